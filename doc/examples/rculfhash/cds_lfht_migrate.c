@@ -0,0 +1,219 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program for any
+ * purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is
+ * granted, provided the above notices are retained, and a notice that
+ * the code was modified is included with the above copyright notice.
+ *
+ * This example shows how to rehash a RCU lock-free hash table with a
+ * new seed, e.g. if its keys collide, without stopping its updates:
+ * the nodes are moved into a new table a few at a time, while lookups
+ * search both tables and new nodes go to the new table. This hash
+ * table requires using a RCU scheme.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <urcu.h>		/* RCU flavor */
+#include <urcu/rculfhash.h>	/* RCU Lock-free hash table */
+#include <urcu/compiler.h>	/* For CAA_ARRAY_SIZE */
+#include "jhash.h"		/* Example hash function */
+
+/*
+ * Nodes populated into the hash table.
+ */
+struct mynode {
+	int value;			/* Node content */
+	struct cds_lfht_node node;	/* Chaining in hash table */
+	struct rcu_head rcu_head;	/* For call_rcu() */
+};
+
+static uint32_t old_seed, new_seed;
+
+static
+int match(struct cds_lfht_node *ht_node, const void *_key)
+{
+	struct mynode *node =
+		caa_container_of(ht_node, struct mynode, node);
+	const int *key = _key;
+
+	return *key == node->value;
+}
+
+static
+void free_node(struct rcu_head *head)
+{
+	struct mynode *node = caa_container_of(head, struct mynode, rcu_head);
+
+	free(node);
+}
+
+static
+unsigned long migrate_hash(struct cds_lfht_node *ht_node, void *priv)
+{
+	struct mynode *node =
+		caa_container_of(ht_node, struct mynode, node);
+
+	return jhash(&node->value, sizeof(node->value), new_seed);
+}
+
+static
+struct cds_lfht_node *migrate_copy(struct cds_lfht_node *ht_node, void *priv)
+{
+	struct mynode *node =
+		caa_container_of(ht_node, struct mynode, node);
+	struct mynode *copy;
+
+	copy = malloc(sizeof(*copy));
+	if (!copy)
+		return NULL;
+	cds_lfht_node_init(&copy->node);
+	copy->value = node->value;
+	return &copy->node;
+}
+
+static
+void migrate_retire(struct cds_lfht_node *ht_node, void *priv)
+{
+	struct mynode *node =
+		caa_container_of(ht_node, struct mynode, node);
+
+	call_rcu(&node->rcu_head, free_node);
+}
+
+static const struct cds_lfht_migrate_ops migrate_ops = {
+	.hash = migrate_hash,
+	.copy = migrate_copy,
+	.retire = migrate_retire,
+};
+
+int main(int argc, char **argv)
+{
+	int values[] = { -5, 42, 36, 24, 7, 13, };
+	int new_values[] = { 42, 99, };	/* 42 is already present */
+	struct cds_lfht *ht, *new_ht;	/* Hash tables */
+	struct cds_lfht_migration *migration;
+	unsigned int i;
+	int ret = 0, more;
+	struct cds_lfht_iter iter;	/* For iteration on hash table */
+	struct cds_lfht_node *ht_node;
+	struct mynode *node;
+
+	/*
+	 * Each thread need using RCU read-side need to be explicitly
+	 * registered.
+	 */
+	rcu_register_thread();
+
+	/* Use time as seed for hash table hashing. */
+	old_seed = (uint32_t) time(NULL);
+	new_seed = old_seed * 2654435761U + 1;
+
+	/*
+	 * Allocate hash tables. The new table could as well use another
+	 * memory management backend or maximum size, see _cds_lfht_new().
+	 */
+	ht = cds_lfht_new(1, 1, 0,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+		NULL);
+	new_ht = cds_lfht_new(1, 1, 0,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+		NULL);
+	if (!ht || !new_ht) {
+		printf("Error allocating hash table\n");
+		ret = -1;
+		goto end;
+	}
+
+	/*
+	 * Add nodes to the old hash table.
+	 */
+	for (i = 0; i < CAA_ARRAY_SIZE(values); i++) {
+		node = malloc(sizeof(*node));
+		if (!node) {
+			ret = -1;
+			goto end;
+		}
+		cds_lfht_node_init(&node->node);
+		node->value = values[i];
+		rcu_read_lock();
+		cds_lfht_add(ht, jhash(&values[i], sizeof(values[i]), old_seed),
+			&node->node);
+		rcu_read_unlock();
+	}
+
+	migration = cds_lfht_migrate_begin(ht, new_ht, &migrate_ops, NULL);
+	if (!migration) {
+		printf("Error starting migration\n");
+		ret = -1;
+		goto end;
+	}
+
+	/*
+	 * Move two nodes per step, adding a node between the steps.
+	 * Lookups and unique adds check both tables.
+	 */
+	i = 0;
+	do {
+		rcu_read_lock();
+		more = cds_lfht_migrate_step(migration, 2);
+		if (more < 0) {
+			rcu_read_unlock();
+			printf("Error moving nodes\n");
+			ret = -1;
+			goto end;
+		}
+		if (i < CAA_ARRAY_SIZE(new_values)) {
+			int value = new_values[i++];
+
+			node = malloc(sizeof(*node));
+			if (!node) {
+				rcu_read_unlock();
+				ret = -1;
+				goto end;
+			}
+			cds_lfht_node_init(&node->node);
+			node->value = value;
+			ht_node = cds_lfht_migrate_add_unique(migration,
+				jhash(&value, sizeof(value), old_seed),
+				jhash(&value, sizeof(value), new_seed),
+				match, &value, &node->node);
+			if (ht_node != &node->node) {
+				printf("Not adding duplicate (key: %d)\n", value);
+				free(node);
+			}
+		}
+		rcu_read_unlock();
+	} while (more);
+
+	/*
+	 * The old table is empty. Readers would now be switched to the
+	 * new table, e.g. with rcu_xchg_pointer(), and a grace period
+	 * waited for before freeing the migration and the old table.
+	 */
+	synchronize_rcu();
+	cds_lfht_migrate_destroy(migration);
+	ret = cds_lfht_destroy(ht, NULL);
+	if (ret) {
+		printf("Error destroying old hash table\n");
+		goto end;
+	}
+	ht = new_ht;
+
+	printf("hash table content (random order):");
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht, &iter, node, node) {
+		printf(" %d", node->value);
+	}
+	rcu_read_unlock();
+	printf("\n");
+
+end:
+	rcu_unregister_thread();
+	return ret;
+}
@@ -0,0 +1,223 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program for any
+ * purpose,  provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is
+ * granted, provided the above notices are retained, and a notice that
+ * the code was modified is included with the above copyright notice.
+ *
+ * This example shows how to update the value associated with a key of
+ * a RCU lock-free hash table without replacing its node: the node
+ * points to its value, which is exchanged with cds_lfht_value_xchg()
+ * and freed after a grace period. A per-key hit counter, fitting in a
+ * machine word, is updated in the node directly. This hash table
+ * requires using a RCU scheme.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <urcu.h>		/* RCU flavor */
+#include <urcu/rculfhash.h>	/* RCU Lock-free hash table */
+#include <urcu/compiler.h>	/* For CAA_ARRAY_SIZE */
+#include "jhash.h"		/* Example hash function */
+
+/*
+ * Values associated with the keys of the hash table.
+ */
+struct myvalue {
+	int version;			/* Value content */
+	struct rcu_head rcu_head;	/* For call_rcu() */
+};
+
+/*
+ * Nodes populated into the hash table.
+ */
+struct mynode {
+	int key;			/* Node key */
+	struct myvalue *value;		/* RCU-updated value */
+	unsigned long hits;		/* Updated with uatomic_inc() */
+	struct cds_lfht_node node;	/* Chaining in hash table */
+	struct rcu_head rcu_head;	/* For call_rcu() */
+};
+
+static
+int match(struct cds_lfht_node *ht_node, const void *_key)
+{
+	struct mynode *node =
+		caa_container_of(ht_node, struct mynode, node);
+	const int *key = _key;
+
+	return *key == node->key;
+}
+
+static
+void free_value(struct rcu_head *head)
+{
+	struct myvalue *value =
+		caa_container_of(head, struct myvalue, rcu_head);
+
+	free(value);
+}
+
+static
+void free_node(struct rcu_head *head)
+{
+	struct mynode *node = caa_container_of(head, struct mynode, rcu_head);
+
+	/* No updater can exchange the value after the grace period. */
+	free(node->value);
+	free(node);
+}
+
+/*
+ * Set the value of @key to a new version, without replacing its node.
+ * Called within RCU read-side critical section.
+ */
+static
+int update_value(struct cds_lfht *ht, unsigned long hash, int key,
+		int version)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ht_node;
+	struct mynode *node;
+	struct myvalue *value, *old_value;
+
+	cds_lfht_lookup(ht, hash, match, &key, &iter);
+	ht_node = cds_lfht_iter_get_node(&iter);
+	if (!ht_node)
+		return -1;
+	node = caa_container_of(ht_node, struct mynode, node);
+	value = malloc(sizeof(*value));
+	if (!value)
+		return -1;
+	value->version = version;
+	old_value = cds_lfht_value_xchg(node->value, value);
+	/* Batched with the other callbacks of the same grace period. */
+	call_rcu(&old_value->rcu_head, free_value);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int keys[] = { -5, 42, 36, 24, };
+	struct cds_lfht *ht;	/* Hash table */
+	unsigned int i;
+	int ret = 0, version;
+	uint32_t seed;
+	struct cds_lfht_iter iter;	/* For iteration on hash table */
+	struct mynode *node;
+
+	/*
+	 * Each thread need using RCU read-side need to be explicitly
+	 * registered.
+	 */
+	rcu_register_thread();
+
+	/* Use time as seed for hash table hashing. */
+	seed = (uint32_t) time(NULL);
+
+	/*
+	 * Allocate hash table.
+	 */
+	ht = cds_lfht_new(1, 1, 0,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+		NULL);
+	if (!ht) {
+		printf("Error allocating hash table\n");
+		ret = -1;
+		goto end;
+	}
+
+	/*
+	 * Add nodes to hash table, with their first value.
+	 */
+	for (i = 0; i < CAA_ARRAY_SIZE(keys); i++) {
+		unsigned long hash;
+
+		node = malloc(sizeof(*node));
+		if (!node) {
+			ret = -1;
+			goto end;
+		}
+		node->value = malloc(sizeof(*node->value));
+		if (!node->value) {
+			free(node);
+			ret = -1;
+			goto end;
+		}
+		cds_lfht_node_init(&node->node);
+		node->key = keys[i];
+		node->value->version = 0;
+		node->hits = 0;
+		hash = jhash(&keys[i], sizeof(keys[i]), seed);
+
+		/*
+		 * cds_lfht_add() needs to be called from RCU read-side
+		 * critical section.
+		 */
+		rcu_read_lock();
+		cds_lfht_add(ht, hash, &node->node);
+		rcu_read_unlock();
+	}
+
+	/*
+	 * Update the value of key 42 a few times. The node stays in the
+	 * hash table: there is no node allocation, and no removal.
+	 */
+	for (version = 1; version <= 3; version++) {
+		int key = 42;
+
+		rcu_read_lock();
+		if (update_value(ht, jhash(&key, sizeof(key), seed), key,
+				version)) {
+			rcu_read_unlock();
+			printf("Error updating value of key %d\n", key);
+			ret = -1;
+			goto end;
+		}
+		rcu_read_unlock();
+	}
+
+	/*
+	 * Count a hit on each node: no value exchange needed.
+	 */
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht, &iter, node, node)
+		uatomic_inc(&node->hits);
+	rcu_read_unlock();
+
+	/*
+	 * Iterate over each hash table node. Those will appear in
+	 * random order, depending on the hash seed. Iteration needs to
+	 * be performed within RCU read-side critical section.
+	 */
+	printf("hash table content (random order):");
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht, &iter, node, node) {
+		struct myvalue *value = cds_lfht_value_get(node->value);
+
+		printf(" (key: %d, version: %d, hits: %lu)",
+			node->key, value->version,
+			CMM_LOAD_SHARED(node->hits));
+	}
+	rcu_read_unlock();
+	printf("\n");
+
+	/*
+	 * Remove the nodes, freeing each with its current value.
+	 */
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht, &iter, node, node) {
+		if (!cds_lfht_del(ht, &node->node))
+			call_rcu(&node->rcu_head, free_node);
+	}
+	rcu_read_unlock();
+
+end:
+	rcu_unregister_thread();
+	return ret;
+}
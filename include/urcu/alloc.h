@@ -0,0 +1,85 @@
+#ifndef _URCU_ALLOC_H
+#define _URCU_ALLOC_H
+
+/*
+ * urcu/alloc.h
+ *
+ * Userspace RCU library - allocator of the internal allocations
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Allocation functions used by the libraries for their internal memory:
+ * call_rcu and defer_rcu queues, hash table structures and bucket
+ * tables, RCU domains, work queues, and so on. Memory the application
+ * frees itself, and the allocations of the inline functions of the
+ * installed headers, still use malloc().
+ *
+ * @alloc, @aligned_alloc, @realloc and @free allocate, resize and
+ * free small objects, @aligned_alloc with @alignment a power of two
+ * multiple of sizeof(void *). They are set together. @large_alloc and @large_free
+ * allocate and free large zeroed areas, at least page-aligned, such as
+ * large hash table bucket tables, e.g. from hugepages or NUMA-local
+ * pools, and are set together. The allocation functions return NULL
+ * on failure. @priv is passed to each function.
+ */
+struct urcu_allocator {
+	void *(*alloc)(size_t size, void *priv);
+	void *(*aligned_alloc)(size_t alignment, size_t size, void *priv);
+	void *(*realloc)(void *ptr, size_t size, void *priv);
+	void (*free)(void *ptr, void *priv);
+	void *(*large_alloc)(size_t size, void *priv);
+	void (*large_free)(void *ptr, size_t size, void *priv);
+	void *priv;
+};
+
+/*
+ * urcu_set_allocator - set the allocator of the libraries.
+ * @allocator: the allocation functions, copied. NULL functions, or a
+ *             NULL @allocator, select malloc() for small objects and
+ *             mmap() for large areas.
+ *
+ * Memory is freed with the allocator current when it is freed, so this
+ * must be called before using the libraries, e.g. first in main().
+ * Returns 0 on success, -EINVAL if a function is set without the
+ * functions it goes with.
+ */
+extern int urcu_set_allocator(const struct urcu_allocator *allocator);
+
+/*
+ * Allocate and free with the allocator of the libraries. They follow
+ * the semantic of the libc functions of the same name, and
+ * urcu_large_alloc() returns zeroed memory.
+ */
+extern void *urcu_malloc(size_t size);
+extern void *urcu_calloc(size_t nmemb, size_t size);
+extern int urcu_posix_memalign(void **memptr, size_t alignment, size_t size);
+extern void *urcu_realloc(void *ptr, size_t size);
+extern void urcu_free(void *ptr);
+extern void *urcu_large_alloc(size_t size);
+extern void urcu_large_free(void *ptr, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_ALLOC_H */
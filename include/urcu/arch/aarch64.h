@@ -30,6 +30,23 @@
 extern "C" {
 #endif
 
+#ifdef CONFIG_RCU_ARM_ASM
+/*
+ * One-directional barriers of the inner shareable domain: loads before
+ * loads and stores for cmm_rmb, stores before stores for cmm_wmb. The
+ * full barrier is the default dmb ish of __sync_synchronize().
+ */
+#define cmm_rmb()	__asm__ __volatile__ ("dmb ishld":::"memory")
+#define cmm_wmb()	__asm__ __volatile__ ("dmb ishst":::"memory")
+
+/*
+ * RCU pointers are published with a store-release (stlr), and
+ * exchanged with acquire-release atomics, instead of barriers around
+ * the store or exchange. See urcu/static/urcu-pointer.h.
+ */
+#define CMM_HAS_POINTER_ACQ_REL
+#endif /* #ifdef CONFIG_RCU_ARM_ASM */
+
 #include <stdlib.h>
 #include <sys/time.h>
 
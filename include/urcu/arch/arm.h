@@ -32,18 +32,28 @@ extern "C" {
 
 #ifdef CONFIG_RCU_ARM_HAVE_DMB
 /*
- * Issues full system DMB operation.
+ * Issues full system DMB operation. With --enable-arm-asm, write
+ * barriers only order stores (DMB ST). ARMv7 has no barrier ordering
+ * loads only.
  */
 #define cmm_mb()	__asm__ __volatile__ ("dmb sy":::"memory")
 #define cmm_rmb()	__asm__ __volatile__ ("dmb sy":::"memory")
+#ifdef CONFIG_RCU_ARM_ASM
+#define cmm_wmb()	__asm__ __volatile__ ("dmb st":::"memory")
+#else
 #define cmm_wmb()	__asm__ __volatile__ ("dmb sy":::"memory")
+#endif
 
 /*
  * Issues DMB operation only to the inner shareable domain.
  */
 #define cmm_smp_mb()	__asm__ __volatile__ ("dmb ish":::"memory")
 #define cmm_smp_rmb()	__asm__ __volatile__ ("dmb ish":::"memory")
+#ifdef CONFIG_RCU_ARM_ASM
+#define cmm_smp_wmb()	__asm__ __volatile__ ("dmb ishst":::"memory")
+#else
 #define cmm_smp_wmb()	__asm__ __volatile__ ("dmb ish":::"memory")
+#endif
 #endif /* CONFIG_RCU_ARM_HAVE_DMB */
 
 #include <stdlib.h>
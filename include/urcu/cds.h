@@ -30,9 +30,15 @@
 #include <urcu/rculfqueue.h>
 #include <urcu/rculfstack.h>
 #include <urcu/rculfhash.h>
+#include <urcu/rcuskiplist.h>
+#include <urcu/rcuja.h>
+#include <urcu/rcuarray.h>
+#include <urcu/rcuhtable.h>
 #include <urcu/wfqueue.h>
 #include <urcu/wfcqueue.h>
 #include <urcu/wfstack.h>
 #include <urcu/lfstack.h>
+#include <urcu/ring.h>
+#include <urcu/rcuslab.h>
 
 #endif /* _URCU_CDS_H */
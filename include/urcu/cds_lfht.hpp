@@ -0,0 +1,296 @@
+#ifndef _URCU_CDS_LFHT_HPP
+#define _URCU_CDS_LFHT_HPP
+
+/*
+ * urcu/cds_lfht.hpp
+ *
+ * Userspace RCU library - C++ typed wrapper of the Lock-Free RCU Hash
+ * Table
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE: the lookup fast-path of
+ * urcu/static/rculfhash.h is inlined in the caller.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor. Requires C++11.
+ */
+
+#ifndef __cplusplus
+#error "urcu/cds_lfht.hpp is a C++ header"
+#endif
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <utility>
+
+#include <urcu/rculfhash.h>
+#include <urcu/static/rculfhash.h>
+#include <urcu/hook.hpp>
+#include <urcu/urcu.hpp>
+
+namespace rcu {
+
+/*
+ * A Hook tells rcu::lfht where the struct cds_lfht_node and the key of
+ * its elements are. It provides:
+ *
+ *   static cds_lfht_node *node(T *obj);
+ *   static T *from_node(cds_lfht_node *node);
+ *   static const Key &key(const T *obj);
+ *
+ * lfht_member_hook implements it for a T holding both as members,
+ * where T is a standard-layout type.
+ */
+template <typename T, typename Key, cds_lfht_node T::*NodeMember,
+		Key T::*KeyMember>
+struct lfht_member_hook {
+	static cds_lfht_node *node(T *obj)
+	{
+		return &(obj->*NodeMember);
+	}
+
+	static T *from_node(cds_lfht_node *node)
+	{
+		return container_of<T, cds_lfht_node, NodeMember>(node);
+	}
+
+	static const Key &key(const T *obj)
+	{
+		return obj->*KeyMember;
+	}
+};
+
+/*
+ * rcu::lfht - hash table of T, intrusive and unique by Key.
+ *
+ * The table does not own its elements: elements removed with erase()
+ * are freed by the caller after a grace period, e.g. with call_rcu().
+ * Hash and Eq are stateless function objects, default-constructed for
+ * each call, and Eq is inlined in the chain traversal of find().
+ *
+ * Caution !
+ * Except for the constructor and destructor, call with rcu_read_lock
+ * held (see rcu::read_guard), from threads registered as RCU
+ * read-side threads. Iterators and element pointers are only valid
+ * within the read-side critical section in which they were obtained.
+ */
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+		typename Eq = std::equal_to<Key>,
+		typename Hook = lfht_member_hook<T, Key, &T::node, &T::key> >
+class lfht {
+public:
+	class iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef T *pointer;
+		typedef T &reference;
+
+		iterator() : ht_(NULL)
+		{
+			iter_.node = iter_.next = NULL;
+		}
+
+		reference operator*() const
+		{
+			return *Hook::from_node(iter_.node);
+		}
+
+		pointer operator->() const
+		{
+			return Hook::from_node(iter_.node);
+		}
+
+		iterator &operator++()
+		{
+			cds_lfht_next(ht_, &iter_);
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator old = *this;
+
+			++*this;
+			return old;
+		}
+
+		bool operator==(const iterator &other) const
+		{
+			return iter_.node == other.iter_.node;
+		}
+
+		bool operator!=(const iterator &other) const
+		{
+			return iter_.node != other.iter_.node;
+		}
+
+	private:
+		friend class lfht;
+
+		explicit iterator(struct cds_lfht *ht) : ht_(ht)
+		{
+			cds_lfht_first(ht_, &iter_);
+		}
+
+		struct cds_lfht *ht_;
+		struct cds_lfht_iter iter_;
+	};
+
+	/*
+	 * Allocate the table, see cds_lfht_new(). Throws std::bad_alloc
+	 * on error.
+	 */
+	explicit lfht(unsigned long init_size = 1,
+			unsigned long min_nr_alloc_buckets = 1,
+			unsigned long max_nr_buckets = 0,
+			int flags = CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING)
+	{
+		ht_ = cds_lfht_new(init_size, min_nr_alloc_buckets,
+				max_nr_buckets, flags, NULL);
+		if (!ht_)
+			throw std::bad_alloc();
+	}
+
+	/*
+	 * Destroy the table, which must be empty. Not to be called from a
+	 * RCU read-side critical section.
+	 */
+	~lfht()
+	{
+		(void) cds_lfht_destroy(ht_, NULL);
+	}
+
+	/*
+	 * Return the element holding @key, or NULL if not found.
+	 */
+	T *find(const Key &key) const
+	{
+		struct cds_lfht_iter iter;
+
+		_cds_lfht_lookup(ht_, hash(key), match, &key, &iter);
+		return iter.node ? Hook::from_node(iter.node) : NULL;
+	}
+
+	/*
+	 * Add @obj unless its key is present. Returns the element holding
+	 * the key, and whether it is @obj.
+	 */
+	std::pair<T *, bool> insert(T *obj)
+	{
+		const Key &key = Hook::key(obj);
+		struct cds_lfht_node *node;
+
+		node = cds_lfht_add_unique(ht_, hash(key), match, &key,
+				Hook::node(obj));
+		return std::make_pair(Hook::from_node(node),
+				node == Hook::node(obj));
+	}
+
+	/*
+	 * Add @obj, replacing the element holding its key if present.
+	 * Returns the replaced element, or NULL.
+	 */
+	T *insert_or_replace(T *obj)
+	{
+		const Key &key = Hook::key(obj);
+		struct cds_lfht_node *node;
+
+		node = cds_lfht_add_replace(ht_, hash(key), match, &key,
+				Hook::node(obj));
+		return node ? Hook::from_node(node) : NULL;
+	}
+
+	/*
+	 * Remove @obj. Returns false if it is not in the table anymore.
+	 */
+	bool erase(T *obj)
+	{
+		return !cds_lfht_del(ht_, Hook::node(obj));
+	}
+
+	/*
+	 * Remove the element holding @key. Returns it, or NULL if not
+	 * found.
+	 */
+	T *erase(const Key &key)
+	{
+		T *obj = find(key);
+
+		if (obj && erase(obj))
+			return obj;
+		return NULL;
+	}
+
+	/*
+	 * Traversal of the whole table, in no particular order.
+	 */
+	iterator begin() const
+	{
+		return iterator(ht_);
+	}
+
+	iterator end() const
+	{
+		return iterator();
+	}
+
+	/*
+	 * Return the number of elements, from the split-counters with
+	 * CDS_LFHT_ACCOUNTING (exact without concurrent updates), and
+	 * otherwise by traversing the table.
+	 */
+	unsigned long size() const
+	{
+		long approx_before, approx_after;
+		unsigned long count;
+
+		if (!cds_lfht_count_fast(ht_, &count))
+			return count;
+		cds_lfht_count_nodes(ht_, &approx_before, &count,
+				&approx_after);
+		return count;
+	}
+
+	/* The underlying table, for the rest of the cds_lfht API. */
+	struct cds_lfht *get() const
+	{
+		return ht_;
+	}
+
+	lfht(const lfht &) = delete;
+	lfht &operator=(const lfht &) = delete;
+
+private:
+	static unsigned long hash(const Key &key)
+	{
+		return Hash()(key);
+	}
+
+	static int match(struct cds_lfht_node *node, const void *key)
+	{
+		return Eq()(Hook::key(Hook::from_node(node)),
+				*static_cast<const Key *>(key));
+	}
+
+	struct cds_lfht *ht_;
+};
+
+} /* namespace rcu */
+
+#endif /* _URCU_CDS_LFHT_HPP */
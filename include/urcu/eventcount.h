@@ -0,0 +1,185 @@
+#ifndef _URCU_EVENTCOUNT_H
+#define _URCU_EVENTCOUNT_H
+
+/*
+ * urcu/eventcount.h
+ *
+ * Userspace RCU library - futex-based event count
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Lets threads sleep until a condition, e.g. a queue being non-empty,
+ * becomes true, while the threads making it true only issue a wake up
+ * system call when a thread is actually sleeping. Waiters do:
+ *
+ *	for (;;) {
+ *		cds_eventcount_prepare_wait(&ec);
+ *		if (condition) {
+ *			cds_eventcount_cancel_wait(&ec);
+ *			break;
+ *		}
+ *		cds_eventcount_wait(&ec);
+ *	}
+ *
+ * and wakers make the condition true, then call cds_eventcount_wake().
+ * The memory barriers of both sides ensure that either the waiter sees
+ * the condition, or the waker sees the waiter and wakes it up.
+ *
+ * The futex is 0 when no thread waits, and -1 once a waiter prepared to
+ * wait. Waking is signal-handler safe.
+ */
+struct cds_eventcount {
+	int32_t futex;
+};
+
+#define CDS_EVENTCOUNT_INIT	{ 0 }
+
+/* Period of the wake up checks without futex timeouts, in ns. */
+#define CDS_EVENTCOUNT_POLL_NS	10000000ULL
+
+static inline void cds_eventcount_init(struct cds_eventcount *ec)
+{
+	ec->futex = 0;
+}
+
+/* Announce a wait, before checking the condition. */
+static inline void cds_eventcount_prepare_wait(struct cds_eventcount *ec)
+{
+	uatomic_set(&ec->futex, -1);
+	/* Write futex before reading the condition. */
+	cmm_smp_mb();
+}
+
+/*
+ * Withdraw a wait announced by cds_eventcount_prepare_wait(), the
+ * condition being true. Optional: otherwise the next waker issues a
+ * needless wake up.
+ */
+static inline void cds_eventcount_cancel_wait(struct cds_eventcount *ec)
+{
+	uatomic_set(&ec->futex, 0);
+}
+
+/*
+ * Wait for a wake up after cds_eventcount_prepare_wait(). May return
+ * early: the caller rechecks the condition. Returns 0, or -1 with
+ * errno set on unexpected futex error.
+ */
+static inline int cds_eventcount_wait(struct cds_eventcount *ec)
+{
+	/* Read condition before read futex. */
+	cmm_smp_mb();
+	if (uatomic_read(&ec->futex) != -1)
+		return 0;
+	while (futex_async(&ec->futex, FUTEX_WAIT, -1, NULL, NULL, 0)) {
+		switch (errno) {
+		case EWOULDBLOCK:
+			/* Value already changed. */
+			return 0;
+		case EINTR:
+			/* Retry if interrupted by signal. */
+			break;	/* Get out of switch. */
+		default:
+			/* Unexpected error. */
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Wait for a wake up after cds_eventcount_prepare_wait(), for at most
+ * @timeout_ns. Returns 1 if the wait timed out, 0 if it may have been
+ * woken up, or -1 with errno set on unexpected futex error. Without
+ * futex timeouts, checks for wake ups every CDS_EVENTCOUNT_POLL_NS.
+ */
+static inline int cds_eventcount_wait_timeout(struct cds_eventcount *ec,
+		uint64_t timeout_ns)
+{
+	uint64_t slice_ns;
+#ifdef CONFIG_RCU_HAVE_FUTEX
+	struct timespec ts;
+#endif
+
+	/* Read condition before read futex. */
+	cmm_smp_mb();
+	if (uatomic_read(&ec->futex) != -1)
+		return 0;
+#ifdef CONFIG_RCU_HAVE_FUTEX
+	ts.tv_sec = timeout_ns / 1000000000ULL;
+	ts.tv_nsec = timeout_ns % 1000000000ULL;
+	if (!futex(&ec->futex, FUTEX_WAIT, -1, &ts, NULL, 0))
+		return 0;
+	switch (errno) {
+	case ETIMEDOUT:
+		return 1;
+	case EWOULDBLOCK:
+	case EINTR:
+		return 0;
+	case ENOSYS:
+		break;
+	default:
+		return -1;
+	}
+#endif
+	while (timeout_ns) {
+		slice_ns = caa_min(timeout_ns, CDS_EVENTCOUNT_POLL_NS);
+		(void) poll(NULL, 0, (int) ((slice_ns + 999999) / 1000000));
+		if (uatomic_read(&ec->futex) != -1)
+			return 0;
+		timeout_ns -= slice_ns;
+	}
+	return 1;
+}
+
+/*
+ * Wake up the waiters, after making the condition true. Only issues a
+ * system call if a thread prepared to wait. Returns 0, or -1 with errno
+ * set on futex error.
+ */
+static inline int cds_eventcount_wake(struct cds_eventcount *ec)
+{
+	/* Write condition before reading/writing futex. */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&ec->futex) == -1)) {
+		uatomic_set(&ec->futex, 0);
+		if (futex_async(&ec->futex, FUTEX_WAKE, INT_MAX,
+				NULL, NULL, 0) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_EVENTCOUNT_H */
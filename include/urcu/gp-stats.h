@@ -0,0 +1,82 @@
+#ifndef _URCU_GP_STATS_H
+#define _URCU_GP_STATS_H
+
+/*
+ * urcu/gp-stats.h
+ *
+ * Userspace RCU - grace period statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Phases of a grace period, timed in rcu_gp_stats.phase_ns.
+ */
+enum rcu_gp_phase {
+	/* Waiting for the grace period lock, once leading a batch. */
+	RCU_GP_PHASE_LOCK = 0,
+	/* Waiting for the readers of the current counter snapshot. */
+	RCU_GP_PHASE_WAIT,
+	/* Waiting for the readers again, after the counter flip. */
+	RCU_GP_PHASE_FLIP,
+	RCU_GP_NR_PHASES,
+};
+
+/*
+ * Cumulative counters of the grace periods of a flavor, filled in by
+ * rcu_gp_get_stats(). Durations are in nanoseconds. Grace periods of
+ * RCU domains are not counted, but their memory barriers and signals
+ * are. Each counter is read atomically, not all of them together.
+ */
+struct rcu_gp_stats {
+	unsigned long grace_periods;	/* Grace periods completed. */
+	unsigned long callers;		/* synchronize_rcu() calls they served. */
+	unsigned long callers_max;	/* Most calls served by one of them. */
+	unsigned long coalesced;	/* Calls served by earlier ones. */
+	uint64_t gp_ns;			/* Time spent in them, lock held. */
+	uint64_t gp_max_ns;		/* Longest of them. */
+	uint64_t phase_ns[RCU_GP_NR_PHASES];
+	unsigned long wait_loops;	/* Reader scans before sleeping. */
+	unsigned long wait_sleeps;	/* Sleeps waiting for readers. */
+	unsigned long membarriers;	/* sys_membarrier() calls. */
+	unsigned long signals;		/* Signals sent to readers. */
+};
+
+/*
+ * sys_membarrier() command issued by the grace periods of the urcu
+ * flavors, returned by rcu_get_membarrier_mode().
+ */
+enum rcu_membarrier_mode {
+	/* Not used: the readers issue memory barriers, or get signals. */
+	RCU_MEMBARRIER_NONE = 0,
+	/* Interrupts the CPUs running threads of this process. */
+	RCU_MEMBARRIER_PRIVATE_EXPEDITED,
+	/* Interrupts the CPUs running threads of registered processes. */
+	RCU_MEMBARRIER_GLOBAL_EXPEDITED,
+	/* Waits for a kernel grace period, milliseconds per barrier. */
+	RCU_MEMBARRIER_SHARED,
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_GP_STATS_H */
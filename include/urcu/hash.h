@@ -0,0 +1,290 @@
+#ifndef _URCU_HASH_H
+#define _URCU_HASH_H
+
+/*
+ * urcu/hash.h
+ *
+ * Userspace RCU library - Hash functions for hash table keys
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <urcu/compiler.h>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define CDS_HASH_HAVE_HW_CRC32C	1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CDS_HASH_HAVE_HW_CRC32C	1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hash functions for the keys of cds_lfht and the other hash tables.
+ *
+ * cds_lfht indexes its buckets with the low-order bits of the hash, and
+ * orders each bucket chain by the bit-reversed hash: every output bit
+ * matters, the low-order ones first. All these functions end with a
+ * multiply-xorshift avalanche, so each output bit depends on each input
+ * bit, unlike e.g. the identity or a modulo of integer keys.
+ *
+ * Hash values depend on the seed, which should be random to resist
+ * collision attacks, and are not portable across architectures.
+ */
+
+/*
+ * cds_hash_u32 - hash a 32-bit integer.
+ *
+ * xorshift-multiply avalanche of C. Wellons' "lowbias32".
+ */
+static inline
+uint32_t cds_hash_u32(uint32_t key, uint32_t seed)
+{
+	uint32_t x = key ^ seed;
+
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+/*
+ * cds_hash_u64 - hash a 64-bit integer.
+ *
+ * SplitMix64 finalizer of the key offset by the seed.
+ */
+static inline
+uint64_t cds_hash_u64(uint64_t key, uint64_t seed)
+{
+	uint64_t x = key + seed + 0x9e3779b97f4a7c15ULL;
+
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+ * cds_hash_ulong - hash an unsigned long, e.g. an integer key or a
+ * pointer.
+ */
+static inline
+unsigned long cds_hash_ulong(unsigned long key, unsigned long seed)
+{
+#if (CAA_BITS_PER_LONG == 64)
+	return (unsigned long) cds_hash_u64(key, seed);
+#else
+	return (unsigned long) cds_hash_u32(key, seed);
+#endif
+}
+
+/*
+ * Byte string hash, after wyhash by Wang Yi (public domain): 64x64 to
+ * 128-bit multiplications fold 16 bytes of key into the state at a
+ * time, in three independent lanes for keys over 48 bytes.
+ */
+static inline
+void __cds_hash_mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t) *a * *b;
+
+	*a = (uint64_t) r;
+	*b = (uint64_t) (r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t) *a, lb = (uint32_t) *b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline
+uint64_t __cds_hash_mix(uint64_t a, uint64_t b)
+{
+	__cds_hash_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline
+uint64_t __cds_hash_r8(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline
+uint64_t __cds_hash_r4(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/* Reads 1 to 3 bytes. */
+static inline
+uint64_t __cds_hash_r3(const uint8_t *p, size_t len)
+{
+	return ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8)
+		| p[len - 1];
+}
+
+/*
+ * cds_hash_bytes - hash a byte string.
+ * @key: the key.
+ * @len: length of the key, in bytes.
+ * @seed: hash seed.
+ *
+ * Fast for any key length, with no alignment requirement on @key. On
+ * 32-bit architectures, cds_lfht uses the low-order 32 bits of the
+ * result, which are as well mixed as the others.
+ */
+static inline
+uint64_t cds_hash_bytes(const void *key, size_t len, uint64_t seed)
+{
+	static const uint64_t s[4] = {
+		0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+		0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL,
+	};
+	const uint8_t *p = (const uint8_t *) key;
+	uint64_t a, b;
+
+	seed ^= __cds_hash_mix(seed ^ s[0], s[1]);
+	if (caa_likely(len <= 16)) {
+		if (caa_likely(len >= 4)) {
+			size_t off = (len >> 3) << 2;
+
+			a = (__cds_hash_r4(p) << 32) | __cds_hash_r4(p + off);
+			b = (__cds_hash_r4(p + len - 4) << 32)
+				| __cds_hash_r4(p + len - 4 - off);
+		} else if (caa_likely(len > 0)) {
+			a = __cds_hash_r3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+
+		if (caa_unlikely(i > 48)) {
+			uint64_t seed1 = seed, seed2 = seed;
+
+			do {
+				seed = __cds_hash_mix(__cds_hash_r8(p) ^ s[1],
+					__cds_hash_r8(p + 8) ^ seed);
+				seed1 = __cds_hash_mix(__cds_hash_r8(p + 16) ^ s[2],
+					__cds_hash_r8(p + 24) ^ seed1);
+				seed2 = __cds_hash_mix(__cds_hash_r8(p + 32) ^ s[3],
+					__cds_hash_r8(p + 40) ^ seed2);
+				p += 48;
+				i -= 48;
+			} while (caa_likely(i > 48));
+			seed ^= seed1 ^ seed2;
+		}
+		while (caa_unlikely(i > 16)) {
+			seed = __cds_hash_mix(__cds_hash_r8(p) ^ s[1],
+				__cds_hash_r8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = __cds_hash_r8(p + i - 16);
+		b = __cds_hash_r8(p + i - 8);
+	}
+	a ^= s[1];
+	b ^= seed;
+	__cds_hash_mum(&a, &b);
+	return __cds_hash_mix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+/*
+ * cds_hash_crc32c - CRC32C (Castagnoli) of a byte string.
+ * @key: the key.
+ * @len: length of the key, in bytes.
+ * @crc: CRC32C of the preceding bytes, or 0.
+ *
+ * Uses the CRC32 instructions when compiled for them, that is when
+ * CDS_HASH_HAVE_HW_CRC32C is defined (e.g. -msse4.2 on x86, or
+ * -march=armv8-a+crc on arm64), and a much slower bitwise computation
+ * otherwise. Returns the standard CRC32C, which is linear: hash tables
+ * should use cds_hash_bytes_crc32c() instead.
+ */
+static inline
+uint32_t cds_hash_crc32c(const void *key, size_t len, uint32_t crc)
+{
+	const uint8_t *p = (const uint8_t *) key;
+
+	crc = ~crc;
+#if defined(__SSE4_2__) && defined(__x86_64__)
+	for (; len >= 8; len -= 8, p += 8)
+		crc = (uint32_t) _mm_crc32_u64(crc, __cds_hash_r8(p));
+#elif defined(__ARM_FEATURE_CRC32)
+	for (; len >= 8; len -= 8, p += 8)
+		crc = __crc32cd(crc, __cds_hash_r8(p));
+#endif
+	for (; len > 0; len--, p++) {
+#if defined(__SSE4_2__)
+		crc = _mm_crc32_u8(crc, *p);
+#elif defined(__ARM_FEATURE_CRC32)
+		crc = __crc32cb(crc, *p);
+#else
+		unsigned int i;
+
+		crc ^= *p;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0x82f63b78U & -(crc & 1));
+#endif
+	}
+	return ~crc;
+}
+
+/*
+ * cds_hash_bytes_crc32c - hash a byte string with CRC32C.
+ *
+ * The CRC32C of @key, and its length, through the cds_hash_u64
+ * avalanche. Faster than cds_hash_bytes on short keys with hardware
+ * CRC32C, but with 32 bits of entropy only, and seeded after the CRC:
+ * keys colliding for one seed collide for all.
+ */
+static inline
+unsigned long cds_hash_bytes_crc32c(const void *key, size_t len,
+		unsigned long seed)
+{
+	uint64_t crc = cds_hash_crc32c(key, len, 0);
+
+	return (unsigned long) cds_hash_u64(crc | ((uint64_t) len << 32),
+			seed);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_HASH_H */
@@ -0,0 +1,215 @@
+#ifndef _URCU_HAZPTR_H
+#define _URCU_HAZPTR_H
+
+/*
+ * urcu/hazptr.h
+ *
+ * Userspace RCU library - Hazard pointers for long-lived readers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor.
+ */
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/lfstack.h>
+#include <urcu-call-rcu.h>
+#include <urcu-flavor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default number of retired objects triggering a scan. */
+#define CDS_HAZPTR_BATCH	64
+
+/*
+ * A hazard pointer domain frees retired objects once no reader can
+ * access them, whether readers access them within RCU read-side
+ * critical sections of the flavor, or protect them with a hazard
+ * pointer of the domain. Short readers stay on RCU, while long readers
+ * protect only the objects they hold, without holding up the grace
+ * periods of everyone.
+ *
+ * Retired objects are queued in batches with the call_rcu of the
+ * flavor: after a grace period, the call_rcu worker thread scans the
+ * hazard pointers of the domain, frees the objects which are not
+ * protected, and keeps the others retired until the next scan.
+ */
+struct cds_hazptr {
+	void *ptr;			/* Protected object, or NULL. */
+	int active;			/* Owned by a reader. */
+	struct cds_hazptr *next;	/* Domain list, never unlinked. */
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * struct cds_hazptr_head is embedded in retired objects.
+ */
+struct cds_hazptr_head {
+	struct cds_lfs_node node;
+	void *ptr;			/* Object as protected by readers. */
+	void (*func)(struct cds_hazptr_head *head);
+};
+
+struct cds_hazptr_domain {
+	struct cds_hazptr *hazptrs;
+	unsigned long nr_hazptrs;
+	struct __cds_lfs_stack retired;
+	long nr_retired;
+	long batch;
+	const struct rcu_flavor_struct *flavor;
+};
+
+/*
+ * _cds_hazptr_domain_init - API used by cds_hazptr_domain_init wrapper.
+ * Do not use directly.
+ */
+extern
+void _cds_hazptr_domain_init(struct cds_hazptr_domain *dom, long batch,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_hazptr_domain_init - initialize a hazard pointer domain.
+ * @dom: the domain to initialize.
+ * @batch: number of retired objects triggering a scan, 0 for
+ *         CDS_HAZPTR_BATCH.
+ *
+ * Note: the RCU flavor must be already included before the hazard
+ * pointer header.
+ */
+static inline
+void cds_hazptr_domain_init(struct cds_hazptr_domain *dom, long batch)
+{
+	_cds_hazptr_domain_init(dom, batch, &rcu_flavor);
+}
+
+/*
+ * cds_hazptr_domain_destroy - free all retired objects and the hazard
+ * pointers of a domain.
+ *
+ * All hazard pointers must have been released. Waits for the pending
+ * scans and for a grace period: not to be called from a RCU read-side
+ * critical section, nor from a call_rcu worker thread.
+ */
+extern
+void cds_hazptr_domain_destroy(struct cds_hazptr_domain *dom);
+
+/*
+ * cds_hazptr_acquire - get a hazard pointer of the domain.
+ *
+ * Reuses a released hazard pointer if any. Returns NULL if a new one
+ * cannot be allocated. Hazard pointers are meant to be kept by a
+ * reader thread across many protections.
+ */
+extern
+struct cds_hazptr *cds_hazptr_acquire(struct cds_hazptr_domain *dom);
+
+/*
+ * cds_hazptr_release - give a hazard pointer back to its domain,
+ * clearing it.
+ */
+extern
+void cds_hazptr_release(struct cds_hazptr *hp);
+
+/*
+ * cds_hazptr_retire - free an object once no reader can access it.
+ * @dom: the domain of the hazard pointers protecting the object.
+ * @ptr: the object, as loaded by readers.
+ * @head: the struct cds_hazptr_head embedded in the object.
+ * @func: frees the object, from a call_rcu worker thread.
+ *
+ * The object must be unpublished first, e.g. with rcu_assign_pointer()
+ * or rcu_xchg_pointer(). May be called from RCU read-side critical
+ * sections. Threads calling this API need to be registered RCU
+ * read-side threads.
+ */
+extern
+void cds_hazptr_retire(struct cds_hazptr_domain *dom, void *ptr,
+		struct cds_hazptr_head *head,
+		void (*func)(struct cds_hazptr_head *head));
+
+/*
+ * cds_hazptr_domain_flush - queue the scan of all retired objects,
+ * rather than waiting for a full batch.
+ *
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void cds_hazptr_domain_flush(struct cds_hazptr_domain *dom);
+
+/*
+ * cds_hazptr_protect - load and protect a RCU-protected pointer.
+ * @hp: the hazard pointer.
+ * @p: address of the pointer, published with rcu_assign_pointer(),
+ *     rcu_cmpxchg_pointer() or rcu_xchg_pointer().
+ *
+ * Returns the pointer loaded from @p, which is protected from
+ * cds_hazptr_retire() until @hp is cleared or reused, with or without
+ * RCU read-side lock held. Replaces the object previously protected by
+ * @hp, if any.
+ */
+static inline
+void *__cds_hazptr_protect(struct cds_hazptr *hp, void **p)
+{
+	void *ptr;
+
+	for (;;) {
+		ptr = CMM_LOAD_SHARED(*p);
+		CMM_STORE_SHARED(hp->ptr, ptr);
+		/* Order the hazard pointer before the validation. */
+		cmm_smp_mb();
+		if (caa_likely(CMM_LOAD_SHARED(*p) == ptr))
+			break;
+	}
+	cmm_smp_read_barrier_depends();
+	return ptr;
+}
+
+#define cds_hazptr_protect(hp, p)					\
+	((__typeof__(*(p))) __cds_hazptr_protect(hp, (void **) (p)))
+
+/*
+ * cds_hazptr_set - protect an object obtained with rcu_dereference().
+ *
+ * Call within the RCU read-side critical section in which @ptr was
+ * obtained from a RCU-protected pointer: the object stays protected
+ * from cds_hazptr_retire() after the end of the critical section,
+ * until @hp is cleared or reused.
+ */
+static inline
+void cds_hazptr_set(struct cds_hazptr *hp, void *ptr)
+{
+	CMM_STORE_SHARED(hp->ptr, ptr);
+	cmm_smp_mb();
+}
+
+/*
+ * cds_hazptr_clear - stop protecting the object of @hp.
+ */
+static inline
+void cds_hazptr_clear(struct cds_hazptr *hp)
+{
+	/* Order the accesses to the object before the clear. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(hp->ptr, NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_HAZPTR_H */
@@ -0,0 +1,53 @@
+#ifndef _URCU_HOOK_HPP
+#define _URCU_HOOK_HPP
+
+/*
+ * urcu/hook.hpp
+ *
+ * Userspace RCU library - C++ helpers for intrusive hooks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __cplusplus
+#error "urcu/hook.hpp is a C++ header"
+#endif
+
+#include <cstddef>
+
+namespace rcu {
+
+/*
+ * container_of - get the object embedding a hook.
+ * @ptr: pointer to the Member member of a T.
+ *
+ * caa_container_of() for a pointer to member, for standard-layout
+ * types T.
+ */
+template <typename T, typename M, M T::*Member>
+inline T *container_of(M *ptr)
+{
+	/* offsetof() for a pointer to member. */
+	const T *obj = reinterpret_cast<const T *>(0x1000);
+	std::ptrdiff_t offset =
+		reinterpret_cast<const char *>(&(obj->*Member))
+			- reinterpret_cast<const char *>(obj);
+
+	return reinterpret_cast<T *>(reinterpret_cast<char *>(ptr) - offset);
+}
+
+} /* namespace rcu */
+
+#endif /* _URCU_HOOK_HPP */
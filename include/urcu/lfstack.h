@@ -29,6 +29,8 @@ extern "C" {
 
 #include <stdbool.h>
 #include <pthread.h>
+#include <urcu/arch.h>
+#include <urcu/eventcount.h>
 
 /*
  * Lock-free stack.
@@ -47,8 +49,19 @@ extern "C" {
  * __cds_lfs_pop              -              X                  X
  * __cds_lfs_pop_all          -              X                  -
  *
- * cds_lfs_pop_blocking and cds_lfs_pop_all_blocking use an internal
- * mutex to provide synchronization.
+ * __cds_lfs_pop_n needs the same synchronization as __cds_lfs_pop,
+ * against __cds_lfs_pop, __cds_lfs_pop_n and __cds_lfs_pop_all callers:
+ * either call it within a RCU read-side critical section, and wait for
+ * a grace period before freeing its nodes or pushing them back into the
+ * stack, or use the same mutual exclusion as the other pop callers (see
+ * __cds_lfs_pop below). With RCU, the popped nodes must not be
+ * overwritten before that grace period either.
+ *
+ * __cds_lfs_pop_elim needs the same synchronization as __cds_lfs_pop.
+ *
+ * cds_lfs_pop_blocking, cds_lfs_pop_n_blocking and
+ * cds_lfs_pop_all_blocking use an internal mutex to provide
+ * synchronization.
  */
 
 /*
@@ -79,6 +92,25 @@ struct cds_lfs_stack {
 	pthread_mutex_t lock;
 };
 
+/* Number of slots of an elimination array. Power of 2. */
+#define CDS_LFS_ELIM_SLOTS	8
+
+/*
+ * struct cds_lfs_elim is an elimination array, shared by the threads
+ * pushing with cds_lfs_push_elim and popping with __cds_lfs_pop_elim
+ * on a stack. When their cmpxchg on the stack head fails, a pusher
+ * offers its node into a slot, where a popper may take it: the push
+ * and the pop then complete without accessing the head. Each slot is
+ * on its own cache line.
+ */
+struct cds_lfs_elim {
+	struct {
+		struct cds_lfs_node *node;
+	} __attribute__((aligned(CAA_CACHE_LINE_SIZE)))
+		slots[CDS_LFS_ELIM_SLOTS];
+};
+
+#ifndef __cplusplus
 /*
  * The transparent union allows calling functions that work on both
  * struct cds_lfs_stack and struct __cds_lfs_stack on any of those two
@@ -89,6 +121,45 @@ typedef union {
 	struct cds_lfs_stack *s;
 } __attribute__((__transparent_union__)) cds_lfs_stack_ptr_t;
 
+/*
+ * This static inline is only present for compatibility with C++. It is
+ * effect-less in C.
+ */
+static inline struct __cds_lfs_stack *__cds_lfs_stack_cast(struct __cds_lfs_stack *s)
+{
+	return s;
+}
+
+/*
+ * This static inline is only present for compatibility with C++. It is
+ * effect-less in C.
+ */
+static inline struct cds_lfs_stack *cds_lfs_stack_cast(struct cds_lfs_stack *s)
+{
+	return s;
+}
+#else /* #ifndef __cplusplus */
+
+/* C++ ignores transparent union. */
+typedef union {
+	struct __cds_lfs_stack *_s;
+	struct cds_lfs_stack *s;
+} cds_lfs_stack_ptr_t;
+
+/* C++ ignores transparent union. Requires an explicit conversion. */
+static inline cds_lfs_stack_ptr_t __cds_lfs_stack_cast(struct __cds_lfs_stack *s)
+{
+	cds_lfs_stack_ptr_t ret = { ._s = s };
+	return ret;
+}
+/* C++ ignores transparent union. Requires an explicit conversion. */
+static inline cds_lfs_stack_ptr_t cds_lfs_stack_cast(struct cds_lfs_stack *s)
+{
+	cds_lfs_stack_ptr_t ret = { .s = s };
+	return ret;
+}
+#endif /* #else #ifndef __cplusplus */
+
 #ifdef _LGPL_SOURCE
 
 #include <urcu/static/lfstack.h>
@@ -99,9 +170,14 @@ typedef union {
 #define __cds_lfs_init			___cds_lfs_init
 #define cds_lfs_empty			_cds_lfs_empty
 #define cds_lfs_push			_cds_lfs_push
+#define cds_lfs_push_wake		_cds_lfs_push_wake
+#define cds_lfs_elim_init		_cds_lfs_elim_init
+#define cds_lfs_push_elim		_cds_lfs_push_elim
 
 /* Locking performed internally */
 #define cds_lfs_pop_blocking		_cds_lfs_pop_blocking
+#define cds_lfs_pop_n_blocking		_cds_lfs_pop_n_blocking
+#define cds_lfs_pop_wait		_cds_lfs_pop_wait
 #define cds_lfs_pop_all_blocking	_cds_lfs_pop_all_blocking
 
 /* Synchronize pop with internal mutex */
@@ -110,6 +186,8 @@ typedef union {
 
 /* Synchronization ensured by the caller. See synchronization table. */
 #define __cds_lfs_pop			___cds_lfs_pop
+#define __cds_lfs_pop_n			___cds_lfs_pop_n
+#define __cds_lfs_pop_elim		___cds_lfs_pop_elim
 #define __cds_lfs_pop_all		___cds_lfs_pop_all
 
 #else /* !_LGPL_SOURCE */
@@ -155,6 +233,42 @@ extern bool cds_lfs_empty(cds_lfs_stack_ptr_t s);
 extern bool cds_lfs_push(cds_lfs_stack_ptr_t s,
 			struct cds_lfs_node *node);
 
+/*
+ * cds_lfs_push_wake: push a node into the stack, and wake up the
+ * threads waiting on @ec in cds_lfs_pop_wait().
+ *
+ * Only issues a wake up, and only a system call if a thread sleeps,
+ * when the stack was empty. Does not require any synchronization with
+ * other push nor pop.
+ *
+ * Returns 0 if the stack was empty prior to adding the node.
+ * Returns non-zero otherwise.
+ */
+extern bool cds_lfs_push_wake(cds_lfs_stack_ptr_t s,
+			struct cds_lfs_node *node,
+			struct cds_eventcount *ec);
+
+/*
+ * cds_lfs_elim_init: initialize an elimination array.
+ */
+extern void cds_lfs_elim_init(struct cds_lfs_elim *elim);
+
+/*
+ * cds_lfs_push_elim: push a node into the stack, or hand it over to a
+ * concurrent __cds_lfs_pop_elim through @elim when the stack head is
+ * contended.
+ *
+ * Does not require any synchronization with other push nor pop. A node
+ * offered in @elim is not seen by cds_lfs_empty nor by the other pop
+ * operations until it is pushed onto the stack.
+ *
+ * Returns 0 if the stack was empty prior to adding the node, non-zero
+ * otherwise, or when the node was taken by a pop through @elim.
+ */
+extern bool cds_lfs_push_elim(cds_lfs_stack_ptr_t s,
+			struct cds_lfs_elim *elim,
+			struct cds_lfs_node *node);
+
 /*
  * cds_lfs_pop_blocking: pop a node from the stack.
  *
@@ -162,6 +276,24 @@ extern bool cds_lfs_push(cds_lfs_stack_ptr_t s,
  */
 extern struct cds_lfs_node *cds_lfs_pop_blocking(struct cds_lfs_stack *s);
 
+/*
+ * cds_lfs_pop_n_blocking: pop up to @n nodes from the stack.
+ *
+ * Calls __cds_lfs_pop_n with an internal pop mutex held.
+ */
+extern unsigned long cds_lfs_pop_n_blocking(struct cds_lfs_stack *s,
+		struct cds_lfs_node **nodes, unsigned long n);
+
+/*
+ * cds_lfs_pop_wait: pop a node from the stack, sleeping on @ec while the
+ * stack is empty.
+ *
+ * Same as cds_lfs_pop_blocking, but never returns NULL. Pushers wake up
+ * the thread with cds_lfs_push_wake() on the same @ec.
+ */
+extern struct cds_lfs_node *cds_lfs_pop_wait(struct cds_lfs_stack *s,
+		struct cds_eventcount *ec);
+
 /*
  * cds_lfs_pop_all_blocking: pop all nodes from a stack.
  *
@@ -188,18 +320,47 @@ extern void cds_lfs_pop_unlock(struct cds_lfs_stack *s);
  * techniques:
  *
  * 1) Calling __cds_lfs_pop under rcu read lock critical section.
- *    Both __cds_lfs_pop and __cds_lfs_pop_all callers must wait for a
- *    grace period to pass before freeing the returned node or pushing
- *    the node back into the stack. It is valid to overwrite the content
- *    of cds_lfs_node immediately after __cds_lfs_pop and
- *    __cds_lfs_pop_all.
- * 2) Using mutual exclusion (e.g. mutexes) to protect __cds_lfs_pop
- *    and __cds_lfs_pop_all callers.
- * 3) Ensuring that only ONE thread can call __cds_lfs_pop() and
- *    __cds_lfs_pop_all(). (multi-provider/single-consumer scheme).
+ *    __cds_lfs_pop, __cds_lfs_pop_n and __cds_lfs_pop_all callers must
+ *    wait for a grace period to pass before freeing the returned node
+ *    or pushing the node back into the stack. It is valid to overwrite
+ *    the content of cds_lfs_node immediately after __cds_lfs_pop and
+ *    __cds_lfs_pop_all, unless __cds_lfs_pop_n is also used.
+ * 2) Using mutual exclusion (e.g. mutexes) to protect __cds_lfs_pop,
+ *    __cds_lfs_pop_n and __cds_lfs_pop_all callers.
+ * 3) Ensuring that only ONE thread can call __cds_lfs_pop(),
+ *    __cds_lfs_pop_n() and __cds_lfs_pop_all().
+ *    (multi-provider/single-consumer scheme).
  */
 extern struct cds_lfs_node *__cds_lfs_pop(cds_lfs_stack_ptr_t s);
 
+/*
+ * __cds_lfs_pop_n: pop up to @n nodes from the stack.
+ *
+ * Stores the popped nodes into @nodes, top of stack first, and returns
+ * their number, 0 if the stack is empty. A single successful cmpxchg
+ * pops all of them.
+ *
+ * __cds_lfs_pop_n walks the nodes below the head, which restricts
+ * its synchronization: either mutual exclusion against __cds_lfs_pop,
+ * __cds_lfs_pop_n and __cds_lfs_pop_all callers (techniques 2 and 3 of
+ * __cds_lfs_pop), or RCU read lock (technique 1) provided that no
+ * caller of the three overwrites the cds_lfs_node of returned nodes
+ * before a grace period has passed.
+ */
+extern unsigned long __cds_lfs_pop_n(cds_lfs_stack_ptr_t s,
+		struct cds_lfs_node **nodes, unsigned long n);
+
+/*
+ * __cds_lfs_pop_elim: pop a node from the stack, or take a node offered
+ * into @elim by a concurrent cds_lfs_push_elim when the stack head is
+ * contended.
+ *
+ * Returns NULL if stack is empty. Needs the same synchronization as
+ * __cds_lfs_pop. Nodes taken from @elim were never on the stack.
+ */
+extern struct cds_lfs_node *__cds_lfs_pop_elim(cds_lfs_stack_ptr_t s,
+		struct cds_lfs_elim *elim);
+
 /*
  * __cds_lfs_pop_all: pop all nodes from a stack.
  *
@@ -0,0 +1,239 @@
+#ifndef _URCU_LFSTACK_HPP
+#define _URCU_LFSTACK_HPP
+
+/*
+ * urcu/lfstack.hpp
+ *
+ * Userspace RCU library - C++ typed wrapper of the Lock-Free Stack
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE: the stack operations of
+ * urcu/static/lfstack.h are inlined in the caller.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Requires C++11.
+ */
+
+#ifndef __cplusplus
+#error "urcu/lfstack.hpp is a C++ header"
+#endif
+
+#include <cstddef>
+#include <iterator>
+
+#include <urcu/lfstack.h>
+#include <urcu/static/lfstack.h>
+#include <urcu/hook.hpp>
+
+namespace rcu {
+
+/*
+ * rcu::lfstack - LIFO of T, linked through their Hook member.
+ *
+ * The stack does not own its elements: push() links the element
+ * itself, without allocation, and the element must stay alive until
+ * popped. push() is lock-free and may be called concurrently with
+ * everything. pop() and pop_all() are mutually excluded by the stack
+ * mutex, which protects against ABA without RCU read-side lock.
+ */
+template <typename T, cds_lfs_node T::*Hook>
+class lfstack {
+public:
+	/*
+	 * rcu::lfstack::batch - elements taken from a stack at once, in
+	 * LIFO order.
+	 *
+	 * A batch is owned by a single thread: it can be traversed with a
+	 * range-for, popped from, or pushed back to a stack. The iterator
+	 * steps past an element before it is dereferenced, so elements may
+	 * be freed during the range-for. Batches are
+	 * move-constructible, not copyable.
+	 */
+	class batch {
+	public:
+		class iterator {
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef T value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef T *pointer;
+			typedef T &reference;
+
+			reference operator*() const
+			{
+				return *from_node(node_);
+			}
+
+			pointer operator->() const
+			{
+				return from_node(node_);
+			}
+
+			iterator &operator++()
+			{
+				node_ = next_;
+				next_ = node_ ? node_->next : NULL;
+				return *this;
+			}
+
+			bool operator==(const iterator &other) const
+			{
+				return node_ == other.node_;
+			}
+
+			bool operator!=(const iterator &other) const
+			{
+				return node_ != other.node_;
+			}
+
+		private:
+			friend class batch;
+
+			explicit iterator(struct cds_lfs_node *node)
+				: node_(node), next_(node ? node->next : NULL) {}
+
+			struct cds_lfs_node *node_, *next_;
+		};
+
+		batch() : first_(NULL) {}
+
+		batch(batch &&other) : first_(other.first_)
+		{
+			other.first_ = NULL;
+		}
+
+		batch(const batch &) = delete;
+		batch &operator=(const batch &) = delete;
+		batch &operator=(batch &&) = delete;
+
+		bool empty() const
+		{
+			return !first_;
+		}
+
+		/*
+		 * Return the most recently pushed element, removed from the
+		 * batch, or NULL if the batch is empty.
+		 */
+		T *pop()
+		{
+			struct cds_lfs_node *node = first_;
+
+			if (!node)
+				return NULL;
+			first_ = node->next;
+			return from_node(node);
+		}
+
+		iterator begin() const
+		{
+			return iterator(first_);
+		}
+
+		iterator end() const
+		{
+			return iterator(NULL);
+		}
+
+	private:
+		friend class lfstack;
+
+		explicit batch(struct cds_lfs_head *head)
+			: first_(head ? &head->node : NULL) {}
+
+		struct cds_lfs_node *first_;
+	};
+
+	lfstack()
+	{
+		_cds_lfs_init(&s_);
+	}
+
+	~lfstack()
+	{
+		_cds_lfs_destroy(&s_);
+	}
+
+	lfstack(const lfstack &) = delete;
+	lfstack &operator=(const lfstack &) = delete;
+
+	bool empty()
+	{
+		return _cds_lfs_empty(cds_lfs_stack_cast(&s_));
+	}
+
+	/*
+	 * Push @obj. Returns false if the stack was empty.
+	 */
+	bool push(T &obj)
+	{
+		struct cds_lfs_node *node = &(obj.*Hook);
+
+		_cds_lfs_node_init(node);
+		return _cds_lfs_push(cds_lfs_stack_cast(&s_), node);
+	}
+
+	/*
+	 * Push back the elements of @b, emptying it. The element on top of
+	 * @b ends up on top of the stack.
+	 */
+	void push(batch &&b)
+	{
+		struct cds_lfs_node *node, *prev = NULL, *next;
+
+		/* Reverse the batch, then push its elements one by one. */
+		for (node = b.first_; node; node = next) {
+			next = node->next;
+			node->next = prev;
+			prev = node;
+		}
+		b.first_ = NULL;
+		for (node = prev; node; node = next) {
+			next = node->next;
+			(void) _cds_lfs_push(cds_lfs_stack_cast(&s_), node);
+		}
+	}
+
+	/*
+	 * Pop the top element, or return NULL if the stack is empty.
+	 */
+	T *pop()
+	{
+		struct cds_lfs_node *node;
+
+		node = _cds_lfs_pop_blocking(&s_);
+		return node ? from_node(node) : NULL;
+	}
+
+	/*
+	 * Take all the elements of the stack at once.
+	 */
+	batch pop_all()
+	{
+		return batch(_cds_lfs_pop_all_blocking(&s_));
+	}
+
+private:
+	static T *from_node(struct cds_lfs_node *node)
+	{
+		return container_of<T, cds_lfs_node, Hook>(node);
+	}
+
+	struct cds_lfs_stack s_;
+};
+
+} /* namespace rcu */
+
+#endif /* _URCU_LFSTACK_HPP */
@@ -45,25 +45,60 @@
 #define rcu_init			rcu_init_bp
 #define rcu_exit			rcu_exit_bp
 #define synchronize_rcu			synchronize_rcu_bp
+#define get_state_synchronize_rcu	get_state_synchronize_rcu_bp
+#define start_poll_synchronize_rcu	start_poll_synchronize_rcu_bp
+#define poll_state_synchronize_rcu	poll_state_synchronize_rcu_bp
+#define cond_synchronize_rcu		cond_synchronize_rcu_bp
+#define rcu_gp_get_stats		rcu_gp_get_stats_bp
+#define rcu_stats_snapshot		rcu_stats_snapshot_bp
+#define rcu_stats_dump			rcu_stats_dump_bp
+#define rcu_stats_dump_periodic		rcu_stats_dump_periodic_bp
 #define rcu_reader			rcu_reader_bp
 #define rcu_gp				rcu_gp_bp
 
 #define get_cpu_call_rcu_data		get_cpu_call_rcu_data_bp
 #define get_call_rcu_thread		get_call_rcu_thread_bp
 #define create_call_rcu_data		create_call_rcu_data_bp
+#define create_call_rcu_data_delay	create_call_rcu_data_delay_bp
 #define set_cpu_call_rcu_data		set_cpu_call_rcu_data_bp
 #define get_default_call_rcu_data	get_default_call_rcu_data_bp
 #define get_call_rcu_data		get_call_rcu_data_bp
 #define get_thread_call_rcu_data	get_thread_call_rcu_data_bp
 #define set_thread_call_rcu_data	set_thread_call_rcu_data_bp
 #define create_all_cpu_call_rcu_data	create_all_cpu_call_rcu_data_bp
+#define create_all_node_call_rcu_data	create_all_node_call_rcu_data_bp
+#define create_lazy_cpu_call_rcu_data	create_lazy_cpu_call_rcu_data_bp
 #define free_all_cpu_call_rcu_data	free_all_cpu_call_rcu_data_bp
 #define call_rcu			call_rcu_bp
+#define call_rcu_expedited		call_rcu_expedited_bp
+#define call_rcu_lazy			call_rcu_lazy_bp
+#define call_rcu_batch			call_rcu_batch_bp
+#define call_rcu_local			call_rcu_local_bp
+#define call_rcu_flush			call_rcu_flush_bp
+#define synchronize_rcu_async		synchronize_rcu_async_bp
+#define synchronize_rcu_timeout		synchronize_rcu_timeout_bp
+#define rcu_async_poll			rcu_async_poll_bp
+#define call_rcu_tagged		call_rcu_tagged_bp
+#define free_rcu_bulk			free_rcu_bulk_bp
+#define free_rcu_bulk_flush		free_rcu_bulk_flush_bp
 #define call_rcu_data_free		call_rcu_data_free_bp
+#define call_rcu_data_set_lazy		call_rcu_data_set_lazy_bp
+#define call_rcu_data_set_watermarks	call_rcu_data_set_watermarks_bp
+#define call_rcu_data_get_stats	call_rcu_data_get_stats_bp
+#define call_rcu_data_set_helpers	call_rcu_data_set_helpers_bp
+#define call_rcu_data_set_placement	call_rcu_data_set_placement_bp
+#define call_rcu_data_get_fd		call_rcu_data_get_fd_bp
+#define call_rcu_process_ready		call_rcu_process_ready_bp
 #define call_rcu_before_fork		call_rcu_before_fork_bp
 #define call_rcu_after_fork_parent	call_rcu_after_fork_parent_bp
 #define call_rcu_after_fork_child	call_rcu_after_fork_child_bp
+#define set_call_rcu_fork_lazy		set_call_rcu_fork_lazy_bp
 #define rcu_barrier			rcu_barrier_bp
+#define rcu_barrier_crdp		rcu_barrier_crdp_bp
+#define rcu_barrier_tag		rcu_barrier_tag_bp
+#define rcu_barrier_async		rcu_barrier_async_bp
+#define rcu_barrier_poll		rcu_barrier_poll_bp
+#define rcu_barrier_wait		rcu_barrier_wait_bp
 
 #define defer_rcu			defer_rcu_bp
 #define rcu_defer_register_thread	rcu_defer_register_thread_bp
@@ -71,6 +106,9 @@
 #define rcu_defer_barrier		rcu_defer_barrier_bp
 #define rcu_defer_barrier_thread	rcu_defer_barrier_thread_bp
 #define rcu_defer_exit			rcu_defer_exit_bp
+#define rcu_defer_set_batch		rcu_defer_set_batch_bp
+#define rcu_defer_set_call_rcu		rcu_defer_set_call_rcu_bp
+#define rcu_defer_set_queue_size	rcu_defer_set_queue_size_bp
 
 #define rcu_flavor			rcu_flavor_bp
 
@@ -0,0 +1,117 @@
+#ifndef _URCU_EBR_MAP_H
+#define _URCU_EBR_MAP_H
+
+/*
+ * urcu-map.h
+ *
+ * Userspace RCU header -- name mapping to allow multiple flavors to be
+ * used in the same executable.
+ *
+ * Copyright (c) 2009 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ * Copyright (c) 2009 Paul E. McKenney, IBM Corporation.
+ *
+ * LGPL-compatible code should include this header with :
+ *
+ * #define _LGPL_SOURCE
+ * #include <urcu.h>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * IBM's contributions to this file may be relicensed under LGPLv2 or later.
+ */
+
+/* Mapping macros to allow multiple flavors in a single binary. */
+
+#define rcu_read_lock			rcu_read_lock_ebr
+#define _rcu_read_lock			_rcu_read_lock_ebr
+#define rcu_read_unlock			rcu_read_unlock_ebr
+#define _rcu_read_unlock		_rcu_read_unlock_ebr
+#define rcu_read_ongoing		rcu_read_ongoing_ebr
+#define _rcu_read_ongoing		_rcu_read_ongoing_ebr
+#define rcu_register_thread		rcu_register_thread_ebr
+#define rcu_unregister_thread		rcu_unregister_thread_ebr
+#define rcu_quiescent_state		rcu_quiescent_state_ebr
+#define rcu_init			rcu_init_ebr
+#define rcu_exit			rcu_exit_ebr
+#define synchronize_rcu			synchronize_rcu_ebr
+#define get_state_synchronize_rcu	get_state_synchronize_rcu_ebr
+#define start_poll_synchronize_rcu	start_poll_synchronize_rcu_ebr
+#define poll_state_synchronize_rcu	poll_state_synchronize_rcu_ebr
+#define cond_synchronize_rcu		cond_synchronize_rcu_ebr
+#define rcu_reader			rcu_reader_ebr
+#define rcu_gp				rcu_gp_ebr
+
+#define get_cpu_call_rcu_data		get_cpu_call_rcu_data_ebr
+#define get_call_rcu_thread		get_call_rcu_thread_ebr
+#define create_call_rcu_data		create_call_rcu_data_ebr
+#define create_call_rcu_data_delay	create_call_rcu_data_delay_ebr
+#define set_cpu_call_rcu_data		set_cpu_call_rcu_data_ebr
+#define get_default_call_rcu_data	get_default_call_rcu_data_ebr
+#define get_call_rcu_data		get_call_rcu_data_ebr
+#define get_thread_call_rcu_data	get_thread_call_rcu_data_ebr
+#define set_thread_call_rcu_data	set_thread_call_rcu_data_ebr
+#define create_all_cpu_call_rcu_data	create_all_cpu_call_rcu_data_ebr
+#define create_all_node_call_rcu_data	create_all_node_call_rcu_data_ebr
+#define create_lazy_cpu_call_rcu_data	create_lazy_cpu_call_rcu_data_ebr
+#define free_all_cpu_call_rcu_data	free_all_cpu_call_rcu_data_ebr
+#define call_rcu			call_rcu_ebr
+#define call_rcu_expedited		call_rcu_expedited_ebr
+#define call_rcu_lazy			call_rcu_lazy_ebr
+#define call_rcu_batch			call_rcu_batch_ebr
+#define call_rcu_local			call_rcu_local_ebr
+#define call_rcu_flush			call_rcu_flush_ebr
+#define synchronize_rcu_async		synchronize_rcu_async_ebr
+#define synchronize_rcu_timeout		synchronize_rcu_timeout_ebr
+#define rcu_async_poll			rcu_async_poll_ebr
+#define call_rcu_tagged		call_rcu_tagged_ebr
+#define free_rcu_bulk			free_rcu_bulk_ebr
+#define free_rcu_bulk_flush		free_rcu_bulk_flush_ebr
+#define call_rcu_data_free		call_rcu_data_free_ebr
+#define call_rcu_data_set_lazy		call_rcu_data_set_lazy_ebr
+#define call_rcu_data_set_watermarks	call_rcu_data_set_watermarks_ebr
+#define call_rcu_data_get_stats	call_rcu_data_get_stats_ebr
+#define call_rcu_data_set_helpers	call_rcu_data_set_helpers_ebr
+#define call_rcu_data_set_placement	call_rcu_data_set_placement_ebr
+#define call_rcu_data_get_fd		call_rcu_data_get_fd_ebr
+#define call_rcu_process_ready		call_rcu_process_ready_ebr
+#define call_rcu_before_fork		call_rcu_before_fork_ebr
+#define call_rcu_after_fork_parent	call_rcu_after_fork_parent_ebr
+#define call_rcu_after_fork_child	call_rcu_after_fork_child_ebr
+#define set_call_rcu_fork_lazy		set_call_rcu_fork_lazy_ebr
+#define rcu_barrier			rcu_barrier_ebr
+#define rcu_barrier_crdp		rcu_barrier_crdp_ebr
+#define rcu_barrier_tag		rcu_barrier_tag_ebr
+#define rcu_barrier_async		rcu_barrier_async_ebr
+#define rcu_barrier_poll		rcu_barrier_poll_ebr
+#define rcu_barrier_wait		rcu_barrier_wait_ebr
+
+#define defer_rcu			defer_rcu_ebr
+#define rcu_defer_register_thread	rcu_defer_register_thread_ebr
+#define rcu_defer_unregister_thread	rcu_defer_unregister_thread_ebr
+#define rcu_defer_barrier		rcu_defer_barrier_ebr
+#define rcu_defer_barrier_thread	rcu_defer_barrier_thread_ebr
+#define rcu_defer_exit			rcu_defer_exit_ebr
+#define rcu_defer_set_batch		rcu_defer_set_batch_ebr
+#define rcu_defer_set_call_rcu		rcu_defer_set_call_rcu_ebr
+#define rcu_defer_set_queue_size	rcu_defer_set_queue_size_ebr
+
+#define rcu_flavor			rcu_flavor_ebr
+
+#define urcu_register_rculfhash_atfork		\
+		urcu_register_rculfhash_atfork_ebr
+#define urcu_unregister_rculfhash_atfork	\
+		urcu_unregister_rculfhash_atfork_ebr
+
+#endif /* _URCU_EBR_MAP_H */
@@ -0,0 +1,123 @@
+#ifndef _URCU_PERCPU_MAP_H
+#define _URCU_PERCPU_MAP_H
+
+/*
+ * urcu-map.h
+ *
+ * Userspace RCU header -- name mapping to allow multiple flavors to be
+ * used in the same executable.
+ *
+ * Copyright (c) 2009 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ * Copyright (c) 2009 Paul E. McKenney, IBM Corporation.
+ *
+ * LGPL-compatible code should include this header with :
+ *
+ * #define _LGPL_SOURCE
+ * #include <urcu.h>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * IBM's contributions to this file may be relicensed under LGPLv2 or later.
+ */
+
+/* Mapping macros to allow multiple flavors in a single binary. */
+
+#define rcu_read_lock			rcu_read_lock_percpu
+#define _rcu_read_lock			_rcu_read_lock_percpu
+#define rcu_read_unlock			rcu_read_unlock_percpu
+#define _rcu_read_unlock		_rcu_read_unlock_percpu
+#define rcu_read_ongoing		rcu_read_ongoing_percpu
+#define _rcu_read_ongoing		_rcu_read_ongoing_percpu
+#define rcu_register_thread		rcu_register_thread_percpu
+#define rcu_unregister_thread		rcu_unregister_thread_percpu
+#define rcu_init			rcu_init_percpu
+#define rcu_exit			rcu_exit_percpu
+#define synchronize_rcu			synchronize_rcu_percpu
+#define get_state_synchronize_rcu	get_state_synchronize_rcu_percpu
+#define start_poll_synchronize_rcu	start_poll_synchronize_rcu_percpu
+#define poll_state_synchronize_rcu	poll_state_synchronize_rcu_percpu
+#define cond_synchronize_rcu		cond_synchronize_rcu_percpu
+#define rcu_gp_get_stats		rcu_gp_get_stats_percpu
+#define rcu_stats_snapshot		rcu_stats_snapshot_percpu
+#define rcu_stats_dump			rcu_stats_dump_percpu
+#define rcu_stats_dump_periodic		rcu_stats_dump_periodic_percpu
+#define rcu_reader			rcu_reader_percpu
+#define rcu_gp				rcu_gp_percpu
+
+#define get_cpu_call_rcu_data		get_cpu_call_rcu_data_percpu
+#define get_call_rcu_thread		get_call_rcu_thread_percpu
+#define create_call_rcu_data		create_call_rcu_data_percpu
+#define create_call_rcu_data_delay	create_call_rcu_data_delay_percpu
+#define set_cpu_call_rcu_data		set_cpu_call_rcu_data_percpu
+#define get_default_call_rcu_data	get_default_call_rcu_data_percpu
+#define get_call_rcu_data		get_call_rcu_data_percpu
+#define get_thread_call_rcu_data	get_thread_call_rcu_data_percpu
+#define set_thread_call_rcu_data	set_thread_call_rcu_data_percpu
+#define create_all_cpu_call_rcu_data	create_all_cpu_call_rcu_data_percpu
+#define create_all_node_call_rcu_data	create_all_node_call_rcu_data_percpu
+#define create_lazy_cpu_call_rcu_data	create_lazy_cpu_call_rcu_data_percpu
+#define free_all_cpu_call_rcu_data	free_all_cpu_call_rcu_data_percpu
+#define call_rcu			call_rcu_percpu
+#define call_rcu_expedited		call_rcu_expedited_percpu
+#define call_rcu_lazy			call_rcu_lazy_percpu
+#define call_rcu_batch			call_rcu_batch_percpu
+#define call_rcu_local			call_rcu_local_percpu
+#define call_rcu_flush			call_rcu_flush_percpu
+#define synchronize_rcu_async		synchronize_rcu_async_percpu
+#define synchronize_rcu_timeout		synchronize_rcu_timeout_percpu
+#define rcu_async_poll			rcu_async_poll_percpu
+#define call_rcu_tagged		call_rcu_tagged_percpu
+#define free_rcu_bulk			free_rcu_bulk_percpu
+#define free_rcu_bulk_flush		free_rcu_bulk_flush_percpu
+#define call_rcu_data_free		call_rcu_data_free_percpu
+#define call_rcu_data_set_lazy		call_rcu_data_set_lazy_percpu
+#define call_rcu_data_set_watermarks	call_rcu_data_set_watermarks_percpu
+#define call_rcu_data_get_stats	call_rcu_data_get_stats_percpu
+#define call_rcu_data_set_helpers	call_rcu_data_set_helpers_percpu
+#define call_rcu_data_set_placement	call_rcu_data_set_placement_percpu
+#define call_rcu_data_get_fd		call_rcu_data_get_fd_percpu
+#define call_rcu_process_ready		call_rcu_process_ready_percpu
+#define call_rcu_before_fork		call_rcu_before_fork_percpu
+#define call_rcu_after_fork_parent	call_rcu_after_fork_parent_percpu
+#define call_rcu_after_fork_child	call_rcu_after_fork_child_percpu
+#define set_call_rcu_fork_lazy		set_call_rcu_fork_lazy_percpu
+#define rcu_barrier			rcu_barrier_percpu
+#define rcu_barrier_crdp		rcu_barrier_crdp_percpu
+#define rcu_barrier_tag		rcu_barrier_tag_percpu
+#define rcu_barrier_async		rcu_barrier_async_percpu
+#define rcu_barrier_poll		rcu_barrier_poll_percpu
+#define rcu_barrier_wait		rcu_barrier_wait_percpu
+
+#define defer_rcu			defer_rcu_percpu
+#define rcu_defer_register_thread	rcu_defer_register_thread_percpu
+#define rcu_defer_unregister_thread	rcu_defer_unregister_thread_percpu
+#define rcu_defer_barrier		rcu_defer_barrier_percpu
+#define rcu_defer_barrier_thread	rcu_defer_barrier_thread_percpu
+#define rcu_defer_exit			rcu_defer_exit_percpu
+#define rcu_defer_set_batch		rcu_defer_set_batch_percpu
+#define rcu_defer_set_call_rcu		rcu_defer_set_call_rcu_percpu
+#define rcu_defer_set_queue_size	rcu_defer_set_queue_size_percpu
+
+#define rcu_flavor			rcu_flavor_percpu
+
+#define rcu_yield_active		rcu_yield_active_percpu
+#define rcu_rand_yield			rcu_rand_yield_percpu
+
+#define urcu_register_rculfhash_atfork		\
+		urcu_register_rculfhash_atfork_percpu
+#define urcu_unregister_rculfhash_atfork	\
+		urcu_unregister_rculfhash_atfork_percpu
+
+#endif /* _URCU_PERCPU_MAP_H */
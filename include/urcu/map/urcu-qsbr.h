@@ -42,30 +42,73 @@
 #define _rcu_read_ongoing		_rcu_read_ongoing_qsbr
 #define rcu_quiescent_state		rcu_quiescent_state_qsbr
 #define _rcu_quiescent_state		_rcu_quiescent_state_qsbr
+#define rcu_quiescent_state_every	rcu_quiescent_state_every_qsbr
+#define _rcu_quiescent_state_every	_rcu_quiescent_state_every_qsbr
+#define rcu_quiescent_state_timed	rcu_quiescent_state_timed_qsbr
+#define _rcu_quiescent_state_timed	_rcu_quiescent_state_timed_qsbr
 #define rcu_thread_offline		rcu_thread_offline_qsbr
 #define rcu_thread_online		rcu_thread_online_qsbr
 #define rcu_register_thread		rcu_register_thread_qsbr
 #define rcu_unregister_thread		rcu_unregister_thread_qsbr
 #define rcu_exit			rcu_exit_qsbr
 #define synchronize_rcu			synchronize_rcu_qsbr
+#define get_state_synchronize_rcu	get_state_synchronize_rcu_qsbr
+#define start_poll_synchronize_rcu	start_poll_synchronize_rcu_qsbr
+#define poll_state_synchronize_rcu	poll_state_synchronize_rcu_qsbr
+#define cond_synchronize_rcu		cond_synchronize_rcu_qsbr
+#define rcu_gp_get_stats		rcu_gp_get_stats_qsbr
+#define rcu_stats_snapshot		rcu_stats_snapshot_qsbr
+#define rcu_stats_dump			rcu_stats_dump_qsbr
+#define rcu_stats_dump_periodic		rcu_stats_dump_periodic_qsbr
+#define rcu_set_spin_budget		rcu_set_spin_budget_qsbr
+#define rcu_get_spin_budget		rcu_get_spin_budget_qsbr
+#define rcu_use_sys_membarrier		rcu_use_sys_membarrier_qsbr
+#define rcu_use_gp_tree			rcu_use_gp_tree_qsbr
 #define rcu_reader			rcu_reader_qsbr
 #define rcu_gp				rcu_gp_qsbr
 
 #define get_cpu_call_rcu_data		get_cpu_call_rcu_data_qsbr
 #define get_call_rcu_thread		get_call_rcu_thread_qsbr
 #define create_call_rcu_data		create_call_rcu_data_qsbr
+#define create_call_rcu_data_delay	create_call_rcu_data_delay_qsbr
 #define set_cpu_call_rcu_data		set_cpu_call_rcu_data_qsbr
 #define get_default_call_rcu_data	get_default_call_rcu_data_qsbr
 #define get_call_rcu_data		get_call_rcu_data_qsbr
 #define get_thread_call_rcu_data	get_thread_call_rcu_data_qsbr
 #define set_thread_call_rcu_data	set_thread_call_rcu_data_qsbr
 #define create_all_cpu_call_rcu_data	create_all_cpu_call_rcu_data_qsbr
+#define create_all_node_call_rcu_data	create_all_node_call_rcu_data_qsbr
+#define create_lazy_cpu_call_rcu_data	create_lazy_cpu_call_rcu_data_qsbr
 #define call_rcu			call_rcu_qsbr
+#define call_rcu_expedited		call_rcu_expedited_qsbr
+#define call_rcu_lazy			call_rcu_lazy_qsbr
+#define call_rcu_batch			call_rcu_batch_qsbr
+#define call_rcu_local			call_rcu_local_qsbr
+#define call_rcu_flush			call_rcu_flush_qsbr
+#define synchronize_rcu_async		synchronize_rcu_async_qsbr
+#define synchronize_rcu_timeout		synchronize_rcu_timeout_qsbr
+#define rcu_async_poll			rcu_async_poll_qsbr
+#define call_rcu_tagged		call_rcu_tagged_qsbr
+#define free_rcu_bulk			free_rcu_bulk_qsbr
+#define free_rcu_bulk_flush		free_rcu_bulk_flush_qsbr
 #define call_rcu_data_free		call_rcu_data_free_qsbr
+#define call_rcu_data_set_lazy		call_rcu_data_set_lazy_qsbr
+#define call_rcu_data_set_watermarks	call_rcu_data_set_watermarks_qsbr
+#define call_rcu_data_get_stats	call_rcu_data_get_stats_qsbr
+#define call_rcu_data_set_helpers	call_rcu_data_set_helpers_qsbr
+#define call_rcu_data_set_placement	call_rcu_data_set_placement_qsbr
+#define call_rcu_data_get_fd		call_rcu_data_get_fd_qsbr
+#define call_rcu_process_ready		call_rcu_process_ready_qsbr
 #define call_rcu_before_fork		call_rcu_before_fork_qsbr
 #define call_rcu_after_fork_parent	call_rcu_after_fork_parent_qsbr
 #define call_rcu_after_fork_child	call_rcu_after_fork_child_qsbr
+#define set_call_rcu_fork_lazy		set_call_rcu_fork_lazy_qsbr
 #define rcu_barrier			rcu_barrier_qsbr
+#define rcu_barrier_crdp		rcu_barrier_crdp_qsbr
+#define rcu_barrier_tag		rcu_barrier_tag_qsbr
+#define rcu_barrier_async		rcu_barrier_async_qsbr
+#define rcu_barrier_poll		rcu_barrier_poll_qsbr
+#define rcu_barrier_wait		rcu_barrier_wait_qsbr
 
 #define defer_rcu			defer_rcu_qsbr
 #define rcu_defer_register_thread	rcu_defer_register_thread_qsbr
@@ -73,6 +116,9 @@
 #define	rcu_defer_barrier		rcu_defer_barrier_qsbr
 #define rcu_defer_barrier_thread	rcu_defer_barrier_thread_qsbr
 #define rcu_defer_exit			rcu_defer_exit_qsbr
+#define rcu_defer_set_batch		rcu_defer_set_batch_qsbr
+#define rcu_defer_set_call_rcu		rcu_defer_set_call_rcu_qsbr
+#define rcu_defer_set_queue_size	rcu_defer_set_queue_size_qsbr
 
 #define rcu_flavor			rcu_flavor_qsbr
 
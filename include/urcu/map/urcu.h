@@ -51,25 +51,77 @@
 #define rcu_init			rcu_init_memb
 #define rcu_exit			rcu_exit_memb
 #define synchronize_rcu			synchronize_rcu_memb
+#define synchronize_rcu_expedited	synchronize_rcu_expedited_memb
+#define get_state_synchronize_rcu	get_state_synchronize_rcu_memb
+#define start_poll_synchronize_rcu	start_poll_synchronize_rcu_memb
+#define poll_state_synchronize_rcu	poll_state_synchronize_rcu_memb
+#define cond_synchronize_rcu		cond_synchronize_rcu_memb
+#define rcu_gp_get_stats		rcu_gp_get_stats_memb
+#define rcu_stats_snapshot		rcu_stats_snapshot_memb
+#define rcu_stats_dump			rcu_stats_dump_memb
+#define rcu_stats_dump_periodic		rcu_stats_dump_periodic_memb
+#define rcu_get_membarrier_mode		rcu_get_membarrier_mode_memb
+#define rcu_set_spin_budget		rcu_set_spin_budget_memb
+#define rcu_get_spin_budget		rcu_get_spin_budget_memb
+#define rcu_domain_create		rcu_domain_create_memb
+#define rcu_domain_destroy		rcu_domain_destroy_memb
+#define rcu_domain_register_thread	rcu_domain_register_thread_memb
+#define rcu_domain_unregister_thread	rcu_domain_unregister_thread_memb
+#define rcu_domain_read_lock		rcu_domain_read_lock_memb
+#define _rcu_domain_read_lock		_rcu_domain_read_lock_memb
+#define rcu_domain_read_unlock		rcu_domain_read_unlock_memb
+#define _rcu_domain_read_unlock		_rcu_domain_read_unlock_memb
+#define rcu_domain_read_ongoing		rcu_domain_read_ongoing_memb
+#define _rcu_domain_read_ongoing	_rcu_domain_read_ongoing_memb
+#define synchronize_rcu_domain		synchronize_rcu_domain_memb
+#define call_rcu_domain			call_rcu_domain_memb
+#define rcu_barrier_domain		rcu_barrier_domain_memb
 #define rcu_reader			rcu_reader_memb
 #define rcu_gp				rcu_gp_memb
 
 #define get_cpu_call_rcu_data		get_cpu_call_rcu_data_memb
 #define get_call_rcu_thread		get_call_rcu_thread_memb
 #define create_call_rcu_data		create_call_rcu_data_memb
+#define create_call_rcu_data_delay	create_call_rcu_data_delay_memb
 #define set_cpu_call_rcu_data		set_cpu_call_rcu_data_memb
 #define get_default_call_rcu_data	get_default_call_rcu_data_memb
 #define get_call_rcu_data		get_call_rcu_data_memb
 #define get_thread_call_rcu_data	get_thread_call_rcu_data_memb
 #define set_thread_call_rcu_data	set_thread_call_rcu_data_memb
 #define create_all_cpu_call_rcu_data	create_all_cpu_call_rcu_data_memb
+#define create_all_node_call_rcu_data	create_all_node_call_rcu_data_memb
+#define create_lazy_cpu_call_rcu_data	create_lazy_cpu_call_rcu_data_memb
 #define free_all_cpu_call_rcu_data	free_all_cpu_call_rcu_data_memb
 #define call_rcu			call_rcu_memb
+#define call_rcu_expedited		call_rcu_expedited_memb
+#define call_rcu_lazy			call_rcu_lazy_memb
+#define call_rcu_batch			call_rcu_batch_memb
+#define call_rcu_local			call_rcu_local_memb
+#define call_rcu_flush			call_rcu_flush_memb
+#define synchronize_rcu_async		synchronize_rcu_async_memb
+#define synchronize_rcu_timeout		synchronize_rcu_timeout_memb
+#define rcu_async_poll			rcu_async_poll_memb
+#define call_rcu_tagged		call_rcu_tagged_memb
+#define free_rcu_bulk			free_rcu_bulk_memb
+#define free_rcu_bulk_flush		free_rcu_bulk_flush_memb
 #define call_rcu_data_free		call_rcu_data_free_memb
+#define call_rcu_data_set_lazy		call_rcu_data_set_lazy_memb
+#define call_rcu_data_set_watermarks	call_rcu_data_set_watermarks_memb
+#define call_rcu_data_get_stats	call_rcu_data_get_stats_memb
+#define call_rcu_data_set_helpers	call_rcu_data_set_helpers_memb
+#define call_rcu_data_set_placement	call_rcu_data_set_placement_memb
+#define call_rcu_data_get_fd		call_rcu_data_get_fd_memb
+#define call_rcu_process_ready		call_rcu_process_ready_memb
 #define call_rcu_before_fork		call_rcu_before_fork_memb
 #define call_rcu_after_fork_parent	call_rcu_after_fork_parent_memb
 #define call_rcu_after_fork_child	call_rcu_after_fork_child_memb
+#define set_call_rcu_fork_lazy		set_call_rcu_fork_lazy_memb
 #define rcu_barrier			rcu_barrier_memb
+#define rcu_barrier_crdp		rcu_barrier_crdp_memb
+#define rcu_barrier_tag		rcu_barrier_tag_memb
+#define rcu_barrier_async		rcu_barrier_async_memb
+#define rcu_barrier_poll		rcu_barrier_poll_memb
+#define rcu_barrier_wait		rcu_barrier_wait_memb
 
 #define defer_rcu			defer_rcu_memb
 #define rcu_defer_register_thread	rcu_defer_register_thread_memb
@@ -77,6 +129,9 @@
 #define rcu_defer_barrier		rcu_defer_barrier_memb
 #define rcu_defer_barrier_thread	rcu_defer_barrier_thread_memb
 #define rcu_defer_exit			rcu_defer_exit_memb
+#define rcu_defer_set_batch		rcu_defer_set_batch_memb
+#define rcu_defer_set_call_rcu		rcu_defer_set_call_rcu_memb
+#define rcu_defer_set_queue_size	rcu_defer_set_queue_size_memb
 
 #define rcu_flavor			rcu_flavor_memb
 
@@ -98,25 +153,77 @@
 #define rcu_init			rcu_init_sig
 #define rcu_exit			rcu_exit_sig
 #define synchronize_rcu			synchronize_rcu_sig
+#define synchronize_rcu_expedited	synchronize_rcu_expedited_sig
+#define get_state_synchronize_rcu	get_state_synchronize_rcu_sig
+#define start_poll_synchronize_rcu	start_poll_synchronize_rcu_sig
+#define poll_state_synchronize_rcu	poll_state_synchronize_rcu_sig
+#define cond_synchronize_rcu		cond_synchronize_rcu_sig
+#define rcu_gp_get_stats		rcu_gp_get_stats_sig
+#define rcu_stats_snapshot		rcu_stats_snapshot_sig
+#define rcu_stats_dump			rcu_stats_dump_sig
+#define rcu_stats_dump_periodic		rcu_stats_dump_periodic_sig
+#define rcu_get_membarrier_mode		rcu_get_membarrier_mode_sig
+#define rcu_set_spin_budget		rcu_set_spin_budget_sig
+#define rcu_get_spin_budget		rcu_get_spin_budget_sig
+#define rcu_domain_create		rcu_domain_create_sig
+#define rcu_domain_destroy		rcu_domain_destroy_sig
+#define rcu_domain_register_thread	rcu_domain_register_thread_sig
+#define rcu_domain_unregister_thread	rcu_domain_unregister_thread_sig
+#define rcu_domain_read_lock		rcu_domain_read_lock_sig
+#define _rcu_domain_read_lock		_rcu_domain_read_lock_sig
+#define rcu_domain_read_unlock		rcu_domain_read_unlock_sig
+#define _rcu_domain_read_unlock		_rcu_domain_read_unlock_sig
+#define rcu_domain_read_ongoing		rcu_domain_read_ongoing_sig
+#define _rcu_domain_read_ongoing	_rcu_domain_read_ongoing_sig
+#define synchronize_rcu_domain		synchronize_rcu_domain_sig
+#define call_rcu_domain			call_rcu_domain_sig
+#define rcu_barrier_domain		rcu_barrier_domain_sig
 #define rcu_reader			rcu_reader_sig
 #define rcu_gp				rcu_gp_sig
 
 #define get_cpu_call_rcu_data		get_cpu_call_rcu_data_sig
 #define get_call_rcu_thread		get_call_rcu_thread_sig
 #define create_call_rcu_data		create_call_rcu_data_sig
+#define create_call_rcu_data_delay	create_call_rcu_data_delay_sig
 #define set_cpu_call_rcu_data		set_cpu_call_rcu_data_sig
 #define get_default_call_rcu_data	get_default_call_rcu_data_sig
 #define get_call_rcu_data		get_call_rcu_data_sig
 #define get_thread_call_rcu_data	get_thread_call_rcu_data_sig
 #define set_thread_call_rcu_data	set_thread_call_rcu_data_sig
 #define create_all_cpu_call_rcu_data	create_all_cpu_call_rcu_data_sig
+#define create_all_node_call_rcu_data	create_all_node_call_rcu_data_sig
+#define create_lazy_cpu_call_rcu_data	create_lazy_cpu_call_rcu_data_sig
 #define free_all_cpu_call_rcu_data	free_all_cpu_call_rcu_data_sig
 #define call_rcu			call_rcu_sig
+#define call_rcu_expedited		call_rcu_expedited_sig
+#define call_rcu_lazy			call_rcu_lazy_sig
+#define call_rcu_batch			call_rcu_batch_sig
+#define call_rcu_local			call_rcu_local_sig
+#define call_rcu_flush			call_rcu_flush_sig
+#define synchronize_rcu_async		synchronize_rcu_async_sig
+#define synchronize_rcu_timeout		synchronize_rcu_timeout_sig
+#define rcu_async_poll			rcu_async_poll_sig
+#define call_rcu_tagged		call_rcu_tagged_sig
+#define free_rcu_bulk			free_rcu_bulk_sig
+#define free_rcu_bulk_flush		free_rcu_bulk_flush_sig
 #define call_rcu_data_free		call_rcu_data_free_sig
+#define call_rcu_data_set_lazy		call_rcu_data_set_lazy_sig
+#define call_rcu_data_set_watermarks	call_rcu_data_set_watermarks_sig
+#define call_rcu_data_get_stats	call_rcu_data_get_stats_sig
+#define call_rcu_data_set_helpers	call_rcu_data_set_helpers_sig
+#define call_rcu_data_set_placement	call_rcu_data_set_placement_sig
+#define call_rcu_data_get_fd		call_rcu_data_get_fd_sig
+#define call_rcu_process_ready		call_rcu_process_ready_sig
 #define call_rcu_before_fork		call_rcu_before_fork_sig
 #define call_rcu_after_fork_parent	call_rcu_after_fork_parent_sig
 #define call_rcu_after_fork_child	call_rcu_after_fork_child_sig
+#define set_call_rcu_fork_lazy		set_call_rcu_fork_lazy_sig
 #define rcu_barrier			rcu_barrier_sig
+#define rcu_barrier_crdp		rcu_barrier_crdp_sig
+#define rcu_barrier_tag		rcu_barrier_tag_sig
+#define rcu_barrier_async		rcu_barrier_async_sig
+#define rcu_barrier_poll		rcu_barrier_poll_sig
+#define rcu_barrier_wait		rcu_barrier_wait_sig
 
 #define defer_rcu			defer_rcu_sig
 #define rcu_defer_register_thread	rcu_defer_register_thread_sig
@@ -124,6 +231,9 @@
 #define rcu_defer_barrier		rcu_defer_barrier_sig
 #define rcu_defer_barrier_thread	rcu_defer_barrier_thread_sig
 #define rcu_defer_exit			rcu_defer_exit_sig
+#define rcu_defer_set_batch		rcu_defer_set_batch_sig
+#define rcu_defer_set_call_rcu		rcu_defer_set_call_rcu_sig
+#define rcu_defer_set_queue_size	rcu_defer_set_queue_size_sig
 
 #define rcu_flavor			rcu_flavor_sig
 
@@ -145,25 +255,77 @@
 #define rcu_init			rcu_init_mb
 #define rcu_exit			rcu_exit_mb
 #define synchronize_rcu			synchronize_rcu_mb
+#define synchronize_rcu_expedited	synchronize_rcu_expedited_mb
+#define get_state_synchronize_rcu	get_state_synchronize_rcu_mb
+#define start_poll_synchronize_rcu	start_poll_synchronize_rcu_mb
+#define poll_state_synchronize_rcu	poll_state_synchronize_rcu_mb
+#define cond_synchronize_rcu		cond_synchronize_rcu_mb
+#define rcu_gp_get_stats		rcu_gp_get_stats_mb
+#define rcu_stats_snapshot		rcu_stats_snapshot_mb
+#define rcu_stats_dump			rcu_stats_dump_mb
+#define rcu_stats_dump_periodic		rcu_stats_dump_periodic_mb
+#define rcu_get_membarrier_mode		rcu_get_membarrier_mode_mb
+#define rcu_set_spin_budget		rcu_set_spin_budget_mb
+#define rcu_get_spin_budget		rcu_get_spin_budget_mb
+#define rcu_domain_create		rcu_domain_create_mb
+#define rcu_domain_destroy		rcu_domain_destroy_mb
+#define rcu_domain_register_thread	rcu_domain_register_thread_mb
+#define rcu_domain_unregister_thread	rcu_domain_unregister_thread_mb
+#define rcu_domain_read_lock		rcu_domain_read_lock_mb
+#define _rcu_domain_read_lock		_rcu_domain_read_lock_mb
+#define rcu_domain_read_unlock		rcu_domain_read_unlock_mb
+#define _rcu_domain_read_unlock		_rcu_domain_read_unlock_mb
+#define rcu_domain_read_ongoing		rcu_domain_read_ongoing_mb
+#define _rcu_domain_read_ongoing	_rcu_domain_read_ongoing_mb
+#define synchronize_rcu_domain		synchronize_rcu_domain_mb
+#define call_rcu_domain			call_rcu_domain_mb
+#define rcu_barrier_domain		rcu_barrier_domain_mb
 #define rcu_reader			rcu_reader_mb
 #define rcu_gp				rcu_gp_mb
 
 #define get_cpu_call_rcu_data		get_cpu_call_rcu_data_mb
 #define get_call_rcu_thread		get_call_rcu_thread_mb
 #define create_call_rcu_data		create_call_rcu_data_mb
+#define create_call_rcu_data_delay	create_call_rcu_data_delay_mb
 #define set_cpu_call_rcu_data		set_cpu_call_rcu_data_mb
 #define get_default_call_rcu_data	get_default_call_rcu_data_mb
 #define get_call_rcu_data		get_call_rcu_data_mb
 #define get_thread_call_rcu_data	get_thread_call_rcu_data_mb
 #define set_thread_call_rcu_data	set_thread_call_rcu_data_mb
 #define create_all_cpu_call_rcu_data	create_all_cpu_call_rcu_data_mb
+#define create_all_node_call_rcu_data	create_all_node_call_rcu_data_mb
+#define create_lazy_cpu_call_rcu_data	create_lazy_cpu_call_rcu_data_mb
 #define free_all_cpu_call_rcu_data	free_all_cpu_call_rcu_data_mb
 #define call_rcu			call_rcu_mb
+#define call_rcu_expedited		call_rcu_expedited_mb
+#define call_rcu_lazy			call_rcu_lazy_mb
+#define call_rcu_batch			call_rcu_batch_mb
+#define call_rcu_local			call_rcu_local_mb
+#define call_rcu_flush			call_rcu_flush_mb
+#define synchronize_rcu_async		synchronize_rcu_async_mb
+#define synchronize_rcu_timeout		synchronize_rcu_timeout_mb
+#define rcu_async_poll			rcu_async_poll_mb
+#define call_rcu_tagged		call_rcu_tagged_mb
+#define free_rcu_bulk			free_rcu_bulk_mb
+#define free_rcu_bulk_flush		free_rcu_bulk_flush_mb
 #define call_rcu_data_free		call_rcu_data_free_mb
+#define call_rcu_data_set_lazy		call_rcu_data_set_lazy_mb
+#define call_rcu_data_set_watermarks	call_rcu_data_set_watermarks_mb
+#define call_rcu_data_get_stats	call_rcu_data_get_stats_mb
+#define call_rcu_data_set_helpers	call_rcu_data_set_helpers_mb
+#define call_rcu_data_set_placement	call_rcu_data_set_placement_mb
+#define call_rcu_data_get_fd		call_rcu_data_get_fd_mb
+#define call_rcu_process_ready		call_rcu_process_ready_mb
 #define call_rcu_before_fork		call_rcu_before_fork_mb
 #define call_rcu_after_fork_parent	call_rcu_after_fork_parent_mb
 #define call_rcu_after_fork_child	call_rcu_after_fork_child_mb
+#define set_call_rcu_fork_lazy		set_call_rcu_fork_lazy_mb
 #define rcu_barrier			rcu_barrier_mb
+#define rcu_barrier_crdp		rcu_barrier_crdp_mb
+#define rcu_barrier_tag		rcu_barrier_tag_mb
+#define rcu_barrier_async		rcu_barrier_async_mb
+#define rcu_barrier_poll		rcu_barrier_poll_mb
+#define rcu_barrier_wait		rcu_barrier_wait_mb
 
 #define defer_rcu			defer_rcu_mb
 #define rcu_defer_register_thread	rcu_defer_register_thread_mb
@@ -171,6 +333,9 @@
 #define rcu_defer_barrier		rcu_defer_barrier_mb
 #define rcu_defer_barrier_thread	rcu_defer_barrier_thread_mb
 #define rcu_defer_exit			rcu_defer_exit_mb
+#define rcu_defer_set_batch		rcu_defer_set_batch_mb
+#define rcu_defer_set_call_rcu		rcu_defer_set_call_rcu_mb
+#define rcu_defer_set_queue_size	rcu_defer_set_queue_size_mb
 
 #define rcu_flavor			rcu_flavor_mb
 
@@ -0,0 +1,108 @@
+#ifndef _URCU_PERCPU_COUNTER_H
+#define _URCU_PERCPU_COUNTER_H
+
+/*
+ * urcu/percpu-counter.h
+ *
+ * Userspace RCU library - Per-CPU split counters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default folding threshold of the per-CPU slots. */
+#define CDS_PERCPU_COUNTER_BATCH	32
+
+struct cds_percpu_counter_cpu;
+
+/*
+ * A struct cds_percpu_counter is a statistics counter updated in
+ * per-CPU slots, each on its own cache line, so that updates from
+ * distinct CPUs do not share cache lines. A slot is folded into the
+ * shared count once its magnitude reaches the batch, so the shared
+ * count is within nr_cpus * batch of the exact value.
+ *
+ * Updates and reads need no registration and no RCU read-side lock.
+ * They do not order other memory accesses.
+ */
+struct cds_percpu_counter {
+	long count;			/* Folded count */
+	long batch;
+	unsigned int nr_cpus;
+	struct cds_percpu_counter_cpu *cpus;
+};
+
+/*
+ * cds_percpu_counter_init - initialize a per-CPU counter.
+ * @counter: the counter to initialize.
+ * @value: the initial value.
+ * @batch: the magnitude at which a per-CPU slot is folded into the
+ *         shared count, 0 for CDS_PERCPU_COUNTER_BATCH.
+ *
+ * Returns 0 on success, -ENOMEM if the per-CPU slots cannot be
+ * allocated.
+ */
+extern int cds_percpu_counter_init(struct cds_percpu_counter *counter,
+		long value, long batch);
+
+/*
+ * cds_percpu_counter_destroy - free the per-CPU slots of a counter.
+ */
+extern void cds_percpu_counter_destroy(struct cds_percpu_counter *counter);
+
+/*
+ * cds_percpu_counter_add - add @v to the counter.
+ *
+ * Only updates the slot of the current CPU, unless its magnitude
+ * reaches the batch.
+ */
+extern void cds_percpu_counter_add(struct cds_percpu_counter *counter,
+		long v);
+
+static inline void cds_percpu_counter_inc(struct cds_percpu_counter *counter)
+{
+	cds_percpu_counter_add(counter, 1);
+}
+
+static inline void cds_percpu_counter_dec(struct cds_percpu_counter *counter)
+{
+	cds_percpu_counter_add(counter, -1);
+}
+
+/*
+ * cds_percpu_counter_read - approximate value of the counter.
+ *
+ * Returns the folded count, within nr_cpus * batch of the exact value:
+ * constant time, without touching the per-CPU slots.
+ */
+extern long cds_percpu_counter_read(struct cds_percpu_counter *counter);
+
+/*
+ * cds_percpu_counter_sum - exact value of the counter.
+ *
+ * Returns the folded count plus the sum of the per-CPU slots: exact in
+ * the absence of concurrent updates. Slots folded during the sum may
+ * be missed or counted twice.
+ */
+extern long cds_percpu_counter_sum(struct cds_percpu_counter *counter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_PERCPU_COUNTER_H */
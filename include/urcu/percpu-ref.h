@@ -0,0 +1,171 @@
+#ifndef _URCU_PERCPU_REF_H
+#define _URCU_PERCPU_REF_H
+
+/*
+ * urcu/percpu-ref.h
+ *
+ * Userspace RCU library - Per-CPU reference counting
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor.
+ */
+
+#include <stdbool.h>
+#include <urcu/compiler.h>
+#include <urcu/ref.h>
+#include <urcu-call-rcu.h>
+#include <urcu-flavor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A struct urcu_percpu_ref counts the references to an object in
+ * per-CPU counters while the object is live, so that getting and
+ * putting references from many CPUs does not bounce a shared cache
+ * line. The per-CPU counters cannot tell when the count reaches zero:
+ * urcu_percpu_ref_kill() drops the initial reference and switches the
+ * counter to a shared struct urcu_ref, after a grace period of the RCU
+ * flavor ensuring that no CPU still updates its per-CPU counter. The
+ * release function is called once the count reaches zero in shared
+ * mode.
+ *
+ * References are taken and put within RCU read-side critical sections
+ * of the flavor, which need not enclose the whole lifetime of the
+ * reference: a reference taken in per-CPU mode may be put after the
+ * switch, and conversely.
+ */
+struct urcu_percpu_ref {
+	unsigned long percpu_ptr;	/* Per-CPU counters | DEAD flag */
+	struct urcu_ref count;		/* Shared mode count, biased. */
+	unsigned int nr_cpus;
+	void (*release)(struct urcu_percpu_ref *ref);
+	const struct rcu_flavor_struct *flavor;
+	struct rcu_head head;
+};
+
+/*
+ * Caution !
+ * Ensure threads getting and putting references are registered as urcu
+ * readers.
+ */
+
+/*
+ * _urcu_percpu_ref_init - API used by urcu_percpu_ref_init wrapper. Do
+ * not use directly.
+ */
+extern
+int _urcu_percpu_ref_init(struct urcu_percpu_ref *ref,
+		void (*release)(struct urcu_percpu_ref *ref),
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * urcu_percpu_ref_init - initialize a per-CPU reference counter.
+ * @ref: the reference counter to initialize.
+ * @release: called when the count reaches zero after
+ *           urcu_percpu_ref_kill(), possibly from a call_rcu worker
+ *           thread.
+ *
+ * The counter starts in per-CPU mode, holding one initial reference
+ * dropped by urcu_percpu_ref_kill().
+ * Return 0 on success, -ENOMEM if the per-CPU counters cannot be
+ * allocated.
+ * Note: the RCU flavor must be already included before the per-CPU
+ * reference counter header.
+ */
+static inline
+int urcu_percpu_ref_init(struct urcu_percpu_ref *ref,
+		void (*release)(struct urcu_percpu_ref *ref))
+{
+	return _urcu_percpu_ref_init(ref, release, &rcu_flavor);
+}
+
+/*
+ * urcu_percpu_ref_exit - free the per-CPU counters.
+ *
+ * To call before freeing a counter never killed, or from the release
+ * function. The counter must not be used anymore.
+ */
+extern
+void urcu_percpu_ref_exit(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_get - get a reference.
+ *
+ * The caller must already hold a reference, or the counter must not be
+ * killed yet.
+ * Call with rcu_read_lock held.
+ */
+extern
+void urcu_percpu_ref_get(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_tryget - get a reference unless the count is zero.
+ *
+ * Return true if the reference is taken. The counter memory must be
+ * kept alive by other means, e.g. RCU, for a reference to be tried
+ * after the count may have reached zero.
+ * Call with rcu_read_lock held.
+ */
+extern
+bool urcu_percpu_ref_tryget(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_tryget_live - get a reference unless killed.
+ *
+ * Return true if the reference is taken, false if the counter has been
+ * killed, even while references remain.
+ * Call with rcu_read_lock held.
+ */
+extern
+bool urcu_percpu_ref_tryget_live(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_put - put a reference.
+ *
+ * Calls the release function if this was the last reference of a
+ * killed counter.
+ * Call with rcu_read_lock held.
+ */
+extern
+void urcu_percpu_ref_put(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_kill - drop the initial reference.
+ *
+ * Switches the counter to shared mode after a grace period, queued
+ * with the call_rcu of the flavor, then calls the release function if
+ * no reference remains. urcu_percpu_ref_tryget_live() fails from now
+ * on. Must be called once.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void urcu_percpu_ref_kill(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_is_dying - query whether the counter is killed.
+ *
+ * This function does not issue any memory barrier.
+ */
+extern
+bool urcu_percpu_ref_is_dying(struct urcu_percpu_ref *ref);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_PERCPU_REF_H */
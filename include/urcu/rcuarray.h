@@ -0,0 +1,134 @@
+#ifndef _URCU_RCUARRAY_H
+#define _URCU_RCUARRAY_H
+
+/*
+ * urcu/rcuarray.h
+ *
+ * Userspace RCU library - RCU Resizable Array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu-call-rcu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Array of pointers indexed by small dense integers, e.g. identifiers,
+ * growing as entries are set beyond its end.
+ *
+ * Readers index the array with a single rcu_dereference() of its block
+ * of entries, and a load of the entry: reads are wait-free. Updaters
+ * are serialized by a mutex. Growing the array copies the entries into
+ * a block of twice the capacity, published with rcu_assign_pointer(),
+ * and the previous block is freed after a grace period with the
+ * call_rcu passed at init, so that the array can be used with any
+ * flavor.
+ *
+ * Entries which were never set, or were set to NULL, read as NULL.
+ * Readers of an entry replaced or cleared may still see the previous
+ * pointer until a grace period elapses, as with rcu_assign_pointer().
+ */
+
+struct cds_rcu_array_block {
+	unsigned long capacity;		/* Entries of the block. */
+	struct rcu_head head;
+	void *slots[];
+};
+
+struct cds_rcu_array {
+	struct cds_rcu_array_block *block;	/* NULL until first set. */
+	unsigned long len;		/* One past the last entry set. */
+	pthread_mutex_t lock;		/* Serializes updates. */
+	void (*array_call_rcu)(struct rcu_head *head,
+		void (*func)(struct rcu_head *head));
+};
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/rcuarray.h>
+
+#define cds_rcu_array_init		_cds_rcu_array_init
+#define cds_rcu_array_destroy		_cds_rcu_array_destroy
+#define cds_rcu_array_get		_cds_rcu_array_get
+#define cds_rcu_array_len		_cds_rcu_array_len
+#define cds_rcu_array_set		_cds_rcu_array_set
+#define cds_rcu_array_append		_cds_rcu_array_append
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * cds_rcu_array_init: initialize an empty array. Entries are allocated
+ * as they are set.
+ */
+extern void cds_rcu_array_init(struct cds_rcu_array *array,
+		void (*array_call_rcu)(struct rcu_head *head,
+			void (*func)(struct rcu_head *head)));
+
+/*
+ * cds_rcu_array_destroy: free the memory of an array. The objects its
+ * entries point to are not freed: the caller releases them beforehand.
+ * No thread may be using the array anymore. Previous blocks waiting for
+ * a grace period are freed by their callbacks.
+ */
+extern void cds_rcu_array_destroy(struct cds_rcu_array *array);
+
+/*
+ * cds_rcu_array_get: get entry @index, NULL if not set.
+ *
+ * Call with rcu_read_lock held. Acts as a rcu_dereference() of the
+ * entry.
+ */
+extern void *cds_rcu_array_get(struct cds_rcu_array *array,
+		unsigned long index);
+
+/*
+ * cds_rcu_array_len: one past the highest index set so far. Entries
+ * below it may be NULL.
+ */
+extern unsigned long cds_rcu_array_len(struct cds_rcu_array *array);
+
+/*
+ * cds_rcu_array_set: set entry @index to @ptr, growing the array if
+ * needed. If @old is not NULL, it receives the previous entry, to be
+ * freed by the caller after a grace period.
+ *
+ * Returns 0, or -ENOMEM. Acts as a rcu_assign_pointer() of the entry.
+ * Does not require the RCU read-side lock.
+ */
+extern int cds_rcu_array_set(struct cds_rcu_array *array,
+		unsigned long index, void *ptr, void **old);
+
+/*
+ * cds_rcu_array_append: set entry cds_rcu_array_len() to @ptr, and
+ * return its index in @index.
+ *
+ * Returns 0, or -ENOMEM. Acts as a rcu_assign_pointer() of the entry.
+ * Does not require the RCU read-side lock.
+ */
+extern int cds_rcu_array_append(struct cds_rcu_array *array, void *ptr,
+		unsigned long *index);
+
+#endif /* !_LGPL_SOURCE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUARRAY_H */
@@ -0,0 +1,175 @@
+#ifndef _URCU_RCUCACHE_H
+#define _URCU_RCUCACHE_H
+
+/*
+ * urcu/rcucache.h
+ *
+ * Userspace RCU library - RCU CLOCK cache over a lock-free hash table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor.
+ */
+
+#include <urcu/compiler.h>
+#include <urcu/list.h>
+#include <urcu/rculfhash.h>
+#include <urcu-call-rcu.h>
+#include <urcu-flavor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A struct cds_rcucache is a cache of bounded capacity: lookups are RCU
+ * lookups in a lock-free hash table, and the entries to evict are
+ * picked with the CLOCK approximation of LRU. A lookup hit only sets
+ * the referenced flag of the entry, with no store when it is already
+ * set, so frequent hits do not write shared cache lines. The entries
+ * are split into slices by hash, each with its own capacity, lock and
+ * clock hand: adds and removals only lock the slice of the entry, and
+ * an add which fills its slice evicts an entry of the same slice.
+ * Evicted entries are freed after a grace period with call_rcu().
+ */
+struct cds_rcucache;
+
+/*
+ * cds_rcucache_node: Contains the chaining of an entry, to be embedded
+ * in the structure of the entries. caa_container_of() can be used to
+ * get the structure from the struct cds_rcucache_node after a lookup.
+ * Owned by the cache once added, until freed by the cache.
+ */
+struct cds_rcucache_node {
+	struct cds_lfht_node lfht_node;
+	struct cds_list_head clock;	/* Slice clock, slice lock. */
+	unsigned long hash;
+	int referenced;
+	int removed;			/* Slice lock. */
+	struct rcu_head rcu_head;	/* Given to free_node. */
+};
+
+/*
+ * cds_rcucache_match_fct: Returns non-zero if @node matches @key.
+ */
+typedef int (*cds_rcucache_match_fct)(struct cds_rcucache_node *node,
+		const void *key);
+
+struct cds_rcucache_stats {
+	unsigned long count;		/* Entries in the cache. */
+	unsigned long capacity;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+};
+
+static inline
+void cds_rcucache_node_init(struct cds_rcucache_node *node)
+{
+	cds_lfht_node_init(&node->lfht_node);
+}
+
+/*
+ * _cds_rcucache_new - allocate a cache.
+ * @capacity: maximum number of entries, at least 1.
+ * @nr_slices: number of slices, 0 for the number of CPUs. Capped to the
+ *             capacity, which is split evenly between the slices.
+ * @free_node: frees an entry given its rcu_head, called by call_rcu()
+ *             for the evicted and removed entries, and directly by
+ *             cds_rcucache_destroy().
+ * @flavor: flavor of liburcu to use for synchronization.
+ *
+ * Returns NULL on error.
+ */
+extern
+struct cds_rcucache *_cds_rcucache_new(unsigned long capacity,
+		unsigned long nr_slices, void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_rcucache_new - allocate a cache, using the included flavor.
+ *
+ * Note: the RCU flavor must be already included before the cache
+ * include.
+ */
+static inline
+struct cds_rcucache *cds_rcucache_new(unsigned long capacity,
+		unsigned long nr_slices, void (*free_node)(struct rcu_head *head))
+{
+	return _cds_rcucache_new(capacity, nr_slices, free_node, &rcu_flavor);
+}
+
+/*
+ * cds_rcucache_destroy - free the cache and the entries it holds.
+ *
+ * The cache must not be used anymore by other threads. Waits for a
+ * grace period before freeing the entries with free_node, so it must
+ * not be called within a RCU read-side critical section, nor from a
+ * call_rcu thread.
+ */
+extern
+void cds_rcucache_destroy(struct cds_rcucache *cache);
+
+/*
+ * cds_rcucache_lookup - look up the entry matching @key.
+ * @hash: the hash of @key, as given on add.
+ *
+ * Returns the entry, which is marked as referenced, or NULL on a miss.
+ * Call with the RCU read-side lock held: the entry may be evicted once
+ * it is released.
+ */
+extern
+struct cds_rcucache_node *cds_rcucache_lookup(struct cds_rcucache *cache,
+		unsigned long hash, cds_rcucache_match_fct match,
+		const void *key);
+
+/*
+ * cds_rcucache_add - add @node under @key, unless already present.
+ *
+ * Returns @node when added, in which case the cache owns it, evicting
+ * an unreferenced entry of its slice when the slice is full. Returns
+ * the entry matching @key when already present: @node is left to the
+ * caller. Call with the RCU read-side lock held.
+ */
+extern
+struct cds_rcucache_node *cds_rcucache_add(struct cds_rcucache *cache,
+		unsigned long hash, cds_rcucache_match_fct match,
+		const void *key, struct cds_rcucache_node *node);
+
+/*
+ * cds_rcucache_del - remove @node, returned by a lookup or add.
+ *
+ * The entry is freed after a grace period. Returns 0 on success,
+ * -ENOENT if it was already removed or evicted. Call with the RCU
+ * read-side lock held.
+ */
+extern
+int cds_rcucache_del(struct cds_rcucache *cache,
+		struct cds_rcucache_node *node);
+
+/*
+ * cds_rcucache_get_stats - snapshot of the cache statistics.
+ *
+ * The counters are read without stopping the updates.
+ */
+extern
+void cds_rcucache_get_stats(struct cds_rcucache *cache,
+		struct cds_rcucache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUCACHE_H */
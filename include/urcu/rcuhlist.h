@@ -41,6 +41,59 @@ void cds_hlist_add_head_rcu(struct cds_hlist_node *newp,
 	rcu_assign_pointer(head->next, newp);
 }
 
+/* Add new element before @next, which is in the list. */
+static inline
+void cds_hlist_add_before_rcu(struct cds_hlist_node *newp,
+		struct cds_hlist_node *next)
+{
+	newp->next = next;
+	newp->prev = next->prev;
+	rcu_assign_pointer(next->prev->next, newp);
+	next->prev = newp;
+}
+
+/* Add new element after @prev, which is in the list. */
+static inline
+void cds_hlist_add_behind_rcu(struct cds_hlist_node *newp,
+		struct cds_hlist_node *prev)
+{
+	newp->next = prev->next;
+	newp->prev = prev;
+	if (prev->next)
+		prev->next->prev = newp;
+	rcu_assign_pointer(prev->next, newp);
+}
+
+/*
+ * Add new element before the first element @cmp orders after it, i.e.
+ * for which cmp(newp, pos) < 0, keeping a list sorted by @cmp in
+ * place: equal elements keep their insertion order. Readers traverse a
+ * sorted list at all times, so they may stop at the first element past
+ * the one they look for. Removal with cds_hlist_del_rcu() keeps the
+ * list sorted as well. Mutual exclusion against concurrent updates is
+ * required. O(n).
+ */
+static inline
+void cds_hlist_add_sorted_rcu(struct cds_hlist_node *newp,
+		struct cds_hlist_head *head,
+		int (*cmp)(const struct cds_hlist_node *a,
+			const struct cds_hlist_node *b))
+{
+	struct cds_hlist_node *pos, *last = NULL;
+
+	for (pos = head->next; pos != NULL; pos = pos->next) {
+		if (cmp(newp, pos) < 0) {
+			cds_hlist_add_before_rcu(newp, pos);
+			return;
+		}
+		last = pos;
+	}
+	if (last)
+		cds_hlist_add_behind_rcu(newp, last);
+	else
+		cds_hlist_add_head_rcu(newp, head);
+}
+
 /* Remove element from list. */
 static inline
 void cds_hlist_del_rcu(struct cds_hlist_node *elem)
@@ -50,6 +103,51 @@ void cds_hlist_del_rcu(struct cds_hlist_node *elem)
 	CMM_STORE_SHARED(elem->prev->next, elem->next);
 }
 
+/*
+ * Move all the elements of @list, which must not be visible to
+ * readers, to the head of @head with a single publication, and
+ * reinitialize @list. Finding the tail of @list is O(n). Mutual
+ * exclusion against concurrent updates of @head is required.
+ */
+static inline
+void cds_hlist_splice_init_rcu(struct cds_hlist_head *list,
+		struct cds_hlist_head *head)
+{
+	struct cds_hlist_node *first = list->next, *last;
+
+	if (!first)
+		return;
+	for (last = first; last->next; last = last->next)
+		;
+	last->next = head->next;
+	if (head->next)
+		head->next->prev = last;
+	first->prev = (struct cds_hlist_node *)head;
+	rcu_assign_pointer(head->next, first);
+	list->next = NULL;
+}
+
+/*
+ * Replace all the elements of @head by those of @newp, which must not
+ * be visible to readers, with a single publication. @newp is
+ * reinitialized, and the old elements are moved to @old, so that they
+ * can be reclaimed with a single call_rcu(). Readers may traverse the
+ * old elements until a grace period elapses. Mutual exclusion against
+ * concurrent updates of @head is required.
+ */
+static inline
+void cds_hlist_replace_all_rcu(struct cds_hlist_head *newp,
+		struct cds_hlist_head *head, struct cds_hlist_head *old)
+{
+	old->next = head->next;
+	if (old->next)
+		old->next->prev = (struct cds_hlist_node *)old;
+	if (newp->next)
+		newp->next->prev = (struct cds_hlist_node *)head;
+	rcu_assign_pointer(head->next, newp->next);
+	newp->next = NULL;
+}
+
 /*
  * Iterate through elements of the list.
  * This must be done while rcu_read_lock() is held.
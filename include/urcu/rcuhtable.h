@@ -0,0 +1,186 @@
+#ifndef _URCU_RCUHTABLE_H
+#define _URCU_RCUHTABLE_H
+
+/*
+ * urcu/rcuhtable.h
+ *
+ * Userspace RCU library - Fixed-size RCU hash table with per-bucket locks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <urcu/hlist.h>
+#include <urcu/rcuhlist.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hash table of cds_hlist buckets, of a size fixed at creation.
+ *
+ * Lookups index the bucket array and walk its chain under
+ * rcu_read_lock(), without dummy nodes nor split-ordering: compared to
+ * cds_lfht, a node costs a cds_hlist_node and its hash, and a lookup
+ * one indirection less. Updates take the spinlock of their bucket, so
+ * updates of distinct buckets run in parallel. The table never
+ * resizes: size it for the expected number of nodes, and use cds_lfht
+ * when that number is unknown.
+ *
+ * As with cds_lfht, nodes are embedded in the user structure, and
+ * removed nodes are freed by the caller after a grace period, e.g.
+ * with call_rcu(). The table itself does not depend on the flavor.
+ */
+
+/*
+ * cds_rcuhtable_node: Contains the chain link and the hash of a key.
+ * Use caa_container_of() to get the structure embedding it.
+ */
+struct cds_rcuhtable_node {
+	struct cds_hlist_node node;	/* node.prev is NULL once removed */
+	unsigned long hash;
+};
+
+struct cds_rcuhtable_bucket {
+	struct cds_hlist_head head;
+	int lock;			/* Spinlock of the updates. */
+	unsigned int nr_nodes;		/* Updated under lock. */
+};
+
+struct cds_rcuhtable {
+	unsigned long mask;		/* Number of buckets - 1. */
+	struct cds_rcuhtable_bucket buckets[];
+};
+
+struct cds_rcuhtable_stats {
+	unsigned long nr_buckets;
+	unsigned long nr_nodes;
+	unsigned long nr_empty;		/* Buckets without nodes. */
+	unsigned long max_chain;	/* Nodes of the longest chain. */
+};
+
+/*
+ * cds_rcuhtable_match_fct: return non-zero if @node matches @key. As
+ * with cds_lfht, it is only called on nodes of the same hash, and a
+ * NULL match function matches nodes on their hash only.
+ */
+typedef int (*cds_rcuhtable_match_fct)(struct cds_rcuhtable_node *node,
+		const void *key);
+
+/*
+ * cds_rcuhtable_new - allocate a hash table.
+ * @size: number of buckets, rounded up to a power of 2.
+ *
+ * Returns NULL on allocation failure.
+ */
+extern struct cds_rcuhtable *cds_rcuhtable_new(unsigned long size);
+
+/*
+ * cds_rcuhtable_destroy - free a hash table.
+ *
+ * Returns -EPERM, leaving the table untouched, if it still contains
+ * nodes, 0 on success. No thread may be using the table anymore.
+ */
+extern int cds_rcuhtable_destroy(struct cds_rcuhtable *ht);
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/rcuhtable.h>
+
+#define cds_rcuhtable_lookup		_cds_rcuhtable_lookup
+#define cds_rcuhtable_next_duplicate	_cds_rcuhtable_next_duplicate
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * cds_rcuhtable_lookup - lookup a node by key.
+ *
+ * Returns the first node matching @key, or NULL. Call with
+ * rcu_read_lock held; the node stays valid until rcu_read_unlock().
+ */
+extern struct cds_rcuhtable_node *cds_rcuhtable_lookup(
+		struct cds_rcuhtable *ht, unsigned long hash,
+		cds_rcuhtable_match_fct match, const void *key);
+
+/*
+ * cds_rcuhtable_next_duplicate - get the next node matching @key.
+ *
+ * Returns the node after @node, in its chain, matching @key, or NULL.
+ * Call with rcu_read_lock held.
+ */
+extern struct cds_rcuhtable_node *cds_rcuhtable_next_duplicate(
+		struct cds_rcuhtable_node *node,
+		cds_rcuhtable_match_fct match, const void *key);
+
+#endif /* !_LGPL_SOURCE */
+
+/*
+ * cds_rcuhtable_add - add @node, allowing duplicate keys.
+ *
+ * Does not require the RCU read-side lock.
+ */
+extern void cds_rcuhtable_add(struct cds_rcuhtable *ht, unsigned long hash,
+		struct cds_rcuhtable_node *node);
+
+/*
+ * cds_rcuhtable_add_unique - add @node unless a node matches @key.
+ *
+ * Returns @node if added, or the node matching @key, which is only
+ * valid under rcu_read_lock. Does not require the RCU read-side lock
+ * otherwise.
+ */
+extern struct cds_rcuhtable_node *cds_rcuhtable_add_unique(
+		struct cds_rcuhtable *ht, unsigned long hash,
+		cds_rcuhtable_match_fct match, const void *key,
+		struct cds_rcuhtable_node *node);
+
+/*
+ * cds_rcuhtable_del - remove @node from the table.
+ *
+ * Returns 0, or -ENOENT if @node was already removed, e.g. by a
+ * concurrent cds_rcuhtable_del(). Readers may still see @node until a
+ * grace period elapses. Call with rcu_read_lock held if @node was
+ * obtained by a lookup and may be concurrently removed and freed.
+ */
+extern int cds_rcuhtable_del(struct cds_rcuhtable *ht,
+		struct cds_rcuhtable_node *node);
+
+/*
+ * cds_rcuhtable_get_stats - count the nodes of the table.
+ *
+ * Walks every bucket, reading their counts without their locks: the
+ * result is approximate while updates are in progress.
+ */
+extern void cds_rcuhtable_get_stats(struct cds_rcuhtable *ht,
+		struct cds_rcuhtable_stats *stats);
+
+/*
+ * cds_rcuhtable_for_each - iterate over all the nodes of the table.
+ * @i: unsigned long bucket index.
+ * @pos: struct cds_rcuhtable_node pointer.
+ *
+ * Call with rcu_read_lock held. Nodes added or removed during the
+ * traversal may or may not be seen.
+ */
+#define cds_rcuhtable_for_each(ht, i, pos)				\
+	for (i = 0; i <= (ht)->mask; i++)				\
+		cds_hlist_for_each_entry_rcu_2(pos,			\
+				&(ht)->buckets[i].head, node)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUHTABLE_H */
@@ -0,0 +1,182 @@
+#ifndef _URCU_RCUJA_H
+#define _URCU_RCUJA_H
+
+/*
+ * urcu/rcuja.h
+ *
+ * Userspace RCU library - RCU Judy Array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor.
+ */
+
+#include <stdint.h>
+#include <urcu/compiler.h>
+#include <urcu-call-rcu.h>
+#include <urcu-flavor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A struct cds_ja maps integer keys of up to 64 bits to nodes, as a
+ * radix tree indexed by one key byte per level, most significant byte
+ * first: a lookup visits at most key_bits / 8 nodes, and nodes holding
+ * neighbouring keys share their internal nodes. Internal nodes holding
+ * few children are small arrays, replaced by 256-entry arrays when they
+ * fill up, so that sparse key ranges stay compact and dense key ranges
+ * are indexed directly.
+ *
+ * Lookups and ordered traversals are wait-free RCU readers. Updates
+ * lock the internal nodes they modify, so that updates of distinct key
+ * ranges proceed in parallel. Internal nodes replaced or emptied by
+ * updates are freed with call_rcu. Keys are unique.
+ */
+
+/*
+ * cds_ja_node: embedded into the structure holding a key and its value.
+ * caa_container_of() can be used to get the structure from the struct
+ * cds_ja_node after a lookup.
+ */
+struct cds_ja_node {
+	uint64_t key;			/* Set by cds_ja_add_unique(). */
+};
+
+struct cds_ja;
+
+/*
+ * Caution !
+ * Ensure reader and writer threads are registered as urcu readers.
+ */
+
+/*
+ * _cds_ja_new - API used by cds_ja_new wrapper. Do not use directly.
+ */
+extern
+struct cds_ja *_cds_ja_new(unsigned int key_bits,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_ja_new - allocate a Judy array.
+ * @key_bits: number of bits of the keys, a multiple of 8 between 8 and
+ *            64.
+ *
+ * Return NULL on error, with errno set.
+ * Note: the RCU flavor must be already included before the Judy array
+ * header.
+ * Threads calling cds_ja_new are NOT required to be registered RCU
+ * read-side threads.
+ */
+static inline
+struct cds_ja *cds_ja_new(unsigned int key_bits)
+{
+	return _cds_ja_new(key_bits, &rcu_flavor);
+}
+
+/*
+ * cds_ja_destroy - destroy a Judy array.
+ * @ja: the Judy array to destroy.
+ *
+ * Return 0 on success, -EPERM if nodes remain in the array.
+ * No thread may be using the array anymore, and cds_ja_destroy should
+ * *not* be called from a RCU read-side critical section. Internal nodes
+ * freed by updates may still be waiting for a grace period on return:
+ * call rcu_barrier() before unloading the library.
+ */
+extern
+int cds_ja_destroy(struct cds_ja *ja);
+
+/*
+ * cds_ja_lookup - lookup a node by key.
+ *
+ * Return the node holding @key, or NULL if not found.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+struct cds_ja_node *cds_ja_lookup(struct cds_ja *ja, uint64_t key);
+
+/*
+ * cds_ja_lookup_above_equal - lookup the node with the lowest key
+ * greater than or equal to @key.
+ *
+ * Return NULL if there is none.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_ja_node *cds_ja_lookup_above_equal(struct cds_ja *ja,
+		uint64_t key);
+
+/*
+ * cds_ja_lookup_below_equal - lookup the node with the highest key
+ * lower than or equal to @key.
+ *
+ * Return NULL if there is none.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_ja_node *cds_ja_lookup_below_equal(struct cds_ja *ja,
+		uint64_t key);
+
+/*
+ * cds_ja_add_unique - add a node if its key is not present.
+ * @ja: the Judy array.
+ * @key: the key of @node, within the key bits of the array.
+ * @node: the node to add.
+ *
+ * Return @node if added, the node already holding @key otherwise, in
+ * which case @node is not added, or NULL with errno set on memory
+ * exhaustion or key out of range.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_ja_node *cds_ja_add_unique(struct cds_ja *ja, uint64_t key,
+		struct cds_ja_node *node);
+
+/*
+ * cds_ja_del - remove a node from the Judy array.
+ *
+ * Return 0 if the node is successfully removed, -ENOENT if the node is
+ * not in the array.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * After successful removal, a grace period must be waited for before
+ * freeing or re-using the memory reserved for old node.
+ */
+extern
+int cds_ja_del(struct cds_ja *ja, struct cds_ja_node *node);
+
+/*
+ * Traverse the nodes in increasing key order. Nodes added or removed
+ * during the traversal may or may not be seen.
+ * Call with rcu_read_lock held.
+ */
+#define cds_ja_for_each_key_rcu(ja, node)				\
+	for (node = cds_ja_lookup_above_equal(ja, 0);			\
+		node != NULL;						\
+		node = (node)->key == UINT64_MAX ? NULL :		\
+			cds_ja_lookup_above_equal(ja, (node)->key + 1))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUJA_H */
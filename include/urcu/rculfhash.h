@@ -56,10 +56,17 @@ extern "C" {
  * The structure which embeds it typically holds the key (or key-value
  * pair) of the object. The caller code is responsible for calculation
  * of the hash value for cds_lfht APIs.
+ *
+ * In tables given a node hash function by cds_lfht_set_node_hash(),
+ * the hash table only uses the next pointer of the nodes, and their
+ * "priv" word belongs to the caller, e.g. to hold a small key.
  */
 struct cds_lfht_node {
 	struct cds_lfht_node *next;	/* ptr | REMOVAL_OWNER_FLAG | BUCKET_FLAG | REMOVED_FLAG */
-	unsigned long reverse_hash;
+	union {
+		unsigned long reverse_hash;
+		unsigned long priv;	/* With cds_lfht_set_node_hash() */
+	};
 } __attribute__((aligned(8)));
 
 /* cds_lfht_iter: Used to track state while traversing a hash chain. */
@@ -73,6 +80,65 @@ struct cds_lfht_node *cds_lfht_iter_get_node(struct cds_lfht_iter *iter)
 	return iter->node;
 }
 
+/*
+ * cds_lfht_range_iter: iterator over the nodes of a hash range, used by
+ * cds_lfht_lookup_range and cds_lfht_next_range. Apart from "iter",
+ * its fields are private.
+ */
+struct cds_lfht_range_iter {
+	struct cds_lfht_iter iter;
+	unsigned long hash_lo, hash_hi;
+	unsigned long hash;		/* current hash, when looking up */
+	int scan;			/* traverse the whole table */
+};
+
+static inline
+struct cds_lfht_node *cds_lfht_range_iter_get_node(
+		struct cds_lfht_range_iter *iter)
+{
+	return iter->iter.node;
+}
+
+/*
+ * cds_lfht_cursor: position of a traversal resumable across RCU
+ * read-side critical sections, used by cds_lfht_cursor_next.
+ * Initialize with cds_lfht_cursor_init, and call cds_lfht_cursor_pause
+ * before leaving the critical section. Its fields are private.
+ */
+struct cds_lfht_cursor {
+	struct cds_lfht_iter iter;	/* current node, until paused */
+	unsigned long reverse_hash;	/* of the current node */
+	unsigned long nr_dup;		/* nodes returned with reverse_hash */
+	int state;
+};
+
+enum cds_lfht_cursor_state {
+	CDS_LFHT_CURSOR_START = 0,
+	CDS_LFHT_CURSOR_ACTIVE,
+	CDS_LFHT_CURSOR_PAUSED,
+	CDS_LFHT_CURSOR_END,
+};
+
+static inline
+void cds_lfht_cursor_init(struct cds_lfht_cursor *cursor)
+{
+	cursor->state = CDS_LFHT_CURSOR_START;
+}
+
+/*
+ * cds_lfht_cursor_pause - keep only the position of a cursor.
+ *
+ * Call before leaving the RCU read-side critical section, or before
+ * rcu_quiescent_state() with QSBR: the next cds_lfht_cursor_next
+ * finds the position again from its reverse hash.
+ */
+static inline
+void cds_lfht_cursor_pause(struct cds_lfht_cursor *cursor)
+{
+	if (cursor->state == CDS_LFHT_CURSOR_ACTIVE)
+		cursor->state = CDS_LFHT_CURSOR_PAUSED;
+}
+
 struct cds_lfht;
 
 /*
@@ -80,8 +146,56 @@ struct cds_lfht;
  * Ensure reader and writer threads are registered as urcu readers.
  */
 
+/*
+ * cds_lfht_match_fct: return non-zero if @node holds @key.
+ *
+ * Match functions are only called on nodes whose hash is equal to the
+ * hash looked up: every node stores its full hash (bit-reversed), which
+ * is compared first. For tables whose hash function is collision-free
+ * over the keys (for instance integer keys used as their own hash), a
+ * NULL match function can therefore be passed to the lookup, traversal
+ * and update functions taking a match function: nodes then match on
+ * their hash only, and their key is never dereferenced.
+ */
 typedef int (*cds_lfht_match_fct)(struct cds_lfht_node *node, const void *key);
 
+/*
+ * Nodes with an inline key of 8, 16 or 32 bytes.
+ *
+ * The key follows the node within the same cache line (hence the
+ * alignment), so the lookups of tables of such nodes compare it without
+ * touching another cache line, nor calling a match function: see
+ * cds_lfht_lookup_key16(). The key is compared as raw bytes: padding
+ * within it must be zeroed. cds_lfht_match_key16() and its 8 and 32
+ * bytes counterparts are the match functions of those nodes, with a
+ * pointer to the key bytes as key, for the update functions.
+ */
+struct cds_lfht_node_key8 {
+	struct cds_lfht_node node;
+	uint64_t key;
+} __attribute__((aligned(32)));
+
+struct cds_lfht_node_key16 {
+	struct cds_lfht_node node;
+	uint64_t key[2];
+} __attribute__((aligned(32)));
+
+struct cds_lfht_node_key32 {
+	struct cds_lfht_node node;
+	uint64_t key[4];
+} __attribute__((aligned(64)));
+
+extern int cds_lfht_match_key8(struct cds_lfht_node *node, const void *key);
+extern int cds_lfht_match_key16(struct cds_lfht_node *node, const void *key);
+extern int cds_lfht_match_key32(struct cds_lfht_node *node, const void *key);
+
+/*
+ * cds_lfht_node_hash_fct: return the hash of @node, as passed to the
+ * function which added it. See cds_lfht_set_node_hash().
+ */
+typedef unsigned long (*cds_lfht_node_hash_fct)(struct cds_lfht_node *node,
+		void *priv);
+
 /*
  * cds_lfht_node_init - initialize a hash table node
  * @node: the node to initialize.
@@ -100,6 +214,7 @@ void cds_lfht_node_init(struct cds_lfht_node *node)
 enum {
 	CDS_LFHT_AUTO_RESIZE = (1U << 0),
 	CDS_LFHT_ACCOUNTING = (1U << 1),
+	CDS_LFHT_INCREMENTAL_RESIZE = (1U << 2),
 };
 
 struct cds_lfht_mm_type {
@@ -114,6 +229,8 @@ struct cds_lfht_mm_type {
 extern const struct cds_lfht_mm_type cds_lfht_mm_order;
 extern const struct cds_lfht_mm_type cds_lfht_mm_chunk;
 extern const struct cds_lfht_mm_type cds_lfht_mm_mmap;
+extern const struct cds_lfht_mm_type cds_lfht_mm_mmap_huge;
+extern const struct cds_lfht_mm_type cds_lfht_mm_numa;
 
 /*
  * _cds_lfht_new - API used by cds_lfht_new wrapper. Do not use directly.
@@ -140,10 +257,18 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
  *           CDS_LFHT_AUTO_RESIZE: automatically resize hash table.
  *           CDS_LFHT_ACCOUNTING: count the number of node addition
  *                                and removal in the table
+ *           CDS_LFHT_INCREMENTAL_RESIZE: with CDS_LFHT_AUTO_RESIZE,
+ *                                grow the table incrementally from
+ *                                the updaters rather than from the
+ *                                resize worker thread.
  * @attr: optional resize worker thread attributes. NULL for default.
  *
  * Return NULL on error.
  * Note: the RCU flavor must be already included before the hash table header.
+ * Applications linked with liburcu-cds-qsbr or liburcu-cds-memb rather
+ * than liburcu-cds must include urcu-qsbr.h or urcu.h respectively: those
+ * libraries inline the flavor operations of their resize and cleanup
+ * paths, and return NULL for tables of another flavor.
  *
  * The programmer is responsible for ensuring that resize operation has a
  * priority equal to hash table updater threads. It should be performed by
@@ -156,78 +281,988 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
  * read-side threads. It can be called very early. (e.g. before RCU is
  * initialized)
  */
-static inline
-struct cds_lfht *cds_lfht_new(unsigned long init_size,
-			unsigned long min_nr_alloc_buckets,
-			unsigned long max_nr_buckets,
-			int flags,
-			pthread_attr_t *attr)
-{
-	return _cds_lfht_new(init_size, min_nr_alloc_buckets, max_nr_buckets,
-			flags, NULL, &rcu_flavor, attr);
-}
+static inline
+struct cds_lfht *cds_lfht_new(unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			pthread_attr_t *attr)
+{
+	return _cds_lfht_new(init_size, min_nr_alloc_buckets, max_nr_buckets,
+			flags, NULL, &rcu_flavor, attr);
+}
+
+/*
+ * cds_lfht_resize_policy: automatic resize policy of a hash table.
+ *
+ * Load factors are expressed as orders: a load order of n stands for
+ * (1 << n) nodes per bucket, and is compared to the approximate node
+ * count, which is only available with CDS_LFHT_ACCOUNTING.
+ *
+ * @grow_load_order: grow when the load factor reaches this order.
+ * @shrink_load_order: shrink when the load factor falls below this
+ *                     order. Must be lower than or equal to
+ *                     grow_load_order. Lower values delay shrink, which
+ *                     avoids grow/shrink cycles for tables churning
+ *                     around a steady size.
+ * @target_load_order: load factor order targeted by resize operations.
+ *                     Must be lower than or equal to grow_load_order.
+ * @chain_len_threshold: grow small tables (and tables without
+ *                       accounting) when an add observes a hash chain of
+ *                       at least this length. Must be at least 1.
+ * @min_interval_ms: minimum interval between the end of a resize and
+ *                   the start of the next automatic resize, in
+ *                   milliseconds. Resize triggers occurring within
+ *                   this interval are ignored. 0 means no minimum.
+ */
+struct cds_lfht_resize_policy {
+	unsigned int grow_load_order;
+	unsigned int shrink_load_order;
+	unsigned int target_load_order;
+	unsigned int chain_len_threshold;
+	unsigned long min_interval_ms;
+};
+
+/*
+ * Default resize policy, used by cds_lfht_new.
+ */
+#define CDS_LFHT_RESIZE_POLICY_DEFAULT					\
+	{								\
+		.grow_load_order = 3,					\
+		.shrink_load_order = 3,					\
+		.target_load_order = 0,					\
+		.chain_len_threshold = 3,				\
+		.min_interval_ms = 0,					\
+	}
+
+/*
+ * _cds_lfht_new_with_policy - API used by cds_lfht_new_with_policy
+ * wrapper. Do not use directly.
+ */
+extern
+struct cds_lfht *_cds_lfht_new_with_policy(unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_resize_policy *policy,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr);
+
+/*
+ * cds_lfht_new_with_policy - allocate a hash table with a resize policy.
+ * @policy: automatic resize policy. NULL for default.
+ *
+ * Other arguments and return value are as for cds_lfht_new. Return NULL
+ * if the policy is invalid. The policy is copied into the hash table.
+ */
+static inline
+struct cds_lfht *cds_lfht_new_with_policy(unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_resize_policy *policy,
+			pthread_attr_t *attr)
+{
+	return _cds_lfht_new_with_policy(init_size, min_nr_alloc_buckets,
+			max_nr_buckets, flags, policy, NULL, &rcu_flavor, attr);
+}
+
+/*
+ * cds_lfht_bulk_entry: (hash, node) pair passed to cds_lfht_add_bulk
+ * and cds_lfht_new_from_array.
+ */
+struct cds_lfht_bulk_entry {
+	unsigned long hash;
+	struct cds_lfht_node *node;
+};
+
+/*
+ * _cds_lfht_new_from_array - API used by cds_lfht_new_from_array
+ * wrapper. Do not use directly.
+ */
+extern
+struct cds_lfht *_cds_lfht_new_from_array(struct cds_lfht_bulk_entry *entries,
+			unsigned long nr_entries,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr);
+
+/*
+ * cds_lfht_new_from_array - allocate a hash table populated with nodes.
+ * @entries: array of (hash, node) pairs to populate the table with.
+ * @nr_entries: number of entries in the array.
+ * @min_nr_alloc_buckets: the minimum number of allocated buckets.
+ *                        (must be power of two)
+ * @max_nr_buckets: the maximum number of hash table buckets allowed.
+ *                  (must be power of two, 0 is accepted, means
+ *                  "infinite")
+ * @flags: hash table creation flags, as for cds_lfht_new.
+ * @attr: optional resize worker thread attributes. NULL for default.
+ *
+ * Return NULL on error.
+ * The table is created with enough buckets for @nr_entries nodes, and
+ * the nodes are linked without atomic operations, using one thread per
+ * CPU for large arrays. The @entries array is sorted in place.
+ * Redundant keys are added as with cds_lfht_add.
+ * The new table is not visible to other threads until the caller
+ * publishes it, e.g. with rcu_assign_pointer().
+ * Threads calling cds_lfht_new_from_array are NOT required to be
+ * registered RCU read-side threads.
+ */
+static inline
+struct cds_lfht *cds_lfht_new_from_array(struct cds_lfht_bulk_entry *entries,
+			unsigned long nr_entries,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			pthread_attr_t *attr)
+{
+	return _cds_lfht_new_from_array(entries, nr_entries,
+			min_nr_alloc_buckets, max_nr_buckets,
+			flags, NULL, &rcu_flavor, attr);
+}
+
+/*
+ * cds_lfht_resize_pool: set of resize worker threads which hash tables
+ * can be attached to, instead of the resize worker thread shared by all
+ * hash tables of the process. Opaque to users.
+ */
+struct cds_lfht_resize_pool;
+
+/*
+ * cds_lfht_resize_pool_create - create a resize worker thread pool.
+ * @nr_workers: number of worker threads.
+ *
+ * Return NULL on error.
+ * The tables attached to a pool are spread over its worker threads, so
+ * resize operations of tables attached to different threads can
+ * proceed in parallel.
+ */
+extern
+struct cds_lfht_resize_pool *cds_lfht_resize_pool_create(unsigned int nr_workers);
+
+/*
+ * cds_lfht_resize_pool_destroy - destroy a resize worker thread pool.
+ * @pool: the pool to destroy.
+ *
+ * Return 0 on success, -EBUSY if hash tables are still attached to the
+ * pool.
+ */
+extern
+int cds_lfht_resize_pool_destroy(struct cds_lfht_resize_pool *pool);
+
+/*
+ * cds_lfht_set_resize_pool - attach a hash table to a resize pool.
+ * @ht: the hash table, created with CDS_LFHT_AUTO_RESIZE.
+ * @pool: the resize pool. NULL attaches the table back to the default
+ *        resize worker thread.
+ *
+ * Return 0 on success, -EINVAL if the table does not resize
+ * automatically.
+ * Waits for the resize operations queued on the previous worker thread
+ * to complete. Should be called before the hash table is used by
+ * concurrent updaters, and should not be called from a resize pool
+ * worker thread. The table stays attached to the pool until it is
+ * destroyed or attached elsewhere.
+ */
+extern
+int cds_lfht_set_resize_pool(struct cds_lfht *ht,
+		struct cds_lfht_resize_pool *pool);
+
+/*
+ * cds_lfht_destroy - destroy a hash table.
+ * @ht: the hash table to destroy.
+ * @attr: (output) resize worker thread attributes, as received by cds_lfht_new.
+ *        The caller will typically want to free this pointer if dynamically
+ *        allocated. The attr point can be NULL if the caller does not
+ *        need to be informed of the value passed to cds_lfht_new().
+ *
+ * Return 0 on success, negative error value on error.
+
+ * Prior to liburcu 0.10:
+ * - Threads calling this API need to be registered RCU read-side
+ *   threads.
+ * - cds_lfht_destroy should *not* be called from a RCU read-side
+ *   critical section. It should *not* be called from a call_rcu thread
+ *   context neither.
+ *
+ * Starting from liburcu 0.10, rculfhash implements its own worker
+ * thread to handle resize operations, which removes RCU requirements on
+ * cds_lfht_destroy.
+ */
+extern
+int cds_lfht_destroy(struct cds_lfht *ht, pthread_attr_t **attr);
+
+/*
+ * cds_lfht_set_node_hash - get the hash of the nodes from the caller.
+ * @ht: the hash table, still empty.
+ * @hash_fct: returns the hash of a node of @ht.
+ * @priv: private data passed to @hash_fct.
+ *
+ * The hash table then does not store the hash of its nodes, leaving
+ * their "priv" word to the caller, who typically stores the key there:
+ * a table of word-sized keys takes two words per node instead of three.
+ * Must be called before any node is added. The match of the nodes, in
+ * lookups and updates, is still performed as with stored hashes.
+ *
+ * Every node visited by a chain walk is hashed: lookups, traversals
+ * and updates call @hash_fct once per node visited, including the
+ * logically removed nodes, so a throughput falling with the chain
+ * length and the cost of @hash_fct is traded for the memory. The
+ * benchmark of test_urcu_hash_mem -X shows this trade-off. @hash_fct
+ * may be called on any node of the table, including removed nodes
+ * whose grace period has not elapsed, from RCU read-side critical
+ * sections: the fields it reads must not change while the node is in
+ * the table.
+ */
+extern
+void cds_lfht_set_node_hash(struct cds_lfht *ht,
+		cds_lfht_node_hash_fct hash_fct, void *priv);
+
+/*
+ * cds_lfht_set_resize_latency - bound the grace period delay of resize.
+ * @ht: the hash table.
+ * @max_us: latency budget of the resize passes, in microseconds.
+ *
+ * Resize passes, which populate or remove bucket nodes from RCU
+ * read-side critical sections, leave them and report a quiescent state
+ * between chunks of bucket nodes once @max_us has elapsed since their
+ * last one, so that a resize delays grace periods by about @max_us at
+ * most. 0 reports a quiescent state after each chunk. The default is
+ * 1000 microseconds. The populate steps of CDS_LFHT_INCREMENTAL_RESIZE
+ * performed by updaters, within their read-side critical section,
+ * report none.
+ */
+extern
+void cds_lfht_set_resize_latency(struct cds_lfht *ht, unsigned long max_us);
+
+/*
+ * cds_lfht_clear - remove all nodes from a hash table.
+ * @ht: the hash table.
+ * @free_fct: called on each removed node, after a grace period.
+ * @priv: private data passed to @free_fct.
+ *
+ * Return the number of nodes removed.
+ * Detaches all nodes at once, without the per-node atomic operations of
+ * cds_lfht_del. Large tables are cleared in parallel across bucket
+ * partitions: @free_fct may be called concurrently from several
+ * threads registered as RCU read-side threads, and should not wait
+ * for a grace period itself.
+ * Concurrent readers may observe any subset of the nodes while the
+ * table is cleared. There must be no concurrent update of the hash
+ * table.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * cds_lfht_clear should *not* be called from a RCU read-side critical
+ * section, nor from a call_rcu thread context.
+ */
+extern
+unsigned long cds_lfht_clear(struct cds_lfht *ht,
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv);
+
+/*
+ * cds_lfht_destroy_with_nodes - destroy a hash table and its nodes.
+ * @ht: the hash table to destroy.
+ * @free_fct: called on each node of the table.
+ * @priv: private data passed to @free_fct.
+ * @attr: (output) resize worker thread attributes, as received by cds_lfht_new.
+ *
+ * Return 0 on success, negative error value on error.
+ * Same as cds_lfht_clear followed by cds_lfht_destroy, except that no
+ * grace period is waited for: there must be no concurrent reader nor
+ * updater of the hash table.
+ */
+extern
+int cds_lfht_destroy_with_nodes(struct cds_lfht *ht,
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv, pthread_attr_t **attr);
+
+/*
+ * cds_lfht_count_nodes - count the number of nodes in the hash table.
+ * @ht: the hash table.
+ * @split_count_before: sample the node count split-counter before traversal.
+ * @count: traverse the hash table, count the number of nodes observed.
+ * @split_count_after: sample the node count split-counter after traversal.
+ *
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void cds_lfht_count_nodes(struct cds_lfht *ht,
+		long *split_count_before,
+		unsigned long *count,
+		long *split_count_after);
+
+/*
+ * cds_lfht_count_fast - count the number of nodes from the split-counters.
+ * @ht: the hash table, created with CDS_LFHT_ACCOUNTING.
+ * @count: number of nodes in the hash table (output).
+ *
+ * Return 0 on success, -EINVAL if the table does not keep accounting.
+ * Sums the per-CPU node addition and removal counters, without
+ * traversing the table: the cost depends on the number of CPUs, not on
+ * the number of nodes. The count is exact when no update is performed
+ * concurrently. Otherwise, each add or removal executing concurrently
+ * with cds_lfht_count_fast can be missed or accounted for, so the error
+ * is at most the number of such concurrent updates.
+ * Does not need to be called with rcu_read_lock held.
+ */
+extern
+int cds_lfht_count_fast(struct cds_lfht *ht, unsigned long *count);
+
+/*
+ * Number of entries of the chain length histogram. The last entry
+ * counts the chains of at least (CDS_LFHT_STATS_NR_CHAIN_LEN - 1)
+ * nodes.
+ */
+#define CDS_LFHT_STATS_NR_CHAIN_LEN	16
+
+/*
+ * cds_lfht_stats: hash table distribution statistics, filled by
+ * cds_lfht_get_stats.
+ *
+ * A chain is the list of nodes following a bucket node, up to the next
+ * bucket node. The average number of nodes visited by a successful
+ * lookup is nr_probes / nr_nodes.
+ */
+struct cds_lfht_stats {
+	unsigned long size;		/* Current number of buckets. */
+	unsigned long nr_bucket_nodes;	/* Bucket nodes observed. */
+	unsigned long nr_nodes;		/* Non-removed nodes observed. */
+	unsigned long nr_removed;	/* Logically removed nodes observed. */
+	unsigned long max_chain_len;	/* Longest chain observed. */
+	unsigned long long nr_probes;	/* Nodes visited when looking up each node. */
+	unsigned long chain_len[CDS_LFHT_STATS_NR_CHAIN_LEN];	/* Histogram. */
+};
+
+/*
+ * cds_lfht_get_stats - sample hash table distribution statistics.
+ * @ht: the hash table.
+ * @stats: statistics (output).
+ *
+ * Traverses the whole hash table, so the cost is proportional to its
+ * size, and the result is only approximate if updates are concurrent.
+ * Lookups and updates are not slowed down when statistics are not
+ * sampled.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void cds_lfht_get_stats(struct cds_lfht *ht, struct cds_lfht_stats *stats);
+
+/*
+ * Number of bucket table orders reported by cds_lfht_get_mem_info.
+ */
+#define CDS_LFHT_MEM_INFO_NR_ORDERS	64
+
+/*
+ * cds_lfht_mem_info: hash table memory footprint, filled by
+ * cds_lfht_get_mem_info. Sizes are in bytes.
+ *
+ * bucket_bytes is the memory committed to bucket node tables, including
+ * tables removed by a shrink which are pending free after a grace
+ * period. order_bytes[i] is the part of bucket_bytes allocated for
+ * order i (order 0 holds min_nr_alloc_buckets bucket nodes, and the
+ * lower orders merged into it report 0). reserved_bucket_bytes is the
+ * address space reserved for bucket node tables: with the mmap
+ * backends it covers max_nr_buckets up front, and otherwise equals
+ * bucket_bytes. The nodes added by the user are not accounted for.
+ */
+struct cds_lfht_mem_info {
+	const struct cds_lfht_mm_type *mm;	/* Memory management backend. */
+	unsigned long size;		/* Current number of buckets. */
+	unsigned long max_nr_buckets;
+	unsigned long min_nr_alloc_buckets;
+	size_t ht_bytes;		/* struct cds_lfht. */
+	size_t split_count_bytes;	/* Split-counter array. */
+	size_t bucket_bytes;
+	size_t reserved_bucket_bytes;
+	size_t order_bytes[CDS_LFHT_MEM_INFO_NR_ORDERS];
+};
+
+/*
+ * cds_lfht_get_mem_info - get the memory footprint of a hash table.
+ * @ht: the hash table.
+ * @info: memory footprint (output).
+ *
+ * Takes the resize mutex, so it waits for a concurrent resize step to
+ * complete. Does not traverse the table.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function should *not* be called from a RCU read-side critical
+ * section.
+ */
+extern
+void cds_lfht_get_mem_info(struct cds_lfht *ht, struct cds_lfht_mem_info *info);
+
+/*
+ * cds_lfht_stats_snapshot - write statistics of a hash table as text.
+ * @ht: the hash table.
+ * @name: name of the table in the keys, e.g. "sessions".
+ * @buf: output buffer.
+ * @len: size of @buf.
+ *
+ * Writes one "cds_lfht.@name.<key> <value>" line per statistic: the
+ * number of buckets, the approximate number of nodes, the resize
+ * target, whether a resize is in progress, the bucket memory and the
+ * works queued on the resize workqueue. Keys are never renamed nor
+ * reused, new keys are added. As with snprintf(), the output is
+ * truncated to @len, and the complete length returned.
+ * Same calling constraints as cds_lfht_get_mem_info().
+ */
+extern
+size_t cds_lfht_stats_snapshot(struct cds_lfht *ht, const char *name,
+		char *buf, size_t len);
+
+/*
+ * cds_lfht_frozen: immutable read-optimized snapshot of a hash table,
+ * created by cds_lfht_freeze. Opaque to users.
+ */
+struct cds_lfht_frozen;
+
+/*
+ * cds_lfht_freeze - create a read-optimized snapshot of a hash table.
+ * @ht: the hash table.
+ *
+ * Return the snapshot, or NULL on allocation failure.
+ * The snapshot is a flat open-addressing index of the nodes present in
+ * the table: a lookup in the snapshot probes a contiguous array of
+ * (hash, node) slots instead of walking a chain of nodes. The snapshot
+ * is not updated with the table. It holds pointers to the nodes of the
+ * table, which must therefore stay allocated for as long as the
+ * snapshot can be used. It is meant for tables which are built, then
+ * only read: the snapshot can be published to readers with
+ * rcu_assign_pointer, and a replaced snapshot freed with
+ * cds_lfht_frozen_destroy after a grace period.
+ * Nodes added or removed concurrently may or may not be part of the
+ * snapshot.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_lfht_frozen *cds_lfht_freeze(struct cds_lfht *ht);
+
+/*
+ * cds_lfht_frozen_lookup - lookup a node by key in a snapshot.
+ * @frozen: the snapshot.
+ * @hash: the key hash.
+ * @match: the key match function, or NULL to match on the hash only.
+ * @key: the current node key.
+ *
+ * Return the node found, or NULL if not found. When the snapshot holds
+ * several nodes with the same key, any of them is returned.
+ * Does not need the RCU read-side lock, except to protect the snapshot
+ * pointer itself when it is published with rcu_assign_pointer.
+ */
+extern
+struct cds_lfht_node *cds_lfht_frozen_lookup(
+		const struct cds_lfht_frozen *frozen, unsigned long hash,
+		cds_lfht_match_fct match, const void *key);
+
+/*
+ * cds_lfht_frozen_count - number of nodes in a snapshot.
+ * @frozen: the snapshot.
+ */
+extern
+unsigned long cds_lfht_frozen_count(const struct cds_lfht_frozen *frozen);
+
+/*
+ * cds_lfht_frozen_destroy - free a snapshot.
+ * @frozen: the snapshot, or NULL.
+ *
+ * The nodes of the snapshot are not freed. If the snapshot has been
+ * published to RCU readers, a grace period must be waited for before
+ * calling cds_lfht_frozen_destroy.
+ */
+extern
+void cds_lfht_frozen_destroy(struct cds_lfht_frozen *frozen);
+
+/*
+ * cds_lfht_snapshot: read-only memory mapping of a hash table snapshot
+ * file, written by cds_lfht_snapshot_write. Opaque to users.
+ */
+struct cds_lfht_snapshot;
+
+/*
+ * cds_lfht_serialize_fct: write the fixed-size payload of @node into
+ * @payload, which is zero-initialized.
+ */
+typedef void (*cds_lfht_serialize_fct)(struct cds_lfht_node *node,
+		void *payload, void *priv);
+
+/*
+ * cds_lfht_payload_match_fct: return non-zero if @payload holds @key.
+ */
+typedef int (*cds_lfht_payload_match_fct)(const void *payload,
+		const void *key);
+
+/*
+ * cds_lfht_snapshot_write - write a snapshot of a hash table to a file.
+ * @ht: the hash table.
+ * @fd: file descriptor, written from its current offset, which should
+ *      be the start of the file.
+ * @payload_size: size of the payload serialized for each node.
+ * @serialize: serialization callback, called for each node.
+ * @priv: private data passed to @serialize.
+ *
+ * Return 0 on success, negative error value on error.
+ * The file holds the hash of each node along with its payload, and an
+ * open-addressing index of the hashes, so cds_lfht_snapshot_map can
+ * serve lookups from the file without rebuilding anything. The file
+ * is in host byte order, and is rejected by cds_lfht_snapshot_map on
+ * hosts with another byte order.
+ * Nodes added or removed concurrently may or may not be part of the
+ * snapshot.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_lfht_snapshot_write(struct cds_lfht *ht, int fd, size_t payload_size,
+		cds_lfht_serialize_fct serialize, void *priv);
+
+/*
+ * cds_lfht_snapshot_map - map a snapshot file read-only.
+ * @fd: file descriptor of a file written by cds_lfht_snapshot_write.
+ *
+ * Return the snapshot, or NULL with errno set on error (EINVAL if the
+ * file is not a valid snapshot). The file descriptor can be closed
+ * once the snapshot is mapped.
+ *
+ * Lookups can be served from the mapping immediately. To upgrade to a
+ * live hash table, e.g. from a background thread, iterate on the
+ * payloads with cds_lfht_snapshot_get, allocate a node for each, and
+ * build the table with cds_lfht_new_from_array or cds_lfht_add_bulk.
+ * The live table can then be published to readers with
+ * rcu_assign_pointer, and the snapshot unmapped after a grace period.
+ */
+extern
+struct cds_lfht_snapshot *cds_lfht_snapshot_map(int fd);
+
+/*
+ * cds_lfht_snapshot_unmap - unmap a snapshot.
+ * @snap: the snapshot.
+ *
+ * Return 0 on success, negative error value on error. Payloads returned
+ * by the snapshot must not be used anymore.
+ */
+extern
+int cds_lfht_snapshot_unmap(struct cds_lfht_snapshot *snap);
+
+/*
+ * cds_lfht_snapshot_lookup - lookup a payload by key in a snapshot.
+ * @snap: the snapshot.
+ * @hash: the key hash.
+ * @match: the payload match function, or NULL to match on the hash only.
+ * @key: the current key.
+ *
+ * Return the payload found in the mapping, or NULL if not found. When
+ * the snapshot holds several payloads with the same key, any of them
+ * is returned.
+ */
+extern
+const void *cds_lfht_snapshot_lookup(const struct cds_lfht_snapshot *snap,
+		unsigned long hash, cds_lfht_payload_match_fct match,
+		const void *key);
+
+/*
+ * cds_lfht_snapshot_count - number of payloads in a snapshot.
+ * @snap: the snapshot.
+ */
+extern
+unsigned long cds_lfht_snapshot_count(const struct cds_lfht_snapshot *snap);
+
+/*
+ * cds_lfht_snapshot_payload_size - size of the payloads of a snapshot.
+ * @snap: the snapshot.
+ */
+extern
+size_t cds_lfht_snapshot_payload_size(const struct cds_lfht_snapshot *snap);
+
+/*
+ * cds_lfht_snapshot_get - get a payload of a snapshot by index.
+ * @snap: the snapshot.
+ * @index: payload index, from 0 to cds_lfht_snapshot_count - 1.
+ * @hash: (output) hash of the payload node. Can be NULL.
+ *
+ * Return the payload, or NULL if @index is out of range. Payloads are
+ * in the order of a cds_lfht_for_each traversal of the source table.
+ */
+extern
+const void *cds_lfht_snapshot_get(const struct cds_lfht_snapshot *snap,
+		unsigned long index, unsigned long *hash);
+
+/*
+ * cds_lfht_migration: online move of the nodes of a hash table into
+ * another, created by cds_lfht_migrate_begin. Opaque to users.
+ */
+struct cds_lfht_migration;
+
+/*
+ * cds_lfht_migrate_ops: callbacks of a migration, called with @priv.
+ *
+ * hash: hash of the key of @node in the new table.
+ * copy: return a node of the same kind as @node, holding the same
+ *       entry, to add to the new table in its place, or NULL on
+ *       allocation failure. Called within the RCU read-side critical
+ *       section of cds_lfht_migrate_step.
+ * retire: @node is not in any table anymore: free it after a grace
+ *         period, e.g. with call_rcu. Called for each moved node, and
+ *         for the copy of a node removed by another thread while being
+ *         moved.
+ */
+struct cds_lfht_migrate_ops {
+	cds_lfht_node_hash_fct hash;
+	struct cds_lfht_node *(*copy)(struct cds_lfht_node *node, void *priv);
+	void (*retire)(struct cds_lfht_node *node, void *priv);
+};
+
+/*
+ * cds_lfht_migrate_begin - start moving the nodes of a table into another.
+ * @old_ht: the table to empty.
+ * @new_ht: the table to fill, e.g. created with another hash seed,
+ *          memory management backend or maximum size.
+ * @ops: migration callbacks, copied.
+ * @priv: private data passed to the callbacks.
+ *
+ * Return the migration, or NULL on allocation failure or invalid
+ * arguments. The nodes of @old_ht are moved by cds_lfht_migrate_step,
+ * while the two tables stay usable by readers and updaters:
+ * - lookups use cds_lfht_migrate_lookup, given the hash of the key in
+ *   each table, and unique adds use cds_lfht_migrate_add_unique,
+ * - other adds go to @new_ht, with the hash of the new table,
+ * - nodes are removed, or replaced with cds_lfht_replace, in the table
+ *   cds_lfht_migrate_lookup returned.
+ * cds_lfht_add_replace is not supported on either table until the
+ * migration is complete. No write freeze is needed, and the nodes added
+ * concurrently are not lost: they are added to @new_ht.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_lfht_migration *cds_lfht_migrate_begin(struct cds_lfht *old_ht,
+		struct cds_lfht *new_ht, const struct cds_lfht_migrate_ops *ops,
+		void *priv);
+
+/*
+ * cds_lfht_migrate_step - move nodes of the old table into the new one.
+ * @m: the migration.
+ * @nr: maximum number of nodes to move.
+ *
+ * Return 1 if nodes remain to be moved, 0 once the old table is empty,
+ * -ENOMEM if the copy callback failed. Each node is added to the new
+ * table before being removed from the old one, so that lookups find it
+ * in either table all along.
+ * Each call starts from the first node of the old table: move batches
+ * of nodes, releasing the RCU read-side lock between calls to let grace
+ * periods complete. Must not be called concurrently on a migration.
+ * Once it returns 0, switch the readers to the new table, wait for a
+ * grace period, then free the migration and destroy the old table.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_lfht_migrate_step(struct cds_lfht_migration *m, unsigned long nr);
+
+/*
+ * cds_lfht_migrate_lookup - lookup a node by key in a migrating table.
+ * @m: the migration.
+ * @old_hash: the key hash in the old table.
+ * @new_hash: the key hash in the new table.
+ * @match: the key match function, or NULL to match on the hash only.
+ * @key: the current node key.
+ * @iter: node, if found (output). *iter->node set to NULL if not found.
+ *
+ * Return the table the node was found in, or NULL if not found.
+ * Searches the old table, then the new one. A node removed while being
+ * moved can be found in the new table until its mover removes its copy.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+struct cds_lfht *cds_lfht_migrate_lookup(struct cds_lfht_migration *m,
+		unsigned long old_hash, unsigned long new_hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_migrate_add_unique - add a node with unique key to a migrating
+ *                               table.
+ * @m: the migration.
+ * @old_hash: the key hash in the old table.
+ * @new_hash: the key hash in the new table.
+ * @match: the key match function.
+ * @key: the node's key.
+ * @node: the node to try adding, to the new table.
+ *
+ * Return the node added, or the node matching @key in either table, as
+ * cds_lfht_add_unique.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function issues a full memory barrier before and after its
+ * atomic commit.
+ */
+extern
+struct cds_lfht_node *cds_lfht_migrate_add_unique(
+		struct cds_lfht_migration *m,
+		unsigned long old_hash, unsigned long new_hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_migrate_destroy - free a migration.
+ * @m: the migration.
+ *
+ * Neither table is freed. If readers use the migration, a grace period
+ * must be waited for before calling cds_lfht_migrate_destroy.
+ */
+extern
+void cds_lfht_migrate_destroy(struct cds_lfht_migration *m);
+
+/*
+ * cds_lfht_filter_rebuild - build the membership filter of a table.
+ * @ht: the hash table.
+ * @nr_entries: number of nodes to size the filter for, or 0 for the
+ *              number of nodes currently in the table.
+ *
+ * Once a table has a membership filter, cds_lfht_lookup and
+ * cds_lfht_lookup_many return without walking the chain for the hashes
+ * the filter excludes, which is the case of about 99% of the misses
+ * while the table holds up to @nr_entries nodes: a miss then costs one
+ * cache line instead of the chain up to the next bucket node. Adds set
+ * the filter bits of their hash, but removals do not clear them, and
+ * the false positive rate rises past @nr_entries: rebuild the filter
+ * periodically, e.g. once many nodes were removed, or the table grew.
+ * Lookups and updates go on during the rebuild, the new filter being
+ * built from a traversal of the table and replacing the current one
+ * with rcu_assign_pointer once complete.
+ * The filter is only keyed on the hash: it does not help tables whose
+ * misses hash as hits do, e.g. when matching on part of the key.
+ * Return 0 on success, -ENOMEM if the filter cannot be allocated, in
+ * which case the current filter is kept.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * cds_lfht_filter_rebuild should *not* be called from a RCU read-side
+ * critical section: it waits for grace periods.
+ */
+extern
+int cds_lfht_filter_rebuild(struct cds_lfht *ht, unsigned long nr_entries);
+
+/*
+ * cds_lfht_filter_disable - remove the membership filter of a table.
+ * @ht: the hash table.
+ *
+ * The filter is freed after a grace period.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * cds_lfht_filter_disable should *not* be called from a RCU read-side
+ * critical section.
+ */
+extern
+void cds_lfht_filter_disable(struct cds_lfht *ht);
+
+/* Default per-CPU capacity of a change log. */
+#define CDS_LFHT_CHANGELOG_CAPACITY	1024
+
+enum cds_lfht_change_type {
+	CDS_LFHT_CHANGE_ADD,		/* node added */
+	CDS_LFHT_CHANGE_REPLACE,	/* node replaced a node of its key */
+	CDS_LFHT_CHANGE_DEL,		/* node removed */
+};
+
+/*
+ * cds_lfht_change: an update of a table, returned by
+ * cds_lfht_changelog_drain.
+ */
+struct cds_lfht_change {
+	struct cds_lfht_node *node;
+	unsigned long hash;
+	enum cds_lfht_change_type type;
+};
 
 /*
- * cds_lfht_destroy - destroy a hash table.
- * @ht: the hash table to destroy.
- * @attr: (output) resize worker thread attributes, as received by cds_lfht_new.
- *        The caller will typically want to free this pointer if dynamically
- *        allocated. The attr point can be NULL if the caller does not
- *        need to be informed of the value passed to cds_lfht_new().
+ * cds_lfht_changelog_enable - start logging the updates of a table.
+ * @ht: the hash table.
+ * @capacity: changes kept per CPU until drained, rounded up to a power
+ *            of 2, or 0 for CDS_LFHT_CHANGELOG_CAPACITY.
  *
- * Return 0 on success, negative error value on error.
+ * Once enabled, each successful cds_lfht_add, cds_lfht_add_bulk,
+ * cds_lfht_add_unique, cds_lfht_lookup_or_add, cds_lfht_add_replace,
+ * cds_lfht_replace and cds_lfht_del appends a change to a ring of the
+ * CPU it runs on, so that a replica can be kept in sync at a cost
+ * proportional to the number of changes, rather than by traversing
+ * the table. When the ring of a CPU is full, the change is dropped and
+ * the next drain reports an overflow, as does a cds_lfht_clear: the
+ * consumer then has to resync from a traversal.
+ * Return 0 on success, -ENOMEM, or -EBUSY if the table already has a
+ * change log.
+ */
+extern
+int cds_lfht_changelog_enable(struct cds_lfht *ht, unsigned long capacity);
 
- * Prior to liburcu 0.10:
- * - Threads calling this API need to be registered RCU read-side
- *   threads.
- * - cds_lfht_destroy should *not* be called from a RCU read-side
- *   critical section. It should *not* be called from a call_rcu thread
- *   context neither.
+/*
+ * cds_lfht_changelog_disable - stop logging the updates of a table.
+ * @ht: the hash table.
  *
- * Starting from liburcu 0.10, rculfhash implements its own worker
- * thread to handle resize operations, which removes RCU requirements on
- * cds_lfht_destroy.
+ * The changes not drained are lost. Must not be called concurrently
+ * with cds_lfht_changelog_drain.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * cds_lfht_changelog_disable should *not* be called from a RCU
+ * read-side critical section: it waits for a grace period.
  */
 extern
-int cds_lfht_destroy(struct cds_lfht *ht, pthread_attr_t **attr);
+void cds_lfht_changelog_disable(struct cds_lfht *ht);
 
 /*
- * cds_lfht_count_nodes - count the number of nodes in the hash table.
+ * cds_lfht_changelog_drain - take the logged changes of a table.
  * @ht: the hash table.
- * @split_count_before: sample the node count split-counter before traversal.
- * @count: traverse the hash table, count the number of nodes observed.
- * @split_count_after: sample the node count split-counter after traversal.
+ * @changes: array of @nr changes (output).
+ * @nr: maximum number of changes to take.
+ * @overflow: set to 1 if changes were lost since the previous drain,
+ *            0 otherwise. Can be NULL.
  *
+ * Return the number of changes taken, in the order of each CPU, but
+ * not ordered between CPUs: two updates of a key from distinct CPUs
+ * may be returned in either order. Rather than replaying the changes,
+ * take them as the hashes which changed, and look up the current
+ * nodes of those hashes. The nodes of CDS_LFHT_CHANGE_DEL changes, and
+ * nodes removed since their change, may have been freed: only use them
+ * to identify the entries, unless the nodes are freed once their
+ * changes are drained.
  * Call with rcu_read_lock held.
  * Threads calling this API need to be registered RCU read-side threads.
  */
 extern
-void cds_lfht_count_nodes(struct cds_lfht *ht,
-		long *split_count_before,
-		unsigned long *count,
-		long *split_count_after);
+unsigned long cds_lfht_changelog_drain(struct cds_lfht *ht,
+		struct cds_lfht_change *changes, unsigned long nr,
+		int *overflow);
 
 /*
  * cds_lfht_lookup - lookup a node by key.
  * @ht: the hash table.
  * @hash: the key hash.
- * @match: the key match function.
+ * @match: the key match function, or NULL to match on the hash only.
  * @key: the current node key.
  * @iter: node, if found (output). *iter->node set to NULL if not found.
  *
  * Call with rcu_read_lock held.
  * Threads calling this API need to be registered RCU read-side threads.
  * This function acts as a rcu_dereference() to read the node pointer.
+ * With _LGPL_SOURCE, the chain traversal and the match function are
+ * inlined in the caller.
  */
 extern
 void cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
 		cds_lfht_match_fct match, const void *key,
 		struct cds_lfht_iter *iter);
 
+/*
+ * cds_lfht_lookup_many - lookup an array of nodes by key.
+ * @ht: the hash table.
+ * @nr: number of keys to lookup.
+ * @hashes: array of @nr key hashes.
+ * @match: the key match function, or NULL to match on the hash only.
+ * @keys: array of @nr keys.
+ * @iters: array of @nr iterators (output). iters[i].node is set to the
+ *         node matching keys[i], or NULL if not found.
+ *
+ * Equivalent to calling cds_lfht_lookup() for each key, but the hash
+ * chains are walked in an interleaved fashion, prefetching the next
+ * node of each chain, so the cache misses of the lookups overlap.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointers.
+ */
+extern
+void cds_lfht_lookup_many(struct cds_lfht *ht, unsigned long nr,
+		const unsigned long *hashes, cds_lfht_match_fct match,
+		const void **keys, struct cds_lfht_iter *iters);
+
+/*
+ * cds_lfht_lookup_key8 - lookup a node with an inline key by key.
+ * cds_lfht_lookup_key16
+ * cds_lfht_lookup_key32
+ * @ht: the hash table, of struct cds_lfht_node_key8 (resp. key16, key32)
+ *      nodes.
+ * @hash: the key hash.
+ * @key: the 8 (resp. 16, 32) bytes of the key, with no alignment
+ *       requirement.
+ * @iter: node, if found (output). *iter->node set to NULL if not found.
+ *
+ * Equivalent to cds_lfht_lookup() with cds_lfht_match_key8() (resp.
+ * key16, key32), but the key comparison is inlined in the chain
+ * traversal, and is a few word compares of the cache line of the node.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_lookup_key8(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter);
+extern
+void cds_lfht_lookup_key16(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter);
+extern
+void cds_lfht_lookup_key32(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter);
+
+/*
+ * Lookup cache: a direct-mapped cache of the nodes found by the lookups
+ * of a thread in a table, which lets repeated lookups of the same keys
+ * skip the walk of their hash chain. It is emptied whenever a node was
+ * removed or replaced in the table since it was filled, and hits on a
+ * node being removed concurrently are ignored: a hit therefore finds
+ * the node cds_lfht_lookup() would find, including across read-side
+ * critical sections. Misses are not cached. A lookup cache is private
+ * to the thread using it.
+ */
+struct cds_lfht_lookup_cache;
+
+/*
+ * cds_lfht_lookup_cache_create - create a lookup cache of a table.
+ * @ht: the hash table.
+ * @nr_entries: number of cached nodes, rounded up to a power of 2.
+ *
+ * Returns NULL on error. Removals from @ht maintain a generation count
+ * once it has a lookup cache, for which this function waits for a
+ * grace period: call it from a registered RCU thread, outside of any
+ * read-side critical section.
+ */
+extern
+struct cds_lfht_lookup_cache *cds_lfht_lookup_cache_create(struct cds_lfht *ht,
+		unsigned long nr_entries);
+
+/*
+ * cds_lfht_lookup_cache_destroy - destroy a lookup cache.
+ * @cache: the cache, which must be destroyed before its table.
+ */
+extern
+void cds_lfht_lookup_cache_destroy(struct cds_lfht_lookup_cache *cache);
+
+/*
+ * cds_lfht_lookup_cached - lookup a node by key through a lookup cache.
+ * @cache: the lookup cache of the hash table.
+ * @hash: the key hash.
+ * @match: the key match function, or NULL to match on the hash only.
+ * @key: the current node key.
+ * @iter: node, if found (output). *iter->node set to NULL if not found.
+ *
+ * Equivalent to cds_lfht_lookup() on the table of @cache. @match is
+ * called on the cached node of @hash: all the lookups through @cache
+ * must use the same match function.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_lookup_cached(struct cds_lfht_lookup_cache *cache,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter);
+
 /*
  * cds_lfht_next_duplicate - get the next item with same key, after iterator.
  * @ht: the hash table.
- * @match: the key match function.
+ * @match: the key match function, or NULL to match on the hash only.
  * @key: the current node key.
  * @iter: input: current iterator.
  *        output: node, if found. *iter->node set to NULL if not found.
@@ -277,6 +1312,119 @@ void cds_lfht_first(struct cds_lfht *ht, struct cds_lfht_iter *iter);
 extern
 void cds_lfht_next(struct cds_lfht *ht, struct cds_lfht_iter *iter);
 
+/*
+ * cds_lfht_first_in_range - get the first node of a range of the table.
+ * @ht: the hash table.
+ * @start: first range of the slice.
+ * @end: range following the last range of the slice.
+ * @nr_ranges: number of ranges the table is split into (power of 2).
+ * @iter: First node, if exists (output). *iter->node set to NULL if not found.
+ *
+ * The table is split into @nr_ranges disjoint ranges following the
+ * order of traversal, independently of its current size. Traversing
+ * [@start, @end) with cds_lfht_first_in_range and
+ * cds_lfht_next_in_range lets several threads walk disjoint slices
+ * of the table in parallel: together, the slices [0, nr_ranges)
+ * visit the same nodes as a cds_lfht_for_each traversal, even across
+ * a concurrent resize.
+ * Output in "*iter". *iter->node set to NULL if the slice is empty.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_first_in_range(struct cds_lfht *ht, unsigned long start,
+		unsigned long end, unsigned long nr_ranges,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_next_in_range - get the next node of a range of the table.
+ * @ht: the hash table.
+ * @end: range following the last range of the slice.
+ * @nr_ranges: number of ranges the table is split into (power of 2).
+ * @iter: input: current iterator.
+ *        output: next node, if exists. *iter->node set to NULL if not found.
+ *
+ * @end and @nr_ranges must be those given to cds_lfht_first_in_range.
+ * Input/Output in "*iter". *iter->node set to NULL if *iter was
+ * pointing to the last node of the slice.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_next_in_range(struct cds_lfht *ht, unsigned long end,
+		unsigned long nr_ranges, struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_lookup_range - get the first node of a hash range.
+ * @ht: the hash table.
+ * @hash_lo: lowest hash of the range.
+ * @hash_hi: highest hash of the range (inclusive).
+ * @iter: First node, if exists (output). Use
+ *        cds_lfht_range_iter_get_node to get the node, and iter->iter
+ *        to remove it.
+ *
+ * Nodes are kept in bit-reversed hash order, so the hashes of a range
+ * are scattered over the table. When the range is narrower than the
+ * number of buckets, each of its hashes is looked up, and nodes are
+ * returned by increasing hash: the cost is proportional to the width
+ * of the range, not to the number of nodes. Otherwise, the whole table
+ * is traversed. As with cds_lfht_for_each, nodes added or removed
+ * concurrently may or may not be returned. Use cds_lfht_for_each_in_range
+ * to split a table into parallel traversals instead.
+ * Output in "*iter". *iter->iter.node set to NULL if the range is empty.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_lookup_range(struct cds_lfht *ht, unsigned long hash_lo,
+		unsigned long hash_hi, struct cds_lfht_range_iter *iter);
+
+/*
+ * cds_lfht_next_range - get the next node of a hash range.
+ * @ht: the hash table.
+ * @iter: input: current iterator, set by cds_lfht_lookup_range.
+ *        output: next node, if exists. *iter->iter.node set to NULL if
+ *        not found.
+ *
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_next_range(struct cds_lfht *ht, struct cds_lfht_range_iter *iter);
+
+/*
+ * cds_lfht_cursor_next - get the next node of a resumable traversal.
+ * @ht: the hash table.
+ * @cursor: the cursor, initialized by cds_lfht_cursor_init.
+ *
+ * Return the first node of the table on the first call, then the node
+ * following the previous one in the order of cds_lfht_for_each, or
+ * NULL once the traversal is complete. Within a RCU read-side critical
+ * section, the cursor steps from node to node as cds_lfht_next. Once
+ * paused with cds_lfht_cursor_pause, the critical section can be left
+ * and the nodes returned freed: the next call, in another critical
+ * section, looks the position up again from the bucket preceding it,
+ * which stays correct across resizes since the order of the nodes does
+ * not depend on the table size. A sweep of a large table can thus
+ * release the read-side lock, or go through a quiescent state, every
+ * few nodes without holding up grace periods.
+ * As with cds_lfht_for_each, nodes added or removed concurrently may
+ * or may not be returned. The nodes present during the whole traversal
+ * are returned once, except when nodes with the same hash as the
+ * position are added or removed while the cursor is paused, in which
+ * case one of them may be skipped or returned twice.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+struct cds_lfht_node *cds_lfht_cursor_next(struct cds_lfht *ht,
+		struct cds_lfht_cursor *cursor);
+
 /*
  * cds_lfht_add - add a node to the hash table.
  * @ht: the hash table.
@@ -293,11 +1441,62 @@ extern
 void cds_lfht_add(struct cds_lfht *ht, unsigned long hash,
 		struct cds_lfht_node *node);
 
+/*
+ * cds_lfht_add_hint - add a node to the hash table, starting from a hint.
+ * @ht: the hash table.
+ * @hash: the key hash.
+ * @node: the node to add.
+ * @hint: iterator on a node of @ht, or with a NULL node (input). Set on
+ *        @node (output).
+ *
+ * Equivalent to cds_lfht_add(), but the walk to the insert location
+ * starts from the hint node, rather than from the bucket, if it is in
+ * the same bucket, not removed, and does not follow @hash in split-order
+ * (bit-reversed hash order). Passing the same iterator to consecutive
+ * calls adds keys clustered in a bucket, e.g. sharing their low-order
+ * hash bits, in increasing bit-reversed hash order without walking the
+ * chain each time; other hints fall back on the bucket walk. As chains
+ * are only measured from the hint, tables mostly filled this way should
+ * be created with CDS_LFHT_ACCOUNTING to be resized automatically.
+ * This function supports adding redundant keys into the table.
+ * Call with rcu_read_lock held. The hint node must not have been freed:
+ * it must have been obtained within the same RCU read-side critical
+ * section, or not be removed from @ht meanwhile.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function issues a full memory barrier before and after its
+ * atomic commit.
+ */
+extern
+void cds_lfht_add_hint(struct cds_lfht *ht, unsigned long hash,
+		struct cds_lfht_node *node, struct cds_lfht_iter *hint);
+
+/*
+ * cds_lfht_add_bulk - add an array of nodes to the hash table.
+ * @ht: the hash table.
+ * @entries: array of (hash, node) pairs to add.
+ * @nr_entries: number of entries in the array.
+ *
+ * Equivalent to calling cds_lfht_add() for each entry, but the entries
+ * are inserted in split-order, and node accounting and automatic resize
+ * checks are performed once for the whole batch. The @entries array is
+ * sorted in place.
+ * This function supports adding redundant keys into the table.
+ * Call with rcu_read_lock held. Very large batches should be split by
+ * the caller to avoid delaying grace periods.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function issues a full memory barrier before and after each
+ * node's atomic commit.
+ */
+extern
+void cds_lfht_add_bulk(struct cds_lfht *ht,
+		struct cds_lfht_bulk_entry *entries,
+		unsigned long nr_entries);
+
 /*
  * cds_lfht_add_unique - add a node to hash table, if key is not present.
  * @ht: the hash table.
  * @hash: the node's hash.
- * @match: the key match function.
+ * @match: the key match function, or NULL to match on the hash only.
  * @key: the node's key.
  * @node: the node to try adding.
  *
@@ -327,11 +1526,48 @@ struct cds_lfht_node *cds_lfht_add_unique(struct cds_lfht *ht,
 		const void *key,
 		struct cds_lfht_node *node);
 
+/*
+ * cds_lfht_lookup_or_add - lookup a node, constructing and adding it if
+ * the key is not present.
+ * @ht: the hash table.
+ * @hash: the key's hash.
+ * @match: the key match function, or NULL to match on the hash only.
+ * @key: the key.
+ * @ctor_fct: constructs the node of @key. May return NULL, e.g. on
+ *            allocation failure. Does not need to initialize the node.
+ * @free_fct: frees a node constructed by @ctor_fct but not added.
+ * @priv: private data passed to @ctor_fct and @free_fct.
+ *
+ * Same as a cds_lfht_lookup() followed, on a miss, by the construction
+ * of a node and a cds_lfht_add_unique(), but in a single walk of the
+ * hash chain: @ctor_fct is only called on reaching the insert location
+ * without finding @key. It is called at most once. Should a concurrent
+ * add of @key win the race between the construction and the insertion,
+ * the constructed node, never published, is passed to @free_fct, which
+ * does NOT need to wait for a grace period.
+ *
+ * Return the node added, or the unique node already present. Return
+ * NULL if @ctor_fct returned NULL.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ *
+ * Same key uniqueness guarantee and memory barriers as
+ * cds_lfht_add_unique().
+ */
+extern
+struct cds_lfht_node *cds_lfht_lookup_or_add(struct cds_lfht *ht,
+		unsigned long hash,
+		cds_lfht_match_fct match,
+		const void *key,
+		struct cds_lfht_node *(*ctor_fct)(const void *key, void *priv),
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv);
+
 /*
  * cds_lfht_add_replace - replace or add a node within hash table.
  * @ht: the hash table.
  * @hash: the node's hash.
- * @match: the key match function.
+ * @match: the key match function, or NULL to match on the hash only.
  * @key: the node's key.
  * @node: the node to add.
  *
@@ -369,7 +1605,7 @@ struct cds_lfht_node *cds_lfht_add_replace(struct cds_lfht *ht,
  * @ht: the hash table.
  * @old_iter: the iterator position of the node to replace.
  * @hash: the node's hash.
- * @match: the key match function.
+ * @match: the key match function, or NULL to match on the hash only.
  * @key: the node's key.
  * @new_node: the new node to use as replacement.
  *
@@ -401,6 +1637,43 @@ int cds_lfht_replace(struct cds_lfht *ht,
 		const void *key,
 		struct cds_lfht_node *new_node);
 
+/*
+ * In-place value updates.
+ *
+ * Replacing a node to change the value of its key costs a node
+ * allocation, the removal flagging of cds_lfht_replace(), and a grace
+ * period deferral of the old node. When only the value changes, the
+ * node can instead stay in the table and refer to its value through an
+ * RCU-protected pointer, updated with the macros below:
+ *
+ *	struct mynode {
+ *		struct cds_lfht_node node;
+ *		int key;
+ *		struct myvalue *value;
+ *		struct rcu_head rcu_head;
+ *	};
+ *
+ * - Readers use cds_lfht_value_get() on the node returned by a lookup,
+ *   within the same RCU read-side critical section.
+ * - Updaters, also within a read-side critical section, exchange the
+ *   pointer with cds_lfht_value_xchg(), or cds_lfht_value_cmpxchg() for
+ *   read-modify-write updates, and free the old value after a grace
+ *   period, e.g. with call_rcu(), which batches the callbacks of all
+ *   the updates of a grace period. Each old value is returned to
+ *   exactly one updater.
+ * - The freeing of a removed node, after a grace period, also frees
+ *   its current value: no updater can still exchange it by then.
+ *
+ * Values fitting in a machine word, such as counters, need no pointer:
+ * update them in the node with uatomic_*() and read them with
+ * CMM_LOAD_SHARED(). These macros require the header of an RCU flavor.
+ */
+#define cds_lfht_value_get(value)		rcu_dereference(value)
+#define cds_lfht_value_set(value, v)		rcu_set_pointer(&(value), v)
+#define cds_lfht_value_xchg(value, v)		rcu_xchg_pointer(&(value), v)
+#define cds_lfht_value_cmpxchg(value, old, v)	\
+	rcu_cmpxchg_pointer(&(value), old, v)
+
 /*
  * cds_lfht_del - remove node pointed to by iterator from hash table.
  * @ht: the hash table.
@@ -425,6 +1698,74 @@ int cds_lfht_replace(struct cds_lfht *ht,
 extern
 int cds_lfht_del(struct cds_lfht *ht, struct cds_lfht_node *node);
 
+/*
+ * cds_lfht_del_free - remove a node, and free it after a grace period.
+ * @ht: the hash table.
+ * @node: the node to delete.
+ * @free_fct: called on @node after a grace period, e.g. to free the
+ *            object containing it, found with caa_container_of.
+ *
+ * Return 0 if the node is successfully removed, negative value
+ * otherwise, as cds_lfht_del, whose rules apply, or -ENOMEM, leaving
+ * the node in the table, if no batch could be allocated.
+ * Replaces a cds_lfht_del followed by a call_rcu, without a struct
+ * rcu_head in the object: the removed nodes are batched in a per-thread
+ * page-sized array, queued with a single call_rcu of the flavor of the
+ * table once full, or when the table flavor or @free_fct changes, and
+ * freed in a loop after the grace period.
+ * Threads should call cds_lfht_del_free_flush before they unregister
+ * from their RCU flavor, and must call it before a rcu_barrier meant
+ * to wait for their nodes to be freed. A thread exiting without
+ * flushing waits for a grace period and frees its batch from a
+ * thread-specific data destructor.
+ */
+extern
+int cds_lfht_del_free(struct cds_lfht *ht, struct cds_lfht_node *node,
+		void (*free_fct)(struct cds_lfht_node *node));
+
+/*
+ * cds_lfht_del_free_flush - queue the nodes batched by cds_lfht_del_free.
+ *
+ * Queues the nodes removed by cds_lfht_del_free in the calling thread,
+ * so that they are freed after a following grace period, and by a
+ * following rcu_barrier.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void cds_lfht_del_free_flush(void);
+
+/*
+ * cds_lfht_del_if - remove the nodes matching a predicate.
+ * @ht: the hash table.
+ * @pred: returns non-zero for the nodes to remove.
+ * @free_fct: called on each removed node, after a grace period.
+ * @priv: private data passed to @pred and @free_fct.
+ * @nr_threads: number of threads sharing the work, 0 to choose it from
+ *              the table size and the number of CPUs as cds_lfht_clear.
+ *
+ * Return the number of nodes removed, or -ENOMEM if memory ran out, in
+ * which case some matching nodes may remain.
+ * The table is split in ranges of buckets, each walked within its own
+ * RCU read-side critical section. Matching nodes are removed as with
+ * cds_lfht_del, but unlinked by a single pass over the chain for several
+ * of them, and each thread waits for a single grace period before
+ * freeing those it removed. @pred may be called concurrently from
+ * several threads, within RCU read-side critical sections, and should
+ * not block; @free_fct may be called concurrently from several threads
+ * registered as RCU read-side threads, and should not wait for a grace
+ * period itself.
+ * Concurrent updates are allowed: nodes added or removed meanwhile may
+ * or may not be passed to @pred.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * cds_lfht_del_if should *not* be called from a RCU read-side critical
+ * section, nor from a call_rcu thread context.
+ */
+extern
+long cds_lfht_del_if(struct cds_lfht *ht,
+		int (*pred)(struct cds_lfht_node *node, void *priv),
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv, unsigned long nr_threads);
+
 /*
  * cds_lfht_is_node_deleted - query whether a node is removed from hash table.
  *
@@ -454,6 +1795,99 @@ int cds_lfht_is_node_deleted(struct cds_lfht_node *node);
 extern
 void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size);
 
+/*
+ * cds_lfht_trim - Shrink an idle hash table to fit its nodes
+ * @ht: the hash table.
+ *
+ * Shrink the table to the smallest size meeting the target load order
+ * of its resize policy for its current number of nodes, without waiting
+ * for automatic resize, which requires CDS_LFHT_AUTO_RESIZE and
+ * CDS_LFHT_ACCOUNTING, and a churn of removals to trigger. The bucket
+ * tables removed, including those of a previous shrink still waiting
+ * for a grace period, are freed before returning: the mmap backends
+ * give their pages back to the system. The number of nodes is read from
+ * the split-counters with CDS_LFHT_ACCOUNTING, and counted by walking
+ * the table otherwise. The table never grows.
+ *
+ * Return the number of buckets after the trim.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * cds_lfht_trim should *not* be called from a RCU read-side critical
+ * section, as it waits for a grace period.
+ */
+extern
+unsigned long cds_lfht_trim(struct cds_lfht *ht);
+
+/*
+ * cds_lfht_resize_handle: resize in progress, returned by
+ * cds_lfht_resize_async. Opaque to users.
+ */
+struct cds_lfht_resize_handle;
+
+/*
+ * cds_lfht_resize_done_fct - resize completion callback.
+ * @ht: the hash table.
+ * @size: the hash table size after the resize.
+ * @priv: private data passed to cds_lfht_resize_async.
+ *
+ * Called from the resize worker thread, outside of RCU read-side
+ * critical section. It should not wait for the resize handle.
+ */
+typedef void (*cds_lfht_resize_done_fct)(struct cds_lfht *ht,
+		unsigned long size, void *priv);
+
+/*
+ * cds_lfht_resize_async - resize a hash table in the background.
+ * @ht: the hash table, created with CDS_LFHT_AUTO_RESIZE.
+ * @new_size: update to this hash table size.
+ * @done_fct: called when the resize completes, or NULL.
+ * @priv: private data passed to @done_fct.
+ *
+ * Queues the resize to the resize worker thread of the table, and
+ * returns at once. Return a handle to poll or wait for the resize, to
+ * be freed with cds_lfht_resize_handle_destroy, or NULL with errno set
+ * to EINVAL if the table does not resize automatically, or ENOMEM.
+ * As with cds_lfht_resize, the table size may differ from @new_size
+ * after completion if other resizes are concurrent.
+ */
+extern
+struct cds_lfht_resize_handle *cds_lfht_resize_async(struct cds_lfht *ht,
+		unsigned long new_size, cds_lfht_resize_done_fct done_fct,
+		void *priv);
+
+/*
+ * cds_lfht_resize_poll - get the progress of an asynchronous resize.
+ * @handle: the resize handle.
+ * @nr_done: number of bucket nodes initialized or removed (output), or
+ *           NULL.
+ * @nr_total: number of bucket nodes to initialize or remove (output),
+ *            or NULL. 0 until the resize worker starts the resize.
+ *
+ * Return 1 once the resize, including its completion callback, is
+ * complete, 0 otherwise. The progress is sampled without waiting.
+ */
+extern
+int cds_lfht_resize_poll(struct cds_lfht_resize_handle *handle,
+		unsigned long *nr_done, unsigned long *nr_total);
+
+/*
+ * cds_lfht_resize_wait - wait for an asynchronous resize to complete.
+ * @handle: the resize handle.
+ *
+ * Should *not* be called from a RCU read-side critical section, nor
+ * from the completion callback.
+ */
+extern
+void cds_lfht_resize_wait(struct cds_lfht_resize_handle *handle);
+
+/*
+ * cds_lfht_resize_handle_destroy - free an asynchronous resize handle.
+ * @handle: the resize handle.
+ *
+ * Return 0 on success, -EBUSY if the resize is not complete.
+ */
+extern
+int cds_lfht_resize_handle_destroy(struct cds_lfht_resize_handle *handle);
+
 /*
  * Note: it is safe to perform element removal (del), replacement, or
  * any hash table update operation during any of the following hash
@@ -467,6 +1901,20 @@ void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size);
 		cds_lfht_next(ht, iter),				\
 			node = cds_lfht_iter_get_node(iter))
 
+#define cds_lfht_for_each_in_range(ht, start, end, nr_ranges, iter, node) \
+	for (cds_lfht_first_in_range(ht, start, end, nr_ranges, iter),	\
+			node = cds_lfht_iter_get_node(iter);		\
+		node != NULL;						\
+		cds_lfht_next_in_range(ht, end, nr_ranges, iter),	\
+			node = cds_lfht_iter_get_node(iter))
+
+#define cds_lfht_for_each_range(ht, hash_lo, hash_hi, iter, node)	\
+	for (cds_lfht_lookup_range(ht, hash_lo, hash_hi, iter),		\
+			node = cds_lfht_range_iter_get_node(iter);	\
+		node != NULL;						\
+		cds_lfht_next_range(ht, iter),				\
+			node = cds_lfht_range_iter_get_node(iter))
+
 #define cds_lfht_for_each_duplicate(ht, hash, match, key, iter, node)	\
 	for (cds_lfht_lookup(ht, hash, match, key, iter),		\
 			node = cds_lfht_iter_get_node(iter);		\
@@ -497,4 +1945,22 @@ void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size);
 }
 #endif
 
+#ifdef _LGPL_SOURCE
+
+/*
+ * Inline the lookup fast-path, and the match function when it is a
+ * compile-time constant, into LGPL-compatible code.
+ */
+#include <urcu/static/rculfhash.h>
+
+#define cds_lfht_lookup			_cds_lfht_lookup
+#define cds_lfht_lookup_key8		_cds_lfht_lookup_key8
+#define cds_lfht_lookup_key16		_cds_lfht_lookup_key16
+#define cds_lfht_lookup_key32		_cds_lfht_lookup_key32
+#define cds_lfht_match_key8		_cds_lfht_match_key8
+#define cds_lfht_match_key16		_cds_lfht_match_key16
+#define cds_lfht_match_key32		_cds_lfht_match_key32
+
+#endif /* _LGPL_SOURCE */
+
 #endif /* _URCU_RCULFHASH_H */
@@ -41,6 +41,8 @@ struct cds_lfq_queue_rcu {
 	struct cds_lfq_node_rcu *head, *tail;
 	void (*queue_call_rcu)(struct rcu_head *head,
 		void (*func)(struct rcu_head *head));
+	/* Stack of dummy nodes past their grace period, for reuse. */
+	struct cds_lfq_node_rcu *dummy_cache;
 };
 
 #ifdef _LGPL_SOURCE
@@ -52,6 +54,7 @@ struct cds_lfq_queue_rcu {
 #define cds_lfq_destroy_rcu		_cds_lfq_destroy_rcu
 #define cds_lfq_enqueue_rcu		_cds_lfq_enqueue_rcu
 #define cds_lfq_dequeue_rcu		_cds_lfq_dequeue_rcu
+#define cds_lfq_dequeue_bulk_rcu	_cds_lfq_dequeue_bulk_rcu
 
 #else /* !_LGPL_SOURCE */
 
@@ -62,6 +65,10 @@ extern void cds_lfq_init_rcu(struct cds_lfq_queue_rcu *q,
 /*
  * The queue should be emptied before calling destroy.
  *
+ * Dummy nodes are recycled into the queue by call_rcu callbacks, so the
+ * queue memory should only be freed once the callbacks queued before
+ * destroy have been executed, e.g. after rcu_barrier().
+ *
  * Return 0 on success, -EPERM if queue is not empty.
  */
 extern int cds_lfq_destroy_rcu(struct cds_lfq_queue_rcu *q);
@@ -82,6 +89,18 @@ extern void cds_lfq_enqueue_rcu(struct cds_lfq_queue_rcu *q,
 extern
 struct cds_lfq_node_rcu *cds_lfq_dequeue_rcu(struct cds_lfq_queue_rcu *q);
 
+/*
+ * Should be called under rcu read lock critical section.
+ *
+ * Dequeues up to @n nodes into @nodes, oldest first, with a single
+ * successful cmpxchg. The caller must wait for a grace period to pass
+ * before freeing the returned nodes or modifying their cds_lfq_node_rcu
+ * structure. Returns the number of nodes dequeued, 0 if queue is empty.
+ */
+extern
+unsigned long cds_lfq_dequeue_bulk_rcu(struct cds_lfq_queue_rcu *q,
+		struct cds_lfq_node_rcu **nodes, unsigned long n);
+
 #endif /* !_LGPL_SOURCE */
 
 #ifdef __cplusplus
@@ -50,6 +50,31 @@ void cds_list_add_tail_rcu(struct cds_list_head *newp,
 	head->prev = newp;
 }
 
+/*
+ * Add new element before the first element @cmp orders after it, i.e.
+ * for which cmp(newp, pos) < 0, keeping a list sorted by @cmp in
+ * place: equal elements keep their insertion order. Readers traverse a
+ * sorted list at all times, so they may stop at the first element past
+ * the one they look for. Removal with cds_list_del_rcu() keeps the
+ * list sorted as well. Mutual exclusion against concurrent updates is
+ * required. O(n).
+ */
+static inline
+void cds_list_add_sorted_rcu(struct cds_list_head *newp,
+		struct cds_list_head *head,
+		int (*cmp)(const struct cds_list_head *a,
+			const struct cds_list_head *b))
+{
+	struct cds_list_head *pos;
+
+	for (pos = head->next; pos != head; pos = pos->next) {
+		if (cmp(newp, pos) < 0)
+			break;
+	}
+	/* Before pos, or at the tail when pos is the head. */
+	cds_list_add_tail_rcu(newp, pos);
+}
+
 /*
  * Replace an old entry atomically with respect to concurrent RCU
  * traversal. Mutual exclusion against concurrent updates is required
@@ -72,6 +97,73 @@ void cds_list_del_rcu(struct cds_list_head *elem)
 	CMM_STORE_SHARED(elem->prev->next, elem->next);
 }
 
+/*
+ * Move all the elements of @list, which must not be visible to
+ * readers, to the head of @head with a single publication, and
+ * reinitialize @list. Mutual exclusion against concurrent updates of
+ * @head is required.
+ */
+static inline
+void cds_list_splice_init_rcu(struct cds_list_head *list,
+		struct cds_list_head *head)
+{
+	struct cds_list_head *first = list->next, *last = list->prev;
+
+	if (cds_list_empty(list))
+		return;
+	last->next = head->next;
+	first->prev = head;
+	head->next->prev = last;
+	rcu_assign_pointer(head->next, first);
+	CDS_INIT_LIST_HEAD(list);
+}
+
+/*
+ * Replace all the elements of @head by those of @newp, which must not
+ * be visible to readers, with a single publication. @newp is
+ * reinitialized, and the old elements are moved to @old, so that they
+ * can be reclaimed with a single call_rcu(). Mutual exclusion against
+ * concurrent updates of @head is required.
+ *
+ * Readers may still be traversing the old elements: the last one keeps
+ * leading them back to @head. Call cds_list_replace_all_rcu_done() on
+ * @old after a grace period, before traversing it forward.
+ */
+static inline
+void cds_list_replace_all_rcu(struct cds_list_head *newp,
+		struct cds_list_head *head, struct cds_list_head *old)
+{
+	struct cds_list_head *old_first = head->next, *old_last = head->prev;
+
+	if (cds_list_empty(newp)) {
+		head->prev = head;
+		CMM_STORE_SHARED(head->next, head);
+	} else {
+		newp->prev->next = head;
+		newp->next->prev = head;
+		head->prev = newp->prev;
+		rcu_assign_pointer(head->next, newp->next);
+		CDS_INIT_LIST_HEAD(newp);
+	}
+	if (old_first == head) {
+		CDS_INIT_LIST_HEAD(old);
+	} else {
+		old->next = old_first;
+		old->prev = old_last;
+		old_first->prev = old;
+	}
+}
+
+/*
+ * Terminate the list of old elements of cds_list_replace_all_rcu(),
+ * once no reader can be traversing them.
+ */
+static inline
+void cds_list_replace_all_rcu_done(struct cds_list_head *old)
+{
+	old->prev->next = old;
+}
+
 /*
  * Iteration through all elements of the list must be done while rcu_read_lock()
  * is held.
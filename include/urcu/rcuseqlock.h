@@ -0,0 +1,178 @@
+#ifndef _URCU_RCUSEQLOCK_H
+#define _URCU_RCUSEQLOCK_H
+
+/*
+ * urcu/rcuseqlock.h
+ *
+ * Userspace RCU library - sequence lock for small values copied out
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * struct rcu_seqlock: sequence count protecting a small value updated
+ * in place, e.g. a few counters updated together. Writers update the
+ * value between rcu_seqlock_write_lock and rcu_seqlock_write_unlock,
+ * which serialize them and make the count odd while the value is
+ * inconsistent. Readers copy the value out and retry if the count
+ * changed meanwhile: they write no shared memory, and an update costs
+ * neither an allocation nor a call_rcu, unlike publishing a new copy
+ * with rcu_xchg_pointer.
+ *
+ * Combined with RCU, a value can live in an object published with
+ * rcu_assign_pointer: readers dereference it within a RCU read-side
+ * critical section, then copy it out under the sequence lock. Small
+ * updates are done in place under the lock, while updates which need
+ * another object, e.g. to grow it, publish a copy with
+ * rcu_xchg_pointer and free the previous object after a grace period.
+ * Such a swap needs no write section, as the previous object is not
+ * modified anymore.
+ *
+ * Readers spin while a writer is within its write section, so write
+ * sections must be short, and must not be preempted for long. Readers
+ * only need a RCU read-side critical section for the object to exist.
+ */
+struct rcu_seqlock {
+	unsigned long seq;	/* Odd: write in progress. */
+};
+
+#define RCU_SEQLOCK_INIT	{ 0 }
+
+static inline
+void rcu_seqlock_init(struct rcu_seqlock *sl)
+{
+	sl->seq = 0;
+}
+
+/*
+ * rcu_seqlock_read_begin - start a read of the protected value.
+ *
+ * Returns the count to pass to rcu_seqlock_read_retry, once no write is
+ * in progress.
+ */
+static inline
+unsigned long rcu_seqlock_read_begin(const struct rcu_seqlock *sl)
+{
+	unsigned long seq;
+
+	for (;;) {
+		seq = CMM_LOAD_SHARED(sl->seq);
+		if (caa_likely(!(seq & 1)))
+			break;
+		caa_cpu_relax();
+	}
+	/* Read the count before the value. */
+	cmm_smp_rmb();
+	return seq;
+}
+
+/*
+ * rcu_seqlock_read_retry - end a read of the protected value.
+ *
+ * Returns non-zero if the value was written since
+ * rcu_seqlock_read_begin returned @seq, in which case what was read
+ * must be discarded and read again.
+ */
+static inline
+int rcu_seqlock_read_retry(const struct rcu_seqlock *sl, unsigned long seq)
+{
+	/* Read the value before the count. */
+	cmm_smp_rmb();
+	return caa_unlikely(CMM_LOAD_SHARED(sl->seq) != seq);
+}
+
+/*
+ * rcu_seqlock_write_lock - start a write of the protected value.
+ *
+ * Waits for the write in progress, if any, to complete. Acts as a full
+ * memory barrier.
+ */
+static inline
+void rcu_seqlock_write_lock(struct rcu_seqlock *sl)
+{
+	unsigned long seq;
+
+	for (;;) {
+		seq = CMM_LOAD_SHARED(sl->seq);
+		if (!(seq & 1) && uatomic_cmpxchg(&sl->seq, seq, seq + 1) == seq)
+			break;
+		caa_cpu_relax();
+	}
+}
+
+/*
+ * rcu_seqlock_write_unlock - end a write of the protected value.
+ */
+static inline
+void rcu_seqlock_write_unlock(struct rcu_seqlock *sl)
+{
+	/* Write the value before the count. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(sl->seq, sl->seq + 1);
+}
+
+/*
+ * rcu_seqlock_read_copy - copy the protected value out.
+ * @sl: the sequence lock.
+ * @dst: the copy (output).
+ * @src: the value.
+ * @len: size of the value.
+ *
+ * Copies @src to @dst until the copy is consistent.
+ */
+static inline
+void rcu_seqlock_read_copy(const struct rcu_seqlock *sl, void *dst,
+		const void *src, size_t len)
+{
+	unsigned long seq;
+
+	do {
+		seq = rcu_seqlock_read_begin(sl);
+		memcpy(dst, src, len);
+	} while (rcu_seqlock_read_retry(sl, seq));
+}
+
+/*
+ * rcu_seqlock_write_copy - replace the protected value in place.
+ * @sl: the sequence lock.
+ * @dst: the value.
+ * @src: the new value.
+ * @len: size of the value.
+ */
+static inline
+void rcu_seqlock_write_copy(struct rcu_seqlock *sl, void *dst,
+		const void *src, size_t len)
+{
+	rcu_seqlock_write_lock(sl);
+	memcpy(dst, src, len);
+	rcu_seqlock_write_unlock(sl);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUSEQLOCK_H */
@@ -0,0 +1,303 @@
+#ifndef _URCU_RCUSKIPLIST_H
+#define _URCU_RCUSKIPLIST_H
+
+/*
+ * urcu/rcuskiplist.h
+ *
+ * Userspace RCU library - Lock-Free RCU Skip List
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor.
+ */
+
+#include <stddef.h>
+#include <urcu/compiler.h>
+#include <urcu-call-rcu.h>
+#include <urcu-flavor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Maximum height of the node towers: 4^16 nodes with 1 in 4 promoted. */
+#define CDS_SKIPLIST_MAX_LEVEL	16
+
+/*
+ * cds_skiplist_node: Contains the tower of next pointers of a node,
+ * one per level, sorted by key at each level.
+ *
+ * Towers are of variable height, so struct cds_skiplist_node must be
+ * the last field of the structure embedding it, and that structure
+ * allocated with room for the tower: pick a height with
+ * cds_skiplist_random_level(), then allocate
+ * offsetof(struct mystruct, node) + cds_skiplist_node_size(level)
+ * bytes. caa_container_of() can be used to get the structure from the
+ * struct cds_skiplist_node after a lookup.
+ *
+ * The lowest bit of the next pointers is used as removal flag.
+ */
+struct cds_skiplist_node {
+	const void *key;		/* Key given on add. */
+	unsigned int level;		/* Height of the tower. */
+	int linked;			/* Tower linked by the adder. */
+	struct cds_skiplist_node *next[];	/* ptr | REMOVED_FLAG */
+};
+
+#define cds_skiplist_node_size(level)					\
+	(sizeof(struct cds_skiplist_node)				\
+		+ (level) * sizeof(struct cds_skiplist_node *))
+
+struct cds_skiplist;
+
+/*
+ * Caution !
+ * Ensure reader and writer threads are registered as urcu readers.
+ */
+
+/*
+ * cds_skiplist_cmp_fct: return a negative value, 0 or a positive value
+ * whether the key of @node is lower than, equal to or greater than
+ * @key. Must define a total order over the keys of the list.
+ */
+typedef int (*cds_skiplist_cmp_fct)(struct cds_skiplist_node *node,
+		const void *key);
+
+/*
+ * cds_skiplist_node_init - initialize a skip list node
+ * @node: the node to initialize.
+ * @level: height of the tower allocated for @node, between 1 and
+ *         CDS_SKIPLIST_MAX_LEVEL.
+ */
+static inline
+void cds_skiplist_node_init(struct cds_skiplist_node *node,
+		unsigned int level)
+{
+	node->level = level;
+}
+
+/*
+ * cds_skiplist_random_level - pick the height of a new node tower.
+ *
+ * Returns a height between 1 and CDS_SKIPLIST_MAX_LEVEL, each level
+ * being used by a quarter of the nodes using the level below.
+ */
+extern
+unsigned int cds_skiplist_random_level(void);
+
+/*
+ * _cds_skiplist_new - API used by cds_skiplist_new wrapper. Do not use
+ * directly.
+ */
+extern
+struct cds_skiplist *_cds_skiplist_new(cds_skiplist_cmp_fct cmp,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_skiplist_new - allocate a skip list.
+ * @cmp: the key comparison function of the list.
+ *
+ * Return NULL on error.
+ * Note: the RCU flavor must be already included before the skip list
+ * header.
+ * Threads calling cds_skiplist_new are NOT required to be registered
+ * RCU read-side threads.
+ */
+static inline
+struct cds_skiplist *cds_skiplist_new(cds_skiplist_cmp_fct cmp)
+{
+	return _cds_skiplist_new(cmp, &rcu_flavor);
+}
+
+/*
+ * cds_skiplist_destroy - destroy a skip list.
+ * @list: the skip list to destroy.
+ *
+ * Return 0 on success, negative error value on error.
+ * The list must be empty, and no thread may be using it anymore.
+ * cds_skiplist_destroy should *not* be called from a RCU read-side
+ * critical section.
+ */
+extern
+int cds_skiplist_destroy(struct cds_skiplist *list);
+
+/*
+ * cds_skiplist_lookup - lookup a node by key.
+ * @list: the skip list.
+ * @key: the key to look up.
+ *
+ * Return the node holding @key, or NULL if not found.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_lookup(struct cds_skiplist *list,
+		const void *key);
+
+/*
+ * cds_skiplist_lower_bound - lookup the first node not lower than a key.
+ * @list: the skip list.
+ * @key: the key to look up.
+ *
+ * Return the node with the lowest key greater than or equal to @key,
+ * or NULL if there is none.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_lower_bound(struct cds_skiplist *list,
+		const void *key);
+
+/*
+ * cds_skiplist_first - get the node with the lowest key.
+ * @list: the skip list.
+ *
+ * Return NULL if the list is empty.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_first(struct cds_skiplist *list);
+
+/*
+ * cds_skiplist_next - get the node following a node in key order.
+ * @list: the skip list.
+ * @node: a node looked up within the same RCU read-side critical
+ *        section, possibly removed since.
+ *
+ * Return NULL after the last node. Nodes added or removed during the
+ * traversal may or may not be seen, but nodes are always seen in
+ * increasing key order.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_next(struct cds_skiplist *list,
+		struct cds_skiplist_node *node);
+
+/*
+ * cds_skiplist_next_range - get the next node of a range.
+ * @list: the skip list.
+ * @node: the current node of the range, or NULL.
+ * @hi: the upper bound of the range, inclusive.
+ *
+ * Return the node following @node if its key is lower than or equal to
+ * @hi, NULL otherwise.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_next_range(struct cds_skiplist *list,
+		struct cds_skiplist_node *node, const void *hi);
+
+/*
+ * cds_skiplist_lookup_range - get the first node of a range.
+ * @list: the skip list.
+ * @lo: the lower bound of the range, inclusive.
+ * @hi: the upper bound of the range, inclusive.
+ *
+ * Return the node with the lowest key within [@lo, @hi], or NULL if
+ * the range is empty.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_lookup_range(struct cds_skiplist *list,
+		const void *lo, const void *hi);
+
+/*
+ * cds_skiplist_add_unique - add a node if its key is not present.
+ * @list: the skip list.
+ * @key: the key of @node. Must stay valid as long as @node is in the
+ *       list, and is typically within the structure embedding @node.
+ * @node: the node to add, initialized with cds_skiplist_node_init().
+ *
+ * Return @node if added, or the node already holding @key otherwise,
+ * in which case @node is not added.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * Upon success, this function issues a full memory barrier before and
+ * after its atomic commit.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_add_unique(struct cds_skiplist *list,
+		const void *key, struct cds_skiplist_node *node);
+
+/*
+ * cds_skiplist_del - remove a node from the skip list.
+ * @list: the skip list.
+ * @node: the node to delete.
+ *
+ * Return 0 if the node is successfully removed, negative value
+ * otherwise. Deleting an already removed node fails with -ENOENT.
+ * RCU read-side lock must be held between lookup and removal.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * After successful removal, a grace period must be waited for before
+ * freeing or re-using the memory reserved for old node.
+ * Upon success, this function issues a full memory barrier before and
+ * after its atomic commit.
+ */
+extern
+int cds_skiplist_del(struct cds_skiplist *list,
+		struct cds_skiplist_node *node);
+
+/*
+ * cds_skiplist_is_node_deleted - query whether a node is removed.
+ *
+ * Return non-zero if the node is deleted from the skip list, 0
+ * otherwise.
+ * Call with rcu_read_lock held.
+ * This function does not issue any memory barrier.
+ */
+extern
+int cds_skiplist_is_node_deleted(struct cds_skiplist_node *node);
+
+/*
+ * Note: it is safe to perform node removal (del) or addition during
+ * any of the following traversals.
+ * These functions act as rcu_dereference() to read the node pointers.
+ */
+#define cds_skiplist_for_each(list, node)				\
+	for (node = cds_skiplist_first(list);				\
+		node != NULL;						\
+		node = cds_skiplist_next(list, node))
+
+#define cds_skiplist_for_each_from(list, key, node)			\
+	for (node = cds_skiplist_lower_bound(list, key);		\
+		node != NULL;						\
+		node = cds_skiplist_next(list, node))
+
+#define cds_skiplist_for_each_range(list, lo, hi, node)			\
+	for (node = cds_skiplist_lookup_range(list, lo, hi);		\
+		node != NULL;						\
+		node = cds_skiplist_next_range(list, node, hi))
+
+#define cds_skiplist_for_each_entry(list, node, pos, member)		\
+	for (node = cds_skiplist_first(list),				\
+			pos = caa_container_of(node,			\
+					__typeof__(*(pos)), member);	\
+		node != NULL;						\
+		node = cds_skiplist_next(list, node),			\
+			pos = caa_container_of(node,			\
+					__typeof__(*(pos)), member))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUSKIPLIST_H */
@@ -0,0 +1,107 @@
+#ifndef _URCU_RCUSLAB_H
+#define _URCU_RCUSLAB_H
+
+/*
+ * urcu/rcuslab.h
+ *
+ * Userspace RCU library - RCU-aware object cache with per-thread magazines
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <urcu/compiler.h>
+#include <urcu-call-rcu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A struct cds_rcu_slab is a cache of objects of a given size, e.g. the
+ * nodes of a hash table or queue. Each thread allocates from its own
+ * magazine of free objects, and owns the objects it allocated.
+ *
+ * Objects freed with cds_rcu_slab_free_rcu() are gathered per freeing
+ * thread in batches of CDS_RCU_SLAB_BATCH objects, and each batch waits
+ * for a single grace period, with a single call_rcu. The callback then
+ * hands the objects back to the magazines of their owning threads with
+ * one atomic operation per run of objects of a same owner, and the
+ * owners take them back all at once when their magazine is empty.
+ * Objects thus go back to the thread which allocated them, rather than
+ * to the malloc cache of the call_rcu thread.
+ *
+ * Magazines of exited threads are adopted by the next threads using the
+ * cache. Memory is only released to the system by cds_rcu_slab_destroy().
+ */
+struct cds_rcu_slab;
+
+/* Objects freed with cds_rcu_slab_free_rcu() per call_rcu. */
+#define CDS_RCU_SLAB_BATCH	64
+
+/*
+ * cds_rcu_slab_create: create a cache of objects of @size bytes,
+ * aligned on @align bytes (a power of 2, or 0 for the alignment of
+ * malloc()). Objects freed after a grace period are queued with
+ * @slab_call_rcu, the call_rcu() of the RCU flavor of their readers.
+ *
+ * Returns NULL with errno set on error.
+ */
+extern struct cds_rcu_slab *cds_rcu_slab_create(size_t size, size_t align,
+		void (*slab_call_rcu)(struct rcu_head *head,
+			void (*func)(struct rcu_head *head)));
+
+/*
+ * cds_rcu_slab_destroy: free a cache and all its memory.
+ *
+ * All the objects must have been freed, and the grace periods of those
+ * freed with cds_rcu_slab_free_rcu() completed: call
+ * cds_rcu_slab_flush() from each thread which freed objects, then
+ * rcu_barrier() of the flavor. Returns 0, or -EBUSY if objects remain
+ * allocated.
+ */
+extern int cds_rcu_slab_destroy(struct cds_rcu_slab *slab);
+
+/*
+ * cds_rcu_slab_alloc: allocate an object from the magazine of the
+ * calling thread. Returns NULL with errno set on memory exhaustion.
+ */
+extern void *cds_rcu_slab_alloc(struct cds_rcu_slab *slab);
+
+/*
+ * cds_rcu_slab_free: free an object immediately, e.g. an object never
+ * published to RCU readers.
+ */
+extern void cds_rcu_slab_free(struct cds_rcu_slab *slab, void *obj);
+
+/*
+ * cds_rcu_slab_free_rcu: free an object after a grace period.
+ *
+ * The object joins the current batch of the calling thread, which waits
+ * for a grace period once full, or on cds_rcu_slab_flush().
+ */
+extern void cds_rcu_slab_free_rcu(struct cds_rcu_slab *slab, void *obj);
+
+/*
+ * cds_rcu_slab_flush: queue the current batch of the calling thread for
+ * a grace period, even if not full. Also done at thread exit.
+ */
+extern void cds_rcu_slab_flush(struct cds_rcu_slab *slab);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUSLAB_H */
@@ -0,0 +1,231 @@
+#ifndef _URCU_RCUSNAPSHOT_H
+#define _URCU_RCUSNAPSHOT_H
+
+/*
+ * urcu/rcusnapshot.h
+ *
+ * Userspace RCU library - groups of pointers published together
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Include the RCU flavor header before this file: publishing uses its
+ * call_rcu() and rcu_barrier().
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu-pointer.h>
+#include <urcu-call-rcu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RCU_SNAPSHOT_MAX_PTRS	8
+
+struct rcu_snapshot;
+
+/*
+ * struct rcu_snapshot_group: one version of the pointers of a snapshot,
+ * stamped with its generation. Readers only use ptr and gen.
+ */
+struct rcu_snapshot_group {
+	void *ptr[RCU_SNAPSHOT_MAX_PTRS];
+	unsigned long gen;
+
+	/* Updater side. */
+	unsigned long keep;	/* Bit i: ptr[i] is still published. */
+	int pending;		/* Waiting for the free callback. */
+	struct rcu_head head;
+	struct rcu_snapshot *snap;
+};
+
+/*
+ * struct rcu_snapshot: up to RCU_SNAPSHOT_MAX_PTRS related pointers,
+ * e.g. the parts of a configuration, replaced all at once. Publishing
+ * as many pointers with rcu_assign_pointer lets readers see a mix of
+ * versions, and wrapping them in an object published in their stead
+ * costs an allocation per update.
+ *
+ * The snapshot embeds two groups of pointers instead. A publish fills
+ * the group no reader uses anymore, then points the snapshot at it
+ * with a single rcu_assign_pointer: readers reach a consistent group
+ * with one rcu_dereference and no indirection beyond the snapshot
+ * itself. The superseded group is handed to one call_rcu, which frees
+ * all its pointers which were not published again, and makes the group
+ * available for the next publish.
+ *
+ * The snapshot must not move while in use, e.g. it can be a static
+ * variable or be embedded in a longer-lived object.
+ */
+struct rcu_snapshot {
+	struct rcu_snapshot_group *cur;
+	unsigned int nr_ptrs;
+	void (*free_ptr)(void *ptr);
+	struct rcu_snapshot_group group[2];
+};
+
+/*
+ * rcu_snapshot_init - initialize a snapshot.
+ * @snap: the snapshot.
+ * @nr_ptrs: number of pointers of each group, at most
+ *           RCU_SNAPSHOT_MAX_PTRS.
+ * @free_ptr: frees the pointers of superseded groups, or NULL.
+ * @ptrs: the first group of @nr_ptrs pointers, or NULL for NULL pointers.
+ *
+ * The pointers of a group must be distinct, except for NULL pointers,
+ * which are not freed. This generation is 0. Returns 0, or -EINVAL if
+ * @nr_ptrs is too large.
+ */
+static inline
+int rcu_snapshot_init(struct rcu_snapshot *snap, unsigned int nr_ptrs,
+		void (*free_ptr)(void *ptr), void * const *ptrs)
+{
+	unsigned int i, j;
+
+	if (nr_ptrs > RCU_SNAPSHOT_MAX_PTRS)
+		return -EINVAL;
+	snap->nr_ptrs = nr_ptrs;
+	snap->free_ptr = free_ptr;
+	for (i = 0; i < 2; i++) {
+		struct rcu_snapshot_group *group = &snap->group[i];
+
+		for (j = 0; j < RCU_SNAPSHOT_MAX_PTRS; j++)
+			group->ptr[j] = NULL;
+		group->gen = 0;
+		group->keep = 0;
+		group->pending = 0;
+		group->snap = snap;
+	}
+	for (j = 0; ptrs && j < nr_ptrs; j++)
+		snap->group[0].ptr[j] = ptrs[j];
+	snap->cur = &snap->group[0];
+	return 0;
+}
+
+/*
+ * rcu_snapshot_dereference - get the current group of a snapshot.
+ *
+ * Call within a RCU read-side critical section. The group, and the
+ * objects its pointers reference, exist until the end of the critical
+ * section, even if a newer group is published meanwhile.
+ */
+static inline
+struct rcu_snapshot_group *rcu_snapshot_dereference(struct rcu_snapshot *snap)
+{
+	return rcu_dereference(snap->cur);
+}
+
+static inline
+void _rcu_snapshot_free_group(struct rcu_head *head)
+{
+	struct rcu_snapshot_group *group =
+		caa_container_of(head, struct rcu_snapshot_group, head);
+	struct rcu_snapshot *snap = group->snap;
+	unsigned int i;
+
+	if (snap->free_ptr) {
+		for (i = 0; i < snap->nr_ptrs; i++) {
+			if (group->ptr[i] && !(group->keep & (1UL << i)))
+				snap->free_ptr(group->ptr[i]);
+		}
+	}
+	/* Free the pointers before the next publish reuses the group. */
+	cmm_smp_mb();
+	uatomic_set(&group->pending, 0);
+}
+
+/*
+ * rcu_snapshot_publish - replace all the pointers of a snapshot.
+ * @snap: the snapshot.
+ * @ptrs: the new group of nr_ptrs pointers.
+ *
+ * Pointers of the current group which are part of @ptrs too, at any
+ * index, are kept; the other ones are freed by free_ptr after a grace
+ * period. Returns the generation of the new group.
+ *
+ * Publishers must be serialized by the caller, and must be registered
+ * RCU threads outside of read-side critical sections. A publish issued
+ * before the free callback of the previous one ran, i.e. less than a
+ * grace period later, waits for it with rcu_barrier().
+ */
+static inline
+unsigned long rcu_snapshot_publish(struct rcu_snapshot *snap,
+		void * const *ptrs)
+{
+	struct rcu_snapshot_group *old = snap->cur, *next;
+	unsigned int i, j;
+
+	next = old == &snap->group[0] ? &snap->group[1] : &snap->group[0];
+	/* Readers of the group superseded by the previous publish are done. */
+	if (uatomic_read(&next->pending))
+		rcu_barrier();
+	cmm_smp_mb();	/* Read ->pending before reusing the group. */
+	for (i = 0; i < snap->nr_ptrs; i++)
+		next->ptr[i] = ptrs[i];
+	next->gen = old->gen + 1;
+	next->keep = 0;
+	rcu_assign_pointer(snap->cur, next);
+
+	old->keep = 0;
+	for (i = 0; i < snap->nr_ptrs; i++) {
+		for (j = 0; j < snap->nr_ptrs; j++) {
+			if (old->ptr[i] == ptrs[j]) {
+				old->keep |= 1UL << i;
+				break;
+			}
+		}
+	}
+	old->pending = 1;
+	call_rcu(&old->head, _rcu_snapshot_free_group);
+	return next->gen;
+}
+
+/*
+ * rcu_snapshot_destroy - free the pointers of a snapshot.
+ *
+ * Waits for the free callback of the last publish, if needed, then
+ * frees the pointers of the current group with free_ptr. Call once
+ * readers cannot reach the snapshot anymore, from a registered RCU
+ * thread outside of read-side critical sections.
+ */
+static inline
+void rcu_snapshot_destroy(struct rcu_snapshot *snap)
+{
+	struct rcu_snapshot_group *group = snap->cur;
+	unsigned int i;
+
+	if (uatomic_read(&snap->group[0].pending)
+			|| uatomic_read(&snap->group[1].pending))
+		rcu_barrier();
+	cmm_smp_mb();	/* Read ->pending before freeing. */
+	if (!snap->free_ptr)
+		return;
+	for (i = 0; i < snap->nr_ptrs; i++) {
+		if (group->ptr[i])
+			snap->free_ptr(group->ptr[i]);
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUSNAPSHOT_H */
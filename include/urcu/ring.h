@@ -0,0 +1,171 @@
+#ifndef _URCU_RING_H
+#define _URCU_RING_H
+
+/*
+ * urcu/ring.h
+ *
+ * Userspace RCU library - Bounded Lock-Free Ring Buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded ring buffers of pointers, with a capacity fixed at init,
+ * which must be a power of 2. Enqueue fails when the ring is full, and
+ * dequeue fails when it is empty: neither blocks. Items are stored in
+ * an array, without node nor memory allocation per item.
+ *
+ * struct cds_mpmc_ring allows any number of concurrent enqueuers and
+ * dequeuers. Each slot has a sequence number telling whether it is
+ * free or holds an item for a given turn of the ring, after D. Vyukov's
+ * bounded MPMC queue: enqueue and dequeue each reserve a position with
+ * a compare-and-swap, and wait for nobody. A thread preempted between
+ * reserving a position and filling or emptying its slot only delays
+ * the operations reaching that slot a turn later.
+ *
+ * struct cds_spsc_ring allows one enqueuer and one dequeuer at a time,
+ * without atomic operation: each side only writes its own position,
+ * and caches the position of the other side.
+ *
+ * Both rings keep the enqueue and dequeue positions on separate cache
+ * lines, and should be allocated aligned on the cache line, e.g. with
+ * posix_memalign(), when embedded in other structures.
+ */
+
+struct cds_mpmc_ring_slot {
+	unsigned long seq;
+	void *item;
+};
+
+struct cds_mpmc_ring {
+	struct cds_mpmc_ring_slot *slots;
+	unsigned long mask;
+	unsigned long enqueue_pos __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long dequeue_pos __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+};
+
+struct cds_spsc_ring {
+	void **slots;
+	unsigned long mask;
+	/* Written by the enqueuer. */
+	unsigned long tail __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long head_cache;
+	/* Written by the dequeuer. */
+	unsigned long head __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long tail_cache;
+};
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/ring.h>
+
+#define cds_mpmc_ring_init		_cds_mpmc_ring_init
+#define cds_mpmc_ring_destroy		_cds_mpmc_ring_destroy
+#define cds_mpmc_ring_enqueue		_cds_mpmc_ring_enqueue
+#define cds_mpmc_ring_dequeue		_cds_mpmc_ring_dequeue
+#define cds_spsc_ring_init		_cds_spsc_ring_init
+#define cds_spsc_ring_destroy		_cds_spsc_ring_destroy
+#define cds_spsc_ring_enqueue		_cds_spsc_ring_enqueue
+#define cds_spsc_ring_dequeue		_cds_spsc_ring_dequeue
+#define cds_spsc_ring_dequeue_bulk	_cds_spsc_ring_dequeue_bulk
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * cds_mpmc_ring_init: initialize a ring holding up to @capacity items.
+ *
+ * Returns 0, -EINVAL if @capacity is not a power of 2, or -ENOMEM.
+ */
+extern int cds_mpmc_ring_init(struct cds_mpmc_ring *ring,
+		unsigned long capacity);
+
+/*
+ * cds_mpmc_ring_destroy: release the memory of a ring. Items left in
+ * the ring are dropped.
+ */
+extern void cds_mpmc_ring_destroy(struct cds_mpmc_ring *ring);
+
+/*
+ * cds_mpmc_ring_enqueue: enqueue @item.
+ *
+ * Returns false if the ring is full. Content written into the item
+ * before enqueue is visible to the dequeuer. No mutual exclusion is
+ * required.
+ */
+extern bool cds_mpmc_ring_enqueue(struct cds_mpmc_ring *ring, void *item);
+
+/*
+ * cds_mpmc_ring_dequeue: dequeue an item into @item.
+ *
+ * Returns false if the ring is empty. No mutual exclusion is required.
+ */
+extern bool cds_mpmc_ring_dequeue(struct cds_mpmc_ring *ring, void **item);
+
+/*
+ * cds_spsc_ring_init: initialize a ring holding up to @capacity items.
+ *
+ * Returns 0, -EINVAL if @capacity is not a power of 2, or -ENOMEM.
+ */
+extern int cds_spsc_ring_init(struct cds_spsc_ring *ring,
+		unsigned long capacity);
+
+/*
+ * cds_spsc_ring_destroy: release the memory of a ring. Items left in
+ * the ring are dropped.
+ */
+extern void cds_spsc_ring_destroy(struct cds_spsc_ring *ring);
+
+/*
+ * cds_spsc_ring_enqueue: enqueue @item.
+ *
+ * Returns false if the ring is full. Content written into the item
+ * before enqueue is visible to the dequeuer. Mutual exclusion with
+ * other enqueuers is required.
+ */
+extern bool cds_spsc_ring_enqueue(struct cds_spsc_ring *ring, void *item);
+
+/*
+ * cds_spsc_ring_dequeue: dequeue an item into @item.
+ *
+ * Returns false if the ring is empty. Mutual exclusion with other
+ * dequeuers is required.
+ */
+extern bool cds_spsc_ring_dequeue(struct cds_spsc_ring *ring, void **item);
+
+/*
+ * cds_spsc_ring_dequeue_bulk: dequeue up to @count items into @items.
+ *
+ * Returns the number of items dequeued, with a single memory barrier
+ * rather than one per item. Mutual exclusion with other dequeuers is
+ * required.
+ */
+extern unsigned long cds_spsc_ring_dequeue_bulk(struct cds_spsc_ring *ring,
+		void **items, unsigned long count);
+
+#endif /* !_LGPL_SOURCE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RING_H */
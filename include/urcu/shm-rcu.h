@@ -0,0 +1,110 @@
+#ifndef _URCU_SHM_RCU_H
+#define _URCU_SHM_RCU_H
+
+/*
+ * urcu/shm-rcu.h
+ *
+ * Userspace RCU library - RCU domains shared between processes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Shared-memory RCU domain: the grace period counter and the reader
+ * registry live in a memory area provided by the caller, typically a
+ * MAP_SHARED mapping, so threads of several processes share grace
+ * periods. The domain holds no pointers and may be mapped at
+ * different addresses. All processes must share the same ABI and pid
+ * namespace. Does not depend on any URCU flavor.
+ */
+struct shm_rcu_domain;
+
+/* Reader slot of a thread in a shared-memory RCU domain. */
+struct shm_rcu_reader;
+
+/*
+ * shm_rcu_domain_size - bytes needed by a domain of @nr_readers slots.
+ */
+extern size_t shm_rcu_domain_size(unsigned int nr_readers);
+
+/*
+ * shm_rcu_domain_init - initialize a shared-memory RCU domain in @mem.
+ *
+ * @mem must be cache-line aligned and @len at least
+ * shm_rcu_domain_size(@nr_readers). Must be called by a single process
+ * before any other process attaches. Returns NULL with errno set to
+ * EINVAL when @len is too small.
+ */
+extern struct shm_rcu_domain *shm_rcu_domain_init(void *mem, size_t len,
+		unsigned int nr_readers);
+
+/*
+ * shm_rcu_domain_attach - use the domain initialized in @mem.
+ *
+ * Called by each process other than the initializing one. Returns
+ * NULL with errno set to EINVAL if @mem does not hold a domain of a
+ * compatible layout fitting in @len bytes.
+ */
+extern struct shm_rcu_domain *shm_rcu_domain_attach(void *mem, size_t len);
+
+/*
+ * shm_rcu_register_thread - claim a reader slot for the current thread.
+ *
+ * Returns NULL with errno set to ENOSPC when all slots are in use.
+ * The slots of threads which exited without unregistering are
+ * reclaimed when needed, by grace periods or registrations.
+ */
+extern struct shm_rcu_reader *shm_rcu_register_thread(
+		struct shm_rcu_domain *dp);
+
+/*
+ * shm_rcu_unregister_thread - release the reader slot @rp.
+ *
+ * Must not be called from a read-side critical section.
+ */
+extern void shm_rcu_unregister_thread(struct shm_rcu_reader *rp);
+
+/*
+ * shm_rcu_read_lock - enter a read-side critical section.
+ *
+ * Takes no lock. Read-side critical sections nest.
+ */
+extern void shm_rcu_read_lock(struct shm_rcu_reader *rp);
+
+/*
+ * shm_rcu_read_unlock - exit a read-side critical section.
+ */
+extern void shm_rcu_read_unlock(struct shm_rcu_reader *rp);
+
+/*
+ * synchronize_shm_rcu - wait for a grace period of @dp.
+ *
+ * Waits for the read-side critical sections in progress in any process
+ * when called. Must not be called from a read-side critical section of
+ * @dp.
+ */
+extern void synchronize_shm_rcu(struct shm_rcu_domain *dp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SHM_RCU_H */
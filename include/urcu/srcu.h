@@ -0,0 +1,76 @@
+#ifndef _URCU_SRCU_H
+#define _URCU_SRCU_H
+
+/*
+ * urcu/srcu.h
+ *
+ * Userspace RCU library - Sleepable RCU domains
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sleepable RCU domain: read-side critical sections may block, and
+ * only delay the grace periods of their domain. Readers are counted
+ * in per-CPU counters, so reader threads need no registration. Does
+ * not depend on any URCU flavor.
+ */
+struct srcu_domain;
+
+/*
+ * srcu_domain_create - allocate a sleepable RCU domain.
+ *
+ * Returns NULL on allocation failure.
+ */
+extern struct srcu_domain *srcu_domain_create(void);
+
+/*
+ * srcu_domain_destroy - free a sleepable RCU domain.
+ *
+ * Returns -EBUSY, leaving the domain untouched, while read-side
+ * critical sections are in progress. Returns 0 on success.
+ */
+extern int srcu_domain_destroy(struct srcu_domain *sp);
+
+/*
+ * srcu_read_lock - enter a read-side critical section of @sp.
+ *
+ * Returns an index to pass to the matching srcu_read_unlock(), which
+ * may be called from another CPU. Read-side critical sections nest.
+ */
+extern int srcu_read_lock(struct srcu_domain *sp);
+
+/*
+ * srcu_read_unlock - exit a read-side critical section of @sp.
+ */
+extern void srcu_read_unlock(struct srcu_domain *sp, int idx);
+
+/*
+ * synchronize_srcu - wait for a grace period of @sp.
+ *
+ * Waits for the read-side critical sections of @sp in progress when
+ * called. Must not be called from a read-side critical section of @sp.
+ */
+extern void synchronize_srcu(struct srcu_domain *sp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SRCU_H */
@@ -30,6 +30,7 @@
 #include <pthread.h>
 #include <assert.h>
 #include <urcu/uatomic.h>
+#include <urcu/eventcount.h>
 #include <urcu-pointer.h>
 
 #ifdef __cplusplus
@@ -174,6 +175,28 @@ bool _cds_lfs_push(cds_lfs_stack_ptr_t u_s,
 	return !___cds_lfs_empty_head(head);
 }
 
+/*
+ * cds_lfs_push_wake: push a node into the stack, and wake up the
+ * threads waiting on @ec in cds_lfs_pop_wait().
+ *
+ * Only issues a wake up, and only a system call if a thread sleeps,
+ * when the stack was empty. Does not require any synchronization with
+ * other push nor pop.
+ *
+ * Returns 0 if the stack was empty prior to adding the node.
+ * Returns non-zero otherwise.
+ */
+static inline
+bool _cds_lfs_push_wake(cds_lfs_stack_ptr_t u_s,
+		  struct cds_lfs_node *node,
+		  struct cds_eventcount *ec)
+{
+	if (_cds_lfs_push(u_s, node))
+		return true;
+	(void) cds_eventcount_wake(ec);
+	return false;
+}
+
 /*
  * __cds_lfs_pop: pop a node from the stack.
  *
@@ -222,6 +245,217 @@ struct cds_lfs_node *___cds_lfs_pop(cds_lfs_stack_ptr_t u_s)
 	}
 }
 
+/*
+ * Number of busy-loop iterations during which a pusher waits for a
+ * popper to take the node it offered into an elimination slot.
+ */
+#define CDS_LFS_ELIM_SPINS	128
+
+/*
+ * cds_lfs_elim_init: initialize an elimination array.
+ */
+static inline
+void _cds_lfs_elim_init(struct cds_lfs_elim *elim)
+{
+	unsigned int i;
+
+	for (i = 0; i < CDS_LFS_ELIM_SLOTS; i++)
+		elim->slots[i].node = NULL;
+}
+
+/*
+ * Elimination slot for the @attempt-th retry of the calling thread.
+ * The address of a local variable spreads threads, whose stacks are
+ * distinct, over the slots.
+ */
+static inline
+unsigned int ___cds_lfs_elim_index(unsigned int attempt)
+{
+	unsigned long seed = (unsigned long) &attempt >> 12;
+
+	return (unsigned int) ((seed * 2654435761UL) >> 16) + attempt;
+}
+
+/*
+ * Offer @node into a slot of @elim. Returns 1 if a popper took it, 0 if
+ * the slot was busy or nobody took the node in time.
+ */
+static inline
+int ___cds_lfs_elim_push(struct cds_lfs_elim *elim,
+		struct cds_lfs_node *node, unsigned int attempt)
+{
+	struct cds_lfs_node **slot = &elim->slots[___cds_lfs_elim_index(attempt)
+			& (CDS_LFS_ELIM_SLOTS - 1)].node;
+	unsigned int i;
+
+	/*
+	 * uatomic_cmpxchg() implicit memory barrier orders earlier
+	 * stores to node before publication.
+	 */
+	if (uatomic_cmpxchg(slot, NULL, node) != NULL)
+		return 0;
+	for (i = 0; i < CDS_LFS_ELIM_SPINS; i++) {
+		if (CMM_LOAD_SHARED(*slot) != node)
+			return 1;
+		caa_cpu_relax();
+	}
+	/* Withdraw the node, unless a popper took it meanwhile. */
+	return uatomic_cmpxchg(slot, node, NULL) != node;
+}
+
+/*
+ * Take a node offered into a slot of @elim, or return NULL.
+ */
+static inline
+struct cds_lfs_node *___cds_lfs_elim_pop(struct cds_lfs_elim *elim,
+		unsigned int attempt)
+{
+	struct cds_lfs_node **slot = &elim->slots[___cds_lfs_elim_index(attempt)
+			& (CDS_LFS_ELIM_SLOTS - 1)].node;
+	struct cds_lfs_node *node;
+
+	node = CMM_LOAD_SHARED(*slot);
+	if (!node)
+		return NULL;
+	/*
+	 * The node content is only read by our caller, after the
+	 * implicit memory barrier of uatomic_cmpxchg().
+	 */
+	if (uatomic_cmpxchg(slot, node, NULL) != node)
+		return NULL;
+	return node;
+}
+
+/*
+ * cds_lfs_push_elim: push a node into the stack, or hand it over to a
+ * concurrent __cds_lfs_pop_elim through @elim when the stack head is
+ * contended.
+ *
+ * Same as cds_lfs_push, but from the second failed uatomic_cmpxchg()
+ * on the head, which the head being modified by others caused, offers
+ * the node into a slot of @elim for CDS_LFS_ELIM_SPINS iterations in
+ * between retries. The push and the matching pop are then complete
+ * without touching the head cache line.
+ *
+ * Returns 0 if the stack was empty prior to adding the node, non-zero
+ * otherwise, or when the node was taken by a pop through @elim.
+ */
+static inline
+bool _cds_lfs_push_elim(cds_lfs_stack_ptr_t u_s,
+		  struct cds_lfs_elim *elim,
+		  struct cds_lfs_node *node)
+{
+	struct __cds_lfs_stack *s = u_s._s;
+	struct cds_lfs_head *head = NULL;
+	struct cds_lfs_head *new_head =
+		caa_container_of(node, struct cds_lfs_head, node);
+	unsigned int attempt;
+
+	for (attempt = 0;; attempt++) {
+		struct cds_lfs_head *old_head = head;
+
+		node->next = &head->node;
+		head = uatomic_cmpxchg(&s->head, old_head, new_head);
+		if (old_head == head)
+			break;
+		/* The first attempt expects an empty stack. */
+		if (attempt && ___cds_lfs_elim_push(elim, node, attempt))
+			return true;
+	}
+	return !___cds_lfs_empty_head(head);
+}
+
+/*
+ * __cds_lfs_pop_elim: pop a node from the stack, or take a node offered
+ * into @elim by a concurrent cds_lfs_push_elim when the stack head is
+ * contended.
+ *
+ * Returns NULL if stack is empty. Needs the same synchronization as
+ * __cds_lfs_pop. A node taken from @elim does not need any: it is never
+ * dereferenced, and was never on the stack.
+ */
+static inline
+struct cds_lfs_node *___cds_lfs_pop_elim(cds_lfs_stack_ptr_t u_s,
+		struct cds_lfs_elim *elim)
+{
+	struct __cds_lfs_stack *s = u_s._s;
+	unsigned int attempt;
+
+	for (attempt = 0;; attempt++) {
+		struct cds_lfs_head *head, *next_head;
+		struct cds_lfs_node *next;
+
+		head = _CMM_LOAD_SHARED(s->head);
+		if (___cds_lfs_empty_head(head))
+			return NULL;	/* Empty stack */
+
+		/* Same as __cds_lfs_pop. */
+		cmm_smp_read_barrier_depends();
+		next = _CMM_LOAD_SHARED(head->node.next);
+		next_head = caa_container_of(next,
+				struct cds_lfs_head, node);
+		if (uatomic_cmpxchg(&s->head, head, next_head) == head)
+			return &head->node;
+		/* Head changed under us: try to eliminate with a push. */
+		next = ___cds_lfs_elim_pop(elim, attempt);
+		if (next)
+			return next;
+	}
+}
+
+/*
+ * __cds_lfs_pop_n: pop up to @n nodes from the stack.
+ *
+ * Stores the popped nodes into @nodes, top of stack first, and returns
+ * their number, 0 if the stack is empty. A single successful cmpxchg
+ * pops all of them.
+ *
+ * __cds_lfs_pop_n walks the nodes below the head, which restricts
+ * its synchronization: either mutual exclusion against __cds_lfs_pop,
+ * __cds_lfs_pop_n and __cds_lfs_pop_all callers (techniques 2 and 3 of
+ * __cds_lfs_pop), or RCU read lock (technique 1) provided that no
+ * caller of the three overwrites the cds_lfs_node of returned nodes
+ * before a grace period has passed.
+ *
+ * With RCU, a popped node cannot be pushed back before a grace period,
+ * so an unchanged head means the nodes below it did not change either.
+ */
+static inline
+unsigned long ___cds_lfs_pop_n(cds_lfs_stack_ptr_t u_s,
+		struct cds_lfs_node **nodes, unsigned long n)
+{
+	struct __cds_lfs_stack *s = u_s._s;
+
+	if (!n)
+		return 0;
+	for (;;) {
+		struct cds_lfs_head *head, *next_head;
+		struct cds_lfs_node *next;
+		unsigned long i;
+
+		head = _CMM_LOAD_SHARED(s->head);
+		if (___cds_lfs_empty_head(head))
+			return 0;	/* Empty stack */
+
+		/*
+		 * Read head before head->next. Matches the implicit
+		 * memory barrier before uatomic_cmpxchg() in
+		 * cds_lfs_push.
+		 */
+		cmm_smp_read_barrier_depends();
+		next = &head->node;
+		for (i = 0; i < n && next; i++) {
+			nodes[i] = next;
+			next = _CMM_LOAD_SHARED(next->next);
+		}
+		next_head = caa_container_of(next,
+				struct cds_lfs_head, node);
+		if (uatomic_cmpxchg(&s->head, head, next_head) == head)
+			return i;
+		/* busy-loop if head changed under us */
+	}
+}
+
 /*
  * __cds_lfs_pop_all: pop all nodes from a stack.
  *
@@ -291,11 +525,51 @@ _cds_lfs_pop_blocking(struct cds_lfs_stack *s)
 	struct cds_lfs_node *retnode;
 
 	_cds_lfs_pop_lock(s);
-	retnode = ___cds_lfs_pop(s);
+	retnode = ___cds_lfs_pop(cds_lfs_stack_cast(s));
 	_cds_lfs_pop_unlock(s);
 	return retnode;
 }
 
+/*
+ * Call __cds_lfs_pop_n with an internal pop mutex held.
+ */
+static inline
+unsigned long
+_cds_lfs_pop_n_blocking(struct cds_lfs_stack *s,
+		struct cds_lfs_node **nodes, unsigned long n)
+{
+	unsigned long ret;
+
+	_cds_lfs_pop_lock(s);
+	ret = ___cds_lfs_pop_n(cds_lfs_stack_cast(s), nodes, n);
+	_cds_lfs_pop_unlock(s);
+	return ret;
+}
+
+/*
+ * Call __cds_lfs_pop with an internal pop mutex held, sleeping on @ec
+ * while the stack is empty. Never returns NULL.
+ */
+static inline
+struct cds_lfs_node *
+_cds_lfs_pop_wait(struct cds_lfs_stack *s, struct cds_eventcount *ec)
+{
+	struct cds_lfs_node *retnode;
+
+	for (;;) {
+		retnode = _cds_lfs_pop_blocking(s);
+		if (retnode)
+			return retnode;
+		cds_eventcount_prepare_wait(ec);
+		if (!_cds_lfs_empty(cds_lfs_stack_cast(s))) {
+			cds_eventcount_cancel_wait(ec);
+			continue;
+		}
+		/* Errors are spurious wake ups: the stack is rechecked. */
+		(void) cds_eventcount_wait(ec);
+	}
+}
+
 /*
  * Call __cds_lfs_pop_all with an internal pop mutex held.
  */
@@ -306,7 +580,7 @@ _cds_lfs_pop_all_blocking(struct cds_lfs_stack *s)
 	struct cds_lfs_head *rethead;
 
 	_cds_lfs_pop_lock(s);
-	rethead = ___cds_lfs_pop_all(s);
+	rethead = ___cds_lfs_pop_all(cds_lfs_stack_cast(s));
 	_cds_lfs_pop_unlock(s);
 	return rethead;
 }
@@ -0,0 +1,184 @@
+#ifndef _URCU_STATIC_RCUARRAY_H
+#define _URCU_STATIC_RCUARRAY_H
+
+/*
+ * urcu/static/rcuarray.h
+ *
+ * Userspace RCU library - RCU Resizable Array
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE. See urcu/rcuarray.h for
+ * linking dynamically with the userspace rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <urcu-call-rcu.h>
+#include <urcu-pointer.h>
+#include <urcu/system.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Capacity of the first block. */
+#define CDS_RCU_ARRAY_MIN_CAPACITY	16UL
+
+static inline void _cds_rcu_array_init(struct cds_rcu_array *array,
+		void (*array_call_rcu)(struct rcu_head *head,
+			void (*func)(struct rcu_head *head)))
+{
+	int ret;
+
+	array->block = NULL;
+	array->len = 0;
+	ret = pthread_mutex_init(&array->lock, NULL);
+	assert(!ret);
+	array->array_call_rcu = array_call_rcu;
+}
+
+static inline void _cds_rcu_array_destroy(struct cds_rcu_array *array)
+{
+	int ret;
+
+	free(array->block);
+	array->block = NULL;
+	array->len = 0;
+	ret = pthread_mutex_destroy(&array->lock);
+	assert(!ret);
+}
+
+/*
+ * cds_rcu_array_get: get entry @index, NULL if not set.
+ *
+ * The capacity of a block never changes once published, and its
+ * entries beyond the ones set are NULL, so the length is not read.
+ */
+static inline void *_cds_rcu_array_get(struct cds_rcu_array *array,
+		unsigned long index)
+{
+	struct cds_rcu_array_block *block;
+
+	block = rcu_dereference(array->block);
+	if (caa_unlikely(!block || index >= block->capacity))
+		return NULL;
+	return rcu_dereference(block->slots[index]);
+}
+
+static inline unsigned long _cds_rcu_array_len(struct cds_rcu_array *array)
+{
+	return CMM_LOAD_SHARED(array->len);
+}
+
+static inline void _cds_rcu_array_free_block(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct cds_rcu_array_block, head));
+}
+
+/*
+ * Replace the block with one holding at least @index + 1 entries, at
+ * least twice the current capacity. Called with the lock held.
+ */
+static inline int _cds_rcu_array_grow(struct cds_rcu_array *array,
+		unsigned long index)
+{
+	struct cds_rcu_array_block *old = array->block, *block;
+	unsigned long capacity;
+
+	capacity = old ? old->capacity : CDS_RCU_ARRAY_MIN_CAPACITY;
+	while (capacity <= index) {
+		if (capacity > (~0UL >> 1) / sizeof(void *))
+			return -ENOMEM;
+		capacity <<= 1;
+	}
+	block = (struct cds_rcu_array_block *)
+		calloc(1, sizeof(*block) + capacity * sizeof(void *));
+	if (!block)
+		return -ENOMEM;
+	block->capacity = capacity;
+	if (old)
+		memcpy(block->slots, old->slots, array->len * sizeof(void *));
+	rcu_assign_pointer(array->block, block);
+	if (old)
+		array->array_call_rcu(&old->head, _cds_rcu_array_free_block);
+	return 0;
+}
+
+static inline int _cds_rcu_array_set_locked(struct cds_rcu_array *array,
+		unsigned long index, void *ptr, void **old)
+{
+	struct cds_rcu_array_block *block = array->block;
+	int ret;
+
+	if (!block || index >= block->capacity) {
+		ret = _cds_rcu_array_grow(array, index);
+		if (ret)
+			return ret;
+		block = array->block;
+	}
+	if (old)
+		*old = block->slots[index];
+	rcu_assign_pointer(block->slots[index], ptr);
+	if (index >= array->len)
+		CMM_STORE_SHARED(array->len, index + 1);
+	return 0;
+}
+
+/*
+ * cds_rcu_array_set: set entry @index to @ptr, growing the array if
+ * needed. If @old is not NULL, it receives the previous entry.
+ */
+static inline int _cds_rcu_array_set(struct cds_rcu_array *array,
+		unsigned long index, void *ptr, void **old)
+{
+	int ret, lret;
+
+	if (index == ~0UL)
+		return -ENOMEM;
+	lret = pthread_mutex_lock(&array->lock);
+	assert(!lret);
+	ret = _cds_rcu_array_set_locked(array, index, ptr, old);
+	lret = pthread_mutex_unlock(&array->lock);
+	assert(!lret);
+	return ret;
+}
+
+/*
+ * cds_rcu_array_append: set entry cds_rcu_array_len() to @ptr, and
+ * return its index in @index.
+ */
+static inline int _cds_rcu_array_append(struct cds_rcu_array *array,
+		void *ptr, unsigned long *index)
+{
+	int ret, lret;
+
+	lret = pthread_mutex_lock(&array->lock);
+	assert(!lret);
+	*index = array->len;
+	ret = _cds_rcu_array_set_locked(array, array->len, ptr, NULL);
+	lret = pthread_mutex_unlock(&array->lock);
+	assert(!lret);
+	return ret;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_STATIC_RCUARRAY_H */
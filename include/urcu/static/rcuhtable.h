@@ -0,0 +1,79 @@
+#ifndef _URCU_STATIC_RCUHTABLE_H
+#define _URCU_STATIC_RCUHTABLE_H
+
+/*
+ * urcu/static/rcuhtable.h
+ *
+ * Userspace RCU library - Fixed-size RCU hash table with per-bucket locks
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE. See urcu/rcuhtable.h for
+ * linking dynamically with the userspace rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <urcu/compiler.h>
+#include <urcu-pointer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline int _cds_rcuhtable_match(struct cds_rcuhtable_node *node,
+		unsigned long hash, cds_rcuhtable_match_fct match,
+		const void *key)
+{
+	return node->hash == hash && (!match || match(node, key));
+}
+
+static inline struct cds_rcuhtable_node *_cds_rcuhtable_lookup(
+		struct cds_rcuhtable *ht, unsigned long hash,
+		cds_rcuhtable_match_fct match, const void *key)
+{
+	struct cds_hlist_node *pos;
+
+	for (pos = rcu_dereference(ht->buckets[hash & ht->mask].head.next);
+			pos; pos = rcu_dereference(pos->next)) {
+		struct cds_rcuhtable_node *node = caa_container_of(pos,
+				struct cds_rcuhtable_node, node);
+
+		if (_cds_rcuhtable_match(node, hash, match, key))
+			return node;
+	}
+	return NULL;
+}
+
+static inline struct cds_rcuhtable_node *_cds_rcuhtable_next_duplicate(
+		struct cds_rcuhtable_node *node,
+		cds_rcuhtable_match_fct match, const void *key)
+{
+	struct cds_hlist_node *pos;
+
+	for (pos = rcu_dereference(node->node.next); pos;
+			pos = rcu_dereference(pos->next)) {
+		struct cds_rcuhtable_node *next = caa_container_of(pos,
+				struct cds_rcuhtable_node, node);
+
+		if (_cds_rcuhtable_match(next, node->hash, match, key))
+			return next;
+	}
+	return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_STATIC_RCUHTABLE_H */
@@ -0,0 +1,218 @@
+#ifndef _URCU_RCULFHASH_STATIC_H
+#define _URCU_RCULFHASH_STATIC_H
+
+/*
+ * urcu/static/rculfhash.h
+ *
+ * Userspace RCU library - Lock-Free RCU Hash Table lookup fast-path
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE. See urcu/rculfhash.h for
+ * linking dynamically with the userspace rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <urcu/config.h>
+#include <urcu/compiler.h>
+#include <urcu-pointer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Flags stored in the low bits of the cds_lfht_node next pointers.
+ */
+#define _CDS_LFHT_REMOVED_FLAG		(1UL << 0)
+#define _CDS_LFHT_BUCKET_FLAG		(1UL << 1)
+#define _CDS_LFHT_REMOVAL_OWNER_FLAG	(1UL << 2)
+#define _CDS_LFHT_FLAGS_MASK		((1UL << 3) - 1)
+
+/*
+ * Returned by __cds_lfht_lookup_chain for tables without stored
+ * hashes, which are looked up out of line.
+ */
+#define _CDS_LFHT_CHAIN_NODE_HASH	((struct cds_lfht_node *) 1UL)
+
+/*
+ * __cds_lfht_lookup_chain - get the first node of the chain of a hash.
+ *
+ * Returns the (flag-cleared) node following the bucket node of @hash,
+ * or NULL if the membership filter of the table excludes @hash, and
+ * sets *@reverse_hash to the bit-reversed @hash. The table layout
+ * and memory management backend stay private to the library: this is
+ * the only out-of-line call of _cds_lfht_lookup(), except for tables
+ * with a node hash function, for which _CDS_LFHT_CHAIN_NODE_HASH is
+ * returned.
+ */
+extern
+struct cds_lfht_node *__cds_lfht_lookup_chain(struct cds_lfht *ht,
+		unsigned long hash, unsigned long *reverse_hash);
+
+static inline
+struct cds_lfht_node *_cds_lfht_clear_flag(struct cds_lfht_node *node)
+{
+	return (struct cds_lfht_node *)
+		(((unsigned long) node) & ~_CDS_LFHT_FLAGS_MASK);
+}
+
+/*
+ * _cds_lfht_prefetch_next: prefetch the node following a chain node.
+ *
+ * Called once the next pointer of a node is loaded, so the cache miss
+ * on the next node overlaps with the match function, or with the work
+ * done by the caller between traversal steps. Enabled by configuring
+ * with --enable-lfht-prefetch: out-of-order cores already overlap the
+ * next node load with short match functions and loop bodies, so it
+ * only pays off with long ones.
+ */
+static inline
+void _cds_lfht_prefetch_next(struct cds_lfht_node *next)
+{
+#ifdef CONFIG_RCU_LFHT_PREFETCH
+	__builtin_prefetch(_cds_lfht_clear_flag(next));
+#else
+	(void) next;
+#endif
+}
+
+/*
+ * _cds_lfht_lookup: lookup a node by key.
+ *
+ * Same semantic as cds_lfht_lookup(). When @match is a compile-time
+ * constant, it is inlined in the chain traversal loop.
+ */
+static inline
+void _cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *node, *next;
+	unsigned long reverse_hash;
+
+	node = __cds_lfht_lookup_chain(ht, hash, &reverse_hash);
+	if (caa_unlikely(node == _CDS_LFHT_CHAIN_NODE_HASH)) {
+		/* The library symbol: cds_lfht_lookup is not mapped yet. */
+		cds_lfht_lookup(ht, hash, match, key, iter);
+		return;
+	}
+	for (;;) {
+		if (caa_unlikely(!node)) {
+			next = NULL;
+			break;
+		}
+		if (caa_unlikely(node->reverse_hash > reverse_hash)) {
+			node = next = NULL;
+			break;
+		}
+		next = rcu_dereference(node->next);
+		_cds_lfht_prefetch_next(next);
+		if (caa_likely(!((unsigned long) next
+				& (_CDS_LFHT_REMOVED_FLAG | _CDS_LFHT_BUCKET_FLAG)))
+		    && node->reverse_hash == reverse_hash
+		    && (!match || caa_likely(match(node, key)))) {
+				break;
+		}
+		node = _cds_lfht_clear_flag(next);
+	}
+	iter->node = node;
+	iter->next = next;
+}
+
+/*
+ * _cds_lfht_key_load: load a key word, @key having no alignment
+ * requirement.
+ */
+static inline
+uint64_t _cds_lfht_key_load(const void *key, unsigned int i)
+{
+	uint64_t v;
+
+	memcpy(&v, (const char *) key + i * sizeof(v), sizeof(v));
+	return v;
+}
+
+/*
+ * _cds_lfht_match_key8, _cds_lfht_match_key16, _cds_lfht_match_key32:
+ * match functions of the nodes with an inline key.
+ *
+ * The words are compared without branches, which compilers turn into
+ * vector compares where the target has them.
+ */
+static inline
+int _cds_lfht_match_key8(struct cds_lfht_node *node, const void *key)
+{
+	struct cds_lfht_node_key8 *n =
+		caa_container_of(node, struct cds_lfht_node_key8, node);
+
+	return n->key == _cds_lfht_key_load(key, 0);
+}
+
+static inline
+int _cds_lfht_match_key16(struct cds_lfht_node *node, const void *key)
+{
+	struct cds_lfht_node_key16 *n =
+		caa_container_of(node, struct cds_lfht_node_key16, node);
+
+	return !((n->key[0] ^ _cds_lfht_key_load(key, 0))
+		| (n->key[1] ^ _cds_lfht_key_load(key, 1)));
+}
+
+static inline
+int _cds_lfht_match_key32(struct cds_lfht_node *node, const void *key)
+{
+	struct cds_lfht_node_key32 *n =
+		caa_container_of(node, struct cds_lfht_node_key32, node);
+
+	return !((n->key[0] ^ _cds_lfht_key_load(key, 0))
+		| (n->key[1] ^ _cds_lfht_key_load(key, 1))
+		| (n->key[2] ^ _cds_lfht_key_load(key, 2))
+		| (n->key[3] ^ _cds_lfht_key_load(key, 3)));
+}
+
+/*
+ * _cds_lfht_lookup_key8, _cds_lfht_lookup_key16, _cds_lfht_lookup_key32:
+ * lookup a node with an inline key by key.
+ *
+ * Same semantic as cds_lfht_lookup_key8(), cds_lfht_lookup_key16() and
+ * cds_lfht_lookup_key32().
+ */
+static inline
+void _cds_lfht_lookup_key8(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	_cds_lfht_lookup(ht, hash, _cds_lfht_match_key8, key, iter);
+}
+
+static inline
+void _cds_lfht_lookup_key16(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	_cds_lfht_lookup(ht, hash, _cds_lfht_match_key16, key, iter);
+}
+
+static inline
+void _cds_lfht_lookup_key32(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	_cds_lfht_lookup(ht, hash, _cds_lfht_match_key32, key, iter);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_STATIC_H */
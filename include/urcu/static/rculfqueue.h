@@ -55,10 +55,40 @@ struct cds_lfq_node_rcu_dummy {
  * (it means a dummy node dequeue-requeue is in progress). This ensures
  * that there is always at least one node in the queue.
  *
- * In the dequeue operation, we internally reallocate the dummy node
- * upon dequeue/requeue and use call_rcu to free the old one after a
+ * In the dequeue operation, we internally use a new dummy node upon
+ * dequeue/requeue and use call_rcu to release the old one after a
  * grace period.
+ *
+ * Released dummy nodes are pushed on the dummy_cache stack of the queue,
+ * linked by their next pointer, rather than freed, so that a queue going
+ * back and forth between empty and non-empty does not allocate. Dummy
+ * nodes are popped from the cache under RCU read lock, and only pushed
+ * back a grace period after being dequeued, which protects the pop
+ * cmpxchg from ABA. Destroy closes the cache, after which released dummy
+ * nodes are freed.
+ */
+
+#define CDS_LFQ_DUMMY_CACHE_CLOSED	((struct cds_lfq_node_rcu *) 0x1UL)
+
+/*
+ * Called under rcu read lock critical section, or without concurrent
+ * access to the queue.
  */
+static inline
+struct cds_lfq_node_rcu_dummy *get_cached_dummy(struct cds_lfq_queue_rcu *q)
+{
+	struct cds_lfq_node_rcu *node, *next;
+
+	for (;;) {
+		node = rcu_dereference(q->dummy_cache);
+		if (!node)
+			return NULL;
+		next = CMM_LOAD_SHARED(node->next);
+		if (uatomic_cmpxchg(&q->dummy_cache, node, next) == node)
+			return caa_container_of(node,
+				struct cds_lfq_node_rcu_dummy, parent);
+	}
+}
 
 static inline
 struct cds_lfq_node_rcu *make_dummy(struct cds_lfq_queue_rcu *q,
@@ -66,8 +96,11 @@ struct cds_lfq_node_rcu *make_dummy(struct cds_lfq_queue_rcu *q,
 {
 	struct cds_lfq_node_rcu_dummy *dummy;
 
-	dummy = malloc(sizeof(struct cds_lfq_node_rcu_dummy));
-	assert(dummy);
+	dummy = get_cached_dummy(q);
+	if (!dummy) {
+		dummy = malloc(sizeof(struct cds_lfq_node_rcu_dummy));
+		assert(dummy);
+	}
 	dummy->parent.next = next;
 	dummy->parent.dummy = 1;
 	dummy->q = q;
@@ -79,7 +112,22 @@ void free_dummy_cb(struct rcu_head *head)
 {
 	struct cds_lfq_node_rcu_dummy *dummy =
 		caa_container_of(head, struct cds_lfq_node_rcu_dummy, head);
-	free(dummy);
+	struct cds_lfq_queue_rcu *q = dummy->q;
+	struct cds_lfq_node_rcu *top, *old;
+
+	top = CMM_LOAD_SHARED(q->dummy_cache);
+	for (;;) {
+		if (top == CDS_LFQ_DUMMY_CACHE_CLOSED) {
+			free(dummy);
+			return;
+		}
+		dummy->parent.next = top;
+		/* cmpxchg orders the next store before publication. */
+		old = uatomic_cmpxchg(&q->dummy_cache, top, &dummy->parent);
+		if (old == top)
+			return;
+		top = old;
+	}
 }
 
 static inline
@@ -114,6 +162,7 @@ void _cds_lfq_init_rcu(struct cds_lfq_queue_rcu *q,
 		       void queue_call_rcu(struct rcu_head *head,
 				void (*func)(struct rcu_head *head)))
 {
+	q->dummy_cache = NULL;
 	q->tail = make_dummy(q, NULL);
 	q->head = q->tail;
 	q->queue_call_rcu = queue_call_rcu;
@@ -122,17 +171,26 @@ void _cds_lfq_init_rcu(struct cds_lfq_queue_rcu *q,
 /*
  * The queue should be emptied before calling destroy.
  *
+ * Dummy nodes are recycled into the queue by call_rcu callbacks, so the
+ * queue memory should only be freed once the callbacks queued before
+ * destroy have been executed, e.g. after rcu_barrier().
+ *
  * Return 0 on success, -EPERM if queue is not empty.
  */
 static inline
 int _cds_lfq_destroy_rcu(struct cds_lfq_queue_rcu *q)
 {
-	struct cds_lfq_node_rcu *head;
+	struct cds_lfq_node_rcu *head, *node, *next;
 
 	head = rcu_dereference(q->head);
 	if (!(head->dummy && head->next == NULL))
 		return -EPERM;	/* not empty */
 	free_dummy(head);
+	node = uatomic_xchg(&q->dummy_cache, CDS_LFQ_DUMMY_CACHE_CLOSED);
+	for (; node; node = next) {
+		next = node->next;
+		free_dummy(node);
+	}
 	return 0;
 }
 
@@ -177,7 +235,10 @@ void enqueue_dummy(struct cds_lfq_queue_rcu *q)
 {
 	struct cds_lfq_node_rcu *node;
 
-	/* We need to reallocate to protect from ABA. */
+	/*
+	 * We need a dummy node not in the queue to protect from ABA:
+	 * cached dummy nodes are past a grace period since their dequeue.
+	 */
 	node = make_dummy(q, NULL);
 	_cds_lfq_enqueue_rcu(q, node);
 }
@@ -221,6 +282,65 @@ struct cds_lfq_node_rcu *_cds_lfq_dequeue_rcu(struct cds_lfq_queue_rcu *q)
 	}
 }
 
+/*
+ * Should be called under rcu read lock critical section.
+ *
+ * Dequeues up to @n nodes into @nodes, oldest first, moving the head
+ * past all of them with a single successful cmpxchg. Dummy nodes found
+ * on the way are freed after a grace period. As for single dequeue, the
+ * last node is never dequeued, a dummy node being enqueued after it
+ * first.
+ *
+ * The caller must wait for a grace period to pass before freeing the
+ * returned nodes or modifying their cds_lfq_node_rcu structure.
+ * Returns the number of nodes dequeued, 0 if queue is empty.
+ */
+static inline
+unsigned long _cds_lfq_dequeue_bulk_rcu(struct cds_lfq_queue_rcu *q,
+		struct cds_lfq_node_rcu **nodes, unsigned long n)
+{
+	if (!n)
+		return 0;
+	for (;;) {
+		struct cds_lfq_node_rcu *head, *node, *next;
+		unsigned long i = 0;
+
+		head = rcu_dereference(q->head);
+		node = head;
+		for (;;) {
+			next = rcu_dereference(node->next);
+			if (node->dummy && next == NULL)
+				break;	/* empty */
+			if (!next) {
+				enqueue_dummy(q);
+				next = rcu_dereference(node->next);
+			}
+			if (!node->dummy)
+				nodes[i++] = node;
+			node = next;
+			if (i == n)
+				break;
+		}
+		/* The new head is node. Nothing but dummies to dequeue. */
+		if (!i && node == head)
+			return 0;	/* empty */
+		if (uatomic_cmpxchg(&q->head, head, node) != head)
+			continue;	/* Concurrently pushed. */
+		/*
+		 * The nodes from head to node are ours: their next pointers
+		 * do not change anymore.
+		 */
+		for (; head != node; head = next) {
+			next = head->next;
+			if (head->dummy)
+				rcu_free_dummy(head);
+		}
+		if (i)
+			return i;
+		/* Only dummies were dequeued: try again. */
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
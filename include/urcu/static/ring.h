@@ -0,0 +1,267 @@
+#ifndef _URCU_STATIC_RING_H
+#define _URCU_STATIC_RING_H
+
+/*
+ * urcu/static/ring.h
+ *
+ * Userspace RCU library - Bounded Lock-Free Ring Buffers
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE. See urcu/ring.h for
+ * linking dynamically with the userspace rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline bool _cds_ring_capacity_valid(unsigned long capacity)
+{
+	return capacity && !(capacity & (capacity - 1));
+}
+
+/*
+ * cds_mpmc_ring_init: initialize a ring holding up to @capacity items.
+ *
+ * Slot i starts free for position i, with sequence number i. The
+ * enqueuer of position pos fills slot pos & mask once its sequence is
+ * pos, and sets it to pos + 1. The dequeuer of position pos empties
+ * the slot once its sequence is pos + 1, and sets it to pos + capacity,
+ * the next enqueue position reaching the slot.
+ */
+static inline int _cds_mpmc_ring_init(struct cds_mpmc_ring *ring,
+		unsigned long capacity)
+{
+	unsigned long i;
+
+	if (!_cds_ring_capacity_valid(capacity))
+		return -EINVAL;
+	ring->slots = (struct cds_mpmc_ring_slot *)
+		malloc(capacity * sizeof(*ring->slots));
+	if (!ring->slots)
+		return -ENOMEM;
+	for (i = 0; i < capacity; i++) {
+		ring->slots[i].seq = i;
+		ring->slots[i].item = NULL;
+	}
+	ring->mask = capacity - 1;
+	ring->enqueue_pos = 0;
+	ring->dequeue_pos = 0;
+	return 0;
+}
+
+static inline void _cds_mpmc_ring_destroy(struct cds_mpmc_ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+/*
+ * cds_mpmc_ring_enqueue: enqueue @item.
+ *
+ * Returns false if the ring is full. Content written into the item
+ * before enqueue is visible to the dequeuer. No mutual exclusion is
+ * required.
+ */
+static inline bool _cds_mpmc_ring_enqueue(struct cds_mpmc_ring *ring,
+		void *item)
+{
+	struct cds_mpmc_ring_slot *slot;
+	unsigned long pos, seq, old;
+	long diff;
+
+	pos = CMM_LOAD_SHARED(ring->enqueue_pos);
+	for (;;) {
+		slot = &ring->slots[pos & ring->mask];
+		seq = CMM_LOAD_SHARED(slot->seq);
+		diff = (long) (seq - pos);
+		if (diff == 0) {
+			/*
+			 * Implicit memory barriers around the cmpxchg
+			 * order the sequence load before the item store.
+			 */
+			old = uatomic_cmpxchg(&ring->enqueue_pos, pos, pos + 1);
+			if (old == pos)
+				break;
+			pos = old;
+		} else if (diff < 0) {
+			/* Slot not emptied yet since the previous turn. */
+			return false;
+		} else {
+			/* Position taken by another enqueuer. */
+			pos = CMM_LOAD_SHARED(ring->enqueue_pos);
+		}
+	}
+	CMM_STORE_SHARED(slot->item, item);
+	/* Store item before publishing the slot. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(slot->seq, pos + 1);
+	return true;
+}
+
+/*
+ * cds_mpmc_ring_dequeue: dequeue an item into @item.
+ *
+ * Returns false if the ring is empty. No mutual exclusion is required.
+ */
+static inline bool _cds_mpmc_ring_dequeue(struct cds_mpmc_ring *ring,
+		void **item)
+{
+	struct cds_mpmc_ring_slot *slot;
+	unsigned long pos, seq, old;
+	void *data;
+	long diff;
+
+	pos = CMM_LOAD_SHARED(ring->dequeue_pos);
+	for (;;) {
+		slot = &ring->slots[pos & ring->mask];
+		seq = CMM_LOAD_SHARED(slot->seq);
+		diff = (long) (seq - (pos + 1));
+		if (diff == 0) {
+			/* Load sequence before item. */
+			cmm_smp_rmb();
+			/*
+			 * Load the item before taking the position: the
+			 * slot is not refilled before its sequence is
+			 * updated below, and the implicit memory barriers
+			 * around the cmpxchg order the item load before
+			 * that update.
+			 */
+			data = CMM_LOAD_SHARED(slot->item);
+			old = uatomic_cmpxchg(&ring->dequeue_pos, pos, pos + 1);
+			if (old == pos)
+				break;
+			pos = old;
+		} else if (diff < 0) {
+			/* Slot not filled yet for this turn. */
+			return false;
+		} else {
+			/* Position taken by another dequeuer. */
+			pos = CMM_LOAD_SHARED(ring->dequeue_pos);
+		}
+	}
+	CMM_STORE_SHARED(slot->seq, pos + ring->mask + 1);
+	*item = data;
+	return true;
+}
+
+/*
+ * cds_spsc_ring_init: initialize a ring holding up to @capacity items.
+ *
+ * Items are at positions head to tail - 1, positions increasing without
+ * bound and wrapping around the slots.
+ */
+static inline int _cds_spsc_ring_init(struct cds_spsc_ring *ring,
+		unsigned long capacity)
+{
+	if (!_cds_ring_capacity_valid(capacity))
+		return -EINVAL;
+	ring->slots = (void **) calloc(capacity, sizeof(*ring->slots));
+	if (!ring->slots)
+		return -ENOMEM;
+	ring->mask = capacity - 1;
+	ring->tail = ring->head_cache = 0;
+	ring->head = ring->tail_cache = 0;
+	return 0;
+}
+
+static inline void _cds_spsc_ring_destroy(struct cds_spsc_ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+/*
+ * cds_spsc_ring_enqueue: enqueue @item.
+ *
+ * Returns false if the ring is full. Mutual exclusion with other
+ * enqueuers is required.
+ */
+static inline bool _cds_spsc_ring_enqueue(struct cds_spsc_ring *ring,
+		void *item)
+{
+	unsigned long tail = ring->tail;
+
+	if (caa_unlikely(tail - ring->head_cache > ring->mask)) {
+		ring->head_cache = CMM_LOAD_SHARED(ring->head);
+		/*
+		 * Order the head load, after the dequeuer loaded the
+		 * item, before reuse of its slot.
+		 */
+		cmm_smp_mb();
+		if (tail - ring->head_cache > ring->mask)
+			return false;
+	}
+	CMM_STORE_SHARED(ring->slots[tail & ring->mask], item);
+	/* Store item before publishing it. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(ring->tail, tail + 1);
+	return true;
+}
+
+/*
+ * cds_spsc_ring_dequeue_bulk: dequeue up to @count items into @items.
+ *
+ * Returns the number of items dequeued. Mutual exclusion with other
+ * dequeuers is required.
+ */
+static inline unsigned long _cds_spsc_ring_dequeue_bulk(
+		struct cds_spsc_ring *ring, void **items, unsigned long count)
+{
+	unsigned long head = ring->head, i;
+
+	if (ring->tail_cache - head < count) {
+		ring->tail_cache = CMM_LOAD_SHARED(ring->tail);
+		/* Load tail before items. */
+		cmm_smp_rmb();
+	}
+	if (ring->tail_cache - head < count)
+		count = ring->tail_cache - head;
+	if (!count)
+		return 0;
+	for (i = 0; i < count; i++)
+		items[i] = CMM_LOAD_SHARED(ring->slots[(head + i) & ring->mask]);
+	/* Load items before releasing their slots to the enqueuer. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(ring->head, head + count);
+	return count;
+}
+
+/*
+ * cds_spsc_ring_dequeue: dequeue an item into @item.
+ *
+ * Returns false if the ring is empty. Mutual exclusion with other
+ * dequeuers is required.
+ */
+static inline bool _cds_spsc_ring_dequeue(struct cds_spsc_ring *ring,
+		void **item)
+{
+	return _cds_spsc_ring_dequeue_bulk(ring, item, 1) != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_STATIC_RING_H */
@@ -39,6 +39,7 @@
 #include <urcu/system.h>
 #include <urcu/uatomic.h>
 #include <urcu/list.h>
+#include <urcu/lfstack.h>
 #include <urcu/tls-compat.h>
 #include <urcu/debug.h>
 
@@ -87,13 +88,24 @@ struct rcu_gp {
 
 extern struct rcu_gp rcu_gp;
 
+struct registry_chunk;
+
 struct rcu_reader {
 	/* Data used by both reader and synchronize_rcu() */
 	unsigned long ctr;
+#ifdef CONFIG_RCU_READER_STATS
+	/* Read-side statistics, only written by the reader thread. */
+	unsigned long nr_read_locks;	/* Outermost critical sections */
+	unsigned long nr_nested_locks;	/* Nested critical sections */
+	unsigned long nesting_max;	/* Deepest nesting */
+#endif
 	/* Data used for registry */
 	struct cds_list_head node __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 	pthread_t tid;
 	int alloc;	/* registry entry allocated */
+	struct registry_chunk *chunk;	/* registry chunk of the entry */
+	/* Node of the registrations not yet moved to the registry. */
+	struct cds_lfs_node pending_node;
 };
 
 /*
@@ -142,6 +154,35 @@ static inline enum rcu_state rcu_reader_state(unsigned long *ctr)
  * or RCU_GP_CTR_PHASE.  The smp_mb_slave() ensures that the accesses in
  * _rcu_read_lock() happen before the subsequent read-side critical section.
  */
+#ifdef CONFIG_RCU_READER_STATS
+/*
+ * Count a read-side critical section of the thread, with @tmp its
+ * reader counter before entering it. Plain stores: only the thread
+ * itself writes its statistics, rcu_stats_snapshot() reads them.
+ */
+static inline void _rcu_reader_stats_lock(struct rcu_reader *reader,
+		unsigned long tmp)
+{
+	unsigned long depth;
+
+	if (caa_likely(!(tmp & RCU_GP_CTR_NEST_MASK))) {
+		_CMM_STORE_SHARED(reader->nr_read_locks,
+			reader->nr_read_locks + 1);
+		return;
+	}
+	_CMM_STORE_SHARED(reader->nr_nested_locks,
+		reader->nr_nested_locks + 1);
+	depth = (tmp & RCU_GP_CTR_NEST_MASK) / RCU_GP_COUNT + 1;
+	if (depth > reader->nesting_max)
+		_CMM_STORE_SHARED(reader->nesting_max, depth);
+}
+#else
+static inline void _rcu_reader_stats_lock(struct rcu_reader *reader,
+		unsigned long tmp)
+{
+}
+#endif
+
 static inline void _rcu_read_lock_update(unsigned long tmp)
 {
 	if (caa_likely(!(tmp & RCU_GP_CTR_NEST_MASK))) {
@@ -149,6 +190,7 @@ static inline void _rcu_read_lock_update(unsigned long tmp)
 		urcu_bp_smp_mb_slave();
 	} else
 		_CMM_STORE_SHARED(URCU_TLS(rcu_reader)->ctr, tmp + RCU_GP_COUNT);
+	_rcu_reader_stats_lock(URCU_TLS(rcu_reader), tmp);
 }
 
 /*
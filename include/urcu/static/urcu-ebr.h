@@ -0,0 +1,190 @@
+#ifndef _URCU_EBR_STATIC_H
+#define _URCU_EBR_STATIC_H
+
+/*
+ * urcu-ebr-static.h
+ *
+ * Userspace RCU header, epoch-based reclamation version.
+ *
+ * TO BE INCLUDED ONLY IN CODE THAT IS TO BE RECOMPILED ON EACH LIBURCU
+ * RELEASE. See urcu-ebr.h for linking dynamically with the userspace
+ * rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <urcu/config.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/list.h>
+#include <urcu/tls-compat.h>
+#include <urcu/debug.h>
+
+/*
+ * This code section can only be included in LGPL 2.1 compatible source code.
+ * See below for the function call wrappers which can be used in code meant to
+ * be only linked with the Userspace RCU library. This comes with a small
+ * performance degradation on the read-side due to the added function calls.
+ * This is required to permit relinking with newer versions of the library.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The global epoch advances by RCU_EBR_EPOCH, so that the low bit of
+ * rcu_reader.ctr can flag a reader within a critical section, the
+ * other bits holding the epoch it announced.
+ */
+#define RCU_EBR_ACTIVE		(1UL << 0)
+#define RCU_EBR_EPOCH		(1UL << 1)
+
+/*
+ * Callbacks queued in epoch e are invoked once the global epoch reached
+ * e + RCU_EBR_GP_EPOCHS: a thread keeps one list per epoch that may not
+ * have expired, plus the one of the current epoch.
+ */
+#define RCU_EBR_GP_EPOCHS	3
+#define RCU_EBR_NR_LIMBO	(RCU_EBR_GP_EPOCHS + 1)
+
+struct rcu_head;
+
+/* Callbacks queued in a same epoch, chained through their rcu_head. */
+struct rcu_ebr_limbo {
+	struct rcu_head *head;
+	struct rcu_head *tail;
+	unsigned long epoch;
+};
+
+struct rcu_gp {
+	/*
+	 * Global epoch, advanced by the thread finding every reader within
+	 * a critical section to have announced it.
+	 */
+	unsigned long epoch;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+extern struct rcu_gp rcu_gp;
+
+struct rcu_reader {
+	/* Announced epoch | RCU_EBR_ACTIVE, or 0. Read by epoch advances. */
+	unsigned long ctr;
+	/* Read-side nesting count, only accessed by the thread itself. */
+	unsigned long nesting;
+	/* Callbacks of the thread, limbo_lock. */
+	pthread_mutex_t limbo_lock;
+	struct rcu_ebr_limbo limbo[RCU_EBR_NR_LIMBO];
+	/* Callbacks queued since the last reclaim, thread itself. */
+	unsigned long nr_queued;
+	/* Data used for registry, rcu_registry_lock. */
+#ifdef CONFIG_RCU_COMPACT_READER
+	struct cds_list_head node;
+#else
+	struct cds_list_head node __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+#endif
+	pthread_t tid;
+	/* Reader registered flag, for internal checks. */
+	unsigned int registered:1;
+};
+
+extern DECLARE_URCU_TLS(struct rcu_reader, rcu_reader);
+
+#ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+#define urcu_ebr_has_sys_membarrier	1
+#else
+extern int urcu_ebr_has_sys_membarrier;
+#endif
+
+/*
+ * With sys_membarrier(), the epoch advances issue the memory barriers
+ * on behalf of the readers.
+ */
+static inline void urcu_ebr_smp_mb_slave(void)
+{
+	if (caa_likely(urcu_ebr_has_sys_membarrier))
+		cmm_barrier();
+	else
+		cmm_smp_mb();
+}
+
+/*
+ * Enter an RCU read-side critical section.
+ *
+ * The outermost _rcu_read_lock() announces the global epoch, and reads it
+ * again after smp_mb_slave(): an epoch advance meanwhile may have missed
+ * the announce, so the new epoch is announced instead. Once the epoch
+ * read back matches, it cannot advance twice before the critical section
+ * ends.
+ */
+static inline void _rcu_read_lock(void)
+{
+	unsigned long epoch, tmp;
+
+	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
+	urcu_assert(URCU_TLS(rcu_reader).registered);
+	if (caa_likely(!URCU_TLS(rcu_reader).nesting)) {
+		epoch = CMM_LOAD_SHARED(rcu_gp.epoch);
+		for (;;) {
+			CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr,
+				epoch | RCU_EBR_ACTIVE);
+			urcu_ebr_smp_mb_slave();
+			tmp = CMM_LOAD_SHARED(rcu_gp.epoch);
+			if (caa_likely(tmp == epoch))
+				break;
+			epoch = tmp;
+		}
+	}
+	URCU_TLS(rcu_reader).nesting++;
+}
+
+/*
+ * Exit an RCU read-side critical section. The outermost _rcu_read_unlock()
+ * finishes using rcu before clearing its announce.
+ */
+static inline void _rcu_read_unlock(void)
+{
+	urcu_assert(URCU_TLS(rcu_reader).nesting);
+	if (caa_likely(URCU_TLS(rcu_reader).nesting == 1)) {
+		urcu_ebr_smp_mb_slave();
+		CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, 0);
+	}
+	URCU_TLS(rcu_reader).nesting--;
+	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
+}
+
+/*
+ * Returns whether within a RCU read-side critical section.
+ *
+ * This function is less than 10 lines long.  The intent is that this
+ * function meets the 10-line criterion for LGPL, allowing this function
+ * to be invoked directly from non-LGPL code.
+ */
+static inline int _rcu_read_ongoing(void)
+{
+	return URCU_TLS(rcu_reader).nesting;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_EBR_STATIC_H */
@@ -0,0 +1,301 @@
+#ifndef _URCU_PERCPU_STATIC_H
+#define _URCU_PERCPU_STATIC_H
+
+/*
+ * urcu-percpu-static.h
+ *
+ * Userspace RCU header, per-CPU read-side counters version.
+ *
+ * TO BE INCLUDED ONLY IN CODE THAT IS TO BE RECOMPILED ON EACH LIBURCU
+ * RELEASE. See urcu-percpu.h for linking dynamically with the userspace
+ * rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <urcu/config.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/tls-compat.h>
+#include <urcu/debug.h>
+
+/*
+ * The counters of the running CPU are updated with a restartable
+ * sequence where the glibc rseq registration is available, on x86-64.
+ */
+#if defined(CONFIG_RCU_HAVE_RSEQ) && defined(__x86_64__)
+#define _URCU_PERCPU_RSEQ
+#include <sys/rseq.h>
+#endif
+
+/*
+ * This code section can only be included in LGPL 2.1 compatible source code.
+ * See below for the function call wrappers which can be used in code meant to
+ * be only linked with the Userspace RCU library. This comes with a small
+ * performance degradation on the read-side due to the added function calls.
+ * This is required to permit relinking with newer versions of the library.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-thread rcu_reader.ctr holds the read-side nesting count in its
+ * upper bits, and the index of the counters the outermost
+ * _rcu_read_lock() incremented in its low bit.
+ */
+#define RCU_PERCPU_IDX		(1UL << 0)
+#define RCU_PERCPU_COUNT	(1UL << 1)
+
+/*
+ * Readers increment the lock count of the current index on entry, and
+ * the unlock count of the same index on exit, possibly on another CPU.
+ */
+struct rcu_percpu_count {
+	unsigned long lock[2];
+	unsigned long unlock[2];
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * Used internally by _rcu_read_lock.
+ */
+extern void rcu_percpu_init(void);
+
+struct rcu_gp {
+	/*
+	 * Global grace period counter. Its low bit is the index of the
+	 * counters used by new readers. Written to only by writer with
+	 * mutex taken. Read by both writer and readers.
+	 */
+	unsigned long ctr;
+	/*
+	 * mask + 1 counters, one per possible CPU (rounded up to a power
+	 * of two), updated with restartable sequences, followed by as many
+	 * counters updated atomically by readers which cannot use them.
+	 * Allocated once, by rcu_percpu_init().
+	 */
+	struct rcu_percpu_count *count;
+	unsigned long mask;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+extern struct rcu_gp rcu_gp;
+
+struct rcu_reader {
+	/* Only used by the reader thread and its signal handlers. */
+	unsigned long ctr;
+};
+
+/*
+ * Readers are not registered: synchronize_rcu() only scans the
+ * counters, whatever the number of threads.
+ */
+extern DECLARE_URCU_TLS(struct rcu_reader, rcu_reader);
+
+#ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+#define urcu_percpu_has_sys_membarrier	1
+#else
+extern int urcu_percpu_has_sys_membarrier;
+#endif
+
+#ifdef _URCU_PERCPU_RSEQ
+extern int urcu_percpu_has_rseq;
+#endif
+
+static inline void urcu_percpu_smp_mb_slave(void)
+{
+	if (caa_likely(urcu_percpu_has_sys_membarrier))
+		cmm_barrier();
+	else
+		cmm_smp_mb();
+}
+
+static inline unsigned long *_rcu_percpu_counter(struct rcu_percpu_count *count,
+		int unlock, unsigned long idx)
+{
+	return unlock ? &count->unlock[idx] : &count->lock[idx];
+}
+
+#ifdef _URCU_PERCPU_RSEQ
+
+#define __rcu_percpu_str_1(x)	#x
+#define __rcu_percpu_str(x)	__rcu_percpu_str_1(x)
+
+static inline int _rcu_percpu_rseq_cpu(void)
+{
+	int cpu;
+
+	__asm__ __volatile__ ("movl %%fs:4(%[rseq_offset]), %[cpu]"
+		: [cpu] "=r" (cpu)
+		: [rseq_offset] "r" (__rseq_offset));
+	return cpu;
+}
+
+/*
+ * Increment *v if still running on @cpu, in a restartable sequence
+ * (struct rseq rseq_cs at offset 8, cpu_id at offset 4). Returns
+ * non-zero if preempted, migrated or signaled before the increment.
+ */
+static inline int _rcu_percpu_rseq_inc(unsigned long *v, int cpu)
+{
+	__asm__ __volatile__ goto (
+		".pushsection __rseq_cs, \"aw\"\n\t"
+		".balign 32\n\t"
+		"3:\n\t"
+		".long 0x0, 0x0\n\t"
+		".quad 1f, 2f - 1f, 4f\n\t"
+		".popsection\n\t"
+		"leaq 3b(%%rip), %%rax\n\t"
+		"movq %%rax, %%fs:8(%[rseq_offset])\n\t"
+		"1:\n\t"
+		"cmpl %[cpu], %%fs:4(%[rseq_offset])\n\t"
+		"jnz 4f\n\t"
+		"addq $1, %[v]\n\t"
+		"2:\n\t"
+		".pushsection __rseq_failure, \"ax\"\n\t"
+		/* Signature: ud1 <sig>(%rip), %edi. */
+		".byte 0x0f, 0xb9, 0x3d\n\t"
+		".long " __rcu_percpu_str(RSEQ_SIG) "\n\t"
+		"4:\n\t"
+		"jmp %l[abort]\n\t"
+		".popsection\n\t"
+		: /* asm goto has no outputs */
+		: [cpu] "r" (cpu),
+		  [rseq_offset] "r" (__rseq_offset),
+		  [v] "m" (*v)
+		: "memory", "cc", "rax"
+		: abort);
+	return 0;
+abort:
+	return 1;
+}
+
+#endif /* _URCU_PERCPU_RSEQ */
+
+/*
+ * Counters of the threads which cannot use restartable sequences,
+ * hashed on the address of their rcu_reader.
+ */
+static inline struct rcu_percpu_count *_rcu_percpu_atomic_count(void)
+{
+	unsigned long v = (unsigned long) &URCU_TLS(rcu_reader)
+			/ CAA_CACHE_LINE_SIZE;
+
+	v ^= v >> 16;
+	v *= 0x45d9f3bUL;
+	v ^= v >> 16;
+	return &rcu_gp.count[rcu_gp.mask + 1 + (v & rcu_gp.mask)];
+}
+
+/*
+ * Increment the lock or unlock count of index @idx. Restartable
+ * sequences are aborted by signal delivery, so this is signal-safe.
+ */
+static inline void _rcu_percpu_inc(int unlock, unsigned long idx)
+{
+#ifdef _URCU_PERCPU_RSEQ
+	if (caa_likely(urcu_percpu_has_rseq)) {
+		for (;;) {
+			int cpu = _rcu_percpu_rseq_cpu();
+
+			if (caa_unlikely(cpu < 0
+					|| (unsigned long) cpu > rcu_gp.mask))
+				break;
+			if (caa_likely(!_rcu_percpu_rseq_inc(_rcu_percpu_counter(
+					&rcu_gp.count[cpu], unlock, idx), cpu)))
+				return;
+		}
+	}
+#endif
+	uatomic_inc(_rcu_percpu_counter(_rcu_percpu_atomic_count(),
+			unlock, idx));
+}
+
+/*
+ * Enter an RCU read-side critical section.
+ *
+ * The outermost _rcu_read_lock() counts the reader on the current index,
+ * then stores that index with the nesting count, so a signal handler
+ * nesting a critical section in between uses its own index. The
+ * smp_mb_slave() ensures that the counter update happens before the
+ * subsequent read-side critical section.
+ */
+static inline void _rcu_read_lock(void)
+{
+	unsigned long tmp;
+
+	if (caa_unlikely(!CMM_LOAD_SHARED(rcu_gp.count)))
+		rcu_percpu_init(); /* First reader or updater. */
+	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
+	tmp = URCU_TLS(rcu_reader).ctr;
+	if (caa_likely(tmp < RCU_PERCPU_COUNT)) {
+		unsigned long idx;
+
+		idx = CMM_LOAD_SHARED(rcu_gp.ctr) & RCU_PERCPU_IDX;
+		_rcu_percpu_inc(0, idx);
+		CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr,
+			RCU_PERCPU_COUNT | idx);
+		urcu_percpu_smp_mb_slave();
+	} else {
+		CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr,
+			tmp + RCU_PERCPU_COUNT);
+	}
+}
+
+/*
+ * Exit an RCU read-side critical section. The outermost _rcu_read_unlock()
+ * finishes using rcu before uncounting the reader.
+ */
+static inline void _rcu_read_unlock(void)
+{
+	unsigned long tmp;
+
+	tmp = URCU_TLS(rcu_reader).ctr;
+	urcu_assert(tmp >= RCU_PERCPU_COUNT);
+	if (caa_likely(tmp < 2 * RCU_PERCPU_COUNT)) {
+		urcu_percpu_smp_mb_slave();
+		CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr,
+			tmp - RCU_PERCPU_COUNT);
+		_rcu_percpu_inc(1, tmp & RCU_PERCPU_IDX);
+	} else {
+		CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr,
+			tmp - RCU_PERCPU_COUNT);
+	}
+	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
+}
+
+/*
+ * Returns whether within a RCU read-side critical section.
+ *
+ * This function is less than 10 lines long.  The intent is that this
+ * function meets the 10-line criterion for LGPL, allowing this function
+ * to be invoked directly from non-LGPL code.
+ */
+static inline int _rcu_read_ongoing(void)
+{
+	return URCU_TLS(rcu_reader).ctr >= RCU_PERCPU_COUNT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_PERCPU_STATIC_H */
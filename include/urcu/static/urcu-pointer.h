@@ -85,6 +85,19 @@ extern "C" {
  * meets the 10-line criterion in LGPL, allowing this function to be
  * expanded directly in non-LGPL code.
  */
+#ifdef CMM_HAS_POINTER_ACQ_REL
+
+#define _rcu_cmpxchg_pointer(p, old, _new)				\
+	__extension__							\
+	({								\
+		__typeof__(*p) _________pold = (old);			\
+		__typeof__(*p) _________pnew = (_new);			\
+		uatomic_cmpxchg_mo(p, _________pold, _________pnew,	\
+				CMM_ACQ_REL, CMM_ACQUIRE);		\
+	})
+
+#else /* #ifdef CMM_HAS_POINTER_ACQ_REL */
+
 #define _rcu_cmpxchg_pointer(p, old, _new)				\
 	__extension__							\
 	({								\
@@ -93,6 +106,8 @@ extern "C" {
 		uatomic_cmpxchg(p, _________pold, _________pnew);	\
 	})
 
+#endif /* #else #ifdef CMM_HAS_POINTER_ACQ_REL */
+
 /**
  * _rcu_xchg_pointer - same as rcu_assign_pointer, but returns the previous
  * pointer to the data structure, which can be safely freed after waiting for a
@@ -104,6 +119,24 @@ extern "C" {
  * meets the 10-line criterion in LGPL, allowing this function to be
  * expanded directly in non-LGPL code.
  */
+#ifdef CMM_HAS_POINTER_ACQ_REL
+
+#define _rcu_xchg_pointer(p, v)				\
+	__extension__					\
+	({						\
+		__typeof__(*p) _________pv = (v);	\
+		uatomic_xchg_mo(p, _________pv, CMM_ACQ_REL);	\
+	})
+
+/* A store-release orders the initialization before the publication. */
+#define _rcu_set_pointer(p, v)				\
+	do {						\
+		__typeof__(*p) _________pv = (v);	\
+		uatomic_store(p, _________pv, CMM_RELEASE);	\
+	} while (0)
+
+#else /* #ifdef CMM_HAS_POINTER_ACQ_REL */
+
 #define _rcu_xchg_pointer(p, v)				\
 	__extension__					\
 	({						\
@@ -121,6 +154,8 @@ extern "C" {
 		uatomic_set(p, _________pv);		\
 	} while (0)
 
+#endif /* #else #ifdef CMM_HAS_POINTER_ACQ_REL */
+
 /**
  * _rcu_assign_pointer - assign (publicize) a pointer to a new data structure
  * meant to be read by RCU read-side critical sections. Returns the assigned
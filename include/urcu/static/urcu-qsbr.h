@@ -35,6 +35,7 @@
 #include <unistd.h>
 #include <stdint.h>
 
+#include <urcu/config.h>
 #include <urcu/compiler.h>
 #include <urcu/arch.h>
 #include <urcu/system.h>
@@ -78,19 +79,63 @@ struct rcu_gp {
 
 extern struct rcu_gp rcu_gp;
 
+/*
+ * Node of the grace-period combining tree, used by synchronize_rcu()
+ * after rcu_use_gp_tree(1): each reader flagged by a grace period
+ * reports its quiescent state to the node of its registry shard, and
+ * the last reader of each node reports to the root, so the updater
+ * waits on the root instead of scanning all the readers.
+ */
+struct rcu_gp_node {
+	long pending;			/* Readers or nodes yet to report */
+	struct rcu_gp_node *parent;	/* NULL for the root */
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
 struct rcu_reader {
 	/* Data used by both reader and synchronize_rcu() */
 	unsigned long ctr;
+	/* Set by the grace period waiting for a report to gp_node. */
+	int gp_need;
+	struct rcu_gp_node *gp_node;
+	/* Batched quiescent states, only used by the reader thread. */
+	unsigned int qs_countdown;
+	caa_cycles_t qs_last;
+#ifdef CONFIG_RCU_READER_STATS
+	/* Read-side statistics, only written by the reader thread. */
+	unsigned long nr_read_locks;	/* rcu_read_lock() calls */
+	unsigned long nr_quiescent_states;	/* rcu_quiescent_state() calls */
+#endif
 	/* Data used for registry */
+#ifdef CONFIG_RCU_COMPACT_READER
+	struct cds_list_head node;
+#else
 	struct cds_list_head node __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+#endif
 	int waiting;
 	pthread_t tid;
 	/* Reader registered flag, for internal checks. */
 	unsigned int registered:1;
+	/* Recent grace periods delayed past the spin budget. */
+	unsigned int gp_slow;
 };
 
 extern DECLARE_URCU_TLS(struct rcu_reader, rcu_reader);
 
+/*
+ * Set by rcu_use_sys_membarrier(): synchronize_rcu() then issues
+ * sys_membarrier() on the readers instead of them issuing memory
+ * barriers when reporting quiescent states.
+ */
+extern int urcu_qsbr_has_sys_membarrier;
+
+static inline void urcu_qsbr_smp_mb_slave(void)
+{
+	if (urcu_qsbr_has_sys_membarrier)
+		cmm_barrier();
+	else
+		cmm_smp_mb();
+}
+
 /*
  * Wake-up waiting synchronize_rcu(). Called from many concurrent threads.
  */
@@ -112,6 +157,43 @@ static inline void wake_up_gp(void)
 	}
 }
 
+/*
+ * Report a quiescent state to @node. Returns non-zero if it was the
+ * last one of the grace period.
+ */
+static inline int _rcu_gp_node_report(struct rcu_gp_node *node)
+{
+	while (!uatomic_sub_return(&node->pending, 1)) {
+		node = node->parent;
+		if (!node)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Report the quiescent state the current grace period waits for, unless
+ * synchronize_rcu() found it first, and wake it up if it was the last.
+ * Called after storing URCU_TLS(rcu_reader).ctr and a barrier.
+ */
+static inline void _rcu_gp_tree_report(void)
+{
+	if (!uatomic_xchg(&URCU_TLS(rcu_reader).gp_need, 0))
+		return;
+	if (!_rcu_gp_node_report(URCU_TLS(rcu_reader).gp_node))
+		return;
+	if (uatomic_read(&rcu_gp.futex) != -1)
+		return;
+	uatomic_set(&rcu_gp.futex, 0);
+	(void) futex_noasync(&rcu_gp.futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static inline void rcu_gp_tree_report(void)
+{
+	if (caa_unlikely(_CMM_LOAD_SHARED(URCU_TLS(rcu_reader).gp_need)))
+		_rcu_gp_tree_report();
+}
+
 static inline enum rcu_state rcu_reader_state(unsigned long *ctr)
 {
 	unsigned long v;
@@ -134,6 +216,10 @@ static inline enum rcu_state rcu_reader_state(unsigned long *ctr)
 static inline void _rcu_read_lock(void)
 {
 	urcu_assert(URCU_TLS(rcu_reader).ctr);
+#ifdef CONFIG_RCU_READER_STATS
+	_CMM_STORE_SHARED(URCU_TLS(rcu_reader).nr_read_locks,
+		URCU_TLS(rcu_reader).nr_read_locks + 1);
+#endif
 }
 
 /*
@@ -162,8 +248,8 @@ static inline int _rcu_read_ongoing(void)
 
 /*
  * This is a helper function for _rcu_quiescent_state().
- * The first cmm_smp_mb() ensures memory accesses in the prior read-side
- * critical sections are not reordered with store to
+ * The first urcu_qsbr_smp_mb_slave() ensures memory accesses in the
+ * prior read-side critical sections are not reordered with store to
  * URCU_TLS(rcu_reader).ctr, and ensures that mutexes held within an
  * offline section that would happen to end with this
  * rcu_quiescent_state() call are not reordered with
@@ -171,11 +257,13 @@ static inline int _rcu_read_ongoing(void)
  */
 static inline void _rcu_quiescent_state_update_and_wakeup(unsigned long gp_ctr)
 {
-	cmm_smp_mb();
+	urcu_qsbr_smp_mb_slave();
 	_CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, gp_ctr);
-	cmm_smp_mb();	/* write URCU_TLS(rcu_reader).ctr before read futex */
+	/* write URCU_TLS(rcu_reader).ctr before read futex and gp_need */
+	urcu_qsbr_smp_mb_slave();
 	wake_up_gp();
-	cmm_smp_mb();
+	rcu_gp_tree_report();
+	urcu_qsbr_smp_mb_slave();
 }
 
 /*
@@ -195,11 +283,47 @@ static inline void _rcu_quiescent_state(void)
 	unsigned long gp_ctr;
 
 	urcu_assert(URCU_TLS(rcu_reader).registered);
+#ifdef CONFIG_RCU_READER_STATS
+	_CMM_STORE_SHARED(URCU_TLS(rcu_reader).nr_quiescent_states,
+		URCU_TLS(rcu_reader).nr_quiescent_states + 1);
+#endif
 	if ((gp_ctr = CMM_LOAD_SHARED(rcu_gp.ctr)) == URCU_TLS(rcu_reader).ctr)
 		return;
 	_rcu_quiescent_state_update_and_wakeup(gp_ctr);
 }
 
+/*
+ * Inform RCU of a quiescent state once every @n calls, @n being at
+ * least 1, counting down in a thread-local variable. The grace periods
+ * then wait for up to @n - 1 calls after the readers pass through a
+ * quiescent state: this suits loops calling it at a steady rate.
+ */
+static inline void _rcu_quiescent_state_every(unsigned int n)
+{
+	if (caa_likely(URCU_TLS(rcu_reader).qs_countdown)) {
+		URCU_TLS(rcu_reader).qs_countdown--;
+		return;
+	}
+	URCU_TLS(rcu_reader).qs_countdown = n ? n - 1 : 0;
+	_rcu_quiescent_state();
+}
+
+/*
+ * Inform RCU of a quiescent state if @interval cycles, in the unit of
+ * caa_get_cycles(), elapsed since the last one reported by this
+ * function. This bounds the report latency whatever the call rate, at
+ * the cost of reading the cycle counter.
+ */
+static inline void _rcu_quiescent_state_timed(caa_cycles_t interval)
+{
+	caa_cycles_t now = caa_get_cycles();
+
+	if (now - URCU_TLS(rcu_reader).qs_last < interval)
+		return;
+	URCU_TLS(rcu_reader).qs_last = now;
+	_rcu_quiescent_state();
+}
+
 /*
  * Take a thread offline, prohibiting it from entering further RCU
  * read-side critical sections.
@@ -211,10 +335,12 @@ static inline void _rcu_quiescent_state(void)
 static inline void _rcu_thread_offline(void)
 {
 	urcu_assert(URCU_TLS(rcu_reader).registered);
-	cmm_smp_mb();
+	urcu_qsbr_smp_mb_slave();
 	CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, 0);
-	cmm_smp_mb();	/* write URCU_TLS(rcu_reader).ctr before read futex */
+	/* write URCU_TLS(rcu_reader).ctr before read futex and gp_need */
+	urcu_qsbr_smp_mb_slave();
 	wake_up_gp();
+	rcu_gp_tree_report();
 	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
 }
 
@@ -231,7 +357,7 @@ static inline void _rcu_thread_online(void)
 	urcu_assert(URCU_TLS(rcu_reader).registered);
 	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
 	_CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, CMM_LOAD_SHARED(rcu_gp.ctr));
-	cmm_smp_mb();
+	urcu_qsbr_smp_mb_slave();
 }
 
 #ifdef __cplusplus
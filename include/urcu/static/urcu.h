@@ -147,33 +147,64 @@ struct rcu_reader {
 	/* Data used by both reader and synchronize_rcu() */
 	unsigned long ctr;
 	char need_mb;
+#ifdef CONFIG_RCU_READER_STATS
+	/* Read-side statistics, only written by the reader thread. */
+	unsigned long nr_read_locks;	/* Outermost critical sections */
+	unsigned long nr_nested_locks;	/* Nested critical sections */
+	unsigned long nesting_max;	/* Deepest nesting */
+#endif
 	/* Data used for registry */
+#ifdef CONFIG_RCU_COMPACT_READER
+	struct cds_list_head node;
+#else
 	struct cds_list_head node __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+#endif
 	pthread_t tid;
 	/* Reader registered flag, for internal checks. */
 	unsigned int registered:1;
+	/* Recent grace periods delayed past the spin budget. */
+	unsigned int gp_slow;
 };
 
 extern DECLARE_URCU_TLS(struct rcu_reader, rcu_reader);
 
+/*
+ * Reader of an RCU domain: same state machine as the flavor readers,
+ * against the grace period counter of the domain. Owned by a single
+ * thread, which must also be registered with rcu_register_thread().
+ */
+struct rcu_domain;
+
+struct rcu_domain_reader {
+	struct rcu_reader reader;
+	struct rcu_gp *gp;
+	struct rcu_domain *domain;
+};
+
 /*
  * Wake-up waiting synchronize_rcu(). Called from many concurrent threads.
  */
-static inline void wake_up_gp(void)
+static inline void __wake_up_gp(struct rcu_gp *gp)
 {
-	if (caa_unlikely(uatomic_read(&rcu_gp.futex) == -1)) {
-		uatomic_set(&rcu_gp.futex, 0);
+	if (caa_unlikely(uatomic_read(&gp->futex) == -1)) {
+		uatomic_set(&gp->futex, 0);
 		/*
 		 * Ignoring return value until we can make this function
 		 * return something (because urcu_die() is not publicly
 		 * exposed).
 		 */
-		(void) futex_async(&rcu_gp.futex, FUTEX_WAKE, 1,
+		(void) futex_async(&gp->futex, FUTEX_WAKE, 1,
 				NULL, NULL, 0);
 	}
 }
 
-static inline enum rcu_state rcu_reader_state(unsigned long *ctr)
+static inline void wake_up_gp(void)
+{
+	__wake_up_gp(&rcu_gp);
+}
+
+static inline enum rcu_state __rcu_reader_state(unsigned long *ctr,
+		struct rcu_gp *gp)
 {
 	unsigned long v;
 
@@ -184,11 +215,16 @@ static inline enum rcu_state rcu_reader_state(unsigned long *ctr)
 	v = CMM_LOAD_SHARED(*ctr);
 	if (!(v & RCU_GP_CTR_NEST_MASK))
 		return RCU_READER_INACTIVE;
-	if (!((v ^ rcu_gp.ctr) & RCU_GP_CTR_PHASE))
+	if (!((v ^ gp->ctr) & RCU_GP_CTR_PHASE))
 		return RCU_READER_ACTIVE_CURRENT;
 	return RCU_READER_ACTIVE_OLD;
 }
 
+static inline enum rcu_state rcu_reader_state(unsigned long *ctr)
+{
+	return __rcu_reader_state(ctr, &rcu_gp);
+}
+
 /*
  * Helper for _rcu_read_lock().  The format of rcu_gp.ctr (as well as
  * the per-thread rcu_reader.ctr) has the upper bits containing a count of
@@ -196,13 +232,49 @@ static inline enum rcu_state rcu_reader_state(unsigned long *ctr)
  * or RCU_GP_CTR_PHASE.  The smp_mb_slave() ensures that the accesses in
  * _rcu_read_lock() happen before the subsequent read-side critical section.
  */
-static inline void _rcu_read_lock_update(unsigned long tmp)
+static inline void __rcu_read_lock_update(struct rcu_reader *reader,
+		struct rcu_gp *gp, unsigned long tmp)
 {
 	if (caa_likely(!(tmp & RCU_GP_CTR_NEST_MASK))) {
-		_CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, _CMM_LOAD_SHARED(rcu_gp.ctr));
+		_CMM_STORE_SHARED(reader->ctr, _CMM_LOAD_SHARED(gp->ctr));
 		smp_mb_slave();
 	} else
-		_CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, tmp + RCU_GP_COUNT);
+		_CMM_STORE_SHARED(reader->ctr, tmp + RCU_GP_COUNT);
+}
+
+#ifdef CONFIG_RCU_READER_STATS
+/*
+ * Count a read-side critical section of the thread, with @tmp its
+ * reader counter before entering it. Plain stores: only the thread
+ * itself writes its statistics, rcu_stats_snapshot() reads them.
+ */
+static inline void _rcu_reader_stats_lock(struct rcu_reader *reader,
+		unsigned long tmp)
+{
+	unsigned long depth;
+
+	if (caa_likely(!(tmp & RCU_GP_CTR_NEST_MASK))) {
+		_CMM_STORE_SHARED(reader->nr_read_locks,
+			reader->nr_read_locks + 1);
+		return;
+	}
+	_CMM_STORE_SHARED(reader->nr_nested_locks,
+		reader->nr_nested_locks + 1);
+	depth = (tmp & RCU_GP_CTR_NEST_MASK) / RCU_GP_COUNT + 1;
+	if (depth > reader->nesting_max)
+		_CMM_STORE_SHARED(reader->nesting_max, depth);
+}
+#else
+static inline void _rcu_reader_stats_lock(struct rcu_reader *reader,
+		unsigned long tmp)
+{
+}
+#endif
+
+static inline void _rcu_read_lock_update(unsigned long tmp)
+{
+	__rcu_read_lock_update(&URCU_TLS(rcu_reader), &rcu_gp, tmp);
+	_rcu_reader_stats_lock(&URCU_TLS(rcu_reader), tmp);
 }
 
 /*
@@ -234,15 +306,22 @@ static inline void _rcu_read_lock(void)
  * The second smp_mb_slave() call ensures that we write to rcu_reader.ctr
  * before reading the update-side futex.
  */
-static inline void _rcu_read_unlock_update_and_wakeup(unsigned long tmp)
+static inline void __rcu_read_unlock_update_and_wakeup(
+		struct rcu_reader *reader, struct rcu_gp *gp, unsigned long tmp)
 {
 	if (caa_likely((tmp & RCU_GP_CTR_NEST_MASK) == RCU_GP_COUNT)) {
 		smp_mb_slave();
-		_CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, tmp - RCU_GP_COUNT);
+		_CMM_STORE_SHARED(reader->ctr, tmp - RCU_GP_COUNT);
 		smp_mb_slave();
-		wake_up_gp();
+		__wake_up_gp(gp);
 	} else
-		_CMM_STORE_SHARED(URCU_TLS(rcu_reader).ctr, tmp - RCU_GP_COUNT);
+		_CMM_STORE_SHARED(reader->ctr, tmp - RCU_GP_COUNT);
+}
+
+static inline void _rcu_read_unlock_update_and_wakeup(unsigned long tmp)
+{
+	__rcu_read_unlock_update_and_wakeup(&URCU_TLS(rcu_reader),
+			&rcu_gp, tmp);
 }
 
 /*
@@ -273,6 +352,39 @@ static inline int _rcu_read_ongoing(void)
 	return URCU_TLS(rcu_reader).ctr & RCU_GP_CTR_NEST_MASK;
 }
 
+/*
+ * Enter and exit a read-side critical section of the domain of @r,
+ * obtained from rcu_domain_register_thread(). Domain read-side
+ * critical sections nest, and only delay the grace periods of their
+ * domain.
+ */
+static inline void _rcu_domain_read_lock(struct rcu_domain_reader *r)
+{
+	unsigned long tmp;
+
+	urcu_assert(r->reader.registered);
+	cmm_barrier();
+	tmp = r->reader.ctr;
+	urcu_assert((tmp & RCU_GP_CTR_NEST_MASK) != RCU_GP_CTR_NEST_MASK);
+	__rcu_read_lock_update(&r->reader, r->gp, tmp);
+}
+
+static inline void _rcu_domain_read_unlock(struct rcu_domain_reader *r)
+{
+	unsigned long tmp;
+
+	urcu_assert(r->reader.registered);
+	tmp = r->reader.ctr;
+	urcu_assert(tmp & RCU_GP_CTR_NEST_MASK);
+	__rcu_read_unlock_update_and_wakeup(&r->reader, r->gp, tmp);
+	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
+}
+
+static inline int _rcu_domain_read_ongoing(struct rcu_domain_reader *r)
+{
+	return r->reader.ctr & RCU_GP_CTR_NEST_MASK;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <urcu/compiler.h>
 #include <urcu/uatomic.h>
+#include <urcu/eventcount.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -223,6 +224,75 @@ static inline bool _cds_wfcq_enqueue(cds_wfcq_head_ptr_t head,
 	return ___cds_wfcq_append(head, tail, new_tail, new_tail);
 }
 
+/*
+ * __cds_wfcq_enqueue_sp: enqueue a node into a queue the caller has
+ * exclusive access to.
+ *
+ * Publishes the node with plain stores instead of exchanging the tail,
+ * so it requires mutual exclusion against all enqueue, dequeue and
+ * splice operations on the queue, e.g. for a queue local to a thread,
+ * later spliced into a shared queue. Dequeue and splice move the tail
+ * too, so a single producer racing with a consumer still needs
+ * cds_wfcq_enqueue(). Issues no memory barrier.
+ *
+ * Returns false if the queue was empty prior to adding the node.
+ * Returns true otherwise.
+ */
+static inline bool ___cds_wfcq_enqueue_sp(cds_wfcq_head_ptr_t u_head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *new_tail)
+{
+	struct __cds_wfcq_head *head = u_head._h;
+	struct cds_wfcq_node *old_tail = tail->p;
+
+	tail->p = new_tail;
+	old_tail->next = new_tail;
+	return old_tail != &head->node;
+}
+
+/*
+ * cds_wfcq_enqueue_batch: enqueue a chain of nodes into a wait-free
+ * queue.
+ *
+ * The nodes from @first to @last are linked through their next
+ * pointer by the caller, and @last->next is NULL. They are enqueued
+ * with a single exchange of the tail.
+ *
+ * Issues a full memory barrier before enqueue. No mutual exclusion is
+ * required.
+ *
+ * Returns false if the queue was empty prior to adding the nodes.
+ * Returns true otherwise.
+ */
+static inline bool _cds_wfcq_enqueue_batch(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last)
+{
+	return ___cds_wfcq_append(head, tail, first, last);
+}
+
+/*
+ * cds_wfcq_enqueue_wake: enqueue a node, and wake up the consumers
+ * waiting on @ec in cds_wfcq_dequeue_wait().
+ *
+ * Only issues a wake up, and only a system call if a consumer sleeps,
+ * when the queue was empty. No mutual exclusion is required.
+ *
+ * Returns false if the queue was empty prior to adding the node.
+ * Returns true otherwise.
+ */
+static inline bool _cds_wfcq_enqueue_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *new_tail,
+		struct cds_eventcount *ec)
+{
+	if (_cds_wfcq_enqueue(head, tail, new_tail))
+		return true;
+	(void) cds_eventcount_wake(ec);
+	return false;
+}
+
 /*
  * CDS_WFCQ_WAIT_SLEEP:
  *
@@ -648,6 +718,34 @@ _cds_wfcq_dequeue_blocking(struct cds_wfcq_head *head,
 	return _cds_wfcq_dequeue_with_state_blocking(head, tail, NULL);
 }
 
+/*
+ * cds_wfcq_dequeue_wait: dequeue node from queue, sleeping on @ec while
+ * the queue is empty.
+ *
+ * Same as cds_wfcq_dequeue_blocking, but never returns NULL. Producers
+ * wake up the consumer with cds_wfcq_enqueue_wake() on the same @ec.
+ */
+static inline struct cds_wfcq_node *
+_cds_wfcq_dequeue_wait(struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_eventcount *ec)
+{
+	struct cds_wfcq_node *node;
+
+	for (;;) {
+		node = _cds_wfcq_dequeue_blocking(head, tail);
+		if (node)
+			return node;
+		cds_eventcount_prepare_wait(ec);
+		if (!_cds_wfcq_empty(cds_wfcq_head_cast(head), tail)) {
+			cds_eventcount_cancel_wait(ec);
+			continue;
+		}
+		/* Errors are spurious wake ups: the queue is rechecked. */
+		(void) cds_eventcount_wait(ec);
+	}
+}
+
 /*
  * cds_wfcq_splice_blocking: enqueue all src_q nodes at the end of dest_q.
  *
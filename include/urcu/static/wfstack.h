@@ -445,6 +445,67 @@ _cds_wfs_next_nonblocking(struct cds_wfs_node *node)
 	return ___cds_wfs_next(node, 0);
 }
 
+/*
+ * cds_wfs_batch_init: initialize a single-consumer pop batch.
+ */
+static inline
+void _cds_wfs_batch_init(struct cds_wfs_batch *batch)
+{
+	batch->next = NULL;
+}
+
+/*
+ * __cds_wfs_pop_batch_with_state_blocking: pop a node from the stack,
+ * for a single consumer.
+ *
+ * When @batch is empty, takes all the nodes of the stack at once with
+ * __cds_wfs_pop_all, then returns them one at a time from @batch. This
+ * costs one atomic exchange per batch instead of one cmpxchg per pop,
+ * which pushes racing with the pop never make retry. Nodes pushed after
+ * the batch was taken are only returned once it is exhausted: the pop
+ * order is LIFO within a batch only.
+ *
+ * Requires the synchronization of __cds_wfs_pop_all, and that @batch
+ * is only used by one thread at a time. The nodes left in @batch are
+ * not seen by cds_wfs_empty nor by the other pop operations.
+ *
+ * "state" is set to CDS_WFS_STATE_LAST when this pop took a new batch,
+ * thereby emptying the stack.
+ */
+static inline struct cds_wfs_node *
+___cds_wfs_pop_batch_with_state_blocking(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_batch *batch, int *state)
+{
+	struct cds_wfs_node *node;
+
+	if (state)
+		*state = 0;
+	node = batch->next;
+	if (!node) {
+		node = _cds_wfs_first(___cds_wfs_pop_all(u_stack));
+		if (!node)
+			return NULL;
+		if (state)
+			*state |= CDS_WFS_STATE_LAST;
+	}
+	/* Get the next node before the caller may free this one. */
+	batch->next = _cds_wfs_next_blocking(node);
+	return node;
+}
+
+/*
+ * __cds_wfs_pop_batch_blocking: pop a node from the stack, for a single
+ * consumer.
+ *
+ * Same as __cds_wfs_pop_batch_with_state_blocking, without state.
+ */
+static inline struct cds_wfs_node *
+___cds_wfs_pop_batch_blocking(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_batch *batch)
+{
+	return ___cds_wfs_pop_batch_with_state_blocking(u_stack, batch, NULL);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -64,11 +64,24 @@ extern "C" {
  * handlers setup with with sigaltstack(2).
  */
 
+/*
+ * With --enable-tls-initial-exec, the TLS variables of the libraries
+ * are accessed at a fixed offset from the thread pointer, without a
+ * call to __tls_get_addr(). This requires the libraries to be loaded
+ * at program startup, or dlopen() to find their TLS variables room in
+ * the static TLS surplus reserved by the dynamic linker.
+ */
+# ifdef CONFIG_RCU_TLS_INITIAL_EXEC
+#  define URCU_TLS_MODEL	__attribute__((tls_model("initial-exec")))
+# else
+#  define URCU_TLS_MODEL
+# endif
+
 # define DECLARE_URCU_TLS(type, name)	\
-	CONFIG_RCU_TLS type name
+	CONFIG_RCU_TLS type name URCU_TLS_MODEL
 
 # define DEFINE_URCU_TLS(type, name)	\
-	CONFIG_RCU_TLS type name
+	CONFIG_RCU_TLS type name URCU_TLS_MODEL
 
 # define URCU_TLS(name)		(name)
 
@@ -22,7 +22,9 @@
  * Boehm-Demers-Weiser conservative garbage collector.
  */
 
+#include <stdint.h>
 #include <urcu/compiler.h>
+#include <urcu/config.h>
 #include <urcu/system.h>
 
 #ifdef __cplusplus
@@ -32,6 +34,419 @@ extern "C" {
 #define UATOMIC_HAS_ATOMIC_BYTE
 #define UATOMIC_HAS_ATOMIC_SHORT
 
+#define ILLEGAL_INSTR	".inst	0x00000000"
+
+/*
+ * cmpxchg_double, only used when configured with --enable-arm-asm.
+ * Otherwise, the generic implementation uses the double-width compiler
+ * builtin.
+ */
+#ifdef CONFIG_RCU_ARM_ASM
+
+struct __uatomic_double {
+	unsigned long v[2];
+};
+
+#if defined(__ARM_FEATURE_ATOMICS) && !defined(URCU_AARCH64_NO_LSE)
+static inline __attribute__((always_inline))
+int _uatomic_cmpxchg_double(void *addr, unsigned long old1,
+		unsigned long old2, unsigned long _new1, unsigned long _new2)
+{
+	/* casp operates on pairs of consecutive registers, even first. */
+	register unsigned long x0 __asm__ ("x0") = old1;
+	register unsigned long x1 __asm__ ("x1") = old2;
+	register unsigned long x2 __asm__ ("x2") = _new1;
+	register unsigned long x3 __asm__ ("x3") = _new2;
+
+	__asm__ __volatile__(
+	"caspal %0, %1, %3, %4, %2"
+		: "+&r"(x0), "+&r"(x1),
+		  "+Q"(*(struct __uatomic_double *) addr)
+		: "r"(x2), "r"(x3)
+		: "memory");
+	return x0 == old1 && x1 == old2;
+}
+#else
+static inline __attribute__((always_inline))
+int _uatomic_cmpxchg_double(void *addr, unsigned long old1,
+		unsigned long old2, unsigned long _new1, unsigned long _new2)
+{
+	unsigned long tmp, ret;
+
+	__asm__ __volatile__(
+	"1:	ldxp %0, %1, %2\n\t"
+	"eor %0, %0, %3\n\t"
+	"eor %1, %1, %4\n\t"
+	"orr %1, %0, %1\n\t"
+	"cbnz %1, 2f\n\t"
+	"stlxp %w0, %5, %6, %2\n\t"
+	"cbnz %w0, 1b\n\t"
+	"dmb ish\n"
+	"2:"
+		: "=&r"(tmp), "=&r"(ret),
+		  "+Q"(*(struct __uatomic_double *) addr)
+		: "r"(old1), "r"(old2), "r"(_new1), "r"(_new2)
+		: "memory");
+	return !ret;
+}
+#endif
+
+#define UATOMIC_HAS_CMPXCHG_DOUBLE
+#define uatomic_cmpxchg_double(addr, old1, old2, _new1, _new2)		\
+	_uatomic_cmpxchg_double((addr),					\
+				(unsigned long) (old1),			\
+				(unsigned long) (old2),			\
+				(unsigned long) (_new1),		\
+				(unsigned long) (_new2))
+
+#endif /* #ifdef CONFIG_RCU_ARM_ASM */
+
+/*
+ * With the ARMv8.1 Large System Extensions, use the single instruction
+ * atomics (cas, ldadd, swp) rather than load-exclusive/store-exclusive
+ * loops, which scale badly under contention, and ldclr/ldset for
+ * uatomic_and/uatomic_or. Their acquire-release forms order the
+ * operation as a full memory barrier would, as for the fully ordered
+ * atomics of Linux on arm64.
+ *
+ * They are selected at compile time, when targeting ARMv8.1-A or later
+ * (e.g. -march=armv8.1-a or -mcpu=neoverse-n1). Otherwise, the generic
+ * implementation uses the compiler builtins, which GCC 10 and later
+ * turn into calls selecting LSE at runtime with -moutline-atomics,
+ * the default on Linux.
+ *
+ * They are only used when configured with --enable-arm-asm.
+ */
+#if defined(CONFIG_RCU_ARM_ASM) && defined(__ARM_FEATURE_ATOMICS) \
+	&& !defined(URCU_AARCH64_NO_LSE)
+
+/* cmpxchg */
+
+static inline __attribute__((always_inline))
+unsigned long _uatomic_cmpxchg(void *addr, unsigned long old,
+			      unsigned long _new, int len)
+{
+	switch (len) {
+	case 1:
+	{
+		uint8_t result = old;
+
+		__asm__ __volatile__(
+		"casalb %w0, %w2, %1"
+			: "+r"(result), "+Q"(*(uint8_t *) addr)
+			: "r"((uint8_t) _new)
+			: "memory");
+		return result;
+	}
+	case 2:
+	{
+		uint16_t result = old;
+
+		__asm__ __volatile__(
+		"casalh %w0, %w2, %1"
+			: "+r"(result), "+Q"(*(uint16_t *) addr)
+			: "r"((uint16_t) _new)
+			: "memory");
+		return result;
+	}
+	case 4:
+	{
+		uint32_t result = old;
+
+		__asm__ __volatile__(
+		"casal %w0, %w2, %1"
+			: "+r"(result), "+Q"(*(uint32_t *) addr)
+			: "r"((uint32_t) _new)
+			: "memory");
+		return result;
+	}
+	case 8:
+	{
+		uint64_t result = old;
+
+		__asm__ __volatile__(
+		"casal %x0, %x2, %1"
+			: "+r"(result), "+Q"(*(uint64_t *) addr)
+			: "r"((uint64_t) _new)
+			: "memory");
+		return result;
+	}
+	}
+	/*
+	 * generate an illegal instruction. Cannot catch this with
+	 * linker tricks when optimizations are disabled.
+	 */
+	__asm__ __volatile__(ILLEGAL_INSTR);
+	return 0;
+}
+
+#define uatomic_cmpxchg(addr, old, _new)				      \
+	((__typeof__(*(addr))) _uatomic_cmpxchg((addr),			      \
+						caa_cast_long_keep_sign(old), \
+						caa_cast_long_keep_sign(_new),\
+						sizeof(*(addr))))
+
+/* uatomic_add_return */
+
+static inline __attribute__((always_inline))
+unsigned long _uatomic_add_return(void *addr, unsigned long val,
+				 int len)
+{
+	switch (len) {
+	case 1:
+	{
+		uint8_t result;
+
+		__asm__ __volatile__(
+		"ldaddalb %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint8_t *) addr)
+			: "r"((uint8_t) val)
+			: "memory");
+		return (uint8_t) (result + (uint8_t) val);
+	}
+	case 2:
+	{
+		uint16_t result;
+
+		__asm__ __volatile__(
+		"ldaddalh %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint16_t *) addr)
+			: "r"((uint16_t) val)
+			: "memory");
+		return (uint16_t) (result + (uint16_t) val);
+	}
+	case 4:
+	{
+		uint32_t result;
+
+		__asm__ __volatile__(
+		"ldaddal %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint32_t *) addr)
+			: "r"((uint32_t) val)
+			: "memory");
+		return (uint32_t) (result + (uint32_t) val);
+	}
+	case 8:
+	{
+		uint64_t result;
+
+		__asm__ __volatile__(
+		"ldaddal %x2, %x0, %1"
+			: "=r"(result), "+Q"(*(uint64_t *) addr)
+			: "r"((uint64_t) val)
+			: "memory");
+		return (uint64_t) (result + (uint64_t) val);
+	}
+	}
+	/*
+	 * generate an illegal instruction. Cannot catch this with
+	 * linker tricks when optimizations are disabled.
+	 */
+	__asm__ __volatile__(ILLEGAL_INSTR);
+	return 0;
+}
+
+#define uatomic_add_return(addr, v)					    \
+	((__typeof__(*(addr))) _uatomic_add_return((addr),		    \
+						caa_cast_long_keep_sign(v), \
+						sizeof(*(addr))))
+
+/* xchg */
+
+static inline __attribute__((always_inline))
+unsigned long _uatomic_exchange(void *addr, unsigned long val, int len)
+{
+	switch (len) {
+	case 1:
+	{
+		uint8_t result;
+
+		__asm__ __volatile__(
+		"swpalb %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint8_t *) addr)
+			: "r"((uint8_t) val)
+			: "memory");
+		return result;
+	}
+	case 2:
+	{
+		uint16_t result;
+
+		__asm__ __volatile__(
+		"swpalh %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint16_t *) addr)
+			: "r"((uint16_t) val)
+			: "memory");
+		return result;
+	}
+	case 4:
+	{
+		uint32_t result;
+
+		__asm__ __volatile__(
+		"swpal %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint32_t *) addr)
+			: "r"((uint32_t) val)
+			: "memory");
+		return result;
+	}
+	case 8:
+	{
+		uint64_t result;
+
+		__asm__ __volatile__(
+		"swpal %x2, %x0, %1"
+			: "=r"(result), "+Q"(*(uint64_t *) addr)
+			: "r"((uint64_t) val)
+			: "memory");
+		return result;
+	}
+	}
+	/*
+	 * generate an illegal instruction. Cannot catch this with
+	 * linker tricks when optimizations are disabled.
+	 */
+	__asm__ __volatile__(ILLEGAL_INSTR);
+	return 0;
+}
+
+#define uatomic_xchg(addr, v)						    \
+	((__typeof__(*(addr))) _uatomic_exchange((addr),		    \
+						caa_cast_long_keep_sign(v), \
+						sizeof(*(addr))))
+
+/* uatomic_and */
+
+static inline __attribute__((always_inline))
+void _uatomic_and(void *addr, unsigned long val, int len)
+{
+	switch (len) {
+	case 1:
+	{
+		uint8_t result;
+
+		__asm__ __volatile__(
+		"ldclralb %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint8_t *) addr)
+			: "r"((uint8_t) ~val)
+			: "memory");
+		return;
+	}
+	case 2:
+	{
+		uint16_t result;
+
+		__asm__ __volatile__(
+		"ldclralh %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint16_t *) addr)
+			: "r"((uint16_t) ~val)
+			: "memory");
+		return;
+	}
+	case 4:
+	{
+		uint32_t result;
+
+		__asm__ __volatile__(
+		"ldclral %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint32_t *) addr)
+			: "r"((uint32_t) ~val)
+			: "memory");
+		return;
+	}
+	case 8:
+	{
+		uint64_t result;
+
+		__asm__ __volatile__(
+		"ldclral %x2, %x0, %1"
+			: "=r"(result), "+Q"(*(uint64_t *) addr)
+			: "r"((uint64_t) ~val)
+			: "memory");
+		return;
+	}
+	}
+	/*
+	 * generate an illegal instruction. Cannot catch this with
+	 * linker tricks when optimizations are disabled.
+	 */
+	__asm__ __volatile__(ILLEGAL_INSTR);
+}
+
+#define uatomic_and(addr, v)			\
+	(_uatomic_and((addr),			\
+		caa_cast_long_keep_sign(v),	\
+		sizeof(*(addr))))
+#define cmm_smp_mb__before_uatomic_and()	cmm_barrier()
+#define cmm_smp_mb__after_uatomic_and()		cmm_barrier()
+
+/* uatomic_or */
+
+static inline __attribute__((always_inline))
+void _uatomic_or(void *addr, unsigned long val, int len)
+{
+	switch (len) {
+	case 1:
+	{
+		uint8_t result;
+
+		__asm__ __volatile__(
+		"ldsetalb %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint8_t *) addr)
+			: "r"((uint8_t) val)
+			: "memory");
+		return;
+	}
+	case 2:
+	{
+		uint16_t result;
+
+		__asm__ __volatile__(
+		"ldsetalh %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint16_t *) addr)
+			: "r"((uint16_t) val)
+			: "memory");
+		return;
+	}
+	case 4:
+	{
+		uint32_t result;
+
+		__asm__ __volatile__(
+		"ldsetal %w2, %w0, %1"
+			: "=r"(result), "+Q"(*(uint32_t *) addr)
+			: "r"((uint32_t) val)
+			: "memory");
+		return;
+	}
+	case 8:
+	{
+		uint64_t result;
+
+		__asm__ __volatile__(
+		"ldsetal %x2, %x0, %1"
+			: "=r"(result), "+Q"(*(uint64_t *) addr)
+			: "r"((uint64_t) val)
+			: "memory");
+		return;
+	}
+	}
+	/*
+	 * generate an illegal instruction. Cannot catch this with
+	 * linker tricks when optimizations are disabled.
+	 */
+	__asm__ __volatile__(ILLEGAL_INSTR);
+}
+
+#define uatomic_or(addr, v)			\
+	(_uatomic_or((addr),			\
+		caa_cast_long_keep_sign(v),	\
+		sizeof(*(addr))))
+#define cmm_smp_mb__before_uatomic_or()		cmm_barrier()
+#define cmm_smp_mb__after_uatomic_or()		cmm_barrier()
+
+#endif /* #if defined(CONFIG_RCU_ARM_ASM) && defined(__ARM_FEATURE_ATOMICS) ... */
+
 #ifdef __cplusplus
 }
 #endif
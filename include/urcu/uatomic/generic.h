@@ -579,6 +579,40 @@ unsigned long _uatomic_exchange(void *addr, unsigned long val, int len)
 
 #endif /* #else #ifndef uatomic_cmpxchg */
 
+/* uatomic_cmpxchg_double */
+
+#ifndef uatomic_cmpxchg_double
+#if (CAA_BITS_PER_LONG == 64 && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)) \
+	|| (CAA_BITS_PER_LONG == 32 && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8))
+#if (CAA_BITS_PER_LONG == 64)
+__extension__ typedef unsigned __int128 __uatomic_double_t;
+#else
+typedef uint64_t __uatomic_double_t;
+#endif
+
+static inline __attribute__((always_inline))
+int _uatomic_cmpxchg_double(void *addr, unsigned long old1,
+		unsigned long old2, unsigned long _new1, unsigned long _new2)
+{
+	union {
+		unsigned long v[2];
+		__uatomic_double_t d;
+	} old = { { old1, old2 } }, _new = { { _new1, _new2 } };
+
+	return __sync_bool_compare_and_swap((__uatomic_double_t *) addr,
+			old.d, _new.d);
+}
+
+#define UATOMIC_HAS_CMPXCHG_DOUBLE
+#define uatomic_cmpxchg_double(addr, old1, old2, _new1, _new2)		\
+	_uatomic_cmpxchg_double((addr),					\
+				(unsigned long) (old1),			\
+				(unsigned long) (old2),			\
+				(unsigned long) (_new1),		\
+				(unsigned long) (_new2))
+#endif
+#endif /* #ifndef uatomic_cmpxchg_double */
+
 /* uatomic_sub_return, uatomic_add, uatomic_sub, uatomic_inc, uatomic_dec */
 
 #ifndef uatomic_add
@@ -606,6 +640,107 @@ unsigned long _uatomic_exchange(void *addr, unsigned long val, int len)
 #define cmm_smp_mb__after_uatomic_dec()		cmm_smp_mb__after_uatomic_add()
 #endif
 
+/*
+ * Memory order variants: uatomic_cmpxchg_mo, uatomic_xchg_mo,
+ * uatomic_add_return_mo, uatomic_sub_return_mo, uatomic_add_mo,
+ * uatomic_sub_mo, uatomic_inc_mo, uatomic_dec_mo, uatomic_load and
+ * uatomic_store.
+ *
+ * The memory ordering guaranteed by these operations is given by their
+ * last argument, with the meaning of the C11 memory orders, instead of
+ * the full memory barriers before and after implied by uatomic_cmpxchg,
+ * uatomic_xchg and uatomic_add_return. uatomic_cmpxchg_mo takes the
+ * memory order of a successful exchange, then of a failed one, which
+ * cannot be stronger. Use CMM_RELAXED for statistics and other counters
+ * which do not order anything else.
+ *
+ * These map onto the __atomic builtins when the compiler provides them,
+ * and otherwise onto the fully ordered operations above.
+ */
+
+#ifdef __ATOMIC_RELAXED
+
+#define CMM_RELAXED	__ATOMIC_RELAXED
+#define CMM_CONSUME	__ATOMIC_CONSUME
+#define CMM_ACQUIRE	__ATOMIC_ACQUIRE
+#define CMM_RELEASE	__ATOMIC_RELEASE
+#define CMM_ACQ_REL	__ATOMIC_ACQ_REL
+#define CMM_SEQ_CST	__ATOMIC_SEQ_CST
+
+#define uatomic_cmpxchg_mo(addr, old, _new, mos, mof)			      \
+	__extension__							      \
+	({								      \
+		__typeof__(*(addr)) _____old = (old);			      \
+									      \
+		(void) __atomic_compare_exchange_n((addr), &_____old, (_new), \
+				0, (mos), (mof));			      \
+		_____old;						      \
+	})
+
+#define uatomic_xchg_mo(addr, v, mo)				\
+	__atomic_exchange_n((addr), (v), (mo))
+
+#define uatomic_add_return_mo(addr, v, mo)			\
+	__atomic_add_fetch((addr), (v), (mo))
+
+#define uatomic_add_mo(addr, v, mo)				\
+	((void) __atomic_add_fetch((addr), (v), (mo)))
+
+#define uatomic_load(addr, mo)					\
+	__atomic_load_n((addr), (mo))
+
+#define uatomic_store(addr, v, mo)				\
+	__atomic_store_n((addr), (v), (mo))
+
+#else /* #ifdef __ATOMIC_RELAXED */
+
+#define CMM_RELAXED	0
+#define CMM_CONSUME	1
+#define CMM_ACQUIRE	2
+#define CMM_RELEASE	3
+#define CMM_ACQ_REL	4
+#define CMM_SEQ_CST	5
+
+#define uatomic_cmpxchg_mo(addr, old, _new, mos, mof)		\
+	uatomic_cmpxchg((addr), (old), (_new))
+
+#define uatomic_xchg_mo(addr, v, mo)				\
+	uatomic_xchg((addr), (v))
+
+#define uatomic_add_return_mo(addr, v, mo)			\
+	uatomic_add_return((addr), (v))
+
+#define uatomic_add_mo(addr, v, mo)				\
+	((void) uatomic_add_return((addr), (v)))
+
+#define uatomic_load(addr, mo)						\
+	__extension__							\
+	({								\
+		__typeof__(*(addr)) _____v = uatomic_read(addr);	\
+									\
+		if ((mo) != CMM_RELAXED)				\
+			cmm_smp_mb();					\
+		_____v;							\
+	})
+
+#define uatomic_store(addr, v, mo)				\
+	do {							\
+		if ((mo) != CMM_RELAXED)			\
+			cmm_smp_mb();				\
+		uatomic_set((addr), (v));			\
+		if ((mo) == CMM_SEQ_CST)			\
+			cmm_smp_mb();				\
+	} while (0)
+
+#endif /* #else #ifdef __ATOMIC_RELAXED */
+
+#define uatomic_sub_return_mo(addr, v, mo)			\
+	uatomic_add_return_mo((addr), -(caa_cast_long_keep_sign(v)), (mo))
+#define uatomic_sub_mo(addr, v, mo)				\
+	uatomic_add_mo((addr), -(caa_cast_long_keep_sign(v)), (mo))
+#define uatomic_inc_mo(addr, mo)	uatomic_add_mo((addr), 1, (mo))
+#define uatomic_dec_mo(addr, mo)	uatomic_add_mo((addr), -1, (mo))
+
 #ifdef __cplusplus
 }
 #endif
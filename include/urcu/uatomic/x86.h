@@ -620,6 +620,38 @@ extern unsigned long _compat_uatomic_add_return(void *addr,
 #define cmm_smp_mb__before_uatomic_dec()	cmm_barrier()
 #define cmm_smp_mb__after_uatomic_dec()		cmm_barrier()
 
+#if (CAA_BITS_PER_LONG == 64)
+/* cmpxchg_double */
+
+struct __uatomic_double {
+	unsigned long v[2];
+};
+
+static inline __attribute__((always_inline))
+int _uatomic_cmpxchg_double(void *addr, unsigned long old1,
+		unsigned long old2, unsigned long _new1, unsigned long _new2)
+{
+	unsigned char result;
+
+	__asm__ __volatile__(
+	"lock; cmpxchg16b %1\n\t"
+	"sete %0"
+		: "=q"(result), "+m"(*(struct __uatomic_double *) addr),
+		  "+a"(old1), "+d"(old2)
+		: "b"(_new1), "c"(_new2)
+		: "memory");
+	return result;
+}
+
+#define UATOMIC_HAS_CMPXCHG_DOUBLE
+#define uatomic_cmpxchg_double(addr, old1, old2, _new1, _new2)		\
+	_uatomic_cmpxchg_double((addr),					\
+				(unsigned long) (old1),			\
+				(unsigned long) (old2),			\
+				(unsigned long) (_new1),		\
+				(unsigned long) (_new2))
+#endif /* #if (CAA_BITS_PER_LONG == 64) */
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,253 @@
+#ifndef _URCU_URCU_HPP
+#define _URCU_URCU_HPP
+
+/*
+ * urcu/urcu.hpp
+ *
+ * Userspace RCU library - C++ read-side guards and RCU-protected
+ * pointers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor: the flavor
+ * mapping of rcu_read_lock(), call_rcu() and synchronize_rcu() is the
+ * one of the flavor, inlined with _LGPL_SOURCE. Requires C++11.
+ */
+
+#ifndef __cplusplus
+#error "urcu/urcu.hpp is a C++ header"
+#endif
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#include <urcu/compiler.h>
+#include <urcu-pointer.h>
+#include <urcu-call-rcu.h>
+
+namespace rcu {
+
+/*
+ * RAII read-side critical section. Read-side critical sections nest.
+ */
+class read_guard {
+public:
+	read_guard()
+	{
+		rcu_read_lock();
+	}
+
+	~read_guard()
+	{
+		rcu_read_unlock();
+	}
+
+	read_guard(const read_guard &) = delete;
+	read_guard &operator=(const read_guard &) = delete;
+};
+
+/* Number of objects retired with one call_rcu. */
+#define URCU_HPP_RETIRE_BATCH	64
+
+/*
+ * Per-thread list of objects to delete after a grace period, of any
+ * type: objects are retired in batches, each batch being freed by one
+ * call_rcu, so that retired objects need no rcu_head. The last batch
+ * of a thread is waited for with synchronize_rcu() at thread exit, or
+ * queued by retire_flush().
+ */
+class retire_list {
+public:
+	typedef void (*deleter_fct)(void *obj);
+
+	static void retire(void *obj, deleter_fct deleter)
+	{
+		retire_list &list = self();
+
+		if (caa_unlikely(!list.batch_)) {
+			list.batch_ = new (std::nothrow) batch;
+			if (caa_unlikely(!list.batch_)) {
+				/* Out of memory: wait for the grace period. */
+				synchronize_rcu();
+				deleter(obj);
+				return;
+			}
+		}
+		list.batch_->entries[list.batch_->nr].obj = obj;
+		list.batch_->entries[list.batch_->nr].deleter = deleter;
+		if (++list.batch_->nr == URCU_HPP_RETIRE_BATCH)
+			list.flush();
+	}
+
+	/*
+	 * Queue the objects retired by the current thread with call_rcu.
+	 * The calling thread must be a registered RCU thread.
+	 */
+	static void flush_current()
+	{
+		self().flush();
+	}
+
+	retire_list(const retire_list &) = delete;
+	retire_list &operator=(const retire_list &) = delete;
+
+private:
+	struct entry {
+		void *obj;
+		deleter_fct deleter;
+	};
+
+	struct batch {
+		struct rcu_head head;
+		unsigned int nr;
+		entry entries[URCU_HPP_RETIRE_BATCH];
+
+		batch() : nr(0) {}
+	};
+
+	retire_list() : batch_(NULL) {}
+
+	~retire_list()
+	{
+		if (!batch_)
+			return;
+		/* The thread may not be registered anymore: no call_rcu. */
+		synchronize_rcu();
+		free_batch(&batch_->head);
+	}
+
+	static retire_list &self()
+	{
+		static thread_local retire_list list;
+
+		return list;
+	}
+
+	void flush()
+	{
+		if (!batch_)
+			return;
+		call_rcu(&batch_->head, free_batch);
+		batch_ = NULL;
+	}
+
+	static void free_batch(struct rcu_head *head)
+	{
+		batch *b = caa_container_of(head, batch, head);
+		unsigned int i;
+
+		for (i = 0; i < b->nr; i++)
+			b->entries[i].deleter(b->entries[i].obj);
+		delete b;
+	}
+
+	batch *batch_;
+};
+
+/*
+ * retire - delete @obj after a grace period.
+ */
+template <typename T>
+void retire(T *obj)
+{
+	struct deleter {
+		static void fct(void *p)
+		{
+			delete static_cast<T *>(p);
+		}
+	};
+
+	if (obj)
+		retire_list::retire(obj, deleter::fct);
+}
+
+/*
+ * retire_flush - queue the objects retired by the current thread for
+ * deletion after a grace period, rather than waiting for a full batch.
+ * The calling thread must be a registered RCU thread.
+ */
+static inline void retire_flush()
+{
+	retire_list::flush_current();
+}
+
+/*
+ * rcu::rcu_ptr - RCU-protected pointer owning the object it points to.
+ *
+ * Readers load() the pointer within a read-side critical section, and
+ * may use the object until its end. Updaters publish new objects with
+ * exchange() or reset(), which retire the previous object: it is
+ * deleted after a grace period, by a batched call_rcu. Updaters must be
+ * registered RCU threads, and the destructor must not run concurrently
+ * with updaters.
+ */
+template <typename T>
+class rcu_ptr {
+public:
+	rcu_ptr() : p_(NULL) {}
+
+	explicit rcu_ptr(std::unique_ptr<T> p) : p_(p.release()) {}
+
+	~rcu_ptr()
+	{
+		retire(p_);
+	}
+
+	rcu_ptr(const rcu_ptr &) = delete;
+	rcu_ptr &operator=(const rcu_ptr &) = delete;
+
+	/*
+	 * Return the current object. Call with rcu_read_lock held.
+	 */
+	T *load() const
+	{
+		return rcu_dereference(p_);
+	}
+
+	/*
+	 * Publish @p, and retire the previous object.
+	 */
+	void exchange(std::unique_ptr<T> p)
+	{
+		retire(rcu_xchg_pointer(&p_, p.release()));
+	}
+
+	/*
+	 * Publish @p, unless the current object is not @old. Returns true
+	 * and retires @old on success, and leaves @p owning its object
+	 * otherwise.
+	 */
+	bool compare_exchange(T *old, std::unique_ptr<T> &p)
+	{
+		if (rcu_cmpxchg_pointer(&p_, old, p.get()) != old)
+			return false;
+		(void) p.release();
+		retire(old);
+		return true;
+	}
+
+	void reset()
+	{
+		retire(rcu_xchg_pointer(&p_, (T *) NULL));
+	}
+
+private:
+	T *p_;
+};
+
+} /* namespace rcu */
+
+#endif /* _URCU_URCU_HPP */
@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <urcu/compiler.h>
 #include <urcu/arch.h>
+#include <urcu/eventcount.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -128,6 +129,25 @@ struct cds_wfcq_tail {
 	struct cds_wfcq_node *p;
 };
 
+/*
+ * Queue with head and tail on separate cache lines, for queues enqueued
+ * into from many CPUs while being dequeued: the exchange of the tail by
+ * enqueuers does not invalidate the cache line of the head, read by the
+ * dequeuer. Fields following the queue in a structure share the cache
+ * line of the tail. Pass &q->head and &q->tail to the queue functions.
+ * Structures embedding it should be allocated aligned on the cache
+ * line, e.g. with posix_memalign().
+ */
+struct cds_wfcq_queue {
+	struct cds_wfcq_head head __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	struct cds_wfcq_tail tail __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+};
+
+struct __cds_wfcq_queue {
+	struct __cds_wfcq_head head __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	struct cds_wfcq_tail tail __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+};
+
 #ifdef _LGPL_SOURCE
 
 #include <urcu/static/wfcqueue.h>
@@ -138,6 +158,8 @@ struct cds_wfcq_tail {
 #define cds_wfcq_destroy		_cds_wfcq_destroy
 #define cds_wfcq_empty			_cds_wfcq_empty
 #define cds_wfcq_enqueue		_cds_wfcq_enqueue
+#define cds_wfcq_enqueue_batch		_cds_wfcq_enqueue_batch
+#define cds_wfcq_enqueue_wake		_cds_wfcq_enqueue_wake
 
 /* Dequeue locking */
 #define cds_wfcq_dequeue_lock		_cds_wfcq_dequeue_lock
@@ -145,12 +167,16 @@ struct cds_wfcq_tail {
 
 /* Locking performed within cds_wfcq calls. */
 #define cds_wfcq_dequeue_blocking	_cds_wfcq_dequeue_blocking
+#define cds_wfcq_dequeue_wait		_cds_wfcq_dequeue_wait
 #define cds_wfcq_dequeue_with_state_blocking	\
 					_cds_wfcq_dequeue_with_state_blocking
 #define cds_wfcq_splice_blocking	_cds_wfcq_splice_blocking
 #define cds_wfcq_first_blocking		_cds_wfcq_first_blocking
 #define cds_wfcq_next_blocking		_cds_wfcq_next_blocking
 
+/* Exclusive access to the queue ensured by caller */
+#define __cds_wfcq_enqueue_sp		___cds_wfcq_enqueue_sp
+
 /* Locking ensured by caller by holding cds_wfcq_dequeue_lock() */
 #define __cds_wfcq_dequeue_blocking	___cds_wfcq_dequeue_blocking
 #define __cds_wfcq_dequeue_with_state_blocking	\
@@ -267,6 +293,56 @@ extern bool cds_wfcq_enqueue(cds_wfcq_head_ptr_t head,
 		struct cds_wfcq_tail *tail,
 		struct cds_wfcq_node *node);
 
+/*
+ * cds_wfcq_enqueue_batch: enqueue a chain of nodes into a wait-free
+ * queue.
+ *
+ * The nodes from @first to @last are linked through their next
+ * pointer by the caller, and @last->next is NULL. They are enqueued
+ * with a single exchange of the tail.
+ *
+ * Issues a full memory barrier before enqueue. No mutual exclusion is
+ * required.
+ *
+ * Returns false if the queue was empty prior to adding the nodes.
+ * Returns true otherwise.
+ */
+extern bool cds_wfcq_enqueue_batch(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last);
+
+/*
+ * __cds_wfcq_enqueue_sp: enqueue a node into a queue the caller has
+ * exclusive access to.
+ *
+ * Publishes the node with plain stores instead of exchanging the tail,
+ * so it requires mutual exclusion against all enqueue, dequeue and
+ * splice operations on the queue, e.g. for a queue local to a thread,
+ * later spliced into a shared queue. Issues no memory barrier.
+ *
+ * Returns false if the queue was empty prior to adding the node.
+ * Returns true otherwise.
+ */
+extern bool __cds_wfcq_enqueue_sp(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *node);
+
+/*
+ * cds_wfcq_enqueue_wake: enqueue a node, and wake up the consumers
+ * waiting on @ec in cds_wfcq_dequeue_wait().
+ *
+ * Only issues a wake up, and only a system call if a consumer sleeps,
+ * when the queue was empty. No mutual exclusion is required.
+ *
+ * Returns false if the queue was empty prior to adding the node.
+ * Returns true otherwise.
+ */
+extern bool cds_wfcq_enqueue_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *node,
+		struct cds_eventcount *ec);
+
 /*
  * cds_wfcq_dequeue_blocking: dequeue a node from a wait-free queue.
  *
@@ -280,6 +356,18 @@ extern struct cds_wfcq_node *cds_wfcq_dequeue_blocking(
 		struct cds_wfcq_head *head,
 		struct cds_wfcq_tail *tail);
 
+/*
+ * cds_wfcq_dequeue_wait: dequeue a node, sleeping on @ec while the
+ * queue is empty.
+ *
+ * Same as cds_wfcq_dequeue_blocking, but never returns NULL. Producers
+ * wake up the consumer with cds_wfcq_enqueue_wake() on the same @ec.
+ */
+extern struct cds_wfcq_node *cds_wfcq_dequeue_wait(
+		struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_eventcount *ec);
+
 /*
  * cds_wfcq_dequeue_with_state_blocking: dequeue with state.
  *
@@ -0,0 +1,268 @@
+#ifndef _URCU_WFCQUEUE_HPP
+#define _URCU_WFCQUEUE_HPP
+
+/*
+ * urcu/wfcqueue.hpp
+ *
+ * Userspace RCU library - C++ typed wrapper of the Concurrent Queue
+ * with Wait-Free Enqueue/Blocking Dequeue
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE: the queue operations of
+ * urcu/static/wfcqueue.h are inlined in the caller.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Requires C++11.
+ */
+
+#ifndef __cplusplus
+#error "urcu/wfcqueue.hpp is a C++ header"
+#endif
+
+#include <cstddef>
+#include <iterator>
+
+#include <urcu/wfcqueue.h>
+#include <urcu/static/wfcqueue.h>
+#include <urcu/hook.hpp>
+
+namespace rcu {
+
+/*
+ * rcu::wfcqueue - FIFO of T, linked through their Hook member.
+ *
+ * The queue does not own its elements: push() links the element
+ * itself, without allocation, and the element must stay alive until
+ * popped. push() is wait-free and may be called concurrently with
+ * everything. pop() and splice() from the queue are mutually
+ * excluded by the queue mutex.
+ */
+template <typename T, cds_wfcq_node T::*Hook>
+class wfcqueue {
+public:
+	/*
+	 * rcu::wfcqueue::batch - elements taken from a queue at once.
+	 *
+	 * A batch is owned by a single thread: it is built by push() or
+	 * taken from a queue with wfcqueue::pop_all(), and can be
+	 * traversed with a range-for, popped from, or spliced into a
+	 * queue as a whole. Batches are move-constructible, not
+	 * copyable.
+	 */
+	class batch {
+	public:
+		class iterator {
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef T value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef T *pointer;
+			typedef T &reference;
+
+			reference operator*() const
+			{
+				return *from_node(node_);
+			}
+
+			pointer operator->() const
+			{
+				return from_node(node_);
+			}
+
+			iterator &operator++()
+			{
+				node_ = ___cds_wfcq_next_blocking(
+					__cds_wfcq_head_cast(&b_->head_),
+					&b_->tail_, node_);
+				return *this;
+			}
+
+			bool operator==(const iterator &other) const
+			{
+				return node_ == other.node_;
+			}
+
+			bool operator!=(const iterator &other) const
+			{
+				return node_ != other.node_;
+			}
+
+		private:
+			friend class batch;
+
+			iterator(batch *b, struct cds_wfcq_node *node)
+				: b_(b), node_(node) {}
+
+			batch *b_;
+			struct cds_wfcq_node *node_;
+		};
+
+		batch()
+		{
+			___cds_wfcq_init(&head_, &tail_);
+		}
+
+		batch(batch &&other)
+		{
+			___cds_wfcq_init(&head_, &tail_);
+			(void) ___cds_wfcq_splice_blocking(
+				__cds_wfcq_head_cast(&head_), &tail_,
+				__cds_wfcq_head_cast(&other.head_), &other.tail_);
+		}
+
+		batch(const batch &) = delete;
+		batch &operator=(const batch &) = delete;
+		batch &operator=(batch &&) = delete;
+
+		bool empty()
+		{
+			return _cds_wfcq_empty(__cds_wfcq_head_cast(&head_),
+					&tail_);
+		}
+
+		void push(T &obj)
+		{
+			struct cds_wfcq_node *node = &(obj.*Hook);
+
+			_cds_wfcq_node_init(node);
+			(void) _cds_wfcq_enqueue(__cds_wfcq_head_cast(&head_),
+					&tail_, node);
+		}
+
+		/*
+		 * Return the first element, removed from the batch, or NULL
+		 * if the batch is empty.
+		 */
+		T *pop()
+		{
+			struct cds_wfcq_node *node;
+
+			node = ___cds_wfcq_dequeue_blocking(
+				__cds_wfcq_head_cast(&head_), &tail_);
+			return node ? from_node(node) : NULL;
+		}
+
+		/*
+		 * Traversal in FIFO order. Elements may not be removed or
+		 * freed during the traversal: pop() them instead.
+		 */
+		iterator begin()
+		{
+			return iterator(this, ___cds_wfcq_first_blocking(
+				__cds_wfcq_head_cast(&head_), &tail_));
+		}
+
+		iterator end()
+		{
+			return iterator(this, NULL);
+		}
+
+	private:
+		friend class wfcqueue;
+
+		struct __cds_wfcq_head head_;
+		struct cds_wfcq_tail tail_;
+	};
+
+	wfcqueue()
+	{
+		_cds_wfcq_init(&head_, &tail_);
+	}
+
+	~wfcqueue()
+	{
+		_cds_wfcq_destroy(&head_, &tail_);
+	}
+
+	wfcqueue(const wfcqueue &) = delete;
+	wfcqueue &operator=(const wfcqueue &) = delete;
+
+	bool empty()
+	{
+		return _cds_wfcq_empty(cds_wfcq_head_cast(&head_), &tail_);
+	}
+
+	/*
+	 * Enqueue @obj. Returns false if the queue was empty.
+	 */
+	bool push(T &obj)
+	{
+		struct cds_wfcq_node *node = &(obj.*Hook);
+
+		_cds_wfcq_node_init(node);
+		return _cds_wfcq_enqueue(cds_wfcq_head_cast(&head_), &tail_,
+				node);
+	}
+
+	/*
+	 * Enqueue the elements of @b at once, emptying it. Returns false
+	 * if the queue was empty.
+	 */
+	bool push(batch &&b)
+	{
+		return ___cds_wfcq_splice_blocking(cds_wfcq_head_cast(&head_),
+				&tail_, __cds_wfcq_head_cast(&b.head_), &b.tail_)
+			== CDS_WFCQ_RET_DEST_NON_EMPTY;
+	}
+
+	/*
+	 * Dequeue the first element, or return NULL if the queue is
+	 * empty.
+	 */
+	T *pop()
+	{
+		struct cds_wfcq_node *node;
+
+		node = _cds_wfcq_dequeue_blocking(&head_, &tail_);
+		return node ? from_node(node) : NULL;
+	}
+
+	/*
+	 * Take all the elements of the queue at once.
+	 */
+	batch pop_all()
+	{
+		batch b;
+
+		_cds_wfcq_dequeue_lock(&head_, &tail_);
+		(void) ___cds_wfcq_splice_blocking(
+				__cds_wfcq_head_cast(&b.head_), &b.tail_,
+				cds_wfcq_head_cast(&head_), &tail_);
+		_cds_wfcq_dequeue_unlock(&head_, &tail_);
+		return b;
+	}
+
+	/*
+	 * Move all the elements of @src at the end of this queue.
+	 */
+	void splice(wfcqueue &src)
+	{
+		(void) _cds_wfcq_splice_blocking(&head_, &tail_,
+				&src.head_, &src.tail_);
+	}
+
+private:
+	static T *from_node(struct cds_wfcq_node *node)
+	{
+		return container_of<T, cds_wfcq_node, Hook>(node);
+	}
+
+	struct cds_wfcq_head head_;
+	struct cds_wfcq_tail tail_;
+};
+
+} /* namespace rcu */
+
+#endif /* _URCU_WFCQUEUE_HPP */
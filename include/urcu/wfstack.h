@@ -43,6 +43,10 @@ extern "C" {
  * Blocking operations: cds_wfs_pop, cds_wfs_pop_all, cds_wfs_next,
  *                      iteration on stack head returned by pop_all.
  *
+ * A single consumer may use __cds_wfs_pop_batch, which pops the stack
+ * in batches with __cds_wfs_pop_all and returns their nodes one by one,
+ * without any lock.
+ *
  * Synchronization table:
  *
  * External synchronization techniques described in the API below is
@@ -54,6 +58,8 @@ extern "C" {
  * __cds_wfs_pop              -              X                  X
  * __cds_wfs_pop_all          -              X                  -
  *
+ * __cds_wfs_pop_batch requires the synchronization of __cds_wfs_pop_all.
+ *
  * cds_wfs_pop and cds_wfs_pop_all use an internal mutex to provide
  * synchronization.
  */
@@ -83,6 +89,14 @@ struct cds_wfs_head {
 	struct cds_wfs_node node;
 };
 
+/*
+ * struct cds_wfs_batch holds the nodes popped by __cds_wfs_pop_batch
+ * and not returned yet. It is private to its consumer.
+ */
+struct cds_wfs_batch {
+	struct cds_wfs_node *next;
+};
+
 struct __cds_wfs_stack {
 	struct cds_wfs_head *head;
 };
@@ -139,6 +153,12 @@ typedef union {
 					___cds_wfs_pop_with_state_nonblocking
 #define __cds_wfs_pop_all		___cds_wfs_pop_all
 
+/* Single consumer. See synchronization table. */
+#define cds_wfs_batch_init		_cds_wfs_batch_init
+#define __cds_wfs_pop_batch_blocking	___cds_wfs_pop_batch_blocking
+#define __cds_wfs_pop_batch_with_state_blocking	\
+					___cds_wfs_pop_batch_with_state_blocking
+
 #else /* !_LGPL_SOURCE */
 
 /*
@@ -317,6 +337,41 @@ extern struct cds_wfs_node *
  */
 extern struct cds_wfs_head *__cds_wfs_pop_all(cds_wfs_stack_ptr_t u_stack);
 
+/*
+ * cds_wfs_batch_init: initialize a single-consumer pop batch.
+ */
+extern void cds_wfs_batch_init(struct cds_wfs_batch *batch);
+
+/*
+ * __cds_wfs_pop_batch_blocking: pop a node from the stack, for a single
+ * consumer.
+ *
+ * When @batch is empty, takes all the nodes of the stack at once with
+ * __cds_wfs_pop_all, then returns them one at a time from @batch: one
+ * atomic exchange per batch instead of one cmpxchg per pop. Nodes
+ * pushed after the batch was taken are only returned once it is
+ * exhausted: the pop order is LIFO within a batch only.
+ *
+ * Requires the synchronization of __cds_wfs_pop_all, and that @batch
+ * is only used by one thread at a time. The nodes left in @batch are
+ * not seen by cds_wfs_empty nor by the other pop operations.
+ */
+extern struct cds_wfs_node *
+	__cds_wfs_pop_batch_blocking(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_batch *batch);
+
+/*
+ * __cds_wfs_pop_batch_with_state_blocking: pop a node from the stack,
+ * for a single consumer, with state.
+ *
+ * Same as __cds_wfs_pop_batch_blocking, but stores CDS_WFS_STATE_LAST
+ * into state when this pop took a new batch, thereby emptying the
+ * stack.
+ */
+extern struct cds_wfs_node *
+	__cds_wfs_pop_batch_with_state_blocking(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_batch *batch, int *state);
+
 #endif /* !_LGPL_SOURCE */
 
 #ifdef __cplusplus
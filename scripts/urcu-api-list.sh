@@ -29,24 +29,84 @@ api="caa_container_of \
 	call_rcu \
 	call_rcu_after_fork_child \
 	call_rcu_after_fork_parent \
+	call_rcu_batch \
 	call_rcu_before_fork \
 	call_rcu_data_free \
+	call_rcu_data_get_fd \
+	call_rcu_data_get_stats \
+	call_rcu_data_set_helpers \
+	call_rcu_data_set_lazy \
+	call_rcu_data_set_placement \
+	call_rcu_data_set_watermarks \
+	call_rcu_domain \
+	call_rcu_expedited \
+	call_rcu_flush \
+	call_rcu_lazy \
+	call_rcu_local \
+	call_rcu_process_ready \
+	call_rcu_tagged \
+	cds_eventcount_cancel_wait \
+	cds_eventcount_init \
+	cds_eventcount_prepare_wait \
+	cds_eventcount_wait \
+	cds_eventcount_wait_timeout \
+	cds_eventcount_wake \
+	cds_hazptr_acquire \
+	cds_hazptr_clear \
+	cds_hazptr_domain_destroy \
+	cds_hazptr_domain_flush \
+	cds_hazptr_domain_init \
+	cds_hazptr_protect \
+	cds_hazptr_release \
+	cds_hazptr_retire \
+	cds_hazptr_set \
+	cds_hash_bytes \
+	cds_hash_bytes_crc32c \
+	cds_hash_crc32c \
+	cds_hash_u32 \
+	cds_hash_u64 \
+	cds_hash_ulong \
+	cds_hlist_add_before_rcu \
+	cds_hlist_add_behind_rcu \
 	cds_hlist_add_head \
 	cds_hlist_add_head_rcu \
+	cds_hlist_add_sorted_rcu \
 	cds_hlist_del \
 	cds_hlist_del_rcu \
 	cds_hlist_entry \
 	cds_hlist_for_each_entry \
 	cds_hlist_for_each_entry_rcu \
 	cds_hlist_for_each_entry_safe \
+	cds_hlist_replace_all_rcu \
+	cds_hlist_splice_init_rcu \
 	CDS_INIT_HLIST_HEAD \
 	CDS_INIT_LIST_HEAD \
+	cds_ja_add_unique \
+	cds_ja_del \
+	cds_ja_destroy \
+	cds_ja_for_each_key_rcu \
+	cds_ja_lookup \
+	cds_ja_lookup_above_equal \
+	cds_ja_lookup_below_equal \
+	cds_ja_new \
 	cds_lfht_add \
+	cds_lfht_add_hint \
 	cds_lfht_add_replace \
 	cds_lfht_add_unique \
+	cds_lfht_changelog_disable \
+	cds_lfht_changelog_drain \
+	cds_lfht_changelog_enable \
 	cds_lfht_count_nodes \
+	cds_lfht_cursor_init \
+	cds_lfht_cursor_next \
+	cds_lfht_cursor_pause \
 	cds_lfht_del \
+	cds_lfht_del_free \
+	cds_lfht_del_free_flush \
+	cds_lfht_del_if \
 	cds_lfht_destroy \
+	cds_lfht_filter_disable \
+	cds_lfht_filter_rebuild \
 	cds_lfht_first \
 	cds_lfht_for_each \
 	cds_lfht_for_each_duplicate \
@@ -55,16 +115,41 @@ api="caa_container_of \
 	cds_lfht_is_node_deleted \
 	cds_lfht_iter_get_node \
 	cds_lfht_lookup \
+	cds_lfht_lookup_cache_create \
+	cds_lfht_lookup_cache_destroy \
+	cds_lfht_lookup_cached \
+	cds_lfht_lookup_key16 \
+	cds_lfht_lookup_key32 \
+	cds_lfht_lookup_key8 \
+	cds_lfht_lookup_or_add \
+	cds_lfht_match_key16 \
+	cds_lfht_match_key32 \
+	cds_lfht_match_key8 \
+	cds_lfht_migrate_add_unique \
+	cds_lfht_migrate_begin \
+	cds_lfht_migrate_destroy \
+	cds_lfht_migrate_lookup \
+	cds_lfht_migrate_step \
 	cds_lfht_new \
 	cds_lfht_next \
 	cds_lfht_next_duplicate \
 	cds_lfht_replace \
 	cds_lfht_resize \
+	cds_lfht_set_node_hash \
+	cds_lfht_set_resize_latency \
+	cds_lfht_stats_snapshot \
+	cds_lfht_trim \
+	cds_lfht_value_cmpxchg \
+	cds_lfht_value_get \
+	cds_lfht_value_set \
+	cds_lfht_value_xchg \
+	cds_lfq_dequeue_bulk_rcu \
 	cds_lfq_dequeue_rcu \
 	cds_lfq_destroy_rcu \
 	cds_lfq_enqueue_rcu \
 	cds_lfq_init_rcu \
 	cds_lfq_node_init_rcu \
+	cds_lfs_elim_init \
 	cds_lfs_empty \
 	cds_lfs_for_each \
 	cds_lfs_for_each_safe \
@@ -74,11 +159,18 @@ api="caa_container_of \
 	__cds_lfs_pop_all \
 	cds_lfs_pop_all_blocking \
 	cds_lfs_pop_blocking \
+	__cds_lfs_pop_elim \
 	cds_lfs_pop_lock \
+	__cds_lfs_pop_n \
+	cds_lfs_pop_n_blocking \
 	cds_lfs_pop_unlock \
+	cds_lfs_pop_wait \
 	cds_lfs_push \
+	cds_lfs_push_elim \
+	cds_lfs_push_wake \
 	cds_list_add \
 	cds_list_add_rcu \
+	cds_list_add_sorted_rcu \
 	cds_list_add_tail \
 	cds_list_del \
 	cds_list_del_init \
@@ -98,16 +190,85 @@ api="caa_container_of \
 	CDS_LIST_HEAD_INIT \
 	cds_list_move \
 	cds_list_replace \
+	cds_list_replace_all_rcu \
+	cds_list_replace_all_rcu_done \
 	cds_list_replace_init \
 	cds_list_replace_rcu \
 	cds_list_splice \
+	cds_list_splice_init_rcu \
+	cds_mpmc_ring_dequeue \
+	cds_mpmc_ring_destroy \
+	cds_mpmc_ring_enqueue \
+	cds_mpmc_ring_init \
+	cds_percpu_counter_add \
+	cds_percpu_counter_dec \
+	cds_percpu_counter_destroy \
+	cds_percpu_counter_inc \
+	cds_percpu_counter_init \
+	cds_percpu_counter_read \
+	cds_percpu_counter_sum \
+	cds_rcu_array_append \
+	cds_rcu_array_destroy \
+	cds_rcu_array_get \
+	cds_rcu_array_init \
+	cds_rcu_array_len \
+	cds_rcu_array_set \
+	cds_rcu_slab_alloc \
+	cds_rcu_slab_create \
+	cds_rcu_slab_destroy \
+	cds_rcu_slab_flush \
+	cds_rcu_slab_free \
+	cds_rcu_slab_free_rcu \
+	cds_rcucache_add \
+	cds_rcucache_del \
+	cds_rcucache_destroy \
+	cds_rcucache_get_stats \
+	cds_rcucache_lookup \
+	cds_rcucache_new \
+	cds_rcucache_node_init \
+	cds_rcuhtable_add \
+	cds_rcuhtable_add_unique \
+	cds_rcuhtable_del \
+	cds_rcuhtable_destroy \
+	cds_rcuhtable_for_each \
+	cds_rcuhtable_get_stats \
+	cds_rcuhtable_lookup \
+	cds_rcuhtable_new \
+	cds_rcuhtable_next_duplicate \
+	cds_skiplist_add_unique \
+	cds_skiplist_del \
+	cds_skiplist_destroy \
+	cds_skiplist_first \
+	cds_skiplist_for_each \
+	cds_skiplist_for_each_entry \
+	cds_skiplist_for_each_from \
+	cds_skiplist_for_each_range \
+	cds_skiplist_is_node_deleted \
+	cds_skiplist_lookup \
+	cds_skiplist_lookup_range \
+	cds_skiplist_lower_bound \
+	cds_skiplist_new \
+	cds_skiplist_next \
+	cds_skiplist_next_range \
+	cds_skiplist_node_init \
+	cds_skiplist_node_size \
+	cds_skiplist_random_level \
+	cds_spsc_ring_dequeue \
+	cds_spsc_ring_dequeue_bulk \
+	cds_spsc_ring_destroy \
+	cds_spsc_ring_enqueue \
+	cds_spsc_ring_init \
 	__cds_wfcq_dequeue_blocking \
 	cds_wfcq_dequeue_blocking \
 	cds_wfcq_dequeue_lock \
 	__cds_wfcq_dequeue_nonblocking \
 	cds_wfcq_dequeue_unlock \
+	cds_wfcq_dequeue_wait \
 	cds_wfcq_empty \
 	cds_wfcq_enqueue \
+	cds_wfcq_enqueue_batch \
+	__cds_wfcq_enqueue_sp \
+	cds_wfcq_enqueue_wake \
 	__cds_wfcq_first_blocking \
 	__cds_wfcq_first_nonblocking \
 	__cds_wfcq_for_each_blocking \
@@ -119,6 +280,7 @@ api="caa_container_of \
 	__cds_wfcq_splice_blocking \
 	cds_wfcq_splice_blocking \
 	__cds_wfcq_splice_nonblocking \
+	cds_wfs_batch_init \
 	cds_wfs_empty \
 	cds_wfs_first \
 	cds_wfs_for_each_blocking \
@@ -129,6 +291,7 @@ api="caa_container_of \
 	cds_wfs_node_init \
 	__cds_wfs_pop_all \
 	cds_wfs_pop_all_blocking \
+	__cds_wfs_pop_batch_blocking \
 	__cds_wfs_pop_blocking \
 	cds_wfs_pop_blocking \
 	cds_wfs_pop_lock \
@@ -152,44 +315,140 @@ api="caa_container_of \
 	cmm_smp_rmb \
 	cmm_smp_wmb \
 	CMM_STORE_SHARED \
+	cond_synchronize_rcu \
 	create_all_cpu_call_rcu_data \
+	create_all_node_call_rcu_data \
 	create_call_rcu_data \
+	create_call_rcu_data_delay \
+	create_lazy_cpu_call_rcu_data \
 	DECLARE_URCU_TLS \
 	defer_rcu \
 	DEFINE_URCU_TLS \
 	free_all_cpu_call_rcu_data \
+	free_rcu_bulk \
+	free_rcu_bulk_flush \
 	get_call_rcu_data \
 	get_call_rcu_thread \
 	get_cpu_call_rcu_data \
 	get_default_call_rcu_data \
+	get_state_synchronize_rcu \
 	get_thread_call_rcu_data \
+	poll_state_synchronize_rcu \
 	rcu_assign_pointer \
+	rcu_async_poll \
+	rcu_barrier_async \
+	rcu_barrier_domain \
+	rcu_barrier_poll \
+	rcu_barrier_wait \
 	rcu_cmpxchg_pointer \
+	rcu_defer_set_batch \
+	rcu_defer_set_call_rcu \
+	rcu_defer_set_queue_size \
 	rcu_dereference \
+	rcu_domain_create \
+	rcu_domain_destroy \
+	rcu_domain_read_lock \
+	rcu_domain_read_ongoing \
+	rcu_domain_read_unlock \
+	rcu_domain_register_thread \
+	rcu_domain_unregister_thread \
 	rcu_exit \
+	rcu_get_membarrier_mode \
+	rcu_get_spin_budget \
+	rcu_gp_get_stats \
 	rcu_init \
+	rcu_qsbr_cond_timedwait \
+	rcu_qsbr_cond_wait \
+	rcu_qsbr_epoll_wait \
+	rcu_qsbr_futex_wait \
+	rcu_qsbr_poll \
 	rcu_quiescent_state \
+	rcu_quiescent_state_every \
+	rcu_quiescent_state_timed \
 	rcu_read_lock \
 	rcu_read_unlock \
 	rcu_register_thread \
+	rcu_seqlock_init \
+	rcu_seqlock_read_begin \
+	rcu_seqlock_read_copy \
+	rcu_seqlock_read_retry \
+	rcu_seqlock_write_copy \
+	rcu_seqlock_write_lock \
+	rcu_seqlock_write_unlock \
 	rcu_set_pointer \
+	rcu_set_spin_budget \
+	rcu_snapshot_dereference \
+	rcu_snapshot_destroy \
+	rcu_snapshot_init \
+	rcu_snapshot_publish \
+	rcu_stats_dump \
+	rcu_stats_dump_periodic \
+	rcu_stats_snapshot \
 	rcu_thread_offline \
 	rcu_thread_online \
 	rcu_unregister_thread \
+	rcu_use_gp_tree \
+	rcu_use_sys_membarrier \
 	rcu_xchg_pointer \
+	set_call_rcu_fork_lazy \
 	set_cpu_call_rcu_data \
 	set_thread_call_rcu_data \
+	shm_rcu_domain_attach \
+	shm_rcu_domain_init \
+	shm_rcu_domain_size \
+	shm_rcu_read_lock \
+	shm_rcu_read_unlock \
+	shm_rcu_register_thread \
+	shm_rcu_unregister_thread \
+	srcu_domain_create \
+	srcu_domain_destroy \
+	srcu_read_lock \
+	srcu_read_unlock \
+	start_poll_synchronize_rcu \
 	synchronize_rcu \
+	synchronize_rcu_async \
+	synchronize_rcu_timeout \
+	synchronize_rcu_domain \
+	synchronize_rcu_expedited \
+	synchronize_shm_rcu \
+	synchronize_srcu \
 	uatomic_add \
+	uatomic_add_mo \
 	uatomic_add_return \
+	uatomic_add_return_mo \
 	uatomic_and \
 	uatomic_cmpxchg \
+	uatomic_cmpxchg_double \
+	uatomic_cmpxchg_mo \
 	uatomic_dec \
+	uatomic_dec_mo \
 	uatomic_inc \
+	uatomic_inc_mo \
+	uatomic_load \
 	uatomic_or \
 	uatomic_read \
 	uatomic_set \
+	uatomic_store \
+	uatomic_sub_mo \
+	uatomic_sub_return_mo \
 	uatomic_xchg \
+	uatomic_xchg_mo \
+	urcu_calloc \
+	urcu_free \
+	urcu_large_alloc \
+	urcu_large_free \
+	urcu_malloc \
+	urcu_percpu_ref_exit \
+	urcu_percpu_ref_get \
+	urcu_percpu_ref_init \
+	urcu_percpu_ref_is_dying \
+	urcu_percpu_ref_kill \
+	urcu_percpu_ref_put \
+	urcu_percpu_ref_tryget \
+	urcu_percpu_ref_tryget_live \
+	urcu_posix_memalign \
+	urcu_realloc \
+	urcu_set_allocator \
 	URCU_TLS"
 
 T=/tmp/urcu-api-list.sh.$$
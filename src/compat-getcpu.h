@@ -24,11 +24,41 @@
 #if defined(HAVE_SCHED_GETCPU)
 #include <sched.h>
 
+#if defined(CONFIG_RCU_HAVE_RSEQ) && defined(__has_builtin)
+#if __has_builtin(__builtin_thread_pointer)
+#define URCU_GETCPU_RSEQ
+#endif
+#endif
+
+#ifdef URCU_GETCPU_RSEQ
+#include <sys/rseq.h>
+#include <urcu/system.h>
+
+/*
+ * glibc registers a rseq area for each thread, at __rseq_offset from
+ * the thread pointer, in which the kernel keeps the current cpu_id up
+ * to date: reading it costs a TLS load. cpu_id is negative when the
+ * registration failed or is disabled, e.g. with
+ * GLIBC_TUNABLES=glibc.pthread.rseq=0.
+ */
+static inline
+int urcu_sched_getcpu(void)
+{
+	const struct rseq *rseq_area = (const struct rseq *)
+		((char *) __builtin_thread_pointer() + __rseq_offset);
+	int cpu = (int) CMM_LOAD_SHARED(rseq_area->cpu_id);
+
+	if (caa_likely(cpu >= 0))
+		return cpu;
+	return sched_getcpu();
+}
+#else
 static inline
 int urcu_sched_getcpu(void)
 {
 	return sched_getcpu();
 }
+#endif
 #elif defined(HAVE_GETCPUID)
 #include <sys/processor.h>
 
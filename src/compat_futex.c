@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <poll.h>
 #include <stdint.h>
+#include <sys/time.h>
 
 #include <urcu/arch.h>
 #include <urcu/futex.h>
@@ -47,7 +48,8 @@ pthread_cond_t __urcu_compat_futex_cond = PTHREAD_COND_INITIALIZER;
 
 /*
  * _NOT SIGNAL-SAFE_. pthread_cond is not signal-safe anyway. Though.
- * For now, timeout, uaddr2 and val3 are unused.
+ * For now, uaddr2 and val3 are unused. A FUTEX_WAIT @timeout is
+ * relative, as with sys_futex.
  * Waiter will relinquish the CPU until woken up.
  */
 
@@ -60,7 +62,6 @@ int compat_futex_noasync(int32_t *uaddr, int op, int32_t val,
 	 * Check if NULL. Don't let users expect that they are taken into
 	 * account.
 	 */
-	assert(!timeout);
 	assert(!uaddr2);
 	assert(!val3);
 
@@ -82,6 +83,31 @@ int compat_futex_noasync(int32_t *uaddr, int op, int32_t val,
 		 * Comparing *uaddr content against val figures out which
 		 * thread has been awakened.
 		 */
+		if (timeout) {
+			struct timespec deadline;
+			struct timeval now;
+
+			(void) gettimeofday(&now, NULL);
+			deadline.tv_sec = now.tv_sec + timeout->tv_sec;
+			deadline.tv_nsec = now.tv_usec * 1000L
+				+ timeout->tv_nsec;
+			if (deadline.tv_nsec >= 1000000000L) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			}
+			while (CMM_LOAD_SHARED(*uaddr) == val) {
+				if (pthread_cond_timedwait(
+						&__urcu_compat_futex_cond,
+						&__urcu_compat_futex_lock,
+						&deadline) == ETIMEDOUT
+						&& CMM_LOAD_SHARED(*uaddr) == val) {
+					errno = ETIMEDOUT;
+					ret = -1;
+					break;
+				}
+			}
+			break;
+		}
 		while (CMM_LOAD_SHARED(*uaddr) == val)
 			pthread_cond_wait(&__urcu_compat_futex_cond,
 				&__urcu_compat_futex_lock);
@@ -109,7 +135,8 @@ end:
 
 /*
  * _ASYNC SIGNAL-SAFE_.
- * For now, timeout, uaddr2 and val3 are unused.
+ * For now, uaddr2 and val3 are unused. A FUTEX_WAIT @timeout is
+ * relative, as with sys_futex, and rounded up to the polling period.
  * Waiter will busy-loop trying to read the condition.
  * It is OK to use compat_futex_async() on a futex address on which
  * futex() WAKE operations are also performed.
@@ -118,13 +145,13 @@ end:
 int compat_futex_async(int32_t *uaddr, int op, int32_t val,
 	const struct timespec *timeout, int32_t *uaddr2, int32_t val3)
 {
+	long polls = 0;
 	int ret = 0;
 
 	/*
 	 * Check if NULL. Don't let users expect that they are taken into
 	 * account.
 	 */
-	assert(!timeout);
 	assert(!uaddr2);
 	assert(!val3);
 
@@ -135,7 +162,15 @@ int compat_futex_async(int32_t *uaddr, int op, int32_t val,
 
 	switch (op) {
 	case FUTEX_WAIT:
+		if (timeout)
+			polls = timeout->tv_sec * 100
+				+ (timeout->tv_nsec + 9999999) / 10000000;
 		while (CMM_LOAD_SHARED(*uaddr) == val) {
+			if (timeout && polls-- <= 0) {
+				errno = ETIMEDOUT;
+				ret = -1;
+				goto end;
+			}
 			if (poll(NULL, 0, 10) < 0) {
 				ret = -1;
 				/* Keep poll errno. Caller handles EINTR. */
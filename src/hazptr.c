@@ -0,0 +1,270 @@
+/*
+ * hazptr.c
+ *
+ * Userspace RCU library - Hazard pointers for long-lived readers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * A retired object is unpublished before cds_hazptr_retire(). The
+ * grace period elapsed before the scan ensures that RCU readers are
+ * done with it, and that a reader protecting it with
+ * cds_hazptr_set() within its read-side critical section has stored
+ * its hazard pointer. A reader protecting it with
+ * cds_hazptr_protect() either sees it unpublished when validating, or
+ * has stored its hazard pointer before the memory barrier issued by
+ * the scan prior to reading the hazard pointers.
+ */
+
+#define _LGPL_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <urcu-pointer.h>
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+#include <urcu/lfstack.h>
+#include <urcu/hazptr.h>
+
+/* A batch of retired objects waiting for a grace period. */
+struct hazptr_scan {
+	struct rcu_head head;
+	struct cds_hazptr_domain *dom;
+	struct cds_lfs_head *list;
+};
+
+void _cds_hazptr_domain_init(struct cds_hazptr_domain *dom, long batch,
+		const struct rcu_flavor_struct *flavor)
+{
+	dom->hazptrs = NULL;
+	dom->nr_hazptrs = 0;
+	__cds_lfs_init(&dom->retired);
+	dom->nr_retired = 0;
+	dom->batch = batch > 0 ? batch : CDS_HAZPTR_BATCH;
+	dom->flavor = flavor;
+}
+
+struct cds_hazptr *cds_hazptr_acquire(struct cds_hazptr_domain *dom)
+{
+	struct cds_hazptr *hp, *old;
+
+	for (hp = CMM_LOAD_SHARED(dom->hazptrs); hp; hp = hp->next) {
+		if (!CMM_LOAD_SHARED(hp->active)
+				&& !uatomic_cmpxchg(&hp->active, 0, 1))
+			return hp;
+	}
+	if (urcu_posix_memalign((void **) &hp, CAA_CACHE_LINE_SIZE,
+			sizeof(*hp)))
+		return NULL;
+	hp->ptr = NULL;
+	hp->active = 1;
+	old = CMM_LOAD_SHARED(dom->hazptrs);
+	for (;;) {
+		struct cds_hazptr *prev;
+
+		hp->next = old;
+		prev = rcu_cmpxchg_pointer(&dom->hazptrs, old, hp);
+		if (prev == old)
+			break;
+		old = prev;
+	}
+	uatomic_inc(&dom->nr_hazptrs);
+	return hp;
+}
+
+void cds_hazptr_release(struct cds_hazptr *hp)
+{
+	cds_hazptr_clear(hp);
+	uatomic_set(&hp->active, 0);
+}
+
+static
+int hazptr_cmp(const void *a, const void *b)
+{
+	uintptr_t pa = (uintptr_t) *(void * const *) a;
+	uintptr_t pb = (uintptr_t) *(void * const *) b;
+
+	return pa < pb ? -1 : pa > pb;
+}
+
+/*
+ * Return the sorted array of the objects protected by the hazard
+ * pointers of @dom, or NULL if it cannot be allocated, or if hazard
+ * pointers are added concurrently beyond its size.
+ */
+static
+void **hazptr_collect(struct cds_hazptr_domain *dom, unsigned long *nr)
+{
+	struct cds_hazptr *hp;
+	unsigned long max, i = 0;
+	void **ptrs;
+
+	max = uatomic_read(&dom->nr_hazptrs);
+	ptrs = urcu_malloc((max ? max : 1) * sizeof(*ptrs));
+	if (!ptrs)
+		return NULL;
+	for (hp = rcu_dereference(dom->hazptrs); hp; hp = hp->next) {
+		void *ptr = CMM_LOAD_SHARED(hp->ptr);
+
+		if (!ptr)
+			continue;
+		if (caa_unlikely(i == max)) {
+			urcu_free(ptrs);
+			return NULL;
+		}
+		ptrs[i++] = ptr;
+	}
+	qsort(ptrs, i, sizeof(*ptrs), hazptr_cmp);
+	*nr = i;
+	return ptrs;
+}
+
+static
+bool hazptr_is_protected(struct cds_hazptr_domain *dom, void **ptrs,
+		unsigned long nr, void *ptr)
+{
+	struct cds_hazptr *hp;
+
+	if (ptrs)
+		return bsearch(&ptr, ptrs, nr, sizeof(*ptrs), hazptr_cmp);
+	/* Traverse the hazard pointers for each object. */
+	for (hp = rcu_dereference(dom->hazptrs); hp; hp = hp->next) {
+		if (CMM_LOAD_SHARED(hp->ptr) == ptr)
+			return true;
+	}
+	return false;
+}
+
+static
+void hazptr_scan_list(struct cds_hazptr_domain *dom,
+		struct cds_lfs_head *list)
+{
+	struct cds_lfs_node *node, *next;
+	unsigned long nr = 0;
+	void **ptrs;
+
+	/* Order the grace period before reading the hazard pointers. */
+	cmm_smp_mb();
+	ptrs = hazptr_collect(dom, &nr);
+	for (node = &list->node; node; node = next) {
+		struct cds_hazptr_head *head =
+			caa_container_of(node, struct cds_hazptr_head, node);
+
+		next = node->next;
+		if (hazptr_is_protected(dom, ptrs, nr, head->ptr)) {
+			/* Still protected: retired until the next scan. */
+			(void) cds_lfs_push(&dom->retired, node);
+			uatomic_inc(&dom->nr_retired);
+			continue;
+		}
+		head->func(head);
+	}
+	urcu_free(ptrs);
+}
+
+static
+void hazptr_scan(struct rcu_head *head)
+{
+	struct hazptr_scan *scan =
+		caa_container_of(head, struct hazptr_scan, head);
+
+	hazptr_scan_list(scan->dom, scan->list);
+	urcu_free(scan);
+}
+
+static
+void hazptr_queue_scan(struct cds_hazptr_domain *dom)
+{
+	struct cds_lfs_node *node, *next;
+	struct hazptr_scan *scan;
+	struct cds_lfs_head *list;
+	long nr = 0;
+
+	list = __cds_lfs_pop_all(&dom->retired);
+	if (!list)
+		return;
+	for (node = &list->node; node; node = node->next)
+		nr++;
+	uatomic_sub(&dom->nr_retired, nr);
+	scan = urcu_malloc(sizeof(*scan));
+	if (caa_unlikely(!scan)) {
+		/* Out of memory: keep them retired until the next scan. */
+		for (node = &list->node; node; node = next) {
+			next = node->next;
+			(void) cds_lfs_push(&dom->retired, node);
+		}
+		uatomic_add(&dom->nr_retired, nr);
+		return;
+	}
+	scan->dom = dom;
+	scan->list = list;
+	dom->flavor->update_call_rcu(&scan->head, hazptr_scan);
+}
+
+void cds_hazptr_retire(struct cds_hazptr_domain *dom, void *ptr,
+		struct cds_hazptr_head *head,
+		void (*func)(struct cds_hazptr_head *head))
+{
+	long nr;
+
+	head->ptr = ptr;
+	head->func = func;
+	(void) cds_lfs_push(&dom->retired, &head->node);
+	nr = uatomic_add_return(&dom->nr_retired, 1);
+	/*
+	 * At most one object per hazard pointer is kept retired by a
+	 * scan: each scan frees at least a batch of objects.
+	 */
+	if (nr >= dom->batch + (long) CMM_LOAD_SHARED(dom->nr_hazptrs))
+		hazptr_queue_scan(dom);
+}
+
+void cds_hazptr_domain_flush(struct cds_hazptr_domain *dom)
+{
+	hazptr_queue_scan(dom);
+}
+
+void cds_hazptr_domain_destroy(struct cds_hazptr_domain *dom)
+{
+	struct cds_lfs_node *node, *next;
+	struct cds_hazptr *hp, *hp_next;
+	struct cds_lfs_head *list;
+
+	/* Wait for the pending scans, then for the last retired objects. */
+	dom->flavor->barrier();
+	list = __cds_lfs_pop_all(&dom->retired);
+	if (list) {
+		dom->flavor->update_synchronize_rcu();
+		for (node = &list->node; node; node = next) {
+			struct cds_hazptr_head *head = caa_container_of(node,
+					struct cds_hazptr_head, node);
+
+			next = node->next;
+			head->func(head);
+		}
+	}
+	for (hp = dom->hazptrs; hp; hp = hp_next) {
+		hp_next = hp->next;
+		urcu_free(hp);
+	}
+	dom->hazptrs = NULL;
+	dom->nr_hazptrs = 0;
+	dom->nr_retired = 0;
+}
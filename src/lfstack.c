@@ -60,11 +60,40 @@ bool cds_lfs_push(cds_lfs_stack_ptr_t s, struct cds_lfs_node *node)
 	return _cds_lfs_push(s, node);
 }
 
+bool cds_lfs_push_wake(cds_lfs_stack_ptr_t s, struct cds_lfs_node *node,
+		struct cds_eventcount *ec)
+{
+	return _cds_lfs_push_wake(s, node, ec);
+}
+
 struct cds_lfs_node *cds_lfs_pop_blocking(struct cds_lfs_stack *s)
 {
 	return _cds_lfs_pop_blocking(s);
 }
 
+void cds_lfs_elim_init(struct cds_lfs_elim *elim)
+{
+	_cds_lfs_elim_init(elim);
+}
+
+bool cds_lfs_push_elim(cds_lfs_stack_ptr_t s, struct cds_lfs_elim *elim,
+		struct cds_lfs_node *node)
+{
+	return _cds_lfs_push_elim(s, elim, node);
+}
+
+unsigned long cds_lfs_pop_n_blocking(struct cds_lfs_stack *s,
+		struct cds_lfs_node **nodes, unsigned long n)
+{
+	return _cds_lfs_pop_n_blocking(s, nodes, n);
+}
+
+struct cds_lfs_node *cds_lfs_pop_wait(struct cds_lfs_stack *s,
+		struct cds_eventcount *ec)
+{
+	return _cds_lfs_pop_wait(s, ec);
+}
+
 struct cds_lfs_head *cds_lfs_pop_all_blocking(struct cds_lfs_stack *s)
 {
 	return _cds_lfs_pop_all_blocking(s);
@@ -85,7 +114,19 @@ struct cds_lfs_node *__cds_lfs_pop(cds_lfs_stack_ptr_t s)
 	return ___cds_lfs_pop(s);
 }
 
+unsigned long __cds_lfs_pop_n(cds_lfs_stack_ptr_t s,
+		struct cds_lfs_node **nodes, unsigned long n)
+{
+	return ___cds_lfs_pop_n(s, nodes, n);
+}
+
 struct cds_lfs_head *__cds_lfs_pop_all(cds_lfs_stack_ptr_t s)
 {
 	return ___cds_lfs_pop_all(s);
 }
+
+struct cds_lfs_node *__cds_lfs_pop_elim(cds_lfs_stack_ptr_t s,
+		struct cds_lfs_elim *elim)
+{
+	return ___cds_lfs_pop_elim(s, elim);
+}
@@ -0,0 +1,98 @@
+/*
+ * percpu-counter.c
+ *
+ * Userspace RCU library - Per-CPU split counters
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+#include <urcu/percpu-counter.h>
+
+#include "compat-getcpu.h"
+
+/*
+ * Threads sharing a CPU, or migrated while updating it, may update a
+ * slot concurrently: slots are updated with relaxed atomics, and
+ * folded by exchanging them with 0, so that no update is lost.
+ */
+struct cds_percpu_counter_cpu {
+	long count;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+int cds_percpu_counter_init(struct cds_percpu_counter *counter,
+		long value, long batch)
+{
+	long nr_cpus;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	counter->nr_cpus = nr_cpus > 0 ? nr_cpus : 1;
+	if (urcu_posix_memalign((void **) &counter->cpus, CAA_CACHE_LINE_SIZE,
+			counter->nr_cpus * sizeof(*counter->cpus)))
+		return -ENOMEM;
+	memset(counter->cpus, 0, counter->nr_cpus * sizeof(*counter->cpus));
+	counter->count = value;
+	counter->batch = batch > 0 ? batch : CDS_PERCPU_COUNTER_BATCH;
+	return 0;
+}
+
+void cds_percpu_counter_destroy(struct cds_percpu_counter *counter)
+{
+	urcu_free(counter->cpus);
+	counter->cpus = NULL;
+}
+
+void cds_percpu_counter_add(struct cds_percpu_counter *counter, long v)
+{
+	struct cds_percpu_counter_cpu *slot;
+	long count;
+	int cpu;
+
+	cpu = urcu_sched_getcpu();
+	if (caa_unlikely(cpu < 0))
+		cpu = 0;
+	slot = &counter->cpus[(unsigned int) cpu % counter->nr_cpus];
+	count = uatomic_add_return_mo(&slot->count, v, CMM_RELAXED);
+	if (caa_likely(count < counter->batch && count > -counter->batch))
+		return;
+	count = uatomic_xchg_mo(&slot->count, 0, CMM_RELAXED);
+	if (count)
+		uatomic_add_mo(&counter->count, count, CMM_RELAXED);
+}
+
+long cds_percpu_counter_read(struct cds_percpu_counter *counter)
+{
+	return uatomic_load(&counter->count, CMM_RELAXED);
+}
+
+long cds_percpu_counter_sum(struct cds_percpu_counter *counter)
+{
+	long sum;
+	unsigned int i;
+
+	sum = uatomic_load(&counter->count, CMM_RELAXED);
+	for (i = 0; i < counter->nr_cpus; i++)
+		sum += uatomic_load(&counter->cpus[i].count, CMM_RELAXED);
+	return sum;
+}
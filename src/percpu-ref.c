@@ -0,0 +1,195 @@
+/*
+ * percpu-ref.c
+ *
+ * Userspace RCU library - Per-CPU reference counting
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Modelled after the Linux kernel percpu_ref.
+ *
+ * In per-CPU mode, references are counted in the counter of the CPU
+ * running the caller: a reference may be taken on a CPU and put on
+ * another, so only the sum of the counters is meaningful. The shared
+ * count holds the initial reference plus a large bias, so that the
+ * references put in shared mode after the kill, while the per-CPU
+ * counters are not summed yet, cannot bring it to zero. Once a grace
+ * period has elapsed after the DEAD flag is set, no CPU updates its
+ * counter anymore: the sum is added to the shared count and the bias
+ * removed.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <urcu-pointer.h>
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+#include <urcu/debug.h>
+#include <urcu/percpu-ref.h>
+
+#include "compat-getcpu.h"
+
+#define PERCPU_REF_DEAD		(1UL << 0)
+#define PERCPU_REF_BIAS		(1L << (CAA_BITS_PER_LONG - 2))
+
+struct percpu_ref_cpu {
+	unsigned long count;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static
+struct percpu_ref_cpu *percpu_ref_cpus(unsigned long percpu_ptr)
+{
+	return (struct percpu_ref_cpu *) (percpu_ptr & ~PERCPU_REF_DEAD);
+}
+
+/*
+ * Return the counter of the current CPU, or NULL in shared mode.
+ */
+static
+struct percpu_ref_cpu *percpu_ref_this_cpu(struct urcu_percpu_ref *ref)
+{
+	unsigned long percpu_ptr;
+	int cpu;
+
+	urcu_assert(ref->flavor->read_ongoing());
+	percpu_ptr = rcu_dereference(ref->percpu_ptr);
+	if (caa_unlikely(percpu_ptr & PERCPU_REF_DEAD))
+		return NULL;
+	cpu = urcu_sched_getcpu();
+	if (caa_unlikely(cpu < 0))
+		cpu = 0;
+	return &percpu_ref_cpus(percpu_ptr)[(unsigned int) cpu % ref->nr_cpus];
+}
+
+static
+void percpu_ref_release(struct urcu_ref *count)
+{
+	struct urcu_percpu_ref *ref =
+		caa_container_of(count, struct urcu_percpu_ref, count);
+
+	ref->release(ref);
+}
+
+int _urcu_percpu_ref_init(struct urcu_percpu_ref *ref,
+		void (*release)(struct urcu_percpu_ref *ref),
+		const struct rcu_flavor_struct *flavor)
+{
+	struct percpu_ref_cpu *cpus;
+	long nr_cpus;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	ref->nr_cpus = nr_cpus > 0 ? nr_cpus : 1;
+	if (urcu_posix_memalign((void **) &cpus, CAA_CACHE_LINE_SIZE,
+			ref->nr_cpus * sizeof(*cpus)))
+		return -ENOMEM;
+	memset(cpus, 0, ref->nr_cpus * sizeof(*cpus));
+	ref->percpu_ptr = (unsigned long) cpus;
+	urcu_ref_set(&ref->count, 1 + PERCPU_REF_BIAS);
+	ref->release = release;
+	ref->flavor = flavor;
+	return 0;
+}
+
+void urcu_percpu_ref_exit(struct urcu_percpu_ref *ref)
+{
+	urcu_free(percpu_ref_cpus(ref->percpu_ptr));
+	ref->percpu_ptr = PERCPU_REF_DEAD;
+}
+
+void urcu_percpu_ref_get(struct urcu_percpu_ref *ref)
+{
+	struct percpu_ref_cpu *cpu;
+
+	cpu = percpu_ref_this_cpu(ref);
+	if (caa_likely(cpu))
+		uatomic_inc(&cpu->count);
+	else
+		urcu_ref_get(&ref->count);
+}
+
+bool urcu_percpu_ref_tryget(struct urcu_percpu_ref *ref)
+{
+	struct percpu_ref_cpu *cpu;
+
+	cpu = percpu_ref_this_cpu(ref);
+	if (caa_likely(cpu)) {
+		uatomic_inc(&cpu->count);
+		return true;
+	}
+	return urcu_ref_get_unless_zero(&ref->count);
+}
+
+bool urcu_percpu_ref_tryget_live(struct urcu_percpu_ref *ref)
+{
+	struct percpu_ref_cpu *cpu;
+
+	cpu = percpu_ref_this_cpu(ref);
+	if (caa_unlikely(!cpu))
+		return false;
+	uatomic_inc(&cpu->count);
+	return true;
+}
+
+void urcu_percpu_ref_put(struct urcu_percpu_ref *ref)
+{
+	struct percpu_ref_cpu *cpu;
+
+	cpu = percpu_ref_this_cpu(ref);
+	if (caa_likely(cpu))
+		uatomic_dec(&cpu->count);
+	else
+		urcu_ref_put(&ref->count, percpu_ref_release);
+}
+
+static
+void percpu_ref_switch_to_shared(struct rcu_head *head)
+{
+	struct urcu_percpu_ref *ref =
+		caa_container_of(head, struct urcu_percpu_ref, head);
+	struct percpu_ref_cpu *cpus = percpu_ref_cpus(ref->percpu_ptr);
+	unsigned long sum = 0;
+	unsigned int i;
+
+	/* No CPU updates its counter after the grace period. */
+	for (i = 0; i < ref->nr_cpus; i++)
+		sum += CMM_LOAD_SHARED(cpus[i].count);
+	if (!uatomic_add_return(&ref->count.refcount,
+			(long) sum - PERCPU_REF_BIAS))
+		ref->release(ref);
+}
+
+void urcu_percpu_ref_kill(struct urcu_percpu_ref *ref)
+{
+	urcu_assert(!(ref->percpu_ptr & PERCPU_REF_DEAD));
+	/* Implicit memory barriers order the flag before the grace period. */
+	(void) uatomic_xchg(&ref->percpu_ptr,
+			ref->percpu_ptr | PERCPU_REF_DEAD);
+	ref->flavor->update_call_rcu(&ref->head, percpu_ref_switch_to_shared);
+	/* Drop the initial reference, in shared mode. */
+	urcu_ref_put(&ref->count, percpu_ref_release);
+}
+
+bool urcu_percpu_ref_is_dying(struct urcu_percpu_ref *ref)
+{
+	return CMM_LOAD_SHARED(ref->percpu_ptr) & PERCPU_REF_DEAD;
+}
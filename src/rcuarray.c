@@ -0,0 +1,63 @@
+/*
+ * rcuarray.c
+ *
+ * Userspace RCU library - RCU Resizable Array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#undef _LGPL_SOURCE
+#include "urcu/rcuarray.h"
+#define _LGPL_SOURCE
+#include "urcu/static/rcuarray.h"
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+void cds_rcu_array_init(struct cds_rcu_array *array,
+		void (*array_call_rcu)(struct rcu_head *head,
+			void (*func)(struct rcu_head *head)))
+{
+	_cds_rcu_array_init(array, array_call_rcu);
+}
+
+void cds_rcu_array_destroy(struct cds_rcu_array *array)
+{
+	_cds_rcu_array_destroy(array);
+}
+
+void *cds_rcu_array_get(struct cds_rcu_array *array, unsigned long index)
+{
+	return _cds_rcu_array_get(array, index);
+}
+
+unsigned long cds_rcu_array_len(struct cds_rcu_array *array)
+{
+	return _cds_rcu_array_len(array);
+}
+
+int cds_rcu_array_set(struct cds_rcu_array *array, unsigned long index,
+		void *ptr, void **old)
+{
+	return _cds_rcu_array_set(array, index, ptr, old);
+}
+
+int cds_rcu_array_append(struct cds_rcu_array *array, void *ptr,
+		unsigned long *index)
+{
+	return _cds_rcu_array_append(array, ptr, index);
+}
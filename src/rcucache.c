@@ -0,0 +1,330 @@
+/*
+ * rcucache.c
+ *
+ * Userspace RCU library - RCU CLOCK cache over a lock-free hash table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The entries of a slice are on a circular clock list, in insertion
+ * order, swept by the hand: a referenced entry has its flag cleared and
+ * is passed, the first unreferenced one is evicted. New entries are
+ * inserted just behind the hand, so that they get a full turn of the
+ * clock before being considered. Adding the entry to the hash table
+ * under the slice lock keeps the hash table and the clock list in sync
+ * for updaters: an entry is in the table if and only if it is on the
+ * clock, and removed from both at once.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/alloc.h>
+#include <urcu/list.h>
+#include <urcu/percpu-counter.h>
+#include <urcu/rcucache.h>
+#include "urcu-die.h"
+
+struct rcucache_slice {
+	pthread_mutex_t lock;		/* Protects the fields below. */
+	struct cds_list_head clock;
+	struct cds_list_head *hand;	/* Next entry considered. */
+	unsigned long count;
+	unsigned long capacity;
+	unsigned long evictions;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_rcucache {
+	struct cds_lfht *ht;
+	const struct rcu_flavor_struct *flavor;
+	void (*free_node)(struct rcu_head *head);
+	unsigned long capacity;
+	unsigned long nr_slices;
+	struct rcucache_slice *slices;
+	struct cds_percpu_counter hits;
+	struct cds_percpu_counter misses;
+};
+
+/* Key given to the hash table match function. */
+struct rcucache_key {
+	cds_rcucache_match_fct match;
+	const void *key;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static
+int rcucache_match(struct cds_lfht_node *ht_node, const void *_key)
+{
+	const struct rcucache_key *key = _key;
+
+	return key->match(caa_container_of(ht_node,
+			struct cds_rcucache_node, lfht_node), key->key);
+}
+
+static
+struct rcucache_slice *rcucache_slice(struct cds_rcucache *cache,
+		unsigned long hash)
+{
+	return &cache->slices[hash % cache->nr_slices];
+}
+
+/* Remove @node from the table and the clock. Called with the slice lock. */
+static
+void rcucache_unlink(struct cds_rcucache *cache, struct rcucache_slice *slice,
+		struct cds_rcucache_node *node)
+{
+	int ret;
+
+	ret = cds_lfht_del(cache->ht, &node->lfht_node);
+	assert(!ret);
+	if (slice->hand == &node->clock)
+		slice->hand = node->clock.next;
+	cds_list_del(&node->clock);
+	node->removed = 1;
+	slice->count--;
+}
+
+/*
+ * Evict an entry of the full @slice, called with the slice lock. The
+ * sweep is bounded to two turns of the clock, after which the entry at
+ * the hand is evicted even if readers keep referencing it.
+ */
+static
+void rcucache_evict(struct cds_rcucache *cache, struct rcucache_slice *slice)
+{
+	unsigned long steps = 2 * slice->count;
+	struct cds_rcucache_node *node;
+
+	for (;;) {
+		if (slice->hand == &slice->clock) {
+			slice->hand = slice->hand->next;
+			continue;
+		}
+		node = cds_list_entry(slice->hand, struct cds_rcucache_node,
+				clock);
+		if (!CMM_LOAD_SHARED(node->referenced) || !steps--)
+			break;
+		CMM_STORE_SHARED(node->referenced, 0);
+		slice->hand = slice->hand->next;
+	}
+	rcucache_unlink(cache, slice, node);
+	slice->evictions++;
+	cache->flavor->update_call_rcu(&node->rcu_head, cache->free_node);
+}
+
+struct cds_rcucache *_cds_rcucache_new(unsigned long capacity,
+		unsigned long nr_slices, void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_rcucache *cache;
+	unsigned long i;
+
+	if (!capacity || !free_node)
+		return NULL;
+	if (!nr_slices) {
+		long nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+		nr_slices = nr_cpus > 0 ? nr_cpus : 1;
+	}
+	if (nr_slices > capacity)
+		nr_slices = capacity;
+	cache = urcu_calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+	cache->flavor = flavor;
+	cache->free_node = free_node;
+	cache->capacity = capacity;
+	cache->nr_slices = nr_slices;
+	if (urcu_posix_memalign((void **) &cache->slices, CAA_CACHE_LINE_SIZE,
+			nr_slices * sizeof(*cache->slices)))
+		goto error_slices;
+	for (i = 0; i < nr_slices; i++) {
+		struct rcucache_slice *slice = &cache->slices[i];
+
+		pthread_mutex_init(&slice->lock, NULL);
+		CDS_INIT_LIST_HEAD(&slice->clock);
+		slice->hand = &slice->clock;
+		slice->count = 0;
+		slice->capacity = capacity / nr_slices
+			+ (i < capacity % nr_slices);
+		slice->evictions = 0;
+	}
+	if (cds_percpu_counter_init(&cache->hits, 0, 0))
+		goto error_hits;
+	if (cds_percpu_counter_init(&cache->misses, 0, 0))
+		goto error_misses;
+	cache->ht = _cds_lfht_new(1, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+			NULL, flavor, NULL);
+	if (!cache->ht)
+		goto error_ht;
+	return cache;
+
+error_ht:
+	cds_percpu_counter_destroy(&cache->misses);
+error_misses:
+	cds_percpu_counter_destroy(&cache->hits);
+error_hits:
+	for (i = 0; i < nr_slices; i++)
+		pthread_mutex_destroy(&cache->slices[i].lock);
+	urcu_free(cache->slices);
+error_slices:
+	urcu_free(cache);
+	return NULL;
+}
+
+void cds_rcucache_destroy(struct cds_rcucache *cache)
+{
+	struct cds_rcucache_node *node, *tmp;
+	struct cds_list_head nodes;
+	unsigned long i;
+	int ret;
+
+	CDS_INIT_LIST_HEAD(&nodes);
+	cache->flavor->read_lock();
+	for (i = 0; i < cache->nr_slices; i++) {
+		struct rcucache_slice *slice = &cache->slices[i];
+
+		mutex_lock(&slice->lock);
+		while (!cds_list_empty(&slice->clock)) {
+			node = cds_list_entry(slice->clock.next,
+					struct cds_rcucache_node, clock);
+			rcucache_unlink(cache, slice, node);
+			cds_list_add(&node->clock, &nodes);
+		}
+		mutex_unlock(&slice->lock);
+	}
+	cache->flavor->read_unlock();
+	cache->flavor->update_synchronize_rcu();
+	cds_list_for_each_entry_safe(node, tmp, &nodes, clock)
+		cache->free_node(&node->rcu_head);
+	ret = cds_lfht_destroy(cache->ht, NULL);
+	assert(!ret);
+	for (i = 0; i < cache->nr_slices; i++)
+		pthread_mutex_destroy(&cache->slices[i].lock);
+	cds_percpu_counter_destroy(&cache->hits);
+	cds_percpu_counter_destroy(&cache->misses);
+	urcu_free(cache->slices);
+	urcu_free(cache);
+}
+
+struct cds_rcucache_node *cds_rcucache_lookup(struct cds_rcucache *cache,
+		unsigned long hash, cds_rcucache_match_fct match,
+		const void *key)
+{
+	struct rcucache_key k = { .match = match, .key = key };
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ht_node;
+	struct cds_rcucache_node *node;
+
+	cds_lfht_lookup(cache->ht, hash, rcucache_match, &k, &iter);
+	ht_node = cds_lfht_iter_get_node(&iter);
+	if (!ht_node) {
+		cds_percpu_counter_inc(&cache->misses);
+		return NULL;
+	}
+	node = caa_container_of(ht_node, struct cds_rcucache_node, lfht_node);
+	/* Only store when needed: hits stay read-only on hot entries. */
+	if (!CMM_LOAD_SHARED(node->referenced))
+		CMM_STORE_SHARED(node->referenced, 1);
+	cds_percpu_counter_inc(&cache->hits);
+	return node;
+}
+
+struct cds_rcucache_node *cds_rcucache_add(struct cds_rcucache *cache,
+		unsigned long hash, cds_rcucache_match_fct match,
+		const void *key, struct cds_rcucache_node *node)
+{
+	struct rcucache_slice *slice = rcucache_slice(cache, hash);
+	struct rcucache_key k = { .match = match, .key = key };
+	struct cds_lfht_node *ht_node;
+
+	node->hash = hash;
+	node->referenced = 0;
+	node->removed = 0;
+	mutex_lock(&slice->lock);
+	ht_node = cds_lfht_add_unique(cache->ht, hash, rcucache_match, &k,
+			&node->lfht_node);
+	if (ht_node != &node->lfht_node) {
+		mutex_unlock(&slice->lock);
+		return caa_container_of(ht_node, struct cds_rcucache_node,
+				lfht_node);
+	}
+	cds_list_add_tail(&node->clock, slice->hand);
+	if (++slice->count > slice->capacity)
+		rcucache_evict(cache, slice);
+	mutex_unlock(&slice->lock);
+	return node;
+}
+
+int cds_rcucache_del(struct cds_rcucache *cache,
+		struct cds_rcucache_node *node)
+{
+	struct rcucache_slice *slice = rcucache_slice(cache, node->hash);
+
+	mutex_lock(&slice->lock);
+	if (node->removed) {
+		mutex_unlock(&slice->lock);
+		return -ENOENT;
+	}
+	rcucache_unlink(cache, slice, node);
+	mutex_unlock(&slice->lock);
+	cache->flavor->update_call_rcu(&node->rcu_head, cache->free_node);
+	return 0;
+}
+
+void cds_rcucache_get_stats(struct cds_rcucache *cache,
+		struct cds_rcucache_stats *stats)
+{
+	unsigned long i;
+
+	stats->count = 0;
+	stats->evictions = 0;
+	for (i = 0; i < cache->nr_slices; i++) {
+		struct rcucache_slice *slice = &cache->slices[i];
+
+		mutex_lock(&slice->lock);
+		stats->count += slice->count;
+		stats->evictions += slice->evictions;
+		mutex_unlock(&slice->lock);
+	}
+	stats->capacity = cache->capacity;
+	stats->hits = cds_percpu_counter_sum(&cache->hits);
+	stats->misses = cds_percpu_counter_sum(&cache->misses);
+}
@@ -0,0 +1,190 @@
+/*
+ * rcuhtable.c
+ *
+ * Userspace RCU library - Fixed-size RCU hash table with per-bucket locks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+
+/* Inline the RCU pointer accessors used by the bucket chains. */
+#define _LGPL_SOURCE
+#include <urcu-pointer.h>
+#include <urcu/rcuhlist.h>
+
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#undef _LGPL_SOURCE
+#include "urcu/rcuhtable.h"
+#define _LGPL_SOURCE
+#include "urcu/static/rcuhtable.h"
+
+/*
+ * Spins on a held bucket lock before yielding the CPU to its holder,
+ * which may have been preempted.
+ */
+#define BUCKET_LOCK_SPINS	100
+
+static void bucket_lock(struct cds_rcuhtable_bucket *bucket)
+{
+	unsigned int spins = 0;
+
+	while (uatomic_xchg(&bucket->lock, 1)) {
+		while (CMM_LOAD_SHARED(bucket->lock)) {
+			if (++spins < BUCKET_LOCK_SPINS) {
+				caa_cpu_relax();
+			} else {
+				(void) sched_yield();
+				spins = 0;
+			}
+		}
+	}
+}
+
+static void bucket_unlock(struct cds_rcuhtable_bucket *bucket)
+{
+	/* Order the updates of the chain before the release. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(bucket->lock, 0);
+}
+
+static struct cds_rcuhtable_bucket *ht_bucket(struct cds_rcuhtable *ht,
+		unsigned long hash)
+{
+	return &ht->buckets[hash & ht->mask];
+}
+
+struct cds_rcuhtable *cds_rcuhtable_new(unsigned long size)
+{
+	struct cds_rcuhtable *ht;
+	unsigned long nr_buckets = 1;
+
+	while (nr_buckets < size)
+		nr_buckets <<= 1;
+	ht = urcu_calloc(1, sizeof(*ht)
+		+ nr_buckets * sizeof(struct cds_rcuhtable_bucket));
+	if (!ht)
+		return NULL;
+	ht->mask = nr_buckets - 1;
+	return ht;
+}
+
+int cds_rcuhtable_destroy(struct cds_rcuhtable *ht)
+{
+	unsigned long i;
+
+	for (i = 0; i <= ht->mask; i++) {
+		if (ht->buckets[i].head.next)
+			return -EPERM;
+	}
+	urcu_free(ht);
+	return 0;
+}
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+struct cds_rcuhtable_node *cds_rcuhtable_lookup(struct cds_rcuhtable *ht,
+		unsigned long hash, cds_rcuhtable_match_fct match,
+		const void *key)
+{
+	return _cds_rcuhtable_lookup(ht, hash, match, key);
+}
+
+struct cds_rcuhtable_node *cds_rcuhtable_next_duplicate(
+		struct cds_rcuhtable_node *node,
+		cds_rcuhtable_match_fct match, const void *key)
+{
+	return _cds_rcuhtable_next_duplicate(node, match, key);
+}
+
+void cds_rcuhtable_add(struct cds_rcuhtable *ht, unsigned long hash,
+		struct cds_rcuhtable_node *node)
+{
+	struct cds_rcuhtable_bucket *bucket = ht_bucket(ht, hash);
+
+	node->hash = hash;
+	bucket_lock(bucket);
+	cds_hlist_add_head_rcu(&node->node, &bucket->head);
+	bucket->nr_nodes++;
+	bucket_unlock(bucket);
+}
+
+struct cds_rcuhtable_node *cds_rcuhtable_add_unique(
+		struct cds_rcuhtable *ht, unsigned long hash,
+		cds_rcuhtable_match_fct match, const void *key,
+		struct cds_rcuhtable_node *node)
+{
+	struct cds_rcuhtable_bucket *bucket = ht_bucket(ht, hash);
+	struct cds_rcuhtable_node *pos;
+
+	node->hash = hash;
+	bucket_lock(bucket);
+	cds_hlist_for_each_entry_2(pos, &bucket->head, node) {
+		if (_cds_rcuhtable_match(pos, hash, match, key)) {
+			bucket_unlock(bucket);
+			return pos;
+		}
+	}
+	cds_hlist_add_head_rcu(&node->node, &bucket->head);
+	bucket->nr_nodes++;
+	bucket_unlock(bucket);
+	return node;
+}
+
+int cds_rcuhtable_del(struct cds_rcuhtable *ht,
+		struct cds_rcuhtable_node *node)
+{
+	struct cds_rcuhtable_bucket *bucket = ht_bucket(ht, node->hash);
+	int ret = -ENOENT;
+
+	bucket_lock(bucket);
+	if (node->node.prev) {
+		cds_hlist_del_rcu(&node->node);
+		/* Readers only follow next pointers. */
+		node->node.prev = NULL;
+		bucket->nr_nodes--;
+		ret = 0;
+	}
+	bucket_unlock(bucket);
+	return ret;
+}
+
+void cds_rcuhtable_get_stats(struct cds_rcuhtable *ht,
+		struct cds_rcuhtable_stats *stats)
+{
+	unsigned long i;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->nr_buckets = ht->mask + 1;
+	for (i = 0; i <= ht->mask; i++) {
+		unsigned long nr = CMM_LOAD_SHARED(ht->buckets[i].nr_nodes);
+
+		stats->nr_nodes += nr;
+		if (!nr)
+			stats->nr_empty++;
+		if (nr > stats->max_chain)
+			stats->max_chain = nr;
+	}
+}
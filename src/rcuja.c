@@ -0,0 +1,636 @@
+/*
+ * rcuja.c
+ *
+ * Userspace RCU library - RCU Judy Array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Internal nodes ("inodes") are either linear or full. A linear inode
+ * holds up to JA_LINEAR_MAX children in arrival order, as a key byte
+ * array and a pointer array: it only grows, readers scanning the first
+ * nr entries, and removed children leave a NULL pointer behind. Entries
+ * are never reused, so a reader matching a key byte always reads the
+ * pointer of that byte. A linear inode which is full is replaced by a
+ * copy of its live children, linear if they are few, a full inode
+ * indexed by the key byte otherwise. Full inodes are never replaced.
+ * The root is a full inode.
+ *
+ * Updaters lock the inode they modify, and also its parent when
+ * replacing or removing it, parent first. Inodes removed from the tree
+ * are flagged dead under their lock, so updaters which looked them up
+ * concurrently retry from the root once they get the lock, and are
+ * freed after a grace period. Inodes left empty by a removal are
+ * removed from their parent.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <urcu-pointer.h>
+#include <urcu-call-rcu.h>
+#include <urcu-flavor.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+#include <urcu/compiler.h>
+#include <urcu/debug.h>
+#include <urcu/rcuja.h>
+#include "urcu-die.h"
+
+#define JA_BITS_PER_LEVEL	8
+#define JA_FANOUT		(1U << JA_BITS_PER_LEVEL)
+#define JA_LINEAR_MAX		16
+
+enum ja_inode_type {
+	JA_LINEAR,
+	JA_FULL,
+};
+
+struct ja_inode {
+	enum ja_inode_type type;
+	int dead;			/* Removed from the tree. */
+	unsigned int nr_live;		/* Children, under lock. */
+	pthread_mutex_t lock;
+	struct rcu_head head;
+};
+
+struct ja_linear {
+	struct ja_inode hdr;
+	unsigned int nr;		/* Entries used, live or removed. */
+	uint8_t bytes[JA_LINEAR_MAX];
+	void *ptrs[JA_LINEAR_MAX];
+};
+
+struct ja_full {
+	struct ja_inode hdr;
+	void *ptrs[JA_FANOUT];
+};
+
+struct cds_ja {
+	struct ja_inode *root;		/* Full inode. */
+	unsigned int key_bits;
+	unsigned int depth;		/* Levels of inodes. */
+	const struct rcu_flavor_struct *flavor;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static
+struct ja_linear *to_linear(struct ja_inode *inode)
+{
+	return caa_container_of(inode, struct ja_linear, hdr);
+}
+
+static
+struct ja_full *to_full(struct ja_inode *inode)
+{
+	return caa_container_of(inode, struct ja_full, hdr);
+}
+
+static
+unsigned int key_byte(struct cds_ja *ja, uint64_t key, unsigned int level)
+{
+	unsigned int shift = (ja->depth - 1 - level) * JA_BITS_PER_LEVEL;
+
+	return (key >> shift) & (JA_FANOUT - 1);
+}
+
+static
+int key_valid(struct cds_ja *ja, uint64_t key)
+{
+	return ja->key_bits == 64 || !(key >> ja->key_bits);
+}
+
+static
+struct ja_inode *alloc_inode(enum ja_inode_type type)
+{
+	struct ja_inode *inode;
+
+	if (type == JA_LINEAR)
+		inode = urcu_calloc(1, sizeof(struct ja_linear));
+	else
+		inode = urcu_calloc(1, sizeof(struct ja_full));
+	if (!inode)
+		return NULL;
+	inode->type = type;
+	pthread_mutex_init(&inode->lock, NULL);
+	return inode;
+}
+
+static
+void free_inode(struct ja_inode *inode)
+{
+	(void) pthread_mutex_destroy(&inode->lock);
+	urcu_free(inode);
+}
+
+static
+void free_inode_cb(struct rcu_head *head)
+{
+	free_inode(caa_container_of(head, struct ja_inode, head));
+}
+
+/* Read-side lookup of the child of @inode for key byte @b. */
+static
+void *inode_child(struct ja_inode *inode, unsigned int b)
+{
+	struct ja_linear *linear;
+	unsigned int i, nr;
+	void *ptr;
+
+	if (inode->type == JA_FULL)
+		return rcu_dereference(to_full(inode)->ptrs[b]);
+	linear = to_linear(inode);
+	nr = CMM_LOAD_SHARED(linear->nr);
+	/* Read nr before entries. */
+	cmm_smp_rmb();
+	for (i = 0; i < nr; i++) {
+		if (CMM_LOAD_SHARED(linear->bytes[i]) != b)
+			continue;
+		ptr = rcu_dereference(linear->ptrs[i]);
+		if (ptr)
+			return ptr;
+	}
+	return NULL;
+}
+
+/* Slot of the live child of @inode for key byte @b, under lock. */
+static
+void **inode_slot(struct ja_inode *inode, unsigned int b)
+{
+	struct ja_linear *linear;
+	unsigned int i;
+
+	if (inode->type == JA_FULL)
+		return to_full(inode)->ptrs[b] ? &to_full(inode)->ptrs[b] : NULL;
+	linear = to_linear(inode);
+	for (i = 0; i < linear->nr; i++) {
+		if (linear->bytes[i] == b && linear->ptrs[i])
+			return &linear->ptrs[i];
+	}
+	return NULL;
+}
+
+/*
+ * Add child @ptr for key byte @b to @inode, under lock. Returns 0, or
+ * -ENOSPC if @inode is a full linear inode.
+ */
+static
+int inode_insert(struct ja_inode *inode, unsigned int b, void *ptr)
+{
+	struct ja_linear *linear;
+
+	if (inode->type == JA_FULL) {
+		rcu_assign_pointer(to_full(inode)->ptrs[b], ptr);
+	} else {
+		linear = to_linear(inode);
+		if (linear->nr == JA_LINEAR_MAX)
+			return -ENOSPC;
+		linear->ptrs[linear->nr] = ptr;
+		linear->bytes[linear->nr] = b;
+		/* Write entry before publishing it. */
+		cmm_smp_wmb();
+		CMM_STORE_SHARED(linear->nr, linear->nr + 1);
+	}
+	inode->nr_live++;
+	return 0;
+}
+
+/*
+ * Copy of the live children of the linear inode @inode, plus child @ptr
+ * for key byte @b. Returns NULL on memory exhaustion.
+ */
+static
+struct ja_inode *inode_grow(struct ja_inode *inode, unsigned int b, void *ptr)
+{
+	struct ja_linear *linear = to_linear(inode);
+	struct ja_inode *new;
+	unsigned int i;
+
+	urcu_assert(inode->type == JA_LINEAR);
+	if (inode->nr_live + 1 <= JA_LINEAR_MAX / 2)
+		new = alloc_inode(JA_LINEAR);
+	else
+		new = alloc_inode(JA_FULL);
+	if (!new)
+		return NULL;
+	for (i = 0; i < linear->nr; i++) {
+		if (linear->ptrs[i])
+			(void) inode_insert(new, linear->bytes[i],
+				linear->ptrs[i]);
+	}
+	(void) inode_insert(new, b, ptr);
+	return new;
+}
+
+/*
+ * Replace the full linear inode @inode, child of @parent for key byte
+ * @pb, by a bigger copy also holding child @ptr for key byte @b.
+ * Returns 0, -EAGAIN if the tree changed, or -ENOMEM.
+ */
+static
+int ja_grow(struct cds_ja *ja, struct ja_inode *parent, unsigned int pb,
+		struct ja_inode *inode, unsigned int b, void *ptr)
+{
+	struct ja_inode *new;
+	void **slot;
+	int ret = -EAGAIN;
+
+	mutex_lock(&parent->lock);
+	mutex_lock(&inode->lock);
+	if (parent->dead || inode->dead || inode_slot(inode, b))
+		goto end;
+	slot = inode_slot(parent, pb);
+	if (!slot || *slot != inode)
+		goto end;
+	new = inode_grow(inode, b, ptr);
+	if (!new) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	rcu_assign_pointer(*slot, new);
+	inode->dead = 1;
+	ja->flavor->update_call_rcu(&inode->head, free_inode_cb);
+	ret = 0;
+end:
+	mutex_unlock(&inode->lock);
+	mutex_unlock(&parent->lock);
+	return ret;
+}
+
+/*
+ * Remove the empty inodes of the path of @key, from @path[@level] up.
+ */
+static
+void ja_prune(struct cds_ja *ja, uint64_t key, struct ja_inode **path,
+		unsigned int level)
+{
+	struct ja_inode *parent, *inode;
+	void **slot;
+	int empty;
+
+	for (; level > 0; level--) {
+		parent = path[level - 1];
+		inode = path[level];
+		mutex_lock(&parent->lock);
+		mutex_lock(&inode->lock);
+		slot = inode_slot(parent, key_byte(ja, key, level - 1));
+		if (parent->dead || inode->dead || inode->nr_live
+				|| !slot || *slot != inode) {
+			mutex_unlock(&inode->lock);
+			mutex_unlock(&parent->lock);
+			return;
+		}
+		rcu_assign_pointer(*slot, NULL);
+		parent->nr_live--;
+		inode->dead = 1;
+		ja->flavor->update_call_rcu(&inode->head, free_inode_cb);
+		empty = !parent->nr_live;
+		mutex_unlock(&inode->lock);
+		mutex_unlock(&parent->lock);
+		if (!empty)
+			return;
+	}
+}
+
+struct cds_ja *_cds_ja_new(unsigned int key_bits,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_ja *ja;
+
+	if (!key_bits || key_bits > 64 || key_bits % JA_BITS_PER_LEVEL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	ja = urcu_calloc(1, sizeof(*ja));
+	if (!ja)
+		return NULL;
+	ja->root = alloc_inode(JA_FULL);
+	if (!ja->root) {
+		urcu_free(ja);
+		return NULL;
+	}
+	ja->key_bits = key_bits;
+	ja->depth = key_bits / JA_BITS_PER_LEVEL;
+	ja->flavor = flavor;
+	return ja;
+}
+
+/*
+ * Free the inodes of the subtree of @inode at @level, or only check
+ * that it holds no node if @check. Returns -EPERM if it does.
+ */
+static
+int ja_free_subtree(struct cds_ja *ja, struct ja_inode *inode,
+		unsigned int level, int check)
+{
+	struct ja_linear *linear;
+	unsigned int i, nr;
+	void **ptrs;
+	int ret = 0;
+
+	if (inode->type == JA_FULL) {
+		ptrs = to_full(inode)->ptrs;
+		nr = JA_FANOUT;
+	} else {
+		linear = to_linear(inode);
+		ptrs = linear->ptrs;
+		nr = linear->nr;
+	}
+	for (i = 0; i < nr && !ret; i++) {
+		if (!ptrs[i])
+			continue;
+		if (level == ja->depth - 1)
+			ret = -EPERM;
+		else
+			ret = ja_free_subtree(ja, ptrs[i], level + 1, check);
+	}
+	if (!check)
+		free_inode(inode);
+	return ret;
+}
+
+int cds_ja_destroy(struct cds_ja *ja)
+{
+	int ret;
+
+	ret = ja_free_subtree(ja, ja->root, 0, 1);
+	if (ret)
+		return ret;
+	(void) ja_free_subtree(ja, ja->root, 0, 0);
+	urcu_free(ja);
+	return 0;
+}
+
+struct cds_ja_node *cds_ja_lookup(struct cds_ja *ja, uint64_t key)
+{
+	struct ja_inode *inode = ja->root;
+	unsigned int level;
+
+	if (!key_valid(ja, key))
+		return NULL;
+	for (level = 0; level < ja->depth - 1; level++) {
+		inode = inode_child(inode, key_byte(ja, key, level));
+		if (!inode)
+			return NULL;
+	}
+	return inode_child(inode, key_byte(ja, key, level));
+}
+
+/*
+ * Children of @inode in key byte order, from @start in direction @dir
+ * (1 or -1). Fills @bytes and @ptrs, returns their number.
+ */
+static
+unsigned int inode_sorted(struct ja_inode *inode, int start, int dir,
+		unsigned int *bytes, void **ptrs)
+{
+	struct ja_linear *linear;
+	unsigned int i, j, nr, n = 0, b;
+	void *ptr;
+	int c;
+
+	if (inode->type == JA_FULL) {
+		for (c = start; c >= 0 && c < JA_FANOUT; c += dir) {
+			ptr = rcu_dereference(to_full(inode)->ptrs[c]);
+			if (!ptr)
+				continue;
+			bytes[n] = c;
+			ptrs[n++] = ptr;
+			/* Enough to try a child per level below. */
+			if (n == JA_LINEAR_MAX)
+				break;
+		}
+		return n;
+	}
+	linear = to_linear(inode);
+	nr = CMM_LOAD_SHARED(linear->nr);
+	/* Read nr before entries. */
+	cmm_smp_rmb();
+	for (i = 0; i < nr; i++) {
+		b = CMM_LOAD_SHARED(linear->bytes[i]);
+		if ((int) (b - start) * dir < 0)
+			continue;
+		ptr = rcu_dereference(linear->ptrs[i]);
+		if (!ptr)
+			continue;
+		/* Insertion sort, in direction dir. */
+		for (j = n; j > 0 && ((int) (bytes[j - 1] - b)) * dir > 0; j--) {
+			bytes[j] = bytes[j - 1];
+			ptrs[j] = ptrs[j - 1];
+		}
+		bytes[j] = b;
+		ptrs[j] = ptr;
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Nearest node to @key within the subtree of @inode at @level, in
+ * direction @dir. If @exact, the subtree holds the key bytes of @key
+ * above @level, otherwise all its nodes are beyond @key in direction
+ * @dir.
+ */
+static
+struct cds_ja_node *ja_search(struct cds_ja *ja, struct ja_inode *inode,
+		unsigned int level, uint64_t key, int dir, int exact)
+{
+	unsigned int bytes[JA_LINEAR_MAX];
+	void *ptrs[JA_LINEAR_MAX];
+	struct cds_ja_node *node;
+	unsigned int i, n;
+	int start;
+
+	if (exact)
+		start = key_byte(ja, key, level);
+	else
+		start = dir > 0 ? 0 : JA_FANOUT - 1;
+	for (;;) {
+		n = inode_sorted(inode, start, dir, bytes, ptrs);
+		if (!n)
+			return NULL;
+		for (i = 0; i < n; i++) {
+			if (level == ja->depth - 1)
+				return ptrs[i];
+			node = ja_search(ja, ptrs[i], level + 1, key, dir,
+					exact && bytes[i] == start);
+			if (node)
+				return node;
+		}
+		/* Full inode with more children beyond the last tried. */
+		if (n < JA_LINEAR_MAX || inode->type != JA_FULL)
+			return NULL;
+		start = bytes[n - 1] + dir;
+		exact = 0;
+		if (start < 0 || start >= JA_FANOUT)
+			return NULL;
+	}
+}
+
+struct cds_ja_node *cds_ja_lookup_above_equal(struct cds_ja *ja,
+		uint64_t key)
+{
+	if (!key_valid(ja, key))
+		return NULL;
+	return ja_search(ja, ja->root, 0, key, 1, 1);
+}
+
+struct cds_ja_node *cds_ja_lookup_below_equal(struct cds_ja *ja,
+		uint64_t key)
+{
+	if (!key_valid(ja, key))
+		key = ja->key_bits == 64 ? UINT64_MAX
+			: (UINT64_C(1) << ja->key_bits) - 1;
+	return ja_search(ja, ja->root, 0, key, -1, 1);
+}
+
+struct cds_ja_node *cds_ja_add_unique(struct cds_ja *ja, uint64_t key,
+		struct cds_ja_node *node)
+{
+	struct ja_inode *parent, *inode, *spare = NULL;
+	unsigned int level, b, pb;
+	void *child, *new;
+	int ret;
+
+	urcu_assert(ja->flavor->read_ongoing());
+	if (!key_valid(ja, key)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	node->key = key;
+retry:
+	parent = NULL;
+	pb = 0;
+	inode = ja->root;
+	for (level = 0; ; level++) {
+		b = key_byte(ja, key, level);
+		child = inode_child(inode, b);
+		if (child) {
+			if (level == ja->depth - 1) {
+				new = child;	/* Key present. */
+				goto end;
+			}
+			parent = inode;
+			pb = b;
+			inode = child;
+			continue;
+		}
+		if (level == ja->depth - 1) {
+			new = node;
+		} else {
+			if (!spare)
+				spare = alloc_inode(JA_LINEAR);
+			if (!spare) {
+				errno = ENOMEM;
+				return NULL;
+			}
+			new = spare;
+		}
+		mutex_lock(&inode->lock);
+		if (inode->dead || inode_slot(inode, b)) {
+			mutex_unlock(&inode->lock);
+			goto retry;
+		}
+		ret = inode_insert(inode, b, new);
+		mutex_unlock(&inode->lock);
+		if (ret) {
+			/* Full linear inode: never the root. */
+			ret = ja_grow(ja, parent, pb, inode, b, new);
+			if (ret == -ENOMEM) {
+				if (spare)
+					free_inode(spare);
+				errno = ENOMEM;
+				return NULL;
+			}
+			if (!ret && new == spare)
+				spare = NULL;
+			goto retry;
+		}
+		if (level == ja->depth - 1)
+			goto end;
+		spare = NULL;
+		parent = inode;
+		pb = b;
+		inode = new;
+	}
+end:
+	if (spare)
+		free_inode(spare);
+	return new;
+}
+
+int cds_ja_del(struct cds_ja *ja, struct cds_ja_node *node)
+{
+	struct ja_inode *path[64 / JA_BITS_PER_LEVEL];
+	struct ja_inode *inode;
+	uint64_t key = node->key;
+	unsigned int level, b;
+	void **slot;
+	int empty;
+
+	urcu_assert(ja->flavor->read_ongoing());
+	if (!key_valid(ja, key))
+		return -ENOENT;
+retry:
+	inode = ja->root;
+	for (level = 0; ; level++) {
+		path[level] = inode;
+		if (level == ja->depth - 1)
+			break;
+		inode = inode_child(inode, key_byte(ja, key, level));
+		if (!inode)
+			return -ENOENT;
+	}
+	b = key_byte(ja, key, level);
+	mutex_lock(&inode->lock);
+	if (inode->dead) {
+		mutex_unlock(&inode->lock);
+		goto retry;
+	}
+	slot = inode_slot(inode, b);
+	if (!slot || *slot != node) {
+		mutex_unlock(&inode->lock);
+		return -ENOENT;
+	}
+	rcu_assign_pointer(*slot, NULL);
+	inode->nr_live--;
+	empty = !inode->nr_live;
+	mutex_unlock(&inode->lock);
+	if (empty)
+		ja_prune(ja, key, path, level);
+	return 0;
+}
@@ -25,7 +25,11 @@
  */
 
 #include <urcu/rculfhash.h>
+#include <urcu/alloc.h>
+#include <urcu/uatomic.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 #ifdef DEBUG
 #define dbg_printf(fmt, args...)     printf("[debug rculfhash] " fmt, ## args)
@@ -55,15 +59,42 @@ do {								\
 #endif
 
 struct ht_items_count;
+struct lfht_changelog;
+
+/*
+ * Split block Bloom filter of the hashes of a table: each hash sets 8
+ * bits of a 32-byte block, one bit in each 32-bit word, so a probe
+ * reads a single cache line and its 8 tests are independent. Bits are
+ * only set: removed nodes are forgotten when the filter is rebuilt.
+ */
+#define LFHT_FILTER_BLOCK_WORDS	8
+#define LFHT_FILTER_BLOCK_BITS	(LFHT_FILTER_BLOCK_WORDS * 32)
+/* Filter bits per entry it is sized for, at least: about 1% false positives. */
+#define LFHT_FILTER_BITS_PER_ENTRY	12
+
+struct lfht_filter_block {
+	uint32_t word[LFHT_FILTER_BLOCK_WORDS];
+};
+
+struct lfht_filter {
+	unsigned long nr_blocks;	/* Power of 2. */
+	struct lfht_filter_block *blocks;
+};
 
 /*
  * cds_lfht: Top-level data structure representing a lock-free hash
  * table. Defined in the implementation file to make it be an opaque
  * cookie to users.
  *
- * The fields used in fast-paths are placed near the end of the
- * structure, because we need to have a variable-sized union to contain
- * the mm plugin fields, which are used in the fast path.
+ * The fields are split in cache-line-aligned regions, so that the
+ * stores of updaters and of the resize worker do not invalidate the
+ * cache line every lookup reads: cold configuration and resize state
+ * first, then the fields written by updaters, then those they only
+ * read, and last the fields of the lookup fast-path. The lookup fields
+ * are placed at the end of the structure, because we need to have a
+ * variable-sized union to contain the mm plugin fields, which are used
+ * in the fast path. The structure is allocated aligned on the cache
+ * line.
  */
 struct cds_lfht {
 	/* Initial configuration items */
@@ -71,8 +102,6 @@ struct cds_lfht {
 	const struct cds_lfht_mm_type *mm;	/* memory management plugin */
 	const struct rcu_flavor_struct *flavor;	/* RCU flavor */
 
-	long count;			/* global approximate item count */
-
 	/*
 	 * We need to put the work threads offline (QSBR) when taking this
 	 * mutex, because we use synchronize_rcu within this mutex critical
@@ -81,29 +110,67 @@ struct cds_lfht {
 	 * completion.
 	 */
 	pthread_mutex_t resize_mutex;	/* resize mutex: add/del mutex */
+	pthread_mutex_t filter_mutex;	/* Serializes filter rebuilds. */
 	pthread_attr_t *resize_attr;	/* Resize threads attributes */
-	unsigned int in_progress_destroy;
+	struct urcu_workqueue *resize_workqueue;	/* Resize worker */
+	struct cds_lfht_resize_pool *resize_pool;	/* NULL: default worker */
+	/* Pending free of bucket tables removed by shrink, or NULL. */
+	struct bucket_free_work *bucket_free_work;
+	/* Orders of the pending free, protected by resize_mutex. */
+	unsigned long bucket_free_first_order, bucket_free_last_order;
+	/* Incremental resize state, protected by resize_mutex. */
+	unsigned long incr_resize_order;	/* order being populated, 0: none */
+	unsigned long incr_resize_index;	/* next bucket node to populate */
+	/* Resize passes report a quiescent state at least that often. */
+	unsigned long resize_latency_us;
+
+	/*
+	 * Variables written by the add and remove fast-paths, and by
+	 * resize.
+	 */
+	long count __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+					/* global approximate item count */
 	unsigned long resize_target;
 	int resize_initiated;
+	unsigned int in_progress_destroy;
+	unsigned long last_resize_ms;	/* end of last resize, monotonic */
+	unsigned long resize_nr_buckets;	/* bucket nodes resized, total */
+	/* Removals, counted while nr_lookup_caches is non-zero. */
+	unsigned long generation;
 
 	/*
 	 * Variables needed for add and remove fast-paths.
 	 */
-	int flags;
-	unsigned long min_alloc_buckets_order;
-	unsigned long min_nr_alloc_buckets;
+	int flags __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	struct cds_lfht_resize_policy resize_policy;
 	struct ht_items_count *split_count;	/* split item count */
+	/* Filter being rebuilt, also set by adds, or NULL (RCU). */
+	struct lfht_filter *filter_next;
+	/* Log of the updates, or NULL (RCU). */
+	struct lfht_changelog *changelog;
+	long nr_lookup_caches;
 
 	/*
-	 * Variables needed for the lookup, add and remove fast-paths.
+	 * Variables needed for the lookup, add and remove fast-paths,
+	 * read from a single cache line along with the first entries of
+	 * the union.
 	 */
-	unsigned long size;	/* always a power of 2, shared (RCU) */
+	unsigned long size __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+				/* always a power of 2, shared (RCU) */
+	/* Membership filter of the hashes, or NULL (RCU). */
+	struct lfht_filter *filter;
+	/* Hash of the non-bucket nodes, NULL: stored in reverse_hash. */
+	cds_lfht_node_hash_fct node_hash;
+	void *node_hash_priv;
 	/*
 	 * bucket_at pointer is kept here to skip the extra level of
 	 * dereference needed to get to "mm" (this is a fast-path).
 	 */
 	struct cds_lfht_node *(*bucket_at)(struct cds_lfht *ht,
 			unsigned long index);
+	/* Read by bucket_at of the order, chunk and numa plugins. */
+	unsigned long min_alloc_buckets_order;
+	unsigned long min_nr_alloc_buckets;
 	/*
 	 * Dynamic length "tbl_chunk" needs to be at the end of
 	 * cds_lfht.
@@ -145,17 +212,18 @@ struct cds_lfht {
 
 extern unsigned int cds_lfht_fls_ulong(unsigned long x);
 extern int cds_lfht_get_count_order_ulong(unsigned long x);
+extern unsigned long cds_lfht_bit_reverse_ulong(unsigned long v);
 
 #ifdef POISON_FREE
 #define poison_free(ptr)					\
 	do {							\
 		if (ptr) {					\
 			memset(ptr, 0x42, sizeof(*(ptr)));	\
-			free(ptr);				\
+			urcu_free(ptr);				\
 		}						\
 	} while (0)
 #else
-#define poison_free(ptr)	free(ptr)
+#define poison_free(ptr)	urcu_free(ptr)
 #endif
 
 static inline
@@ -167,8 +235,11 @@ struct cds_lfht *__default_alloc_cds_lfht(
 {
 	struct cds_lfht *ht;
 
-	ht = calloc(1, cds_lfht_size);
+	if (urcu_posix_memalign((void **) &ht, CAA_CACHE_LINE_SIZE,
+			cds_lfht_size))
+		ht = NULL;
 	assert(ht);
+	memset(ht, 0, cds_lfht_size);
 
 	ht->mm = mm;
 	ht->bucket_at = mm->bucket_at;
@@ -180,4 +251,60 @@ struct cds_lfht *__default_alloc_cds_lfht(
 	return ht;
 }
 
+/*
+ * Block index and bit mask of each word of a hash. The hash is mixed
+ * first, since hash functions of integer keys are often the identity.
+ */
+static inline
+struct lfht_filter_block *lfht_filter_block(const struct lfht_filter *filter,
+		unsigned long hash, uint32_t *mask)
+{
+	static const uint32_t salt[LFHT_FILTER_BLOCK_WORDS] = {
+		0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+		0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+	};
+	uint64_t h = hash;
+	uint32_t key;
+	unsigned int i;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	key = (uint32_t) (h >> 32);
+	for (i = 0; i < LFHT_FILTER_BLOCK_WORDS; i++)
+		mask[i] = 1U << ((key * salt[i]) >> 27);
+	return &filter->blocks[(unsigned long) h & (filter->nr_blocks - 1)];
+}
+
+/* Returns 0 if no node of @filter has @hash. */
+static inline
+int lfht_filter_test(const struct lfht_filter *filter, unsigned long hash)
+{
+	uint32_t mask[LFHT_FILTER_BLOCK_WORDS], miss = 0;
+	struct lfht_filter_block *block;
+	unsigned int i;
+
+	block = lfht_filter_block(filter, hash, mask);
+	for (i = 0; i < LFHT_FILTER_BLOCK_WORDS; i++)
+		miss |= mask[i] & ~CMM_LOAD_SHARED(block->word[i]);
+	return !miss;
+}
+
+/* Set the bits of @hash, storing only to the words missing them. */
+static inline
+void lfht_filter_set(struct lfht_filter *filter, unsigned long hash)
+{
+	uint32_t mask[LFHT_FILTER_BLOCK_WORDS];
+	struct lfht_filter_block *block;
+	unsigned int i;
+
+	block = lfht_filter_block(filter, hash, mask);
+	for (i = 0; i < LFHT_FILTER_BLOCK_WORDS; i++) {
+		if (!(CMM_LOAD_SHARED(block->word[i]) & mask[i]))
+			uatomic_or(&block->word[i], mask[i]);
+	}
+}
+
 #endif /* _URCU_RCULFHASH_INTERNAL_H */
@@ -0,0 +1,127 @@
+/*
+ * rculfhash-migrate.c
+ *
+ * Online migration of the nodes of a Lock-Free RCU Hash Table to another
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * A node is moved by adding its copy to the new table, then removing
+ * it from the old table. Lookups search the old table first: a node
+ * missing from the old table has either been moved, in which case its
+ * copy was added to the new table before, or has never been there: no
+ * lookup misses a node being moved. When the node is removed by another
+ * thread while being moved, its copy is removed by the mover, and can
+ * be found by lookups in the meantime.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <urcu-pointer.h>
+#include <urcu/compiler.h>
+#include <urcu/alloc.h>
+#include <urcu/rculfhash.h>
+
+struct cds_lfht_migration {
+	struct cds_lfht *old_ht, *new_ht;
+	struct cds_lfht_migrate_ops ops;
+	void *priv;
+};
+
+struct cds_lfht_migration *cds_lfht_migrate_begin(struct cds_lfht *old_ht,
+		struct cds_lfht *new_ht, const struct cds_lfht_migrate_ops *ops,
+		void *priv)
+{
+	struct cds_lfht_migration *m;
+
+	if (old_ht == new_ht || !ops->hash || !ops->copy || !ops->retire)
+		return NULL;
+	m = urcu_calloc(1, sizeof(*m));
+	if (!m)
+		return NULL;
+	m->old_ht = old_ht;
+	m->new_ht = new_ht;
+	m->ops = *ops;
+	m->priv = priv;
+	return m;
+}
+
+void cds_lfht_migrate_destroy(struct cds_lfht_migration *m)
+{
+	urcu_free(m);
+}
+
+struct cds_lfht *cds_lfht_migrate_lookup(struct cds_lfht_migration *m,
+		unsigned long old_hash, unsigned long new_hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	cds_lfht_lookup(m->old_ht, old_hash, match, key, iter);
+	if (cds_lfht_iter_get_node(iter))
+		return m->old_ht;
+	cds_lfht_lookup(m->new_ht, new_hash, match, key, iter);
+	if (cds_lfht_iter_get_node(iter))
+		return m->new_ht;
+	return NULL;
+}
+
+struct cds_lfht_node *cds_lfht_migrate_add_unique(
+		struct cds_lfht_migration *m,
+		unsigned long old_hash, unsigned long new_hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *found;
+
+	/*
+	 * A key absent from the old table is either in the new one, where
+	 * its mover added it before, or not moved by anyone.
+	 */
+	cds_lfht_lookup(m->old_ht, old_hash, match, key, &iter);
+	found = cds_lfht_iter_get_node(&iter);
+	if (found)
+		return found;
+	return cds_lfht_add_unique(m->new_ht, new_hash, match, key, node);
+}
+
+int cds_lfht_migrate_step(struct cds_lfht_migration *m, unsigned long nr)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node, *copy;
+
+	cds_lfht_first(m->old_ht, &iter);
+	while ((node = cds_lfht_iter_get_node(&iter)) != NULL) {
+		if (!nr--)
+			return 1;
+		copy = m->ops.copy(node, m->priv);
+		if (!copy)
+			return -ENOMEM;
+		cds_lfht_add(m->new_ht, m->ops.hash(copy, m->priv), copy);
+		cds_lfht_next(m->old_ht, &iter);
+		if (!cds_lfht_del(m->old_ht, node)) {
+			m->ops.retire(node, m->priv);
+		} else if (!cds_lfht_del(m->new_ht, copy)) {
+			/*
+			 * Removed concurrently, along with the entry: the
+			 * remover owns the node, and we own the copy.
+			 */
+			m->ops.retire(copy, m->priv);
+		}
+	}
+	return 0;
+}
@@ -49,6 +49,12 @@
  * macOS.
  *
  * For this reason, we keep to original scheme on all platforms except Cygwin.
+ *
+ * The "mmap_huge" variant aligns the reservation on the transparent huge
+ * page size and advises the kernel to back the populated chunks with
+ * huge pages, reducing the TLB misses of bucket_at on large tables.
+ * Where transparent huge pages are unavailable or disabled, the advice
+ * is ignored and regular pages are used.
  */
 
 
@@ -75,6 +81,67 @@ void memory_unmap(void *ptr, size_t length)
 	}
 }
 
+#if defined(MADV_HUGEPAGE) && !defined(__CYGWIN__)
+
+#define DEFAULT_HUGEPAGE_SIZE	(2UL << 20)
+
+static
+unsigned long hugepage_size(void)
+{
+	unsigned long size = 0;
+	FILE *fp;
+
+	fp = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+	if (fp) {
+		if (fscanf(fp, "%lu", &size) != 1)
+			size = 0;
+		fclose(fp);
+	}
+	if (!size || (size & (size - 1)))
+		size = DEFAULT_HUGEPAGE_SIZE;
+	return size;
+}
+
+/*
+ * Reserve inaccessible memory space aligned on the huge page size, so
+ * populated chunks of at least a huge page can be backed by huge pages.
+ */
+static
+void *memory_map_huge(size_t length)
+{
+	unsigned long align = hugepage_size();
+	char *ret, *aligned;
+
+	ret = memory_map(length + align);
+	aligned = (char *) (((unsigned long) ret + align - 1) & ~(align - 1));
+	if (aligned != ret)
+		memory_unmap(ret, aligned - ret);
+	memory_unmap(aligned + length, ret + align - aligned);
+	return aligned;
+}
+
+/* Failure to advise is not an error: regular pages are used. */
+static
+void memory_advise_huge(void *ptr, size_t length)
+{
+	(void) madvise(ptr, length, MADV_HUGEPAGE);
+}
+
+#else /* defined(MADV_HUGEPAGE) && !defined(__CYGWIN__) */
+
+static
+void *memory_map_huge(size_t length)
+{
+	return memory_map(length);
+}
+
+static
+void memory_advise_huge(void *ptr, size_t length)
+{
+}
+
+#endif /* defined(MADV_HUGEPAGE) && !defined(__CYGWIN__) */
+
 #ifdef __CYGWIN__
 /* Set protection to read/write to allocate a memory chunk */
 static
@@ -86,7 +153,10 @@ void memory_populate(void *ptr, size_t length)
 	}
 }
 
-/* Set protection to none to deallocate a memory chunk */
+/*
+ * Set protection to none to deallocate a memory chunk, and tell the
+ * system its content can be dropped.
+ */
 static
 void memory_discard(void *ptr, size_t length)
 {
@@ -94,6 +164,9 @@ void memory_discard(void *ptr, size_t length)
 		perror("mprotect");
 		abort();
 	}
+#ifdef MADV_DONTNEED
+	(void) madvise(ptr, length, MADV_DONTNEED);
+#endif
 }
 
 #else /* __CYGWIN__ */
@@ -126,21 +199,28 @@ void memory_discard(void *ptr, size_t length)
 #endif /* __CYGWIN__ */
 
 static
-void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
+void alloc_bucket_table(struct cds_lfht *ht, unsigned long order, int huge)
 {
 	if (order == 0) {
 		if (ht->min_nr_alloc_buckets == ht->max_nr_buckets) {
 			/* small table */
-			ht->tbl_mmap = calloc(ht->max_nr_buckets,
+			ht->tbl_mmap = urcu_calloc(ht->max_nr_buckets,
 					sizeof(*ht->tbl_mmap));
 			assert(ht->tbl_mmap);
 			return;
 		}
 		/* large table */
-		ht->tbl_mmap = memory_map(ht->max_nr_buckets
-			* sizeof(*ht->tbl_mmap));
+		if (huge)
+			ht->tbl_mmap = memory_map_huge(ht->max_nr_buckets
+				* sizeof(*ht->tbl_mmap));
+		else
+			ht->tbl_mmap = memory_map(ht->max_nr_buckets
+				* sizeof(*ht->tbl_mmap));
 		memory_populate(ht->tbl_mmap,
 			ht->min_nr_alloc_buckets * sizeof(*ht->tbl_mmap));
+		if (huge)
+			memory_advise_huge(ht->tbl_mmap,
+				ht->min_nr_alloc_buckets * sizeof(*ht->tbl_mmap));
 	} else if (order > ht->min_alloc_buckets_order) {
 		/* large table */
 		unsigned long len = 1UL << (order - 1);
@@ -148,10 +228,25 @@ void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
 		assert(ht->min_nr_alloc_buckets < ht->max_nr_buckets);
 		memory_populate(ht->tbl_mmap + len,
 				len * sizeof(*ht->tbl_mmap));
+		if (huge)
+			memory_advise_huge(ht->tbl_mmap + len,
+				len * sizeof(*ht->tbl_mmap));
 	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
 
+static
+void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	alloc_bucket_table(ht, order, 0);
+}
+
+static
+void cds_lfht_alloc_bucket_table_huge(struct cds_lfht *ht, unsigned long order)
+{
+	alloc_bucket_table(ht, order, 1);
+}
+
 /*
  * cds_lfht_free_bucket_table() should be called with decreasing order.
  * When cds_lfht_free_bucket_table(0) is called, it means the whole
@@ -186,7 +281,8 @@ struct cds_lfht_node *bucket_at(struct cds_lfht *ht, unsigned long index)
 }
 
 static
-struct cds_lfht *alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
+struct cds_lfht *alloc_mmap_cds_lfht(const struct cds_lfht_mm_type *mm,
+		unsigned long min_nr_alloc_buckets,
 		unsigned long max_nr_buckets)
 {
 	unsigned long page_bucket_size;
@@ -202,7 +298,23 @@ struct cds_lfht *alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
 	}
 
 	return __default_alloc_cds_lfht(
-			&cds_lfht_mm_mmap, sizeof(struct cds_lfht),
+			mm, sizeof(struct cds_lfht),
+			min_nr_alloc_buckets, max_nr_buckets);
+}
+
+static
+struct cds_lfht *alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	return alloc_mmap_cds_lfht(&cds_lfht_mm_mmap,
+			min_nr_alloc_buckets, max_nr_buckets);
+}
+
+static
+struct cds_lfht *alloc_cds_lfht_huge(unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	return alloc_mmap_cds_lfht(&cds_lfht_mm_mmap_huge,
 			min_nr_alloc_buckets, max_nr_buckets);
 }
 
@@ -212,3 +324,10 @@ const struct cds_lfht_mm_type cds_lfht_mm_mmap = {
 	.free_bucket_table = cds_lfht_free_bucket_table,
 	.bucket_at = bucket_at,
 };
+
+const struct cds_lfht_mm_type cds_lfht_mm_mmap_huge = {
+	.alloc_cds_lfht = alloc_cds_lfht_huge,
+	.alloc_bucket_table = cds_lfht_alloc_bucket_table_huge,
+	.free_bucket_table = cds_lfht_free_bucket_table,
+	.bucket_at = bucket_at,
+};
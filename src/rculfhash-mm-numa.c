@@ -0,0 +1,177 @@
+/*
+ * rculfhash-mm-numa.c
+ *
+ * NUMA interleaved order based memory management for Lock-Free RCU Hash Table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include "rculfhash-internal.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+/*
+ * Bucket tables are allocated per order, as with the "order" allocator.
+ * Each order table spanning at least one page is mapped separately, and
+ * its pages are interleaved across the NUMA nodes the process is
+ * allowed to allocate memory from, so lookups distributed over the
+ * whole table hit all memory nodes evenly instead of the node of the
+ * thread which happened to perform the resize. Smaller tables are
+ * allocated with calloc.
+ *
+ * Where the NUMA memory policy system calls are unavailable, memory is
+ * allocated with the default policy of the allocating thread.
+ */
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_get_mempolicy)
+
+#define NUMA_MAX_NODES		1024
+#define NUMA_MPOL_INTERLEAVE	3
+#define NUMA_MPOL_F_MEMS_ALLOWED	(1 << 2)
+
+static
+void memory_interleave(void *ptr, size_t length)
+{
+	unsigned long nodemask[NUMA_MAX_NODES / CAA_BITS_PER_LONG];
+	int mode;
+
+	if (syscall(SYS_get_mempolicy, &mode, nodemask,
+			(unsigned long) NUMA_MAX_NODES, NULL,
+			(unsigned long) NUMA_MPOL_F_MEMS_ALLOWED))
+		return;
+	/*
+	 * The memory policy is only a placement hint: on failure, keep
+	 * the default policy. The kernel expects the number of nodes
+	 * plus one.
+	 */
+	(void) syscall(SYS_mbind, ptr, (unsigned long) length,
+			(unsigned long) NUMA_MPOL_INTERLEAVE, nodemask,
+			(unsigned long) NUMA_MAX_NODES + 1, 0UL);
+}
+
+#else
+
+static
+void memory_interleave(void *ptr, size_t length)
+{
+}
+
+#endif
+
+static
+size_t table_bytes(unsigned long nr_buckets)
+{
+	return nr_buckets * sizeof(struct cds_lfht_node);
+}
+
+static
+struct cds_lfht_node *memory_alloc(unsigned long nr_buckets)
+{
+	size_t length = table_bytes(nr_buckets);
+	void *ptr;
+
+	if (length < (size_t) getpagesize()) {
+		ptr = urcu_calloc(nr_buckets, sizeof(struct cds_lfht_node));
+		assert(ptr);
+		return ptr;
+	}
+	ptr = urcu_large_alloc(length);
+	if (!ptr) {
+		perror("urcu_large_alloc");
+		abort();
+	}
+	/* Set the policy before the pages are first touched. */
+	memory_interleave(ptr, length);
+	return ptr;
+}
+
+static
+void memory_free(struct cds_lfht_node *ptr, unsigned long nr_buckets)
+{
+	size_t length = table_bytes(nr_buckets);
+
+	if (length < (size_t) getpagesize()) {
+		poison_free(ptr);
+		return;
+	}
+	urcu_large_free(ptr, length);
+}
+
+static
+void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	if (order == 0)
+		ht->tbl_order[0] = memory_alloc(ht->min_nr_alloc_buckets);
+	else if (order > ht->min_alloc_buckets_order)
+		ht->tbl_order[order] = memory_alloc(1UL << (order - 1));
+	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
+}
+
+/*
+ * cds_lfht_free_bucket_table() should be called with decreasing order.
+ * When cds_lfht_free_bucket_table(0) is called, it means the whole
+ * lfht is destroyed.
+ */
+static
+void cds_lfht_free_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	if (order == 0)
+		memory_free(ht->tbl_order[0], ht->min_nr_alloc_buckets);
+	else if (order > ht->min_alloc_buckets_order)
+		memory_free(ht->tbl_order[order], 1UL << (order - 1));
+	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
+}
+
+static
+struct cds_lfht_node *bucket_at(struct cds_lfht *ht, unsigned long index)
+{
+	unsigned long order;
+
+	if (index < ht->min_nr_alloc_buckets) {
+		dbg_printf("bucket index %lu order 0 aridx 0\n", index);
+		return &ht->tbl_order[0][index];
+	}
+	/*
+	 * equivalent to cds_lfht_get_count_order_ulong(index + 1), but
+	 * optimizes away the non-existing 0 special-case for
+	 * cds_lfht_get_count_order_ulong.
+	 */
+	order = cds_lfht_fls_ulong(index);
+	dbg_printf("bucket index %lu order %lu aridx %lu\n",
+		   index, order, index & ((1UL << (order - 1)) - 1));
+	return &ht->tbl_order[order][index & ((1UL << (order - 1)) - 1)];
+}
+
+static
+struct cds_lfht *alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	return __default_alloc_cds_lfht(
+			&cds_lfht_mm_numa, sizeof(struct cds_lfht),
+			min_nr_alloc_buckets, max_nr_buckets);
+}
+
+const struct cds_lfht_mm_type cds_lfht_mm_numa = {
+	.alloc_cds_lfht = alloc_cds_lfht,
+	.alloc_bucket_table = cds_lfht_alloc_bucket_table,
+	.free_bucket_table = cds_lfht_free_bucket_table,
+	.bucket_at = bucket_at,
+};
@@ -27,11 +27,11 @@ static
 void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
 {
 	if (order == 0) {
-		ht->tbl_order[0] = calloc(ht->min_nr_alloc_buckets,
+		ht->tbl_order[0] = urcu_calloc(ht->min_nr_alloc_buckets,
 			sizeof(struct cds_lfht_node));
 		assert(ht->tbl_order[0]);
 	} else if (order > ht->min_alloc_buckets_order) {
-		ht->tbl_order[order] = calloc(1UL << (order -1),
+		ht->tbl_order[order] = urcu_calloc(1UL << (order -1),
 			sizeof(struct cds_lfht_node));
 		assert(ht->tbl_order[order]);
 	}
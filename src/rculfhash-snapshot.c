@@ -0,0 +1,376 @@
+/*
+ * rculfhash-snapshot.c
+ *
+ * Persistent memory-mapped snapshots of Lock-Free RCU Hash Tables
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <urcu-pointer.h>
+#include <urcu/compiler.h>
+#include "rculfhash-internal.h"
+
+/*
+ * File layout, in host byte order:
+ *
+ * - header,
+ * - nr_slots open-addressing slots (hash, record index + 1), at a
+ *   cache line aligned offset, probed linearly from hash & (nr_slots - 1),
+ * - nr_records records, each made of the node hash followed by the
+ *   payload produced by the serialization callback.
+ *
+ * The slot table is at most half full, so lookups in a mapped file
+ * touch a slot cache line, then the record.
+ */
+#define SNAPSHOT_MAGIC		"LFHTSNAP"
+#define SNAPSHOT_VERSION	1
+#define SNAPSHOT_BYTE_ORDER	0x01020304U
+#define SNAPSHOT_ALIGN		64
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t payload_size;
+	uint64_t record_size;
+	uint64_t nr_records;
+	uint64_t nr_slots;
+	uint64_t slots_offset;
+	uint64_t records_offset;
+};
+
+struct snapshot_slot {
+	uint64_t hash;
+	uint64_t record;		/* record index + 1, 0: empty slot */
+};
+
+/*
+ * The header fields are copied once validated: the mapping is shared,
+ * and the file may change under it.
+ */
+struct cds_lfht_snapshot {
+	void *base;
+	size_t len;
+	const struct snapshot_slot *slots;
+	const char *records;
+	unsigned long mask;		/* nr_slots - 1 */
+	uint64_t nr_records;
+	uint64_t record_size;
+	size_t payload_size;
+};
+
+static
+uint64_t align_up(uint64_t v)
+{
+	return (v + SNAPSHOT_ALIGN - 1) & ~(uint64_t) (SNAPSHOT_ALIGN - 1);
+}
+
+static
+int write_full(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t ret;
+
+		ret = write(fd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static
+int write_zeroes(int fd, size_t len)
+{
+	static const char zeroes[SNAPSHOT_ALIGN];
+
+	while (len) {
+		size_t chunk = min(len, sizeof(zeroes));
+		int ret;
+
+		ret = write_full(fd, zeroes, chunk);
+		if (ret)
+			return ret;
+		len -= chunk;
+	}
+	return 0;
+}
+
+/* Collect the (hash, node) pairs present in the table. */
+static
+int snapshot_collect(struct cds_lfht *ht, struct cds_lfht_bulk_entry **entries,
+		unsigned long *nr_entries)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long nr = 0, alloc = 0;
+	struct cds_lfht_bulk_entry *array = NULL;
+
+	cds_lfht_for_each(ht, &iter, node) {
+		if (nr == alloc) {
+			struct cds_lfht_bulk_entry *new_array;
+
+			alloc = alloc ? 2 * alloc : 1024;
+			new_array = urcu_realloc(array, alloc * sizeof(*array));
+			if (!new_array) {
+				urcu_free(array);
+				return -ENOMEM;
+			}
+			array = new_array;
+		}
+		if (ht->node_hash)
+			array[nr].hash = ht->node_hash(node, ht->node_hash_priv);
+		else
+			array[nr].hash = cds_lfht_bit_reverse_ulong(
+					node->reverse_hash);
+		array[nr].node = node;
+		nr++;
+	}
+	*entries = array;
+	*nr_entries = nr;
+	return 0;
+}
+
+int cds_lfht_snapshot_write(struct cds_lfht *ht, int fd, size_t payload_size,
+		cds_lfht_serialize_fct serialize, void *priv)
+{
+	struct snapshot_header header;
+	struct snapshot_slot *slots = NULL;
+	struct cds_lfht_bulk_entry *entries = NULL;
+	unsigned long nr_entries, nr_slots, i;
+	uint64_t record_size;
+	char *record = NULL;
+	int ret;
+
+	ret = snapshot_collect(ht, &entries, &nr_entries);
+	if (ret)
+		return ret;
+	nr_slots = 1UL << cds_lfht_get_count_order_ulong(
+			max(2 * nr_entries, 2UL));
+	record_size = (sizeof(uint64_t) + payload_size + sizeof(uint64_t) - 1)
+			& ~(uint64_t) (sizeof(uint64_t) - 1);
+	slots = urcu_calloc(nr_slots, sizeof(*slots));
+	record = urcu_calloc(1, record_size);
+	if (!slots || !record) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	for (i = 0; i < nr_entries; i++) {
+		unsigned long s;
+
+		for (s = entries[i].hash & (nr_slots - 1); slots[s].record;
+				s = (s + 1) & (nr_slots - 1))
+			;
+		slots[s].hash = entries[i].hash;
+		slots[s].record = i + 1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.payload_size = payload_size;
+	header.record_size = record_size;
+	header.nr_records = nr_entries;
+	header.nr_slots = nr_slots;
+	header.slots_offset = align_up(sizeof(header));
+	header.records_offset = align_up(header.slots_offset
+			+ (uint64_t) nr_slots * sizeof(*slots));
+
+	ret = write_full(fd, &header, sizeof(header));
+	if (!ret)
+		ret = write_zeroes(fd, header.slots_offset - sizeof(header));
+	if (!ret)
+		ret = write_full(fd, slots, nr_slots * sizeof(*slots));
+	if (!ret)
+		ret = write_zeroes(fd, header.records_offset
+			- header.slots_offset - nr_slots * sizeof(*slots));
+	for (i = 0; !ret && i < nr_entries; i++) {
+		uint64_t hash = entries[i].hash;
+
+		memset(record, 0, record_size);
+		memcpy(record, &hash, sizeof(hash));
+		serialize(entries[i].node, record + sizeof(hash), priv);
+		ret = write_full(fd, record, record_size);
+	}
+end:
+	urcu_free(record);
+	urcu_free(slots);
+	urcu_free(entries);
+	return ret;
+}
+
+static
+int snapshot_header_valid(const struct snapshot_header *header, size_t len)
+{
+	uint64_t slots_len, records_len;
+
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic))
+	    || header->version != SNAPSHOT_VERSION
+	    || header->byte_order != SNAPSHOT_BYTE_ORDER)
+		return 0;
+	if (!header->nr_slots || (header->nr_slots & (header->nr_slots - 1))
+	    || header->nr_slots <= header->nr_records
+	    || header->nr_slots - 1 > ULONG_MAX)
+		return 0;
+	if (header->payload_size > SIZE_MAX - sizeof(uint64_t)
+	    || header->record_size < sizeof(uint64_t) + header->payload_size
+	    || header->record_size % sizeof(uint64_t))
+		return 0;
+	if (header->slots_offset < sizeof(*header)
+	    || header->slots_offset % SNAPSHOT_ALIGN
+	    || header->records_offset % SNAPSHOT_ALIGN
+	    || header->slots_offset > len || header->records_offset > len)
+		return 0;
+	/* Bounds, without overflowing. */
+	if (header->nr_slots > (len - header->slots_offset)
+			/ sizeof(struct snapshot_slot))
+		return 0;
+	slots_len = header->nr_slots * sizeof(struct snapshot_slot);
+	if (header->records_offset < header->slots_offset + slots_len)
+		return 0;
+	if (header->nr_records > (len - header->records_offset)
+			/ header->record_size)
+		return 0;
+	records_len = header->nr_records * header->record_size;
+	return header->records_offset + records_len <= len;
+}
+
+struct cds_lfht_snapshot *cds_lfht_snapshot_map(int fd)
+{
+	struct cds_lfht_snapshot *snap;
+	struct snapshot_header header;
+	struct stat st;
+	void *base;
+
+	if (fstat(fd, &st))
+		return NULL;
+	if (st.st_size < (off_t) sizeof(struct snapshot_header)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	snap = urcu_calloc(1, sizeof(*snap));
+	if (!snap) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		urcu_free(snap);
+		return NULL;
+	}
+	snap->base = base;
+	snap->len = st.st_size;
+	memcpy(&header, base, sizeof(header));
+	if (!snapshot_header_valid(&header, snap->len)) {
+		(void) munmap(base, snap->len);
+		urcu_free(snap);
+		errno = EINVAL;
+		return NULL;
+	}
+	snap->slots = (const struct snapshot_slot *)
+		((const char *) base + header.slots_offset);
+	snap->records = (const char *) base + header.records_offset;
+	snap->mask = header.nr_slots - 1;
+	snap->nr_records = header.nr_records;
+	snap->record_size = header.record_size;
+	snap->payload_size = header.payload_size;
+	return snap;
+}
+
+int cds_lfht_snapshot_unmap(struct cds_lfht_snapshot *snap)
+{
+	int ret = 0;
+
+	if (munmap(snap->base, snap->len))
+		ret = -errno;
+	poison_free(snap);
+	return ret;
+}
+
+static
+const char *snapshot_record(const struct cds_lfht_snapshot *snap,
+		uint64_t index)
+{
+	return snap->records + index * snap->record_size;
+}
+
+const void *cds_lfht_snapshot_lookup(const struct cds_lfht_snapshot *snap,
+		unsigned long hash, cds_lfht_payload_match_fct match,
+		const void *key)
+{
+	unsigned long i, n;
+
+	/*
+	 * A well-formed table always has an empty slot: the probes are
+	 * only bounded for a corrupted file, as are the record indexes.
+	 */
+	for (i = hash & snap->mask, n = 0; n <= snap->mask;
+			i = (i + 1) & snap->mask, n++) {
+		struct snapshot_slot slot;
+		const void *payload;
+
+		memcpy(&slot, &snap->slots[i], sizeof(slot));
+		if (!slot.record || slot.record > snap->nr_records)
+			return NULL;
+		if (slot.hash != (uint64_t) hash)
+			continue;
+		payload = snapshot_record(snap, slot.record - 1)
+				+ sizeof(uint64_t);
+		if (!match || caa_likely(match(payload, key)))
+			return payload;
+	}
+	return NULL;
+}
+
+unsigned long cds_lfht_snapshot_count(const struct cds_lfht_snapshot *snap)
+{
+	return snap->nr_records;
+}
+
+size_t cds_lfht_snapshot_payload_size(const struct cds_lfht_snapshot *snap)
+{
+	return snap->payload_size;
+}
+
+const void *cds_lfht_snapshot_get(const struct cds_lfht_snapshot *snap,
+		unsigned long index, unsigned long *hash)
+{
+	const char *record;
+	uint64_t record_hash;
+
+	if (index >= snap->nr_records)
+		return NULL;
+	record = snapshot_record(snap, index);
+	memcpy(&record_hash, record, sizeof(record_hash));
+	if (hash)
+		*hash = record_hash;
+	return record + sizeof(uint64_t);
+}
@@ -262,8 +262,30 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
 #include <sched.h>
 #include <unistd.h>
+#include <poll.h>
+#if (defined(__GFNI__) || defined(__SSSE3__) || defined(__LZCNT__)) \
+		&& (defined(__i386) || defined(__x86_64))
+#include <immintrin.h>
+#endif
+
+/*
+ * liburcu-cds-qsbr and liburcu-cds-memb are built with
+ * RCULFHASH_FLAVOR_QSBR or RCULFHASH_FLAVOR_MEMB: their hash tables are
+ * bound to that flavor, whose header is included before the others so
+ * its symbol mapping applies to urcu-call-rcu.h.
+ */
+#if defined(RCULFHASH_FLAVOR_QSBR)
+#include <urcu-qsbr.h>
+#define RCULFHASH_FLAVOR_BOUND
+#elif defined(RCULFHASH_FLAVOR_MEMB)
+#define RCU_MEMBARRIER
+#include <urcu.h>
+#define RCULFHASH_FLAVOR_BOUND
+#endif
 
 #include "compat-getcpu.h"
 #include <urcu-pointer.h>
@@ -272,13 +294,54 @@
 #include <urcu/arch.h>
 #include <urcu/uatomic.h>
 #include <urcu/compiler.h>
+#include <urcu/tls-compat.h>
 #include <urcu/rculfhash.h>
 #include <rculfhash-internal.h>
 #include <stdio.h>
 #include <pthread.h>
 #include <signal.h>
+#include <urcu/list.h>
 #include "workqueue.h"
 #include "urcu-die.h"
+#include "urcu-trace.h"
+#include "urcu-stats.h"
+#include "urcu-time.h"
+
+/* Emit the library symbols rather than the inline lookups. */
+#undef cds_lfht_lookup
+#undef cds_lfht_lookup_key8
+#undef cds_lfht_lookup_key16
+#undef cds_lfht_lookup_key32
+#undef cds_lfht_match_key8
+#undef cds_lfht_match_key16
+#undef cds_lfht_match_key32
+
+/*
+ * Flavor operations of the resize and cleanup paths: inlined when the
+ * library is bound to a flavor, called through ht->flavor otherwise.
+ */
+#ifdef RCULFHASH_FLAVOR_BOUND
+#define flavor_read_lock(ht)		rcu_read_lock()
+#define flavor_read_unlock(ht)		rcu_read_unlock()
+#define flavor_synchronize_rcu(ht)	synchronize_rcu()
+#define flavor_call_rcu(ht, head, func)	call_rcu(head, func)
+#define flavor_register_thread(ht)	rcu_register_thread()
+#define flavor_unregister_thread(ht)	rcu_unregister_thread()
+#define flavor_read_ongoing(ht)		rcu_read_ongoing()
+#define flavor_thread_offline(ht)	rcu_thread_offline()
+#define flavor_thread_online(ht)	rcu_thread_online()
+#else
+#define flavor_read_lock(ht)		(ht)->flavor->read_lock()
+#define flavor_read_unlock(ht)		(ht)->flavor->read_unlock()
+#define flavor_synchronize_rcu(ht)	(ht)->flavor->update_synchronize_rcu()
+#define flavor_call_rcu(ht, head, func)	\
+	(ht)->flavor->update_call_rcu(head, func)
+#define flavor_register_thread(ht)	(ht)->flavor->register_thread()
+#define flavor_unregister_thread(ht)	(ht)->flavor->unregister_thread()
+#define flavor_read_ongoing(ht)		(ht)->flavor->read_ongoing()
+#define flavor_thread_offline(ht)	(ht)->flavor->thread_offline()
+#define flavor_thread_online(ht)	(ht)->flavor->thread_online()
+#endif
 
 /*
  * Split-counters lazily update the global counter each 1024
@@ -289,7 +352,6 @@
 #define COUNT_COMMIT_ORDER		10
 #define DEFAULT_SPLIT_COUNT_MASK	0xFUL
 #define CHAIN_LEN_TARGET		1
-#define CHAIN_LEN_RESIZE_THRESHOLD	3
 
 /*
  * Define the minimum table size.
@@ -303,6 +365,19 @@
 #define MIN_PARTITION_PER_THREAD_ORDER	12
 #define MIN_PARTITION_PER_THREAD	(1UL << MIN_PARTITION_PER_THREAD_ORDER)
 
+/*
+ * Number of bucket nodes populated by an updater helping an incremental
+ * resize.
+ */
+#define INCREMENTAL_RESIZE_STEP		64UL
+
+/*
+ * Number of hash chains walked concurrently by cds_lfht_lookup_many.
+ */
+#define LOOKUP_MANY_BATCH		16UL
+
+#define lfht_prefetch(ptr)		__builtin_prefetch(ptr)
+
 /*
  * The removed flag needs to be updated atomically with the pointer.
  * It indicates that no node must attach to the node scheduled for
@@ -315,10 +390,10 @@
  * iteract with the "removal owner" flag, because it validates that
  * the "removed" flag is not set before performing its cmpxchg.
  */
-#define REMOVED_FLAG		(1UL << 0)
-#define BUCKET_FLAG		(1UL << 1)
-#define REMOVAL_OWNER_FLAG	(1UL << 2)
-#define FLAGS_MASK		((1UL << 3) - 1)
+#define REMOVED_FLAG		_CDS_LFHT_REMOVED_FLAG
+#define BUCKET_FLAG		_CDS_LFHT_BUCKET_FLAG
+#define REMOVAL_OWNER_FLAG	_CDS_LFHT_REMOVAL_OWNER_FLAG
+#define FLAGS_MASK		_CDS_LFHT_FLAGS_MASK
 
 /* Value of the end pointer. Should not interact with flags. */
 #define END_VALUE		NULL
@@ -346,6 +421,28 @@ struct resize_work {
 	struct cds_lfht *ht;
 };
 
+enum resize_handle_state {
+	RESIZE_HANDLE_QUEUED = 0,
+	RESIZE_HANDLE_RUNNING,
+	RESIZE_HANDLE_DONE,
+};
+
+/*
+ * cds_lfht_resize_handle: resize queued by cds_lfht_resize_async,
+ * performed by the resize worker thread of the table.
+ */
+struct cds_lfht_resize_handle {
+	struct urcu_work work;
+	struct cds_lfht *ht;
+	unsigned long new_size;
+	cds_lfht_resize_done_fct done_fct;
+	void *priv;
+	unsigned long nr_buckets_base;	/* ht->resize_nr_buckets at start */
+	unsigned long nr_buckets_total;	/* bucket nodes to resize */
+	unsigned long size;		/* table size after the resize */
+	int state;
+};
+
 /*
  * partition_resize_work: Contains arguments passed to worker threads
  * executing the hash table resize on partitions of the hash table
@@ -355,13 +452,115 @@ struct partition_resize_work {
 	pthread_t thread_id;
 	struct cds_lfht *ht;
 	unsigned long i, start, len;
+	void *priv;
 	void (*fct)(struct cds_lfht *ht, unsigned long i,
-		    unsigned long start, unsigned long len);
+		    unsigned long start, unsigned long len, void *priv);
+	int caller_online;	/* QSBR caller waiting offline. */
+};
+
+/*
+ * clear_work: shared by the threads detaching and freeing the nodes of
+ * disjoint ranges of a table being cleared.
+ */
+struct clear_work {
+	void (*free_fct)(struct cds_lfht_node *node, void *priv);
+	void *priv;
+	unsigned long size;		/* Number of ranges */
+	unsigned long nr_cleared;
+	int sync;			/* Wait for readers before freeing */
+};
+
+/*
+ * del_if_work: shared by the threads deleting the nodes matching a
+ * predicate in disjoint ranges of a table. Each thread keeps the nodes
+ * it removed in a list of del_if_chunk, freed after a single grace
+ * period.
+ */
+struct del_if_work {
+	int (*pred)(struct cds_lfht_node *node, void *priv);
+	void (*free_fct)(struct cds_lfht_node *node, void *priv);
+	void *priv;
+	unsigned long size;		/* Number of ranges */
+	unsigned long nr_deleted;
+	int err;			/* -ENOMEM if a thread stopped early */
+};
+
+#define DEL_IF_RANGES		64	/* Ranges per read-side critical section */
+#define DEL_IF_BATCH		64	/* Max nodes unlinked per gc pass */
+#define DEL_IF_CHUNK		1024	/* Multiple of DEL_IF_BATCH */
+
+struct del_if_chunk {
+	struct del_if_chunk *next;
+	unsigned long nr;
+	struct cds_lfht_node *nodes[DEL_IF_CHUNK];
+};
+
+/*
+ * del_free_batch: page-sized array of the nodes removed by
+ * cds_lfht_del_free in a thread, sharing a flavor and a free function,
+ * queued with a single call_rcu of that flavor once full. The flavor
+ * member lets flavor_call_rcu take the batch in place of a table.
+ */
+struct del_free_batch {
+	struct rcu_head head;
+	const struct rcu_flavor_struct *flavor;
+	void (*free_fct)(struct cds_lfht_node *node);
+	unsigned long nr;
+	struct cds_lfht_node *nodes[];
+};
+
+#define DEL_FREE_BATCH_BYTES	4096
+#define DEL_FREE_BATCH_LEN						\
+	((DEL_FREE_BATCH_BYTES - sizeof(struct del_free_batch))		\
+	 / sizeof(struct cds_lfht_node *))
+
+static DEFINE_URCU_TLS(struct del_free_batch *, cds_lfht_del_free_batch);
+
+/*
+ * Thread-specific copy of the batch pointer, whose destructor frees the
+ * batch left by a thread exiting without cds_lfht_del_free_flush.
+ */
+static pthread_key_t del_free_key;
+static pthread_once_t del_free_key_once = PTHREAD_ONCE_INIT;
+
+/*
+ * bulk_load: Sorted array of nodes linked into a hash table which is
+ * not yet visible to any other thread.
+ */
+struct bulk_load {
+	struct cds_lfht_bulk_entry *entries;
+	unsigned long nr_entries;
 };
 
 static struct urcu_workqueue *cds_lfht_workqueue;
 static unsigned long cds_lfht_workqueue_user_count;
 
+/*
+ * Resize pools: sets of resize worker threads created by the
+ * application. Tables attached to a pool are spread over its workers,
+ * so resize of different tables can proceed in parallel.
+ */
+struct cds_lfht_resize_pool {
+	struct cds_list_head node;	/* cds_lfht_resize_pools list */
+	unsigned long refcount;		/* attached tables */
+	unsigned long next_worker;	/* round-robin table assignment */
+	unsigned int nr_workers;
+	struct urcu_workqueue *workqueue[];
+};
+
+/* Protected by cds_lfht_fork_mutex. */
+static CDS_LIST_HEAD(cds_lfht_resize_pools);
+
+/*
+ * Workers splitting the partitions of resizes, bulk loads, clears and
+ * del_if among them, created by the first operation large enough.
+ * Written with cds_lfht_fork_mutex held. Its threads are not registered
+ * RCU readers, but register to the flavor of the table around each
+ * partition.
+ */
+static struct urcu_workqueue *cds_lfht_partition_workqueue;
+static DEFINE_URCU_TLS(int, cds_lfht_partition_worker);
+
 /*
  * Mutex ensuring mutual exclusion between workqueue initialization and
  * fork handlers. cds_lfht_fork_mutex nests inside call_rcu_mutex.
@@ -380,6 +579,89 @@ static int cds_lfht_workqueue_atfork_nesting;
 static void cds_lfht_init_worker(const struct rcu_flavor_struct *flavor);
 static void cds_lfht_fini_worker(const struct rcu_flavor_struct *flavor);
 
+/*
+ * Bit reversal of the hashes: rbit on arm64 and armv7 configured with
+ * --enable-arm-asm, GFNI on x86
+ * built with -mgfni, which reverses the bits of each byte, then a byte
+ * swap. Otherwise, a byte swap followed by swaps of the nibbles, bit
+ * pairs and bits of each byte, or a lookup table without
+ * __builtin_bswap. bit_reverse_ulong_many() reverses a whole array of
+ * hashes with SSSE3 or AVX2 nibble lookups where available.
+ */
+#if defined(CONFIG_RCU_ARM_ASM) && defined(__aarch64__)
+
+static inline
+uint64_t bit_reverse_u64(uint64_t v)
+{
+	uint64_t r;
+
+	__asm__ ("rbit %0, %1" : "=r" (r) : "r" (v));
+	return r;
+}
+#define HAS_BIT_REVERSE_U64
+
+#elif defined(CONFIG_RCU_ARM_ASM) && defined(__arm__) \
+		&& defined(__ARM_ARCH) && __ARM_ARCH >= 7
+
+static inline
+uint32_t bit_reverse_u32(uint32_t v)
+{
+	uint32_t r;
+
+	__asm__ ("rbit %0, %1" : "=r" (r) : "r" (v));
+	return r;
+}
+#define HAS_BIT_REVERSE_U32
+
+#elif defined(__GFNI__) && defined(__x86_64__)
+
+/*
+ * The affine transform by this matrix maps bit i of each byte to bit
+ * 7 - i.
+ */
+#define GF2P8_BIT_REVERSE	0x8040201008040201ULL
+
+static inline
+uint64_t bit_reverse_u64(uint64_t v)
+{
+	__m128i x = _mm_cvtsi64_si128((long long) v);
+
+	x = _mm_gf2p8affine_epi64_epi8(x,
+		_mm_set1_epi64x((long long) GF2P8_BIT_REVERSE), 0);
+	return __builtin_bswap64((uint64_t) _mm_cvtsi128_si64(x));
+}
+#define HAS_BIT_REVERSE_U64
+
+#endif
+
+#if defined(__GNUC__) && !defined(HAS_BIT_REVERSE_U32)
+static __attribute__((unused))
+uint32_t bit_reverse_u32(uint32_t v)
+{
+	v = __builtin_bswap32(v);
+	v = ((v >> 4) & 0x0F0F0F0FU) | ((v & 0x0F0F0F0FU) << 4);
+	v = ((v >> 2) & 0x33333333U) | ((v & 0x33333333U) << 2);
+	return ((v >> 1) & 0x55555555U) | ((v & 0x55555555U) << 1);
+}
+#define HAS_BIT_REVERSE_U32
+#endif
+
+#if defined(__GNUC__) && !defined(HAS_BIT_REVERSE_U64)
+static __attribute__((unused))
+uint64_t bit_reverse_u64(uint64_t v)
+{
+	v = __builtin_bswap64(v);
+	v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL)
+		| ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	v = ((v >> 2) & 0x3333333333333333ULL)
+		| ((v & 0x3333333333333333ULL) << 2);
+	return ((v >> 1) & 0x5555555555555555ULL)
+		| ((v & 0x5555555555555555ULL) << 1);
+}
+#define HAS_BIT_REVERSE_U64
+#endif
+
+#if !defined(HAS_BIT_REVERSE_U32) || !defined(HAS_BIT_REVERSE_U64)
 /*
  * Algorithm to reverse bits in a word by lookup table, extended to
  * 64-bit words.
@@ -404,9 +686,10 @@ uint8_t bit_reverse_u8(uint8_t v)
 {
 	return BitReverseTable256[v];
 }
+#endif
 
-#if (CAA_BITS_PER_LONG == 32)
-static
+#ifndef HAS_BIT_REVERSE_U32
+static __attribute__((unused))
 uint32_t bit_reverse_u32(uint32_t v)
 {
 	return ((uint32_t) bit_reverse_u8(v) << 24) |
@@ -414,8 +697,10 @@ uint32_t bit_reverse_u32(uint32_t v)
 		((uint32_t) bit_reverse_u8(v >> 16) << 8) |
 		((uint32_t) bit_reverse_u8(v >> 24));
 }
-#else
-static
+#endif
+
+#ifndef HAS_BIT_REVERSE_U64
+static __attribute__((unused))
 uint64_t bit_reverse_u64(uint64_t v)
 {
 	return ((uint64_t) bit_reverse_u8(v) << 56) |
@@ -429,7 +714,7 @@ uint64_t bit_reverse_u64(uint64_t v)
 }
 #endif
 
-static
+static inline
 unsigned long bit_reverse_ulong(unsigned long v)
 {
 #if (CAA_BITS_PER_LONG == 32)
@@ -439,12 +724,92 @@ unsigned long bit_reverse_ulong(unsigned long v)
 #endif
 }
 
+#if (defined(__AVX2__) || defined(__SSSE3__)) && defined(__x86_64__)
+/*
+ * Reverse the bytes of each 64-bit lane with a byte shuffle, then the
+ * bits of each byte with two lookups of its nibbles in a table of the
+ * reversed nibbles.
+ */
+#define NIBBLE_REVERSE_TABLE \
+	0x00, 0x08, 0x04, 0x0C, 0x02, 0x0A, 0x06, 0x0E, \
+	0x01, 0x09, 0x05, 0x0D, 0x03, 0x0B, 0x07, 0x0F
+#define BSWAP64_SHUFFLE \
+	7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+#define HAS_BIT_REVERSE_MANY
+#endif
+
+#if defined(__AVX2__) && defined(__x86_64__)
+static inline
+__m256i bit_reverse_u64x4(__m256i v)
+{
+	const __m256i table = _mm256_setr_epi8(NIBBLE_REVERSE_TABLE,
+			NIBBLE_REVERSE_TABLE);
+	const __m256i bswap = _mm256_setr_epi8(BSWAP64_SHUFFLE,
+			BSWAP64_SHUFFLE);
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+	__m256i lo, hi;
+
+	v = _mm256_shuffle_epi8(v, bswap);
+	lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, mask));
+	hi = _mm256_shuffle_epi8(table,
+			_mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+	return _mm256_or_si256(_mm256_slli_epi16(lo, 4), hi);
+}
+#endif
+
+#if defined(__SSSE3__) && defined(__x86_64__)
+static inline
+__m128i bit_reverse_u64x2(__m128i v)
+{
+	const __m128i table = _mm_setr_epi8(NIBBLE_REVERSE_TABLE);
+	const __m128i bswap = _mm_setr_epi8(BSWAP64_SHUFFLE);
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	__m128i lo, hi;
+
+	v = _mm_shuffle_epi8(v, bswap);
+	lo = _mm_shuffle_epi8(table, _mm_and_si128(v, mask));
+	hi = _mm_shuffle_epi8(table,
+			_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+	return _mm_or_si128(_mm_slli_epi16(lo, 4), hi);
+}
+#endif
+
+/* Store the bit reversal of the @nr hashes of @v in @r. */
+static inline
+void bit_reverse_ulong_many(const unsigned long *v, unsigned long *r,
+		unsigned long nr)
+{
+	unsigned long i = 0;
+
+#if defined(__AVX2__) && defined(__x86_64__)
+	for (; i + 4 <= nr; i += 4)
+		_mm256_storeu_si256((__m256i *) &r[i], bit_reverse_u64x4(
+			_mm256_loadu_si256((const __m256i *) &v[i])));
+#endif
+#if defined(__SSSE3__) && defined(__x86_64__)
+	for (; i + 2 <= nr; i += 2)
+		_mm_storeu_si128((__m128i *) &r[i], bit_reverse_u64x2(
+			_mm_loadu_si128((const __m128i *) &v[i])));
+#endif
+	for (; i < nr; i++)
+		r[i] = bit_reverse_ulong(v[i]);
+}
+
 /*
  * fls: returns the position of the most significant bit.
  * Returns 0 if no bit is set, else returns the position of the most
  * significant bit (from 1 to 32 on 32-bit, from 1 to 64 on 64-bit).
+ * lzcnt, on x86 built with -mlzcnt, counts 32 or 64 leading zeroes
+ * in 0, unlike bsr. clz does too on arm, with --enable-arm-asm.
  */
-#if defined(__i386) || defined(__x86_64)
+#if defined(__LZCNT__) && (defined(__i386) || defined(__x86_64))
+static inline
+unsigned int fls_u32(uint32_t x)
+{
+	return 32 - _lzcnt_u32(x);
+}
+#define HAS_FLS_U32
+#elif defined(__i386) || defined(__x86_64)
 static inline
 unsigned int fls_u32(uint32_t x)
 {
@@ -458,9 +823,27 @@ unsigned int fls_u32(uint32_t x)
 	return r + 1;
 }
 #define HAS_FLS_U32
+#elif defined(CONFIG_RCU_ARM_ASM) && (defined(__aarch64__) \
+		|| (defined(__arm__) && defined(__ARM_ARCH) && __ARM_ARCH >= 5))
+static inline
+unsigned int fls_u32(uint32_t x)
+{
+	uint32_t r;
+
+	__asm__ ("clz %w0, %w1" : "=r" (r) : "r" (x));
+	return 32 - r;
+}
+#define HAS_FLS_U32
 #endif
 
-#if defined(__x86_64)
+#if defined(__LZCNT__) && defined(__x86_64)
+static inline
+unsigned int fls_u64(uint64_t x)
+{
+	return 64 - (unsigned int) _lzcnt_u64(x);
+}
+#define HAS_FLS_U64
+#elif defined(__x86_64)
 static inline
 unsigned int fls_u64(uint64_t x)
 {
@@ -474,6 +857,16 @@ unsigned int fls_u64(uint64_t x)
 	return r + 1;
 }
 #define HAS_FLS_U64
+#elif defined(CONFIG_RCU_ARM_ASM) && defined(__aarch64__)
+static inline
+unsigned int fls_u64(uint64_t x)
+{
+	uint64_t r;
+
+	__asm__ ("clz %0, %1" : "=r" (r) : "r" (x));
+	return 64 - (unsigned int) r;
+}
+#define HAS_FLS_U64
 #endif
 
 #ifndef HAS_FLS_U64
@@ -545,6 +938,11 @@ unsigned int fls_u32(uint32_t x)
 }
 #endif
 
+unsigned long cds_lfht_bit_reverse_ulong(unsigned long v)
+{
+	return bit_reverse_ulong(v);
+}
+
 unsigned int cds_lfht_fls_ulong(unsigned long x)
 {
 #if (CAA_BITS_PER_LONG == 32)
@@ -660,7 +1058,7 @@ void alloc_split_items_count(struct cds_lfht *ht)
 	assert(split_count_mask >= 0);
 
 	if (ht->flags & CDS_LFHT_ACCOUNTING) {
-		ht->split_count = calloc(split_count_mask + 1,
+		ht->split_count = urcu_calloc(split_count_mask + 1,
 					sizeof(struct ht_items_count));
 		assert(ht->split_count);
 	} else {
@@ -687,33 +1085,46 @@ int ht_get_split_count_index(unsigned long hash)
 		return cpu & split_count_mask;
 }
 
+/*
+ * Account for "nr" node additions. Adding more than one node at once
+ * (bulk add) may cross more than one commit boundary of the split
+ * counter, and may cross a power of 2 of the global counter without
+ * hitting it exactly. The counters only drive the resize heuristic, so
+ * they are updated with relaxed atomics.
+ */
 static
-void ht_count_add(struct cds_lfht *ht, unsigned long size, unsigned long hash)
+void ht_count_add(struct cds_lfht *ht, unsigned long size, unsigned long hash,
+		unsigned long nr)
 {
-	unsigned long split_count;
+	unsigned long split_count, nr_commit;
 	int index;
-	long count;
+	long count, old_count;
 
 	if (caa_unlikely(!ht->split_count))
 		return;
 	index = ht_get_split_count_index(hash);
-	split_count = uatomic_add_return(&ht->split_count[index].add, 1);
-	if (caa_likely(split_count & ((1UL << COUNT_COMMIT_ORDER) - 1)))
+	split_count = uatomic_add_return_mo(&ht->split_count[index].add, nr,
+			CMM_RELAXED);
+	nr_commit = (split_count >> COUNT_COMMIT_ORDER)
+		- ((split_count - nr) >> COUNT_COMMIT_ORDER);
+	if (caa_likely(!nr_commit))
 		return;
-	/* Only if number of add multiple of 1UL << COUNT_COMMIT_ORDER */
+	/* Only if number of add crossed a multiple of 1UL << COUNT_COMMIT_ORDER */
 
 	dbg_printf("add split count %lu\n", split_count);
-	count = uatomic_add_return(&ht->count,
-				   1UL << COUNT_COMMIT_ORDER);
-	if (caa_likely(count & (count - 1)))
+	count = uatomic_add_return_mo(&ht->count,
+				   nr_commit << COUNT_COMMIT_ORDER, CMM_RELAXED);
+	old_count = count - (nr_commit << COUNT_COMMIT_ORDER);
+	if (caa_likely(cds_lfht_fls_ulong(count)
+			== cds_lfht_fls_ulong(old_count)))
 		return;
-	/* Only if global count is power of 2 */
+	/* Only if global count reached or crossed a power of 2 */
 
-	if ((count >> CHAIN_LEN_RESIZE_THRESHOLD) < size)
+	if ((count >> ht->resize_policy.grow_load_order) < size)
 		return;
 	dbg_printf("add set global %ld\n", count);
 	cds_lfht_resize_lazy_count(ht, size,
-		count >> (CHAIN_LEN_TARGET - 1));
+		count >> ht->resize_policy.target_load_order);
 }
 
 static
@@ -726,19 +1137,20 @@ void ht_count_del(struct cds_lfht *ht, unsigned long size, unsigned long hash)
 	if (caa_unlikely(!ht->split_count))
 		return;
 	index = ht_get_split_count_index(hash);
-	split_count = uatomic_add_return(&ht->split_count[index].del, 1);
+	split_count = uatomic_add_return_mo(&ht->split_count[index].del, 1,
+			CMM_RELAXED);
 	if (caa_likely(split_count & ((1UL << COUNT_COMMIT_ORDER) - 1)))
 		return;
 	/* Only if number of deletes multiple of 1UL << COUNT_COMMIT_ORDER */
 
 	dbg_printf("del split count %lu\n", split_count);
-	count = uatomic_add_return(&ht->count,
-				   -(1UL << COUNT_COMMIT_ORDER));
+	count = uatomic_add_return_mo(&ht->count,
+				   -(1UL << COUNT_COMMIT_ORDER), CMM_RELAXED);
 	if (caa_likely(count & (count - 1)))
 		return;
 	/* Only if global count is power of 2 */
 
-	if ((count >> CHAIN_LEN_RESIZE_THRESHOLD) >= size)
+	if ((count >> ht->resize_policy.shrink_load_order) >= size)
 		return;
 	dbg_printf("del set global %ld\n", count);
 	/*
@@ -748,7 +1160,7 @@ void ht_count_del(struct cds_lfht *ht, unsigned long size, unsigned long hash)
 	if (count < (1UL << COUNT_COMMIT_ORDER) * (split_count_mask + 1))
 		return;
 	cds_lfht_resize_lazy_count(ht, size,
-		count >> (CHAIN_LEN_TARGET - 1));
+		count >> ht->resize_policy.target_load_order);
 }
 
 static
@@ -768,7 +1180,7 @@ void check_resize(struct cds_lfht *ht, unsigned long size, uint32_t chain_len)
 	if (chain_len > 100)
 		dbg_printf("WARNING: large chain length: %u.\n",
 			   chain_len);
-	if (chain_len >= CHAIN_LEN_RESIZE_THRESHOLD) {
+	if (chain_len >= ht->resize_policy.chain_len_threshold) {
 		int growth;
 
 		/*
@@ -898,13 +1310,123 @@ struct cds_lfht_node *lookup_bucket(struct cds_lfht *ht, unsigned long size,
 	return bucket_at(ht, hash & (size - 1));
 }
 
+/*
+ * Reverse hash of a (flag-cleared) node of the chains. With a node hash
+ * function, only bucket nodes store theirs: a node is a bucket node if
+ * its own next pointer has BUCKET_FLAG set.
+ */
+static inline
+unsigned long node_reverse_hash(struct cds_lfht *ht,
+		struct cds_lfht_node *node)
+{
+	if (caa_likely(!ht->node_hash)
+	    || is_bucket(CMM_LOAD_SHARED(node->next)))
+		return node->reverse_hash;
+	return bit_reverse_ulong(ht->node_hash(node, ht->node_hash_priv));
+}
+
+/* Store the reverse hash of a node being added, unless it has none. */
+static inline
+void node_set_reverse_hash(struct cds_lfht *ht, struct cds_lfht_node *node,
+		unsigned long hash)
+{
+	if (caa_likely(!ht->node_hash))
+		node->reverse_hash = bit_reverse_ulong(hash);
+}
+
+/* Returns 0 if the filter of the table, if any, excludes @hash. */
+static inline
+int lfht_filter_may_contain(struct cds_lfht *ht, unsigned long hash)
+{
+	struct lfht_filter *filter = rcu_dereference(ht->filter);
+
+	return caa_likely(!filter) || lfht_filter_test(filter, hash);
+}
+
+/*
+ * Set the filter bits of a node being added, before linking it, in the
+ * filter being rebuilt as well.
+ */
+static inline
+void lfht_filter_add(struct cds_lfht *ht, unsigned long hash)
+{
+	struct lfht_filter *filter;
+
+	filter = rcu_dereference(ht->filter);
+	if (caa_unlikely(filter))
+		lfht_filter_set(filter, hash);
+	filter = rcu_dereference(ht->filter_next);
+	if (caa_unlikely(filter))
+		lfht_filter_set(filter, hash);
+}
+
+/*
+ * Change log: a ring of changes per CPU, each protected by a mutex
+ * only taken by the updaters running on that CPU, and by the consumer
+ * draining it. A full ring drops the change and sets the overflow flag
+ * instead of blocking the updater.
+ */
+struct lfht_changelog_cpu {
+	pthread_mutex_t lock;
+	unsigned long head, tail;	/* Free running. */
+	struct cds_lfht_change *changes;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct lfht_changelog {
+	unsigned long capacity;		/* Per CPU, power of 2. */
+	unsigned int nr_cpus;
+	unsigned int next_cpu;		/* First CPU of the next drain. */
+	int overflow;
+	struct lfht_changelog_cpu *cpus;
+};
+
+static
+void __changelog_append(struct lfht_changelog *log,
+		enum cds_lfht_change_type type, unsigned long hash,
+		struct cds_lfht_node *node)
+{
+	struct lfht_changelog_cpu *lc;
+	struct cds_lfht_change *change;
+	int cpu;
+
+	cpu = urcu_sched_getcpu();
+	if (caa_unlikely(cpu < 0))
+		cpu = hash;
+	lc = &log->cpus[(unsigned int) cpu % log->nr_cpus];
+	mutex_lock(&lc->lock);
+	if (caa_unlikely(lc->head - lc->tail == log->capacity)) {
+		mutex_unlock(&lc->lock);
+		if (!CMM_LOAD_SHARED(log->overflow))
+			uatomic_set(&log->overflow, 1);
+		return;
+	}
+	change = &lc->changes[lc->head++ & (log->capacity - 1)];
+	change->node = node;
+	change->hash = hash;
+	change->type = type;
+	mutex_unlock(&lc->lock);
+}
+
+/* Log a successful update, if the table has a change log. */
+static inline
+void changelog_append(struct cds_lfht *ht, enum cds_lfht_change_type type,
+		unsigned long hash, struct cds_lfht_node *node)
+{
+	struct lfht_changelog *log = rcu_dereference(ht->changelog);
+
+	if (caa_unlikely(log))
+		__changelog_append(log, type, hash, node);
+}
+
 /*
  * Remove all logically deleted nodes from a bucket up to a certain node key.
  */
 static
-void _cds_lfht_gc_bucket(struct cds_lfht_node *bucket, struct cds_lfht_node *node)
+void _cds_lfht_gc_bucket(struct cds_lfht *ht, struct cds_lfht_node *bucket,
+		struct cds_lfht_node *node)
 {
 	struct cds_lfht_node *iter_prev, *iter, *next, *new_next;
+	unsigned long reverse_hash;
 
 	assert(!is_bucket(bucket));
 	assert(!is_removed(bucket));
@@ -912,13 +1434,14 @@ void _cds_lfht_gc_bucket(struct cds_lfht_node *bucket, struct cds_lfht_node *nod
 	assert(!is_bucket(node));
 	assert(!is_removed(node));
 	assert(!is_removal_owner(node));
+	reverse_hash = node_reverse_hash(ht, node);
 	for (;;) {
 		iter_prev = bucket;
 		/* We can always skip the bucket node initially */
 		iter = rcu_dereference(iter_prev->next);
 		assert(!is_removed(iter));
 		assert(!is_removal_owner(iter));
-		assert(iter_prev->reverse_hash <= node->reverse_hash);
+		assert(iter_prev->reverse_hash <= reverse_hash);
 		/*
 		 * We should never be called with bucket (start of chain)
 		 * and logically removed node (end of path compression
@@ -929,24 +1452,45 @@ void _cds_lfht_gc_bucket(struct cds_lfht_node *bucket, struct cds_lfht_node *nod
 		for (;;) {
 			if (caa_unlikely(is_end(iter)))
 				return;
-			if (caa_likely(clear_flag(iter)->reverse_hash > node->reverse_hash))
+			if (caa_likely(node_reverse_hash(ht, clear_flag(iter))
+					> reverse_hash))
 				return;
 			next = rcu_dereference(clear_flag(iter)->next);
-			if (caa_likely(is_removed(next)))
-				break;
-			iter_prev = clear_flag(iter);
+			if (caa_likely(is_removed(next))) {
+				assert(!is_removed(iter));
+				assert(!is_removal_owner(iter));
+				if (is_bucket(iter))
+					new_next = flag_bucket(clear_flag(next));
+				else
+					new_next = clear_flag(next);
+				next = uatomic_cmpxchg(&iter_prev->next, iter,
+						new_next);
+				if (next == iter)
+					next = new_next;
+				/* Resume from iter_prev unless it was removed. */
+				if (is_removed(next))
+					break;
+			} else {
+				iter_prev = clear_flag(iter);
+			}
 			iter = next;
 		}
-		assert(!is_removed(iter));
-		assert(!is_removal_owner(iter));
-		if (is_bucket(iter))
-			new_next = flag_bucket(clear_flag(next));
-		else
-			new_next = clear_flag(next);
-		(void) uatomic_cmpxchg(&iter_prev->next, iter, new_next);
 	}
 }
 
+/*
+ * Empty the lookup caches of the table before a removal or replacement,
+ * if it has any. Called within a read-side critical section, which
+ * cds_lfht_lookup_cache_create() waits for after counting its cache,
+ * so that no removal it can cache a node of goes unnoticed.
+ */
+static inline
+void lookup_caches_invalidate(struct cds_lfht *ht)
+{
+	if (caa_unlikely(CMM_LOAD_SHARED(ht->nr_lookup_caches)))
+		uatomic_inc(&ht->generation);
+}
+
 static
 int _cds_lfht_replace(struct cds_lfht *ht, unsigned long size,
 		struct cds_lfht_node *old_node,
@@ -965,6 +1509,7 @@ int _cds_lfht_replace(struct cds_lfht *ht, unsigned long size,
 	assert(!is_removal_owner(new_node));
 	assert(!is_bucket(new_node));
 	assert(new_node != old_node);
+	lookup_caches_invalidate(ht);
 	for (;;) {
 		/* Insert after node to be replaced */
 		if (is_removed(old_next)) {
@@ -1010,16 +1555,74 @@ int _cds_lfht_replace(struct cds_lfht *ht, unsigned long size,
 	 * lookup for the node, and remove it (along with any other
 	 * logically removed node) if found.
 	 */
-	bucket = lookup_bucket(ht, size, bit_reverse_ulong(old_node->reverse_hash));
-	_cds_lfht_gc_bucket(bucket, new_node);
+	bucket = lookup_bucket(ht, size,
+			bit_reverse_ulong(node_reverse_hash(ht, old_node)));
+	_cds_lfht_gc_bucket(ht, bucket, new_node);
 
 	assert(is_removed(CMM_LOAD_SHARED(old_node->next)));
 	return 0;
 }
 
+/*
+ * Get the next node matching key after iter, given the reverse hash of
+ * iter->node: _cds_lfht_add() starts from nodes not linked yet, whose
+ * hash the node hash function cannot provide.
+ */
+static
+void _cds_lfht_next_duplicate(struct cds_lfht *ht, cds_lfht_match_fct match,
+		const void *key, unsigned long reverse_hash,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *node, *next;
+
+	next = iter->next;
+	node = clear_flag(next);
+
+	for (;;) {
+		if (caa_unlikely(is_end(node))) {
+			node = next = NULL;
+			break;
+		}
+		if (caa_unlikely(node_reverse_hash(ht, node) > reverse_hash)) {
+			node = next = NULL;
+			break;
+		}
+		next = rcu_dereference(node->next);
+		_cds_lfht_prefetch_next(next);
+		if (caa_likely(!is_removed(next))
+		    && !is_bucket(next)
+		    && (!match || caa_likely(match(node, key)))) {
+				break;
+		}
+		node = clear_flag(next);
+	}
+	assert(!node || !is_bucket(CMM_LOAD_SHARED(node->next)));
+	iter->node = node;
+	iter->next = next;
+}
+
+/*
+ * Node constructed by _cds_lfht_add() on reaching its insert location,
+ * for cds_lfht_lookup_or_add().
+ */
+struct lfht_add_ctor {
+	struct cds_lfht_node *(*ctor_fct)(const void *key, void *priv);
+	void *priv;
+	struct cds_lfht_node *node;	/* Constructed node, or NULL. */
+};
+
 /*
  * A non-NULL unique_ret pointer uses the "add unique" (or uniquify) add
  * mode. A NULL unique_ret allows creation of duplicate keys.
+ * A non-NULL max_chain_len pointer defers the resize check to the
+ * caller: the longest chain length observed is recorded instead.
+ * A non-NULL ctor, in add unique mode, replaces @node, which then only
+ * provides the reverse hash, by the node ctor constructs when no node
+ * matches @key. unique_ret->node is NULL if construction fails.
+ * A non-NULL hint, in duplicate add mode, starts the walk from the hint
+ * node if it lies between the bucket and the insert location in
+ * split-order, and is not removed: chains are then only measured from
+ * there by the resize check.
  */
 static
 void _cds_lfht_add(struct cds_lfht *ht,
@@ -1029,16 +1632,33 @@ void _cds_lfht_add(struct cds_lfht *ht,
 		unsigned long size,
 		struct cds_lfht_node *node,
 		struct cds_lfht_iter *unique_ret,
-		int bucket_flag)
+		int bucket_flag,
+		uint32_t *max_chain_len,
+		struct lfht_add_ctor *ctor,
+		struct cds_lfht_node *hint)
 {
 	struct cds_lfht_node *iter_prev, *iter, *next, *new_node, *new_next,
 			*return_node;
-	struct cds_lfht_node *bucket;
+	struct cds_lfht_node *bucket, *start;
+	unsigned long reverse_hash, iter_hash, prev_hash, start_hash;
 
 	assert(!is_bucket(node));
 	assert(!is_removed(node));
 	assert(!is_removal_owner(node));
+	/* The hash of node, which may not store it. */
+	reverse_hash = bit_reverse_ulong(hash);
+	if (!bucket_flag)
+		lfht_filter_add(ht, hash);
 	bucket = lookup_bucket(ht, size, hash);
+	start = bucket;
+	start_hash = bucket->reverse_hash;
+	if (hint && !unique_ret && !bucket_flag) {
+		iter_hash = node_reverse_hash(ht, hint);
+		if (iter_hash >= start_hash && iter_hash <= reverse_hash) {
+			start = hint;
+			start_hash = iter_hash;
+		}
+	}
 	for (;;) {
 		uint32_t chain_len = 0;
 
@@ -1046,18 +1666,26 @@ void _cds_lfht_add(struct cds_lfht *ht,
 		 * iter_prev points to the non-removed node prior to the
 		 * insert location.
 		 */
-		iter_prev = bucket;
-		/* We can always skip the bucket node initially */
+		iter_prev = start;
+		prev_hash = start_hash;
+		/* We can always skip the start node initially */
 		iter = rcu_dereference(iter_prev->next);
-		assert(iter_prev->reverse_hash <= node->reverse_hash);
+		if (caa_unlikely(is_removed(iter))) {
+			/* Removed hint: walk from the bucket. */
+			start = bucket;
+			start_hash = bucket->reverse_hash;
+			continue;
+		}
+		assert(prev_hash <= reverse_hash);
 		for (;;) {
 			if (caa_unlikely(is_end(iter)))
 				goto insert;
-			if (caa_likely(clear_flag(iter)->reverse_hash > node->reverse_hash))
+			iter_hash = node_reverse_hash(ht, clear_flag(iter));
+			if (caa_likely(iter_hash > reverse_hash))
 				goto insert;
 
 			/* bucket node is the first node of the identical-hash-value chain */
-			if (bucket_flag && clear_flag(iter)->reverse_hash == node->reverse_hash)
+			if (bucket_flag && iter_hash == reverse_hash)
 				goto insert;
 
 			next = rcu_dereference(clear_flag(iter)->next);
@@ -1067,7 +1695,7 @@ void _cds_lfht_add(struct cds_lfht *ht,
 			/* uniquely add */
 			if (unique_ret
 			    && !is_bucket(next)
-			    && clear_flag(iter)->reverse_hash == node->reverse_hash) {
+			    && iter_hash == reverse_hash) {
 				struct cds_lfht_iter d_iter = { .node = node, .next = iter, };
 
 				/*
@@ -1079,7 +1707,8 @@ void _cds_lfht_add(struct cds_lfht *ht,
 				 * (including traversing the table node by
 				 * node by forward iterations)
 				 */
-				cds_lfht_next_duplicate(ht, match, key, &d_iter);
+				_cds_lfht_next_duplicate(ht, match, key,
+						reverse_hash, &d_iter);
 				if (!d_iter.node)
 					goto insert;
 
@@ -1088,45 +1717,75 @@ void _cds_lfht_add(struct cds_lfht *ht,
 			}
 
 			/* Only account for identical reverse hash once */
-			if (iter_prev->reverse_hash != clear_flag(iter)->reverse_hash
-			    && !is_bucket(next))
-				check_resize(ht, size, ++chain_len);
+			if (prev_hash != iter_hash
+			    && !is_bucket(next)) {
+				chain_len++;
+				if (!max_chain_len)
+					check_resize(ht, size, chain_len);
+				else if (chain_len > *max_chain_len)
+					*max_chain_len = chain_len;
+			}
 			iter_prev = clear_flag(iter);
+			prev_hash = iter_hash;
 			iter = next;
-		}
+			continue;
+
+		insert:
+			if (ctor && !ctor->node) {
+				/* Constructed once, kept if the cmpxchg fails. */
+				ctor->node = ctor->ctor_fct(key, ctor->priv);
+				if (!ctor->node) {
+					unique_ret->node = NULL;
+					return;
+				}
+				node = ctor->node;
+				node_set_reverse_hash(ht, node, hash);
+			}
+			assert(node != clear_flag(iter));
+			assert(!is_removed(iter_prev));
+			assert(!is_removal_owner(iter_prev));
+			assert(!is_removed(iter));
+			assert(!is_removal_owner(iter));
+			assert(iter_prev != node);
+			if (!bucket_flag)
+				node->next = clear_flag(iter);
+			else
+				node->next = flag_bucket(clear_flag(iter));
+			if (is_bucket(iter))
+				new_node = flag_bucket(node);
+			else
+				new_node = node;
+			next = uatomic_cmpxchg(&iter_prev->next, iter, new_node);
+			if (next == iter) {
+				return_node = node;
+				goto end;
+			}
+			goto resume;
 
-	insert:
-		assert(node != clear_flag(iter));
-		assert(!is_removed(iter_prev));
-		assert(!is_removal_owner(iter_prev));
-		assert(!is_removed(iter));
-		assert(!is_removal_owner(iter));
-		assert(iter_prev != node);
-		if (!bucket_flag)
-			node->next = clear_flag(iter);
-		else
-			node->next = flag_bucket(clear_flag(iter));
-		if (is_bucket(iter))
-			new_node = flag_bucket(node);
-		else
-			new_node = node;
-		if (uatomic_cmpxchg(&iter_prev->next, iter,
-				    new_node) != iter) {
-			continue;	/* retry */
-		} else {
-			return_node = node;
-			goto end;
-		}
+		gc_node:
+			assert(!is_removed(iter));
+			assert(!is_removal_owner(iter));
+			if (is_bucket(iter))
+				new_next = flag_bucket(clear_flag(next));
+			else
+				new_next = clear_flag(next);
+			next = uatomic_cmpxchg(&iter_prev->next, iter, new_next);
+			if (next == iter)
+				next = new_next;
 
-	gc_node:
-		assert(!is_removed(iter));
-		assert(!is_removal_owner(iter));
-		if (is_bucket(iter))
-			new_next = flag_bucket(clear_flag(next));
-		else
-			new_next = clear_flag(next);
-		(void) uatomic_cmpxchg(&iter_prev->next, iter, new_next);
-		/* retry */
+		resume:
+			/*
+			 * iter_prev->next changed under us: resume the walk from
+			 * iter_prev, which still precedes the insert location,
+			 * rather than from the bucket, unless it was removed.
+			 */
+			if (is_removed(next)) {
+				start = bucket;
+				start_hash = bucket->reverse_hash;
+				break;	/* retry */
+			}
+			iter = next;
+		}
 	}
 end:
 	if (unique_ret) {
@@ -1163,6 +1822,7 @@ int _cds_lfht_del(struct cds_lfht *ht, unsigned long size,
 	 * The del operation semantic guarantees a full memory barrier
 	 * before the uatomic_or atomic commit of the deletion flag.
 	 */
+	lookup_caches_invalidate(ht);
 	cmm_smp_mb__before_uatomic_or();
 	/*
 	 * We set the REMOVED_FLAG unconditionally. Note that there may
@@ -1178,8 +1838,9 @@ int _cds_lfht_del(struct cds_lfht *ht, unsigned long size,
 	 * the node, and remove it (along with any other logically removed node)
 	 * if found.
 	 */
-	bucket = lookup_bucket(ht, size, bit_reverse_ulong(node->reverse_hash));
-	_cds_lfht_gc_bucket(bucket, node);
+	bucket = lookup_bucket(ht, size,
+			bit_reverse_ulong(node_reverse_hash(ht, node)));
+	_cds_lfht_gc_bucket(ht, bucket, node);
 
 	assert(is_removed(CMM_LOAD_SHARED(node->next)));
 	/*
@@ -1206,40 +1867,108 @@ void *partition_resize_thread(void *arg)
 {
 	struct partition_resize_work *work = arg;
 
-	work->ht->flavor->register_thread();
-	work->fct(work->ht, work->i, work->start, work->len);
-	work->ht->flavor->unregister_thread();
+	flavor_register_thread(work->ht);
+	work->fct(work->ht, work->i, work->start, work->len, work->priv);
+	flavor_unregister_thread(work->ht);
 	return NULL;
 }
 
 static
-void partition_resize_helper(struct cds_lfht *ht, unsigned long i,
-		unsigned long len,
-		void (*fct)(struct cds_lfht *ht, unsigned long i,
-			unsigned long start, unsigned long len))
+void partition_chunk(unsigned long chunk, void *priv)
 {
-	unsigned long partition_len, start = 0;
-	struct partition_resize_work *work;
-	int thread, ret;
-	unsigned long nr_threads;
+	struct partition_resize_work *work =
+		&((struct partition_resize_work *) priv)[chunk];
+
+	if (!URCU_TLS(cds_lfht_partition_worker)) {
+		/* The caller, registered, online again for its chunk. */
+		if (work->caller_online)
+			flavor_thread_online(work->ht);
+		work->fct(work->ht, work->i, work->start, work->len,
+			work->priv);
+		if (work->caller_online)
+			flavor_thread_offline(work->ht);
+		return;
+	}
+	(void) partition_resize_thread(work);
+}
 
-	assert(nr_cpus_mask != -1);
-	if (nr_cpus_mask < 0 || len < 2 * MIN_PARTITION_PER_THREAD)
-		goto fallback;
+static void cds_lfht_partition_worker_init(struct urcu_workqueue *workqueue,
+		void *priv);
 
-	/*
-	 * Note: nr_cpus_mask + 1 is always power of 2.
-	 * We spawn just the number of threads we need to satisfy the minimum
-	 * partition size, up to the number of CPUs in the system.
-	 */
-	if (nr_cpus_mask > 0) {
-		nr_threads = min(nr_cpus_mask + 1,
-				 len >> MIN_PARTITION_PER_THREAD_ORDER);
+/*
+ * Get the partition workers, creating them on first use. Returns NULL
+ * while fork handlers run, or without more than one CPU.
+ */
+static
+struct urcu_workqueue *partition_workqueue_get(void)
+{
+	struct urcu_workqueue *workqueue;
+
+	workqueue = CMM_LOAD_SHARED(cds_lfht_partition_workqueue);
+	if (caa_likely(workqueue) || nr_cpus_mask < 1)
+		return workqueue;
+	/* The resize worker may run this while fork handlers pause it. */
+	if (pthread_mutex_trylock(&cds_lfht_fork_mutex))
+		return NULL;
+	workqueue = cds_lfht_partition_workqueue;
+	if (!workqueue && cds_lfht_workqueue_user_count) {
+		/* The caller executes partitions too. */
+		workqueue = urcu_workqueue_create_pool(nr_cpus_mask, 0, -1,
+			NULL, NULL, cds_lfht_partition_worker_init, NULL,
+			NULL, NULL, NULL, NULL);
+		urcu_workqueue_set_batch(workqueue, 0, 0);
+		CMM_STORE_SHARED(cds_lfht_partition_workqueue, workqueue);
+	}
+	mutex_unlock(&cds_lfht_fork_mutex);
+	return workqueue;
+}
+
+/*
+ * Start of partition thread out of nr_threads: len * thread / nr_threads,
+ * computed without overflowing. The remainder of len is spread across
+ * the partitions, which differ by one bucket at most.
+ */
+static
+unsigned long partition_start(unsigned long len, unsigned long thread,
+		unsigned long nr_threads)
+{
+	return (len / nr_threads) * thread
+		+ (len % nr_threads) * thread / nr_threads;
+}
+
+/*
+ * A nr_threads of 0 spawns just the number of threads needed to satisfy
+ * the minimum partition size, up to the number of CPUs in the system.
+ */
+static
+void partition_helper(struct cds_lfht *ht, unsigned long i,
+		unsigned long len, unsigned long nr_threads, void *priv,
+		void (*fct)(struct cds_lfht *ht, unsigned long i,
+			unsigned long start, unsigned long len, void *priv))
+{
+	unsigned long start = 0;
+	struct partition_resize_work *work;
+	struct urcu_workqueue *workqueue;
+	int thread, ret, was_online;
+
+	if (!nr_threads) {
+		assert(nr_cpus_mask != -1);
+		if (nr_cpus_mask < 0 || len < 2 * MIN_PARTITION_PER_THREAD)
+			goto fallback;
+
+		/* Note: nr_cpus_mask + 1 is always power of 2. */
+		if (nr_cpus_mask > 0) {
+			nr_threads = min(nr_cpus_mask + 1,
+					 len >> MIN_PARTITION_PER_THREAD_ORDER);
+		} else {
+			nr_threads = 1;
+		}
 	} else {
-		nr_threads = 1;
+		nr_threads = min(nr_threads, len);
+		if (nr_threads < 2)
+			goto fallback;
 	}
-	partition_len = len >> cds_lfht_get_count_order_ulong(nr_threads);
-	work = calloc(nr_threads, sizeof(*work));
+	work = urcu_calloc(nr_threads, sizeof(*work));
 	if (!work) {
 		dbg_printf("error allocating for resize, single-threading\n");
 		goto fallback;
@@ -1247,9 +1976,36 @@ void partition_resize_helper(struct cds_lfht *ht, unsigned long i,
 	for (thread = 0; thread < nr_threads; thread++) {
 		work[thread].ht = ht;
 		work[thread].i = i;
-		work[thread].len = partition_len;
-		work[thread].start = thread * partition_len;
+		work[thread].start = partition_start(len, thread, nr_threads);
+		work[thread].len = partition_start(len, thread + 1, nr_threads)
+			- work[thread].start;
+		work[thread].priv = priv;
 		work[thread].fct = fct;
+	}
+	/*
+	 * The caller waits for the partition threads offline: with QSBR,
+	 * an online caller would hold off grace periods for the whole
+	 * pass, whatever quiescent states the partition threads report.
+	 */
+	was_online = flavor_read_ongoing(ht);
+	/*
+	 * Tables with resize thread attributes keep spawning threads
+	 * with them.
+	 */
+	workqueue = ht->resize_attr ? NULL : partition_workqueue_get();
+	if (workqueue) {
+		for (thread = 0; thread < nr_threads; thread++)
+			work[thread].caller_online = was_online;
+		if (was_online)
+			flavor_thread_offline(ht);
+		urcu_workqueue_parallel_for(workqueue, nr_threads,
+			partition_chunk, work);
+		if (was_online)
+			flavor_thread_online(ht);
+		urcu_free(work);
+		return;
+	}
+	for (thread = 0; thread < nr_threads; thread++) {
 		ret = pthread_create(&(work[thread].thread_id), ht->resize_attr,
 			partition_resize_thread, &work[thread]);
 		if (ret == EAGAIN) {
@@ -1265,11 +2021,15 @@ void partition_resize_helper(struct cds_lfht *ht, unsigned long i,
 		}
 		assert(!ret);
 	}
+	if (was_online)
+		flavor_thread_offline(ht);
 	for (thread = 0; thread < nr_threads; thread++) {
 		ret = pthread_join(work[thread].thread_id, NULL);
 		assert(!ret);
 	}
-	free(work);
+	if (was_online)
+		flavor_thread_online(ht);
+	urcu_free(work);
 
 	/*
 	 * A pthread_create failure above will either lead in us having
@@ -1279,7 +2039,80 @@ void partition_resize_helper(struct cds_lfht *ht, unsigned long i,
 	if (start == 0 && nr_threads > 0)
 		return;
 fallback:
-	fct(ht, i, start, len);
+	fct(ht, i, start, len, priv);
+}
+
+static
+void partition_resize_helper(struct cds_lfht *ht, unsigned long i,
+		unsigned long len, void *priv,
+		void (*fct)(struct cds_lfht *ht, unsigned long i,
+			unsigned long start, unsigned long len, void *priv))
+{
+	partition_helper(ht, i, len, 0, priv, fct);
+}
+
+static
+unsigned long resize_time_ms(void)
+{
+	return urcu_time_ns() / 1000000;
+}
+
+static
+unsigned long resize_time_us(void)
+{
+	return urcu_time_ns() / 1000;
+}
+
+/*
+ * Resize passes check their read-side critical section length after
+ * each chunk of RESIZE_QS_CHUNK bucket nodes: once the
+ * resize latency budget of the table has elapsed since the pass last
+ * reported a quiescent state, the pass leaves its critical section and
+ * reports one, so that a resize of a large table does not hold off
+ * grace periods. This matters most with QSBR, whose read-side lock is
+ * a no-op: the resize threads are online readers, which otherwise
+ * report no quiescent state for the whole pass. Without a monotonic
+ * clock, a quiescent state is reported after each chunk.
+ *
+ * Only passes performed outside of the caller read-side critical
+ * sections report quiescent states: not the populate steps of the
+ * incremental resize performed by updaters.
+ */
+#define RESIZE_QS_CHUNK			256UL
+#define RESIZE_LATENCY_US_DEFAULT	1000UL
+
+struct resize_qs {
+	unsigned long last_us;	/* Time of the last quiescent state. */
+	unsigned long count;	/* Bucket nodes since the last check. */
+};
+
+static
+void resize_qs_init(struct resize_qs *qs)
+{
+	qs->last_us = resize_time_us();
+	qs->count = 0;
+}
+
+/* Called within read-side critical section, after each bucket node. */
+static
+void resize_qs_check(struct cds_lfht *ht, struct resize_qs *qs)
+{
+	unsigned long now;
+
+	if (caa_likely(++qs->count < RESIZE_QS_CHUNK))
+		return;
+	qs->count = 0;
+	now = resize_time_us();
+	if (now - qs->last_us < CMM_LOAD_SHARED(ht->resize_latency_us))
+		return;
+	qs->last_us = now;
+	flavor_read_unlock(ht);
+	/* QSBR: going offline and back online reports a quiescent state. */
+	if (flavor_read_ongoing(ht)) {
+		flavor_thread_offline(ht);
+		flavor_thread_online(ht);
+	}
+	flavor_read_lock(ht);
 }
 
 /*
@@ -1294,13 +2127,14 @@ fallback:
  * schedule bucket node population fairly with insertions.
  */
 static
-void init_table_populate_partition(struct cds_lfht *ht, unsigned long i,
-				   unsigned long start, unsigned long len)
+void init_table_populate_range(struct cds_lfht *ht, unsigned long i,
+			       unsigned long start, unsigned long len,
+			       struct resize_qs *qs)
 {
 	unsigned long j, size = 1UL << (i - 1);
 
 	assert(i > MIN_TABLE_ORDER);
-	ht->flavor->read_lock();
+	flavor_read_lock(ht);
 	for (j = size + start; j < size + start + len; j++) {
 		struct cds_lfht_node *new_node = bucket_at(ht, j);
 
@@ -1308,16 +2142,31 @@ void init_table_populate_partition(struct cds_lfht *ht, unsigned long i,
 		dbg_printf("init populate: order %lu index %lu hash %lu\n",
 			   i, j, j);
 		new_node->reverse_hash = bit_reverse_ulong(j);
-		_cds_lfht_add(ht, j, NULL, NULL, size, new_node, NULL, 1);
+		_cds_lfht_add(ht, j, NULL, NULL, size, new_node, NULL, 1, NULL,
+				NULL, NULL);
+		if (qs)
+			resize_qs_check(ht, qs);
 	}
-	ht->flavor->read_unlock();
+	flavor_read_unlock(ht);
+	uatomic_add(&ht->resize_nr_buckets, len);
+}
+
+static
+void init_table_populate_partition(struct cds_lfht *ht, unsigned long i,
+				   unsigned long start, unsigned long len,
+				   void *priv)
+{
+	struct resize_qs qs;
+
+	resize_qs_init(&qs);
+	init_table_populate_range(ht, i, start, len, &qs);
 }
 
 static
 void init_table_populate(struct cds_lfht *ht, unsigned long i,
 			 unsigned long len)
 {
-	partition_resize_helper(ht, i, len, init_table_populate_partition);
+	partition_resize_helper(ht, i, len, NULL, init_table_populate_partition);
 }
 
 static
@@ -1359,6 +2208,114 @@ void init_table(struct cds_lfht *ht,
 	}
 }
 
+static
+void resize_record_time(struct cds_lfht *ht)
+{
+	if (ht->resize_policy.min_interval_ms)
+		CMM_STORE_SHARED(ht->last_resize_ms, resize_time_ms());
+}
+
+/*
+ * Return nonzero if an automatic resize should not be initiated yet,
+ * because the previous resize ended less than the policy minimum
+ * interval ago.
+ */
+static
+int resize_too_early(struct cds_lfht *ht)
+{
+	unsigned long interval = ht->resize_policy.min_interval_ms;
+
+	if (caa_likely(!interval))
+		return 0;
+	return resize_time_ms() - CMM_LOAD_SHARED(ht->last_resize_ms)
+		< interval;
+}
+
+static
+int bucket_free_pending(struct cds_lfht *ht);
+
+/*
+ * Incremental resize: with CDS_LFHT_INCREMENTAL_RESIZE, table growth is
+ * not performed by the resize worker, but by the updaters, each of them
+ * populating at most INCREMENTAL_RESIZE_STEP bucket nodes of the order
+ * being initialized after its update. The table size is published once
+ * all bucket nodes of an order are populated. Shrinking is still
+ * performed by the resize worker, because it needs to wait for grace
+ * periods.
+ *
+ * Called with resize mutex held. Populates at most "budget" bucket
+ * nodes, reporting quiescent states if "qs" is non-NULL.
+ */
+static
+void incremental_resize_step(struct cds_lfht *ht, unsigned long budget,
+		struct resize_qs *qs)
+{
+	unsigned long order, len, start;
+
+	order = ht->incr_resize_order;
+	if (!order) {
+		/* Stop expand if the resize target changes under us */
+		if (CMM_LOAD_SHARED(ht->resize_target) <= ht->size)
+			return;
+		if (CMM_LOAD_SHARED(ht->in_progress_destroy))
+			return;
+		/* Bucket tables freed by a shrink cannot be reused yet. */
+		if (bucket_free_pending(ht))
+			return;
+		order = cds_lfht_get_count_order_ulong(ht->size) + 1;
+		dbg_printf("incremental init order %lu\n", order);
+		cds_lfht_alloc_bucket_table(ht, order);
+		ht->incr_resize_order = order;
+		ht->incr_resize_index = 0;
+	}
+	len = 1UL << (order - 1);
+	start = ht->incr_resize_index;
+	budget = min(budget, len - start);
+	init_table_populate_range(ht, order, start, budget, qs);
+	ht->incr_resize_index = start + budget;
+	if (ht->incr_resize_index == len) {
+		cmm_smp_wmb();	/* populate data before RCU size */
+		CMM_STORE_SHARED(ht->size, 1UL << order);
+		ht->incr_resize_order = 0;
+		resize_record_time(ht);
+		dbg_printf("incremental init new size: %lu\n", 1UL << order);
+	}
+}
+
+/*
+ * Complete the order partially populated by updaters, if any, so the
+ * table size reflects all the bucket nodes linked in the table.
+ * Called with resize mutex held.
+ */
+static
+void incremental_resize_finish(struct cds_lfht *ht)
+{
+	struct resize_qs qs;
+
+	if (ht->incr_resize_order) {
+		resize_qs_init(&qs);
+		incremental_resize_step(ht, ULONG_MAX, &qs);
+	}
+}
+
+/*
+ * Called by updaters within RCU read-side critical section. Only one
+ * updater helps at a time: the others, and updaters finding a resize
+ * in progress in the worker thread, do not wait for the resize mutex.
+ */
+static
+void incremental_resize_help(struct cds_lfht *ht, unsigned long size)
+{
+	if (!(ht->flags & CDS_LFHT_INCREMENTAL_RESIZE))
+		return;
+	if (caa_likely(CMM_LOAD_SHARED(ht->resize_target) <= size))
+		return;
+	if (pthread_mutex_trylock(&ht->resize_mutex))
+		return;
+	incremental_resize_step(ht, INCREMENTAL_RESIZE_STEP, NULL);
+	mutex_unlock(&ht->resize_mutex);
+}
+
 /*
  * Holding RCU read lock to protect _cds_lfht_remove against memory
  * reclaim that could be performed by other worker threads (ABA
@@ -1387,12 +2344,15 @@ void init_table(struct cds_lfht *ht,
  */
 static
 void remove_table_partition(struct cds_lfht *ht, unsigned long i,
-			    unsigned long start, unsigned long len)
+			    unsigned long start, unsigned long len,
+			    void *priv)
 {
 	unsigned long j, size = 1UL << (i - 1);
+	struct resize_qs qs;
 
 	assert(i > MIN_TABLE_ORDER);
-	ht->flavor->read_lock();
+	resize_qs_init(&qs);
+	flavor_read_lock(ht);
 	for (j = size + start; j < size + start + len; j++) {
 		struct cds_lfht_node *fini_bucket = bucket_at(ht, j);
 		struct cds_lfht_node *parent_bucket = bucket_at(ht, j - size);
@@ -1402,74 +2362,214 @@ void remove_table_partition(struct cds_lfht *ht, unsigned long i,
 			   i, j, j);
 		/* Set the REMOVED_FLAG to freeze the ->next for gc */
 		uatomic_or(&fini_bucket->next, REMOVED_FLAG);
-		_cds_lfht_gc_bucket(parent_bucket, fini_bucket);
+		_cds_lfht_gc_bucket(ht, parent_bucket, fini_bucket);
+		resize_qs_check(ht, &qs);
 	}
-	ht->flavor->read_unlock();
+	flavor_read_unlock(ht);
+	uatomic_add(&ht->resize_nr_buckets, len);
 }
 
 static
 void remove_table(struct cds_lfht *ht, unsigned long i, unsigned long len)
 {
-	partition_resize_helper(ht, i, len, remove_table_partition);
+	partition_resize_helper(ht, i, len, NULL, remove_table_partition);
 }
 
 /*
- * fini_table() is never called for first_order == 0, which is why
- * free_by_rcu_order == 0 can be used as criterion to know if free must
- * be called.
+ * Bucket tables of the orders removed by a shrink are freed by a
+ * call_rcu callback, after a grace period ensuring no reader still
+ * traverses their unlinked bucket nodes. A resize or destroy finding a
+ * free still pending either cancels the callback and frees the bucket
+ * tables itself, or waits for the running callback to complete.
+ *
+ * The state of the work decides which of the callback and the table
+ * frees the bucket tables. The work is referenced by the callback and
+ * by ht->bucket_free_work, which is only cleared under resize mutex:
+ * the last of them to drop its reference frees it. The callback only
+ * accesses the table before marking the work done, and the table waits
+ * for that before clearing its reference, so a destroy never frees the
+ * table under a running callback.
  */
+enum bucket_free_state {
+	BUCKET_FREE_PENDING = 0,
+	BUCKET_FREE_CANCELLED,
+	BUCKET_FREE_RUNNING,
+	BUCKET_FREE_DONE,
+};
+
+struct bucket_free_work {
+	struct rcu_head head;
+	struct cds_lfht *ht;
+	unsigned long first_order, last_order;
+	int state;
+	int refcount;
+};
+
+/* Bucket tables need to be freed with decreasing order. */
 static
-void fini_table(struct cds_lfht *ht,
+void free_bucket_tables(struct cds_lfht *ht,
 		unsigned long first_order, unsigned long last_order)
 {
 	long i;
-	unsigned long free_by_rcu_order = 0;
 
-	dbg_printf("fini table: first_order %lu last_order %lu\n",
-		   first_order, last_order);
-	assert(first_order > MIN_TABLE_ORDER);
-	for (i = last_order; i >= first_order; i--) {
-		unsigned long len;
+	for (i = last_order; i >= (long) first_order; i--)
+		cds_lfht_free_bucket_table(ht, i);
+}
 
-		len = 1UL << (i - 1);
-		dbg_printf("fini order %ld len: %lu\n", i, len);
+static
+void bucket_free_put(struct bucket_free_work *work)
+{
+	if (!uatomic_sub_return(&work->refcount, 1))
+		poison_free(work);
+}
 
-		/* Stop shrink if the resize target changes under us */
-		if (CMM_LOAD_SHARED(ht->resize_target) > (1UL << (i - 1)))
-			break;
+static
+void bucket_free_cb(struct rcu_head *head)
+{
+	struct bucket_free_work *work =
+		caa_container_of(head, struct bucket_free_work, head);
+
+	if (uatomic_cmpxchg(&work->state, BUCKET_FREE_PENDING,
+			BUCKET_FREE_RUNNING) == BUCKET_FREE_PENDING) {
+		free_bucket_tables(work->ht, work->first_order,
+			work->last_order);
+		cmm_smp_mb();	/* free bucket tables before marking done */
+		/* Last access to ht: it can be destroyed after this store. */
+		uatomic_set(&work->state, BUCKET_FREE_DONE);
+	}
+	bucket_free_put(work);
+}
 
-		cmm_smp_wmb();	/* populate data before RCU size */
-		CMM_STORE_SHARED(ht->size, 1UL << (i - 1));
+/* Drop the reference of the table to its work. Resize mutex held. */
+static
+void bucket_free_clear(struct cds_lfht *ht)
+{
+	struct bucket_free_work *work = ht->bucket_free_work;
 
-		/*
-		 * We need to wait for all add operations to reach Q.S. (and
-		 * thus use the new table for lookups) before we can start
-		 * releasing the old bucket nodes. Otherwise their lookup will
-		 * return a logically removed node as insert position.
-		 */
-		ht->flavor->update_synchronize_rcu();
-		if (free_by_rcu_order)
-			cds_lfht_free_bucket_table(ht, free_by_rcu_order);
+	CMM_STORE_SHARED(ht->bucket_free_work, NULL);
+	bucket_free_put(work);
+}
 
-		/*
-		 * Set "removed" flag in bucket nodes about to be removed.
-		 * Unlink all now-logically-removed bucket node pointers.
-		 * Concurrent add/remove operation are helping us doing
-		 * the gc.
-		 */
-		remove_table(ht, i, len);
+/*
+ * Return nonzero if the bucket tables of a shrink are still to be
+ * freed, forgetting the work completed by its callback. Called with
+ * resize mutex held.
+ */
+static
+int bucket_free_pending(struct cds_lfht *ht)
+{
+	struct bucket_free_work *work = ht->bucket_free_work;
 
-		free_by_rcu_order = i;
+	if (!work)
+		return 0;
+	if (uatomic_read(&work->state) != BUCKET_FREE_DONE)
+		return 1;
+	cmm_smp_mb();	/* read state before reusing bucket tables */
+	bucket_free_clear(ht);
+	return 0;
+}
 
-		dbg_printf("fini new size: %lu\n", 1UL << i);
-		if (CMM_LOAD_SHARED(ht->in_progress_destroy))
-			break;
+/*
+ * Free the bucket tables of a pending bucket free work, if any.
+ * Waits for a grace period before freeing if "sync" is set.
+ * Called with resize mutex held, or from cds_lfht_destroy.
+ */
+static
+void bucket_free_flush(struct cds_lfht *ht, int sync)
+{
+	struct bucket_free_work *work = ht->bucket_free_work;
+
+	if (!work)
+		return;
+	if (uatomic_cmpxchg(&work->state, BUCKET_FREE_PENDING,
+			BUCKET_FREE_CANCELLED) == BUCKET_FREE_PENDING) {
+		if (sync)
+			flavor_synchronize_rcu(ht);
+		free_bucket_tables(ht, work->first_order, work->last_order);
+	} else {
+		/* The callback is running or done: wait for it to complete. */
+		while (uatomic_read(&work->state) != BUCKET_FREE_DONE)
+			caa_cpu_relax();
+		cmm_smp_mb();	/* read state before reusing bucket tables */
+	}
+	bucket_free_clear(ht);
+}
+
+/* Called with resize mutex held. */
+static
+void bucket_free_defer(struct cds_lfht *ht,
+		unsigned long first_order, unsigned long last_order)
+{
+	struct bucket_free_work *work;
+
+	assert(!ht->bucket_free_work);
+	work = urcu_malloc(sizeof(*work));
+	if (!work) {
+		dbg_printf("error allocating bucket free work, freeing synchronously\n");
+		flavor_synchronize_rcu(ht);
+		free_bucket_tables(ht, first_order, last_order);
+		return;
 	}
+	work->ht = ht;
+	work->first_order = first_order;
+	work->last_order = last_order;
+	work->state = BUCKET_FREE_PENDING;
+	work->refcount = 2;	/* The table and the callback. */
+	ht->bucket_free_first_order = first_order;
+	ht->bucket_free_last_order = last_order;
+	CMM_STORE_SHARED(ht->bucket_free_work, work);
+	flavor_call_rcu(ht, &work->head, bucket_free_cb);
+}
+
+/*
+ * fini_table() is never called for first_order == 0.
+ *
+ * The table size is updated to its final value at once, so a single
+ * grace period is needed before the bucket nodes of all the removed
+ * orders are unlinked, and their bucket tables are freed after a grace
+ * period, without waiting for it.
+ */
+static
+void fini_table(struct cds_lfht *ht,
+		unsigned long first_order, unsigned long last_order)
+{
+	long i;
+
+	dbg_printf("fini table: first_order %lu last_order %lu\n",
+		   first_order, last_order);
+	assert(first_order > MIN_TABLE_ORDER);
+
+	/* Stop shrink if the resize target changes under us */
+	if (CMM_LOAD_SHARED(ht->resize_target) > (1UL << (first_order - 1)))
+		return;
+
+	cmm_smp_wmb();	/* populate data before RCU size */
+	CMM_STORE_SHARED(ht->size, 1UL << (first_order - 1));
+	dbg_printf("fini new size: %lu\n", 1UL << (first_order - 1));
 
-	if (free_by_rcu_order) {
-		ht->flavor->update_synchronize_rcu();
-		cds_lfht_free_bucket_table(ht, free_by_rcu_order);
+	/*
+	 * We need to wait for all add operations to reach Q.S. (and
+	 * thus use the new table for lookups) before we can start
+	 * releasing the old bucket nodes. Otherwise their lookup will
+	 * return a logically removed node as insert position.
+	 */
+	flavor_synchronize_rcu(ht);
+
+	/*
+	 * Set "removed" flag in bucket nodes about to be removed.
+	 * Unlink all now-logically-removed bucket node pointers.
+	 * Concurrent add/remove operation are helping us doing
+	 * the gc. Bucket nodes are removed with decreasing order, so
+	 * the parent bucket of each removed bucket is still linked. All
+	 * orders are removed even if destroy is in progress, so the
+	 * table only contains bucket nodes below its size.
+	 */
+	for (i = last_order; i >= (long) first_order; i--) {
+		dbg_printf("fini order %ld len: %lu\n", i, 1UL << (i - 1));
+		remove_table(ht, i, 1UL << (i - 1));
 	}
+
+	bucket_free_defer(ht, first_order, last_order);
 }
 
 static
@@ -1516,6 +2616,20 @@ void cds_lfht_create_bucket(struct cds_lfht *ht, unsigned long size)
 	}
 }
 
+static
+int resize_policy_valid(const struct cds_lfht_resize_policy *policy)
+{
+	if (policy->grow_load_order >= CAA_BITS_PER_LONG)
+		return 0;
+	if (policy->shrink_load_order > policy->grow_load_order)
+		return 0;
+	if (policy->target_load_order > policy->grow_load_order)
+		return 0;
+	if (!policy->chain_len_threshold)
+		return 0;
+	return 1;
+}
+
 struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 			unsigned long min_nr_alloc_buckets,
 			unsigned long max_nr_buckets,
@@ -1524,10 +2638,36 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 			const struct rcu_flavor_struct *flavor,
 			pthread_attr_t *attr)
 {
+	return _cds_lfht_new_with_policy(init_size, min_nr_alloc_buckets,
+			max_nr_buckets, flags, NULL, mm, flavor, attr);
+}
+
+struct cds_lfht *_cds_lfht_new_with_policy(unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_resize_policy *policy,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr)
+{
+	static const struct cds_lfht_resize_policy default_policy =
+		CDS_LFHT_RESIZE_POLICY_DEFAULT;
 	struct cds_lfht *ht;
 	unsigned long order;
 
-	/* min_nr_alloc_buckets must be power of two */
+	if (!policy)
+		policy = &default_policy;
+	if (!resize_policy_valid(policy))
+		return NULL;
+
+#ifdef RCULFHASH_FLAVOR_BOUND
+	/* The flavor operations of this library are those of rcu_flavor. */
+	if (flavor != &rcu_flavor)
+		return NULL;
+#endif
+
+	/* min_nr_alloc_buckets must be power of two */
 	if (!min_nr_alloc_buckets || (min_nr_alloc_buckets & (min_nr_alloc_buckets - 1)))
 		return NULL;
 
@@ -1581,11 +2721,16 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 	assert(ht->bucket_at == mm->bucket_at);
 
 	ht->flags = flags;
+	if (flags & CDS_LFHT_AUTO_RESIZE)
+		ht->resize_workqueue = cds_lfht_workqueue;
+	ht->resize_policy = *policy;
+	ht->resize_latency_us = RESIZE_LATENCY_US_DEFAULT;
 	ht->flavor = flavor;
 	ht->resize_attr = attr;
 	alloc_split_items_count(ht);
 	/* this mutex should not nest in read-side C.S. */
 	pthread_mutex_init(&ht->resize_mutex, NULL);
+	pthread_mutex_init(&ht->filter_mutex, NULL);
 	order = cds_lfht_get_count_order_ulong(init_size);
 	ht->resize_target = 1UL << order;
 	cds_lfht_create_bucket(ht, 1UL << order);
@@ -1593,13 +2738,136 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 	return ht;
 }
 
+static
+int bulk_entry_cmp(const void *a, const void *b)
+{
+	unsigned long reverse_a, reverse_b;
+
+	reverse_a = bit_reverse_ulong(((const struct cds_lfht_bulk_entry *) a)->hash);
+	reverse_b = bit_reverse_ulong(((const struct cds_lfht_bulk_entry *) b)->hash);
+	if (reverse_a < reverse_b)
+		return -1;
+	if (reverse_a > reverse_b)
+		return 1;
+	return 0;
+}
+
+/*
+ * Link the nodes of each bucket whose first entry is within
+ * [start, start + len) after their bucket node. Entries are sorted by
+ * reverse hash, so all nodes belonging to a bucket are contiguous and
+ * already in split-order. A bucket overlapping the end of the range is
+ * completed by this partition, and skipped by the next one.
+ * No atomic operation is needed: the table is not visible to any other
+ * thread yet.
+ */
+static
+void bulk_link_partition(struct cds_lfht *ht, unsigned long i,
+		unsigned long start, unsigned long len, void *priv)
+{
+	struct bulk_load *bulk = priv;
+	struct cds_lfht_bulk_entry *entries = bulk->entries;
+	unsigned long j = start, end = start + len, mask = ht->size - 1;
+
+	while (j > 0 && j < end
+			&& (entries[j - 1].hash & mask) == (entries[j].hash & mask))
+		j++;
+	while (j < end) {
+		unsigned long index = entries[j].hash & mask;
+		struct cds_lfht_node *bucket, *prev, *next;
+
+		bucket = bucket_at(ht, index);
+		next = clear_flag(bucket->next);
+		prev = bucket;
+		for (; j < bulk->nr_entries
+				&& (entries[j].hash & mask) == index; j++) {
+			struct cds_lfht_node *node = entries[j].node;
+
+			if (prev == bucket)
+				prev->next = flag_bucket(node);
+			else
+				prev->next = node;
+			prev = node;
+		}
+		prev->next = next;
+	}
+}
+
+struct cds_lfht *_cds_lfht_new_from_array(struct cds_lfht_bulk_entry *entries,
+			unsigned long nr_entries,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr)
+{
+	struct cds_lfht *ht;
+	struct bulk_load bulk = {
+		.entries = entries,
+		.nr_entries = nr_entries,
+	};
+	unsigned long size, i;
+
+	/* Size the table for its final number of nodes. */
+	size = max(nr_entries >> (CHAIN_LEN_TARGET - 1), MIN_TABLE_SIZE);
+	size = 1UL << cds_lfht_get_count_order_ulong(size);
+	if (max_nr_buckets)
+		size = min(size, max_nr_buckets);
+	ht = _cds_lfht_new(size, min_nr_alloc_buckets, max_nr_buckets,
+			flags, mm, flavor, attr);
+	if (!ht || !nr_entries)
+		return ht;
+
+	for (i = 0; i < nr_entries; i++) {
+		assert(!is_bucket(entries[i].node));
+		entries[i].node->reverse_hash =
+			bit_reverse_ulong(entries[i].hash);
+	}
+	qsort(entries, nr_entries, sizeof(*entries), bulk_entry_cmp);
+	partition_resize_helper(ht, 0, nr_entries, &bulk,
+			bulk_link_partition);
+
+	/*
+	 * Account for the nodes as if they had been added on the first
+	 * split counter, committing whole split counter periods to the
+	 * global count.
+	 */
+	if (ht->split_count) {
+		ht->split_count[0].add = nr_entries;
+		ht->count = nr_entries & ~((1UL << COUNT_COMMIT_ORDER) - 1);
+	}
+	return ht;
+}
+
+struct cds_lfht_node *__cds_lfht_lookup_chain(struct cds_lfht *ht,
+		unsigned long hash, unsigned long *reverse_hash)
+{
+	struct cds_lfht_node *bucket;
+	unsigned long size;
+
+	if (ht->node_hash)
+		return _CDS_LFHT_CHAIN_NODE_HASH;
+	*reverse_hash = bit_reverse_ulong(hash);
+	if (!lfht_filter_may_contain(ht, hash))
+		return NULL;
+	size = rcu_dereference(ht->size);
+	bucket = lookup_bucket(ht, size, hash);
+	/* We can always skip the bucket node initially */
+	return clear_flag(rcu_dereference(bucket->next));
+}
+
 void cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
 		cds_lfht_match_fct match, const void *key,
 		struct cds_lfht_iter *iter)
 {
 	struct cds_lfht_node *node, *next, *bucket;
-	unsigned long reverse_hash, size;
+	unsigned long reverse_hash, node_hash, size;
 
+	if (!lfht_filter_may_contain(ht, hash)) {
+		iter->node = iter->next = NULL;
+		return;
+	}
 	reverse_hash = bit_reverse_ulong(hash);
 
 	size = rcu_dereference(ht->size);
@@ -1612,16 +2880,18 @@ void cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
 			node = next = NULL;
 			break;
 		}
-		if (caa_unlikely(node->reverse_hash > reverse_hash)) {
+		node_hash = node_reverse_hash(ht, node);
+		if (caa_unlikely(node_hash > reverse_hash)) {
 			node = next = NULL;
 			break;
 		}
 		next = rcu_dereference(node->next);
+		_cds_lfht_prefetch_next(next);
 		assert(node == clear_flag(node));
 		if (caa_likely(!is_removed(next))
 		    && !is_bucket(next)
-		    && node->reverse_hash == reverse_hash
-		    && caa_likely(match(node, key))) {
+		    && node_hash == reverse_hash
+		    && (!match || caa_likely(match(node, key)))) {
 				break;
 		}
 		node = clear_flag(next);
@@ -1631,37 +2901,198 @@ void cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
 	iter->next = next;
 }
 
-void cds_lfht_next_duplicate(struct cds_lfht *ht, cds_lfht_match_fct match,
+int cds_lfht_match_key8(struct cds_lfht_node *node, const void *key)
+{
+	return _cds_lfht_match_key8(node, key);
+}
+
+int cds_lfht_match_key16(struct cds_lfht_node *node, const void *key)
+{
+	return _cds_lfht_match_key16(node, key);
+}
+
+int cds_lfht_match_key32(struct cds_lfht_node *node, const void *key)
+{
+	return _cds_lfht_match_key32(node, key);
+}
+
+void cds_lfht_lookup_key8(struct cds_lfht *ht, unsigned long hash,
 		const void *key, struct cds_lfht_iter *iter)
 {
-	struct cds_lfht_node *node, *next;
-	unsigned long reverse_hash;
+	_cds_lfht_lookup_key8(ht, hash, key, iter);
+}
 
-	node = iter->node;
-	reverse_hash = node->reverse_hash;
-	next = iter->next;
-	node = clear_flag(next);
+void cds_lfht_lookup_key16(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	_cds_lfht_lookup_key16(ht, hash, key, iter);
+}
 
-	for (;;) {
-		if (caa_unlikely(is_end(node))) {
-			node = next = NULL;
-			break;
-		}
-		if (caa_unlikely(node->reverse_hash > reverse_hash)) {
-			node = next = NULL;
-			break;
-		}
+void cds_lfht_lookup_key32(struct cds_lfht *ht, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	_cds_lfht_lookup_key32(ht, hash, key, iter);
+}
+
+struct lookup_cache_entry {
+	unsigned long hash;
+	struct cds_lfht_node *node;	/* NULL: empty */
+};
+
+struct cds_lfht_lookup_cache {
+	struct cds_lfht *ht;
+	unsigned long generation;	/* of the cached nodes */
+	unsigned long mask;
+	struct lookup_cache_entry entries[];
+};
+
+struct cds_lfht_lookup_cache *cds_lfht_lookup_cache_create(struct cds_lfht *ht,
+		unsigned long nr_entries)
+{
+	struct cds_lfht_lookup_cache *cache;
+	unsigned long size;
+
+	if (!nr_entries || nr_entries > (1UL << (CAA_BITS_PER_LONG - 2)))
+		return NULL;
+	size = 1UL << cds_lfht_get_count_order_ulong(nr_entries);
+	cache = urcu_calloc(1, sizeof(*cache)
+			+ size * sizeof(cache->entries[0]));
+	if (!cache)
+		return NULL;
+	cache->ht = ht;
+	cache->mask = size - 1;
+	uatomic_inc(&ht->nr_lookup_caches);
+	/*
+	 * Wait for the removals which did not see the cache count: the
+	 * nodes they removed are unlinked before the cache is filled.
+	 */
+	flavor_synchronize_rcu(ht);
+	cache->generation = uatomic_read(&ht->generation);
+	return cache;
+}
+
+void cds_lfht_lookup_cache_destroy(struct cds_lfht_lookup_cache *cache)
+{
+	if (!cache)
+		return;
+	uatomic_dec(&cache->ht->nr_lookup_caches);
+	urcu_free(cache);
+}
+
+void cds_lfht_lookup_cached(struct cds_lfht_lookup_cache *cache,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	struct lookup_cache_entry *entry = &cache->entries[hash & cache->mask];
+	unsigned long generation;
+	struct cds_lfht_node *node, *next;
+
+	generation = CMM_LOAD_SHARED(cache->ht->generation);
+	if (caa_unlikely(generation != cache->generation)) {
+		memset(cache->entries, 0,
+			(cache->mask + 1) * sizeof(cache->entries[0]));
+		cache->generation = generation;
+	}
+	node = entry->node;
+	if (node && entry->hash == hash) {
 		next = rcu_dereference(node->next);
 		if (caa_likely(!is_removed(next))
-		    && !is_bucket(next)
-		    && caa_likely(match(node, key))) {
-				break;
+		    && (!match || caa_likely(match(node, key)))) {
+			iter->node = node;
+			iter->next = next;
+			return;
 		}
-		node = clear_flag(next);
 	}
-	assert(!node || !is_bucket(CMM_LOAD_SHARED(node->next)));
-	iter->node = node;
-	iter->next = next;
+	cds_lfht_lookup(cache->ht, hash, match, key, iter);
+	if (iter->node) {
+		entry->hash = hash;
+		entry->node = iter->node;
+	}
+}
+
+/*
+ * Resolve up to LOOKUP_MANY_BATCH lookups, walking all the hash chains
+ * one node at a time in round-robin, so the cache misses of each chain
+ * overlap with the work done on the other chains.
+ */
+static
+void lookup_many_batch(struct cds_lfht *ht, unsigned long nr,
+		const unsigned long *hashes, cds_lfht_match_fct match,
+		const void **keys, struct cds_lfht_iter *iters)
+{
+	struct cds_lfht_node *node[LOOKUP_MANY_BATCH];
+	unsigned long reverse_hash[LOOKUP_MANY_BATCH];
+	unsigned int pending[LOOKUP_MANY_BATCH];
+	unsigned long size, i, j, nr_pending, node_hash;
+
+	size = rcu_dereference(ht->size);
+	bit_reverse_ulong_many(hashes, reverse_hash, nr);
+	for (i = 0; i < nr; i++) {
+		if (!lfht_filter_may_contain(ht, hashes[i])) {
+			node[i] = NULL;
+			continue;
+		}
+		node[i] = lookup_bucket(ht, size, hashes[i]);
+		lfht_prefetch(node[i]);
+	}
+	for (i = 0; i < nr; i++) {
+		/* We can always skip the bucket node initially */
+		if (node[i])
+			node[i] = clear_flag(rcu_dereference(node[i]->next));
+		if (!is_end(node[i]))
+			lfht_prefetch(node[i]);
+		pending[i] = i;
+	}
+	nr_pending = nr;
+	while (nr_pending) {
+		/* Completed lookups are removed from the pending array. */
+		for (j = 0; j < nr_pending; ) {
+			struct cds_lfht_node *next;
+
+			i = pending[j];
+			if (caa_unlikely(is_end(node[i]))
+			    || caa_unlikely((node_hash = node_reverse_hash(ht,
+					node[i])) > reverse_hash[i])) {
+				iters[i].node = iters[i].next = NULL;
+				pending[j] = pending[--nr_pending];
+				continue;
+			}
+			next = rcu_dereference(node[i]->next);
+			assert(node[i] == clear_flag(node[i]));
+			if (caa_likely(!is_removed(next))
+			    && !is_bucket(next)
+			    && node_hash == reverse_hash[i]
+			    && (!match || caa_likely(match(node[i], keys[i])))) {
+				assert(!is_bucket(CMM_LOAD_SHARED(node[i]->next)));
+				iters[i].node = node[i];
+				iters[i].next = next;
+				pending[j] = pending[--nr_pending];
+				continue;
+			}
+			node[i] = clear_flag(next);
+			if (!is_end(node[i]))
+				lfht_prefetch(node[i]);
+			j++;
+		}
+	}
+}
+
+void cds_lfht_lookup_many(struct cds_lfht *ht, unsigned long nr,
+		const unsigned long *hashes, cds_lfht_match_fct match,
+		const void **keys, struct cds_lfht_iter *iters)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr; i += LOOKUP_MANY_BATCH)
+		lookup_many_batch(ht, min(nr - i, LOOKUP_MANY_BATCH),
+				&hashes[i], match, &keys[i], &iters[i]);
+}
+
+void cds_lfht_next_duplicate(struct cds_lfht *ht, cds_lfht_match_fct match,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	_cds_lfht_next_duplicate(ht, match, key,
+			node_reverse_hash(ht, iter->node), iter);
 }
 
 void cds_lfht_next(struct cds_lfht *ht, struct cds_lfht_iter *iter)
@@ -1675,6 +3106,8 @@ void cds_lfht_next(struct cds_lfht *ht, struct cds_lfht_iter *iter)
 			break;
 		}
 		next = rcu_dereference(node->next);
+		/* Overlaps with the caller's work on node. */
+		_cds_lfht_prefetch_next(next);
 		if (caa_likely(!is_removed(next))
 		    && !is_bucket(next)) {
 				break;
@@ -1696,15 +3129,269 @@ void cds_lfht_first(struct cds_lfht *ht, struct cds_lfht_iter *iter)
 	cds_lfht_next(ht, iter);
 }
 
+/*
+ * Ranges are slices of the split-ordered list: range "index" out of
+ * "nr_ranges" holds the nodes whose reverse hash starts with the
+ * order(nr_ranges) bits of "index". Those boundaries do not depend on
+ * the table size, so they stay valid across concurrent resize.
+ */
+static
+unsigned long range_reverse_hash(unsigned long index, unsigned long nr_ranges)
+{
+	if (!index)
+		return 0;
+	return index << (CAA_BITS_PER_LONG
+			- cds_lfht_get_count_order_ulong(nr_ranges));
+}
+
+static
+void range_clip_end(struct cds_lfht *ht, struct cds_lfht_iter *iter,
+		unsigned long end, unsigned long nr_ranges)
+{
+	if (iter->node && end < nr_ranges
+	    && node_reverse_hash(ht, iter->node)
+			>= range_reverse_hash(end, nr_ranges))
+		iter->node = iter->next = NULL;
+}
+
+void cds_lfht_first_in_range(struct cds_lfht *ht, unsigned long start,
+		unsigned long end, unsigned long nr_ranges,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *bucket;
+	unsigned long boundary, size;
+
+	assert(nr_ranges && !(nr_ranges & (nr_ranges - 1)));
+	assert(end <= nr_ranges);
+	if (start >= end) {
+		iter->node = iter->next = NULL;
+		return;
+	}
+	if (!start) {
+		cds_lfht_first(ht, iter);
+		range_clip_end(ht, iter, end, nr_ranges);
+		return;
+	}
+	boundary = range_reverse_hash(start, nr_ranges);
+	size = rcu_dereference(ht->size);
+	/*
+	 * Start from the bucket preceding the boundary: nodes with a
+	 * reverse hash equal to the one of a bucket can be chained before
+	 * that bucket node, but never before a bucket with a lower reverse
+	 * hash.
+	 */
+	bucket = lookup_bucket(ht, size, bit_reverse_ulong(boundary - 1));
+	iter->next = rcu_dereference(bucket->next);
+	cds_lfht_next(ht, iter);
+	while (iter->node && node_reverse_hash(ht, iter->node) < boundary)
+		cds_lfht_next(ht, iter);
+	range_clip_end(ht, iter, end, nr_ranges);
+}
+
+void cds_lfht_next_in_range(struct cds_lfht *ht, unsigned long end,
+		unsigned long nr_ranges, struct cds_lfht_iter *iter)
+{
+	cds_lfht_next(ht, iter);
+	range_clip_end(ht, iter, end, nr_ranges);
+}
+
+/*
+ * Find the node following the position of a paused cursor: the first
+ * node of a greater reverse hash, or of the same one past the nr_dup
+ * nodes returned. Start from the bucket preceding the position, as in
+ * cds_lfht_first_in_range.
+ */
+static
+void cursor_resume(struct cds_lfht *ht, struct cds_lfht_cursor *cursor)
+{
+	struct cds_lfht_iter *iter = &cursor->iter;
+	unsigned long reverse_hash = cursor->reverse_hash;
+	unsigned long skip = cursor->nr_dup, node_hash;
+	struct cds_lfht_node *bucket;
+
+	if (!reverse_hash) {
+		cds_lfht_first(ht, iter);
+	} else {
+		bucket = lookup_bucket(ht, rcu_dereference(ht->size),
+				bit_reverse_ulong(reverse_hash - 1));
+		iter->next = rcu_dereference(bucket->next);
+		cds_lfht_next(ht, iter);
+	}
+	while (iter->node) {
+		node_hash = node_reverse_hash(ht, iter->node);
+		if (node_hash > reverse_hash)
+			break;
+		if (node_hash == reverse_hash && !skip--)
+			break;
+		cds_lfht_next(ht, iter);
+	}
+}
+
+struct cds_lfht_node *cds_lfht_cursor_next(struct cds_lfht *ht,
+		struct cds_lfht_cursor *cursor)
+{
+	struct cds_lfht_node *node;
+	unsigned long reverse_hash;
+
+	switch (cursor->state) {
+	case CDS_LFHT_CURSOR_START:
+		cds_lfht_first(ht, &cursor->iter);
+		break;
+	case CDS_LFHT_CURSOR_ACTIVE:
+		cds_lfht_next(ht, &cursor->iter);
+		break;
+	case CDS_LFHT_CURSOR_PAUSED:
+		cursor_resume(ht, cursor);
+		break;
+	default:
+		return NULL;
+	}
+	node = cursor->iter.node;
+	if (!node) {
+		cursor->state = CDS_LFHT_CURSOR_END;
+		return NULL;
+	}
+	reverse_hash = node_reverse_hash(ht, node);
+	if (cursor->state != CDS_LFHT_CURSOR_START
+			&& reverse_hash == cursor->reverse_hash) {
+		cursor->nr_dup++;
+	} else {
+		cursor->reverse_hash = reverse_hash;
+		cursor->nr_dup = 1;
+	}
+	cursor->state = CDS_LFHT_CURSOR_ACTIVE;
+	return node;
+}
+
+static
+int hash_in_range(struct cds_lfht *ht, struct cds_lfht_range_iter *iter,
+		struct cds_lfht_node *node)
+{
+	unsigned long hash = bit_reverse_ulong(node_reverse_hash(ht, node));
+
+	return hash >= iter->hash_lo && hash <= iter->hash_hi;
+}
+
+/* Skip nodes out of the hash range in a whole table traversal. */
+static
+void range_scan_skip(struct cds_lfht *ht, struct cds_lfht_range_iter *iter)
+{
+	while (iter->iter.node && !hash_in_range(ht, iter, iter->iter.node))
+		cds_lfht_next(ht, &iter->iter);
+}
+
+/* Look up the hashes following iter->hash until a node is found. */
+static
+void range_lookup_from(struct cds_lfht *ht, struct cds_lfht_range_iter *iter)
+{
+	for (;;) {
+		cds_lfht_lookup(ht, iter->hash, NULL, NULL, &iter->iter);
+		if (iter->iter.node || iter->hash == iter->hash_hi)
+			return;
+		iter->hash++;
+	}
+}
+
+void cds_lfht_lookup_range(struct cds_lfht *ht, unsigned long hash_lo,
+		unsigned long hash_hi, struct cds_lfht_range_iter *iter)
+{
+	iter->hash_lo = hash_lo;
+	iter->hash_hi = hash_hi;
+	iter->hash = hash_lo;
+	if (hash_lo > hash_hi) {
+		iter->scan = 0;
+		iter->iter.node = iter->iter.next = NULL;
+		return;
+	}
+	/*
+	 * The list is sorted by bit-reversed hash, so a hash range is
+	 * scattered all over the table. Looking up each hash of the range
+	 * is cheaper than a traversal as long as the range is narrower
+	 * than the number of buckets.
+	 */
+	iter->scan = hash_hi - hash_lo >= rcu_dereference(ht->size);
+	if (iter->scan) {
+		cds_lfht_first(ht, &iter->iter);
+		range_scan_skip(ht, iter);
+	} else {
+		range_lookup_from(ht, iter);
+	}
+}
+
+void cds_lfht_next_range(struct cds_lfht *ht, struct cds_lfht_range_iter *iter)
+{
+	if (iter->scan) {
+		cds_lfht_next(ht, &iter->iter);
+		range_scan_skip(ht, iter);
+		return;
+	}
+	cds_lfht_next_duplicate(ht, NULL, NULL, &iter->iter);
+	if (iter->iter.node || iter->hash == iter->hash_hi)
+		return;
+	iter->hash++;
+	range_lookup_from(ht, iter);
+}
+
 void cds_lfht_add(struct cds_lfht *ht, unsigned long hash,
 		struct cds_lfht_node *node)
 {
 	unsigned long size;
 
-	node->reverse_hash = bit_reverse_ulong(hash);
+	node_set_reverse_hash(ht, node, hash);
+	size = rcu_dereference(ht->size);
+	_cds_lfht_add(ht, hash, NULL, NULL, size, node, NULL, 0, NULL, NULL,
+			NULL);
+	changelog_append(ht, CDS_LFHT_CHANGE_ADD, hash, node);
+	ht_count_add(ht, size, hash, 1);
+	incremental_resize_help(ht, size);
+}
+
+void cds_lfht_add_hint(struct cds_lfht *ht, unsigned long hash,
+		struct cds_lfht_node *node, struct cds_lfht_iter *hint)
+{
+	unsigned long size;
+
+	node_set_reverse_hash(ht, node, hash);
+	size = rcu_dereference(ht->size);
+	_cds_lfht_add(ht, hash, NULL, NULL, size, node, NULL, 0, NULL, NULL,
+			hint->node);
+	changelog_append(ht, CDS_LFHT_CHANGE_ADD, hash, node);
+	ht_count_add(ht, size, hash, 1);
+	incremental_resize_help(ht, size);
+	hint->node = node;
+	hint->next = rcu_dereference(node->next);
+}
+
+/*
+ * Each insertion still looks up its bucket and walks its chain from
+ * there. Sorting the entries by reverse hash only makes consecutive
+ * insertions touch neighbouring buckets and chain regions, which are
+ * likely to still be cached. Resize checks and node accounting are done
+ * once for the whole batch.
+ */
+void cds_lfht_add_bulk(struct cds_lfht *ht,
+		struct cds_lfht_bulk_entry *entries,
+		unsigned long nr_entries)
+{
+	unsigned long size, i;
+	uint32_t max_chain_len = 0;
+
+	if (!nr_entries)
+		return;
+	qsort(entries, nr_entries, sizeof(*entries), bulk_entry_cmp);
 	size = rcu_dereference(ht->size);
-	_cds_lfht_add(ht, hash, NULL, NULL, size, node, NULL, 0);
-	ht_count_add(ht, size, hash);
+	for (i = 0; i < nr_entries; i++) {
+		struct cds_lfht_node *node = entries[i].node;
+
+		node_set_reverse_hash(ht, node, entries[i].hash);
+		_cds_lfht_add(ht, entries[i].hash, NULL, NULL, size, node,
+				NULL, 0, &max_chain_len, NULL, NULL);
+		changelog_append(ht, CDS_LFHT_CHANGE_ADD, entries[i].hash,
+				node);
+	}
+	check_resize(ht, size, max_chain_len);
+	ht_count_add(ht, size, entries[0].hash, nr_entries);
+	incremental_resize_help(ht, size);
 }
 
 struct cds_lfht_node *cds_lfht_add_unique(struct cds_lfht *ht,
@@ -1716,11 +3403,48 @@ struct cds_lfht_node *cds_lfht_add_unique(struct cds_lfht *ht,
 	unsigned long size;
 	struct cds_lfht_iter iter;
 
-	node->reverse_hash = bit_reverse_ulong(hash);
+	node_set_reverse_hash(ht, node, hash);
 	size = rcu_dereference(ht->size);
-	_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0);
-	if (iter.node == node)
-		ht_count_add(ht, size, hash);
+	_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0, NULL, NULL,
+			NULL);
+	if (iter.node == node) {
+		changelog_append(ht, CDS_LFHT_CHANGE_ADD, hash, node);
+		ht_count_add(ht, size, hash, 1);
+	}
+	incremental_resize_help(ht, size);
+	return iter.node;
+}
+
+struct cds_lfht_node *cds_lfht_lookup_or_add(struct cds_lfht *ht,
+		unsigned long hash,
+		cds_lfht_match_fct match,
+		const void *key,
+		struct cds_lfht_node *(*ctor_fct)(const void *key, void *priv),
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv)
+{
+	struct lfht_add_ctor ctor = {
+		.ctor_fct = ctor_fct,
+		.priv = priv,
+	};
+	/* Stands for the node until construction, never linked. */
+	struct cds_lfht_node probe = { .next = NULL };
+	unsigned long size;
+	struct cds_lfht_iter iter;
+
+	size = rcu_dereference(ht->size);
+	_cds_lfht_add(ht, hash, match, key, size, &probe, &iter, 0, NULL,
+			&ctor, NULL);
+	if (!iter.node)
+		return NULL;
+	if (iter.node == ctor.node) {
+		changelog_append(ht, CDS_LFHT_CHANGE_ADD, hash, iter.node);
+		ht_count_add(ht, size, hash, 1);
+	} else if (ctor.node) {
+		/* Lost a race after construction: never published. */
+		free_fct(ctor.node, priv);
+	}
+	incremental_resize_help(ht, size);
 	return iter.node;
 }
 
@@ -1733,17 +3457,23 @@ struct cds_lfht_node *cds_lfht_add_replace(struct cds_lfht *ht,
 	unsigned long size;
 	struct cds_lfht_iter iter;
 
-	node->reverse_hash = bit_reverse_ulong(hash);
+	node_set_reverse_hash(ht, node, hash);
 	size = rcu_dereference(ht->size);
 	for (;;) {
-		_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0);
+		_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0, NULL,
+				NULL, NULL);
 		if (iter.node == node) {
-			ht_count_add(ht, size, hash);
+			changelog_append(ht, CDS_LFHT_CHANGE_ADD, hash, node);
+			ht_count_add(ht, size, hash, 1);
+			incremental_resize_help(ht, size);
 			return NULL;
 		}
 
-		if (!_cds_lfht_replace(ht, size, iter.node, iter.next, node))
+		if (!_cds_lfht_replace(ht, size, iter.node, iter.next, node)) {
+			changelog_append(ht, CDS_LFHT_CHANGE_REPLACE, hash,
+					node);
 			return iter.node;
+		}
 	}
 }
 
@@ -1755,74 +3485,615 @@ int cds_lfht_replace(struct cds_lfht *ht,
 		struct cds_lfht_node *new_node)
 {
 	unsigned long size;
+	int ret;
+
+	node_set_reverse_hash(ht, new_node, hash);
+	if (!old_iter->node)
+		return -ENOENT;
+	if (caa_unlikely(node_reverse_hash(ht, old_iter->node)
+			!= bit_reverse_ulong(hash)))
+		return -EINVAL;
+	if (match && caa_unlikely(!match(old_iter->node, key)))
+		return -EINVAL;
+	size = rcu_dereference(ht->size);
+	ret = _cds_lfht_replace(ht, size, old_iter->node, old_iter->next,
+			new_node);
+	if (!ret)
+		changelog_append(ht, CDS_LFHT_CHANGE_REPLACE, hash, new_node);
+	return ret;
+}
+
+int cds_lfht_del(struct cds_lfht *ht, struct cds_lfht_node *node)
+{
+	unsigned long size;
+	int ret;
+
+	size = rcu_dereference(ht->size);
+	ret = _cds_lfht_del(ht, size, node);
+	if (!ret) {
+		unsigned long hash;
+
+		hash = bit_reverse_ulong(node_reverse_hash(ht, node));
+		changelog_append(ht, CDS_LFHT_CHANGE_DEL, hash, node);
+		ht_count_del(ht, size, hash);
+	}
+	incremental_resize_help(ht, size);
+	return ret;
+}
+
+static
+void del_free_batch_cb(struct rcu_head *head)
+{
+	struct del_free_batch *batch =
+		caa_container_of(head, struct del_free_batch, head);
+	unsigned long i;
+
+	for (i = 0; i < batch->nr; i++)
+		batch->free_fct(batch->nodes[i]);
+	urcu_free(batch);
+}
+
+/*
+ * Thread exit: the thread may be unregistered from its flavor already,
+ * so wait for a grace period rather than queueing a callback.
+ */
+static
+void del_free_batch_release(void *arg)
+{
+	struct del_free_batch *batch = arg;
+	unsigned long i;
+
+	URCU_TLS(cds_lfht_del_free_batch) = NULL;
+	batch->flavor->update_synchronize_rcu();
+	for (i = 0; i < batch->nr; i++)
+		batch->free_fct(batch->nodes[i]);
+	urcu_free(batch);
+}
+
+static
+void del_free_key_init(void)
+{
+	int ret;
+
+	ret = pthread_key_create(&del_free_key, del_free_batch_release);
+	if (ret)
+		urcu_die(ret);
+}
+
+static
+void del_free_key_set(struct del_free_batch *batch)
+{
+	int ret;
+
+	ret = pthread_setspecific(del_free_key, batch);
+	if (ret)
+		urcu_die(ret);
+}
+
+void cds_lfht_del_free_flush(void)
+{
+	struct del_free_batch *batch = URCU_TLS(cds_lfht_del_free_batch);
+
+	if (!batch)
+		return;
+	URCU_TLS(cds_lfht_del_free_batch) = NULL;
+	del_free_key_set(NULL);
+	if (!batch->nr) {
+		urcu_free(batch);
+		return;
+	}
+	flavor_call_rcu(batch, &batch->head, del_free_batch_cb);
+}
+
+int cds_lfht_del_free(struct cds_lfht *ht, struct cds_lfht_node *node,
+		void (*free_fct)(struct cds_lfht_node *node))
+{
+	struct del_free_batch *batch = URCU_TLS(cds_lfht_del_free_batch);
+	int ret;
+
+	if (batch && (batch->flavor != ht->flavor
+			|| batch->free_fct != free_fct)) {
+		cds_lfht_del_free_flush();
+		batch = NULL;
+	}
+	/*
+	 * The batch is allocated before the removal: without memory, the
+	 * node stays in the table, as the caller cannot wait for a grace
+	 * period within its read-side critical section.
+	 */
+	if (!batch) {
+		batch = urcu_malloc(DEL_FREE_BATCH_BYTES);
+		if (!batch)
+			return -ENOMEM;
+		batch->flavor = ht->flavor;
+		batch->free_fct = free_fct;
+		batch->nr = 0;
+		(void) pthread_once(&del_free_key_once, del_free_key_init);
+		del_free_key_set(batch);
+		URCU_TLS(cds_lfht_del_free_batch) = batch;
+	}
+	ret = cds_lfht_del(ht, node);
+	if (ret)
+		return ret;
+	batch->nodes[batch->nr++] = node;
+	if (batch->nr == DEL_FREE_BATCH_LEN)
+		cds_lfht_del_free_flush();
+	return 0;
+}
+
+/*
+ * Unlink the nodes of @batch, flagged removed in split-order, with a
+ * single gc pass from their bucket, and keep in @chunk
+ * those whose removal this thread owns. Returns their number.
+ */
+static
+unsigned long del_if_flush(struct cds_lfht *ht, struct cds_lfht_node **batch,
+		unsigned long nr, struct del_if_chunk *chunk)
+{
+	struct cds_lfht_node *bucket, *node;
+	unsigned long size, hash, i, count = 0;
+
+	size = rcu_dereference(ht->size);
+	bucket = lookup_bucket(ht, size,
+			bit_reverse_ulong(node_reverse_hash(ht, batch[0])));
+	_cds_lfht_gc_bucket(ht, bucket, batch[nr - 1]);
+	for (i = 0; i < nr; i++) {
+		node = batch[i];
+		assert(is_removed(CMM_LOAD_SHARED(node->next)));
+		/* Same removal ownership as _cds_lfht_del. */
+		if (is_removal_owner(uatomic_xchg(&node->next,
+				flag_removal_owner(node->next))))
+			continue;
+		hash = bit_reverse_ulong(node_reverse_hash(ht, node));
+		changelog_append(ht, CDS_LFHT_CHANGE_DEL, hash, node);
+		ht_count_del(ht, size, hash);
+		chunk->nodes[chunk->nr++] = node;
+		count++;
+	}
+	incremental_resize_help(ht, size);
+	return count;
+}
+
+/*
+ * Delete the nodes matching the predicate in ranges [start, start + len)
+ * out of del_if_work size ranges, walked DEL_IF_RANGES at a time within
+ * a read-side critical section. Matching nodes are flagged removed as by
+ * _cds_lfht_del, but unlinked together with those of the same bucket,
+ * up to DEL_IF_BATCH at a time. The nodes removed
+ * are freed after a grace period, once all ranges are done.
+ */
+static
+void del_if_partition(struct cds_lfht *ht, unsigned long i,
+		unsigned long start, unsigned long len, void *priv)
+{
+	struct del_if_work *work = priv;
+	struct cds_lfht_node *batch[DEL_IF_BATCH], *node, *next;
+	struct del_if_chunk *chunks = NULL, *chunk;
+	struct cds_lfht_iter iter;
+	unsigned long r, end, j, nr, bucket, batch_bucket = 0, count = 0;
+
+	for (r = start; r < start + len; r = end) {
+		end = min(r + DEL_IF_RANGES, start + len);
+		nr = 0;
+		flavor_read_lock(ht);
+		cds_lfht_first_in_range(ht, r, end, work->size, &iter);
+		for (; iter.node; cds_lfht_next_in_range(ht, end,
+				work->size, &iter)) {
+			node = iter.node;
+			if (!work->pred(node, work->priv))
+				continue;
+			next = CMM_LOAD_SHARED(node->next);
+			if (is_removed(next))
+				continue;
+			assert(!is_bucket(next));
+			bucket = bit_reverse_ulong(node_reverse_hash(ht, node))
+					& (work->size - 1);
+			if (nr && bucket != batch_bucket) {
+				count += del_if_flush(ht, batch, nr, chunks);
+				nr = 0;
+			}
+			batch_bucket = bucket;
+			/* Room for the whole batch before flagging it. */
+			if (!nr && (!chunks
+			    || chunks->nr + DEL_IF_BATCH > DEL_IF_CHUNK)) {
+				chunk = urcu_malloc(sizeof(*chunk));
+				if (!chunk) {
+					uatomic_set(&work->err, -ENOMEM);
+					break;
+				}
+				chunk->next = chunks;
+				chunk->nr = 0;
+				chunks = chunk;
+			}
+			lookup_caches_invalidate(ht);
+			cmm_smp_mb__before_uatomic_or();
+			uatomic_or(&node->next, REMOVED_FLAG);
+			batch[nr++] = node;
+			if (nr == DEL_IF_BATCH) {
+				count += del_if_flush(ht, batch, nr, chunks);
+				nr = 0;
+			}
+		}
+		if (nr)
+			count += del_if_flush(ht, batch, nr, chunks);
+		flavor_read_unlock(ht);
+		if (!iter.node)
+			continue;
+		break;	/* Out of memory */
+	}
+	if (!chunks)
+		return;
+	if (count)
+		flavor_synchronize_rcu(ht);
+	for (chunk = chunks; chunk; chunk = chunks) {
+		for (j = 0; j < chunk->nr; j++)
+			work->free_fct(chunk->nodes[j], work->priv);
+		chunks = chunk->next;
+		urcu_free(chunk);
+	}
+	uatomic_add(&work->nr_deleted, count);
+}
+
+long cds_lfht_del_if(struct cds_lfht *ht,
+		int (*pred)(struct cds_lfht_node *node, void *priv),
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv, unsigned long nr_threads)
+{
+	struct del_if_work work = {
+		.pred = pred,
+		.free_fct = free_fct,
+		.priv = priv,
+	};
+
+	/* Range boundaries do not depend on the size, which may change. */
+	work.size = CMM_LOAD_SHARED(ht->size);
+	partition_helper(ht, 0, work.size, nr_threads, &work,
+			del_if_partition);
+	if (work.err)
+		return work.err;
+	return work.nr_deleted;
+}
+
+int cds_lfht_is_node_deleted(struct cds_lfht_node *node)
+{
+	return is_removed(CMM_LOAD_SHARED(node->next));
+}
+
+static
+int cds_lfht_delete_bucket(struct cds_lfht *ht)
+{
+	struct cds_lfht_node *node;
+	unsigned long order, i, size;
+
+	/* Check that the table is empty */
+	node = bucket_at(ht, 0);
+	do {
+		node = clear_flag(node)->next;
+		if (!is_bucket(node))
+			return -EPERM;
+		assert(!is_removed(node));
+		assert(!is_removal_owner(node));
+	} while (!is_end(node));
+	/*
+	 * size accessed without rcu_dereference because hash table is
+	 * being destroyed.
+	 */
+	size = ht->size;
+	/* Internal sanity check: all nodes left should be buckets */
+	for (i = 0; i < size; i++) {
+		node = bucket_at(ht, i);
+		dbg_printf("delete bucket: index %lu expected hash %lu hash %lu\n",
+			i, i, bit_reverse_ulong(node->reverse_hash));
+		assert(is_bucket(node->next));
+	}
+
+	for (order = cds_lfht_get_count_order_ulong(size); (long)order >= 0; order--)
+		cds_lfht_free_bucket_table(ht, order);
+
+	return 0;
+}
+
+/*
+ * Detach the regular nodes of ranges [start, start + len) out of
+ * clear_work size ranges, then free them after a grace period. The
+ * ranges of a partition are delimited by bucket nodes, so each thread
+ * only modifies the list within its own partition. All pointers are
+ * moved forward in the list order, so concurrent readers either see
+ * detached nodes or skip them, but never loop.
+ */
+static
+void clear_table_partition(struct cds_lfht *ht, unsigned long i,
+		unsigned long start, unsigned long len, void *priv)
+{
+	struct clear_work *work = priv;
+	struct cds_lfht_node *bucket, *node, *next, *run_head, *run_tail,
+		*head = NULL, *tail = NULL;
+	unsigned long end_hash, count = 0;
+	int last = (start + len == work->size);
+
+	end_hash = last ? 0 : range_reverse_hash(start + len, work->size);
+	bucket = bucket_at(ht,
+		bit_reverse_ulong(range_reverse_hash(start, work->size)));
+	for (;;) {
+		assert(is_bucket(bucket->next));
+		run_head = node = clear_flag(bucket->next);
+		run_tail = NULL;
+		while (!is_end(node)) {
+			next = node->next;
+			if (is_bucket(next))
+				break;
+			assert(!is_removed(next));
+			run_tail = node;
+			count++;
+			node = clear_flag(next);
+		}
+		/* node is the next bucket node, or the end of the list. */
+		if (run_tail) {
+			rcu_assign_pointer(bucket->next, flag_bucket(node));
+			if (tail)
+				CMM_STORE_SHARED(tail->next, run_head);
+			else
+				head = run_head;
+			tail = run_tail;
+		}
+		if (is_end(node) || (!last && node->reverse_hash >= end_hash))
+			break;
+		bucket = node;
+	}
+	if (!head)
+		return;
+	if (work->sync)
+		flavor_synchronize_rcu(ht);
+	for (node = head; node; node = next) {
+		next = node == tail ? NULL : clear_flag(node->next);
+		work->free_fct(node, work->priv);
+	}
+	uatomic_add(&work->nr_cleared, count);
+}
+
+static
+void changelog_free(struct lfht_changelog *log)
+{
+	unsigned int i;
+
+	if (!log)
+		return;
+	for (i = 0; i < log->nr_cpus; i++) {
+		(void) pthread_mutex_destroy(&log->cpus[i].lock);
+		urcu_free(log->cpus[i].changes);
+	}
+	urcu_free(log->cpus);
+	urcu_free(log);
+}
+
+int cds_lfht_changelog_enable(struct cds_lfht *ht, unsigned long capacity)
+{
+	struct lfht_changelog *log;
+	unsigned int i;
+	long nr_cpus;
+
+	if (!capacity)
+		capacity = CDS_LFHT_CHANGELOG_CAPACITY;
+	capacity = 1UL << cds_lfht_get_count_order_ulong(capacity);
+	log = urcu_calloc(1, sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	log->nr_cpus = nr_cpus > 0 ? nr_cpus : 1;
+	log->capacity = capacity;
+	if (urcu_posix_memalign((void **) &log->cpus, CAA_CACHE_LINE_SIZE,
+			log->nr_cpus * sizeof(*log->cpus))) {
+		urcu_free(log);
+		return -ENOMEM;
+	}
+	memset(log->cpus, 0, log->nr_cpus * sizeof(*log->cpus));
+	for (i = 0; i < log->nr_cpus; i++) {
+		struct lfht_changelog_cpu *lc = &log->cpus[i];
+
+		pthread_mutex_init(&lc->lock, NULL);
+		lc->changes = urcu_malloc(capacity * sizeof(*lc->changes));
+		if (!lc->changes) {
+			log->nr_cpus = i + 1;
+			changelog_free(log);
+			return -ENOMEM;
+		}
+	}
+	if (uatomic_cmpxchg(&ht->changelog, NULL, log) != NULL) {
+		changelog_free(log);
+		return -EBUSY;
+	}
+	return 0;
+}
+
+void cds_lfht_changelog_disable(struct cds_lfht *ht)
+{
+	struct lfht_changelog *log;
+
+	log = uatomic_xchg(&ht->changelog, NULL);
+	if (!log)
+		return;
+	ht->flavor->update_synchronize_rcu();
+	changelog_free(log);
+}
+
+unsigned long cds_lfht_changelog_drain(struct cds_lfht *ht,
+		struct cds_lfht_change *changes, unsigned long nr,
+		int *overflow)
+{
+	struct lfht_changelog *log = rcu_dereference(ht->changelog);
+	unsigned long done = 0;
+	unsigned int i, cpu;
+
+	if (overflow)
+		*overflow = 0;
+	if (!log)
+		return 0;
+	if (overflow && CMM_LOAD_SHARED(log->overflow))
+		*overflow = uatomic_xchg(&log->overflow, 0);
+	/* Start from another CPU each time, so none is starved. */
+	cpu = CMM_LOAD_SHARED(log->next_cpu);
+	for (i = 0; i < log->nr_cpus && done < nr; i++) {
+		struct lfht_changelog_cpu *lc =
+			&log->cpus[(cpu + i) % log->nr_cpus];
+
+		if (CMM_LOAD_SHARED(lc->head) == CMM_LOAD_SHARED(lc->tail))
+			continue;
+		mutex_lock(&lc->lock);
+		while (lc->tail != lc->head && done < nr)
+			changes[done++] =
+				lc->changes[lc->tail++ & (log->capacity - 1)];
+		mutex_unlock(&lc->lock);
+	}
+	CMM_STORE_SHARED(log->next_cpu, (cpu + 1) % log->nr_cpus);
+	return done;
+}
+
+/* Changes which are not logged one by one, e.g. clear, force a resync. */
+static
+void changelog_overflow(struct cds_lfht *ht)
+{
+	struct lfht_changelog *log;
 
-	new_node->reverse_hash = bit_reverse_ulong(hash);
-	if (!old_iter->node)
-		return -ENOENT;
-	if (caa_unlikely(old_iter->node->reverse_hash != new_node->reverse_hash))
-		return -EINVAL;
-	if (caa_unlikely(!match(old_iter->node, key)))
-		return -EINVAL;
-	size = rcu_dereference(ht->size);
-	return _cds_lfht_replace(ht, size, old_iter->node, old_iter->next,
-			new_node);
+	ht->flavor->read_lock();
+	log = rcu_dereference(ht->changelog);
+	if (log)
+		uatomic_set(&log->overflow, 1);
+	ht->flavor->read_unlock();
 }
 
-int cds_lfht_del(struct cds_lfht *ht, struct cds_lfht_node *node)
+static
+unsigned long _cds_lfht_clear(struct cds_lfht *ht,
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv, int sync)
 {
+	struct clear_work work = {
+		.free_fct = free_fct,
+		.priv = priv,
+		.sync = sync,
+	};
 	unsigned long size;
-	int ret;
 
-	size = rcu_dereference(ht->size);
-	ret = _cds_lfht_del(ht, size, node);
-	if (!ret) {
-		unsigned long hash;
+	mutex_lock(&ht->resize_mutex);
+	incremental_resize_finish(ht);
+	size = work.size = ht->size;
+	partition_resize_helper(ht, 0, size, &work, clear_table_partition);
+	if (ht->split_count) {
+		int i;
 
-		hash = bit_reverse_ulong(node->reverse_hash);
-		ht_count_del(ht, size, hash);
+		for (i = 0; i < split_count_mask + 1; i++) {
+			CMM_STORE_SHARED(ht->split_count[i].add, 0);
+			CMM_STORE_SHARED(ht->split_count[i].del, 0);
+		}
 	}
-	return ret;
+	CMM_STORE_SHARED(ht->count, 0);
+	mutex_unlock(&ht->resize_mutex);
+	changelog_overflow(ht);
+	if (sync)
+		cds_lfht_resize_lazy_count(ht, size, 0);
+	return work.nr_cleared;
 }
 
-int cds_lfht_is_node_deleted(struct cds_lfht_node *node)
+unsigned long cds_lfht_clear(struct cds_lfht *ht,
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv)
 {
-	return is_removed(CMM_LOAD_SHARED(node->next));
+	return _cds_lfht_clear(ht, free_fct, priv, 1);
 }
 
 static
-int cds_lfht_delete_bucket(struct cds_lfht *ht)
+void lfht_filter_free(struct lfht_filter *filter)
 {
-	struct cds_lfht_node *node;
-	unsigned long order, i, size;
+	if (!filter)
+		return;
+	urcu_free(filter->blocks);
+	urcu_free(filter);
+}
 
-	/* Check that the table is empty */
-	node = bucket_at(ht, 0);
-	do {
-		node = clear_flag(node)->next;
-		if (!is_bucket(node))
-			return -EPERM;
-		assert(!is_removed(node));
-		assert(!is_removal_owner(node));
-	} while (!is_end(node));
-	/*
-	 * size accessed without rcu_dereference because hash table is
-	 * being destroyed.
-	 */
-	size = ht->size;
-	/* Internal sanity check: all nodes left should be buckets */
-	for (i = 0; i < size; i++) {
-		node = bucket_at(ht, i);
-		dbg_printf("delete bucket: index %lu expected hash %lu hash %lu\n",
-			i, i, bit_reverse_ulong(node->reverse_hash));
-		assert(is_bucket(node->next));
+/* Empty filter for @nr_entries, rounded up to a power of 2 of blocks. */
+static
+struct lfht_filter *lfht_filter_alloc(unsigned long nr_entries)
+{
+	struct lfht_filter *filter;
+	unsigned long nr_blocks;
+
+	nr_blocks = (nr_entries / LFHT_FILTER_BLOCK_BITS + 1)
+		* LFHT_FILTER_BITS_PER_ENTRY;
+	nr_blocks = 1UL << cds_lfht_get_count_order_ulong(nr_blocks);
+	filter = urcu_malloc(sizeof(*filter));
+	if (!filter)
+		return NULL;
+	if (urcu_posix_memalign((void **) &filter->blocks, CAA_CACHE_LINE_SIZE,
+			nr_blocks * sizeof(*filter->blocks))) {
+		urcu_free(filter);
+		return NULL;
 	}
+	memset(filter->blocks, 0, nr_blocks * sizeof(*filter->blocks));
+	filter->nr_blocks = nr_blocks;
+	return filter;
+}
 
-	for (order = cds_lfht_get_count_order_ulong(size); (long)order >= 0; order--)
-		cds_lfht_free_bucket_table(ht, order);
+/*
+ * The new filter is published to adds first, through filter_next, and
+ * a grace period waited for: the adds which did not see it are then
+ * complete, and their nodes are found by the traversal setting the
+ * bits of the nodes already in the table. Lookups go on with the old
+ * filter, which adds keep updating, until the new one is complete.
+ */
+int cds_lfht_filter_rebuild(struct cds_lfht *ht, unsigned long nr_entries)
+{
+	struct lfht_filter *filter, *old;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	if (!nr_entries) {
+		long approx_before, approx_after;
 
+		ht->flavor->read_lock();
+		cds_lfht_count_nodes(ht, &approx_before, &nr_entries,
+				&approx_after);
+		ht->flavor->read_unlock();
+	}
+	filter = lfht_filter_alloc(nr_entries);
+	if (!filter)
+		return -ENOMEM;
+	mutex_lock(&ht->filter_mutex);
+	rcu_set_pointer(&ht->filter_next, filter);
+	ht->flavor->update_synchronize_rcu();
+	ht->flavor->read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		lfht_filter_set(filter,
+			bit_reverse_ulong(node_reverse_hash(ht, node)));
+	ht->flavor->read_unlock();
+	old = ht->filter;
+	rcu_set_pointer(&ht->filter, filter);
+	/* No lookup nor add uses the old filter past this grace period. */
+	ht->flavor->update_synchronize_rcu();
+	CMM_STORE_SHARED(ht->filter_next, NULL);
+	mutex_unlock(&ht->filter_mutex);
+	lfht_filter_free(old);
 	return 0;
 }
 
+void cds_lfht_filter_disable(struct cds_lfht *ht)
+{
+	struct lfht_filter *old;
+
+	mutex_lock(&ht->filter_mutex);
+	old = ht->filter;
+	rcu_set_pointer(&ht->filter, NULL);
+	ht->flavor->update_synchronize_rcu();
+	mutex_unlock(&ht->filter_mutex);
+	lfht_filter_free(old);
+}
+
+int cds_lfht_destroy_with_nodes(struct cds_lfht *ht,
+		void (*free_fct)(struct cds_lfht_node *node, void *priv),
+		void *priv, pthread_attr_t **attr)
+{
+	(void) _cds_lfht_clear(ht, free_fct, priv, 0);
+	return cds_lfht_destroy(ht, attr);
+}
+
 /*
  * Should only be called when no more concurrent readers nor writers can
  * possibly access the table.
@@ -1835,8 +4106,13 @@ int cds_lfht_destroy(struct cds_lfht *ht, pthread_attr_t **attr)
 		/* Cancel ongoing resize operations. */
 		_CMM_STORE_SHARED(ht->in_progress_destroy, 1);
 		/* Wait for in-flight resize operations to complete */
-		urcu_workqueue_flush_queued_work(cds_lfht_workqueue);
+		urcu_workqueue_flush_queued_work(ht->resize_workqueue);
 	}
+	/* Complete pending incremental growth and bucket tables free. */
+	mutex_lock(&ht->resize_mutex);
+	incremental_resize_finish(ht);
+	bucket_free_flush(ht, 0);
+	mutex_unlock(&ht->resize_mutex);
 	ret = cds_lfht_delete_bucket(ht);
 	if (ret)
 		return ret;
@@ -1846,12 +4122,46 @@ int cds_lfht_destroy(struct cds_lfht *ht, pthread_attr_t **attr)
 	ret = pthread_mutex_destroy(&ht->resize_mutex);
 	if (ret)
 		ret = -EBUSY;
-	if (ht->flags & CDS_LFHT_AUTO_RESIZE)
+	(void) pthread_mutex_destroy(&ht->filter_mutex);
+	lfht_filter_free(ht->filter);
+	changelog_free(ht->changelog);
+	if (ht->flags & CDS_LFHT_AUTO_RESIZE) {
+		if (ht->resize_pool)
+			uatomic_dec(&ht->resize_pool->refcount);
 		cds_lfht_fini_worker(ht->flavor);
+	}
 	poison_free(ht);
 	return ret;
 }
 
+void cds_lfht_set_node_hash(struct cds_lfht *ht,
+		cds_lfht_node_hash_fct hash_fct, void *priv)
+{
+	ht->node_hash_priv = priv;
+	ht->node_hash = hash_fct;
+}
+
+void cds_lfht_set_resize_latency(struct cds_lfht *ht, unsigned long max_us)
+{
+	CMM_STORE_SHARED(ht->resize_latency_us, max_us);
+}
+
+int cds_lfht_count_fast(struct cds_lfht *ht, unsigned long *count)
+{
+	long sum = 0;
+	int i;
+
+	if (!ht->split_count)
+		return -EINVAL;
+	for (i = 0; i < split_count_mask + 1; i++) {
+		sum += uatomic_read(&ht->split_count[i].add);
+		sum -= uatomic_read(&ht->split_count[i].del);
+	}
+	/* Concurrent updates may be observed out of order. */
+	*count = sum > 0 ? sum : 0;
+	return 0;
+}
+
 void cds_lfht_count_nodes(struct cds_lfht *ht,
 		long *approx_before,
 		unsigned long *count,
@@ -1900,6 +4210,245 @@ void cds_lfht_count_nodes(struct cds_lfht *ht,
 	}
 }
 
+static
+void stats_add_chain(struct cds_lfht_stats *stats, unsigned long len)
+{
+	stats->chain_len[min(len, CDS_LFHT_STATS_NR_CHAIN_LEN - 1)]++;
+	stats->max_chain_len = max(stats->max_chain_len, len);
+	/* Looking up the n-th node of a chain visits n nodes. */
+	stats->nr_probes += (unsigned long long) len * (len + 1) / 2;
+}
+
+void cds_lfht_get_stats(struct cds_lfht *ht, struct cds_lfht_stats *stats)
+{
+	struct cds_lfht_node *node, *next;
+	unsigned long chain_len = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->size = rcu_dereference(ht->size);
+
+	/* The first node is the bucket node of index 0. */
+	node = bucket_at(ht, 0);
+	do {
+		next = rcu_dereference(node->next);
+		if (is_bucket(next)) {
+			if (stats->nr_bucket_nodes)
+				stats_add_chain(stats, chain_len);
+			chain_len = 0;
+			stats->nr_bucket_nodes++;
+		} else if (is_removed(next)) {
+			stats->nr_removed++;
+		} else {
+			chain_len++;
+			stats->nr_nodes++;
+		}
+		node = clear_flag(next);
+	} while (!is_end(node));
+	stats_add_chain(stats, chain_len);
+}
+
+/* Bytes of the bucket node table allocated for an order. */
+static
+size_t order_bucket_bytes(struct cds_lfht *ht, unsigned long order)
+{
+	if (order == 0)
+		return ht->min_nr_alloc_buckets * sizeof(struct cds_lfht_node);
+	if (order > ht->min_alloc_buckets_order)
+		return (1UL << (order - 1)) * sizeof(struct cds_lfht_node);
+	/* Merged in order 0 for 0 < order && order <= min_alloc_buckets_order */
+	return 0;
+}
+
+static
+void mem_info_add_order(struct cds_lfht *ht, struct cds_lfht_mem_info *info,
+		unsigned long order)
+{
+	size_t bytes = order_bucket_bytes(ht, order);
+
+	if (order < CDS_LFHT_MEM_INFO_NR_ORDERS)
+		info->order_bytes[order] = bytes;
+	info->bucket_bytes += bytes;
+}
+
+void cds_lfht_get_mem_info(struct cds_lfht *ht, struct cds_lfht_mem_info *info)
+{
+	unsigned long order, size_order;
+
+	memset(info, 0, sizeof(*info));
+	info->mm = ht->mm;
+	info->max_nr_buckets = ht->max_nr_buckets;
+	info->min_nr_alloc_buckets = ht->min_nr_alloc_buckets;
+	if (ht->mm == &cds_lfht_mm_chunk)
+		info->ht_bytes = max(offsetof(struct cds_lfht, tbl_chunk)
+				+ sizeof(struct cds_lfht_node *)
+					* (ht->max_nr_buckets
+						/ ht->min_nr_alloc_buckets),
+				sizeof(struct cds_lfht));
+	else
+		info->ht_bytes = sizeof(struct cds_lfht);
+	if (ht->split_count)
+		info->split_count_bytes = (split_count_mask + 1)
+				* sizeof(struct ht_items_count);
+
+	/* Bucket tables are only allocated and freed under resize_mutex. */
+	mutex_lock(&ht->resize_mutex);
+	info->size = CMM_LOAD_SHARED(ht->size);
+	size_order = cds_lfht_get_count_order_ulong(info->size);
+	for (order = 0; order <= size_order; order++)
+		mem_info_add_order(ht, info, order);
+	/* Order being populated by an incremental resize. */
+	if (ht->incr_resize_order)
+		mem_info_add_order(ht, info, ht->incr_resize_order);
+	/* Orders removed by a shrink, freed after a grace period. */
+	if (bucket_free_pending(ht)) {
+		for (order = ht->bucket_free_first_order;
+				order <= ht->bucket_free_last_order; order++)
+			mem_info_add_order(ht, info, order);
+	}
+	mutex_unlock(&ht->resize_mutex);
+
+	/*
+	 * The mmap backends reserve the address space of max_nr_buckets
+	 * bucket nodes when the table is created, and populate it as the
+	 * table grows.
+	 */
+	if ((ht->mm == &cds_lfht_mm_mmap || ht->mm == &cds_lfht_mm_mmap_huge)
+			&& ht->min_nr_alloc_buckets < ht->max_nr_buckets)
+		info->reserved_bucket_bytes = ht->max_nr_buckets
+				* sizeof(struct cds_lfht_node);
+	else
+		info->reserved_bucket_bytes = info->bucket_bytes;
+}
+
+size_t cds_lfht_stats_snapshot(struct cds_lfht *ht, const char *name,
+		char *buf, size_t len)
+{
+	struct urcu_workqueue *workqueue;
+	struct cds_lfht_mem_info info;
+	struct urcu_stats_buf b;
+	char p[128];
+
+	cds_lfht_get_mem_info(ht, &info);
+	workqueue = CMM_LOAD_SHARED(ht->resize_workqueue);
+	(void) snprintf(p, sizeof(p), "cds_lfht.%s", name);
+	urcu_stats_init(&b, buf, len);
+	urcu_stats_put(&b, p, "nr_buckets", info.size);
+	urcu_stats_put(&b, p, "count",
+		(unsigned long) max(CMM_LOAD_SHARED(ht->count), 0L));
+	urcu_stats_put(&b, p, "resize_target",
+		CMM_LOAD_SHARED(ht->resize_target));
+	urcu_stats_put(&b, p, "resize_initiated",
+		CMM_LOAD_SHARED(ht->resize_initiated));
+	urcu_stats_put(&b, p, "bucket_bytes", info.bucket_bytes);
+	urcu_stats_put(&b, p, "reserved_bucket_bytes",
+		info.reserved_bucket_bytes);
+	urcu_stats_put(&b, p, "resize_backlog",
+		workqueue ? urcu_workqueue_get_backlog(workqueue) : 0);
+	return b.pos;
+}
+
+/*
+ * Frozen snapshot: open-addressing table with linear probing. Each slot
+ * keeps the node hash next to the node pointer, so probing only touches
+ * the slot array, four slots per 64-byte cache line on 64-bit. The
+ * table is kept at most 3/4 full, so probes always reach an empty slot.
+ */
+struct frozen_slot {
+	unsigned long hash;
+	struct cds_lfht_node *node;	/* NULL: empty slot */
+};
+
+struct cds_lfht_frozen {
+	unsigned long mask;		/* number of slots - 1 */
+	unsigned long nr_nodes;
+	struct frozen_slot *slots;
+};
+
+static
+int frozen_fill(struct cds_lfht *ht, struct cds_lfht_frozen *frozen)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long max_nodes = frozen->mask + 1 - ((frozen->mask + 1) >> 2);
+
+	frozen->nr_nodes = 0;
+	cds_lfht_for_each(ht, &iter, node) {
+		unsigned long hash, i;
+
+		/* Nodes added after the node count need more room. */
+		if (frozen->nr_nodes == max_nodes)
+			return -ENOSPC;
+		hash = bit_reverse_ulong(node_reverse_hash(ht, node));
+		for (i = hash & frozen->mask; frozen->slots[i].node;
+				i = (i + 1) & frozen->mask)
+			;
+		frozen->slots[i].hash = hash;
+		frozen->slots[i].node = node;
+		frozen->nr_nodes++;
+	}
+	return 0;
+}
+
+struct cds_lfht_frozen *cds_lfht_freeze(struct cds_lfht *ht)
+{
+	struct cds_lfht_frozen *frozen;
+	unsigned long nr_slots;
+	long approx_before, approx_after;
+	unsigned long count;
+
+	frozen = urcu_calloc(1, sizeof(*frozen));
+	if (!frozen)
+		return NULL;
+	cds_lfht_count_nodes(ht, &approx_before, &count, &approx_after);
+	/* Twice the number of nodes keeps probe sequences short. */
+	nr_slots = 1UL << cds_lfht_get_count_order_ulong(max(2 * count, 2UL));
+	for (;;) {
+		size_t len = nr_slots * sizeof(struct frozen_slot);
+
+		if (urcu_posix_memalign((void **) &frozen->slots,
+				CAA_CACHE_LINE_SIZE, len)) {
+			urcu_free(frozen);
+			return NULL;
+		}
+		memset(frozen->slots, 0, len);
+		frozen->mask = nr_slots - 1;
+		if (!frozen_fill(ht, frozen))
+			return frozen;
+		urcu_free(frozen->slots);
+		nr_slots <<= 1;
+	}
+}
+
+struct cds_lfht_node *cds_lfht_frozen_lookup(
+		const struct cds_lfht_frozen *frozen, unsigned long hash,
+		cds_lfht_match_fct match, const void *key)
+{
+	const struct frozen_slot *slot;
+	unsigned long i;
+
+	for (i = hash & frozen->mask;; i = (i + 1) & frozen->mask) {
+		slot = &frozen->slots[i];
+		if (!slot->node)
+			return NULL;
+		if (slot->hash == hash
+		    && (!match || caa_likely(match(slot->node, key))))
+			return slot->node;
+	}
+}
+
+unsigned long cds_lfht_frozen_count(const struct cds_lfht_frozen *frozen)
+{
+	return frozen->nr_nodes;
+}
+
+void cds_lfht_frozen_destroy(struct cds_lfht_frozen *frozen)
+{
+	if (!frozen)
+		return;
+	urcu_free(frozen->slots);
+	poison_free(frozen);
+}
+
 /* called with resize mutex held */
 static
 void _do_cds_lfht_grow(struct cds_lfht *ht,
@@ -1947,12 +4496,17 @@ void _do_cds_lfht_resize(struct cds_lfht *ht)
 		if (CMM_LOAD_SHARED(ht->in_progress_destroy))
 			break;
 		ht->resize_initiated = 1;
+		bucket_free_flush(ht, 1);
+		incremental_resize_finish(ht);
 		old_size = ht->size;
 		new_size = CMM_LOAD_SHARED(ht->resize_target);
+		urcu_trace3(lfht_resize_start, ht, old_size, new_size);
 		if (old_size < new_size)
 			_do_cds_lfht_grow(ht, old_size, new_size);
 		else if (old_size > new_size)
 			_do_cds_lfht_shrink(ht, old_size, new_size);
+		urcu_trace2(lfht_resize_end, ht, ht->size);
+		resize_record_time(ht);
 		ht->resize_initiated = 0;
 		/* write resize_initiated before read resize_target */
 		cmm_smp_mb();
@@ -1983,6 +4537,35 @@ void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size)
 	mutex_unlock(&ht->resize_mutex);
 }
 
+unsigned long cds_lfht_trim(struct cds_lfht *ht)
+{
+	unsigned long count, target, size;
+
+	if (cds_lfht_count_fast(ht, &count)) {
+		long approx_before, approx_after;
+
+		flavor_read_lock(ht);
+		cds_lfht_count_nodes(ht, &approx_before, &count, &approx_after);
+		flavor_read_unlock(ht);
+	}
+	/* Resize targets are powers of two, as for automatic resize. */
+	target = max(count >> ht->resize_policy.target_load_order,
+			MIN_TABLE_SIZE);
+	target = 1UL << cds_lfht_get_count_order_ulong(target);
+	CMM_STORE_SHARED(ht->resize_initiated, 1);
+	mutex_lock(&ht->resize_mutex);
+	incremental_resize_finish(ht);
+	if (target < ht->size)
+		resize_target_update_count(ht, target);
+	/* Also completes a resize queued meanwhile, as resize_initiated is set. */
+	_do_cds_lfht_resize(ht);
+	/* Release the bucket tables now rather than after a grace period. */
+	bucket_free_flush(ht, 1);
+	size = ht->size;
+	mutex_unlock(&ht->resize_mutex);
+	return size;
+}
+
 static
 void do_resize_cb(struct urcu_work *work)
 {
@@ -1990,34 +4573,144 @@ void do_resize_cb(struct urcu_work *work)
 		caa_container_of(work, struct resize_work, work);
 	struct cds_lfht *ht = resize_work->ht;
 
-	ht->flavor->register_thread();
+	flavor_register_thread(ht);
 	mutex_lock(&ht->resize_mutex);
 	_do_cds_lfht_resize(ht);
 	mutex_unlock(&ht->resize_mutex);
-	ht->flavor->unregister_thread();
+	flavor_unregister_thread(ht);
 	poison_free(work);
 }
 
+static
+void do_resize_async_cb(struct urcu_work *work)
+{
+	struct cds_lfht_resize_handle *handle =
+		caa_container_of(work, struct cds_lfht_resize_handle, work);
+	struct cds_lfht *ht = handle->ht;
+	unsigned long size, target;
+
+	flavor_register_thread(ht);
+	mutex_lock(&ht->resize_mutex);
+	resize_target_update_count(ht, handle->new_size);
+	incremental_resize_finish(ht);
+	/* The table size is the power of two above the target. */
+	size = ht->size;
+	target = 1UL << cds_lfht_get_count_order_ulong(
+			max(handle->new_size, MIN_TABLE_SIZE));
+	target = min(target, ht->max_nr_buckets);
+	handle->nr_buckets_base = uatomic_read(&ht->resize_nr_buckets);
+	handle->nr_buckets_total = size < target ? target - size : size - target;
+	cmm_smp_wmb();	/* write progress base before state */
+	CMM_STORE_SHARED(handle->state, RESIZE_HANDLE_RUNNING);
+	_do_cds_lfht_resize(ht);
+	handle->size = ht->size;
+	mutex_unlock(&ht->resize_mutex);
+	if (handle->done_fct)
+		handle->done_fct(ht, handle->size, handle->priv);
+	flavor_unregister_thread(ht);
+	cmm_smp_mb();	/* complete callback before state */
+	CMM_STORE_SHARED(handle->state, RESIZE_HANDLE_DONE);
+}
+
+struct cds_lfht_resize_handle *cds_lfht_resize_async(struct cds_lfht *ht,
+		unsigned long new_size, cds_lfht_resize_done_fct done_fct,
+		void *priv)
+{
+	struct cds_lfht_resize_handle *handle;
+
+	if (!(ht->flags & CDS_LFHT_AUTO_RESIZE)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	handle = urcu_calloc(1, sizeof(*handle));
+	if (!handle) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	handle->ht = ht;
+	handle->new_size = new_size;
+	handle->done_fct = done_fct;
+	handle->priv = priv;
+	handle->state = RESIZE_HANDLE_QUEUED;
+	/* Lazy resize is performed by the queued work. */
+	CMM_STORE_SHARED(ht->resize_initiated, 1);
+	urcu_workqueue_queue_work(CMM_LOAD_SHARED(ht->resize_workqueue),
+		&handle->work, do_resize_async_cb);
+	return handle;
+}
+
+int cds_lfht_resize_poll(struct cds_lfht_resize_handle *handle,
+		unsigned long *nr_done, unsigned long *nr_total)
+{
+	int state = CMM_LOAD_SHARED(handle->state);
+	unsigned long done = 0, total = 0;
+
+	cmm_smp_rmb();	/* read state before progress */
+	switch (state) {
+	case RESIZE_HANDLE_QUEUED:
+		break;
+	case RESIZE_HANDLE_RUNNING:
+		total = handle->nr_buckets_total;
+		done = uatomic_read(&handle->ht->resize_nr_buckets)
+			- handle->nr_buckets_base;
+		/* Concurrent resizes of the table add to the progress. */
+		done = min(done, total);
+		break;
+	case RESIZE_HANDLE_DONE:
+		done = total = handle->nr_buckets_total;
+		break;
+	}
+	if (nr_done)
+		*nr_done = done;
+	if (nr_total)
+		*nr_total = total;
+	return state == RESIZE_HANDLE_DONE;
+}
+
+void cds_lfht_resize_wait(struct cds_lfht_resize_handle *handle)
+{
+	while (!cds_lfht_resize_poll(handle, NULL, NULL))
+		(void) poll(NULL, 0, 10);
+	cmm_smp_mb();	/* read state before handle reuse */
+}
+
+int cds_lfht_resize_handle_destroy(struct cds_lfht_resize_handle *handle)
+{
+	if (!cds_lfht_resize_poll(handle, NULL, NULL))
+		return -EBUSY;
+	poison_free(handle);
+	return 0;
+}
+
 static
 void __cds_lfht_resize_lazy_launch(struct cds_lfht *ht)
 {
 	struct resize_work *work;
 
+	/* Growth is performed by updaters in incremental resize mode. */
+	if ((ht->flags & CDS_LFHT_INCREMENTAL_RESIZE)
+			&& CMM_LOAD_SHARED(ht->resize_target) > ht->size)
+		return;
 	/* Store resize_target before read resize_initiated */
 	cmm_smp_mb();
 	if (!CMM_LOAD_SHARED(ht->resize_initiated)) {
 		if (CMM_LOAD_SHARED(ht->in_progress_destroy)) {
 			return;
 		}
-		work = malloc(sizeof(*work));
+		work = urcu_malloc(sizeof(*work));
 		if (work == NULL) {
 			dbg_printf("error allocating resize work, bailing out\n");
 			return;
 		}
 		work->ht = ht;
-		urcu_workqueue_queue_work(cds_lfht_workqueue,
-			&work->work, do_resize_cb);
+		/*
+		 * Set resize_initiated before queuing: the worker may
+		 * complete the resize and clear it before we return.
+		 */
 		CMM_STORE_SHARED(ht->resize_initiated, 1);
+		/* Ahead of other work: lookups walk longer chains meanwhile. */
+		urcu_workqueue_queue_work_prio(ht->resize_workqueue,
+			&work->work, do_resize_cb, URCU_WORKQUEUE_PRIO_HIGH);
 	}
 }
 
@@ -2026,6 +4719,8 @@ void cds_lfht_resize_lazy_grow(struct cds_lfht *ht, unsigned long size, int grow
 {
 	unsigned long target_size = size << growth;
 
+	if (resize_too_early(ht))
+		return;
 	target_size = min(target_size, ht->max_nr_buckets);
 	if (resize_target_grow(ht, target_size) >= target_size)
 		return;
@@ -2048,6 +4743,8 @@ void cds_lfht_resize_lazy_count(struct cds_lfht *ht, unsigned long size,
 	count = min(count, ht->max_nr_buckets);
 	if (count == size)
 		return;		/* Already the right size, no resize needed */
+	if (resize_too_early(ht))
+		return;
 	if (count > size) {	/* lazy grow */
 		if (resize_target_grow(ht, count) >= count)
 			return;
@@ -2068,11 +4765,26 @@ void cds_lfht_resize_lazy_count(struct cds_lfht *ht, unsigned long size,
 	__cds_lfht_resize_lazy_launch(ht);
 }
 
+/* Apply fct to all resize pool workqueues. */
+static void resize_pools_for_each(void (*fct)(struct urcu_workqueue *workqueue))
+{
+	struct cds_lfht_resize_pool *pool;
+	unsigned int i;
+
+	cds_list_for_each_entry(pool, &cds_lfht_resize_pools, node) {
+		for (i = 0; i < pool->nr_workers; i++)
+			fct(pool->workqueue[i]);
+	}
+}
+
 static void cds_lfht_before_fork(void *priv)
 {
 	if (cds_lfht_workqueue_atfork_nesting++)
 		return;
 	mutex_lock(&cds_lfht_fork_mutex);
+	resize_pools_for_each(urcu_workqueue_pause_worker);
+	if (cds_lfht_partition_workqueue)
+		urcu_workqueue_pause_worker(cds_lfht_partition_workqueue);
 	if (!cds_lfht_workqueue)
 		return;
 	urcu_workqueue_pause_worker(cds_lfht_workqueue);
@@ -2082,6 +4794,9 @@ static void cds_lfht_after_fork_parent(void *priv)
 {
 	if (--cds_lfht_workqueue_atfork_nesting)
 		return;
+	resize_pools_for_each(urcu_workqueue_resume_worker);
+	if (cds_lfht_partition_workqueue)
+		urcu_workqueue_resume_worker(cds_lfht_partition_workqueue);
 	if (!cds_lfht_workqueue)
 		goto end;
 	urcu_workqueue_resume_worker(cds_lfht_workqueue);
@@ -2093,6 +4808,9 @@ static void cds_lfht_after_fork_child(void *priv)
 {
 	if (--cds_lfht_workqueue_atfork_nesting)
 		return;
+	resize_pools_for_each(urcu_workqueue_create_worker);
+	if (cds_lfht_partition_workqueue)
+		urcu_workqueue_create_worker(cds_lfht_partition_workqueue);
 	if (!cds_lfht_workqueue)
 		goto end;
 	urcu_workqueue_create_worker(cds_lfht_workqueue);
@@ -2107,6 +4825,16 @@ static struct urcu_atfork cds_lfht_atfork = {
 };
 
 /* Block all signals to ensure we don't disturb the application. */
+static void cds_lfht_worker_init(struct urcu_workqueue *workqueue,
+		void *priv);
+
+static void cds_lfht_partition_worker_init(struct urcu_workqueue *workqueue,
+		void *priv)
+{
+	URCU_TLS(cds_lfht_partition_worker) = 1;
+	cds_lfht_worker_init(workqueue, priv);
+}
+
 static void cds_lfht_worker_init(struct urcu_workqueue *workqueue,
 		void *priv)
 {
@@ -2131,6 +4859,8 @@ static void cds_lfht_init_worker(const struct rcu_flavor_struct *flavor)
 		goto end;
 	cds_lfht_workqueue = urcu_workqueue_create(0, -1, NULL,
 		NULL, cds_lfht_worker_init, NULL, NULL, NULL, NULL, NULL);
+	/* Start resizes without delay, while the chains grow. */
+	urcu_workqueue_set_batch(cds_lfht_workqueue, 0, 0);
 end:
 	mutex_unlock(&cds_lfht_fork_mutex);
 }
@@ -2142,8 +4872,76 @@ static void cds_lfht_fini_worker(const struct rcu_flavor_struct *flavor)
 		goto end;
 	urcu_workqueue_destroy(cds_lfht_workqueue);
 	cds_lfht_workqueue = NULL;
+	if (cds_lfht_partition_workqueue) {
+		urcu_workqueue_destroy(cds_lfht_partition_workqueue);
+		cds_lfht_partition_workqueue = NULL;
+	}
 end:
 	mutex_unlock(&cds_lfht_fork_mutex);
 
 	flavor->unregister_rculfhash_atfork(&cds_lfht_atfork);
 }
+
+struct cds_lfht_resize_pool *cds_lfht_resize_pool_create(unsigned int nr_workers)
+{
+	struct cds_lfht_resize_pool *pool;
+	unsigned int i;
+
+	if (!nr_workers)
+		return NULL;
+	pool = urcu_calloc(1, sizeof(*pool)
+			+ nr_workers * sizeof(pool->workqueue[0]));
+	if (!pool)
+		return NULL;
+	pool->nr_workers = nr_workers;
+	for (i = 0; i < nr_workers; i++) {
+		pool->workqueue[i] = urcu_workqueue_create(0, -1, NULL,
+			NULL, cds_lfht_worker_init, NULL, NULL, NULL, NULL,
+			NULL);
+		urcu_workqueue_set_batch(pool->workqueue[i], 0, 0);
+	}
+	mutex_lock(&cds_lfht_fork_mutex);
+	cds_list_add(&pool->node, &cds_lfht_resize_pools);
+	mutex_unlock(&cds_lfht_fork_mutex);
+	return pool;
+}
+
+int cds_lfht_resize_pool_destroy(struct cds_lfht_resize_pool *pool)
+{
+	unsigned int i;
+
+	if (uatomic_read(&pool->refcount))
+		return -EBUSY;
+	mutex_lock(&cds_lfht_fork_mutex);
+	cds_list_del(&pool->node);
+	mutex_unlock(&cds_lfht_fork_mutex);
+	for (i = 0; i < pool->nr_workers; i++)
+		urcu_workqueue_destroy(pool->workqueue[i]);
+	poison_free(pool);
+	return 0;
+}
+
+int cds_lfht_set_resize_pool(struct cds_lfht *ht,
+		struct cds_lfht_resize_pool *pool)
+{
+	struct urcu_workqueue *workqueue;
+
+	if (!(ht->flags & CDS_LFHT_AUTO_RESIZE))
+		return -EINVAL;
+	if (pool) {
+		unsigned long worker;
+
+		worker = uatomic_add_return(&pool->next_worker, 1);
+		workqueue = pool->workqueue[worker % pool->nr_workers];
+		uatomic_inc(&pool->refcount);
+	} else {
+		workqueue = cds_lfht_workqueue;
+	}
+	/* Wait for resize operations queued on the previous worker. */
+	urcu_workqueue_flush_queued_work(ht->resize_workqueue);
+	if (ht->resize_pool)
+		uatomic_dec(&ht->resize_pool->refcount);
+	ht->resize_pool = pool;
+	CMM_STORE_SHARED(ht->resize_workqueue, workqueue);
+	return 0;
+}
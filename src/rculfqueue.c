@@ -57,3 +57,9 @@ cds_lfq_dequeue_rcu(struct cds_lfq_queue_rcu *q)
 {
 	return _cds_lfq_dequeue_rcu(q);
 }
+
+unsigned long cds_lfq_dequeue_bulk_rcu(struct cds_lfq_queue_rcu *q,
+		struct cds_lfq_node_rcu **nodes, unsigned long n)
+{
+	return _cds_lfq_dequeue_bulk_rcu(q, nodes, n);
+}
@@ -0,0 +1,362 @@
+/*
+ * rcuskiplist.c
+ *
+ * Userspace RCU library - Lock-Free RCU Skip List
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Based on the lock-free skip list of Fraser, as described by Herlihy
+ * and Shavit ("The Art of Multiprocessor Programming", 14.4), with RCU
+ * providing the existence guarantees instead of garbage collection.
+ *
+ * Each level is a sorted Harris linked list. A node is logically
+ * removed once the removal flag is set in its level 0 next pointer,
+ * after being set at the levels above, top-down. Updaters unlink
+ * flagged nodes they meet on their way (see skiplist_find()), and the
+ * remover unlinks its node from all levels before returning, so the
+ * node is unreachable when its grace period starts. Readers never
+ * write: they step over flagged nodes.
+ *
+ * A node is linked at level 0 first, which adds it to the list, then at
+ * the levels above. Its remover waits for the adder to finish linking
+ * the tower before unlinking it, otherwise the adder could link the
+ * node at a level once already unlinked.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <poll.h>
+
+#include <urcu-pointer.h>
+#include <urcu-call-rcu.h>
+#include <urcu-flavor.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+#include <urcu/compiler.h>
+#include <urcu/debug.h>
+#include <urcu/tls-compat.h>
+#include <urcu/rcuskiplist.h>
+
+#define REMOVED_FLAG		(1UL << 0)
+
+/* Wait for an adder: active attempts, then sleep period in ms. */
+#define SKIPLIST_ADAPT_ATTEMPTS	10
+#define SKIPLIST_WAIT		10
+
+struct cds_skiplist {
+	cds_skiplist_cmp_fct cmp;
+	const struct rcu_flavor_struct *flavor;
+	struct cds_skiplist_node *head;	/* Tower of CDS_SKIPLIST_MAX_LEVEL */
+};
+
+static DEFINE_URCU_TLS(uint32_t, skiplist_seed);
+
+static
+struct cds_skiplist_node *clear_flag(struct cds_skiplist_node *node)
+{
+	return (struct cds_skiplist_node *) (((unsigned long) node) & ~REMOVED_FLAG);
+}
+
+static
+int is_removed(struct cds_skiplist_node *node)
+{
+	return ((unsigned long) node) & REMOVED_FLAG;
+}
+
+static
+struct cds_skiplist_node *flag_removed(struct cds_skiplist_node *node)
+{
+	return (struct cds_skiplist_node *) (((unsigned long) node) | REMOVED_FLAG);
+}
+
+unsigned int cds_skiplist_random_level(void)
+{
+	uint32_t x = URCU_TLS(skiplist_seed);
+	unsigned int level = 1;
+
+	if (caa_unlikely(!x))
+		x = (uint32_t) (uintptr_t) &URCU_TLS(skiplist_seed) | 1;
+	/* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	URCU_TLS(skiplist_seed) = x;
+	/* Promote to the next level for each pair of zero bits. */
+	while (level < CDS_SKIPLIST_MAX_LEVEL && !(x & 3)) {
+		level++;
+		x >>= 2;
+	}
+	return level;
+}
+
+/*
+ * Find the predecessors and successors of @key at each level, unlinking
+ * the removed nodes met on the way. succs[i] is the first node of
+ * level i whose key is not lower than @key. Returns non-zero if
+ * succs[0] holds @key.
+ */
+static
+int skiplist_find(struct cds_skiplist *list, const void *key,
+		struct cds_skiplist_node **preds,
+		struct cds_skiplist_node **succs)
+{
+	struct cds_skiplist_node *pred, *curr, *succ, *old;
+	int level;
+
+retry:
+	pred = list->head;
+	for (level = CDS_SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+		curr = clear_flag(rcu_dereference(pred->next[level]));
+		while (curr) {
+			succ = rcu_dereference(curr->next[level]);
+			if (is_removed(succ)) {
+				/* Unlink curr at this level. */
+				old = uatomic_cmpxchg(&pred->next[level], curr,
+						clear_flag(succ));
+				if (old != curr)
+					goto retry;	/* pred changed or removed. */
+				curr = clear_flag(succ);
+				continue;
+			}
+			if (list->cmp(curr, key) >= 0)
+				break;
+			pred = curr;
+			curr = clear_flag(succ);
+		}
+		preds[level] = pred;
+		succs[level] = curr;
+	}
+	return succs[0] && !list->cmp(succs[0], key);
+}
+
+/*
+ * Read-side search: the first node of level 0 whose key is not lower
+ * than @key, stepping over removed nodes. Returns NULL if none.
+ */
+static
+struct cds_skiplist_node *skiplist_search(struct cds_skiplist *list,
+		const void *key)
+{
+	struct cds_skiplist_node *pred, *curr, *succ;
+	int level;
+
+	pred = list->head;
+	curr = NULL;
+	for (level = CDS_SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+		curr = clear_flag(rcu_dereference(pred->next[level]));
+		while (curr) {
+			succ = rcu_dereference(curr->next[level]);
+			if (!is_removed(succ)) {
+				if (list->cmp(curr, key) >= 0)
+					break;
+				pred = curr;
+			}
+			curr = clear_flag(succ);
+		}
+	}
+	return curr;
+}
+
+struct cds_skiplist *_cds_skiplist_new(cds_skiplist_cmp_fct cmp,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_skiplist *list;
+
+	list = urcu_calloc(1, sizeof(*list));
+	if (!list)
+		return NULL;
+	list->head = urcu_calloc(1,
+			cds_skiplist_node_size(CDS_SKIPLIST_MAX_LEVEL));
+	if (!list->head) {
+		urcu_free(list);
+		return NULL;
+	}
+	cds_skiplist_node_init(list->head, CDS_SKIPLIST_MAX_LEVEL);
+	list->head->linked = 1;
+	list->cmp = cmp;
+	list->flavor = flavor;
+	return list;
+}
+
+int cds_skiplist_destroy(struct cds_skiplist *list)
+{
+	struct cds_skiplist_node *node;
+
+	/* Removed nodes left linked are not in use anymore. */
+	for (node = list->head->next[0]; node; node = clear_flag(node->next[0])) {
+		if (!is_removed(node->next[0]))
+			return -EPERM;
+	}
+	urcu_free(list->head);
+	urcu_free(list);
+	return 0;
+}
+
+struct cds_skiplist_node *cds_skiplist_lookup(struct cds_skiplist *list,
+		const void *key)
+{
+	struct cds_skiplist_node *node;
+
+	node = skiplist_search(list, key);
+	if (node && !list->cmp(node, key))
+		return node;
+	return NULL;
+}
+
+struct cds_skiplist_node *cds_skiplist_lower_bound(struct cds_skiplist *list,
+		const void *key)
+{
+	return skiplist_search(list, key);
+}
+
+struct cds_skiplist_node *cds_skiplist_first(struct cds_skiplist *list)
+{
+	return cds_skiplist_next(list, list->head);
+}
+
+struct cds_skiplist_node *cds_skiplist_next(struct cds_skiplist *list,
+		struct cds_skiplist_node *node)
+{
+	struct cds_skiplist_node *next;
+
+	next = clear_flag(rcu_dereference(node->next[0]));
+	while (next) {
+		node = rcu_dereference(next->next[0]);
+		if (!is_removed(node))
+			break;
+		next = clear_flag(node);
+	}
+	return next;
+}
+
+struct cds_skiplist_node *cds_skiplist_next_range(struct cds_skiplist *list,
+		struct cds_skiplist_node *node, const void *hi)
+{
+	if (!node)
+		return NULL;
+	node = cds_skiplist_next(list, node);
+	if (node && list->cmp(node, hi) > 0)
+		return NULL;
+	return node;
+}
+
+struct cds_skiplist_node *cds_skiplist_lookup_range(struct cds_skiplist *list,
+		const void *lo, const void *hi)
+{
+	struct cds_skiplist_node *node;
+
+	node = skiplist_search(list, lo);
+	if (node && list->cmp(node, hi) > 0)
+		return NULL;
+	return node;
+}
+
+struct cds_skiplist_node *cds_skiplist_add_unique(struct cds_skiplist *list,
+		const void *key, struct cds_skiplist_node *node)
+{
+	struct cds_skiplist_node *preds[CDS_SKIPLIST_MAX_LEVEL];
+	struct cds_skiplist_node *succs[CDS_SKIPLIST_MAX_LEVEL];
+	struct cds_skiplist_node *old;
+	unsigned int level, i;
+
+	urcu_assert(list->flavor->read_ongoing());
+	level = node->level;
+	urcu_assert(level >= 1 && level <= CDS_SKIPLIST_MAX_LEVEL);
+	node->key = key;
+	node->linked = 0;
+	for (;;) {
+		if (skiplist_find(list, key, preds, succs))
+			return succs[0];
+		for (i = 0; i < level; i++)
+			node->next[i] = succs[i];
+		/* Implicit memory barriers publish the node content. */
+		old = uatomic_cmpxchg(&preds[0]->next[0], succs[0], node);
+		if (old == succs[0])
+			break;
+	}
+	for (i = 1; i < level; i++) {
+		for (;;) {
+			old = CMM_LOAD_SHARED(node->next[i]);
+			if (is_removed(old))
+				goto end;	/* Being removed: stop. */
+			if (old != succs[i] && uatomic_cmpxchg(&node->next[i],
+					old, succs[i]) != old)
+				continue;
+			if (uatomic_cmpxchg(&preds[i]->next[i], succs[i],
+					node) == succs[i])
+				break;
+			skiplist_find(list, key, preds, succs);
+			if (is_removed(CMM_LOAD_SHARED(node->next[0])))
+				goto end;
+		}
+	}
+end:
+	/* Links before flag, for the remover waiting for it. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(node->linked, 1);
+	return node;
+}
+
+int cds_skiplist_del(struct cds_skiplist *list,
+		struct cds_skiplist_node *node)
+{
+	struct cds_skiplist_node *preds[CDS_SKIPLIST_MAX_LEVEL];
+	struct cds_skiplist_node *succs[CDS_SKIPLIST_MAX_LEVEL];
+	struct cds_skiplist_node *next, *old;
+	unsigned int attempt = 0;
+	int i;
+
+	urcu_assert(list->flavor->read_ongoing());
+	/* Flag the levels top-down: the winner of level 0 is the remover. */
+	for (i = (int) node->level - 1; i >= 0; i--) {
+		next = CMM_LOAD_SHARED(node->next[i]);
+		for (;;) {
+			if (is_removed(next)) {
+				if (!i)
+					return -ENOENT;
+				break;
+			}
+			old = uatomic_cmpxchg(&node->next[i], next,
+					flag_removed(next));
+			if (old == next)
+				break;
+			next = old;
+		}
+	}
+	/* Wait for the adder to stop linking the tower. */
+	while (!CMM_LOAD_SHARED(node->linked)) {
+		if (++attempt >= SKIPLIST_ADAPT_ATTEMPTS) {
+			(void) poll(NULL, 0, SKIPLIST_WAIT);	/* Wait for 10ms */
+			attempt = 0;
+		} else {
+			caa_cpu_relax();
+		}
+	}
+	/* Read linked flag before the links. */
+	cmm_smp_mb();
+	/* Unlink from all levels. */
+	(void) skiplist_find(list, node->key, preds, succs);
+	return 0;
+}
+
+int cds_skiplist_is_node_deleted(struct cds_skiplist_node *node)
+{
+	return is_removed(CMM_LOAD_SHARED(node->next[0]));
+}
@@ -0,0 +1,371 @@
+/*
+ * rcuslab.c
+ *
+ * Userspace RCU library - RCU-aware object cache with per-thread magazines
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+#include <urcu/list.h>
+#include <urcu/rcuslab.h>
+#include "urcu-die.h"
+
+/* Objects per chunk allocated on refill: at least this many bytes. */
+#define RCU_SLAB_CHUNK_BYTES	16384
+
+/*
+ * Header before each object. owner never changes. next links the
+ * object in the free, remote or batch list it is on. head is used by
+ * the first object of a batch waiting for a grace period.
+ */
+struct rcu_slab_obj {
+	struct rcu_slab_cache *owner;
+	struct rcu_slab_obj *next;
+	struct rcu_head head;
+};
+
+/*
+ * Per-thread magazine. free and batch are only accessed by the thread
+ * using the magazine. remote is a stack of objects handed back by other
+ * threads and by grace period callbacks, with lock-free push, and taken
+ * all at once by the owner with an exchange, hence free from ABA.
+ */
+struct rcu_slab_cache {
+	struct cds_rcu_slab *slab;
+	struct rcu_slab_obj *free;
+	struct rcu_slab_obj *batch;
+	unsigned int nr_batch;
+	int dead;			/* Thread exited: can be adopted. */
+	struct cds_list_head list;	/* In slab->caches. */
+	struct rcu_slab_obj *remote __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/* Objects are carved from chunks, only freed on destroy. */
+struct rcu_slab_chunk {
+	struct cds_list_head list;
+};
+
+struct cds_rcu_slab {
+	size_t align;			/* Object alignment. */
+	size_t obj_offset;		/* Object offset in its stride. */
+	size_t stride;			/* Object and header size. */
+	size_t data_offset;		/* First stride offset in a chunk. */
+	unsigned long chunk_objs;	/* Objects per chunk. */
+	void (*slab_call_rcu)(struct rcu_head *head,
+		void (*func)(struct rcu_head *head));
+	pthread_key_t key;		/* Magazine of the thread. */
+	pthread_mutex_t lock;		/* Protects the fields below. */
+	struct cds_list_head caches;
+	struct cds_list_head chunks;
+	unsigned long nr_objs;		/* Objects carved from chunks. */
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static size_t align_up(size_t size, size_t align)
+{
+	return (size + align - 1) & ~(align - 1);
+}
+
+static struct rcu_slab_obj *obj_header(void *ptr)
+{
+	return (struct rcu_slab_obj *) ((char *) ptr
+			- sizeof(struct rcu_slab_obj));
+}
+
+static void *obj_ptr(struct rcu_slab_obj *obj)
+{
+	return (char *) obj + sizeof(struct rcu_slab_obj);
+}
+
+/* Hand the chain @first to @last back to its owner. */
+static void remote_push(struct rcu_slab_cache *owner,
+		struct rcu_slab_obj *first, struct rcu_slab_obj *last)
+{
+	struct rcu_slab_obj *old, *head;
+
+	head = CMM_LOAD_SHARED(owner->remote);
+	do {
+		old = head;
+		last->next = old;
+		/* cmpxchg orders the next store before publication. */
+		head = uatomic_cmpxchg(&owner->remote, old, first);
+	} while (head != old);
+}
+
+/*
+ * Grace period callback of a batch: hand each run of objects of a
+ * same owner back with a single push.
+ */
+static void batch_free_cb(struct rcu_head *head)
+{
+	struct rcu_slab_obj *obj, *first, *next;
+
+	obj = caa_container_of(head, struct rcu_slab_obj, head);
+	while (obj) {
+		first = obj;
+		while (obj->next && obj->next->owner == first->owner)
+			obj = obj->next;
+		next = obj->next;
+		remote_push(first->owner, first, obj);
+		obj = next;
+	}
+}
+
+static void cache_flush(struct rcu_slab_cache *cache)
+{
+	struct rcu_slab_obj *batch = cache->batch;
+
+	if (!batch)
+		return;
+	cache->batch = NULL;
+	cache->nr_batch = 0;
+	cache->slab->slab_call_rcu(&batch->head, batch_free_cb);
+}
+
+/* Thread exit. */
+static void cache_release(void *arg)
+{
+	struct rcu_slab_cache *cache = arg;
+	struct cds_rcu_slab *slab = cache->slab;
+
+	cache_flush(cache);
+	mutex_lock(&slab->lock);
+	cache->dead = 1;
+	mutex_unlock(&slab->lock);
+}
+
+/*
+ * Magazine of the calling thread: the magazine of an exited thread if
+ * any, a new one otherwise. Returns NULL with errno set on error.
+ */
+static struct rcu_slab_cache *get_cache(struct cds_rcu_slab *slab)
+{
+	struct rcu_slab_cache *cache, *iter;
+	int ret;
+
+	cache = pthread_getspecific(slab->key);
+	if (caa_likely(cache))
+		return cache;
+	mutex_lock(&slab->lock);
+	cds_list_for_each_entry(iter, &slab->caches, list) {
+		if (iter->dead) {
+			iter->dead = 0;
+			cache = iter;
+			break;
+		}
+	}
+	if (!cache) {
+		ret = urcu_posix_memalign((void **) &cache, CAA_CACHE_LINE_SIZE,
+				sizeof(*cache));
+		if (ret) {
+			mutex_unlock(&slab->lock);
+			errno = ret;
+			return NULL;
+		}
+		cache->slab = slab;
+		cache->free = NULL;
+		cache->batch = NULL;
+		cache->nr_batch = 0;
+		cache->dead = 0;
+		cache->remote = NULL;
+		cds_list_add(&cache->list, &slab->caches);
+	}
+	mutex_unlock(&slab->lock);
+	ret = pthread_setspecific(slab->key, cache);
+	if (ret)
+		urcu_die(ret);
+	return cache;
+}
+
+/* Carve a new chunk into the free list of @cache. */
+static int cache_refill(struct rcu_slab_cache *cache)
+{
+	struct cds_rcu_slab *slab = cache->slab;
+	struct rcu_slab_chunk *chunk;
+	struct rcu_slab_obj *obj;
+	unsigned long i;
+	char *data;
+	int ret;
+
+	ret = urcu_posix_memalign((void **) &chunk, caa_max(slab->align,
+			sizeof(void *)), slab->data_offset
+			+ slab->chunk_objs * slab->stride);
+	if (ret) {
+		errno = ret;
+		return -1;
+	}
+	mutex_lock(&slab->lock);
+	cds_list_add(&chunk->list, &slab->chunks);
+	slab->nr_objs += slab->chunk_objs;
+	mutex_unlock(&slab->lock);
+	data = (char *) chunk + slab->data_offset;
+	for (i = slab->chunk_objs; i-- > 0; ) {
+		obj = obj_header(data + i * slab->stride
+				+ slab->obj_offset);
+		obj->owner = cache;
+		obj->next = cache->free;
+		cache->free = obj;
+	}
+	return 0;
+}
+
+struct cds_rcu_slab *cds_rcu_slab_create(size_t size, size_t align,
+		void (*slab_call_rcu)(struct rcu_head *head,
+			void (*func)(struct rcu_head *head)))
+{
+	struct cds_rcu_slab *slab;
+	int ret;
+
+	if (!align)
+		align = 2 * sizeof(void *);
+	if (align & (align - 1)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	align = caa_max(align, sizeof(void *));
+	slab = urcu_calloc(1, sizeof(*slab));
+	if (!slab)
+		return NULL;
+	slab->align = align;
+	slab->obj_offset = align_up(sizeof(struct rcu_slab_obj), align);
+	slab->stride = align_up(slab->obj_offset + size, align);
+	slab->data_offset = align_up(sizeof(struct rcu_slab_chunk), align);
+	slab->chunk_objs = caa_max(CDS_RCU_SLAB_BATCH,
+			RCU_SLAB_CHUNK_BYTES / slab->stride);
+	slab->slab_call_rcu = slab_call_rcu;
+	ret = pthread_key_create(&slab->key, cache_release);
+	if (ret) {
+		urcu_free(slab);
+		errno = ret;
+		return NULL;
+	}
+	pthread_mutex_init(&slab->lock, NULL);
+	CDS_INIT_LIST_HEAD(&slab->caches);
+	CDS_INIT_LIST_HEAD(&slab->chunks);
+	return slab;
+}
+
+int cds_rcu_slab_destroy(struct cds_rcu_slab *slab)
+{
+	struct rcu_slab_cache *cache, *tmp_cache;
+	struct rcu_slab_chunk *chunk, *tmp_chunk;
+	struct rcu_slab_obj *obj;
+	unsigned long nr_free = 0;
+
+	mutex_lock(&slab->lock);
+	cds_list_for_each_entry(cache, &slab->caches, list) {
+		for (obj = cache->free; obj; obj = obj->next)
+			nr_free++;
+		for (obj = uatomic_read(&cache->remote); obj; obj = obj->next)
+			nr_free++;
+	}
+	mutex_unlock(&slab->lock);
+	if (nr_free != slab->nr_objs)
+		return -EBUSY;
+	(void) pthread_key_delete(slab->key);
+	cds_list_for_each_entry_safe(cache, tmp_cache, &slab->caches, list)
+		urcu_free(cache);
+	cds_list_for_each_entry_safe(chunk, tmp_chunk, &slab->chunks, list)
+		urcu_free(chunk);
+	(void) pthread_mutex_destroy(&slab->lock);
+	urcu_free(slab);
+	return 0;
+}
+
+void *cds_rcu_slab_alloc(struct cds_rcu_slab *slab)
+{
+	struct rcu_slab_cache *cache;
+	struct rcu_slab_obj *obj;
+
+	cache = get_cache(slab);
+	if (caa_unlikely(!cache))
+		return NULL;
+	obj = cache->free;
+	if (caa_unlikely(!obj)) {
+		/* Take back all the objects handed back by others. */
+		obj = uatomic_xchg(&cache->remote, NULL);
+		if (!obj) {
+			if (cache_refill(cache))
+				return NULL;
+			obj = cache->free;
+		}
+	}
+	cache->free = obj->next;
+	return obj_ptr(obj);
+}
+
+void cds_rcu_slab_free(struct cds_rcu_slab *slab, void *ptr)
+{
+	struct rcu_slab_obj *obj = obj_header(ptr);
+
+	if (pthread_getspecific(slab->key) == obj->owner) {
+		obj->next = obj->owner->free;
+		obj->owner->free = obj;
+	} else {
+		remote_push(obj->owner, obj, obj);
+	}
+}
+
+void cds_rcu_slab_free_rcu(struct cds_rcu_slab *slab, void *ptr)
+{
+	struct rcu_slab_obj *obj = obj_header(ptr);
+	struct rcu_slab_cache *cache;
+
+	cache = get_cache(slab);
+	if (caa_unlikely(!cache)) {
+		/* Out of memory for a magazine: batch of one. */
+		obj->next = NULL;
+		slab->slab_call_rcu(&obj->head, batch_free_cb);
+		return;
+	}
+	obj->next = cache->batch;
+	cache->batch = obj;
+	if (++cache->nr_batch == CDS_RCU_SLAB_BATCH)
+		cache_flush(cache);
+}
+
+void cds_rcu_slab_flush(struct cds_rcu_slab *slab)
+{
+	struct rcu_slab_cache *cache;
+
+	cache = pthread_getspecific(slab->key);
+	if (cache)
+		cache_flush(cache);
+}
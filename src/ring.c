@@ -0,0 +1,75 @@
+/*
+ * ring.c
+ *
+ * Userspace RCU library - Bounded Lock-Free Ring Buffers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#undef _LGPL_SOURCE
+#include "urcu/ring.h"
+#define _LGPL_SOURCE
+#include "urcu/static/ring.h"
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+int cds_mpmc_ring_init(struct cds_mpmc_ring *ring, unsigned long capacity)
+{
+	return _cds_mpmc_ring_init(ring, capacity);
+}
+
+void cds_mpmc_ring_destroy(struct cds_mpmc_ring *ring)
+{
+	_cds_mpmc_ring_destroy(ring);
+}
+
+bool cds_mpmc_ring_enqueue(struct cds_mpmc_ring *ring, void *item)
+{
+	return _cds_mpmc_ring_enqueue(ring, item);
+}
+
+bool cds_mpmc_ring_dequeue(struct cds_mpmc_ring *ring, void **item)
+{
+	return _cds_mpmc_ring_dequeue(ring, item);
+}
+
+int cds_spsc_ring_init(struct cds_spsc_ring *ring, unsigned long capacity)
+{
+	return _cds_spsc_ring_init(ring, capacity);
+}
+
+void cds_spsc_ring_destroy(struct cds_spsc_ring *ring)
+{
+	_cds_spsc_ring_destroy(ring);
+}
+
+bool cds_spsc_ring_enqueue(struct cds_spsc_ring *ring, void *item)
+{
+	return _cds_spsc_ring_enqueue(ring, item);
+}
+
+bool cds_spsc_ring_dequeue(struct cds_spsc_ring *ring, void **item)
+{
+	return _cds_spsc_ring_dequeue(ring, item);
+}
+
+unsigned long cds_spsc_ring_dequeue_bulk(struct cds_spsc_ring *ring,
+		void **items, unsigned long count)
+{
+	return _cds_spsc_ring_dequeue_bulk(ring, items, count);
+}
@@ -0,0 +1,363 @@
+/*
+ * shm-rcu.c
+ *
+ * Userspace RCU library - RCU domains shared between processes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/shm-rcu.h>
+
+#include "urcu-die.h"
+
+#define SHM_RCU_MAGIC		0x73686d72U	/* "shmr" */
+#define SHM_RCU_VERSION		1
+
+/*
+ * Active attempts to check for readers before sleeping.
+ */
+#define SHM_RCU_ACTIVE_ATTEMPTS	100
+#define SHM_RCU_SLEEP_DELAY_MS	1
+
+/*
+ * Reader counters use the layout of urcu.h: the low half counts the
+ * nesting, the high half holds the grace period phase.
+ */
+#define SHM_RCU_GP_COUNT	(1UL << 0)
+#define SHM_RCU_GP_CTR_PHASE	(1UL << (sizeof(unsigned long) << 2))
+#define SHM_RCU_GP_CTR_NEST_MASK	(SHM_RCU_GP_CTR_PHASE - 1)
+
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY				= 0,
+	MEMBARRIER_CMD_GLOBAL_EXPEDITED			= (1 << 1),
+	MEMBARRIER_CMD_REGISTER_GLOBAL_EXPEDITED	= (1 << 2),
+};
+
+struct shm_rcu_reader {
+	unsigned long ctr;
+	/* Position in the domain, set at initialization. */
+	uint32_t index;
+	/* Issue memory barriers on the read side, see shm_rcu_fence(). */
+	int32_t fence;
+	/* Owner of the slot, 0 when free. */
+	int32_t pid, tid;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * Everything below is shared between processes: offsets and plain
+ * values only.
+ */
+struct shm_rcu_domain {
+	uint32_t magic, version;
+	uint32_t long_size, nr_readers;
+	/* Updaters issue MEMBARRIER_CMD_GLOBAL_EXPEDITED. */
+	int32_t membarrier;
+	/* Process id of the updater in a grace period, 0 when idle. */
+	int32_t gp_lock;
+	unsigned long gp_ctr __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	struct shm_rcu_reader readers[] __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+};
+
+/*
+ * Whether this process is registered for global expedited membarrier,
+ * so its readers can rely on the barriers sent by updaters.
+ */
+static int shm_rcu_membarrier_registered;
+
+static void shm_rcu_membarrier_register(struct shm_rcu_domain *dp)
+{
+	if (!dp->membarrier || CMM_LOAD_SHARED(shm_rcu_membarrier_registered))
+		return;
+	if (!membarrier(MEMBARRIER_CMD_REGISTER_GLOBAL_EXPEDITED, 0))
+		CMM_STORE_SHARED(shm_rcu_membarrier_registered, 1);
+}
+
+static void smp_mb_master(struct shm_rcu_domain *dp)
+{
+	if (dp->membarrier) {
+		if (membarrier(MEMBARRIER_CMD_GLOBAL_EXPEDITED, 0))
+			urcu_die(errno);
+	} else {
+		cmm_smp_mb();
+	}
+}
+
+/*
+ * Readers of processes registered for global expedited membarrier get
+ * their memory barriers from the updaters, others issue them.
+ */
+static void shm_rcu_fence(struct shm_rcu_reader *rp)
+{
+	if (rp->fence)
+		cmm_smp_mb();
+	else
+		cmm_barrier();
+}
+
+static struct shm_rcu_domain *shm_rcu_reader_domain(struct shm_rcu_reader *rp)
+{
+	return caa_container_of(rp - rp->index, struct shm_rcu_domain,
+			readers[0]);
+}
+
+/*
+ * A process or thread is gone when signaling it fails with ESRCH;
+ * EPERM still means it exists.
+ */
+static int shm_rcu_alive(int32_t pid, int32_t tid)
+{
+	int ret;
+
+#ifdef __NR_tgkill
+	if (tid)
+		ret = syscall(__NR_tgkill, pid, tid, 0);
+	else
+#endif
+		ret = kill(pid, 0);
+	return !ret || errno != ESRCH;
+}
+
+/*
+ * Free the slot of a thread which exited, or whose process died, while
+ * registered. Its counter would otherwise block grace periods forever.
+ */
+static int shm_rcu_reader_reclaim(struct shm_rcu_reader *rp)
+{
+	int32_t pid = CMM_LOAD_SHARED(rp->pid);
+
+	if (!pid || shm_rcu_alive(pid, CMM_LOAD_SHARED(rp->tid)))
+		return 0;
+	CMM_STORE_SHARED(rp->ctr, 0);
+	CMM_STORE_SHARED(rp->tid, 0);
+	cmm_smp_mb();
+	(void) uatomic_cmpxchg(&rp->pid, pid, 0);
+	return 1;
+}
+
+size_t shm_rcu_domain_size(unsigned int nr_readers)
+{
+	return sizeof(struct shm_rcu_domain)
+		+ (size_t) nr_readers * sizeof(struct shm_rcu_reader);
+}
+
+struct shm_rcu_domain *shm_rcu_domain_init(void *mem, size_t len,
+		unsigned int nr_readers)
+{
+	struct shm_rcu_domain *dp = mem;
+	unsigned int i;
+	int mask;
+
+	if (!nr_readers || len < shm_rcu_domain_size(nr_readers)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	memset(dp, 0, shm_rcu_domain_size(nr_readers));
+	dp->version = SHM_RCU_VERSION;
+	dp->long_size = sizeof(unsigned long);
+	dp->nr_readers = nr_readers;
+	dp->gp_ctr = SHM_RCU_GP_COUNT;
+	for (i = 0; i < nr_readers; i++)
+		dp->readers[i].index = i;
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	dp->membarrier = mask >= 0 && (mask & MEMBARRIER_CMD_GLOBAL_EXPEDITED);
+	/* Publish the magic last: attach checks it first. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(dp->magic, SHM_RCU_MAGIC);
+	shm_rcu_membarrier_register(dp);
+	return dp;
+}
+
+struct shm_rcu_domain *shm_rcu_domain_attach(void *mem, size_t len)
+{
+	struct shm_rcu_domain *dp = mem;
+
+	if (len < sizeof(*dp) || CMM_LOAD_SHARED(dp->magic) != SHM_RCU_MAGIC)
+		goto invalid;
+	cmm_smp_mb();
+	if (dp->version != SHM_RCU_VERSION
+			|| dp->long_size != sizeof(unsigned long)
+			|| !dp->nr_readers
+			|| len < shm_rcu_domain_size(dp->nr_readers))
+		goto invalid;
+	shm_rcu_membarrier_register(dp);
+	return dp;
+
+invalid:
+	errno = EINVAL;
+	return NULL;
+}
+
+struct shm_rcu_reader *shm_rcu_register_thread(struct shm_rcu_domain *dp)
+{
+	int32_t pid = getpid();
+	unsigned int pass;
+
+	/* Check the owners of taken slots only when no slot is free. */
+	for (pass = 0; pass < 2 * dp->nr_readers; pass++) {
+		struct shm_rcu_reader *rp = &dp->readers[pass % dp->nr_readers];
+
+		if (CMM_LOAD_SHARED(rp->pid)
+				&& (pass < dp->nr_readers
+					|| !shm_rcu_reader_reclaim(rp)))
+			continue;
+		if (uatomic_cmpxchg(&rp->pid, 0, pid) != 0)
+			continue;
+		CMM_STORE_SHARED(rp->ctr, 0);
+		rp->fence = !CMM_LOAD_SHARED(shm_rcu_membarrier_registered);
+#ifdef SYS_gettid
+		CMM_STORE_SHARED(rp->tid, syscall(SYS_gettid));
+#endif
+		cmm_smp_mb();
+		return rp;
+	}
+	errno = ENOSPC;
+	return NULL;
+}
+
+void shm_rcu_unregister_thread(struct shm_rcu_reader *rp)
+{
+	assert(!(rp->ctr & SHM_RCU_GP_CTR_NEST_MASK));
+	CMM_STORE_SHARED(rp->tid, 0);
+	/* Release the slot after the last use of the counter. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(rp->pid, 0);
+}
+
+void shm_rcu_read_lock(struct shm_rcu_reader *rp)
+{
+	unsigned long tmp;
+
+	tmp = rp->ctr;
+	if (caa_likely(!(tmp & SHM_RCU_GP_CTR_NEST_MASK))) {
+		CMM_STORE_SHARED(rp->ctr,
+			CMM_LOAD_SHARED(shm_rcu_reader_domain(rp)->gp_ctr));
+		/* Set the counter before the critical section. */
+		shm_rcu_fence(rp);
+	} else {
+		CMM_STORE_SHARED(rp->ctr, tmp + SHM_RCU_GP_COUNT);
+	}
+}
+
+void shm_rcu_read_unlock(struct shm_rcu_reader *rp)
+{
+	unsigned long tmp;
+
+	tmp = rp->ctr;
+	/* End the critical section before clearing the counter. */
+	if (caa_likely((tmp & SHM_RCU_GP_CTR_NEST_MASK) == SHM_RCU_GP_COUNT))
+		shm_rcu_fence(rp);
+	CMM_STORE_SHARED(rp->ctr, tmp - SHM_RCU_GP_COUNT);
+}
+
+static void shm_rcu_gp_lock(struct shm_rcu_domain *dp)
+{
+	int32_t pid = getpid(), owner;
+	unsigned int attempts = 0;
+
+	while ((owner = uatomic_cmpxchg(&dp->gp_lock, 0, pid)) != 0) {
+		if (attempts < SHM_RCU_ACTIVE_ATTEMPTS) {
+			attempts++;
+			caa_cpu_relax();
+		} else if (!shm_rcu_alive(owner, 0)) {
+			/*
+			 * The updater died within its grace period. Ours
+			 * flips the phase twice anyway.
+			 */
+			(void) uatomic_cmpxchg(&dp->gp_lock, owner, 0);
+		} else {
+			(void) poll(NULL, 0, SHM_RCU_SLEEP_DELAY_MS);
+		}
+	}
+}
+
+static void shm_rcu_gp_unlock(struct shm_rcu_domain *dp)
+{
+	uatomic_set(&dp->gp_lock, 0);
+}
+
+static int shm_rcu_reader_old(struct shm_rcu_domain *dp,
+		struct shm_rcu_reader *rp)
+{
+	unsigned long v = CMM_LOAD_SHARED(rp->ctr);
+
+	return (v & SHM_RCU_GP_CTR_NEST_MASK)
+		&& ((v ^ dp->gp_ctr) & SHM_RCU_GP_CTR_PHASE);
+}
+
+/*
+ * Wait for the readers in a critical section started before the last
+ * phase flip.
+ */
+static void shm_rcu_wait_readers(struct shm_rcu_domain *dp)
+{
+	unsigned int i;
+
+	for (i = 0; i < dp->nr_readers; i++) {
+		struct shm_rcu_reader *rp = &dp->readers[i];
+		unsigned int attempts = 0;
+
+		while (shm_rcu_reader_old(dp, rp)) {
+			if (attempts < SHM_RCU_ACTIVE_ATTEMPTS) {
+				attempts++;
+				caa_cpu_relax();
+			} else if (!shm_rcu_reader_reclaim(rp)) {
+				(void) poll(NULL, 0, SHM_RCU_SLEEP_DELAY_MS);
+			}
+		}
+	}
+}
+
+void synchronize_shm_rcu(struct shm_rcu_domain *dp)
+{
+	shm_rcu_gp_lock(dp);
+	/*
+	 * Order prior updates before reading the reader counters, in
+	 * every process.
+	 */
+	smp_mb_master(dp);
+	/*
+	 * Two phase flips, as in urcu.c: a reader which loaded the phase
+	 * just before the first flip may store it after the first wait.
+	 */
+	CMM_STORE_SHARED(dp->gp_ctr, dp->gp_ctr ^ SHM_RCU_GP_CTR_PHASE);
+	cmm_smp_mb();
+	shm_rcu_wait_readers(dp);
+	cmm_smp_mb();
+	CMM_STORE_SHARED(dp->gp_ctr, dp->gp_ctr ^ SHM_RCU_GP_CTR_PHASE);
+	cmm_smp_mb();
+	shm_rcu_wait_readers(dp);
+	/* Finish waiting for readers before letting old data be freed. */
+	smp_mb_master(dp);
+	shm_rcu_gp_unlock(dp);
+}
@@ -0,0 +1,194 @@
+/*
+ * srcu.c
+ *
+ * Userspace RCU library - Sleepable RCU domains
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/alloc.h>
+#include <urcu/srcu.h>
+
+#include "compat-getcpu.h"
+#include "urcu-die.h"
+
+/*
+ * Active attempts to check for readers before sleeping.
+ */
+#define SRCU_ACTIVE_ATTEMPTS	100
+#define SRCU_SLEEP_DELAY_MS	1
+
+/*
+ * Readers increment the lock count of the current index on entry, and
+ * the unlock count of the same index on exit, possibly on another CPU.
+ * Both counts only increase, so the readers of an index are all done
+ * when the sum of its unlock counts, read first, equals the sum of its
+ * lock counts.
+ */
+struct srcu_cpu {
+	unsigned long lock[2];
+	unsigned long unlock[2];
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct srcu_domain {
+	/* Grace period counter. Its low bit is the current reader index. */
+	unsigned long completed;
+	unsigned int nr_cpus;
+	struct srcu_cpu *cpus;
+	/* Serializes synchronize_srcu(). */
+	pthread_mutex_t gp_lock;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static struct srcu_cpu *srcu_this_cpu(struct srcu_domain *sp)
+{
+	int cpu = urcu_sched_getcpu();
+
+	if (caa_unlikely(cpu < 0))
+		cpu = 0;
+	return &sp->cpus[(unsigned int) cpu % sp->nr_cpus];
+}
+
+struct srcu_domain *srcu_domain_create(void)
+{
+	struct srcu_domain *sp;
+	long nr_cpus;
+
+	sp = urcu_calloc(1, sizeof(*sp));
+	if (!sp)
+		return NULL;
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	sp->nr_cpus = nr_cpus > 0 ? nr_cpus : 1;
+	if (urcu_posix_memalign((void **) &sp->cpus, CAA_CACHE_LINE_SIZE,
+			sp->nr_cpus * sizeof(*sp->cpus))) {
+		urcu_free(sp);
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset(sp->cpus, 0, sp->nr_cpus * sizeof(*sp->cpus));
+	pthread_mutex_init(&sp->gp_lock, NULL);
+	return sp;
+}
+
+static int srcu_readers_done(struct srcu_domain *sp, int idx)
+{
+	unsigned long locks = 0, unlocks = 0;
+	unsigned int i;
+
+	for (i = 0; i < sp->nr_cpus; i++)
+		unlocks += CMM_LOAD_SHARED(sp->cpus[i].unlock[idx]);
+	/*
+	 * Read unlock counts before lock counts: a reader whose unlock
+	 * is counted has its lock counted too.
+	 */
+	cmm_smp_mb();
+	for (i = 0; i < sp->nr_cpus; i++)
+		locks += CMM_LOAD_SHARED(sp->cpus[i].lock[idx]);
+	return locks == unlocks;
+}
+
+int srcu_domain_destroy(struct srcu_domain *sp)
+{
+	if (!srcu_readers_done(sp, 0) || !srcu_readers_done(sp, 1))
+		return -EBUSY;
+	(void) pthread_mutex_destroy(&sp->gp_lock);
+	urcu_free(sp->cpus);
+	urcu_free(sp);
+	return 0;
+}
+
+int srcu_read_lock(struct srcu_domain *sp)
+{
+	int idx;
+
+	idx = CMM_LOAD_SHARED(sp->completed) & 1;
+	uatomic_inc(&srcu_this_cpu(sp)->lock[idx]);
+	/* Count the reader before its critical section. */
+	cmm_smp_mb();
+	return idx;
+}
+
+void srcu_read_unlock(struct srcu_domain *sp, int idx)
+{
+	/* End the critical section before uncounting the reader. */
+	cmm_smp_mb();
+	uatomic_inc(&srcu_this_cpu(sp)->unlock[idx]);
+}
+
+static void srcu_wait_readers(struct srcu_domain *sp, int idx)
+{
+	unsigned int attempts = 0;
+
+	while (!srcu_readers_done(sp, idx)) {
+		if (attempts < SRCU_ACTIVE_ATTEMPTS) {
+			attempts++;
+			caa_cpu_relax();
+		} else {
+			(void) poll(NULL, 0, SRCU_SLEEP_DELAY_MS);
+		}
+	}
+}
+
+void synchronize_srcu(struct srcu_domain *sp)
+{
+	int idx;
+
+	mutex_lock(&sp->gp_lock);
+	/* Order prior updates before reading the reader counts. */
+	cmm_smp_mb();
+	/*
+	 * Readers which loaded the index before the previous flip may
+	 * only now count themselves on the inactive index: wait for
+	 * them before flipping back to it.
+	 */
+	idx = 1 ^ (sp->completed & 1);
+	srcu_wait_readers(sp, idx);
+	cmm_smp_mb();
+	CMM_STORE_SHARED(sp->completed, sp->completed + 1);
+	cmm_smp_mb();
+	/* New readers use idx now: wait for the readers of the old one. */
+	srcu_wait_readers(sp, idx ^ 1);
+	/* Finish waiting for readers before letting old data be freed. */
+	cmm_smp_mb();
+	mutex_unlock(&sp->gp_lock);
+}
@@ -0,0 +1,166 @@
+/*
+ * urcu-alloc.c
+ *
+ * Userspace RCU library - allocator of the internal allocations
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <urcu/alloc.h>
+
+static void *default_alloc(size_t size, void *priv)
+{
+	return malloc(size);
+}
+
+static void *default_aligned_alloc(size_t alignment, size_t size, void *priv)
+{
+	void *ptr;
+
+	if (posix_memalign(&ptr, alignment, size))
+		return NULL;
+	return ptr;
+}
+
+static void *default_realloc(void *ptr, size_t size, void *priv)
+{
+	return realloc(ptr, size);
+}
+
+static void default_free(void *ptr, void *priv)
+{
+	free(ptr);
+}
+
+static void *default_large_alloc(size_t size, void *priv)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	return ptr;
+}
+
+static void default_large_free(void *ptr, size_t size, void *priv)
+{
+	(void) munmap(ptr, size);
+}
+
+static struct urcu_allocator urcu_allocator = {
+	.alloc = default_alloc,
+	.aligned_alloc = default_aligned_alloc,
+	.realloc = default_realloc,
+	.free = default_free,
+	.large_alloc = default_large_alloc,
+	.large_free = default_large_free,
+};
+
+int urcu_set_allocator(const struct urcu_allocator *allocator)
+{
+	struct urcu_allocator a = {
+		.alloc = default_alloc,
+		.aligned_alloc = default_aligned_alloc,
+		.realloc = default_realloc,
+		.free = default_free,
+		.large_alloc = default_large_alloc,
+		.large_free = default_large_free,
+	};
+
+	if (allocator) {
+		if (!allocator->alloc != !allocator->free
+		    || !allocator->alloc != !allocator->aligned_alloc
+		    || !allocator->alloc != !allocator->realloc)
+			return -EINVAL;
+		if (!allocator->large_alloc != !allocator->large_free)
+			return -EINVAL;
+		if (allocator->alloc) {
+			a.alloc = allocator->alloc;
+			a.aligned_alloc = allocator->aligned_alloc;
+			a.realloc = allocator->realloc;
+			a.free = allocator->free;
+		}
+		if (allocator->large_alloc) {
+			a.large_alloc = allocator->large_alloc;
+			a.large_free = allocator->large_free;
+		}
+		a.priv = allocator->priv;
+	}
+	urcu_allocator = a;
+	return 0;
+}
+
+void *urcu_malloc(size_t size)
+{
+	return urcu_allocator.alloc(size, urcu_allocator.priv);
+}
+
+void *urcu_calloc(size_t nmemb, size_t size)
+{
+	void *ptr;
+
+	if (size && nmemb > SIZE_MAX / size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	ptr = urcu_allocator.alloc(nmemb * size, urcu_allocator.priv);
+	if (ptr)
+		memset(ptr, 0, nmemb * size);
+	return ptr;
+}
+
+int urcu_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *ptr;
+
+	if (!alignment || (alignment & (alignment - 1))
+	    || alignment % sizeof(void *))
+		return EINVAL;
+	ptr = urcu_allocator.aligned_alloc(alignment, size,
+			urcu_allocator.priv);
+	if (!ptr)
+		return ENOMEM;
+	*memptr = ptr;
+	return 0;
+}
+
+void *urcu_realloc(void *ptr, size_t size)
+{
+	return urcu_allocator.realloc(ptr, size, urcu_allocator.priv);
+}
+
+void urcu_free(void *ptr)
+{
+	if (ptr)
+		urcu_allocator.free(ptr, urcu_allocator.priv);
+}
+
+void *urcu_large_alloc(size_t size)
+{
+	return urcu_allocator.large_alloc(size, urcu_allocator.priv);
+}
+
+void urcu_large_free(void *ptr, size_t size)
+{
+	if (ptr)
+		urcu_allocator.large_free(ptr, size, urcu_allocator.priv);
+}
@@ -38,18 +38,24 @@
 
 #include "urcu/arch.h"
 #include "urcu/wfcqueue.h"
+#include "urcu/lfstack.h"
 #include "urcu/map/urcu-bp.h"
 #include "urcu/static/urcu-bp.h"
 #include "urcu-pointer.h"
 #include "urcu/tls-compat.h"
 
 #include "urcu-die.h"
+#include "urcu-gp-stats.h"
+#include "urcu-stall.h"
+#include "urcu-stats.h"
 
 /* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
 #undef _LGPL_SOURCE
 #include "urcu-bp.h"
 #define _LGPL_SOURCE
 
+#include "urcu-poll-impl.h"
+
 #ifndef MAP_ANONYMOUS
 #define MAP_ANONYMOUS MAP_ANON
 #endif
@@ -112,9 +118,11 @@ enum membarrier_cmd {
 };
 
 static
-void __attribute__((constructor)) rcu_bp_init(void);
+void rcu_bp_init(void);
+static
+void rcu_bp_exit(void);
 static
-void __attribute__((destructor)) rcu_bp_exit(void);
+void __attribute__((destructor)) rcu_bp_destructor(void);
 
 #ifndef CONFIG_RCU_FORCE_SYS_MEMBARRIER
 int urcu_bp_has_sys_membarrier;
@@ -125,6 +133,10 @@ int urcu_bp_has_sys_membarrier;
  * synchronize_rcu().
  */
 static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Statistics of the grace periods, see urcu-gp-stats.h. */
+static struct rcu_gp_stats rcu_gp_stats;
+
 /*
  * rcu_registry_lock ensures mutual exclusion between threads
  * registering and unregistering themselves to/from the registry, and
@@ -136,8 +148,23 @@ static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
  */
 static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * arena_lock protects the registry arena. It is never taken by
+ * synchronize_rcu(), so registering a thread does not wait for a grace
+ * period in progress. arena_lock nests inside rcu_registry_lock.
+ */
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * init_lock protects rcu_bp_refcount. The library is initialized by the
+ * first thread registering, rather than by a constructor, so processes
+ * linking the library without using it do not probe sys_membarrier().
+ * That first registration also takes a reference on behalf of the
+ * library, dropped by its destructor, so the registry survives threads
+ * coming and going.
+ */
 static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
-static int initialized;
+static int initialized;		/* Library reference taken */
 
 static pthread_key_t urcu_bp_key;
 
@@ -151,19 +178,33 @@ DEFINE_URCU_TLS(struct rcu_reader *, rcu_reader);
 
 static CDS_LIST_HEAD(registry);
 
+/*
+ * Threads being registered are pushed on this stack, without lock, and
+ * moved to the registry by the next updater holding rcu_registry_lock.
+ */
+static struct __cds_lfs_stack registry_pending;
+
 struct registry_chunk {
 	size_t data_len;		/* data length */
-	size_t used;			/* amount of data used */
+	size_t used;			/* number of slots allocated */
 	struct cds_list_head node;	/* chunk_list node */
 	char data[];
 };
 
+/*
+ * The slots not allocated to a thread are linked in free_list through
+ * their registry node, so that allocating and releasing a slot do not
+ * scan the chunks. Protected by arena_lock.
+ */
 struct registry_arena {
 	struct cds_list_head chunk_list;
+	struct cds_list_head free_list;
+	size_t nr_slots, used;		/* of all chunks */
 };
 
 static struct registry_arena registry_arena = {
 	.chunk_list = CDS_LIST_HEAD_INIT(registry_arena.chunk_list),
+	.free_list = CDS_LIST_HEAD_INIT(registry_arena.free_list),
 };
 
 /* Saved fork signal mask, protected by rcu_gp_lock */
@@ -200,11 +241,32 @@ static void smp_mb_master(void)
 	if (caa_likely(urcu_bp_has_sys_membarrier)) {
 		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
 			urcu_die(errno);
+		uatomic_inc(&rcu_gp_stats.membarriers);
 	} else {
 		cmm_smp_mb();
 	}
 }
 
+/*
+ * Move the threads registered since the last call to the registry.
+ * Called with rcu_registry_lock held.
+ */
+static void registry_splice_pending(void)
+{
+	struct cds_lfs_head *head;
+	struct cds_lfs_node *node, *n;
+
+	head = __cds_lfs_pop_all(&registry_pending);
+	if (!head)
+		return;
+	cds_lfs_for_each_safe(head, node, n) {
+		struct rcu_reader *rcu_reader_reg = caa_container_of(node,
+				struct rcu_reader, pending_node);
+
+		cds_list_add(&rcu_reader_reg->node, &registry);
+	}
+}
+
 /*
  * Always called with rcu_registry lock held. Releases this lock between
  * iterations and grabs it again. Holds the lock when it returns.
@@ -213,8 +275,11 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 			struct cds_list_head *cur_snap_readers,
 			struct cds_list_head *qsreaders)
 {
-	unsigned int wait_loops = 0;
+	unsigned int wait_loops = 0, scans = 0, sleeps = 0;
 	struct rcu_reader *index, *tmp;
+	struct rcu_stall stall;
+
+	rcu_stall_begin(&stall, urcu_time_ns());
 
 	/*
 	 * Wait for each thread URCU_TLS(rcu_reader).ctr to either
@@ -222,6 +287,8 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 	 * rcu_gp.ctr value.
 	 */
 	for (;;) {
+		scans++;
+		rcu_stall_scan(&stall);
 		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
 			wait_loops++;
 
@@ -244,6 +311,7 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 				 * until the snapshot becomes current or
 				 * the reader becomes inactive.
 				 */
+				rcu_stall_reader(&stall, index->tid);
 				break;
 			}
 		}
@@ -253,21 +321,27 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 		} else {
 			/* Temporarily unlock the registry lock. */
 			mutex_unlock(&rcu_registry_lock);
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS)
+			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+				sleeps++;
 				(void) poll(NULL, 0, RCU_SLEEP_DELAY_MS);
-			else
+			} else {
 				caa_cpu_relax();
+			}
 			/* Re-lock the registry lock before the next loop. */
 			mutex_lock(&rcu_registry_lock);
 		}
 	}
+	rcu_gp_stats_wait(&rcu_gp_stats, scans - sleeps, sleeps);
 }
 
 void synchronize_rcu(void)
 {
 	CDS_LIST_HEAD(cur_snap_readers);
 	CDS_LIST_HEAD(qsreaders);
+	struct rcu_gp_stats_clock clock;
 	sigset_t newmask, oldmask;
+	unsigned long cookie;
+	uint64_t lock_ns;
 	int ret;
 
 	ret = sigfillset(&newmask);
@@ -275,10 +349,26 @@ void synchronize_rcu(void)
 	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
 	assert(!ret);
 
+	cookie = get_state_synchronize_rcu();
+	lock_ns = urcu_time_ns();
 	mutex_lock(&rcu_gp_lock);
+	/* Return if a grace period started since the call completed. */
+	if (poll_state_synchronize_rcu(cookie)) {
+		rcu_gp_stats_coalesced(&rcu_gp_stats, 1);
+		goto unlock;
+	}
+	rcu_gp_stats_begin(&rcu_gp_stats, &clock, lock_ns, 1);
 
 	mutex_lock(&rcu_registry_lock);
 
+	rcu_gp_seq_start();
+	/*
+	 * A push not seen by this pop is ordered after it by the full
+	 * barriers implied by both: the first read-side critical section
+	 * of that thread observes the updates preceding this grace
+	 * period, so the thread needs not be waited for.
+	 */
+	registry_splice_pending();
 	if (cds_list_empty(&registry))
 		goto out;
 
@@ -293,6 +383,7 @@ void synchronize_rcu(void)
 	 * interally.
 	 */
 	wait_for_readers(&registry, &cur_snap_readers, &qsreaders);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_WAIT);
 
 	/*
 	 * Adding a cmm_smp_mb() which is _not_ formally required, but makes the
@@ -324,6 +415,7 @@ void synchronize_rcu(void)
 	 * interally.
 	 */
 	wait_for_readers(&cur_snap_readers, NULL, &qsreaders);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_FLIP);
 
 	/*
 	 * Put quiescent reader list back into registry.
@@ -336,12 +428,20 @@ void synchronize_rcu(void)
 	 */
 	smp_mb_master();
 out:
+	rcu_gp_stats_end(&rcu_gp_stats, &clock);
+	rcu_gp_seq_end();
 	mutex_unlock(&rcu_registry_lock);
+unlock:
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 	assert(!ret);
 }
 
+void rcu_gp_get_stats(struct rcu_gp_stats *stats)
+{
+	rcu_gp_stats_read(stats, &rcu_gp_stats);
+}
+
 /*
  * library wrappers to be used by non-LGPL compatible source code.
  */
@@ -361,13 +461,88 @@ int rcu_read_ongoing(void)
 	return _rcu_read_ongoing();
 }
 
+static
+size_t chunk_nr_slots(struct registry_chunk *chunk)
+{
+	return chunk->data_len / sizeof(struct rcu_reader);
+}
+
+/* Add the slots of @chunk from index @first on to the free list. */
+static
+void arena_free_slots(struct registry_arena *arena,
+		struct registry_chunk *chunk, size_t first)
+{
+	struct rcu_reader *slots = (struct rcu_reader *) &chunk->data[0];
+	size_t i;
+
+	for (i = first; i < chunk_nr_slots(chunk); i++) {
+		slots[i].chunk = chunk;
+		cds_list_add_tail(&slots[i].node, &arena->free_list);
+	}
+	arena->nr_slots += chunk_nr_slots(chunk) - first;
+}
+
+/*
+ * Give back the memory left unused at the end of the arena by a spike
+ * of threads: the last chunk is unmapped when none of its slots is
+ * allocated, and otherwise halved when the upper half of its slots is
+ * free. The arena is only shrunk while it is at most a quarter used, so
+ * that a thread count oscillating around a chunk boundary does not map
+ * and unmap memory over and over. The first ARENA_INIT_ALLOC bytes are
+ * kept.
+ */
+static
+void shrink_arena(struct registry_arena *arena)
+{
+	struct registry_chunk *last_chunk, *new_chunk;
+	struct rcu_reader *slots;
+	size_t i, nr, new_nr, chunk_len;
+
+	while (4 * arena->used <= arena->nr_slots) {
+		last_chunk = cds_list_entry(arena->chunk_list.prev,
+			struct registry_chunk, node);
+		slots = (struct rcu_reader *) &last_chunk->data[0];
+		nr = chunk_nr_slots(last_chunk);
+		chunk_len = last_chunk->data_len
+				+ sizeof(struct registry_chunk);
+		if (!last_chunk->used
+				&& arena->chunk_list.next != &last_chunk->node) {
+			for (i = 0; i < nr; i++)
+				cds_list_del(&slots[i].node);
+			arena->nr_slots -= nr;
+			cds_list_del(&last_chunk->node);
+			munmap((void *) last_chunk, chunk_len);
+			continue;
+		}
+		if (chunk_len < 2 * ARENA_INIT_ALLOC)
+			return;
+		new_nr = (chunk_len / 2 - sizeof(struct registry_chunk))
+				/ sizeof(struct rcu_reader);
+		for (i = nr; i-- > new_nr; ) {
+			if (slots[i].alloc)
+				return;
+		}
+		/* Shrinking a mapping never moves it. */
+		new_chunk = mremap_wrapper(last_chunk, chunk_len,
+			chunk_len / 2, 0);
+		if (new_chunk == MAP_FAILED)
+			return;
+		assert(new_chunk == last_chunk);
+		for (i = new_nr; i < nr; i++)
+			cds_list_del(&slots[i].node);
+		arena->nr_slots -= nr - new_nr;
+		last_chunk->data_len =
+			chunk_len / 2 - sizeof(struct registry_chunk);
+	}
+}
+
 /*
  * Only grow for now. If empty, allocate a ARENA_INIT_ALLOC sized chunk.
  * Else, try expanding the last chunk. If this fails, allocate a new
  * chunk twice as big as the last chunk.
- * Memory used by chunks _never_ moves. A chunk could theoretically be
- * freed when all "used" slots are released, but we don't do it at this
- * point.
+ * Memory used by chunks _never_ moves. Chunks are only freed when all
+ * their slots are released, see shrink_arena(). The new slots are added
+ * to the free list.
  */
 static
 void expand_arena(struct registry_arena *arena)
@@ -392,6 +567,7 @@ void expand_arena(struct registry_arena *arena)
 		new_chunk->data_len =
 			new_chunk_len - sizeof(struct registry_chunk);
 		cds_list_add_tail(&new_chunk->node, &arena->chunk_list);
+		arena_free_slots(arena, new_chunk, 0);
 		return;		/* We're done. */
 	}
 
@@ -406,12 +582,15 @@ void expand_arena(struct registry_arena *arena)
 	new_chunk = mremap_wrapper(last_chunk, old_chunk_len,
 		new_chunk_len, 0);
 	if (new_chunk != MAP_FAILED) {
+		size_t old_nr_slots = chunk_nr_slots(last_chunk);
+
 		/* Should not have moved. */
 		assert(new_chunk == last_chunk);
 		memset((char *) last_chunk + old_chunk_len, 0,
 			new_chunk_len - old_chunk_len);
 		last_chunk->data_len =
 			new_chunk_len - sizeof(struct registry_chunk);
+		arena_free_slots(arena, last_chunk, old_nr_slots);
 		return;		/* We're done. */
 	}
 
@@ -427,59 +606,53 @@ void expand_arena(struct registry_arena *arena)
 	new_chunk->data_len =
 		new_chunk_len - sizeof(struct registry_chunk);
 	cds_list_add_tail(&new_chunk->node, &arena->chunk_list);
+	arena_free_slots(arena, new_chunk, 0);
 }
 
 static
 struct rcu_reader *arena_alloc(struct registry_arena *arena)
 {
-	struct registry_chunk *chunk;
 	struct rcu_reader *rcu_reader_reg;
-	int expand_done = 0;	/* Only allow to expand once per alloc */
-	size_t len = sizeof(struct rcu_reader);
 
-retry:
-	cds_list_for_each_entry(chunk, &arena->chunk_list, node) {
-		if (chunk->data_len - chunk->used < len)
-			continue;
-		/* Find spot */
-		for (rcu_reader_reg = (struct rcu_reader *) &chunk->data[0];
-				rcu_reader_reg < (struct rcu_reader *) &chunk->data[chunk->data_len];
-				rcu_reader_reg++) {
-			if (!rcu_reader_reg->alloc) {
-				rcu_reader_reg->alloc = 1;
-				chunk->used += len;
-				return rcu_reader_reg;
-			}
-		}
-	}
-
-	if (!expand_done) {
+	if (cds_list_empty(&arena->free_list)) {
 		expand_arena(arena);
-		expand_done = 1;
-		goto retry;
+		if (cds_list_empty(&arena->free_list))
+			return NULL;
 	}
-
-	return NULL;
+	rcu_reader_reg = cds_list_entry(arena->free_list.next,
+		struct rcu_reader, node);
+	cds_list_del(&rcu_reader_reg->node);
+	rcu_reader_reg->alloc = 1;
+	rcu_reader_reg->chunk->used++;
+	arena->used++;
+	return rcu_reader_reg;
 }
 
-/* Called with signals off and mutex locked */
+/* Called with signals off */
 static
 void add_thread(void)
 {
 	struct rcu_reader *rcu_reader_reg;
 	int ret;
 
+	mutex_lock(&arena_lock);
 	rcu_reader_reg = arena_alloc(&registry_arena);
+	mutex_unlock(&arena_lock);
 	if (!rcu_reader_reg)
 		abort();
 	ret = pthread_setspecific(urcu_bp_key, rcu_reader_reg);
 	if (ret)
 		abort();
 
-	/* Add to registry */
+	/*
+	 * Publish to the updaters. The push implies a full memory
+	 * barrier, ordering it before the first read-side critical
+	 * section of the thread.
+	 */
 	rcu_reader_reg->tid = pthread_self();
 	assert(rcu_reader_reg->ctr == 0);
-	cds_list_add(&rcu_reader_reg->node, &registry);
+	cds_lfs_node_init(&rcu_reader_reg->pending_node);
+	(void) cds_lfs_push(&registry_pending, &rcu_reader_reg->pending_node);
 	/*
 	 * Reader threads are pointing to the reader registry. This is
 	 * why its memory should never be relocated.
@@ -487,42 +660,87 @@ void add_thread(void)
 	URCU_TLS(rcu_reader) = rcu_reader_reg;
 }
 
-/* Called with mutex locked */
-static
-void cleanup_thread(struct registry_chunk *chunk,
-		struct rcu_reader *rcu_reader_reg)
+#ifdef CONFIG_RCU_READER_STATS
+/* Read-side statistics of the exited threads, rcu_registry_lock. */
+static struct urcu_reader_stats rcu_reader_stats_exited;
+
+static void rcu_reader_stats_read(struct rcu_reader *reader,
+		struct urcu_reader_stats *s)
 {
-	rcu_reader_reg->ctr = 0;
-	cds_list_del(&rcu_reader_reg->node);
-	rcu_reader_reg->tid = 0;
-	rcu_reader_reg->alloc = 0;
-	chunk->used -= sizeof(struct rcu_reader);
+	s->read_locks = CMM_LOAD_SHARED(reader->nr_read_locks);
+	s->nested_locks = CMM_LOAD_SHARED(reader->nr_nested_locks);
+	s->nesting_max = CMM_LOAD_SHARED(reader->nesting_max);
+	if (!s->nesting_max && s->read_locks)
+		s->nesting_max = 1;
+	s->quiescent_states = 0;
 }
 
-static
-struct registry_chunk *find_chunk(struct rcu_reader *rcu_reader_reg)
+/* Called with rcu_registry_lock held, before the slot is freed. */
+static void rcu_reader_stats_exit(struct rcu_reader *reader)
 {
-	struct registry_chunk *chunk;
+	struct urcu_reader_stats s;
 
-	cds_list_for_each_entry(chunk, &registry_arena.chunk_list, node) {
-		if (rcu_reader_reg < (struct rcu_reader *) &chunk->data[0])
-			continue;
-		if (rcu_reader_reg >= (struct rcu_reader *) &chunk->data[chunk->data_len])
-			continue;
-		return chunk;
+	rcu_reader_stats_read(reader, &s);
+	urcu_reader_stats_add(&rcu_reader_stats_exited, &s);
+	reader->nr_read_locks = 0;
+	reader->nr_nested_locks = 0;
+	reader->nesting_max = 0;
+}
+
+static void rcu_reader_stats_walk(void (*fct)(void *priv, pthread_t tid,
+			const struct urcu_reader_stats *s),
+		void *priv, struct urcu_reader_stats *exited)
+{
+	struct urcu_reader_stats s;
+	struct rcu_reader *index;
+
+	mutex_lock(&rcu_registry_lock);
+	registry_splice_pending();
+	cds_list_for_each_entry(index, &registry, node) {
+		rcu_reader_stats_read(index, &s);
+		fct(priv, index->tid, &s);
 	}
-	return NULL;
+	*exited = rcu_reader_stats_exited;
+	mutex_unlock(&rcu_registry_lock);
+}
+#define RCU_STATS_READERS
+#else
+static void rcu_reader_stats_exit(struct rcu_reader *reader)
+{
+}
+#endif /* CONFIG_RCU_READER_STATS */
+
+/*
+ * Called with rcu_registry_lock and arena_lock held, after moving the
+ * pending threads to the registry. The slot is reused first, while its
+ * cache lines are likely still hot.
+ */
+static
+void cleanup_thread(struct rcu_reader *rcu_reader_reg)
+{
+	rcu_reader_stats_exit(rcu_reader_reg);
+	rcu_reader_reg->ctr = 0;
+	cds_list_del(&rcu_reader_reg->node);
+	rcu_reader_reg->tid = 0;
+	rcu_reader_reg->alloc = 0;
+	cds_list_add(&rcu_reader_reg->node, &registry_arena.free_list);
+	rcu_reader_reg->chunk->used--;
+	registry_arena.used--;
 }
 
-/* Called with signals off and mutex locked */
+/* Called with signals off and rcu_registry_lock held */
 static
 void remove_thread(struct rcu_reader *rcu_reader_reg)
 {
-	cleanup_thread(find_chunk(rcu_reader_reg), rcu_reader_reg);
+	registry_splice_pending();
+	mutex_lock(&arena_lock);
+	cleanup_thread(rcu_reader_reg);
+	shrink_arena(&registry_arena);
+	mutex_unlock(&arena_lock);
 	URCU_TLS(rcu_reader) = NULL;
 }
 
-/* Disable signals, take mutex, add to registry */
+/* Disable signals, add to registry without waiting for grace periods */
 void rcu_bp_register(void)
 {
 	sigset_t newmask, oldmask;
@@ -542,14 +760,9 @@ void rcu_bp_register(void)
 	if (URCU_TLS(rcu_reader))
 		goto end;
 
-	/*
-	 * Take care of early registration before urcu_bp constructor.
-	 */
 	rcu_bp_init();
 
-	mutex_lock(&rcu_registry_lock);
 	add_thread();
-	mutex_unlock(&rcu_registry_lock);
 end:
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 	if (ret)
@@ -635,6 +848,9 @@ void rcu_bp_init(void)
 		if (ret)
 			abort();
 		rcu_sys_membarrier_init();
+	}
+	if (!initialized) {
+		rcu_bp_refcount++;
 		initialized = 1;
 	}
 	mutex_unlock(&init_lock);
@@ -654,6 +870,9 @@ void rcu_bp_exit(void)
 					+ sizeof(struct registry_chunk));
 		}
 		CDS_INIT_LIST_HEAD(&registry_arena.chunk_list);
+		CDS_INIT_LIST_HEAD(&registry_arena.free_list);
+		registry_arena.nr_slots = registry_arena.used = 0;
+		__cds_lfs_init(&registry_pending);
 		ret = pthread_key_delete(urcu_bp_key);
 		if (ret)
 			abort();
@@ -661,9 +880,22 @@ void rcu_bp_exit(void)
 	mutex_unlock(&init_lock);
 }
 
+static
+void rcu_bp_destructor(void)
+{
+	int drop;
+
+	mutex_lock(&init_lock);
+	drop = initialized;
+	initialized = 0;
+	mutex_unlock(&init_lock);
+	if (drop)
+		rcu_bp_exit();
+}
+
 /*
- * Holding the rcu_gp_lock and rcu_registry_lock across fork will make
- * sure we fork() don't race with a concurrent thread executing with
+ * Holding the rcu_gp_lock, rcu_registry_lock and arena_lock across fork
+ * will make sure we fork() don't race with a concurrent thread executing with
  * any of those locks held. This ensures that the registry and data
  * protected by rcu_gp_lock are in a coherent state in the child.
  */
@@ -678,6 +910,7 @@ void rcu_bp_before_fork(void)
 	assert(!ret);
 	mutex_lock(&rcu_gp_lock);
 	mutex_lock(&rcu_registry_lock);
+	mutex_lock(&arena_lock);
 	saved_fork_signal_mask = oldmask;
 }
 
@@ -687,6 +920,7 @@ void rcu_bp_after_fork_parent(void)
 	int ret;
 
 	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&arena_lock);
 	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
@@ -695,25 +929,28 @@ void rcu_bp_after_fork_parent(void)
 
 /*
  * Prune all entries from registry except our own thread. Fits the Linux
- * fork behavior. Called with rcu_gp_lock and rcu_registry_lock held.
+ * fork behavior. Called with rcu_gp_lock, rcu_registry_lock and
+ * arena_lock held.
  */
 static
 void urcu_bp_prune_registry(void)
 {
 	struct registry_chunk *chunk;
-	struct rcu_reader *rcu_reader_reg;
+	struct rcu_reader *slots;
+	size_t i;
 
+	registry_splice_pending();
 	cds_list_for_each_entry(chunk, &registry_arena.chunk_list, node) {
-		for (rcu_reader_reg = (struct rcu_reader *) &chunk->data[0];
-				rcu_reader_reg < (struct rcu_reader *) &chunk->data[chunk->data_len];
-				rcu_reader_reg++) {
-			if (!rcu_reader_reg->alloc)
+		slots = (struct rcu_reader *) &chunk->data[0];
+		for (i = 0; i < chunk_nr_slots(chunk); i++) {
+			if (!slots[i].alloc)
 				continue;
-			if (rcu_reader_reg->tid == pthread_self())
+			if (slots[i].tid == pthread_self())
 				continue;
-			cleanup_thread(chunk, rcu_reader_reg);
+			cleanup_thread(&slots[i]);
 		}
 	}
+	shrink_arena(&registry_arena);
 }
 
 void rcu_bp_after_fork_child(void)
@@ -723,6 +960,7 @@ void rcu_bp_after_fork_child(void)
 
 	urcu_bp_prune_registry();
 	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&arena_lock);
 	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
@@ -757,3 +995,6 @@ DEFINE_RCU_FLAVOR(rcu_flavor);
 
 #include "urcu-call-rcu-impl.h"
 #include "urcu-defer-impl.h"
+
+#define RCU_STATS_PREFIX	"urcu.bp"
+#include "urcu-stats-impl.h"
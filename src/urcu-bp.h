@@ -56,6 +56,7 @@ extern "C" {
  * publication headers.
  */
 #include <urcu-pointer.h>
+#include <urcu/gp-stats.h>
 
 #ifdef _LGPL_SOURCE
 
@@ -140,6 +141,28 @@ extern void *rcu_set_pointer_sym_bp(void **p, void *v);
 
 extern void synchronize_rcu(void);
 
+/*
+ * Polling grace-period API: a cookie taken before removing data can be
+ * polled to know whether the data can be freed without waiting.
+ */
+extern unsigned long get_state_synchronize_rcu(void);
+extern unsigned long start_poll_synchronize_rcu(void);
+extern int poll_state_synchronize_rcu(unsigned long cookie);
+extern void cond_synchronize_rcu(unsigned long cookie);
+
+/*
+ * Cumulative statistics of the grace periods, see urcu/gp-stats.h.
+ */
+extern void rcu_gp_get_stats(struct rcu_gp_stats *stats);
+
+/*
+ * Statistics of the flavor, its call_rcu and defer_rcu queues, as
+ * "key value" lines. See rcu-api.md.
+ */
+extern size_t rcu_stats_snapshot(char *buf, size_t len);
+extern int rcu_stats_dump(int fd);
+extern int rcu_stats_dump_periodic(int fd, unsigned int period_ms);
+
 /*
  * rcu_bp_before_fork, rcu_bp_after_fork_parent and rcu_bp_after_fork_child
  * should be called around fork() system calls when the child process is not
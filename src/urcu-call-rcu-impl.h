@@ -27,12 +27,18 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <errno.h>
 #include <poll.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include <sched.h>
+#include <fcntl.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 
 #include "compat-getcpu.h"
 #include "urcu/wfcqueue.h"
@@ -40,37 +46,205 @@
 #include "urcu-pointer.h"
 #include "urcu/list.h"
 #include "urcu/futex.h"
+#include "urcu/eventcount.h"
 #include "urcu/tls-compat.h"
 #include "urcu/ref.h"
+#include "urcu/alloc.h"
 #include "urcu-die.h"
+#include "urcu-trace.h"
+#include "urcu-placement.h"
+#include "urcu-time.h"
+
+
+/*
+ * Number of queued callbacks above which a call_rcu thread stops
+ * waiting for more callbacks to batch, and shortens its batching delay.
+ */
+#define CALL_RCU_BUSY_QLEN			1024
+
+/*
+ * Number of callbacks a helper thread takes from a batch at a time.
+ * Callbacks of a chunk are invoked in queue order.
+ */
+#define CALL_RCU_HELPER_CHUNK			64
+
+/* Spins of a busy-polling call_rcu thread between checks of its flags. */
+#define CALL_RCU_BUSY_POLL_SPINS		1024
+
+/*
+ * Default delay after which call_rcu_lazy() callbacks are processed,
+ * in milliseconds, and number of lazy callbacks processed right away.
+ */
+#define CALL_RCU_LAZY_DELAY_MS			10000
+#define CALL_RCU_LAZY_QLEN			10000
+
+/*
+ * Maximum number of sub-queues of the default call_rcu_data, see
+ * struct call_rcu_shard.
+ */
+#define CALL_RCU_MAX_SHARDS			64
+
+/*
+ * Sub-queue of the default call_rcu_data, shared by the call_rcu()
+ * callers of the CPUs it is indexed by, so that the callers of the
+ * other CPUs do not exchange the same tail. qlen is incremented before
+ * the enqueue, and moved to the qlen of the call_rcu_data when the
+ * sub-queue is spliced, by the call_rcu thread only. first_ns is the
+ * time of the first enqueue into the empty sub-queue. node is the index
+ * of the call_rcu_node of its CPU, for URCU_CALL_RCU_NUMA.
+ */
+struct call_rcu_shard {
+	struct cds_wfcq_head head;
+	struct cds_wfcq_tail tail;
+	unsigned long qlen;
+	uint64_t first_ns;
+	unsigned int node;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
-#define SET_AFFINITY_CHECK_PERIOD		(1U << 8)	/* 256 */
-#define SET_AFFINITY_CHECK_PERIOD_MASK		(SET_AFFINITY_CHECK_PERIOD - 1)
+/*
+ * NUMA node of a URCU_CALL_RCU_NUMA call_rcu_data. Before the grace
+ * period, the call_rcu thread splices the sub-queues of the CPUs of the
+ * node in the batch queue. After it, the batch is moved to the exec
+ * queue of the worker thread of the node, which runs on its CPUs, so
+ * that the callbacks free memory to node-local allocator caches.
+ */
+struct call_rcu_node {
+	struct cds_wfcq_head batch_head;
+	struct cds_wfcq_tail batch_tail;
+	struct cds_wfcq_head exec_head;
+	struct cds_wfcq_tail exec_tail;
+	struct call_rcu_data *crdp;
+	struct urcu_placement_shared placement;
+	pthread_t tid;
+	int node;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
 /* Data structure that identifies a call_rcu thread. */
 
 struct call_rcu_data {
 	/*
-	 * We do not align head on a different cache-line than tail
-	 * mainly because call_rcu callback-invocation threads use
-	 * batching ("splice") to get an entire list of callbacks, which
-	 * effectively empties the queue, and requires to touch the tail
-	 * anyway.
+	 * The head is on its own cache line, apart from the tail
+	 * exchanged by call_rcu() on many CPUs, and from the fields
+	 * following the tail, also updated or read by call_rcu(). The
+	 * tail is still touched by the splice of a whole batch.
 	 */
-	struct cds_wfcq_tail cbs_tail;
-	struct cds_wfcq_head cbs_head;
+	struct cds_wfcq_queue cbs;
 	unsigned long flags;
-	int32_t futex;
+	struct cds_eventcount wait_ec;
 	unsigned long qlen; /* maintained for debugging. */
+	/* Sub-queues of the default call_rcu_data, NULL otherwise. */
+	struct call_rcu_shard *shards;
+	unsigned int nr_shards;
 	pthread_t tid;
 	int cpu_affinity;
-	unsigned long gp_count;
+	/* CPUs and scheduling of the thread and its helpers. */
+	struct urcu_placement_shared placement;
+	/* Batching delay bounds, and current delay, in milliseconds. */
+	unsigned int min_delay_ms, max_delay_ms, delay_ms;
+	unsigned long last_qlen;	/* qlen after the previous batch */
+	/* Backpressure watermarks, 0: disabled. */
+	unsigned long high_watermark, low_watermark;
+	int backpressure_mode;
+	int backpressure;		/* high watermark reached */
+	/*
+	 * Callers helping under backpressure and thieves which took
+	 * callbacks from the main queue and did not invoke them yet, see
+	 * call_rcu_take().
+	 */
+	unsigned long takers;
+	/*
+	 * URCU_CALL_RCU_EVENTFD: callbacks spliced by the grace-period
+	 * driver thread, waiting for its grace period, and callbacks
+	 * whose grace period has completed. event_fd[0] is readable
+	 * while ready callbacks are queued, -1 without event fd.
+	 */
+	struct cds_wfcq_head wait_head;
+	struct cds_wfcq_tail wait_tail;
+	struct cds_wfcq_head ready_head;
+	struct cds_wfcq_tail ready_tail;
+	int wait_pending;		/* protected by poll_mutex */
+	int event_fd[2];		/* read, write ends */
+	struct cds_list_head poll_list;	/* in call_rcu_gp_driver */
+	uint64_t wait_oldest_ns, wait_newest_ns;	/* poll_mutex */
+	uint64_t ready_oldest_ns, ready_newest_ns;
+	/*
+	 * Statistics. batch_first_ns is the time of the first enqueue
+	 * into the empty queue. Callbacks queued elsewhere and moved to
+	 * this queue are subtracted from "moved", moved out added to it.
+	 */
+	uint64_t batch_first_ns;
+	pthread_mutex_t stats_lock;
+	struct call_rcu_data_stats stats;	/* stats_lock */
+	unsigned long moved;			/* stats_lock */
+	/*
+	 * Helper pool, see call_rcu_data_set_helpers(). The call_rcu
+	 * thread moves a batch to the exec queue and bumps helper_gen,
+	 * which helper threads wait on. exec_running counts the chunks
+	 * being invoked, exec_futex is the call_rcu thread wait futex.
+	 * rcu_barrier() callbacks are deferred until the whole batch is
+	 * invoked.
+	 */
+	unsigned int nr_helpers;
+	pthread_t *helper_tids;
+	unsigned long helper_flags;	/* URCU_CALL_RCU_PAUSE/STOP */
+	unsigned int nr_helpers_paused;
+	int32_t helper_gen;
+	int32_t exec_futex;
+	unsigned long exec_running, exec_count;
+	struct cds_wfcq_head exec_head;
+	struct cds_wfcq_tail exec_tail;
+	struct cds_wfcq_head deferred_head;
+	struct cds_wfcq_tail deferred_tail;
+	/*
+	 * Node workers of URCU_CALL_RCU_NUMA, which share the pause and
+	 * stop handshake, generation and exec counters of the helpers.
+	 */
+	struct call_rcu_node *nodes;
+	unsigned int nr_nodes;
+	/*
+	 * Expedited callbacks, see call_rcu_expedited(). xp_futex is
+	 * the batching delay wait futex.
+	 */
+	struct cds_wfcq_head xp_head;
+	struct cds_wfcq_tail xp_tail;
+	int32_t xp_futex;
+	/*
+	 * Callbacks queued during the last grace period of the call_rcu
+	 * thread, spliced once it completed, and the
+	 * get_state_synchronize_rcu() cookie taken then: any grace period
+	 * started afterwards, e.g. by another call_rcu thread or by
+	 * synchronize_rcu(), is enough to invoke them. Only accessed by the
+	 * call_rcu thread, and by call_rcu_data_free() once it stopped.
+	 */
+	struct cds_wfcq_head next_head;
+	struct cds_wfcq_tail next_tail;
+	unsigned long next_cookie;
+	uint64_t next_oldest_ns, next_newest_ns;
+	/*
+	 * Lazy callbacks, see call_rcu_lazy(). lazy_qlen is incremented
+	 * before the enqueue, and moved to qlen when the queue is spliced.
+	 * lazy_first_ns is the time of the first enqueue into the empty
+	 * queue.
+	 */
+	struct cds_wfcq_head lazy_head;
+	struct cds_wfcq_tail lazy_tail;
+	unsigned long lazy_qlen;
+	uint64_t lazy_first_ns;
+	unsigned int lazy_delay_ms;
+	unsigned long lazy_qlen_max;
+	/*
+	 * Created by get_call_rcu_data() in lazy mode: the thread exits
+	 * after idle_ms without callbacks. Set when unpublished from its
+	 * CPU, see call_rcu_retire().
+	 */
+	unsigned int idle_ms;
+	int retiring;
 	struct cds_list_head list;
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
 struct call_rcu_completion {
 	int barrier_count;
-	int32_t futex;
+	struct cds_eventcount ec;
 	struct urcu_ref ref;
 };
 
@@ -90,6 +264,47 @@ static CDS_LIST_HEAD(call_rcu_data_list);
 
 static DEFINE_URCU_TLS(struct call_rcu_data *, thread_call_rcu_data);
 
+/*
+ * Set in call_rcu threads, and while a thread invokes callbacks to help
+ * a call_rcu thread: callbacks queueing callbacks must not wait for
+ * themselves.
+ */
+static DEFINE_URCU_TLS(int, call_rcu_no_backpressure);
+
+/*
+ * free_rcu_bulk batch: page-sized array of pointers sharing a free
+ * function, handed to call_rcu as a whole.
+ */
+#define FREE_RCU_BATCH_BYTES	4096
+
+struct free_rcu_batch {
+	struct rcu_head head;
+	void (*free_fct)(void *ptr);
+	unsigned long nr;
+	void *ptrs[];
+};
+
+#define FREE_RCU_BATCH_LEN						\
+	((FREE_RCU_BATCH_BYTES - sizeof(struct free_rcu_batch))		\
+		/ sizeof(void *))
+
+/* Batch being filled by the current thread, or NULL. */
+static DEFINE_URCU_TLS(struct free_rcu_batch *, free_rcu_batch);
+
+/*
+ * Callbacks staged by call_rcu_local() in the current thread, linked
+ * through their next.next field, queued with call_rcu_batch() once
+ * CALL_RCU_LOCAL_LEN are staged.
+ */
+#define CALL_RCU_LOCAL_LEN	64
+
+struct call_rcu_staged {
+	struct rcu_head *first, *last;
+	unsigned long len;
+};
+
+static DEFINE_URCU_TLS(struct call_rcu_staged, call_rcu_staged);
+
 /*
  * Guard call_rcu thread creation and atfork handlers.
  */
@@ -99,9 +314,131 @@ static pthread_mutex_t call_rcu_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static struct call_rcu_data *default_call_rcu_data;
 
+/*
+ * Grace-period driver shared by the call_rcu threads created with
+ * URCU_CALL_RCU_SHARED_GP. Workers request a grace period by
+ * incrementing "requested", and wait for "completed" to reach the
+ * value they got. The driver thread snapshots "requested", waits for a
+ * grace period, and publishes the snapshot in "completed": all the
+ * requests made before the snapshot are served by a single grace
+ * period. Sequence numbers wrap around, and are compared with signed
+ * differences. "completed" is also the futex workers wait on.
+ *
+ * The driver also serves the call_rcu_data created with
+ * URCU_CALL_RCU_EVENTFD, which have no thread: each round splices their
+ * queues before the grace period, and hands the spliced callbacks over
+ * to their ready queue after the grace period.
+ */
+struct call_rcu_gp_driver {
+	int32_t requested;
+	int32_t completed;
+	int32_t nr_waiters;
+	int32_t futex;			/* driver thread wait futex */
+	unsigned long flags;		/* URCU_CALL_RCU_PAUSE/PAUSED */
+	int started;			/* protected by call_rcu_mutex */
+	pthread_t tid;
+	/*
+	 * URCU_CALL_RCU_EVENTFD call_rcu_data, and their waiting queues.
+	 * Nested inside call_rcu_mutex, never held across a grace period.
+	 */
+	pthread_mutex_t poll_mutex;
+	struct cds_list_head poll_list;
+};
+
+static struct call_rcu_gp_driver call_rcu_gp_driver = {
+	.poll_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.poll_list = CDS_LIST_HEAD_INIT(call_rcu_gp_driver.poll_list),
+};
+
 static struct urcu_atfork *registered_rculfhash_atfork;
 static unsigned long registered_rculfhash_atfork_refcount;
 
+/*
+ * Fork pause handshake. The call_rcu, helper and driver threads wait on
+ * call_rcu_resume_seq while paused, and call_rcu_after_fork_parent()
+ * bumps it when resuming them. They bump call_rcu_pause_seq, which the
+ * forking thread waits on, when they enter and leave the paused state.
+ */
+static int32_t call_rcu_pause_seq;
+static int32_t call_rcu_resume_seq;
+
+/*
+ * Lazy fork child, see set_call_rcu_fork_lazy(): the call_rcu_data
+ * inherited from the parent wait on call_rcu_fork_stale_list until
+ * the child first needs the default call_rcu_data.
+ */
+static int call_rcu_fork_lazy;
+static int call_rcu_fork_pending;
+static CDS_LIST_HEAD(call_rcu_fork_stale_list);
+
+static void call_rcu_fork_child_cleanup(void);
+
+/* Read a handshake sequence before checking the state it tracks. */
+static int32_t call_rcu_seq_read(int32_t *seq)
+{
+	int32_t ret = uatomic_read(seq);
+
+	cmm_smp_mb();
+	return ret;
+}
+
+/* Wait for @seq to move from @old, as read by call_rcu_seq_read(). */
+static void call_rcu_seq_wait(int32_t *seq, int32_t old)
+{
+	if (futex_async(seq, FUTEX_WAIT, old, NULL, NULL, 0)
+	    && errno != EAGAIN && errno != EINTR)
+		urcu_die(errno);
+}
+
+/* Bump @seq after changing the state it tracks, and wake its waiters. */
+static void call_rcu_seq_wake(int32_t *seq)
+{
+	cmm_smp_mb__before_uatomic_inc();
+	uatomic_inc(seq);
+	cmm_smp_mb__after_uatomic_inc();
+	if (futex_async(seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) < 0)
+		urcu_die(errno);
+}
+
+/*
+ * Paused thread side of the handshake: set URCU_CALL_RCU_PAUSED in
+ * @flags, wait for URCU_CALL_RCU_PAUSE to be cleared, then clear
+ * URCU_CALL_RCU_PAUSED.
+ */
+static void call_rcu_pause_wait(unsigned long *flags)
+{
+	int32_t seq;
+
+	cmm_smp_mb__before_uatomic_or();
+	uatomic_or(flags, URCU_CALL_RCU_PAUSED);
+	call_rcu_seq_wake(&call_rcu_pause_seq);
+	for (;;) {
+		seq = call_rcu_seq_read(&call_rcu_resume_seq);
+		if (!(uatomic_read(flags) & URCU_CALL_RCU_PAUSE))
+			break;
+		call_rcu_seq_wait(&call_rcu_resume_seq, seq);
+	}
+	uatomic_and(flags, ~URCU_CALL_RCU_PAUSED);
+	cmm_smp_mb__after_uatomic_and();
+	call_rcu_seq_wake(&call_rcu_pause_seq);
+}
+
+/*
+ * Forking thread side: wait until URCU_CALL_RCU_PAUSED is set in
+ * @flags if @paused, cleared otherwise.
+ */
+static void call_rcu_pause_wait_ack(unsigned long *flags, int paused)
+{
+	int32_t seq;
+
+	for (;;) {
+		seq = call_rcu_seq_read(&call_rcu_pause_seq);
+		if (!(uatomic_read(flags) & URCU_CALL_RCU_PAUSED) == !paused)
+			break;
+		call_rcu_seq_wait(&call_rcu_pause_seq, seq);
+	}
+}
+
 /*
  * If the sched_getcpu() and sysconf(_SC_NPROCESSORS_CONF) calls are
  * available, then we can have call_rcu threads assigned to individual
@@ -121,6 +458,15 @@ static unsigned long registered_rculfhash_atfork_refcount;
 static struct call_rcu_data **per_cpu_call_rcu_data;
 static long maxcpus;
 
+/*
+ * Lazy mode, see create_lazy_cpu_call_rcu_data(): flags and idle
+ * timeout of the per-CPU call_rcu_data created on demand. Protected by
+ * call_rcu_mutex.
+ */
+static int lazy_cpu_call_rcu;
+static unsigned long lazy_cpu_flags;
+static unsigned int lazy_cpu_idle_ms;
+
 static void maxcpus_reset(void)
 {
 	maxcpus = 0;
@@ -139,7 +485,7 @@ static void alloc_cpu_call_rcu_data(void)
 	if (maxcpus <= 0) {
 		return;
 	}
-	p = malloc(maxcpus * sizeof(*per_cpu_call_rcu_data));
+	p = urcu_malloc(maxcpus * sizeof(*per_cpu_call_rcu_data));
 	if (p != NULL) {
 		memset(p, '\0', maxcpus * sizeof(*per_cpu_call_rcu_data));
 		rcu_set_pointer(&per_cpu_call_rcu_data, p);
@@ -194,525 +540,2825 @@ static void call_rcu_unlock(pthread_mutex_t *pmp)
 }
 
 /*
- * Periodically retry setting CPU affinity if we migrate.
- * Losing affinity can be caused by CPU hotunplug/hotplug, or by
- * cpuset(7).
+ * Account a batch of @count callbacks, queued between @oldest_ns and
+ * @newest_ns, invoked from @start_ns to @end_ns after @nr_gp grace
+ * periods. The delay of each callback is approximated by the mean delay
+ * of the batch; the histogram counts callbacks by the delay of the
+ * oldest callback of their batch.
  */
-#if HAVE_SCHED_SETAFFINITY
-static
-int set_thread_cpu_affinity(struct call_rcu_data *crdp)
+static void call_rcu_stats_batch(struct call_rcu_data *crdp,
+				 unsigned long count, uint64_t oldest_ns,
+				 uint64_t newest_ns, uint64_t start_ns,
+				 uint64_t end_ns, unsigned long nr_gp)
 {
-	cpu_set_t mask;
-	int ret;
-
-	if (crdp->cpu_affinity < 0)
-		return 0;
-	if (++crdp->gp_count & SET_AFFINITY_CHECK_PERIOD_MASK)
-		return 0;
-	if (urcu_sched_getcpu() == crdp->cpu_affinity)
-		return 0;
+	struct call_rcu_data_stats *stats = &crdp->stats;
+	uint64_t max_ns, min_ns, us;
+	unsigned int bucket = 0;
+
+	if (!oldest_ns || oldest_ns > newest_ns)
+		oldest_ns = newest_ns;
+	max_ns = start_ns > oldest_ns ? start_ns - oldest_ns : 0;
+	min_ns = start_ns > newest_ns ? start_ns - newest_ns : 0;
+	for (us = max_ns / 1000; us > 1
+			&& bucket < URCU_CALL_RCU_STATS_NR_BUCKETS - 1; us >>= 1)
+		bucket++;
+
+	call_rcu_lock(&crdp->stats_lock);
+	stats->invoked += count;
+	stats->batches++;
+	stats->grace_periods += nr_gp;
+	if (max_ns > stats->delay_max_ns)
+		stats->delay_max_ns = max_ns;
+	stats->delay_sum_ns += count * ((max_ns + min_ns) / 2);
+	stats->exec_ns += end_ns > start_ns ? end_ns - start_ns : 0;
+	stats->delay_hist[bucket] += count;
+	call_rcu_unlock(&crdp->stats_lock);
+}
 
-	CPU_ZERO(&mask);
-	CPU_SET(crdp->cpu_affinity, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	ret = sched_setaffinity(0, &mask);
-#else
-	ret = sched_setaffinity(0, sizeof(mask), &mask);
-#endif
-	/*
-	 * EINVAL is fine: can be caused by hotunplugged CPUs, or by
-	 * cpuset(7). This is why we should always retry if we detect
-	 * migration.
-	 */
-	if (ret && errno == EINVAL) {
-		ret = 0;
-		errno = 0;
+/* Callbacks moved from @src to @dst. */
+static void call_rcu_stats_move(struct call_rcu_data *src,
+				struct call_rcu_data *dst,
+				unsigned long count)
+{
+	if (src) {
+		call_rcu_lock(&src->stats_lock);
+		src->moved += count;
+		call_rcu_unlock(&src->stats_lock);
 	}
-	return ret;
+	call_rcu_lock(&dst->stats_lock);
+	dst->moved -= count;
+	call_rcu_unlock(&dst->stats_lock);
 }
-#else
+
+/* Apply the placement of @crdp, see urcu_placement_check(). */
 static
-int set_thread_cpu_affinity(struct call_rcu_data *crdp)
+int set_thread_cpu_affinity(struct call_rcu_data *crdp,
+		struct urcu_placement_thread *placement, int cpu_affinity)
 {
-	return 0;
+	return urcu_placement_check(&crdp->placement, placement,
+			cpu_affinity);
+}
+
+/*
+ * Wait for callbacks for at most @ms milliseconds. Returns whether the
+ * wait timed out.
+ */
+static int call_rcu_wait_timeout(struct call_rcu_data *crdp, unsigned int ms)
+{
+	int ret;
+
+	ret = cds_eventcount_wait_timeout(&crdp->wait_ec,
+			(uint64_t) ms * 1000000ULL);
+	if (ret < 0)
+		urcu_die(errno);
+	return ret;
 }
-#endif
 
 static void call_rcu_wait(struct call_rcu_data *crdp)
 {
-	/* Read call_rcu list before read futex */
-	cmm_smp_mb();
-	if (uatomic_read(&crdp->futex) != -1)
-		return;
-	while (futex_async(&crdp->futex, FUTEX_WAIT, -1,
-			NULL, NULL, 0)) {
-		switch (errno) {
-		case EWOULDBLOCK:
-			/* Value already changed. */
-			return;
-		case EINTR:
-			/* Retry if interrupted by signal. */
-			break;	/* Get out of switch. */
-		default:
-			/* Unexpected error. */
-			urcu_die(errno);
-		}
-	}
+	if (cds_eventcount_wait(&crdp->wait_ec))
+		urcu_die(errno);
 }
 
 static void call_rcu_wake_up(struct call_rcu_data *crdp)
 {
-	/* Write to call_rcu list before reading/writing futex */
-	cmm_smp_mb();
-	if (caa_unlikely(uatomic_read(&crdp->futex) == -1)) {
-		uatomic_set(&crdp->futex, 0);
-		if (futex_async(&crdp->futex, FUTEX_WAKE, 1,
-				NULL, NULL, 0) < 0)
-			urcu_die(errno);
-	}
+	if (cds_eventcount_wake(&crdp->wait_ec))
+		urcu_die(errno);
 }
 
 static void call_rcu_completion_wait(struct call_rcu_completion *completion)
 {
-	/* Read completion barrier count before read futex */
-	cmm_smp_mb();
-	if (uatomic_read(&completion->futex) != -1)
-		return;
-	while (futex_async(&completion->futex, FUTEX_WAIT, -1,
-			NULL, NULL, 0)) {
-		switch (errno) {
-		case EWOULDBLOCK:
-			/* Value already changed. */
-			return;
-		case EINTR:
-			/* Retry if interrupted by signal. */
-			break;	/* Get out of switch. */
-		default:
-			/* Unexpected error. */
-			urcu_die(errno);
-		}
-	}
+	if (cds_eventcount_wait(&completion->ec))
+		urcu_die(errno);
 }
 
 static void call_rcu_completion_wake_up(struct call_rcu_completion *completion)
 {
-	/* Write to completion barrier count before reading/writing futex */
-	cmm_smp_mb();
-	if (caa_unlikely(uatomic_read(&completion->futex) == -1)) {
-		uatomic_set(&completion->futex, 0);
-		if (futex_async(&completion->futex, FUTEX_WAKE, 1,
-				NULL, NULL, 0) < 0)
-			urcu_die(errno);
-	}
+	if (cds_eventcount_wake(&completion->ec))
+		urcu_die(errno);
 }
 
-/* This is the code run by each call_rcu thread. */
+/*
+ * Release the callers throttled by the high watermark once the queue is
+ * back to the low watermark.
+ */
+static void call_rcu_backpressure_update(struct call_rcu_data *crdp)
+{
+	if (CMM_LOAD_SHARED(crdp->backpressure)
+	    && uatomic_read(&crdp->qlen) <= CMM_LOAD_SHARED(crdp->low_watermark))
+		CMM_STORE_SHARED(crdp->backpressure, 0);
+}
 
-static void *call_rcu_thread(void *arg)
+/*
+ * Adapt the batching delay after a batch: halve it if the queue is large
+ * or grew during the batch, so memory is reclaimed sooner under load,
+ * and double it otherwise, so more callbacks share each grace period
+ * when things are quiet.
+ */
+static void call_rcu_update_delay(struct call_rcu_data *crdp)
 {
-	unsigned long cbcount;
-	struct call_rcu_data *crdp = (struct call_rcu_data *) arg;
-	int rt = !!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_RT);
+	unsigned long qlen = uatomic_read(&crdp->qlen);
 
-	if (set_thread_cpu_affinity(crdp))
-		urcu_die(errno);
+	if (qlen >= CALL_RCU_BUSY_QLEN || qlen > crdp->last_qlen) {
+		crdp->delay_ms >>= 1;
+		if (crdp->delay_ms < crdp->min_delay_ms)
+			crdp->delay_ms = crdp->min_delay_ms;
+	} else {
+		crdp->delay_ms = crdp->delay_ms ? crdp->delay_ms << 1 : 1;
+		if (crdp->delay_ms > crdp->max_delay_ms)
+			crdp->delay_ms = crdp->max_delay_ms;
+	}
+	crdp->last_qlen = qlen;
+}
 
-	/*
-	 * If callbacks take a read-side lock, we need to be registered.
-	 */
-	rcu_register_thread();
+static int call_rcu_xp_pending(struct call_rcu_data *crdp)
+{
+	return !cds_wfcq_empty(&crdp->xp_head, &crdp->xp_tail);
+}
 
-	URCU_TLS(thread_call_rcu_data) = crdp;
-	if (!rt) {
-		uatomic_dec(&crdp->futex);
-		/* Decrement futex before reading call_rcu list */
-		cmm_smp_mb();
-	}
-	for (;;) {
-		struct cds_wfcq_head cbs_tmp_head;
-		struct cds_wfcq_tail cbs_tmp_tail;
-		struct cds_wfcq_node *cbs, *cbs_tmp_n;
-		enum cds_wfcq_ret splice_ret;
+static int call_rcu_next_pending(struct call_rcu_data *crdp)
+{
+	return !cds_wfcq_empty(&crdp->next_head, &crdp->next_tail);
+}
 
-		if (set_thread_cpu_affinity(crdp))
-			urcu_die(errno);
+static int call_rcu_lazy_pending(struct call_rcu_data *crdp)
+{
+	return !cds_wfcq_empty(&crdp->lazy_head, &crdp->lazy_tail);
+}
 
-		if (uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSE) {
-			/*
-			 * Pause requested. Become quiescent: remove
-			 * ourself from all global lists, and don't
-			 * process any callback. The callback lists may
-			 * still be non-empty though.
-			 */
-			rcu_unregister_thread();
-			cmm_smp_mb__before_uatomic_or();
-			uatomic_or(&crdp->flags, URCU_CALL_RCU_PAUSED);
-			while ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSE) != 0)
-				(void) poll(NULL, 0, 1);
-			uatomic_and(&crdp->flags, ~URCU_CALL_RCU_PAUSED);
-			cmm_smp_mb__after_uatomic_and();
-			rcu_register_thread();
-		}
+/*
+ * Whether the lazy callbacks should be processed: their delay elapsed,
+ * too many are queued, or the queue is past its high watermark.
+ */
+static int call_rcu_lazy_due(struct call_rcu_data *crdp)
+{
+	uint64_t first_ns;
 
-		cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
-		splice_ret = __cds_wfcq_splice_blocking(&cbs_tmp_head,
-			&cbs_tmp_tail, &crdp->cbs_head, &crdp->cbs_tail);
-		assert(splice_ret != CDS_WFCQ_RET_WOULDBLOCK);
-		assert(splice_ret != CDS_WFCQ_RET_DEST_NON_EMPTY);
-		if (splice_ret != CDS_WFCQ_RET_SRC_EMPTY) {
-			synchronize_rcu();
-			cbcount = 0;
-			__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head,
-					&cbs_tmp_tail, cbs, cbs_tmp_n) {
-				struct rcu_head *rhp;
+	if (!call_rcu_lazy_pending(crdp))
+		return 0;
+	if (uatomic_read(&crdp->lazy_qlen)
+			>= CMM_LOAD_SHARED(crdp->lazy_qlen_max)
+	    || CMM_LOAD_SHARED(crdp->backpressure))
+		return 1;
+	first_ns = CMM_LOAD_SHARED(crdp->lazy_first_ns);
+	return urcu_time_ns() - first_ns
+		>= (uint64_t) CMM_LOAD_SHARED(crdp->lazy_delay_ms) * 1000000ULL;
+}
 
-				rhp = caa_container_of(cbs,
-					struct rcu_head, next);
-				rhp->func(rhp);
-				cbcount++;
-			}
-			uatomic_sub(&crdp->qlen, cbcount);
-		}
-		if (uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOP)
-			break;
-		rcu_thread_offline();
-		if (!rt) {
-			if (cds_wfcq_empty(&crdp->cbs_head,
-					&crdp->cbs_tail)) {
-				call_rcu_wait(crdp);
-				(void) poll(NULL, 0, 10);
-				uatomic_dec(&crdp->futex);
-				/*
-				 * Decrement futex before reading
-				 * call_rcu list.
-				 */
-				cmm_smp_mb();
-			} else {
-				(void) poll(NULL, 0, 10);
-			}
-		} else {
-			(void) poll(NULL, 0, 10);
-		}
-		rcu_thread_online();
-	}
-	if (!rt) {
-		/*
-		 * Read call_rcu list before write futex.
-		 */
-		cmm_smp_mb();
-		uatomic_set(&crdp->futex, 0);
-	}
-	uatomic_or(&crdp->flags, URCU_CALL_RCU_STOPPED);
-	rcu_unregister_thread();
-	return NULL;
+/* Milliseconds until the lazy callbacks are due, at least 1. */
+static unsigned int call_rcu_lazy_wait_ms(struct call_rcu_data *crdp)
+{
+	uint64_t delay_ns, age_ns;
+
+	delay_ns = (uint64_t) CMM_LOAD_SHARED(crdp->lazy_delay_ms) * 1000000ULL;
+	age_ns = urcu_time_ns() - CMM_LOAD_SHARED(crdp->lazy_first_ns);
+	if (age_ns >= delay_ns)
+		return 1;
+	return (unsigned int) ((delay_ns - age_ns) / 1000000ULL) + 1;
 }
 
 /*
- * Create both a call_rcu thread and the corresponding call_rcu_data
- * structure, linking the structure in as specified.  Caller must hold
- * call_rcu_mutex.
+ * Move the lazy callbacks in front of the @head queue, and account for
+ * them in qlen. Returns whether there were any.
  */
+static int call_rcu_lazy_splice(struct call_rcu_data *crdp,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail)
+{
+	struct cds_wfcq_head lazy_tmp_head;
+	struct cds_wfcq_tail lazy_tmp_tail;
 
-static void call_rcu_data_init(struct call_rcu_data **crdpp,
-			       unsigned long flags,
-			       int cpu_affinity)
+	if (!call_rcu_lazy_pending(crdp))
+		return 0;
+	cds_wfcq_init(&lazy_tmp_head, &lazy_tmp_tail);
+	(void) __cds_wfcq_splice_blocking(&lazy_tmp_head, &lazy_tmp_tail,
+			&crdp->lazy_head, &crdp->lazy_tail);
+	(void) __cds_wfcq_splice_blocking(&lazy_tmp_head, &lazy_tmp_tail,
+			head, tail);
+	(void) __cds_wfcq_splice_blocking(head, tail,
+			&lazy_tmp_head, &lazy_tmp_tail);
+	uatomic_add_mo(&crdp->qlen, uatomic_xchg(&crdp->lazy_qlen, 0),
+			CMM_RELAXED);
+	return 1;
+}
+
+static int call_rcu_shards_pending(struct call_rcu_data *crdp)
 {
-	struct call_rcu_data *crdp;
-	int ret;
+	unsigned int i;
 
-	crdp = malloc(sizeof(*crdp));
-	if (crdp == NULL)
+	for (i = 0; i < crdp->nr_shards; i++) {
+		if (!cds_wfcq_empty(&crdp->shards[i].head,
+				&crdp->shards[i].tail))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Move the callbacks of the sub-queues in front of the @head queue, and
+ * account for them in qlen. Called after splicing the main queue: the
+ * callbacks queued before a rcu_barrier() callback spliced from it are
+ * part of the splice, and are invoked before it. Only called by the
+ * call_rcu thread, or once it stopped. Returns whether there were any,
+ * and sets *@oldest_ns to the oldest first enqueue time.
+ */
+static int call_rcu_shards_splice(struct call_rcu_data *crdp,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail,
+		uint64_t *oldest_ns)
+{
+	struct cds_wfcq_head shards_tmp_head;
+	struct cds_wfcq_tail shards_tmp_tail;
+	unsigned long count = 0;
+	uint64_t first_ns;
+	unsigned int i;
+	int found = 0;
+
+	cds_wfcq_init(&shards_tmp_head, &shards_tmp_tail);
+	for (i = 0; i < crdp->nr_shards; i++) {
+		struct call_rcu_shard *shard = &crdp->shards[i];
+
+		if (cds_wfcq_empty(&shard->head, &shard->tail))
+			continue;
+		first_ns = CMM_LOAD_SHARED(shard->first_ns);
+		(void) __cds_wfcq_splice_blocking(&shards_tmp_head,
+				&shards_tmp_tail, &shard->head, &shard->tail);
+		count += uatomic_xchg(&shard->qlen, 0);
+		if (!found || first_ns < *oldest_ns)
+			*oldest_ns = first_ns;
+		found = 1;
+	}
+	if (!found)
+		return 0;
+	(void) __cds_wfcq_splice_blocking(&shards_tmp_head, &shards_tmp_tail,
+			head, tail);
+	(void) __cds_wfcq_splice_blocking(head, tail,
+			&shards_tmp_head, &shards_tmp_tail);
+	uatomic_add_mo(&crdp->qlen, count, CMM_RELAXED);
+	return 1;
+}
+
+/*
+ * Same as call_rcu_shards_splice() for URCU_CALL_RCU_NUMA, splicing
+ * each sub-queue in the batch queue of its node instead.
+ */
+static int call_rcu_nodes_splice(struct call_rcu_data *crdp,
+		uint64_t *oldest_ns)
+{
+	unsigned long count = 0;
+	uint64_t first_ns;
+	unsigned int i;
+	int found = 0;
+
+	for (i = 0; i < crdp->nr_shards; i++) {
+		struct call_rcu_shard *shard = &crdp->shards[i];
+		struct call_rcu_node *node = &crdp->nodes[shard->node];
+
+		if (cds_wfcq_empty(&shard->head, &shard->tail))
+			continue;
+		first_ns = CMM_LOAD_SHARED(shard->first_ns);
+		(void) __cds_wfcq_splice_blocking(&node->batch_head,
+				&node->batch_tail, &shard->head, &shard->tail);
+		count += uatomic_xchg(&shard->qlen, 0);
+		if (!found || first_ns < *oldest_ns)
+			*oldest_ns = first_ns;
+		found = 1;
+	}
+	if (!found)
+		return 0;
+	uatomic_add_mo(&crdp->qlen, count, CMM_RELAXED);
+	return 1;
+}
+
+/* Whether the callbacks of the next segment can be invoked. */
+static int call_rcu_next_done(struct call_rcu_data *crdp)
+{
+	return call_rcu_next_pending(crdp)
+		&& poll_state_synchronize_rcu(crdp->next_cookie);
+}
+
+/*
+ * Move the callbacks queued during the grace period which just
+ * completed to the next segment, empty before.
+ */
+static void call_rcu_next_splice(struct call_rcu_data *crdp)
+{
+	uint64_t oldest_ns = CMM_LOAD_SHARED(crdp->batch_first_ns);
+	uint64_t shards_ns;
+	int queued;
+
+	/*
+	 * The sub-queues of URCU_CALL_RCU_NUMA go to the node workers,
+	 * and wait for the next batch, as do the rcu_barrier() callbacks
+	 * of the main queue which may have been queued after them.
+	 */
+	if (crdp->nr_nodes)
+		return;
+	queued = cds_wfcq_splice_blocking(&crdp->next_head, &crdp->next_tail,
+			&crdp->cbs.head, &crdp->cbs.tail)
+				!= CDS_WFCQ_RET_SRC_EMPTY;
+	if (call_rcu_shards_splice(crdp, &crdp->next_head, &crdp->next_tail,
+			&shards_ns)) {
+		if (!queued || shards_ns < oldest_ns)
+			oldest_ns = shards_ns;
+		queued = 1;
+	}
+	if (!queued)
+		return;
+	crdp->next_oldest_ns = oldest_ns;
+	crdp->next_newest_ns = urcu_time_ns();
+	/* Callbacks were queued before the cookie is taken. */
+	crdp->next_cookie = get_state_synchronize_rcu();
+}
+
+static void _rcu_barrier_complete(struct rcu_head *head);
+
+/*
+ * Wait for the callers and thieves which took callbacks queued on
+ * @crdp to invoke them, putting a QSBR caller offline meanwhile, since
+ * they wait for a grace period first.
+ */
+static void call_rcu_takers_wait(struct call_rcu_data *crdp)
+{
+	int was_online;
+
+	if (!uatomic_read(&crdp->takers))
+		return;
+	was_online = _rcu_read_ongoing();
+	if (was_online)
+		rcu_thread_offline();
+	while (uatomic_read(&crdp->takers))
+		(void) poll(NULL, 0, 1);
+	if (was_online)
+		rcu_thread_online();
+	/* Read takers before invoking the following callbacks. */
+	cmm_smp_mb();
+}
+
+/*
+ * Invoke a callback of @crdp from its call_rcu thread, or from the
+ * caller of call_rcu_process_ready(). Callbacks queued before a
+ * rcu_barrier() callback may have been taken by callers helping under
+ * backpressure or by thieves: the barrier callback waits for them.
+ */
+static void call_rcu_invoke(struct call_rcu_data *crdp, struct rcu_head *rhp)
+{
+	if (rhp->func == _rcu_barrier_complete)
+		call_rcu_takers_wait(crdp);
+	rhp->func(rhp);
+}
+
+/* Invoke the next segment, whose grace period has completed. */
+static unsigned long call_rcu_next_invoke(struct call_rcu_data *crdp)
+{
+	struct cds_wfcq_head cbs_tmp_head;
+	struct cds_wfcq_tail cbs_tmp_tail;
+	struct cds_wfcq_node *cbs, *cbs_tmp_n;
+	unsigned long cbcount = 0;
+	uint64_t start_ns = urcu_time_ns();
+
+	cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
+	(void) __cds_wfcq_splice_blocking(&cbs_tmp_head, &cbs_tmp_tail,
+			&crdp->next_head, &crdp->next_tail);
+	urcu_trace1(call_rcu_batch_start, crdp);
+	__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head, &cbs_tmp_tail,
+			cbs, cbs_tmp_n) {
+		struct rcu_head *rhp;
+
+		rhp = caa_container_of(cbs, struct rcu_head, next);
+		call_rcu_invoke(crdp, rhp);
+		cbcount++;
+	}
+	urcu_trace2(call_rcu_batch_end, crdp, cbcount);
+	call_rcu_stats_batch(crdp, cbcount, crdp->next_oldest_ns,
+			crdp->next_newest_ns, start_ns, urcu_time_ns(), 0);
+	uatomic_sub_mo(&crdp->qlen, cbcount, CMM_RELAXED);
+	call_rcu_backpressure_update(crdp);
+	return cbcount;
+}
+
+/*
+ * Sleep for @ms milliseconds of batching delay. Where futexes support
+ * timeouts, call_rcu_expedited() cuts the sleep short. Real-time
+ * call_rcu threads are never woken up, and notice expedited callbacks
+ * after the current slice.
+ */
+static void call_rcu_delay_sleep(struct call_rcu_data *crdp, unsigned int ms)
+{
+#ifdef CONFIG_RCU_HAVE_FUTEX
+	struct timespec ts;
+	int ret;
+
+	if (!(_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_RT)) {
+		ts.tv_sec = ms / 1000;
+		ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+		uatomic_set(&crdp->xp_futex, -1);
+		/* Write futex before reading the expedited queue. */
+		cmm_smp_mb();
+		ret = 0;
+		if (!call_rcu_xp_pending(crdp))
+			ret = futex(&crdp->xp_futex, FUTEX_WAIT, -1, &ts,
+				    NULL, 0);
+		uatomic_set(&crdp->xp_futex, 0);
+		if (!ret || errno != ENOSYS)
+			return;
+	}
+#endif
+	(void) poll(NULL, 0, ms);
+}
+
+static void call_rcu_xp_wake_up(struct call_rcu_data *crdp)
+{
+	/* Write expedited queue before reading/writing futex. */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&crdp->xp_futex) == -1)) {
+		uatomic_set(&crdp->xp_futex, 0);
+		if (futex_async(&crdp->xp_futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+}
+
+/*
+ * Wait for callbacks to batch before the next grace period. While
+ * callbacks are queued, sleep by slices of the minimum delay, and stop
+ * as soon as the queue becomes large, or expedited callbacks are
+ * queued.
+ */
+static void call_rcu_batch_delay(struct call_rcu_data *crdp)
+{
+	unsigned int slept = 0;
+
+	while (slept < crdp->delay_ms) {
+		unsigned int slice = crdp->delay_ms - slept;
+		unsigned long qlen = uatomic_read(&crdp->qlen);
+
+		if (qlen >= CALL_RCU_BUSY_QLEN
+		    || CMM_LOAD_SHARED(crdp->backpressure)
+		    || call_rcu_xp_pending(crdp)
+		    || call_rcu_next_done(crdp)
+		    || (uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSE))
+			break;
+		if (qlen && crdp->min_delay_ms && slice > crdp->min_delay_ms)
+			slice = crdp->min_delay_ms;
+		else if (qlen && slice > 1)
+			slice = 1;
+		call_rcu_delay_sleep(crdp, slice);
+		slept += slice;
+	}
+}
+
+/*
+ * Idle wait of URCU_CALL_RCU_BUSY_POLL threads: spin on the queues
+ * instead of sleeping, so that the grace period starts as soon as a
+ * callback is queued, the grace period itself being the batching delay.
+ * Returns after CALL_RCU_BUSY_POLL_SPINS rounds, for the caller to
+ * handle pause requests and to steal.
+ */
+static void call_rcu_busy_poll(struct call_rcu_data *crdp)
+{
+	unsigned int i;
+
+	for (i = 0; i < CALL_RCU_BUSY_POLL_SPINS; i++) {
+		if (!cds_wfcq_empty(&crdp->cbs.head, &crdp->cbs.tail)
+		    || call_rcu_shards_pending(crdp)
+		    || call_rcu_xp_pending(crdp)
+		    || call_rcu_next_done(crdp)
+		    || (uatomic_read(&crdp->flags)
+			& (URCU_CALL_RCU_STOP | URCU_CALL_RCU_PAUSE)))
+			return;
+		caa_cpu_relax();
+	}
+}
+
+/*
+ * Move the callbacks of the main queue of @crdp queued before its first
+ * rcu_barrier() callback, if any, to the @head queue, for a caller
+ * helping under backpressure or a thief, which invoke them after their
+ * own grace period. Unless none were moved, the caller is counted in
+ * crdp->takers until it calls call_rcu_take_done(): the barrier
+ * callback, left in the queue, then waits for it to be done before
+ * completing, see call_rcu_invoke(). Returns the number of callbacks
+ * moved.
+ */
+static unsigned long call_rcu_take(struct call_rcu_data *crdp,
+				   struct cds_wfcq_head *head,
+				   struct cds_wfcq_tail *tail)
+{
+	struct cds_wfcq_node *node;
+	unsigned long count = 0;
+
+	uatomic_inc(&crdp->takers);
+	/* Counted before the call_rcu thread can splice the barrier. */
+	cmm_smp_mb__after_uatomic_inc();
+	cds_wfcq_dequeue_lock(&crdp->cbs.head, &crdp->cbs.tail);
+	while ((node = __cds_wfcq_first_blocking(&crdp->cbs.head,
+			&crdp->cbs.tail)) != NULL) {
+		if (caa_container_of(node, struct rcu_head, next)->func
+				== _rcu_barrier_complete)
+			break;
+		node = __cds_wfcq_dequeue_blocking(&crdp->cbs.head,
+				&crdp->cbs.tail);
+		cds_wfcq_node_init(node);
+		(void) cds_wfcq_enqueue(head, tail, node);
+		count++;
+	}
+	cds_wfcq_dequeue_unlock(&crdp->cbs.head, &crdp->cbs.tail);
+	if (!count)
+		uatomic_dec(&crdp->takers);
+	return count;
+}
+
+/*
+ * Called once the callbacks moved by call_rcu_take() are invoked.
+ * call_rcu_data_free() waits for it, so @crdp is not freed earlier.
+ */
+static void call_rcu_take_done(struct call_rcu_data *crdp)
+{
+	/* Invoke the callbacks before releasing the barrier. */
+	cmm_smp_mb__before_uatomic_dec();
+	uatomic_dec(&crdp->takers);
+}
+
+/*
+ * Work stealing between call_rcu threads created with
+ * URCU_CALL_RCU_STEAL: a thread finding its own queue empty takes the
+ * callbacks of the busiest other such thread, if it holds at least
+ * CALL_RCU_BUSY_QLEN callbacks, and invokes the stolen callbacks after
+ * its own grace period. Stolen callbacks are moved to the qlen of the
+ * thief. Returns the number of callbacks stolen, and sets *@victimp to
+ * the call_rcu_data to pass to call_rcu_take_done() once they are
+ * invoked, if any.
+ *
+ * The call_rcu_data list is only walked if call_rcu_mutex is free,
+ * because the fork handlers hold it while waiting for call_rcu threads
+ * to pause.
+ */
+static unsigned long call_rcu_steal(struct call_rcu_data *crdp,
+				    struct cds_wfcq_head *head,
+				    struct cds_wfcq_tail *tail,
+				    uint64_t *oldest_ns,
+				    struct call_rcu_data **victimp)
+{
+	struct call_rcu_data *victim, *busiest = NULL;
+	unsigned long qlen, max_qlen = CALL_RCU_BUSY_QLEN - 1, count = 0;
+
+	*victimp = NULL;
+	if (pthread_mutex_trylock(&call_rcu_mutex))
+		return 0;
+	cds_list_for_each_entry(victim, &call_rcu_data_list, list) {
+		if (victim == crdp
+		    || !(uatomic_read(&victim->flags) & URCU_CALL_RCU_STEAL))
+			continue;
+		qlen = uatomic_read(&victim->qlen);
+		if (qlen > max_qlen) {
+			max_qlen = qlen;
+			busiest = victim;
+		}
+	}
+	/* The qlen of the victim also counts its callbacks in progress. */
+	if (busiest)
+		*oldest_ns = CMM_LOAD_SHARED(busiest->batch_first_ns);
+	if (busiest)
+		count = call_rcu_take(busiest, head, tail);
+	if (count) {
+		uatomic_add_mo(&crdp->qlen, count, CMM_RELAXED);
+		uatomic_sub_mo(&busiest->qlen, count, CMM_RELAXED);
+		call_rcu_backpressure_update(busiest);
+		call_rcu_stats_move(busiest, crdp, count);
+		*victimp = busiest;
+	}
+	call_rcu_unlock(&call_rcu_mutex);
+	return count;
+}
+
+static int call_rcu_gp_completed(int32_t seq)
+{
+	return (int32_t) ((uint32_t) uatomic_read(&call_rcu_gp_driver.completed)
+			- (uint32_t) seq) >= 0;
+}
+
+/*
+ * Make the event fd of an URCU_CALL_RCU_EVENTFD call_rcu_data readable.
+ * A full counter or pipe is readable already.
+ */
+static void call_rcu_event_signal(struct call_rcu_data *crdp)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+	uint64_t one = 1;
+#else
+	char one = 1;
+#endif
+	ssize_t ret;
+
+	do {
+		ret = write(crdp->event_fd[1], &one, sizeof(one));
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0 && errno != EAGAIN)
 		urcu_die(errno);
-	memset(crdp, '\0', sizeof(*crdp));
-	cds_wfcq_init(&crdp->cbs_head, &crdp->cbs_tail);
-	crdp->qlen = 0;
-	crdp->futex = 0;
-	crdp->flags = flags;
-	cds_list_add(&crdp->list, &call_rcu_data_list);
-	crdp->cpu_affinity = cpu_affinity;
-	crdp->gp_count = 0;
-	cmm_smp_mb();  /* Structure initialized before pointer is planted. */
-	*crdpp = crdp;
-	ret = pthread_create(&crdp->tid, NULL, call_rcu_thread, crdp);
+}
+
+static void call_rcu_event_clear(struct call_rcu_data *crdp)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+	uint64_t value;
+#else
+	char value[64];
+#endif
+	ssize_t ret;
+
+	do {
+		ret = read(crdp->event_fd[0], &value, sizeof(value));
+	} while (ret > 0 || (ret < 0 && errno == EINTR));
+	if (ret < 0 && errno != EAGAIN)
+		urcu_die(errno);
+}
+
+static void call_rcu_event_open(struct call_rcu_data *crdp)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+	crdp->event_fd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (crdp->event_fd[0] < 0)
+		urcu_die(errno);
+	crdp->event_fd[1] = crdp->event_fd[0];
+#else
+	int i;
+
+	if (pipe(crdp->event_fd))
+		urcu_die(errno);
+	for (i = 0; i < 2; i++) {
+		if (fcntl(crdp->event_fd[i], F_SETFL, O_NONBLOCK)
+		    || fcntl(crdp->event_fd[i], F_SETFD, FD_CLOEXEC))
+			urcu_die(errno);
+	}
+#endif
+}
+
+static void call_rcu_event_close(struct call_rcu_data *crdp)
+{
+	(void) close(crdp->event_fd[0]);
+	if (crdp->event_fd[1] != crdp->event_fd[0])
+		(void) close(crdp->event_fd[1]);
+	crdp->event_fd[0] = crdp->event_fd[1] = -1;
+}
+
+/*
+ * Request a grace period from the driver thread. Returns the sequence
+ * number to wait for.
+ */
+static int32_t call_rcu_gp_request(void)
+{
+	struct call_rcu_gp_driver *driver = &call_rcu_gp_driver;
+	int32_t seq;
+
+	/* Enqueue or splice before the request: ordered by add_return. */
+	seq = uatomic_add_return(&driver->requested, 1);
+	/* Write request before reading/writing driver futex. */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&driver->futex) == -1)) {
+		uatomic_set(&driver->futex, 0);
+		if (futex_async(&driver->futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+	return seq;
+}
+
+/* This is the code run by the grace-period driver thread. */
+
+static void *call_rcu_gp_driver_thread(void *arg)
+{
+	struct call_rcu_gp_driver *driver = arg;
+	struct call_rcu_data *crdp;
+	int32_t target;
+
+	for (;;) {
+		if (uatomic_read(&driver->flags) & URCU_CALL_RCU_PAUSE) {
+			/* Do not hold grace-period locks across fork. */
+			call_rcu_pause_wait(&driver->flags);
+		}
+		uatomic_dec(&driver->futex);
+		/* Decrement futex before reading requests. */
+		cmm_smp_mb();
+		target = uatomic_read(&driver->requested);
+		if (target == uatomic_read(&driver->completed)) {
+			if (!(uatomic_read(&driver->flags) & URCU_CALL_RCU_PAUSE)) {
+				while (futex_async(&driver->futex, FUTEX_WAIT,
+						-1, NULL, NULL, 0)) {
+					if (errno == EAGAIN || errno == EINTR)
+						break;
+					urcu_die(errno);
+				}
+			}
+			uatomic_set(&driver->futex, 0);
+			continue;
+		}
+		uatomic_set(&driver->futex, 0);
+		call_rcu_lock(&driver->poll_mutex);
+		/* Read requests before splicing the requesting queues. */
+		cds_list_for_each_entry(crdp, &driver->poll_list, poll_list) {
+			crdp->wait_oldest_ns =
+				CMM_LOAD_SHARED(crdp->batch_first_ns);
+			crdp->wait_pending = cds_wfcq_splice_blocking(
+				&crdp->wait_head, &crdp->wait_tail,
+				&crdp->cbs.head, &crdp->cbs.tail)
+					!= CDS_WFCQ_RET_SRC_EMPTY;
+			crdp->wait_newest_ns = urcu_time_ns();
+		}
+		call_rcu_unlock(&driver->poll_mutex);
+		synchronize_rcu();
+		/* Grace period completed before "completed" is written. */
+		cmm_smp_mb();
+		uatomic_set(&driver->completed, target);
+		/* Write "completed" before reading nr_waiters. */
+		cmm_smp_mb();
+		if (uatomic_read(&driver->nr_waiters)) {
+			if (futex_async(&driver->completed, FUTEX_WAKE, INT_MAX,
+					NULL, NULL, 0) < 0)
+				urcu_die(errno);
+		}
+		/*
+		 * Freed call_rcu_data take their waiting callbacks back
+		 * and leave the list. Added ones have none.
+		 */
+		call_rcu_lock(&driver->poll_mutex);
+		cds_list_for_each_entry(crdp, &driver->poll_list, poll_list) {
+			if (!crdp->wait_pending)
+				continue;
+			if (cds_wfcq_empty(&crdp->ready_head, &crdp->ready_tail))
+				CMM_STORE_SHARED(crdp->ready_oldest_ns,
+						 crdp->wait_oldest_ns);
+			CMM_STORE_SHARED(crdp->ready_newest_ns,
+					 crdp->wait_newest_ns);
+			(void) __cds_wfcq_splice_blocking(&crdp->ready_head,
+				&crdp->ready_tail, &crdp->wait_head,
+				&crdp->wait_tail);
+			crdp->wait_pending = 0;
+			call_rcu_lock(&crdp->stats_lock);
+			crdp->stats.grace_periods++;
+			call_rcu_unlock(&crdp->stats_lock);
+			/* Hand over callbacks before signalling. */
+			cmm_smp_mb();
+			call_rcu_event_signal(crdp);
+		}
+		call_rcu_unlock(&driver->poll_mutex);
+	}
+	return NULL;
+}
+
+/* Start the grace-period driver thread. Caller must hold call_rcu_mutex. */
+static void call_rcu_gp_driver_start(void)
+{
+	int ret;
+
+	if (call_rcu_gp_driver.started)
+		return;
+	ret = pthread_create(&call_rcu_gp_driver.tid, NULL,
+			call_rcu_gp_driver_thread, &call_rcu_gp_driver);
 	if (ret)
 		urcu_die(ret);
+	call_rcu_gp_driver.started = 1;
+}
+
+/*
+ * Wait for a grace period from the shared driver thread. The caller is
+ * offline while waiting, so QSBR workers do not hold back the grace
+ * period they wait for.
+ */
+static void call_rcu_shared_synchronize(void)
+{
+	struct call_rcu_gp_driver *driver = &call_rcu_gp_driver;
+	int32_t seq, completed;
+
+	seq = call_rcu_gp_request();
+	if (call_rcu_gp_completed(seq))
+		goto end;
+	rcu_thread_offline();
+	uatomic_inc(&driver->nr_waiters);
+	for (;;) {
+		/* Increment nr_waiters before reading "completed". */
+		cmm_smp_mb();
+		completed = uatomic_read(&driver->completed);
+		if ((int32_t) ((uint32_t) completed - (uint32_t) seq) >= 0)
+			break;
+		if (futex_async(&driver->completed, FUTEX_WAIT, completed,
+				NULL, NULL, 0)) {
+			if (errno != EAGAIN && errno != EINTR)
+				urcu_die(errno);
+		}
+	}
+	uatomic_dec(&driver->nr_waiters);
+	rcu_thread_online();
+end:
+	/* Grace period completed before callbacks are invoked. */
+	cmm_smp_mb();
+}
+
+/*
+ * Invoke chunks of the batch in the exec queue until it is empty.
+ * Called by the call_rcu thread and its helper threads.
+ */
+static void call_rcu_exec_chunks(struct call_rcu_data *crdp)
+{
+	struct rcu_head *chunk[CALL_RCU_HELPER_CHUNK];
+	struct cds_wfcq_node *node;
+	unsigned int i, n;
+
+	do {
+		uatomic_inc(&crdp->exec_running);
+		/* Count ourself as running before taking callbacks. */
+		cmm_smp_mb__after_uatomic_inc();
+		n = 0;
+		cds_wfcq_dequeue_lock(&crdp->exec_head, &crdp->exec_tail);
+		while (n < CALL_RCU_HELPER_CHUNK
+		       && (node = __cds_wfcq_dequeue_blocking(&crdp->exec_head,
+				&crdp->exec_tail)) != NULL)
+			chunk[n++] = caa_container_of(node, struct rcu_head,
+						      next);
+		cds_wfcq_dequeue_unlock(&crdp->exec_head, &crdp->exec_tail);
+		for (i = 0; i < n; i++) {
+			if (chunk[i]->func == _rcu_barrier_complete) {
+				cds_wfcq_node_init(&chunk[i]->next);
+				cds_wfcq_enqueue(&crdp->deferred_head,
+					&crdp->deferred_tail, &chunk[i]->next);
+			} else {
+				chunk[i]->func(chunk[i]);
+			}
+		}
+		uatomic_add(&crdp->exec_count, n);
+		if (!uatomic_sub_return(&crdp->exec_running, 1)
+		    && uatomic_read(&crdp->exec_futex) == -1) {
+			uatomic_set(&crdp->exec_futex, 0);
+			if (futex_async(&crdp->exec_futex, FUTEX_WAKE, 1,
+					NULL, NULL, 0) < 0)
+				urcu_die(errno);
+		}
+	} while (n == CALL_RCU_HELPER_CHUNK);
+}
+
+/* Wake up helper threads, to invoke a batch or to change state. */
+static void call_rcu_helpers_wake_up(struct call_rcu_data *crdp)
+{
+	/* Write batch or flags before bumping the generation. */
+	cmm_smp_mb();
+	uatomic_inc(&crdp->helper_gen);
+	if (futex_async(&crdp->helper_gen, FUTEX_WAKE, INT_MAX,
+			NULL, NULL, 0) < 0)
+		urcu_die(errno);
+}
+
+/*
+ * Wait for the helper or node threads of @crdp to invoke their part of
+ * the batch, then invoke the deferred rcu_barrier() callbacks. Returns
+ * the number of callbacks invoked by the threads.
+ */
+static unsigned long call_rcu_exec_wait(struct call_rcu_data *crdp)
+{
+	struct cds_wfcq_node *cbs, *cbs_tmp_n;
+	unsigned long count;
+
+	while (uatomic_read(&crdp->exec_running)) {
+		uatomic_set(&crdp->exec_futex, -1);
+		/* Write futex before reading exec_running. */
+		cmm_smp_mb();
+		if (!uatomic_read(&crdp->exec_running)) {
+			uatomic_set(&crdp->exec_futex, 0);
+			break;
+		}
+		if (futex_async(&crdp->exec_futex, FUTEX_WAIT, -1,
+				NULL, NULL, 0)) {
+			if (errno != EAGAIN && errno != EINTR)
+				urcu_die(errno);
+		}
+	}
+	/* Read helper invocations before the deferred callbacks. */
+	cmm_smp_mb();
+	count = uatomic_read(&crdp->exec_count);
+	__cds_wfcq_for_each_blocking_safe(&crdp->deferred_head,
+			&crdp->deferred_tail, cbs, cbs_tmp_n) {
+		struct rcu_head *rhp;
+
+		rhp = caa_container_of(cbs, struct rcu_head, next);
+		call_rcu_invoke(crdp, rhp);
+	}
+	cds_wfcq_init(&crdp->deferred_head, &crdp->deferred_tail);
+	return count;
+}
+
+/*
+ * Invoke the callbacks spliced in @head, in parallel with the helper
+ * threads of @crdp. Returns the number of callbacks invoked.
+ */
+static unsigned long call_rcu_exec_parallel(struct call_rcu_data *crdp,
+					    struct cds_wfcq_head *head,
+					    struct cds_wfcq_tail *tail)
+{
+	/* The exec queue is empty between batches. */
+	(void) __cds_wfcq_splice_blocking(&crdp->exec_head, &crdp->exec_tail,
+					  head, tail);
+	uatomic_set(&crdp->exec_count, 0);
+	call_rcu_helpers_wake_up(crdp);
+	call_rcu_exec_chunks(crdp);
+	return call_rcu_exec_wait(crdp);
+}
+
+/*
+ * Paused helper or node thread side of the handshake. Same as call_rcu
+ * threads, see call_rcu_thread().
+ */
+static void call_rcu_helper_pause_wait(struct call_rcu_data *crdp)
+{
+	int32_t seq;
+
+	rcu_unregister_thread();
+	uatomic_inc(&crdp->nr_helpers_paused);
+	call_rcu_seq_wake(&call_rcu_pause_seq);
+	for (;;) {
+		seq = call_rcu_seq_read(&call_rcu_resume_seq);
+		if (!(uatomic_read(&crdp->helper_flags) & URCU_CALL_RCU_PAUSE))
+			break;
+		call_rcu_seq_wait(&call_rcu_resume_seq, seq);
+	}
+	uatomic_dec(&crdp->nr_helpers_paused);
+	cmm_smp_mb__after_uatomic_dec();
+	rcu_register_thread();
+}
+
+/* This is the code run by each helper thread of a call_rcu thread. */
+
+static void *call_rcu_helper_thread(void *arg)
+{
+	struct call_rcu_data *crdp = arg;
+	struct urcu_placement_thread placement;
+	unsigned long flags;
+	int32_t gen;
+
+	memset(&placement, 0, sizeof(placement));
+	rcu_register_thread();
+	URCU_TLS(call_rcu_no_backpressure) = 1;
+	for (;;) {
+		/* Helpers share the CPUs of a cpuset, not cpu_affinity. */
+		if (set_thread_cpu_affinity(crdp, &placement, -1))
+			urcu_die(errno);
+		gen = uatomic_read(&crdp->helper_gen);
+		/* Read generation before flags and batch. */
+		cmm_smp_mb();
+		flags = uatomic_read(&crdp->helper_flags);
+		if (flags & URCU_CALL_RCU_STOP)
+			break;
+		if (flags & URCU_CALL_RCU_PAUSE) {
+			call_rcu_helper_pause_wait(crdp);
+			continue;
+		}
+		call_rcu_exec_chunks(crdp);
+		rcu_thread_offline();
+		if (futex_async(&crdp->helper_gen, FUTEX_WAIT, gen,
+				NULL, NULL, 0)) {
+			if (errno != EAGAIN && errno != EINTR)
+				urcu_die(errno);
+		}
+		rcu_thread_online();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Invoke the batch handed to the worker of @node, if any, see
+ * call_rcu_nodes_dispatch().
+ */
+static void call_rcu_node_exec(struct call_rcu_node *node)
+{
+	struct call_rcu_data *crdp = node->crdp;
+	struct cds_wfcq_head cbs_tmp_head;
+	struct cds_wfcq_tail cbs_tmp_tail;
+	struct cds_wfcq_node *cbs, *cbs_tmp_n;
+	unsigned long count = 0;
+
+	if (cds_wfcq_empty(&node->exec_head, &node->exec_tail))
+		return;
+	cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
+	(void) __cds_wfcq_splice_blocking(&cbs_tmp_head, &cbs_tmp_tail,
+			&node->exec_head, &node->exec_tail);
+	__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head, &cbs_tmp_tail,
+			cbs, cbs_tmp_n) {
+		struct rcu_head *rhp;
+
+		rhp = caa_container_of(cbs, struct rcu_head, next);
+		rhp->func(rhp);
+		count++;
+	}
+	uatomic_add(&crdp->exec_count, count);
+	if (!uatomic_sub_return(&crdp->exec_running, 1)
+	    && uatomic_read(&crdp->exec_futex) == -1) {
+		uatomic_set(&crdp->exec_futex, 0);
+		if (futex_async(&crdp->exec_futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+}
+
+/* This is the code run by each node thread of a call_rcu thread. */
+
+static void *call_rcu_node_thread(void *arg)
+{
+	struct call_rcu_node *node = arg;
+	struct call_rcu_data *crdp = node->crdp;
+	struct urcu_placement_thread placement;
+	unsigned long flags;
+	int32_t gen;
+
+	memset(&placement, 0, sizeof(placement));
+	rcu_register_thread();
+	URCU_TLS(call_rcu_no_backpressure) = 1;
+	for (;;) {
+		if (urcu_placement_check(&node->placement, &placement, -1))
+			urcu_die(errno);
+		gen = uatomic_read(&crdp->helper_gen);
+		/* Read generation before flags and batch. */
+		cmm_smp_mb();
+		flags = uatomic_read(&crdp->helper_flags);
+		if (flags & URCU_CALL_RCU_STOP)
+			break;
+		if (flags & URCU_CALL_RCU_PAUSE) {
+			call_rcu_helper_pause_wait(crdp);
+			continue;
+		}
+		call_rcu_node_exec(node);
+		rcu_thread_offline();
+		if (futex_async(&crdp->helper_gen, FUTEX_WAIT, gen,
+				NULL, NULL, 0)) {
+			if (errno != EAGAIN && errno != EINTR)
+				urcu_die(errno);
+		}
+		rcu_thread_online();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Hand the batch queue of each node, whose grace period has completed,
+ * to its worker. The call_rcu thread then waits for them with
+ * call_rcu_exec_wait(), after deferring the rcu_barrier() callbacks of
+ * the main queue: callbacks queued before them may be in the batches.
+ */
+static void call_rcu_nodes_dispatch(struct call_rcu_data *crdp)
+{
+	unsigned int i;
+	int dispatched = 0;
+
+	uatomic_set(&crdp->exec_count, 0);
+	for (i = 0; i < crdp->nr_nodes; i++) {
+		struct call_rcu_node *node = &crdp->nodes[i];
+
+		if (cds_wfcq_empty(&node->batch_head, &node->batch_tail))
+			continue;
+		uatomic_inc(&crdp->exec_running);
+		/* Count the worker as running before it sees its batch. */
+		cmm_smp_mb__after_uatomic_inc();
+		(void) __cds_wfcq_splice_blocking(&node->exec_head,
+				&node->exec_tail, &node->batch_head,
+				&node->batch_tail);
+		dispatched = 1;
+	}
+	if (dispatched)
+		call_rcu_helpers_wake_up(crdp);
+}
+
+/* Pause the helpers of a pausing call_rcu thread, and resume them. */
+static void call_rcu_helpers_pause(struct call_rcu_data *crdp)
+{
+	int32_t seq;
+
+	uatomic_or(&crdp->helper_flags, URCU_CALL_RCU_PAUSE);
+	call_rcu_helpers_wake_up(crdp);
+	for (;;) {
+		seq = call_rcu_seq_read(&call_rcu_pause_seq);
+		if (uatomic_read(&crdp->nr_helpers_paused)
+				== crdp->nr_helpers + crdp->nr_nodes)
+			break;
+		call_rcu_seq_wait(&call_rcu_pause_seq, seq);
+	}
+}
+
+static void call_rcu_helpers_resume(struct call_rcu_data *crdp)
+{
+	uatomic_and(&crdp->helper_flags, ~URCU_CALL_RCU_PAUSE);
+	call_rcu_seq_wake(&call_rcu_resume_seq);
+}
+
+static void call_rcu_helpers_stop(struct call_rcu_data *crdp)
+{
+	unsigned int i;
+	int ret;
+
+	uatomic_or(&crdp->helper_flags, URCU_CALL_RCU_STOP);
+	call_rcu_helpers_wake_up(crdp);
+	for (i = 0; i < crdp->nr_helpers; i++) {
+		ret = pthread_join(crdp->helper_tids[i], NULL);
+		if (ret)
+			urcu_die(ret);
+	}
+	for (i = 0; i < crdp->nr_nodes; i++) {
+		ret = pthread_join(crdp->nodes[i].tid, NULL);
+		if (ret)
+			urcu_die(ret);
+	}
+}
+
+/* This is the code run by each call_rcu thread. */
+
+/* Nothing to process, except lazy callbacks which are not due yet. */
+static int call_rcu_lazy_idle(struct call_rcu_data *crdp)
+{
+	return cds_wfcq_empty(&crdp->cbs.head, &crdp->cbs.tail)
+		&& !call_rcu_shards_pending(crdp)
+		&& !call_rcu_xp_pending(crdp)
+		&& !call_rcu_next_pending(crdp);
+}
+
+static int call_rcu_idle(struct call_rcu_data *crdp)
+{
+	return call_rcu_lazy_idle(crdp) && !call_rcu_lazy_pending(crdp);
+}
+
+/*
+ * Called by the thread of a lazily created call_rcu_data which stayed
+ * idle: unpublish it from its CPU, so that the next call_rcu() from the
+ * CPU creates a new one, and wait for the call_rcu() callers which may
+ * still use it. Returns 1 once it is unlinked, and the thread should
+ * exit and free it. Whoever removes the call_rcu_data from its CPU,
+ * under call_rcu_mutex, owns it: free_all_cpu_call_rcu_data() or
+ * set_cpu_call_rcu_data() take it over from the thread. The mutex is
+ * only tried, as it is held while call_rcu threads are paused for fork.
+ */
+static int call_rcu_retire(struct call_rcu_data *crdp)
+{
+	int cpu = crdp->cpu_affinity;
+
+	if (pthread_mutex_trylock(&call_rcu_mutex))
+		return 0;
+	if (!crdp->retiring) {
+		if (CMM_LOAD_SHARED(crdp->nr_helpers) || crdp->nr_nodes
+		    || per_cpu_call_rcu_data == NULL
+		    || cpu < 0 || cpu >= maxcpus
+		    || per_cpu_call_rcu_data[cpu] != crdp
+		    || !call_rcu_idle(crdp)) {
+			call_rcu_unlock(&call_rcu_mutex);
+			return 0;
+		}
+		rcu_set_pointer(&per_cpu_call_rcu_data[cpu], NULL);
+		crdp->retiring = 1;
+		call_rcu_unlock(&call_rcu_mutex);
+		/* call_rcu() uses the pointer in read-side critical section. */
+		synchronize_rcu();
+		if (pthread_mutex_trylock(&call_rcu_mutex))
+			return 0;
+	}
+	/* Callbacks queued until unpublished: retry once idle again. */
+	if (!call_rcu_idle(crdp)
+	    || (uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSE)) {
+		call_rcu_unlock(&call_rcu_mutex);
+		return 0;
+	}
+	cds_list_del(&crdp->list);
+	call_rcu_unlock(&call_rcu_mutex);
+	return 1;
+}
+
+static void *call_rcu_thread(void *arg)
+{
+	unsigned long cbcount, stolen;
+	uint64_t oldest_ns, newest_ns, start_ns, lazy_ns, shards_ns;
+	struct call_rcu_data *crdp = (struct call_rcu_data *) arg;
+	struct call_rcu_data *victim;
+	struct urcu_placement_thread placement;
+	int retired = 0;
+	int rt = !!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_RT);
+	int busy_poll = !!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_BUSY_POLL);
+	int steal = !!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_STEAL);
+	int shared_gp = !!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_SHARED_GP);
+
+	memset(&placement, 0, sizeof(placement));
+	if (set_thread_cpu_affinity(crdp, &placement, crdp->cpu_affinity))
+		urcu_die(errno);
+
+	/*
+	 * If callbacks take a read-side lock, we need to be registered.
+	 */
+	rcu_register_thread();
+
+	URCU_TLS(thread_call_rcu_data) = crdp;
+	URCU_TLS(call_rcu_no_backpressure) = 1;
+	if (!rt)
+		cds_eventcount_prepare_wait(&crdp->wait_ec);
+	for (;;) {
+		struct cds_wfcq_head cbs_tmp_head, xp_tmp_head;
+		struct cds_wfcq_tail cbs_tmp_tail, xp_tmp_tail;
+		struct cds_wfcq_node *cbs, *cbs_tmp_n;
+		enum cds_wfcq_ret splice_ret, xp_splice_ret;
+
+		if (set_thread_cpu_affinity(crdp, &placement,
+				crdp->cpu_affinity))
+			urcu_die(errno);
+
+		if (uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSE) {
+			/*
+			 * Pause requested. Become quiescent: remove
+			 * ourself from all global lists, and don't
+			 * process any callback. The callback lists may
+			 * still be non-empty though.
+			 */
+			if (CMM_LOAD_SHARED(crdp->nr_helpers) || crdp->nr_nodes)
+				call_rcu_helpers_pause(crdp);
+			rcu_unregister_thread();
+			call_rcu_pause_wait(&crdp->flags);
+			rcu_register_thread();
+			if (CMM_LOAD_SHARED(crdp->nr_helpers) || crdp->nr_nodes)
+				call_rcu_helpers_resume(crdp);
+		}
+
+		cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
+		oldest_ns = CMM_LOAD_SHARED(crdp->batch_first_ns);
+		/* Callers helping under backpressure also take callbacks. */
+		splice_ret = cds_wfcq_splice_blocking(&cbs_tmp_head,
+			&cbs_tmp_tail, &crdp->cbs.head, &crdp->cbs.tail);
+		assert(splice_ret != CDS_WFCQ_RET_WOULDBLOCK);
+		assert(splice_ret != CDS_WFCQ_RET_DEST_NON_EMPTY);
+		if (crdp->nr_nodes ? call_rcu_nodes_splice(crdp, &shards_ns)
+		    : call_rcu_shards_splice(crdp, &cbs_tmp_head,
+				&cbs_tmp_tail, &shards_ns)) {
+			if (splice_ret == CDS_WFCQ_RET_SRC_EMPTY
+			    || shards_ns < oldest_ns)
+				oldest_ns = shards_ns;
+			splice_ret = CDS_WFCQ_RET_DEST_EMPTY;
+		}
+		/*
+		 * Splice expedited callbacks after the others: those
+		 * queued before a rcu_barrier() callback of this batch
+		 * are part of the batch.
+		 */
+		cds_wfcq_init(&xp_tmp_head, &xp_tmp_tail);
+		xp_splice_ret = __cds_wfcq_splice_blocking(&xp_tmp_head,
+			&xp_tmp_tail, &crdp->xp_head, &crdp->xp_tail);
+		if (xp_splice_ret != CDS_WFCQ_RET_SRC_EMPTY
+		    && splice_ret == CDS_WFCQ_RET_SRC_EMPTY)
+			splice_ret = CDS_WFCQ_RET_DEST_EMPTY;
+		/*
+		 * Lazy callbacks share the grace period of any other
+		 * callback, and otherwise wait until they are due.
+		 */
+		if ((splice_ret != CDS_WFCQ_RET_SRC_EMPTY
+		     || call_rcu_lazy_due(crdp)
+		     || (uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOP))
+		    && call_rcu_lazy_splice(crdp, &cbs_tmp_head,
+				&cbs_tmp_tail)) {
+			lazy_ns = CMM_LOAD_SHARED(crdp->lazy_first_ns);
+			if (splice_ret == CDS_WFCQ_RET_SRC_EMPTY
+			    || lazy_ns < oldest_ns)
+				oldest_ns = lazy_ns;
+			splice_ret = CDS_WFCQ_RET_DEST_EMPTY;
+		}
+		/*
+		 * Callbacks queued during the previous grace period are
+		 * invoked first if a grace period started since has
+		 * completed, or else wait for the grace period of the batch.
+		 */
+		cbcount = 0;
+		if (call_rcu_next_done(crdp)) {
+			cbcount = call_rcu_next_invoke(crdp);
+		} else if (call_rcu_next_pending(crdp)) {
+			(void) __cds_wfcq_splice_blocking(&crdp->next_head,
+				&crdp->next_tail, &cbs_tmp_head, &cbs_tmp_tail);
+			(void) __cds_wfcq_splice_blocking(&cbs_tmp_head,
+				&cbs_tmp_tail, &crdp->next_head,
+				&crdp->next_tail);
+			oldest_ns = crdp->next_oldest_ns;
+			splice_ret = CDS_WFCQ_RET_DEST_EMPTY;
+		}
+		stolen = 0;
+		victim = NULL;
+		if (splice_ret == CDS_WFCQ_RET_SRC_EMPTY && !cbcount && steal) {
+			stolen = call_rcu_steal(crdp, &cbs_tmp_head,
+						&cbs_tmp_tail, &oldest_ns,
+						&victim);
+			if (stolen)
+				splice_ret = CDS_WFCQ_RET_DEST_EMPTY;
+		}
+		if (splice_ret != CDS_WFCQ_RET_SRC_EMPTY) {
+			newest_ns = urcu_time_ns();
+			/* Expedited callbacks do not wait for a driver round. */
+			if (shared_gp && xp_splice_ret == CDS_WFCQ_RET_SRC_EMPTY)
+				call_rcu_shared_synchronize();
+			else
+				synchronize_rcu();
+			call_rcu_next_splice(crdp);
+			start_ns = urcu_time_ns();
+			urcu_trace1(call_rcu_batch_start, crdp);
+			cbcount = 0;
+			if (crdp->nr_nodes)
+				call_rcu_nodes_dispatch(crdp);
+			__cds_wfcq_for_each_blocking_safe(&xp_tmp_head,
+					&xp_tmp_tail, cbs, cbs_tmp_n) {
+				struct rcu_head *rhp;
+
+				rhp = caa_container_of(cbs,
+					struct rcu_head, next);
+				rhp->func(rhp);
+				cbcount++;
+			}
+			/* Batches larger than a chunk are split. */
+			if (CMM_LOAD_SHARED(crdp->nr_helpers)
+			    && uatomic_read(&crdp->qlen) > CALL_RCU_HELPER_CHUNK) {
+				/* Helpers created before the pointer is read. */
+				cmm_smp_rmb();
+				cbcount += call_rcu_exec_parallel(crdp,
+					&cbs_tmp_head, &cbs_tmp_tail);
+			}
+			__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head,
+					&cbs_tmp_tail, cbs, cbs_tmp_n) {
+				struct rcu_head *rhp;
+
+				rhp = caa_container_of(cbs,
+					struct rcu_head, next);
+				cbcount++;
+				if (crdp->nr_nodes
+				    && rhp->func == _rcu_barrier_complete) {
+					cds_wfcq_node_init(&rhp->next);
+					cds_wfcq_enqueue(&crdp->deferred_head,
+						&crdp->deferred_tail,
+						&rhp->next);
+					continue;
+				}
+				call_rcu_invoke(crdp, rhp);
+			}
+			if (crdp->nr_nodes)
+				cbcount += call_rcu_exec_wait(crdp);
+			if (victim)
+				call_rcu_take_done(victim);
+			urcu_trace2(call_rcu_batch_end, crdp, cbcount);
+			call_rcu_stats_batch(crdp, cbcount, oldest_ns,
+					newest_ns, start_ns, urcu_time_ns(), 1);
+			uatomic_sub_mo(&crdp->qlen, cbcount, CMM_RELAXED);
+			call_rcu_backpressure_update(crdp);
+		}
+		if (uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOP)
+			break;
+		/* Keep helping while other queues are busy. */
+		if (stolen)
+			continue;
+		call_rcu_update_delay(crdp);
+		rcu_thread_offline();
+		if (busy_poll) {
+			call_rcu_busy_poll(crdp);
+		} else if (!rt) {
+			if (call_rcu_lazy_idle(crdp)
+			    && call_rcu_lazy_pending(crdp)) {
+				if (!call_rcu_wait_timeout(crdp,
+						call_rcu_lazy_wait_ms(crdp)))
+					call_rcu_batch_delay(crdp);
+				cds_eventcount_prepare_wait(&crdp->wait_ec);
+			} else if (call_rcu_idle(crdp)) {
+				if (!CMM_LOAD_SHARED(crdp->idle_ms)) {
+					call_rcu_wait(crdp);
+				} else if (call_rcu_wait_timeout(crdp,
+						crdp->idle_ms)
+					   && call_rcu_retire(crdp)) {
+					rcu_thread_online();
+					retired = 1;
+					break;
+				}
+				call_rcu_batch_delay(crdp);
+				cds_eventcount_prepare_wait(&crdp->wait_ec);
+			} else {
+				call_rcu_batch_delay(crdp);
+			}
+		} else {
+			call_rcu_batch_delay(crdp);
+		}
+		rcu_thread_online();
+	}
+	if (!rt) {
+		/*
+		 * Read call_rcu list before write futex.
+		 */
+		cmm_smp_mb();
+		cds_eventcount_cancel_wait(&crdp->wait_ec);
+	}
+	if (CMM_LOAD_SHARED(crdp->nr_helpers) || crdp->nr_nodes)
+		call_rcu_helpers_stop(crdp);
+	uatomic_or(&crdp->flags, URCU_CALL_RCU_STOPPED);
+	rcu_unregister_thread();
+	if (retired) {
+		/* Unreachable and idle, see call_rcu_retire(). */
+		URCU_TLS(thread_call_rcu_data) = NULL;
+		(void) pthread_detach(pthread_self());
+		(void) pthread_mutex_destroy(&crdp->stats_lock);
+		urcu_placement_destroy(&crdp->placement);
+		urcu_free(crdp->helper_tids);
+		urcu_free(crdp);
+	}
+	return NULL;
+}
+
+/*
+ * Allocate one sub-queue per CPU, up to CALL_RCU_MAX_SHARDS, for the
+ * default call_rcu_data, and for URCU_CALL_RCU_NUMA ones, even with a
+ * single CPU. Without CPU numbers, or if the allocation fails, all
+ * callbacks go to the main queue.
+ */
+static void call_rcu_shards_init(struct call_rcu_data *crdp)
+{
+#if defined(HAVE_SYSCONF) && (defined(HAVE_SCHED_GETCPU) || defined(HAVE_GETCPUID))
+	struct call_rcu_shard *shards;
+	long nr = sysconf(_SC_NPROCESSORS_CONF);
+	long i;
+
+	if (nr < 1 || (nr == 1 && !(crdp->flags & URCU_CALL_RCU_NUMA)))
+		return;
+	if (nr > CALL_RCU_MAX_SHARDS)
+		nr = CALL_RCU_MAX_SHARDS;
+	if (urcu_posix_memalign((void **) &shards, CAA_CACHE_LINE_SIZE,
+			nr * sizeof(*shards)))
+		return;
+	memset(shards, '\0', nr * sizeof(*shards));
+	for (i = 0; i < nr; i++)
+		cds_wfcq_init(&shards[i].head, &shards[i].tail);
+	crdp->shards = shards;
+	crdp->nr_shards = (unsigned int) nr;
+#endif
+}
+
+static void call_rcu_node_init(struct call_rcu_data *crdp,
+		struct call_rcu_node *node, int nr)
+{
+	cds_wfcq_init(&node->batch_head, &node->batch_tail);
+	cds_wfcq_init(&node->exec_head, &node->exec_tail);
+	node->crdp = crdp;
+	urcu_placement_init(&node->placement);
+	node->node = nr;
+}
+
+/*
+ * Map the sub-queues of a URCU_CALL_RCU_NUMA call_rcu_data to the NUMA
+ * nodes of their CPUs, and start a worker thread pinned to each node.
+ * Sub-queues are indexed by CPU modulo CALL_RCU_MAX_SHARDS: on larger
+ * machines, each goes to the node of the CPU of its index, even if it
+ * is shared with CPUs of other nodes. Without NUMA nodes, a single
+ * unpinned worker invokes all the callbacks of the sub-queues. Without
+ * sub-queues, callbacks are invoked by the call_rcu thread.
+ */
+static void call_rcu_nodes_init(struct call_rcu_data *crdp)
+{
+	struct call_rcu_node *nodes;
+	unsigned int i, nr = 0;
+#if HAVE_SCHED_SETAFFINITY
+	struct urcu_placement p;
+	cpu_set_t online;
+	int node, found;
+#endif
+	int ret;
+
+	if (!crdp->nr_shards)
+		return;
+	/* At most one node per sub-queue. */
+	if (urcu_posix_memalign((void **) &nodes, CAA_CACHE_LINE_SIZE,
+			crdp->nr_shards * sizeof(*nodes)))
+		return;
+	memset(nodes, '\0', crdp->nr_shards * sizeof(*nodes));
+#if HAVE_SCHED_SETAFFINITY
+	urcu_placement_online_nodes(&online);
+	for (node = 0; node < CPU_SETSIZE; node++) {
+		if (!CPU_ISSET(node, &online))
+			continue;
+		memset(&p, 0, sizeof(p));
+		if (urcu_placement_node(&p, node) || !p.pinned)
+			continue;
+		found = 0;
+		for (i = 0; i < crdp->nr_shards && i < CPU_SETSIZE; i++) {
+			if (!CPU_ISSET(i, &p.cpuset))
+				continue;
+			crdp->shards[i].node = nr;
+			found = 1;
+		}
+		if (!found)
+			continue;
+		call_rcu_node_init(crdp, &nodes[nr], node);
+		urcu_placement_update(&nodes[nr].placement, &p);
+		if (++nr == crdp->nr_shards)
+			break;
+	}
+#endif
+	/* Unpinned: the worker keeps the affinity it starts with. */
+	if (!nr)
+		call_rcu_node_init(crdp, &nodes[nr++], 0);
+	for (i = 0; i < nr; i++) {
+		ret = pthread_create(&nodes[i].tid, NULL,
+				call_rcu_node_thread, &nodes[i]);
+		if (ret)
+			urcu_die(ret);
+	}
+	crdp->nodes = nodes;
+	crdp->nr_nodes = nr;
+}
+
+static void call_rcu_nodes_free(struct call_rcu_data *crdp)
+{
+	unsigned int i;
+
+	for (i = 0; i < crdp->nr_nodes; i++)
+		urcu_placement_destroy(&crdp->nodes[i].placement);
+	urcu_free(crdp->nodes);
+}
+
+/*
+ * Create both a call_rcu thread and the corresponding call_rcu_data
+ * structure, linking the structure in as specified.  Caller must hold
+ * call_rcu_mutex.
+ */
+
+static void call_rcu_data_init(struct call_rcu_data **crdpp,
+			       unsigned long flags,
+			       int cpu_affinity,
+			       unsigned int min_delay_ms,
+			       unsigned int max_delay_ms)
+{
+	struct call_rcu_data *crdp;
+	int ret;
+
+	ret = urcu_posix_memalign((void **) &crdp, CAA_CACHE_LINE_SIZE,
+			     sizeof(*crdp));
+	if (ret)
+		urcu_die(ret);
+	memset(crdp, '\0', sizeof(*crdp));
+	cds_wfcq_init(&crdp->cbs.head, &crdp->cbs.tail);
+	crdp->qlen = 0;
+	cds_eventcount_init(&crdp->wait_ec);
+	/* Busy-polling threads are never woken up either. */
+	if (flags & URCU_CALL_RCU_BUSY_POLL)
+		flags |= URCU_CALL_RCU_RT;
+	/* Stolen and event fd callbacks do not go to the sub-queues. */
+	if (flags & (URCU_CALL_RCU_STEAL | URCU_CALL_RCU_EVENTFD))
+		flags &= ~URCU_CALL_RCU_NUMA;
+	crdp->flags = flags;
+	cds_list_add(&crdp->list, &call_rcu_data_list);
+	crdp->cpu_affinity = cpu_affinity;
+	urcu_placement_init(&crdp->placement);
+	if (max_delay_ms < min_delay_ms)
+		max_delay_ms = min_delay_ms;
+	crdp->min_delay_ms = min_delay_ms;
+	crdp->max_delay_ms = max_delay_ms;
+	crdp->delay_ms = max_delay_ms;
+	crdp->last_qlen = 0;
+	cds_wfcq_init(&crdp->wait_head, &crdp->wait_tail);
+	cds_wfcq_init(&crdp->ready_head, &crdp->ready_tail);
+	crdp->event_fd[0] = crdp->event_fd[1] = -1;
+	CDS_INIT_LIST_HEAD(&crdp->poll_list);
+	ret = pthread_mutex_init(&crdp->stats_lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	cds_wfcq_init(&crdp->exec_head, &crdp->exec_tail);
+	cds_wfcq_init(&crdp->deferred_head, &crdp->deferred_tail);
+	cds_wfcq_init(&crdp->xp_head, &crdp->xp_tail);
+	cds_wfcq_init(&crdp->next_head, &crdp->next_tail);
+	cds_wfcq_init(&crdp->lazy_head, &crdp->lazy_tail);
+	crdp->lazy_delay_ms = CALL_RCU_LAZY_DELAY_MS;
+	crdp->lazy_qlen_max = CALL_RCU_LAZY_QLEN;
+	/* Only the default call_rcu_data is shared by all CPUs. */
+	if (crdpp == &default_call_rcu_data || (flags & URCU_CALL_RCU_NUMA))
+		call_rcu_shards_init(crdp);
+	if (flags & URCU_CALL_RCU_NUMA)
+		call_rcu_nodes_init(crdp);
+	if (flags & (URCU_CALL_RCU_SHARED_GP | URCU_CALL_RCU_EVENTFD))
+		call_rcu_gp_driver_start();
+	if (flags & URCU_CALL_RCU_EVENTFD) {
+		/* No thread: callbacks are invoked by the event loop. */
+		call_rcu_event_open(crdp);
+		call_rcu_lock(&call_rcu_gp_driver.poll_mutex);
+		cds_list_add(&crdp->poll_list, &call_rcu_gp_driver.poll_list);
+		call_rcu_unlock(&call_rcu_gp_driver.poll_mutex);
+		cmm_smp_mb();  /* Structure initialized before pointer is planted. */
+		*crdpp = crdp;
+		return;
+	}
+	cmm_smp_mb();  /* Structure initialized before pointer is planted. */
+	*crdpp = crdp;
+	ret = pthread_create(&crdp->tid, NULL, call_rcu_thread, crdp);
+	if (ret)
+		urcu_die(ret);
+}
+
+/*
+ * Return a pointer to the call_rcu_data structure for the specified
+ * CPU, returning NULL if there is none.  We cannot automatically
+ * created it because the platform we are running on might not define
+ * urcu_sched_getcpu().
+ *
+ * The call to this function and use of the returned call_rcu_data
+ * should be protected by RCU read-side lock.
+ */
+
+static inline struct call_rcu_data *_get_cpu_call_rcu_data(int cpu)
+{
+	static int warned = 0;
+	struct call_rcu_data **pcpu_crdp;
+
+	pcpu_crdp = rcu_dereference(per_cpu_call_rcu_data);
+	if (pcpu_crdp == NULL)
+		return NULL;
+	if (!warned && maxcpus > 0 && (cpu < 0 || maxcpus <= cpu)) {
+		fprintf(stderr, "[error] liburcu: get CPU # out of range\n");
+		warned = 1;
+	}
+	if (cpu < 0 || maxcpus <= cpu)
+		return NULL;
+	return rcu_dereference(pcpu_crdp[cpu]);
+}
+
+struct call_rcu_data *get_cpu_call_rcu_data(int cpu)
+{
+	return _get_cpu_call_rcu_data(cpu);
+}
+
+/*
+ * Return the tid corresponding to the call_rcu thread whose
+ * call_rcu_data structure is specified.
+ */
+
+pthread_t get_call_rcu_thread(struct call_rcu_data *crdp)
+{
+	return crdp->tid;
+}
+
+/*
+ * Create a call_rcu_data structure (with thread) and return a pointer.
+ */
+
+static struct call_rcu_data *__create_call_rcu_data(unsigned long flags,
+						    int cpu_affinity,
+						    unsigned int min_delay_ms,
+						    unsigned int max_delay_ms)
+{
+	struct call_rcu_data *crdp;
+
+	call_rcu_data_init(&crdp, flags, cpu_affinity, min_delay_ms,
+			   max_delay_ms);
+	return crdp;
+}
+
+struct call_rcu_data *create_call_rcu_data(unsigned long flags,
+					   int cpu_affinity)
+{
+	return create_call_rcu_data_delay(flags, cpu_affinity,
+			URCU_CALL_RCU_DEFAULT_MIN_DELAY_MS,
+			URCU_CALL_RCU_DEFAULT_MAX_DELAY_MS);
+}
+
+struct call_rcu_data *create_call_rcu_data_delay(unsigned long flags,
+						 int cpu_affinity,
+						 unsigned int min_delay_ms,
+						 unsigned int max_delay_ms)
+{
+	struct call_rcu_data *crdp;
+
+	call_rcu_lock(&call_rcu_mutex);
+	crdp = __create_call_rcu_data(flags, cpu_affinity, min_delay_ms,
+				      max_delay_ms);
+	call_rcu_unlock(&call_rcu_mutex);
+	return crdp;
+}
+
+/*
+ * Set the specified CPU to use the specified call_rcu_data structure.
+ *
+ * Use NULL to remove a CPU's call_rcu_data structure, but it is
+ * the caller's responsibility to dispose of the removed structure.
+ * Use get_cpu_call_rcu_data() to obtain a pointer to the old structure
+ * (prior to NULLing it out, of course).
+ *
+ * The caller must wait for a grace-period to pass between return from
+ * set_cpu_call_rcu_data() and call to call_rcu_data_free() passing the
+ * previous call rcu data as argument.
+ */
+
+int set_cpu_call_rcu_data(int cpu, struct call_rcu_data *crdp)
+{
+	static int warned = 0;
+
+	call_rcu_lock(&call_rcu_mutex);
+	alloc_cpu_call_rcu_data();
+	if (cpu < 0 || maxcpus <= cpu) {
+		if (!warned) {
+			fprintf(stderr, "[error] liburcu: set CPU # out of range\n");
+			warned = 1;
+		}
+		call_rcu_unlock(&call_rcu_mutex);
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	if (per_cpu_call_rcu_data == NULL) {
+		call_rcu_unlock(&call_rcu_mutex);
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+
+	if (per_cpu_call_rcu_data[cpu] != NULL && crdp != NULL) {
+		call_rcu_unlock(&call_rcu_mutex);
+		errno = EEXIST;
+		return -EEXIST;
+	}
+
+	rcu_set_pointer(&per_cpu_call_rcu_data[cpu], crdp);
+	call_rcu_unlock(&call_rcu_mutex);
+	return 0;
+}
+
+/*
+ * Return a pointer to the default call_rcu_data structure, creating
+ * one if need be.  Because we never free call_rcu_data structures,
+ * we don't need to be in an RCU read-side critical section.
+ */
+
+struct call_rcu_data *get_default_call_rcu_data(void)
+{
+	if (default_call_rcu_data != NULL)
+		return rcu_dereference(default_call_rcu_data);
+	call_rcu_lock(&call_rcu_mutex);
+	if (default_call_rcu_data != NULL) {
+		call_rcu_unlock(&call_rcu_mutex);
+		return default_call_rcu_data;
+	}
+	call_rcu_data_init(&default_call_rcu_data, 0, -1,
+			   URCU_CALL_RCU_DEFAULT_MIN_DELAY_MS,
+			   URCU_CALL_RCU_DEFAULT_MAX_DELAY_MS);
+	call_rcu_unlock(&call_rcu_mutex);
+	if (caa_unlikely(CMM_LOAD_SHARED(call_rcu_fork_pending)))
+		call_rcu_fork_child_cleanup();
+	return default_call_rcu_data;
+}
+
+/*
+ * Lazy mode: create the call_rcu_data of @cpu the first time it is
+ * needed. The caller is either in a RCU read-side critical section, or
+ * has to rely on the call_rcu_data not being freed.
+ */
+static struct call_rcu_data *get_lazy_cpu_call_rcu_data(int cpu)
+{
+	struct call_rcu_data *crdp = NULL;
+
+	call_rcu_lock(&call_rcu_mutex);
+	if (!lazy_cpu_call_rcu || per_cpu_call_rcu_data == NULL
+	    || cpu >= maxcpus)
+		goto end;
+	crdp = per_cpu_call_rcu_data[cpu];
+	if (crdp)
+		goto end;
+	crdp = __create_call_rcu_data(lazy_cpu_flags, cpu,
+			URCU_CALL_RCU_DEFAULT_MIN_DELAY_MS,
+			URCU_CALL_RCU_DEFAULT_MAX_DELAY_MS);
+	if (!crdp)
+		goto end;
+	/* Read by the new thread once it is idle. */
+	CMM_STORE_SHARED(crdp->idle_ms, lazy_cpu_idle_ms);
+	rcu_set_pointer(&per_cpu_call_rcu_data[cpu], crdp);
+end:
+	call_rcu_unlock(&call_rcu_mutex);
+	return crdp;
+}
+
+/*
+ * Return the call_rcu_data structure that applies to the currently
+ * running thread.  Any call_rcu_data structure assigned specifically
+ * to this thread has first priority, followed by any call_rcu_data
+ * structure assigned to the CPU on which the thread is running,
+ * followed by the default call_rcu_data structure.  If there is not
+ * yet a default call_rcu_data structure, one will be created.
+ *
+ * Calls to this function and use of the returned call_rcu_data should
+ * be protected by RCU read-side lock.
+ */
+static inline struct call_rcu_data *_get_call_rcu_data(void)
+{
+	struct call_rcu_data *crd;
+
+	if (URCU_TLS(thread_call_rcu_data) != NULL)
+		return URCU_TLS(thread_call_rcu_data);
+
+	if (maxcpus > 0) {
+		int cpu = urcu_sched_getcpu();
+
+		crd = _get_cpu_call_rcu_data(cpu);
+		if (crd)
+			return crd;
+		if (caa_unlikely(CMM_LOAD_SHARED(lazy_cpu_call_rcu))
+		    && cpu >= 0) {
+			crd = get_lazy_cpu_call_rcu_data(cpu);
+			if (crd)
+				return crd;
+		}
+	}
+
+	return get_default_call_rcu_data();
+}
+
+struct call_rcu_data *get_call_rcu_data(void)
+{
+	return _get_call_rcu_data();
+}
+
+/*
+ * Return a pointer to this task's call_rcu_data if there is one.
+ */
+
+struct call_rcu_data *get_thread_call_rcu_data(void)
+{
+	return URCU_TLS(thread_call_rcu_data);
+}
+
+/*
+ * Set this task's call_rcu_data structure as specified, regardless
+ * of whether or not this task already had one.  (This allows switching
+ * to and from real-time call_rcu threads, for example.)
+ *
+ * Use NULL to remove a thread's call_rcu_data structure, but it is
+ * the caller's responsibility to dispose of the removed structure.
+ * Use get_thread_call_rcu_data() to obtain a pointer to the old structure
+ * (prior to NULLing it out, of course).
+ */
+
+void set_thread_call_rcu_data(struct call_rcu_data *crdp)
+{
+	URCU_TLS(thread_call_rcu_data) = crdp;
+}
+
+/*
+ * Create a separate call_rcu thread for each CPU.  This does not
+ * replace a pre-existing call_rcu thread -- use the set_cpu_call_rcu_data()
+ * function if you want that behavior. Should be paired with
+ * free_all_cpu_call_rcu_data() to teardown these call_rcu worker
+ * threads.
+ */
+
+int create_all_cpu_call_rcu_data(unsigned long flags)
+{
+	int i;
+	struct call_rcu_data *crdp;
+	int ret;
+
+	call_rcu_lock(&call_rcu_mutex);
+	alloc_cpu_call_rcu_data();
+	call_rcu_unlock(&call_rcu_mutex);
+	if (maxcpus <= 0) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	if (per_cpu_call_rcu_data == NULL) {
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+	for (i = 0; i < maxcpus; i++) {
+		call_rcu_lock(&call_rcu_mutex);
+		if (get_cpu_call_rcu_data(i)) {
+			call_rcu_unlock(&call_rcu_mutex);
+			continue;
+		}
+		crdp = __create_call_rcu_data(flags, i,
+				URCU_CALL_RCU_DEFAULT_MIN_DELAY_MS,
+				URCU_CALL_RCU_DEFAULT_MAX_DELAY_MS);
+		if (crdp == NULL) {
+			call_rcu_unlock(&call_rcu_mutex);
+			errno = ENOMEM;
+			return -ENOMEM;
+		}
+		call_rcu_unlock(&call_rcu_mutex);
+		if ((ret = set_cpu_call_rcu_data(i, crdp)) != 0) {
+			call_rcu_data_free(crdp);
+
+			/* it has been created by other thread */
+			if (ret == -EEXIST)
+				continue;
+
+			return ret;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Have get_call_rcu_data() create the call_rcu_data of each CPU the
+ * first time call_rcu() is used on that CPU. With a non-zero
+ * @idle_timeout_ms, their threads exit after being idle for that long,
+ * and are created again when needed.
+ */
+int create_lazy_cpu_call_rcu_data(unsigned long flags,
+				  unsigned int idle_timeout_ms)
+{
+	if (flags & URCU_CALL_RCU_EVENTFD) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	call_rcu_lock(&call_rcu_mutex);
+	alloc_cpu_call_rcu_data();
+	if (maxcpus <= 0) {
+		call_rcu_unlock(&call_rcu_mutex);
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	if (per_cpu_call_rcu_data == NULL) {
+		call_rcu_unlock(&call_rcu_mutex);
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+	lazy_cpu_flags = flags;
+	lazy_cpu_idle_ms = idle_timeout_ms;
+	CMM_STORE_SHARED(lazy_cpu_call_rcu, 1);
+	call_rcu_unlock(&call_rcu_mutex);
+	return 0;
+}
+
+/*
+ * Create a call_rcu_data for NUMA node @node, pinned to its CPUs, and
+ * use it for those which have none yet. Without NUMA nodes, node 0 has
+ * all the CPUs.
+ */
+static int create_node_call_rcu_data(unsigned long flags, int node)
+{
+	struct call_rcu_data *crdp;
+	struct urcu_placement p;
+	unsigned int nr_cpus = 0;
+	int cpu, ret;
+
+	memset(&p, 0, sizeof(p));
+#if HAVE_SCHED_SETAFFINITY
+	ret = urcu_placement_node(&p, node);
+	if (ret)
+		return ret;
+#endif
+	call_rcu_lock(&call_rcu_mutex);
+	crdp = __create_call_rcu_data(flags, -1,
+			URCU_CALL_RCU_DEFAULT_MIN_DELAY_MS,
+			URCU_CALL_RCU_DEFAULT_MAX_DELAY_MS);
+	call_rcu_unlock(&call_rcu_mutex);
+	if (crdp == NULL)
+		return -ENOMEM;
+	if (p.pinned)
+		urcu_placement_update(&crdp->placement, &p);
+	for (cpu = 0; cpu < maxcpus; cpu++) {
+#if HAVE_SCHED_SETAFFINITY
+		if (p.pinned && (cpu >= CPU_SETSIZE
+				|| !CPU_ISSET(cpu, &p.cpuset)))
+			continue;
+#endif
+		ret = set_cpu_call_rcu_data(cpu, crdp);
+		if (ret == -EEXIST)
+			continue;
+		if (ret) {
+			if (!nr_cpus)
+				call_rcu_data_free(crdp);
+			return ret;
+		}
+		nr_cpus++;
+	}
+	/* All the CPUs of the node have one already. */
+	if (!nr_cpus)
+		call_rcu_data_free(crdp);
+	return 0;
+}
+
+/*
+ * Create a call_rcu_data per NUMA node, see create_node_call_rcu_data().
+ * Nodes are listed like CPUs, e.g. "0-3".
+ */
+int create_all_node_call_rcu_data(unsigned long flags)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t nodes;
+	int node;
+#endif
+	int ret;
+
+	call_rcu_lock(&call_rcu_mutex);
+	alloc_cpu_call_rcu_data();
+	call_rcu_unlock(&call_rcu_mutex);
+	if (maxcpus <= 0) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	if (per_cpu_call_rcu_data == NULL) {
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+#if HAVE_SCHED_SETAFFINITY
+	urcu_placement_online_nodes(&nodes);
+	for (node = 0; node < CPU_SETSIZE; node++) {
+		if (!CPU_ISSET(node, &nodes))
+			continue;
+		ret = create_node_call_rcu_data(flags, node);
+		/* Nodes without CPUs. */
+		if (ret == -EINVAL)
+			continue;
+		if (ret)
+			goto error;
+	}
+	return 0;
+#else
+	ret = create_node_call_rcu_data(flags, 0);
+	if (!ret)
+		return 0;
+#endif
+error:
+	errno = -ret;
+	return ret;
+}
+
+/*
+ * Wake up the call_rcu thread corresponding to the specified
+ * call_rcu_data structure.
+ */
+static void wake_call_rcu_thread(struct call_rcu_data *crdp)
+{
+	if (!(_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_RT))
+		call_rcu_wake_up(crdp);
+}
+
+/*
+ * Wake up the idle call_rcu threads which can steal callbacks from a
+ * queue becoming busy. Skipped if call_rcu_mutex is held.
+ */
+static void wake_call_rcu_thieves(struct call_rcu_data *crdp)
+{
+	struct call_rcu_data *thief;
+
+	if (pthread_mutex_trylock(&call_rcu_mutex))
+		return;
+	cds_list_for_each_entry(thief, &call_rcu_data_list, list) {
+		if (thief != crdp
+		    && (uatomic_read(&thief->flags) & URCU_CALL_RCU_STEAL)
+		    && !uatomic_read(&thief->qlen))
+			wake_call_rcu_thread(thief);
+	}
+	call_rcu_unlock(&call_rcu_mutex);
+}
+
+/*
+ * Account for @count callbacks enqueued on crdp, and wake up the
+ * call_rcu thread.
+ */
+static void call_rcu_enqueued(struct call_rcu_data *crdp, bool was_nonempty,
+			      unsigned long count)
+{
+	unsigned long high = CMM_LOAD_SHARED(crdp->high_watermark);
+
+	if (!was_nonempty)
+		CMM_STORE_SHARED(crdp->batch_first_ns, urcu_time_ns());
+	if (caa_likely(!high && !(_CMM_LOAD_SHARED(crdp->flags)
+			& URCU_CALL_RCU_STEAL))) {
+		uatomic_add_mo(&crdp->qlen, count, CMM_RELAXED);
+	} else {
+		unsigned long qlen = uatomic_add_return_mo(&crdp->qlen, count,
+							   CMM_RELAXED);
+
+		if (high && qlen >= high
+		    && !CMM_LOAD_SHARED(crdp->backpressure))
+			CMM_STORE_SHARED(crdp->backpressure, 1);
+		if (qlen >= CALL_RCU_BUSY_QLEN
+		    && qlen - count < CALL_RCU_BUSY_QLEN
+		    && (_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_STEAL))
+			wake_call_rcu_thieves(crdp);
+	}
+	if (_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_EVENTFD) {
+		/*
+		 * Only the first callback of a batch requests a grace
+		 * period: the driver thread splices the queue after
+		 * reading the request, and a splice waits for the
+		 * enqueues which found the queue non-empty.
+		 */
+		if (!was_nonempty)
+			(void) call_rcu_gp_request();
+		return;
+	}
+	wake_call_rcu_thread(crdp);
+}
+
+/*
+ * Return the sub-queue of the calling CPU if @crdp has sub-queues and
+ * none of its watermarks, work stealing or event fd need the callbacks
+ * to be counted in qlen or queued on the main queue, NULL otherwise.
+ */
+static struct call_rcu_shard *call_rcu_get_shard(struct call_rcu_data *crdp)
+{
+	int cpu;
+
+	if (caa_likely(!crdp->nr_shards))
+		return NULL;
+	if (CMM_LOAD_SHARED(crdp->high_watermark)
+	    || (_CMM_LOAD_SHARED(crdp->flags)
+		& (URCU_CALL_RCU_STEAL | URCU_CALL_RCU_EVENTFD)))
+		return NULL;
+	cpu = urcu_sched_getcpu();
+	if (caa_unlikely(cpu < 0))
+		return NULL;
+	return &crdp->shards[(unsigned int) cpu % crdp->nr_shards];
+}
+
+/*
+ * Queue the callbacks from @first to @last on a sub-queue of crdp, and
+ * wake up the call_rcu thread.
+ */
+static void call_rcu_shard_enqueue(struct call_rcu_data *crdp,
+		struct call_rcu_shard *shard, struct rcu_head *first,
+		struct rcu_head *last, unsigned long count)
+{
+	uatomic_add_mo(&shard->qlen, count, CMM_RELAXED);
+	if (!cds_wfcq_enqueue_batch(&shard->head, &shard->tail,
+			&first->next, &last->next))
+		CMM_STORE_SHARED(shard->first_ns, urcu_time_ns());
+	wake_call_rcu_thread(crdp);
+}
+
+static void __call_rcu(struct rcu_head *head,
+		       void (*func)(struct rcu_head *head),
+		       struct call_rcu_data *crdp, int expedited)
+{
+	bool was_nonempty;
+
+	urcu_trace3(call_rcu, crdp, head, func);
+	cds_wfcq_node_init(&head->next);
+	head->func = func;
+	/* Without call_rcu thread, there is no batching delay to skip. */
+	if (expedited
+	    && !(_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_EVENTFD)) {
+		(void) cds_wfcq_enqueue(&crdp->xp_head, &crdp->xp_tail,
+					&head->next);
+		uatomic_inc_mo(&crdp->qlen, CMM_RELAXED);
+		wake_call_rcu_thread(crdp);
+		call_rcu_xp_wake_up(crdp);
+		return;
+	}
+	was_nonempty = cds_wfcq_enqueue(&crdp->cbs.head, &crdp->cbs.tail,
+					&head->next);
+	call_rcu_enqueued(crdp, was_nonempty, 1);
+}
+
+static void _call_rcu(struct rcu_head *head,
+		      void (*func)(struct rcu_head *head),
+		      struct call_rcu_data *crdp)
+{
+	__call_rcu(head, func, crdp, 0);
 }
 
 /*
- * Return a pointer to the call_rcu_data structure for the specified
- * CPU, returning NULL if there is none.  We cannot automatically
- * created it because the platform we are running on might not define
- * urcu_sched_getcpu().
- *
- * The call to this function and use of the returned call_rcu_data
- * should be protected by RCU read-side lock.
+ * Invoke the callbacks queued on a call_rcu_data from the calling
+ * thread, up to its first rcu_barrier() callback, see call_rcu_take().
+ * Called within RCU read-side critical section, which is exited before
+ * waiting for the grace period: crdp may then only be freed once
+ * call_rcu_take_done() is called. Returns the number of callbacks
+ * invoked.
  */
+static unsigned long call_rcu_help(struct call_rcu_data *crdp)
+{
+	struct cds_wfcq_head cbs_tmp_head;
+	struct cds_wfcq_tail cbs_tmp_tail;
+	struct cds_wfcq_node *cbs, *cbs_tmp_n;
+	unsigned long cbcount;
+	uint64_t oldest_ns, newest_ns, start_ns;
+
+	cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
+	oldest_ns = CMM_LOAD_SHARED(crdp->batch_first_ns);
+	cbcount = call_rcu_take(crdp, &cbs_tmp_head, &cbs_tmp_tail);
+	if (cbcount)
+		uatomic_sub_mo(&crdp->qlen, cbcount, CMM_RELAXED);
+	call_rcu_backpressure_update(crdp);
+	_rcu_read_unlock();
+	if (!cbcount)
+		return 0;
+	newest_ns = urcu_time_ns();
+	synchronize_rcu();
+	start_ns = urcu_time_ns();
+	urcu_trace1(call_rcu_batch_start, crdp);
+	URCU_TLS(call_rcu_no_backpressure) = 1;
+	__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head, &cbs_tmp_tail,
+			cbs, cbs_tmp_n) {
+		struct rcu_head *rhp;
+
+		rhp = caa_container_of(cbs, struct rcu_head, next);
+		rhp->func(rhp);
+	}
+	URCU_TLS(call_rcu_no_backpressure) = 0;
+	urcu_trace2(call_rcu_batch_end, crdp, cbcount);
+	call_rcu_stats_batch(crdp, cbcount, oldest_ns, newest_ns, start_ns,
+			urcu_time_ns(), 1);
+	call_rcu_take_done(crdp);
+	return cbcount;
+}
 
-struct call_rcu_data *get_cpu_call_rcu_data(int cpu)
+/*
+ * Apply the backpressure of the call_rcu_data of the calling thread, if
+ * its high watermark was reached. Callers within RCU read-side critical
+ * section, which includes online QSBR threads, and call_rcu threads are
+ * never held back, because grace periods would then wait for them.
+ * The enqueue functions only call it when they found the call_rcu_data
+ * they enqueued on past its high watermark.
+ */
+static void call_rcu_backpressure(void)
 {
-	static int warned = 0;
-	struct call_rcu_data **pcpu_crdp;
+	struct call_rcu_data *crdp;
 
-	pcpu_crdp = rcu_dereference(per_cpu_call_rcu_data);
-	if (pcpu_crdp == NULL)
-		return NULL;
-	if (!warned && maxcpus > 0 && (cpu < 0 || maxcpus <= cpu)) {
-		fprintf(stderr, "[error] liburcu: get CPU # out of range\n");
-		warned = 1;
+	if (URCU_TLS(call_rcu_no_backpressure) || _rcu_read_ongoing())
+		return;
+	for (;;) {
+		_rcu_read_lock();
+		crdp = _get_call_rcu_data();
+		if (caa_likely(!CMM_LOAD_SHARED(crdp->backpressure)))
+			break;
+		/*
+		 * Wait for the call_rcu thread if the queue starts with a
+		 * rcu_barrier() callback, which only it invokes.
+		 */
+		if (CMM_LOAD_SHARED(crdp->backpressure_mode)
+				== URCU_CALL_RCU_BACKPRESSURE_HELP) {
+			if (call_rcu_help(crdp))
+				return;
+		} else {
+			_rcu_read_unlock();
+		}
+		(void) poll(NULL, 0, 1);
 	}
-	if (cpu < 0 || maxcpus <= cpu)
-		return NULL;
-	return rcu_dereference(pcpu_crdp[cpu]);
+	_rcu_read_unlock();
 }
 
 /*
- * Return the tid corresponding to the call_rcu thread whose
- * call_rcu_data structure is specified.
+ * Schedule a function to be invoked after a following grace period.
+ * This is the only function that must be called -- the others are
+ * only present to allow applications to tune their use of RCU for
+ * maximum performance.
+ *
+ * Note that unless a call_rcu thread has not already been created,
+ * the first invocation of call_rcu() will create one.  So, if you
+ * need the first invocation of call_rcu() to be fast, make sure
+ * to create a call_rcu thread first.  One way to accomplish this is
+ * "get_call_rcu_data();", and another is create_all_cpu_call_rcu_data().
+ *
+ * call_rcu must be called by registered RCU read-side threads.
+ *
+ * Past the high watermark of its call_rcu_data, call_rcu waits for the
+ * queue to drain, or invokes the queued callbacks itself, unless it is
+ * called within a RCU read-side critical section.
  */
-
-pthread_t get_call_rcu_thread(struct call_rcu_data *crdp)
+void call_rcu(struct rcu_head *head,
+	      void (*func)(struct rcu_head *head))
 {
-	return crdp->tid;
+	struct call_rcu_data *crdp;
+	int backpressure;
+
+	struct call_rcu_shard *shard;
+
+	/* Holding rcu read-side lock across use of per-cpu crdp */
+	_rcu_read_lock();
+	crdp = _get_call_rcu_data();
+	shard = call_rcu_get_shard(crdp);
+	if (shard) {
+		urcu_trace3(call_rcu, crdp, head, func);
+		cds_wfcq_node_init(&head->next);
+		head->func = func;
+		call_rcu_shard_enqueue(crdp, shard, head, head, 1);
+	} else {
+		_call_rcu(head, func, crdp);
+	}
+	backpressure = CMM_LOAD_SHARED(crdp->backpressure);
+	_rcu_read_unlock();
+	if (caa_unlikely(backpressure))
+		call_rcu_backpressure();
 }
 
 /*
- * Create a call_rcu_data structure (with thread) and return a pointer.
+ * Queue the callbacks from @first to @last, linked through their
+ * next.next field with last->next.next NULL, each with its func set,
+ * with a single enqueue.
  */
-
-static struct call_rcu_data *__create_call_rcu_data(unsigned long flags,
-						    int cpu_affinity)
+void call_rcu_batch(struct rcu_head *first, struct rcu_head *last)
 {
 	struct call_rcu_data *crdp;
+	struct call_rcu_shard *shard;
+	struct rcu_head *head;
+	unsigned long count = 0;
+	bool was_nonempty;
+	int backpressure;
 
-	call_rcu_data_init(&crdp, flags, cpu_affinity);
-	return crdp;
+	_rcu_read_lock();
+	crdp = _get_call_rcu_data();
+	for (head = first; ;
+	     head = caa_container_of(head->next.next, struct rcu_head, next)) {
+		urcu_trace3(call_rcu, crdp, head, head->func);
+		count++;
+		if (head == last)
+			break;
+	}
+	assert(!last->next.next);
+	shard = call_rcu_get_shard(crdp);
+	if (shard) {
+		call_rcu_shard_enqueue(crdp, shard, first, last, count);
+	} else {
+		was_nonempty = cds_wfcq_enqueue_batch(&crdp->cbs.head,
+				&crdp->cbs.tail, &first->next, &last->next);
+		call_rcu_enqueued(crdp, was_nonempty, count);
+	}
+	backpressure = CMM_LOAD_SHARED(crdp->backpressure);
+	_rcu_read_unlock();
+	if (caa_unlikely(backpressure))
+		call_rcu_backpressure();
 }
 
-struct call_rcu_data *create_call_rcu_data(unsigned long flags,
-					   int cpu_affinity)
+/*
+ * Same as call_rcu(), for callbacks which should be invoked as soon as
+ * possible, e.g. to release large buffers. Expedited callbacks go to a
+ * separate queue: the call_rcu thread is woken up without batching
+ * delay, does not wait for the grace-period driver thread, and invokes
+ * them before the other callbacks of its batch.
+ */
+void call_rcu_expedited(struct rcu_head *head,
+			void (*func)(struct rcu_head *head))
 {
 	struct call_rcu_data *crdp;
+	int backpressure;
 
-	call_rcu_lock(&call_rcu_mutex);
-	crdp = __create_call_rcu_data(flags, cpu_affinity);
-	call_rcu_unlock(&call_rcu_mutex);
-	return crdp;
+	_rcu_read_lock();
+	crdp = _get_call_rcu_data();
+	__call_rcu(head, func, crdp, 1);
+	backpressure = CMM_LOAD_SHARED(crdp->backpressure);
+	_rcu_read_unlock();
+	if (caa_unlikely(backpressure))
+		call_rcu_backpressure();
 }
 
 /*
- * Set the specified CPU to use the specified call_rcu_data structure.
- *
- * Use NULL to remove a CPU's call_rcu_data structure, but it is
- * the caller's responsibility to dispose of the removed structure.
- * Use get_cpu_call_rcu_data() to obtain a pointer to the old structure
- * (prior to NULLing it out, of course).
- *
- * The caller must wait for a grace-period to pass between return from
- * set_cpu_call_rcu_data() and call to call_rcu_data_free() passing the
- * previous call rcu data as argument.
+ * Same as call_rcu(), for callbacks which can wait, e.g. frees in code
+ * tolerating some memory overhead. Lazy callbacks go to a separate
+ * queue, which does not wake up the call_rcu thread, except for the
+ * first callback of the queue, so that it sleeps until they are due.
+ * They are processed with the next batch of other callbacks, including
+ * those of rcu_barrier(), or once their delay elapsed or too many are
+ * queued, see call_rcu_data_set_lazy().
  */
-
-int set_cpu_call_rcu_data(int cpu, struct call_rcu_data *crdp)
+void call_rcu_lazy(struct rcu_head *head,
+		   void (*func)(struct rcu_head *head))
 {
-	static int warned = 0;
+	struct call_rcu_data *crdp;
+	unsigned long lazy_qlen;
+	bool was_nonempty;
+	int backpressure;
 
-	call_rcu_lock(&call_rcu_mutex);
-	alloc_cpu_call_rcu_data();
-	if (cpu < 0 || maxcpus <= cpu) {
-		if (!warned) {
-			fprintf(stderr, "[error] liburcu: set CPU # out of range\n");
-			warned = 1;
+	_rcu_read_lock();
+	crdp = _get_call_rcu_data();
+	/* Without call_rcu thread, there is no wake-up to save. */
+	if (_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_EVENTFD) {
+		_call_rcu(head, func, crdp);
+	} else {
+		urcu_trace3(call_rcu, crdp, head, func);
+		cds_wfcq_node_init(&head->next);
+		head->func = func;
+		lazy_qlen = uatomic_add_return_mo(&crdp->lazy_qlen, 1,
+						  CMM_RELAXED);
+		was_nonempty = cds_wfcq_enqueue(&crdp->lazy_head,
+				&crdp->lazy_tail, &head->next);
+		if (!was_nonempty) {
+			CMM_STORE_SHARED(crdp->lazy_first_ns,
+					 urcu_time_ns());
+			wake_call_rcu_thread(crdp);
+		} else if (lazy_qlen == CMM_LOAD_SHARED(crdp->lazy_qlen_max)) {
+			wake_call_rcu_thread(crdp);
 		}
-		call_rcu_unlock(&call_rcu_mutex);
-		errno = EINVAL;
-		return -EINVAL;
 	}
+	backpressure = CMM_LOAD_SHARED(crdp->backpressure);
+	_rcu_read_unlock();
+	if (caa_unlikely(backpressure))
+		call_rcu_backpressure();
+}
 
-	if (per_cpu_call_rcu_data == NULL) {
-		call_rcu_unlock(&call_rcu_mutex);
-		errno = ENOMEM;
-		return -ENOMEM;
-	}
+/*
+ * Queue the callbacks staged by call_rcu_local() in the current thread.
+ */
+void call_rcu_flush(void)
+{
+	struct call_rcu_staged *staged = &URCU_TLS(call_rcu_staged);
+	struct rcu_head *first = staged->first, *last = staged->last;
 
-	if (per_cpu_call_rcu_data[cpu] != NULL && crdp != NULL) {
-		call_rcu_unlock(&call_rcu_mutex);
-		errno = EEXIST;
-		return -EEXIST;
-	}
+	if (!first)
+		return;
+	staged->first = staged->last = NULL;
+	staged->len = 0;
+	call_rcu_batch(first, last);
+}
 
-	rcu_set_pointer(&per_cpu_call_rcu_data[cpu], crdp);
-	call_rcu_unlock(&call_rcu_mutex);
-	return 0;
+/*
+ * Same as call_rcu(), for threads queueing many callbacks in a row,
+ * e.g. when removing many nodes: callbacks are staged in a per-thread
+ * list without touching the call_rcu_data, and queued together by
+ * call_rcu_batch() once CALL_RCU_LOCAL_LEN are staged, or by
+ * call_rcu_flush(). Staged callbacks are not waited for by
+ * rcu_barrier() until flushed.
+ *
+ * call_rcu_local must be called by registered RCU read-side threads.
+ */
+void call_rcu_local(struct rcu_head *head,
+		    void (*func)(struct rcu_head *head))
+{
+	struct call_rcu_staged *staged = &URCU_TLS(call_rcu_staged);
+
+	head->func = func;
+	head->next.next = NULL;
+	if (staged->last)
+		staged->last->next.next = &head->next;
+	else
+		staged->first = head;
+	staged->last = head;
+	if (++staged->len == CALL_RCU_LOCAL_LEN)
+		call_rcu_flush();
+}
+
+static void rcu_async_complete(struct rcu_head *head)
+{
+	struct rcu_async *req = caa_container_of(head, struct rcu_async, head);
+	int fd = req->fd;
+	uint64_t one = 1;
+	ssize_t ret;
+
+	/* The request may be reused or freed as soon as done is set. */
+	cmm_smp_mb();
+	uatomic_set(&req->done, 1);
+	if (fd < 0)
+		return;
+	do {
+		ret = write(fd, &one, sizeof(one));
+	} while (ret < 0 && errno == EINTR);
+	/* A full eventfd counter or pipe is readable already. */
+	if (ret < 0 && errno != EAGAIN)
+		urcu_die(errno);
 }
 
 /*
- * Return a pointer to the default call_rcu_data structure, creating
- * one if need be.  Because we never free call_rcu_data structures,
- * we don't need to be in an RCU read-side critical section.
+ * Start a grace period for @req and return without waiting for it. Its
+ * completion is reported by rcu_async_poll(), and by a write to req->fd
+ * if set. The grace period is waited for by the call_rcu thread as for
+ * call_rcu_expedited(), so @req must not be reused until completed.
  */
+void synchronize_rcu_async(struct rcu_async *req)
+{
+	req->done = 0;
+	call_rcu_expedited(&req->head, rcu_async_complete);
+}
 
-struct call_rcu_data *get_default_call_rcu_data(void)
+/*
+ * Return non-zero once the grace period started by
+ * synchronize_rcu_async() for @req has completed. Following memory
+ * accesses are ordered after that grace period.
+ */
+int rcu_async_poll(struct rcu_async *req)
 {
-	if (default_call_rcu_data != NULL)
-		return rcu_dereference(default_call_rcu_data);
-	call_rcu_lock(&call_rcu_mutex);
-	if (default_call_rcu_data != NULL) {
-		call_rcu_unlock(&call_rcu_mutex);
-		return default_call_rcu_data;
-	}
-	call_rcu_data_init(&default_call_rcu_data, 0, -1);
-	call_rcu_unlock(&call_rcu_mutex);
-	return default_call_rcu_data;
+	if (!uatomic_read(&req->done))
+		return 0;
+	/* Order following frees after the grace period. */
+	cmm_smp_mb();
+	return 1;
 }
 
 /*
- * Return the call_rcu_data structure that applies to the currently
- * running thread.  Any call_rcu_data structure assigned specifically
- * to this thread has first priority, followed by any call_rcu_data
- * structure assigned to the CPU on which the thread is running,
- * followed by the default call_rcu_data structure.  If there is not
- * yet a default call_rcu_data structure, one will be created.
- *
- * Calls to this function and use of the returned call_rcu_data should
- * be protected by RCU read-side lock.
+ * Wait for a grace period for at most @timeout. Return 0 if it elapsed,
+ * in which case the caller can reclaim the removed data itself. Else
+ * queue @func on @head with call_rcu(), if @head is not NULL, and
+ * return -ETIMEDOUT. The grace period is started by the call_rcu thread
+ * as for start_poll_synchronize_rcu(), and polled with an exponential
+ * backoff bounded by the time left, so the caller only overshoots
+ * @timeout by its own wake-up latency.
  */
-struct call_rcu_data *get_call_rcu_data(void)
+int synchronize_rcu_timeout(const struct timespec *timeout,
+		struct rcu_head *head, void (*func)(struct rcu_head *head))
 {
-	struct call_rcu_data *crd;
+	uint64_t now, deadline, delay = 1000;
+	unsigned long cookie;
+	int was_online, ret = 0;
 
-	if (URCU_TLS(thread_call_rcu_data) != NULL)
-		return URCU_TLS(thread_call_rcu_data);
+	cookie = start_poll_synchronize_rcu();
+	now = urcu_time_ns();
+	deadline = now + (uint64_t) timeout->tv_sec * 1000000000ULL
+			+ timeout->tv_nsec;
 
-	if (maxcpus > 0) {
-		crd = get_cpu_call_rcu_data(urcu_sched_getcpu());
-		if (crd)
-			return crd;
+	/* Put in offline state in QSBR. */
+	was_online = _rcu_read_ongoing();
+	if (was_online)
+		rcu_thread_offline();
+	while (!poll_state_synchronize_rcu(cookie)) {
+		struct timespec ts;
+
+		if (now >= deadline) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		if (delay > deadline - now)
+			delay = deadline - now;
+		ts.tv_sec = delay / 1000000000ULL;
+		ts.tv_nsec = delay % 1000000000ULL;
+		(void) nanosleep(&ts, NULL);
+		if (delay < 1000000)
+			delay <<= 1;
+		now = urcu_time_ns();
+	}
+	if (was_online)
+		rcu_thread_online();
+
+	if (ret && head)
+		call_rcu(head, func);
+	return ret;
+}
+
+static void call_rcu_tag_wake_up(struct call_rcu_tag *tag)
+{
+	/* Write to tag count before reading/writing futex */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&tag->futex) == -1)) {
+		uatomic_set(&tag->futex, 0);
+		if (futex_async(&tag->futex, FUTEX_WAKE, INT_MAX,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
 	}
+}
 
-	return get_default_call_rcu_data();
+static void call_rcu_tagged_invoke(struct rcu_head *head)
+{
+	struct rcu_tagged_head *thead;
+	struct call_rcu_tag *tag;
+
+	thead = caa_container_of(head, struct rcu_tagged_head, head);
+	tag = thead->tag;
+	thead->func(head);
+	/*
+	 * rcu_barrier_tag() waits for waking to drop to 0 before
+	 * returning, so tag can be freed as soon as it returns.
+	 */
+	uatomic_inc(&tag->waking);
+	if (!uatomic_sub_return(&tag->count, 1))
+		call_rcu_tag_wake_up(tag);
+	uatomic_dec(&tag->waking);
 }
 
 /*
- * Return a pointer to this task's call_rcu_data if there is one.
+ * Same as call_rcu(), and account the callback in @tag, so
+ * rcu_barrier_tag() can wait for the callbacks of this class only.
  */
+void call_rcu_tagged(struct rcu_tagged_head *head,
+		     void (*func)(struct rcu_head *head),
+		     struct call_rcu_tag *tag)
+{
+	head->tag = tag;
+	head->func = func;
+	uatomic_inc(&tag->count);
+	call_rcu(&head->head, call_rcu_tagged_invoke);
+}
 
-struct call_rcu_data *get_thread_call_rcu_data(void)
+static void free_rcu_batch_cb(struct rcu_head *head)
 {
-	return URCU_TLS(thread_call_rcu_data);
+	struct free_rcu_batch *batch =
+		caa_container_of(head, struct free_rcu_batch, head);
+	void (*free_fct)(void *ptr) = batch->free_fct;
+	unsigned long i;
+
+	for (i = 0; i < batch->nr; i++)
+		free_fct(batch->ptrs[i]);
+	urcu_free(batch);
 }
 
 /*
- * Set this task's call_rcu_data structure as specified, regardless
- * of whether or not this task already had one.  (This allows switching
- * to and from real-time call_rcu threads, for example.)
+ * Queue the pointers batched by free_rcu_bulk() in the current thread.
+ */
+void free_rcu_bulk_flush(void)
+{
+	struct free_rcu_batch *batch = URCU_TLS(free_rcu_batch);
+
+	if (!batch)
+		return;
+	URCU_TLS(free_rcu_batch) = NULL;
+	call_rcu(&batch->head, free_rcu_batch_cb);
+}
+
+/*
+ * Free a pointer with free_fct (free() if NULL) after a following grace
+ * period, without a rcu_head in the object. Pointers are batched per
+ * thread, and each batch goes through call_rcu once full, or when the
+ * free function changes.
  *
- * Use NULL to remove a thread's call_rcu_data structure, but it is
- * the caller's responsibility to dispose of the removed structure.
- * Use get_thread_call_rcu_data() to obtain a pointer to the old structure
- * (prior to NULLing it out, of course).
+ * free_rcu_bulk must be called by registered RCU read-side threads.
  */
+void free_rcu_bulk(void *ptr, void (*free_fct)(void *ptr))
+{
+	struct free_rcu_batch *batch = URCU_TLS(free_rcu_batch);
 
-void set_thread_call_rcu_data(struct call_rcu_data *crdp)
+	if (!free_fct)
+		free_fct = free;
+	if (batch && batch->free_fct != free_fct) {
+		free_rcu_bulk_flush();
+		batch = NULL;
+	}
+	if (!batch) {
+		batch = urcu_malloc(FREE_RCU_BATCH_BYTES);
+		if (!batch)
+			urcu_die(errno);
+		batch->free_fct = free_fct;
+		batch->nr = 0;
+		URCU_TLS(free_rcu_batch) = batch;
+	}
+	batch->ptrs[batch->nr++] = ptr;
+	if (batch->nr == FREE_RCU_BATCH_LEN)
+		free_rcu_bulk_flush();
+}
+
+int call_rcu_data_set_watermarks(struct call_rcu_data *crdp,
+				 unsigned long high_watermark,
+				 unsigned long low_watermark,
+				 int mode)
 {
-	URCU_TLS(thread_call_rcu_data) = crdp;
+	if (low_watermark > high_watermark)
+		return -EINVAL;
+	if (mode != URCU_CALL_RCU_BACKPRESSURE_THROTTLE
+	    && mode != URCU_CALL_RCU_BACKPRESSURE_HELP)
+		return -EINVAL;
+	CMM_STORE_SHARED(crdp->backpressure_mode, mode);
+	CMM_STORE_SHARED(crdp->low_watermark, low_watermark);
+	CMM_STORE_SHARED(crdp->high_watermark, high_watermark);
+	CMM_STORE_SHARED(crdp->backpressure, 0);
+	return 0;
 }
 
 /*
- * Create a separate call_rcu thread for each CPU.  This does not
- * replace a pre-existing call_rcu thread -- use the set_cpu_call_rcu_data()
- * function if you want that behavior. Should be paired with
- * free_all_cpu_call_rcu_data() to teardown these call_rcu worker
- * threads.
+ * Process the lazy callbacks of @crdp after @delay_ms milliseconds, or
+ * once @qlen_max of them are queued.
+ */
+int call_rcu_data_set_lazy(struct call_rcu_data *crdp,
+			   unsigned int delay_ms,
+			   unsigned long qlen_max)
+{
+	if (!qlen_max)
+		return -EINVAL;
+	CMM_STORE_SHARED(crdp->lazy_delay_ms, delay_ms);
+	CMM_STORE_SHARED(crdp->lazy_qlen_max, qlen_max);
+	/* Apply the new delay to the lazy callbacks already queued. */
+	wake_call_rcu_thread(crdp);
+	return 0;
+}
+
+/*
+ * Copy the statistics of @crdp into @stats. The enqueued count is
+ * derived from the invoked count and the queue length, so it can lag
+ * behind concurrent call_rcu() by a few callbacks.
  */
+void call_rcu_data_get_stats(struct call_rcu_data *crdp,
+			     struct call_rcu_data_stats *stats)
+{
+	unsigned int i;
+
+	call_rcu_lock(&crdp->stats_lock);
+	*stats = crdp->stats;
+	stats->enqueued = stats->invoked + uatomic_read(&crdp->qlen)
+			+ uatomic_read(&crdp->lazy_qlen) + crdp->moved;
+	for (i = 0; i < crdp->nr_shards; i++)
+		stats->enqueued += uatomic_read(&crdp->shards[i].qlen);
+	call_rcu_unlock(&crdp->stats_lock);
+}
 
-int create_all_cpu_call_rcu_data(unsigned long flags)
+/*
+ * Attach @nr_helpers helper threads to the call_rcu thread of @crdp.
+ * Once the grace period of a batch larger than CALL_RCU_HELPER_CHUNK
+ * callbacks has elapsed, the batch is invoked in chunks by the call_rcu
+ * thread and its helpers in parallel. Helpers are stopped with the
+ * call_rcu thread. Returns 0 on success, -EINVAL if @crdp has no
+ * call_rcu thread or @nr_helpers is 0, -EBUSY if helpers are already
+ * attached, -ENOMEM on allocation failure.
+ */
+int call_rcu_data_set_helpers(struct call_rcu_data *crdp,
+			      unsigned int nr_helpers)
 {
-	int i;
-	struct call_rcu_data *crdp;
+	pthread_t *tids;
+	unsigned int i;
 	int ret;
 
-	call_rcu_lock(&call_rcu_mutex);
-	alloc_cpu_call_rcu_data();
-	call_rcu_unlock(&call_rcu_mutex);
-	if (maxcpus <= 0) {
-		errno = EINVAL;
+	if (!nr_helpers || crdp->event_fd[0] >= 0)
 		return -EINVAL;
+	call_rcu_lock(&call_rcu_mutex);
+	if (crdp->nr_helpers || crdp->nr_nodes) {
+		call_rcu_unlock(&call_rcu_mutex);
+		return -EBUSY;
 	}
-	if (per_cpu_call_rcu_data == NULL) {
-		errno = ENOMEM;
+	tids = urcu_calloc(nr_helpers, sizeof(*tids));
+	if (!tids) {
+		call_rcu_unlock(&call_rcu_mutex);
 		return -ENOMEM;
 	}
-	for (i = 0; i < maxcpus; i++) {
-		call_rcu_lock(&call_rcu_mutex);
-		if (get_cpu_call_rcu_data(i)) {
-			call_rcu_unlock(&call_rcu_mutex);
-			continue;
-		}
-		crdp = __create_call_rcu_data(flags, i);
-		if (crdp == NULL) {
-			call_rcu_unlock(&call_rcu_mutex);
-			errno = ENOMEM;
-			return -ENOMEM;
-		}
-		call_rcu_unlock(&call_rcu_mutex);
-		if ((ret = set_cpu_call_rcu_data(i, crdp)) != 0) {
-			call_rcu_data_free(crdp);
-
-			/* it has been created by other thread */
-			if (ret == -EEXIST)
-				continue;
-
-			return ret;
-		}
+	for (i = 0; i < nr_helpers; i++) {
+		ret = pthread_create(&tids[i], NULL, call_rcu_helper_thread,
+				     crdp);
+		if (ret)
+			urcu_die(ret);
 	}
+	crdp->helper_tids = tids;
+	/* Helpers created before they are used. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(crdp->nr_helpers, nr_helpers);
+	call_rcu_unlock(&call_rcu_mutex);
 	return 0;
 }
 
 /*
- * Wake up the call_rcu thread corresponding to the specified
- * call_rcu_data structure.
+ * Set the CPUs the thread of @crdp and its helpers run on, and their
+ * scheduling policy. Returns 0 on success, -EINVAL for an invalid
+ * placement or an URCU_CALL_RCU_EVENTFD call_rcu_data, -ENOSYS if CPU
+ * affinity is not supported, or the error setting the scheduling
+ * policy.
  */
-static void wake_call_rcu_thread(struct call_rcu_data *crdp)
+int call_rcu_data_set_placement(struct call_rcu_data *crdp,
+				const struct call_rcu_placement *placement)
 {
-	if (!(_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_RT))
-		call_rcu_wake_up(crdp);
+	struct urcu_placement p;
+	unsigned int i;
+	int ret;
+
+	if (crdp->event_fd[0] >= 0)
+		return -EINVAL;
+	ret = urcu_placement_resolve(&p, placement);
+	if (ret)
+		return ret;
+	call_rcu_lock(&call_rcu_mutex);
+	ret = urcu_placement_set_sched(&p, crdp->tid);
+	for (i = 0; !ret && i < crdp->nr_helpers; i++)
+		ret = urcu_placement_set_sched(&p, crdp->helper_tids[i]);
+	if (!ret)
+		urcu_placement_update(&crdp->placement, &p);
+	call_rcu_unlock(&call_rcu_mutex);
+	if (!ret)
+		wake_call_rcu_thread(crdp);
+	return ret;
 }
 
-static void _call_rcu(struct rcu_head *head,
-		      void (*func)(struct rcu_head *head),
-		      struct call_rcu_data *crdp)
+/*
+ * Return the file descriptor of an URCU_CALL_RCU_EVENTFD call_rcu_data,
+ * which is readable while callbacks are ready to be invoked by
+ * call_rcu_process_ready(). Returns -1 with errno set to EINVAL if
+ * @crdp has a call_rcu thread.
+ */
+int call_rcu_data_get_fd(struct call_rcu_data *crdp)
 {
-	cds_wfcq_node_init(&head->next);
-	head->func = func;
-	cds_wfcq_enqueue(&crdp->cbs_head, &crdp->cbs_tail, &head->next);
-	uatomic_inc(&crdp->qlen);
-	wake_call_rcu_thread(crdp);
+	if (!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_EVENTFD)) {
+		errno = EINVAL;
+		return -1;
+	}
+	return crdp->event_fd[0];
 }
 
 /*
- * Schedule a function to be invoked after a following grace period.
- * This is the only function that must be called -- the others are
- * only present to allow applications to tune their use of RCU for
- * maximum performance.
- *
- * Note that unless a call_rcu thread has not already been created,
- * the first invocation of call_rcu() will create one.  So, if you
- * need the first invocation of call_rcu() to be fast, make sure
- * to create a call_rcu thread first.  One way to accomplish this is
- * "get_call_rcu_data();", and another is create_all_cpu_call_rcu_data().
- *
- * call_rcu must be called by registered RCU read-side threads.
+ * Invoke at most @budget callbacks of an URCU_CALL_RCU_EVENTFD
+ * call_rcu_data whose grace period has completed. The file descriptor
+ * stays readable if ready callbacks are left. Returns the number of
+ * callbacks invoked. Must be called from a registered RCU thread,
+ * outside of RCU read-side critical sections.
  */
-void call_rcu(struct rcu_head *head,
-	      void (*func)(struct rcu_head *head))
+unsigned long call_rcu_process_ready(struct call_rcu_data *crdp,
+				     unsigned long budget)
 {
-	struct call_rcu_data *crdp;
+	struct cds_wfcq_node *cbs;
+	unsigned long count = 0;
+	uint64_t oldest_ns, newest_ns, start_ns;
+	int no_backpressure;
 
-	/* Holding rcu read-side lock across use of per-cpu crdp */
-	_rcu_read_lock();
-	crdp = get_call_rcu_data();
-	_call_rcu(head, func, crdp);
-	_rcu_read_unlock();
+	if (!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_EVENTFD))
+		return 0;
+	call_rcu_event_clear(crdp);
+	/* Clear the event before reading the ready queue. */
+	cmm_smp_mb();
+	oldest_ns = CMM_LOAD_SHARED(crdp->ready_oldest_ns);
+	newest_ns = CMM_LOAD_SHARED(crdp->ready_newest_ns);
+	start_ns = urcu_time_ns();
+	no_backpressure = URCU_TLS(call_rcu_no_backpressure);
+	URCU_TLS(call_rcu_no_backpressure) = 1;
+	while (count < budget) {
+		struct rcu_head *rhp;
+
+		cbs = cds_wfcq_dequeue_blocking(&crdp->ready_head,
+				&crdp->ready_tail);
+		if (!cbs)
+			break;
+		rhp = caa_container_of(cbs, struct rcu_head, next);
+		call_rcu_invoke(crdp, rhp);
+		count++;
+	}
+	URCU_TLS(call_rcu_no_backpressure) = no_backpressure;
+	if (!cds_wfcq_empty(&crdp->ready_head, &crdp->ready_tail))
+		call_rcu_event_signal(crdp);
+	if (count) {
+		/* Grace periods are accounted by the driver thread. */
+		call_rcu_stats_batch(crdp, count, oldest_ns, newest_ns,
+				start_ns, urcu_time_ns(), 0);
+		uatomic_sub_mo(&crdp->qlen, count, CMM_RELAXED);
+		call_rcu_backpressure_update(crdp);
+	}
+	return count;
 }
 
 /*
@@ -743,31 +3389,100 @@ void call_rcu(struct rcu_head *head,
  */
 void call_rcu_data_free(struct call_rcu_data *crdp)
 {
+	uint64_t shards_ns;
+
 	if (crdp == NULL || crdp == default_call_rcu_data) {
 		return;
 	}
-	if ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOPPED) == 0) {
+	if (crdp->event_fd[0] >= 0) {
+		/*
+		 * Take back the callbacks waiting for the grace period of
+		 * the driver thread, if any. They, and the ready callbacks,
+		 * get another grace period.
+		 */
+		call_rcu_lock(&call_rcu_mutex);
+		call_rcu_lock(&call_rcu_gp_driver.poll_mutex);
+		cds_list_del_init(&crdp->poll_list);
+		if (crdp->wait_pending)
+			(void) __cds_wfcq_splice_blocking(&crdp->cbs.head,
+				&crdp->cbs.tail, &crdp->wait_head,
+				&crdp->wait_tail);
+		crdp->wait_pending = 0;
+		call_rcu_unlock(&call_rcu_gp_driver.poll_mutex);
+		call_rcu_unlock(&call_rcu_mutex);
+		(void) cds_wfcq_splice_blocking(&crdp->cbs.head,
+			&crdp->cbs.tail, &crdp->ready_head, &crdp->ready_tail);
+		call_rcu_event_close(crdp);
+	} else if ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOPPED) == 0) {
 		uatomic_or(&crdp->flags, URCU_CALL_RCU_STOP);
 		wake_call_rcu_thread(crdp);
 		while ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOPPED) == 0)
 			(void) poll(NULL, 0, 1);
 	}
-	if (!cds_wfcq_empty(&crdp->cbs_head, &crdp->cbs_tail)) {
+	/*
+	 * The call_rcu thread is stopped: the next segment, the lazy, the
+	 * expedited queues and the sub-queues are ours. The next segment
+	 * goes first, then the lazy callbacks and the sub-queues.
+	 */
+	(void) call_rcu_shards_splice(crdp, &crdp->cbs.head, &crdp->cbs.tail,
+			&shards_ns);
+	(void) call_rcu_lazy_splice(crdp, &crdp->cbs.head, &crdp->cbs.tail);
+	if (call_rcu_next_pending(crdp)) {
+		(void) __cds_wfcq_splice_blocking(&crdp->next_head,
+			&crdp->next_tail, &crdp->cbs.head, &crdp->cbs.tail);
+		(void) __cds_wfcq_splice_blocking(&crdp->cbs.head,
+			&crdp->cbs.tail, &crdp->next_head, &crdp->next_tail);
+	}
+	(void) __cds_wfcq_splice_blocking(&crdp->cbs.head, &crdp->cbs.tail,
+					  &crdp->xp_head, &crdp->xp_tail);
+	if (!cds_wfcq_empty(&crdp->cbs.head, &crdp->cbs.tail)) {
 		/* Create default call rcu data if need be */
 		(void) get_default_call_rcu_data();
-		__cds_wfcq_splice_blocking(&default_call_rcu_data->cbs_head,
-			&default_call_rcu_data->cbs_tail,
-			&crdp->cbs_head, &crdp->cbs_tail);
-		uatomic_add(&default_call_rcu_data->qlen,
-			    uatomic_read(&crdp->qlen));
+		__cds_wfcq_splice_blocking(&default_call_rcu_data->cbs.head,
+			&default_call_rcu_data->cbs.tail,
+			&crdp->cbs.head, &crdp->cbs.tail);
+		uatomic_add_mo(&default_call_rcu_data->qlen,
+			       uatomic_read(&crdp->qlen), CMM_RELAXED);
+		call_rcu_stats_move(NULL, default_call_rcu_data,
+				    uatomic_read(&crdp->qlen));
 		wake_call_rcu_thread(default_call_rcu_data);
 	}
 
 	call_rcu_lock(&call_rcu_mutex);
 	cds_list_del(&crdp->list);
 	call_rcu_unlock(&call_rcu_mutex);
+	/* No new thief past the removal, nor helping caller past the GP. */
+	call_rcu_takers_wait(crdp);
+
+	(void) pthread_mutex_destroy(&crdp->stats_lock);
+	urcu_placement_destroy(&crdp->placement);
+	urcu_free(crdp->helper_tids);
+	call_rcu_nodes_free(crdp);
+	urcu_free(crdp->shards);
+	urcu_free(crdp);
+}
+
+/*
+ * Free the call_rcu_data inherited from the parent by a fork child,
+ * moving their callbacks to the default call_rcu_data.
+ */
+static void call_rcu_fork_child_cleanup(void)
+{
+	struct call_rcu_data *crdp, *next;
+	CDS_LIST_HEAD(stale);
+
+	call_rcu_lock(&call_rcu_mutex);
+	if (!call_rcu_fork_pending) {
+		call_rcu_unlock(&call_rcu_mutex);
+		return;
+	}
+	cds_list_splice(&call_rcu_fork_stale_list, &stale);
+	CDS_INIT_LIST_HEAD(&call_rcu_fork_stale_list);
+	CMM_STORE_SHARED(call_rcu_fork_pending, 0);
+	call_rcu_unlock(&call_rcu_mutex);
 
-	free(crdp);
+	cds_list_for_each_entry_safe(crdp, next, &stale, list)
+		call_rcu_data_free(crdp);
 }
 
 /*
@@ -782,7 +3497,7 @@ void free_all_cpu_call_rcu_data(void)
 	if (maxcpus <= 0)
 		return;
 
-	crdp = malloc(sizeof(*crdp) * maxcpus);
+	crdp = urcu_malloc(sizeof(*crdp) * maxcpus);
 	if (!crdp) {
 		if (!warned) {
 			fprintf(stderr, "[error] liburcu: unable to allocate per-CPU pointer array\n");
@@ -791,12 +3506,31 @@ void free_all_cpu_call_rcu_data(void)
 		return;
 	}
 
+	/*
+	 * Take the call_rcu_data from their CPU under the mutex, so that
+	 * they are not retired meanwhile, see call_rcu_retire().
+	 */
+	call_rcu_lock(&call_rcu_mutex);
+	CMM_STORE_SHARED(lazy_cpu_call_rcu, 0);
 	for (cpu = 0; cpu < maxcpus; cpu++) {
-		crdp[cpu] = get_cpu_call_rcu_data(cpu);
+		int i;
+
+		crdp[cpu] = NULL;
+		if (per_cpu_call_rcu_data == NULL)
+			continue;
+		crdp[cpu] = per_cpu_call_rcu_data[cpu];
 		if (crdp[cpu] == NULL)
 			continue;
-		set_cpu_call_rcu_data(cpu, NULL);
+		rcu_set_pointer(&per_cpu_call_rcu_data[cpu], NULL);
+		/* Shared by CPUs, e.g. per NUMA node: free once. */
+		for (i = 0; i < cpu; i++) {
+			if (crdp[i] == crdp[cpu]) {
+				crdp[cpu] = NULL;
+				break;
+			}
+		}
 	}
+	call_rcu_unlock(&call_rcu_mutex);
 	/*
 	 * Wait for call_rcu sites acting as RCU readers of the
 	 * call_rcu_data to become quiescent.
@@ -807,7 +3541,7 @@ void free_all_cpu_call_rcu_data(void)
 			continue;
 		call_rcu_data_free(crdp[cpu]);
 	}
-	free(crdp);
+	urcu_free(crdp);
 }
 
 static
@@ -816,11 +3550,10 @@ void free_completion(struct urcu_ref *ref)
 	struct call_rcu_completion *completion;
 
 	completion = caa_container_of(ref, struct call_rcu_completion, ref);
-	free(completion);
+	urcu_free(completion);
 }
 
-static
-void _rcu_barrier_complete(struct rcu_head *head)
+static void _rcu_barrier_complete(struct rcu_head *head)
 {
 	struct call_rcu_completion_work *work;
 	struct call_rcu_completion *completion;
@@ -830,77 +3563,219 @@ void _rcu_barrier_complete(struct rcu_head *head)
 	if (!uatomic_sub_return(&completion->barrier_count, 1))
 		call_rcu_completion_wake_up(completion);
 	urcu_ref_put(&completion->ref, free_completion);
-	free(work);
+	urcu_free(work);
 }
 
 /*
- * Wait for all in-flight call_rcu callbacks to complete execution.
+ * Queue a barrier callback on @only, or on all call_rcu_data if NULL,
+ * and return the completion they release once invoked.
  */
-void rcu_barrier(void)
+static struct call_rcu_completion *call_rcu_barrier_start(
+		struct call_rcu_data *only)
 {
 	struct call_rcu_data *crdp;
 	struct call_rcu_completion *completion;
 	int count = 0;
-	int was_online;
-
-	/* Put in offline state in QSBR. */
-	was_online = _rcu_read_ongoing();
-	if (was_online)
-		rcu_thread_offline();
-	/*
-	 * Calling a rcu_barrier() within a RCU read-side critical
-	 * section is an error.
-	 */
-	if (_rcu_read_ongoing()) {
-		static int warned = 0;
 
-		if (!warned) {
-			fprintf(stderr, "[error] liburcu: rcu_barrier() called from within RCU read-side critical section.\n");
-		}
-		warned = 1;
-		goto online;
-	}
+	/* Wait for the callbacks inherited by a lazy fork child too. */
+	if (caa_unlikely(CMM_LOAD_SHARED(call_rcu_fork_pending)))
+		(void) get_default_call_rcu_data();
 
-	completion = calloc(sizeof(*completion), 1);
+	completion = urcu_calloc(sizeof(*completion), 1);
 	if (!completion)
 		urcu_die(errno);
 
 	call_rcu_lock(&call_rcu_mutex);
-	cds_list_for_each_entry(crdp, &call_rcu_data_list, list)
-		count++;
+	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
+		if (!only || crdp == only)
+			count++;
+	}
 
-	/* Referenced by rcu_barrier() and each call_rcu thread. */
+	/* Referenced by the waiter and each call_rcu thread. */
 	urcu_ref_set(&completion->ref, count + 1);
 	completion->barrier_count = count;
 
 	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
 		struct call_rcu_completion_work *work;
 
-		work = calloc(sizeof(*work), 1);
+		if (only && crdp != only)
+			continue;
+		work = urcu_calloc(sizeof(*work), 1);
 		if (!work)
 			urcu_die(errno);
 		work->completion = completion;
 		_call_rcu(&work->head, _rcu_barrier_complete, crdp);
 	}
 	call_rcu_unlock(&call_rcu_mutex);
+	return completion;
+}
 
-	/* Wait for them */
+/*
+ * Wait for the barrier callbacks of @completion, then drop the
+ * waiter reference.
+ */
+static void call_rcu_barrier_finish(struct call_rcu_completion *completion)
+{
 	for (;;) {
-		uatomic_dec(&completion->futex);
-		/* Decrement futex before reading barrier_count */
-		cmm_smp_mb();
+		cds_eventcount_prepare_wait(&completion->ec);
 		if (!uatomic_read(&completion->barrier_count))
 			break;
 		call_rcu_completion_wait(completion);
 	}
-
 	urcu_ref_put(&completion->ref, free_completion);
+}
+
+/*
+ * Put the caller offline in QSBR and check it is not within a read-side
+ * critical section before waiting. Returns -1 on error, else whether
+ * call_rcu_barrier_online() has to put it back online.
+ */
+static int call_rcu_barrier_offline(const char *name)
+{
+	int was_online;
+
+	/* Put in offline state in QSBR. */
+	was_online = _rcu_read_ongoing();
+	if (was_online)
+		rcu_thread_offline();
+	/*
+	 * Calling a rcu_barrier() within a RCU read-side critical
+	 * section is an error.
+	 */
+	if (_rcu_read_ongoing()) {
+		static int warned = 0;
+
+		if (!warned) {
+			fprintf(stderr, "[error] liburcu: %s() called from within RCU read-side critical section.\n",
+				name);
+		}
+		warned = 1;
+		if (was_online)
+			rcu_thread_online();
+		return -1;
+	}
+	return was_online;
+}
 
-online:
+static void call_rcu_barrier_online(int was_online)
+{
 	if (was_online)
 		rcu_thread_online();
 }
 
+/*
+ * Wait for the in-flight callbacks of @only, or of all call_rcu_data
+ * if NULL, to complete execution.
+ */
+static void call_rcu_barrier(struct call_rcu_data *only)
+{
+	int was_online;
+
+	was_online = call_rcu_barrier_offline("rcu_barrier");
+	if (was_online < 0)
+		return;
+	call_rcu_barrier_finish(call_rcu_barrier_start(only));
+	call_rcu_barrier_online(was_online);
+}
+
+/*
+ * Wait for all in-flight call_rcu callbacks to complete execution.
+ */
+void rcu_barrier(void)
+{
+	call_rcu_barrier(NULL);
+}
+
+/*
+ * Wait for the in-flight callbacks queued on @crdp to complete
+ * execution. The caller must prevent @crdp from being freed meanwhile.
+ */
+void rcu_barrier_crdp(struct call_rcu_data *crdp)
+{
+	call_rcu_barrier(crdp);
+}
+
+/*
+ * Start a rcu_barrier() without waiting for it: the callbacks queued
+ * before this call are complete once rcu_barrier_poll() returns 1 on
+ * the returned handle, or once rcu_barrier_wait() returns. Can be
+ * called within a read-side critical section.
+ */
+struct call_rcu_completion *rcu_barrier_async(void)
+{
+	return call_rcu_barrier_start(NULL);
+}
+
+/*
+ * Return 1 if the callbacks covered by @completion completed, 0
+ * otherwise. Does not release @completion.
+ */
+int rcu_barrier_poll(struct call_rcu_completion *completion)
+{
+	if (uatomic_read(&completion->barrier_count))
+		return 0;
+	/* Read barrier_count before the caller reads freed data. */
+	cmm_smp_mb();
+	return 1;
+}
+
+/*
+ * Wait for the callbacks covered by @completion to complete, and
+ * release it. Each handle returned by rcu_barrier_async() must be
+ * passed to rcu_barrier_wait() exactly once.
+ */
+void rcu_barrier_wait(struct call_rcu_completion *completion)
+{
+	int was_online;
+
+	/* The barrier callbacks hold their own references. */
+	if (rcu_barrier_poll(completion)) {
+		urcu_ref_put(&completion->ref, free_completion);
+		return;
+	}
+	was_online = call_rcu_barrier_offline("rcu_barrier_wait");
+	if (was_online < 0) {
+		urcu_ref_put(&completion->ref, free_completion);
+		return;
+	}
+	call_rcu_barrier_finish(completion);
+	call_rcu_barrier_online(was_online);
+}
+
+/*
+ * Wait for the callbacks queued with call_rcu_tagged() on @tag to
+ * complete execution. Callbacks queued concurrently with
+ * rcu_barrier_tag() delay its return.
+ */
+void rcu_barrier_tag(struct call_rcu_tag *tag)
+{
+	int was_online;
+
+	was_online = call_rcu_barrier_offline("rcu_barrier_tag");
+	if (was_online < 0)
+		return;
+
+	for (;;) {
+		uatomic_set(&tag->futex, -1);
+		/* Write futex before reading tag count */
+		cmm_smp_mb();
+		if (!uatomic_read(&tag->count))
+			break;
+		while (futex_async(&tag->futex, FUTEX_WAIT, -1,
+				NULL, NULL, 0)) {
+			if (errno == EWOULDBLOCK)
+				break;	/* Value already changed. */
+			if (errno != EINTR)
+				urcu_die(errno);
+		}
+	}
+	uatomic_set(&tag->futex, 0);
+	/* Let the last invoking thread stop touching tag. */
+	while (uatomic_read(&tag->waking))
+		(void) poll(NULL, 0, 1);
+	call_rcu_barrier_online(was_online);
+}
+
 /*
  * Acquire the call_rcu_mutex in order to ensure that the child sees
  * all of the call_rcu() data structures in a consistent state. Ensure
@@ -919,14 +3794,34 @@ void call_rcu_before_fork(void)
 		atfork->before_fork(atfork->priv);
 
 	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
+		if (crdp->event_fd[0] >= 0)
+			continue;
 		uatomic_or(&crdp->flags, URCU_CALL_RCU_PAUSE);
 		cmm_smp_mb__after_uatomic_or();
 		wake_call_rcu_thread(crdp);
+		/* Cut the batching delay short. */
+		if (!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_RT))
+			call_rcu_xp_wake_up(crdp);
 	}
 	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
-		while ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSED) == 0)
-			(void) poll(NULL, 0, 1);
+		if (crdp->event_fd[0] >= 0)
+			continue;
+		call_rcu_pause_wait_ack(&crdp->flags, 1);
+	}
+	/* Paused workers no longer wait for the driver. */
+	if (call_rcu_gp_driver.started) {
+		uatomic_or(&call_rcu_gp_driver.flags, URCU_CALL_RCU_PAUSE);
+		cmm_smp_mb__after_uatomic_or();
+		if (uatomic_read(&call_rcu_gp_driver.futex) == -1) {
+			uatomic_set(&call_rcu_gp_driver.futex, 0);
+			(void) futex_async(&call_rcu_gp_driver.futex,
+					FUTEX_WAKE, 1, NULL, NULL, 0);
+		}
+		call_rcu_pause_wait_ack(&call_rcu_gp_driver.flags, 1);
 	}
+#ifdef RCU_DOMAIN_ATFORK
+	rcu_domain_before_fork();
+#endif
 }
 
 /*
@@ -939,12 +3834,21 @@ void call_rcu_after_fork_parent(void)
 	struct call_rcu_data *crdp;
 	struct urcu_atfork *atfork;
 
-	cds_list_for_each_entry(crdp, &call_rcu_data_list, list)
-		uatomic_and(&crdp->flags, ~URCU_CALL_RCU_PAUSE);
+#ifdef RCU_DOMAIN_ATFORK
+	rcu_domain_after_fork_parent();
+#endif
+	if (call_rcu_gp_driver.started) {
+		uatomic_and(&call_rcu_gp_driver.flags, ~URCU_CALL_RCU_PAUSE);
+		call_rcu_seq_wake(&call_rcu_resume_seq);
+		call_rcu_pause_wait_ack(&call_rcu_gp_driver.flags, 0);
+	}
 	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
-		while ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSED) != 0)
-			(void) poll(NULL, 0, 1);
+		if (crdp->event_fd[0] < 0)
+			uatomic_and(&crdp->flags, ~URCU_CALL_RCU_PAUSE);
 	}
+	call_rcu_seq_wake(&call_rcu_resume_seq);
+	cds_list_for_each_entry(crdp, &call_rcu_data_list, list)
+		call_rcu_pause_wait_ack(&crdp->flags, 0);
 	atfork = registered_rculfhash_atfork;
 	if (atfork)
 		atfork->after_fork_parent(atfork->priv);
@@ -961,6 +3865,21 @@ void call_rcu_after_fork_child(void)
 	struct call_rcu_data *crdp, *next;
 	struct urcu_atfork *atfork;
 
+#ifdef RCU_DOMAIN_ATFORK
+	rcu_domain_after_fork_child();
+#endif
+	/*
+	 * The driver thread does not exist in the child. It was paused
+	 * between rounds, so the event fd call_rcu_data have nothing
+	 * waiting for a grace period, and stay on the poll list until
+	 * they are freed by call_rcu_fork_child_cleanup().
+	 */
+	call_rcu_gp_driver.requested = call_rcu_gp_driver.completed = 0;
+	call_rcu_gp_driver.nr_waiters = 0;
+	call_rcu_gp_driver.futex = 0;
+	call_rcu_gp_driver.flags = 0;
+	call_rcu_gp_driver.started = 0;
+
 	/* Release the mutex. */
 	call_rcu_unlock(&call_rcu_mutex);
 
@@ -972,30 +3891,46 @@ void call_rcu_after_fork_child(void)
 	if (cds_list_empty(&call_rcu_data_list))
 		return;
 
-	/*
-	 * Allocate a new default call_rcu_data structure in order
-	 * to get a working call_rcu thread to go with it.
-	 */
-	default_call_rcu_data = NULL;
-	(void)get_default_call_rcu_data();
-
 	/* Cleanup call_rcu_data pointers before use */
+	default_call_rcu_data = NULL;
+	lazy_cpu_call_rcu = 0;
 	maxcpus_reset();
-	free(per_cpu_call_rcu_data);
+	urcu_free(per_cpu_call_rcu_data);
 	rcu_set_pointer(&per_cpu_call_rcu_data, NULL);
 	URCU_TLS(thread_call_rcu_data) = NULL;
 
 	/*
-	 * Dispose of all of the rest of the call_rcu_data structures.
-	 * Leftover call_rcu callbacks will be merged into the new
-	 * default call_rcu thread queue.
+	 * None of the call_rcu threads exist in the child: set the
+	 * call_rcu_data aside, their leftover callbacks are merged into
+	 * the queue of the new default call_rcu thread.
 	 */
 	cds_list_for_each_entry_safe(crdp, next, &call_rcu_data_list, list) {
-		if (crdp == default_call_rcu_data)
-			continue;
 		uatomic_set(&crdp->flags, URCU_CALL_RCU_STOPPED);
-		call_rcu_data_free(crdp);
+		/* Callers helping in the parent do not exist either. */
+		uatomic_set(&crdp->takers, 0);
+		cds_list_move(&crdp->list, &call_rcu_fork_stale_list);
 	}
+	call_rcu_fork_pending = 1;
+	if (call_rcu_fork_lazy)
+		return;
+
+	/*
+	 * Allocate a new default call_rcu_data structure in order
+	 * to get a working call_rcu thread to go with it, and dispose
+	 * of the inherited call_rcu_data.
+	 */
+	(void) get_default_call_rcu_data();
+}
+
+/*
+ * Toggle lazy fork children: call_rcu_after_fork_child() then leaves
+ * the creation of the default call_rcu thread, and the disposal of the
+ * call_rcu_data inherited from the parent, to the first call_rcu(),
+ * rcu_barrier() or get_default_call_rcu_data() of the child.
+ */
+void set_call_rcu_fork_lazy(int lazy)
+{
+	CMM_STORE_SHARED(call_rcu_fork_lazy, lazy);
 }
 
 void urcu_register_rculfhash_atfork(struct urcu_atfork *atfork)
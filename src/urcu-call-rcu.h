@@ -30,7 +30,9 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <urcu/wfcqueue.h>
 
@@ -42,6 +44,9 @@ extern "C" {
 
 struct call_rcu_data;
 
+/* Handle of a rcu_barrier_async(), opaque to callers. */
+struct call_rcu_completion;
+
 /* Flag values. */
 
 #define URCU_CALL_RCU_RT	(1U << 0)
@@ -50,6 +55,67 @@ struct call_rcu_data;
 #define URCU_CALL_RCU_STOPPED	(1U << 3)
 #define URCU_CALL_RCU_PAUSE	(1U << 4)
 #define URCU_CALL_RCU_PAUSED	(1U << 5)
+#define URCU_CALL_RCU_STEAL	(1U << 6)
+#define URCU_CALL_RCU_SHARED_GP	(1U << 7)
+#define URCU_CALL_RCU_EVENTFD	(1U << 8)
+#define URCU_CALL_RCU_BUSY_POLL	(1U << 9)
+#define URCU_CALL_RCU_NUMA	(1U << 10)
+
+/*
+ * Default bounds of the delay call_rcu threads wait for callbacks to
+ * batch before starting a grace period, in milliseconds.
+ */
+#define URCU_CALL_RCU_DEFAULT_MIN_DELAY_MS	1
+#define URCU_CALL_RCU_DEFAULT_MAX_DELAY_MS	10
+
+/* Backpressure modes, see call_rcu_data_set_watermarks(). */
+#define URCU_CALL_RCU_BACKPRESSURE_THROTTLE	1
+#define URCU_CALL_RCU_BACKPRESSURE_HELP		2
+
+/* Placement policies, see call_rcu_data_set_placement(). */
+#define CALL_RCU_PLACE_CPU_AFFINITY	0	/* cpu_affinity of creation */
+#define CALL_RCU_PLACE_CPUSET		1	/* CPUs of cpuset */
+#define CALL_RCU_PLACE_NODE		2	/* CPUs of NUMA node */
+#define CALL_RCU_PLACE_CALLER_NODE	3	/* CPUs of the caller's node */
+
+/* Placement flags. */
+#define CALL_RCU_PLACE_SCHED		(1U << 0)	/* Set sched_policy */
+#define CALL_RCU_PLACE_NICE		(1U << 1)	/* Set nice */
+
+/*
+ * Placement of the threads of a call_rcu_data, see
+ * call_rcu_data_set_placement(). cpuset points to a cpu_set_t of
+ * cpuset_size bytes.
+ */
+struct call_rcu_placement {
+	int policy;		/* CALL_RCU_PLACE_* policy */
+	int node;		/* CALL_RCU_PLACE_NODE */
+	const void *cpuset;	/* CALL_RCU_PLACE_CPUSET */
+	size_t cpuset_size;
+	unsigned int flags;	/* CALL_RCU_PLACE_SCHED, CALL_RCU_PLACE_NICE */
+	int sched_policy;	/* e.g. SCHED_FIFO */
+	int sched_priority;
+	int nice;
+};
+
+/*
+ * Statistics of a call_rcu_data, see call_rcu_data_get_stats(). Bucket
+ * 0 of delay_hist counts callbacks invoked less than 2 microseconds
+ * after being queued, bucket i > 0 from 2^i to 2^(i+1) microseconds,
+ * and the last bucket anything slower.
+ */
+#define URCU_CALL_RCU_STATS_NR_BUCKETS	32
+
+struct call_rcu_data_stats {
+	unsigned long enqueued;		/* callbacks queued */
+	unsigned long invoked;		/* callbacks invoked */
+	unsigned long batches;		/* batches of callbacks invoked */
+	unsigned long grace_periods;	/* grace periods waited for */
+	uint64_t delay_max_ns;		/* max queue-to-invoke delay */
+	uint64_t delay_sum_ns;		/* sum of queue-to-invoke delays */
+	uint64_t exec_ns;		/* time spent invoking callbacks */
+	unsigned long delay_hist[URCU_CALL_RCU_STATS_NR_BUCKETS];
+};
 
 /*
  * The rcu_head data structure is placed in the structure to be freed
@@ -61,6 +127,40 @@ struct rcu_head {
 	void (*func)(struct rcu_head *head);
 };
 
+/*
+ * Callback class, see call_rcu_tagged() and rcu_barrier_tag(). Zero
+ * initialized, and only used by the library.
+ */
+struct call_rcu_tag {
+	unsigned long count;		/* queued, not yet invoked callbacks */
+	unsigned long waking;		/* invoking threads waking up waiters */
+	int32_t futex;
+};
+
+#define CALL_RCU_TAG_INIT	{ 0, 0, 0 }
+
+/*
+ * Placed in the structure to be freed instead of the rcu_head when
+ * using call_rcu_tagged(). The callback receives &head.
+ */
+struct rcu_tagged_head {
+	struct rcu_head head;
+	struct call_rcu_tag *tag;
+	void (*func)(struct rcu_head *head);
+};
+
+/*
+ * Request of synchronize_rcu_async(), placed in the caller's data. Set
+ * fd to a file descriptor written 8 bytes to when the grace period
+ * completes, typically an eventfd, or to -1. Other fields are only used
+ * by the library.
+ */
+struct rcu_async {
+	struct rcu_head head;
+	int fd;
+	int done;
+};
+
 /*
  * Exported functions
  *
@@ -71,10 +171,47 @@ struct rcu_head {
 
 void call_rcu(struct rcu_head *head,
 	      void (*func)(struct rcu_head *head));
+void call_rcu_expedited(struct rcu_head *head,
+			void (*func)(struct rcu_head *head));
+void call_rcu_lazy(struct rcu_head *head,
+		   void (*func)(struct rcu_head *head));
+void call_rcu_batch(struct rcu_head *first, struct rcu_head *last);
+void call_rcu_local(struct rcu_head *head,
+		    void (*func)(struct rcu_head *head));
+void call_rcu_flush(void);
+void call_rcu_tagged(struct rcu_tagged_head *head,
+		     void (*func)(struct rcu_head *head),
+		     struct call_rcu_tag *tag);
+void synchronize_rcu_async(struct rcu_async *req);
+int rcu_async_poll(struct rcu_async *req);
+int synchronize_rcu_timeout(const struct timespec *timeout,
+		struct rcu_head *head, void (*func)(struct rcu_head *head));
+void free_rcu_bulk(void *ptr, void (*free_fct)(void *ptr));
+void free_rcu_bulk_flush(void);
 
 struct call_rcu_data *create_call_rcu_data(unsigned long flags,
 					   int cpu_affinity);
+struct call_rcu_data *create_call_rcu_data_delay(unsigned long flags,
+						 int cpu_affinity,
+						 unsigned int min_delay_ms,
+						 unsigned int max_delay_ms);
 void call_rcu_data_free(struct call_rcu_data *crdp);
+int call_rcu_data_set_lazy(struct call_rcu_data *crdp,
+			   unsigned int delay_ms,
+			   unsigned long qlen_max);
+int call_rcu_data_set_watermarks(struct call_rcu_data *crdp,
+				 unsigned long high_watermark,
+				 unsigned long low_watermark,
+				 int mode);
+void call_rcu_data_get_stats(struct call_rcu_data *crdp,
+			     struct call_rcu_data_stats *stats);
+int call_rcu_data_set_helpers(struct call_rcu_data *crdp,
+			      unsigned int nr_helpers);
+int call_rcu_data_set_placement(struct call_rcu_data *crdp,
+				const struct call_rcu_placement *placement);
+int call_rcu_data_get_fd(struct call_rcu_data *crdp);
+unsigned long call_rcu_process_ready(struct call_rcu_data *crdp,
+				     unsigned long budget);
 
 struct call_rcu_data *get_default_call_rcu_data(void);
 struct call_rcu_data *get_cpu_call_rcu_data(int cpu);
@@ -86,13 +223,22 @@ void set_thread_call_rcu_data(struct call_rcu_data *crdp);
 int set_cpu_call_rcu_data(int cpu, struct call_rcu_data *crdp);
 
 int create_all_cpu_call_rcu_data(unsigned long flags);
+int create_all_node_call_rcu_data(unsigned long flags);
+int create_lazy_cpu_call_rcu_data(unsigned long flags,
+				  unsigned int idle_timeout_ms);
 void free_all_cpu_call_rcu_data(void);
 
 void call_rcu_before_fork(void);
 void call_rcu_after_fork_parent(void);
 void call_rcu_after_fork_child(void);
+void set_call_rcu_fork_lazy(int lazy);
 
 void rcu_barrier(void);
+void rcu_barrier_crdp(struct call_rcu_data *crdp);
+void rcu_barrier_tag(struct call_rcu_tag *tag);
+struct call_rcu_completion *rcu_barrier_async(void);
+int rcu_barrier_poll(struct call_rcu_completion *completion);
+void rcu_barrier_wait(struct call_rcu_completion *completion);
 
 #ifdef __cplusplus
 }
@@ -49,13 +49,28 @@
 #include <urcu/list.h>
 #include <urcu/system.h>
 #include <urcu/tls-compat.h>
+#include <urcu/alloc.h>
 #include "urcu-die.h"
+#include "urcu-trace.h"
 
 /*
- * Number of entries in the per-thread defer queue. Must be power of 2.
+ * Initial number of entries in the per-thread defer queue, allocated by
+ * the first defer_rcu() of the thread. A full queue doubles its size, up
+ * to DEFER_QUEUE_MAX_SIZE entries. Past that size, its entries are handed
+ * to the reclamation thread, and its thread goes on in a new array. Must
+ * be powers of 2. See rcu_defer_set_queue_size().
  */
 #define DEFER_QUEUE_SIZE	(1 << 12)
-#define DEFER_QUEUE_MASK	(DEFER_QUEUE_SIZE - 1)
+#define DEFER_QUEUE_MIN_SIZE	(1 << 3)
+#define DEFER_QUEUE_MAX_SIZE	(1 << 20)
+
+/*
+ * The reclamation thread waits up to DEFER_BATCH_DELAY_MS after the first
+ * callback is queued before its grace period, unless a thread queue
+ * holds DEFER_BATCH_WATERMARK entries. See rcu_defer_set_batch().
+ */
+#define DEFER_BATCH_DELAY_MS	100
+#define DEFER_BATCH_WATERMARK	(DEFER_QUEUE_SIZE / 2)
 
 /*
  * Typically, data is aligned at least on the architecture size.
@@ -101,8 +116,10 @@ struct defer_queue {
 	unsigned long tail;	/* next element to remove at tail */
 	void *last_fct_out;	/* last fct pointer encoded */
 	void **q;
+	unsigned long mask;	/* number of entries of q[] - 1 */
 	/* registry information */
 	unsigned long last_head;
+	unsigned long flush_head;	/* head seen by the call_rcu flush */
 	struct cds_list_head list;	/* list of thread queues */
 };
 
@@ -121,6 +138,25 @@ static pthread_mutex_t defer_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static int32_t defer_thread_futex;
 static int32_t defer_thread_stop;
+/* Batching delay wait futex. */
+static int32_t defer_batch_futex;
+
+static unsigned int defer_batch_delay_ms = DEFER_BATCH_DELAY_MS;
+static unsigned long defer_batch_watermark = DEFER_BATCH_WATERMARK;
+static unsigned long defer_queue_size = DEFER_QUEUE_SIZE;
+
+/*
+ * Set by the deferers after queuing, cleared by rcu_defer_barrier()
+ * before reading the queue heads: rcu_defer_barrier() returns without
+ * taking rcu_defer_mutex when it is clear, and the reclamation thread
+ * sleeps on its futex.
+ */
+static int defer_pending;
+/*
+ * Set by the deferers whose queue holds defer_batch_watermark entries,
+ * cleared by rcu_defer_barrier(): ends the batching delay.
+ */
+static int defer_batch_full;
 
 /*
  * Written to only by each individual deferer. Read by both the deferer and
@@ -128,8 +164,28 @@ static int32_t defer_thread_stop;
  */
 static DEFINE_URCU_TLS(struct defer_queue, defer_queue);
 static CDS_LIST_HEAD(registry_defer);
+/*
+ * Full queues handed off by their thread, linked through their list
+ * field. Protected by rcu_defer_mutex.
+ */
+static CDS_LIST_HEAD(defer_pages);
 static pthread_t tid_defer;
 
+/*
+ * With rcu_defer_set_call_rcu(1), there is no reclamation thread: the
+ * call_rcu worker drains the queues, sharing the grace periods of the
+ * call_rcu callbacks. Each invocation of defer_flush_head executes the
+ * entries up to the queue heads recorded by the previous invocation,
+ * records the current heads and the pages handed off since (moved to
+ * defer_flush_pages), then queues itself again as long as entries are
+ * pending. defer_flush_queued is set while it is queued or running.
+ * Protected by rcu_defer_mutex, except defer_flush_queued.
+ */
+static int defer_use_call_rcu;
+static int defer_flush_queued;
+static struct rcu_head defer_flush_head;
+static CDS_LIST_HEAD(defer_flush_pages);
+
 static void mutex_lock_defer(pthread_mutex_t *mutex)
 {
 	int ret;
@@ -160,18 +216,17 @@ static void wake_up_defer(void)
 	}
 }
 
-static unsigned long rcu_defer_num_callbacks(void)
+/*
+ * Cut the batching delay of the defer thread short.
+ */
+static void wake_up_defer_batch(void)
 {
-	unsigned long num_items = 0, head;
-	struct defer_queue *index;
-
-	mutex_lock_defer(&rcu_defer_mutex);
-	cds_list_for_each_entry(index, &registry_defer, list) {
-		head = CMM_LOAD_SHARED(index->head);
-		num_items += head - index->tail;
+	if (caa_unlikely(uatomic_read(&defer_batch_futex) == -1)) {
+		uatomic_set(&defer_batch_futex, 0);
+		if (futex_noasync(&defer_batch_futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
 	}
-	mutex_unlock(&rcu_defer_mutex);
-	return num_items;
 }
 
 /*
@@ -187,7 +242,7 @@ static void wait_defer(void)
 		uatomic_set(&defer_thread_futex, 0);
 		pthread_exit(0);
 	}
-	if (rcu_defer_num_callbacks()) {
+	if (uatomic_read(&defer_pending)) {
 		cmm_smp_mb();	/* Read queue before write futex */
 		/* Callbacks are queued, don't wait. */
 		uatomic_set(&defer_thread_futex, 0);
@@ -227,23 +282,48 @@ static void rcu_defer_barrier_queue(struct defer_queue *queue,
 	 * Head is only modified by owner thread.
 	 */
 
+	urcu_trace2(defer_flush_start, queue, head - queue->tail);
 	for (i = queue->tail; i != head;) {
 		cmm_smp_rmb();       /* read head before q[]. */
-		p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+		p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 		if (caa_unlikely(DQ_IS_FCT_BIT(p))) {
 			DQ_CLEAR_FCT_BIT(p);
 			queue->last_fct_out = p;
-			p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+			p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 		} else if (caa_unlikely(p == DQ_FCT_MARK)) {
-			p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+			p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 			queue->last_fct_out = p;
-			p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+			p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 		}
 		fct = queue->last_fct_out;
 		fct(p);
 	}
 	cmm_smp_mb();	/* push tail after having used q[] */
 	CMM_STORE_SHARED(queue->tail, i);
+	urcu_trace1(defer_flush_end, queue);
+}
+
+/*
+ * Execute the callbacks of the handed off queues, and free them. Must be
+ * called after Q.S. is reached, with rcu_defer_mutex held.
+ */
+static void rcu_defer_barrier_page_list(struct cds_list_head *pages)
+{
+	struct defer_queue *page, *tmp;
+
+	cds_list_for_each_entry_safe(page, tmp, pages, list) {
+		rcu_defer_barrier_queue(page, page->head);
+		urcu_free(page->q);
+		urcu_free(page);
+	}
+	CDS_INIT_LIST_HEAD(pages);
+}
+
+static void rcu_defer_barrier_pages(void)
+{
+	/* Handed off before the others. */
+	rcu_defer_barrier_page_list(&defer_flush_pages);
+	rcu_defer_barrier_page_list(&defer_pages);
 }
 
 static void _rcu_defer_barrier_thread(void)
@@ -252,10 +332,13 @@ static void _rcu_defer_barrier_thread(void)
 
 	head = URCU_TLS(defer_queue).head;
 	num_items = head - URCU_TLS(defer_queue).tail;
-	if (caa_unlikely(!num_items))
+	if (caa_unlikely(!num_items && cds_list_empty(&defer_pages)
+			&& cds_list_empty(&defer_flush_pages)))
 		return;
 	synchronize_rcu();
 	rcu_defer_barrier_queue(&URCU_TLS(defer_queue), head);
+	/* Some of the handed off queues may belong to this thread. */
+	rcu_defer_barrier_pages();
 }
 
 void rcu_defer_barrier_thread(void)
@@ -283,15 +366,19 @@ void rcu_defer_barrier(void)
 	struct defer_queue *index;
 	unsigned long num_items = 0;
 
-	if (cds_list_empty(&registry_defer))
+	if (cds_list_empty(&registry_defer) || !uatomic_read(&defer_pending))
 		return;
 
 	mutex_lock_defer(&rcu_defer_mutex);
+	uatomic_set(&defer_batch_full, 0);
+	uatomic_set(&defer_pending, 0);
+	cmm_smp_mb();	/* Write pending flag before read queue heads */
 	cds_list_for_each_entry(index, &registry_defer, list) {
 		index->last_head = CMM_LOAD_SHARED(index->head);
 		num_items += index->last_head - index->tail;
 	}
-	if (caa_likely(!num_items)) {
+	if (caa_likely(!num_items && cds_list_empty(&defer_pages)
+			&& cds_list_empty(&defer_flush_pages))) {
 		/*
 		 * We skip the grace period because there are no queued
 		 * callbacks to execute.
@@ -299,18 +386,195 @@ void rcu_defer_barrier(void)
 		goto end;
 	}
 	synchronize_rcu();
-	cds_list_for_each_entry(index, &registry_defer, list)
-		rcu_defer_barrier_queue(index, index->last_head);
+	cds_list_for_each_entry(index, &registry_defer, list) {
+		if (index->last_head != index->tail)
+			rcu_defer_barrier_queue(index, index->last_head);
+	}
+	rcu_defer_barrier_pages();
 end:
 	mutex_unlock(&rcu_defer_mutex);
 }
 
+/*
+ * Allocate the queue of the current thread, on its first callback.
+ * Returns 0 on success, -1 if out of memory.
+ */
+static int defer_queue_alloc(void)
+{
+	struct defer_queue *queue = &URCU_TLS(defer_queue);
+	unsigned long size = CMM_LOAD_SHARED(defer_queue_size);
+	void **q;
+
+	q = urcu_malloc(sizeof(void *) * size);
+	if (!q)
+		return -1;
+	mutex_lock_defer(&rcu_defer_mutex);
+	queue->q = q;
+	queue->mask = size - 1;
+	mutex_unlock(&rcu_defer_mutex);
+	return 0;
+}
+
+/*
+ * Double the size of the queue of the current thread, keeping the
+ * entries at the same indexes. q[] is only read by other threads with
+ * rcu_defer_mutex held. Returns 0 if the queue has room for a new
+ * callback, -1 if it is full and cannot grow.
+ */
+static int defer_queue_grow(void)
+{
+	struct defer_queue *queue = &URCU_TLS(defer_queue);
+	unsigned long size = 2 * (queue->mask + 1), i;
+	void **q;
+
+	if (size > DEFER_QUEUE_MAX_SIZE)
+		return -1;
+	q = urcu_malloc(sizeof(void *) * size);
+	if (!q)
+		return -1;
+	mutex_lock_defer(&rcu_defer_mutex);
+	for (i = queue->tail; i != queue->head; i++)
+		q[i & (size - 1)] = queue->q[i & queue->mask];
+	urcu_free(queue->q);
+	queue->q = q;
+	queue->mask = size - 1;
+	mutex_unlock(&rcu_defer_mutex);
+	return 0;
+}
+
+/*
+ * Hand the entries of the full queue of the current thread to the
+ * reclamation thread, which executes them after its next grace period,
+ * and go on queuing in a new array. Returns 0 if the queue has room for
+ * a new callback, -1 if out of memory.
+ */
+static int defer_queue_hand_off(void)
+{
+	struct defer_queue *queue = &URCU_TLS(defer_queue), *page;
+	void **q;
+
+	page = urcu_malloc(sizeof(*page));
+	q = urcu_malloc(sizeof(void *) * (queue->mask + 1));
+	if (!page || !q) {
+		urcu_free(page);
+		urcu_free(q);
+		return -1;
+	}
+	mutex_lock_defer(&rcu_defer_mutex);
+	if (queue->head - queue->tail < queue->mask - 1) {
+		/* Emptied by the reclamation thread meanwhile. */
+		mutex_unlock(&rcu_defer_mutex);
+		urcu_free(page);
+		urcu_free(q);
+		return 0;
+	}
+	page->q = queue->q;
+	page->mask = queue->mask;
+	page->head = queue->head;
+	page->tail = queue->tail;
+	page->last_fct_out = queue->last_fct_out;
+	cds_list_add_tail(&page->list, &defer_pages);
+	queue->q = q;
+	CMM_STORE_SHARED(queue->tail, queue->head);
+	/* Encode the function of the first callback of the new array. */
+	queue->last_fct_in = NULL;
+	mutex_unlock(&rcu_defer_mutex);
+	return 0;
+}
+
+/*
+ * Record the queue heads and the handed off pages for the next flush.
+ * Returns whether any entry is recorded. Called with rcu_defer_mutex
+ * held.
+ */
+static int defer_flush_record(void)
+{
+	struct defer_queue *index;
+	int pending = 0;
+
+	cds_list_for_each_entry(index, &registry_defer, list) {
+		index->flush_head = CMM_LOAD_SHARED(index->head);
+		if (index->flush_head != index->tail)
+			pending = 1;
+	}
+	if (!cds_list_empty(&defer_pages)) {
+		cds_list_splice(&defer_pages, &defer_flush_pages);
+		CDS_INIT_LIST_HEAD(&defer_pages);
+	}
+	return pending || !cds_list_empty(&defer_flush_pages);
+}
+
+static int defer_flush_pending(void)
+{
+	struct defer_queue *index;
+
+	cds_list_for_each_entry(index, &registry_defer, list) {
+		if (CMM_LOAD_SHARED(index->head) != index->tail)
+			return 1;
+	}
+	return !cds_list_empty(&defer_pages);
+}
+
+/*
+ * Invoked by the call_rcu worker, after a grace period which started
+ * after the previous invocation recorded the queue heads.
+ */
+static void defer_flush(struct rcu_head *head)
+{
+	struct defer_queue *index;
+
+	(void) head;
+	mutex_lock_defer(&rcu_defer_mutex);
+	cds_list_for_each_entry(index, &registry_defer, list) {
+		/* rcu_defer_barrier() may have executed past flush_head. */
+		if ((long) (index->flush_head - index->tail) > 0)
+			rcu_defer_barrier_queue(index, index->flush_head);
+	}
+	rcu_defer_barrier_page_list(&defer_flush_pages);
+	for (;;) {
+		if (defer_flush_record()) {
+			call_rcu(&defer_flush_head, defer_flush);
+			break;
+		}
+		uatomic_set(&defer_flush_queued, 0);
+		cmm_smp_mb();	/* Write queued flag before read queue heads */
+		if (!defer_flush_pending()
+				|| uatomic_xchg(&defer_flush_queued, 1))
+			break;
+	}
+	mutex_unlock(&rcu_defer_mutex);
+}
+
+/*
+ * Queue the flush if it is not. Called after writing the queue head
+ * and a memory barrier.
+ */
+static void defer_flush_start(void)
+{
+	if (caa_likely(CMM_LOAD_SHARED(defer_flush_queued))
+			|| uatomic_xchg(&defer_flush_queued, 1))
+		return;
+	/* Nothing is recorded yet: the first invocation records. */
+	call_rcu(&defer_flush_head, defer_flush);
+}
+
 /*
  * _defer_rcu - Queue a RCU callback.
  */
 static void _defer_rcu(void (*fct)(void *p), void *p)
 {
-	unsigned long head, tail;
+	unsigned long head, tail, mask;
+	void **q;
+
+	/*
+	 * Threads which never defer a callback do not pay for a queue.
+	 * Without memory for it, execute the callback right away.
+	 */
+	if (caa_unlikely(!URCU_TLS(defer_queue).q) && defer_queue_alloc()) {
+		synchronize_rcu();
+		fct(p);
+		return;
+	}
 
 	/*
 	 * Head is only modified by ourself. Tail can be modified by reclamation
@@ -320,14 +584,20 @@ static void _defer_rcu(void (*fct)(void *p), void *p)
 	tail = CMM_LOAD_SHARED(URCU_TLS(defer_queue).tail);
 
 	/*
-	 * If queue is full, or reached threshold. Empty queue ourself.
+	 * If queue is full, or reached threshold, grow it, or hand it to
+	 * the reclamation thread if it is already at its maximum size.
+	 * Empty queue ourself if out of memory.
 	 * Worse-case: must allow 2 supplementary entries for fct pointer.
 	 */
-	if (caa_unlikely(head - tail >= DEFER_QUEUE_SIZE - 2)) {
-		assert(head - tail <= DEFER_QUEUE_SIZE);
-		rcu_defer_barrier_thread();
-		assert(head - CMM_LOAD_SHARED(URCU_TLS(defer_queue).tail) == 0);
+	if (caa_unlikely(head - tail >= URCU_TLS(defer_queue).mask - 1)) {
+		assert(head - tail <= URCU_TLS(defer_queue).mask + 1);
+		if (defer_queue_grow() && defer_queue_hand_off()) {
+			rcu_defer_barrier_thread();
+			assert(head - CMM_LOAD_SHARED(URCU_TLS(defer_queue).tail) == 0);
+		}
 	}
+	q = URCU_TLS(defer_queue).q;
+	mask = URCU_TLS(defer_queue).mask;
 
 	/*
 	 * Encode:
@@ -350,25 +620,73 @@ static void _defer_rcu(void (*fct)(void *p), void *p)
 			|| p == DQ_FCT_MARK)) {
 		URCU_TLS(defer_queue).last_fct_in = fct;
 		if (caa_unlikely(DQ_IS_FCT_BIT(fct) || fct == DQ_FCT_MARK)) {
-			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK],
+			_CMM_STORE_SHARED(q[head++ & mask],
 				      DQ_FCT_MARK);
-			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK],
+			_CMM_STORE_SHARED(q[head++ & mask],
 				      fct);
 		} else {
 			DQ_SET_FCT_BIT(fct);
-			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK],
+			_CMM_STORE_SHARED(q[head++ & mask],
 				      fct);
 		}
 	}
-	_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK], p);
+	_CMM_STORE_SHARED(q[head++ & mask], p);
 	cmm_smp_wmb();	/* Publish new pointer before head */
 			/* Write q[] before head. */
 	CMM_STORE_SHARED(URCU_TLS(defer_queue).head, head);
 	cmm_smp_mb();	/* Write queue head before read futex */
+	if (caa_unlikely(!_CMM_LOAD_SHARED(defer_pending))) {
+		uatomic_set(&defer_pending, 1);
+		cmm_smp_mb();	/* Write pending flag before read futex */
+	}
+	if (caa_unlikely(CMM_LOAD_SHARED(defer_use_call_rcu))) {
+		defer_flush_start();
+		return;
+	}
 	/*
 	 * Wake-up any waiting defer thread.
 	 */
 	wake_up_defer();
+	tail = CMM_LOAD_SHARED(URCU_TLS(defer_queue).tail);
+	if (caa_unlikely(head - tail >= CMM_LOAD_SHARED(defer_batch_watermark)
+			&& CMM_LOAD_SHARED(defer_batch_watermark))) {
+		if (!_CMM_LOAD_SHARED(defer_batch_full)) {
+			uatomic_set(&defer_batch_full, 1);
+			cmm_smp_mb();	/* Write full flag before read futex */
+		}
+		wake_up_defer_batch();
+	}
+}
+
+/*
+ * Sleep for the batching delay, cut short by wake_up_defer_batch() where
+ * futexes support timeouts.
+ */
+static void wait_defer_batch(void)
+{
+	unsigned int ms = CMM_LOAD_SHARED(defer_batch_delay_ms);
+#ifdef CONFIG_RCU_HAVE_FUTEX
+	struct timespec ts;
+	int ret;
+
+	if (!ms)
+		return;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+	uatomic_set(&defer_batch_futex, -1);
+	/* Write futex before read full flag and defer_thread_stop */
+	cmm_smp_mb();
+	ret = 0;
+	if (!uatomic_read(&defer_batch_full)
+			&& !_CMM_LOAD_SHARED(defer_thread_stop))
+		ret = futex(&defer_batch_futex, FUTEX_WAIT, -1, &ts,
+			    NULL, 0);
+	uatomic_set(&defer_batch_futex, 0);
+	if (!ret || errno != ENOSYS)
+		return;
+#endif
+	if (ms && !uatomic_read(&defer_batch_full))
+		(void) poll(NULL, 0, ms);
 }
 
 static void *thr_defer(void *args)
@@ -381,7 +699,7 @@ static void *thr_defer(void *args)
 		 */
 		wait_defer();
 		/* Sleeping after wait_defer to let many callbacks enqueue */
-		(void) poll(NULL,0,100);	/* wait for 100ms */
+		wait_defer_batch();
 		rcu_defer_barrier();
 	}
 
@@ -414,6 +732,7 @@ static void stop_defer_thread(void)
 	/* Store defer_thread_stop before testing futex */
 	cmm_smp_mb();
 	wake_up_defer();
+	wake_up_defer_batch();
 
 	ret = pthread_join(tid_defer, &tret);
 	assert(!ret);
@@ -429,17 +748,15 @@ int rcu_defer_register_thread(void)
 
 	assert(URCU_TLS(defer_queue).last_head == 0);
 	assert(URCU_TLS(defer_queue).q == NULL);
-	URCU_TLS(defer_queue).q = malloc(sizeof(void *) * DEFER_QUEUE_SIZE);
-	if (!URCU_TLS(defer_queue).q)
-		return -ENOMEM;
 
 	mutex_lock_defer(&defer_thread_mutex);
 	mutex_lock_defer(&rcu_defer_mutex);
 	was_empty = cds_list_empty(&registry_defer);
+	URCU_TLS(defer_queue).flush_head = URCU_TLS(defer_queue).head;
 	cds_list_add(&URCU_TLS(defer_queue).list, &registry_defer);
 	mutex_unlock(&rcu_defer_mutex);
 
-	if (was_empty)
+	if (was_empty && !defer_use_call_rcu)
 		start_defer_thread();
 	mutex_unlock(&defer_thread_mutex);
 	return 0;
@@ -453,16 +770,52 @@ void rcu_defer_unregister_thread(void)
 	mutex_lock_defer(&rcu_defer_mutex);
 	cds_list_del(&URCU_TLS(defer_queue).list);
 	_rcu_defer_barrier_thread();
-	free(URCU_TLS(defer_queue).q);
+	urcu_free(URCU_TLS(defer_queue).q);
 	URCU_TLS(defer_queue).q = NULL;
+	URCU_TLS(defer_queue).mask = 0;
 	is_empty = cds_list_empty(&registry_defer);
 	mutex_unlock(&rcu_defer_mutex);
 
-	if (is_empty)
+	if (is_empty && !defer_use_call_rcu)
 		stop_defer_thread();
 	mutex_unlock(&defer_thread_mutex);
 }
 
+int rcu_defer_set_batch(unsigned int delay_ms, unsigned long watermark)
+{
+	if (watermark > DEFER_QUEUE_MAX_SIZE)
+		return -EINVAL;
+	CMM_STORE_SHARED(defer_batch_delay_ms, delay_ms);
+	CMM_STORE_SHARED(defer_batch_watermark, watermark);
+	/* Apply the new delay to the current wait. */
+	cmm_smp_mb();
+	wake_up_defer_batch();
+	return 0;
+}
+
+int rcu_defer_set_queue_size(unsigned long nr_entries)
+{
+	if (nr_entries < DEFER_QUEUE_MIN_SIZE
+			|| nr_entries > DEFER_QUEUE_MAX_SIZE
+			|| (nr_entries & (nr_entries - 1)))
+		return -EINVAL;
+	CMM_STORE_SHARED(defer_queue_size, nr_entries);
+	return 0;
+}
+
+int rcu_defer_set_call_rcu(int enable)
+{
+	int ret = 0;
+
+	mutex_lock_defer(&defer_thread_mutex);
+	if (!cds_list_empty(&registry_defer))
+		ret = -EBUSY;
+	else
+		defer_use_call_rcu = !!enable;
+	mutex_unlock(&defer_thread_mutex);
+	return ret;
+}
+
 void rcu_defer_exit(void)
 {
 	assert(cds_list_empty(&registry_defer));
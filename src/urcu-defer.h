@@ -60,6 +60,40 @@ extern void rcu_defer_unregister_thread(void);
 extern void rcu_defer_barrier(void);
 extern void rcu_defer_barrier_thread(void);
 
+/*
+ * rcu_defer_set_batch - Set the batching of the reclamation thread.
+ *
+ * After the first callback is queued, the reclamation thread waits up to
+ * @delay_ms milliseconds for more callbacks before its grace period
+ * (100ms by default, 0 for no wait). A thread queue holding @watermark
+ * entries ends the wait early (2048 by default, 0 to always wait for the
+ * delay). Returns -EINVAL if @watermark exceeds the largest queue size.
+ */
+extern int rcu_defer_set_batch(unsigned int delay_ms, unsigned long watermark);
+
+/*
+ * rcu_defer_set_queue_size - Set the initial size of the defer queues.
+ *
+ * The queue of a thread is allocated by its first defer_rcu(), with
+ * @nr_entries entries (4096 by default), and doubles in size when full.
+ * Applies to the queues allocated afterwards. Returns -EINVAL unless
+ * @nr_entries is a power of 2 between 8 and 1048576.
+ */
+extern int rcu_defer_set_queue_size(unsigned long nr_entries);
+
+/*
+ * rcu_defer_set_call_rcu - Drain the defer queues from the call_rcu worker.
+ *
+ * With @enable non-zero, no reclamation thread is started: the default
+ * call_rcu worker executes the queued callbacks after its own grace
+ * periods, which they share with the call_rcu() callbacks, and the
+ * batching of rcu_defer_set_batch() is replaced by that of the worker.
+ * Callbacks then wait for two grace periods of the worker at most.
+ * Returns -EBUSY if threads are registered with
+ * rcu_defer_register_thread().
+ */
+extern int rcu_defer_set_call_rcu(int enable);
+
 #ifdef __cplusplus
 }
 #endif
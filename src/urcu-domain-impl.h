@@ -0,0 +1,342 @@
+#ifndef _URCU_DOMAIN_IMPL_H
+#define _URCU_DOMAIN_IMPL_H
+
+/*
+ * urcu-domain-impl.h
+ *
+ * Userspace RCU library - independent RCU domains
+ *
+ * TO BE INCLUDED ONLY FROM urcu.c, after the grace period code.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * An RCU domain has its own grace period counter and reader registry,
+ * and runs the flavor grace period algorithm on them: long read-side
+ * critical sections of a domain only delay the grace periods of that
+ * domain. Callbacks queued with call_rcu_domain() are invoked by a
+ * worker thread of the domain, created on the first call.
+ */
+struct rcu_domain {
+	struct rcu_gp gp;
+	struct rcu_registry_shard registry[RCU_REGISTRY_NR_SHARDS];
+
+	/* Serializes the grace periods of the domain. */
+	pthread_mutex_t gp_lock;
+	struct rcu_spin_budget budget;	/* Protected by gp_lock. */
+
+	/* call_rcu_domain() queue, and its worker thread. */
+	struct cds_wfcq_head cbs_head;
+	struct cds_wfcq_tail cbs_tail;
+	int32_t futex;
+	int stop;
+	int worker;
+	pthread_t tid;
+	pthread_mutex_t worker_lock;	/* Worker thread creation. */
+
+	struct cds_list_head node;	/* rcu_domain_list */
+};
+
+struct rcu_domain_barrier {
+	struct rcu_head head;
+	struct urcu_wait_node wait;
+};
+
+/* Domains of the process, for fork handling. */
+static CDS_LIST_HEAD(rcu_domain_list);
+static pthread_mutex_t rcu_domain_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct rcu_domain *rcu_domain_create(void)
+{
+	struct rcu_domain *domain;
+	unsigned int i;
+
+	if (urcu_posix_memalign((void **) &domain, CAA_CACHE_LINE_SIZE,
+			sizeof(*domain))) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset(domain, 0, sizeof(*domain));
+	domain->gp.ctr = RCU_GP_COUNT;
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++)
+		pthread_mutex_init(&domain->registry[i].lock, NULL);
+	pthread_mutex_init(&domain->gp_lock, NULL);
+	pthread_mutex_init(&domain->worker_lock, NULL);
+	/* Start from the bounds of the flavor grace periods. */
+	mutex_lock(&rcu_gp_lock);
+	domain->budget = rcu_gp_budget;
+	mutex_unlock(&rcu_gp_lock);
+	cds_wfcq_init(&domain->cbs_head, &domain->cbs_tail);
+	mutex_lock(&rcu_domain_list_lock);
+	cds_list_add(&domain->node, &rcu_domain_list);
+	mutex_unlock(&rcu_domain_list_lock);
+	return domain;
+}
+
+/*
+ * Invoke the callbacks queued before each grace period of the domain.
+ * Exits once stopped and the queue is empty.
+ */
+static void *rcu_domain_thread(void *arg)
+{
+	struct rcu_domain *domain = arg;
+
+	/* If callbacks take a read-side lock, we need to be registered. */
+	rcu_register_thread();
+	for (;;) {
+		struct cds_wfcq_head cbs_tmp_head;
+		struct cds_wfcq_tail cbs_tmp_tail;
+		struct cds_wfcq_node *cbs, *cbs_tmp_n;
+
+		uatomic_set(&domain->futex, -1);
+		/* Write futex before reading the callback queue. */
+		cmm_smp_mb();
+		cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
+		if (__cds_wfcq_splice_blocking(&cbs_tmp_head, &cbs_tmp_tail,
+				&domain->cbs_head, &domain->cbs_tail)
+				!= CDS_WFCQ_RET_SRC_EMPTY) {
+			uatomic_set(&domain->futex, 0);
+			synchronize_rcu_domain(domain);
+			__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head,
+					&cbs_tmp_tail, cbs, cbs_tmp_n) {
+				struct rcu_head *rhp;
+
+				rhp = caa_container_of(cbs,
+					struct rcu_head, next);
+				rhp->func(rhp);
+			}
+			continue;
+		}
+		if (CMM_LOAD_SHARED(domain->stop))
+			break;
+		while (uatomic_read(&domain->futex) == -1
+				&& futex_async(&domain->futex, FUTEX_WAIT, -1,
+					NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+			case EINTR:
+				break;
+			default:
+				urcu_die(errno);
+			}
+		}
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void rcu_domain_wake_up(struct rcu_domain *domain)
+{
+	/* Write to the callback queue before reading/writing futex */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&domain->futex) == -1)) {
+		uatomic_set(&domain->futex, 0);
+		if (futex_async(&domain->futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+}
+
+int rcu_domain_destroy(struct rcu_domain *domain)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		if (CMM_LOAD_SHARED(domain->registry[i].nr))
+			return -EBUSY;
+	}
+	mutex_lock(&rcu_domain_list_lock);
+	cds_list_del(&domain->node);
+	mutex_unlock(&rcu_domain_list_lock);
+	if (domain->worker) {
+		/* The worker invokes the pending callbacks before exiting. */
+		CMM_STORE_SHARED(domain->stop, 1);
+		rcu_domain_wake_up(domain);
+		ret = pthread_join(domain->tid, NULL);
+		if (ret)
+			urcu_die(ret);
+	}
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		urcu_free(domain->registry[i].readers);
+		urcu_free(domain->registry[i].state);
+		(void) pthread_mutex_destroy(&domain->registry[i].lock);
+	}
+	cds_wfcq_destroy(&domain->cbs_head, &domain->cbs_tail);
+	(void) pthread_mutex_destroy(&domain->gp_lock);
+	(void) pthread_mutex_destroy(&domain->worker_lock);
+	urcu_free(domain);
+	return 0;
+}
+
+struct rcu_domain_reader *rcu_domain_register_thread(struct rcu_domain *domain)
+{
+	struct rcu_domain_reader *r;
+	struct rcu_registry_shard *shard;
+
+	assert(URCU_TLS(rcu_reader).registered);
+	if (urcu_posix_memalign((void **) &r, CAA_CACHE_LINE_SIZE,
+			sizeof(*r))) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset(r, 0, sizeof(*r));
+	r->reader.tid = pthread_self();
+	r->reader.registered = 1;
+	r->gp = &domain->gp;
+	r->domain = domain;
+	shard = &domain->registry[rcu_registry_shard_index(r)];
+	mutex_lock(&shard->lock);
+	rcu_registry_add(shard, &r->reader);
+	mutex_unlock(&shard->lock);
+	return r;
+}
+
+void rcu_domain_unregister_thread(struct rcu_domain_reader *r)
+{
+	struct rcu_registry_shard *shard;
+
+	assert(!(r->reader.ctr & RCU_GP_CTR_NEST_MASK));
+	shard = &r->domain->registry[rcu_registry_shard_index(r)];
+	mutex_lock(&shard->lock);
+	rcu_registry_del(shard, &r->reader);
+	mutex_unlock(&shard->lock);
+	urcu_free(r);
+}
+
+void rcu_domain_read_lock(struct rcu_domain_reader *r)
+{
+	_rcu_domain_read_lock(r);
+}
+
+void rcu_domain_read_unlock(struct rcu_domain_reader *r)
+{
+	_rcu_domain_read_unlock(r);
+}
+
+int rcu_domain_read_ongoing(struct rcu_domain_reader *r)
+{
+	return _rcu_domain_read_ongoing(r);
+}
+
+void synchronize_rcu_domain(struct rcu_domain *domain)
+{
+	mutex_lock(&domain->gp_lock);
+	__synchronize_rcu_gp(&domain->gp, domain->registry,
+			&domain->budget, 0, NULL);
+	mutex_unlock(&domain->gp_lock);
+}
+
+/* Called with worker_lock held. */
+static void rcu_domain_start_worker(struct rcu_domain *domain)
+{
+	int ret;
+
+	ret = pthread_create(&domain->tid, NULL, rcu_domain_thread, domain);
+	if (ret)
+		urcu_die(ret);
+	CMM_STORE_SHARED(domain->worker, 1);
+}
+
+void call_rcu_domain(struct rcu_domain *domain, struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	if (caa_unlikely(!CMM_LOAD_SHARED(domain->worker))) {
+		mutex_lock(&domain->worker_lock);
+		if (!domain->worker)
+			rcu_domain_start_worker(domain);
+		mutex_unlock(&domain->worker_lock);
+	}
+	cds_wfcq_node_init(&head->next);
+	head->func = func;
+	cds_wfcq_enqueue(&domain->cbs_head, &domain->cbs_tail, &head->next);
+	rcu_domain_wake_up(domain);
+}
+
+static void rcu_domain_barrier_func(struct rcu_head *head)
+{
+	struct rcu_domain_barrier *barrier =
+		caa_container_of(head, struct rcu_domain_barrier, head);
+
+	urcu_adaptative_wake_up(&barrier->wait);
+}
+
+/*
+ * Wait for the callbacks queued by call_rcu_domain() before the call to
+ * be invoked. Must not be called from a callback of the domain.
+ */
+void rcu_barrier_domain(struct rcu_domain *domain)
+{
+	struct rcu_domain_barrier barrier;
+
+	if (!CMM_LOAD_SHARED(domain->worker))
+		return;
+	urcu_wait_node_init(&barrier.wait, URCU_WAIT_WAITING);
+	call_rcu_domain(domain, &barrier.head, rcu_domain_barrier_func);
+	urcu_adaptative_busy_wait(&barrier.wait);
+}
+
+/*
+ * Called by call_rcu_before_fork(): no grace period of a domain, nor
+ * worker thread creation, is in progress across the fork.
+ */
+static void rcu_domain_before_fork(void)
+{
+	struct rcu_domain *domain;
+
+	mutex_lock(&rcu_domain_list_lock);
+	cds_list_for_each_entry(domain, &rcu_domain_list, node) {
+		mutex_lock(&domain->worker_lock);
+		mutex_lock(&domain->gp_lock);
+	}
+}
+
+static void rcu_domain_after_fork_parent(void)
+{
+	struct rcu_domain *domain;
+
+	cds_list_for_each_entry(domain, &rcu_domain_list, node) {
+		mutex_unlock(&domain->gp_lock);
+		mutex_unlock(&domain->worker_lock);
+	}
+	mutex_unlock(&rcu_domain_list_lock);
+}
+
+/*
+ * The worker threads of the domains do not exist in the child: start
+ * new ones, which invoke the callbacks still queued. Callbacks the
+ * worker of the parent had already dequeued are only invoked in the
+ * parent.
+ */
+static void rcu_domain_after_fork_child(void)
+{
+	struct rcu_domain *domain;
+
+	cds_list_for_each_entry(domain, &rcu_domain_list, node) {
+		mutex_unlock(&domain->gp_lock);
+		if (domain->worker) {
+			domain->futex = 0;
+			rcu_domain_start_worker(domain);
+		}
+		mutex_unlock(&domain->worker_lock);
+	}
+	mutex_unlock(&rcu_domain_list_lock);
+}
+
+/* Fork handling for urcu-call-rcu-impl.h. */
+#define RCU_DOMAIN_ATFORK
+
+#endif /* _URCU_DOMAIN_IMPL_H */
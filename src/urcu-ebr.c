@@ -0,0 +1,759 @@
+/*
+ * urcu-ebr.c
+ *
+ * Userspace RCU library, epoch-based reclamation version.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The global epoch advances from e to e + 1 once every reader within a
+ * critical section has announced e: a reader which announced e prevents
+ * the epoch from reaching e + 2 until it leaves its critical section.
+ * A callback is queued in the epoch read after its data was unpublished,
+ * say e. The readers which may still reference the data announced e or
+ * an earlier epoch, or e + 1 when their loads were ordered by nothing but
+ * the memory barriers of an advance with sys_membarrier(): the callback
+ * is invoked once the epoch reached e + RCU_EBR_GP_EPOCHS, that is e + 3.
+ *
+ * Threads queue callbacks on their own limbo lists, one per epoch, and
+ * every RCU_EBR_RECLAIM_INTERVAL callbacks try to advance the epoch and
+ * invoke their expired lists. Threads queuing callbacks thus pay for
+ * the grace periods, on their own: there is no grace-period nor
+ * call_rcu thread, and no call_rcu() waits for readers. The callbacks
+ * of unregistered threads, and those pending when a thread unregisters,
+ * go to global orphan lists, invoked by the next thread reclaiming.
+ */
+
+#define _LGPL_SOURCE
+#include <stdio.h>
+#include <pthread.h>
+#include <signal.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdbool.h>
+
+#include "urcu/arch.h"
+#include "urcu/list.h"
+#include "urcu/map/urcu-ebr.h"
+#include "urcu/static/urcu-ebr.h"
+#include "urcu-pointer.h"
+#include "urcu/tls-compat.h"
+
+#include "urcu-die.h"
+
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#undef _LGPL_SOURCE
+#include "urcu-ebr.h"
+#define _LGPL_SOURCE
+
+/* Sleep delay in ms */
+#define RCU_SLEEP_DELAY_MS	10
+
+/*
+ * Active attempts to advance the epoch before calling sleep().
+ */
+#define RCU_QS_ACTIVE_ATTEMPTS 100
+
+/* Callbacks queued by a thread between two reclaim attempts. */
+#define RCU_EBR_RECLAIM_INTERVAL	64
+
+/* If the headers do not support membarrier system call, fall back smp_mb. */
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY				= 0,
+	MEMBARRIER_CMD_SHARED				= (1 << 0),
+	/* reserved for MEMBARRIER_CMD_SHARED_EXPEDITED (1 << 1) */
+	/* reserved for MEMBARRIER_CMD_PRIVATE (1 << 2) */
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
+};
+
+static
+void rcu_sys_membarrier_init(void);
+
+#ifndef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+int urcu_ebr_has_sys_membarrier;
+#endif
+
+/*
+ * rcu_registry_lock protects the registry, and serializes the epoch
+ * advances. Nests the limbo_lock of the readers.
+ */
+static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * sys_membarrier() is probed by the first thread registering, rather
+ * than by a library constructor, with rcu_registry_lock held: readers
+ * and epoch advances only read its status after a registration.
+ */
+static int init_done;
+
+/*
+ * rcu_gp_lock protects the orphan callbacks and the lfht fork handlers.
+ * Taken before rcu_registry_lock across fork.
+ */
+static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static CDS_LIST_HEAD(registry);
+
+struct rcu_gp rcu_gp;
+
+/*
+ * Announced epoch and callbacks of each thread, see
+ * urcu/static/urcu-ebr.h.
+ */
+DEFINE_URCU_TLS(struct rcu_reader, rcu_reader);
+
+/*
+ * Callbacks of unregistered threads, and of the threads which
+ * unregistered before they expired. rcu_gp_lock.
+ */
+static struct rcu_ebr_limbo orphans[RCU_EBR_NR_LIMBO];
+static unsigned long nr_orphans_queued;
+
+static struct urcu_atfork *registered_rculfhash_atfork;
+static unsigned long registered_rculfhash_atfork_refcount;
+
+/* Saved fork signal mask, protected by rcu_gp_lock */
+static sigset_t saved_fork_signal_mask;
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+#ifndef DISTRUST_SIGNALS_EXTREME
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+#else /* #ifndef DISTRUST_SIGNALS_EXTREME */
+	while ((ret = pthread_mutex_trylock(mutex)) != 0) {
+		if (ret != EBUSY && ret != EINTR)
+			urcu_die(ret);
+		poll(NULL,0,10);
+	}
+#endif /* #else #ifndef DISTRUST_SIGNALS_EXTREME */
+}
+
+/* Returns non-zero if the mutex was taken. */
+static int mutex_trylock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_trylock(mutex);
+	if (ret && ret != EBUSY)
+		urcu_die(ret);
+	return !ret;
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void smp_mb_master(void)
+{
+	if (caa_likely(urcu_ebr_has_sys_membarrier)) {
+		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
+			urcu_die(errno);
+	} else {
+		cmm_smp_mb();
+	}
+}
+
+/* Returns non-zero if epoch @a is before epoch @b. */
+static int epoch_before(unsigned long a, unsigned long b)
+{
+	return (long) (a - b) < 0;
+}
+
+/* Returns non-zero if callbacks queued in @queued expired in @epoch. */
+static int epoch_expired(unsigned long queued, unsigned long epoch)
+{
+	return !epoch_before(epoch, queued + RCU_EBR_GP_EPOCHS * RCU_EBR_EPOCH);
+}
+
+static struct rcu_ebr_limbo *limbo_of(struct rcu_ebr_limbo *limbo,
+		unsigned long epoch)
+{
+	return &limbo[(epoch / RCU_EBR_EPOCH) % RCU_EBR_NR_LIMBO];
+}
+
+/* Append the callbacks [@first, @last], queued in @epoch, to @l. */
+static void limbo_add(struct rcu_ebr_limbo *l, struct rcu_head *first,
+		struct rcu_head *last, unsigned long epoch)
+{
+	last->next.next = NULL;
+	if (l->head) {
+		l->tail->next.next = &first->next;
+		/* Only merged with other epochs on wrap around. */
+		if (epoch_before(l->epoch, epoch))
+			l->epoch = epoch;
+	} else {
+		l->head = first;
+		l->epoch = epoch;
+	}
+	l->tail = last;
+}
+
+static void limbo_splice(struct rcu_ebr_limbo *dst, struct rcu_ebr_limbo *src)
+{
+	if (!src->head)
+		return;
+	limbo_add(dst, src->head, src->tail, src->epoch);
+	src->head = src->tail = NULL;
+}
+
+/*
+ * Queue the callbacks [@first, @last] in @epoch on @limbo. A list is
+ * reused every RCU_EBR_NR_LIMBO epochs: of the callbacks it holds and
+ * the queued ones, those of an earlier epoch have expired, and are
+ * moved to @ready instead of being merged.
+ */
+static void limbo_queue(struct rcu_ebr_limbo *limbo, struct rcu_head *first,
+		struct rcu_head *last, unsigned long epoch,
+		struct rcu_ebr_limbo *ready)
+{
+	struct rcu_ebr_limbo *l = limbo_of(limbo, epoch);
+
+	if (l->head && l->epoch != epoch) {
+		if (epoch_expired(l->epoch, epoch)) {
+			limbo_splice(ready, l);
+		} else if (epoch_expired(epoch, l->epoch)) {
+			limbo_add(ready, first, last, epoch);
+			return;
+		}
+	}
+	limbo_add(l, first, last, epoch);
+}
+
+/* Move the lists of @limbo expired in @epoch to @ready. */
+static void limbo_expire(struct rcu_ebr_limbo *limbo, unsigned long epoch,
+		struct rcu_ebr_limbo *ready)
+{
+	int i;
+
+	for (i = 0; i < RCU_EBR_NR_LIMBO; i++) {
+		if (limbo[i].head && epoch_expired(limbo[i].epoch, epoch))
+			limbo_splice(ready, &limbo[i]);
+	}
+}
+
+/* Move all the lists of @limbo to orphans. Called with rcu_gp_lock. */
+static void limbo_orphan(struct rcu_ebr_limbo *limbo,
+		struct rcu_ebr_limbo *ready)
+{
+	int i;
+
+	for (i = 0; i < RCU_EBR_NR_LIMBO; i++) {
+		struct rcu_ebr_limbo *l = &limbo[i];
+
+		if (!l->head)
+			continue;
+		limbo_queue(orphans, l->head, l->tail, l->epoch, ready);
+		l->head = l->tail = NULL;
+	}
+}
+
+static void limbo_invoke(struct rcu_ebr_limbo *l)
+{
+	struct rcu_head *head, *next;
+
+	for (head = l->head; head; head = next) {
+		next = head->next.next ?
+			caa_container_of(head->next.next, struct rcu_head, next) :
+			NULL;
+		head->func(head);
+	}
+}
+
+/*
+ * Advance the global epoch if every reader within a critical section
+ * announced it. Called with rcu_registry_lock held. Returns non-zero if
+ * the epoch was advanced.
+ */
+static int epoch_try_advance(void)
+{
+	struct rcu_reader *index;
+	unsigned long epoch;
+
+	epoch = CMM_LOAD_SHARED(rcu_gp.epoch);
+	/*
+	 * Read the epoch before the announces: a reader seen outside of
+	 * a critical section which then reads back this epoch is
+	 * accounted for by the next advance.
+	 */
+	smp_mb_master();
+	cds_list_for_each_entry(index, &registry, node) {
+		unsigned long ctr = CMM_LOAD_SHARED(index->ctr);
+
+		if ((ctr & RCU_EBR_ACTIVE) && ctr != (epoch | RCU_EBR_ACTIVE))
+			return 0;
+	}
+	/* Read the announces before advancing. */
+	smp_mb_master();
+	CMM_STORE_SHARED(rcu_gp.epoch, epoch + RCU_EBR_EPOCH);
+	return 1;
+}
+
+/* Advance the epoch if possible, unless another thread is at it. */
+static void epoch_try_advance_nowait(void)
+{
+	if (!mutex_trylock(&rcu_registry_lock))
+		return;
+	(void) epoch_try_advance();
+	mutex_unlock(&rcu_registry_lock);
+}
+
+/*
+ * Try to advance the epoch, then invoke the expired callbacks of @r, if
+ * not NULL, and of the orphans.
+ */
+static void reclaim(struct rcu_reader *r)
+{
+	struct rcu_ebr_limbo ready = { NULL, NULL, 0 };
+	unsigned long epoch;
+	int i;
+
+	epoch_try_advance_nowait();
+	epoch = CMM_LOAD_SHARED(rcu_gp.epoch);
+	/* Read the epoch before invoking the callbacks. */
+	cmm_smp_mb();
+	if (r) {
+		mutex_lock(&r->limbo_lock);
+		limbo_expire(r->limbo, epoch, &ready);
+		mutex_unlock(&r->limbo_lock);
+	}
+	for (i = 0; i < RCU_EBR_NR_LIMBO; i++) {
+		if (CMM_LOAD_SHARED(orphans[i].head))
+			break;
+	}
+	if (i < RCU_EBR_NR_LIMBO && mutex_trylock(&rcu_gp_lock)) {
+		limbo_expire(orphans, epoch, &ready);
+		nr_orphans_queued = 0;
+		mutex_unlock(&rcu_gp_lock);
+	}
+	limbo_invoke(&ready);
+}
+
+/* Queue the callbacks [@first, @last] in the current epoch. */
+static void queue_callbacks(struct rcu_head *first, struct rcu_head *last,
+		unsigned long count)
+{
+	struct rcu_reader *r = &URCU_TLS(rcu_reader);
+	struct rcu_ebr_limbo ready = { NULL, NULL, 0 };
+	unsigned long epoch;
+	int do_reclaim;
+
+	/* Unpublish the data before reading the epoch it is queued in. */
+	cmm_smp_mb();
+	epoch = CMM_LOAD_SHARED(rcu_gp.epoch);
+	if (caa_likely(r->registered)) {
+		mutex_lock(&r->limbo_lock);
+		limbo_queue(r->limbo, first, last, epoch, &ready);
+		mutex_unlock(&r->limbo_lock);
+		r->nr_queued += count;
+		do_reclaim = r->nr_queued >= RCU_EBR_RECLAIM_INTERVAL;
+		if (do_reclaim)
+			r->nr_queued = 0;
+	} else {
+		mutex_lock(&rcu_gp_lock);
+		limbo_queue(orphans, first, last, epoch, &ready);
+		nr_orphans_queued += count;
+		do_reclaim = nr_orphans_queued >= RCU_EBR_RECLAIM_INTERVAL;
+		if (do_reclaim)
+			nr_orphans_queued = 0;
+		mutex_unlock(&rcu_gp_lock);
+	}
+	limbo_invoke(&ready);
+	if (do_reclaim)
+		reclaim(r->registered ? r : NULL);
+}
+
+void call_rcu(struct rcu_head *head,
+	      void (*func)(struct rcu_head *head))
+{
+	head->func = func;
+	queue_callbacks(head, head, 1);
+}
+
+/*
+ * Same as call_rcu() for the callbacks chained from @first to @last
+ * through their next field, with their func already set.
+ */
+void call_rcu_batch(struct rcu_head *first, struct rcu_head *last)
+{
+	struct rcu_head *head;
+	unsigned long count = 1;
+
+	for (head = first; head != last;
+	     head = caa_container_of(head->next.next, struct rcu_head, next))
+		count++;
+	queue_callbacks(first, last, count);
+}
+
+void rcu_quiescent_state(void)
+{
+	struct rcu_reader *r = &URCU_TLS(rcu_reader);
+
+	reclaim(r->registered ? r : NULL);
+}
+
+void synchronize_rcu(void)
+{
+	unsigned long cookie;
+	unsigned int wait_loops = 0;
+	int advanced;
+
+	urcu_assert(!URCU_TLS(rcu_reader).nesting);
+	cookie = get_state_synchronize_rcu();
+	while (epoch_before(CMM_LOAD_SHARED(rcu_gp.epoch), cookie)) {
+		mutex_lock(&rcu_registry_lock);
+		advanced = epoch_try_advance();
+		mutex_unlock(&rcu_registry_lock);
+		if (advanced)
+			continue;
+		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS) {
+			wait_loops++;
+			caa_cpu_relax();
+		} else {
+			(void) poll(NULL, 0, RCU_SLEEP_DELAY_MS);
+		}
+	}
+	/*
+	 * Finish waiting for reader threads before letting the old ptr being
+	 * freed.
+	 */
+	cmm_smp_mb();
+}
+
+/*
+ * Polling grace-period API: the cookie is the epoch at which the
+ * readers of the current epoch are done.
+ */
+unsigned long get_state_synchronize_rcu(void)
+{
+	/* Order prior updates before reading the epoch. */
+	cmm_smp_mb();
+	return CMM_LOAD_SHARED(rcu_gp.epoch) + RCU_EBR_GP_EPOCHS * RCU_EBR_EPOCH;
+}
+
+/* Also advances the epoch if possible: pollers drive the grace periods. */
+int poll_state_synchronize_rcu(unsigned long cookie)
+{
+	if (epoch_before(CMM_LOAD_SHARED(rcu_gp.epoch), cookie)) {
+		epoch_try_advance_nowait();
+		if (epoch_before(CMM_LOAD_SHARED(rcu_gp.epoch), cookie))
+			return 0;
+	}
+	/* Order following frees after the grace period. */
+	cmm_smp_mb();
+	return 1;
+}
+
+unsigned long start_poll_synchronize_rcu(void)
+{
+	unsigned long cookie;
+
+	cookie = get_state_synchronize_rcu();
+	epoch_try_advance_nowait();
+	return cookie;
+}
+
+void cond_synchronize_rcu(unsigned long cookie)
+{
+	if (!poll_state_synchronize_rcu(cookie))
+		synchronize_rcu();
+}
+
+/*
+ * Wait for a grace period, then invoke the callbacks of every thread
+ * queued before it: they are the expired ones.
+ */
+void rcu_barrier(void)
+{
+	struct rcu_ebr_limbo ready = { NULL, NULL, 0 };
+	struct rcu_reader *index;
+	unsigned long epoch;
+
+	synchronize_rcu();
+	epoch = CMM_LOAD_SHARED(rcu_gp.epoch);
+	/* Read the epoch before invoking the callbacks. */
+	cmm_smp_mb();
+	mutex_lock(&rcu_registry_lock);
+	cds_list_for_each_entry(index, &registry, node) {
+		mutex_lock(&index->limbo_lock);
+		limbo_expire(index->limbo, epoch, &ready);
+		mutex_unlock(&index->limbo_lock);
+	}
+	mutex_unlock(&rcu_registry_lock);
+	mutex_lock(&rcu_gp_lock);
+	limbo_expire(orphans, epoch, &ready);
+	mutex_unlock(&rcu_gp_lock);
+	limbo_invoke(&ready);
+}
+
+/*
+ * There are no defer_rcu() queues: the callback is invoked after a
+ * grace period.
+ */
+void defer_rcu(void (*fct)(void *p), void *p)
+{
+	synchronize_rcu();
+	fct(p);
+}
+
+int rcu_defer_register_thread(void)
+{
+	return 0;
+}
+
+void rcu_defer_unregister_thread(void)
+{
+}
+
+void rcu_defer_barrier(void)
+{
+}
+
+void rcu_defer_barrier_thread(void)
+{
+}
+
+/* defer_rcu() callbacks already wait for the grace periods of call_rcu(). */
+int rcu_defer_set_call_rcu(int enable)
+{
+	(void) enable;
+	return 0;
+}
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+void rcu_read_lock(void)
+{
+	_rcu_read_lock();
+}
+
+void rcu_read_unlock(void)
+{
+	_rcu_read_unlock();
+}
+
+int rcu_read_ongoing(void)
+{
+	return _rcu_read_ongoing();
+}
+
+void rcu_register_thread(void)
+{
+	struct rcu_reader *r = &URCU_TLS(rcu_reader);
+	int ret;
+
+	assert(!r->registered);
+	r->tid = pthread_self();
+	ret = pthread_mutex_init(&r->limbo_lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	mutex_lock(&rcu_registry_lock);
+	if (caa_unlikely(!init_done)) {
+		rcu_sys_membarrier_init();
+		init_done = 1;
+	}
+	r->registered = 1;
+	cds_list_add(&r->node, &registry);
+	mutex_unlock(&rcu_registry_lock);
+}
+
+/*
+ * The callbacks of the thread which did not expire yet become orphans,
+ * invoked by the next thread reclaiming.
+ */
+void rcu_unregister_thread(void)
+{
+	struct rcu_reader *r = &URCU_TLS(rcu_reader);
+	struct rcu_ebr_limbo ready = { NULL, NULL, 0 };
+
+	assert(r->registered);
+	urcu_assert(!r->nesting);
+	mutex_lock(&rcu_registry_lock);
+	r->registered = 0;
+	cds_list_del(&r->node);
+	mutex_unlock(&rcu_registry_lock);
+
+	/* Out of the registry: no other thread can access the limbo. */
+	mutex_lock(&rcu_gp_lock);
+	limbo_orphan(r->limbo, &ready);
+	mutex_unlock(&rcu_gp_lock);
+	(void) pthread_mutex_destroy(&r->limbo_lock);
+	r->nr_queued = 0;
+	limbo_invoke(&ready);
+}
+
+#ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+static
+void rcu_sys_membarrier_status(bool available)
+{
+	if (!available)
+		abort();
+}
+#else
+static
+void rcu_sys_membarrier_status(bool available)
+{
+	if (!available)
+		return;
+	urcu_ebr_has_sys_membarrier = 1;
+}
+#endif
+
+static
+void rcu_sys_membarrier_init(void)
+{
+	bool available = false;
+	int mask;
+
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (mask >= 0) {
+		if (mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED) {
+			if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0))
+				urcu_die(errno);
+			available = true;
+		}
+	}
+	rcu_sys_membarrier_status(available);
+}
+
+void urcu_register_rculfhash_atfork(struct urcu_atfork *atfork)
+{
+	mutex_lock(&rcu_gp_lock);
+	if (!registered_rculfhash_atfork_refcount++)
+		registered_rculfhash_atfork = atfork;
+	mutex_unlock(&rcu_gp_lock);
+}
+
+void urcu_unregister_rculfhash_atfork(struct urcu_atfork *atfork)
+{
+	mutex_lock(&rcu_gp_lock);
+	if (!--registered_rculfhash_atfork_refcount)
+		registered_rculfhash_atfork = NULL;
+	mutex_unlock(&rcu_gp_lock);
+}
+
+/*
+ * Holding rcu_gp_lock and rcu_registry_lock across fork makes sure
+ * fork() does not race with an epoch advance, a registration or the
+ * orphans being reclaimed.
+ */
+void rcu_ebr_before_fork(void)
+{
+	struct urcu_atfork *atfork;
+	sigset_t newmask, oldmask;
+	int ret;
+
+	ret = sigfillset(&newmask);
+	assert(!ret);
+	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
+	assert(!ret);
+	mutex_lock(&rcu_gp_lock);
+	atfork = registered_rculfhash_atfork;
+	if (atfork)
+		atfork->before_fork(atfork->priv);
+	mutex_lock(&rcu_registry_lock);
+	saved_fork_signal_mask = oldmask;
+}
+
+void rcu_ebr_after_fork_parent(void)
+{
+	struct urcu_atfork *atfork;
+	sigset_t oldmask;
+	int ret;
+
+	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&rcu_registry_lock);
+	atfork = registered_rculfhash_atfork;
+	if (atfork)
+		atfork->after_fork_parent(atfork->priv);
+	mutex_unlock(&rcu_gp_lock);
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	assert(!ret);
+}
+
+/*
+ * Only our own thread exists in the child: drop the other readers,
+ * whose critical sections will never end. Their callbacks are leaked,
+ * as fork() may have interrupted them while queuing one.
+ */
+void rcu_ebr_after_fork_child(void)
+{
+	struct rcu_reader *index, *tmp;
+	struct urcu_atfork *atfork;
+	sigset_t oldmask;
+	int ret;
+
+	cds_list_for_each_entry_safe(index, tmp, &registry, node) {
+		if (index == &URCU_TLS(rcu_reader))
+			continue;
+		cds_list_del(&index->node);
+	}
+	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&rcu_registry_lock);
+	atfork = registered_rculfhash_atfork;
+	if (atfork)
+		atfork->after_fork_child(atfork->priv);
+	mutex_unlock(&rcu_gp_lock);
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	assert(!ret);
+}
+
+void *rcu_dereference_sym_ebr(void *p)
+{
+	return _rcu_dereference(p);
+}
+
+void *rcu_set_pointer_sym_ebr(void **p, void *v)
+{
+	cmm_wmb();
+	uatomic_set(p, v);
+	return v;
+}
+
+void *rcu_xchg_pointer_sym_ebr(void **p, void *v)
+{
+	cmm_wmb();
+	return uatomic_xchg(p, v);
+}
+
+void *rcu_cmpxchg_pointer_sym_ebr(void **p, void *old, void *_new)
+{
+	cmm_wmb();
+	return uatomic_cmpxchg(p, old, _new);
+}
+
+DEFINE_RCU_FLAVOR(rcu_flavor);
@@ -0,0 +1,199 @@
+#ifndef _URCU_EBR_H
+#define _URCU_EBR_H
+
+/*
+ * urcu-ebr.h
+ *
+ * Userspace RCU header, epoch-based reclamation version.
+ *
+ * Readers announce the global epoch they run in, and callbacks are
+ * kept on per-thread lists until the global epoch advanced three times.
+ * The epoch is advanced by the threads queuing callbacks, once every few
+ * callbacks, which then invoke their expired callbacks: there is no
+ * call_rcu thread, and call_rcu() never waits for a grace period.
+ * Reader threads must be registered.
+ *
+ * LGPL-compatible code should include this header with :
+ *
+ * #define _LGPL_SOURCE
+ * #include <urcu.h>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <urcu/map/urcu-ebr.h>
+
+/*
+ * See urcu-pointer.h and urcu/static/urcu-pointer.h for pointer
+ * publication headers.
+ */
+#include <urcu-pointer.h>
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/urcu-ebr.h>
+
+/*
+ * Mappings for static use of the userspace RCU library.
+ * Should only be used in LGPL-compatible code.
+ */
+
+/*
+ * rcu_read_lock()
+ * rcu_read_unlock()
+ *
+ * Mark the beginning and end of a read-side critical section.
+ */
+#define rcu_read_lock_ebr			_rcu_read_lock
+#define rcu_read_unlock_ebr			_rcu_read_unlock
+#define rcu_read_ongoing_ebr			_rcu_read_ongoing
+
+#define rcu_dereference_ebr			rcu_dereference
+#define rcu_cmpxchg_pointer_ebr		rcu_cmpxchg_pointer
+#define rcu_xchg_pointer_ebr			rcu_xchg_pointer
+#define rcu_set_pointer_ebr			rcu_set_pointer
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ * See LGPL-only urcu/static/urcu-pointer.h for documentation.
+ */
+
+extern void rcu_read_lock(void);
+extern void rcu_read_unlock(void);
+extern int rcu_read_ongoing(void);
+
+extern void *rcu_dereference_sym_ebr(void *p);
+#define rcu_dereference_ebr(p)						     \
+	__extension__							     \
+	({								     \
+		__typeof__(p) _________p1 = URCU_FORCE_CAST(__typeof__(p),   \
+			rcu_dereference_sym_ebr(URCU_FORCE_CAST(void *, p))); \
+		(_________p1);						     \
+	})
+
+extern void *rcu_cmpxchg_pointer_sym_ebr(void **p, void *old, void *_new);
+#define rcu_cmpxchg_pointer_ebr(p, old, _new)				     \
+	__extension__							     \
+	({								     \
+		__typeof__(*(p)) _________pold = (old);			     \
+		__typeof__(*(p)) _________pnew = (_new);		     \
+		__typeof__(*(p)) _________p1 = URCU_FORCE_CAST(__typeof__(*(p)), \
+			rcu_cmpxchg_pointer_sym_ebr(URCU_FORCE_CAST(void **, p), \
+						_________pold,		     \
+						_________pnew));	     \
+		(_________p1);						     \
+	})
+
+extern void *rcu_xchg_pointer_sym_ebr(void **p, void *v);
+#define rcu_xchg_pointer_ebr(p, v)					     \
+	__extension__							     \
+	({								     \
+		__typeof__(*(p)) _________pv = (v);			     \
+		__typeof__(*(p)) _________p1 = URCU_FORCE_CAST(__typeof__(*(p)),\
+			rcu_xchg_pointer_sym_ebr(URCU_FORCE_CAST(void **, p), \
+					     _________pv));		     \
+		(_________p1);						     \
+	})
+
+extern void *rcu_set_pointer_sym_ebr(void **p, void *v);
+#define rcu_set_pointer_ebr(p, v)					     \
+	__extension__							     \
+	({								     \
+		__typeof__(*(p)) _________pv = (v);			     \
+		__typeof__(*(p)) _________p1 = URCU_FORCE_CAST(__typeof__(*(p)), \
+			rcu_set_pointer_sym_ebr(URCU_FORCE_CAST(void **, p),  \
+					    _________pv));		     \
+		(_________p1);						     \
+	})
+
+#endif /* !_LGPL_SOURCE */
+
+extern void synchronize_rcu(void);
+
+/*
+ * Polling grace-period API: a cookie taken before removing data can be
+ * polled to know whether the data can be freed without waiting.
+ */
+extern unsigned long get_state_synchronize_rcu(void);
+extern unsigned long start_poll_synchronize_rcu(void);
+extern int poll_state_synchronize_rcu(unsigned long cookie);
+extern void cond_synchronize_rcu(unsigned long cookie);
+
+/*
+ * rcu_ebr_before_fork, rcu_ebr_after_fork_parent and
+ * rcu_ebr_after_fork_child should be called around fork() system calls
+ * when the child process is not expected to immediately perform an exec().
+ * For pthread users, see pthread_atfork(3).
+ */
+extern void rcu_ebr_before_fork(void);
+extern void rcu_ebr_after_fork_parent(void);
+extern void rcu_ebr_after_fork_child(void);
+
+extern void rcu_register_thread(void);
+extern void rcu_unregister_thread(void);
+
+/*
+ * Advance the global epoch if possible, and invoke the expired callbacks
+ * queued by the calling thread. call_rcu() does the same periodically:
+ * this lets threads which stopped queuing callbacks get theirs invoked.
+ */
+extern void rcu_quiescent_state(void);
+
+/*
+ * In the epoch-based reclamation version, following functions are
+ * no-ops: readers not within a critical section never hold back the
+ * epoch.
+ */
+static inline void rcu_init(void)
+{
+}
+
+static inline void rcu_thread_offline(void)
+{
+}
+
+static inline void rcu_thread_online(void)
+{
+}
+
+/*
+ * Of the call_rcu API, only call_rcu(), call_rcu_batch() and
+ * rcu_barrier() are provided, and defer_rcu() waits for a grace period
+ * before invoking its callback, the other defer functions being no-ops.
+ * Callbacks are invoked by the threads calling call_rcu(),
+ * rcu_quiescent_state(), rcu_barrier() or rcu_unregister_thread(),
+ * possibly within their read-side critical section and with the locks
+ * held around call_rcu(): callbacks must not wait for a grace period,
+ * nor take locks held by callers of call_rcu().
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <urcu-call-rcu.h>
+#include <urcu-defer.h>
+#include <urcu-flavor.h>
+
+#endif /* _URCU_EBR_H */
@@ -0,0 +1,122 @@
+#ifndef _URCU_GP_STATS_IMPL_H
+#define _URCU_GP_STATS_IMPL_H
+
+/*
+ * urcu-gp-stats.h
+ *
+ * Userspace RCU library - grace period statistics accounting
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/gp-stats.h>
+#include "urcu-time.h"
+#include "urcu-trace.h"
+
+/*
+ * The grace period counters are only written with the grace period
+ * lock held, the membarrier and signal counters atomically, as RCU
+ * domains issue them concurrently. rcu_gp_get_stats() only loads them,
+ * so that QSBR readers can call it while online.
+ */
+#define rcu_gp_stats_add(field, v)				\
+	CMM_STORE_SHARED(field, (field) + (v))
+
+/* Timestamps of the grace period being accounted. */
+struct rcu_gp_stats_clock {
+	uint64_t start_ns;	/* Lock taken. */
+	uint64_t phase_ns;	/* Current phase started. */
+};
+
+/*
+ * A grace period serving @callers synchronize_rcu() calls got the lock,
+ * which its leader started to wait for at @lock_ns. The gp_start and
+ * gp_end probes fire along with the accounting of the grace periods.
+ */
+static inline void rcu_gp_stats_begin(struct rcu_gp_stats *stats,
+		struct rcu_gp_stats_clock *clock, uint64_t lock_ns,
+		unsigned long callers)
+{
+	urcu_trace1(gp_start, callers);
+	clock->start_ns = clock->phase_ns = urcu_time_ns();
+	rcu_gp_stats_add(stats->phase_ns[RCU_GP_PHASE_LOCK],
+			clock->start_ns - lock_ns);
+	rcu_gp_stats_add(stats->callers, callers);
+	if (callers > stats->callers_max)
+		CMM_STORE_SHARED(stats->callers_max, callers);
+}
+
+static inline void rcu_gp_stats_phase(struct rcu_gp_stats *stats,
+		struct rcu_gp_stats_clock *clock, enum rcu_gp_phase phase)
+{
+	uint64_t now = urcu_time_ns();
+
+	rcu_gp_stats_add(stats->phase_ns[phase], now - clock->phase_ns);
+	clock->phase_ns = now;
+}
+
+static inline void rcu_gp_stats_end(struct rcu_gp_stats *stats,
+		struct rcu_gp_stats_clock *clock)
+{
+	uint64_t ns = urcu_time_ns() - clock->start_ns;
+
+	rcu_gp_stats_add(stats->grace_periods, 1);
+	rcu_gp_stats_add(stats->gp_ns, ns);
+	if (ns > stats->gp_max_ns)
+		CMM_STORE_SHARED(stats->gp_max_ns, ns);
+	urcu_trace1(gp_end, ns);
+}
+
+/*
+ * @callers synchronize_rcu() calls found a grace period started after
+ * they were made already completed, once they got the lock.
+ */
+static inline void rcu_gp_stats_coalesced(struct rcu_gp_stats *stats,
+		unsigned long callers)
+{
+	rcu_gp_stats_add(stats->coalesced, callers);
+}
+
+/* A wait for readers scanned them @loops times, and slept @sleeps times. */
+static inline void rcu_gp_stats_wait(struct rcu_gp_stats *stats,
+		unsigned long loops, unsigned long sleeps)
+{
+	rcu_gp_stats_add(stats->wait_loops, loops);
+	rcu_gp_stats_add(stats->wait_sleeps, sleeps);
+}
+
+static inline void rcu_gp_stats_read(struct rcu_gp_stats *dst,
+		struct rcu_gp_stats *src)
+{
+	unsigned int i;
+
+	dst->grace_periods = CMM_LOAD_SHARED(src->grace_periods);
+	dst->callers = CMM_LOAD_SHARED(src->callers);
+	dst->callers_max = CMM_LOAD_SHARED(src->callers_max);
+	dst->coalesced = CMM_LOAD_SHARED(src->coalesced);
+	dst->gp_ns = CMM_LOAD_SHARED(src->gp_ns);
+	dst->gp_max_ns = CMM_LOAD_SHARED(src->gp_max_ns);
+	for (i = 0; i < RCU_GP_NR_PHASES; i++)
+		dst->phase_ns[i] = CMM_LOAD_SHARED(src->phase_ns[i]);
+	dst->wait_loops = CMM_LOAD_SHARED(src->wait_loops);
+	dst->wait_sleeps = CMM_LOAD_SHARED(src->wait_sleeps);
+	dst->membarriers = uatomic_read(&src->membarriers);
+	dst->signals = uatomic_read(&src->signals);
+}
+
+#endif /* _URCU_GP_STATS_IMPL_H */
@@ -0,0 +1,427 @@
+/*
+ * urcu-percpu.c
+ *
+ * Userspace RCU library, per-CPU read-side counters version.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdio.h>
+#include <pthread.h>
+#include <signal.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdbool.h>
+
+#include "urcu/arch.h"
+#include "urcu/wfcqueue.h"
+#include "urcu/map/urcu-percpu.h"
+#include "urcu/static/urcu-percpu.h"
+#include "urcu-pointer.h"
+#include "urcu/tls-compat.h"
+#include "urcu/alloc.h"
+
+#include "urcu-die.h"
+#include "urcu-gp-stats.h"
+
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#undef _LGPL_SOURCE
+#include "urcu-percpu.h"
+#define _LGPL_SOURCE
+
+#include "urcu-poll-impl.h"
+
+/* Sleep delay in ms */
+#define RCU_SLEEP_DELAY_MS	10
+
+/*
+ * Active attempts to check for reader Q.S. before calling sleep().
+ */
+#define RCU_QS_ACTIVE_ATTEMPTS 100
+
+/* If the headers do not support membarrier system call, fall back smp_mb. */
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY				= 0,
+	MEMBARRIER_CMD_SHARED				= (1 << 0),
+	/* reserved for MEMBARRIER_CMD_SHARED_EXPEDITED (1 << 1) */
+	/* reserved for MEMBARRIER_CMD_PRIVATE (1 << 2) */
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
+};
+
+#ifndef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+int urcu_percpu_has_sys_membarrier;
+#endif
+
+#ifdef _URCU_PERCPU_RSEQ
+int urcu_percpu_has_rseq;
+#endif
+
+/*
+ * rcu_gp_lock ensures mutual exclusion between threads calling
+ * synchronize_rcu().
+ */
+static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Statistics of the grace periods, see urcu-gp-stats.h. */
+static struct rcu_gp_stats rcu_gp_stats;
+
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct rcu_gp rcu_gp;
+
+/*
+ * Nesting count and counters index of each thread. Only accessed by the
+ * thread itself.
+ */
+DEFINE_URCU_TLS(struct rcu_reader, rcu_reader);
+
+/* Saved fork signal mask, protected by rcu_gp_lock */
+static sigset_t saved_fork_signal_mask;
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+#ifndef DISTRUST_SIGNALS_EXTREME
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+#else /* #ifndef DISTRUST_SIGNALS_EXTREME */
+	while ((ret = pthread_mutex_trylock(mutex)) != 0) {
+		if (ret != EBUSY && ret != EINTR)
+			urcu_die(ret);
+		poll(NULL,0,10);
+	}
+#endif /* #else #ifndef DISTRUST_SIGNALS_EXTREME */
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void smp_mb_master(void)
+{
+	if (caa_likely(urcu_percpu_has_sys_membarrier)) {
+		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
+			urcu_die(errno);
+		uatomic_inc(&rcu_gp_stats.membarriers);
+	} else {
+		cmm_smp_mb();
+	}
+}
+
+static unsigned long sum_counters(int unlock, unsigned long idx)
+{
+	unsigned long i, sum = 0;
+
+	for (i = 0; i < 2 * (rcu_gp.mask + 1); i++)
+		sum += CMM_LOAD_SHARED(*_rcu_percpu_counter(&rcu_gp.count[i],
+				unlock, idx));
+	return sum;
+}
+
+/*
+ * Both counts only increase, so the readers of an index are all done
+ * when the sum of its unlock counts, read first, equals the sum of its
+ * lock counts. Comparing with a first lock sum, read without ordering,
+ * saves the smp_mb_master() while readers are still in.
+ */
+static int readers_done(unsigned long idx)
+{
+	unsigned long unlocks;
+
+	unlocks = sum_counters(1, idx);
+	if (sum_counters(0, idx) != unlocks)
+		return 0;
+	/*
+	 * Read unlock counts before lock counts: a reader whose unlock
+	 * is counted has its lock counted too. Pairs with the
+	 * smp_mb_slave() of the readers.
+	 */
+	smp_mb_master();
+	return sum_counters(0, idx) == unlocks;
+}
+
+static void wait_for_readers(unsigned long idx)
+{
+	unsigned int wait_loops = 0, sleeps = 0;
+
+	while (!readers_done(idx)) {
+		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS) {
+			wait_loops++;
+			caa_cpu_relax();
+		} else {
+			sleeps++;
+			(void) poll(NULL, 0, RCU_SLEEP_DELAY_MS);
+		}
+	}
+	rcu_gp_stats_wait(&rcu_gp_stats, wait_loops + 1, sleeps);
+}
+
+void synchronize_rcu(void)
+{
+	struct rcu_gp_stats_clock clock;
+	unsigned long idx, cookie;
+	uint64_t lock_ns;
+
+	if (caa_unlikely(!CMM_LOAD_SHARED(rcu_gp.count)))
+		rcu_percpu_init();
+	/* Read the counters before the flags published with them. */
+	cmm_smp_rmb();
+
+	cookie = get_state_synchronize_rcu();
+	lock_ns = urcu_time_ns();
+	mutex_lock(&rcu_gp_lock);
+	/* Return if a grace period started since the call completed. */
+	if (poll_state_synchronize_rcu(cookie)) {
+		rcu_gp_stats_coalesced(&rcu_gp_stats, 1);
+		mutex_unlock(&rcu_gp_lock);
+		return;
+	}
+	rcu_gp_stats_begin(&rcu_gp_stats, &clock, lock_ns, 1);
+
+	rcu_gp_seq_start();
+
+	/* Write new ptr before reading the reader counters. */
+	smp_mb_master();
+
+	/*
+	 * Readers which loaded the index before the previous flip may
+	 * only now count themselves on the inactive index: wait for
+	 * them before flipping back to it.
+	 */
+	idx = (rcu_gp.ctr & RCU_PERCPU_IDX) ^ RCU_PERCPU_IDX;
+	wait_for_readers(idx);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_WAIT);
+
+	/*
+	 * Adding a cmm_smp_mb() which is _not_ formally required, but makes the
+	 * model easier to understand. It does not have a big performance impact
+	 * anyway, given this is the write-side.
+	 */
+	cmm_smp_mb();
+
+	/* Switch index: 0 -> 1, 1 -> 0 */
+	CMM_STORE_SHARED(rcu_gp.ctr, rcu_gp.ctr ^ RCU_PERCPU_IDX);
+
+	cmm_smp_mb();
+
+	/* New readers use idx now: wait for the readers of the old one. */
+	wait_for_readers(idx ^ RCU_PERCPU_IDX);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_FLIP);
+
+	/*
+	 * Finish waiting for reader threads before letting the old ptr being
+	 * freed.
+	 */
+	smp_mb_master();
+
+	rcu_gp_stats_end(&rcu_gp_stats, &clock);
+	rcu_gp_seq_end();
+	mutex_unlock(&rcu_gp_lock);
+}
+
+void rcu_gp_get_stats(struct rcu_gp_stats *stats)
+{
+	rcu_gp_stats_read(stats, &rcu_gp_stats);
+}
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+void rcu_read_lock(void)
+{
+	_rcu_read_lock();
+}
+
+void rcu_read_unlock(void)
+{
+	_rcu_read_unlock();
+}
+
+int rcu_read_ongoing(void)
+{
+	return _rcu_read_ongoing();
+}
+
+#ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+static
+void rcu_sys_membarrier_status(bool available)
+{
+	if (!available)
+		abort();
+}
+#else
+static
+void rcu_sys_membarrier_status(bool available)
+{
+	if (!available)
+		return;
+	urcu_percpu_has_sys_membarrier = 1;
+}
+#endif
+
+static
+void rcu_sys_membarrier_init(void)
+{
+	bool available = false;
+	int mask;
+
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (mask >= 0) {
+		if (mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED) {
+			if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0))
+				urcu_die(errno);
+			available = true;
+		}
+	}
+	rcu_sys_membarrier_status(available);
+}
+
+/*
+ * Allocate the counters. Called by the first reader or updater, rather
+ * than by a library constructor: processes linking the library without
+ * using it do not allocate them, nor probe sys_membarrier().
+ */
+void rcu_percpu_init(void)
+{
+	mutex_lock(&init_lock);
+	if (!rcu_gp.count) {
+		struct rcu_percpu_count *count;
+		unsigned long nr = 1;
+		long nr_cpus;
+
+		nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+		while ((long) nr < nr_cpus)
+			nr <<= 1;
+		if (urcu_posix_memalign((void **) &count, CAA_CACHE_LINE_SIZE,
+				2 * nr * sizeof(*count)))
+			urcu_die(ENOMEM);
+		memset(count, 0, 2 * nr * sizeof(*count));
+		rcu_sys_membarrier_init();
+#ifdef _URCU_PERCPU_RSEQ
+		/* glibc registers its rseq area for each thread. */
+		urcu_percpu_has_rseq = __rseq_size > 0;
+#endif
+		rcu_gp.mask = nr - 1;
+		/* Publish the mask and flags before the counters. */
+		cmm_smp_wmb();
+		CMM_STORE_SHARED(rcu_gp.count, count);
+	}
+	mutex_unlock(&init_lock);
+}
+
+/*
+ * Holding the rcu_gp_lock across fork will make sure we fork() don't
+ * race with a concurrent synchronize_rcu(). This ensures that the
+ * counters and data protected by rcu_gp_lock are in a coherent state in
+ * the child.
+ */
+void rcu_percpu_before_fork(void)
+{
+	sigset_t newmask, oldmask;
+	int ret;
+
+	ret = sigfillset(&newmask);
+	assert(!ret);
+	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
+	assert(!ret);
+	mutex_lock(&rcu_gp_lock);
+	saved_fork_signal_mask = oldmask;
+}
+
+void rcu_percpu_after_fork_parent(void)
+{
+	sigset_t oldmask;
+	int ret;
+
+	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&rcu_gp_lock);
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	assert(!ret);
+}
+
+/*
+ * Only our own thread exists in the child: drop the counts of the
+ * critical sections of the other threads, which will never end, and
+ * count again our own, if any. Called with rcu_gp_lock held.
+ */
+void rcu_percpu_after_fork_child(void)
+{
+	unsigned long tmp = URCU_TLS(rcu_reader).ctr;
+	sigset_t oldmask;
+	int ret;
+
+	if (rcu_gp.count) {
+		memset(rcu_gp.count, 0,
+			2 * (rcu_gp.mask + 1) * sizeof(*rcu_gp.count));
+		if (tmp >= RCU_PERCPU_COUNT)
+			_rcu_percpu_inc(0, tmp & RCU_PERCPU_IDX);
+	}
+	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&rcu_gp_lock);
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	assert(!ret);
+}
+
+void *rcu_dereference_sym_percpu(void *p)
+{
+	return _rcu_dereference(p);
+}
+
+void *rcu_set_pointer_sym_percpu(void **p, void *v)
+{
+	cmm_wmb();
+	uatomic_set(p, v);
+	return v;
+}
+
+void *rcu_xchg_pointer_sym_percpu(void **p, void *v)
+{
+	cmm_wmb();
+	return uatomic_xchg(p, v);
+}
+
+void *rcu_cmpxchg_pointer_sym_percpu(void **p, void *old, void *_new)
+{
+	cmm_wmb();
+	return uatomic_cmpxchg(p, old, _new);
+}
+
+DEFINE_RCU_FLAVOR(rcu_flavor);
+
+#include "urcu-call-rcu-impl.h"
+#include "urcu-defer-impl.h"
+
+#define RCU_STATS_PREFIX	"urcu.percpu"
+#include "urcu-stats-impl.h"
@@ -0,0 +1,204 @@
+#ifndef _URCU_PERCPU_H
+#define _URCU_PERCPU_H
+
+/*
+ * urcu-percpu.h
+ *
+ * Userspace RCU header, per-CPU read-side counters version.
+ *
+ * Readers update per-CPU lock and unlock counters, with restartable
+ * sequences when available, instead of per-thread state: does not
+ * require thread registration nor unregistration, and grace periods
+ * scan the counters of each CPU instead of each reader thread. Also
+ * signal-safe.
+ *
+ * LGPL-compatible code should include this header with :
+ *
+ * #define _LGPL_SOURCE
+ * #include <urcu.h>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <urcu/map/urcu-percpu.h>
+
+/*
+ * See urcu-pointer.h and urcu/static/urcu-pointer.h for pointer
+ * publication headers.
+ */
+#include <urcu-pointer.h>
+#include <urcu/gp-stats.h>
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/urcu-percpu.h>
+
+/*
+ * Mappings for static use of the userspace RCU library.
+ * Should only be used in LGPL-compatible code.
+ */
+
+/*
+ * rcu_read_lock()
+ * rcu_read_unlock()
+ *
+ * Mark the beginning and end of a read-side critical section.
+ */
+#define rcu_read_lock_percpu			_rcu_read_lock
+#define rcu_read_unlock_percpu			_rcu_read_unlock
+#define rcu_read_ongoing_percpu			_rcu_read_ongoing
+
+#define rcu_dereference_percpu			rcu_dereference
+#define rcu_cmpxchg_pointer_percpu		rcu_cmpxchg_pointer
+#define rcu_xchg_pointer_percpu			rcu_xchg_pointer
+#define rcu_set_pointer_percpu			rcu_set_pointer
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ * See LGPL-only urcu/static/urcu-pointer.h for documentation.
+ */
+
+extern void rcu_read_lock(void);
+extern void rcu_read_unlock(void);
+extern int rcu_read_ongoing(void);
+
+extern void *rcu_dereference_sym_percpu(void *p);
+#define rcu_dereference_percpu(p)						     \
+	__extension__							     \
+	({								     \
+		__typeof__(p) _________p1 = URCU_FORCE_CAST(__typeof__(p),   \
+			rcu_dereference_sym_percpu(URCU_FORCE_CAST(void *, p))); \
+		(_________p1);						     \
+	})
+
+extern void *rcu_cmpxchg_pointer_sym_percpu(void **p, void *old, void *_new);
+#define rcu_cmpxchg_pointer_percpu(p, old, _new)				     \
+	__extension__							     \
+	({								     \
+		__typeof__(*(p)) _________pold = (old);			     \
+		__typeof__(*(p)) _________pnew = (_new);		     \
+		__typeof__(*(p)) _________p1 = URCU_FORCE_CAST(__typeof__(*(p)), \
+			rcu_cmpxchg_pointer_sym_percpu(URCU_FORCE_CAST(void **, p), \
+						_________pold,		     \
+						_________pnew));	     \
+		(_________p1);						     \
+	})
+
+extern void *rcu_xchg_pointer_sym_percpu(void **p, void *v);
+#define rcu_xchg_pointer_percpu(p, v)					     \
+	__extension__							     \
+	({								     \
+		__typeof__(*(p)) _________pv = (v);			     \
+		__typeof__(*(p)) _________p1 = URCU_FORCE_CAST(__typeof__(*(p)),\
+			rcu_xchg_pointer_sym_percpu(URCU_FORCE_CAST(void **, p), \
+					     _________pv));		     \
+		(_________p1);						     \
+	})
+
+extern void *rcu_set_pointer_sym_percpu(void **p, void *v);
+#define rcu_set_pointer_percpu(p, v)					     \
+	__extension__							     \
+	({								     \
+		__typeof__(*(p)) _________pv = (v);			     \
+		__typeof__(*(p)) _________p1 = URCU_FORCE_CAST(__typeof__(*(p)), \
+			rcu_set_pointer_sym_percpu(URCU_FORCE_CAST(void **, p),  \
+					    _________pv));		     \
+		(_________p1);						     \
+	})
+
+#endif /* !_LGPL_SOURCE */
+
+extern void synchronize_rcu(void);
+
+/*
+ * Polling grace-period API: a cookie taken before removing data can be
+ * polled to know whether the data can be freed without waiting.
+ */
+extern unsigned long get_state_synchronize_rcu(void);
+extern unsigned long start_poll_synchronize_rcu(void);
+extern int poll_state_synchronize_rcu(unsigned long cookie);
+extern void cond_synchronize_rcu(unsigned long cookie);
+
+/*
+ * Cumulative statistics of the grace periods, see urcu/gp-stats.h.
+ */
+extern void rcu_gp_get_stats(struct rcu_gp_stats *stats);
+
+/*
+ * Statistics of the flavor, its call_rcu and defer_rcu queues, as
+ * "key value" lines. See rcu-api.md.
+ */
+extern size_t rcu_stats_snapshot(char *buf, size_t len);
+extern int rcu_stats_dump(int fd);
+extern int rcu_stats_dump_periodic(int fd, unsigned int period_ms);
+
+/*
+ * rcu_percpu_before_fork, rcu_percpu_after_fork_parent and
+ * rcu_percpu_after_fork_child should be called around fork() system calls
+ * when the child process is not expected to immediately perform an exec().
+ * For pthread users, see pthread_atfork(3).
+ */
+extern void rcu_percpu_before_fork(void);
+extern void rcu_percpu_after_fork_parent(void);
+extern void rcu_percpu_after_fork_child(void);
+
+/*
+ * In the per-CPU counters version, the following functions are no-ops.
+ */
+static inline void rcu_register_thread(void)
+{
+}
+
+static inline void rcu_unregister_thread(void)
+{
+}
+
+static inline void rcu_init(void)
+{
+}
+
+/*
+ * Q.S. reporting are no-ops for these URCU flavors.
+ */
+static inline void rcu_quiescent_state(void)
+{
+}
+
+static inline void rcu_thread_offline(void)
+{
+}
+
+static inline void rcu_thread_online(void)
+{
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <urcu-call-rcu.h>
+#include <urcu-defer.h>
+#include <urcu-flavor.h>
+
+#endif /* _URCU_PERCPU_H */
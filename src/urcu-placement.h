@@ -0,0 +1,360 @@
+#ifndef _URCU_PLACEMENT_H
+#define _URCU_PLACEMENT_H
+
+/*
+ * urcu-placement.h
+ *
+ * Userspace RCU library - CPU and scheduling placement of worker threads
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include "compat-getcpu.h"
+#include "urcu-call-rcu.h"
+#include "urcu-die.h"
+
+/*
+ * A struct call_rcu_placement is resolved by the caller to a set of
+ * CPUs, published in a struct urcu_placement_shared. Each worker thread
+ * applies it from its own loop with urcu_placement_check(): when it
+ * changed, and periodically afterwards, to retry setting the CPU
+ * affinity if the worker migrated, which can be caused by CPU
+ * hotunplug/hotplug, or by cpuset(7). Workers read the placement
+ * without lock, retrying while it is updated.
+ */
+#define URCU_PLACEMENT_CHECK_PERIOD_MASK	((1U << 8) - 1)
+
+#define URCU_PLACEMENT_NODE_PATH	"/sys/devices/system/node"
+
+struct urcu_placement {
+	/*
+	 * CPU affinity of the worker if use_affinity, otherwise cpuset if
+	 * pinned, otherwise none.
+	 */
+	int use_affinity;
+	int pinned;
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t cpuset;
+#endif
+	unsigned int flags;	/* CALL_RCU_PLACE_SCHED, CALL_RCU_PLACE_NICE */
+	int sched_policy, sched_priority;
+	int nice;
+};
+
+struct urcu_placement_shared {
+	pthread_mutex_t lock;	/* Serializes updates. */
+	unsigned long seq;	/* Odd while updated. */
+	struct urcu_placement p;
+};
+
+/* Placement applied by a worker thread, zeroed when it starts. */
+struct urcu_placement_thread {
+	unsigned long seq;
+	unsigned long loop_count;
+	struct urcu_placement p;
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t initial;	/* Affinity inherited by the thread. */
+#endif
+};
+
+/* Workers keep the cpu_affinity they were created with. */
+static inline void urcu_placement_init(struct urcu_placement_shared *s)
+{
+	memset(s, 0, sizeof(*s));
+	pthread_mutex_init(&s->lock, NULL);
+	s->seq = 2;
+	s->p.use_affinity = 1;
+}
+
+static inline void urcu_placement_destroy(struct urcu_placement_shared *s)
+{
+	(void) pthread_mutex_destroy(&s->lock);
+}
+
+#if HAVE_SCHED_SETAFFINITY
+/* Add the CPUs of a cpulist, e.g. "0-3,8", to @set. */
+static inline int urcu_placement_parse_cpulist(const char *list,
+		cpu_set_t *set)
+{
+	unsigned long first, last;
+	char *end;
+
+	while (*list && *list != '\n') {
+		first = strtoul(list, &end, 10);
+		if (end == list)
+			return -EINVAL;
+		last = first;
+		if (*end == '-') {
+			list = end + 1;
+			last = strtoul(list, &end, 10);
+			if (end == list || last < first)
+				return -EINVAL;
+		}
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+		list = end;
+		if (*list == ',')
+			list++;
+	}
+	return 0;
+}
+
+/*
+ * CPUs of NUMA node @node. Without NUMA nodes, node 0 has all the CPUs,
+ * and leaves the worker unpinned.
+ */
+static inline int urcu_placement_node(struct urcu_placement *p, int node)
+{
+	char path[64], buf[4096];
+	FILE *fp;
+	int ret;
+
+	if (node < 0)
+		return -EINVAL;
+	(void) snprintf(path, sizeof(path),
+			URCU_PLACEMENT_NODE_PATH "/node%d/cpulist", node);
+	fp = fopen(path, "r");
+	if (!fp) {
+		if (!node && access(URCU_PLACEMENT_NODE_PATH, F_OK))
+			return 0;
+		return -EINVAL;
+	}
+	if (!fgets(buf, sizeof(buf), fp))
+		buf[0] = '\0';
+	fclose(fp);
+	CPU_ZERO(&p->cpuset);
+	ret = urcu_placement_parse_cpulist(buf, &p->cpuset);
+	if (ret)
+		return ret;
+	/* Node without CPUs, e.g. memory only. */
+	if (!CPU_COUNT(&p->cpuset))
+		return -EINVAL;
+	p->pinned = 1;
+	return 0;
+}
+
+/* Online NUMA nodes, node 0 only without NUMA nodes. */
+static inline void urcu_placement_online_nodes(cpu_set_t *nodes)
+{
+	char buf[4096];
+	FILE *fp;
+
+	CPU_ZERO(nodes);
+	fp = fopen(URCU_PLACEMENT_NODE_PATH "/online", "r");
+	if (fp) {
+		if (!fgets(buf, sizeof(buf), fp))
+			buf[0] = '\0';
+		fclose(fp);
+		(void) urcu_placement_parse_cpulist(buf, nodes);
+	}
+	if (!CPU_COUNT(nodes))
+		CPU_SET(0, nodes);
+}
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+/* NUMA node of the CPU the caller runs on, 0 without NUMA nodes. */
+static inline int urcu_placement_caller_node(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned int cpu, node;
+
+	if (!syscall(SYS_getcpu, &cpu, &node, NULL))
+		return (int) node;
+#endif
+	return 0;
+}
+
+/* Resolve @attr to @p. Returns 0, or a negative error number. */
+static inline int urcu_placement_resolve(struct urcu_placement *p,
+		const struct call_rcu_placement *attr)
+{
+	memset(p, 0, sizeof(*p));
+	if (attr->flags & ~(CALL_RCU_PLACE_SCHED | CALL_RCU_PLACE_NICE))
+		return -EINVAL;
+	if ((attr->flags & CALL_RCU_PLACE_NICE)
+			&& (attr->nice < -20 || attr->nice > 19))
+		return -EINVAL;
+	p->flags = attr->flags;
+	p->sched_policy = attr->sched_policy;
+	p->sched_priority = attr->sched_priority;
+	p->nice = attr->nice;
+	switch (attr->policy) {
+	case CALL_RCU_PLACE_CPU_AFFINITY:
+		p->use_affinity = 1;
+		return 0;
+#if HAVE_SCHED_SETAFFINITY
+	case CALL_RCU_PLACE_CPUSET:
+		if (!attr->cpuset)
+			return -EINVAL;
+		CPU_ZERO(&p->cpuset);
+		memcpy(&p->cpuset, attr->cpuset,
+			caa_min(attr->cpuset_size, sizeof(p->cpuset)));
+		if (!CPU_COUNT(&p->cpuset))
+			return -EINVAL;
+		p->pinned = 1;
+		return 0;
+	case CALL_RCU_PLACE_NODE:
+		return urcu_placement_node(p, attr->node);
+	case CALL_RCU_PLACE_CALLER_NODE:
+		return urcu_placement_node(p, urcu_placement_caller_node());
+#else
+	case CALL_RCU_PLACE_CPUSET:
+	case CALL_RCU_PLACE_NODE:
+	case CALL_RCU_PLACE_CALLER_NODE:
+		return -ENOSYS;
+#endif
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Set the scheduling policy of thread @tid, so that the caller gets the
+ * error, e.g. -EPERM for SCHED_FIFO without privileges.
+ */
+static inline int urcu_placement_set_sched(const struct urcu_placement *p,
+		pthread_t tid)
+{
+	struct sched_param param;
+
+	if (!(p->flags & CALL_RCU_PLACE_SCHED))
+		return 0;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = p->sched_priority;
+	return -pthread_setschedparam(tid, p->sched_policy, &param);
+}
+
+/* Publish @p to the workers, which apply it on their next check. */
+static inline void urcu_placement_update(struct urcu_placement_shared *s,
+		const struct urcu_placement *p)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(&s->lock);
+	if (ret)
+		urcu_die(ret);
+	CMM_STORE_SHARED(s->seq, s->seq + 1);
+	cmm_smp_wmb();
+	s->p = *p;
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(s->seq, s->seq + 1);
+	ret = pthread_mutex_unlock(&s->lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+/* Scheduling policy and nice value, best effort. */
+static inline void urcu_placement_apply_sched(const struct urcu_placement *p)
+{
+	if (p->flags & CALL_RCU_PLACE_SCHED)
+		(void) urcu_placement_set_sched(p, pthread_self());
+	if (p->flags & CALL_RCU_PLACE_NICE) {
+		/* The nice value of Linux threads is their own. */
+#if defined(__linux__) && defined(SYS_gettid)
+		(void) setpriority(PRIO_PROCESS, syscall(SYS_gettid), p->nice);
+#else
+		(void) setpriority(PRIO_PROCESS, 0, p->nice);
+#endif
+	}
+}
+
+/*
+ * Called by worker threads in their loop, @cpu_affinity being the CPU
+ * the worker was created for, or -1. Unpinned workers get back the
+ * affinity they started with. Returns 0, or -1 with errno set.
+ */
+static inline int urcu_placement_check(struct urcu_placement_shared *s,
+		struct urcu_placement_thread *t, int cpu_affinity)
+{
+	unsigned long seq;
+	int changed = 0;
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int ret, cpu;
+#endif
+
+	seq = CMM_LOAD_SHARED(s->seq);
+	if (caa_unlikely(seq != t->seq)) {
+#if HAVE_SCHED_SETAFFINITY
+#if SCHED_SETAFFINITY_ARGS == 2
+		if (!t->seq && sched_getaffinity(0, &t->initial))
+#else
+		if (!t->seq && sched_getaffinity(0, sizeof(t->initial),
+				&t->initial))
+#endif
+			return -1;
+#endif
+		do {
+			seq = CMM_LOAD_SHARED(s->seq);
+			cmm_smp_rmb();
+			t->p = s->p;
+			cmm_smp_rmb();
+		} while ((seq & 1) || CMM_LOAD_SHARED(s->seq) != seq);
+		t->seq = seq;
+		urcu_placement_apply_sched(&t->p);
+		changed = 1;
+	}
+#if HAVE_SCHED_SETAFFINITY
+	if (t->p.use_affinity && cpu_affinity >= 0) {
+		CPU_ZERO(&mask);
+		CPU_SET(cpu_affinity, &mask);
+	} else if (t->p.pinned) {
+		mask = t->p.cpuset;
+	} else {
+		if (!changed)
+			return 0;
+		mask = t->initial;
+	}
+	if (!changed) {
+		if (++t->loop_count & URCU_PLACEMENT_CHECK_PERIOD_MASK)
+			return 0;
+		cpu = urcu_sched_getcpu();
+		if (cpu >= 0 && CPU_ISSET(cpu, &mask))
+			return 0;
+	}
+#if SCHED_SETAFFINITY_ARGS == 2
+	ret = sched_setaffinity(0, &mask);
+#else
+	ret = sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+	/*
+	 * EINVAL is fine: can be caused by hotunplugged CPUs, or by
+	 * cpuset(7). This is why we should always retry if we detect
+	 * migration.
+	 */
+	if (ret && errno == EINVAL) {
+		ret = 0;
+		errno = 0;
+	}
+	return ret;
+#else
+	return 0;
+#endif
+}
+
+#endif /* _URCU_PLACEMENT_H */
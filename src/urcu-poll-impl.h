@@ -0,0 +1,157 @@
+#ifndef _URCU_POLL_IMPL_H
+#define _URCU_POLL_IMPL_H
+
+/*
+ * urcu-poll-impl.h
+ *
+ * Userspace RCU library - polling grace-period API
+ *
+ * TO BE INCLUDED ONLY FROM URCU LIBRARY CODE, before synchronize_rcu().
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <urcu/uatomic.h>
+
+/*
+ * Grace-period sequence, incremented at the start and at the end of
+ * each grace period: odd while a grace period is in progress. Written
+ * with rcu_gp_lock held.
+ */
+static unsigned long rcu_gp_seq;
+
+/* Pending start_poll_synchronize_rcu() grace period. */
+static struct rcu_head rcu_gp_poll_head;
+static int rcu_gp_poll_pending;
+static unsigned long rcu_gp_poll_cookie;
+
+/*
+ * Latest cookie of the synchronize_rcu() callers queued on gp_waiters,
+ * for the flavors batching them.
+ */
+static unsigned long rcu_gp_seq_wanted;
+
+static void rcu_gp_seq_start(void)
+{
+	CMM_STORE_SHARED(rcu_gp_seq, rcu_gp_seq + 1);
+	/* Publish grace period start before waiting for readers. */
+	cmm_smp_mb();
+}
+
+static void rcu_gp_seq_end(void)
+{
+	/* Wait for readers before publishing grace period end. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(rcu_gp_seq, rcu_gp_seq + 1);
+}
+
+/*
+ * Return a cookie for poll_state_synchronize_rcu(): the sequence
+ * number at which a full grace period started after this call has
+ * completed.
+ */
+unsigned long get_state_synchronize_rcu(void)
+{
+	/* Order prior updates before reading the sequence. */
+	cmm_smp_mb();
+	return (CMM_LOAD_SHARED(rcu_gp_seq) + 3) & ~1UL;
+}
+
+/*
+ * Return non-zero if a full grace period has elapsed since @cookie was
+ * obtained. Following memory accesses are ordered after that grace
+ * period.
+ */
+int poll_state_synchronize_rcu(unsigned long cookie)
+{
+	if ((long) (CMM_LOAD_SHARED(rcu_gp_seq) - cookie) < 0)
+		return 0;
+	/* Order following frees after the grace period. */
+	cmm_smp_mb();
+	return 1;
+}
+
+/*
+ * Wait for a grace period only if none has elapsed since @cookie was
+ * obtained.
+ */
+void cond_synchronize_rcu(unsigned long cookie)
+{
+	if (!poll_state_synchronize_rcu(cookie))
+		synchronize_rcu();
+}
+
+/* Raise *@p to @cookie, unless it is already past it. */
+static void rcu_gp_seq_max(unsigned long *p, unsigned long cookie)
+{
+	unsigned long old, prev;
+
+	old = uatomic_read(p);
+	while ((long) (cookie - old) > 0) {
+		prev = uatomic_cmpxchg(p, old, cookie);
+		if (prev == old)
+			break;
+		old = prev;
+	}
+}
+
+/*
+ * Record the grace period wanted by a synchronize_rcu() caller, before
+ * it is queued on gp_waiters.
+ */
+static inline void rcu_gp_seq_want(void)
+{
+	rcu_gp_seq_max(&rcu_gp_seq_wanted, get_state_synchronize_rcu());
+}
+
+/*
+ * Called with rcu_gp_lock held, after moving the waiters: return
+ * non-zero if a grace period started after all of them were queued has
+ * already completed, e.g. an expedited one, so that none is needed.
+ */
+static inline int rcu_gp_seq_wanted_done(void)
+{
+	return poll_state_synchronize_rcu(uatomic_read(&rcu_gp_seq_wanted));
+}
+
+static void rcu_gp_poll_func(struct rcu_head *head)
+{
+	uatomic_set(&rcu_gp_poll_pending, 0);
+	/* Clear pending before reading the requested cookie. */
+	cmm_smp_mb();
+	if (!poll_state_synchronize_rcu(uatomic_read(&rcu_gp_poll_cookie))
+	    && !uatomic_xchg(&rcu_gp_poll_pending, 1))
+		call_rcu_expedited(&rcu_gp_poll_head, rcu_gp_poll_func);
+}
+
+/*
+ * Same as get_state_synchronize_rcu(), and make sure a grace period
+ * satisfying the cookie is started by a call_rcu thread, without
+ * waiting for it. At most one request is queued at any time. Should be
+ * called from registered RCU read-side threads; for the QSBR flavor,
+ * the caller should be online.
+ */
+unsigned long start_poll_synchronize_rcu(void)
+{
+	unsigned long cookie;
+
+	cookie = get_state_synchronize_rcu();
+	rcu_gp_seq_max(&rcu_gp_poll_cookie, cookie);
+	if (!uatomic_xchg(&rcu_gp_poll_pending, 1))
+		call_rcu_expedited(&rcu_gp_poll_head, rcu_gp_poll_func);
+	return cookie;
+}
+
+#endif /* _URCU_POLL_IMPL_H */
@@ -33,6 +33,10 @@
 #include <string.h>
 #include <errno.h>
 #include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #include "urcu/wfcqueue.h"
 #include "urcu/map/urcu-qsbr.h"
@@ -43,12 +47,32 @@
 
 #include "urcu-die.h"
 #include "urcu-wait.h"
+#include "urcu-registry.h"
+#include "urcu-spin.h"
+#include "urcu-gp-stats.h"
+#include "urcu-stall.h"
+#include "urcu-stats.h"
 
 /* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
 #undef _LGPL_SOURCE
 #include "urcu-qsbr.h"
 #define _LGPL_SOURCE
 
+#include "urcu-poll-impl.h"
+
+/* If the headers do not support membarrier system call, fall back smp_mb. */
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY				= 0,
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
+};
+
 void __attribute__((destructor)) rcu_exit(void);
 
 /*
@@ -56,22 +80,16 @@ void __attribute__((destructor)) rcu_exit(void);
  * synchronize_rcu().
  */
 static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
-/*
- * rcu_registry_lock ensures mutual exclusion between threads
- * registering and unregistering themselves to/from the registry, and
- * with threads reading that registry from synchronize_rcu(). However,
- * this lock is not held all the way through the completion of awaiting
- * for the grace period. It is sporadically released between iterations
- * on the registry.
- * rcu_registry_lock may nest inside rcu_gp_lock.
- */
-static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
 struct rcu_gp rcu_gp = { .ctr = RCU_GP_ONLINE };
 
 /*
- * Active attempts to check for reader Q.S. before calling futex().
+ * Active attempts to check for reader Q.S. before calling futex(),
+ * protected by rcu_gp_lock.
  */
-#define RCU_QS_ACTIVE_ATTEMPTS 100
+static struct rcu_spin_budget rcu_gp_budget = RCU_SPIN_BUDGET_INIT;
+
+/* Statistics of the grace periods, see urcu-gp-stats.h. */
+static struct rcu_gp_stats rcu_gp_stats;
 
 /*
  * Written to only by each individual reader. Read by both the reader and the
@@ -79,7 +97,18 @@ struct rcu_gp rcu_gp = { .ctr = RCU_GP_ONLINE };
  */
 DEFINE_URCU_TLS(struct rcu_reader, rcu_reader);
 
-static CDS_LIST_HEAD(registry);
+/* Only set by rcu_use_sys_membarrier(), before readers register. */
+int urcu_qsbr_has_sys_membarrier;
+
+/*
+ * Each shard lock ensures mutual exclusion between threads registering
+ * and unregistering themselves to/from the shard, and with
+ * synchronize_rcu() scanning the shard. However, shard locks are not
+ * held all the way through the completion of awaiting for the grace
+ * period. They are released between iterations on the registry.
+ * Shard locks may nest inside rcu_gp_lock.
+ */
+static DEFINE_RCU_REGISTRY(registry);
 
 /*
  * Queue keeping threads awaiting to wait for a grace period. Contains
@@ -87,6 +116,18 @@ static CDS_LIST_HEAD(registry);
  */
 static DEFINE_URCU_WAIT_QUEUE(gp_waiters);
 
+/*
+ * Grace-period combining tree: one node per registry shard under a
+ * root. Enabled by rcu_use_gp_tree(), protected by rcu_gp_lock.
+ */
+static int rcu_gp_tree;
+static struct rcu_gp_node rcu_gp_tree_root;
+static struct rcu_gp_node rcu_gp_tree_nodes[RCU_REGISTRY_NR_SHARDS] = {
+	[0 ... RCU_REGISTRY_NR_SHARDS - 1] = {
+		.parent = &rcu_gp_tree_root,
+	},
+};
+
 static void mutex_lock(pthread_mutex_t *mutex)
 {
 	int ret;
@@ -114,19 +155,36 @@ static void mutex_unlock(pthread_mutex_t *mutex)
 }
 
 /*
- * synchronize_rcu() waiting. Single thread.
+ * Memory barrier on the updater, and on the readers when they rely on
+ * sys_membarrier().
  */
-static void wait_gp(void)
+static void smp_mb_master(void)
+{
+	if (urcu_qsbr_has_sys_membarrier) {
+		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
+			urcu_die(errno);
+		uatomic_inc(&rcu_gp_stats.membarriers);
+	} else {
+		cmm_smp_mb();
+	}
+}
+
+/*
+ * synchronize_rcu() waiting. Single thread. Returns after @timeout,
+ * unless NULL, to report stalled readers.
+ */
+static void wait_gp(const struct timespec *timeout)
 {
 	/* Read reader_gp before read futex */
 	cmm_smp_rmb();
 	if (uatomic_read(&rcu_gp.futex) != -1)
 		return;
 	while (futex_noasync(&rcu_gp.futex, FUTEX_WAIT, -1,
-			NULL, NULL, 0)) {
+			timeout, NULL, 0)) {
 		switch (errno) {
 		case EWOULDBLOCK:
-			/* Value already changed. */
+		case ETIMEDOUT:
+			/* Value already changed, or stall report. */
 			return;
 		case EINTR:
 			/* Retry if interrupted by signal. */
@@ -138,73 +196,144 @@ static void wait_gp(void)
 	}
 }
 
+static int registry_list_empty(enum rcu_registry_list list)
+{
+	unsigned int i;
+	int empty = 1;
+
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS && empty; i++) {
+		mutex_lock(&registry[i].lock);
+		empty = !rcu_registry_shard_has(&registry[i], list);
+		mutex_unlock(&registry[i].lock);
+	}
+	return empty;
+}
+
+/* Put quiescent readers back into the registry. */
+static void registry_splice_qs(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		mutex_lock(&registry[i].lock);
+		rcu_registry_shard_reset(&registry[i]);
+		mutex_unlock(&registry[i].lock);
+	}
+}
+
 /*
- * Always called with rcu_registry lock held. Releases this lock between
- * iterations and grabs it again. Holds the lock when it returns.
+ * Move the readers in the @input state of each shard to the
+ * REGISTRY_CUR_SNAP state if @cur_snap and they observe the current
+ * rcu_gp.ctr, or to the REGISTRY_QS state once quiescent. Each shard
+ * lock is only held while scanning the shard, and the shards emptied
+ * are not scanned again. Spin up to the attempts of rcu_gp_budget
+ * before waiting on the futex, and adapt it to the duration of the wait.
  */
-static void wait_for_readers(struct cds_list_head *input_readers,
-			struct cds_list_head *cur_snap_readers,
-			struct cds_list_head *qsreaders)
+static void wait_for_readers(enum rcu_registry_list input, int cur_snap)
 {
-	unsigned int wait_loops = 0;
-	struct rcu_reader *index, *tmp;
+	unsigned int wait_loops = 0, sleeps = 0, scans = 0;
+	unsigned int budget = rcu_gp_budget.budget;
+	unsigned long pending = RCU_REGISTRY_ALL_SHARDS;
+	struct rcu_reader *index;
+	struct rcu_stall stall;
+	struct timespec stall_ts;
+	uint64_t start_ns;
+	unsigned long j;
+	unsigned int i;
+	int left, slow_skip = 0;
 
+	start_ns = urcu_time_ns();
+	rcu_stall_begin(&stall, start_ns);
 	/*
 	 * Wait for each thread URCU_TLS(rcu_reader).ctr to either
 	 * indicate quiescence (offline), or for them to observe the
 	 * current rcu_gp.ctr value.
 	 */
 	for (;;) {
-		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
+		int slow = 0;
+
+		scans++;
+		rcu_stall_scan(&stall);
+		if (wait_loops < budget)
 			wait_loops++;
-		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+		if (wait_loops >= budget) {
+			sleeps++;
 			uatomic_set(&rcu_gp.futex, -1);
 			/*
 			 * Write futex before write waiting (the other side
 			 * reads them in the opposite order).
 			 */
 			cmm_smp_wmb();
-			cds_list_for_each_entry(index, input_readers, node) {
-				_CMM_STORE_SHARED(index->waiting, 1);
+			for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+				if (!(pending & (1UL << i)))
+					continue;
+				struct rcu_registry_shard *shard = &registry[i];
+
+				mutex_lock(&shard->lock);
+				rcu_registry_for_each(shard, j, input)
+					_CMM_STORE_SHARED(shard->readers[j]->waiting, 1);
+				mutex_unlock(&shard->lock);
 			}
 			/* Write futex before read reader_gp */
-			cmm_smp_mb();
+			smp_mb_master();
 		}
-		cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
-			switch (rcu_reader_state(&index->ctr)) {
-			case RCU_READER_ACTIVE_CURRENT:
-				if (cur_snap_readers) {
-					cds_list_move(&index->node,
-						cur_snap_readers);
+		for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+			struct rcu_registry_shard *shard = &registry[i];
+
+			if (!(pending & (1UL << i)))
+				continue;
+			mutex_lock(&shard->lock);
+			left = 0;
+			rcu_registry_for_each(shard, j, input) {
+				index = shard->readers[j];
+				switch (rcu_reader_state(&index->ctr)) {
+				case RCU_READER_ACTIVE_CURRENT:
+					if (cur_snap) {
+						shard->state[j] = REGISTRY_CUR_SNAP;
+						rcu_spin_reader_done(&index->gp_slow,
+							sleeps);
+						break;
+					}
+					/* Fall-through */
+				case RCU_READER_INACTIVE:
+					shard->state[j] = REGISTRY_QS;
+					rcu_spin_reader_done(&index->gp_slow,
+						sleeps);
+					break;
+				case RCU_READER_ACTIVE_OLD:
+					/*
+					 * Old snapshot. Leaving reader in
+					 * input state will make us busy-loop
+					 * until the snapshot becomes current
+					 * or the reader becomes inactive.
+					 */
+					left = 1;
+					if (rcu_spin_reader_old(&index->gp_slow,
+							sleeps))
+						slow = 1;
+					rcu_stall_reader(&stall, index->tid);
 					break;
 				}
-				/* Fall-through */
-			case RCU_READER_INACTIVE:
-				cds_list_move(&index->node, qsreaders);
-				break;
-			case RCU_READER_ACTIVE_OLD:
-				/*
-				 * Old snapshot. Leaving node in
-				 * input_readers will make us busy-loop
-				 * until the snapshot becomes current or
-				 * the reader becomes inactive.
-				 */
-				break;
 			}
+			if (!left)
+				pending &= ~(1UL << i);
+			mutex_unlock(&shard->lock);
 		}
 
-		if (cds_list_empty(input_readers)) {
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+		if (!pending) {
+			if (sleeps) {
 				/* Read reader_gp before write futex */
-				cmm_smp_mb();
+				smp_mb_master();
 				uatomic_set(&rcu_gp.futex, 0);
 			}
 			break;
+		} else if (slow && wait_loops < budget) {
+			/* Do not spin for readers known to be slow. */
+			wait_loops = budget;
+			slow_skip = 1;
 		} else {
-			/* Temporarily unlock the registry lock. */
-			mutex_unlock(&rcu_registry_lock);
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
-				wait_gp();
+			if (sleeps) {
+				wait_gp(rcu_stall_timeout(&stall, &stall_ts));
 			} else {
 #ifndef HAS_INCOHERENT_CACHES
 				caa_cpu_relax();
@@ -212,11 +341,138 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 				cmm_smp_mb();
 #endif /* #else #ifndef HAS_INCOHERENT_CACHES */
 			}
-			/* Re-lock the registry lock before the next loop. */
-			mutex_lock(&rcu_registry_lock);
 		}
 	}
+	if (!slow_skip)
+		rcu_spin_budget_update(&rcu_gp_budget, wait_loops, sleeps,
+			urcu_time_ns() - start_ns);
+	rcu_gp_stats_wait(&rcu_gp_stats, scans - sleeps, sleeps);
+}
+
+#if (CAA_BITS_PER_LONG >= 64)
+/*
+ * Flag the readers of each shard for a report to its node, then report
+ * for them those already quiescent or observing the current rcu_gp.ctr.
+ * Returns the root reports left to wait for.
+ */
+static long gp_tree_flag_readers(void)
+{
+	struct rcu_registry_shard *shard;
+	struct rcu_reader *index;
+	unsigned long j, nr;
+	unsigned int i;
+
+	/* Biased until all the nodes are flagged. */
+	uatomic_set(&rcu_gp_tree_root.pending, 1);
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		shard = &registry[i];
+		mutex_lock(&shard->lock);
+		nr = 0;
+		rcu_registry_for_each(shard, j, REGISTRY_READERS)
+			nr++;
+		if (nr) {
+			uatomic_inc(&rcu_gp_tree_root.pending);
+			/* Biased until its quiescent readers are reported. */
+			uatomic_set(&rcu_gp_tree_nodes[i].pending, nr + 1);
+			/* Write pending count before write flags. */
+			cmm_smp_wmb();
+			rcu_registry_for_each(shard, j, REGISTRY_READERS)
+				_CMM_STORE_SHARED(shard->readers[j]->gp_need, 1);
+		}
+		mutex_unlock(&shard->lock);
+	}
+	/*
+	 * Write flags before read reader ctr (the readers write their
+	 * ctr before reading their flag).
+	 */
+	smp_mb_master();
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		shard = &registry[i];
+		mutex_lock(&shard->lock);
+		nr = 0;
+		rcu_registry_for_each(shard, j, REGISTRY_READERS) {
+			index = shard->readers[j];
+			nr++;
+			if (rcu_reader_state(&index->ctr) == RCU_READER_ACTIVE_OLD)
+				continue;
+			if (uatomic_xchg(&index->gp_need, 0))
+				(void) _rcu_gp_node_report(&rcu_gp_tree_nodes[i]);
+		}
+		if (nr)
+			(void) _rcu_gp_node_report(&rcu_gp_tree_nodes[i]);
+		mutex_unlock(&shard->lock);
+	}
+	return uatomic_sub_return(&rcu_gp_tree_root.pending, 1);
+}
+
+/* Print the readers still flagged by the current grace period. */
+static void gp_tree_stall(struct rcu_stall *stall)
+{
+	struct rcu_registry_shard *shard;
+	unsigned long j;
+	unsigned int i;
+
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		shard = &registry[i];
+		mutex_lock(&shard->lock);
+		rcu_registry_for_each(shard, j, REGISTRY_READERS) {
+			if (uatomic_read(&shard->readers[j]->gp_need))
+				rcu_stall_reader(stall, shard->readers[j]->tid);
+		}
+		mutex_unlock(&shard->lock);
+	}
+}
+
+/*
+ * Wait for the readers to observe the current rcu_gp.ctr or be
+ * quiescent through the combining tree: the updater only polls the
+ * root, spinning up to the attempts of rcu_gp_budget before waiting
+ * on the futex, which the last reader to report wakes.
+ */
+static void wait_for_readers_tree(void)
+{
+	unsigned int wait_loops = 0, sleeps = 0, scans = 0;
+	unsigned int budget = rcu_gp_budget.budget;
+	struct rcu_stall stall;
+	struct timespec stall_ts;
+	uint64_t start_ns;
+
+	start_ns = urcu_time_ns();
+	rcu_stall_begin(&stall, start_ns);
+	if (!gp_tree_flag_readers())
+		goto end;
+	for (;;) {
+		scans++;
+		rcu_stall_scan(&stall);
+		if (caa_unlikely(stall.report))
+			gp_tree_stall(&stall);
+		if (wait_loops < budget) {
+			wait_loops++;
+			if (!uatomic_read(&rcu_gp_tree_root.pending))
+				break;
+#ifndef HAS_INCOHERENT_CACHES
+			caa_cpu_relax();
+#else /* #ifndef HAS_INCOHERENT_CACHES */
+			cmm_smp_mb();
+#endif /* #else #ifndef HAS_INCOHERENT_CACHES */
+			continue;
+		}
+		sleeps++;
+		uatomic_set(&rcu_gp.futex, -1);
+		/* Write futex before read root */
+		smp_mb_master();
+		if (!uatomic_read(&rcu_gp_tree_root.pending)) {
+			uatomic_set(&rcu_gp.futex, 0);
+			break;
+		}
+		wait_gp(rcu_stall_timeout(&stall, &stall_ts));
+	}
+end:
+	rcu_spin_budget_update(&rcu_gp_budget, wait_loops, sleeps,
+		urcu_time_ns() - start_ns);
+	rcu_gp_stats_wait(&rcu_gp_stats, scans - sleeps, sleeps);
 }
+#endif /* #if (CAA_BITS_PER_LONG >= 64) */
 
 /*
  * Using a two-subphases algorithm for architectures with smaller than 64-bit
@@ -226,11 +482,11 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 #if (CAA_BITS_PER_LONG < 64)
 void synchronize_rcu(void)
 {
-	CDS_LIST_HEAD(cur_snap_readers);
-	CDS_LIST_HEAD(qsreaders);
 	unsigned long was_online;
 	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
 	struct urcu_waiters waiters;
+	struct rcu_gp_stats_clock clock;
+	uint64_t lock_ns;
 
 	was_online = rcu_read_ongoing();
 
@@ -252,32 +508,43 @@ void synchronize_rcu(void)
 	 * for a grace period. Proceed to perform the grace period only
 	 * if we are the first thread added into the queue.
 	 */
+	rcu_gp_seq_want();
 	if (urcu_wait_add(&gp_waiters, &wait) != 0) {
 		/* Not first in queue: will be awakened by another thread. */
-		urcu_adaptative_busy_wait(&wait);
+		urcu_wait_queue_busy_wait(&gp_waiters, &wait);
 		goto gp_end;
 	}
 	/* We won't need to wake ourself up */
 	urcu_wait_set_state(&wait, URCU_WAIT_RUNNING);
 
+	lock_ns = urcu_time_ns();
 	mutex_lock(&rcu_gp_lock);
 
 	/*
 	 * Move all waiters into our local queue.
 	 */
 	urcu_move_waiters(&waiters, &gp_waiters);
+	if (rcu_gp_seq_wanted_done()) {
+		rcu_gp_stats_coalesced(&rcu_gp_stats,
+				urcu_waiters_count(&waiters));
+		goto unlock;
+	}
+	rcu_gp_stats_begin(&rcu_gp_stats, &clock, lock_ns,
+			urcu_waiters_count(&waiters));
 
-	mutex_lock(&rcu_registry_lock);
-
-	if (cds_list_empty(&registry))
+	rcu_gp_seq_start();
+	if (registry_list_empty(REGISTRY_READERS))
 		goto out;
 
+	/* Write new ptr before reading the reader counters. */
+	smp_mb_master();
+
 	/*
 	 * Wait for readers to observe original parity or be quiescent.
-	 * wait_for_readers() can release and grab again rcu_registry_lock
-	 * interally.
+	 * wait_for_readers() takes and releases the shard locks.
 	 */
-	wait_for_readers(&registry, &cur_snap_readers, &qsreaders);
+	wait_for_readers(REGISTRY_READERS, 1);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_WAIT);
 
 	/*
 	 * Must finish waiting for quiescent state for original parity
@@ -317,19 +584,27 @@ void synchronize_rcu(void)
 
 	/*
 	 * Wait for readers to observe new parity or be quiescent.
-	 * wait_for_readers() can release and grab again rcu_registry_lock
-	 * interally.
+	 * wait_for_readers() takes and releases the shard locks.
 	 */
-	wait_for_readers(&cur_snap_readers, NULL, &qsreaders);
+	wait_for_readers(REGISTRY_CUR_SNAP, 0);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_FLIP);
 
 	/*
 	 * Put quiescent reader list back into registry.
 	 */
-	cds_list_splice(&qsreaders, &registry);
+	registry_splice_qs();
+
+	/*
+	 * Finish waiting for the critical sections of the readers, which
+	 * may have stored their quiescent state early without barrier.
+	 */
+	smp_mb_master();
 out:
-	mutex_unlock(&rcu_registry_lock);
+	rcu_gp_stats_end(&rcu_gp_stats, &clock);
+	rcu_gp_seq_end();
+unlock:
 	mutex_unlock(&rcu_gp_lock);
-	urcu_wake_all_waiters(&waiters);
+	urcu_wake_all_waiters(&gp_waiters, &waiters);
 gp_end:
 	/*
 	 * Finish waiting for reader threads before letting the old ptr being
@@ -343,10 +618,11 @@ gp_end:
 #else /* !(CAA_BITS_PER_LONG < 64) */
 void synchronize_rcu(void)
 {
-	CDS_LIST_HEAD(qsreaders);
 	unsigned long was_online;
 	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
 	struct urcu_waiters waiters;
+	struct rcu_gp_stats_clock clock;
+	uint64_t lock_ns;
 
 	was_online = rcu_read_ongoing();
 
@@ -365,26 +641,41 @@ void synchronize_rcu(void)
 	 * for a grace period. Proceed to perform the grace period only
 	 * if we are the first thread added into the queue.
 	 */
+	rcu_gp_seq_want();
 	if (urcu_wait_add(&gp_waiters, &wait) != 0) {
 		/* Not first in queue: will be awakened by another thread. */
-		urcu_adaptative_busy_wait(&wait);
+		urcu_wait_queue_busy_wait(&gp_waiters, &wait);
 		goto gp_end;
 	}
 	/* We won't need to wake ourself up */
 	urcu_wait_set_state(&wait, URCU_WAIT_RUNNING);
 
+	lock_ns = urcu_time_ns();
 	mutex_lock(&rcu_gp_lock);
 
 	/*
 	 * Move all waiters into our local queue.
 	 */
 	urcu_move_waiters(&waiters, &gp_waiters);
+	if (rcu_gp_seq_wanted_done()) {
+		rcu_gp_stats_coalesced(&rcu_gp_stats,
+				urcu_waiters_count(&waiters));
+		goto unlock;
+	}
+	rcu_gp_stats_begin(&rcu_gp_stats, &clock, lock_ns,
+			urcu_waiters_count(&waiters));
 
-	mutex_lock(&rcu_registry_lock);
-
-	if (cds_list_empty(&registry))
+	rcu_gp_seq_start();
+	if (registry_list_empty(REGISTRY_READERS))
 		goto out;
 
+	/*
+	 * Write new ptr before the readers observe the new count. A
+	 * reader entering a quiescent state before the sys_membarrier()
+	 * barrier loads the old count, one after it the new ptr.
+	 */
+	smp_mb_master();
+
 	/* Increment current G.P. */
 	CMM_STORE_SHARED(rcu_gp.ctr, rcu_gp.ctr + RCU_GP_CTR);
 
@@ -406,19 +697,32 @@ void synchronize_rcu(void)
 
 	/*
 	 * Wait for readers to observe new count of be quiescent.
-	 * wait_for_readers() can release and grab again rcu_registry_lock
-	 * interally.
+	 * wait_for_readers() takes and releases the shard locks.
 	 */
-	wait_for_readers(&registry, NULL, &qsreaders);
+	if (rcu_gp_tree) {
+		wait_for_readers_tree();
+		rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_WAIT);
+	} else {
+		wait_for_readers(REGISTRY_READERS, 0);
+		rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_WAIT);
+
+		/*
+		 * Put quiescent reader list back into registry.
+		 */
+		registry_splice_qs();
+	}
 
 	/*
-	 * Put quiescent reader list back into registry.
+	 * Finish waiting for the critical sections of the readers, which
+	 * may have stored their quiescent state early without barrier.
 	 */
-	cds_list_splice(&qsreaders, &registry);
+	smp_mb_master();
 out:
-	mutex_unlock(&rcu_registry_lock);
+	rcu_gp_stats_end(&rcu_gp_stats, &clock);
+	rcu_gp_seq_end();
+unlock:
 	mutex_unlock(&rcu_gp_lock);
-	urcu_wake_all_waiters(&waiters);
+	urcu_wake_all_waiters(&gp_waiters, &waiters);
 gp_end:
 	if (was_online)
 		rcu_thread_online();
@@ -427,6 +731,81 @@ gp_end:
 }
 #endif  /* !(CAA_BITS_PER_LONG < 64) */
 
+int rcu_set_spin_budget(unsigned int min_attempts, unsigned int max_attempts)
+{
+	int ret;
+
+	mutex_lock(&rcu_gp_lock);
+	ret = rcu_spin_budget_set(&rcu_gp_budget, min_attempts, max_attempts);
+	mutex_unlock(&rcu_gp_lock);
+	return ret;
+}
+
+unsigned int rcu_get_spin_budget(void)
+{
+	return CMM_LOAD_SHARED(rcu_gp_budget.budget);
+}
+
+/*
+ * Let synchronize_rcu() issue sys_membarrier() so that readers report
+ * quiescent states with compiler barriers only. Must be called before
+ * any thread registers: returns -EBUSY otherwise, and -ENOSYS if the
+ * kernel lacks the private expedited membarrier.
+ */
+int rcu_use_sys_membarrier(void)
+{
+	unsigned int i;
+	int mask, ret = 0;
+
+	mutex_lock(&rcu_gp_lock);
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++)
+		mutex_lock(&registry[i].lock);
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		if (registry[i].nr) {
+			ret = -EBUSY;
+			goto end;
+		}
+	}
+	if (urcu_qsbr_has_sys_membarrier)
+		goto end;
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (mask < 0 || !(mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+		ret = -ENOSYS;
+		goto end;
+	}
+	if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0))
+		urcu_die(errno);
+	/* Threads registering after the shard locks see the new mode. */
+	CMM_STORE_SHARED(urcu_qsbr_has_sys_membarrier, 1);
+end:
+	for (i = RCU_REGISTRY_NR_SHARDS; i > 0; i--)
+		mutex_unlock(&registry[i - 1].lock);
+	mutex_unlock(&rcu_gp_lock);
+	return ret;
+}
+
+/*
+ * Let synchronize_rcu() wait for the readers through the combining
+ * tree, or scan them again. Not supported with 32-bit longs, whose
+ * grace periods have two phases.
+ */
+int rcu_use_gp_tree(int enable)
+{
+#if (CAA_BITS_PER_LONG >= 64)
+	mutex_lock(&rcu_gp_lock);
+	rcu_gp_tree = !!enable;
+	mutex_unlock(&rcu_gp_lock);
+	return 0;
+#else
+	return enable ? -ENOSYS : 0;
+#endif
+}
+
+void rcu_gp_get_stats(struct rcu_gp_stats *stats)
+{
+	rcu_gp_stats_read(stats, &rcu_gp_stats);
+}
+
 /*
  * library wrappers to be used by non-LGPL compatible source code.
  */
@@ -451,6 +830,16 @@ void rcu_quiescent_state(void)
 	_rcu_quiescent_state();
 }
 
+void rcu_quiescent_state_every(unsigned int n)
+{
+	_rcu_quiescent_state_every(n);
+}
+
+void rcu_quiescent_state_timed(caa_cycles_t interval)
+{
+	_rcu_quiescent_state_timed(interval);
+}
+
 void rcu_thread_offline(void)
 {
 	_rcu_thread_offline();
@@ -461,21 +850,178 @@ void rcu_thread_online(void)
 	_rcu_thread_online();
 }
 
+/*
+ * The blocking call wrappers first try the call without blocking while
+ * online, so that ready events only cost the call itself. Coming back
+ * online does not change errno.
+ */
+int rcu_qsbr_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	int ret;
+
+	if (!timeout || !_rcu_read_ongoing())
+		return poll(fds, nfds, timeout);
+	ret = poll(fds, nfds, 0);
+	if (ret)
+		return ret;
+	_rcu_thread_offline();
+	ret = poll(fds, nfds, timeout);
+	_rcu_thread_online();
+	return ret;
+}
+
+#ifdef __linux__
+int rcu_qsbr_epoll_wait(int epfd, struct epoll_event *events,
+		int maxevents, int timeout)
+{
+	int ret;
+
+	if (!timeout || !_rcu_read_ongoing())
+		return epoll_wait(epfd, events, maxevents, timeout);
+	ret = epoll_wait(epfd, events, maxevents, 0);
+	if (ret)
+		return ret;
+	_rcu_thread_offline();
+	ret = epoll_wait(epfd, events, maxevents, timeout);
+	_rcu_thread_online();
+	return ret;
+}
+#endif
+
+/*
+ * Wait on the futex at @uaddr while it holds @val, as FUTEX_WAIT: returns
+ * -1 with errno set to EWOULDBLOCK without going offline if it does not.
+ * Use futex_noasync() FUTEX_WAKE to wake up the waiters.
+ */
+int rcu_qsbr_futex_wait(int32_t *uaddr, int32_t val,
+		const struct timespec *timeout)
+{
+	int ret;
+
+	if (uatomic_read(uaddr) != val) {
+		errno = EWOULDBLOCK;
+		return -1;
+	}
+	if (!_rcu_read_ongoing())
+		return futex_noasync(uaddr, FUTEX_WAIT, val, timeout, NULL, 0);
+	_rcu_thread_offline();
+	ret = futex_noasync(uaddr, FUTEX_WAIT, val, timeout, NULL, 0);
+	_rcu_thread_online();
+	return ret;
+}
+
+/*
+ * Condition variable waits always block. The thread goes offline with
+ * @mutex held, and back online once it is taken again.
+ */
+int rcu_qsbr_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+	int ret;
+
+	if (!_rcu_read_ongoing())
+		return pthread_cond_wait(cond, mutex);
+	_rcu_thread_offline();
+	ret = pthread_cond_wait(cond, mutex);
+	_rcu_thread_online();
+	return ret;
+}
+
+int rcu_qsbr_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+		const struct timespec *abstime)
+{
+	int ret;
+
+	if (!_rcu_read_ongoing())
+		return pthread_cond_timedwait(cond, mutex, abstime);
+	_rcu_thread_offline();
+	ret = pthread_cond_timedwait(cond, mutex, abstime);
+	_rcu_thread_online();
+	return ret;
+}
+
+#ifdef CONFIG_RCU_READER_STATS
+/*
+ * Read-side statistics of the threads which unregistered. The lock is
+ * taken before the shard locks by unregistrations and by
+ * rcu_reader_stats_walk(): a snapshot counts a thread either in its
+ * shard or in these totals.
+ */
+static pthread_mutex_t rcu_reader_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct urcu_reader_stats rcu_reader_stats_exited;
+
+static void rcu_reader_stats_read(struct rcu_reader *reader,
+		struct urcu_reader_stats *s)
+{
+	s->read_locks = CMM_LOAD_SHARED(reader->nr_read_locks);
+	s->nested_locks = 0;
+	s->nesting_max = s->read_locks ? 1 : 0;
+	s->quiescent_states = CMM_LOAD_SHARED(reader->nr_quiescent_states);
+}
+
+/* Called by the thread unregistering, with rcu_reader_stats_lock held. */
+static void rcu_reader_stats_exit(struct rcu_reader *reader)
+{
+	struct urcu_reader_stats s;
+
+	rcu_reader_stats_read(reader, &s);
+	urcu_reader_stats_add(&rcu_reader_stats_exited, &s);
+	reader->nr_read_locks = 0;
+	reader->nr_quiescent_states = 0;
+}
+
+static void rcu_reader_stats_walk(void (*fct)(void *priv, pthread_t tid,
+			const struct urcu_reader_stats *s),
+		void *priv, struct urcu_reader_stats *exited)
+{
+	struct urcu_reader_stats s;
+	unsigned long j;
+	unsigned int i;
+
+	mutex_lock(&rcu_reader_stats_lock);
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		struct rcu_registry_shard *shard = &registry[i];
+
+		mutex_lock(&shard->lock);
+		for (j = 0; j < shard->nr; j++) {
+			rcu_reader_stats_read(shard->readers[j], &s);
+			fct(priv, shard->readers[j]->tid, &s);
+		}
+		mutex_unlock(&shard->lock);
+	}
+	*exited = rcu_reader_stats_exited;
+	mutex_unlock(&rcu_reader_stats_lock);
+}
+#define RCU_STATS_READERS
+#endif /* CONFIG_RCU_READER_STATS */
+
 void rcu_register_thread(void)
 {
+	struct rcu_registry_shard *shard;
+
 	URCU_TLS(rcu_reader).tid = pthread_self();
 	assert(URCU_TLS(rcu_reader).ctr == 0);
 
-	mutex_lock(&rcu_registry_lock);
+	shard = &registry[rcu_registry_shard_index(&URCU_TLS(rcu_reader))];
+	mutex_lock(&shard->lock);
 	assert(!URCU_TLS(rcu_reader).registered);
 	URCU_TLS(rcu_reader).registered = 1;
-	cds_list_add(&URCU_TLS(rcu_reader).node, &registry);
-	mutex_unlock(&rcu_registry_lock);
+	URCU_TLS(rcu_reader).gp_node =
+		&rcu_gp_tree_nodes[rcu_registry_shard_index(&URCU_TLS(rcu_reader))];
+	rcu_registry_add(shard, &URCU_TLS(rcu_reader));
+	mutex_unlock(&shard->lock);
 	_rcu_thread_online();
 }
 
 void rcu_unregister_thread(void)
 {
+	struct rcu_registry_shard *shard;
+
+	/*
+	 * Queue callbacks staged by call_rcu_local() and pointers batched
+	 * by free_rcu_bulk() while registered.
+	 */
+	call_rcu_flush();
+	free_rcu_bulk_flush();
 	/*
 	 * We have to make the thread offline otherwise we end up dealocking
 	 * with a waiting writer.
@@ -483,9 +1029,17 @@ void rcu_unregister_thread(void)
 	_rcu_thread_offline();
 	assert(URCU_TLS(rcu_reader).registered);
 	URCU_TLS(rcu_reader).registered = 0;
-	mutex_lock(&rcu_registry_lock);
-	cds_list_del(&URCU_TLS(rcu_reader).node);
-	mutex_unlock(&rcu_registry_lock);
+	shard = &registry[rcu_registry_shard_index(&URCU_TLS(rcu_reader))];
+#ifdef CONFIG_RCU_READER_STATS
+	mutex_lock(&rcu_reader_stats_lock);
+	rcu_reader_stats_exit(&URCU_TLS(rcu_reader));
+#endif
+	mutex_lock(&shard->lock);
+	rcu_registry_del(shard, &URCU_TLS(rcu_reader));
+	mutex_unlock(&shard->lock);
+#ifdef CONFIG_RCU_READER_STATS
+	mutex_unlock(&rcu_reader_stats_lock);
+#endif
 }
 
 void rcu_exit(void)
@@ -501,3 +1055,6 @@ DEFINE_RCU_FLAVOR(rcu_flavor);
 
 #include "urcu-call-rcu-impl.h"
 #include "urcu-defer-impl.h"
+
+#define RCU_STATS_PREFIX	"urcu.qsbr"
+#include "urcu-stats-impl.h"
@@ -29,13 +29,20 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 /*
  * See urcu-pointer.h and urcu/static/urcu-pointer.h for pointer
  * publication headers.
  */
 #include <urcu-pointer.h>
+#include <urcu/gp-stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -77,6 +84,8 @@ extern "C" {
 #define rcu_read_ongoing_qsbr		_rcu_read_ongoing
 
 #define rcu_quiescent_state_qsbr	_rcu_quiescent_state
+#define rcu_quiescent_state_every_qsbr	_rcu_quiescent_state_every
+#define rcu_quiescent_state_timed_qsbr	_rcu_quiescent_state_timed
 #define rcu_thread_offline_qsbr		_rcu_thread_offline
 #define rcu_thread_online_qsbr		_rcu_thread_online
 
@@ -116,6 +125,8 @@ extern void rcu_read_unlock(void);
 
 extern int rcu_read_ongoing(void);
 extern void rcu_quiescent_state(void);
+extern void rcu_quiescent_state_every(unsigned int n);
+extern void rcu_quiescent_state_timed(caa_cycles_t interval);
 extern void rcu_thread_offline(void);
 extern void rcu_thread_online(void);
 
@@ -123,6 +134,64 @@ extern void rcu_thread_online(void);
 
 extern void synchronize_rcu(void);
 
+/*
+ * Polling grace-period API: a cookie taken before removing data can be
+ * polled to know whether the data can be freed without waiting.
+ */
+extern unsigned long get_state_synchronize_rcu(void);
+extern unsigned long start_poll_synchronize_rcu(void);
+extern int poll_state_synchronize_rcu(unsigned long cookie);
+extern void cond_synchronize_rcu(unsigned long cookie);
+
+/*
+ * Cumulative statistics of the grace periods, see urcu/gp-stats.h.
+ */
+extern void rcu_gp_get_stats(struct rcu_gp_stats *stats);
+
+/*
+ * Statistics of the flavor, its call_rcu and defer_rcu queues, as
+ * "key value" lines. See rcu-api.md.
+ */
+extern size_t rcu_stats_snapshot(char *buf, size_t len);
+extern int rcu_stats_dump(int fd);
+extern int rcu_stats_dump_periodic(int fd, unsigned int period_ms);
+
+/*
+ * Bounds of the number of attempts synchronize_rcu() spins for readers
+ * before sleeping, adapted within them to recent grace periods.
+ */
+extern int rcu_set_spin_budget(unsigned int min_attempts,
+		unsigned int max_attempts);
+extern unsigned int rcu_get_spin_budget(void);
+
+/*
+ * Readers report quiescent states without memory barriers, synchronize_rcu()
+ * issuing sys_membarrier() instead. Called before any thread registers.
+ */
+extern int rcu_use_sys_membarrier(void);
+
+/*
+ * synchronize_rcu() waits for a combining tree of per-shard reports of
+ * the readers instead of scanning them all, for large reader counts.
+ */
+extern int rcu_use_gp_tree(int enable);
+
+/*
+ * Blocking calls for online reader threads, which only go offline if the
+ * call would block, and come back online before returning. Same return
+ * values as the wrapped calls. Behave as the wrapped calls when offline.
+ */
+extern int rcu_qsbr_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+#ifdef __linux__
+extern int rcu_qsbr_epoll_wait(int epfd, struct epoll_event *events,
+		int maxevents, int timeout);
+#endif
+extern int rcu_qsbr_futex_wait(int32_t *uaddr, int32_t val,
+		const struct timespec *timeout);
+extern int rcu_qsbr_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+extern int rcu_qsbr_cond_timedwait(pthread_cond_t *cond,
+		pthread_mutex_t *mutex, const struct timespec *abstime);
+
 /*
  * Reader thread registration.
  */
@@ -0,0 +1,178 @@
+#ifndef _URCU_REGISTRY_H
+#define _URCU_REGISTRY_H
+
+/*
+ * urcu-registry.h
+ *
+ * Userspace RCU library - sharded reader registry
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/alloc.h>
+#include <urcu/list.h>
+#include "urcu-die.h"
+
+/*
+ * Reader threads are spread over shards, hashed on the address of their
+ * rcu_reader TLS structure. Each shard lock protects its arrays, so
+ * thread registration only contends with registrations of the same
+ * shard, and with synchronize_rcu() scanning that shard.
+ *
+ * Each shard keeps a contiguous array of pointers to the rcu_reader of
+ * its threads, with a parallel array of grace-period states: scanning
+ * readers walks the arrays linearly, prefetching the rcu_reader
+ * structures ahead, instead of chasing list pointers. During a grace
+ * period, synchronize_rcu() moves readers from the REGISTRY_READERS
+ * state to the REGISTRY_CUR_SNAP and REGISTRY_QS states, and resets
+ * them all to REGISTRY_READERS at the end. The urcu flavors move the
+ * readers quiescent on the first scan to REGISTRY_IDLE instead. Those
+ * states are only used with rcu_gp_lock held.
+ *
+ * Threads registering while a grace period scans their shard may push
+ * their rcu_reader on the pending stack of the shard instead of waiting
+ * for the shard lock, chained through their node.next. Whoever takes
+ * the shard lock next moves them to the arrays.
+ */
+#define RCU_REGISTRY_NR_SHARDS	16
+
+/* Readers prefetched ahead of the one being scanned. */
+#define RCU_REGISTRY_PREFETCH	4
+
+enum rcu_registry_list {
+	REGISTRY_READERS = 0,
+	REGISTRY_CUR_SNAP,
+	REGISTRY_QS,
+	REGISTRY_IDLE,		/* Quiescent since the grace period began */
+};
+
+struct rcu_reader;
+
+struct rcu_registry_shard {
+	pthread_mutex_t lock;
+	struct rcu_reader **readers;
+	unsigned char *state;		/* enum rcu_registry_list */
+	unsigned long nr, alloc;
+	struct cds_list_head *pending;	/* Deferred registrations */
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+#define DEFINE_RCU_REGISTRY(shards)					\
+	struct rcu_registry_shard shards[RCU_REGISTRY_NR_SHARDS] = {	\
+		[0 ... RCU_REGISTRY_NR_SHARDS - 1] = {			\
+			.lock = PTHREAD_MUTEX_INITIALIZER,		\
+		},							\
+	}
+
+/* Mask of all shards, for the shards still scanned by a grace period. */
+#define RCU_REGISTRY_ALL_SHARDS	((1UL << RCU_REGISTRY_NR_SHARDS) - 1)
+
+/* Iterate on the readers of @shard in state @list. Shard lock held. */
+#define rcu_registry_for_each(shard, i, list)				\
+	for ((i) = 0; (i) < (shard)->nr; (i)++)			\
+		if ((shard)->state[i] == (list)				\
+		    && (rcu_registry_prefetch(shard, i), 1))
+
+static inline
+void rcu_registry_prefetch(struct rcu_registry_shard *shard, unsigned long i)
+{
+	if (i + RCU_REGISTRY_PREFETCH < shard->nr)
+		__builtin_prefetch(shard->readers[i + RCU_REGISTRY_PREFETCH]);
+}
+
+/* Called with the shard lock held. */
+static inline
+void rcu_registry_add(struct rcu_registry_shard *shard,
+		struct rcu_reader *reader)
+{
+	if (shard->nr == shard->alloc) {
+		unsigned long alloc = shard->alloc ? 2 * shard->alloc : 64;
+		struct rcu_reader **readers;
+		unsigned char *state;
+
+		readers = urcu_realloc(shard->readers,
+				alloc * sizeof(*readers));
+		if (!readers)
+			urcu_die(ENOMEM);
+		shard->readers = readers;
+		state = urcu_realloc(shard->state, alloc * sizeof(*state));
+		if (!state)
+			urcu_die(ENOMEM);
+		shard->state = state;
+		shard->alloc = alloc;
+	}
+	shard->readers[shard->nr] = reader;
+	shard->state[shard->nr] = REGISTRY_READERS;
+	shard->nr++;
+}
+
+/* Called with the shard lock held. Moves the last reader in its slot. */
+static inline
+void rcu_registry_del(struct rcu_registry_shard *shard,
+		struct rcu_reader *reader)
+{
+	unsigned long i;
+
+	for (i = 0; i < shard->nr; i++) {
+		if (shard->readers[i] != reader)
+			continue;
+		shard->nr--;
+		shard->readers[i] = shard->readers[shard->nr];
+		shard->state[i] = shard->state[shard->nr];
+		return;
+	}
+	assert(0);
+}
+
+/* Called with the shard lock held. */
+static inline
+int rcu_registry_shard_has(struct rcu_registry_shard *shard,
+		enum rcu_registry_list list)
+{
+	unsigned long i;
+
+	for (i = 0; i < shard->nr; i++) {
+		if (shard->state[i] == list)
+			return 1;
+	}
+	return 0;
+}
+
+/* Called with the shard lock held. */
+static inline
+void rcu_registry_shard_reset(struct rcu_registry_shard *shard)
+{
+	memset(shard->state, REGISTRY_READERS, shard->nr);
+}
+
+static inline
+unsigned int rcu_registry_shard_index(const void *reader)
+{
+	unsigned long v = (unsigned long) reader / CAA_CACHE_LINE_SIZE;
+
+	/* TLS areas are often spaced by large powers of two. */
+	v ^= v >> 16;
+	v *= 0x45d9f3bUL;
+	v ^= v >> 16;
+	return v % RCU_REGISTRY_NR_SHARDS;
+}
+
+#endif /* _URCU_REGISTRY_H */
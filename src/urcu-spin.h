@@ -0,0 +1,141 @@
+#ifndef _URCU_SPIN_H
+#define _URCU_SPIN_H
+
+/*
+ * urcu-spin.h
+ *
+ * Userspace RCU library - adaptive spin budget of grace periods
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include "urcu-time.h"
+
+/*
+ * synchronize_rcu() checks for reader quiescent states up to "budget"
+ * times, relaxing the CPU in between, before waiting on the futex. The
+ * budget follows twice the average number of attempts the recent waits
+ * needed, within bounds set by rcu_set_spin_budget(). The duration of a
+ * wait which slept is converted to attempts with the average duration
+ * of an attempt: if spinning up to the maximum budget could not have
+ * covered it, the spinning was wasted and the budget is halved instead.
+ * All fields are protected by the lock serializing the grace periods.
+ */
+#define RCU_SPIN_DEFAULT_MIN	10
+#define RCU_SPIN_DEFAULT_MAX	1000
+#define RCU_SPIN_DEFAULT	100
+
+/*
+ * Per-reader history: readers which delayed RCU_SPIN_SLOW_READER of the
+ * recent grace periods past the spin budget are waited for on the futex
+ * right away. The count of each reader saturates at RCU_SPIN_SLOW_MAX,
+ * and decreases when the reader is found quiescent while spinning.
+ */
+#define RCU_SPIN_SLOW_READER	2
+#define RCU_SPIN_SLOW_MAX	4
+
+struct rcu_spin_budget {
+	unsigned int min, max;		/* Bounds of the budget. */
+	unsigned int budget;		/* Attempts before the futex wait. */
+	unsigned int avg8;		/* Average attempts of the waits, x8. */
+	uint64_t attempt_ns8;		/* Average attempt duration, x8. */
+};
+
+#define RCU_SPIN_BUDGET_INIT					\
+	{							\
+		.min = RCU_SPIN_DEFAULT_MIN,			\
+		.max = RCU_SPIN_DEFAULT_MAX,			\
+		.budget = RCU_SPIN_DEFAULT,			\
+		.avg8 = 4 * RCU_SPIN_DEFAULT,			\
+	}
+
+static inline unsigned int rcu_spin_clamp(const struct rcu_spin_budget *b,
+		uint64_t v)
+{
+	if (v < b->min)
+		return b->min;
+	if (v > b->max)
+		return b->max;
+	return v;
+}
+
+/*
+ * Account a wait of @ns nanoseconds, which took @attempts attempts (at
+ * least one), and waited on the futex if @slept.
+ */
+static inline void rcu_spin_budget_update(struct rcu_spin_budget *b,
+		unsigned int attempts, int slept, uint64_t ns)
+{
+	uint64_t sample;
+
+	if (!slept) {
+		if (!b->attempt_ns8)
+			b->attempt_ns8 = 8 * ns / attempts;
+		else
+			b->attempt_ns8 += ns / attempts - b->attempt_ns8 / 8;
+		sample = attempts;
+	} else if (b->attempt_ns8) {
+		sample = 8 * ns / b->attempt_ns8;
+	} else {
+		sample = UINT64_MAX;
+	}
+	if (sample > b->max) {
+		b->budget = rcu_spin_clamp(b, b->budget / 2);
+		b->avg8 = 4 * b->budget;
+		return;
+	}
+	b->avg8 += sample - b->avg8 / 8;
+	b->budget = rcu_spin_clamp(b, b->avg8 / 4);
+}
+
+/*
+ * The reader with history @gp_slow is done waiting for, after @sleeps
+ * futex waits.
+ */
+static inline void rcu_spin_reader_done(unsigned int *gp_slow,
+		unsigned int sleeps)
+{
+	if (!sleeps && *gp_slow)
+		(*gp_slow)--;
+}
+
+/*
+ * The reader with history @gp_slow is still in an old critical section
+ * after @sleeps futex waits. Returns whether it is known to be slow.
+ */
+static inline int rcu_spin_reader_old(unsigned int *gp_slow,
+		unsigned int sleeps)
+{
+	if (sleeps == 1 && *gp_slow < RCU_SPIN_SLOW_MAX)
+		(*gp_slow)++;
+	return *gp_slow >= RCU_SPIN_SLOW_READER;
+}
+
+/* Set the bounds of @b, and bring its budget within them. */
+static inline int rcu_spin_budget_set(struct rcu_spin_budget *b,
+		unsigned int min, unsigned int max)
+{
+	if (min > max)
+		return -EINVAL;
+	b->min = min;
+	b->max = max;
+	b->budget = rcu_spin_clamp(b, b->budget);
+	b->avg8 = 4 * b->budget;
+	return 0;
+}
+
+#endif /* _URCU_SPIN_H */
@@ -0,0 +1,120 @@
+#ifndef _URCU_STALL_H
+#define _URCU_STALL_H
+
+/*
+ * urcu-stall.h
+ *
+ * Userspace RCU library - read-side stall warnings
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include "urcu-time.h"
+#include "urcu-trace.h"
+
+/*
+ * When the URCU_STALL_WARN_MS environment variable holds a number of
+ * milliseconds, a wait for readers which lasts longer reports each
+ * reader still delaying the grace period on stderr, with its thread
+ * id, then again after each such period as long as the grace period
+ * is delayed. The stall is measured by the updater, from the start of
+ * the wait: readers are not slowed down, and nothing is measured when
+ * the variable is unset. Futex waits then time out after the period,
+ * so that a reader blocked in its critical section is reported without
+ * having to unlock first.
+ */
+#define RCU_STALL_ENV		"URCU_STALL_WARN_MS"
+
+struct rcu_stall {
+	uint64_t period_ns;	/* 0: stall warnings disabled. */
+	uint64_t start_ns;	/* Wait for readers started. */
+	uint64_t now_ns;	/* Scan reporting readers. */
+	uint64_t next_ns;	/* Next scan to report readers. */
+	int report;		/* Current scan reports readers. */
+};
+
+/* Read the environment once: written identically by concurrent calls. */
+static inline uint64_t rcu_stall_period_ns(void)
+{
+	static int stall_init;
+	static uint64_t stall_period_ns;
+
+	if (caa_unlikely(!CMM_LOAD_SHARED(stall_init))) {
+		const char *env = getenv(RCU_STALL_ENV);
+
+		if (env)
+			CMM_STORE_SHARED(stall_period_ns,
+				strtoull(env, NULL, 10) * 1000000ULL);
+		CMM_STORE_SHARED(stall_init, 1);
+	}
+	return CMM_LOAD_SHARED(stall_period_ns);
+}
+
+static inline void rcu_stall_begin(struct rcu_stall *stall,
+		uint64_t start_ns)
+{
+	stall->period_ns = rcu_stall_period_ns();
+	stall->start_ns = stall->now_ns = start_ns;
+	stall->next_ns = start_ns + stall->period_ns;
+	stall->report = 0;
+}
+
+/* Called before each scan of the readers. */
+static inline void rcu_stall_scan(struct rcu_stall *stall)
+{
+	stall->report = 0;
+	if (caa_likely(!stall->period_ns))
+		return;
+	stall->now_ns = urcu_time_ns();
+	if (stall->now_ns < stall->next_ns)
+		return;
+	stall->report = 1;
+	stall->next_ns = stall->now_ns + stall->period_ns;
+}
+
+/* Reader @tid, found delaying the grace period by the current scan. */
+static inline void rcu_stall_reader(struct rcu_stall *stall, pthread_t tid)
+{
+	uint64_t ns;
+
+	if (caa_likely(!stall->report))
+		return;
+	ns = stall->now_ns - stall->start_ns;
+	urcu_trace2(reader_stall, (unsigned long) tid, ns);
+	fprintf(stderr, "[liburcu] RCU reader thread %#lx has delayed a "
+		"grace period for %" PRIu64 " ms\n",
+		(unsigned long) tid, ns / 1000000);
+}
+
+/* Timeout of the futex waits for readers, NULL without stall warnings. */
+static inline const struct timespec *rcu_stall_timeout(
+		struct rcu_stall *stall, struct timespec *ts)
+{
+	if (caa_likely(!stall->period_ns))
+		return NULL;
+	ts->tv_sec = stall->period_ns / 1000000000ULL;
+	ts->tv_nsec = stall->period_ns % 1000000000ULL;
+	return ts;
+}
+
+#endif /* _URCU_STALL_H */
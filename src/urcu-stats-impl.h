@@ -0,0 +1,266 @@
+#ifndef _URCU_STATS_IMPL_H
+#define _URCU_STATS_IMPL_H
+
+/*
+ * urcu-stats-impl.h
+ *
+ * Userspace RCU library - statistics snapshot of a flavor
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Included by the flavors after urcu-call-rcu-impl.h and
+ * urcu-defer-impl.h, with RCU_STATS_PREFIX set to the key prefix of
+ * the flavor, e.g. "urcu.memb".
+ */
+
+#include <pthread.h>
+#include <sys/time.h>
+#include "urcu-stats.h"
+
+static const char *rcu_gp_phase_keys[RCU_GP_NR_PHASES] = {
+	[RCU_GP_PHASE_LOCK] = "phase_lock_ns",
+	[RCU_GP_PHASE_WAIT] = "phase_wait_ns",
+	[RCU_GP_PHASE_FLIP] = "phase_flip_ns",
+};
+
+static void rcu_stats_gp(struct urcu_stats_buf *b)
+{
+	const char *p = RCU_STATS_PREFIX ".gp";
+	struct rcu_gp_stats stats;
+	unsigned int i;
+
+	rcu_gp_get_stats(&stats);
+	urcu_stats_put(b, p, "grace_periods", stats.grace_periods);
+	urcu_stats_put(b, p, "callers", stats.callers);
+	urcu_stats_put(b, p, "callers_max", stats.callers_max);
+	urcu_stats_put(b, p, "coalesced", stats.coalesced);
+	urcu_stats_put(b, p, "gp_ns", stats.gp_ns);
+	urcu_stats_put(b, p, "gp_max_ns", stats.gp_max_ns);
+	for (i = 0; i < RCU_GP_NR_PHASES; i++)
+		urcu_stats_put(b, p, rcu_gp_phase_keys[i], stats.phase_ns[i]);
+	urcu_stats_put(b, p, "wait_loops", stats.wait_loops);
+	urcu_stats_put(b, p, "wait_sleeps", stats.wait_sleeps);
+	urcu_stats_put(b, p, "membarriers", stats.membarriers);
+	urcu_stats_put(b, p, "signals", stats.signals);
+#ifdef RCU_STATS_MEMBARRIER_MODE
+	urcu_stats_put(b, p, "membarrier_mode", rcu_get_membarrier_mode());
+#endif
+}
+
+/* Each call_rcu_data, in creation order, and its queue. */
+static void rcu_stats_call_rcu(struct urcu_stats_buf *b)
+{
+	const char *p = RCU_STATS_PREFIX ".call_rcu";
+	struct call_rcu_data_stats stats;
+	struct call_rcu_data *crdp;
+	unsigned long i = 0, qlen;
+	uint64_t now = urcu_time_ns(), first_ns;
+
+	call_rcu_lock(&call_rcu_mutex);
+	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
+		call_rcu_data_get_stats(crdp, &stats);
+		qlen = uatomic_read(&crdp->qlen);
+		first_ns = CMM_LOAD_SHARED(crdp->batch_first_ns);
+		urcu_stats_put_index(b, p, i, "qlen", qlen);
+		urcu_stats_put_index(b, p, i, "lazy_qlen",
+			uatomic_read(&crdp->lazy_qlen));
+		urcu_stats_put_index(b, p, i, "oldest_ns",
+			qlen && first_ns && now > first_ns ?
+				now - first_ns : 0);
+		urcu_stats_put_index(b, p, i, "enqueued", stats.enqueued);
+		urcu_stats_put_index(b, p, i, "invoked", stats.invoked);
+		urcu_stats_put_index(b, p, i, "batches", stats.batches);
+		urcu_stats_put_index(b, p, i, "grace_periods",
+			stats.grace_periods);
+		urcu_stats_put_index(b, p, i, "delay_max_ns",
+			stats.delay_max_ns);
+		urcu_stats_put_index(b, p, i, "delay_sum_ns",
+			stats.delay_sum_ns);
+		urcu_stats_put_index(b, p, i, "exec_ns", stats.exec_ns);
+		i++;
+	}
+	call_rcu_unlock(&call_rcu_mutex);
+	urcu_stats_put(b, p, "nr_data", i);
+}
+
+/* Totals of the defer_rcu() queues, including the handed off ones. */
+static void rcu_stats_defer(struct urcu_stats_buf *b)
+{
+	const char *p = RCU_STATS_PREFIX ".defer";
+	unsigned long threads = 0, pending = 0, capacity = 0, pages = 0;
+	struct defer_queue *queue;
+
+	mutex_lock_defer(&rcu_defer_mutex);
+	cds_list_for_each_entry(queue, &registry_defer, list) {
+		threads++;
+		pending += CMM_LOAD_SHARED(queue->head) - queue->tail;
+		if (queue->q)
+			capacity += queue->mask + 1;
+	}
+	cds_list_for_each_entry(queue, &defer_pages, list) {
+		pages++;
+		pending += queue->head - queue->tail;
+	}
+	mutex_unlock(&rcu_defer_mutex);
+	urcu_stats_put(b, p, "threads", threads);
+	urcu_stats_put(b, p, "pending", pending);
+	urcu_stats_put(b, p, "capacity", capacity);
+	urcu_stats_put(b, p, "pages", pages);
+}
+
+#ifdef RCU_STATS_READERS
+/*
+ * Flavors built with CONFIG_RCU_READER_STATS define RCU_STATS_READERS
+ * and rcu_reader_stats_walk(), which calls its function on each
+ * registered reader thread with the registry locked, and returns the
+ * totals of the threads which unregistered.
+ */
+struct rcu_stats_readers {
+	struct urcu_stats_buf *b;
+	struct urcu_reader_stats sum;
+	unsigned long nr;
+};
+
+static void rcu_stats_reader(void *priv, pthread_t tid,
+		const struct urcu_reader_stats *s)
+{
+	const char *p = RCU_STATS_PREFIX ".readers";
+	struct rcu_stats_readers *r = priv;
+
+	urcu_stats_put_index(r->b, p, r->nr, "tid", (unsigned long) tid);
+	urcu_stats_put_index(r->b, p, r->nr, "read_locks", s->read_locks);
+	urcu_stats_put_index(r->b, p, r->nr, "nested_locks",
+		s->nested_locks);
+	urcu_stats_put_index(r->b, p, r->nr, "nesting_max", s->nesting_max);
+	urcu_stats_put_index(r->b, p, r->nr, "quiescent_states",
+		s->quiescent_states);
+	urcu_reader_stats_add(&r->sum, s);
+	r->nr++;
+}
+
+/* Each registered reader thread, then the totals of all threads. */
+static void rcu_stats_readers(struct urcu_stats_buf *b)
+{
+	const char *p = RCU_STATS_PREFIX ".readers";
+	struct rcu_stats_readers r = { .b = b };
+	struct urcu_reader_stats exited;
+
+	rcu_reader_stats_walk(rcu_stats_reader, &r, &exited);
+	urcu_reader_stats_add(&r.sum, &exited);
+	urcu_stats_put(b, p, "threads", r.nr);
+	urcu_stats_put(b, p, "read_locks", r.sum.read_locks);
+	urcu_stats_put(b, p, "nested_locks", r.sum.nested_locks);
+	urcu_stats_put(b, p, "nesting_max", r.sum.nesting_max);
+	urcu_stats_put(b, p, "quiescent_states", r.sum.quiescent_states);
+}
+#endif
+
+size_t rcu_stats_snapshot(char *buf, size_t len)
+{
+	struct urcu_stats_buf b;
+
+	urcu_stats_init(&b, buf, len);
+	rcu_stats_gp(&b);
+	rcu_stats_call_rcu(&b);
+	rcu_stats_defer(&b);
+#ifdef RCU_STATS_READERS
+	rcu_stats_readers(&b);
+#endif
+	return b.pos;
+}
+
+static size_t rcu_stats_snapshot_cb(char *buf, size_t len, void *priv)
+{
+	return rcu_stats_snapshot(buf, len);
+}
+
+int rcu_stats_dump(int fd)
+{
+	return urcu_stats_write(fd, rcu_stats_snapshot_cb, NULL);
+}
+
+/*
+ * Periodic dump thread, protected by rcu_stats_mutex. The thread
+ * waits on rcu_stats_cond for its period, or to be stopped.
+ * rcu_stats_ctl_mutex serializes its starts and stops.
+ */
+static pthread_mutex_t rcu_stats_ctl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t rcu_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rcu_stats_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t rcu_stats_tid;
+static int rcu_stats_running, rcu_stats_stop;
+static int rcu_stats_fd;
+static unsigned int rcu_stats_period_ms;
+
+static void *rcu_stats_thread(void *arg)
+{
+	struct timespec deadline;
+	struct timeval now;
+
+	mutex_lock(&rcu_stats_mutex);
+	while (!rcu_stats_stop) {
+		mutex_unlock(&rcu_stats_mutex);
+		(void) rcu_stats_dump(rcu_stats_fd);
+		mutex_lock(&rcu_stats_mutex);
+		(void) gettimeofday(&now, NULL);
+		deadline.tv_sec = now.tv_sec + rcu_stats_period_ms / 1000;
+		deadline.tv_nsec = now.tv_usec * 1000L
+			+ (rcu_stats_period_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		while (!rcu_stats_stop
+				&& pthread_cond_timedwait(&rcu_stats_cond,
+					&rcu_stats_mutex, &deadline) != ETIMEDOUT)
+			;
+	}
+	mutex_unlock(&rcu_stats_mutex);
+	return NULL;
+}
+
+int rcu_stats_dump_periodic(int fd, unsigned int period_ms)
+{
+	int ret = 0;
+
+	mutex_lock(&rcu_stats_ctl_mutex);
+	mutex_lock(&rcu_stats_mutex);
+	if (rcu_stats_running) {
+		rcu_stats_stop = 1;
+		pthread_cond_broadcast(&rcu_stats_cond);
+		mutex_unlock(&rcu_stats_mutex);
+		ret = pthread_join(rcu_stats_tid, NULL);
+		if (ret)
+			urcu_die(ret);
+		mutex_lock(&rcu_stats_mutex);
+		rcu_stats_running = 0;
+	}
+	if (period_ms) {
+		rcu_stats_fd = fd;
+		rcu_stats_period_ms = period_ms;
+		rcu_stats_stop = 0;
+		ret = -pthread_create(&rcu_stats_tid, NULL, rcu_stats_thread,
+				NULL);
+		if (!ret)
+			rcu_stats_running = 1;
+	}
+	mutex_unlock(&rcu_stats_mutex);
+	mutex_unlock(&rcu_stats_ctl_mutex);
+	return ret;
+}
+
+#endif /* _URCU_STATS_IMPL_H */
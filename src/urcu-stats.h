@@ -0,0 +1,146 @@
+#ifndef _URCU_STATS_H
+#define _URCU_STATS_H
+
+/*
+ * urcu-stats.h
+ *
+ * Userspace RCU library - key/value statistics output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <urcu/alloc.h>
+
+/*
+ * Statistics are output as one "key value" line per counter, the key
+ * made of dot-separated components, the value an unsigned decimal.
+ * Keys are never renamed nor given another meaning: new counters get
+ * new keys, so that parsers can ignore the keys they do not know.
+ */
+struct urcu_stats_buf {
+	char *buf;
+	size_t len;		/* Size of buf. */
+	size_t pos;		/* Length of the complete output. */
+};
+
+static inline void urcu_stats_init(struct urcu_stats_buf *b, char *buf,
+		size_t len)
+{
+	b->buf = buf;
+	b->len = len;
+	b->pos = 0;
+	if (len)
+		buf[0] = '\0';
+}
+
+/*
+ * Append "@prefix.@key @v" to the output. As with snprintf(), the
+ * output is truncated to the buffer, but its complete length counted.
+ */
+static inline void urcu_stats_put(struct urcu_stats_buf *b,
+		const char *prefix, const char *key, uint64_t v)
+{
+	size_t left = b->pos < b->len ? b->len - b->pos : 0;
+	int ret;
+
+	ret = snprintf(left ? b->buf + b->pos : NULL, left,
+			"%s.%s %" PRIu64 "\n", prefix, key, v);
+	if (ret > 0)
+		b->pos += ret;
+}
+
+/* Same as urcu_stats_put(), for "@prefix.@index.@key @v". */
+static inline void urcu_stats_put_index(struct urcu_stats_buf *b,
+		const char *prefix, unsigned long index, const char *key,
+		uint64_t v)
+{
+	char p[128];
+
+	(void) snprintf(p, sizeof(p), "%s.%lu", prefix, index);
+	urcu_stats_put(b, p, key, v);
+}
+
+/*
+ * Read-side statistics of a reader thread, with CONFIG_RCU_READER_STATS,
+ * or their totals over threads: the counts are summed, the nesting is
+ * the deepest one.
+ */
+struct urcu_reader_stats {
+	uint64_t read_locks;		/* Outermost critical sections. */
+	uint64_t nested_locks;		/* Nested critical sections. */
+	uint64_t nesting_max;		/* Deepest nesting level. */
+	uint64_t quiescent_states;	/* Reported by QSBR readers. */
+};
+
+static inline void urcu_reader_stats_add(struct urcu_reader_stats *sum,
+		const struct urcu_reader_stats *s)
+{
+	sum->read_locks += s->read_locks;
+	sum->nested_locks += s->nested_locks;
+	if (s->nesting_max > sum->nesting_max)
+		sum->nesting_max = s->nesting_max;
+	sum->quiescent_states += s->quiescent_states;
+}
+
+/*
+ * Write the output of @snapshot, called on a buffer grown until it
+ * holds the complete output, to @fd. Returns 0 on success, a negative
+ * error value on error.
+ */
+static inline int urcu_stats_write(int fd,
+		size_t (*snapshot)(char *buf, size_t len, void *priv),
+		void *priv)
+{
+	size_t len = 4096, needed, done = 0;
+	char *buf = NULL;
+	int ret = 0;
+
+	for (;;) {
+		char *nbuf = urcu_realloc(buf, len);
+
+		if (!nbuf) {
+			ret = -ENOMEM;
+			goto end;
+		}
+		buf = nbuf;
+		needed = snapshot(buf, len, priv);
+		if (needed < len)
+			break;
+		len = needed + 1;
+	}
+	while (done < needed) {
+		ssize_t w = write(fd, buf + done, needed - done);
+
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			goto end;
+		}
+		done += w;
+	}
+end:
+	urcu_free(buf);
+	return ret;
+}
+
+#endif /* _URCU_STATS_H */
@@ -0,0 +1,44 @@
+#ifndef _URCU_TRACE_H
+#define _URCU_TRACE_H
+
+/*
+ * urcu-trace.h
+ *
+ * Userspace RCU library - static tracepoints
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * USDT probes of the "liburcu" provider, compiled in with
+ * --enable-sdt. A probe is a nop instruction until a tracer such as
+ * bpftrace or perf attaches to it, and without --enable-sdt the
+ * arguments are not even evaluated.
+ */
+#ifdef HAVE_SDT
+#include <sys/sdt.h>
+
+#define urcu_trace0(name)		DTRACE_PROBE(liburcu, name)
+#define urcu_trace1(name, a)		DTRACE_PROBE1(liburcu, name, a)
+#define urcu_trace2(name, a, b)		DTRACE_PROBE2(liburcu, name, a, b)
+#define urcu_trace3(name, a, b, c)	DTRACE_PROBE3(liburcu, name, a, b, c)
+#else
+#define urcu_trace0(name)
+#define urcu_trace1(name, a)
+#define urcu_trace2(name, a, b)
+#define urcu_trace3(name, a, b, c)
+#endif
+
+#endif /* _URCU_TRACE_H */
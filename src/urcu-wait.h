@@ -23,6 +23,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <limits.h>
 #include <urcu/uatomic.h>
 #include <urcu/wfstack.h>
 #include "urcu-die.h"
@@ -56,12 +57,19 @@ struct urcu_wait_node {
 #define DECLARE_URCU_WAIT_NODE(name)			\
 	struct urcu_wait_node name
 
+/*
+ * The waiters of a queue sleep on its wake_seq futex rather than on
+ * their node: the waker sets the state of every waiter it moved, then
+ * increments wake_seq and wakes them all with a single FUTEX_WAKE.
+ */
 struct urcu_wait_queue {
 	struct cds_wfs_stack stack;
+	int32_t wake_seq;
 };
 
 #define URCU_WAIT_QUEUE_HEAD_INIT(name)			\
-	{ .stack.head = CDS_WFS_END, .stack.lock = PTHREAD_MUTEX_INITIALIZER }
+	{ .stack.head = CDS_WFS_END, .stack.lock = PTHREAD_MUTEX_INITIALIZER, \
+	  .wake_seq = 0 }
 
 #define DECLARE_URCU_WAIT_QUEUE(name)			\
 	struct urcu_wait_queue name
@@ -96,6 +104,18 @@ void urcu_move_waiters(struct urcu_waiters *waiters,
 	waiters->head = __cds_wfs_pop_all(&queue->stack);
 }
 
+/* Number of waiters moved into our local struct urcu_waiters. */
+static inline
+unsigned long urcu_waiters_count(struct urcu_waiters *waiters)
+{
+	struct cds_wfs_node *iter;
+	unsigned long count = 0;
+
+	cds_wfs_for_each_blocking(waiters->head, iter)
+		count++;
+	return count;
+}
+
 static inline
 void urcu_wait_set_state(struct urcu_wait_node *node,
 		enum urcu_wait_state state)
@@ -181,12 +201,68 @@ skip_futex_wait:
 	assert(uatomic_read(&wait->state) & URCU_WAIT_TEARDOWN);
 }
 
+/*
+ * Wait until a waker of @queue moved and woke up @wait. Unlike
+ * urcu_adaptative_busy_wait(), sleeps on the futex shared by all the
+ * waiters of @queue, and returns as soon as the waker set the state:
+ * the waker does not access @wait anymore past that point.
+ *
+ * Caller must initialize "value" to URCU_WAIT_WAITING before adding it
+ * to @queue.
+ */
 static inline
-void urcu_wake_all_waiters(struct urcu_waiters *waiters)
+void urcu_wait_queue_busy_wait(struct urcu_wait_queue *queue,
+		struct urcu_wait_node *wait)
+{
+	unsigned int i;
+	int32_t seq;
+
+	/* Load and test condition before read state */
+	cmm_smp_rmb();
+	for (i = 0; i < URCU_WAIT_ATTEMPTS; i++) {
+		if (uatomic_read(&wait->state) != URCU_WAIT_WAITING)
+			return;
+		caa_cpu_relax();
+	}
+	for (;;) {
+		seq = uatomic_read(&queue->wake_seq);
+		/* Read wake_seq before state, paired with the waker. */
+		cmm_smp_mb();
+		if (uatomic_read(&wait->state) != URCU_WAIT_WAITING)
+			return;
+		if (futex_noasync(&queue->wake_seq, FUTEX_WAIT, seq,
+				NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:	/* wake_seq already changed. */
+			case EINTR:		/* Interrupted by signal. */
+				break;	/* Get out of switch. */
+			default:
+				/* Unexpected error. */
+				urcu_die(errno);
+			}
+		}
+		/*
+		 * Either our batch was woken up, or a batch which was
+		 * moved before we were added to the queue: check again.
+		 */
+	}
+}
+
+/*
+ * Wake up all the waiters moved from @queue into @waiters, which wait
+ * in urcu_wait_queue_busy_wait(). Issues at most one futex system call,
+ * whatever the number of waiters.
+ */
+static inline
+void urcu_wake_all_waiters(struct urcu_wait_queue *queue,
+		struct urcu_waiters *waiters)
 {
 	struct cds_wfs_node *iter, *iter_n;
+	bool woken = false;
 
-	/* Wake all waiters in our stack head */
+	/* Order the grace period before the waiters' state. */
+	cmm_smp_mb();
+	/* The safe iteration reads the next node before waking a waiter. */
 	cds_wfs_for_each_blocking_safe(waiters->head, iter, iter_n) {
 		struct urcu_wait_node *wait_node =
 			caa_container_of(iter, struct urcu_wait_node, node);
@@ -194,8 +270,20 @@ void urcu_wake_all_waiters(struct urcu_waiters *waiters)
 		/* Don't wake already running threads */
 		if (wait_node->state & URCU_WAIT_RUNNING)
 			continue;
-		urcu_adaptative_wake_up(wait_node);
+		assert(uatomic_read(&wait_node->state) == URCU_WAIT_WAITING);
+		/* Last access: the waiter may free its node from now. */
+		uatomic_set(&wait_node->state,
+			URCU_WAIT_WAKEUP | URCU_WAIT_TEARDOWN);
+		woken = true;
 	}
+	if (!woken)
+		return;
+	/* Write the waiters' state before wake_seq. */
+	cmm_smp_mb();
+	uatomic_inc(&queue->wake_seq);
+	if (futex_noasync(&queue->wake_seq, FUTEX_WAKE, INT_MAX,
+			NULL, NULL, 0) < 0)
+		urcu_die(errno);
 }
 
 #endif /* _URCU_WAIT_H */
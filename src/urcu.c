@@ -36,6 +36,8 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <poll.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "urcu/arch.h"
 #include "urcu/wfcqueue.h"
@@ -46,12 +48,19 @@
 
 #include "urcu-die.h"
 #include "urcu-wait.h"
+#include "urcu-registry.h"
+#include "urcu-spin.h"
+#include "urcu-gp-stats.h"
+#include "urcu-stall.h"
+#include "urcu-stats.h"
 
 /* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
 #undef _LGPL_SOURCE
 #include "urcu.h"
 #define _LGPL_SOURCE
 
+#include "urcu-poll-impl.h"
+
 /*
  * If a reader is really non-cooperative and refuses to commit its
  * rcu_active_readers count to memory (there is no barrier in the reader
@@ -60,7 +69,9 @@
 #define KICK_READER_LOOPS 	10
 
 /*
- * Active attempts to check for reader Q.S. before calling futex().
+ * Active attempts to check for reader Q.S. before yielding the CPU in
+ * synchronize_rcu_expedited(). See urcu-spin.h for the attempts before
+ * calling futex().
  */
 #define RCU_QS_ACTIVE_ATTEMPTS 100
 
@@ -74,21 +85,21 @@
 enum membarrier_cmd {
 	MEMBARRIER_CMD_QUERY				= 0,
 	MEMBARRIER_CMD_SHARED				= (1 << 0),
-	/* reserved for MEMBARRIER_CMD_SHARED_EXPEDITED (1 << 1) */
-	/* reserved for MEMBARRIER_CMD_PRIVATE (1 << 2) */
+	MEMBARRIER_CMD_GLOBAL_EXPEDITED			= (1 << 1),
+	MEMBARRIER_CMD_REGISTER_GLOBAL_EXPEDITED	= (1 << 2),
 	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
 	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
 };
 
 #ifdef RCU_MEMBARRIER
 static int init_done;
-static int has_sys_membarrier_private_expedited;
+/* sys_membarrier() command of smp_mb_master(), see rcu_sys_membarrier_init(). */
+static int rcu_sys_membarrier_cmd;
+static enum rcu_membarrier_mode rcu_sys_membarrier_mode;
 
 #ifndef CONFIG_RCU_FORCE_SYS_MEMBARRIER
 int rcu_has_sys_membarrier_memb;
 #endif
-
-void __attribute__((constructor)) rcu_init(void);
 #endif
 
 #ifdef RCU_MB
@@ -100,7 +111,6 @@ void rcu_init(void)
 #ifdef RCU_SIGNAL
 static int init_done;
 
-void __attribute__((constructor)) rcu_init(void);
 void __attribute__((destructor)) rcu_exit(void);
 #endif
 
@@ -110,24 +120,39 @@ void __attribute__((destructor)) rcu_exit(void);
  */
 static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
 /*
- * rcu_registry_lock ensures mutual exclusion between threads
- * registering and unregistering themselves to/from the registry, and
- * with threads reading that registry from synchronize_rcu(). However,
- * this lock is not held all the way through the completion of awaiting
- * for the grace period. It is sporadically released between iterations
- * on the registry.
- * rcu_registry_lock may nest inside rcu_gp_lock.
+ * rcu_init_lock serializes rcu_init() calls from rcu_register_thread().
+ * The library is initialized by the first thread registering, rather
+ * than by a constructor: processes linking the library without using
+ * it do not probe sys_membarrier() nor install the signal handler.
+ * Readers and grace periods only read what rcu_init() sets up after a
+ * registration, so they see it initialized.
  */
-static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t rcu_init_lock = PTHREAD_MUTEX_INITIALIZER;
 struct rcu_gp rcu_gp = { .ctr = RCU_GP_COUNT };
 
+/* Spin budget of rcu_gp grace periods, protected by rcu_gp_lock. */
+static struct rcu_spin_budget rcu_gp_budget = RCU_SPIN_BUDGET_INIT;
+
+/* Statistics of rcu_gp grace periods, see urcu-gp-stats.h. */
+static struct rcu_gp_stats rcu_gp_stats;
+
 /*
  * Written to only by each individual reader. Read by both the reader and the
  * writers.
  */
 DEFINE_URCU_TLS(struct rcu_reader, rcu_reader);
 
-static CDS_LIST_HEAD(registry);
+/*
+ * Each shard lock ensures mutual exclusion between threads registering
+ * and unregistering themselves to/from the shard, and with
+ * synchronize_rcu() scanning the shard. However, shard locks are not
+ * held all the way through the completion of awaiting for the grace
+ * period. They are released between iterations on the registry.
+ * Threads registering while the lock of their shard is taken defer
+ * their registration, see registry_shard_defer().
+ * Shard locks may nest inside rcu_gp_lock.
+ */
+static DEFINE_RCU_REGISTRY(registry);
 
 /*
  * Queue keeping threads awaiting to wait for a grace period. Contains
@@ -166,14 +191,54 @@ static void mutex_unlock(pthread_mutex_t *mutex)
 		urcu_die(ret);
 }
 
+/*
+ * Lock @shard, and move the readers whose registration was deferred to
+ * its arrays. Grace periods take the shard locks with this: the memory
+ * barrier orders the removal of the old data before reading the
+ * pending stack, as the push of a deferred registration orders it
+ * before its first read-side critical section. A reader is therefore
+ * either scanned by a grace period, or sees the data it removed.
+ */
+static void registry_shard_lock(struct rcu_registry_shard *shard)
+{
+	struct cds_list_head *node, *next;
+
+	mutex_lock(&shard->lock);
+	cmm_smp_mb();
+	if (caa_likely(!CMM_LOAD_SHARED(shard->pending)))
+		return;
+	node = uatomic_xchg(&shard->pending, NULL);
+	for (; node; node = next) {
+		next = node->next;
+		rcu_registry_add(shard,
+			caa_container_of(node, struct rcu_reader, node));
+	}
+}
+
+/*
+ * Lock-free registration, for a thread finding the lock of @shard taken,
+ * most likely by a grace period scanning it.
+ */
+static void registry_shard_defer(struct rcu_registry_shard *shard,
+		struct rcu_reader *reader)
+{
+	struct cds_list_head *old, *head;
+
+	head = CMM_LOAD_SHARED(shard->pending);
+	do {
+		old = head;
+		reader->node.next = old;
+		head = uatomic_cmpxchg(&shard->pending, old, &reader->node);
+	} while (head != old);
+}
+
 #ifdef RCU_MEMBARRIER
 static void smp_mb_master(void)
 {
 	if (caa_likely(rcu_has_sys_membarrier_memb)) {
-		if (membarrier(has_sys_membarrier_private_expedited ?
-				MEMBARRIER_CMD_PRIVATE_EXPEDITED :
-				MEMBARRIER_CMD_SHARED, 0))
+		if (membarrier(rcu_sys_membarrier_cmd, 0))
 			urcu_die(errno);
+		uatomic_inc(&rcu_gp_stats.membarriers);
 	} else {
 		cmm_smp_mb();
 	}
@@ -187,26 +252,112 @@ static void smp_mb_master(void)
 }
 #endif
 
+/*
+ * Readers a memory barrier applies to with the signal flavor, as a mask
+ * of their registry states. Readers found quiescent on the first scan
+ * of a grace period, after the barrier starting it, are left in the
+ * REGISTRY_IDLE state: they did not access the old data since, so the
+ * barrier ending the grace period skips them.
+ */
+#define RCU_MB_STATE(state)	(1U << (state))
+#define RCU_MB_ALL		(~0U)
+#define RCU_MB_NOT_IDLE		(~RCU_MB_STATE(REGISTRY_IDLE))
+
 #ifdef RCU_SIGNAL
-static void force_mb_all_readers(void)
+/*
+ * rcu_force_mb_lock serializes force_mb_readers() between
+ * synchronize_rcu() and the grace periods of RCU domains.
+ */
+static pthread_mutex_t rcu_force_mb_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Set to -1 by force_mb_readers() before waiting for a signal handler,
+ * which resets it and wakes it up once it cleared its need_mb.
+ */
+static int32_t rcu_force_mb_futex;
+
+/* Delay before signaling again a reader which did not handle its signal. */
+#define RCU_FORCE_MB_RESEND_MS	10
+
+/*
+ * Wait for @index to execute the signal handler, signaling it again if
+ * it takes longer than RCU_FORCE_MB_RESEND_MS. Returns the number of
+ * signals sent again.
+ */
+static unsigned long force_mb_wait(struct rcu_reader *index)
+{
+#ifdef CONFIG_RCU_HAVE_FUTEX
+	const struct timespec timeout = {
+		.tv_nsec = RCU_FORCE_MB_RESEND_MS * 1000000L,
+	};
+#endif
+	unsigned long signals = 0;
+
+	while (CMM_LOAD_SHARED(index->need_mb)) {
+		uatomic_set(&rcu_force_mb_futex, -1);
+		/* Write futex before read ->need_mb. */
+		cmm_smp_mb();
+		if (!CMM_LOAD_SHARED(index->need_mb))
+			break;
+#ifdef CONFIG_RCU_HAVE_FUTEX
+		if (!futex(&rcu_force_mb_futex, FUTEX_WAIT, -1, &timeout,
+				NULL, 0))
+			continue;
+		switch (errno) {
+		case EWOULDBLOCK:	/* Woken before waiting. */
+		case EINTR:
+			continue;
+		case ETIMEDOUT:
+			break;
+		case ENOSYS:
+			(void) poll(NULL, 0, 1);
+			break;
+		default:
+			urcu_die(errno);
+		}
+#else
+		(void) poll(NULL, 0, 1);
+#endif
+		pthread_kill(index->tid, SIGRCU);
+		signals++;
+	}
+	return signals;
+}
+
+/*
+ * Force a memory barrier on the registered threads in the registry
+ * states of @states, a mask of RCU_MB_STATE().
+ */
+static void force_mb_readers(unsigned int states)
 {
 	struct rcu_reader *index;
+	unsigned long j, signals = 0;
+	unsigned int i;
 
 	/*
 	 * Ask for each threads to execute a cmm_smp_mb() so we can consider the
 	 * compiler barriers around rcu read lock as real memory barriers.
 	 */
-	if (cds_list_empty(&registry))
-		return;
 	/*
 	 * pthread_kill has a cmm_smp_mb(). But beware, we assume it performs
 	 * a cache flush on architectures with non-coherent cache. Let's play
 	 * safe and don't assume anything : we use cmm_smp_mc() to make sure the
 	 * cache flush is enforced.
 	 */
-	cds_list_for_each_entry(index, &registry, node) {
-		CMM_STORE_SHARED(index->need_mb, 1);
-		pthread_kill(index->tid, SIGRCU);
+	mutex_lock(&rcu_force_mb_lock);
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		struct rcu_registry_shard *shard = &registry[i];
+
+		registry_shard_lock(shard);
+		for (j = 0; j < shard->nr; j++) {
+			if (!(states & RCU_MB_STATE(shard->state[j])))
+				continue;
+			index = shard->readers[j];
+			CMM_STORE_SHARED(index->need_mb, 1);
+			pthread_kill(index->tid, SIGRCU);
+			signals++;
+		}
+		mutex_unlock(&shard->lock);
 	}
 	/*
 	 * Wait for sighandler (and thus mb()) to execute on every thread.
@@ -221,44 +372,59 @@ static void force_mb_all_readers(void)
 	 * relevant bug report.  For Linux kernels, we recommend getting
 	 * the Linux Test Project (LTP).
 	 */
-	cds_list_for_each_entry(index, &registry, node) {
-		while (CMM_LOAD_SHARED(index->need_mb)) {
-			pthread_kill(index->tid, SIGRCU);
-			(void) poll(NULL, 0, 1);
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		struct rcu_registry_shard *shard = &registry[i];
+
+		registry_shard_lock(shard);
+		for (j = 0; j < shard->nr; j++) {
+			if (!(states & RCU_MB_STATE(shard->state[j])))
+				continue;
+			signals += force_mb_wait(shard->readers[j]);
 		}
+		mutex_unlock(&shard->lock);
 	}
+	mutex_unlock(&rcu_force_mb_lock);
+	uatomic_add(&rcu_gp_stats.signals, signals);
 	cmm_smp_mb();	/* read ->need_mb before ending the barrier */
 }
+#endif /* #ifdef RCU_SIGNAL */
 
-static void smp_mb_master(void)
+/*
+ * Memory barrier on the readers of @gp in the registry states of
+ * @states. With the signal flavor, the threads reading in an RCU domain
+ * can be in any state of the flavor registry, so all of them are
+ * signaled.
+ */
+static void smp_mb_master_gp(struct rcu_gp *gp, unsigned int states)
 {
-	force_mb_all_readers();
+#ifdef RCU_SIGNAL
+	force_mb_readers(gp == &rcu_gp ? states : RCU_MB_ALL);
+#else
+	smp_mb_master();
+#endif
 }
-#endif /* #ifdef RCU_SIGNAL */
 
 /*
- * synchronize_rcu() waiting. Single thread.
- * Always called with rcu_registry lock held. Releases this lock and
- * grabs it again. Holds the lock when it returns.
+ * synchronize_rcu() waiting. Single thread. Returns after @timeout,
+ * unless NULL, to report stalled readers.
  */
-static void wait_gp(void)
+static void wait_gp(struct rcu_gp *gp, unsigned int states,
+		const struct timespec *timeout)
 {
-	/*
-	 * Read reader_gp before read futex. smp_mb_master() needs to
-	 * be called with the rcu registry lock held in RCU_SIGNAL
-	 * flavor.
-	 */
-	smp_mb_master();
-	/* Temporarily unlock the registry lock. */
-	mutex_unlock(&rcu_registry_lock);
-	if (uatomic_read(&rcu_gp.futex) != -1)
-		goto end;
-	while (futex_async(&rcu_gp.futex, FUTEX_WAIT, -1,
-			NULL, NULL, 0)) {
+	/* Read reader_gp before read futex. */
+	smp_mb_master_gp(gp, states);
+	if (uatomic_read(&gp->futex) != -1)
+		return;
+	while (futex_async(&gp->futex, FUTEX_WAIT, -1,
+			timeout, NULL, 0)) {
 		switch (errno) {
 		case EWOULDBLOCK:
 			/* Value already changed. */
-			goto end;
+			return;
+		case ETIMEDOUT:
+			/* Decremented again by the next wait. */
+			uatomic_set(&gp->futex, 0);
+			return;
 		case EINTR:
 			/* Retry if interrupted by signal. */
 			break;	/* Get out of switch. */
@@ -267,130 +433,182 @@ static void wait_gp(void)
 			urcu_die(errno);
 		}
 	}
-end:
-	/*
-	 * Re-lock the registry lock before the next loop.
-	 */
-	mutex_lock(&rcu_registry_lock);
+}
+
+static int registry_list_empty(struct rcu_registry_shard *shards,
+		enum rcu_registry_list list)
+{
+	unsigned int i;
+	int empty = 1;
+
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS && empty; i++) {
+		registry_shard_lock(&shards[i]);
+		empty = !rcu_registry_shard_has(&shards[i], list);
+		mutex_unlock(&shards[i].lock);
+	}
+	return empty;
+}
+
+/* Put quiescent readers back into the registry. */
+static void registry_splice_qs(struct rcu_registry_shard *shards)
+{
+	unsigned int i;
+
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		registry_shard_lock(&shards[i]);
+		rcu_registry_shard_reset(&shards[i]);
+		mutex_unlock(&shards[i].lock);
+	}
 }
 
 /*
- * Always called with rcu_registry lock held. Releases this lock between
- * iterations and grabs it again. Holds the lock when it returns.
+ * Move the readers in the @input state of each of @shards to the
+ * REGISTRY_CUR_SNAP state if @cur_snap and they observe the current
+ * @gp counter, or to the REGISTRY_QS state once quiescent. Each shard
+ * lock is only held while scanning the shard, and the shards emptied
+ * are not scanned again. Spin up to the attempts of @spin_budget before
+ * waiting on the futex, and adapt it to the duration of the wait. When
+ * @spin is set, busy-wait instead of waiting on the futex, yielding the
+ * CPU to preempted readers after RCU_QS_ACTIVE_ATTEMPTS loops.
  */
-static void wait_for_readers(struct cds_list_head *input_readers,
-			struct cds_list_head *cur_snap_readers,
-			struct cds_list_head *qsreaders)
+static void wait_for_readers(struct rcu_gp *gp,
+			struct rcu_registry_shard *shards,
+			struct rcu_spin_budget *spin_budget,
+			enum rcu_registry_list input, int cur_snap, int spin)
 {
-	unsigned int wait_loops = 0;
-	struct rcu_reader *index, *tmp;
+	unsigned int wait_loops = 0, spin_loops = 0, sleeps = 0, scans = 0;
+	unsigned int budget = spin_budget->budget;
+	unsigned long pending = RCU_REGISTRY_ALL_SHARDS;
+	struct rcu_reader *index;
+	struct rcu_stall stall;
+	struct timespec stall_ts;
+	uint64_t start_ns;
+	unsigned long j;
+	unsigned int i;
+	int left, slow_skip = 0;
 #ifdef HAS_INCOHERENT_CACHES
 	unsigned int wait_gp_loops = 0;
 #endif /* HAS_INCOHERENT_CACHES */
 
+	start_ns = urcu_time_ns();
+	rcu_stall_begin(&stall, start_ns);
 	/*
 	 * Wait for each thread URCU_TLS(rcu_reader).ctr to either
 	 * indicate quiescence (not nested), or observe the current
 	 * rcu_gp.ctr value.
 	 */
 	for (;;) {
-		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
+		int slow = 0;
+
+		scans++;
+		rcu_stall_scan(&stall);
+		if (wait_loops < budget && !spin)
 			wait_loops++;
-		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
-			uatomic_dec(&rcu_gp.futex);
+		if (wait_loops >= budget && !spin) {
+			sleeps++;
+			uatomic_dec(&gp->futex);
 			/* Write futex before read reader_gp */
-			smp_mb_master();
+			smp_mb_master_gp(gp, RCU_MB_STATE(input));
 		}
 
-		cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
-			switch (rcu_reader_state(&index->ctr)) {
-			case RCU_READER_ACTIVE_CURRENT:
-				if (cur_snap_readers) {
-					cds_list_move(&index->node,
-						cur_snap_readers);
+		for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+			struct rcu_registry_shard *shard = &shards[i];
+
+			if (!(pending & (1UL << i)))
+				continue;
+			registry_shard_lock(shard);
+			left = 0;
+			rcu_registry_for_each(shard, j, input) {
+				index = shard->readers[j];
+				switch (__rcu_reader_state(&index->ctr, gp)) {
+				case RCU_READER_ACTIVE_CURRENT:
+					if (cur_snap) {
+						shard->state[j] = REGISTRY_CUR_SNAP;
+						rcu_spin_reader_done(&index->gp_slow,
+							sleeps);
+						break;
+					}
+					/* Fall-through */
+				case RCU_READER_INACTIVE:
+					/*
+					 * Quiescent since the grace period
+					 * began, when first scanned.
+					 */
+					shard->state[j] = (input == REGISTRY_READERS
+							&& scans == 1) ?
+						REGISTRY_IDLE : REGISTRY_QS;
+					rcu_spin_reader_done(&index->gp_slow,
+						sleeps);
+					break;
+				case RCU_READER_ACTIVE_OLD:
+					/*
+					 * Old snapshot. Leaving reader in
+					 * input state will make us busy-loop
+					 * until the snapshot becomes current
+					 * or the reader becomes inactive.
+					 */
+					left = 1;
+					if (rcu_spin_reader_old(&index->gp_slow,
+							sleeps))
+						slow = 1;
+					rcu_stall_reader(&stall, index->tid);
 					break;
 				}
-				/* Fall-through */
-			case RCU_READER_INACTIVE:
-				cds_list_move(&index->node, qsreaders);
-				break;
-			case RCU_READER_ACTIVE_OLD:
-				/*
-				 * Old snapshot. Leaving node in
-				 * input_readers will make us busy-loop
-				 * until the snapshot becomes current or
-				 * the reader becomes inactive.
-				 */
-				break;
 			}
+			if (!left)
+				pending &= ~(1UL << i);
+			mutex_unlock(&shard->lock);
 		}
 
-#ifndef HAS_INCOHERENT_CACHES
-		if (cds_list_empty(input_readers)) {
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+		if (!pending) {
+			if (sleeps) {
 				/* Read reader_gp before write futex */
-				smp_mb_master();
-				uatomic_set(&rcu_gp.futex, 0);
+				smp_mb_master_gp(gp, RCU_MB_ALL);
+				uatomic_set(&gp->futex, 0);
 			}
 			break;
-		} else {
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
-				/* wait_gp unlocks/locks registry lock. */
-				wait_gp();
-			} else {
-				/* Temporarily unlock the registry lock. */
-				mutex_unlock(&rcu_registry_lock);
-				caa_cpu_relax();
-				/*
-				 * Re-lock the registry lock before the
-				 * next loop.
-				 */
-				mutex_lock(&rcu_registry_lock);
-			}
 		}
-#else /* #ifndef HAS_INCOHERENT_CACHES */
+		/* Do not spin for readers known to be slow. */
+		if (slow && !spin && wait_loops < budget) {
+			wait_loops = budget;
+			slow_skip = 1;
+			continue;
+		}
+#ifdef HAS_INCOHERENT_CACHES
 		/*
 		 * BUSY-LOOP. Force the reader thread to commit its
 		 * URCU_TLS(rcu_reader).ctr update to memory if we wait
 		 * for too long.
 		 */
-		if (cds_list_empty(input_readers)) {
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
-				/* Read reader_gp before write futex */
-				smp_mb_master();
-				uatomic_set(&rcu_gp.futex, 0);
-			}
-			break;
-		} else {
-			if (wait_gp_loops == KICK_READER_LOOPS) {
-				smp_mb_master();
-				wait_gp_loops = 0;
-			}
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
-				/* wait_gp unlocks/locks registry lock. */
-				wait_gp();
-				wait_gp_loops++;
-			} else {
-				/* Temporarily unlock the registry lock. */
-				mutex_unlock(&rcu_registry_lock);
-				caa_cpu_relax();
-				/*
-				 * Re-lock the registry lock before the
-				 * next loop.
-				 */
-				mutex_lock(&rcu_registry_lock);
-			}
+		if (wait_gp_loops == KICK_READER_LOOPS) {
+			smp_mb_master_gp(gp, RCU_MB_STATE(input));
+			wait_gp_loops = 0;
 		}
-#endif /* #else #ifndef HAS_INCOHERENT_CACHES */
+		/* Spinning readers need kicks too. */
+		if (sleeps || spin)
+			wait_gp_loops++;
+#endif /* HAS_INCOHERENT_CACHES */
+		if (sleeps)
+			wait_gp(gp, RCU_MB_STATE(input),
+				rcu_stall_timeout(&stall, &stall_ts));
+		else if (spin && ++spin_loops >= RCU_QS_ACTIVE_ATTEMPTS)
+			(void) sched_yield();
+		else
+			caa_cpu_relax();
 	}
+	if (!spin && !slow_skip)
+		rcu_spin_budget_update(spin_budget, wait_loops, sleeps,
+			urcu_time_ns() - start_ns);
+	if (gp == &rcu_gp)
+		rcu_gp_stats_wait(&rcu_gp_stats, scans - sleeps, sleeps);
 }
 
 void synchronize_rcu(void)
 {
-	CDS_LIST_HEAD(cur_snap_readers);
-	CDS_LIST_HEAD(qsreaders);
 	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
 	struct urcu_waiters waiters;
+	struct rcu_gp_stats_clock clock;
+	uint64_t lock_ns;
 
 	/*
 	 * Add ourself to gp_waiters queue of threads awaiting to wait
@@ -400,9 +618,10 @@ void synchronize_rcu(void)
 	 * orders prior memory accesses of threads put into the wait
 	 * queue before their insertion into the wait queue.
 	 */
+	rcu_gp_seq_want();
 	if (urcu_wait_add(&gp_waiters, &wait) != 0) {
 		/* Not first in queue: will be awakened by another thread. */
-		urcu_adaptative_busy_wait(&wait);
+		urcu_wait_queue_busy_wait(&gp_waiters, &wait);
 		/* Order following memory accesses after grace period. */
 		cmm_smp_mb();
 		return;
@@ -410,32 +629,39 @@ void synchronize_rcu(void)
 	/* We won't need to wake ourself up */
 	urcu_wait_set_state(&wait, URCU_WAIT_RUNNING);
 
+	lock_ns = urcu_time_ns();
 	mutex_lock(&rcu_gp_lock);
 
 	/*
 	 * Move all waiters into our local queue.
 	 */
 	urcu_move_waiters(&waiters, &gp_waiters);
+	if (rcu_gp_seq_wanted_done()) {
+		rcu_gp_stats_coalesced(&rcu_gp_stats,
+				urcu_waiters_count(&waiters));
+		goto unlock;
+	}
+	rcu_gp_stats_begin(&rcu_gp_stats, &clock, lock_ns,
+			urcu_waiters_count(&waiters));
 
-	mutex_lock(&rcu_registry_lock);
-
-	if (cds_list_empty(&registry))
+	rcu_gp_seq_start();
+	if (registry_list_empty(registry, REGISTRY_READERS))
 		goto out;
 
 	/*
 	 * All threads should read qparity before accessing data structure
-	 * where new ptr points to. Must be done within rcu_registry_lock
-	 * because it iterates on reader threads.
+	 * where new ptr points to.
 	 */
 	/* Write new ptr before changing the qparity */
-	smp_mb_master();
+	smp_mb_master_gp(&rcu_gp, RCU_MB_ALL);
 
 	/*
 	 * Wait for readers to observe original parity or be quiescent.
-	 * wait_for_readers() can release and grab again rcu_registry_lock
-	 * interally.
+	 * wait_for_readers() takes and releases the shard locks.
 	 */
-	wait_for_readers(&registry, &cur_snap_readers, &qsreaders);
+	wait_for_readers(&rcu_gp, registry, &rcu_gp_budget,
+			REGISTRY_READERS, 1, 0);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_WAIT);
 
 	/*
 	 * Must finish waiting for quiescent state for original parity before
@@ -474,24 +700,27 @@ void synchronize_rcu(void)
 
 	/*
 	 * Wait for readers to observe new parity or be quiescent.
-	 * wait_for_readers() can release and grab again rcu_registry_lock
-	 * interally.
+	 * wait_for_readers() takes and releases the shard locks.
 	 */
-	wait_for_readers(&cur_snap_readers, NULL, &qsreaders);
+	wait_for_readers(&rcu_gp, registry, &rcu_gp_budget,
+			REGISTRY_CUR_SNAP, 0, 0);
+	rcu_gp_stats_phase(&rcu_gp_stats, &clock, RCU_GP_PHASE_FLIP);
 
 	/*
-	 * Put quiescent reader list back into registry.
+	 * Finish waiting for reader threads before letting the old ptr
+	 * being freed. Done before putting the quiescent readers back into
+	 * the registry, to skip the idle ones.
 	 */
-	cds_list_splice(&qsreaders, &registry);
+	smp_mb_master_gp(&rcu_gp, RCU_MB_NOT_IDLE);
 
 	/*
-	 * Finish waiting for reader threads before letting the old ptr
-	 * being freed. Must be done within rcu_registry_lock because it
-	 * iterates on reader threads.
+	 * Put quiescent reader list back into registry.
 	 */
-	smp_mb_master();
+	registry_splice_qs(registry);
 out:
-	mutex_unlock(&rcu_registry_lock);
+	rcu_gp_stats_end(&rcu_gp_stats, &clock);
+	rcu_gp_seq_end();
+unlock:
 	mutex_unlock(&rcu_gp_lock);
 
 	/*
@@ -499,7 +728,104 @@ out:
 	 * and have ensured the memory barriers at the end of the grace
 	 * period have been issued.
 	 */
-	urcu_wake_all_waiters(&waiters);
+	urcu_wake_all_waiters(&gp_waiters, &waiters);
+}
+
+/*
+ * Grace period of @gp over the readers of @shards, called with the
+ * lock serializing the grace periods of @gp held. The parity flip and
+ * the second wait are skipped when all readers were quiescent during
+ * the first wait: the readers which became active since then started
+ * after the grace period began. Adapts @spin_budget, unless @spin is
+ * set to busy-wait for readers instead of sleeping on the futex. Times
+ * the phases with @clock, if not NULL.
+ */
+static void __synchronize_rcu_gp(struct rcu_gp *gp,
+		struct rcu_registry_shard *shards,
+		struct rcu_spin_budget *spin_budget, int spin,
+		struct rcu_gp_stats_clock *clock)
+{
+	if (registry_list_empty(shards, REGISTRY_READERS))
+		return;
+
+	/* Write new ptr before reading reader ctr. */
+	smp_mb_master_gp(gp, RCU_MB_ALL);
+
+	wait_for_readers(gp, shards, spin_budget, REGISTRY_READERS, 1, spin);
+	if (clock)
+		rcu_gp_stats_phase(&rcu_gp_stats, clock, RCU_GP_PHASE_WAIT);
+	if (registry_list_empty(shards, REGISTRY_CUR_SNAP))
+		goto end;
+
+	/* See synchronize_rcu() for the parity flip ordering. */
+	cmm_barrier();
+	cmm_smp_mb();
+	CMM_STORE_SHARED(gp->ctr, gp->ctr ^ RCU_GP_CTR_PHASE);
+	cmm_barrier();
+	cmm_smp_mb();
+
+	wait_for_readers(gp, shards, spin_budget, REGISTRY_CUR_SNAP, 0, spin);
+	if (clock)
+		rcu_gp_stats_phase(&rcu_gp_stats, clock, RCU_GP_PHASE_FLIP);
+end:
+	/* Finish waiting for readers before letting old ptr be freed. */
+	smp_mb_master_gp(gp, RCU_MB_NOT_IDLE);
+	registry_splice_qs(shards);
+}
+
+/*
+ * Same as synchronize_rcu(), trading CPU time for latency: do not batch
+ * with concurrent synchronize_rcu() callers, and busy-wait for readers
+ * instead of sleeping on the futex. On uniprocessor systems,
+ * busy-waiting would only delay preempted readers, so the futex is used
+ * as usual.
+ */
+void synchronize_rcu_expedited(void)
+{
+	static int spin = -1;
+	struct rcu_gp_stats_clock clock;
+	uint64_t lock_ns;
+
+	if (caa_unlikely(spin < 0))
+		spin = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+	lock_ns = urcu_time_ns();
+	mutex_lock(&rcu_gp_lock);
+	rcu_gp_stats_begin(&rcu_gp_stats, &clock, lock_ns, 1);
+	rcu_gp_seq_start();
+	__synchronize_rcu_gp(&rcu_gp, registry, &rcu_gp_budget, spin, &clock);
+	rcu_gp_stats_end(&rcu_gp_stats, &clock);
+	rcu_gp_seq_end();
+	mutex_unlock(&rcu_gp_lock);
+}
+
+int rcu_set_spin_budget(unsigned int min_attempts, unsigned int max_attempts)
+{
+	int ret;
+
+	mutex_lock(&rcu_gp_lock);
+	ret = rcu_spin_budget_set(&rcu_gp_budget, min_attempts, max_attempts);
+	mutex_unlock(&rcu_gp_lock);
+	return ret;
+}
+
+unsigned int rcu_get_spin_budget(void)
+{
+	return CMM_LOAD_SHARED(rcu_gp_budget.budget);
+}
+
+void rcu_gp_get_stats(struct rcu_gp_stats *stats)
+{
+	rcu_gp_stats_read(stats, &rcu_gp_stats);
+}
+
+enum rcu_membarrier_mode rcu_get_membarrier_mode(void)
+{
+#ifdef RCU_MEMBARRIER
+	if (rcu_has_sys_membarrier_memb)
+		return rcu_sys_membarrier_mode;
+#endif
+	return RCU_MEMBARRIER_NONE;
 }
 
 /*
@@ -521,27 +847,145 @@ int rcu_read_ongoing(void)
 	return _rcu_read_ongoing();
 }
 
+#ifdef RCU_SIGNAL
+/*
+ * Grace periods wait for each registered thread to run sigrcu_handler().
+ * Threads which block all signals and then register, like the rculfhash
+ * resize worker, would stall them forever: let SIGRCU through.
+ */
+static void rcu_unblock_sigrcu(void)
+{
+	sigset_t mask;
+	int ret;
+
+	ret = sigemptyset(&mask);
+	if (ret)
+		urcu_die(errno);
+	ret = sigaddset(&mask, SIGRCU);
+	if (ret)
+		urcu_die(errno);
+	ret = pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+	if (ret)
+		urcu_die(ret);
+}
+#else
+static void rcu_unblock_sigrcu(void)
+{
+}
+#endif
+
+#ifdef CONFIG_RCU_READER_STATS
+/*
+ * Read-side statistics of the threads which unregistered. The lock is
+ * taken before the shard locks by unregistrations and by
+ * rcu_reader_stats_walk(): a snapshot counts a thread either in its
+ * shard or in these totals.
+ */
+static pthread_mutex_t rcu_reader_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct urcu_reader_stats rcu_reader_stats_exited;
+
+static void rcu_reader_stats_read(struct rcu_reader *reader,
+		struct urcu_reader_stats *s)
+{
+	s->read_locks = CMM_LOAD_SHARED(reader->nr_read_locks);
+	s->nested_locks = CMM_LOAD_SHARED(reader->nr_nested_locks);
+	s->nesting_max = CMM_LOAD_SHARED(reader->nesting_max);
+	if (!s->nesting_max && s->read_locks)
+		s->nesting_max = 1;
+	s->quiescent_states = 0;
+}
+
+/* Called by the thread unregistering, with rcu_reader_stats_lock held. */
+static void rcu_reader_stats_exit(struct rcu_reader *reader)
+{
+	struct urcu_reader_stats s;
+
+	rcu_reader_stats_read(reader, &s);
+	urcu_reader_stats_add(&rcu_reader_stats_exited, &s);
+	reader->nr_read_locks = 0;
+	reader->nr_nested_locks = 0;
+	reader->nesting_max = 0;
+}
+
+static void rcu_reader_stats_walk(void (*fct)(void *priv, pthread_t tid,
+			const struct urcu_reader_stats *s),
+		void *priv, struct urcu_reader_stats *exited)
+{
+	struct urcu_reader_stats s;
+	unsigned long j;
+	unsigned int i;
+
+	mutex_lock(&rcu_reader_stats_lock);
+	for (i = 0; i < RCU_REGISTRY_NR_SHARDS; i++) {
+		struct rcu_registry_shard *shard = &registry[i];
+
+		registry_shard_lock(shard);
+		for (j = 0; j < shard->nr; j++) {
+			rcu_reader_stats_read(shard->readers[j], &s);
+			fct(priv, shard->readers[j]->tid, &s);
+		}
+		mutex_unlock(&shard->lock);
+	}
+	*exited = rcu_reader_stats_exited;
+	mutex_unlock(&rcu_reader_stats_lock);
+}
+#define RCU_STATS_READERS
+#endif /* CONFIG_RCU_READER_STATS */
+
 void rcu_register_thread(void)
 {
+	struct rcu_registry_shard *shard;
+
+	rcu_unblock_sigrcu();
 	URCU_TLS(rcu_reader).tid = pthread_self();
 	assert(URCU_TLS(rcu_reader).need_mb == 0);
 	assert(!(URCU_TLS(rcu_reader).ctr & RCU_GP_CTR_NEST_MASK));
 
-	mutex_lock(&rcu_registry_lock);
 	assert(!URCU_TLS(rcu_reader).registered);
 	URCU_TLS(rcu_reader).registered = 1;
-	rcu_init();	/* In case gcc does not support constructor attribute */
-	cds_list_add(&URCU_TLS(rcu_reader).node, &registry);
-	mutex_unlock(&rcu_registry_lock);
+	mutex_lock(&rcu_init_lock);
+	rcu_init();
+	mutex_unlock(&rcu_init_lock);
+	shard = &registry[rcu_registry_shard_index(&URCU_TLS(rcu_reader))];
+	/*
+	 * Do not wait for a grace period scanning the shard: the next one
+	 * to take the shard lock adds us to its arrays.
+	 */
+	if (pthread_mutex_trylock(&shard->lock)) {
+		registry_shard_defer(shard, &URCU_TLS(rcu_reader));
+		return;
+	}
+	rcu_registry_add(shard, &URCU_TLS(rcu_reader));
+	mutex_unlock(&shard->lock);
 }
 
 void rcu_unregister_thread(void)
 {
-	mutex_lock(&rcu_registry_lock);
+	struct rcu_registry_shard *shard;
+
+	/*
+	 * Queue callbacks staged by call_rcu_local() and pointers batched
+	 * by free_rcu_bulk() while registered.
+	 */
+	call_rcu_flush();
+	free_rcu_bulk_flush();
+	shard = &registry[rcu_registry_shard_index(&URCU_TLS(rcu_reader))];
+#ifdef CONFIG_RCU_READER_STATS
+	mutex_lock(&rcu_reader_stats_lock);
+	rcu_reader_stats_exit(&URCU_TLS(rcu_reader));
+#endif
+	/*
+	 * Grace periods only hold the shard lock while scanning the shard,
+	 * never while waiting for readers.
+	 */
+	registry_shard_lock(shard);
 	assert(URCU_TLS(rcu_reader).registered);
 	URCU_TLS(rcu_reader).registered = 0;
-	cds_list_del(&URCU_TLS(rcu_reader).node);
-	mutex_unlock(&rcu_registry_lock);
+	rcu_registry_del(shard, &URCU_TLS(rcu_reader));
+	mutex_unlock(&shard->lock);
+#ifdef CONFIG_RCU_READER_STATS
+	mutex_unlock(&rcu_reader_stats_lock);
+#endif
 }
 
 #ifdef RCU_MEMBARRIER
@@ -563,22 +1007,48 @@ void rcu_sys_membarrier_status(bool available)
 }
 #endif
 
+/*
+ * sys_membarrier() commands, from the fastest. The expedited ones
+ * interrupt the CPUs running threads of the registered processes,
+ * while MEMBARRIER_CMD_SHARED waits for a kernel grace period, which
+ * takes milliseconds.
+ */
+static const struct {
+	int cmd, register_cmd;	/* register_cmd 0: none */
+	enum rcu_membarrier_mode mode;
+} rcu_sys_membarrier_ladder[] = {
+	{ MEMBARRIER_CMD_PRIVATE_EXPEDITED,
+		MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED,
+		RCU_MEMBARRIER_PRIVATE_EXPEDITED },
+	{ MEMBARRIER_CMD_GLOBAL_EXPEDITED,
+		MEMBARRIER_CMD_REGISTER_GLOBAL_EXPEDITED,
+		RCU_MEMBARRIER_GLOBAL_EXPEDITED },
+	{ MEMBARRIER_CMD_SHARED, 0, RCU_MEMBARRIER_SHARED },
+};
+
+/*
+ * Use the first command of the ladder the kernel supports and lets this
+ * process register for, or fall back on memory barriers in the readers.
+ */
 static
 void rcu_sys_membarrier_init(void)
 {
 	bool available = false;
+	unsigned int i;
 	int mask;
 
 	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
-	if (mask >= 0) {
-		if (mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED) {
-			if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0))
-				urcu_die(errno);
-			has_sys_membarrier_private_expedited = 1;
-			available = true;
-		} else if (mask & MEMBARRIER_CMD_SHARED) {
-			available = true;
-		}
+	for (i = 0; mask >= 0 && i < CAA_ARRAY_SIZE(rcu_sys_membarrier_ladder);
+			i++) {
+		if (!(mask & rcu_sys_membarrier_ladder[i].cmd))
+			continue;
+		if (rcu_sys_membarrier_ladder[i].register_cmd
+				&& membarrier(rcu_sys_membarrier_ladder[i].register_cmd, 0))
+			continue;
+		rcu_sys_membarrier_cmd = rcu_sys_membarrier_ladder[i].cmd;
+		rcu_sys_membarrier_mode = rcu_sys_membarrier_ladder[i].mode;
+		available = true;
+		break;
 	}
 	rcu_sys_membarrier_status(available);
 }
@@ -603,15 +1073,23 @@ static void sigrcu_handler(int signo, siginfo_t *siginfo, void *context)
 	cmm_smp_mb();
 	_CMM_STORE_SHARED(URCU_TLS(rcu_reader).need_mb, 0);
 	cmm_smp_mb();
+	/* Write ->need_mb before read futex, wake force_mb_wait() up. */
+	if (caa_unlikely(uatomic_read(&rcu_force_mb_futex) == -1)) {
+		uatomic_set(&rcu_force_mb_futex, 0);
+#ifdef CONFIG_RCU_HAVE_FUTEX
+		(void) futex(&rcu_force_mb_futex, FUTEX_WAKE, 1,
+				NULL, NULL, 0);
+#endif
+	}
 }
 
 /*
- * rcu_init constructor. Called when the library is linked, but also when
- * reader threads are calling rcu_register_thread().
+ * Called when reader threads are calling rcu_register_thread(), or
+ * explicitly.
  * Should only be called by a single thread at a given time. This is ensured by
- * holing the rcu_registry_lock from rcu_register_thread() or by running
- * at library load time, which should not be executed by multiple
- * threads nor concurrently with rcu_register_thread() anyway.
+ * holding the rcu_init_lock from rcu_register_thread(). Explicit calls
+ * should happen before threads are created, e.g. from a library
+ * constructor.
  */
 void rcu_init(void)
 {
@@ -646,5 +1124,16 @@ void rcu_exit(void)
 
 DEFINE_RCU_FLAVOR(rcu_flavor);
 
+#include "urcu-domain-impl.h"
 #include "urcu-call-rcu-impl.h"
 #include "urcu-defer-impl.h"
+
+#if defined(RCU_MEMBARRIER)
+#define RCU_STATS_PREFIX	"urcu.memb"
+#elif defined(RCU_MB)
+#define RCU_STATS_PREFIX	"urcu.mb"
+#elif defined(RCU_SIGNAL)
+#define RCU_STATS_PREFIX	"urcu.signal"
+#endif
+#define RCU_STATS_MEMBARRIER_MODE
+#include "urcu-stats-impl.h"
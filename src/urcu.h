@@ -39,6 +39,7 @@
  * publication headers.
  */
 #include <urcu-pointer.h>
+#include <urcu/gp-stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -75,14 +76,23 @@ extern "C" {
 #define rcu_read_lock_memb		_rcu_read_lock
 #define rcu_read_unlock_memb		_rcu_read_unlock
 #define rcu_read_ongoing_memb		_rcu_read_ongoing
+#define rcu_domain_read_lock_memb	_rcu_domain_read_lock
+#define rcu_domain_read_unlock_memb	_rcu_domain_read_unlock
+#define rcu_domain_read_ongoing_memb	_rcu_domain_read_ongoing
 #elif defined(RCU_SIGNAL)
 #define rcu_read_lock_sig		_rcu_read_lock
 #define rcu_read_unlock_sig		_rcu_read_unlock
 #define rcu_read_ongoing_sig		_rcu_read_ongoing
+#define rcu_domain_read_lock_sig	_rcu_domain_read_lock
+#define rcu_domain_read_unlock_sig	_rcu_domain_read_unlock
+#define rcu_domain_read_ongoing_sig	_rcu_domain_read_ongoing
 #elif defined(RCU_MB)
 #define rcu_read_lock_mb		_rcu_read_lock
 #define rcu_read_unlock_mb		_rcu_read_unlock
 #define rcu_read_ongoing_mb		_rcu_read_ongoing
+#define rcu_domain_read_lock_mb		_rcu_domain_read_lock
+#define rcu_domain_read_unlock_mb	_rcu_domain_read_unlock
+#define rcu_domain_read_ongoing_mb	_rcu_domain_read_ongoing
 #endif
 
 #else /* !_LGPL_SOURCE */
@@ -96,9 +106,51 @@ extern void rcu_read_lock(void);
 extern void rcu_read_unlock(void);
 extern int rcu_read_ongoing(void);
 
+struct rcu_domain_reader;
+
+extern void rcu_domain_read_lock(struct rcu_domain_reader *r);
+extern void rcu_domain_read_unlock(struct rcu_domain_reader *r);
+extern int rcu_domain_read_ongoing(struct rcu_domain_reader *r);
+
 #endif /* !_LGPL_SOURCE */
 
 extern void synchronize_rcu(void);
+extern void synchronize_rcu_expedited(void);
+
+/*
+ * Polling grace-period API: a cookie taken before removing data can be
+ * polled to know whether the data can be freed without waiting.
+ */
+extern unsigned long get_state_synchronize_rcu(void);
+extern unsigned long start_poll_synchronize_rcu(void);
+extern int poll_state_synchronize_rcu(unsigned long cookie);
+extern void cond_synchronize_rcu(unsigned long cookie);
+
+/*
+ * Cumulative statistics of the grace periods, see urcu/gp-stats.h.
+ */
+extern void rcu_gp_get_stats(struct rcu_gp_stats *stats);
+
+/*
+ * Statistics of the flavor, its call_rcu and defer_rcu queues, as
+ * "key value" lines. See rcu-api.md.
+ */
+extern size_t rcu_stats_snapshot(char *buf, size_t len);
+extern int rcu_stats_dump(int fd);
+extern int rcu_stats_dump_periodic(int fd, unsigned int period_ms);
+
+/*
+ * sys_membarrier() command used by the grace periods, for diagnostics.
+ */
+extern enum rcu_membarrier_mode rcu_get_membarrier_mode(void);
+
+/*
+ * Bounds of the number of attempts synchronize_rcu() spins for readers
+ * before sleeping, adapted within them to recent grace periods.
+ */
+extern int rcu_set_spin_budget(unsigned int min_attempts,
+		unsigned int max_attempts);
+extern unsigned int rcu_get_spin_budget(void);
 
 /*
  * Reader thread registration.
@@ -106,8 +158,27 @@ extern void synchronize_rcu(void);
 extern void rcu_register_thread(void);
 extern void rcu_unregister_thread(void);
 
+/*
+ * Independent RCU domains: each domain has its own grace periods, only
+ * waiting for the read-side critical sections of the same domain.
+ * Domain readers must also be registered with rcu_register_thread().
+ */
+struct rcu_domain;
+struct rcu_head;
+
+extern struct rcu_domain *rcu_domain_create(void);
+extern int rcu_domain_destroy(struct rcu_domain *domain);
+extern struct rcu_domain_reader *rcu_domain_register_thread(
+		struct rcu_domain *domain);
+extern void rcu_domain_unregister_thread(struct rcu_domain_reader *r);
+extern void synchronize_rcu_domain(struct rcu_domain *domain);
+extern void call_rcu_domain(struct rcu_domain *domain, struct rcu_head *head,
+		void (*func)(struct rcu_head *head));
+extern void rcu_barrier_domain(struct rcu_domain *domain);
+
 /*
  * Explicit rcu initialization, for "early" use within library constructors.
+ * Otherwise, the library is initialized by the first rcu_register_thread().
  */
 extern void rcu_init(void);
 
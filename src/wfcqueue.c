@@ -66,6 +66,29 @@ bool cds_wfcq_enqueue(cds_wfcq_head_ptr_t head,
 	return _cds_wfcq_enqueue(head, tail, node);
 }
 
+bool cds_wfcq_enqueue_batch(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last)
+{
+	return _cds_wfcq_enqueue_batch(head, tail, first, last);
+}
+
+bool __cds_wfcq_enqueue_sp(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *node)
+{
+	return ___cds_wfcq_enqueue_sp(head, tail, node);
+}
+
+bool cds_wfcq_enqueue_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *node,
+		struct cds_eventcount *ec)
+{
+	return _cds_wfcq_enqueue_wake(head, tail, node, ec);
+}
+
 void cds_wfcq_dequeue_lock(struct cds_wfcq_head *head,
 		struct cds_wfcq_tail *tail)
 {
@@ -85,6 +108,14 @@ struct cds_wfcq_node *cds_wfcq_dequeue_blocking(
 	return _cds_wfcq_dequeue_blocking(head, tail);
 }
 
+struct cds_wfcq_node *cds_wfcq_dequeue_wait(
+		struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_eventcount *ec)
+{
+	return _cds_wfcq_dequeue_wait(head, tail, ec);
+}
+
 struct cds_wfcq_node *cds_wfcq_dequeue_with_state_blocking(
 		struct cds_wfcq_head *head,
 		struct cds_wfcq_tail *tail,
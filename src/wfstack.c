@@ -127,3 +127,23 @@ struct cds_wfs_head *__cds_wfs_pop_all(cds_wfs_stack_ptr_t u_stack)
 {
 	return ___cds_wfs_pop_all(u_stack);
 }
+
+void cds_wfs_batch_init(struct cds_wfs_batch *batch)
+{
+	_cds_wfs_batch_init(batch);
+}
+
+struct cds_wfs_node *
+	__cds_wfs_pop_batch_blocking(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_batch *batch)
+{
+	return ___cds_wfs_pop_batch_blocking(u_stack, batch);
+}
+
+struct cds_wfs_node *
+	__cds_wfs_pop_batch_with_state_blocking(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_batch *batch, int *state)
+{
+	return ___cds_wfs_pop_batch_with_state_blocking(u_stack, batch,
+			state);
+}
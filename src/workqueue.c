@@ -30,6 +30,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <poll.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -41,33 +42,77 @@
 #include "urcu-pointer.h"
 #include "urcu/list.h"
 #include "urcu/futex.h"
+#include "urcu/eventcount.h"
 #include "urcu/tls-compat.h"
 #include "urcu/ref.h"
+#include "urcu/alloc.h"
 #include "urcu-die.h"
+#include "urcu-time.h"
+#include "urcu-placement.h"
 
 #include "workqueue.h"
 
-#define SET_AFFINITY_CHECK_PERIOD		(1U << 8)	/* 256 */
-#define SET_AFFINITY_CHECK_PERIOD_MASK		(SET_AFFINITY_CHECK_PERIOD - 1)
 
-/* Data structure that identifies a workqueue. */
+/* Default delay between batches of work, in ms. */
+#define URCU_WORKQUEUE_BATCH_DELAY_MS		10
 
-struct urcu_workqueue {
+/* Spins of a busy-polling worker between checks of its flags. */
+#define WORKQUEUE_BUSY_POLL_SPINS		1024
+
+/*
+ * Batches low priority work may be passed over for higher priority
+ * work, after which one low priority item joins the next batch anyway.
+ */
+#define WORKQUEUE_LOW_MAX_SKIPS			8
+
+/*
+ * High priority items executed between two items of a batch, so that a
+ * stream of high priority work does not stall the batch.
+ */
+#define WORKQUEUE_HIGH_BURST			16
+
+/*
+ * Worker thread of a workqueue, and its queues, one per priority class.
+ * Workers of a pool finding their queues empty steal the queue of
+ * another worker. Their queues are then spliced with the head lock held.
+ */
+struct urcu_workqueue_worker {
 	/*
-	 * We do not align head on a different cache-line than tail
-	 * mainly because call_rcu callback-invocation threads use
-	 * batching ("splice") to get an entire list of callbacks, which
-	 * effectively empties the queue, and requires to touch the tail
-	 * anyway.
+	 * The head is on its own cache line, apart from the tail
+	 * exchanged by urcu_workqueue_queue_work() on many CPUs.
 	 */
-	struct cds_wfcq_tail cbs_tail;
-	struct cds_wfcq_head cbs_head;
-	unsigned long flags;
-	int32_t futex;
+	struct cds_wfcq_queue cbs[URCU_WORKQUEUE_NR_PRIO];
+	unsigned long flags;	/* URCU_WORKQUEUE_PAUSED */
+	/* Batches taken while low priority work was waiting. */
+	unsigned int low_skipped;
+	struct cds_eventcount wait_ec;
 	unsigned long qlen; /* maintained for debugging. */
+	/* Odd while the worker takes and executes work (pool only). */
+	unsigned long batch_seq;
 	pthread_t tid;
 	int cpu_affinity;
-	unsigned long loop_count;
+	struct urcu_workqueue *workqueue;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/* Data structure that identifies a workqueue. */
+
+struct urcu_workqueue {
+	unsigned long flags;
+	unsigned int nr_workers;
+	struct urcu_workqueue_worker *workers;
+	/*
+	 * Delayed work: a binary min-heap on expires_ns, moved to the queue
+	 * of the first worker when due. The first worker sleeps with a
+	 * timeout until the earliest expiry.
+	 */
+	pthread_mutex_t timer_lock;
+	struct urcu_work **timers;
+	unsigned long nr_timers, alloc_timers;
+	/* Set by urcu_workqueue_set_batch(). */
+	unsigned int batch_delay_ms;
+	unsigned long batch_max;
+	/* CPUs and scheduling of the workers. */
+	struct urcu_placement_shared placement;
 	void *priv;
 	void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv);
 	void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv);
@@ -76,11 +121,11 @@ struct urcu_workqueue {
 	void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv);
 	void (*worker_before_wait_fct)(struct urcu_workqueue *workqueue, void *priv);
 	void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv);
-} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+};
 
 struct urcu_workqueue_completion {
 	int barrier_count;
-	int32_t futex;
+	struct cds_eventcount ec;
 	struct urcu_ref ref;
 };
 
@@ -89,79 +134,455 @@ struct urcu_workqueue_completion_work {
 	struct urcu_workqueue_completion *completion;
 };
 
+/* Worker choice of threads without a current CPU number. */
+static DEFINE_URCU_TLS(unsigned int, workqueue_next_worker);
+
+/* Apply the placement of the workqueue, see urcu_placement_check(). */
+static int set_thread_cpu_affinity(struct urcu_workqueue_worker *worker,
+		struct urcu_placement_thread *placement)
+{
+	return urcu_placement_check(&worker->workqueue->placement, placement,
+			worker->cpu_affinity);
+}
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void eventcount_wait(struct cds_eventcount *ec)
+{
+	if (cds_eventcount_wait(ec))
+		urcu_die(errno);
+}
+
+static void eventcount_wake_up(struct cds_eventcount *ec)
+{
+	if (cds_eventcount_wake(ec))
+		urcu_die(errno);
+}
+
+static void wake_worker_thread(struct urcu_workqueue_worker *worker)
+{
+	if (!(_CMM_LOAD_SHARED(worker->workqueue->flags) & URCU_WORKQUEUE_RT))
+		eventcount_wake_up(&worker->wait_ec);
+}
+
+static struct cds_wfcq_queue *worker_queue(struct urcu_workqueue_worker *worker,
+		enum urcu_workqueue_prio prio)
+{
+	return &worker->cbs[prio];
+}
+
+static int worker_queue_empty(struct urcu_workqueue_worker *worker,
+		enum urcu_workqueue_prio prio)
+{
+	struct cds_wfcq_queue *queue = worker_queue(worker, prio);
+
+	return cds_wfcq_empty(&queue->head, &queue->tail);
+}
+
+/* Whether all the queues of @worker are empty. */
+static int worker_empty(struct urcu_workqueue_worker *worker)
+{
+	int prio;
+
+	for (prio = 0; prio < URCU_WORKQUEUE_NR_PRIO; prio++) {
+		if (!worker_queue_empty(worker, prio))
+			return 0;
+	}
+	return 1;
+}
+
+/* Queue @work on the queue of @worker for @prio, and wake it up. */
+static unsigned long worker_enqueue(struct urcu_workqueue_worker *worker,
+		struct urcu_work *work, enum urcu_workqueue_prio prio)
+{
+	struct cds_wfcq_queue *queue = worker_queue(worker, prio);
+	unsigned long qlen;
+
+	cds_wfcq_node_init(&work->next);
+	cds_wfcq_enqueue(&queue->head, &queue->tail, &work->next);
+	qlen = uatomic_add_return_mo(&worker->qlen, 1, CMM_RELAXED);
+	wake_worker_thread(worker);
+	return qlen;
+}
+
+static void timer_heap_swap(struct urcu_work **timers, unsigned long a,
+		unsigned long b)
+{
+	struct urcu_work *tmp = timers[a];
+
+	timers[a] = timers[b];
+	timers[b] = tmp;
+}
+
+static void timer_heap_up(struct urcu_work **timers, unsigned long i)
+{
+	while (i && timers[(i - 1) / 2]->expires_ns > timers[i]->expires_ns) {
+		timer_heap_swap(timers, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void timer_heap_down(struct urcu_work **timers, unsigned long nr,
+		unsigned long i)
+{
+	for (;;) {
+		unsigned long min = i, child = 2 * i + 1;
+
+		if (child < nr && timers[child]->expires_ns
+				< timers[min]->expires_ns)
+			min = child;
+		if (child + 1 < nr && timers[child + 1]->expires_ns
+				< timers[min]->expires_ns)
+			min = child + 1;
+		if (min == i)
+			return;
+		timer_heap_swap(timers, i, min);
+		i = min;
+	}
+}
+
+/* Remove entry @i of the heap. Called with timer_lock held. */
+static void timer_heap_remove(struct urcu_workqueue *workqueue,
+		unsigned long i)
+{
+	struct urcu_work **timers = workqueue->timers;
+	unsigned long nr = workqueue->nr_timers - 1;
+
+	/* Read without timer_lock by the first worker. */
+	CMM_STORE_SHARED(workqueue->nr_timers, nr);
+	if (i == nr)
+		return;
+	timers[i] = timers[nr];
+	timer_heap_up(timers, i);
+	timer_heap_down(timers, nr, i);
+}
+
 /*
- * Periodically retry setting CPU affinity if we migrate.
- * Losing affinity can be caused by CPU hotunplug/hotplug, or by
- * cpuset(7).
+ * Move the delayed work which is due to the queue of the first worker.
+ * Returns the time until the next expiry, 0 if there is none.
  */
-#if HAVE_SCHED_SETAFFINITY
-static int set_thread_cpu_affinity(struct urcu_workqueue *workqueue)
+static uint64_t workqueue_run_timers(struct urcu_workqueue *workqueue)
 {
-	cpu_set_t mask;
-	int ret;
+	struct urcu_workqueue_worker *worker = &workqueue->workers[0];
+	uint64_t now, next = 0;
+	struct urcu_work *work;
 
-	if (workqueue->cpu_affinity < 0)
-		return 0;
-	if (++workqueue->loop_count & SET_AFFINITY_CHECK_PERIOD_MASK)
-		return 0;
-	if (urcu_sched_getcpu() == workqueue->cpu_affinity)
+	if (!uatomic_read(&workqueue->nr_timers))
 		return 0;
+	now = urcu_time_ns();
+	mutex_lock(&workqueue->timer_lock);
+	while (workqueue->nr_timers) {
+		work = workqueue->timers[0];
+		if (work->expires_ns > now) {
+			next = work->expires_ns - now;
+			break;
+		}
+		timer_heap_remove(workqueue, 0);
+		cds_wfcq_node_init(&work->next);
+		cds_wfcq_enqueue(&worker->cbs[URCU_WORKQUEUE_PRIO_NORMAL].head,
+				&worker->cbs[URCU_WORKQUEUE_PRIO_NORMAL].tail,
+				&work->next);
+		uatomic_inc_mo(&worker->qlen, CMM_RELAXED);
+	}
+	mutex_unlock(&workqueue->timer_lock);
+	return next;
+}
 
-	CPU_ZERO(&mask);
-	CPU_SET(workqueue->cpu_affinity, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	ret = sched_setaffinity(0, &mask);
-#else
-	ret = sched_setaffinity(0, sizeof(mask), &mask);
-#endif
-	/*
-	 * EINVAL is fine: can be caused by hotunplugged CPUs, or by
-	 * cpuset(7). This is why we should always retry if we detect
-	 * migration.
-	 */
-	if (ret && errno == EINVAL) {
-		ret = 0;
-		errno = 0;
+/*
+ * Wait for work. The first worker also waits for the next delayed work
+ * to be due, and returns 1 while delayed work is pending, so that it is
+ * not postponed by batching.
+ */
+static int workqueue_wait(struct urcu_workqueue_worker *worker)
+{
+	struct urcu_workqueue *workqueue = worker->workqueue;
+	uint64_t next;
+
+	if (worker == workqueue->workers) {
+		next = workqueue_run_timers(workqueue);
+		if (!worker_empty(worker))
+			return 1;
+		if (next) {
+			if (cds_eventcount_wait_timeout(&worker->wait_ec,
+					next) < 0)
+				urcu_die(errno);
+			return 1;
+		}
 	}
-	return ret;
+	eventcount_wait(&worker->wait_ec);
+	/* Woken up by the first delayed work? */
+	return worker == workqueue->workers
+		&& uatomic_read(&workqueue->nr_timers);
 }
-#else
-static int set_thread_cpu_affinity(struct urcu_workqueue *workqueue)
+
+/*
+ * Move up to @max work items from the queue @prio of @worker to the
+ * given queue, local to the worker. ULONG_MAX splices the whole queue.
+ * Returns the number of work items moved, or, for a splice, whether
+ * work was moved.
+ */
+static unsigned long workqueue_dequeue_batch(struct urcu_workqueue_worker *worker,
+		enum urcu_workqueue_prio prio,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail,
+		unsigned long max)
 {
-	return 0;
+	struct cds_wfcq_queue *queue = worker_queue(worker, prio);
+	struct cds_wfcq_node *node;
+	unsigned long count = 0;
+
+	if (max == ULONG_MAX) {
+		/* Only pools steal, with the head lock held. */
+		if (worker->workqueue->nr_workers == 1)
+			return __cds_wfcq_splice_blocking(head, tail,
+					&queue->head, &queue->tail)
+				!= CDS_WFCQ_RET_SRC_EMPTY;
+		return cds_wfcq_splice_blocking(head, tail,
+				&queue->head, &queue->tail)
+			!= CDS_WFCQ_RET_SRC_EMPTY;
+	}
+	while (count < max) {
+		node = cds_wfcq_dequeue_blocking(&queue->head, &queue->tail);
+		if (!node)
+			break;
+		cds_wfcq_node_init(node);
+		__cds_wfcq_enqueue_sp(head, tail, node);
+		count++;
+	}
+	return count;
 }
-#endif
 
-static void futex_wait(int32_t *futex)
+/*
+ * Move up to @max work items of @worker to the given queue, in priority
+ * order: high priority work first, then normal priority work, then low
+ * priority work if there is no other. Low priority work passed over for
+ * WORKQUEUE_LOW_MAX_SKIPS batches has one item join the batch anyway.
+ * ULONG_MAX moves all the work, but low priority work passed over.
+ * Returns non-zero if work was moved, as workqueue_dequeue_batch().
+ */
+static unsigned long workqueue_dequeue_prio(struct urcu_workqueue_worker *worker,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail,
+		unsigned long max)
 {
-	/* Read condition before read futex */
-	cmm_smp_mb();
-	if (uatomic_read(futex) != -1)
-		return;
-	while (futex_async(futex, FUTEX_WAIT, -1, NULL, NULL, 0)) {
-		switch (errno) {
-		case EWOULDBLOCK:
-			/* Value already changed. */
-			return;
-		case EINTR:
-			/* Retry if interrupted by signal. */
-			break;	/* Get out of switch. */
-		default:
-			/* Unexpected error. */
-			urcu_die(errno);
+	unsigned long count = 0;
+	int prio;
+
+	for (prio = URCU_WORKQUEUE_PRIO_HIGH;
+			prio < URCU_WORKQUEUE_PRIO_LOW && count < max; prio++)
+		count += workqueue_dequeue_batch(worker, prio, head, tail,
+				max == ULONG_MAX ? max : max - count);
+	if (worker_queue_empty(worker, URCU_WORKQUEUE_PRIO_LOW)) {
+		worker->low_skipped = 0;
+		return count;
+	}
+	if (!count) {
+		worker->low_skipped = 0;
+		return workqueue_dequeue_batch(worker, URCU_WORKQUEUE_PRIO_LOW,
+				head, tail, max);
+	}
+	if (++worker->low_skipped >= WORKQUEUE_LOW_MAX_SKIPS) {
+		worker->low_skipped = 0;
+		count += workqueue_dequeue_batch(worker,
+				URCU_WORKQUEUE_PRIO_LOW, head, tail, 1);
+	}
+	return count;
+}
+
+/*
+ * Steal a share of the queue of another worker of the pool, starting
+ * with the next worker and with its highest priority work, into the
+ * given queue. Stolen work is executed in the batch of @worker rather
+ * than queued again: behind a completion queued meanwhile, it would
+ * escape urcu_workqueue_flush_queued_work(). Returns the number of work
+ * items stolen.
+ */
+static unsigned long workqueue_steal(struct urcu_workqueue_worker *worker,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail)
+{
+	struct urcu_workqueue *workqueue = worker->workqueue;
+	unsigned int i, self = worker - workqueue->workers;
+	unsigned int nr_workers = workqueue->nr_workers;
+	struct urcu_workqueue_worker *victim;
+	unsigned long count = 0, nr;
+	int prio;
+
+	for (i = 1; i < nr_workers; i++) {
+		victim = &workqueue->workers[(self + i) % nr_workers];
+		for (prio = 0; prio < URCU_WORKQUEUE_NR_PRIO; prio++) {
+			if (!worker_queue_empty(victim, prio))
+				break;
 		}
+		if (prio == URCU_WORKQUEUE_NR_PRIO)
+			continue;
+		nr = uatomic_read(&victim->qlen) / nr_workers;
+		if (!nr)
+			nr = 1;
+		count = workqueue_dequeue_batch(victim, prio, head, tail, nr);
+		if (!count)
+			continue;
+		uatomic_add_mo(&worker->qlen, count, CMM_RELAXED);
+		uatomic_sub_mo(&victim->qlen, count, CMM_RELAXED);
+		/* Have another worker share what is left. */
+		if (!worker_empty(victim))
+			wake_worker_thread(
+				&workqueue->workers[(self + 1) % nr_workers]);
+		break;
 	}
+	return count;
 }
 
-static void futex_wake_up(int32_t *futex)
+/*
+ * Take work from the queues of @worker, or else steal work, into the
+ * given queue. Without grace period function, work is taken one item at
+ * a time, leaving the rest to other workers, otherwise up to the batch
+ * budget. Returns whether work was taken.
+ */
+static int workqueue_take(struct urcu_workqueue_worker *worker,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail)
 {
-	/* Write to condition before reading/writing futex */
-	cmm_smp_mb();
-	if (caa_unlikely(uatomic_read(futex) == -1)) {
-		uatomic_set(futex, 0);
-		if (futex_async(futex, FUTEX_WAKE, 1,
-				NULL, NULL, 0) < 0)
-			urcu_die(errno);
+	struct urcu_workqueue *workqueue = worker->workqueue;
+	unsigned long max = CMM_LOAD_SHARED(workqueue->batch_max);
+
+	if (!workqueue->grace_period_fct)
+		max = 1;
+	else if (!max)
+		max = ULONG_MAX;
+	if (workqueue_dequeue_prio(worker, head, tail, max))
+		return 1;
+	return workqueue_steal(worker, head, tail) != 0;
+}
+
+/*
+ * Execute up to WORKQUEUE_HIGH_BURST high priority work items queued on
+ * @worker. Returns the number of work items executed.
+ */
+static unsigned long workqueue_run_high(struct urcu_workqueue_worker *worker)
+{
+	struct cds_wfcq_queue *queue =
+		worker_queue(worker, URCU_WORKQUEUE_PRIO_HIGH);
+	struct cds_wfcq_node *node;
+	unsigned long count;
+
+	for (count = 0; count < WORKQUEUE_HIGH_BURST; count++) {
+		struct rcu_head *rhp;
+
+		node = cds_wfcq_dequeue_blocking(&queue->head, &queue->tail);
+		if (!node)
+			break;
+		rhp = caa_container_of(node, struct rcu_head, next);
+		rhp->func(rhp);
+	}
+	return count;
+}
+
+/*
+ * Execute the batch of work in the given queue. Without grace period
+ * function, high priority work queued meanwhile on @worker executes
+ * between the items of the batch, rather than behind the whole batch:
+ * work which needs a grace period only executes within a batch. Returns
+ * the number of work items executed.
+ */
+static unsigned long workqueue_run_batch(struct urcu_workqueue_worker *worker,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail)
+{
+	int preempt = !worker->workqueue->grace_period_fct;
+	struct cds_wfcq_node *cbs, *cbs_tmp_n;
+	unsigned long cbcount = 0;
+
+	__cds_wfcq_for_each_blocking_safe(head, tail, cbs, cbs_tmp_n) {
+		struct rcu_head *rhp;
+
+		if (preempt && !worker_queue_empty(worker,
+				URCU_WORKQUEUE_PRIO_HIGH))
+			cbcount += workqueue_run_high(worker);
+		rhp = caa_container_of(cbs, struct rcu_head, next);
+		rhp->func(rhp);
+		cbcount++;
+	}
+	return cbcount;
+}
+
+/*
+ * Execute the work of a pool worker until there is none left to take or
+ * steal, or pause is requested. batch_seq is odd while work is taken and
+ * executed.
+ */
+static void workqueue_run_pool(struct urcu_workqueue_worker *worker)
+{
+	struct urcu_workqueue *workqueue = worker->workqueue;
+
+	for (;;) {
+		struct cds_wfcq_head cbs_tmp_head;
+		struct cds_wfcq_tail cbs_tmp_tail;
+		unsigned long cbcount;
+		int taken;
+
+		if (worker == workqueue->workers)
+			(void) workqueue_run_timers(workqueue);
+		cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
+		uatomic_inc(&worker->batch_seq);
+		cmm_smp_mb__after_uatomic_add();
+		taken = workqueue_take(worker, &cbs_tmp_head, &cbs_tmp_tail);
+		if (taken) {
+			if (workqueue->grace_period_fct)
+				workqueue->grace_period_fct(workqueue, workqueue->priv);
+			cbcount = workqueue_run_batch(worker, &cbs_tmp_head,
+					&cbs_tmp_tail);
+			uatomic_sub_mo(&worker->qlen, cbcount, CMM_RELAXED);
+		}
+		cmm_smp_mb__before_uatomic_add();
+		uatomic_inc(&worker->batch_seq);
+		if (!taken
+		    || (uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSE))
+			break;
+	}
+}
+
+/*
+ * Delay before the next batch, so that work queued meanwhile is batched.
+ * RT workers poll the queue at that period, at least every ms.
+ */
+static void workqueue_batch_delay(struct urcu_workqueue *workqueue, int rt)
+{
+	unsigned int delay = CMM_LOAD_SHARED(workqueue->batch_delay_ms);
+
+	if (rt && !delay)
+		delay = 1;
+	if (delay)
+		(void) poll(NULL, 0, delay);
+}
+
+/*
+ * Idle wait of URCU_WORKQUEUE_BUSY_POLL workers: spin on the queue.
+ * Returns after WORKQUEUE_BUSY_POLL_SPINS rounds, for the caller to
+ * steal work, run timers and handle pause requests.
+ */
+static void workqueue_busy_poll(struct urcu_workqueue_worker *worker)
+{
+	struct urcu_workqueue *workqueue = worker->workqueue;
+	unsigned int i;
+
+	for (i = 0; i < WORKQUEUE_BUSY_POLL_SPINS; i++) {
+		if (!worker_empty(worker)
+		    || (uatomic_read(&workqueue->flags)
+			& (URCU_WORKQUEUE_STOP | URCU_WORKQUEUE_PAUSE)))
+			return;
+		caa_cpu_relax();
 	}
 }
 
@@ -170,27 +591,30 @@ static void futex_wake_up(int32_t *futex)
 static void *workqueue_thread(void *arg)
 {
 	unsigned long cbcount;
-	struct urcu_workqueue *workqueue = (struct urcu_workqueue *) arg;
+	struct urcu_workqueue_worker *worker = arg;
+	struct urcu_workqueue *workqueue = worker->workqueue;
+	struct urcu_placement_thread placement;
 	int rt = !!(uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_RT);
+	int busy_poll = !!(uatomic_read(&workqueue->flags)
+			& URCU_WORKQUEUE_BUSY_POLL);
+	int pool = workqueue->nr_workers > 1;
 
-	if (set_thread_cpu_affinity(workqueue))
+	memset(&placement, 0, sizeof(placement));
+	if (set_thread_cpu_affinity(worker, &placement))
 		urcu_die(errno);
 
 	if (workqueue->initialize_worker_fct)
 		workqueue->initialize_worker_fct(workqueue, workqueue->priv);
 
-	if (!rt) {
-		uatomic_dec(&workqueue->futex);
-		/* Decrement futex before reading workqueue */
-		cmm_smp_mb();
-	}
+	if (!rt)
+		cds_eventcount_prepare_wait(&worker->wait_ec);
 	for (;;) {
 		struct cds_wfcq_head cbs_tmp_head;
 		struct cds_wfcq_tail cbs_tmp_tail;
-		struct cds_wfcq_node *cbs, *cbs_tmp_n;
-		enum cds_wfcq_ret splice_ret;
+		unsigned long max, taken;
+		int full = 0;
 
-		if (set_thread_cpu_affinity(workqueue))
+		if (set_thread_cpu_affinity(worker, &placement))
 			urcu_die(errno);
 
 		if (uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSE) {
@@ -203,55 +627,52 @@ static void *workqueue_thread(void *arg)
 			if (workqueue->worker_before_pause_fct)
 				workqueue->worker_before_pause_fct(workqueue, workqueue->priv);
 			cmm_smp_mb__before_uatomic_or();
-			uatomic_or(&workqueue->flags, URCU_WORKQUEUE_PAUSED);
+			uatomic_or(&worker->flags, URCU_WORKQUEUE_PAUSED);
 			while ((uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSE) != 0)
 				(void) poll(NULL, 0, 1);
-			uatomic_and(&workqueue->flags, ~URCU_WORKQUEUE_PAUSED);
+			uatomic_and(&worker->flags, ~URCU_WORKQUEUE_PAUSED);
 			cmm_smp_mb__after_uatomic_and();
 			if (workqueue->worker_after_resume_fct)
 				workqueue->worker_after_resume_fct(workqueue, workqueue->priv);
 		}
 
+		if (pool) {
+			workqueue_run_pool(worker);
+			goto wait;
+		}
+		(void) workqueue_run_timers(workqueue);
 		cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
-		splice_ret = __cds_wfcq_splice_blocking(&cbs_tmp_head,
-			&cbs_tmp_tail, &workqueue->cbs_head, &workqueue->cbs_tail);
-		assert(splice_ret != CDS_WFCQ_RET_WOULDBLOCK);
-		assert(splice_ret != CDS_WFCQ_RET_DEST_NON_EMPTY);
-		if (splice_ret != CDS_WFCQ_RET_SRC_EMPTY) {
+		max = CMM_LOAD_SHARED(workqueue->batch_max);
+		/* With a bound, leave the rest for the next batch, right away. */
+		taken = workqueue_dequeue_prio(worker, &cbs_tmp_head,
+				&cbs_tmp_tail, max ? max : ULONG_MAX);
+		full = max && taken >= max;
+		if (taken) {
 			if (workqueue->grace_period_fct)
 				workqueue->grace_period_fct(workqueue, workqueue->priv);
-			cbcount = 0;
-			__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head,
-					&cbs_tmp_tail, cbs, cbs_tmp_n) {
-				struct rcu_head *rhp;
-
-				rhp = caa_container_of(cbs,
-					struct rcu_head, next);
-				rhp->func(rhp);
-				cbcount++;
-			}
-			uatomic_sub(&workqueue->qlen, cbcount);
+			cbcount = workqueue_run_batch(worker, &cbs_tmp_head,
+					&cbs_tmp_tail);
+			uatomic_sub_mo(&worker->qlen, cbcount, CMM_RELAXED);
 		}
+	wait:
 		if (uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_STOP)
 			break;
 		if (workqueue->worker_before_wait_fct)
 			workqueue->worker_before_wait_fct(workqueue, workqueue->priv);
-		if (!rt) {
-			if (cds_wfcq_empty(&workqueue->cbs_head,
-					&workqueue->cbs_tail)) {
-				futex_wait(&workqueue->futex);
-				(void) poll(NULL, 0, 10);
-				uatomic_dec(&workqueue->futex);
-				/*
-				 * Decrement futex before reading
-				 * call_rcu list.
-				 */
-				cmm_smp_mb();
-			} else {
-				(void) poll(NULL, 0, 10);
+		if (busy_poll) {
+			if (!full)
+				workqueue_busy_poll(worker);
+		} else if (!rt) {
+			if (worker_empty(worker)) {
+				/* Execute due delayed work right away. */
+				if (!workqueue_wait(worker))
+					workqueue_batch_delay(workqueue, rt);
+				cds_eventcount_prepare_wait(&worker->wait_ec);
+			} else if (!full) {
+				workqueue_batch_delay(workqueue, rt);
 			}
-		} else {
-			(void) poll(NULL, 0, 10);
+		} else if (!full) {
+			workqueue_batch_delay(workqueue, rt);
 		}
 		if (workqueue->worker_after_wake_up_fct)
 			workqueue->worker_after_wake_up_fct(workqueue, workqueue->priv);
@@ -261,15 +682,25 @@ static void *workqueue_thread(void *arg)
 		 * Read call_rcu list before write futex.
 		 */
 		cmm_smp_mb();
-		uatomic_set(&workqueue->futex, 0);
+		cds_eventcount_cancel_wait(&worker->wait_ec);
 	}
 	if (workqueue->finalize_worker_fct)
 		workqueue->finalize_worker_fct(workqueue, workqueue->priv);
 	return NULL;
 }
 
-struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
-		int cpu_affinity, void *priv,
+static void create_worker_thread(struct urcu_workqueue_worker *worker)
+{
+	int ret;
+
+	ret = pthread_create(&worker->tid, NULL, workqueue_thread, worker);
+	if (ret) {
+		urcu_die(ret);
+	}
+}
+
+struct urcu_workqueue *urcu_workqueue_create_pool(unsigned int nr_workers,
+		unsigned long flags, int cpu_affinity, void *priv,
 		void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*finalize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
@@ -279,15 +710,36 @@ struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
 		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv))
 {
 	struct urcu_workqueue *workqueue;
-	int ret;
+	unsigned int i;
 
-	workqueue = malloc(sizeof(*workqueue));
+	assert(nr_workers);
+	workqueue = urcu_malloc(sizeof(*workqueue));
 	if (workqueue == NULL)
 		urcu_die(errno);
 	memset(workqueue, '\0', sizeof(*workqueue));
-	cds_wfcq_init(&workqueue->cbs_head, &workqueue->cbs_tail);
-	workqueue->qlen = 0;
-	workqueue->futex = 0;
+	if (urcu_posix_memalign((void **) &workqueue->workers,
+			CAA_CACHE_LINE_SIZE,
+			nr_workers * sizeof(*workqueue->workers)))
+		urcu_die(ENOMEM);
+	memset(workqueue->workers, '\0',
+		nr_workers * sizeof(*workqueue->workers));
+	for (i = 0; i < nr_workers; i++) {
+		struct urcu_workqueue_worker *worker = &workqueue->workers[i];
+		int prio;
+
+		for (prio = 0; prio < URCU_WORKQUEUE_NR_PRIO; prio++)
+			cds_wfcq_init(&worker->cbs[prio].head,
+					&worker->cbs[prio].tail);
+		worker->cpu_affinity = cpu_affinity < 0 ? -1 : cpu_affinity + i;
+		worker->workqueue = workqueue;
+	}
+	workqueue->nr_workers = nr_workers;
+	pthread_mutex_init(&workqueue->timer_lock, NULL);
+	workqueue->batch_delay_ms = URCU_WORKQUEUE_BATCH_DELAY_MS;
+	urcu_placement_init(&workqueue->placement);
+	/* Busy-polling workers are never woken up either. */
+	if (flags & URCU_WORKQUEUE_BUSY_POLL)
+		flags |= URCU_WORKQUEUE_RT;
 	workqueue->flags = flags;
 	workqueue->priv = priv;
 	workqueue->grace_period_fct = grace_period_fct;
@@ -297,63 +749,208 @@ struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
 	workqueue->worker_after_wake_up_fct = worker_after_wake_up_fct;
 	workqueue->worker_before_pause_fct = worker_before_pause_fct;
 	workqueue->worker_after_resume_fct = worker_after_resume_fct;
-	workqueue->cpu_affinity = cpu_affinity;
-	workqueue->loop_count = 0;
 	cmm_smp_mb();  /* Structure initialized before pointer is planted. */
-	ret = pthread_create(&workqueue->tid, NULL, workqueue_thread, workqueue);
-	if (ret) {
-		urcu_die(ret);
-	}
+	for (i = 0; i < nr_workers; i++)
+		create_worker_thread(&workqueue->workers[i]);
 	return workqueue;
 }
 
-static void wake_worker_thread(struct urcu_workqueue *workqueue)
+struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
+		int cpu_affinity, void *priv,
+		void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*finalize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_wait_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_pause_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv))
+{
+	return urcu_workqueue_create_pool(1, flags, cpu_affinity, priv,
+			grace_period_fct, initialize_worker_fct,
+			finalize_worker_fct, worker_before_wait_fct,
+			worker_after_wake_up_fct, worker_before_pause_fct,
+			worker_after_resume_fct);
+}
+
+static void wake_worker_threads(struct urcu_workqueue *workqueue)
 {
-	if (!(_CMM_LOAD_SHARED(workqueue->flags) & URCU_CALL_RCU_RT))
-		futex_wake_up(&workqueue->futex);
+	unsigned int i;
+
+	for (i = 0; i < workqueue->nr_workers; i++)
+		wake_worker_thread(&workqueue->workers[i]);
 }
 
 static int urcu_workqueue_destroy_worker(struct urcu_workqueue *workqueue)
 {
+	unsigned int i;
 	int ret;
 	void *retval;
 
 	uatomic_or(&workqueue->flags, URCU_WORKQUEUE_STOP);
-	wake_worker_thread(workqueue);
+	wake_worker_threads(workqueue);
 
-	ret = pthread_join(workqueue->tid, &retval);
-	if (ret) {
-		urcu_die(ret);
-	}
-	if (retval != NULL) {
-		urcu_die(EINVAL);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		ret = pthread_join(workqueue->workers[i].tid, &retval);
+		if (ret) {
+			urcu_die(ret);
+		}
+		if (retval != NULL) {
+			urcu_die(EINVAL);
+		}
+		workqueue->workers[i].tid = 0;
 	}
 	workqueue->flags &= ~URCU_WORKQUEUE_STOP;
-	workqueue->tid = 0;
 	return 0;
 }
 
 void urcu_workqueue_destroy(struct urcu_workqueue *workqueue)
 {
+	unsigned int i;
+
 	if (workqueue == NULL) {
 		return;
 	}
 	if (urcu_workqueue_destroy_worker(workqueue)) {
 		urcu_die(errno);
 	}
-	assert(cds_wfcq_empty(&workqueue->cbs_head, &workqueue->cbs_tail));
-	free(workqueue);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		struct urcu_workqueue_worker *worker = &workqueue->workers[i];
+		int prio;
+
+		assert(worker_empty(worker));
+		for (prio = 0; prio < URCU_WORKQUEUE_NR_PRIO; prio++)
+			cds_wfcq_destroy(&worker->cbs[prio].head,
+					&worker->cbs[prio].tail);
+	}
+	assert(!workqueue->nr_timers);
+	urcu_free(workqueue->timers);
+	(void) pthread_mutex_destroy(&workqueue->timer_lock);
+	urcu_placement_destroy(&workqueue->placement);
+	urcu_free(workqueue->workers);
+	urcu_free(workqueue);
+}
+
+/*
+ * Queue work on the worker of the current CPU. If that worker already
+ * has work queued, wake up the next worker as well, to steal it.
+ */
+void urcu_workqueue_queue_work_prio(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work),
+		enum urcu_workqueue_prio prio)
+{
+	unsigned int nr_workers = workqueue->nr_workers, i = 0;
+	unsigned long qlen;
+	int cpu;
+
+	assert(prio >= 0 && prio < URCU_WORKQUEUE_NR_PRIO);
+	if (nr_workers > 1) {
+		cpu = urcu_sched_getcpu();
+		if (cpu < 0)
+			cpu = URCU_TLS(workqueue_next_worker)++;
+		i = (unsigned int) cpu % nr_workers;
+	}
+	work->func = func;
+	qlen = worker_enqueue(&workqueue->workers[i], work, prio);
+	if (nr_workers > 1 && qlen > 1)
+		wake_worker_thread(&workqueue->workers[(i + 1) % nr_workers]);
 }
 
 void urcu_workqueue_queue_work(struct urcu_workqueue *workqueue,
 		      struct urcu_work *work,
 		      void (*func)(struct urcu_work *work))
 {
-	cds_wfcq_node_init(&work->next);
+	urcu_workqueue_queue_work_prio(workqueue, work, func,
+			URCU_WORKQUEUE_PRIO_NORMAL);
+}
+
+/* Approximate: the queue lengths are read without synchronization. */
+unsigned long urcu_workqueue_get_backlog(struct urcu_workqueue *workqueue)
+{
+	unsigned long backlog;
+	unsigned int i;
+
+	backlog = uatomic_read(&workqueue->nr_timers);
+	for (i = 0; i < workqueue->nr_workers; i++)
+		backlog += uatomic_read(&workqueue->workers[i].qlen);
+	return backlog;
+}
+
+int urcu_workqueue_set_placement(struct urcu_workqueue *workqueue,
+		const struct call_rcu_placement *placement)
+{
+	struct urcu_placement p;
+	unsigned int i;
+	int ret;
+
+	ret = urcu_placement_resolve(&p, placement);
+	if (ret)
+		return ret;
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		ret = urcu_placement_set_sched(&p, workqueue->workers[i].tid);
+		if (ret)
+			return ret;
+	}
+	urcu_placement_update(&workqueue->placement, &p);
+	wake_worker_threads(workqueue);
+	return 0;
+}
+
+void urcu_workqueue_set_batch(struct urcu_workqueue *workqueue,
+		unsigned int delay_ms, unsigned long max_items)
+{
+	CMM_STORE_SHARED(workqueue->batch_delay_ms, delay_ms);
+	CMM_STORE_SHARED(workqueue->batch_max, max_items);
+}
+
+void urcu_workqueue_queue_delayed_work(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work),
+		uint64_t delay_ns)
+{
+	int first;
+
 	work->func = func;
-	cds_wfcq_enqueue(&workqueue->cbs_head, &workqueue->cbs_tail, &work->next);
-	uatomic_inc(&workqueue->qlen);
-	wake_worker_thread(workqueue);
+	work->expires_ns = urcu_time_ns() + delay_ns;
+	mutex_lock(&workqueue->timer_lock);
+	if (workqueue->nr_timers == workqueue->alloc_timers) {
+		unsigned long alloc = workqueue->alloc_timers ?
+				2 * workqueue->alloc_timers : 16;
+		struct urcu_work **timers;
+
+		timers = urcu_realloc(workqueue->timers,
+				alloc * sizeof(*timers));
+		if (!timers)
+			urcu_die(errno);
+		workqueue->timers = timers;
+		workqueue->alloc_timers = alloc;
+	}
+	workqueue->timers[workqueue->nr_timers] = work;
+	timer_heap_up(workqueue->timers, workqueue->nr_timers);
+	CMM_STORE_SHARED(workqueue->nr_timers, workqueue->nr_timers + 1);
+	first = workqueue->timers[0] == work;
+	mutex_unlock(&workqueue->timer_lock);
+	/* Have the first worker wait for the new earliest expiry. */
+	if (first)
+		wake_worker_thread(&workqueue->workers[0]);
+}
+
+int urcu_workqueue_cancel_delayed_work(struct urcu_workqueue *workqueue,
+		struct urcu_work *work)
+{
+	unsigned long i;
+	int ret = 0;
+
+	mutex_lock(&workqueue->timer_lock);
+	for (i = 0; i < workqueue->nr_timers; i++) {
+		if (workqueue->timers[i] == work) {
+			timer_heap_remove(workqueue, i);
+			ret = 1;
+			break;
+		}
+	}
+	mutex_unlock(&workqueue->timer_lock);
+	return ret;
 }
 
 static
@@ -362,7 +959,7 @@ void free_completion(struct urcu_ref *ref)
 	struct urcu_workqueue_completion *completion;
 
 	completion = caa_container_of(ref, struct urcu_workqueue_completion, ref);
-	free(completion);
+	urcu_free(completion);
 }
 
 static
@@ -374,16 +971,16 @@ void _urcu_workqueue_wait_complete(struct urcu_work *work)
 	completion_work = caa_container_of(work, struct urcu_workqueue_completion_work, work);
 	completion = completion_work->completion;
 	if (!uatomic_sub_return(&completion->barrier_count, 1))
-		futex_wake_up(&completion->futex);
+		eventcount_wake_up(&completion->ec);
 	urcu_ref_put(&completion->ref, free_completion);
-	free(completion_work);
+	urcu_free(completion_work);
 }
 
 struct urcu_workqueue_completion *urcu_workqueue_create_completion(void)
 {
 	struct urcu_workqueue_completion *completion;
 
-	completion = calloc(sizeof(*completion), 1);
+	completion = urcu_calloc(sizeof(*completion), 1);
 	if (!completion)
 		urcu_die(errno);
 	urcu_ref_set(&completion->ref, 1);
@@ -400,35 +997,52 @@ void urcu_workqueue_wait_completion(struct urcu_workqueue_completion *completion
 {
 	/* Wait for them */
 	for (;;) {
-		uatomic_dec(&completion->futex);
-		/* Decrement futex before reading barrier_count */
-		cmm_smp_mb();
+		cds_eventcount_prepare_wait(&completion->ec);
 		if (!uatomic_read(&completion->barrier_count))
 			break;
-		futex_wait(&completion->futex);
+		eventcount_wait(&completion->ec);
 	}
 }
 
+/*
+ * Queue a completion work item on each queue of each worker, after the
+ * work already queued on it: the queues of different priorities are
+ * executed out of order.
+ */
 void urcu_workqueue_queue_completion(struct urcu_workqueue *workqueue,
 		struct urcu_workqueue_completion *completion)
 {
 	struct urcu_workqueue_completion_work *work;
+	unsigned int i;
+	int prio;
 
-	work = calloc(sizeof(*work), 1);
-	if (!work)
-		urcu_die(errno);
-	work->completion = completion;
-	urcu_ref_get(&completion->ref);
-	uatomic_inc(&completion->barrier_count);
-	urcu_workqueue_queue_work(workqueue, &work->work, _urcu_workqueue_wait_complete);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		for (prio = 0; prio < URCU_WORKQUEUE_NR_PRIO; prio++) {
+			work = urcu_calloc(sizeof(*work), 1);
+			if (!work)
+				urcu_die(errno);
+			work->completion = completion;
+			urcu_ref_get(&completion->ref);
+			uatomic_inc(&completion->barrier_count);
+			work->work.func = _urcu_workqueue_wait_complete;
+			(void) worker_enqueue(&workqueue->workers[i],
+					&work->work, prio);
+		}
+	}
 }
 
 /*
  * Wait for all in-flight work to complete execution.
+ *
+ * In a pool, once the completion work items have executed, the work
+ * queued before them has been taken, but may still execute on other
+ * workers: also wait for the work each worker is executing.
  */
 void urcu_workqueue_flush_queued_work(struct urcu_workqueue *workqueue)
 {
 	struct urcu_workqueue_completion *completion;
+	unsigned long batch_seq;
+	unsigned int i;
 
 	completion = urcu_workqueue_create_completion();
 	if (!completion)
@@ -436,37 +1050,170 @@ void urcu_workqueue_flush_queued_work(struct urcu_workqueue *workqueue)
 	urcu_workqueue_queue_completion(workqueue, completion);
 	urcu_workqueue_wait_completion(completion);
 	urcu_workqueue_destroy_completion(completion);
+	if (workqueue->nr_workers == 1)
+		return;
+	/* Read completion before reading the batches. */
+	cmm_smp_mb();
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		struct urcu_workqueue_worker *worker = &workqueue->workers[i];
+
+		batch_seq = uatomic_read(&worker->batch_seq);
+		if (!(batch_seq & 1))
+			continue;
+		while (uatomic_read(&worker->batch_seq) == batch_seq)
+			(void) poll(NULL, 0, 1);
+	}
+	/* Read the batches before the data of the work items. */
+	cmm_smp_mb();
+}
+
+/*
+ * Shared by the caller of urcu_workqueue_parallel_for() and its work
+ * items, freed by the last of them. The completion counts the chunks
+ * left to execute.
+ */
+struct urcu_workqueue_parallel_for {
+	void (*fn)(unsigned long chunk, void *priv);
+	void *priv;
+	unsigned long nr_chunks;
+	unsigned long next_chunk;
+	struct urcu_workqueue_completion *completion;
+	struct urcu_ref ref;
+};
+
+struct urcu_workqueue_parallel_for_work {
+	struct urcu_work work;
+	struct urcu_workqueue_parallel_for *pf;
+};
+
+static
+void free_parallel_for(struct urcu_ref *ref)
+{
+	struct urcu_workqueue_parallel_for *pf;
+
+	pf = caa_container_of(ref, struct urcu_workqueue_parallel_for, ref);
+	urcu_workqueue_destroy_completion(pf->completion);
+	urcu_free(pf);
+}
+
+/* Execute chunks until none is left. */
+static
+void parallel_for_run(struct urcu_workqueue_parallel_for *pf)
+{
+	unsigned long chunk;
+
+	for (;;) {
+		chunk = uatomic_add_return(&pf->next_chunk, 1) - 1;
+		if (chunk >= pf->nr_chunks)
+			break;
+		pf->fn(chunk, pf->priv);
+		if (!uatomic_sub_return(&pf->completion->barrier_count, 1))
+			eventcount_wake_up(&pf->completion->ec);
+	}
+}
+
+static
+void _urcu_workqueue_parallel_for(struct urcu_work *work)
+{
+	struct urcu_workqueue_parallel_for_work *pf_work;
+	struct urcu_workqueue_parallel_for *pf;
+
+	pf_work = caa_container_of(work,
+		struct urcu_workqueue_parallel_for_work, work);
+	pf = pf_work->pf;
+	urcu_free(pf_work);
+	parallel_for_run(pf);
+	urcu_ref_put(&pf->ref, free_parallel_for);
+}
+
+void urcu_workqueue_parallel_for(struct urcu_workqueue *workqueue,
+		unsigned long nr_chunks,
+		void (*fn)(unsigned long chunk, void *priv), void *priv)
+{
+	struct urcu_workqueue_parallel_for_work *pf_work;
+	struct urcu_workqueue_parallel_for *pf;
+	unsigned long nr_works, i;
+
+	if (!nr_chunks)
+		return;
+	pf = urcu_calloc(sizeof(*pf), 1);
+	if (!pf)
+		urcu_die(errno);
+	pf->fn = fn;
+	pf->priv = priv;
+	pf->nr_chunks = nr_chunks;
+	pf->completion = urcu_workqueue_create_completion();
+	pf->completion->barrier_count = nr_chunks;
+	urcu_ref_set(&pf->ref, 1);
+	/* The caller executes one of the chunks. */
+	nr_works = nr_chunks - 1;
+	if (nr_works > workqueue->nr_workers)
+		nr_works = workqueue->nr_workers;
+	for (i = 0; i < nr_works; i++) {
+		pf_work = urcu_calloc(sizeof(*pf_work), 1);
+		if (!pf_work)
+			urcu_die(errno);
+		pf_work->pf = pf;
+		urcu_ref_get(&pf->ref);
+		/*
+		 * One work item per worker, each queued on its own, ahead
+		 * of background work: the caller waits for them.
+		 */
+		pf_work->work.func = _urcu_workqueue_parallel_for;
+		(void) worker_enqueue(&workqueue->workers[i], &pf_work->work,
+				URCU_WORKQUEUE_PRIO_HIGH);
+	}
+	parallel_for_run(pf);
+	urcu_workqueue_wait_completion(pf->completion);
+	/* Read the completion before the data written by the chunks. */
+	cmm_smp_mb();
+	urcu_ref_put(&pf->ref, free_parallel_for);
 }
 
 /* To be used in before fork handler. */
 void urcu_workqueue_pause_worker(struct urcu_workqueue *workqueue)
 {
+	unsigned int i;
+
 	uatomic_or(&workqueue->flags, URCU_WORKQUEUE_PAUSE);
 	cmm_smp_mb__after_uatomic_or();
-	wake_worker_thread(workqueue);
+	wake_worker_threads(workqueue);
 
-	while ((uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSED) == 0)
-		(void) poll(NULL, 0, 1);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		while ((uatomic_read(&workqueue->workers[i].flags)
+				& URCU_WORKQUEUE_PAUSED) == 0)
+			(void) poll(NULL, 0, 1);
+	}
+	/* Held across fork, released by resume or create_worker. */
+	mutex_lock(&workqueue->timer_lock);
 }
 
 /* To be used in after fork parent handler. */
 void urcu_workqueue_resume_worker(struct urcu_workqueue *workqueue)
 {
+	unsigned int i;
+
+	mutex_unlock(&workqueue->timer_lock);
 	uatomic_and(&workqueue->flags, ~URCU_WORKQUEUE_PAUSE);
-	while ((uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSED) != 0)
-		(void) poll(NULL, 0, 1);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		while ((uatomic_read(&workqueue->workers[i].flags)
+				& URCU_WORKQUEUE_PAUSED) != 0)
+			(void) poll(NULL, 0, 1);
+	}
 }
 
 void urcu_workqueue_create_worker(struct urcu_workqueue *workqueue)
 {
-	int ret;
+	unsigned int i;
 
 	/* Clear workqueue state from parent. */
-	workqueue->flags &= ~URCU_WORKQUEUE_PAUSED;
+	mutex_unlock(&workqueue->timer_lock);
 	workqueue->flags &= ~URCU_WORKQUEUE_PAUSE;
-	workqueue->tid = 0;
-	ret = pthread_create(&workqueue->tid, NULL, workqueue_thread, workqueue);
-	if (ret) {
-		urcu_die(ret);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		struct urcu_workqueue_worker *worker = &workqueue->workers[i];
+
+		worker->flags &= ~URCU_WORKQUEUE_PAUSED;
+		worker->tid = 0;
+		create_worker_thread(worker);
 	}
 }
@@ -25,6 +25,7 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <pthread.h>
 
 #include <urcu/wfcqueue.h>
@@ -37,6 +38,7 @@ extern "C" {
 
 struct urcu_workqueue;
 struct urcu_workqueue_completion;
+struct call_rcu_placement;
 
 /* Flag values. */
 
@@ -44,6 +46,11 @@ struct urcu_workqueue_completion;
 #define URCU_WORKQUEUE_STOP	(1U << 1)
 #define URCU_WORKQUEUE_PAUSE	(1U << 2)
 #define URCU_WORKQUEUE_PAUSED	(1U << 3)
+/*
+ * Idle workers spin on their queue instead of sleeping, for workers
+ * running on dedicated CPUs. Implies URCU_WORKQUEUE_RT.
+ */
+#define URCU_WORKQUEUE_BUSY_POLL	(1U << 4)
 
 /*
  * The urcu_work data structure is placed in the structure to be acted
@@ -53,6 +60,7 @@ struct urcu_workqueue_completion;
 struct urcu_work {
 	struct cds_wfcq_node next;
 	void (*func)(struct urcu_work *head);
+	uint64_t expires_ns;	/* delayed work only */
 };
 
 /*
@@ -68,6 +76,22 @@ struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
 		void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*worker_before_pause_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv));
+/*
+ * Create a workqueue with nr_workers worker threads, each with its own
+ * queue. Work is queued on the worker of the CPU of the caller, and
+ * workers finding their queue empty steal the queue of another worker:
+ * work items may execute in any order and concurrently. If cpu_affinity
+ * is not -1, worker i is affine to CPU cpu_affinity + i.
+ */
+struct urcu_workqueue *urcu_workqueue_create_pool(unsigned int nr_workers,
+		unsigned long flags, int cpu_affinity, void *priv,
+		void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*finalize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_wait_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_pause_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv));
 void urcu_workqueue_destroy(struct urcu_workqueue *workqueue);
 
 /*
@@ -78,6 +102,68 @@ void urcu_workqueue_queue_work(struct urcu_workqueue *workqueue,
 		struct urcu_work *work,
 		void (*func)(struct urcu_work *work));
 
+/*
+ * Priority classes of work. Workers execute the high priority work
+ * queued on them first, and, without grace period function, between
+ * the items of a batch too. Low priority work executes when there is no
+ * other, and at least once every few batches otherwise, so that it is
+ * not starved. Work of different classes executes out of order.
+ */
+enum urcu_workqueue_prio {
+	URCU_WORKQUEUE_PRIO_HIGH = 0,
+	URCU_WORKQUEUE_PRIO_NORMAL,
+	URCU_WORKQUEUE_PRIO_LOW,
+	URCU_WORKQUEUE_NR_PRIO,
+};
+
+/*
+ * Same as urcu_workqueue_queue_work, which queues work with
+ * URCU_WORKQUEUE_PRIO_NORMAL, with the priority class @prio.
+ */
+void urcu_workqueue_queue_work_prio(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work),
+		enum urcu_workqueue_prio prio);
+
+/*
+ * Set the CPUs the workers run on, and their scheduling policy, as
+ * call_rcu_data_set_placement(). With CALL_RCU_PLACE_CPU_AFFINITY,
+ * workers keep the affinity they were created with.
+ */
+int urcu_workqueue_set_placement(struct urcu_workqueue *workqueue,
+		const struct call_rcu_placement *placement);
+
+/*
+ * Set the delay between batches of work, in ms (10 by default). Work
+ * queued while a batch executes, or during the delay, is executed in the
+ * next batch; 0 executes work as soon as possible. RT workqueues poll
+ * their queue at that period, at least every ms. max_items bounds the
+ * number of work items of a batch, so that work queued behind a large
+ * batch is not postponed by the delay: a full batch is followed by the
+ * next one right away. 0 (the default) means no bound.
+ */
+void urcu_workqueue_set_batch(struct urcu_workqueue *workqueue,
+		unsigned int delay_ms, unsigned long max_items);
+
+/*
+ * Queue work to be executed once delay_ns nanoseconds have elapsed.
+ * Never fails. Delayed work not yet due is not waited for by
+ * urcu_workqueue_flush_queued_work(), and must be cancelled before the
+ * workqueue is destroyed.
+ */
+void urcu_workqueue_queue_delayed_work(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work),
+		uint64_t delay_ns);
+
+/*
+ * Cancel delayed work which is not due yet. Returns 1 if cancelled, 0 if
+ * the work was not pending: it may then be queued or executing.
+ * Linear in the number of delayed work items.
+ */
+int urcu_workqueue_cancel_delayed_work(struct urcu_workqueue *workqueue,
+		struct urcu_work *work);
+
 struct urcu_workqueue_completion *urcu_workqueue_create_completion(void);
 void urcu_workqueue_destroy_completion(struct urcu_workqueue_completion *completion);
 
@@ -87,6 +173,20 @@ void urcu_workqueue_wait_completion(struct urcu_workqueue_completion *completion
 
 void urcu_workqueue_flush_queued_work(struct urcu_workqueue *workqueue);
 
+/*
+ * Call fn(chunk, priv) for each chunk of [0, nr_chunks), on the workers
+ * of the workqueue and on the calling thread, which returns once all
+ * the calls returned. The chunks are handed out one at a time to the
+ * threads which are free, so the caller completes them all itself if
+ * the workers are busy: it may run on a worker of the workqueue.
+ */
+void urcu_workqueue_parallel_for(struct urcu_workqueue *workqueue,
+		unsigned long nr_chunks,
+		void (*fn)(unsigned long chunk, void *priv), void *priv);
+
+/* Number of queued and delayed works not executed yet. */
+unsigned long urcu_workqueue_get_backlog(struct urcu_workqueue *workqueue);
+
 /*
  * pause/resume/create worker threads. Can be used to pause worker
  * threads across fork/clone while keeping the workqueue in place.
@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Compare the callback latency of the call_rcu and workqueue worker
+# modes: default, real-time and busy-polling. Prints one
+# CALLBACK_LATENCY line of key=value pairs per run, for regression
+# tracking. Busy-polling workers are best affine to an idle CPU, set
+# with CALLBACK_LATENCY_CPU.
+
+# 1st parameter: seconds per run
+DURATION=$1
+
+if [ "x${DURATION}" = "x" ]; then
+	echo "usage: $0 [DURATION]"
+	exit 1
+fi
+
+MODES=${CALLBACK_LATENCY_MODES:-"default rt busy"}
+DELAYS=${CALLBACK_LATENCY_DELAYS:-"0 1000"}
+AFFINITY=${CALLBACK_LATENCY_CPU:+-a ${CALLBACK_LATENCY_CPU}}
+
+for queue in "" "-q"; do
+	for mode in ${MODES}; do
+		for delay in ${DELAYS}; do
+			./test_callback_latency ${DURATION} -m ${mode} \
+				-d ${delay} ${queue} ${AFFINITY} || exit 1
+		done
+	done
+done
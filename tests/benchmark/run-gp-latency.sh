@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Sweep the grace period latency benchmark over flavors, reader counts
+# and read-side critical section lengths. Prints one GP_LATENCY line of
+# key=value pairs per run, for regression tracking.
+
+# 1st parameter: seconds per run
+DURATION=$1
+
+if [ "x${DURATION}" = "x" ]; then
+	echo "usage: $0 [DURATION]"
+	exit 1
+fi
+
+FLAVORS=${GP_LATENCY_FLAVORS:-"mb memb signal qsbr bp percpu"}
+READERS=${GP_LATENCY_READERS:-"1 2 4 8 16"}
+RDURS=${GP_LATENCY_RDURS:-"0 100 10000"}
+
+for flavor in ${FLAVORS}; do
+	for readers in ${READERS}; do
+		for rdur in ${RDURS}; do
+			./test_urcu_gp_latency_${flavor} ${readers} \
+				${DURATION} -c ${rdur} || exit 1
+		done
+	done
+done
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Sweep the read and write throughput of cds_lfht and of the baseline
+# maps of test_urcu_hash -p over reader counts, with the same key pools.
+# Prints one CSV dataset, one row per run.
+
+# 1st parameter: seconds per run
+# 2nd parameter: maximum number of readers (default: online CPUs)
+DURATION=$1
+MAX_THREADS=${2:-$(getconf _NPROCESSORS_ONLN)}
+
+if [ "x${DURATION}" = "x" ]; then
+	echo "usage: $0 [DURATION] [MAX_THREADS]"
+	exit 1
+fi
+
+MAPS=${HASH_MAPS:-"lfht mutex rwlock rculist rcuhtable"}
+WRITERS=${HASH_MAP_WRITERS:-"1"}
+POOL=${HASH_MAP_POOL:-"65536"}
+
+# The baselines are sized for all the keys: let cds_lfht resize (-A).
+MAP_ARGS="-A -k $(( POOL / 2 )) -O ${POOL} -M ${POOL} -N ${POOL}"
+
+thread_counts()
+{
+	local n
+
+	{
+		for (( n = 1; n <= MAX_THREADS; n *= 2 )); do
+			echo ${n}
+		done
+		echo ${MAX_THREADS}
+	} | sort -n -u
+}
+
+# Value of a key of the --format=csv output on stdin.
+csv_value()
+{
+	awk -F, -v section="$1" -v key="$2" \
+		'$2 == section && $3 == key { print $4 }'
+}
+
+echo "map,nr_readers,nr_writers,duration_s,reader_ops_per_s,writer_ops_per_s,ops_per_s"
+for map in ${MAPS}; do
+	for writers in ${WRITERS}; do
+		for readers in $(thread_counts); do
+			out=$(./test_urcu_hash ${readers} ${writers} ${DURATION} \
+				-p ${map} ${MAP_ARGS} --format=csv "${@:3}") || exit 1
+			echo "${map},${readers},${writers},${DURATION}," \
+				"$(echo "${out}" | csv_value throughput reader_ops_per_s)," \
+				"$(echo "${out}" | csv_value throughput writer_ops_per_s)," \
+				"$(echo "${out}" | csv_value throughput ops_per_s)" \
+				| tr -d ' '
+		done
+	done
+done
@@ -0,0 +1,13 @@
+#!/bin/bash
+
+# Print the read-side overhead of each RCU flavor, with the primitives
+# inlined and called in the shared library. Arguments are passed to
+# the benchmarks, e.g. "-a 0" to pin them on CPU 0.
+
+FLAVORS=${OVERHEAD_FLAVORS:-"mb memb signal qsbr bp percpu"}
+
+for flavor in ${FLAVORS}; do
+	for link in "" "_dynlink"; do
+		./test_read_overhead_${flavor}${link} "$@" || exit 1
+	done
+done
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# Sweep the read-side throughput of each RCU flavor and of the locking
+# baselines over reader counts. Prints one CSV dataset, one row per
+# run, to plot throughput against the number of threads.
+
+# 1st parameter: seconds per run
+# 2nd parameter: maximum number of readers (default: online CPUs)
+DURATION=$1
+MAX_THREADS=${2:-$(getconf _NPROCESSORS_ONLN)}
+
+if [ "x${DURATION}" = "x" ]; then
+	echo "usage: $0 [DURATION] [MAX_THREADS]"
+	exit 1
+fi
+
+FLAVORS=${SCALE_FLAVORS:-"mb memb signal qsbr bp rwlock mutex perthreadlock"}
+WRITERS=${SCALE_WRITERS:-"1"}
+
+# Powers of two, and multiples of the number of CPUs per package, so the
+# curves show where each flavor stops scaling across sockets.
+thread_counts()
+{
+	local n packages per_package
+
+	packages=$(cat /sys/devices/system/cpu/cpu*/topology/physical_package_id \
+		2>/dev/null | sort -u | wc -l)
+	per_package=0
+	if [ "${packages}" -gt 1 ]; then
+		per_package=$(( $(getconf _NPROCESSORS_ONLN) / packages ))
+	fi
+	{
+		for (( n = 1; n <= MAX_THREADS; n *= 2 )); do
+			echo ${n}
+		done
+		if [ "${per_package}" -gt 0 ]; then
+			for (( n = per_package; n <= MAX_THREADS; n += per_package )); do
+				echo ${n}
+			done
+		fi
+		echo ${MAX_THREADS}
+	} | sort -n -u
+}
+
+program()
+{
+	case $1 in
+	memb) echo test_urcu ;;
+	mb|signal|qsbr|bp) echo test_urcu_$1 ;;
+	rwlock|mutex|perthreadlock) echo test_$1 ;;
+	*) return 1 ;;
+	esac
+}
+
+# Value of a key of the --format=csv output on stdin.
+csv_value()
+{
+	awk -F, -v section="$1" -v key="$2" \
+		'$2 == section && $3 == key { print $4 }'
+}
+
+echo "flavor,nr_readers,nr_writers,duration_s,reader_ops_per_s,writer_ops_per_s,ops_per_s"
+for flavor in ${FLAVORS}; do
+	prog=$(program ${flavor}) || { echo "Unknown flavor ${flavor}" >&2; exit 1; }
+	for writers in ${WRITERS}; do
+		for readers in $(thread_counts); do
+			out=$(./${prog} ${readers} ${writers} ${DURATION} \
+				--format=csv "${@:3}") || exit 1
+			echo "${flavor},${readers},${writers},${DURATION}," \
+				"$(echo "${out}" | csv_value throughput reader_ops_per_s)," \
+				"$(echo "${out}" | csv_value throughput writer_ops_per_s)," \
+				"$(echo "${out}" | csv_value throughput ops_per_s)" \
+				| tr -d ' '
+		done
+	done
+done
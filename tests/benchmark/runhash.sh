@@ -10,7 +10,7 @@ fi
 
 source ../utils/tap.sh
 
-NUM_TESTS=17
+NUM_TESTS=39
 
 plan_tests      ${NUM_TESTS}
 
@@ -102,6 +102,132 @@ okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -m 1 -n 104
 okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -m 1 -n 1048576 -i \
 	-M 100000000 -N 100000000 -O 100000000 -B mmap ${EXTRA_PARAMS}
 
+# rw test, 2 lookup, 2 update threads, add only, auto resize.
+# max buckets: 1048576
+# key range: init, lookup, and update: 0 to 99999999
+# mm backend: "mmap_huge"
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -m 1 -n 1048576 -i \
+	-M 100000000 -N 100000000 -O 100000000 -B mmap_huge ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add only, auto resize.
+# max buckets: 1048576
+# key range: init, lookup, and update: 0 to 99999999
+# mm backend: "numa"
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -m 1 -n 1048576 -i \
+	-M 100000000 -N 100000000 -O 100000000 -B numa ${EXTRA_PARAMS}
+
+
+# ** bulk insertion test
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize.
+# max 1048576 buckets
+# 100000 initial nodes inserted in batches of 1000 nodes.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
+	-k 100000 -b 1000 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize.
+# max 1048576 buckets
+# table built from an array of 100000 initial nodes.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
+	-k 100000 -F ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize.
+# max 1048576 buckets
+# lookups in batches of 32 keys.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
+	-k 100000 -l 32 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize
+# performed incrementally by updaters.
+# max 1048576 buckets
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -I \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize
+# with shrink hysteresis and 10ms minimum interval between resizes.
+# max 1048576 buckets
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -H 1 \
+	-G 10 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize
+# performed by a pool of 2 resize worker threads.
+# max 1048576 buckets
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -P 2 \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# final node count checked against a traversal split in 16 ranges.
+# max 1048576 buckets
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -e 16 \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# final nodes removed with a bulk clear.
+# max 1048576 buckets
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -x \
+	${EXTRA_PARAMS}
+
+# rw test, 4 lookup threads in a frozen snapshot of the initial nodes.
+# key range: init, and lookup: 0 to 999999
+okx ${TESTPROG} $((4*THREAD_MUL)) 0 "${DURATION}" -z -k 500000 \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# initial nodes checked through a memory-mapped snapshot file.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -j \
+	-k 100000 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# table resized asynchronously to 262144 buckets before population.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
+	-Q 262144 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# final nodes checked with hash range lookups of 1024 hashes.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
+	-E 1024 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# removed nodes freed in batches without rcu_head.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -y \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# callbacks balanced across per-CPU call_rcu threads.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -D \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# grace periods shared across per-CPU call_rcu threads.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -g \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# writers invoke their callbacks from an event fd.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -W \
+	${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, add and del randomly, auto resize,
+# call_rcu batches invoked by 2 helper threads per call_rcu thread.
+# key range: init, lookup, and update: 0 to 999999
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -K 2 \
+	${EXTRA_PARAMS}
+
 
 # ** key range tests
 
@@ -134,6 +260,23 @@ okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
 okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
 	-M 10 -N 10 -O 10 -s ${EXTRA_PARAMS}
 
+# ** test skewed key distributions
+
+# rw test, 2 lookup, 2 update threads, zipf keys, add_unique, auto resize.
+# writers: 50% lookups, 20% add, 20% del, 10% replace.
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -u \
+	-k 100000 -X zipf -Z 0.99 -q 50:20:20:10 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, 90% of the operations on 10% of
+# the keys, add and del randomly, auto resize.
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A \
+	-X hotspot -Y 10:90 ${EXTRA_PARAMS}
+
+# rw test, 2 lookup, 2 update threads, sequential keys, replace and del
+# randomly, auto resize.
+okx ${TESTPROG} $((2*THREAD_MUL)) $((2*THREAD_MUL)) "${DURATION}" -A -s \
+	-X seq ${EXTRA_PARAMS}
+
 # ** lookup for known keys
 
 # rw test, 2 lookup, 2 update threads, add_replace and del randomly, auto resize.
@@ -0,0 +1,539 @@
+/*
+ * test_call_rcu.c
+ *
+ * Userspace RCU library - call_rcu throughput and reclamation lag
+ * benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * N producer threads allocate objects and free them with call_rcu() as
+ * fast as they can, using the default call_rcu_data, one call_rcu_data
+ * per CPU, or one per producer thread. Prints the enqueue throughput,
+ * the latency percentiles from call_rcu() to the invocation of the
+ * callback, and the peak number of queued, not yet invoked callbacks
+ * and the memory they hold, sampled every millisecond by the main
+ * thread.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/list.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include "cpuset.h"
+#include "thread-id.h"
+#include "bench-report.h"
+#include "bench-latency.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu.h>
+
+enum test_mode {
+	MODE_DEFAULT,
+	MODE_CPU,
+	MODE_THREAD,
+};
+
+static const char *mode_names[] = {
+	[MODE_DEFAULT] = "default",
+	[MODE_CPU] = "cpu",
+	[MODE_THREAD] = "thread",
+};
+
+static volatile int test_go, test_stop;
+
+static unsigned long duration;
+
+/* Enqueue period, in loops. */
+static unsigned long wdelay;
+
+/* Size of the objects freed with call_rcu, in bytes. */
+static size_t obj_size = 64;
+
+/* call_rcu_data high watermark, 0 for none. */
+static unsigned long high_watermark;
+
+static enum test_mode mode;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, ## args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+struct test_obj {
+	struct rcu_head head;
+	caa_cycles_t queued;	/* 0: latency not sampled */
+};
+
+/*
+ * Producer state, read by the main thread while sampling the number of
+ * outstanding callbacks.
+ */
+struct producer {
+	unsigned long long nr_enqueues;
+	unsigned long long nr_alloc_fail;
+	struct call_rcu_data *crdp;	/* MODE_THREAD */
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * State of a thread invoking callbacks, allocated by its first
+ * callback and kept until the end of the test.
+ */
+struct invoker {
+	unsigned long long nr_invoked;
+	struct bench_latency *lat;
+	struct cds_list_head node;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static struct producer *producers;
+static unsigned int nr_producers;
+
+static CDS_LIST_HEAD(invokers);
+static pthread_mutex_t invokers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DEFINE_URCU_TLS(struct invoker *, invoker);
+
+/* Shared callback latency histogram, in which invokers are merged. */
+static struct bench_latency *callback_lat;
+
+static struct invoker *get_invoker(void)
+{
+	struct invoker *inv = URCU_TLS(invoker);
+
+	if (caa_likely(inv))
+		return inv;
+	inv = calloc(1, sizeof(*inv));
+	if (!inv) {
+		perror("calloc");
+		exit(-1);
+	}
+	inv->lat = bench_latency_thread_alloc(callback_lat);
+	pthread_mutex_lock(&invokers_mutex);
+	cds_list_add(&inv->node, &invokers);
+	pthread_mutex_unlock(&invokers_mutex);
+	URCU_TLS(invoker) = inv;
+	return inv;
+}
+
+static void free_obj_cb(struct rcu_head *head)
+{
+	struct test_obj *obj = caa_container_of(head, struct test_obj, head);
+	struct invoker *inv = get_invoker();
+
+	bench_latency_end(inv->lat, obj->queued);
+	CMM_STORE_SHARED(inv->nr_invoked, inv->nr_invoked + 1);
+	free(obj);
+}
+
+static void set_watermarks(struct call_rcu_data *crdp)
+{
+	if (!high_watermark || !crdp)
+		return;
+	if (call_rcu_data_set_watermarks(crdp, high_watermark,
+			high_watermark / 2, URCU_CALL_RCU_BACKPRESSURE_THROTTLE)) {
+		perror("call_rcu_data_set_watermarks");
+		exit(-1);
+	}
+}
+
+static void *thr_producer(void *_producer)
+{
+	struct producer *p = _producer;
+	/* Only used for its sampling countdown. */
+	struct bench_latency *hist = bench_latency_thread_alloc(callback_lat);
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"producer", urcu_get_thread_id());
+
+	set_affinity();
+
+	rcu_register_thread();
+	if (mode == MODE_THREAD) {
+		p->crdp = create_call_rcu_data(0, -1);
+		if (!p->crdp) {
+			perror("create_call_rcu_data");
+			exit(-1);
+		}
+		set_watermarks(p->crdp);
+		set_thread_call_rcu_data(p->crdp);
+	}
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		struct test_obj *obj = malloc(obj_size);
+
+		if (caa_unlikely(!obj)) {
+			p->nr_alloc_fail++;
+		} else {
+			obj->queued = bench_latency_begin(hist);
+			call_rcu(&obj->head, free_obj_cb);
+			CMM_STORE_SHARED(p->nr_enqueues, p->nr_enqueues + 1);
+		}
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+		if (caa_unlikely(test_stop))
+			break;
+	}
+
+	if (mode == MODE_THREAD)
+		set_thread_call_rcu_data(NULL);
+	rcu_unregister_thread();
+	bench_latency_free(hist);
+	printf_verbose("producer thread_end, tid %lu, enqueues %llu\n",
+			urcu_get_thread_id(), p->nr_enqueues);
+	return ((void*)1);
+}
+
+/* Number of callbacks queued and not invoked yet. */
+static unsigned long long nr_outstanding(void)
+{
+	unsigned long long enqueued = 0, invoked = 0;
+	struct invoker *inv;
+	unsigned int i;
+
+	/* Read invoked before enqueued, so the difference is not negative. */
+	pthread_mutex_lock(&invokers_mutex);
+	cds_list_for_each_entry(inv, &invokers, node)
+		invoked += CMM_LOAD_SHARED(inv->nr_invoked);
+	pthread_mutex_unlock(&invokers_mutex);
+	cmm_smp_rmb();
+	for (i = 0; i < nr_producers; i++)
+		enqueued += CMM_LOAD_SHARED(producers[i].nr_enqueues);
+	return enqueued > invoked ? enqueued - invoked : 0;
+}
+
+static uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_producers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-m default|cpu|thread] (call_rcu_data configuration)\n");
+	printf("	[-s size] (object size, in bytes, default: %zu)\n",
+		obj_size);
+	printf("	[-d delay] (producer period (in loops))\n");
+	printf("	[-W n] (call_rcu_data high watermark, throttling producers)\n");
+	printf("	[-a cpu#] [-a cpu#]... (producer affinity)\n");
+	printf("	[--latency[=period]] (sample one of period callbacks, default: all)\n");
+	printf("	[-v] (verbose output)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report report;
+	pthread_t *tid_producer;
+	unsigned long long tot_enqueues = 0, tot_invoked = 0,
+			   tot_alloc_fail = 0, peak_outstanding = 0;
+	uint64_t start_ns, end_ns;
+	struct invoker *inv, *tmp;
+	unsigned int i;
+	int err, a, retval = 0;
+
+	argc = bench_report_parse_args(argc, argv);
+	argc = bench_latency_parse_args(argc, argv);
+	if (argc < 3) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_producers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 3; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'm':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			i++;
+			if (!strcmp(argv[i], "default")) {
+				mode = MODE_DEFAULT;
+			} else if (!strcmp(argv[i], "cpu")) {
+				mode = MODE_CPU;
+			} else if (!strcmp(argv[i], "thread")) {
+				mode = MODE_THREAD;
+			} else {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 's':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			obj_size = atol(argv[++i]);
+			if (obj_size < sizeof(struct test_obj))
+				obj_size = sizeof(struct test_obj);
+			break;
+		case 'W':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			high_watermark = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, %u producers, "
+		       "mode %s.\n", duration, nr_producers, mode_names[mode]);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	/* The callback latency is always measured, of all callbacks by default. */
+	if (!bench_latency_enabled()) {
+		bench_latency_calibrate();
+		callback_lat = __bench_latency_alloc("call_rcu_callback", 1);
+	} else {
+		callback_lat = bench_latency_alloc("call_rcu_callback");
+	}
+
+	rcu_register_thread();
+	switch (mode) {
+	case MODE_DEFAULT:
+		set_watermarks(get_default_call_rcu_data());
+		break;
+	case MODE_CPU:
+	{
+		long nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+		if (create_all_cpu_call_rcu_data(0)) {
+			perror("create_all_cpu_call_rcu_data");
+			exit(-1);
+		}
+		for (a = 0; a < nr_cpus; a++)
+			set_watermarks(get_cpu_call_rcu_data(a));
+		break;
+	}
+	case MODE_THREAD:
+		break;
+	}
+
+	tid_producer = calloc(nr_producers, sizeof(*tid_producer));
+	producers = calloc(nr_producers, sizeof(*producers));
+	if (!tid_producer || !producers) {
+		perror("calloc");
+		exit(-1);
+	}
+
+	next_aff = 0;
+
+	for (i = 0; i < nr_producers; i++) {
+		err = pthread_create(&tid_producer[i], NULL, thr_producer,
+				     &producers[i]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	test_go = 1;
+
+	/* Sample the outstanding callbacks every millisecond. */
+	start_ns = clock_ns();
+	do {
+		unsigned long long outstanding;
+
+		(void) poll(NULL, 0, 1);
+		outstanding = nr_outstanding();
+		if (outstanding > peak_outstanding)
+			peak_outstanding = outstanding;
+		end_ns = clock_ns();
+	} while (end_ns - start_ns < duration * 1000000000ULL);
+
+	test_stop = 1;
+
+	for (i = 0; i < nr_producers; i++) {
+		err = pthread_join(tid_producer[i], NULL);
+		if (err != 0)
+			exit(1);
+		tot_enqueues += producers[i].nr_enqueues;
+		tot_alloc_fail += producers[i].nr_alloc_fail;
+	}
+
+	/* Wait for the remaining callbacks to be invoked. */
+	rcu_barrier();
+
+	cds_list_for_each_entry(inv, &invokers, node) {
+		tot_invoked += inv->nr_invoked;
+		bench_latency_merge(callback_lat, inv->lat);
+	}
+
+	printf_verbose("total number of enqueues : %llu, invoked %llu\n",
+		       tot_enqueues, tot_invoked);
+	if (bench_report_text()) {
+		printf("SUMMARY %-25s testdur %4lu nr_producers %3u mode %-7s "
+			"wdelay %6lu obj_size %6zu high_watermark %8lu "
+			"nr_enqueues %12llu enqueues_per_s %12.0f "
+			"peak_outstanding %10llu peak_outstanding_bytes %12llu\n",
+			argv[0], duration, nr_producers, mode_names[mode],
+			wdelay, obj_size, high_watermark, tot_enqueues,
+			(double) tot_enqueues * 1000000000.0
+				/ (end_ns - start_ns),
+			peak_outstanding,
+			peak_outstanding * obj_size);
+		bench_latency_print(callback_lat);
+	}
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_producers", nr_producers);
+	bench_report_config(&report, "mode", mode);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "obj_size", obj_size);
+	bench_report_config(&report, "high_watermark", high_watermark);
+	for (i = 0; i < nr_producers; i++)
+		bench_report_thread(&report, "producer",
+			producers[i].nr_enqueues);
+	bench_report_result(&report, "enqueues", tot_enqueues);
+	bench_report_result(&report, "invoked", tot_invoked);
+	bench_report_result(&report, "alloc_fail", tot_alloc_fail);
+	bench_report_result(&report, "peak_outstanding", peak_outstanding);
+	bench_report_result(&report, "peak_outstanding_bytes",
+		peak_outstanding * obj_size);
+	bench_latency_report(&report, callback_lat);
+	bench_report_print(&report);
+
+	if (tot_invoked != tot_enqueues) {
+		printf("WARNING! Discrepancy between nr enqueues %llu vs "
+		       "nr invoked %llu.\n", tot_enqueues, tot_invoked);
+		retval = 1;
+	}
+
+	if (mode == MODE_CPU)
+		free_all_cpu_call_rcu_data();
+	for (i = 0; i < nr_producers; i++) {
+		if (producers[i].crdp)
+			call_rcu_data_free(producers[i].crdp);
+	}
+	rcu_unregister_thread();
+
+	cds_list_for_each_entry_safe(inv, tmp, &invokers, node) {
+		cds_list_del(&inv->node);
+		bench_latency_free(inv->lat);
+		free(inv);
+	}
+	bench_latency_free(callback_lat);
+	free(producers);
+	free(tid_producer);
+	return retval;
+}
@@ -0,0 +1,316 @@
+/*
+ * test_callback_latency.c
+ *
+ * Userspace RCU library - callback latency benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Queue one call_rcu() callback, or one workqueue work item, at a time,
+ * waiting for it to be invoked and then for a given delay, so that the
+ * worker thread goes idle in between. Prints the latency percentiles
+ * from queueing to invocation, and the CPU time of the worker thread,
+ * for the default, real-time and busy-polling worker modes.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <urcu/arch.h>
+
+#include "thread-id.h"
+#include "bench-report.h"
+
+#define _LGPL_SOURCE
+#include <urcu.h>
+#include "workqueue.h"
+
+enum test_mode {
+	MODE_DEFAULT,
+	MODE_RT,
+	MODE_BUSY,
+};
+
+static const char *mode_names[] = {
+	[MODE_DEFAULT] = "default",
+	[MODE_RT] = "rt",
+	[MODE_BUSY] = "busy",
+};
+
+static volatile int test_stop;
+
+static unsigned long duration;
+
+/* delay between callbacks, in us */
+static unsigned long delay_us = 1000;
+
+static enum test_mode mode;
+static int use_workqueue;
+static int cpu_affinity = -1;
+
+static struct callback {
+	struct rcu_head head;
+	struct urcu_work work;
+	uint64_t queued_ns;
+	int done;
+} callback;
+
+static pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+/* Callback latencies, in ns. */
+static uint64_t *lat;
+static unsigned long nr_lat, lat_alloc;
+static uint64_t worker_cpu_ns;
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(clock, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static void callback_done(struct callback *cb)
+{
+	uint64_t now = clock_ns(CLOCK_MONOTONIC);
+
+	/* Worker thread CPU time, up to the last callback. */
+	worker_cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	if (nr_lat == lat_alloc) {
+		lat_alloc = lat_alloc ? 2 * lat_alloc : 4096;
+		lat = realloc(lat, lat_alloc * sizeof(*lat));
+		assert(lat);
+	}
+	lat[nr_lat++] = now - cb->queued_ns;
+	pthread_mutex_lock(&done_mutex);
+	cb->done = 1;
+	pthread_cond_signal(&done_cond);
+	pthread_mutex_unlock(&done_mutex);
+}
+
+static void rcu_callback(struct rcu_head *head)
+{
+	callback_done(caa_container_of(head, struct callback, head));
+}
+
+static void work_callback(struct urcu_work *work)
+{
+	callback_done(caa_container_of(work, struct callback, work));
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Latency at @permille of the sorted samples. */
+static uint64_t lat_percentile(unsigned int permille)
+{
+	if (!nr_lat)
+		return 0;
+	return lat[(nr_lat - 1) * permille / 1000];
+}
+
+static void *thr_timer(void *arg)
+{
+	sleep(duration);
+	test_stop = 1;
+	return NULL;
+}
+
+void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-m default|rt|busy] (worker mode)\n");
+	printf("	[-q] (use a workqueue instead of call_rcu)\n");
+	printf("	[-d delay] (delay between callbacks (in us))\n");
+	printf("	[-a cpu#] (worker affinity)\n");
+	printf("	[-v] (verbose output)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report report;
+	struct call_rcu_data *crdp = NULL;
+	struct urcu_workqueue *workqueue = NULL;
+	unsigned long flags = 0;
+	struct timespec delay;
+	pthread_t tid_timer;
+	int err, i;
+
+	argc = bench_report_parse_args(argc, argv);
+	if (argc < 2) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 2; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			cpu_affinity = atoi(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			delay_us = atol(argv[++i]);
+			break;
+		case 'm':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			i++;
+			if (!strcmp(argv[i], "default")) {
+				mode = MODE_DEFAULT;
+			} else if (!strcmp(argv[i], "rt")) {
+				mode = MODE_RT;
+			} else if (!strcmp(argv[i], "busy")) {
+				mode = MODE_BUSY;
+			} else {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 'q':
+			use_workqueue = 1;
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, mode %s, %s.\n",
+		duration, mode_names[mode],
+		use_workqueue ? "workqueue" : "call_rcu");
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	rcu_register_thread();
+	if (use_workqueue) {
+		if (mode == MODE_RT)
+			flags = URCU_WORKQUEUE_RT;
+		else if (mode == MODE_BUSY)
+			flags = URCU_WORKQUEUE_BUSY_POLL;
+		workqueue = urcu_workqueue_create(flags, cpu_affinity, NULL,
+				NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+		if (!workqueue)
+			exit(1);
+	} else {
+		if (mode == MODE_RT)
+			flags = URCU_CALL_RCU_RT;
+		else if (mode == MODE_BUSY)
+			flags = URCU_CALL_RCU_BUSY_POLL;
+		crdp = create_call_rcu_data(flags, cpu_affinity);
+		if (!crdp)
+			exit(1);
+		set_thread_call_rcu_data(crdp);
+	}
+
+	err = pthread_create(&tid_timer, NULL, thr_timer, NULL);
+	if (err != 0)
+		exit(1);
+
+	delay.tv_sec = delay_us / 1000000;
+	delay.tv_nsec = (delay_us % 1000000) * 1000;
+	while (!test_stop) {
+		callback.done = 0;
+		callback.queued_ns = clock_ns(CLOCK_MONOTONIC);
+		if (use_workqueue)
+			urcu_workqueue_queue_work(workqueue, &callback.work,
+					work_callback);
+		else
+			call_rcu(&callback.head, rcu_callback);
+		pthread_mutex_lock(&done_mutex);
+		while (!callback.done)
+			pthread_cond_wait(&done_cond, &done_mutex);
+		pthread_mutex_unlock(&done_mutex);
+		if (delay_us)
+			(void) nanosleep(&delay, NULL);
+	}
+
+	err = pthread_join(tid_timer, NULL);
+	if (err != 0)
+		exit(1);
+	if (use_workqueue) {
+		urcu_workqueue_flush_queued_work(workqueue);
+		urcu_workqueue_destroy(workqueue);
+	} else {
+		set_thread_call_rcu_data(NULL);
+		call_rcu_data_free(crdp);
+	}
+	rcu_unregister_thread();
+
+	qsort(lat, nr_lat, sizeof(*lat), cmp_u64);
+	if (bench_report_text())
+		printf("CALLBACK_LATENCY queue=%s mode=%s delay_us=%lu "
+			"testdur=%lu nr=%lu p50_ns=%llu p99_ns=%llu "
+			"p999_ns=%llu max_ns=%llu worker_cpu_ns=%llu\n",
+			use_workqueue ? "workqueue" : "call_rcu",
+			mode_names[mode], delay_us, duration, nr_lat,
+			(unsigned long long) lat_percentile(500),
+			(unsigned long long) lat_percentile(990),
+			(unsigned long long) lat_percentile(999),
+			(unsigned long long) lat_percentile(1000),
+			(unsigned long long) worker_cpu_ns);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "workqueue", use_workqueue);
+	bench_report_config(&report, "mode", mode);
+	bench_report_config(&report, "delay_us", delay_us);
+	bench_report_thread(&report, "callback", nr_lat);
+	bench_report_result(&report, "p50_ns", lat_percentile(500));
+	bench_report_result(&report, "p99_ns", lat_percentile(990));
+	bench_report_result(&report, "p999_ns", lat_percentile(999));
+	bench_report_result(&report, "max_ns", lat_percentile(1000));
+	bench_report_result(&report, "worker_cpu_ns", worker_cpu_ns);
+	bench_report_print(&report);
+	free(lat);
+	return 0;
+}
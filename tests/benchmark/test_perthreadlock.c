@@ -35,6 +35,7 @@
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-report.h"
 
 /* hardcoded number of CPUs */
 #define NR_CPUS 16384
@@ -258,12 +259,14 @@ void show_usage(int argc, char **argv)
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	int err;
 	pthread_t *tid_reader, *tid_writer;
 	void *tret;
 	unsigned long long tot_reads = 0, tot_writes = 0;
 	int i, a;
 
+	argc = bench_report_parse_args(argc, argv);
 	if (argc < 4) {
 		show_usage(argc, argv);
 		return -1;
@@ -383,12 +386,27 @@ int main(int argc, char **argv)
 
 	printf_verbose("total number of reads : %llu, writes %llu\n", tot_reads,
 	       tot_writes);
-	printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu wdur %6lu "
-		"nr_writers %3u "
-		"wdelay %6lu nr_reads %12llu nr_writes %12llu nr_ops %12llu\n",
-		argv[0], duration, nr_readers, rduration, wduration,
-		nr_writers, wdelay, tot_reads, tot_writes,
-		tot_reads + tot_writes);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu wdur %6lu "
+			"nr_writers %3u "
+			"wdelay %6lu nr_reads %12llu nr_writes %12llu nr_ops %12llu\n",
+			argv[0], duration, nr_readers, rduration, wduration,
+			nr_writers, wdelay, tot_reads, tot_writes,
+			tot_reads + tot_writes);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_readers", nr_readers);
+	bench_report_config(&report, "rdur", rduration);
+	bench_report_config(&report, "wdur", wduration);
+	bench_report_config(&report, "nr_writers", nr_writers);
+	bench_report_config(&report, "wdelay", wdelay);
+	for (i = 0; i < nr_readers; i++)
+		bench_report_thread(&report, "reader", tot_nr_reads[i]);
+	for (i = 0; i < nr_writers; i++)
+		bench_report_thread(&report, "writer", tot_nr_writes[i]);
+	bench_report_result(&report, "nr_reads", tot_reads);
+	bench_report_result(&report, "nr_writes", tot_writes);
+	bench_report_result(&report, "nr_ops", tot_reads + tot_writes);
+	bench_report_print(&report);
 
 	free(tid_reader);
 	free(tid_writer);
@@ -0,0 +1,472 @@
+/*
+ * test_primitive_cost.c
+ *
+ * Userspace RCU library - memory barrier and atomic primitives cost
+ * microbenchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Time loops of the memory barriers of urcu/arch.h and of the atomic
+ * operations of urcu/uatomic.h used by the flavors, with 1, 2, 4, ...
+ * up to -t threads running the same loop. Each atomic operation is
+ * timed on a variable private to each thread, on its own cache line,
+ * and on a variable shared by all the threads. The broadcasts issued by
+ * the grace periods are timed with one thread issuing them while the
+ * other threads spin: sys_membarrier() private expedited, as issued
+ * by the memb flavor, and the signal round trip of the signal flavor,
+ * each thread being sent a signal whose handler issues a memory barrier
+ * before clearing its flag. The cost per operation, averaged over the
+ * threads, is printed in nanoseconds as a table, one column per thread
+ * count.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/tls-compat.h>
+
+#include "cpuset.h"
+#include "bench-report.h"
+
+#ifdef __NR_membarrier
+# define membarrier(...)	syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)	-ENOSYS
+#endif
+
+#define MEMBARRIER_CMD_QUERY				0
+#define MEMBARRIER_CMD_PRIVATE_EXPEDITED		(1 << 3)
+#define MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	(1 << 4)
+
+#define SIGBENCH	SIGUSR1
+
+#define DEFAULT_LOOPS		1000000UL
+#define DEFAULT_BROADCASTS	1000UL
+#define DEFAULT_THREADS		4
+#define MAX_THREAD_COUNTS	16
+
+enum test_op {
+	OP_SMP_MB = 0,
+	OP_SMP_RMB,
+	OP_SMP_WMB,
+	OP_XCHG_PRIVATE,
+	OP_XCHG_SHARED,
+	OP_CMPXCHG_PRIVATE,
+	OP_CMPXCHG_SHARED,
+	OP_ADD_RETURN_PRIVATE,
+	OP_ADD_RETURN_SHARED,
+	OP_MEMBARRIER,
+	OP_SIGNAL,
+	NR_OPS,
+};
+
+static const char *op_names[] = {
+	[OP_SMP_MB] = "smp_mb",
+	[OP_SMP_RMB] = "smp_rmb",
+	[OP_SMP_WMB] = "smp_wmb",
+	[OP_XCHG_PRIVATE] = "xchg_private",
+	[OP_XCHG_SHARED] = "xchg_shared",
+	[OP_CMPXCHG_PRIVATE] = "cmpxchg_private",
+	[OP_CMPXCHG_SHARED] = "cmpxchg_shared",
+	[OP_ADD_RETURN_PRIVATE] = "add_return_private",
+	[OP_ADD_RETURN_SHARED] = "add_return_shared",
+	[OP_MEMBARRIER] = "membarrier",
+	[OP_SIGNAL] = "signal_broadcast",
+};
+
+static int op_is_broadcast(enum test_op op)
+{
+	return op == OP_MEMBARRIER || op == OP_SIGNAL;
+}
+
+struct test_var {
+	unsigned long v;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct test_thread {
+	pthread_t tid;
+	unsigned int index;
+	struct test_var var;		/* OP_*_PRIVATE */
+	int need_mb;			/* OP_SIGNAL */
+	uint64_t ns;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static unsigned long nr_loops = DEFAULT_LOOPS;
+static unsigned long nr_broadcasts = DEFAULT_BROADCASTS;
+static unsigned int nr_threads_max = DEFAULT_THREADS;
+static int use_affinity;
+
+static struct test_var shared_var;
+static struct test_thread *threads;
+static unsigned int nr_threads;
+static enum test_op cur_op;
+static int go, stop;
+static unsigned int nr_ready;
+static int has_membarrier;
+
+static DEFINE_URCU_TLS(struct test_thread *, self);
+
+static uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void set_affinity(unsigned int cpu)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (!use_affinity || nr_cpus <= 0)
+		return;
+	CPU_ZERO(&mask);
+	CPU_SET(cpu % nr_cpus, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+static void sigbench_handler(int signo __attribute__((unused)),
+		siginfo_t *siginfo __attribute__((unused)),
+		void *context __attribute__((unused)))
+{
+	struct test_thread *t = URCU_TLS(self);
+
+	cmm_smp_mb();
+	if (t)
+		_CMM_STORE_SHARED(t->need_mb, 0);
+	cmm_smp_mb();
+}
+
+/* Round trip of the signal flavor: signal every other thread, wait. */
+static void signal_broadcast(struct test_thread *sender)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_threads; i++) {
+		if (&threads[i] == sender)
+			continue;
+		_CMM_STORE_SHARED(threads[i].need_mb, 1);
+		cmm_smp_mb();
+		pthread_kill(threads[i].tid, SIGBENCH);
+	}
+	for (i = 0; i < nr_threads; i++) {
+		while (CMM_LOAD_SHARED(threads[i].need_mb))
+			(void) poll(NULL, 0, 0);
+	}
+	cmm_smp_mb();
+}
+
+/* Nanoseconds taken by the loop of @op in thread @t. */
+static uint64_t time_loop(struct test_thread *t, enum test_op op)
+{
+	unsigned long *private = &t->var.v, *shared = &shared_var.v, i;
+	uint64_t begin, end;
+
+	begin = clock_ns();
+	switch (op) {
+	case OP_SMP_MB:
+		for (i = 0; i < nr_loops; i++)
+			cmm_smp_mb();
+		break;
+	case OP_SMP_RMB:
+		for (i = 0; i < nr_loops; i++)
+			cmm_smp_rmb();
+		break;
+	case OP_SMP_WMB:
+		for (i = 0; i < nr_loops; i++)
+			cmm_smp_wmb();
+		break;
+	case OP_XCHG_PRIVATE:
+		for (i = 0; i < nr_loops; i++)
+			(void) uatomic_xchg(private, i);
+		break;
+	case OP_XCHG_SHARED:
+		for (i = 0; i < nr_loops; i++)
+			(void) uatomic_xchg(shared, i);
+		break;
+	case OP_CMPXCHG_PRIVATE:
+		for (i = 0; i < nr_loops; i++)
+			(void) uatomic_cmpxchg(private, i, i + 1);
+		break;
+	case OP_CMPXCHG_SHARED:
+		for (i = 0; i < nr_loops; i++)
+			(void) uatomic_cmpxchg(shared, i, i + 1);
+		break;
+	case OP_ADD_RETURN_PRIVATE:
+		for (i = 0; i < nr_loops; i++)
+			(void) uatomic_add_return(private, 1);
+		break;
+	case OP_ADD_RETURN_SHARED:
+		for (i = 0; i < nr_loops; i++)
+			(void) uatomic_add_return(shared, 1);
+		break;
+	case OP_MEMBARRIER:
+		for (i = 0; i < nr_broadcasts; i++)
+			(void) membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+		break;
+	case OP_SIGNAL:
+		for (i = 0; i < nr_broadcasts; i++)
+			signal_broadcast(t);
+		break;
+	default:
+		break;
+	}
+	end = clock_ns();
+	return end - begin;
+}
+
+static void *thr_test(void *arg)
+{
+	struct test_thread *t = arg;
+
+	URCU_TLS(self) = t;
+	set_affinity(t->index);
+	uatomic_inc(&nr_ready);
+	while (!CMM_LOAD_SHARED(go))
+		caa_cpu_relax();
+	cmm_smp_mb();
+	/* Broadcasts are issued by the first thread, the others spin. */
+	if (!op_is_broadcast(cur_op) || !t->index) {
+		t->ns = time_loop(t, cur_op);
+		if (op_is_broadcast(cur_op))
+			CMM_STORE_SHARED(stop, 1);
+	} else {
+		while (!CMM_LOAD_SHARED(stop))
+			caa_cpu_relax();
+	}
+	return NULL;
+}
+
+/*
+ * Average cost of @op in nanoseconds with @count threads, or -1 if it
+ * cannot be measured.
+ */
+static double run_op(enum test_op op, unsigned int count)
+{
+	uint64_t total = 0;
+	unsigned int i;
+	int ret;
+
+	if (op == OP_MEMBARRIER && !has_membarrier)
+		return -1;
+	if (op == OP_SIGNAL && count < 2)
+		return -1;
+	memset(threads, 0, sizeof(*threads) * count);
+	nr_threads = count;
+	cur_op = op;
+	go = stop = 0;
+	nr_ready = 0;
+	shared_var.v = 0;
+	for (i = 0; i < count; i++) {
+		threads[i].index = i;
+		ret = pthread_create(&threads[i].tid, NULL, thr_test,
+				&threads[i]);
+		if (ret) {
+			errno = ret;
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	while (uatomic_read(&nr_ready) < count)
+		(void) poll(NULL, 0, 1);
+	cmm_smp_mb();
+	CMM_STORE_SHARED(go, 1);
+	for (i = 0; i < count; i++) {
+		ret = pthread_join(threads[i].tid, NULL);
+		if (ret) {
+			errno = ret;
+			perror("pthread_join");
+			exit(1);
+		}
+	}
+	if (op_is_broadcast(op))
+		return (double) threads[0].ns / nr_broadcasts;
+	for (i = 0; i < count; i++)
+		total += threads[i].ns;
+	return (double) total / ((double) nr_loops * count);
+}
+
+static void membarrier_init(void)
+{
+	int mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+
+	if (mask < 0 || !(mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED))
+		return;
+	if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0))
+		return;
+	has_membarrier = 1;
+}
+
+static void signal_init(void)
+{
+	struct sigaction act;
+
+	memset(&act, 0, sizeof(act));
+	act.sa_sigaction = sigbench_handler;
+	act.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&act.sa_mask);
+	if (sigaction(SIGBENCH, &act, NULL)) {
+		perror("sigaction");
+		exit(1);
+	}
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s <OPTIONS>\n", argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-n loops] (iterations per thread, default: %lu)\n",
+		DEFAULT_LOOPS);
+	printf("	[-b broadcasts] (membarrier and signal broadcasts, default: %lu)\n",
+		DEFAULT_BROADCASTS);
+	printf("	[-t threads] (maximum thread count, default: %d)\n",
+		DEFAULT_THREADS);
+	printf("	[-a] (pin thread i on CPU i)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int counts[MAX_THREAD_COUNTS], nr_counts = 0, c, count;
+	double cost[MAX_THREAD_COUNTS][NR_OPS];
+	char keys[NR_OPS][32];
+	int i;
+
+	argc = bench_report_parse_args(argc, argv);
+
+	for (i = 1; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'n':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_loops = strtoul(argv[++i], NULL, 10);
+			break;
+		case 'b':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_broadcasts = strtoul(argv[++i], NULL, 10);
+			break;
+		case 't':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_threads_max = atoi(argv[++i]);
+			break;
+		case 'a':
+			use_affinity = 1;
+			break;
+		default:
+			show_usage(argc, argv);
+			return -1;
+		}
+	}
+	if (!nr_loops || !nr_broadcasts || !nr_threads_max) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	/* 1, 2, 4, ... and the maximum thread count. */
+	for (count = 1; count < nr_threads_max
+			&& nr_counts < MAX_THREAD_COUNTS - 1; count <<= 1)
+		counts[nr_counts++] = count;
+	counts[nr_counts++] = nr_threads_max;
+
+	threads = calloc(nr_threads_max, sizeof(*threads));
+	if (!threads) {
+		perror("calloc");
+		return 1;
+	}
+	membarrier_init();
+	signal_init();
+
+	for (c = 0; c < nr_counts; c++) {
+		for (i = 0; i < NR_OPS; i++)
+			cost[c][i] = run_op(i, counts[c]);
+	}
+
+	if (bench_report_text()) {
+		printf("PRIMITIVE_COST loops %lu broadcasts %lu (ns per operation)\n",
+			nr_loops, nr_broadcasts);
+		printf("%-20s", "threads");
+		for (c = 0; c < nr_counts; c++)
+			printf(" %10u", counts[c]);
+		printf("\n");
+		for (i = 0; i < NR_OPS; i++) {
+			printf("%-20s", op_names[i]);
+			for (c = 0; c < nr_counts; c++) {
+				if (cost[c][i] < 0)
+					printf(" %10s", "-");
+				else
+					printf(" %10.2f", cost[c][i]);
+			}
+			printf("\n");
+		}
+	}
+
+	/*
+	 * One report per thread count. The totals are scaled so that
+	 * dividing them by the operation count of the threads gives the
+	 * cost per operation.
+	 */
+	for (c = 0; c < nr_counts; c++) {
+		struct bench_report report;
+		unsigned int t;
+
+		bench_report_init(&report, argv[0], 0);
+		bench_report_config(&report, "threads", counts[c]);
+		bench_report_config(&report, "loops", nr_loops);
+		bench_report_config(&report, "broadcasts", nr_broadcasts);
+		for (t = 0; t < counts[c]; t++)
+			bench_report_thread(&report, "worker", nr_loops);
+		for (i = 0; i < NR_OPS; i++) {
+			if (cost[c][i] < 0)
+				continue;
+			snprintf(keys[i], sizeof(keys[i]), "%s_ns",
+				op_names[i]);
+			bench_report_per_op(&report, keys[i],
+				(long long) (cost[c][i]
+					* (double) nr_loops * counts[c]));
+		}
+		bench_report_print(&report);
+	}
+	free(threads);
+	return 0;
+}
@@ -0,0 +1,420 @@
+/*
+ * test_read_overhead.c
+ *
+ * Userspace RCU library - read-side primitives overhead microbenchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Time loops of rcu_read_lock()/rcu_read_unlock() pairs, unnested and
+ * nested within an outer critical section, of rcu_dereference() and of
+ * rcu_quiescent_state() (QSBR only) in a single thread, and of
+ * caa_cpu_relax(), the unit of the loop delays of the other benchmarks.
+ * Each loop is repeated, its fastest repetition kept and the cost of an
+ * empty loop subtracted, and the cost per operation is printed in
+ * ticks of the timestamp counter and in nanoseconds.
+ *
+ * The program is built for each flavor, with _LGPL_SOURCE inlining the
+ * read-side primitives and, with DYNAMIC_LINK_TEST, calling them in the
+ * shared library, which gives the cost of the call indirection.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <urcu/arch.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "cpuset.h"
+#include "bench-report.h"
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#define LINK	"inline"
+#else
+#define LINK	"library"
+#endif
+#if defined(TEST_URCU_QSBR)
+#include <urcu-qsbr.h>
+#define FLAVOR	"qsbr"
+#elif defined(TEST_URCU_BP)
+#include <urcu-bp.h>
+#define FLAVOR	"bp"
+#elif defined(TEST_URCU_PERCPU)
+#include <urcu-percpu.h>
+#define FLAVOR	"percpu"
+#elif defined(TEST_URCU_EBR)
+#include <urcu-ebr.h>
+#define FLAVOR	"ebr"
+#else
+#include <urcu.h>
+#if defined(RCU_MB)
+#define FLAVOR	"mb"
+#elif defined(RCU_SIGNAL)
+#define FLAVOR	"signal"
+#else
+#define FLAVOR	"memb"
+#endif
+#endif
+
+/* The bp and percpu flavors do not need readers to register. */
+#if defined(TEST_URCU_BP) || defined(TEST_URCU_PERCPU)
+#define test_register_thread()
+#define test_unregister_thread()
+#else
+#define test_register_thread()		rcu_register_thread()
+#define test_unregister_thread()	rcu_unregister_thread()
+#endif
+
+#define DEFAULT_LOOPS		10000000UL
+#define DEFAULT_REPEATS		10
+
+/*
+ * Timestamp counter: rdtscp on x86, which waits for the previous
+ * instructions to complete, falling back to lfence; rdtsc on processors
+ * lacking it, and the virtual counter on arm64, after an isb. Other
+ * architectures use caa_get_cycles().
+ */
+#if defined(__x86_64__) || defined(__i386__)
+
+static int has_rdtscp;
+
+static void counter_init(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx))
+		has_rdtscp = !!(edx & (1U << 27));
+}
+
+static inline uint64_t read_counter(void)
+{
+	unsigned int lo, hi, aux;
+
+	if (caa_likely(has_rdtscp)) {
+		__asm__ __volatile__ ("rdtscp"
+			: "=a" (lo), "=d" (hi), "=c" (aux) : : "memory");
+	} else {
+		__asm__ __volatile__ ("lfence; rdtsc"
+			: "=a" (lo), "=d" (hi) : : "memory");
+	}
+	return ((uint64_t) hi << 32) | lo;
+}
+
+static const char *counter_name(void)
+{
+	return has_rdtscp ? "rdtscp" : "rdtsc";
+}
+
+#elif defined(__aarch64__)
+
+static void counter_init(void)
+{
+}
+
+static inline uint64_t read_counter(void)
+{
+	uint64_t v;
+
+	__asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r" (v) : : "memory");
+	return v;
+}
+
+static const char *counter_name(void)
+{
+	return "cntvct";
+}
+
+#else
+
+static void counter_init(void)
+{
+}
+
+static inline uint64_t read_counter(void)
+{
+	return caa_get_cycles();
+}
+
+static const char *counter_name(void)
+{
+	return "caa_get_cycles";
+}
+
+#endif
+
+static unsigned long nr_loops = DEFAULT_LOOPS;
+static unsigned int nr_repeats = DEFAULT_REPEATS;
+
+static int *test_rcu_pointer;
+
+static uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Nanoseconds per counter tick, measured over 100ms. */
+static double calibrate(void)
+{
+	uint64_t t0, t1, c0, c1;
+
+	t0 = clock_ns();
+	c0 = read_counter();
+	do {
+		t1 = clock_ns();
+	} while (t1 - t0 < 100000000ULL);
+	c1 = read_counter();
+	return c1 > c0 ? (double) (t1 - t0) / (c1 - c0) : 1.0;
+}
+
+enum test_op {
+	OP_EMPTY = 0,
+	OP_RELAX,
+	OP_LOCK_UNLOCK,
+	OP_LOCK_UNLOCK_NESTED,
+	OP_DEREFERENCE,
+	OP_QUIESCENT_STATE,
+	NR_OPS,
+};
+
+static const char *op_names[] = {
+	[OP_EMPTY] = "empty",
+	[OP_RELAX] = "cpu_relax",
+	[OP_LOCK_UNLOCK] = "lock_unlock",
+	[OP_LOCK_UNLOCK_NESTED] = "lock_unlock_nested",
+	[OP_DEREFERENCE] = "dereference",
+	[OP_QUIESCENT_STATE] = "quiescent_state",
+};
+
+/* Ticks of nr_loops iterations of @op. */
+static uint64_t time_loop(enum test_op op)
+{
+	uint64_t begin, end;
+	unsigned long i;
+	int *p;
+
+	switch (op) {
+	case OP_EMPTY:
+		begin = read_counter();
+		for (i = 0; i < nr_loops; i++)
+			cmm_barrier();
+		end = read_counter();
+		break;
+	case OP_RELAX:
+		begin = read_counter();
+		for (i = 0; i < nr_loops; i++)
+			caa_cpu_relax();
+		end = read_counter();
+		break;
+	case OP_LOCK_UNLOCK:
+		begin = read_counter();
+		for (i = 0; i < nr_loops; i++) {
+			rcu_read_lock();
+			rcu_read_unlock();
+		}
+		end = read_counter();
+		break;
+	case OP_LOCK_UNLOCK_NESTED:
+		rcu_read_lock();
+		begin = read_counter();
+		for (i = 0; i < nr_loops; i++) {
+			rcu_read_lock();
+			rcu_read_unlock();
+		}
+		end = read_counter();
+		rcu_read_unlock();
+		break;
+	case OP_DEREFERENCE:
+		rcu_read_lock();
+		begin = read_counter();
+		for (i = 0; i < nr_loops; i++) {
+			p = rcu_dereference(test_rcu_pointer);
+			__asm__ __volatile__ ("" : : "r" (p) : "memory");
+		}
+		end = read_counter();
+		rcu_read_unlock();
+		break;
+	case OP_QUIESCENT_STATE:
+#ifdef TEST_URCU_QSBR
+		begin = read_counter();
+		for (i = 0; i < nr_loops; i++)
+			rcu_quiescent_state();
+		end = read_counter();
+		break;
+#endif
+	default:
+		return 0;
+	}
+	return end - begin;
+}
+
+static int op_supported(enum test_op op)
+{
+#ifdef TEST_URCU_QSBR
+	return 1;
+#else
+	return op != OP_QUIESCENT_STATE;
+#endif
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s <OPTIONS>\n", argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-n loops] (iterations per repetition, default: %lu)\n",
+		DEFAULT_LOOPS);
+	printf("	[-r repeats] (repetitions, the fastest is kept, default: %d)\n",
+		DEFAULT_REPEATS);
+	printf("	[-a cpu#] (affinity)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report report;
+	static int value = 8;
+	uint64_t ticks[NR_OPS];
+	long long per_op_ticks[NR_OPS], per_op_ns[NR_OPS];
+	char ticks_keys[NR_OPS][32], ns_keys[NR_OPS][32];
+	double ns_per_tick;
+	int cpu = -1;
+	unsigned int r;
+	int i;
+
+	argc = bench_report_parse_args(argc, argv);
+
+	for (i = 1; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'n':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_loops = strtoul(argv[++i], NULL, 10);
+			break;
+		case 'r':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_repeats = atoi(argv[++i]);
+			break;
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			cpu = atoi(argv[++i]);
+			break;
+		default:
+			show_usage(argc, argv);
+			return -1;
+		}
+	}
+	if (!nr_loops || !nr_repeats) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+#if HAVE_SCHED_SETAFFINITY
+	if (cpu >= 0) {
+		cpu_set_t mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+		sched_setaffinity(0, &mask);
+#else
+		sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+	}
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	counter_init();
+	ns_per_tick = calibrate();
+	rcu_set_pointer(&test_rcu_pointer, &value);
+
+	test_register_thread();
+	for (i = 0; i < NR_OPS; i++) {
+		ticks[i] = UINT64_MAX;
+		if (!op_supported(i))
+			continue;
+		for (r = 0; r < nr_repeats; r++) {
+			uint64_t t = time_loop(i);
+
+			if (t < ticks[i])
+				ticks[i] = t;
+		}
+	}
+	test_unregister_thread();
+
+	/* Costs per operation, without the loop overhead, over nr_loops. */
+	for (i = 0; i < NR_OPS; i++) {
+		long long t;
+
+		if (!op_supported(i))
+			continue;
+		t = i == OP_EMPTY ? ticks[i] : ticks[i] - ticks[OP_EMPTY];
+		if (t < 0)
+			t = 0;
+		per_op_ticks[i] = t;
+		per_op_ns[i] = t * ns_per_tick;
+	}
+
+	if (bench_report_text()) {
+		printf("READ_OVERHEAD flavor %s link %s counter %s ns_per_tick %.3f loops %lu",
+			FLAVOR, LINK, counter_name(), ns_per_tick, nr_loops);
+		for (i = 0; i < NR_OPS; i++) {
+			if (!op_supported(i))
+				continue;
+			printf(" %s_ticks %.2f %s_ns %.2f", op_names[i],
+				(double) per_op_ticks[i] / nr_loops,
+				op_names[i],
+				(double) per_op_ticks[i] * ns_per_tick
+					/ nr_loops);
+		}
+		printf("\n");
+	}
+	bench_report_init(&report, argv[0], 0);
+	bench_report_config(&report, "loops", nr_loops);
+	bench_report_config(&report, "repeats", nr_repeats);
+	bench_report_config(&report, "inline",
+		!strcmp(LINK, "inline"));
+	bench_report_thread(&report, "reader", nr_loops);
+	for (i = 0; i < NR_OPS; i++) {
+		if (!op_supported(i))
+			continue;
+		snprintf(ticks_keys[i], sizeof(ticks_keys[i]), "%s_ticks",
+			op_names[i]);
+		snprintf(ns_keys[i], sizeof(ns_keys[i]), "%s_ns",
+			op_names[i]);
+		bench_report_per_op(&report, ticks_keys[i], per_op_ticks[i]);
+		bench_report_per_op(&report, ns_keys[i], per_op_ns[i]);
+	}
+	bench_report_print(&report);
+	return 0;
+}
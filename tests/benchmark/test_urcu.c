@@ -30,11 +30,15 @@
 #include <stdio.h>
 #include <assert.h>
 #include <errno.h>
+#include <time.h>
 
 #include <urcu/arch.h>
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-report.h"
+#include "bench-latency.h"
+#include "bench-placement.h"
 #include <../common/debug-yield.h>
 
 /* hardcoded number of CPUs */
@@ -59,6 +63,22 @@ static unsigned long rduration;
 /* write-side C.S. duration, in loops */
 static unsigned long wduration;
 
+/* use synchronize_rcu_expedited() */
+static int expedited;
+
+/* grace period latency, merged by writers at exit */
+static pthread_mutex_t gp_lat_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long long gp_lat_sum_ns, gp_lat_max_ns, gp_lat_count;
+static struct bench_latency *gp_lat_hist;	/* NULL: no --latency */
+
+static unsigned long long gp_time_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static inline void loop_sleep(unsigned long loops)
 {
 	while (loops-- != 0)
@@ -76,30 +96,35 @@ static int verbose_mode;
 static unsigned int cpu_affinities[NR_CPUS];
 static unsigned int next_aff = 0;
 static int use_affinity = 0;
+static struct bench_placement placement;
 
 pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void set_affinity(void)
+static void set_affinity(enum bench_role role)
 {
 #if HAVE_SCHED_SETAFFINITY
 	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
-	if (!use_affinity)
+	if (!use_affinity && !bench_placement_enabled(&placement))
 		return;
 
 #if HAVE_SCHED_SETAFFINITY
-	ret = pthread_mutex_lock(&affinity_mutex);
-	if (ret) {
-		perror("Error in pthread mutex lock");
-		exit(-1);
-	}
-	cpu = cpu_affinities[next_aff++];
-	ret = pthread_mutex_unlock(&affinity_mutex);
-	if (ret) {
-		perror("Error in pthread mutex unlock");
-		exit(-1);
+	if (bench_placement_enabled(&placement)) {
+		cpu = bench_placement_next_cpu(&placement, role);
+	} else {
+		ret = pthread_mutex_lock(&affinity_mutex);
+		if (ret) {
+			perror("Error in pthread mutex lock");
+			exit(-1);
+		}
+		cpu = cpu_affinities[next_aff++];
+		ret = pthread_mutex_unlock(&affinity_mutex);
+		if (ret) {
+			perror("Error in pthread mutex unlock");
+			exit(-1);
+		}
 	}
 
 	CPU_ZERO(&mask);
@@ -162,7 +187,7 @@ void *thr_reader(void *_count)
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"reader", urcu_get_thread_id());
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_READER);
 
 	rcu_register_thread();
 	assert(!rcu_read_ongoing());
@@ -203,12 +228,15 @@ void *thr_reader(void *_count)
 void *thr_writer(void *_count)
 {
 	unsigned long long *count = _count;
+	unsigned long long lat_sum = 0, lat_max = 0, start, lat;
+	struct bench_latency *hist = bench_latency_thread_alloc(gp_lat_hist);
+	caa_cycles_t begin;
 	int *new, *old;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"writer", urcu_get_thread_id());
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_WRITER);
 
 	while (!test_go)
 	{
@@ -222,7 +250,17 @@ void *thr_writer(void *_count)
 		old = rcu_xchg_pointer(&test_rcu_pointer, new);
 		if (caa_unlikely(wduration))
 			loop_sleep(wduration);
-		synchronize_rcu();
+		start = gp_time_ns();
+		begin = bench_latency_begin(hist);
+		if (expedited)
+			synchronize_rcu_expedited();
+		else
+			synchronize_rcu();
+		bench_latency_end(hist, begin);
+		lat = gp_time_ns() - start;
+		lat_sum += lat;
+		if (lat > lat_max)
+			lat_max = lat;
 		if (old)
 			*old = 0;
 		free(old);
@@ -236,6 +274,14 @@ void *thr_writer(void *_count)
 	printf_verbose("thread_end %s, tid %lu\n",
 			"writer", urcu_get_thread_id());
 	*count = URCU_TLS(nr_writes);
+	pthread_mutex_lock(&gp_lat_mutex);
+	gp_lat_sum_ns += lat_sum;
+	gp_lat_count += *count;
+	if (lat_max > gp_lat_max_ns)
+		gp_lat_max_ns = lat_max;
+	pthread_mutex_unlock(&gp_lat_mutex);
+	bench_latency_merge(gp_lat_hist, hist);
+	bench_latency_free(hist);
 	return ((void*)2);
 }
 
@@ -248,13 +294,16 @@ void show_usage(int argc, char **argv)
 	printf("	[-d delay] (writer period (us))\n");
 	printf("	[-c duration] (reader C.S. duration (in loops))\n");
 	printf("	[-e duration] (writer C.S. duration (in loops))\n");
+	printf("	[-x] (use synchronize_rcu_expedited())\n");
 	printf("	[-v] (verbose output)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--placement=compact|scatter|core|split] (topology-aware affinity)\n");
 	printf("\n");
 }
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	int err;
 	pthread_t *tid_reader, *tid_writer;
 	void *tret;
@@ -262,6 +311,10 @@ int main(int argc, char **argv)
 	unsigned long long tot_reads = 0, tot_writes = 0;
 	int i, a;
 
+	argc = bench_report_parse_args(argc, argv);
+	argc = bench_latency_parse_args(argc, argv);
+	argc = bench_placement_parse_args(&placement, argc, argv);
+	gp_lat_hist = bench_latency_alloc("synchronize_rcu");
 	if (argc < 4) {
 		show_usage(argc, argv);
 		return -1;
@@ -329,6 +382,9 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose_mode = 1;
 			break;
+		case 'x':
+			expedited = 1;
+			break;
 		}
 	}
 
@@ -382,12 +438,43 @@ int main(int argc, char **argv)
 	
 	printf_verbose("total number of reads : %llu, writes %llu\n", tot_reads,
 	       tot_writes);
-	printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu wdur %6lu "
-		"nr_writers %3u "
-		"wdelay %6lu nr_reads %12llu nr_writes %12llu nr_ops %12llu\n",
-		argv[0], duration, nr_readers, rduration, wduration,
-		nr_writers, wdelay, tot_reads, tot_writes,
-		tot_reads + tot_writes);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu wdur %6lu "
+			"nr_writers %3u "
+			"wdelay %6lu nr_reads %12llu nr_writes %12llu nr_ops %12llu\n",
+			argv[0], duration, nr_readers, rduration, wduration,
+			nr_writers, wdelay, tot_reads, tot_writes,
+			tot_reads + tot_writes);
+	if (gp_lat_count && bench_report_text())
+		printf("GP latency %s avg %llu ns max %llu ns\n",
+			expedited ? "expedited" : "normal",
+			gp_lat_sum_ns / gp_lat_count, gp_lat_max_ns);
+	if (bench_report_text()) {
+		bench_latency_print(gp_lat_hist);
+		bench_placement_print(&placement, "reader", "writer");
+	}
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_readers", nr_readers);
+	bench_report_config(&report, "rdur", rduration);
+	bench_report_config(&report, "wdur", wduration);
+	bench_report_config(&report, "nr_writers", nr_writers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "expedited", expedited);
+	bench_report_config(&report, "placement", placement.policy);
+	for (i = 0; i < nr_readers; i++)
+		bench_report_thread(&report, "reader", count_reader[i]);
+	for (i = 0; i < nr_writers; i++)
+		bench_report_thread(&report, "writer", count_writer[i]);
+	bench_report_result(&report, "nr_reads", tot_reads);
+	bench_report_result(&report, "nr_writes", tot_writes);
+	bench_report_result(&report, "nr_ops", tot_reads + tot_writes);
+	bench_report_result(&report, "gp_lat_avg_ns",
+		gp_lat_count ? gp_lat_sum_ns / gp_lat_count : 0);
+	bench_report_result(&report, "gp_lat_max_ns", gp_lat_max_ns);
+	bench_latency_report(&report, gp_lat_hist);
+	bench_report_print(&report);
+	bench_latency_free(gp_lat_hist);
+	bench_placement_destroy(&placement);
 	free(test_rcu_pointer);
 	free(tid_reader);
 	free(tid_writer);
@@ -0,0 +1,395 @@
+/*
+ * test_urcu_gp_latency.c
+ *
+ * Userspace RCU library - grace period latency benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * One updater thread replaces a pointer and waits for a grace period in
+ * a loop, while nr_readers threads run read-side critical sections of
+ * a given length. Prints the grace period latency percentiles and the
+ * CPU time of the updater as a single line of key=value pairs.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <urcu/arch.h>
+
+#include "cpuset.h"
+#include "thread-id.h"
+#include "bench-report.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#define _LGPL_SOURCE
+#if defined(TEST_URCU_QSBR)
+#include <urcu-qsbr.h>
+#define FLAVOR	"qsbr"
+#elif defined(TEST_URCU_BP)
+#include <urcu-bp.h>
+#define FLAVOR	"bp"
+#elif defined(TEST_URCU_PERCPU)
+#include <urcu-percpu.h>
+#define FLAVOR	"percpu"
+#elif defined(TEST_URCU_EBR)
+#include <urcu-ebr.h>
+#define FLAVOR	"ebr"
+#else
+#include <urcu.h>
+#if defined(RCU_MB)
+#define FLAVOR	"mb"
+#elif defined(RCU_SIGNAL)
+#define FLAVOR	"signal"
+#else
+#define FLAVOR	"memb"
+#endif
+#endif
+
+/* The bp and percpu flavors do not need readers to register. */
+#if defined(TEST_URCU_BP) || defined(TEST_URCU_PERCPU)
+#define test_register_thread()
+#define test_unregister_thread()
+#else
+#define test_register_thread()		rcu_register_thread()
+#define test_unregister_thread()	rcu_unregister_thread()
+#endif
+
+#ifdef TEST_URCU_QSBR
+#define test_quiescent_state()		rcu_quiescent_state()
+#else
+#define test_quiescent_state()
+#endif
+
+static volatile int test_go, test_stop;
+
+static int *test_rcu_pointer;
+
+static unsigned long duration;
+
+/* read-side C.S. duration, in loops */
+static unsigned long rduration;
+
+/* delay between grace periods, in loops */
+static unsigned long wdelay;
+
+static unsigned int nr_readers;
+
+/* Grace period latencies of the updater, in ns. */
+static uint64_t *gp_lat;
+static unsigned long nr_gp, gp_lat_alloc;
+static uint64_t updater_cpu_ns;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(clock, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+void *thr_reader(void *arg)
+{
+	int *local_ptr;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	set_affinity();
+
+	test_register_thread();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		rcu_read_lock();
+		local_ptr = rcu_dereference(test_rcu_pointer);
+		if (local_ptr)
+			assert(*local_ptr == 8);
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+		rcu_read_unlock();
+		test_quiescent_state();
+		if (caa_unlikely(test_stop))
+			break;
+	}
+
+	test_unregister_thread();
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+void *thr_updater(void *arg)
+{
+	uint64_t start, cpu_start;
+	int *new, *old;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	for (;;) {
+		new = malloc(sizeof(int));
+		assert(new);
+		*new = 8;
+		old = rcu_xchg_pointer(&test_rcu_pointer, new);
+		start = clock_ns(CLOCK_MONOTONIC);
+		synchronize_rcu();
+		if (nr_gp == gp_lat_alloc) {
+			gp_lat_alloc = gp_lat_alloc ? 2 * gp_lat_alloc : 4096;
+			gp_lat = realloc(gp_lat, gp_lat_alloc * sizeof(*gp_lat));
+			assert(gp_lat);
+		}
+		gp_lat[nr_gp++] = clock_ns(CLOCK_MONOTONIC) - start;
+		if (old)
+			*old = 0;
+		free(old);
+		if (caa_unlikely(test_stop))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+	}
+	updater_cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+	return ((void*)2);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Latency at @permille of the sorted samples. */
+static uint64_t gp_lat_percentile(unsigned int permille)
+{
+	if (!nr_gp)
+		return 0;
+	return gp_lat[(nr_gp - 1) * permille / 1000];
+}
+
+void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_readers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-c duration] (reader C.S. duration (in loops))\n");
+	printf("	[-d delay] (delay between grace periods (in loops))\n");
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report report;
+	int err;
+	pthread_t *tid_reader, tid_updater;
+	void *tret;
+	int i, a;
+
+	argc = bench_report_parse_args(argc, argv);
+	if (argc < 3) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_readers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 3; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'c':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			rduration = atol(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, %u readers.\n",
+		duration, nr_readers);
+	printf_verbose("Reader duration : %lu loops.\n", rduration);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+
+	next_aff = 0;
+
+	for (i = 0; i < nr_readers; i++) {
+		err = pthread_create(&tid_reader[i], NULL, thr_reader, NULL);
+		if (err != 0)
+			exit(1);
+	}
+	err = pthread_create(&tid_updater, NULL, thr_updater, NULL);
+	if (err != 0)
+		exit(1);
+
+	cmm_smp_mb();
+
+	test_go = 1;
+
+	sleep(duration);
+
+	test_stop = 1;
+
+	for (i = 0; i < nr_readers; i++) {
+		err = pthread_join(tid_reader[i], &tret);
+		if (err != 0)
+			exit(1);
+	}
+	err = pthread_join(tid_updater, &tret);
+	if (err != 0)
+		exit(1);
+
+	qsort(gp_lat, nr_gp, sizeof(*gp_lat), cmp_u64);
+	if (bench_report_text())
+		printf("GP_LATENCY flavor=%s nr_readers=%u rdur=%lu wdelay=%lu "
+			"testdur=%lu nr_gp=%lu p50_ns=%llu p99_ns=%llu "
+			"p999_ns=%llu max_ns=%llu updater_cpu_ns=%llu\n",
+			FLAVOR, nr_readers, rduration, wdelay, duration, nr_gp,
+			(unsigned long long) gp_lat_percentile(500),
+			(unsigned long long) gp_lat_percentile(990),
+			(unsigned long long) gp_lat_percentile(999),
+			(unsigned long long) gp_lat_percentile(1000),
+			(unsigned long long) updater_cpu_ns);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_readers", nr_readers);
+	bench_report_config(&report, "rdur", rduration);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_thread(&report, "updater", nr_gp);
+	bench_report_result(&report, "nr_gp", nr_gp);
+	bench_report_result(&report, "p50_ns", gp_lat_percentile(500));
+	bench_report_result(&report, "p99_ns", gp_lat_percentile(990));
+	bench_report_result(&report, "p999_ns", gp_lat_percentile(999));
+	bench_report_result(&report, "max_ns", gp_lat_percentile(1000));
+	bench_report_result(&report, "updater_cpu_ns", updater_cpu_ns);
+	bench_report_print(&report);
+	free(test_rcu_pointer);
+	free(gp_lat);
+	free(tid_reader);
+	return 0;
+}
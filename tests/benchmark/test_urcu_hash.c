@@ -20,11 +20,14 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <poll.h>
+#include <math.h>
 #include "test_urcu_hash.h"
 
 enum test_hash {
 	TEST_HASH_RW,
 	TEST_HASH_UNIQUE,
+	TEST_HASH_MAP,
 };
 
 struct test_hash_cb {
@@ -51,6 +54,13 @@ struct test_hash_cb test_hash_cb[] = {
 		test_hash_unique_thr_writer,
 		test_hash_unique_populate_hash,
 	},
+	[TEST_HASH_MAP] = {
+		test_hash_map_sigusr1_handler,
+		test_hash_map_sigusr2_handler,
+		test_hash_map_thr_reader,
+		test_hash_map_thr_writer,
+		test_hash_map_populate_hash,
+	},
 
 };
 
@@ -88,8 +98,11 @@ DEFINE_URCU_TLS(unsigned long, nr_del);
 DEFINE_URCU_TLS(unsigned long, nr_delnoent);
 DEFINE_URCU_TLS(unsigned long, lookup_fail);
 DEFINE_URCU_TLS(unsigned long, lookup_ok);
+DEFINE_URCU_TLS(unsigned long, key_seq);
 
 struct cds_lfht *test_ht;
+struct bench_latency *lookup_lat;	/* Single lookups, with --latency */
+struct bench_perf *perf_totals;		/* All threads, with --perf */
 
 volatile int test_go, test_stop;
 
@@ -104,7 +117,25 @@ unsigned long init_hash_size = DEFAULT_HASH_SIZE;
 unsigned long min_hash_alloc_size = DEFAULT_MIN_ALLOC_SIZE;
 unsigned long max_hash_buckets_size = (1UL << 20);
 unsigned long init_populate;
+unsigned long bulk_populate;	/* 0: add nodes one by one */
+int array_populate;
+unsigned long lookup_batch;	/* 0: lookup keys one by one */
+static int opt_freeze;
+static int opt_snapshot;
+struct cds_lfht_frozen *test_frozen;	/* NULL: lookup in test_ht */
 int opt_auto_resize;
+int opt_free_bulk;
+static int opt_call_rcu_steal, opt_call_rcu_shared_gp;
+static int opt_call_rcu_eventfd;
+static unsigned int opt_call_rcu_helpers;
+int opt_incremental_resize;
+static struct cds_lfht_resize_policy *resize_policy;	/* NULL: default policy */
+static unsigned int nr_resize_workers;	/* 0: default resize worker */
+static unsigned long count_ranges;	/* 0: no range traversal check */
+static unsigned long hash_range_width;	/* 0: no hash range lookup check */
+static int opt_clear;
+static unsigned long presize;	/* 0: no asynchronous resize at start */
+static unsigned long presize_done_size;
 int add_only, add_unique, add_replace;
 const struct cds_lfht_mm_type *memory_backend;
 
@@ -115,6 +146,39 @@ unsigned long init_pool_size = DEFAULT_RAND_POOL,
 int validate_lookup;
 unsigned long nr_hash_chains;	/* 0: normal table, other: number of hash chains */
 
+enum key_dist key_dist;
+static double zipf_theta = 0.99;
+static unsigned long hotspot_keys = 10, hotspot_ops = 90;	/* percents */
+struct key_pool lookup_keys, write_keys;
+unsigned long writer_mix[NR_WRITER_OPS];
+
+struct timeline_slot *timeline;	/* NULL: no resize under load (-L) */
+unsigned long timeline_nr_slots;
+caa_cycles_t timeline_start, timeline_slot_cycles;
+pthread_mutex_t timeline_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long timeline_slot_ms = 10;
+static double timeline_ns_per_cycle;
+
+/* Resizes of the resize thread, alternately to large and small (-L). */
+static unsigned long resize_period_ms;
+static unsigned long resize_small, resize_large;
+
+struct resize_event {
+	caa_cycles_t begin, end;
+	unsigned long size;
+};
+
+static struct resize_event *resize_events;
+static unsigned long nr_resize_events, max_resize_events;
+unsigned long writer_mix_total;
+
+static const char *key_dist_names[] = {
+	[KEY_DIST_UNIFORM] = "uniform",
+	[KEY_DIST_ZIPF] = "zipf",
+	[KEY_DIST_HOTSPOT] = "hotspot",
+	[KEY_DIST_SEQ] = "seq",
+};
+
 int count_pipe[2];
 
 int verbose_mode;
@@ -122,6 +186,7 @@ int verbose_mode;
 unsigned int cpu_affinities[NR_CPUS];
 unsigned int next_aff = 0;
 int use_affinity = 0;
+struct bench_placement placement;
 
 pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -133,27 +198,107 @@ unsigned int nr_writers;
 
 static pthread_mutex_t rcu_copy_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-void set_affinity(void)
+/*
+ * Zipf draws follow Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases", SIGMOD 1994: O(pool size) setup, constant time
+ * draws. Key 0 is the hottest.
+ */
+void key_pool_init(struct key_pool *pool, unsigned long offset,
+		unsigned long size)
+{
+	unsigned long i;
+	double zeta2;
+
+	pool->offset = offset;
+	pool->size = size ? size : 1;
+	switch (key_dist) {
+	case KEY_DIST_ZIPF:
+		pool->zetan = 0;
+		for (i = 1; i <= pool->size; i++)
+			pool->zetan += 1.0 / pow(i, zipf_theta);
+		pool->half_pow_theta = pow(0.5, zipf_theta);
+		zeta2 = 1.0 + pool->half_pow_theta;
+		pool->alpha = 1.0 / (1.0 - zipf_theta);
+		pool->eta = (1.0 - pow(2.0 / pool->size, 1.0 - zipf_theta))
+			/ (1.0 - zeta2 / pool->zetan);
+		break;
+	case KEY_DIST_HOTSPOT:
+		pool->hot_size = pool->size * hotspot_keys / 100;
+		if (!pool->hot_size)
+			pool->hot_size = 1;
+		break;
+	default:
+		break;
+	}
+}
+
+void *key_pool_next(struct key_pool *pool)
+{
+	unsigned int *seed = &URCU_TLS(rand_lookup);
+	unsigned long i;
+
+	switch (key_dist) {
+	case KEY_DIST_ZIPF:
+	{
+		double u, uz;
+
+		u = rand_r(seed) / ((double) RAND_MAX + 1.0);
+		uz = u * pool->zetan;
+		if (uz < 1.0)
+			i = 0;
+		else if (uz < 1.0 + pool->half_pow_theta)
+			i = 1;
+		else
+			i = pool->size * pow(pool->eta * u - pool->eta + 1.0,
+					pool->alpha);
+		if (i >= pool->size)
+			i = pool->size - 1;
+		break;
+	}
+	case KEY_DIST_HOTSPOT:
+		if (pool->hot_size == pool->size
+				|| (unsigned long) rand_r(seed) % 100 < hotspot_ops)
+			i = (unsigned long) rand_r(seed) % pool->hot_size;
+		else
+			i = pool->hot_size + (unsigned long) rand_r(seed)
+				% (pool->size - pool->hot_size);
+		break;
+	case KEY_DIST_SEQ:
+		i = URCU_TLS(key_seq)++ % pool->size;
+		break;
+	case KEY_DIST_UNIFORM:
+	default:
+		i = (unsigned long) rand_r(seed) % pool->size;
+		break;
+	}
+	return (void *) (pool->offset + i);
+}
+
+void set_affinity(enum bench_role role)
 {
 #if HAVE_SCHED_SETAFFINITY
 	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
-	if (!use_affinity)
+	if (!use_affinity && !bench_placement_enabled(&placement))
 		return;
 
 #if HAVE_SCHED_SETAFFINITY
-	ret = pthread_mutex_lock(&affinity_mutex);
-	if (ret) {
-		perror("Error in pthread mutex lock");
-		exit(-1);
-	}
-	cpu = cpu_affinities[next_aff++];
-	ret = pthread_mutex_unlock(&affinity_mutex);
-	if (ret) {
-		perror("Error in pthread mutex unlock");
-		exit(-1);
+	if (bench_placement_enabled(&placement)) {
+		cpu = bench_placement_next_cpu(&placement, role);
+	} else {
+		ret = pthread_mutex_lock(&affinity_mutex);
+		if (ret) {
+			perror("Error in pthread mutex lock");
+			exit(-1);
+		}
+		cpu = cpu_affinities[next_aff++];
+		ret = pthread_mutex_unlock(&affinity_mutex);
+		if (ret) {
+			perror("Error in pthread mutex unlock");
+			exit(-1);
+		}
 	}
 	CPU_ZERO(&mask);
 	CPU_SET(cpu, &mask);
@@ -238,6 +383,454 @@ void *thr_count(void *arg)
 	return NULL;
 }
 
+static
+void print_stats(struct cds_lfht *ht)
+{
+	struct cds_lfht_stats stats;
+	int i;
+
+	cds_lfht_get_stats(ht, &stats);
+	printf_verbose("Hash table stats: %lu buckets, %lu bucket nodes, "
+		"%lu nodes, %lu removed nodes, max chain length %lu, "
+		"%.2f probes per lookup.\n",
+		stats.size, stats.nr_bucket_nodes, stats.nr_nodes,
+		stats.nr_removed, stats.max_chain_len,
+		stats.nr_nodes ? (double) stats.nr_probes / stats.nr_nodes : 0.0);
+	for (i = 0; i < CDS_LFHT_STATS_NR_CHAIN_LEN; i++) {
+		if (!stats.chain_len[i])
+			continue;
+		printf_verbose("Chain length %2d%s: %lu buckets.\n", i,
+			i == CDS_LFHT_STATS_NR_CHAIN_LEN - 1 ? "+" : " ",
+			stats.chain_len[i]);
+	}
+}
+
+static
+void print_mem_info(struct cds_lfht *ht)
+{
+	struct cds_lfht_mem_info info;
+	int i;
+
+	cds_lfht_get_mem_info(ht, &info);
+	printf_verbose("Hash table memory: %lu buckets (max %lu), "
+		"%zu bytes table, %zu bytes split counters, "
+		"%zu bytes buckets committed, %zu bytes reserved.\n",
+		info.size, info.max_nr_buckets, info.ht_bytes,
+		info.split_count_bytes, info.bucket_bytes,
+		info.reserved_bucket_bytes);
+	for (i = 0; i < CDS_LFHT_MEM_INFO_NR_ORDERS; i++) {
+		if (!info.order_bytes[i])
+			continue;
+		printf_verbose("Bucket order %2d: %zu bytes.\n", i,
+			info.order_bytes[i]);
+	}
+}
+
+static
+void print_call_rcu_stats(const char *name, struct call_rcu_data *crdp)
+{
+	struct call_rcu_data_stats stats;
+	int i;
+
+	call_rcu_data_get_stats(crdp, &stats);
+	printf_verbose("call_rcu %s: %lu enqueued, %lu invoked, %lu batches, "
+		"%lu grace periods, delay avg %llu ns max %llu ns, "
+		"%llu ns in callbacks.\n",
+		name, stats.enqueued, stats.invoked, stats.batches,
+		stats.grace_periods,
+		stats.invoked ? (unsigned long long) (stats.delay_sum_ns
+				/ stats.invoked) : 0ULL,
+		(unsigned long long) stats.delay_max_ns,
+		(unsigned long long) stats.exec_ns);
+	for (i = 0; i < URCU_CALL_RCU_STATS_NR_BUCKETS; i++) {
+		if (!stats.delay_hist[i])
+			continue;
+		printf_verbose("call_rcu %s: delay >= %lu us: %lu callbacks.\n",
+			name, i ? 1UL << i : 0UL, stats.delay_hist[i]);
+	}
+}
+
+static
+int attach_call_rcu_helpers(unsigned int nr_helpers)
+{
+	long cpu, nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	struct call_rcu_data *crdp;
+	int ret, nr_attached = 0;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		rcu_read_lock();
+		crdp = get_cpu_call_rcu_data(cpu);
+		rcu_read_unlock();
+		if (!crdp)
+			continue;
+		ret = call_rcu_data_set_helpers(crdp, nr_helpers);
+		if (ret)
+			return ret;
+		nr_attached++;
+	}
+	if (nr_attached)
+		return 0;
+	return call_rcu_data_set_helpers(get_default_call_rcu_data(),
+			nr_helpers);
+}
+
+static
+void print_all_call_rcu_stats(void)
+{
+	long cpu, nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	struct call_rcu_data *crdp;
+	char name[32];
+
+	print_call_rcu_stats("default", get_default_call_rcu_data());
+	rcu_read_lock();
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		crdp = get_cpu_call_rcu_data(cpu);
+		if (!crdp)
+			continue;
+		snprintf(name, sizeof(name), "cpu %ld", cpu);
+		print_call_rcu_stats(name, crdp);
+	}
+	rcu_read_unlock();
+}
+
+#define NR_HASH_RANGE_SAMPLES	16
+
+static
+unsigned long node_hash(struct cds_lfht_node *node)
+{
+	struct lfht_test_node *test_node = to_test_node(node);
+
+	return test_hash(test_node->key, test_node->key_len, TEST_HASH_SEED);
+}
+
+static
+unsigned long count_nodes_in_hash_range(struct cds_lfht *ht,
+		unsigned long hash_lo, unsigned long hash_hi, int lookup)
+{
+	struct cds_lfht_range_iter range_iter;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long count = 0;
+
+	if (lookup) {
+		cds_lfht_for_each_range(ht, hash_lo, hash_hi, &range_iter, node)
+			count++;
+		return count;
+	}
+	cds_lfht_for_each(ht, &iter, node) {
+		unsigned long hash = node_hash(node);
+
+		if (hash >= hash_lo && hash <= hash_hi)
+			count++;
+	}
+	return count;
+}
+
+/*
+ * Compare hash range lookups to filtered traversals, for the whole hash
+ * space split in two halves, and for ranges of "width" hashes starting
+ * at the hash of, or just before, a few nodes.
+ */
+static
+int check_hash_ranges(struct cds_lfht *ht, unsigned long width,
+		unsigned long count)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long lo_count, hi_count, nr_samples = 0;
+
+	lo_count = count_nodes_in_hash_range(ht, 0, ULONG_MAX >> 1, 1);
+	hi_count = count_nodes_in_hash_range(ht, (ULONG_MAX >> 1) + 1,
+			ULONG_MAX, 1);
+	if (lo_count + hi_count != count) {
+		printf("Hash range lookups found %lu nodes instead of %lu.\n",
+			lo_count + hi_count, count);
+		return -1;
+	}
+	cds_lfht_for_each(ht, &iter, node) {
+		unsigned long hash, lo, hi, found, expect;
+
+		if (nr_samples++ == NR_HASH_RANGE_SAMPLES)
+			break;
+		hash = node_hash(node);
+		lo = hash - (hash < width / 2 ? hash : width / 2);
+		hi = ULONG_MAX - lo < width - 1 ? ULONG_MAX : lo + width - 1;
+		found = count_nodes_in_hash_range(ht, lo, hi, 1);
+		expect = count_nodes_in_hash_range(ht, lo, hi, 0);
+		if (found != expect) {
+			printf("Hash range [%lx, %lx] lookup found %lu nodes instead of %lu.\n",
+				lo, hi, found, expect);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static
+void presize_done(struct cds_lfht *ht, unsigned long size, void *priv)
+{
+	CMM_STORE_SHARED(presize_done_size, size);
+}
+
+/* Resize the table in the background, and report progress until done. */
+static
+int presize_table(struct cds_lfht *ht, unsigned long size)
+{
+	struct cds_lfht_resize_handle *handle;
+	unsigned long done, total, expect;
+
+	handle = cds_lfht_resize_async(ht, size, presize_done, NULL);
+	if (!handle) {
+		perror("cds_lfht_resize_async");
+		return -1;
+	}
+	while (!cds_lfht_resize_poll(handle, &done, &total)) {
+		printf_verbose("Asynchronous resize: %lu/%lu buckets.\n",
+			done, total);
+		usleep(1000);
+	}
+	cds_lfht_resize_poll(handle, &done, &total);
+	printf_verbose("Asynchronous resize done: %lu buckets, %lu/%lu buckets resized.\n",
+		presize_done_size, done, total);
+	if (cds_lfht_resize_handle_destroy(handle))
+		abort();
+	expect = size < max_hash_buckets_size ? size : max_hash_buckets_size;
+	if (presize_done_size != expect) {
+		printf("Asynchronous resize to %lu buckets ended with %lu buckets.\n",
+			expect, presize_done_size);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Resize the table to resize_large then resize_small buckets,
+ * alternately, every resize_period_ms during the test, recording when
+ * each resize starts and ends.
+ */
+static
+void *thr_resize(void *arg)
+{
+	unsigned long size = resize_large;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"resize", urcu_get_thread_id());
+
+	rcu_register_thread();
+	rcu_thread_offline();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		struct resize_event *event;
+
+		(void) poll(NULL, 0, resize_period_ms);
+		if (test_stop || nr_resize_events == max_resize_events)
+			break;
+		event = &resize_events[nr_resize_events];
+		event->size = size;
+		rcu_thread_online();
+		event->begin = caa_get_cycles();
+		cds_lfht_resize(test_ht, size);
+		event->end = caa_get_cycles();
+		rcu_thread_offline();
+		nr_resize_events++;
+		size = size == resize_large ? resize_small : resize_large;
+	}
+
+	rcu_unregister_thread();
+	printf_verbose("thread_end %s, tid %lu\n",
+			"resize", urcu_get_thread_id());
+	return NULL;
+}
+
+static
+double timeline_ms(caa_cycles_t cycles)
+{
+	return (double) (cycles - timeline_start) * timeline_ns_per_cycle
+		/ 1000000.0;
+}
+
+/* Whether a resize ran during timeline slot @i. */
+static
+int timeline_slot_resizing(unsigned long i)
+{
+	caa_cycles_t begin = timeline_start + i * timeline_slot_cycles,
+		end = begin + timeline_slot_cycles;
+	unsigned long j;
+
+	for (j = 0; j < nr_resize_events; j++) {
+		if (resize_events[j].begin < end
+				&& resize_events[j].end >= begin)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Print the resizes and the lookup latency timeline, marking the slots
+ * during which a resize ran, and add the lookup latency during and
+ * outside of resizes to the results of @r.
+ */
+static
+void timeline_report(struct bench_report *r)
+{
+	/* [0]: outside of resizes, [1]: during resizes. */
+	unsigned long long nr[2] = { 0, 0 }, sum[2] = { 0, 0 },
+		max[2] = { 0, 0 };
+	caa_cycles_t resize_max = 0;
+	unsigned long i;
+
+	for (i = 0; i < nr_resize_events; i++) {
+		struct resize_event *event = &resize_events[i];
+
+		if (event->end - event->begin > resize_max)
+			resize_max = event->end - event->begin;
+		if (bench_report_text())
+			printf("RESIZE at_ms %10.3f duration_ms %10.3f size %lu\n",
+				timeline_ms(event->begin),
+				(double) (event->end - event->begin)
+					* timeline_ns_per_cycle / 1000000.0,
+				event->size);
+	}
+	for (i = 0; i < timeline_nr_slots; i++) {
+		struct timeline_slot *slot = &timeline[i];
+		int resizing = timeline_slot_resizing(i);
+
+		if (!slot->nr)
+			continue;
+		nr[resizing] += slot->nr;
+		sum[resizing] += slot->sum;
+		if (slot->max > max[resizing])
+			max[resizing] = slot->max;
+		if (bench_report_text())
+			printf("TIMELINE t_ms %8lu lookups %10llu mean_ns %8.0f max_ns %10.0f%s\n",
+				i * timeline_slot_ms, slot->nr,
+				(double) slot->sum / slot->nr
+					* timeline_ns_per_cycle,
+				slot->max * timeline_ns_per_cycle,
+				resizing ? " resize" : "");
+	}
+	if (bench_report_text())
+		printf("RESIZE_LOAD nr_resizes %lu resize_max_ms %.3f "
+			"lookup_mean_ns_resize %.0f lookup_max_ns_resize %.0f "
+			"lookup_mean_ns_idle %.0f lookup_max_ns_idle %.0f\n",
+			nr_resize_events,
+			resize_max * timeline_ns_per_cycle / 1000000.0,
+			nr[1] ? (double) sum[1] / nr[1] * timeline_ns_per_cycle : 0,
+			max[1] * timeline_ns_per_cycle,
+			nr[0] ? (double) sum[0] / nr[0] * timeline_ns_per_cycle : 0,
+			max[0] * timeline_ns_per_cycle);
+	bench_report_result(r, "nr_resizes", nr_resize_events);
+	bench_report_result(r, "resize_max_us",
+		resize_max * timeline_ns_per_cycle / 1000.0);
+	bench_report_result(r, "lookup_mean_ns_resize",
+		nr[1] ? (double) sum[1] / nr[1] * timeline_ns_per_cycle : 0);
+	bench_report_result(r, "lookup_max_ns_resize",
+		max[1] * timeline_ns_per_cycle);
+	bench_report_result(r, "lookup_mean_ns_idle",
+		nr[0] ? (double) sum[0] / nr[0] * timeline_ns_per_cycle : 0);
+	bench_report_result(r, "lookup_max_ns_idle",
+		max[0] * timeline_ns_per_cycle);
+}
+
+static
+unsigned long count_nodes_in_ranges(struct cds_lfht *ht,
+		unsigned long nr_ranges)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long range, count = 0;
+
+	for (range = 0; range < nr_ranges; range++) {
+		cds_lfht_for_each_in_range(ht, range, range + 1, nr_ranges,
+				&iter, node)
+			count++;
+	}
+	return count;
+}
+
+static
+void snapshot_serialize(struct cds_lfht_node *node, void *payload, void *priv)
+{
+	unsigned long key = (unsigned long) to_test_node(node)->key;
+
+	memcpy(payload, &key, sizeof(key));
+}
+
+static
+int snapshot_match(const void *payload, const void *key)
+{
+	return !memcmp(payload, &key, sizeof(key));
+}
+
+/*
+ * Write a snapshot of the table to a temporary file, map it, and check
+ * that each payload is found in both the mapping and the table.
+ */
+static
+int test_snapshot(struct cds_lfht *ht)
+{
+	struct cds_lfht_snapshot *snap;
+	unsigned long i, nr;
+	FILE *file;
+	int ret;
+
+	file = tmpfile();
+	if (!file) {
+		perror("tmpfile");
+		return -1;
+	}
+	rcu_read_lock();
+	ret = cds_lfht_snapshot_write(ht, fileno(file), sizeof(unsigned long),
+			snapshot_serialize, NULL);
+	rcu_read_unlock();
+	if (ret) {
+		printf("Error writing snapshot: %d.\n", ret);
+		goto end;
+	}
+	snap = cds_lfht_snapshot_map(fileno(file));
+	if (!snap) {
+		perror("cds_lfht_snapshot_map");
+		ret = -1;
+		goto end;
+	}
+	nr = cds_lfht_snapshot_count(snap);
+	rcu_read_lock();
+	for (i = 0; i < nr; i++) {
+		struct cds_lfht_iter iter;
+		const void *payload;
+		unsigned long hash, key;
+
+		/* With duplicate keys, any payload of the key can be found. */
+		payload = cds_lfht_snapshot_get(snap, i, &hash);
+		memcpy(&key, payload, sizeof(key));
+		payload = cds_lfht_snapshot_lookup(snap, hash, snapshot_match,
+				(void *) key);
+		if (!payload || !snapshot_match(payload, (void *) key)) {
+			printf("[ERROR] Snapshot lookup cannot find node.\n");
+			ret = -1;
+			break;
+		}
+		cds_lfht_test_lookup(ht, (void *) key, sizeof(void *), &iter);
+		if (!cds_lfht_iter_get_node(&iter)) {
+			printf("[ERROR] Snapshot node not found in table.\n");
+			ret = -1;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	printf_verbose("Snapshot of %lu nodes checked.\n", nr);
+	if (cds_lfht_snapshot_unmap(snap))
+		ret = -1;
+end:
+	fclose(file);
+	return ret;
+}
+
 void free_node_cb(struct rcu_head *head)
 {
 	struct lfht_test_node *node =
@@ -245,6 +838,57 @@ void free_node_cb(struct rcu_head *head)
 	free(node);
 }
 
+/* Free a node removed from the table after a grace period. */
+void free_node_rcu(struct lfht_test_node *node)
+{
+	if (opt_free_bulk)
+		free_rcu_bulk(node, NULL);
+	else
+		call_rcu(&node->head, free_node_cb);
+}
+
+/*
+ * With -W, each writer thread reclaims the nodes it removes with its
+ * own event fd call_rcu_data, as an event loop would.
+ */
+void writer_call_rcu_begin(void)
+{
+	struct call_rcu_data *crdp;
+
+	if (!opt_call_rcu_eventfd)
+		return;
+	crdp = create_call_rcu_data(URCU_CALL_RCU_EVENTFD, -1);
+	set_thread_call_rcu_data(crdp);
+}
+
+void writer_call_rcu_poll(void)
+{
+	struct call_rcu_data *crdp;
+	struct pollfd pfd;
+
+	if (!opt_call_rcu_eventfd)
+		return;
+	crdp = get_thread_call_rcu_data();
+	pfd.fd = call_rcu_data_get_fd(crdp);
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) > 0)
+		(void) call_rcu_process_ready(crdp, 4096);
+}
+
+void writer_call_rcu_end(void)
+{
+	struct call_rcu_data *crdp;
+
+	if (!opt_call_rcu_eventfd)
+		return;
+	crdp = get_thread_call_rcu_data();
+	if (verbose_mode)
+		print_call_rcu_stats("writer", crdp);
+	set_thread_call_rcu_data(NULL);
+	/* Leftover callbacks are handed over to the default thread. */
+	call_rcu_data_free(crdp);
+}
+
 static
 void test_delete_all_nodes(struct cds_lfht *ht)
 {
@@ -257,12 +901,18 @@ void test_delete_all_nodes(struct cds_lfht *ht)
 
 		ret = cds_lfht_del(test_ht, cds_lfht_iter_get_node(&iter));
 		assert(!ret);
-		call_rcu(&node->head, free_node_cb);
+		free_node_rcu(node);
 		count++;
 	}
 	printf("deleted %lu nodes.\n", count);
 }
 
+static
+void clear_free_node(struct cds_lfht_node *node, void *priv)
+{
+	free(caa_container_of(node, struct lfht_test_node, node));
+}
+
 void show_usage(int argc, char **argv)
 {
 	printf("Usage : %s nr_readers nr_writers duration (s) <OPTIONS>\n",
@@ -273,6 +923,8 @@ void show_usage(int argc, char **argv)
 	printf("        [-c duration] (reader C.S. duration (in loops))\n");
 	printf("        [-v] (verbose output)\n");
 	printf("        [-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("        [--placement=compact|scatter|core|split] (topology-aware affinity)\n");
+	printf("        [--perf[=0xCONFIG]] (hardware counters, and raw event CONFIG)\n");
 	printf("        [-h size] (initial number of buckets)\n");
 	printf("        [-m size] (minimum number of allocated buckets)\n");
 	printf("        [-n size] (maximum number of buckets)\n");
@@ -281,26 +933,53 @@ printf("        [not -u nor -s] Add entries (supports redundant keys).\n");
 	printf("        [-s] Replace (swap) entries.\n");
 	printf("        [-i] Add only (no removal).\n");
 	printf("        [-k nr_nodes] Number of nodes to insert initially.\n");
+	printf("        [-b nr_nodes] Insert initial nodes in batches of nr_nodes.\n");
+	printf("        [-F] Build the table from an array of the initial nodes.\n");
+	printf("        [-l nr_keys] Lookup keys in batches of nr_keys (rw test).\n");
+	printf("        [-j] Check a snapshot file of the initial nodes.\n");
+	printf("        [-z] Lookup in a frozen snapshot of the initial nodes (rw test, no writer).\n");
 	printf("        [-A] Automatically resize hash table.\n");
-	printf("        [-B order|chunk|mmap] Specify the memory backend.\n");
+	printf("        [-I] Grow hash table incrementally from updaters (with -A).\n");
+	printf("        [-H order] Shrink hash table when load factor falls below 2^order.\n");
+	printf("        [-G ms] Minimum interval between automatic resizes.\n");
+	printf("        [-P nr_workers] Resize with a pool of nr_workers threads (with -A).\n");
+	printf("        [-Q size] Resize hash table asynchronously to size buckets before populating (with -A).\n");
+	printf("        [-L ms:small:large] Resize between small and large buckets every ms, timing lookups (rw test).\n");
+	printf("        [-t ms] Lookup latency timeline slot with -L (default 10).\n");
+	printf("        [-x] Remove final nodes with cds_lfht_clear().\n");
+	printf("        [-y] Free removed nodes with free_rcu_bulk().\n");
+	printf("        [-D] Balance callbacks across per-CPU call_rcu threads.\n");
+	printf("        [-g] Share grace periods across per-CPU call_rcu threads.\n");
+	printf("        [-W] Writers invoke their own callbacks from an event fd.\n");
+	printf("        [-K helpers] Invoke call_rcu batches with helpers per call_rcu thread.\n");
+	printf("        [-e nr_ranges] Check final node count by traversing nr_ranges ranges.\n");
+	printf("        [-E width] Check hash range lookups of width hashes around final nodes.\n");
+	printf("        [-B order|chunk|mmap|mmap_huge|numa] Specify the memory backend.\n");
 	printf("        [-R offset] Lookup pool offset.\n");
 	printf("        [-S offset] Write pool offset.\n");
 	printf("        [-T offset] Init pool offset.\n");
 	printf("        [-M size] Lookup pool size.\n");
 	printf("        [-N size] Write pool size.\n");
 	printf("        [-O size] Init pool size.\n");
+	printf("        [-X uniform|zipf|hotspot|seq] Key distribution of lookups and updates (rw test).\n");
+	printf("        [-Z theta] Zipf skew, between 0 and 1 exclusive (default 0.99).\n");
+	printf("        [-Y keys:ops] Hotspot of ops %% of the draws on keys %% of the pool (default 10:90).\n");
+	printf("        [-q lookup:add:del:replace] Writer operation mix weights (rw test).\n");
 	printf("        [-V] Validate lookups of init values.\n");
 	printf("		(use with filled init pool, same lookup range,\n");
 	printf("		with different write range)\n");
 	printf("	[-U] Uniqueness test.\n");
 	printf("	[-C] Number of hash chains.\n");
+	printf("	[-p lfht|mutex|rwlock|rculist|rcuhtable] Map test against cds_lfht or a baseline map.\n");
 	printf("\n");
 }
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	pthread_t *tid_reader, *tid_writer;
-	pthread_t tid_count;
+	pthread_t tid_count, tid_resize;
+	int resize_created = 0;
 	void *tret;
 	unsigned long long *count_reader;
 	struct wr_count *count_writer;
@@ -313,7 +992,15 @@ int main(int argc, char **argv)
 	unsigned int remain;
 	unsigned int nr_readers_created = 0, nr_writers_created = 0;
 	long long nr_leaked;
-
+	struct cds_lfht_resize_pool *resize_pool = NULL;
+	struct cds_lfht_resize_policy policy = CDS_LFHT_RESIZE_POLICY_DEFAULT;
+
+	argc = bench_report_parse_args(argc, argv);
+	argc = bench_latency_parse_args(argc, argv);
+	argc = bench_placement_parse_args(&placement, argc, argv);
+	argc = bench_perf_parse_args(argc, argv);
+	perf_totals = bench_perf_alloc();
+	lookup_lat = bench_latency_alloc("cds_lfht_lookup");
 	if (argc < 4) {
 		show_usage(argc, argv);
 		mainret = 1;
@@ -425,9 +1112,115 @@ int main(int argc, char **argv)
 		case 'k':
 			init_populate = atol(argv[++i]);
 			break;
+		case 'b':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			bulk_populate = atol(argv[++i]);
+			break;
+		case 'F':
+			array_populate = 1;
+			break;
+		case 'l':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			lookup_batch = atol(argv[++i]);
+			break;
 		case 'A':
 			opt_auto_resize = 1;
 			break;
+		case 'I':
+			opt_incremental_resize = 1;
+			break;
+		case 'H':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			policy.shrink_load_order = atol(argv[++i]);
+			resize_policy = &policy;
+			break;
+		case 'P':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			nr_resize_workers = atol(argv[++i]);
+			break;
+		case 'j':
+			opt_snapshot = 1;
+			break;
+		case 'z':
+			opt_freeze = 1;
+			break;
+		case 'x':
+			opt_clear = 1;
+			break;
+		case 'y':
+			opt_free_bulk = 1;
+			break;
+		case 'D':
+			opt_call_rcu_steal = 1;
+			break;
+		case 'g':
+			opt_call_rcu_shared_gp = 1;
+			break;
+		case 'W':
+			opt_call_rcu_eventfd = 1;
+			break;
+		case 'E':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			hash_range_width = atol(argv[++i]);
+			break;
+		case 'K':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			opt_call_rcu_helpers = atol(argv[++i]);
+			break;
+		case 'Q':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			presize = atol(argv[++i]);
+			break;
+		case 'e':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			count_ranges = atol(argv[++i]);
+			if (count_ranges & (count_ranges - 1)) {
+				printf("Number of ranges must be a power of 2.\n");
+				mainret = 1;
+				goto end;
+			}
+			break;
+		case 'G':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			policy.min_interval_ms = atol(argv[++i]);
+			resize_policy = &policy;
+			break;
 		case 'B':
 			if (argc < i + 2) {
 				show_usage(argc, argv);
@@ -441,8 +1234,12 @@ int main(int argc, char **argv)
 				memory_backend = &cds_lfht_mm_chunk;
 			else if (!strcmp("mmap", argv[i]))
 				memory_backend = &cds_lfht_mm_mmap;
+			else if (!strcmp("mmap_huge", argv[i]))
+				memory_backend = &cds_lfht_mm_mmap_huge;
+			else if (!strcmp("numa", argv[i]))
+				memory_backend = &cds_lfht_mm_numa;
 			else {
-				printf("Please specify memory backend with order|chunk|mmap.\n");
+				printf("Please specify memory backend with order|chunk|mmap|mmap_huge|numa.\n");
 				mainret = 1;
 				goto end;
 			}
@@ -465,6 +1262,108 @@ int main(int argc, char **argv)
 		case 'O':
 			init_pool_size = atol(argv[++i]);
 			break;
+		case 'X':
+		{
+			unsigned int d;
+
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			i++;
+			for (d = 0; d < CAA_ARRAY_SIZE(key_dist_names); d++) {
+				if (!strcmp(key_dist_names[d], argv[i]))
+					break;
+			}
+			if (d == CAA_ARRAY_SIZE(key_dist_names)) {
+				printf("Please specify key distribution with uniform|zipf|hotspot|seq.\n");
+				mainret = 1;
+				goto end;
+			}
+			key_dist = d;
+			break;
+		}
+		case 'Z':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			zipf_theta = atof(argv[++i]);
+			if (!(zipf_theta > 0 && zipf_theta < 1)) {
+				printf("Zipf theta must be between 0 and 1 exclusive.\n");
+				mainret = 1;
+				goto end;
+			}
+			break;
+		case 'L':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			if (sscanf(argv[++i], "%lu:%lu:%lu", &resize_period_ms,
+					&resize_small, &resize_large) != 3
+					|| !resize_period_ms
+					|| !resize_small || !resize_large
+					|| resize_small & (resize_small - 1)
+					|| resize_large & (resize_large - 1)) {
+				printf("Please specify the resizes as ms:small:large, with powers of 2 sizes.\n");
+				mainret = 1;
+				goto end;
+			}
+			break;
+		case 't':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			timeline_slot_ms = atol(argv[++i]);
+			if (!timeline_slot_ms) {
+				printf("Timeline slot must be at least 1 ms.\n");
+				mainret = 1;
+				goto end;
+			}
+			break;
+		case 'Y':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			if (sscanf(argv[++i], "%lu:%lu", &hotspot_keys,
+					&hotspot_ops) != 2
+					|| hotspot_keys > 100 || hotspot_ops > 100) {
+				printf("Please specify hotspot as keys:ops percents.\n");
+				mainret = 1;
+				goto end;
+			}
+			break;
+		case 'q':
+		{
+			unsigned int op;
+
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			if (sscanf(argv[++i], "%lu:%lu:%lu:%lu",
+					&writer_mix[WRITER_OP_LOOKUP],
+					&writer_mix[WRITER_OP_ADD],
+					&writer_mix[WRITER_OP_DEL],
+					&writer_mix[WRITER_OP_REPLACE]) != 4) {
+				printf("Please specify writer mix as lookup:add:del:replace weights.\n");
+				mainret = 1;
+				goto end;
+			}
+			writer_mix_total = 0;
+			for (op = 0; op < NR_WRITER_OPS; op++)
+				writer_mix_total += writer_mix[op];
+			break;
+		}
 		case 'V':
 			validate_lookup = 1;
 			break;
@@ -474,10 +1373,40 @@ int main(int argc, char **argv)
 		case 'C':
 			nr_hash_chains = atol(argv[++i]);
 			break;
+		case 'p':
+		{
+			unsigned int m;
+
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			i++;
+			for (m = 0; m < NR_HASH_MAPS; m++) {
+				if (!strcmp(hash_map_names[m], argv[i]))
+					break;
+			}
+			if (m == NR_HASH_MAPS) {
+				printf("Please specify map with lfht|mutex|rwlock|rculist|rcuhtable.\n");
+				mainret = 1;
+				goto end;
+			}
+			hash_map = m;
+			test_choice = TEST_HASH_MAP;
+			break;
+		}
 		}
 	}
 
 	/* Check if hash size is power of 2 */
+	if (presize && (presize & (presize - 1) || !opt_auto_resize)) {
+		printf("Error: Asynchronous resize size (%lu) should be a power of 2, with -A.\n",
+			presize);
+		mainret = 1;
+		goto end;
+	}
+
 	if (init_hash_size && init_hash_size & (init_hash_size - 1)) {
 		printf("Error: Initial number of buckets (%lu) is not a power of 2.\n",
 			init_hash_size);
@@ -499,6 +1428,50 @@ int main(int argc, char **argv)
 		goto end;
 	}
 
+	if (array_populate && (add_unique || add_replace
+			|| test_choice != TEST_HASH_RW)) {
+		printf("Error: Building from an array (-F) only supports the rw test in add mode.\n");
+		mainret = 1;
+		goto end;
+	}
+
+	if (opt_freeze && (nr_writers || lookup_batch
+			|| test_choice != TEST_HASH_RW)) {
+		printf("Error: Frozen snapshot lookups (-z) only support the rw test without writers.\n");
+		mainret = 1;
+		goto end;
+	}
+
+	if ((key_dist != KEY_DIST_UNIFORM && test_choice == TEST_HASH_UNIQUE)
+			|| (writer_mix_total && test_choice != TEST_HASH_RW)) {
+		printf("Error: Key distributions (-X) only support the rw and map tests, writer mixes (-q) the rw test.\n");
+		mainret = 1;
+		goto end;
+	}
+
+	if (test_choice == TEST_HASH_MAP && (add_unique || add_replace
+			|| init_populate > init_pool_size)) {
+		printf("Error: The map test (-p) adds unique keys: it needs no -u nor -s, and at most %lu initial nodes.\n",
+			init_pool_size);
+		mainret = 1;
+		goto end;
+	}
+	if (resize_period_ms && (test_choice != TEST_HASH_RW || lookup_batch
+			|| opt_freeze)) {
+		printf("Error: Resizes under load (-L) only support the rw test with single lookups.\n");
+		mainret = 1;
+		goto end;
+	}
+
+	if (resize_period_ms && resize_large > max_hash_buckets_size) {
+		printf("Error: Resize size (%lu) above the maximum number of buckets (%lu).\n",
+			resize_large, max_hash_buckets_size);
+		mainret = 1;
+		goto end;
+	}
+	key_pool_init(&lookup_keys, lookup_pool_offset, lookup_pool_size);
+	key_pool_init(&write_keys, write_pool_offset, write_pool_size);
+
 	memset(&act, 0, sizeof(act));
 	ret = sigemptyset(&act.sa_mask);
 	if (ret == -1) {
@@ -542,6 +1515,18 @@ int main(int argc, char **argv)
 		write_pool_offset, write_pool_size);
 	printf_verbose("Number of hash chains: %lu.\n",
 		nr_hash_chains);
+	printf_verbose("Key distribution: %s.\n", key_dist_names[key_dist]);
+	if (key_dist == KEY_DIST_ZIPF)
+		printf_verbose("Zipf theta: %g.\n", zipf_theta);
+	if (key_dist == KEY_DIST_HOTSPOT)
+		printf_verbose("Hotspot: %lu%% of the draws on %lu%% of the keys.\n",
+			hotspot_ops, hotspot_keys);
+	if (writer_mix_total)
+		printf_verbose("Writer mix: lookup %lu add %lu del %lu replace %lu.\n",
+			writer_mix[WRITER_OP_LOOKUP],
+			writer_mix[WRITER_OP_ADD],
+			writer_mix[WRITER_OP_DEL],
+			writer_mix[WRITER_OP_REPLACE]);
 	printf_verbose("thread %-6s, tid %lu\n",
 			"main", urcu_get_thread_id());
 
@@ -565,37 +1550,102 @@ int main(int argc, char **argv)
 		mainret = 1;
 		goto end_free_count_reader;
 	}
+	if (resize_period_ms) {
+		bench_latency_calibrate();
+		timeline_ns_per_cycle = bench_latency_ns_per_cycle;
+		timeline_slot_cycles = timeline_slot_ms * 1000000.0
+			/ timeline_ns_per_cycle;
+		if (!timeline_slot_cycles)
+			timeline_slot_cycles = 1;
+		timeline_nr_slots = duration * 1000 / timeline_slot_ms + 1;
+		max_resize_events = duration * 1000 / resize_period_ms + 1;
+		timeline = calloc(timeline_nr_slots, sizeof(*timeline));
+		resize_events = calloc(max_resize_events,
+				sizeof(*resize_events));
+		if (!timeline || !resize_events) {
+			mainret = 1;
+			goto end_free_count_reader;
+		}
+	}
 
-	err = create_all_cpu_call_rcu_data(0);
+	err = create_all_cpu_call_rcu_data(
+			(opt_call_rcu_steal ? URCU_CALL_RCU_STEAL : 0)
+			| (opt_call_rcu_shared_gp ? URCU_CALL_RCU_SHARED_GP : 0));
 	if (err) {
 		printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
 	}
+	if (opt_call_rcu_helpers && attach_call_rcu_helpers(opt_call_rcu_helpers)) {
+		printf("Error attaching call_rcu() helper threads.\n");
+		mainret = 1;
+		goto end_free_count_reader;
+	}
 
-	if (memory_backend) {
-		test_ht = _cds_lfht_new(init_hash_size, min_hash_alloc_size,
-				max_hash_buckets_size,
+	if (array_populate) {
+		test_ht = test_hash_rw_new_from_array(
 				(opt_auto_resize ? CDS_LFHT_AUTO_RESIZE : 0) |
-				CDS_LFHT_ACCOUNTING, memory_backend,
-				&rcu_flavor, NULL);
+				(opt_incremental_resize ? CDS_LFHT_INCREMENTAL_RESIZE : 0) |
+				CDS_LFHT_ACCOUNTING);
+	} else if (memory_backend) {
+		test_ht = _cds_lfht_new_with_policy(init_hash_size,
+				min_hash_alloc_size, max_hash_buckets_size,
+				(opt_auto_resize ? CDS_LFHT_AUTO_RESIZE : 0) |
+				(opt_incremental_resize ? CDS_LFHT_INCREMENTAL_RESIZE : 0) |
+				CDS_LFHT_ACCOUNTING, resize_policy,
+				memory_backend, &rcu_flavor, NULL);
 	} else {
-		test_ht = cds_lfht_new(init_hash_size, min_hash_alloc_size,
-				max_hash_buckets_size,
+		test_ht = cds_lfht_new_with_policy(init_hash_size,
+				min_hash_alloc_size, max_hash_buckets_size,
 				(opt_auto_resize ? CDS_LFHT_AUTO_RESIZE : 0) |
-				CDS_LFHT_ACCOUNTING, NULL);
+				(opt_incremental_resize ? CDS_LFHT_INCREMENTAL_RESIZE : 0) |
+				CDS_LFHT_ACCOUNTING, resize_policy, NULL);
 	}
 	if (!test_ht) {
 		printf("Error allocating hash table.\n");
 		mainret = 1;
 		goto end_free_call_rcu_data;
 	}
+	if (nr_resize_workers && opt_auto_resize) {
+		resize_pool = cds_lfht_resize_pool_create(nr_resize_workers);
+		if (!resize_pool
+				|| cds_lfht_set_resize_pool(test_ht, resize_pool)) {
+			printf("Error creating resize pool.\n");
+			mainret = 1;
+			goto end_free_call_rcu_data;
+		}
+	}
+	/* Before registration: QSBR readers would hold off the resize. */
+	if (presize && presize_table(test_ht, presize)) {
+		mainret = 1;
+		goto end_free_call_rcu_data;
+	}
 
 	/*
 	 * Hash Population needs to be seen as a RCU reader
 	 * thread from the point of view of resize.
 	 */
 	rcu_register_thread();
-	ret = (get_populate_hash_cb())();
-	assert(!ret);
+	if (!array_populate) {
+		ret = (get_populate_hash_cb())();
+		assert(!ret);
+	}
+	if (opt_snapshot && test_snapshot(test_ht)) {
+		mainret = 1;
+		rcu_thread_offline();
+		goto end_online;
+	}
+	if (opt_freeze) {
+		rcu_read_lock();
+		test_frozen = cds_lfht_freeze(test_ht);
+		rcu_read_unlock();
+		if (!test_frozen) {
+			printf("Error creating frozen snapshot.\n");
+			mainret = 1;
+			rcu_thread_offline();
+			goto end_online;
+		}
+		printf_verbose("Frozen snapshot of %lu nodes.\n",
+			cds_lfht_frozen_count(test_frozen));
+	}
 
 	rcu_thread_offline();
 
@@ -642,7 +1692,18 @@ int main(int argc, char **argv)
 		}
 		nr_writers_created++;
 	}
+	if (resize_period_ms) {
+		err = pthread_create(&tid_resize, NULL, thr_resize, NULL);
+		if (err != 0) {
+			errno = err;
+			mainret = 1;
+			perror("pthread_create");
+			goto end_pthread_join;
+		}
+		resize_created = 1;
+	}
 
+	timeline_start = caa_get_cycles();
 	cmm_smp_mb();
 
 	test_go = 1;
@@ -676,6 +1737,14 @@ end_pthread_join:
 		tot_add_exist += count_writer[i].add_exist;
 		tot_remove += count_writer[i].remove;
 	}
+	if (resize_created) {
+		err = pthread_join(tid_resize, &tret);
+		if (err != 0) {
+			errno = err;
+			mainret = 1;
+			perror("pthread_join");
+		}
+	}
 
 	/* teardown counter thread */
 	act.sa_handler = SIG_IGN;
@@ -711,13 +1780,47 @@ end_close_pipe:
 	fflush(stdout);
 end_online:
 	rcu_thread_online();
+	cds_lfht_frozen_destroy(test_frozen);
+	if (verbose_mode) {
+		print_mem_info(test_ht);
+		print_all_call_rcu_stats();
+	}
 	rcu_read_lock();
+	if (verbose_mode)
+		print_stats(test_ht);
 	printf("Counting nodes... ");
 	cds_lfht_count_nodes(test_ht, &approx_before, &count, &approx_after);
 	printf("done.\n");
-	test_delete_all_nodes(test_ht);
+	{
+		unsigned long fast_count = 0;
+
+		if (cds_lfht_count_fast(test_ht, &fast_count)
+		    || fast_count != count) {
+			printf("Fast count found %lu nodes instead of %lu.\n",
+				fast_count, count);
+			mainret = 1;
+		}
+	}
+	if (count_ranges) {
+		unsigned long range_count;
+
+		range_count = count_nodes_in_ranges(test_ht, count_ranges);
+		if (range_count != count) {
+			printf("Range traversal found %lu nodes instead of %lu.\n",
+				range_count, count);
+			mainret = 1;
+		}
+	}
+	if (hash_range_width && check_hash_ranges(test_ht, hash_range_width,
+			count))
+		mainret = 1;
+	if (!opt_clear)
+		test_delete_all_nodes(test_ht);
 	rcu_read_unlock();
 	rcu_thread_offline();
+	if (opt_clear)
+		printf("cleared %lu nodes.\n",
+			cds_lfht_clear(test_ht, clear_free_node, NULL));
 	if (count) {
 		printf("Approximation before node accounting: %ld nodes.\n",
 			approx_before);
@@ -735,17 +1838,64 @@ end_online:
 	} else {
 		printf_verbose("final delete success\n");
 	}
+	if (resize_pool && cds_lfht_resize_pool_destroy(resize_pool)) {
+		printf_verbose("resize pool destroy aborted\n");
+		mainret = 1;
+	}
 	printf_verbose("total number of reads : %llu, writes %llu\n", tot_reads,
 	       tot_writes);
+	if (test_choice == TEST_HASH_MAP)
+		count += test_hash_map_destroy();
 	nr_leaked = (long long) tot_add + init_populate - tot_remove - count;
-	printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu "
-		"nr_writers %3u "
-		"wdelay %6lu nr_reads %12llu nr_writes %12llu nr_ops %12llu "
-		"nr_add %12llu nr_add_fail %12llu nr_remove %12llu nr_leaked %12lld\n",
-		argv[0], duration, nr_readers, rduration,
-		nr_writers, wdelay, tot_reads, tot_writes,
-		tot_reads + tot_writes, tot_add, tot_add_exist, tot_remove,
-		nr_leaked);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu "
+			"nr_writers %3u "
+			"wdelay %6lu nr_reads %12llu nr_writes %12llu nr_ops %12llu "
+			"nr_add %12llu nr_add_fail %12llu nr_remove %12llu nr_leaked %12lld\n",
+			argv[0], duration, nr_readers, rduration,
+			nr_writers, wdelay, tot_reads, tot_writes,
+			tot_reads + tot_writes, tot_add, tot_add_exist, tot_remove,
+			nr_leaked);
+	if (bench_report_text()) {
+		bench_latency_print(lookup_lat);
+		bench_placement_print(&placement, "reader", "writer");
+		bench_perf_print(perf_totals, tot_reads + tot_writes);
+	}
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_readers", nr_readers);
+	bench_report_config(&report, "rdur", rduration);
+	bench_report_config(&report, "nr_writers", nr_writers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "key_dist", key_dist);
+	bench_report_config(&report, "placement", placement.policy);
+	if (test_choice == TEST_HASH_MAP)
+		bench_report_config(&report, "map", hash_map);
+	if (timeline) {
+		bench_report_config(&report, "resize_period_ms",
+			resize_period_ms);
+		bench_report_config(&report, "resize_small", resize_small);
+		bench_report_config(&report, "resize_large", resize_large);
+	}
+	for (i = 0; i < nr_readers; i++)
+		bench_report_thread(&report, "reader", count_reader[i]);
+	for (i = 0; i < nr_writers; i++)
+		bench_report_thread(&report, "writer",
+			count_writer[i].update_ops);
+	bench_report_result(&report, "nr_reads", tot_reads);
+	bench_report_result(&report, "nr_writes", tot_writes);
+	bench_report_result(&report, "nr_ops", tot_reads + tot_writes);
+	bench_report_result(&report, "nr_add", tot_add);
+	bench_report_result(&report, "nr_add_fail", tot_add_exist);
+	bench_report_result(&report, "nr_remove", tot_remove);
+	bench_report_result(&report, "nr_leaked", nr_leaked);
+	bench_latency_report(&report, lookup_lat);
+	bench_perf_report(&report, perf_totals);
+	if (timeline)
+		timeline_report(&report);
+	bench_report_print(&report);
+	bench_latency_free(lookup_lat);
+	bench_perf_free(perf_totals);
+	bench_placement_destroy(&placement);
 	if (nr_leaked != 0) {
 		mainret = 1;
 		printf("WARNING: %lld nodes were leaked!\n", nr_leaked);
@@ -756,6 +1906,8 @@ end_free_call_rcu_data:
 	free_all_cpu_call_rcu_data();
 	free(count_writer);
 end_free_count_reader:
+	free(timeline);
+	free(resize_events);
 	free(count_reader);
 end_free_tid_writer:
 	free(tid_writer);
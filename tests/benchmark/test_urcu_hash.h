@@ -34,11 +34,15 @@
 #include <assert.h>
 #include <errno.h>
 #include <signal.h>
+#include <limits.h>
 
 #include <urcu/tls-compat.h>
 #include <compat-rand.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-latency.h"
+#include "bench-placement.h"
+#include "bench-perf.h"
 #include "../common/debug-yield.h"
 
 #define DEFAULT_HASH_SIZE	32
@@ -73,6 +77,7 @@
 #endif
 #include <urcu-qsbr.h>
 #include <urcu/rculfhash.h>
+#include <urcu/hash.h>
 #include <urcu-call-rcu.h>
 
 struct wr_count {
@@ -91,6 +96,8 @@ extern DECLARE_URCU_TLS(unsigned long, lookup_fail);
 extern DECLARE_URCU_TLS(unsigned long, lookup_ok);
 
 extern struct cds_lfht *test_ht;
+extern struct bench_latency *lookup_lat;
+extern struct bench_perf *perf_totals;
 
 struct test_data {
 	int a;
@@ -139,7 +146,13 @@ extern unsigned long init_hash_size;
 extern unsigned long min_hash_alloc_size;
 extern unsigned long max_hash_buckets_size;
 extern unsigned long init_populate;
+extern unsigned long bulk_populate;
+extern int array_populate;
+extern unsigned long lookup_batch;
+extern struct cds_lfht_frozen *test_frozen;
 extern int opt_auto_resize;
+extern int opt_free_bulk;
+extern int opt_incremental_resize;
 extern int add_only, add_unique, add_replace;
 extern const struct cds_lfht_mm_type *memory_backend;
 
@@ -151,6 +164,69 @@ extern int validate_lookup;
 
 extern unsigned long nr_hash_chains;
 
+/* Key distribution of the lookups and updates of the rw test. */
+enum key_dist {
+	KEY_DIST_UNIFORM = 0,
+	KEY_DIST_ZIPF,		/* Key i drawn with probability ~ 1/(i+1)^theta */
+	KEY_DIST_HOTSPOT,	/* A share of the draws on a share of the keys */
+	KEY_DIST_SEQ,		/* Each thread walks the pool in order */
+};
+
+struct key_pool {
+	unsigned long offset, size;
+	unsigned long hot_size;			/* KEY_DIST_HOTSPOT */
+	double zetan, eta, alpha, half_pow_theta;	/* KEY_DIST_ZIPF */
+};
+
+extern enum key_dist key_dist;
+extern struct key_pool lookup_keys, write_keys;
+extern DECLARE_URCU_TLS(unsigned long, key_seq);
+
+void key_pool_init(struct key_pool *pool, unsigned long offset,
+		unsigned long size);
+void *key_pool_next(struct key_pool *pool);
+
+/* Operations of the rw test writers, drawn from the writer_mix weights. */
+enum writer_op {
+	WRITER_OP_LOOKUP = 0,
+	WRITER_OP_ADD,
+	WRITER_OP_DEL,
+	WRITER_OP_REPLACE,
+	NR_WRITER_OPS,
+};
+
+extern unsigned long writer_mix[NR_WRITER_OPS];
+extern unsigned long writer_mix_total;	/* 0: add/remove as per -i and SIGUSR1 */
+
+/*
+ * Lookup latency timeline of the rw test readers while a resize thread
+ * alternately resizes the table between two sizes (-L). Each slot
+ * covers timeline_slot_cycles from the start of the test.
+ */
+struct timeline_slot {
+	unsigned long long nr, sum, max;	/* lookup cycles */
+};
+
+extern struct timeline_slot *timeline;	/* NULL: no -L */
+extern unsigned long timeline_nr_slots;
+extern caa_cycles_t timeline_start, timeline_slot_cycles;
+extern pthread_mutex_t timeline_mutex;
+
+static inline
+void timeline_record(struct timeline_slot *slots, caa_cycles_t begin,
+		caa_cycles_t end)
+{
+	unsigned long i = (begin - timeline_start) / timeline_slot_cycles;
+	caa_cycles_t v = end - begin;
+
+	if (caa_unlikely(i >= timeline_nr_slots))
+		return;
+	slots[i].nr++;
+	slots[i].sum += v;
+	if (v > slots[i].max)
+		slots[i].max = v;
+}
+
 extern int count_pipe[2];
 
 static inline void loop_sleep(unsigned long loops)
@@ -170,10 +246,11 @@ extern int verbose_mode;
 extern unsigned int cpu_affinities[NR_CPUS];
 extern unsigned int next_aff;
 extern int use_affinity;
+extern struct bench_placement placement;
 
 extern pthread_mutex_t affinity_mutex;
 
-void set_affinity(void);
+void set_affinity(enum bench_role role);
 
 /*
  * returns 0 if test should end.
@@ -197,135 +274,12 @@ extern unsigned int nr_writers;
 void rcu_copy_mutex_lock(void);
 void rcu_copy_mutex_unlock(void);
 
-/*
- * Hash function
- * Source: http://burtleburtle.net/bob/c/lookup3.c
- * Originally Public Domain
- */
-
-#define rot(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
-
-#define mix(a, b, c) \
-do { \
-	a -= c; a ^= rot(c,  4); c += b; \
-	b -= a; b ^= rot(a,  6); a += c; \
-	c -= b; c ^= rot(b,  8); b += a; \
-	a -= c; a ^= rot(c, 16); c += b; \
-	b -= a; b ^= rot(a, 19); a += c; \
-	c -= b; c ^= rot(b,  4); b += a; \
-} while (0)
-
-#define final(a, b, c) \
-{ \
-	c ^= b; c -= rot(b, 14); \
-	a ^= c; a -= rot(c, 11); \
-	b ^= a; b -= rot(a, 25); \
-	c ^= b; c -= rot(b, 16); \
-	a ^= c; a -= rot(c,  4);\
-	b ^= a; b -= rot(a, 14); \
-	c ^= b; c -= rot(b, 24); \
-}
-
-static inline __attribute__((unused))
-uint32_t hash_u32(
-	const uint32_t *k,	/* the key, an array of uint32_t values */
-	size_t length,		/* the length of the key, in uint32_ts */
-	uint32_t initval)	/* the previous hash, or an arbitrary value */
-{
-	uint32_t a, b, c;
-
-	/* Set up the internal state */
-	a = b = c = 0xdeadbeef + (((uint32_t) length) << 2) + initval;
-
-	/*----------------------------------------- handle most of the key */
-	while (length > 3) {
-		a += k[0];
-		b += k[1];
-		c += k[2];
-		mix(a, b, c);
-		length -= 3;
-		k += 3;
-	}
-
-	/*----------------------------------- handle the last 3 uint32_t's */
-	switch (length) {	/* all the case statements fall through */
-	case 3: c += k[2];
-	case 2: b += k[1];
-	case 1: a += k[0];
-		final(a, b, c);
-	case 0:			/* case 0: nothing left to add */
-		break;
-	}
-	/*---------------------------------------------- report the result */
-	return c;
-}
-
-static inline
-void hashword2(
-	const uint32_t *k,	/* the key, an array of uint32_t values */
-	size_t length,		/* the length of the key, in uint32_ts */
-	uint32_t *pc,		/* IN: seed OUT: primary hash value */
-	uint32_t *pb)		/* IN: more seed OUT: secondary hash value */
-{
-	uint32_t a, b, c;
-
-	/* Set up the internal state */
-	a = b = c = 0xdeadbeef + ((uint32_t) (length << 2)) + *pc;
-	c += *pb;
-
-	/*----------------------------------------- handle most of the key */
-	while (length > 3) {
-		a += k[0];
-		b += k[1];
-		c += k[2];
-		mix(a, b, c);
-		length -= 3;
-		k += 3;
-	}
-
-	/*----------------------------------- handle the last 3 uint32_t's */
-	switch (length) {	/* all the case statements fall through */
-	case 3: c += k[2];
-	case 2: b += k[1];
-	case 1: a += k[0];
-		final(a, b, c);
-	case 0:			/* case 0: nothing left to add */
-		break;
-	}
-	/*---------------------------------------------- report the result */
-	*pc = c;
-	*pb = b;
-}
-
-#if (CAA_BITS_PER_LONG == 32)
 static inline
 unsigned long test_hash_mix(const void *_key, size_t length, unsigned long seed)
 {
-	unsigned int key = (unsigned int) _key;
-
-	assert(length == sizeof(unsigned int));
-	return hash_u32(&key, 1, seed);
-}
-#else
-static inline
-unsigned long test_hash_mix(const void *_key, size_t length, unsigned long seed)
-{
-	union {
-		uint64_t v64;
-		uint32_t v32[2];
-	} v;
-	union {
-		uint64_t v64;
-		uint32_t v32[2];
-	} key;
-
 	assert(length == sizeof(unsigned long));
-	v.v64 = (uint64_t) seed;
-	key.v64 = (uint64_t) _key;
-	hashword2(key.v32, 2, &v.v32[0], &v.v32[1]);
-	return v.v64;
+	return cds_hash_ulong((unsigned long) _key, seed);
 }
-#endif
 
 /*
  * Hash function with nr_hash_chains != 0 for testing purpose only!
@@ -373,6 +327,10 @@ void cds_lfht_test_lookup(struct cds_lfht *ht, void *key, size_t key_len,
 }
 
 void free_node_cb(struct rcu_head *head);
+void free_node_rcu(struct lfht_test_node *node);
+void writer_call_rcu_begin(void);
+void writer_call_rcu_poll(void);
+void writer_call_rcu_end(void);
 
 /* rw test */
 void test_hash_rw_sigusr1_handler(int signo);
@@ -380,6 +338,7 @@ void test_hash_rw_sigusr2_handler(int signo);
 void *test_hash_rw_thr_reader(void *_count);
 void *test_hash_rw_thr_writer(void *_count);
 int test_hash_rw_populate_hash(void);
+struct cds_lfht *test_hash_rw_new_from_array(int flags);
 
 /* unique test */
 void test_hash_unique_sigusr1_handler(int signo);
@@ -388,4 +347,24 @@ void *test_hash_unique_thr_reader(void *_count);
 void *test_hash_unique_thr_writer(void *_count);
 int test_hash_unique_populate_hash(void);
 
+/* map test */
+enum hash_map {
+	HASH_MAP_LFHT = 0,
+	HASH_MAP_MUTEX,		/* Open addressing under a mutex */
+	HASH_MAP_RWLOCK,	/* Chained buckets under striped rwlocks */
+	HASH_MAP_RCULIST,	/* RCU hlist buckets, striped update locks */
+	HASH_MAP_RCUHTABLE,	/* cds_rcuhtable */
+	NR_HASH_MAPS,
+};
+
+extern enum hash_map hash_map;
+extern const char *hash_map_names[NR_HASH_MAPS];
+
+void test_hash_map_sigusr1_handler(int signo);
+void test_hash_map_sigusr2_handler(int signo);
+void *test_hash_map_thr_reader(void *_count);
+void *test_hash_map_thr_writer(void *_count);
+int test_hash_map_populate_hash(void);
+unsigned long test_hash_map_destroy(void);
+
 #endif /* _TEST_URCU_HASH_H */
@@ -0,0 +1,462 @@
+/*
+ * test_urcu_hash_contend.c
+ *
+ * Userspace RCU library - lookup throughput of the RCU lock-free hash
+ * table under concurrent updates
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Readers look up the keys of a small table, which fits in the cache,
+ * first alone, then while writers add and remove keys of their own, for
+ * the given duration each. The writers keep a window of keys in the
+ * table, so that its item count goes up and down without resizing it.
+ * With accounting, which is the default, their updates write the item
+ * count and resize target of the table: the ratio of the lookup rates
+ * of both phases shows how much the writes of the updaters slow down
+ * the lookups, e.g. through the cache lines of the table they share.
+ */
+
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include "thread-id.h"
+#include "bench-report.h"
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#define DEFAULT_NODES		4096
+#define DEFAULT_WINDOW		1024
+
+enum contend_phase {
+	PHASE_INIT = 0,
+	PHASE_IDLE,		/* Readers only. */
+	PHASE_UPDATE,		/* Readers and writers. */
+	PHASE_STOP,
+};
+
+struct contend_node {
+	struct cds_lfht_node node;
+	unsigned long key;
+	struct rcu_head head;
+};
+
+struct contend_count {
+	unsigned long long ops[PHASE_STOP];
+	unsigned long long missed;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static int test_phase;
+
+static struct cds_lfht *test_ht;
+static unsigned long nr_nodes = DEFAULT_NODES;
+static unsigned long window = DEFAULT_WINDOW;
+static int accounting = 1;
+
+static unsigned int nr_readers, nr_writers;
+static unsigned long duration;
+static struct contend_count *count_reader, *count_writer;
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static
+unsigned long hash_key(unsigned long key)
+{
+	uint64_t h = key;
+
+	/* 64-bit finalizer of MurmurHash3. */
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (unsigned long) h;
+}
+
+static
+int match_key(struct cds_lfht_node *node, const void *key)
+{
+	struct contend_node *n = caa_container_of(node, struct contend_node,
+			node);
+
+	return n->key == *(const unsigned long *) key;
+}
+
+static
+void free_node_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct contend_node, head));
+}
+
+static
+struct contend_node *alloc_node(unsigned long key)
+{
+	struct contend_node *n;
+
+	n = malloc(sizeof(*n));
+	if (!n) {
+		perror("malloc");
+		exit(-1);
+	}
+	cds_lfht_node_init(&n->node);
+	n->key = key;
+	return n;
+}
+
+/* xorshift64: cheaper than rand_r(), so lookups dominate the loop. */
+static inline
+uint64_t next_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+static
+void *thr_reader(void *arg)
+{
+	struct contend_count *count = arg;
+	uint64_t state = (uintptr_t) arg | 1;
+	struct cds_lfht_iter iter;
+	int phase;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	rcu_register_thread();
+	while ((phase = CMM_LOAD_SHARED(test_phase)) == PHASE_INIT)
+		caa_cpu_relax();
+	while (phase != PHASE_STOP) {
+		unsigned long i;
+
+		rcu_read_lock();
+		for (i = 0; i < 1024; i++) {
+			unsigned long key = next_rand(&state) % nr_nodes;
+
+			cds_lfht_lookup(test_ht, hash_key(key), match_key,
+				&key, &iter);
+			if (caa_unlikely(!cds_lfht_iter_get_node(&iter)))
+				count->missed++;
+		}
+		rcu_read_unlock();
+		count->ops[phase] += i;
+		phase = CMM_LOAD_SHARED(test_phase);
+	}
+	rcu_unregister_thread();
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	return NULL;
+}
+
+/*
+ * Each writer adds the keys [base + n, base + n + window) one after
+ * the other, removing the key added window updates earlier.
+ */
+static
+void *thr_writer(void *arg)
+{
+	struct contend_count *count = arg;
+	unsigned long base, n = 0;
+	struct contend_node **ring;
+	int phase;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+	base = nr_nodes + (unsigned long) (count - count_writer)
+		* (ULONG_MAX / 2 / nr_writers);
+	ring = calloc(window, sizeof(*ring));
+	if (!ring) {
+		perror("calloc");
+		exit(-1);
+	}
+	rcu_register_thread();
+	while ((phase = CMM_LOAD_SHARED(test_phase)) != PHASE_STOP) {
+		struct contend_node *old, *new;
+		unsigned long slot;
+
+		if (phase != PHASE_UPDATE) {
+			(void) poll(NULL, 0, 1);
+			continue;
+		}
+		slot = n % window;
+		new = alloc_node(base + n);
+		rcu_read_lock();
+		cds_lfht_add(test_ht, hash_key(new->key), &new->node);
+		old = ring[slot];
+		if (old) {
+			int ret;
+
+			ret = cds_lfht_del(test_ht, &old->node);
+			assert(!ret);
+		}
+		rcu_read_unlock();
+		if (old)
+			call_rcu(&old->head, free_node_cb);
+		ring[slot] = new;
+		n++;
+		count->ops[phase]++;
+	}
+	rcu_read_lock();
+	for (n = 0; n < window; n++) {
+		if (!ring[n])
+			continue;
+		(void) cds_lfht_del(test_ht, &ring[n]->node);
+		call_rcu(&ring[n]->head, free_node_cb);
+	}
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	free(ring);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+	return NULL;
+}
+
+static
+unsigned long long sum_ops(struct contend_count *count, unsigned int nr,
+		int phase)
+{
+	unsigned long long sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		sum += count[i].ops[phase];
+	return sum;
+}
+
+static
+void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_readers nr_writers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-n n] (nodes looked up, default: %d)\n",
+		DEFAULT_NODES);
+	printf("	[-w n] (keys kept in the table by each writer, default: %d)\n",
+		DEFAULT_WINDOW);
+	printf("	[-N] (no accounting: the updates do not write the item count)\n");
+	printf("	[-v] (verbose output)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long idle_ops, update_ops, write_ops, missed = 0;
+	double idle_rate, update_rate;
+	struct bench_report report;
+	pthread_t *tid_reader, *tid_writer;
+	struct contend_node **nodes;
+	unsigned long k, nr_buckets;
+	unsigned int i;
+	int a, ret;
+
+	argc = bench_report_parse_args(argc, argv);
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+	nr_readers = atoi(argv[1]);
+	nr_writers = atoi(argv[2]);
+	duration = atol(argv[3]);
+	if (!nr_readers || !duration) {
+		show_usage(argc, argv);
+		return -1;
+	}
+	for (a = 4; a < argc; a++) {
+		if (argv[a][0] != '-')
+			continue;
+		switch (argv[a][1]) {
+		case 'n':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_nodes = atol(argv[++a]);
+			break;
+		case 'w':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			window = atol(argv[++a]);
+			break;
+		case 'N':
+			accounting = 0;
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+	if (!nr_nodes || !window) {
+		printf("The numbers of nodes and of keys per writer must not be 0.\n");
+		return -1;
+	}
+
+	/* Size the table for all the keys, so that it is never resized. */
+	for (nr_buckets = 1; nr_buckets < nr_nodes + nr_writers * window;)
+		nr_buckets <<= 1;
+	test_ht = cds_lfht_new(nr_buckets, 1, nr_buckets,
+			accounting ? CDS_LFHT_ACCOUNTING : 0, NULL);
+	if (!test_ht) {
+		fprintf(stderr, "Error allocating hash table\n");
+		return -1;
+	}
+	nodes = calloc(nr_nodes, sizeof(*nodes));
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+	tid_writer = calloc(nr_writers, sizeof(*tid_writer));
+	count_reader = calloc(nr_readers, sizeof(*count_reader));
+	count_writer = calloc(nr_writers, sizeof(*count_writer));
+	if (!nodes || !tid_reader || (nr_writers && !tid_writer)
+			|| !count_reader || (nr_writers && !count_writer)) {
+		perror("calloc");
+		return -1;
+	}
+
+	rcu_register_thread();
+	rcu_read_lock();
+	for (k = 0; k < nr_nodes; k++) {
+		nodes[k] = alloc_node(k);
+		cds_lfht_add(test_ht, hash_key(k), &nodes[k]->node);
+	}
+	rcu_read_unlock();
+
+	printf_verbose("readers %u, writers %u, duration %lus, nodes %lu, "
+		"window %lu, buckets %lu, accounting %d\n",
+		nr_readers, nr_writers, duration, nr_nodes, window,
+		nr_buckets, accounting);
+
+	for (i = 0; i < nr_readers; i++) {
+		ret = pthread_create(&tid_reader[i], NULL, thr_reader,
+				&count_reader[i]);
+		if (ret) {
+			errno = ret;
+			perror("pthread_create");
+			return -1;
+		}
+	}
+	for (i = 0; i < nr_writers; i++) {
+		ret = pthread_create(&tid_writer[i], NULL, thr_writer,
+				&count_writer[i]);
+		if (ret) {
+			errno = ret;
+			perror("pthread_create");
+			return -1;
+		}
+	}
+	CMM_STORE_SHARED(test_phase, PHASE_IDLE);
+	sleep(duration);
+	CMM_STORE_SHARED(test_phase, PHASE_UPDATE);
+	sleep(duration);
+	CMM_STORE_SHARED(test_phase, PHASE_STOP);
+
+	for (i = 0; i < nr_readers; i++) {
+		ret = pthread_join(tid_reader[i], NULL);
+		if (ret) {
+			errno = ret;
+			perror("pthread_join");
+			return -1;
+		}
+		missed += count_reader[i].missed;
+	}
+	for (i = 0; i < nr_writers; i++) {
+		ret = pthread_join(tid_writer[i], NULL);
+		if (ret) {
+			errno = ret;
+			perror("pthread_join");
+			return -1;
+		}
+	}
+	if (missed) {
+		printf("[ERROR] %llu lookups missed a present key.\n", missed);
+		return -1;
+	}
+
+	idle_ops = sum_ops(count_reader, nr_readers, PHASE_IDLE);
+	update_ops = sum_ops(count_reader, nr_readers, PHASE_UPDATE);
+	write_ops = sum_ops(count_writer, nr_writers, PHASE_UPDATE);
+	idle_rate = (double) idle_ops / duration;
+	update_rate = (double) update_ops / duration;
+	if (bench_report_text())
+		printf("CONTEND readers %u writers %u nodes %lu window %lu "
+			"accounting %d idle_lookups_per_s %12.0f "
+			"update_lookups_per_s %12.0f lookup_ratio %6.3f "
+			"updates_per_s %11.0f\n",
+			nr_readers, nr_writers, nr_nodes, window, accounting,
+			idle_rate, update_rate,
+			idle_rate ? update_rate / idle_rate : 0,
+			(double) write_ops / duration);
+	bench_report_init(&report, argv[0], 2 * duration);
+	bench_report_config(&report, "nr_readers", nr_readers);
+	bench_report_config(&report, "nr_writers", nr_writers);
+	bench_report_config(&report, "nr_nodes", nr_nodes);
+	bench_report_config(&report, "window", window);
+	bench_report_config(&report, "accounting", accounting);
+	bench_report_result(&report, "idle_lookups_per_s", idle_rate);
+	bench_report_result(&report, "update_lookups_per_s", update_rate);
+	bench_report_result(&report, "updates_per_s",
+		(double) write_ops / duration);
+	for (i = 0; i < nr_readers; i++)
+		bench_report_thread(&report, "reader",
+			count_reader[i].ops[PHASE_IDLE]
+			+ count_reader[i].ops[PHASE_UPDATE]);
+	for (i = 0; i < nr_writers; i++)
+		bench_report_thread(&report, "writer",
+			count_writer[i].ops[PHASE_UPDATE]);
+	bench_report_print(&report);
+
+	rcu_read_lock();
+	for (k = 0; k < nr_nodes; k++) {
+		ret = cds_lfht_del(test_ht, &nodes[k]->node);
+		assert(!ret);
+		call_rcu(&nodes[k]->head, free_node_cb);
+	}
+	rcu_read_unlock();
+	rcu_barrier();
+	if (cds_lfht_destroy(test_ht, NULL)) {
+		fprintf(stderr, "Error destroying hash table\n");
+		return -1;
+	}
+	rcu_unregister_thread();
+	free(count_writer);
+	free(count_reader);
+	free(tid_writer);
+	free(tid_reader);
+	free(nodes);
+	return 0;
+}
@@ -0,0 +1,789 @@
+/*
+ * test_urcu_hash_map.c
+ *
+ * Userspace RCU library - test program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Map test: the same lookup, add unique and remove workload, run against
+ * cds_lfht or against one of the baseline maps below, so their read and
+ * write scaling can be compared. The baselines are sized once for all
+ * the keys of the init and write pools and never resize:
+ *
+ * - mutex: open addressing with linear probing, under a single mutex.
+ * - rwlock: chained buckets, protected by striped rwlocks.
+ * - rculist: chained rcuhlist buckets, read under RCU, updated under
+ *   striped mutexes, with removed nodes freed by call_rcu().
+ * - rcuhtable: cds_rcuhtable, the library version of rculist with
+ *   per-bucket spinlocks.
+ */
+
+#include <urcu/hlist.h>
+#include <urcu/rcuhlist.h>
+#include <urcu/rcuhtable.h>
+
+#include "test_urcu_hash.h"
+
+#define HASH_MAP_NR_STRIPES	256
+
+enum urcu_hash_addremove {
+	AR_RANDOM = 0,
+	AR_ADD = 1,
+	AR_REMOVE = -1,
+};	/* 1: add, -1 remove, 0: random */
+
+static enum urcu_hash_addremove addremove; /* 1: add, -1 remove, 0: random */
+
+const char *hash_map_names[NR_HASH_MAPS] = {
+	[HASH_MAP_LFHT] = "lfht",
+	[HASH_MAP_MUTEX] = "mutex",
+	[HASH_MAP_RWLOCK] = "rwlock",
+	[HASH_MAP_RCULIST] = "rculist",
+	[HASH_MAP_RCUHTABLE] = "rcuhtable",
+};
+
+enum hash_map hash_map;
+
+struct hash_map_ops {
+	void (*init)(unsigned long nr_keys);
+	int (*lookup)(unsigned long key);	/* 1: found */
+	int (*add)(unsigned long key);		/* 1: added, 0: key exists */
+	int (*del)(unsigned long key);		/* 1: removed, 0: no key */
+	unsigned long (*destroy)(void);		/* Returns the nodes freed */
+};
+
+static
+unsigned long map_hash(unsigned long key)
+{
+	return test_hash((void *) key, sizeof(void *), TEST_HASH_SEED);
+}
+
+static
+unsigned long roundup_pow2(unsigned long v)
+{
+	unsigned long r = 1;
+
+	while (r < v)
+		r <<= 1;
+	return r;
+}
+
+/* cds_lfht, as in the rw test. */
+
+static
+void lfht_map_init(unsigned long nr_keys)
+{
+}
+
+static
+int lfht_map_lookup(unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	int found;
+
+	rcu_read_lock();
+	cds_lfht_test_lookup(test_ht, (void *) key, sizeof(void *), &iter);
+	found = cds_lfht_iter_get_node(&iter) != NULL;
+	rcu_read_unlock();
+	return found;
+}
+
+static
+int lfht_map_add(unsigned long key)
+{
+	struct lfht_test_node *node;
+	struct cds_lfht_node *ret_node;
+
+	node = malloc(sizeof(*node));
+	if (!node) {
+		perror("malloc");
+		exit(-1);
+	}
+	lfht_test_node_init(node, (void *) key, sizeof(void *));
+	rcu_read_lock();
+	ret_node = cds_lfht_add_unique(test_ht, map_hash(key), test_match,
+			node->key, &node->node);
+	rcu_read_unlock();
+	if (ret_node != &node->node) {
+		free(node);
+		return 0;
+	}
+	return 1;
+}
+
+static
+int lfht_map_del(unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	int ret;
+
+	rcu_read_lock();
+	cds_lfht_test_lookup(test_ht, (void *) key, sizeof(void *), &iter);
+	ret = cds_lfht_del(test_ht, cds_lfht_iter_get_node(&iter));
+	rcu_read_unlock();
+	if (ret)
+		return 0;
+	free_node_rcu(cds_lfht_iter_get_test_node(&iter));
+	return 1;
+}
+
+/* Nodes left in test_ht are counted and freed by main(). */
+static
+unsigned long lfht_map_destroy(void)
+{
+	return 0;
+}
+
+/*
+ * Open addressing with linear probing under a single mutex. Slots hold
+ * key + 1, 0 being an empty slot. The table has at least twice as many
+ * slots as keys, so a probe always ends on an empty slot. Removal shifts
+ * the following entries of the probe sequence back, without tombstones.
+ */
+
+static unsigned long *oa_slots;
+static unsigned long oa_mask;
+static pthread_mutex_t oa_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static
+void mutex_map_init(unsigned long nr_keys)
+{
+	oa_mask = (roundup_pow2(nr_keys) << 1) - 1;
+	oa_slots = calloc(oa_mask + 1, sizeof(*oa_slots));
+	if (!oa_slots) {
+		perror("calloc");
+		exit(-1);
+	}
+}
+
+/* Index of @key, or of the empty slot ending its probe sequence. */
+static
+unsigned long oa_find(unsigned long key)
+{
+	unsigned long i;
+
+	for (i = map_hash(key) & oa_mask;
+			oa_slots[i] && oa_slots[i] != key + 1;
+			i = (i + 1) & oa_mask)
+		;
+	return i;
+}
+
+static
+int mutex_map_lookup(unsigned long key)
+{
+	int found;
+
+	pthread_mutex_lock(&oa_lock);
+	found = oa_slots[oa_find(key)] != 0;
+	pthread_mutex_unlock(&oa_lock);
+	return found;
+}
+
+static
+int mutex_map_add(unsigned long key)
+{
+	unsigned long i;
+	int added = 0;
+
+	pthread_mutex_lock(&oa_lock);
+	i = oa_find(key);
+	if (!oa_slots[i]) {
+		oa_slots[i] = key + 1;
+		added = 1;
+	}
+	pthread_mutex_unlock(&oa_lock);
+	return added;
+}
+
+static
+int mutex_map_del(unsigned long key)
+{
+	unsigned long i, j, home;
+
+	pthread_mutex_lock(&oa_lock);
+	i = oa_find(key);
+	if (!oa_slots[i]) {
+		pthread_mutex_unlock(&oa_lock);
+		return 0;
+	}
+	oa_slots[i] = 0;
+	for (j = (i + 1) & oa_mask; oa_slots[j]; j = (j + 1) & oa_mask) {
+		home = map_hash(oa_slots[j] - 1) & oa_mask;
+		/* Keep entries whose home slot is cyclically in (i, j]. */
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		oa_slots[i] = oa_slots[j];
+		oa_slots[j] = 0;
+		i = j;
+	}
+	pthread_mutex_unlock(&oa_lock);
+	return 1;
+}
+
+static
+unsigned long mutex_map_destroy(void)
+{
+	unsigned long i, count = 0;
+
+	for (i = 0; i <= oa_mask; i++) {
+		if (oa_slots[i])
+			count++;
+	}
+	free(oa_slots);
+	oa_slots = NULL;
+	return count;
+}
+
+/*
+ * Chained buckets, shared by the rwlock and rculist maps. Bucket i is
+ * protected by stripe i % HASH_MAP_NR_STRIPES: its rwlock for the rwlock
+ * map, its mutex for the updates of the rculist map.
+ */
+
+struct map_node {
+	struct cds_hlist_node node;
+	unsigned long key;
+	struct rcu_head head;
+};
+
+struct map_stripe {
+	pthread_rwlock_t rwlock;
+	pthread_mutex_t mutex;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static struct cds_hlist_head *chain_buckets;
+static unsigned long chain_mask;
+static struct map_stripe chain_stripes[HASH_MAP_NR_STRIPES];
+
+static
+void chain_map_init(unsigned long nr_keys)
+{
+	unsigned int i;
+
+	chain_mask = roundup_pow2(nr_keys) - 1;
+	chain_buckets = calloc(chain_mask + 1, sizeof(*chain_buckets));
+	if (!chain_buckets) {
+		perror("calloc");
+		exit(-1);
+	}
+	for (i = 0; i < HASH_MAP_NR_STRIPES; i++) {
+		pthread_rwlock_init(&chain_stripes[i].rwlock, NULL);
+		pthread_mutex_init(&chain_stripes[i].mutex, NULL);
+	}
+}
+
+static
+struct map_node *chain_find(struct cds_hlist_head *bucket, unsigned long key)
+{
+	struct map_node *node;
+
+	cds_hlist_for_each_entry_2(node, bucket, node) {
+		if (node->key == key)
+			return node;
+	}
+	return NULL;
+}
+
+static
+struct map_node *chain_node_alloc(unsigned long key)
+{
+	struct map_node *node;
+
+	node = malloc(sizeof(*node));
+	if (!node) {
+		perror("malloc");
+		exit(-1);
+	}
+	node->key = key;
+	return node;
+}
+
+static
+unsigned long chain_map_destroy(void)
+{
+	struct map_node *node, *tmp;
+	unsigned long i, count = 0;
+
+	for (i = 0; i <= chain_mask; i++) {
+		cds_hlist_for_each_entry_safe_2(node, tmp, &chain_buckets[i],
+				node) {
+			free(node);
+			count++;
+		}
+	}
+	for (i = 0; i < HASH_MAP_NR_STRIPES; i++) {
+		pthread_rwlock_destroy(&chain_stripes[i].rwlock);
+		pthread_mutex_destroy(&chain_stripes[i].mutex);
+	}
+	free(chain_buckets);
+	chain_buckets = NULL;
+	return count;
+}
+
+static
+int rwlock_map_lookup(unsigned long key)
+{
+	unsigned long i = map_hash(key) & chain_mask;
+	pthread_rwlock_t *lock =
+		&chain_stripes[i % HASH_MAP_NR_STRIPES].rwlock;
+	int found;
+
+	pthread_rwlock_rdlock(lock);
+	found = chain_find(&chain_buckets[i], key) != NULL;
+	pthread_rwlock_unlock(lock);
+	return found;
+}
+
+static
+int rwlock_map_add(unsigned long key)
+{
+	unsigned long i = map_hash(key) & chain_mask;
+	pthread_rwlock_t *lock =
+		&chain_stripes[i % HASH_MAP_NR_STRIPES].rwlock;
+	struct map_node *node = chain_node_alloc(key);
+
+	pthread_rwlock_wrlock(lock);
+	if (chain_find(&chain_buckets[i], key)) {
+		pthread_rwlock_unlock(lock);
+		free(node);
+		return 0;
+	}
+	cds_hlist_add_head(&node->node, &chain_buckets[i]);
+	pthread_rwlock_unlock(lock);
+	return 1;
+}
+
+static
+int rwlock_map_del(unsigned long key)
+{
+	unsigned long i = map_hash(key) & chain_mask;
+	pthread_rwlock_t *lock =
+		&chain_stripes[i % HASH_MAP_NR_STRIPES].rwlock;
+	struct map_node *node;
+
+	pthread_rwlock_wrlock(lock);
+	node = chain_find(&chain_buckets[i], key);
+	if (node)
+		cds_hlist_del(&node->node);
+	pthread_rwlock_unlock(lock);
+	free(node);
+	return node != NULL;
+}
+
+static
+int rculist_map_lookup(unsigned long key)
+{
+	struct cds_hlist_head *bucket =
+		&chain_buckets[map_hash(key) & chain_mask];
+	struct map_node *node;
+	int found = 0;
+
+	rcu_read_lock();
+	cds_hlist_for_each_entry_rcu_2(node, bucket, node) {
+		if (node->key == key) {
+			found = 1;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+static
+int rculist_map_add(unsigned long key)
+{
+	unsigned long i = map_hash(key) & chain_mask;
+	pthread_mutex_t *lock = &chain_stripes[i % HASH_MAP_NR_STRIPES].mutex;
+	struct map_node *node = chain_node_alloc(key);
+
+	pthread_mutex_lock(lock);
+	if (chain_find(&chain_buckets[i], key)) {
+		pthread_mutex_unlock(lock);
+		free(node);
+		return 0;
+	}
+	cds_hlist_add_head_rcu(&node->node, &chain_buckets[i]);
+	pthread_mutex_unlock(lock);
+	return 1;
+}
+
+static
+void map_node_free_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct map_node, head));
+}
+
+static
+int rculist_map_del(unsigned long key)
+{
+	unsigned long i = map_hash(key) & chain_mask;
+	pthread_mutex_t *lock = &chain_stripes[i % HASH_MAP_NR_STRIPES].mutex;
+	struct map_node *node;
+
+	pthread_mutex_lock(lock);
+	node = chain_find(&chain_buckets[i], key);
+	if (node)
+		cds_hlist_del_rcu(&node->node);
+	pthread_mutex_unlock(lock);
+	if (!node)
+		return 0;
+	call_rcu(&node->head, map_node_free_cb);
+	return 1;
+}
+
+/*
+ * cds_rcuhtable, with as many buckets as the chained maps.
+ */
+struct rcuht_map_node {
+	struct cds_rcuhtable_node node;
+	unsigned long key;
+	struct rcu_head head;
+};
+
+static struct cds_rcuhtable *rcuht;
+
+static
+int rcuht_map_match(struct cds_rcuhtable_node *node, const void *key)
+{
+	return caa_container_of(node, struct rcuht_map_node, node)->key
+		== (unsigned long) key;
+}
+
+static
+void rcuht_map_init(unsigned long nr_keys)
+{
+	rcuht = cds_rcuhtable_new(nr_keys);
+	if (!rcuht) {
+		perror("cds_rcuhtable_new");
+		abort();
+	}
+}
+
+static
+int rcuht_map_lookup(unsigned long key)
+{
+	int found;
+
+	rcu_read_lock();
+	found = cds_rcuhtable_lookup(rcuht, map_hash(key), rcuht_map_match,
+			(void *) key) != NULL;
+	rcu_read_unlock();
+	return found;
+}
+
+static
+int rcuht_map_add(unsigned long key)
+{
+	struct rcuht_map_node *node;
+	struct cds_rcuhtable_node *ret;
+
+	node = malloc(sizeof(*node));
+	if (!node) {
+		perror("malloc");
+		abort();
+	}
+	node->key = key;
+	ret = cds_rcuhtable_add_unique(rcuht, map_hash(key), rcuht_map_match,
+			(void *) key, &node->node);
+	if (ret != &node->node) {
+		free(node);
+		return 0;
+	}
+	return 1;
+}
+
+static
+void rcuht_map_node_free_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct rcuht_map_node, head));
+}
+
+static
+int rcuht_map_del(unsigned long key)
+{
+	struct cds_rcuhtable_node *node;
+	int removed = 0;
+
+	rcu_read_lock();
+	node = cds_rcuhtable_lookup(rcuht, map_hash(key), rcuht_map_match,
+			(void *) key);
+	if (node && !cds_rcuhtable_del(rcuht, node)) {
+		call_rcu(&caa_container_of(node, struct rcuht_map_node,
+				node)->head, rcuht_map_node_free_cb);
+		removed = 1;
+	}
+	rcu_read_unlock();
+	return removed;
+}
+
+static
+unsigned long rcuht_map_destroy(void)
+{
+	struct cds_rcuhtable_stats stats;
+	struct cds_rcuhtable_node *pos;
+	unsigned long i, count = 0;
+	int ret;
+
+	cds_rcuhtable_get_stats(rcuht, &stats);
+	printf("rcuhtable: %lu nodes in %lu buckets, %lu empty, "
+		"longest chain %lu\n", stats.nr_nodes, stats.nr_buckets,
+		stats.nr_empty, stats.max_chain);
+	rcu_read_lock();
+	cds_rcuhtable_for_each(rcuht, i, pos) {
+		if (!cds_rcuhtable_del(rcuht, pos)) {
+			call_rcu(&caa_container_of(pos, struct rcuht_map_node,
+					node)->head, rcuht_map_node_free_cb);
+			count++;
+		}
+	}
+	rcu_read_unlock();
+	ret = cds_rcuhtable_destroy(rcuht);
+	if (ret)
+		printf("cds_rcuhtable_destroy error\n");
+	rcuht = NULL;
+	return count;
+}
+
+static const struct hash_map_ops hash_map_ops[NR_HASH_MAPS] = {
+	[HASH_MAP_LFHT] = {
+		lfht_map_init,
+		lfht_map_lookup,
+		lfht_map_add,
+		lfht_map_del,
+		lfht_map_destroy,
+	},
+	[HASH_MAP_MUTEX] = {
+		mutex_map_init,
+		mutex_map_lookup,
+		mutex_map_add,
+		mutex_map_del,
+		mutex_map_destroy,
+	},
+	[HASH_MAP_RWLOCK] = {
+		chain_map_init,
+		rwlock_map_lookup,
+		rwlock_map_add,
+		rwlock_map_del,
+		chain_map_destroy,
+	},
+	[HASH_MAP_RCULIST] = {
+		chain_map_init,
+		rculist_map_lookup,
+		rculist_map_add,
+		rculist_map_del,
+		chain_map_destroy,
+	},
+	[HASH_MAP_RCUHTABLE] = {
+		rcuht_map_init,
+		rcuht_map_lookup,
+		rcuht_map_add,
+		rcuht_map_del,
+		rcuht_map_destroy,
+	},
+};
+
+void test_hash_map_sigusr1_handler(int signo)
+{
+	switch (addremove) {
+	case AR_ADD:
+		printf("Add/Remove: random.\n");
+		addremove = AR_RANDOM;
+		break;
+	case AR_RANDOM:
+		printf("Add/Remove: remove only.\n");
+		addremove = AR_REMOVE;
+		break;
+	case AR_REMOVE:
+		printf("Add/Remove: add only.\n");
+		addremove = AR_ADD;
+		break;
+	}
+}
+
+void test_hash_map_sigusr2_handler(int signo)
+{
+	char msg[1] = { 0x42 };
+	ssize_t ret;
+
+	do {
+		ret = write(count_pipe[1], msg, 1);	/* wakeup thread */
+	} while (ret == -1L && errno == EINTR);
+}
+
+void *test_hash_map_thr_reader(void *_count)
+{
+	unsigned long long *count = _count;
+	const struct hash_map_ops *ops = &hash_map_ops[hash_map];
+	struct bench_latency *hist = bench_latency_thread_alloc(lookup_lat);
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	/* Sequential threads start at distinct keys. */
+	URCU_TLS(key_seq) = rand_r(&URCU_TLS(rand_lookup));
+
+	set_affinity(BENCH_ROLE_READER);
+
+	rcu_register_thread();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
+
+	for (;;) {
+		unsigned long key = (unsigned long) key_pool_next(&lookup_keys);
+		caa_cycles_t begin = bench_latency_begin(hist);
+		int found;
+
+		found = ops->lookup(key);
+		bench_latency_end(hist, begin);
+		if (!found) {
+			if (validate_lookup) {
+				printf("[ERROR] Lookup cannot find initial node.\n");
+				exit(-1);
+			}
+			URCU_TLS(lookup_fail)++;
+		} else {
+			URCU_TLS(lookup_ok)++;
+		}
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+		URCU_TLS(nr_reads)++;
+		if (caa_unlikely(!test_duration_read()))
+			break;
+		if (caa_unlikely((URCU_TLS(nr_reads) & ((1 << 10) - 1)) == 0))
+			rcu_quiescent_state();
+	}
+
+	bench_perf_thread_free(perf_thread);
+	rcu_unregister_thread();
+	bench_latency_merge(lookup_lat, hist);
+	bench_latency_free(hist);
+
+	*count = URCU_TLS(nr_reads);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	printf_verbose("read tid : %lu, lookupfail %lu, lookupok %lu\n",
+			urcu_get_thread_id(), URCU_TLS(lookup_fail),
+			URCU_TLS(lookup_ok));
+	return ((void*)1);
+}
+
+void *test_hash_map_thr_writer(void *_count)
+{
+	struct wr_count *count = _count;
+	const struct hash_map_ops *ops = &hash_map_ops[hash_map];
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+
+	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	URCU_TLS(key_seq) = rand_r(&URCU_TLS(rand_lookup));
+
+	set_affinity(BENCH_ROLE_WRITER);
+
+	rcu_register_thread();
+	writer_call_rcu_begin();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
+
+	for (;;) {
+		unsigned long key = (unsigned long) key_pool_next(&write_keys);
+
+		if ((addremove == AR_ADD || add_only)
+				|| (addremove == AR_RANDOM && rand_r(&URCU_TLS(rand_lookup)) & 1)) {
+			if (ops->add(key))
+				URCU_TLS(nr_add)++;
+			else
+				URCU_TLS(nr_addexist)++;
+		} else {
+			if (ops->del(key))
+				URCU_TLS(nr_del)++;
+			else
+				URCU_TLS(nr_delnoent)++;
+		}
+		URCU_TLS(nr_writes)++;
+		if (caa_unlikely(!test_duration_write()))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0)) {
+			rcu_quiescent_state();
+			writer_call_rcu_poll();
+		}
+	}
+
+	bench_perf_thread_free(perf_thread);
+	writer_call_rcu_end();
+	rcu_unregister_thread();
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+	printf_verbose("info tid %lu: nr_add %lu, nr_addexist %lu, nr_del %lu, "
+			"nr_delnoent %lu\n", urcu_get_thread_id(),
+			URCU_TLS(nr_add),
+			URCU_TLS(nr_addexist),
+			URCU_TLS(nr_del),
+			URCU_TLS(nr_delnoent));
+	count->update_ops = URCU_TLS(nr_writes);
+	count->add = URCU_TLS(nr_add);
+	count->add_exist = URCU_TLS(nr_addexist);
+	count->remove = URCU_TLS(nr_del);
+	return ((void*)2);
+}
+
+/* Keys come from the init and write pools: size the baselines for both. */
+int test_hash_map_populate_hash(void)
+{
+	const struct hash_map_ops *ops = &hash_map_ops[hash_map];
+
+	printf("Starting map test (%s).\n", hash_map_names[hash_map]);
+
+	ops->init(init_pool_size + write_pool_size);
+
+	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+
+	while (URCU_TLS(nr_add) < init_populate) {
+		unsigned long key = ((unsigned long) rand_r(&URCU_TLS(rand_lookup))
+				% init_pool_size) + init_pool_offset;
+
+		if (ops->add(key))
+			URCU_TLS(nr_add)++;
+		else
+			URCU_TLS(nr_addexist)++;
+		URCU_TLS(nr_writes)++;
+	}
+	return 0;
+}
+
+/* Free the nodes of a baseline map, and return how many there were. */
+unsigned long test_hash_map_destroy(void)
+{
+	return hash_map_ops[hash_map].destroy();
+}
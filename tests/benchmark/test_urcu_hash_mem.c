@@ -0,0 +1,525 @@
+/*
+ * test_urcu_hash_mem.c
+ *
+ * Userspace RCU library - memory footprint benchmark of the RCU lock-free
+ * hash table memory management backends
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * For each memory management backend and minimum number of allocated
+ * buckets, grow an auto-resized table through each size, then shrink
+ * it back through each size down to empty, over several cycles. After
+ * each step, once the resizes and the frees of the bucket tables have
+ * completed, print the resident set size taken by the table (the nodes
+ * are allocated up front, outside of the measurement), the bucket
+ * memory reported by cds_lfht_get_mem_info(), and the throughput of
+ * lookups of present and of absent keys.
+ *
+ * With -X, the keys are stored in the node word left to the caller by
+ * cds_lfht_set_node_hash(), and rehashed by the table at each node it
+ * visits: compare the lookup rates to those of the default mode, which
+ * stores the hashes in the nodes.
+ */
+
+#include <stdio.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <compat-rand.h>
+#include "bench-report.h"
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#define DEFAULT_BACKENDS	"order,chunk,mmap"
+#define DEFAULT_MIN_ALLOC	"1,4096"
+#define DEFAULT_SIZES		"1000,100000,1000000"
+#define DEFAULT_CYCLES		2
+#define DEFAULT_LOOKUPS		1000000
+
+#define MAX_LIST		16
+
+struct mem_node {
+	struct cds_lfht_node node;
+	unsigned long key;
+};
+
+static const struct {
+	const char *name;
+	const struct cds_lfht_mm_type *mm;
+} backends[] = {
+	{ "order", &cds_lfht_mm_order },
+	{ "chunk", &cds_lfht_mm_chunk },
+	{ "mmap", &cds_lfht_mm_mmap },
+};
+
+enum mem_phase {
+	PHASE_GROW = 0,
+	PHASE_SHRINK,
+};
+
+static unsigned int backend_list[MAX_LIST], nr_backend_list;
+static unsigned long min_alloc_list[MAX_LIST];
+static unsigned int nr_min_alloc_list;
+static unsigned long size_list[MAX_LIST];
+static unsigned int nr_size_list;
+static unsigned long max_nr_buckets;
+static unsigned int nr_cycles = DEFAULT_CYCLES;
+static unsigned long nr_lookups = DEFAULT_LOOKUPS;
+
+static struct mem_node *nodes;
+static unsigned long nr_nodes_max;
+static unsigned int rand_seed;
+
+static int verbose_mode;
+static int external_hash;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static
+unsigned long hash_key(unsigned long key)
+{
+	uint64_t h = key;
+
+	/* 64-bit finalizer of MurmurHash3. */
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (unsigned long) h;
+}
+
+static
+int match_key(struct cds_lfht_node *node, const void *key)
+{
+	struct mem_node *n = caa_container_of(node, struct mem_node, node);
+
+	return n->key == *(const unsigned long *) key;
+}
+
+/* With -X: the key is the node word, hashed on demand. */
+static
+unsigned long node_hash_key(struct cds_lfht_node *node, void *priv)
+{
+	return hash_key(node->priv);
+}
+
+static
+int match_priv(struct cds_lfht_node *node, const void *key)
+{
+	return node->priv == *(const unsigned long *) key;
+}
+
+static
+long long rss_bytes(void)
+{
+	unsigned long size, resident;
+	FILE *f;
+	int ret;
+
+	f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	ret = fscanf(f, "%lu %lu", &size, &resident);
+	fclose(f);
+	if (ret != 2)
+		return 0;
+	return (long long) resident * sysconf(_SC_PAGESIZE);
+}
+
+static
+double now_s(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Wait for the automatic resizes triggered by the last updates, run by
+ * the resize worker thread, and for the bucket tables they removed to
+ * be freed after a grace period.
+ */
+static
+void settle(struct cds_lfht *ht, struct cds_lfht_mem_info *info)
+{
+	unsigned long prev;
+
+	cds_lfht_get_mem_info(ht, info);
+	do {
+		prev = info->size;
+		(void) poll(NULL, 0, 10);
+		synchronize_rcu();
+		rcu_barrier();
+		cds_lfht_get_mem_info(ht, info);
+	} while (info->size != prev);
+}
+
+/* Look up @nr keys among [@base, @base + @range). Returns lookups/s. */
+static
+double lookup_rate(struct cds_lfht *ht, unsigned long base,
+		unsigned long range, unsigned long nr, unsigned long *found)
+{
+	struct cds_lfht_iter iter;
+	unsigned long i;
+	double begin;
+
+	*found = 0;
+	if (!range)
+		return 0;
+	begin = now_s();
+	rcu_read_lock();
+	for (i = 0; i < nr; i++) {
+		unsigned long key = base + rand_r(&rand_seed) % range;
+
+		cds_lfht_lookup(ht, hash_key(key),
+			external_hash ? match_priv : match_key, &key, &iter);
+		if (cds_lfht_iter_get_node(&iter))
+			(*found)++;
+		if (caa_unlikely((i & ((1 << 10) - 1)) == 0)) {
+			rcu_read_unlock();
+			rcu_read_lock();
+		}
+	}
+	rcu_read_unlock();
+	return nr / (now_s() - begin);
+}
+
+static
+void measure(struct cds_lfht *ht, unsigned int backend,
+		unsigned long min_alloc, unsigned int cycle,
+		enum mem_phase phase, unsigned long nr, long long rss_base,
+		const char *test)
+{
+	struct cds_lfht_mem_info info;
+	unsigned long hit_found, miss_found;
+	double hit_rate, miss_rate;
+	struct bench_report report;
+	long long rss;
+
+	settle(ht, &info);
+	rss = rss_bytes() - rss_base;
+	hit_rate = lookup_rate(ht, 0, nr, nr_lookups, &hit_found);
+	miss_rate = lookup_rate(ht, nr_nodes_max, nr_nodes_max, nr_lookups,
+			&miss_found);
+	if ((nr && hit_found != nr_lookups) || miss_found) {
+		printf("[ERROR] Lookup found %lu of %lu present and %lu "
+			"absent keys.\n", hit_found, nr ? nr_lookups : 0,
+			miss_found);
+		exit(-1);
+	}
+	if (bench_report_text())
+		printf("MEM backend %-5s min_alloc %7lu cycle %2u %-6s "
+			"nr_nodes %9lu buckets %9lu rss_kb %9lld "
+			"bucket_bytes %11zu reserved_bytes %11zu "
+			"bytes_per_node %8.2f hit_lookups_per_s %11.0f "
+			"miss_lookups_per_s %11.0f\n",
+			backends[backend].name, min_alloc, cycle,
+			phase == PHASE_GROW ? "grow" : "shrink", nr,
+			info.size, rss / 1024, info.bucket_bytes,
+			info.reserved_bucket_bytes,
+			nr ? (double) info.bucket_bytes / nr : 0,
+			hit_rate, miss_rate);
+	bench_report_init(&report, test, 0);
+	bench_report_config(&report, "backend", backend);
+	bench_report_config(&report, "min_alloc", min_alloc);
+	bench_report_config(&report, "max_nr_buckets", max_nr_buckets);
+	bench_report_config(&report, "cycle", cycle);
+	bench_report_config(&report, "phase", phase);
+	bench_report_config(&report, "nr_nodes", nr);
+	bench_report_config(&report, "external_hash", external_hash);
+	bench_report_result(&report, "nr_buckets", info.size);
+	bench_report_result(&report, "rss_bytes", rss);
+	bench_report_result(&report, "bucket_bytes", info.bucket_bytes);
+	bench_report_result(&report, "reserved_bucket_bytes",
+		info.reserved_bucket_bytes);
+	bench_report_result(&report, "hit_lookups_per_s", hit_rate);
+	bench_report_result(&report, "miss_lookups_per_s", miss_rate);
+	bench_report_print(&report);
+}
+
+static
+void test_backend(unsigned int backend, unsigned long min_alloc,
+		const char *test)
+{
+	unsigned long nr = 0;
+	struct cds_lfht *ht;
+	long long rss_base;
+	unsigned int cycle;
+	int i;
+
+	rss_base = rss_bytes();
+	ht = _cds_lfht_new(min_alloc, min_alloc, max_nr_buckets,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+			backends[backend].mm, &rcu_flavor, NULL);
+	if (!ht) {
+		fprintf(stderr, "Error allocating hash table\n");
+		exit(-1);
+	}
+	if (external_hash)
+		cds_lfht_set_node_hash(ht, node_hash_key, NULL);
+	for (cycle = 0; cycle < nr_cycles; cycle++) {
+		for (i = 0; i < (int) nr_size_list; i++) {
+			rcu_read_lock();
+			for (; nr < size_list[i]; nr++) {
+				cds_lfht_node_init(&nodes[nr].node);
+				if (external_hash)
+					nodes[nr].node.priv = nodes[nr].key;
+				cds_lfht_add(ht, hash_key(nodes[nr].key),
+					&nodes[nr].node);
+			}
+			rcu_read_unlock();
+			measure(ht, backend, min_alloc, cycle, PHASE_GROW, nr,
+				rss_base, test);
+		}
+		for (i = (int) nr_size_list - 2; i >= -1; i--) {
+			unsigned long target = i >= 0 ? size_list[i] : 0;
+
+			rcu_read_lock();
+			for (; nr > target; nr--) {
+				int ret;
+
+				ret = cds_lfht_del(ht, &nodes[nr - 1].node);
+				assert(!ret);
+			}
+			rcu_read_unlock();
+			/* Nodes are re-added by the next cycle. */
+			measure(ht, backend, min_alloc, cycle, PHASE_SHRINK, nr,
+				rss_base, test);
+		}
+	}
+	if (cds_lfht_destroy(ht, NULL)) {
+		fprintf(stderr, "Error destroying hash table\n");
+		exit(-1);
+	}
+}
+
+/* Parse a comma-separated list of numbers. Returns its length, 0 on error. */
+static
+unsigned int parse_list(const char *arg, unsigned long *list)
+{
+	unsigned int nr = 0;
+	const char *p = arg;
+	char *end;
+
+	while (*p && nr < MAX_LIST) {
+		list[nr++] = strtoul(p, &end, 0);
+		if (end == p || (*end && *end != ','))
+			return 0;
+		p = *end ? end + 1 : end;
+	}
+	return *p ? 0 : nr;
+}
+
+static
+unsigned int parse_backends(const char *arg)
+{
+	char buf[128], *saveptr, *name;
+	unsigned int nr = 0, i;
+
+	snprintf(buf, sizeof(buf), "%s", arg);
+	for (name = strtok_r(buf, ",", &saveptr); name && nr < MAX_LIST;
+			name = strtok_r(NULL, ",", &saveptr)) {
+		for (i = 0; i < CAA_ARRAY_SIZE(backends); i++) {
+			if (!strcmp(name, backends[i].name))
+				break;
+		}
+		if (i == CAA_ARRAY_SIZE(backends))
+			return 0;
+		backend_list[nr++] = i;
+	}
+	return nr;
+}
+
+static
+int is_pow2(unsigned long v)
+{
+	return v && !(v & (v - 1));
+}
+
+static
+void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s <OPTIONS>\n", argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-B order,chunk,mmap] (memory backends, default: %s)\n",
+		DEFAULT_BACKENDS);
+	printf("	[-m n,...] (minimum numbers of allocated buckets, powers of 2, default: %s)\n",
+		DEFAULT_MIN_ALLOC);
+	printf("	[-s n,...] (increasing table sizes, in nodes, default: %s)\n",
+		DEFAULT_SIZES);
+	printf("	[-M n] (maximum number of buckets, power of 2, default: largest size rounded up)\n");
+	printf("	[-c n] (grow then shrink cycles, default: %d)\n",
+		DEFAULT_CYCLES);
+	printf("	[-l n] (lookups per measurement, default: %d)\n",
+		DEFAULT_LOOKUPS);
+	printf("	[-X] (keys in the nodes, hashed by cds_lfht_set_node_hash() hook)\n");
+	printf("	[-v] (verbose output)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, j;
+	int a, mainret = 0;
+	unsigned long k;
+
+	argc = bench_report_parse_args(argc, argv);
+	nr_backend_list = parse_backends(DEFAULT_BACKENDS);
+	nr_min_alloc_list = parse_list(DEFAULT_MIN_ALLOC, min_alloc_list);
+	nr_size_list = parse_list(DEFAULT_SIZES, size_list);
+
+	for (a = 1; a < argc; a++) {
+		if (argv[a][0] != '-')
+			continue;
+		switch (argv[a][1]) {
+		case 'B':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			nr_backend_list = parse_backends(argv[++a]);
+			break;
+		case 'm':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			nr_min_alloc_list = parse_list(argv[++a],
+					min_alloc_list);
+			break;
+		case 's':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			nr_size_list = parse_list(argv[++a], size_list);
+			break;
+		case 'M':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			max_nr_buckets = atol(argv[++a]);
+			break;
+		case 'c':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			nr_cycles = atoi(argv[++a]);
+			break;
+		case 'l':
+			if (argc < a + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			nr_lookups = atol(argv[++a]);
+			break;
+		case 'X':
+			external_hash = 1;
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	if (!nr_backend_list || !nr_min_alloc_list || !nr_size_list) {
+		printf("Invalid backend, minimum allocation or size list.\n");
+		show_usage(argc, argv);
+		mainret = 1;
+		goto end;
+	}
+	for (i = 0; i < nr_min_alloc_list; i++) {
+		if (!is_pow2(min_alloc_list[i])) {
+			printf("Minimum number of allocated buckets must be a power of 2.\n");
+			mainret = 1;
+			goto end;
+		}
+	}
+	for (i = 1; i < nr_size_list; i++) {
+		if (size_list[i] <= size_list[i - 1]) {
+			printf("Table sizes must be increasing.\n");
+			mainret = 1;
+			goto end;
+		}
+	}
+	nr_nodes_max = size_list[nr_size_list - 1];
+	if (!max_nr_buckets) {
+		max_nr_buckets = 1;
+		while (max_nr_buckets < nr_nodes_max)
+			max_nr_buckets <<= 1;
+	}
+	for (i = 0; i < nr_min_alloc_list; i++) {
+		if (max_nr_buckets < min_alloc_list[i])
+			max_nr_buckets = min_alloc_list[i];
+	}
+	if (!is_pow2(max_nr_buckets)) {
+		printf("Maximum number of buckets must be a power of 2.\n");
+		mainret = 1;
+		goto end;
+	}
+
+	/* Touch the nodes before measuring, to keep them out of the RSS. */
+	nodes = calloc(nr_nodes_max, sizeof(*nodes));
+	if (!nodes) {
+		perror("calloc");
+		mainret = 1;
+		goto end;
+	}
+	for (k = 0; k < nr_nodes_max; k++)
+		nodes[k].key = k;
+	rand_seed = time(NULL);
+
+	printf_verbose("max_nr_buckets %lu, %u cycles, %lu lookups.\n",
+		max_nr_buckets, nr_cycles, nr_lookups);
+
+	rcu_register_thread();
+	for (i = 0; i < nr_backend_list; i++) {
+		for (j = 0; j < nr_min_alloc_list; j++)
+			test_backend(backend_list[i], min_alloc_list[j],
+				argv[0]);
+	}
+	rcu_unregister_thread();
+	free(nodes);
+end:
+	return mainret;
+}
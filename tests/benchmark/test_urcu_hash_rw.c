@@ -58,18 +58,74 @@ void test_hash_rw_sigusr2_handler(int signo)
 	} while (ret == -1L && errno == EINTR);
 }
 
+static
+void lookup_many_test(unsigned long *hashes, const void **keys,
+		struct cds_lfht_iter *iters)
+{
+	unsigned long i;
+
+	for (i = 0; i < lookup_batch; i++) {
+		keys[i] = key_pool_next(&lookup_keys);
+		hashes[i] = test_hash(keys[i], sizeof(void *), TEST_HASH_SEED);
+	}
+	rcu_read_lock();
+	cds_lfht_lookup_many(test_ht, lookup_batch, hashes, test_match,
+			keys, iters);
+	for (i = 0; i < lookup_batch; i++) {
+		if (cds_lfht_iter_get_test_node(&iters[i]) == NULL) {
+			if (validate_lookup) {
+				printf("[ERROR] Lookup cannot find initial node.\n");
+				exit(-1);
+			}
+			URCU_TLS(lookup_fail)++;
+		} else {
+			URCU_TLS(lookup_ok)++;
+		}
+	}
+	rcu_debug_yield_read();
+	if (caa_unlikely(rduration))
+		loop_sleep(rduration);
+	rcu_read_unlock();
+	URCU_TLS(nr_reads) += lookup_batch;
+}
+
 void *test_hash_rw_thr_reader(void *_count)
 {
 	unsigned long long *count = _count;
 	struct lfht_test_node *node;
-	struct cds_lfht_iter iter;
+	struct cds_lfht_iter iter, *iters = NULL;
+	unsigned long *hashes = NULL;
+	const void **keys = NULL;
+	struct bench_latency *hist = bench_latency_thread_alloc(lookup_lat);
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
+	struct timeline_slot *slots = NULL;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"reader", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	/* Sequential threads start at distinct keys. */
+	URCU_TLS(key_seq) = rand_r(&URCU_TLS(rand_lookup));
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_READER);
+
+	if (timeline) {
+		slots = calloc(timeline_nr_slots, sizeof(*slots));
+		if (!slots) {
+			perror("calloc");
+			exit(-1);
+		}
+	}
+	if (lookup_batch) {
+		hashes = calloc(lookup_batch, sizeof(*hashes));
+		keys = calloc(lookup_batch, sizeof(*keys));
+		iters = calloc(lookup_batch, sizeof(*iters));
+		if (!hashes || !keys || !iters) {
+			perror("calloc");
+			exit(-1);
+		}
+	}
 
 	rcu_register_thread();
 
@@ -77,13 +133,37 @@ void *test_hash_rw_thr_reader(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
+
+	while (lookup_batch) {
+		lookup_many_test(hashes, keys, iters);
+		if (caa_unlikely(!test_duration_read()))
+			goto end;
+		rcu_quiescent_state();
+	}
 
 	for (;;) {
+		void *key = key_pool_next(&lookup_keys);
+
 		rcu_read_lock();
-		cds_lfht_test_lookup(test_ht,
-			(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % lookup_pool_size) + lookup_pool_offset),
-			sizeof(void *), &iter);
-		node = cds_lfht_iter_get_test_node(&iter);
+		if (test_frozen) {
+			node = to_test_node(cds_lfht_frozen_lookup(test_frozen,
+				test_hash(key, sizeof(void *), TEST_HASH_SEED),
+				test_match, key));
+		} else {
+			caa_cycles_t begin = bench_latency_begin(hist);
+			caa_cycles_t tl_begin = 0;
+
+			if (caa_unlikely(slots))
+				tl_begin = caa_get_cycles();
+			cds_lfht_test_lookup(test_ht, key, sizeof(void *),
+				&iter);
+			node = cds_lfht_iter_get_test_node(&iter);
+			if (caa_unlikely(slots))
+				timeline_record(slots, tl_begin,
+					caa_get_cycles());
+			bench_latency_end(hist, begin);
+		}
 		if (node == NULL) {
 			if (validate_lookup) {
 				printf("[ERROR] Lookup cannot find initial node.\n");
@@ -103,8 +183,27 @@ void *test_hash_rw_thr_reader(void *_count)
 		if (caa_unlikely((URCU_TLS(nr_reads) & ((1 << 10) - 1)) == 0))
 			rcu_quiescent_state();
 	}
-
+end:
+	bench_perf_thread_free(perf_thread);
 	rcu_unregister_thread();
+	free(iters);
+	free(keys);
+	free(hashes);
+	bench_latency_merge(lookup_lat, hist);
+	bench_latency_free(hist);
+	if (slots) {
+		unsigned long i;
+
+		pthread_mutex_lock(&timeline_mutex);
+		for (i = 0; i < timeline_nr_slots; i++) {
+			timeline[i].nr += slots[i].nr;
+			timeline[i].sum += slots[i].sum;
+			if (slots[i].max > timeline[i].max)
+				timeline[i].max = slots[i].max;
+		}
+		pthread_mutex_unlock(&timeline_mutex);
+		free(slots);
+	}
 
 	*count = URCU_TLS(nr_reads);
 	printf_verbose("thread_end %s, tid %lu\n",
@@ -117,43 +216,81 @@ void *test_hash_rw_thr_reader(void *_count)
 
 }
 
+static
+enum writer_op writer_next_op(void)
+{
+	unsigned long r;
+	unsigned int op;
+
+	if (!writer_mix_total) {
+		if ((addremove == AR_ADD || add_only)
+				|| (addremove == AR_RANDOM && rand_r(&URCU_TLS(rand_lookup)) & 1))
+			return WRITER_OP_ADD;
+		return WRITER_OP_DEL;
+	}
+	r = (unsigned long) rand_r(&URCU_TLS(rand_lookup)) % writer_mix_total;
+	for (op = 0; op < NR_WRITER_OPS - 1; op++) {
+		if (r < writer_mix[op])
+			break;
+		r -= writer_mix[op];
+	}
+	return op;
+}
+
 void *test_hash_rw_thr_writer(void *_count)
 {
 	struct lfht_test_node *node;
 	struct cds_lfht_iter iter;
 	struct wr_count *count = _count;
 	int ret;
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"writer", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	/* Sequential threads start at distinct keys. */
+	URCU_TLS(key_seq) = rand_r(&URCU_TLS(rand_lookup));
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_WRITER);
 
 	rcu_register_thread();
+	writer_call_rcu_begin();
 
 	while (!test_go)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
 
 	for (;;) {
 		struct cds_lfht_node *ret_node = NULL;
+		enum writer_op op = writer_next_op();
+
+		if (op == WRITER_OP_LOOKUP) {
+			rcu_read_lock();
+			cds_lfht_test_lookup(test_ht, key_pool_next(&lookup_keys),
+				sizeof(void *), &iter);
+			if (cds_lfht_iter_get_node(&iter))
+				URCU_TLS(lookup_ok)++;
+			else
+				URCU_TLS(lookup_fail)++;
+			rcu_read_unlock();
+		} else if (op == WRITER_OP_ADD || op == WRITER_OP_REPLACE) {
+			int unique = add_unique && op == WRITER_OP_ADD;
+			int replace = add_replace || op == WRITER_OP_REPLACE;
 
-		if ((addremove == AR_ADD || add_only)
-				|| (addremove == AR_RANDOM && rand_r(&URCU_TLS(rand_lookup)) & 1)) {
 			node = malloc(sizeof(struct lfht_test_node));
-			lfht_test_node_init(node,
-				(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % write_pool_size) + write_pool_offset),
+			lfht_test_node_init(node, key_pool_next(&write_keys),
 				sizeof(void *));
 			rcu_read_lock();
-			if (add_unique) {
+			if (unique) {
 				ret_node = cds_lfht_add_unique(test_ht,
 					test_hash(node->key, node->key_len, TEST_HASH_SEED),
 					test_match, node->key, &node->node);
 			} else {
-				if (add_replace)
+				if (replace)
 					ret_node = cds_lfht_add_replace(test_ht,
 							test_hash(node->key, node->key_len, TEST_HASH_SEED),
 							test_match, node->key, &node->node);
@@ -163,13 +300,12 @@ void *test_hash_rw_thr_writer(void *_count)
 						&node->node);
 			}
 			rcu_read_unlock();
-			if (add_unique && ret_node != &node->node) {
+			if (unique && ret_node != &node->node) {
 				free(node);
 				URCU_TLS(nr_addexist)++;
 			} else {
-				if (add_replace && ret_node) {
-					call_rcu(&to_test_node(ret_node)->head,
-							free_node_cb);
+				if (replace && ret_node) {
+					free_node_rcu(to_test_node(ret_node));
 					URCU_TLS(nr_addexist)++;
 				} else {
 					URCU_TLS(nr_add)++;
@@ -178,14 +314,13 @@ void *test_hash_rw_thr_writer(void *_count)
 		} else {
 			/* May delete */
 			rcu_read_lock();
-			cds_lfht_test_lookup(test_ht,
-				(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % write_pool_size) + write_pool_offset),
+			cds_lfht_test_lookup(test_ht, key_pool_next(&write_keys),
 				sizeof(void *), &iter);
 			ret = cds_lfht_del(test_ht, cds_lfht_iter_get_node(&iter));
 			rcu_read_unlock();
 			if (ret == 0) {
 				node = cds_lfht_iter_get_test_node(&iter);
-				call_rcu(&node->head, free_node_cb);
+				free_node_rcu(node);
 				URCU_TLS(nr_del)++;
 			} else
 				URCU_TLS(nr_delnoent)++;
@@ -207,20 +342,27 @@ void *test_hash_rw_thr_writer(void *_count)
 			break;
 		if (caa_unlikely(wdelay))
 			loop_sleep(wdelay);
-		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0))
+		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0)) {
 			rcu_quiescent_state();
+			writer_call_rcu_poll();
+		}
 	}
 
+	bench_perf_thread_free(perf_thread);
+	writer_call_rcu_end();
 	rcu_unregister_thread();
 
 	printf_verbose("thread_end %s, tid %lu\n",
 			"writer", urcu_get_thread_id());
 	printf_verbose("info tid %lu: nr_add %lu, nr_addexist %lu, nr_del %lu, "
-			"nr_delnoent %lu\n", urcu_get_thread_id(),
+			"nr_delnoent %lu, lookupfail %lu, lookupok %lu\n",
+			urcu_get_thread_id(),
 			URCU_TLS(nr_add),
 			URCU_TLS(nr_addexist),
 			URCU_TLS(nr_del),
-			URCU_TLS(nr_delnoent));
+			URCU_TLS(nr_delnoent),
+			URCU_TLS(lookup_fail),
+			URCU_TLS(lookup_ok));
 	count->update_ops = URCU_TLS(nr_writes);
 	count->add = URCU_TLS(nr_add);
 	count->add_exist = URCU_TLS(nr_addexist);
@@ -228,6 +370,70 @@ void *test_hash_rw_thr_writer(void *_count)
 	return ((void*)2);
 }
 
+static
+int populate_hash_bulk(void)
+{
+	struct cds_lfht_bulk_entry *entries;
+
+	entries = calloc(bulk_populate, sizeof(*entries));
+	if (!entries)
+		return -ENOMEM;
+	while (URCU_TLS(nr_add) < init_populate) {
+		unsigned long i, nr;
+
+		nr = init_populate - URCU_TLS(nr_add);
+		if (nr > bulk_populate)
+			nr = bulk_populate;
+		for (i = 0; i < nr; i++) {
+			struct lfht_test_node *node;
+
+			node = malloc(sizeof(struct lfht_test_node));
+			lfht_test_node_init(node,
+				(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % init_pool_size) + init_pool_offset),
+				sizeof(void *));
+			entries[i].hash = test_hash(node->key, node->key_len,
+					TEST_HASH_SEED);
+			entries[i].node = &node->node;
+		}
+		rcu_read_lock();
+		cds_lfht_add_bulk(test_ht, entries, nr);
+		rcu_read_unlock();
+		URCU_TLS(nr_add) += nr;
+		URCU_TLS(nr_writes) += nr;
+	}
+	free(entries);
+	return 0;
+}
+
+struct cds_lfht *test_hash_rw_new_from_array(int flags)
+{
+	struct cds_lfht_bulk_entry *entries;
+	struct cds_lfht *ht;
+	unsigned long i;
+
+	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+
+	entries = calloc(init_populate ? init_populate : 1, sizeof(*entries));
+	if (!entries)
+		return NULL;
+	for (i = 0; i < init_populate; i++) {
+		struct lfht_test_node *node;
+
+		node = malloc(sizeof(struct lfht_test_node));
+		lfht_test_node_init(node,
+			(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % init_pool_size) + init_pool_offset),
+			sizeof(void *));
+		entries[i].hash = test_hash(node->key, node->key_len,
+				TEST_HASH_SEED);
+		entries[i].node = &node->node;
+	}
+	ht = _cds_lfht_new_from_array(entries, init_populate,
+			min_hash_alloc_size, max_hash_buckets_size, flags,
+			memory_backend, &rcu_flavor, NULL);
+	free(entries);
+	return ht;
+}
+
 int test_hash_rw_populate_hash(void)
 {
 	struct lfht_test_node *node;
@@ -239,10 +445,13 @@ int test_hash_rw_populate_hash(void)
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
 
+	if (bulk_populate && !add_unique && !add_replace)
+		return populate_hash_bulk();
+
 	if ((add_unique || add_replace) && init_populate * 10 > init_pool_size) {
 		printf("WARNING: required to populate %lu nodes (-k), but random "
 "pool is quite small (%lu values) and we are in add_unique (-u) or add_replace (-s) mode. Try with a "
-"larger random pool (-p option). This may take a while...\n", init_populate, init_pool_size);
+"larger random pool (-O option). This may take a while...\n", init_populate, init_pool_size);
 	}
 
 	while (URCU_TLS(nr_add) < init_populate) {
@@ -273,7 +482,7 @@ int test_hash_rw_populate_hash(void)
 			URCU_TLS(nr_addexist)++;
 		} else {
 			if (add_replace && ret_node) {
-				call_rcu(&to_test_node(ret_node)->head, free_node_cb);
+				free_node_rcu(to_test_node(ret_node));
 				URCU_TLS(nr_addexist)++;
 			} else {
 				URCU_TLS(nr_add)++;
@@ -61,13 +61,15 @@ void test_hash_unique_sigusr2_handler(int signo)
 void *test_hash_unique_thr_reader(void *_count)
 {
 	unsigned long long *count = _count;
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"reader", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_READER);
 
 	rcu_register_thread();
 
@@ -75,6 +77,7 @@ void *test_hash_unique_thr_reader(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
 
 	for (;;) {
 		struct lfht_test_node *node;
@@ -106,6 +109,7 @@ void *test_hash_unique_thr_reader(void *_count)
 			rcu_quiescent_state();
 	}
 
+	bench_perf_thread_free(perf_thread);
 	rcu_unregister_thread();
 
 	*count = URCU_TLS(nr_reads);
@@ -126,20 +130,24 @@ void *test_hash_unique_thr_writer(void *_count)
 	struct wr_count *count = _count;
 	int ret;
 	int loc_add_unique;
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"writer", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_WRITER);
 
 	rcu_register_thread();
+	writer_call_rcu_begin();
 
 	while (!test_go)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
 
 	for (;;) {
 		/*
@@ -178,8 +186,7 @@ void *test_hash_unique_thr_writer(void *_count)
 				}
 			} else {
 				if (ret_node) {
-					call_rcu(&to_test_node(ret_node)->head,
-							free_node_cb);
+					free_node_rcu(to_test_node(ret_node));
 					URCU_TLS(nr_addexist)++;
 				} else {
 					URCU_TLS(nr_add)++;
@@ -195,7 +202,7 @@ void *test_hash_unique_thr_writer(void *_count)
 			rcu_read_unlock();
 			if (ret == 0) {
 				node = cds_lfht_iter_get_test_node(&iter);
-				call_rcu(&node->head, free_node_cb);
+				free_node_rcu(node);
 				URCU_TLS(nr_del)++;
 			} else
 				URCU_TLS(nr_delnoent)++;
@@ -217,10 +224,14 @@ void *test_hash_unique_thr_writer(void *_count)
 			break;
 		if (caa_unlikely(wdelay))
 			loop_sleep(wdelay);
-		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0))
+		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0)) {
 			rcu_quiescent_state();
+			writer_call_rcu_poll();
+		}
 	}
 
+	bench_perf_thread_free(perf_thread);
+	writer_call_rcu_end();
 	rcu_unregister_thread();
 
 	printf_verbose("thread_end %s, tid %lu\n",
@@ -253,7 +264,7 @@ int test_hash_unique_populate_hash(void)
 	if (init_populate * 10 > init_pool_size) {
 		printf("WARNING: required to populate %lu nodes (-k), but random "
 "pool is quite small (%lu values) and we are in add_unique (-u) or add_replace (-s) mode. Try with a "
-"larger random pool (-p option). This may take a while...\n", init_populate, init_pool_size);
+"larger random pool (-O option). This may take a while...\n", init_populate, init_pool_size);
 	}
 
 	while (URCU_TLS(nr_add) < init_populate) {
@@ -267,7 +278,7 @@ int test_hash_unique_populate_hash(void)
 				test_match, node->key, &node->node);
 		rcu_read_unlock();
 		if (ret_node) {
-			call_rcu(&to_test_node(ret_node)->head, free_node_cb);
+			free_node_rcu(to_test_node(ret_node));
 			URCU_TLS(nr_addexist)++;
 		} else {
 			URCU_TLS(nr_add)++;
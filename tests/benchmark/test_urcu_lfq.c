@@ -38,6 +38,7 @@
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-report.h"
 
 /* hardcoded number of CPUs */
 #define NR_CPUS 16384
@@ -57,6 +58,13 @@ static unsigned long duration;
 /* read-side C.S. duration, in loops */
 static unsigned long wdelay;
 
+/* call_rcu backpressure high watermark, 0: disabled */
+static unsigned long high_watermark;
+static int backpressure_mode = URCU_CALL_RCU_BACKPRESSURE_THROTTLE;
+
+/* nodes per dequeue, using cds_lfq_dequeue_bulk_rcu if more than 1 */
+static unsigned long bulk = 1;
+
 static inline void loop_sleep(unsigned long loops)
 {
 	while (loops-- != 0)
@@ -197,6 +205,7 @@ void free_node_cb(struct rcu_head *head)
 void *thr_dequeuer(void *_count)
 {
 	unsigned long long *count = _count;
+	struct cds_lfq_node_rcu **qnodes;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"dequeuer", urcu_get_thread_id());
@@ -210,17 +219,25 @@ void *thr_dequeuer(void *_count)
 	}
 	cmm_smp_mb();
 
+	qnodes = calloc(bulk, sizeof(*qnodes));
+	assert(qnodes);
+
 	for (;;) {
-		struct cds_lfq_node_rcu *qnode;
+		unsigned long i, n;
 
 		rcu_read_lock();
-		qnode = cds_lfq_dequeue_rcu(&q);
+		if (bulk > 1) {
+			n = cds_lfq_dequeue_bulk_rcu(&q, qnodes, bulk);
+		} else {
+			qnodes[0] = cds_lfq_dequeue_rcu(&q);
+			n = !!qnodes[0];
+		}
 		rcu_read_unlock();
 
-		if (qnode) {
+		for (i = 0; i < n; i++) {
 			struct test *node;
 
-			node = caa_container_of(qnode, struct test, list);
+			node = caa_container_of(qnodes[i], struct test, list);
 			call_rcu(&node->rcu, free_node_cb);
 			URCU_TLS(nr_successful_dequeues)++;
 		}
@@ -240,6 +257,7 @@ void *thr_dequeuer(void *_count)
 			URCU_TLS(nr_successful_dequeues));
 	count[0] = URCU_TLS(nr_dequeues);
 	count[1] = URCU_TLS(nr_successful_dequeues);
+	free(qnodes);
 	return ((void*)2);
 }
 
@@ -268,11 +286,15 @@ void show_usage(int argc, char **argv)
 	printf("	[-c duration] (dequeuer period (in loops))\n");
 	printf("	[-v] (verbose output)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[-t watermark] (throttle call_rcu above watermark callbacks)\n");
+	printf("	[-i watermark] (invoke callbacks inline above watermark callbacks)\n");
+	printf("	[-b count] (dequeue up to count nodes at once)\n");
 	printf("\n");
 }
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
@@ -283,6 +305,7 @@ int main(int argc, char **argv)
 	unsigned long long end_dequeues = 0;
 	int i, a;
 
+	argc = bench_report_parse_args(argc, argv);
 	if (argc < 4) {
 		show_usage(argc, argv);
 		return -1;
@@ -320,6 +343,17 @@ int main(int argc, char **argv)
 			use_affinity = 1;
 			printf_verbose("Adding CPU %d affinity\n", a);
 			break;
+		case 'b':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			bulk = atol(argv[++i]);
+			if (!bulk) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
 		case 'c':
 			if (argc < i + 2) {
 				show_usage(argc, argv);
@@ -337,6 +371,16 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose_mode = 1;
 			break;
+		case 't':
+		case 'i':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			if (argv[i][1] == 'i')
+				backpressure_mode = URCU_CALL_RCU_BACKPRESSURE_HELP;
+			high_watermark = atol(argv[++i]);
+			break;
 		}
 	}
 
@@ -353,9 +397,17 @@ int main(int argc, char **argv)
 	count_enqueuer = calloc(nr_enqueuers, 2 * sizeof(*count_enqueuer));
 	count_dequeuer = calloc(nr_dequeuers, 2 * sizeof(*count_dequeuer));
 	cds_lfq_init_rcu(&q, call_rcu);
-	err = create_all_cpu_call_rcu_data(0);
-	if (err) {
-		printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
+	if (high_watermark) {
+		/* All callbacks are queued on the default call_rcu thread. */
+		err = call_rcu_data_set_watermarks(get_default_call_rcu_data(),
+				high_watermark, high_watermark / 2,
+				backpressure_mode);
+		assert(!err);
+	} else {
+		err = create_all_cpu_call_rcu_data(0);
+		if (err) {
+			printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
+		}
 	}
 
 	next_aff = 0;
@@ -411,16 +463,35 @@ int main(int argc, char **argv)
 	printf_verbose("total number of successful enqueues : %llu, "
 		       "successful dequeues %llu\n",
 		       tot_successful_enqueues, tot_successful_dequeues);
-	printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
-		"nr_dequeuers %3u "
-		"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
-		"successful enqueues %12llu successful dequeues %12llu "
-		"end_dequeues %llu nr_ops %12llu\n",
-		argv[0], duration, nr_enqueuers, wdelay,
-		nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
-		tot_successful_enqueues,
-		tot_successful_dequeues, end_dequeues,
-		tot_enqueues + tot_dequeues);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
+			"nr_dequeuers %3u "
+			"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
+			"successful enqueues %12llu successful dequeues %12llu "
+			"end_dequeues %llu nr_ops %12llu\n",
+			argv[0], duration, nr_enqueuers, wdelay,
+			nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
+			tot_successful_enqueues,
+			tot_successful_dequeues, end_dequeues,
+			tot_enqueues + tot_dequeues);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_enqueuers", nr_enqueuers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "nr_dequeuers", nr_dequeuers);
+	bench_report_config(&report, "rdur", rduration);
+	for (i = 0; i < nr_enqueuers; i++)
+		bench_report_thread(&report, "enqueuer", count_enqueuer[2 * i]);
+	for (i = 0; i < nr_dequeuers; i++)
+		bench_report_thread(&report, "dequeuer", count_dequeuer[2 * i]);
+	bench_report_result(&report, "enqueues", tot_enqueues);
+	bench_report_result(&report, "dequeues", tot_dequeues);
+	bench_report_result(&report, "successful_enqueues",
+		tot_successful_enqueues);
+	bench_report_result(&report, "successful_dequeues",
+		tot_successful_dequeues);
+	bench_report_result(&report, "end_dequeues", end_dequeues);
+	bench_report_result(&report, "nr_ops", tot_enqueues + tot_dequeues);
+	bench_report_print(&report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues)
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
@@ -38,6 +38,7 @@
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-report.h"
 
 /* hardcoded number of CPUs */
 #define NR_CPUS 16384
@@ -60,6 +61,10 @@ enum test_sync {
 
 static enum test_sync test_sync;
 
+/* Elimination array used by push and pop with -e. */
+static int test_elim;
+static struct cds_lfs_elim elim;
+
 static volatile int test_go, test_stop;
 
 static unsigned long rduration;
@@ -79,6 +84,12 @@ static int verbose_mode;
 
 static int test_pop, test_pop_all;
 
+/*
+ * nodes per pop, using __cds_lfs_pop_n if more than 1, which walks the
+ * stack: popped nodes are then not poisoned before their grace period.
+ */
+static unsigned long pop_n = 1;
+
 #define printf_verbose(fmt, args...)		\
 	do {					\
 		if (verbose_mode)		\
@@ -174,7 +185,10 @@ static void *thr_enqueuer(void *_count)
 		if (!node)
 			goto fail;
 		cds_lfs_node_init(&node->list);
-		cds_lfs_push(&s, &node->list);
+		if (test_elim)
+			cds_lfs_push_elim(&s, &elim, &node->list);
+		else
+			cds_lfs_push(&s, &node->list);
 		URCU_TLS(nr_successful_enqueues)++;
 
 		if (caa_unlikely(wdelay))
@@ -207,20 +221,29 @@ void free_node_cb(struct rcu_head *head)
 }
 
 static
-void do_test_pop(enum test_sync sync)
+void do_test_pop(enum test_sync sync, struct cds_lfs_node **snodes)
 {
-	struct cds_lfs_node *snode;
+	unsigned long i, n;
 
 	if (sync == TEST_SYNC_RCU)
 		rcu_read_lock();
-	snode = __cds_lfs_pop(&s);
+	if (pop_n > 1) {
+		n = __cds_lfs_pop_n(&s, snodes, pop_n);
+	} else if (test_elim) {
+		snodes[0] = __cds_lfs_pop_elim(&s, &elim);
+		n = !!snodes[0];
+	} else {
+		snodes[0] = __cds_lfs_pop(&s);
+		n = !!snodes[0];
+	}
 	if (sync == TEST_SYNC_RCU)
 		rcu_read_unlock();
-	if (snode) {
+	for (i = 0; i < n; i++) {
 		struct test *node;
 
-		snode->next = POISON_PTR;
-		node = caa_container_of(snode,
+		if (pop_n == 1)
+			snodes[i]->next = POISON_PTR;
+		node = caa_container_of(snodes[i],
 			struct test, list);
 		if (sync == TEST_SYNC_RCU)
 			call_rcu(&node->rcu, free_node_cb);
@@ -242,7 +265,8 @@ void do_test_pop_all(enum test_sync sync)
 	cds_lfs_for_each_safe(head, snode, n) {
 		struct test *node;
 
-		snode->next = POISON_PTR;
+		if (pop_n == 1)
+			snode->next = POISON_PTR;
 		node = caa_container_of(snode, struct test, list);
 		if (sync == TEST_SYNC_RCU)
 			call_rcu(&node->rcu, free_node_cb);
@@ -257,6 +281,7 @@ void do_test_pop_all(enum test_sync sync)
 static void *thr_dequeuer(void *_count)
 {
 	unsigned long long *count = _count;
+	struct cds_lfs_node **snodes;
 	unsigned int counter = 0;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
@@ -273,17 +298,20 @@ static void *thr_dequeuer(void *_count)
 
 	assert(test_pop || test_pop_all);
 
+	snodes = calloc(pop_n, sizeof(*snodes));
+	assert(snodes);
+
 	for (;;) {
 		if (test_pop && test_pop_all) {
 			/* both pop and pop all */
 			if (counter & 1)
-				do_test_pop(test_sync);
+				do_test_pop(test_sync, snodes);
 			else
 				do_test_pop_all(test_sync);
 			counter++;
 		} else {
 			if (test_pop)
-				do_test_pop(test_sync);
+				do_test_pop(test_sync, snodes);
 			else
 				do_test_pop_all(test_sync);
 		}
@@ -303,6 +331,7 @@ static void *thr_dequeuer(void *_count)
 			URCU_TLS(nr_successful_dequeues));
 	count[0] = URCU_TLS(nr_dequeues);
 	count[1] = URCU_TLS(nr_successful_dequeues);
+	free(snodes);
 	return ((void*)2);
 }
 
@@ -332,14 +361,17 @@ static void show_usage(int argc, char **argv)
 	printf("	[-v] (verbose output)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
 	printf("	[-p] (test pop)\n");
+	printf("	[-n count] (test pop of up to count nodes at once)\n");
 	printf("	[-P] (test pop_all, enabled by default)\n");
 	printf("	[-R] (use RCU external synchronization)\n");
+	printf("	[-e] (push and pop through an elimination array)\n");
 	printf("		Note: default: no external synchronization used.\n");
 	printf("\n");
 }
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
@@ -350,6 +382,7 @@ int main(int argc, char **argv)
 	unsigned long long end_dequeues = 0;
 	int i, a;
 
+	argc = bench_report_parse_args(argc, argv);
 	if (argc < 4) {
 		show_usage(argc, argv);
 		return -1;
@@ -407,12 +440,27 @@ int main(int argc, char **argv)
 		case 'p':
 			test_pop = 1;
 			break;
+		case 'n':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			pop_n = atol(argv[++i]);
+			if (!pop_n) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			test_pop = 1;
+			break;
 		case 'P':
 			test_pop_all = 1;
 			break;
 		case 'R':
 			test_sync = TEST_SYNC_RCU;
 			break;
+		case 'e':
+			test_elim = 1;
+			break;
 		}
 	}
 
@@ -427,6 +475,8 @@ int main(int argc, char **argv)
 		printf_verbose("pop test activated.\n");
 	if (test_pop_all)
 		printf_verbose("pop_all test activated.\n");
+	if (test_elim)
+		printf_verbose("Elimination array activated.\n");
 	if (test_sync == TEST_SYNC_RCU)
 		printf_verbose("External sync: RCU.\n");
 	else
@@ -441,6 +491,7 @@ int main(int argc, char **argv)
 	count_enqueuer = calloc(nr_enqueuers, 2 * sizeof(*count_enqueuer));
 	count_dequeuer = calloc(nr_dequeuers, 2 * sizeof(*count_dequeuer));
 	cds_lfs_init(&s);
+	cds_lfs_elim_init(&elim);
 	err = create_all_cpu_call_rcu_data(0);
 	if (err) {
 		printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
@@ -497,16 +548,35 @@ int main(int argc, char **argv)
 	printf_verbose("total number of successful enqueues : %llu, "
 		       "successful dequeues %llu\n",
 		       tot_successful_enqueues, tot_successful_dequeues);
-	printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
-		"nr_dequeuers %3u "
-		"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
-		"successful enqueues %12llu successful dequeues %12llu "
-		"end_dequeues %llu nr_ops %12llu\n",
-		argv[0], duration, nr_enqueuers, wdelay,
-		nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
-		tot_successful_enqueues,
-		tot_successful_dequeues, end_dequeues,
-		tot_enqueues + tot_dequeues);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
+			"nr_dequeuers %3u "
+			"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
+			"successful enqueues %12llu successful dequeues %12llu "
+			"end_dequeues %llu nr_ops %12llu\n",
+			argv[0], duration, nr_enqueuers, wdelay,
+			nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
+			tot_successful_enqueues,
+			tot_successful_dequeues, end_dequeues,
+			tot_enqueues + tot_dequeues);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_enqueuers", nr_enqueuers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "nr_dequeuers", nr_dequeuers);
+	bench_report_config(&report, "rdur", rduration);
+	for (i = 0; i < nr_enqueuers; i++)
+		bench_report_thread(&report, "enqueuer", count_enqueuer[2 * i]);
+	for (i = 0; i < nr_dequeuers; i++)
+		bench_report_thread(&report, "dequeuer", count_dequeuer[2 * i]);
+	bench_report_result(&report, "enqueues", tot_enqueues);
+	bench_report_result(&report, "dequeues", tot_dequeues);
+	bench_report_result(&report, "successful_enqueues",
+		tot_successful_enqueues);
+	bench_report_result(&report, "successful_dequeues",
+		tot_successful_dequeues);
+	bench_report_result(&report, "end_dequeues", end_dequeues);
+	bench_report_result(&report, "nr_ops", tot_enqueues + tot_dequeues);
+	bench_report_print(&report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues)
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
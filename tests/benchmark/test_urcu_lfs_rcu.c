@@ -38,6 +38,7 @@
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-report.h"
 
 /* hardcoded number of CPUs */
 #define NR_CPUS 16384
@@ -275,6 +276,7 @@ void show_usage(int argc, char **argv)
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
@@ -285,6 +287,7 @@ int main(int argc, char **argv)
 	unsigned long long end_dequeues = 0;
 	int i, a;
 
+	argc = bench_report_parse_args(argc, argv);
 	if (argc < 4) {
 		show_usage(argc, argv);
 		return -1;
@@ -411,16 +414,35 @@ int main(int argc, char **argv)
 	printf_verbose("total number of successful enqueues : %llu, "
 		       "successful dequeues %llu\n",
 		       tot_successful_enqueues, tot_successful_dequeues);
-	printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
-		"nr_dequeuers %3u "
-		"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
-		"successful enqueues %12llu successful dequeues %12llu "
-		"end_dequeues %llu nr_ops %12llu\n",
-		argv[0], duration, nr_enqueuers, wdelay,
-		nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
-		tot_successful_enqueues,
-		tot_successful_dequeues, end_dequeues,
-		tot_enqueues + tot_dequeues);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
+			"nr_dequeuers %3u "
+			"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
+			"successful enqueues %12llu successful dequeues %12llu "
+			"end_dequeues %llu nr_ops %12llu\n",
+			argv[0], duration, nr_enqueuers, wdelay,
+			nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
+			tot_successful_enqueues,
+			tot_successful_dequeues, end_dequeues,
+			tot_enqueues + tot_dequeues);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_enqueuers", nr_enqueuers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "nr_dequeuers", nr_dequeuers);
+	bench_report_config(&report, "rdur", rduration);
+	for (i = 0; i < nr_enqueuers; i++)
+		bench_report_thread(&report, "enqueuer", count_enqueuer[2 * i]);
+	for (i = 0; i < nr_dequeuers; i++)
+		bench_report_thread(&report, "dequeuer", count_dequeuer[2 * i]);
+	bench_report_result(&report, "enqueues", tot_enqueues);
+	bench_report_result(&report, "dequeues", tot_dequeues);
+	bench_report_result(&report, "successful_enqueues",
+		tot_successful_enqueues);
+	bench_report_result(&report, "successful_dequeues",
+		tot_successful_dequeues);
+	bench_report_result(&report, "end_dequeues", end_dequeues);
+	bench_report_result(&report, "nr_ops", tot_enqueues + tot_dequeues);
+	bench_report_print(&report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues)
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
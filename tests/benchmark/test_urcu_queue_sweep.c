@@ -0,0 +1,1084 @@
+/*
+ * test_urcu_queue_sweep.c
+ *
+ * Userspace RCU library - producer/consumer sweep over the concurrent
+ * queues, stacks and ring buffers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Runs the same workload on each structure of test_urcu_wfcq,
+ * test_urcu_wfq, test_urcu_lfq, test_urcu_lfs, test_urcu_lfs_rcu,
+ * test_urcu_wfs and test_urcu_ring, for each combination of number of
+ * producers and consumers, batch size and payload size: producers
+ * enqueue batches of items, consumers dequeue batches of items and
+ * release them, for the given duration. Each run prints the item
+ * throughput of both sides, the latency percentiles of an enqueue and
+ * of a non-empty dequeue of a batch, and the memory allocations per
+ * item, so that the structures can be compared directly.
+ *
+ * Items carry a sequence number, whose sums are checked at the end of
+ * each run, and a payload written by the producer and checked by the
+ * consumer. The nodes of the queues and stacks are allocated with the
+ * items. Items without payload are stored as integers into the rings,
+ * without allocation. Batches are enqueued and dequeued with the bulk
+ * primitives of the structures where they exist, and item by item
+ * otherwise.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include "cpuset.h"
+#include "thread-id.h"
+#include "bench-report.h"
+#include "bench-latency.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#define _LGPL_SOURCE
+
+/* Remove deprecation warnings from test build. */
+#define CDS_WFQ_DEPRECATED
+#define CDS_LFS_RCU_DEPRECATED
+
+#include <urcu.h>
+#include <urcu/cds.h>
+#include <urcu/wfqueue.h>
+#include <urcu/ring.h>
+
+/* Largest batch, bounding the node arrays of the bulk primitives. */
+#define SWEEP_MAX_BATCH	1024
+
+#define SWEEP_MAX_RUNS	64
+
+struct sweep_item {
+	union {
+		struct cds_wfcq_node wfcq;
+		struct cds_wfq_node wfq;
+		struct cds_lfq_node_rcu lfq;
+		struct cds_lfs_node lfs;
+		struct cds_lfs_node_rcu lfs_rcu;
+		struct cds_wfs_node wfs;
+	} u;
+	struct rcu_head rcu;
+	unsigned long seq;
+	unsigned char payload[];
+};
+
+/* Single producer and single consumer only. */
+#define SWEEP_SPSC	(1U << 0)
+/* Items without payload are stored as integers. */
+#define SWEEP_RING	(1U << 1)
+
+struct sweep_queue {
+	const char *name;
+	unsigned int flags;
+	void (*init)(void);
+	void (*fini)(void);
+	/* Returns the number of items of @items enqueued, in order. */
+	unsigned long (*enqueue)(struct sweep_item **items, unsigned long n);
+	/* Returns the number of items dequeued into @items, up to @n. */
+	unsigned long (*dequeue)(struct sweep_item **items, unsigned long n);
+	/* Whether items must wait for a grace period before being freed. */
+	int rcu;
+};
+
+static volatile int test_go, test_stop_enqueue, test_stop_dequeue;
+
+static unsigned long duration;
+
+static unsigned long capacity = 4096;
+
+static unsigned long batch, payload;
+
+static const struct sweep_queue *queue;
+
+static struct bench_latency *enqueue_lat, *dequeue_lat;
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, ## args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++ % NR_CPUS];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/* Ring items without payload are sequence numbers. */
+static inline int item_inline(void)
+{
+	return (queue->flags & SWEEP_RING) && !payload;
+}
+
+static inline unsigned long item_seq(struct sweep_item *item)
+{
+	if (item_inline())
+		return (uintptr_t) item;
+	return item->seq;
+}
+
+static void free_item_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct sweep_item, rcu));
+}
+
+/* Returns the number of frees, immediate or after a grace period. */
+static unsigned long release_item(struct sweep_item *item)
+{
+	if (item_inline())
+		return 0;
+	if (queue->rcu)
+		call_rcu(&item->rcu, free_item_cb);
+	else
+		free(item);
+	return 1;
+}
+
+/* wfcq: batches are spliced from a local queue. */
+
+static struct cds_wfcq_head __attribute__((aligned(CAA_CACHE_LINE_SIZE))) wfcq_head;
+static struct cds_wfcq_tail __attribute__((aligned(CAA_CACHE_LINE_SIZE))) wfcq_tail;
+
+static void wfcq_init(void)
+{
+	cds_wfcq_init(&wfcq_head, &wfcq_tail);
+}
+
+static void wfcq_fini(void)
+{
+	cds_wfcq_destroy(&wfcq_head, &wfcq_tail);
+}
+
+static unsigned long wfcq_enqueue(struct sweep_item **items, unsigned long n)
+{
+	struct __cds_wfcq_head head;
+	struct cds_wfcq_tail tail;
+	unsigned long i;
+
+	if (n == 1) {
+		cds_wfcq_node_init(&items[0]->u.wfcq);
+		(void) cds_wfcq_enqueue(&wfcq_head, &wfcq_tail,
+				&items[0]->u.wfcq);
+		return 1;
+	}
+	__cds_wfcq_init(&head, &tail);
+	for (i = 0; i < n; i++) {
+		cds_wfcq_node_init(&items[i]->u.wfcq);
+		(void) cds_wfcq_enqueue(&head, &tail, &items[i]->u.wfcq);
+	}
+	(void) __cds_wfcq_splice_blocking(&wfcq_head, &wfcq_tail,
+			&head, &tail);
+	return n;
+}
+
+static unsigned long wfcq_dequeue(struct sweep_item **items, unsigned long n)
+{
+	struct cds_wfcq_node *node;
+	unsigned long i;
+
+	cds_wfcq_dequeue_lock(&wfcq_head, &wfcq_tail);
+	for (i = 0; i < n; i++) {
+		node = __cds_wfcq_dequeue_blocking(&wfcq_head, &wfcq_tail);
+		if (!node)
+			break;
+		items[i] = caa_container_of(node, struct sweep_item, u.wfcq);
+	}
+	cds_wfcq_dequeue_unlock(&wfcq_head, &wfcq_tail);
+	return i;
+}
+
+/* wfq */
+
+static struct cds_wfq_queue wfq;
+
+static void wfq_init(void)
+{
+	cds_wfq_init(&wfq);
+}
+
+static void wfq_fini(void)
+{
+	cds_wfq_destroy(&wfq);
+}
+
+static unsigned long wfq_enqueue(struct sweep_item **items, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		cds_wfq_node_init(&items[i]->u.wfq);
+		cds_wfq_enqueue(&wfq, &items[i]->u.wfq);
+	}
+	return n;
+}
+
+static unsigned long wfq_dequeue(struct sweep_item **items, unsigned long n)
+{
+	struct cds_wfq_node *node;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		node = cds_wfq_dequeue_blocking(&wfq);
+		if (!node)
+			break;
+		items[i] = caa_container_of(node, struct sweep_item, u.wfq);
+	}
+	return i;
+}
+
+/* lfq: batches are dequeued with a single cmpxchg. */
+
+static struct cds_lfq_queue_rcu lfq;
+
+static void lfq_init(void)
+{
+	cds_lfq_init_rcu(&lfq, call_rcu);
+}
+
+static void lfq_fini(void)
+{
+	int ret;
+
+	ret = cds_lfq_destroy_rcu(&lfq);
+	assert(!ret);
+}
+
+static unsigned long lfq_enqueue(struct sweep_item **items, unsigned long n)
+{
+	unsigned long i;
+
+	rcu_read_lock();
+	for (i = 0; i < n; i++) {
+		cds_lfq_node_init_rcu(&items[i]->u.lfq);
+		cds_lfq_enqueue_rcu(&lfq, &items[i]->u.lfq);
+	}
+	rcu_read_unlock();
+	return n;
+}
+
+static unsigned long lfq_dequeue(struct sweep_item **items, unsigned long n)
+{
+	struct cds_lfq_node_rcu *nodes[SWEEP_MAX_BATCH];
+	unsigned long i;
+
+	rcu_read_lock();
+	if (n > 1) {
+		n = cds_lfq_dequeue_bulk_rcu(&lfq, nodes, n);
+	} else {
+		nodes[0] = cds_lfq_dequeue_rcu(&lfq);
+		n = !!nodes[0];
+	}
+	rcu_read_unlock();
+	for (i = 0; i < n; i++)
+		items[i] = caa_container_of(nodes[i], struct sweep_item, u.lfq);
+	return n;
+}
+
+/* lfs: batches are popped with a single cmpxchg. */
+
+static struct cds_lfs_stack lfs;
+
+static void lfs_init(void)
+{
+	cds_lfs_init(&lfs);
+}
+
+static void lfs_fini(void)
+{
+	cds_lfs_destroy(&lfs);
+}
+
+static unsigned long lfs_enqueue(struct sweep_item **items, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		cds_lfs_node_init(&items[i]->u.lfs);
+		(void) cds_lfs_push(&lfs, &items[i]->u.lfs);
+	}
+	return n;
+}
+
+static unsigned long lfs_dequeue(struct sweep_item **items, unsigned long n)
+{
+	struct cds_lfs_node *nodes[SWEEP_MAX_BATCH];
+	unsigned long i;
+
+	if (n > 1) {
+		n = cds_lfs_pop_n_blocking(&lfs, nodes, n);
+	} else {
+		nodes[0] = cds_lfs_pop_blocking(&lfs);
+		n = !!nodes[0];
+	}
+	for (i = 0; i < n; i++)
+		items[i] = caa_container_of(nodes[i], struct sweep_item, u.lfs);
+	return n;
+}
+
+/* lfs_rcu */
+
+static struct cds_lfs_stack_rcu lfs_rcu;
+
+static void lfs_rcu_init(void)
+{
+	cds_lfs_init_rcu(&lfs_rcu);
+}
+
+static void lfs_rcu_fini(void)
+{
+}
+
+static unsigned long lfs_rcu_enqueue(struct sweep_item **items,
+		unsigned long n)
+{
+	unsigned long i;
+
+	/* No rcu read-side is needed for push */
+	for (i = 0; i < n; i++) {
+		cds_lfs_node_init_rcu(&items[i]->u.lfs_rcu);
+		cds_lfs_push_rcu(&lfs_rcu, &items[i]->u.lfs_rcu);
+	}
+	return n;
+}
+
+static unsigned long lfs_rcu_dequeue(struct sweep_item **items,
+		unsigned long n)
+{
+	struct cds_lfs_node_rcu *node;
+	unsigned long i;
+
+	rcu_read_lock();
+	for (i = 0; i < n; i++) {
+		node = cds_lfs_pop_rcu(&lfs_rcu);
+		if (!node)
+			break;
+		items[i] = caa_container_of(node, struct sweep_item,
+				u.lfs_rcu);
+	}
+	rcu_read_unlock();
+	return i;
+}
+
+/* wfs */
+
+static struct cds_wfs_stack wfs;
+
+static void wfs_init(void)
+{
+	cds_wfs_init(&wfs);
+}
+
+static void wfs_fini(void)
+{
+	cds_wfs_destroy(&wfs);
+}
+
+static unsigned long wfs_enqueue(struct sweep_item **items, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		cds_wfs_node_init(&items[i]->u.wfs);
+		(void) cds_wfs_push(&wfs, &items[i]->u.wfs);
+	}
+	return n;
+}
+
+static unsigned long wfs_dequeue(struct sweep_item **items, unsigned long n)
+{
+	struct cds_wfs_node *node;
+	unsigned long i;
+
+	cds_wfs_pop_lock(&wfs);
+	for (i = 0; i < n; i++) {
+		node = __cds_wfs_pop_blocking(&wfs);
+		if (!node)
+			break;
+		items[i] = caa_container_of(node, struct sweep_item, u.wfs);
+	}
+	cds_wfs_pop_unlock(&wfs);
+	return i;
+}
+
+/* Rings: enqueue stops at the first full slot. */
+
+static struct cds_mpmc_ring __attribute__((aligned(CAA_CACHE_LINE_SIZE))) mpmc;
+static struct cds_spsc_ring __attribute__((aligned(CAA_CACHE_LINE_SIZE))) spsc;
+
+static void mpmc_init(void)
+{
+	int ret;
+
+	ret = cds_mpmc_ring_init(&mpmc, capacity);
+	if (ret) {
+		fprintf(stderr, "Ring init: %s\n", strerror(-ret));
+		exit(-1);
+	}
+}
+
+static void mpmc_fini(void)
+{
+	cds_mpmc_ring_destroy(&mpmc);
+}
+
+static unsigned long mpmc_enqueue(struct sweep_item **items, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		if (!cds_mpmc_ring_enqueue(&mpmc, items[i]))
+			break;
+	}
+	return i;
+}
+
+static unsigned long mpmc_dequeue(struct sweep_item **items, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		if (!cds_mpmc_ring_dequeue(&mpmc, (void **) &items[i]))
+			break;
+	}
+	return i;
+}
+
+static void spsc_init(void)
+{
+	int ret;
+
+	ret = cds_spsc_ring_init(&spsc, capacity);
+	if (ret) {
+		fprintf(stderr, "Ring init: %s\n", strerror(-ret));
+		exit(-1);
+	}
+}
+
+static void spsc_fini(void)
+{
+	cds_spsc_ring_destroy(&spsc);
+}
+
+static unsigned long spsc_enqueue(struct sweep_item **items, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		if (!cds_spsc_ring_enqueue(&spsc, items[i]))
+			break;
+	}
+	return i;
+}
+
+static unsigned long spsc_dequeue(struct sweep_item **items, unsigned long n)
+{
+	return cds_spsc_ring_dequeue_bulk(&spsc, (void **) items, n);
+}
+
+static const struct sweep_queue queues[] = {
+	{ "wfcq", 0, wfcq_init, wfcq_fini, wfcq_enqueue, wfcq_dequeue, 0 },
+	{ "wfq", 0, wfq_init, wfq_fini, wfq_enqueue, wfq_dequeue, 0 },
+	{ "lfq", 0, lfq_init, lfq_fini, lfq_enqueue, lfq_dequeue, 1 },
+	{ "lfs", 0, lfs_init, lfs_fini, lfs_enqueue, lfs_dequeue, 0 },
+	{ "lfs_rcu", 0, lfs_rcu_init, lfs_rcu_fini, lfs_rcu_enqueue,
+		lfs_rcu_dequeue, 1 },
+	{ "wfs", 0, wfs_init, wfs_fini, wfs_enqueue, wfs_dequeue, 0 },
+	{ "mpmc_ring", SWEEP_RING, mpmc_init, mpmc_fini, mpmc_enqueue,
+		mpmc_dequeue, 0 },
+	{ "spsc_ring", SWEEP_RING | SWEEP_SPSC, spsc_init, spsc_fini,
+		spsc_enqueue, spsc_dequeue, 0 },
+};
+
+/* Per-thread totals of a run. */
+struct sweep_count {
+	unsigned long long items;	/* enqueued or dequeued */
+	unsigned long long ops;		/* enqueue or dequeue calls */
+	unsigned long long sum;		/* of the item sequence numbers */
+	unsigned long long allocs, alloc_bytes, frees;
+	unsigned long long bad_payloads;
+};
+
+static struct sweep_item *alloc_item(unsigned long seq,
+		struct sweep_count *count)
+{
+	struct sweep_item *item;
+
+	if (item_inline())
+		return (struct sweep_item *) (uintptr_t) seq;
+	item = malloc(sizeof(*item) + payload);
+	if (!item) {
+		perror("malloc");
+		exit(-1);
+	}
+	item->seq = seq;
+	memset(item->payload, (unsigned char) seq, payload);
+	count->allocs++;
+	count->alloc_bytes += sizeof(*item) + payload;
+	return item;
+}
+
+static int check_item(struct sweep_item *item)
+{
+	unsigned char c;
+
+	if (item_inline() || !payload)
+		return 1;
+	c = (unsigned char) item->seq;
+	return item->payload[0] == c && item->payload[payload - 1] == c;
+}
+
+static void *thr_producer(void *_count)
+{
+	struct sweep_count *count = _count;
+	struct sweep_item *items[SWEEP_MAX_BATCH];
+	struct bench_latency *lat;
+	unsigned long i, n, pending = 0, seq = 0;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"producer", urcu_get_thread_id());
+
+	set_affinity();
+	rcu_register_thread();
+	lat = bench_latency_thread_alloc(enqueue_lat);
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!CMM_LOAD_SHARED(test_stop_enqueue)) {
+		caa_cycles_t begin;
+
+		/* Items left by a full ring are enqueued first. */
+		for (; pending < batch; pending++)
+			items[pending] = alloc_item(++seq, count);
+		begin = bench_latency_begin(lat);
+		n = queue->enqueue(items, batch);
+		bench_latency_end(lat, begin);
+		for (i = 0; i < n; i++)
+			count->sum += item_seq(items[i]);
+		count->items += n;
+		count->ops++;
+		pending = batch - n;
+		memmove(items, items + n, pending * sizeof(*items));
+	}
+	for (i = 0; i < pending; i++) {
+		if (!item_inline()) {
+			free(items[i]);
+			count->frees++;
+		}
+	}
+
+	bench_latency_merge(enqueue_lat, lat);
+	bench_latency_free(lat);
+	rcu_unregister_thread();
+	printf_verbose("producer thread_end, tid %lu, items %llu\n",
+			urcu_get_thread_id(), count->items);
+	return ((void*)1);
+}
+
+static void dequeue_items(struct sweep_item **items, unsigned long n,
+		struct sweep_count *count)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		if (!check_item(items[i]))
+			count->bad_payloads++;
+		count->sum += item_seq(items[i]);
+		count->frees += release_item(items[i]);
+	}
+	count->items += n;
+}
+
+static void *thr_consumer(void *_count)
+{
+	struct sweep_count *count = _count;
+	struct sweep_item *items[SWEEP_MAX_BATCH];
+	struct bench_latency *lat;
+	unsigned long n;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"consumer", urcu_get_thread_id());
+
+	set_affinity();
+	rcu_register_thread();
+	lat = bench_latency_thread_alloc(dequeue_lat);
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!CMM_LOAD_SHARED(test_stop_dequeue)) {
+		caa_cycles_t begin;
+
+		begin = bench_latency_begin(lat);
+		n = queue->dequeue(items, batch);
+		/* Only non-empty dequeues are timed. */
+		if (n)
+			bench_latency_end(lat, begin);
+		dequeue_items(items, n, count);
+		count->ops++;
+	}
+
+	bench_latency_merge(dequeue_lat, lat);
+	bench_latency_free(lat);
+	rcu_unregister_thread();
+	printf_verbose("consumer thread_end, tid %lu, items %llu\n",
+			urcu_get_thread_id(), count->items);
+	return ((void*)2);
+}
+
+static void sum_counts(struct sweep_count *total,
+		const struct sweep_count *count, unsigned int nr)
+{
+	unsigned int i;
+
+	memset(total, 0, sizeof(*total));
+	for (i = 0; i < nr; i++) {
+		total->items += count[i].items;
+		total->ops += count[i].ops;
+		total->sum += count[i].sum;
+		total->allocs += count[i].allocs;
+		total->alloc_bytes += count[i].alloc_bytes;
+		total->frees += count[i].frees;
+		total->bad_payloads += count[i].bad_payloads;
+	}
+}
+
+static double per_item(unsigned long long v, unsigned long long items)
+{
+	return items ? (double) v / items : 0;
+}
+
+/* Run @queue with the given thread counts, batch and payload sizes. */
+static int run_one(unsigned int nr_producers,
+		unsigned int nr_consumers)
+{
+	struct bench_report report;
+	pthread_t *tid_producer, *tid_consumer;
+	struct sweep_count *count_producer, *count_consumer;
+	struct sweep_count prod, cons, end;
+	unsigned long n;
+	unsigned int i;
+	void *tret;
+	int err, retval = 0;
+
+	enqueue_lat = bench_latency_alloc("enqueue");
+	dequeue_lat = bench_latency_alloc("dequeue");
+	queue->init();
+
+	tid_producer = calloc(nr_producers, sizeof(*tid_producer));
+	tid_consumer = calloc(nr_consumers, sizeof(*tid_consumer));
+	count_producer = calloc(nr_producers, sizeof(*count_producer));
+	count_consumer = calloc(nr_consumers, sizeof(*count_consumer));
+	if (!tid_producer || !tid_consumer || !count_producer
+			|| !count_consumer) {
+		perror("calloc");
+		exit(-1);
+	}
+
+	test_go = test_stop_enqueue = test_stop_dequeue = 0;
+	next_aff = 0;
+
+	for (i = 0; i < nr_producers; i++) {
+		err = pthread_create(&tid_producer[i], NULL, thr_producer,
+				     &count_producer[i]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i = 0; i < nr_consumers; i++) {
+		err = pthread_create(&tid_consumer[i], NULL, thr_consumer,
+				     &count_consumer[i]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	test_go = 1;
+
+	for (i = 0; i < duration; i++) {
+		sleep(1);
+		if (verbose_mode) {
+			fwrite(".", sizeof(char), 1, stdout);
+			fflush(stdout);
+		}
+	}
+
+	CMM_STORE_SHARED(test_stop_enqueue, 1);
+	CMM_STORE_SHARED(test_stop_dequeue, 1);
+
+	for (i = 0; i < nr_producers; i++) {
+		err = pthread_join(tid_producer[i], &tret);
+		if (err != 0)
+			exit(1);
+	}
+	for (i = 0; i < nr_consumers; i++) {
+		err = pthread_join(tid_consumer[i], &tret);
+		if (err != 0)
+			exit(1);
+	}
+
+	/* Drain what is left, out of the measurements. */
+	memset(&end, 0, sizeof(end));
+	do {
+		struct sweep_item *items[SWEEP_MAX_BATCH];
+
+		n = queue->dequeue(items, SWEEP_MAX_BATCH);
+		dequeue_items(items, n, &end);
+	} while (n);
+	queue->fini();
+	rcu_barrier();
+
+	sum_counts(&prod, count_producer, nr_producers);
+	sum_counts(&cons, count_consumer, nr_consumers);
+
+	if (bench_report_text()) {
+		printf("SWEEP %-10s producers %3u consumers %3u batch %4lu "
+			"payload %5lu enqueued_per_s %12.0f "
+			"dequeued_per_s %12.0f allocs_per_item %.3f "
+			"alloc_bytes_per_item %.1f\n",
+			queue->name, nr_producers, nr_consumers, batch,
+			payload,
+			(double) prod.items / duration,
+			(double) cons.items / duration,
+			per_item(prod.allocs, prod.items),
+			per_item(prod.alloc_bytes, prod.items));
+		bench_latency_print(enqueue_lat);
+		bench_latency_print(dequeue_lat);
+	}
+	bench_report_init(&report, queue->name, duration);
+	bench_report_config(&report, "nr_producers", nr_producers);
+	bench_report_config(&report, "nr_consumers", nr_consumers);
+	bench_report_config(&report, "batch", batch);
+	bench_report_config(&report, "payload", payload);
+	bench_report_config(&report, "capacity", capacity);
+	for (i = 0; i < nr_producers; i++)
+		bench_report_thread(&report, "producer",
+			count_producer[i].items);
+	for (i = 0; i < nr_consumers; i++)
+		bench_report_thread(&report, "consumer",
+			count_consumer[i].items);
+	bench_report_result(&report, "enqueued", prod.items);
+	bench_report_result(&report, "dequeued", cons.items);
+	bench_report_result(&report, "enqueue_ops", prod.ops);
+	bench_report_result(&report, "dequeue_ops", cons.ops);
+	bench_report_result(&report, "end_dequeues", end.items);
+	bench_report_result(&report, "allocs", prod.allocs);
+	bench_report_result(&report, "alloc_bytes", prod.alloc_bytes);
+	bench_latency_report(&report, enqueue_lat);
+	bench_latency_report(&report, dequeue_lat);
+	bench_report_print(&report);
+
+	if (prod.items != cons.items + end.items) {
+		printf("WARNING! %s: Discrepancy between nr enqueued items "
+		       "%llu vs dequeued items %llu.\n", queue->name,
+		       prod.items, cons.items + end.items);
+		retval = 1;
+	}
+	if (prod.sum != cons.sum + end.sum) {
+		printf("WARNING! %s: Discrepancy between sum of enqueued "
+		       "items %llu and sum of dequeued items %llu.\n",
+		       queue->name, prod.sum, cons.sum + end.sum);
+		retval = 1;
+	}
+	if (prod.allocs != prod.frees + cons.frees + end.frees) {
+		printf("WARNING! %s: %llu items allocated, %llu freed.\n",
+		       queue->name, prod.allocs,
+		       prod.frees + cons.frees + end.frees);
+		retval = 1;
+	}
+	if (cons.bad_payloads + end.bad_payloads) {
+		printf("WARNING! %s: %llu corrupted payloads.\n", queue->name,
+		       cons.bad_payloads + end.bad_payloads);
+		retval = 1;
+	}
+
+	bench_latency_free(enqueue_lat);
+	bench_latency_free(dequeue_lat);
+	free(count_producer);
+	free(count_consumer);
+	free(tid_producer);
+	free(tid_consumer);
+	return retval;
+}
+
+/* Parse a comma-separated list of unsigned integers. */
+static int parse_list(const char *arg, unsigned long *values)
+{
+	char *end;
+	int nr = 0;
+
+	for (;;) {
+		if (nr == SWEEP_MAX_RUNS)
+			return -1;
+		values[nr++] = strtoul(arg, &end, 10);
+		if (end == arg)
+			return -1;
+		if (!*end)
+			return nr;
+		if (*end != ',')
+			return -1;
+		arg = end + 1;
+	}
+}
+
+/* Parse a comma-separated list of producers:consumers thread counts. */
+static int parse_ratios(const char *arg, unsigned long *producers,
+		unsigned long *consumers)
+{
+	char *end;
+	int nr = 0;
+
+	for (;;) {
+		if (nr == SWEEP_MAX_RUNS)
+			return -1;
+		producers[nr] = strtoul(arg, &end, 10);
+		if (end == arg || *end != ':' || !producers[nr])
+			return -1;
+		arg = end + 1;
+		consumers[nr] = strtoul(arg, &end, 10);
+		if (end == arg || !consumers[nr])
+			return -1;
+		nr++;
+		if (!*end)
+			return nr;
+		if (*end != ',')
+			return -1;
+		arg = end + 1;
+	}
+}
+
+static void show_usage(int argc, char **argv)
+{
+	unsigned int i;
+
+	printf("Usage : %s duration (s) <OPTIONS>\n", argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-q name,...] (structures, default all of:");
+	for (i = 0; i < CAA_ARRAY_SIZE(queues); i++)
+		printf(" %s", queues[i].name);
+	printf(")\n");
+	printf("	[-p P:C,...] (producers:consumers, default 1:1,1:4,4:1)\n");
+	printf("	[-b batch,...] (items per enqueue and dequeue, default 1,16)\n");
+	printf("	[-s bytes,...] (item payload sizes, default 0,64,1024)\n");
+	printf("	[-r capacity] (ring capacity, power of 2, default 4096)\n");
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--latency[=period]] (time one of period operations, default 1)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long producers[SWEEP_MAX_RUNS] = { 1, 1, 4 };
+	unsigned long consumers[SWEEP_MAX_RUNS] = { 1, 4, 1 };
+	unsigned long batches[SWEEP_MAX_RUNS] = { 1, 16 };
+	unsigned long payloads[SWEEP_MAX_RUNS] = { 0, 64, 1024 };
+	int nr_ratios = 3, nr_batches = 2, nr_payloads = 3;
+	int selected[CAA_ARRAY_SIZE(queues)];
+	int err, i, j, k, a, retval = 0;
+	unsigned int q;
+
+	argc = bench_report_parse_args(argc, argv);
+	argc = bench_latency_parse_args(argc, argv);
+	/* Latencies are part of the results: time every operation. */
+	if (!bench_latency_enabled()) {
+		bench_latency_period = 1;
+		bench_latency_calibrate();
+	}
+	if (argc < 2) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%lu", &duration);
+	if (err != 1 || !duration) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (q = 0; q < CAA_ARRAY_SIZE(queues); q++)
+		selected[q] = 1;
+
+	for (i = 2; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'b':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_batches = parse_list(argv[++i], batches);
+			break;
+		case 'p':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_ratios = parse_ratios(argv[++i], producers,
+					consumers);
+			break;
+		case 'q':
+		{
+			char *name, *save;
+
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			memset(selected, 0, sizeof(selected));
+			for (name = strtok_r(argv[++i], ",", &save); name;
+					name = strtok_r(NULL, ",", &save)) {
+				for (q = 0; q < CAA_ARRAY_SIZE(queues); q++) {
+					if (!strcmp(name, queues[q].name))
+						break;
+				}
+				if (q == CAA_ARRAY_SIZE(queues)) {
+					fprintf(stderr, "Unknown structure: %s\n",
+						name);
+					return -1;
+				}
+				selected[q] = 1;
+			}
+			break;
+		}
+		case 'r':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			capacity = atol(argv[++i]);
+			break;
+		case 's':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_payloads = parse_list(argv[++i], payloads);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	if (nr_ratios < 0 || nr_batches < 0 || nr_payloads < 0) {
+		show_usage(argc, argv);
+		return -1;
+	}
+	for (j = 0; j < nr_batches; j++) {
+		if (!batches[j] || batches[j] > SWEEP_MAX_BATCH) {
+			fprintf(stderr, "Batch sizes range from 1 to %u.\n",
+				SWEEP_MAX_BATCH);
+			return -1;
+		}
+	}
+
+	printf_verbose("running each test for %lu seconds.\n", duration);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	rcu_register_thread();
+	for (q = 0; q < CAA_ARRAY_SIZE(queues); q++) {
+		if (!selected[q])
+			continue;
+		queue = &queues[q];
+		for (i = 0; i < nr_ratios; i++) {
+			if ((queue->flags & SWEEP_SPSC)
+			    && (producers[i] > 1 || consumers[i] > 1)) {
+				printf_verbose("%s: skipping %lu:%lu threads.\n",
+					queue->name, producers[i],
+					consumers[i]);
+				continue;
+			}
+			for (j = 0; j < nr_batches; j++) {
+				batch = batches[j];
+				for (k = 0; k < nr_payloads; k++) {
+					payload = payloads[k];
+					retval |= run_one(producers[i],
+						consumers[i]);
+				}
+			}
+		}
+	}
+	rcu_unregister_thread();
+	return retval;
+}
@@ -0,0 +1,529 @@
+/*
+ * test_urcu_ring.c
+ *
+ * Userspace RCU library - bounded lock-free ring buffer benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Same workload as test_urcu_wfcq, on a cds_mpmc_ring, or with -S on a
+ * cds_spsc_ring: enqueuers enqueue items in a loop while dequeuers
+ * dequeue them. Items are integers rather than allocated nodes, whose
+ * sums are checked at the end. Enqueues to a full ring and dequeues
+ * from an empty ring fail, and are counted.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include "cpuset.h"
+#include "thread-id.h"
+#include "bench-report.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu/ring.h>
+
+static volatile int test_go, test_stop_enqueue, test_stop_dequeue;
+
+static unsigned long rduration;
+
+static unsigned long duration;
+
+/* read-side C.S. duration, in loops */
+static unsigned long wdelay;
+
+static unsigned long capacity = 4096;
+
+/* Single producer and consumer ring, and its bulk dequeue size. */
+static int test_spsc;
+static unsigned long bulk = 1;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+static int test_wait_empty;
+static int test_enqueue_stopped;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, ## args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration_dequeue(void)
+{
+	return !test_stop_dequeue;
+}
+
+static int test_duration_enqueue(void)
+{
+	return !test_stop_enqueue;
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_dequeues);
+static DEFINE_URCU_TLS(unsigned long long, nr_enqueues);
+
+static DEFINE_URCU_TLS(unsigned long long, nr_successful_dequeues);
+static DEFINE_URCU_TLS(unsigned long long, nr_successful_enqueues);
+static DEFINE_URCU_TLS(unsigned long long, sum_dequeues);
+static DEFINE_URCU_TLS(unsigned long long, sum_enqueues);
+
+static unsigned int nr_enqueuers;
+static unsigned int nr_dequeuers;
+
+static struct cds_mpmc_ring __attribute__((aligned(CAA_CACHE_LINE_SIZE))) mpmc;
+static struct cds_spsc_ring __attribute__((aligned(CAA_CACHE_LINE_SIZE))) spsc;
+
+static bool ring_enqueue(void *item)
+{
+	if (test_spsc)
+		return cds_spsc_ring_enqueue(&spsc, item);
+	return cds_mpmc_ring_enqueue(&mpmc, item);
+}
+
+/* Returns the number of items dequeued into @items, up to @count. */
+static unsigned long ring_dequeue(void **items, unsigned long count)
+{
+	if (test_spsc)
+		return cds_spsc_ring_dequeue_bulk(&spsc, items, count);
+	return cds_mpmc_ring_dequeue(&mpmc, items);
+}
+
+static void *thr_enqueuer(void *_count)
+{
+	unsigned long long *count = _count;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"enqueuer", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		uintptr_t value = URCU_TLS(nr_successful_enqueues) + 1;
+
+		if (ring_enqueue((void *) value)) {
+			URCU_TLS(nr_successful_enqueues)++;
+			URCU_TLS(sum_enqueues) += value;
+		}
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+		URCU_TLS(nr_enqueues)++;
+		if (caa_unlikely(!test_duration_enqueue()))
+			break;
+	}
+
+	uatomic_inc(&test_enqueue_stopped);
+	count[0] = URCU_TLS(nr_enqueues);
+	count[1] = URCU_TLS(nr_successful_enqueues);
+	count[2] = URCU_TLS(sum_enqueues);
+	printf_verbose("enqueuer thread_end, tid %lu, "
+			"enqueues %llu successful_enqueues %llu\n",
+			urcu_get_thread_id(),
+			URCU_TLS(nr_enqueues),
+			URCU_TLS(nr_successful_enqueues));
+	return ((void*)1);
+
+}
+
+static void *thr_dequeuer(void *_count)
+{
+	unsigned long long *count = _count;
+	void **items;
+	unsigned long i, n;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"dequeuer", urcu_get_thread_id());
+
+	set_affinity();
+
+	items = calloc(bulk, sizeof(*items));
+	assert(items);
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		n = ring_dequeue(items, bulk);
+		for (i = 0; i < n; i++)
+			URCU_TLS(sum_dequeues) += (uintptr_t) items[i];
+		URCU_TLS(nr_successful_dequeues) += n;
+		URCU_TLS(nr_dequeues)++;
+		if (caa_unlikely(!test_duration_dequeue()))
+			break;
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+	}
+
+	printf_verbose("dequeuer thread_end, tid %lu, "
+			"dequeues %llu, successful_dequeues %llu\n",
+			urcu_get_thread_id(),
+			URCU_TLS(nr_dequeues), URCU_TLS(nr_successful_dequeues));
+	count[0] = URCU_TLS(nr_dequeues);
+	count[1] = URCU_TLS(nr_successful_dequeues);
+	count[2] = URCU_TLS(sum_dequeues);
+	free(items);
+	return ((void*)2);
+}
+
+static void test_end(unsigned long long *nr_dequeues,
+		unsigned long long *sum)
+{
+	void *item;
+
+	while (ring_dequeue(&item, 1)) {
+		(*sum) += (uintptr_t) item;
+		(*nr_dequeues)++;
+	}
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_dequeuers nr_enqueuers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-d delay] (enqueuer period (in loops))\n");
+	printf("	[-c duration] (dequeuer period (in loops))\n");
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[-r capacity] (ring capacity, power of 2, default 4096)\n");
+	printf("	[-S] (single producer, single consumer ring)\n");
+	printf("	[-b count] (bulk dequeue size of the -S ring)\n");
+	printf("	[-w] Wait for dequeuer to empty queue\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report report;
+	int err;
+	pthread_t *tid_enqueuer, *tid_dequeuer;
+	void *tret;
+	unsigned long long *count_enqueuer, *count_dequeuer;
+	unsigned long long tot_enqueues = 0, tot_dequeues = 0;
+	unsigned long long tot_successful_enqueues = 0,
+			   tot_successful_dequeues = 0,
+			   tot_sum_enqueues = 0, tot_sum_dequeues = 0;
+	unsigned long long end_dequeues = 0;
+	int i, a, retval = 0;
+
+	argc = bench_report_parse_args(argc, argv);
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_dequeuers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_enqueuers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'b':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			bulk = atol(argv[++i]);
+			break;
+		case 'c':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			rduration = atol(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'r':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			capacity = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		case 'S':
+			test_spsc = 1;
+			break;
+		case 'w':
+			test_wait_empty = 1;
+			break;
+		}
+	}
+
+	if (test_spsc && (nr_enqueuers > 1 || nr_dequeuers > 1)) {
+		fprintf(stderr, "The -S ring has a single enqueuer and a "
+			"single dequeuer.\n");
+		return -1;
+	}
+	if (!bulk || (!test_spsc && bulk != 1)) {
+		show_usage(argc, argv);
+		return -1;
+	}
+	if (test_spsc)
+		err = cds_spsc_ring_init(&spsc, capacity);
+	else
+		err = cds_mpmc_ring_init(&mpmc, capacity);
+	if (err) {
+		fprintf(stderr, "Ring init: %s\n", strerror(-err));
+		return -1;
+	}
+
+	printf_verbose("running test for %lu seconds, %u enqueuers, "
+		       "%u dequeuers, %s ring of %lu items.\n",
+		       duration, nr_enqueuers, nr_dequeuers,
+		       test_spsc ? "spsc" : "mpmc", capacity);
+	if (test_wait_empty)
+		printf_verbose("Wait for dequeuers to empty queue.\n");
+	printf_verbose("Writer delay : %lu loops.\n", rduration);
+	printf_verbose("Reader duration : %lu loops.\n", wdelay);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	tid_enqueuer = calloc(nr_enqueuers, sizeof(*tid_enqueuer));
+	tid_dequeuer = calloc(nr_dequeuers, sizeof(*tid_dequeuer));
+	count_enqueuer = calloc(nr_enqueuers, 3 * sizeof(*count_enqueuer));
+	count_dequeuer = calloc(nr_dequeuers, 3 * sizeof(*count_dequeuer));
+
+	next_aff = 0;
+
+	for (i = 0; i < nr_enqueuers; i++) {
+		err = pthread_create(&tid_enqueuer[i], NULL, thr_enqueuer,
+				     &count_enqueuer[3 * i]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i = 0; i < nr_dequeuers; i++) {
+		err = pthread_create(&tid_dequeuer[i], NULL, thr_dequeuer,
+				     &count_dequeuer[3 * i]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	test_go = 1;
+
+	for (i = 0; i < duration; i++) {
+		sleep(1);
+		if (verbose_mode) {
+			fwrite(".", sizeof(char), 1, stdout);
+			fflush(stdout);
+		}
+	}
+
+	test_stop_enqueue = 1;
+
+	if (test_wait_empty) {
+		while (nr_enqueuers != uatomic_read(&test_enqueue_stopped)) {
+			sleep(1);
+		}
+		while (uatomic_read(test_spsc ? &spsc.head : &mpmc.dequeue_pos)
+		       != uatomic_read(test_spsc ? &spsc.tail : &mpmc.enqueue_pos)) {
+			sleep(1);
+		}
+	}
+
+	test_stop_dequeue = 1;
+
+	for (i = 0; i < nr_enqueuers; i++) {
+		err = pthread_join(tid_enqueuer[i], &tret);
+		if (err != 0)
+			exit(1);
+		tot_enqueues += count_enqueuer[3 * i];
+		tot_successful_enqueues += count_enqueuer[3 * i + 1];
+		tot_sum_enqueues += count_enqueuer[3 * i + 2];
+	}
+	for (i = 0; i < nr_dequeuers; i++) {
+		err = pthread_join(tid_dequeuer[i], &tret);
+		if (err != 0)
+			exit(1);
+		tot_dequeues += count_dequeuer[3 * i];
+		tot_successful_dequeues += count_dequeuer[3 * i + 1];
+		tot_sum_dequeues += count_dequeuer[3 * i + 2];
+	}
+
+	test_end(&end_dequeues, &tot_sum_dequeues);
+
+	printf_verbose("total number of enqueues : %llu, dequeues %llu\n",
+		       tot_enqueues, tot_dequeues);
+	printf_verbose("total number of successful enqueues : %llu, "
+		       "successful dequeues %llu\n",
+		       tot_successful_enqueues,
+		       tot_successful_dequeues);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
+			"nr_dequeuers %3u "
+			"rdur %6lu capacity %lu nr_enqueues %12llu "
+			"nr_dequeues %12llu "
+			"successful enqueues %12llu "
+			"successful dequeues %12llu "
+			"end_dequeues %llu nr_ops %12llu\n",
+			argv[0], duration, nr_enqueuers, wdelay,
+			nr_dequeuers, rduration, capacity, tot_enqueues,
+			tot_dequeues,
+			tot_successful_enqueues,
+			tot_successful_dequeues,
+			end_dequeues,
+			tot_enqueues + tot_dequeues);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_enqueuers", nr_enqueuers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "nr_dequeuers", nr_dequeuers);
+	bench_report_config(&report, "rdur", rduration);
+	bench_report_config(&report, "capacity", capacity);
+	bench_report_config(&report, "spsc", test_spsc);
+	bench_report_config(&report, "bulk", bulk);
+	for (i = 0; i < nr_enqueuers; i++)
+		bench_report_thread(&report, "enqueuer", count_enqueuer[3 * i]);
+	for (i = 0; i < nr_dequeuers; i++)
+		bench_report_thread(&report, "dequeuer", count_dequeuer[3 * i]);
+	bench_report_result(&report, "enqueues", tot_enqueues);
+	bench_report_result(&report, "dequeues", tot_dequeues);
+	bench_report_result(&report, "successful_enqueues",
+		tot_successful_enqueues);
+	bench_report_result(&report, "successful_dequeues",
+		tot_successful_dequeues);
+	bench_report_result(&report, "end_dequeues", end_dequeues);
+	bench_report_result(&report, "nr_ops", tot_enqueues + tot_dequeues);
+	bench_report_print(&report);
+
+	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues) {
+		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
+		       "succ. dequeues + end dequeues %llu.\n",
+		       tot_successful_enqueues,
+		       tot_successful_dequeues + end_dequeues);
+		retval = 1;
+	}
+	if (tot_sum_enqueues != tot_sum_dequeues) {
+		printf("WARNING! Discrepancy between sum of enqueued items "
+		       "%llu and sum of dequeued items %llu.\n",
+		       tot_sum_enqueues, tot_sum_dequeues);
+		retval = 1;
+	}
+	if (test_spsc)
+		cds_spsc_ring_destroy(&spsc);
+	else
+		cds_mpmc_ring_destroy(&mpmc);
+	free(count_enqueuer);
+	free(count_dequeuer);
+	free(tid_enqueuer);
+	free(tid_dequeuer);
+	return retval;
+}
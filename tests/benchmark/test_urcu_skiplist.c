@@ -0,0 +1,632 @@
+/*
+ * test_urcu_skiplist.c
+ *
+ * Userspace RCU library - test program for the RCU skip list
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include <compat-rand.h>
+#include "cpuset.h"
+#include "thread-id.h"
+#include "bench-report.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#define DEFAULT_RAND_POOL	1000000
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu-qsbr.h>
+#include <urcu/rcuskiplist.h>
+
+static volatile int test_go, test_stop;
+
+static unsigned long wdelay;
+
+static unsigned long duration;
+
+/* read-side C.S. duration, in loops */
+static unsigned long rduration;
+
+/* keys traversed per reader lookup, using range lookups if more than 1 */
+static unsigned long range_len = 1;
+
+static unsigned long init_populate;
+static int add_only;
+
+static unsigned long lookup_pool_size = DEFAULT_RAND_POOL;
+static unsigned long write_pool_size = DEFAULT_RAND_POOL;
+
+static struct cds_skiplist *test_list;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_reads);
+static DEFINE_URCU_TLS(unsigned long long, nr_writes);
+static DEFINE_URCU_TLS(unsigned long long, lookup_ok);
+static DEFINE_URCU_TLS(unsigned long long, lookup_fail);
+static DEFINE_URCU_TLS(unsigned long long, nr_add);
+static DEFINE_URCU_TLS(unsigned long long, nr_addexist);
+static DEFINE_URCU_TLS(unsigned long long, nr_del);
+static DEFINE_URCU_TLS(unsigned long long, nr_delnoent);
+static DEFINE_URCU_TLS(unsigned int, rand_lookup);
+
+static unsigned int nr_readers;
+static unsigned int nr_writers;
+
+struct lfsl_test_node {
+	unsigned long key;
+	struct rcu_head head;	/* Before node: the tower ends the structure. */
+	struct cds_skiplist_node node;
+};
+
+struct wr_count {
+	unsigned long update_ops;
+	unsigned long add;
+	unsigned long add_exist;
+	unsigned long remove;
+};
+
+static
+int test_cmp(struct cds_skiplist_node *node, const void *key)
+{
+	struct lfsl_test_node *test_node =
+		caa_container_of(node, struct lfsl_test_node, node);
+	unsigned long k = *(const unsigned long *) key;
+
+	if (test_node->key < k)
+		return -1;
+	return test_node->key > k;
+}
+
+static
+struct lfsl_test_node *alloc_test_node(unsigned long key)
+{
+	struct lfsl_test_node *test_node;
+	unsigned int level = cds_skiplist_random_level();
+
+	test_node = malloc(offsetof(struct lfsl_test_node, node)
+			+ cds_skiplist_node_size(level));
+	if (!test_node)
+		return NULL;
+	test_node->key = key;
+	cds_skiplist_node_init(&test_node->node, level);
+	return test_node;
+}
+
+static
+void free_node_cb(struct rcu_head *head)
+{
+	struct lfsl_test_node *node =
+		caa_container_of(head, struct lfsl_test_node, head);
+	free(node);
+}
+
+void *thr_reader(void *_count)
+{
+	unsigned long long *count = _count;
+	struct cds_skiplist_node *node;
+	unsigned long key, hi, prev = 0, n;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+
+	set_affinity();
+
+	rcu_register_thread();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		key = rand_r(&URCU_TLS(rand_lookup)) % lookup_pool_size;
+		rcu_read_lock();
+		if (range_len > 1) {
+			hi = key + range_len - 1;
+			n = 0;
+			cds_skiplist_for_each_range(test_list, &key, &hi, node) {
+				unsigned long k = caa_container_of(node,
+					struct lfsl_test_node, node)->key;
+
+				/* Keys are seen in increasing order. */
+				assert(!n || k > prev);
+				prev = k;
+				n++;
+			}
+		} else {
+			node = cds_skiplist_lookup(test_list, &key);
+			n = !!node;
+		}
+		if (n)
+			URCU_TLS(lookup_ok)++;
+		else
+			URCU_TLS(lookup_fail)++;
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+		rcu_read_unlock();
+		URCU_TLS(nr_reads)++;
+		if (caa_unlikely(test_stop))
+			break;
+		if (caa_unlikely((URCU_TLS(nr_reads) & ((1 << 10) - 1)) == 0))
+			rcu_quiescent_state();
+	}
+
+	rcu_unregister_thread();
+
+	*count = URCU_TLS(nr_reads);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	printf_verbose("readid : %lx, lookupfail %llu, lookupok %llu\n",
+			pthread_self(), URCU_TLS(lookup_fail),
+			URCU_TLS(lookup_ok));
+	return ((void*)1);
+}
+
+void *thr_writer(void *_count)
+{
+	struct wr_count *count = _count;
+	struct cds_skiplist_node *ret_node;
+	struct lfsl_test_node *test_node;
+	unsigned int seed;
+	unsigned long key;
+	int ret;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+
+	seed = urcu_get_thread_id() ^ time(NULL);
+
+	set_affinity();
+
+	rcu_register_thread();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		key = rand_r(&seed) % write_pool_size;
+		if (add_only || rand_r(&seed) & 1) {
+			test_node = alloc_test_node(key);
+			assert(test_node);
+			rcu_read_lock();
+			ret_node = cds_skiplist_add_unique(test_list,
+					&test_node->key, &test_node->node);
+			rcu_read_unlock();
+			if (ret_node != &test_node->node) {
+				free(test_node);
+				URCU_TLS(nr_addexist)++;
+			} else {
+				URCU_TLS(nr_add)++;
+			}
+		} else {
+			rcu_read_lock();
+			ret_node = cds_skiplist_lookup(test_list, &key);
+			ret = ret_node ? cds_skiplist_del(test_list, ret_node)
+				: -ENOENT;
+			rcu_read_unlock();
+			if (!ret) {
+				test_node = caa_container_of(ret_node,
+					struct lfsl_test_node, node);
+				call_rcu(&test_node->head, free_node_cb);
+				URCU_TLS(nr_del)++;
+			} else {
+				URCU_TLS(nr_delnoent)++;
+			}
+		}
+		URCU_TLS(nr_writes)++;
+		if (caa_unlikely(test_stop))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0))
+			rcu_quiescent_state();
+	}
+
+	rcu_unregister_thread();
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+	printf_verbose("info id %lx: nr_add %llu, nr_addexist %llu, "
+			"nr_del %llu, nr_delnoent %llu\n", pthread_self(),
+			URCU_TLS(nr_add), URCU_TLS(nr_addexist),
+			URCU_TLS(nr_del), URCU_TLS(nr_delnoent));
+	count->update_ops = URCU_TLS(nr_writes);
+	count->add = URCU_TLS(nr_add);
+	count->add_exist = URCU_TLS(nr_addexist);
+	count->remove = URCU_TLS(nr_del);
+	return ((void*)2);
+}
+
+static
+unsigned long populate_list(void)
+{
+	struct cds_skiplist_node *ret_node;
+	struct lfsl_test_node *test_node;
+	unsigned int seed = 0x42;
+	unsigned long i, nr_add = 0;
+
+	rcu_thread_online();
+	for (i = 0; i < init_populate; i++) {
+		test_node = alloc_test_node(rand_r(&seed) % write_pool_size);
+		assert(test_node);
+		rcu_read_lock();
+		ret_node = cds_skiplist_add_unique(test_list, &test_node->key,
+				&test_node->node);
+		rcu_read_unlock();
+		if (ret_node != &test_node->node)
+			free(test_node);
+		else
+			nr_add++;
+	}
+	rcu_thread_offline();
+	return nr_add;
+}
+
+/*
+ * Check the order of the final nodes, and remove them. Returns the
+ * number of nodes, or -1 if out of order.
+ */
+static
+long test_end(void)
+{
+	struct cds_skiplist_node *node;
+	struct lfsl_test_node *test_node;
+	unsigned long prev = 0;
+	long count = 0;
+	int order_ok = 1, ret;
+
+	rcu_thread_online();
+	rcu_read_lock();
+	cds_skiplist_for_each(test_list, node) {
+		test_node = caa_container_of(node, struct lfsl_test_node, node);
+		if (count && test_node->key <= prev)
+			order_ok = 0;
+		prev = test_node->key;
+		ret = cds_skiplist_del(test_list, node);
+		assert(!ret);
+		call_rcu(&test_node->head, free_node_cb);
+		count++;
+	}
+	rcu_read_unlock();
+	rcu_thread_offline();
+	return order_ok ? count : -1;
+}
+
+void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_readers nr_writers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("        [-d delay] (writer period (in loops))\n");
+	printf("        [-c duration] (reader C.S. duration (in loops))\n");
+	printf("        [-v] (verbose output)\n");
+	printf("        [-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("        [-i] Add only (no removal).\n");
+	printf("        [-k nr_nodes] Number of nodes to insert initially.\n");
+	printf("        [-l nr_keys] Lookup ranges of nr_keys keys.\n");
+	printf("        [-M size] Lookup pool size.\n");
+	printf("        [-N size] Write pool size.\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report report;
+	pthread_t *tid_reader, *tid_writer;
+	void *tret;
+	unsigned long long *count_reader;
+	struct wr_count *count_writer;
+	unsigned long long tot_reads = 0, tot_writes = 0,
+		tot_add = 0, tot_add_exist = 0, tot_remove = 0;
+	unsigned long nr_init;
+	long count;
+	int i, a, err, ret = 0;
+
+	argc = bench_report_parse_args(argc, argv);
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_readers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_writers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'c':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			rduration = atol(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		case 'i':
+			add_only = 1;
+			break;
+		case 'k':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			init_populate = atol(argv[++i]);
+			break;
+		case 'l':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			range_len = atol(argv[++i]);
+			if (!range_len) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 'M':
+		case 'N':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			if (argv[i][1] == 'M')
+				lookup_pool_size = atol(argv[++i]);
+			else
+				write_pool_size = atol(argv[++i]);
+			if (!lookup_pool_size || !write_pool_size) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, %u readers %u writers.\n",
+		duration, nr_readers, nr_writers);
+	printf_verbose("Writer delay : %lu loops.\n", wdelay);
+	printf_verbose("Reader duration : %lu loops.\n", rduration);
+	printf_verbose("Lookup range: %lu keys.\n", range_len);
+	printf_verbose("Initial nodes: %lu.\n", init_populate);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+	tid_writer = calloc(nr_writers, sizeof(*tid_writer));
+	count_reader = calloc(nr_readers, sizeof(*count_reader));
+	count_writer = calloc(nr_writers, sizeof(*count_writer));
+
+	err = create_all_cpu_call_rcu_data(0);
+	if (err) {
+		printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
+	}
+
+	test_list = cds_skiplist_new(test_cmp);
+	if (!test_list) {
+		printf("Error allocating skip list.\n");
+		return -1;
+	}
+
+	/* Populate and check the list as a RCU reader thread. */
+	rcu_register_thread();
+	rcu_thread_offline();
+	nr_init = populate_list();
+
+	next_aff = 0;
+
+	for (i = 0; i < nr_readers; i++) {
+		err = pthread_create(&tid_reader[i], NULL, thr_reader,
+				     &count_reader[i]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i = 0; i < nr_writers; i++) {
+		err = pthread_create(&tid_writer[i], NULL, thr_writer,
+				     &count_writer[i]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	test_go = 1;
+
+	for (i = 0; i < duration; i++) {
+		sleep(1);
+		if (verbose_mode) {
+			fwrite(".", sizeof(char), 1, stdout);
+			fflush(stdout);
+		}
+	}
+
+	test_stop = 1;
+
+	for (i = 0; i < nr_readers; i++) {
+		err = pthread_join(tid_reader[i], &tret);
+		if (err != 0)
+			exit(1);
+		tot_reads += count_reader[i];
+	}
+	for (i = 0; i < nr_writers; i++) {
+		err = pthread_join(tid_writer[i], &tret);
+		if (err != 0)
+			exit(1);
+		tot_writes += count_writer[i].update_ops;
+		tot_add += count_writer[i].add;
+		tot_add_exist += count_writer[i].add_exist;
+		tot_remove += count_writer[i].remove;
+	}
+
+	count = test_end();
+	rcu_barrier();
+	rcu_unregister_thread();
+	err = cds_skiplist_destroy(test_list);
+	assert(!err);
+
+	printf_verbose("final delete: %ld items\n", count);
+	printf_verbose("total number of reads : %llu, writes %llu\n",
+		tot_reads, tot_writes);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu "
+			"nr_writers %3u wdelay %6lu nr_reads %12llu "
+			"nr_writes %12llu nr_ops %12llu nr_add %12llu "
+			"nr_add_fail %12llu nr_remove %12llu nr_leaked %12lld\n",
+			argv[0], duration, nr_readers, rduration,
+			nr_writers, wdelay, tot_reads, tot_writes,
+			tot_reads + tot_writes, tot_add, tot_add_exist,
+			tot_remove,
+			(long long) nr_init + tot_add - tot_remove
+				- (long long) count);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_readers", nr_readers);
+	bench_report_config(&report, "rdur", rduration);
+	bench_report_config(&report, "nr_writers", nr_writers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "range_len", range_len);
+	for (i = 0; i < nr_readers; i++)
+		bench_report_thread(&report, "reader", count_reader[i]);
+	for (i = 0; i < nr_writers; i++)
+		bench_report_thread(&report, "writer",
+			count_writer[i].update_ops);
+	bench_report_result(&report, "reads", tot_reads);
+	bench_report_result(&report, "writes", tot_writes);
+	bench_report_result(&report, "nr_ops", tot_reads + tot_writes);
+	bench_report_result(&report, "add", tot_add);
+	bench_report_result(&report, "add_fail", tot_add_exist);
+	bench_report_result(&report, "remove", tot_remove);
+	bench_report_print(&report);
+	if (count < 0) {
+		printf("WARNING! Final nodes out of key order.\n");
+		ret = 1;
+	} else if (nr_init + tot_add - tot_remove != (unsigned long long) count) {
+		printf("WARNING! Discrepancy between nr added %llu and "
+			"nr removed %llu + final nodes %ld.\n",
+			nr_init + tot_add, tot_remove, count);
+		ret = 1;
+	}
+	free_all_cpu_call_rcu_data();
+	free(count_reader);
+	free(count_writer);
+	free(tid_reader);
+	free(tid_writer);
+	return ret;
+}
@@ -0,0 +1,743 @@
+/*
+ * test_urcu_soak.c
+ *
+ * Userspace RCU library - long-running soak benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Run a mixed workload for a long time, and sample its memory use once
+ * per interval: readers look up random keys of a resizable hash table,
+ * writers add random keys to it or remove them if present, freeing the
+ * removed nodes with call_rcu(), and queue threads enqueue nodes on a
+ * RCU lock-free queue and dequeue them, freeing them with defer_rcu().
+ * Each sample holds the resident set size, the call_rcu() queue length
+ * and defer_rcu() backlog from rcu_stats_snapshot(), the bucket and
+ * node counts of the table, and the throughput of each kind of thread
+ * over the interval. Samples are written as CSV rows to the -o file,
+ * or printed on SAMPLE lines.
+ *
+ * The workload is steady: once warmed up, none of the sampled values
+ * should keep growing. At the end, the samples after the first tenth of
+ * the run are split into four windows, and a value whose mean grows from
+ * each window to the next, by more than -g percent overall, is reported
+ * on a GROWTH line, in which case the program exits with status 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include "cpuset.h"
+#include "thread-id.h"
+#include "bench-report.h"
+
+#define _LGPL_SOURCE
+#include <urcu.h>
+#include <urcu/cds.h>
+
+#define NR_CPUS 16384
+
+#define DEFAULT_KEY_RANGE	65536UL
+#define DEFAULT_INTERVAL_S	1
+#define DEFAULT_GROWTH_PCT	10
+
+/* Samples of the first tenth of the run are discarded as warmup. */
+#define SOAK_WARMUP_DIV		10
+#define SOAK_NR_WINDOWS		4
+
+static volatile int test_go, test_stop;
+
+static unsigned long duration;
+static unsigned long key_range = DEFAULT_KEY_RANGE;
+static unsigned int interval_s = DEFAULT_INTERVAL_S;
+static unsigned int growth_pct = DEFAULT_GROWTH_PCT;
+static unsigned int nr_readers = 1, nr_writers = 1, nr_queuers = 1;
+static const char *output_path;
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+enum soak_kind {
+	SOAK_READER = 0,
+	SOAK_WRITER,
+	SOAK_QUEUER,
+	SOAK_NR_KINDS,
+};
+
+static const char *kind_names[] = {
+	[SOAK_READER] = "reader",
+	[SOAK_WRITER] = "writer",
+	[SOAK_QUEUER] = "queuer",
+};
+
+/* Operation count of a thread, read by the sampling thread. */
+struct soak_thread {
+	pthread_t tid;
+	enum soak_kind kind;
+	unsigned int seed;
+	unsigned long long ops;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct ht_node {
+	struct cds_lfht_node node;
+	unsigned long key;
+	struct rcu_head rcu;
+};
+
+struct queue_node {
+	struct cds_lfq_node_rcu list;
+};
+
+static struct cds_lfht *test_ht;
+static struct cds_lfq_queue_rcu test_q;
+
+static unsigned long hash_key(unsigned long key)
+{
+	unsigned long h = key * 2654435761UL;
+
+	return h ^ (h >> 15);
+}
+
+static int match_key(struct cds_lfht_node *node, const void *key)
+{
+	struct ht_node *n = caa_container_of(node, struct ht_node, node);
+
+	return n->key == *(const unsigned long *) key;
+}
+
+static void free_ht_node_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct ht_node, rcu));
+}
+
+static void soak_read(struct soak_thread *t)
+{
+	unsigned long key = rand_r(&t->seed) % key_range;
+	struct cds_lfht_iter iter;
+
+	rcu_read_lock();
+	cds_lfht_lookup(test_ht, hash_key(key), match_key, &key, &iter);
+	rcu_read_unlock();
+}
+
+static void soak_write(struct soak_thread *t)
+{
+	unsigned long key = rand_r(&t->seed) % key_range;
+	struct cds_lfht_node *ret;
+	struct cds_lfht_iter iter;
+	struct ht_node *n;
+
+	n = malloc(sizeof(*n));
+	if (!n) {
+		perror("malloc");
+		exit(-1);
+	}
+	cds_lfht_node_init(&n->node);
+	n->key = key;
+	rcu_read_lock();
+	ret = cds_lfht_add_unique(test_ht, hash_key(key), match_key, &key,
+			&n->node);
+	if (ret != &n->node) {
+		/* Present: remove it instead. */
+		free(n);
+		cds_lfht_lookup(test_ht, hash_key(key), match_key, &key,
+				&iter);
+		ret = cds_lfht_iter_get_node(&iter);
+		if (ret && !cds_lfht_del(test_ht, ret)) {
+			n = caa_container_of(ret, struct ht_node, node);
+			call_rcu(&n->rcu, free_ht_node_cb);
+		}
+	}
+	rcu_read_unlock();
+}
+
+static void soak_queue(void)
+{
+	struct cds_lfq_node_rcu *qnode;
+	struct queue_node *n;
+
+	n = malloc(sizeof(*n));
+	if (!n) {
+		perror("malloc");
+		exit(-1);
+	}
+	cds_lfq_node_init_rcu(&n->list);
+	rcu_read_lock();
+	cds_lfq_enqueue_rcu(&test_q, &n->list);
+	qnode = cds_lfq_dequeue_rcu(&test_q);
+	rcu_read_unlock();
+	if (qnode)
+		defer_rcu(free, caa_container_of(qnode, struct queue_node,
+				list));
+}
+
+static void *thr_soak(void *arg)
+{
+	struct soak_thread *t = arg;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			kind_names[t->kind], urcu_get_thread_id());
+
+	set_affinity();
+
+	rcu_register_thread();
+	if (t->kind == SOAK_QUEUER && rcu_defer_register_thread()) {
+		fprintf(stderr, "rcu_defer_register_thread failed\n");
+		exit(-1);
+	}
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop) {
+		switch (t->kind) {
+		case SOAK_READER:
+			soak_read(t);
+			break;
+		case SOAK_WRITER:
+			soak_write(t);
+			break;
+		case SOAK_QUEUER:
+			soak_queue();
+			break;
+		default:
+			break;
+		}
+		CMM_STORE_SHARED(t->ops, t->ops + 1);
+	}
+
+	if (t->kind == SOAK_QUEUER)
+		rcu_defer_unregister_thread();
+	rcu_unregister_thread();
+	printf_verbose("%s thread_end, tid %lu, ops %llu\n",
+			kind_names[t->kind], urcu_get_thread_id(), t->ops);
+	return NULL;
+}
+
+enum soak_series {
+	SERIES_RSS_KB = 0,
+	SERIES_CALL_RCU_QLEN,
+	SERIES_DEFER_PENDING,
+	SERIES_HT_BUCKETS,
+	SERIES_HT_NODES,
+	SERIES_HT_REMOVED,
+	NR_SERIES,
+};
+
+static const char *series_names[] = {
+	[SERIES_RSS_KB] = "rss_kb",
+	[SERIES_CALL_RCU_QLEN] = "call_rcu_qlen",
+	[SERIES_DEFER_PENDING] = "defer_pending",
+	[SERIES_HT_BUCKETS] = "ht_buckets",
+	[SERIES_HT_NODES] = "ht_nodes",
+	[SERIES_HT_REMOVED] = "ht_removed",
+};
+
+/* Growth below these absolute amounts is never reported. */
+static const double series_slack[] = {
+	[SERIES_RSS_KB] = 1024,
+	[SERIES_CALL_RCU_QLEN] = 1024,
+	[SERIES_DEFER_PENDING] = 1024,
+	[SERIES_HT_BUCKETS] = 1,
+	[SERIES_HT_NODES] = 1024,
+	[SERIES_HT_REMOVED] = 1024,
+};
+
+struct soak_sample {
+	unsigned long time_s;
+	uint64_t v[NR_SERIES];
+	double ops_per_s[SOAK_NR_KINDS];
+};
+
+static uint64_t read_rss_kb(void)
+{
+	unsigned long size, resident = 0;
+	FILE *f;
+
+	f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return (uint64_t) resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/*
+ * Sum of the call_rcu_data queue lengths and the defer_rcu() backlog,
+ * from the "<prefix>.call_rcu.<n>.qlen" and "<prefix>.defer.pending"
+ * keys of the statistics.
+ */
+static void read_rcu_stats(uint64_t *qlen, uint64_t *pending)
+{
+	static char *buf;
+	static size_t len;
+	size_t needed;
+	char *line, *key, *next;
+	uint64_t v;
+
+	*qlen = *pending = 0;
+	for (;;) {
+		needed = rcu_stats_snapshot(buf, len);
+		if (needed < len)
+			break;
+		len = needed + 4096;
+		buf = realloc(buf, len);
+		if (!buf) {
+			perror("realloc");
+			exit(-1);
+		}
+	}
+	for (line = buf; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		key = strchr(line, ' ');
+		if (!key)
+			continue;
+		*key = '\0';
+		v = strtoull(key + 1, NULL, 10);
+		if (strstr(line, ".call_rcu.") && strlen(line) > 5
+		    && !strcmp(line + strlen(line) - 5, ".qlen"))
+			*qlen += v;
+		else if (strstr(line, ".defer.pending"))
+			*pending += v;
+	}
+}
+
+static void take_sample(struct soak_sample *s, unsigned long time_s,
+		struct soak_thread *threads, unsigned int nr_threads,
+		unsigned long long *last_ops, double elapsed_s)
+{
+	struct cds_lfht_stats ht_stats;
+	unsigned long long ops;
+	unsigned int i;
+
+	memset(s, 0, sizeof(*s));
+	s->time_s = time_s;
+	s->v[SERIES_RSS_KB] = read_rss_kb();
+	read_rcu_stats(&s->v[SERIES_CALL_RCU_QLEN],
+			&s->v[SERIES_DEFER_PENDING]);
+	rcu_read_lock();
+	cds_lfht_get_stats(test_ht, &ht_stats);
+	rcu_read_unlock();
+	s->v[SERIES_HT_BUCKETS] = ht_stats.size;
+	s->v[SERIES_HT_NODES] = ht_stats.nr_nodes;
+	s->v[SERIES_HT_REMOVED] = ht_stats.nr_removed;
+	for (i = 0; i < nr_threads; i++) {
+		ops = CMM_LOAD_SHARED(threads[i].ops);
+		if (elapsed_s > 0)
+			s->ops_per_s[threads[i].kind] +=
+				(ops - last_ops[i]) / elapsed_s;
+		last_ops[i] = ops;
+	}
+}
+
+static void print_sample(FILE *f, const char *prefix,
+		const struct soak_sample *s)
+{
+	unsigned int i;
+
+	fprintf(f, "%s%lu", prefix, s->time_s);
+	for (i = 0; i < NR_SERIES; i++)
+		fprintf(f, ",%" PRIu64, s->v[i]);
+	for (i = 0; i < SOAK_NR_KINDS; i++)
+		fprintf(f, ",%.0f", s->ops_per_s[i]);
+	fprintf(f, "\n");
+}
+
+static void print_header(FILE *f, const char *prefix)
+{
+	unsigned int i;
+
+	fprintf(f, "%stime_s", prefix);
+	for (i = 0; i < NR_SERIES; i++)
+		fprintf(f, ",%s", series_names[i]);
+	for (i = 0; i < SOAK_NR_KINDS; i++)
+		fprintf(f, ",%s_ops_per_s", kind_names[i]);
+	fprintf(f, "\n");
+}
+
+/*
+ * Whether @series grows from each window of the samples after warmup
+ * to the next, by more than growth_pct percent and its slack overall.
+ * Returns -1 if there are not enough samples.
+ */
+static int series_growing(const struct soak_sample *samples,
+		unsigned long nr, enum soak_series series,
+		double *first_mean, double *last_mean)
+{
+	double mean[SOAK_NR_WINDOWS];
+	unsigned long start = nr / SOAK_WARMUP_DIV, per_window, i;
+	unsigned int w;
+	int growing = 1;
+
+	if (!start)
+		start = 1;
+	if (nr < start + 2 * SOAK_NR_WINDOWS)
+		return -1;
+	per_window = (nr - start) / SOAK_NR_WINDOWS;
+	for (w = 0; w < SOAK_NR_WINDOWS; w++) {
+		double sum = 0;
+
+		for (i = 0; i < per_window; i++)
+			sum += samples[start + w * per_window + i].v[series];
+		mean[w] = sum / per_window;
+		if (w && mean[w] <= mean[w - 1])
+			growing = 0;
+	}
+	*first_mean = mean[0];
+	*last_mean = mean[SOAK_NR_WINDOWS - 1];
+	if (*last_mean - *first_mean <= series_slack[series]
+	    || *last_mean <= *first_mean * (1.0 + growth_pct / 100.0))
+		growing = 0;
+	return growing;
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s duration (s) <OPTIONS>\n", argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-r readers] (hash table lookup threads, default: 1)\n");
+	printf("	[-w writers] (hash table add/remove threads, default: 1)\n");
+	printf("	[-q queuers] (queue enqueue/dequeue threads, default: 1)\n");
+	printf("	[-k range] (key range, default: %lu)\n",
+		DEFAULT_KEY_RANGE);
+	printf("	[-i seconds] (sampling interval, default: %d)\n",
+		DEFAULT_INTERVAL_S);
+	printf("	[-o file] (write the samples as CSV to file)\n");
+	printf("	[-g percent] (growth reported, default: %d)\n",
+		DEFAULT_GROWTH_PCT);
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report report;
+	struct soak_thread *threads;
+	struct soak_sample *samples = NULL;
+	unsigned long nr_samples = 0, alloc_samples = 0, time_s = 0;
+	unsigned long long *last_ops, tot_ops[SOAK_NR_KINDS] = { 0 };
+	unsigned int nr_threads;
+	FILE *out = NULL;
+	uint64_t start_ns, last_ns, now_ns;
+	struct timespec ts;
+	int err, a, i, nr_growing = 0, ret;
+
+	argc = bench_report_parse_args(argc, argv);
+	if (argc < 2) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 2; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'r':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_readers = atoi(argv[++i]);
+			break;
+		case 'w':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_writers = atoi(argv[++i]);
+			break;
+		case 'q':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_queuers = atoi(argv[++i]);
+			break;
+		case 'k':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			key_range = strtoul(argv[++i], NULL, 10);
+			break;
+		case 'i':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			interval_s = atoi(argv[++i]);
+			break;
+		case 'o':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			output_path = argv[++i];
+			break;
+		case 'g':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			growth_pct = atoi(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+	if (!key_range || !interval_s) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	printf_verbose("running soak test for %lu seconds, %u readers, "
+		       "%u writers, %u queuers.\n",
+		       duration, nr_readers, nr_writers, nr_queuers);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	if (output_path) {
+		out = fopen(output_path, "w");
+		if (!out) {
+			perror("fopen");
+			return -1;
+		}
+		print_header(out, "");
+		fflush(out);
+	} else if (bench_report_text()) {
+		print_header(stdout, "SAMPLE ");
+	}
+
+	nr_threads = nr_readers + nr_writers + nr_queuers;
+	threads = calloc(nr_threads, sizeof(*threads));
+	last_ops = calloc(nr_threads, sizeof(*last_ops));
+	if (!threads || !last_ops) {
+		perror("calloc");
+		return -1;
+	}
+
+	rcu_register_thread();
+	test_ht = cds_lfht_new(1, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!test_ht) {
+		fprintf(stderr, "cds_lfht_new failed\n");
+		return -1;
+	}
+	cds_lfq_init_rcu(&test_q, call_rcu);
+
+	next_aff = 0;
+	for (i = 0; i < nr_threads; i++) {
+		if (i < nr_readers)
+			threads[i].kind = SOAK_READER;
+		else if (i < nr_readers + nr_writers)
+			threads[i].kind = SOAK_WRITER;
+		else
+			threads[i].kind = SOAK_QUEUER;
+		threads[i].seed = (unsigned int) time(NULL) + i;
+		err = pthread_create(&threads[i].tid, NULL, thr_soak,
+				     &threads[i]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	test_go = 1;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	start_ns = last_ns = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	rcu_thread_offline();
+	while (time_s < duration) {
+		struct soak_sample *s;
+
+		time_s += interval_s;
+		for (;;) {
+			(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+			now_ns = (uint64_t) ts.tv_sec * 1000000000ULL
+				+ ts.tv_nsec;
+			if (now_ns >= start_ns + time_s * 1000000000ULL)
+				break;
+			(void) poll(NULL, 0, (start_ns + time_s * 1000000000ULL
+					- now_ns) / 1000000 + 1);
+		}
+		if (nr_samples == alloc_samples) {
+			alloc_samples = alloc_samples ? 2 * alloc_samples : 1024;
+			samples = realloc(samples,
+					alloc_samples * sizeof(*samples));
+			if (!samples) {
+				perror("realloc");
+				return -1;
+			}
+		}
+		s = &samples[nr_samples++];
+		rcu_thread_online();
+		take_sample(s, time_s, threads, nr_threads, last_ops,
+				(now_ns - last_ns) / 1e9);
+		rcu_thread_offline();
+		last_ns = now_ns;
+		if (out) {
+			print_sample(out, "", s);
+			fflush(out);
+		} else if (bench_report_text()) {
+			print_sample(stdout, "SAMPLE ", s);
+			fflush(stdout);
+		}
+	}
+	rcu_thread_online();
+
+	test_stop = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		err = pthread_join(threads[i].tid, NULL);
+		if (err != 0)
+			exit(1);
+		tot_ops[threads[i].kind] += threads[i].ops;
+	}
+
+	for (i = 0; i < NR_SERIES; i++) {
+		double first, last;
+
+		ret = series_growing(samples, nr_samples, i, &first, &last);
+		if (ret < 0) {
+			if (bench_report_text())
+				printf("Not enough samples to detect growth: %lu\n",
+					nr_samples);
+			break;
+		}
+		if (ret) {
+			if (bench_report_text())
+				printf("GROWTH %s from %.0f to %.0f\n",
+					series_names[i], first, last);
+			nr_growing++;
+		}
+	}
+
+	if (bench_report_text()) {
+		printf("SUMMARY %-25s testdur %4lu nr_readers %3u "
+			"nr_writers %3u nr_queuers %3u samples %6lu "
+			"lookups %12llu updates %12llu queue_ops %12llu "
+			"growing %d\n",
+			argv[0], duration, nr_readers, nr_writers,
+			nr_queuers, nr_samples, tot_ops[SOAK_READER],
+			tot_ops[SOAK_WRITER], tot_ops[SOAK_QUEUER],
+			nr_growing);
+	}
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "readers", nr_readers);
+	bench_report_config(&report, "writers", nr_writers);
+	bench_report_config(&report, "queuers", nr_queuers);
+	bench_report_config(&report, "key_range", key_range);
+	bench_report_config(&report, "interval_s", interval_s);
+	for (i = 0; i < nr_threads; i++)
+		bench_report_thread(&report, kind_names[threads[i].kind],
+				threads[i].ops);
+	bench_report_result(&report, "samples", nr_samples);
+	bench_report_result(&report, "growing", nr_growing);
+	if (nr_samples) {
+		for (i = 0; i < NR_SERIES; i++)
+			bench_report_result(&report, series_names[i],
+				samples[nr_samples - 1].v[i]);
+	}
+	bench_report_print(&report);
+
+	if (out)
+		fclose(out);
+	rcu_thread_offline();
+	rcu_barrier();
+	rcu_thread_online();
+	free(samples);
+	free(last_ops);
+	free(threads);
+	rcu_unregister_thread();
+	return nr_growing ? 1 : 0;
+}
@@ -39,6 +39,10 @@
 #include <urcu/uatomic.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-report.h"
+#include "bench-latency.h"
+#include "bench-placement.h"
+#include "bench-perf.h"
 
 /* hardcoded number of CPUs */
 #define NR_CPUS 16384
@@ -86,30 +90,36 @@ static int test_enqueue_stopped;
 static unsigned int cpu_affinities[NR_CPUS];
 static unsigned int next_aff = 0;
 static int use_affinity = 0;
+static struct bench_placement placement;
+static struct bench_perf *perf_totals;
 
 pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void set_affinity(void)
+static void set_affinity(enum bench_role role)
 {
 #if HAVE_SCHED_SETAFFINITY
 	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
-	if (!use_affinity)
+	if (!use_affinity && !bench_placement_enabled(&placement))
 		return;
 
 #if HAVE_SCHED_SETAFFINITY
-	ret = pthread_mutex_lock(&affinity_mutex);
-	if (ret) {
-		perror("Error in pthread mutex lock");
-		exit(-1);
-	}
-	cpu = cpu_affinities[next_aff++];
-	ret = pthread_mutex_unlock(&affinity_mutex);
-	if (ret) {
-		perror("Error in pthread mutex unlock");
-		exit(-1);
+	if (bench_placement_enabled(&placement)) {
+		cpu = bench_placement_next_cpu(&placement, role);
+	} else {
+		ret = pthread_mutex_lock(&affinity_mutex);
+		if (ret) {
+			perror("Error in pthread mutex lock");
+			exit(-1);
+		}
+		cpu = cpu_affinities[next_aff++];
+		ret = pthread_mutex_unlock(&affinity_mutex);
+		if (ret) {
+			perror("Error in pthread mutex unlock");
+			exit(-1);
+		}
 	}
 
 	CPU_ZERO(&mask);
@@ -147,6 +157,8 @@ static DEFINE_URCU_TLS(unsigned long long, nr_dequeue_last);
 static unsigned int nr_enqueuers;
 static unsigned int nr_dequeuers;
 
+static struct bench_latency *dequeue_lat;	/* NULL: no --latency */
+
 static struct cds_wfcq_head __attribute__((aligned(CAA_CACHE_LINE_SIZE))) head;
 static struct cds_wfcq_tail __attribute__((aligned(CAA_CACHE_LINE_SIZE))) tail;
 
@@ -154,16 +166,19 @@ static void *thr_enqueuer(void *_count)
 {
 	unsigned long long *count = _count;
 	bool was_nonempty;
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"enqueuer", urcu_get_thread_id());
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_WRITER);
 
 	while (!test_go)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
 
 	for (;;) {
 		struct cds_wfcq_node *node = malloc(sizeof(*node));
@@ -183,6 +198,7 @@ fail:
 			break;
 	}
 
+	bench_perf_thread_free(perf_thread);
 	uatomic_inc(&test_enqueue_stopped);
 	count[0] = URCU_TLS(nr_enqueues);
 	count[1] = URCU_TLS(nr_successful_enqueues);
@@ -198,17 +214,20 @@ fail:
 
 }
 
-static void do_test_dequeue(enum test_sync sync)
+static void do_test_dequeue(enum test_sync sync, struct bench_latency *hist)
 {
 	struct cds_wfcq_node *node;
+	caa_cycles_t begin;
 	int state;
 
+	begin = bench_latency_begin(hist);
 	if (sync == TEST_SYNC_MUTEX)
 		node = cds_wfcq_dequeue_with_state_blocking(&head, &tail,
 				&state);
 	else
 		node = __cds_wfcq_dequeue_with_state_blocking(&head, &tail,
 				&state);
+	bench_latency_end(hist, begin);
 
 	if (state & CDS_WFCQ_STATE_LAST)
 		URCU_TLS(nr_dequeue_last)++;
@@ -265,27 +284,31 @@ static void *thr_dequeuer(void *_count)
 {
 	unsigned long long *count = _count;
 	unsigned int counter = 0;
+	struct bench_latency *hist = bench_latency_thread_alloc(dequeue_lat);
+	struct bench_perf_thread *perf_thread =
+		bench_perf_thread_alloc(perf_totals);
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"dequeuer", urcu_get_thread_id());
 
-	set_affinity();
+	set_affinity(BENCH_ROLE_READER);
 
 	while (!test_go)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_thread_start(perf_thread);
 
 	for (;;) {
 		if (test_dequeue && test_splice) {
 			if (counter & 1)
-				do_test_dequeue(test_sync);
+				do_test_dequeue(test_sync, hist);
 			else
 				do_test_splice(test_sync);
 			counter++;
 		} else {
 			if (test_dequeue)
-				do_test_dequeue(test_sync);
+				do_test_dequeue(test_sync, hist);
 			else
 				do_test_splice(test_sync);
 		}
@@ -294,6 +317,7 @@ static void *thr_dequeuer(void *_count)
 		if (caa_unlikely(rduration))
 			loop_sleep(rduration);
 	}
+	bench_perf_thread_free(perf_thread);
 
 	printf_verbose("dequeuer thread_end, tid %lu, "
 			"dequeues %llu, successful_dequeues %llu, "
@@ -305,6 +329,8 @@ static void *thr_dequeuer(void *_count)
 	count[1] = URCU_TLS(nr_successful_dequeues);
 	count[2] = URCU_TLS(nr_splice);
 	count[3] = URCU_TLS(nr_dequeue_last);
+	bench_latency_merge(dequeue_lat, hist);
+	bench_latency_free(hist);
 	return ((void*)2);
 }
 
@@ -335,6 +361,8 @@ static void show_usage(int argc, char **argv)
 	printf("	[-c duration] (dequeuer period (in loops))\n");
 	printf("	[-v] (verbose output)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--placement=compact|scatter|core|split] (topology-aware affinity)\n");
+	printf("	[--perf[=0xCONFIG]] (hardware counters, and raw event CONFIG)\n");
 	printf("	[-q] (test dequeue)\n");
 	printf("	[-s] (test splice, enabled by default)\n");
 	printf("	[-M] (use mutex external synchronization)\n");
@@ -346,6 +374,7 @@ static void show_usage(int argc, char **argv)
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
@@ -358,6 +387,11 @@ int main(int argc, char **argv)
 	unsigned long long end_dequeues = 0;
 	int i, a, retval = 0;
 
+	argc = bench_report_parse_args(argc, argv);
+	argc = bench_latency_parse_args(argc, argv);
+	argc = bench_placement_parse_args(&placement, argc, argv);
+	argc = bench_perf_parse_args(argc, argv);
+	perf_totals = bench_perf_alloc();
 	if (argc < 4) {
 		show_usage(argc, argv);
 		return -1;
@@ -468,6 +502,8 @@ int main(int argc, char **argv)
 	count_enqueuer = calloc(nr_enqueuers, 3 * sizeof(*count_enqueuer));
 	count_dequeuer = calloc(nr_dequeuers, 4 * sizeof(*count_dequeuer));
 	cds_wfcq_init(&head, &tail);
+	if (test_dequeue)
+		dequeue_lat = bench_latency_alloc("cds_wfcq_dequeue");
 
 	next_aff = 0;
 
@@ -539,20 +575,54 @@ int main(int argc, char **argv)
 		       tot_empty_dest_enqueues,
 		       tot_successful_dequeues,
 		       tot_splice, tot_dequeue_last);
-	printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
-		"nr_dequeuers %3u "
-		"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
-		"successful enqueues %12llu enqueues to empty dest %12llu "
-		"successful dequeues %12llu splice %12llu "
-		"dequeue_last %llu "
-		"end_dequeues %llu nr_ops %12llu\n",
-		argv[0], duration, nr_enqueuers, wdelay,
-		nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
-		tot_successful_enqueues,
-		tot_empty_dest_enqueues,
-		tot_successful_dequeues, tot_splice, tot_dequeue_last,
-		end_dequeues,
-		tot_enqueues + tot_dequeues);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
+			"nr_dequeuers %3u "
+			"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
+			"successful enqueues %12llu enqueues to empty dest %12llu "
+			"successful dequeues %12llu splice %12llu "
+			"dequeue_last %llu "
+			"end_dequeues %llu nr_ops %12llu\n",
+			argv[0], duration, nr_enqueuers, wdelay,
+			nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
+			tot_successful_enqueues,
+			tot_empty_dest_enqueues,
+			tot_successful_dequeues, tot_splice, tot_dequeue_last,
+			end_dequeues,
+			tot_enqueues + tot_dequeues);
+	if (bench_report_text()) {
+		bench_latency_print(dequeue_lat);
+		bench_placement_print(&placement, "dequeuer", "enqueuer");
+		bench_perf_print(perf_totals, tot_enqueues + tot_dequeues);
+	}
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_enqueuers", nr_enqueuers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "nr_dequeuers", nr_dequeuers);
+	bench_report_config(&report, "rdur", rduration);
+	bench_report_config(&report, "placement", placement.policy);
+	for (i = 0; i < nr_enqueuers; i++)
+		bench_report_thread(&report, "enqueuer", count_enqueuer[3 * i]);
+	for (i = 0; i < nr_dequeuers; i++)
+		bench_report_thread(&report, "dequeuer", count_dequeuer[4 * i]);
+	bench_report_result(&report, "enqueues", tot_enqueues);
+	bench_report_result(&report, "dequeues", tot_dequeues);
+	bench_report_result(&report, "successful_enqueues",
+		tot_successful_enqueues);
+	bench_report_result(&report, "successful_dequeues",
+		tot_successful_dequeues);
+	bench_report_result(&report, "empty_dest_enqueues",
+		tot_empty_dest_enqueues);
+	bench_report_result(&report, "splice", tot_splice);
+	bench_report_result(&report, "dequeue_last", tot_dequeue_last);
+	bench_report_result(&report, "end_dequeues", end_dequeues);
+	bench_report_result(&report, "nr_ops", tot_enqueues + tot_dequeues);
+	bench_latency_report(&report, dequeue_lat);
+	bench_perf_report(&report, perf_totals);
+	bench_report_print(&report);
+	bench_latency_free(dequeue_lat);
+	bench_perf_free(perf_totals);
+	bench_placement_destroy(&placement);
 
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues) {
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
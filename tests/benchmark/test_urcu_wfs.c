@@ -39,6 +39,7 @@
 #include <urcu/uatomic.h>
 #include "cpuset.h"
 #include "thread-id.h"
+#include "bench-report.h"
 
 /* hardcoded number of CPUs */
 #define NR_CPUS 16384
@@ -77,7 +78,7 @@ static inline void loop_sleep(unsigned long loops)
 
 static int verbose_mode;
 
-static int test_pop, test_pop_all, test_wait_empty;
+static int test_pop, test_pop_all, test_pop_batch, test_wait_empty;
 static int test_enqueue_stopped;
 
 #define printf_verbose(fmt, args...)		\
@@ -200,14 +201,18 @@ fail:
 
 }
 
-static void do_test_pop(enum test_sync sync)
+static void do_test_pop(enum test_sync sync, struct cds_wfs_batch *batch)
 {
 	struct cds_wfs_node *node;
 	int state;
 
 	if (sync == TEST_SYNC_MUTEX)
 		cds_wfs_pop_lock(&s);
-	node = __cds_wfs_pop_with_state_blocking(&s, &state);
+	if (batch)
+		node = __cds_wfs_pop_batch_with_state_blocking(&s, batch,
+				&state);
+	else
+		node = __cds_wfs_pop_with_state_blocking(&s, &state);
 	if (sync == TEST_SYNC_MUTEX)
 		cds_wfs_pop_unlock(&s);
 
@@ -249,6 +254,7 @@ static void *thr_dequeuer(void *_count)
 {
 	unsigned long long *count = _count;
 	unsigned int counter = 0;
+	struct cds_wfs_batch batch, *pop_batch = NULL;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"dequeuer", urcu_get_thread_id());
@@ -262,16 +268,21 @@ static void *thr_dequeuer(void *_count)
 
 	assert(test_pop || test_pop_all);
 
+	if (test_pop_batch) {
+		cds_wfs_batch_init(&batch);
+		pop_batch = &batch;
+	}
+
 	for (;;) {
 		if (test_pop && test_pop_all) {
 			if (counter & 1)
-				do_test_pop(test_sync);
+				do_test_pop(test_sync, pop_batch);
 			else
 				do_test_pop_all(test_sync);
 			counter++;
 		} else {
 			if (test_pop)
-				do_test_pop(test_sync);
+				do_test_pop(test_sync, pop_batch);
 			else
 				do_test_pop_all(test_sync);
 		}
@@ -282,6 +293,10 @@ static void *thr_dequeuer(void *_count)
 			loop_sleep(rduration);
 	}
 
+	/* The nodes left in the batch are not on the stack anymore. */
+	while (pop_batch && pop_batch->next)
+		do_test_pop(test_sync, pop_batch);
+
 	printf_verbose("dequeuer thread_end, tid %lu, "
 			"dequeues %llu, successful_dequeues %llu "
 			"pop_all %llu pop_last %llu\n",
@@ -324,6 +339,7 @@ static void show_usage(int argc, char **argv)
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
 	printf("	[-p] (test pop)\n");
 	printf("	[-P] (test pop_all, enabled by default)\n");
+	printf("	[-b] (test pop with single-consumer pop batch, implies -p)\n");
 	printf("	[-M] (use mutex external synchronization)\n");
 	printf("		Note: default: no external synchronization used.\n");
 	printf("	[-f] (force user-provided synchronization)\n");
@@ -333,6 +349,7 @@ static void show_usage(int argc, char **argv)
 
 int main(int argc, char **argv)
 {
+	struct bench_report report;
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
@@ -345,6 +362,7 @@ int main(int argc, char **argv)
 	unsigned long long end_dequeues = 0;
 	int i, a, retval = 0;
 
+	argc = bench_report_parse_args(argc, argv);
 	if (argc < 4) {
 		show_usage(argc, argv);
 		return -1;
@@ -405,6 +423,10 @@ int main(int argc, char **argv)
 		case 'P':
 			test_pop_all = 1;
 			break;
+		case 'b':
+			test_pop = 1;
+			test_pop_batch = 1;
+			break;
 		case 'M':
 			test_sync = TEST_SYNC_MUTEX;
 			break;
@@ -421,7 +443,9 @@ int main(int argc, char **argv)
 	if (!test_pop && !test_pop_all)
 		test_pop_all = 1;
 
-	if (test_sync == TEST_SYNC_NONE && nr_dequeuers > 1 && test_pop) {
+	/* Batch pops only synchronize like pop_all. */
+	if (test_sync == TEST_SYNC_NONE && nr_dequeuers > 1 && test_pop
+			&& !test_pop_batch) {
 		if (test_force_sync) {
 			fprintf(stderr, "[WARNING] Using pop concurrently "
 				"with other pop or pop_all without external "
@@ -437,6 +461,8 @@ int main(int argc, char **argv)
 		       duration, nr_enqueuers, nr_dequeuers);
 	if (test_pop)
 		printf_verbose("pop test activated.\n");
+	if (test_pop_batch)
+		printf_verbose("pop batch test activated.\n");
 	if (test_pop_all)
 		printf_verbose("pop_all test activated.\n");
 	if (test_sync == TEST_SYNC_MUTEX)
@@ -526,19 +552,42 @@ int main(int argc, char **argv)
 		       tot_empty_dest_enqueues,
 		       tot_successful_dequeues,
 		       tot_pop_all, tot_pop_last);
-	printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
-		"nr_dequeuers %3u "
-		"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
-		"successful enqueues %12llu enqueues to empty dest %12llu "
-		"successful dequeues %12llu pop_all %12llu "
-		"pop_last %llu end_dequeues %llu nr_ops %12llu\n",
-		argv[0], duration, nr_enqueuers, wdelay,
-		nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
-		tot_successful_enqueues,
-		tot_empty_dest_enqueues,
-		tot_successful_dequeues, tot_pop_all, tot_pop_last,
-		end_dequeues,
-		tot_enqueues + tot_dequeues);
+	if (bench_report_text())
+		printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
+			"nr_dequeuers %3u "
+			"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
+			"successful enqueues %12llu enqueues to empty dest %12llu "
+			"successful dequeues %12llu pop_all %12llu "
+			"pop_last %llu end_dequeues %llu nr_ops %12llu\n",
+			argv[0], duration, nr_enqueuers, wdelay,
+			nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
+			tot_successful_enqueues,
+			tot_empty_dest_enqueues,
+			tot_successful_dequeues, tot_pop_all, tot_pop_last,
+			end_dequeues,
+			tot_enqueues + tot_dequeues);
+	bench_report_init(&report, argv[0], duration);
+	bench_report_config(&report, "nr_enqueuers", nr_enqueuers);
+	bench_report_config(&report, "wdelay", wdelay);
+	bench_report_config(&report, "nr_dequeuers", nr_dequeuers);
+	bench_report_config(&report, "rdur", rduration);
+	for (i = 0; i < nr_enqueuers; i++)
+		bench_report_thread(&report, "enqueuer", count_enqueuer[3 * i]);
+	for (i = 0; i < nr_dequeuers; i++)
+		bench_report_thread(&report, "dequeuer", count_dequeuer[4 * i]);
+	bench_report_result(&report, "enqueues", tot_enqueues);
+	bench_report_result(&report, "dequeues", tot_dequeues);
+	bench_report_result(&report, "successful_enqueues",
+		tot_successful_enqueues);
+	bench_report_result(&report, "successful_dequeues",
+		tot_successful_dequeues);
+	bench_report_result(&report, "empty_dest_enqueues",
+		tot_empty_dest_enqueues);
+	bench_report_result(&report, "pop_all", tot_pop_all);
+	bench_report_result(&report, "pop_last", tot_pop_last);
+	bench_report_result(&report, "end_dequeues", end_dequeues);
+	bench_report_result(&report, "nr_ops", tot_enqueues + tot_dequeues);
+	bench_report_print(&report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues) {
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
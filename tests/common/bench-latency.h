@@ -0,0 +1,324 @@
+#ifndef _TEST_BENCH_LATENCY_H
+#define _TEST_BENCH_LATENCY_H
+
+/*
+ * bench-latency.h
+ *
+ * Userspace RCU library - per-operation latency histograms
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmarks given --latency, or --latency=period, time one of every
+ * period operations (all of them by default) of the kinds they
+ * instrument with caa_get_cycles(). The benchmark allocates a shared
+ * histogram per kind of operation after parsing its arguments. Each
+ * thread records its samples in its own histogram, allocated from the
+ * shared one and merged into it at thread exit, and the benchmark
+ * prints the percentiles of the merged histograms, or adds them to its
+ * bench_report results.
+ *
+ * Histograms are log-linear, as HDR histograms: values below
+ * BENCH_LATENCY_SUB are counted exactly, and each power of two above
+ * is split in BENCH_LATENCY_SUB buckets, for a relative error below
+ * 1 / BENCH_LATENCY_SUB.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+
+#include "bench-report.h"
+
+#define BENCH_LATENCY_SUB_BITS		5
+#define BENCH_LATENCY_SUB		(1U << BENCH_LATENCY_SUB_BITS)
+#define BENCH_LATENCY_NR_BUCKETS	\
+	((64 - BENCH_LATENCY_SUB_BITS + 1) * BENCH_LATENCY_SUB)
+
+/* Percentiles printed and reported, in 1/1000. */
+static const unsigned int bench_latency_pct[] = { 500, 900, 990, 999 };
+
+#define BENCH_LATENCY_NR_KEYS	(CAA_ARRAY_SIZE(bench_latency_pct) + 2)
+
+static unsigned long bench_latency_period;	/* 0: disabled */
+static double bench_latency_ns_per_cycle = 1.0;
+
+struct bench_latency {
+	const char *name;
+	unsigned long period, countdown;
+	unsigned long long nr, min, max;
+	unsigned long long buckets[BENCH_LATENCY_NR_BUCKETS];
+	pthread_mutex_t lock;		/* Merges into this histogram */
+	char keys[BENCH_LATENCY_NR_KEYS][64];	/* bench_report keys */
+};
+
+static inline unsigned long long bench_latency_time_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Measure the caa_get_cycles() frequency over 10ms. */
+static inline void bench_latency_calibrate(void)
+{
+	unsigned long long t0, t1;
+	caa_cycles_t c0, c1;
+
+	t0 = bench_latency_time_ns();
+	c0 = caa_get_cycles();
+	do {
+		t1 = bench_latency_time_ns();
+	} while (t1 - t0 < 10000000ULL);
+	c1 = caa_get_cycles();
+	if (c1 > c0)
+		bench_latency_ns_per_cycle = (double) (t1 - t0) / (c1 - c0);
+}
+
+/*
+ * Remove the --latency[=period] option from the arguments, before they
+ * are parsed by the benchmark. Returns the new argument count.
+ */
+static inline int bench_latency_parse_args(int argc, char **argv)
+{
+	int i, j;
+
+	for (i = 1, j = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--latency")) {
+			bench_latency_period = 1;
+		} else if (!strncmp(argv[i], "--latency=",
+				strlen("--latency="))) {
+			bench_latency_period = strtoul(argv[i]
+					+ strlen("--latency="), NULL, 10);
+			if (!bench_latency_period) {
+				fprintf(stderr, "Invalid latency sampling period: %s\n",
+					argv[i]);
+				exit(-1);
+			}
+		} else {
+			argv[j++] = argv[i];
+		}
+	}
+	argv[j] = NULL;
+	if (bench_latency_period)
+		bench_latency_calibrate();
+	return j;
+}
+
+static inline int bench_latency_enabled(void)
+{
+	return bench_latency_period != 0;
+}
+
+static inline struct bench_latency *__bench_latency_alloc(const char *name,
+		unsigned long period)
+{
+	struct bench_latency *lat;
+
+	lat = calloc(1, sizeof(*lat));
+	if (!lat) {
+		perror("calloc");
+		exit(-1);
+	}
+	lat->name = name;
+	lat->period = lat->countdown = period;
+	lat->min = -1ULL;
+	pthread_mutex_init(&lat->lock, NULL);
+	return lat;
+}
+
+/*
+ * Allocate the shared histogram of operations of kind @name, or return
+ * NULL if latencies are not recorded.
+ */
+static inline struct bench_latency *bench_latency_alloc(const char *name)
+{
+	if (!bench_latency_period)
+		return NULL;
+	return __bench_latency_alloc(name, bench_latency_period);
+}
+
+/*
+ * Allocate a per-thread histogram, to merge into @shared, or return
+ * NULL if @shared is NULL.
+ */
+static inline struct bench_latency *bench_latency_thread_alloc(
+		const struct bench_latency *shared)
+{
+	if (!shared)
+		return NULL;
+	return __bench_latency_alloc(shared->name, shared->period);
+}
+
+static inline void bench_latency_free(struct bench_latency *lat)
+{
+	if (!lat)
+		return;
+	pthread_mutex_destroy(&lat->lock);
+	free(lat);
+}
+
+static inline unsigned int bench_latency_bucket(uint64_t v)
+{
+	unsigned int shift;
+
+	if (v < BENCH_LATENCY_SUB)
+		return v;
+	shift = 63 - __builtin_clzll(v) - BENCH_LATENCY_SUB_BITS;
+	return (shift + 1) * BENCH_LATENCY_SUB
+		+ (unsigned int) (v >> shift) - BENCH_LATENCY_SUB;
+}
+
+/* Highest value counted in bucket @i. */
+static inline uint64_t bench_latency_bucket_max(unsigned int i)
+{
+	unsigned int shift;
+
+	if (i < BENCH_LATENCY_SUB)
+		return i;
+	shift = i / BENCH_LATENCY_SUB - 1;
+	return (((uint64_t) BENCH_LATENCY_SUB + i % BENCH_LATENCY_SUB + 1)
+		<< shift) - 1;
+}
+
+/*
+ * Start timing an operation. Returns 0 if the operation is not
+ * sampled.
+ */
+static inline caa_cycles_t bench_latency_begin(struct bench_latency *lat)
+{
+	if (caa_likely(!lat) || --lat->countdown)
+		return 0;
+	lat->countdown = lat->period;
+	return caa_get_cycles();
+}
+
+static inline void bench_latency_end(struct bench_latency *lat,
+		caa_cycles_t begin)
+{
+	uint64_t v;
+
+	if (caa_likely(!begin))
+		return;
+	v = caa_get_cycles() - begin;
+	lat->buckets[bench_latency_bucket(v)]++;
+	lat->nr++;
+	if (v < lat->min)
+		lat->min = v;
+	if (v > lat->max)
+		lat->max = v;
+}
+
+/*
+ * Add the samples of the per-thread histogram @src to @dst. May be
+ * called concurrently for a same @dst.
+ */
+static inline void bench_latency_merge(struct bench_latency *dst,
+		const struct bench_latency *src)
+{
+	unsigned int i;
+
+	if (!dst || !src)
+		return;
+	pthread_mutex_lock(&dst->lock);
+	for (i = 0; i < BENCH_LATENCY_NR_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->nr += src->nr;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	pthread_mutex_unlock(&dst->lock);
+}
+
+/* Value at percentile @pct (in 1/1000), in ns. */
+static inline unsigned long long bench_latency_pct_ns(
+		const struct bench_latency *lat, unsigned int pct)
+{
+	unsigned long long target, seen = 0;
+	uint64_t v = lat->max;
+	unsigned int i;
+
+	if (!lat->nr)
+		return 0;
+	target = (lat->nr * pct + 999) / 1000;
+	for (i = 0; i < BENCH_LATENCY_NR_BUCKETS; i++) {
+		seen += lat->buckets[i];
+		if (seen >= target) {
+			v = bench_latency_bucket_max(i);
+			break;
+		}
+	}
+	if (v > lat->max)
+		v = lat->max;
+	return v * bench_latency_ns_per_cycle;
+}
+
+/* Print one "LATENCY" line with the percentiles of @lat. */
+static inline void bench_latency_print(const struct bench_latency *lat)
+{
+	unsigned int i;
+
+	if (!lat)
+		return;
+	printf("LATENCY %-20s nr_samples %12llu min_ns %10llu",
+		lat->name, lat->nr,
+		lat->nr ? (unsigned long long)
+			(lat->min * bench_latency_ns_per_cycle) : 0ULL);
+	for (i = 0; i < CAA_ARRAY_SIZE(bench_latency_pct); i++)
+		printf(" p%u_ns %10llu",
+			bench_latency_pct[i] % 10 ? bench_latency_pct[i]
+				: bench_latency_pct[i] / 10,
+			bench_latency_pct_ns(lat, bench_latency_pct[i]));
+	printf(" max_ns %10llu\n",
+		(unsigned long long) (lat->max * bench_latency_ns_per_cycle));
+}
+
+/*
+ * Add the percentiles of @lat to the results of @r, as
+ * "<name>_p99_ns" and so on. @lat must outlive the printing of @r.
+ */
+static inline void bench_latency_report(struct bench_report *r,
+		struct bench_latency *lat)
+{
+	unsigned int i, k = 0;
+
+	if (!lat)
+		return;
+	snprintf(lat->keys[k], sizeof(lat->keys[k]), "%s_samples",
+		lat->name);
+	bench_report_result(r, lat->keys[k++], lat->nr);
+	for (i = 0; i < CAA_ARRAY_SIZE(bench_latency_pct); i++) {
+		snprintf(lat->keys[k], sizeof(lat->keys[k]), "%s_p%u_ns",
+			lat->name, bench_latency_pct[i] % 10
+				? bench_latency_pct[i]
+				: bench_latency_pct[i] / 10);
+		bench_report_result(r, lat->keys[k++],
+			bench_latency_pct_ns(lat, bench_latency_pct[i]));
+	}
+	snprintf(lat->keys[k], sizeof(lat->keys[k]), "%s_max_ns", lat->name);
+	bench_report_result(r, lat->keys[k++],
+		lat->max * bench_latency_ns_per_cycle);
+}
+
+#endif /* _TEST_BENCH_LATENCY_H */
@@ -0,0 +1,335 @@
+#ifndef _TEST_BENCH_PERF_H
+#define _TEST_BENCH_PERF_H
+
+/*
+ * bench-perf.h
+ *
+ * Userspace RCU library - per-thread hardware performance counters
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmarks given --perf count cycles, instructions, last level cache
+ * misses and data TLB misses of each test thread with perf_event_open,
+ * in user space only, from the start to the end of the measurement.
+ * --perf=0xCONFIG also counts the raw event CONFIG of the CPU, e.g. its
+ * HITM event to count cache-line transfers. The benchmark allocates the
+ * shared totals after parsing its arguments. Each thread counts with
+ * its own counters, allocated from the shared totals and added to them
+ * at thread exit. The totals are printed per operation on a "PERF"
+ * line, or added to the per_op section of the bench_report.
+ *
+ * Events the CPU or the kernel do not support, or which cannot be
+ * opened because of perf_event_paranoid, are reported as unavailable.
+ * Counts are scaled when the kernel multiplexes the counters.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <urcu/compiler.h>
+
+#include "bench-report.h"
+
+enum bench_perf_event {
+	BENCH_PERF_CYCLES = 0,
+	BENCH_PERF_INSTRUCTIONS,
+	BENCH_PERF_LLC_MISSES,
+	BENCH_PERF_DTLB_MISSES,
+	BENCH_PERF_RAW,
+	BENCH_PERF_NR_EVENTS,
+};
+
+static const char * const bench_perf_names[] = {
+	[BENCH_PERF_CYCLES] = "cycles",
+	[BENCH_PERF_INSTRUCTIONS] = "instructions",
+	[BENCH_PERF_LLC_MISSES] = "llc_misses",
+	[BENCH_PERF_DTLB_MISSES] = "dtlb_misses",
+	[BENCH_PERF_RAW] = "raw",
+};
+
+static int bench_perf_enabled;
+static unsigned long long bench_perf_raw;	/* 0: no raw event */
+
+/* Totals of all threads. */
+struct bench_perf {
+	unsigned long long raw;
+	int available[BENCH_PERF_NR_EVENTS];
+	unsigned long long count[BENCH_PERF_NR_EVENTS];
+	pthread_mutex_t lock;
+	char keys[BENCH_PERF_NR_EVENTS][32];	/* bench_report keys */
+};
+
+/* Counters of one thread. */
+struct bench_perf_thread {
+	struct bench_perf *shared;
+	int fd[BENCH_PERF_NR_EVENTS];
+};
+
+/*
+ * Remove the --perf[=0xCONFIG] option from the arguments, before they
+ * are parsed by the benchmark. Returns the new argument count.
+ */
+static inline int bench_perf_parse_args(int argc, char **argv)
+{
+	int i, j;
+
+	for (i = 1, j = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--perf")) {
+			bench_perf_enabled = 1;
+		} else if (!strncmp(argv[i], "--perf=", strlen("--perf="))) {
+			bench_perf_enabled = 1;
+			bench_perf_raw = strtoull(argv[i] + strlen("--perf="),
+					NULL, 0);
+			if (!bench_perf_raw) {
+				fprintf(stderr, "Invalid raw perf event: %s\n",
+					argv[i]);
+				exit(-1);
+			}
+		} else {
+			argv[j++] = argv[i];
+		}
+	}
+	argv[j] = NULL;
+#ifndef HAVE_LINUX_PERF_EVENT_H
+	if (bench_perf_enabled) {
+		fprintf(stderr, "--perf requires perf_event_open\n");
+		exit(-1);
+	}
+#endif
+	return j;
+}
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+/* Open @event for the calling thread, disabled. Returns -1 on error. */
+static inline int bench_perf_open(const struct bench_perf *perf,
+		enum bench_perf_event event)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+		| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	switch (event) {
+	case BENCH_PERF_CYCLES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case BENCH_PERF_INSTRUCTIONS:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case BENCH_PERF_LLC_MISSES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case BENCH_PERF_DTLB_MISSES:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case BENCH_PERF_RAW:
+		if (!perf->raw)
+			return -1;
+		attr.type = PERF_TYPE_RAW;
+		attr.config = perf->raw;
+		break;
+	default:
+		return -1;
+	}
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#else
+static inline int bench_perf_open(const struct bench_perf *perf,
+		enum bench_perf_event event)
+{
+	return -1;
+}
+#endif
+
+/*
+ * Allocate the shared totals, or return NULL if counters are not
+ * recorded. Must be called after bench_perf_parse_args().
+ */
+static inline struct bench_perf *bench_perf_alloc(void)
+{
+	struct bench_perf *perf;
+	unsigned int i;
+
+	if (!bench_perf_enabled)
+		return NULL;
+	perf = calloc(1, sizeof(*perf));
+	if (!perf) {
+		perror("calloc");
+		exit(-1);
+	}
+	perf->raw = bench_perf_raw;
+	pthread_mutex_init(&perf->lock, NULL);
+	/* Find which events can be counted. */
+	for (i = 0; i < BENCH_PERF_NR_EVENTS; i++) {
+		int fd = bench_perf_open(perf, i);
+
+		if (fd >= 0) {
+			perf->available[i] = 1;
+			close(fd);
+		}
+	}
+	return perf;
+}
+
+static inline void bench_perf_free(struct bench_perf *perf)
+{
+	if (!perf)
+		return;
+	pthread_mutex_destroy(&perf->lock);
+	free(perf);
+}
+
+/*
+ * Open the counters of the calling thread, or return NULL if @perf is
+ * NULL. They count from bench_perf_thread_start().
+ */
+static inline struct bench_perf_thread *bench_perf_thread_alloc(
+		struct bench_perf *perf)
+{
+	struct bench_perf_thread *t;
+	unsigned int i;
+
+	if (!perf)
+		return NULL;
+	t = calloc(1, sizeof(*t));
+	if (!t) {
+		perror("calloc");
+		exit(-1);
+	}
+	t->shared = perf;
+	for (i = 0; i < BENCH_PERF_NR_EVENTS; i++)
+		t->fd[i] = perf->available[i] ? bench_perf_open(perf, i) : -1;
+	return t;
+}
+
+/* Start counting, once the test begins. */
+static inline void bench_perf_thread_start(struct bench_perf_thread *t)
+{
+#ifdef HAVE_LINUX_PERF_EVENT_H
+	unsigned int i;
+
+	if (!t)
+		return;
+	for (i = 0; i < BENCH_PERF_NR_EVENTS; i++) {
+		if (t->fd[i] >= 0)
+			(void) ioctl(t->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+/*
+ * Stop counting, add the counts of the thread to the shared totals and
+ * free its counters. May be called concurrently by all threads.
+ */
+static inline void bench_perf_thread_free(struct bench_perf_thread *t)
+{
+	unsigned long long count[BENCH_PERF_NR_EVENTS] = { 0 };
+	struct bench_perf *perf;
+	unsigned int i;
+
+	if (!t)
+		return;
+	perf = t->shared;
+	for (i = 0; i < BENCH_PERF_NR_EVENTS; i++) {
+		/* Value, time enabled, time running. */
+		unsigned long long v[3];
+
+		if (t->fd[i] < 0)
+			continue;
+#ifdef HAVE_LINUX_PERF_EVENT_H
+		(void) ioctl(t->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+		if (read(t->fd[i], v, sizeof(v)) == sizeof(v) && v[2]) {
+			count[i] = v[2] < v[1] ?
+				(unsigned long long) ((double) v[0] * v[1] / v[2])
+				: v[0];
+		}
+		close(t->fd[i]);
+	}
+	pthread_mutex_lock(&perf->lock);
+	for (i = 0; i < BENCH_PERF_NR_EVENTS; i++)
+		perf->count[i] += count[i];
+	pthread_mutex_unlock(&perf->lock);
+	free(t);
+}
+
+/* Print one "PERF" line with the counts per operation of @perf. */
+static inline void bench_perf_print(const struct bench_perf *perf,
+		unsigned long long nr_ops)
+{
+	unsigned int i;
+
+	if (!perf)
+		return;
+	printf("PERF");
+	for (i = 0; i < BENCH_PERF_NR_EVENTS; i++) {
+		if (i == BENCH_PERF_RAW && !perf->raw)
+			continue;
+		if (!perf->available[i])
+			printf(" %s/op n/a", bench_perf_names[i]);
+		else
+			printf(" %s/op %.3f", bench_perf_names[i],
+				nr_ops ? (double) perf->count[i] / nr_ops : 0);
+	}
+	if (perf->available[BENCH_PERF_CYCLES]
+			&& perf->available[BENCH_PERF_INSTRUCTIONS])
+		printf(" ipc %.3f", perf->count[BENCH_PERF_CYCLES] ?
+			(double) perf->count[BENCH_PERF_INSTRUCTIONS]
+				/ perf->count[BENCH_PERF_CYCLES] : 0);
+	printf("\n");
+}
+
+/*
+ * Add the available counts of @perf to the per_op section of @r, as
+ * "perf_cycles" and so on. @perf must outlive the printing of @r.
+ */
+static inline void bench_perf_report(struct bench_report *r,
+		struct bench_perf *perf)
+{
+	unsigned int i;
+
+	if (!perf)
+		return;
+	for (i = 0; i < BENCH_PERF_NR_EVENTS; i++) {
+		if (!perf->available[i])
+			continue;
+		snprintf(perf->keys[i], sizeof(perf->keys[i]), "perf_%s",
+			bench_perf_names[i]);
+		bench_report_per_op(r, perf->keys[i], perf->count[i]);
+	}
+}
+
+#endif /* _TEST_BENCH_PERF_H */
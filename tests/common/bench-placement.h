@@ -0,0 +1,400 @@
+#ifndef _TEST_BENCH_PLACEMENT_H
+#define _TEST_BENCH_PLACEMENT_H
+
+/*
+ * bench-placement.h
+ *
+ * Userspace RCU library - topology-aware benchmark thread placement
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmarks given --placement=policy pin each thread to a CPU chosen
+ * from the topology found in /sys/devices/system/cpu, among the CPUs
+ * the benchmark may run on:
+ *
+ * compact: fill the SMT siblings of a core, then the cores of a
+ *          package, then the next package.
+ * scatter: round-robin across packages, one thread per core of each
+ *          package before the SMT siblings.
+ * core:    one thread per physical core, before the SMT siblings.
+ * split:   readers on the first NUMA node, writers on the second. On
+ *          a single node, on the first and second package, or else on
+ *          the first and second half of the cores.
+ *
+ * Threads beyond the number of CPUs wrap around. The CPU of each thread
+ * is recorded and printed with bench_placement_print(), and the policy
+ * is reported as the "placement" configuration of bench_report.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+
+#include "cpuset.h"
+
+enum bench_role {
+	BENCH_ROLE_READER = 0,		/* Readers, dequeuers. */
+	BENCH_ROLE_WRITER,		/* Writers, enqueuers. */
+	BENCH_NR_ROLES,
+};
+
+enum bench_placement_policy {
+	BENCH_PLACEMENT_NONE = 0,
+	BENCH_PLACEMENT_COMPACT,
+	BENCH_PLACEMENT_SCATTER,
+	BENCH_PLACEMENT_CORE,
+	BENCH_PLACEMENT_SPLIT,
+};
+
+static const char * const bench_placement_names[] = {
+	[BENCH_PLACEMENT_NONE] = "none",
+	[BENCH_PLACEMENT_COMPACT] = "compact",
+	[BENCH_PLACEMENT_SCATTER] = "scatter",
+	[BENCH_PLACEMENT_CORE] = "core",
+	[BENCH_PLACEMENT_SPLIT] = "split",
+};
+
+#define BENCH_PLACEMENT_MAX_THREADS	1024
+
+struct bench_cpu {
+	int cpu, node, package, core;
+	int thread_idx;			/* Rank among the SMT siblings. */
+	int core_idx;			/* Rank among the package cores. */
+	int key[4];			/* Sort key of the policy. */
+};
+
+struct bench_placement {
+	enum bench_placement_policy policy;
+	/* CPUs of each role, in placement order. */
+	int *cpus[BENCH_NR_ROLES];
+	unsigned int nr_cpus[BENCH_NR_ROLES];
+	unsigned int next[BENCH_NR_ROLES];
+	/* CPU of each placed thread. */
+	int placed[BENCH_NR_ROLES][BENCH_PLACEMENT_MAX_THREADS];
+	unsigned int nr_placed[BENCH_NR_ROLES];
+	pthread_mutex_t lock;
+};
+
+static inline int bench_placement_read_int(int cpu, const char *file,
+		int dflt)
+{
+	char path[128];
+	FILE *f;
+	int v;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s",
+		cpu, file);
+	f = fopen(path, "r");
+	if (!f)
+		return dflt;
+	if (fscanf(f, "%d", &v) != 1)
+		v = dflt;
+	fclose(f);
+	return v;
+}
+
+static inline int bench_placement_cpu_node(int cpu)
+{
+	char path[64];
+	struct dirent *d;
+	int node = 0;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+	while ((d = readdir(dir))) {
+		if (sscanf(d->d_name, "node%d", &node) == 1)
+			break;
+	}
+	closedir(dir);
+	return node;
+}
+
+/* Return whether the benchmark may run on @cpu. */
+static inline int bench_placement_cpu_usable(int cpu)
+{
+#if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_ISSET)	\
+		&& SCHED_SETAFFINITY_ARGS != 2
+	static cpu_set_t allowed;
+	static int allowed_init;
+
+	if (!allowed_init) {
+		if (sched_getaffinity(0, sizeof(allowed), &allowed))
+			return 1;
+		allowed_init = 1;
+	}
+	if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+		return 0;
+#endif
+	/* cpu0 usually has no online file. */
+	return bench_placement_read_int(cpu, "online", 1);
+}
+
+static inline int bench_placement_cmp(const void *a, const void *b)
+{
+	const struct bench_cpu *ca = a, *cb = b;
+	unsigned int i;
+
+	for (i = 0; i < CAA_ARRAY_SIZE(ca->key); i++) {
+		if (ca->key[i] != cb->key[i])
+			return ca->key[i] < cb->key[i] ? -1 : 1;
+	}
+	return ca->cpu - cb->cpu;
+}
+
+static inline void bench_placement_set_key(struct bench_cpu *c,
+		int k0, int k1, int k2, int k3)
+{
+	c->key[0] = k0;
+	c->key[1] = k1;
+	c->key[2] = k2;
+	c->key[3] = k3;
+}
+
+static inline int *bench_placement_cpu_list(const struct bench_cpu *cpus,
+		unsigned int nr, unsigned int *nr_list)
+{
+	unsigned int i;
+	int *list;
+
+	list = calloc(nr ? nr : 1, sizeof(*list));
+	if (!list) {
+		perror("calloc");
+		exit(-1);
+	}
+	for (i = 0; i < nr; i++)
+		list[i] = cpus[i].cpu;
+	*nr_list = nr;
+	return list;
+}
+
+/* Order the CPUs of @p according to its policy. */
+static inline void bench_placement_init(struct bench_placement *p)
+{
+	struct bench_cpu *cpus;
+	unsigned int nr = 0, i, j, half;
+	long nr_conf;
+	int cpu, split_nodes = 0, split_packages = 0;
+
+	nr_conf = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_conf <= 0)
+		nr_conf = 1;
+	cpus = calloc(nr_conf, sizeof(*cpus));
+	if (!cpus) {
+		perror("calloc");
+		exit(-1);
+	}
+	for (cpu = 0; cpu < nr_conf; cpu++) {
+		struct bench_cpu *c = &cpus[nr];
+
+		if (!bench_placement_cpu_usable(cpu))
+			continue;
+		c->cpu = cpu;
+		c->node = bench_placement_cpu_node(cpu);
+		c->package = bench_placement_read_int(cpu,
+				"topology/physical_package_id", 0);
+		c->core = bench_placement_read_int(cpu,
+				"topology/core_id", cpu);
+		nr++;
+	}
+	if (!nr) {
+		fprintf(stderr, "No usable CPU for --placement\n");
+		exit(-1);
+	}
+	/* Rank each CPU among its siblings, and its core in its package. */
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < nr; j++) {
+			if (cpus[j].package != cpus[i].package)
+				continue;
+			if (cpus[j].core == cpus[i].core
+					&& cpus[j].cpu < cpus[i].cpu)
+				cpus[i].thread_idx++;
+		}
+	}
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < nr; j++) {
+			/* Count the distinct lower cores through their first CPU. */
+			if (cpus[j].package == cpus[i].package
+					&& cpus[j].core < cpus[i].core
+					&& !cpus[j].thread_idx)
+				cpus[i].core_idx++;
+		}
+		if (cpus[i].node != cpus[0].node)
+			split_nodes = 1;
+		if (cpus[i].package != cpus[0].package)
+			split_packages = 1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct bench_cpu *c = &cpus[i];
+
+		switch (p->policy) {
+		case BENCH_PLACEMENT_SCATTER:
+			bench_placement_set_key(c, c->thread_idx, c->core_idx,
+				c->node, c->package);
+			break;
+		case BENCH_PLACEMENT_CORE:
+			bench_placement_set_key(c, c->thread_idx, c->node,
+				c->package, c->core);
+			break;
+		default:
+			bench_placement_set_key(c, c->node, c->package,
+				c->core, c->thread_idx);
+			break;
+		}
+	}
+	qsort(cpus, nr, sizeof(*cpus), bench_placement_cmp);
+
+	if (p->policy != BENCH_PLACEMENT_SPLIT || nr == 1) {
+		p->cpus[BENCH_ROLE_READER] = bench_placement_cpu_list(cpus, nr,
+				&p->nr_cpus[BENCH_ROLE_READER]);
+		p->cpus[BENCH_ROLE_WRITER] = NULL;
+		free(cpus);
+		return;
+	}
+	/* Readers on the first group of CPUs, writers on the second. */
+	for (half = 1; half < nr; half++) {
+		if (split_nodes) {
+			if (cpus[half].node != cpus[0].node)
+				break;
+		} else if (split_packages) {
+			if (cpus[half].package != cpus[0].package)
+				break;
+		} else if (half >= nr / 2 && !cpus[half].thread_idx) {
+			break;
+		}
+	}
+	if (half == nr)
+		half = nr / 2;
+	for (j = half; j < nr; j++) {
+		if (split_nodes ? cpus[j].node != cpus[half].node
+				: split_packages
+				&& cpus[j].package != cpus[half].package)
+			break;
+	}
+	p->cpus[BENCH_ROLE_READER] = bench_placement_cpu_list(cpus, half,
+			&p->nr_cpus[BENCH_ROLE_READER]);
+	p->cpus[BENCH_ROLE_WRITER] = bench_placement_cpu_list(cpus + half,
+			j - half, &p->nr_cpus[BENCH_ROLE_WRITER]);
+	free(cpus);
+}
+
+/*
+ * Remove the --placement=compact|scatter|core|split option from the
+ * arguments, before they are parsed by the benchmark, and find the
+ * CPUs to place threads on. Returns the new argument count.
+ */
+static inline int bench_placement_parse_args(struct bench_placement *p,
+		int argc, char **argv)
+{
+	int i, j;
+
+	memset(p, 0, sizeof(*p));
+	pthread_mutex_init(&p->lock, NULL);
+	for (i = 1, j = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		unsigned int policy;
+
+		if (strncmp(arg, "--placement=", strlen("--placement="))) {
+			argv[j++] = argv[i];
+			continue;
+		}
+		arg += strlen("--placement=");
+		for (policy = BENCH_PLACEMENT_COMPACT;
+				policy < CAA_ARRAY_SIZE(bench_placement_names);
+				policy++) {
+			if (!strcmp(arg, bench_placement_names[policy]))
+				break;
+		}
+		if (policy == CAA_ARRAY_SIZE(bench_placement_names)) {
+			fprintf(stderr, "Unknown placement policy: %s\n", arg);
+			exit(-1);
+		}
+		p->policy = policy;
+	}
+	argv[j] = NULL;
+	if (p->policy != BENCH_PLACEMENT_NONE)
+		bench_placement_init(p);
+	return j;
+}
+
+static inline int bench_placement_enabled(const struct bench_placement *p)
+{
+	return p->policy != BENCH_PLACEMENT_NONE;
+}
+
+/*
+ * Return the CPU of the next thread of @role, and record it. Without
+ * the split policy, threads of all roles share the same CPUs, in the
+ * order they are placed.
+ */
+static inline int bench_placement_next_cpu(struct bench_placement *p,
+		enum bench_role role)
+{
+	unsigned int list = p->cpus[BENCH_ROLE_WRITER] ? role : 0;
+	int cpu;
+
+	pthread_mutex_lock(&p->lock);
+	cpu = p->cpus[list][p->next[list]++ % p->nr_cpus[list]];
+	if (p->nr_placed[role] < BENCH_PLACEMENT_MAX_THREADS)
+		p->placed[role][p->nr_placed[role]++] = cpu;
+	pthread_mutex_unlock(&p->lock);
+	return cpu;
+}
+
+static inline void bench_placement_print_role(const struct bench_placement *p,
+		enum bench_role role, const char *name)
+{
+	unsigned int i;
+
+	printf(" %s ", name);
+	if (!p->nr_placed[role])
+		printf("-");
+	for (i = 0; i < p->nr_placed[role]; i++)
+		printf("%s%d", i ? "," : "", p->placed[role][i]);
+}
+
+/*
+ * Print one "PLACEMENT" line with the policy and the CPU of each
+ * thread, naming the roles @reader and @writer.
+ */
+static inline void bench_placement_print(const struct bench_placement *p,
+		const char *reader, const char *writer)
+{
+	if (!bench_placement_enabled(p))
+		return;
+	printf("PLACEMENT %s", bench_placement_names[p->policy]);
+	bench_placement_print_role(p, BENCH_ROLE_READER, reader);
+	bench_placement_print_role(p, BENCH_ROLE_WRITER, writer);
+	printf("\n");
+}
+
+static inline void bench_placement_destroy(struct bench_placement *p)
+{
+	free(p->cpus[BENCH_ROLE_READER]);
+	free(p->cpus[BENCH_ROLE_WRITER]);
+	pthread_mutex_destroy(&p->lock);
+}
+
+#endif /* _TEST_BENCH_PLACEMENT_H */
@@ -0,0 +1,336 @@
+#ifndef _TEST_BENCH_REPORT_H
+#define _TEST_BENCH_REPORT_H
+
+/*
+ * bench-report.h
+ *
+ * Userspace RCU library - machine-readable benchmark results
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmarks given --format=json or --format=csv print their results
+ * with bench_report_print() instead of their SUMMARY line: the test
+ * configuration, the operation count of each thread, the duration, the
+ * throughput of each kind of thread and the event counts per operation,
+ * if any. JSON is printed as a single object on one line. CSV is
+ * printed in long form, one "test,section,key,value" row per value,
+ * after a header row.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum bench_report_format {
+	BENCH_REPORT_TEXT = 0,
+	BENCH_REPORT_JSON,
+	BENCH_REPORT_CSV,
+};
+
+static enum bench_report_format bench_report_format;
+
+#define BENCH_REPORT_MAX_KEYS	32
+
+struct bench_report_value {
+	const char *key;
+	long long value;
+};
+
+struct bench_report_thread {
+	const char *kind;
+	unsigned long long ops;
+};
+
+struct bench_report {
+	const char *test;
+	unsigned long duration;		/* seconds */
+	struct bench_report_value config[BENCH_REPORT_MAX_KEYS];
+	struct bench_report_value results[BENCH_REPORT_MAX_KEYS];
+	struct bench_report_value per_op[BENCH_REPORT_MAX_KEYS];
+	unsigned int nr_config, nr_results, nr_per_op;
+	struct bench_report_thread *threads;
+	unsigned int nr_threads, alloc_threads;
+};
+
+/*
+ * Remove the --format=text|json|csv option from the arguments, before
+ * they are parsed by the benchmark. Returns the new argument count.
+ */
+static inline int bench_report_parse_args(int argc, char **argv)
+{
+	int i, j;
+
+	for (i = 1, j = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--format=", strlen("--format="))) {
+			argv[j++] = argv[i];
+			continue;
+		}
+		if (!strcmp(argv[i], "--format=text")) {
+			bench_report_format = BENCH_REPORT_TEXT;
+		} else if (!strcmp(argv[i], "--format=json")) {
+			bench_report_format = BENCH_REPORT_JSON;
+		} else if (!strcmp(argv[i], "--format=csv")) {
+			bench_report_format = BENCH_REPORT_CSV;
+		} else {
+			fprintf(stderr, "Unknown output format: %s\n",
+				argv[i]);
+			exit(-1);
+		}
+	}
+	argv[j] = NULL;
+	return j;
+}
+
+/* Whether the benchmark should print its usual text summary. */
+static inline int bench_report_text(void)
+{
+	return bench_report_format == BENCH_REPORT_TEXT;
+}
+
+static inline void bench_report_init(struct bench_report *r,
+		const char *test, unsigned long duration)
+{
+	memset(r, 0, sizeof(*r));
+	r->test = test;
+	r->duration = duration;
+}
+
+static inline void bench_report_add(struct bench_report_value *values,
+		unsigned int *nr, const char *key, long long value)
+{
+	if (*nr == BENCH_REPORT_MAX_KEYS) {
+		fprintf(stderr, "Too many benchmark report keys\n");
+		exit(-1);
+	}
+	values[*nr].key = key;
+	values[*nr].value = value;
+	(*nr)++;
+}
+
+/* Parameter of the test, e.g. number of threads or delays. */
+static inline void bench_report_config(struct bench_report *r,
+		const char *key, long long value)
+{
+	bench_report_add(r->config, &r->nr_config, key, value);
+}
+
+/* Total measured over the test. */
+static inline void bench_report_result(struct bench_report *r,
+		const char *key, long long value)
+{
+	bench_report_add(r->results, &r->nr_results, key, value);
+}
+
+/*
+ * Total measured over the test, e.g. an event count, printed divided
+ * by the operation count of all threads.
+ */
+static inline void bench_report_per_op(struct bench_report *r,
+		const char *key, long long value)
+{
+	bench_report_add(r->per_op, &r->nr_per_op, key, value);
+}
+
+/* Operation count of one thread of a kind, e.g. "reader". */
+static inline void bench_report_thread(struct bench_report *r,
+		const char *kind, unsigned long long ops)
+{
+	if (r->nr_threads == r->alloc_threads) {
+		r->alloc_threads = r->alloc_threads ? 2 * r->alloc_threads : 16;
+		r->threads = realloc(r->threads,
+				r->alloc_threads * sizeof(*r->threads));
+		if (!r->threads) {
+			perror("realloc");
+			exit(-1);
+		}
+	}
+	r->threads[r->nr_threads].kind = kind;
+	r->threads[r->nr_threads].ops = ops;
+	r->nr_threads++;
+}
+
+static inline void bench_report_json_string(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			putchar('\\');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static inline void bench_report_json_values(const char *name,
+		const struct bench_report_value *values, unsigned int nr)
+{
+	unsigned int i;
+
+	printf(",\"%s\":{", name);
+	for (i = 0; i < nr; i++)
+		printf("%s\"%s\":%lld", i ? "," : "", values[i].key,
+			values[i].value);
+	putchar('}');
+}
+
+/* First thread of the kind of thread @i, to list each kind once. */
+static inline int bench_report_kind_first(const struct bench_report *r,
+		unsigned int i)
+{
+	unsigned int j;
+
+	for (j = 0; j < i; j++) {
+		if (!strcmp(r->threads[j].kind, r->threads[i].kind))
+			return 0;
+	}
+	return 1;
+}
+
+static inline unsigned long long bench_report_kind_ops(
+		const struct bench_report *r, const char *kind)
+{
+	unsigned long long ops = 0;
+	unsigned int i;
+
+	for (i = 0; i < r->nr_threads; i++) {
+		if (!strcmp(r->threads[i].kind, kind))
+			ops += r->threads[i].ops;
+	}
+	return ops;
+}
+
+static inline double bench_report_per_s(const struct bench_report *r,
+		unsigned long long ops)
+{
+	return r->duration ? (double) ops / r->duration : 0;
+}
+
+static inline double bench_report_op_ratio(const struct bench_report *r,
+		unsigned int i)
+{
+	unsigned long long total = 0;
+	unsigned int j;
+
+	for (j = 0; j < r->nr_threads; j++)
+		total += r->threads[j].ops;
+	return total ? (double) r->per_op[i].value / total : 0;
+}
+
+static inline void bench_report_print_json(const struct bench_report *r)
+{
+	unsigned long long total = 0;
+	unsigned int i, j, n;
+
+	printf("{\"test\":");
+	bench_report_json_string(r->test);
+	printf(",\"duration_s\":%lu", r->duration);
+	bench_report_json_values("config", r->config, r->nr_config);
+	printf(",\"threads\":{");
+	for (i = 0, n = 0; i < r->nr_threads; i++) {
+		if (!bench_report_kind_first(r, i))
+			continue;
+		printf("%s\"%s\":[", n++ ? "," : "", r->threads[i].kind);
+		for (j = i; j < r->nr_threads; j++) {
+			if (strcmp(r->threads[j].kind, r->threads[i].kind))
+				continue;
+			printf("%s%llu", j != i ? "," : "",
+				r->threads[j].ops);
+		}
+		putchar(']');
+	}
+	putchar('}');
+	bench_report_json_values("results", r->results, r->nr_results);
+	printf(",\"throughput\":{");
+	for (i = 0; i < r->nr_threads; i++) {
+		unsigned long long ops;
+
+		if (!bench_report_kind_first(r, i))
+			continue;
+		ops = bench_report_kind_ops(r, r->threads[i].kind);
+		total += ops;
+		printf("\"%s_ops_per_s\":%.1f,", r->threads[i].kind,
+			bench_report_per_s(r, ops));
+	}
+	printf("\"ops_per_s\":%.1f}", bench_report_per_s(r, total));
+	if (r->nr_per_op) {
+		printf(",\"per_op\":{");
+		for (i = 0; i < r->nr_per_op; i++)
+			printf("%s\"%s\":%.3f", i ? "," : "", r->per_op[i].key,
+				bench_report_op_ratio(r, i));
+		putchar('}');
+	}
+	printf("}\n");
+}
+
+static inline void bench_report_print_csv(const struct bench_report *r)
+{
+	unsigned long long total = 0;
+	static int header_printed;
+	unsigned int i, j, n;
+
+	/* Benchmarks printing several reports print a single header row. */
+	if (!header_printed) {
+		printf("test,section,key,value\n");
+		header_printed = 1;
+	}
+	printf("%s,config,duration_s,%lu\n", r->test, r->duration);
+	for (i = 0; i < r->nr_config; i++)
+		printf("%s,config,%s,%lld\n", r->test, r->config[i].key,
+			r->config[i].value);
+	for (i = 0; i < r->nr_threads; i++) {
+		for (j = 0, n = 0; j < i; j++)
+			n += !strcmp(r->threads[j].kind, r->threads[i].kind);
+		printf("%s,threads,%s[%u],%llu\n", r->test,
+			r->threads[i].kind, n, r->threads[i].ops);
+	}
+	for (i = 0; i < r->nr_results; i++)
+		printf("%s,results,%s,%lld\n", r->test, r->results[i].key,
+			r->results[i].value);
+	for (i = 0; i < r->nr_threads; i++) {
+		unsigned long long ops;
+
+		if (!bench_report_kind_first(r, i))
+			continue;
+		ops = bench_report_kind_ops(r, r->threads[i].kind);
+		total += ops;
+		printf("%s,throughput,%s_ops_per_s,%.1f\n", r->test,
+			r->threads[i].kind, bench_report_per_s(r, ops));
+	}
+	printf("%s,throughput,ops_per_s,%.1f\n", r->test,
+		bench_report_per_s(r, total));
+	for (i = 0; i < r->nr_per_op; i++)
+		printf("%s,per_op,%s,%.3f\n", r->test, r->per_op[i].key,
+			bench_report_op_ratio(r, i));
+}
+
+/* Print the report in the selected format, and release it. */
+static inline void bench_report_print(struct bench_report *r)
+{
+	switch (bench_report_format) {
+	case BENCH_REPORT_TEXT:
+		break;
+	case BENCH_REPORT_JSON:
+		bench_report_print_json(r);
+		break;
+	case BENCH_REPORT_CSV:
+		bench_report_print_csv(r);
+		break;
+	}
+	free(r->threads);
+	r->threads = NULL;
+}
+
+#endif /* _TEST_BENCH_REPORT_H */
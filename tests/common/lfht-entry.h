@@ -0,0 +1,196 @@
+#ifndef _TEST_LFHT_ENTRY_H
+#define _TEST_LFHT_ENTRY_H
+
+/*
+ * lfht-entry.h
+ *
+ * Userspace RCU library - hash table entries of the unit tests
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Entries of an unsigned long key, hashed by test_hash_key(). Removed
+ * entries are freed after a grace period, with their magic cleared so
+ * that a reader still holding one can tell.
+ *
+ * A test adding fields embeds a struct lfht_entry first, so that
+ * lfht_entry_free() frees the whole object.
+ *
+ * Include after the urcu flavor header of the test.
+ */
+
+#include <stdlib.h>
+#include <urcu/rculfhash.h>
+
+#define LFHT_ENTRY_MAGIC	0x1234abcdUL
+
+struct lfht_entry {
+	unsigned long key;
+	unsigned long magic;
+	struct cds_lfht_node node;
+	struct rcu_head rcu_head;
+};
+
+/* Also the key hash of the tests of the other hash tables. */
+static inline unsigned long test_hash_key(unsigned long key)
+{
+	return key * 0x9E3779B97F4A7C15ULL;
+}
+
+/* Return the entry of @node, or NULL if @node is NULL. */
+static inline struct lfht_entry *lfht_entry_of(struct cds_lfht_node *node)
+{
+	return node ? caa_container_of(node, struct lfht_entry, node) : NULL;
+}
+
+static inline int lfht_entry_match(struct cds_lfht_node *node,
+		const void *key)
+{
+	return lfht_entry_of(node)->key == *(const unsigned long *) key;
+}
+
+static inline void lfht_entry_init(struct lfht_entry *e, unsigned long key)
+{
+	e->key = key;
+	e->magic = LFHT_ENTRY_MAGIC;
+	cds_lfht_node_init(&e->node);
+}
+
+static inline struct lfht_entry *lfht_entry_alloc(unsigned long key)
+{
+	struct lfht_entry *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	lfht_entry_init(e, key);
+	return e;
+}
+
+static inline void lfht_entry_free(struct rcu_head *head)
+{
+	struct lfht_entry *e = caa_container_of(head, struct lfht_entry,
+			rcu_head);
+
+	CMM_STORE_SHARED(e->magic, 0);
+	free(e);
+}
+
+/*
+ * Return the first node of @key, also left in @iter unless NULL. Call
+ * with rcu_read_lock held.
+ */
+static inline struct cds_lfht_node *lfht_entry_lookup(struct cds_lfht *ht,
+		unsigned long key, struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_iter local;
+
+	if (!iter)
+		iter = &local;
+	cds_lfht_lookup(ht, test_hash_key(key), lfht_entry_match, &key,
+			iter);
+	return cds_lfht_iter_get_node(iter);
+}
+
+/* Count the nodes of @key. */
+static inline unsigned long lfht_entry_nr_nodes(struct cds_lfht *ht,
+		unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	unsigned long nr = 0;
+
+	rcu_read_lock();
+	lfht_entry_lookup(ht, key, &iter);
+	while (cds_lfht_iter_get_node(&iter)) {
+		nr++;
+		cds_lfht_next_duplicate(ht, lfht_entry_match, &key, &iter);
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+/*
+ * Remove @node, freeing it after a grace period unless removed
+ * concurrently. Call with rcu_read_lock held.
+ */
+static inline void lfht_entry_del(struct cds_lfht *ht,
+		struct cds_lfht_node *node)
+{
+	if (!cds_lfht_del(ht, node))
+		call_rcu(&lfht_entry_of(node)->rcu_head, lfht_entry_free);
+}
+
+/* Remove the first node of @key, if any. */
+static inline void lfht_entry_del_key(struct cds_lfht *ht, unsigned long key)
+{
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	node = lfht_entry_lookup(ht, key, NULL);
+	if (node)
+		lfht_entry_del(ht, node);
+	rcu_read_unlock();
+}
+
+/* Add the keys of [start, start + len). */
+static inline void lfht_entry_add_keys(struct cds_lfht *ht,
+		unsigned long start, unsigned long len)
+{
+	unsigned long key;
+
+	rcu_read_lock();
+	for (key = start; key < start + len; key++)
+		cds_lfht_add(ht, test_hash_key(key),
+				&lfht_entry_alloc(key)->node);
+	rcu_read_unlock();
+}
+
+/* Count the keys of [start, start + len) not found. */
+static inline unsigned long lfht_entry_nr_missing(struct cds_lfht *ht,
+		unsigned long start, unsigned long len)
+{
+	unsigned long key, nr = 0;
+
+	rcu_read_lock();
+	for (key = start; key < start + len; key++) {
+		if (!lfht_entry_lookup(ht, key, NULL))
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+/* Remove all the nodes of the table. */
+static inline void lfht_entry_del_all(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		lfht_entry_del(ht, node);
+	rcu_read_unlock();
+}
+
+/* Destroy the table, and wait for its nodes to be freed. */
+static inline void lfht_entry_destroy(struct cds_lfht *ht)
+{
+	lfht_entry_del_all(ht);
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_barrier();
+}
+
+#endif /* _TEST_LFHT_ENTRY_H */
@@ -0,0 +1,86 @@
+#ifndef _TEST_POISON_OBJ_H
+#define _TEST_POISON_OBJ_H
+
+/*
+ * poison-obj.h
+ *
+ * Userspace RCU library - poisoned objects kept alive until the end of a test
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Freed objects are poisoned and kept until the end of the test, so
+ * that readers can detect an object freed under their read lock or
+ * hazard pointer.
+ *
+ * The objects of a test start with a struct poison_obj: they are
+ * allocated by poison_obj_alloc(), freed by poison_obj_free() from the
+ * reclaim callback of the test, and released by poison_obj_free_all()
+ * once no reader is left.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <urcu/system.h>
+
+#define POISON_OBJ_MAGIC	0x1234abcdUL
+
+struct poison_obj {
+	unsigned long magic;
+	struct poison_obj *next_dead;
+};
+
+static struct poison_obj *poison_obj_dead_list;
+static pthread_mutex_t poison_obj_dead_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allocate an object of @size bytes, starting with a struct poison_obj. */
+static inline void *poison_obj_alloc(size_t size)
+{
+	struct poison_obj *p = malloc(size);
+
+	if (!p)
+		abort();
+	p->magic = POISON_OBJ_MAGIC;
+	return p;
+}
+
+/* Return whether @p is not freed yet. */
+static inline int poison_obj_live(struct poison_obj *p)
+{
+	return CMM_LOAD_SHARED(p->magic) == POISON_OBJ_MAGIC;
+}
+
+static inline void poison_obj_free(struct poison_obj *p)
+{
+	CMM_STORE_SHARED(p->magic, 0);
+	pthread_mutex_lock(&poison_obj_dead_lock);
+	p->next_dead = poison_obj_dead_list;
+	poison_obj_dead_list = p;
+	pthread_mutex_unlock(&poison_obj_dead_lock);
+}
+
+static inline void poison_obj_free_all(void)
+{
+	struct poison_obj *p, *next;
+
+	for (p = poison_obj_dead_list; p; p = next) {
+		next = p->next_dead;
+		free(p);
+	}
+	poison_obj_dead_list = NULL;
+}
+
+#endif /* _TEST_POISON_OBJ_H */
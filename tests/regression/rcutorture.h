@@ -44,6 +44,21 @@
  * data.  A correct RCU implementation will have all but the first two
  * numbers non-zero.
  *
+ * 	./rcu <nreaders> lfht
+ * 		Run a cds_lfht stress test with the specified number of
+ * 		readers and two updaters filling and draining an
+ * 		auto-resizing hash table.  Lookup and update costs are
+ * 		reported as for perf, along with n_lfht_error, the number
+ * 		of stale, duplicated or missing nodes observed (zero in a
+ * 		correct implementation).
+ *
+ * 	./rcu <nreaders> flood
+ * 		Run a call_rcu() flood with the specified number of
+ * 		readers and two flooders.  Reports the cost of each
+ * 		call_rcu(), the maximum and mean delay between call_rcu()
+ * 		and callback invocation in microseconds, and the high-water
+ * 		mark of outstanding callbacks.
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -386,6 +401,19 @@ void *rcu_update_stress_test(void *arg)
 				rcu_stress_array[i].pipe_count++;
 		if (n_updates & 0x1)
 			synchronize_rcu();
+#ifdef RCU_EBR
+		else {
+			/*
+			 * The callback is invoked by the thread queuing
+			 * it, here by rcu_barrier(), so there is no worker
+			 * to wait for.
+			 */
+			rcu_register_thread();
+			call_rcu(&rh, rcu_update_stress_test_rcu);
+			rcu_barrier();
+			rcu_unregister_thread();
+		}
+#else
 		else {
 			int ret;
 
@@ -429,6 +457,7 @@ void *rcu_update_stress_test(void *arg)
 				abort();
 			}
 		}
+#endif
 		n_updates++;
 	}
 
@@ -515,13 +544,491 @@ int stresstest(int nreaders)
 		return -1;
 }
 
+/*
+ * Hash table torture test.
+ *
+ * Readers look up random keys and periodically walk the whole table,
+ * checking that every node they reach is live and carries the key it
+ * was found under.  Updaters own disjoint slices of the key space and
+ * alternately fill and drain their slice, which drags the table
+ * between one bucket and RCU_LFHT_KEYS entries, so the auto-resize
+ * worker is continuously growing and shrinking the table under the
+ * readers.  Each updater keeps a private map of the keys it inserted
+ * and flags lookups, insertions or removals that disagree with it.
+ */
+
+#define RCU_LFHT_KEYS		65536UL
+#define RCU_LFHT_UPDATERS	2
+#define RCU_LFHT_WALK_PERIOD	64
+#define RCU_LFHT_DURATION	5
+
+#define RCU_LFHT_ALIVE		0x600dcafeUL
+#define RCU_LFHT_DEAD		0xdeadbeefUL
+
+struct rcu_lfht_node {
+	struct cds_lfht_node node;
+	unsigned long key;
+	unsigned long alive;
+	struct rcu_head rcu;
+};
+
+struct cds_lfht *rcu_lfht_table;
+int n_lfht_error = 0;
+DEFINE_PER_THREAD(long, n_lfht_present_pt);
+
+static unsigned long rcu_lfht_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int rcu_lfht_match(struct cds_lfht_node *node, const void *key)
+{
+	struct rcu_lfht_node *n =
+		caa_container_of(node, struct rcu_lfht_node, node);
+
+	return n->key == *(const unsigned long *)key;
+}
+
+/* Multiplying by an odd constant permutes the power-of-two key space. */
+static unsigned long rcu_lfht_key(unsigned long i)
+{
+	return (i * 40503UL) & (RCU_LFHT_KEYS - 1);
+}
+
+static unsigned long rcu_lfht_rand(unsigned long *seed)
+{
+	*seed = *seed * 1103515245UL + 12345UL;
+	return (*seed >> 8) & (RCU_LFHT_KEYS - 1);
+}
+
+static int rcu_lfht_check(struct rcu_lfht_node *n, unsigned long key)
+{
+	if (n->key != key || n->alive != RCU_LFHT_ALIVE) {
+		uatomic_inc(&n_lfht_error);
+		return -1;
+	}
+	return 0;
+}
+
+void rcu_lfht_free_node(struct rcu_head *head)
+{
+	struct rcu_lfht_node *n =
+		caa_container_of(head, struct rcu_lfht_node, rcu);
+
+	n->alive = RCU_LFHT_DEAD;
+	free(n);
+}
+
+void *rcu_read_lfht_test(void *arg)
+{
+	struct cds_lfht_iter iter;
+	struct rcu_lfht_node *n;
+	unsigned long seed = (unsigned long)arg + 1;
+	unsigned long key;
+	long long n_reads_local = 0;
+	int itercnt = 0;
+	int i;
+
+	rcu_register_thread();
+	put_thread_offline();
+	while (goflag == GOFLAG_INIT)
+		(void) poll(NULL, 0, 1);
+	put_thread_online();
+	while (goflag == GOFLAG_RUN) {
+		rcu_read_lock();
+		for (i = 0; i < RCU_READ_RUN; i++) {
+			key = rcu_lfht_rand(&seed);
+			cds_lfht_lookup(rcu_lfht_table, rcu_lfht_hash(key),
+					rcu_lfht_match, &key, &iter);
+			n = caa_container_of(cds_lfht_iter_get_node(&iter),
+					struct rcu_lfht_node, node);
+			if (cds_lfht_iter_get_node(&iter))
+				(void) rcu_lfht_check(n, key);
+		}
+		if (++itercnt % RCU_LFHT_WALK_PERIOD == 0) {
+			cds_lfht_for_each_entry(rcu_lfht_table, &iter, n, node)
+				(void) rcu_lfht_check(n, n->key);
+		}
+		rcu_read_unlock();
+		n_reads_local += RCU_READ_RUN;
+		mark_rcu_quiescent_state();
+	}
+	__get_thread_var(n_reads_pt) += n_reads_local;
+	put_thread_offline();
+	rcu_unregister_thread();
+
+	return (NULL);
+}
+
+void *rcu_update_lfht_test(void *arg)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ret;
+	struct rcu_lfht_node *n;
+	unsigned long me = (unsigned long)arg;
+	unsigned long i, key;
+	long long n_updates_local = 0;
+	long present = 0;
+	int fill = 1;
+	char *map;
+
+	map = calloc(RCU_LFHT_KEYS, 1);
+	if (!map)
+		abort();
+	rcu_register_thread();
+	if (callrcu_type == CALLRCU_PERTHREAD) {
+		struct call_rcu_data *crdp;
+
+		crdp = create_call_rcu_data(0, -1);
+		if (crdp != NULL) {
+			diag("Successfully using per-thread call_rcu() worker.");
+			set_thread_call_rcu_data(crdp);
+		}
+	}
+	put_thread_offline();
+	while (goflag == GOFLAG_INIT)
+		(void) poll(NULL, 0, 1);
+	put_thread_online();
+	while (goflag == GOFLAG_RUN) {
+		for (i = me; i < RCU_LFHT_KEYS && goflag == GOFLAG_RUN;
+				i += RCU_LFHT_UPDATERS) {
+			key = rcu_lfht_key(i);
+			if (map[key] == fill)
+				continue;
+			rcu_read_lock();
+			if (fill) {
+				n = malloc(sizeof(*n));
+				if (!n)
+					abort();
+				cds_lfht_node_init(&n->node);
+				n->key = key;
+				n->alive = RCU_LFHT_ALIVE;
+				ret = cds_lfht_add_unique(rcu_lfht_table,
+						rcu_lfht_hash(key),
+						rcu_lfht_match, &key, &n->node);
+				if (ret != &n->node) {
+					/* Only this thread inserts this key. */
+					uatomic_inc(&n_lfht_error);
+					free(n);
+				} else {
+					map[key] = 1;
+					present++;
+				}
+			} else {
+				cds_lfht_lookup(rcu_lfht_table,
+						rcu_lfht_hash(key),
+						rcu_lfht_match, &key, &iter);
+				ret = cds_lfht_iter_get_node(&iter);
+				n = caa_container_of(ret,
+						struct rcu_lfht_node, node);
+				if (!ret || cds_lfht_del(rcu_lfht_table, ret)) {
+					/* Only this thread removes this key. */
+					uatomic_inc(&n_lfht_error);
+				} else {
+					(void) rcu_lfht_check(n, key);
+					call_rcu(&n->rcu, rcu_lfht_free_node);
+					map[key] = 0;
+					present--;
+				}
+			}
+			rcu_read_unlock();
+			n_updates_local++;
+			mark_rcu_quiescent_state();
+		}
+		if (i >= RCU_LFHT_KEYS)
+			fill = !fill;
+	}
+	__get_thread_var(n_updates_pt) += n_updates_local;
+	__get_thread_var(n_lfht_present_pt) = present;
+	/* The worker waits for a grace period before it stops. */
+	put_thread_offline();
+	if (callrcu_type == CALLRCU_PERTHREAD) {
+		struct call_rcu_data *crdp;
+
+		crdp = get_thread_call_rcu_data();
+		set_thread_call_rcu_data(NULL);
+		call_rcu_data_free(crdp);
+	}
+	rcu_unregister_thread();
+	free(map);
+
+	return NULL;
+}
+
+int lfhttest(int nreaders)
+{
+	struct cds_lfht_iter iter;
+	struct rcu_lfht_node *n;
+	unsigned long count, expected = 0;
+	long split;
+	int i;
+	int t;
+
+	init_per_thread(n_reads_pt, 0LL);
+	init_per_thread(n_updates_pt, 0LL);
+	init_per_thread(n_lfht_present_pt, 0L);
+	rcu_lfht_table = cds_lfht_new(1, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!rcu_lfht_table) {
+		diag("cds_lfht_new failed");
+		return -1;
+	}
+	for (i = 0; i < nreaders; i++)
+		create_thread(rcu_read_lfht_test, (void *)(long)i);
+	for (i = 0; i < RCU_LFHT_UPDATERS; i++)
+		create_thread(rcu_update_lfht_test, (void *)(long)i);
+	cmm_smp_mb();
+	goflag = GOFLAG_RUN;
+	cmm_smp_mb();
+	sleep(RCU_LFHT_DURATION);
+	cmm_smp_mb();
+	goflag = GOFLAG_STOP;
+	cmm_smp_mb();
+	wait_all_threads();
+	for_each_thread(t) {
+		n_reads += per_thread(n_reads_pt, t);
+		n_updates += per_thread(n_updates_pt, t);
+		expected += per_thread(n_lfht_present_pt, t);
+	}
+
+	/* Quiescent table: the node count must match the updaters' maps. */
+	rcu_register_thread();
+	rcu_read_lock();
+	cds_lfht_count_nodes(rcu_lfht_table, &split, &count, &split);
+	if (count != expected) {
+		diag("cds_lfht_count_nodes: %lu nodes, expected %lu",
+			count, expected);
+		n_lfht_error++;
+	}
+	cds_lfht_for_each_entry(rcu_lfht_table, &iter, n, node) {
+		if (!cds_lfht_del(rcu_lfht_table, &n->node))
+			call_rcu(&n->rcu, rcu_lfht_free_node);
+	}
+	rcu_read_unlock();
+	rcu_barrier();
+	put_thread_offline();
+	rcu_unregister_thread();
+	if (cds_lfht_destroy(rcu_lfht_table, NULL)) {
+		diag("cds_lfht_destroy failed");
+		n_lfht_error++;
+	}
+
+	diag("n_reads: %lld  n_updates: %ld  n_lfht_error: %d  nreaders: %d  nupdaters: %d duration: %d",
+	       n_reads, n_updates, n_lfht_error, nreaders,
+	       RCU_LFHT_UPDATERS, RCU_LFHT_DURATION);
+	diag("ns/lookup: %g  ns/update: %g",
+	       ((RCU_LFHT_DURATION * 1000*1000*1000.*(double)nreaders) /
+	        (double)n_reads),
+	       ((RCU_LFHT_DURATION * 1000*1000*1000.*(double)RCU_LFHT_UPDATERS) /
+	        (double)n_updates));
+	if (get_cpu_call_rcu_data(0)) {
+		diag("Deallocating per-CPU call_rcu threads.");
+		free_all_cpu_call_rcu_data();
+	}
+	if (!n_lfht_error)
+		return 0;
+	else
+		return -1;
+}
+
+/*
+ * call_rcu() flood test.
+ *
+ * Flooders queue callbacks as fast as they can while readers keep
+ * grace periods busy.  Each callback measures the time elapsed since
+ * its call_rcu(), and the flooders track how many callbacks are
+ * outstanding, which together give the worst-case reclamation lag
+ * and the memory high-water mark of the flavor and call_rcu worker
+ * configuration under test.  Flooders back off once
+ * RCU_FLOOD_MAX_OUTSTANDING callbacks are pending so that a stalled
+ * worker shows up as throttling rather than as an OOM kill.
+ */
+
+#define RCU_FLOOD_FLOODERS		2
+#define RCU_FLOOD_BATCH			100
+#define RCU_FLOOD_MAX_OUTSTANDING	(1UL << 20)
+#define RCU_FLOOD_DURATION		5
+#define RCU_FLOOD_MAGIC			0xf100d0UL
+
+struct rcu_flood {
+	struct rcu_head head;
+	unsigned long magic;
+	unsigned long long enqueue_ns;
+};
+
+unsigned long rcu_flood_outstanding;
+unsigned long rcu_flood_high_water;
+unsigned long rcu_flood_callbacks;
+unsigned long rcu_flood_max_lag_us;
+unsigned long rcu_flood_lag_sum_us;
+int n_flood_error = 0;
+DEFINE_PER_THREAD(long long, n_flood_throttle_pt);
+
+static unsigned long long rcu_flood_now_ns(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void rcu_flood_max(unsigned long *max, unsigned long v)
+{
+	unsigned long old = uatomic_read(max);
+
+	while (v > old) {
+		unsigned long prev = uatomic_cmpxchg(max, old, v);
+
+		if (prev == old)
+			break;
+		old = prev;
+	}
+}
+
+void rcu_flood_cb(struct rcu_head *head)
+{
+	struct rcu_flood *f = caa_container_of(head, struct rcu_flood, head);
+	unsigned long lag_us;
+
+	lag_us = (rcu_flood_now_ns() - f->enqueue_ns) / 1000;
+	if (f->magic != RCU_FLOOD_MAGIC)
+		uatomic_inc(&n_flood_error);
+	f->magic = 0;
+	free(f);
+	rcu_flood_max(&rcu_flood_max_lag_us, lag_us);
+	uatomic_add(&rcu_flood_lag_sum_us, lag_us);
+	uatomic_inc(&rcu_flood_callbacks);
+	uatomic_dec(&rcu_flood_outstanding);
+}
+
+void *rcu_flood_test(void *arg)
+{
+	struct rcu_flood *f;
+	long long n_updates_local = 0;
+	long long n_throttle_local = 0;
+	unsigned long outstanding;
+	int i;
+
+	rcu_register_thread();
+	if (callrcu_type == CALLRCU_PERTHREAD) {
+		struct call_rcu_data *crdp;
+
+		crdp = create_call_rcu_data(0, -1);
+		if (crdp != NULL) {
+			diag("Successfully using per-thread call_rcu() worker.");
+			set_thread_call_rcu_data(crdp);
+		}
+	}
+	put_thread_offline();
+	while (goflag == GOFLAG_INIT)
+		(void) poll(NULL, 0, 1);
+	put_thread_online();
+	while (goflag == GOFLAG_RUN) {
+		if (uatomic_read(&rcu_flood_outstanding)
+				>= RCU_FLOOD_MAX_OUTSTANDING) {
+			n_throttle_local++;
+			put_thread_offline();
+			(void) poll(NULL, 0, 1);
+			put_thread_online();
+			continue;
+		}
+		for (i = 0; i < RCU_FLOOD_BATCH; i++) {
+			f = malloc(sizeof(*f));
+			if (!f)
+				abort();
+			f->magic = RCU_FLOOD_MAGIC;
+			f->enqueue_ns = rcu_flood_now_ns();
+			outstanding = uatomic_add_return(&rcu_flood_outstanding, 1);
+			rcu_flood_max(&rcu_flood_high_water, outstanding);
+			call_rcu(&f->head, rcu_flood_cb);
+		}
+		n_updates_local += RCU_FLOOD_BATCH;
+		mark_rcu_quiescent_state();
+	}
+	__get_thread_var(n_updates_pt) += n_updates_local;
+	__get_thread_var(n_flood_throttle_pt) += n_throttle_local;
+	/* The worker waits for a grace period before it stops. */
+	put_thread_offline();
+	if (callrcu_type == CALLRCU_PERTHREAD) {
+		struct call_rcu_data *crdp;
+
+		crdp = get_thread_call_rcu_data();
+		set_thread_call_rcu_data(NULL);
+		call_rcu_data_free(crdp);
+	}
+	rcu_unregister_thread();
+
+	return NULL;
+}
+
+int floodtest(int nreaders)
+{
+	long long n_throttle = 0;
+	int i;
+	int t;
+
+	perftestinit();
+	init_per_thread(n_flood_throttle_pt, 0LL);
+	for (i = 0; i < nreaders; i++)
+		create_thread(rcu_read_perf_test, (void *)(long)i);
+	for (i = 0; i < RCU_FLOOD_FLOODERS; i++)
+		create_thread(rcu_flood_test, NULL);
+	cmm_smp_mb();
+	while (uatomic_read(&nthreadsrunning) < nreaders)
+		(void) poll(NULL, 0, 1);
+	goflag = GOFLAG_RUN;
+	cmm_smp_mb();
+	sleep(RCU_FLOOD_DURATION);
+	cmm_smp_mb();
+	goflag = GOFLAG_STOP;
+	cmm_smp_mb();
+	wait_all_threads();
+	for_each_thread(t) {
+		n_reads += per_thread(n_reads_pt, t);
+		n_updates += per_thread(n_updates_pt, t);
+		n_throttle += per_thread(n_flood_throttle_pt, t);
+	}
+
+	/* The lag of the callbacks still queued counts towards the maximum. */
+	rcu_register_thread();
+	rcu_barrier();
+	put_thread_offline();
+	rcu_unregister_thread();
+	if (uatomic_read(&rcu_flood_callbacks) != (unsigned long)n_updates
+			|| uatomic_read(&rcu_flood_outstanding)) {
+		diag("%lu callbacks invoked, %ld queued, %lu outstanding",
+			uatomic_read(&rcu_flood_callbacks), n_updates,
+			uatomic_read(&rcu_flood_outstanding));
+		n_flood_error++;
+	}
+
+	diag("n_reads: %lld  n_callbacks: %ld  n_throttle: %lld  n_flood_error: %d  nreaders: %d  nflooders: %d duration: %d",
+	       n_reads, n_updates, n_throttle, n_flood_error, nreaders,
+	       RCU_FLOOD_FLOODERS, RCU_FLOOD_DURATION);
+	diag("ns/call_rcu: %g  max_lag_us: %lu  mean_lag_us: %g  high_water: %lu callbacks (%lu bytes)",
+	       ((RCU_FLOOD_DURATION * 1000*1000*1000.*(double)RCU_FLOOD_FLOODERS) /
+	        (double)n_updates),
+	       rcu_flood_max_lag_us,
+	       (double)rcu_flood_lag_sum_us / (double)n_updates,
+	       rcu_flood_high_water,
+	       rcu_flood_high_water * (unsigned long)sizeof(struct rcu_flood));
+	if (get_cpu_call_rcu_data(0)) {
+		diag("Deallocating per-CPU call_rcu threads.");
+		free_all_cpu_call_rcu_data();
+	}
+	if (!n_flood_error)
+		return 0;
+	else
+		return -1;
+}
+
 /*
  * Mainprogram.
  */
 
 void usage(int argc, char *argv[])
 {
-	diag("Usage: %s nreaders [ perf | rperf | uperf | stress ] [ stride ] [ callrcu_global | callrcu_percpu | callrcu_perthread ]\n", argv[0]);
+	diag("Usage: %s nreaders [ perf | rperf | uperf | stress | lfht | flood ] [ stride ] [ callrcu_global | callrcu_percpu | callrcu_perthread ]\n", argv[0]);
 	exit(-1);
 }
 
@@ -602,6 +1109,12 @@ int main(int argc, char *argv[])
 			ok(!stresstest(nreaders),
 				"stresstest readers: %d, stride: %d",
 				nreaders, cpustride);
+		else if (strcmp(argv[2], "lfht") == 0)
+			ok(!lfhttest(nreaders),
+				"lfhttest readers: %d", nreaders);
+		else if (strcmp(argv[2], "flood") == 0)
+			ok(!floodtest(nreaders),
+				"floodtest readers: %d", nreaders);
 		else
 			usage(argc, argv);
 	} else {
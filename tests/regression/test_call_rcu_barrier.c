@@ -0,0 +1,765 @@
+/*
+ * test_call_rcu_barrier.c
+ *
+ * Userspace RCU library - test program (rcu_barrier and call_rcu modes)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Each test has threads queue rounds of callbacks, end each round with
+ * a barrier, and check that every callback they queued before it was
+ * invoked by the time it returns.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_TESTS	43
+
+#define NR_THREADS	4
+
+struct test_obj {
+	/* Only call_rcu_tagged() uses more than its rcu_head. */
+	struct rcu_tagged_head head;
+	unsigned long *count;
+};
+
+struct barrier_test {
+	/* Assigned to the threads with set_thread_call_rcu_data(). */
+	struct call_rcu_data *crdp;
+	/* Assigned instead of crdp to every other thread, if set. */
+	struct call_rcu_data *alt_crdp;
+	/* Queue the i-th callback of a round. */
+	void (*queue)(struct test_obj *obj, unsigned int i);
+	void (*barrier)(const struct barrier_test *t);
+	unsigned int nr_threads, nr_rounds, nr_callbacks;
+};
+
+/* Busy loop iterations of each callback, to let the queues fill up. */
+static unsigned long cb_spin;
+
+/* Grace periods completed within the timeout of synchronize_rcu_timeout(). */
+static unsigned long nr_sync_in_time;
+
+struct barrier_thread {
+	const struct barrier_test *t;
+	struct call_rcu_data *crdp;
+	unsigned long nr_bad_rounds;
+};
+
+static void count_cb(struct rcu_head *head)
+{
+	struct test_obj *obj = caa_container_of(head, struct test_obj,
+			head.head);
+	unsigned long i;
+
+	for (i = 0; i < cb_spin; i++)
+		caa_cpu_relax();
+	uatomic_inc(obj->count);
+	free(obj);
+}
+
+static struct test_obj *obj_alloc(unsigned long *count)
+{
+	struct test_obj *obj = malloc(sizeof(*obj));
+
+	if (!obj)
+		abort();
+	obj->count = count;
+	return obj;
+}
+
+static void queue_call_rcu(struct test_obj *obj, unsigned int i)
+{
+	(void) i;
+	call_rcu(&obj->head.head, count_cb);
+}
+
+/* Queue every other callback on the expedited queue. */
+static void queue_call_rcu_expedited(struct test_obj *obj, unsigned int i)
+{
+	if (i & 1)
+		call_rcu_expedited(&obj->head.head, count_cb);
+	else
+		call_rcu(&obj->head.head, count_cb);
+}
+
+static void queue_call_rcu_lazy(struct test_obj *obj, unsigned int i)
+{
+	(void) i;
+	call_rcu_lazy(&obj->head.head, count_cb);
+}
+
+static void queue_call_rcu_local(struct test_obj *obj, unsigned int i)
+{
+	(void) i;
+	call_rcu_local(&obj->head.head, count_cb);
+}
+
+/*
+ * Free right away once the grace period completed within the timeout,
+ * reclaim with call_rcu() otherwise.
+ */
+static void queue_synchronize_timeout(struct test_obj *obj, unsigned int i)
+{
+	struct timespec timeout = { 0, (i & 1) ? 1000 : 1000000 };
+
+	if (!synchronize_rcu_timeout(&timeout, &obj->head.head, count_cb)) {
+		count_cb(&obj->head.head);
+		uatomic_inc(&nr_sync_in_time);
+	}
+}
+
+static struct call_rcu_tag test_tag = CALL_RCU_TAG_INIT;
+
+static void queue_call_rcu_tagged(struct test_obj *obj, unsigned int i)
+{
+	(void) i;
+	call_rcu_tagged(&obj->head, count_cb, &test_tag);
+}
+
+static void bulk_free(void *ptr)
+{
+	struct test_obj *obj = ptr;
+
+	uatomic_inc(obj->count);
+	free(obj);
+}
+
+static void queue_free_rcu_bulk(struct test_obj *obj, unsigned int i)
+{
+	(void) i;
+	free_rcu_bulk(obj, bulk_free);
+}
+
+static void barrier_default(const struct barrier_test *t)
+{
+	(void) t;
+	rcu_barrier();
+}
+
+static void barrier_crdp(const struct barrier_test *t)
+{
+	rcu_barrier_crdp(t->crdp);
+}
+
+static void barrier_tag(const struct barrier_test *t)
+{
+	(void) t;
+	rcu_barrier_tag(&test_tag);
+}
+
+static void barrier_bulk(const struct barrier_test *t)
+{
+	(void) t;
+	free_rcu_bulk_flush();
+	rcu_barrier();
+}
+
+static void barrier_local(const struct barrier_test *t)
+{
+	(void) t;
+	call_rcu_flush();
+	rcu_barrier();
+}
+
+static void barrier_async_poll(const struct barrier_test *t)
+{
+	struct call_rcu_completion *completion;
+
+	(void) t;
+	completion = rcu_barrier_async();
+	while (!rcu_barrier_poll(completion))
+		(void) poll(NULL, 0, 1);
+	rcu_barrier_wait(completion);
+}
+
+/* Overlapping barriers, waited for in reverse order. */
+static void barrier_async_overlap(const struct barrier_test *t)
+{
+	struct call_rcu_completion *first, *second;
+
+	(void) t;
+	first = rcu_barrier_async();
+	second = rcu_barrier_async();
+	rcu_barrier_wait(second);
+	rcu_barrier_wait(first);
+}
+
+static void *thr_barrier(void *arg)
+{
+	struct barrier_thread *bt = arg;
+	const struct barrier_test *t = bt->t;
+	unsigned long invoked = 0, queued = 0;
+	unsigned int round, i;
+
+	rcu_register_thread();
+	if (bt->crdp)
+		set_thread_call_rcu_data(bt->crdp);
+	for (round = 0; round < t->nr_rounds; round++) {
+		for (i = 0; i < t->nr_callbacks; i++) {
+			t->queue(obj_alloc(&invoked), i);
+			queued++;
+		}
+		t->barrier(t);
+		if (uatomic_read(&invoked) != queued)
+			bt->nr_bad_rounds++;
+	}
+	if (bt->crdp)
+		set_thread_call_rcu_data(NULL);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Return the number of rounds whose barrier returned too early. */
+static unsigned long run_barrier_test(const struct barrier_test *t)
+{
+	struct barrier_thread bt[NR_THREADS];
+	pthread_t threads[NR_THREADS];
+	unsigned long nr_bad = 0;
+	unsigned int i;
+
+	for (i = 0; i < t->nr_threads; i++) {
+		bt[i].t = t;
+		bt[i].crdp = (t->alt_crdp && (i & 1)) ? t->alt_crdp : t->crdp;
+		bt[i].nr_bad_rounds = 0;
+		if (pthread_create(&threads[i], NULL, thr_barrier, &bt[i]))
+			abort();
+	}
+	for (i = 0; i < t->nr_threads; i++) {
+		if (pthread_join(threads[i], NULL))
+			abort();
+		nr_bad += bt[i].nr_bad_rounds;
+	}
+	return nr_bad;
+}
+
+static void test_backpressure(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.barrier = barrier_default,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 100,
+	};
+
+	cb_spin = 20000;
+	t.crdp = create_call_rcu_data(0, -1);
+	call_rcu_data_set_watermarks(t.crdp, 32, 8,
+		URCU_CALL_RCU_BACKPRESSURE_THROTTLE);
+	ok(!run_barrier_test(&t), "barrier with throttled callers");
+	call_rcu_data_free(t.crdp);
+
+	t.crdp = create_call_rcu_data(0, -1);
+	call_rcu_data_set_watermarks(t.crdp, 32, 8,
+		URCU_CALL_RCU_BACKPRESSURE_HELP);
+	ok(!run_barrier_test(&t), "barrier with callers helping");
+	call_rcu_data_free(t.crdp);
+
+	/* The default call_rcu_data queues on per-CPU sub-queues otherwise. */
+	t.crdp = get_default_call_rcu_data();
+	call_rcu_data_set_watermarks(t.crdp, 32, 8,
+		URCU_CALL_RCU_BACKPRESSURE_HELP);
+	ok(!run_barrier_test(&t),
+		"barrier with callers helping the default call_rcu_data");
+	call_rcu_data_set_watermarks(t.crdp, 0, 0,
+		URCU_CALL_RCU_BACKPRESSURE_HELP);
+}
+
+/* Batch pointers, then exit without flushing them. */
+static void *thr_bulk_unregister(void *arg)
+{
+	unsigned long i;
+
+	rcu_register_thread();
+	for (i = 0; i < 100; i++)
+		free_rcu_bulk(obj_alloc(arg), bulk_free);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_free_rcu_bulk(void)
+{
+	struct barrier_test t = {
+		.queue = queue_free_rcu_bulk,
+		.barrier = barrier_bulk,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 100,
+		/* A full batch of pointers, and one left for the flush. */
+		.nr_callbacks = 1000,
+	};
+	unsigned long invoked = 0;
+	pthread_t thread;
+	int err;
+
+	cb_spin = 0;
+	ok(!run_barrier_test(&t), "barrier after flushing bulk frees");
+	err = pthread_create(&thread, NULL, thr_bulk_unregister, &invoked);
+	if (!err)
+		err = pthread_join(thread, NULL);
+	rcu_barrier();
+	ok(!err && uatomic_read(&invoked) == 100,
+		"barrier after bulk frees flushed by unregistration");
+}
+
+/*
+ * The callbacks stolen by the idle thief are waited for by the barriers
+ * of the call_rcu_data they were queued on.
+ */
+static void test_steal(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 5,
+		.nr_callbacks = 5000,
+	};
+	struct call_rcu_data_stats stats;
+	struct call_rcu_data *thief;
+
+	cb_spin = 500;
+	t.crdp = create_call_rcu_data(URCU_CALL_RCU_STEAL, -1);
+	thief = create_call_rcu_data(URCU_CALL_RCU_STEAL, -1);
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t), "barrier with a thief");
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t), "barrier of the robbed call_rcu_data");
+	call_rcu_data_get_stats(thief, &stats);
+	diag("%lu callbacks invoked by the thief", stats.invoked);
+	call_rcu_data_free(thief);
+	call_rcu_data_free(t.crdp);
+}
+
+/*
+ * The grace periods of the callbacks of both call_rcu_data are run by
+ * the shared driver thread.
+ */
+static void test_shared_gp(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+	struct call_rcu_data *alt_crdp;
+
+	cb_spin = 0;
+	t.crdp = create_call_rcu_data(URCU_CALL_RCU_SHARED_GP, -1);
+	alt_crdp = create_call_rcu_data(URCU_CALL_RCU_SHARED_GP, -1);
+	t.alt_crdp = alt_crdp;
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t), "barrier with shared grace periods");
+	/* rcu_barrier_crdp() only waits for the call_rcu_data of t.crdp. */
+	t.alt_crdp = NULL;
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t),
+		"barrier of a call_rcu_data with shared grace periods");
+	call_rcu_data_free(alt_crdp);
+	call_rcu_data_free(t.crdp);
+}
+
+static int event_loop_stop;
+
+/* Invoke the ready callbacks of the URCU_CALL_RCU_EVENTFD handle. */
+static void *thr_event_loop(void *arg)
+{
+	struct call_rcu_data *crdp = arg;
+	struct pollfd pfd = {
+		.fd = call_rcu_data_get_fd(crdp),
+		.events = POLLIN,
+	};
+
+	rcu_register_thread();
+	while (!uatomic_read(&event_loop_stop)) {
+		if (poll(&pfd, 1, 10) > 0)
+			(void) call_rcu_process_ready(crdp, 64);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_eventfd(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+	pthread_t loop;
+
+	cb_spin = 0;
+	t.crdp = create_call_rcu_data(URCU_CALL_RCU_EVENTFD, -1);
+	if (pthread_create(&loop, NULL, thr_event_loop, t.crdp))
+		abort();
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t), "barrier with an event loop");
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t),
+		"barrier of a call_rcu_data processed by an event loop");
+	uatomic_set(&event_loop_stop, 1);
+	if (pthread_join(loop, NULL))
+		abort();
+	call_rcu_data_free(t.crdp);
+}
+
+/*
+ * A batch is accounted once invoked, possibly after the barrier waiting
+ * for it returned: the second barrier waits for a later batch, so the
+ * statistics then account for all callbacks the threads queued.
+ */
+static void test_stats(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.barrier = barrier_crdp,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+	struct call_rcu_data_stats before, after;
+	unsigned long nr_queued;
+
+	cb_spin = 0;
+	nr_queued = (unsigned long) t.nr_threads * t.nr_rounds * t.nr_callbacks;
+	t.crdp = create_call_rcu_data(0, -1);
+	call_rcu_data_get_stats(t.crdp, &before);
+	ok(!run_barrier_test(&t), "barrier of a call_rcu_data");
+	rcu_barrier_crdp(t.crdp);
+	call_rcu_data_get_stats(t.crdp, &after);
+	ok(after.invoked - before.invoked >= nr_queued
+		&& after.enqueued - before.enqueued >= nr_queued,
+		"statistics account for the callbacks waited for");
+	ok(after.grace_periods > before.grace_periods
+		&& after.batches > before.batches,
+		"statistics account for batches and grace periods");
+	call_rcu_data_free(t.crdp);
+}
+
+/* Batches larger than a chunk are invoked in parallel by the helpers. */
+static void test_helpers(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+
+	cb_spin = 200;
+	t.crdp = create_call_rcu_data(0, -1);
+	ok(!call_rcu_data_set_helpers(t.crdp, 3), "attach helpers");
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t), "barrier with helpers");
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t), "barrier of a call_rcu_data with helpers");
+	call_rcu_data_free(t.crdp);
+}
+
+static void test_expedited(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu_expedited,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+
+	cb_spin = 0;
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t),
+		"barrier with expedited callbacks on the default call_rcu_data");
+	t.crdp = create_call_rcu_data(0, -1);
+	ok(!run_barrier_test(&t), "barrier with expedited callbacks");
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t),
+		"barrier of a call_rcu_data with expedited callbacks");
+	call_rcu_data_free(t.crdp);
+
+	t.crdp = create_call_rcu_data(URCU_CALL_RCU_SHARED_GP, -1);
+	ok(!run_barrier_test(&t),
+		"barrier with expedited callbacks and shared grace periods");
+	call_rcu_data_free(t.crdp);
+}
+
+/* The tagged callbacks are queued on two call_rcu_data. */
+static void test_tagged(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu_tagged,
+		.barrier = barrier_tag,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+
+	cb_spin = 0;
+	t.crdp = create_call_rcu_data(0, -1);
+	t.alt_crdp = get_default_call_rcu_data();
+	ok(!run_barrier_test(&t), "barrier of a callback tag");
+	t.alt_crdp = NULL;
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t), "barrier with tagged callbacks");
+	call_rcu_data_free(t.crdp);
+}
+
+/*
+ * The per-CPU helper threads are created by call_rcu(), and exit when
+ * idle for 10ms, e.g. between the two runs.
+ */
+static void test_lazy_cpu(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.barrier = barrier_default,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+	int ret;
+
+	cb_spin = 0;
+	ret = create_lazy_cpu_call_rcu_data(0, 10);
+	if (ret) {
+		skip(2, "lazy per-CPU call_rcu_data: %s", strerror(-ret));
+		return;
+	}
+	ok(!run_barrier_test(&t), "barrier with lazy per-CPU call_rcu_data");
+	(void) poll(NULL, 0, 100);
+	ok(!run_barrier_test(&t),
+		"barrier with lazy per-CPU call_rcu_data created again");
+	free_all_cpu_call_rcu_data();
+}
+
+/*
+ * The barriers only wait for the grace period of the lazy callbacks,
+ * not for the lazy delay, which would last the whole test run.
+ */
+static void test_lazy(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu_lazy,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+
+	cb_spin = 0;
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t),
+		"barrier with lazy callbacks on the default call_rcu_data");
+	t.crdp = create_call_rcu_data(0, -1);
+	ok(!run_barrier_test(&t), "barrier with lazy callbacks");
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t),
+		"barrier of a call_rcu_data with lazy callbacks");
+	/* Lazy callbacks are processed once a few are queued. */
+	ok(!call_rcu_data_set_lazy(t.crdp, 100, 16), "set the lazy limits");
+	ok(!run_barrier_test(&t),
+		"barrier with lazy callbacks past their queue limit");
+	ok(!call_rcu_data_set_lazy(t.crdp, 0, 10000),
+		"disable the lazy delay");
+	ok(!run_barrier_test(&t), "barrier with lazy callbacks without delay");
+	call_rcu_data_free(t.crdp);
+}
+
+/* Stage callbacks, then exit without flushing them. */
+static void *thr_local_unregister(void *arg)
+{
+	unsigned long i;
+
+	rcu_register_thread();
+	for (i = 0; i < 10; i++)
+		call_rcu_local(&obj_alloc(arg)->head.head, count_cb);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_local(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu_local,
+		.barrier = barrier_local,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		/* Full batches of staged callbacks, and some left to flush. */
+		.nr_callbacks = 500,
+	};
+	unsigned long invoked = 0;
+	pthread_t thread;
+	int err;
+
+	cb_spin = 0;
+	ok(!run_barrier_test(&t), "barrier after flushing staged callbacks");
+	t.crdp = create_call_rcu_data(0, -1);
+	ok(!run_barrier_test(&t),
+		"barrier after flushing callbacks staged for a call_rcu_data");
+	call_rcu_data_free(t.crdp);
+	err = pthread_create(&thread, NULL, thr_local_unregister, &invoked);
+	if (!err)
+		err = pthread_join(thread, NULL);
+	rcu_barrier();
+	ok(!err && uatomic_read(&invoked) == 10,
+		"barrier after staged callbacks flushed by unregistration");
+}
+
+static void test_async(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+
+	cb_spin = 0;
+	t.barrier = barrier_async_poll;
+	ok(!run_barrier_test(&t), "polled asynchronous barrier");
+	t.barrier = barrier_async_overlap;
+	ok(!run_barrier_test(&t), "overlapping asynchronous barriers");
+	t.crdp = create_call_rcu_data(0, -1);
+	t.barrier = barrier_async_poll;
+	ok(!run_barrier_test(&t),
+		"polled asynchronous barrier with a call_rcu_data");
+	call_rcu_data_free(t.crdp);
+}
+
+static int reader_stop;
+
+/* Delay grace periods past the shorter timeout. */
+static void *thr_long_reader(void *arg)
+{
+	(void) arg;
+	rcu_register_thread();
+	while (!uatomic_read(&reader_stop)) {
+		rcu_read_lock();
+		(void) poll(NULL, 0, 1);
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_synchronize_timeout(void)
+{
+	struct barrier_test t = {
+		.queue = queue_synchronize_timeout,
+		.barrier = barrier_default,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 10,
+		.nr_callbacks = 20,
+	};
+	unsigned long nr = (unsigned long) t.nr_threads * t.nr_rounds
+		* t.nr_callbacks;
+	pthread_t reader;
+
+	cb_spin = 0;
+	if (pthread_create(&reader, NULL, thr_long_reader, NULL))
+		abort();
+	ok(!run_barrier_test(&t),
+		"barrier after synchronize_rcu_timeout() fallbacks");
+	t.crdp = create_call_rcu_data(0, -1);
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t), "barrier of a call_rcu_data after "
+		"synchronize_rcu_timeout() fallbacks");
+	call_rcu_data_free(t.crdp);
+	diag("%lu of %lu grace periods completed within the timeout",
+		uatomic_read(&nr_sync_in_time), 2 * nr);
+	uatomic_set(&reader_stop, 1);
+	if (pthread_join(reader, NULL))
+		abort();
+}
+
+/*
+ * Expedited callbacks are invoked by the helper thread, the others by
+ * the node workers, or by a single worker without NUMA support.
+ */
+static void test_numa(void)
+{
+	struct barrier_test t = {
+		.queue = queue_call_rcu_expedited,
+		.nr_threads = NR_THREADS,
+		.nr_rounds = 20,
+		.nr_callbacks = 500,
+	};
+	int ret;
+
+	cb_spin = 0;
+	t.crdp = create_call_rcu_data(URCU_CALL_RCU_NUMA, -1);
+	t.barrier = barrier_default;
+	ok(!run_barrier_test(&t), "barrier with node workers");
+	t.barrier = barrier_crdp;
+	ok(!run_barrier_test(&t),
+		"barrier of a call_rcu_data with node workers");
+	call_rcu_data_free(t.crdp);
+
+	t.crdp = NULL;
+	t.barrier = barrier_default;
+	ret = create_all_node_call_rcu_data(0);
+	if (ret) {
+		skip(1, "per-node call_rcu_data: %s", strerror(-ret));
+		return;
+	}
+	ok(!run_barrier_test(&t), "barrier with per-node call_rcu_data");
+	free_all_cpu_call_rcu_data();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	diag("backpressure");
+	test_backpressure();
+	diag("bulk frees");
+	test_free_rcu_bulk();
+	diag("work stealing");
+	test_steal();
+	diag("shared grace periods");
+	test_shared_gp();
+	diag("event loop");
+	test_eventfd();
+	diag("statistics");
+	test_stats();
+	diag("helpers");
+	test_helpers();
+	diag("expedited callbacks");
+	test_expedited();
+	diag("tagged callbacks");
+	test_tagged();
+	diag("lazy per-CPU call_rcu_data");
+	test_lazy_cpu();
+	diag("lazy callbacks");
+	test_lazy();
+	diag("staged callbacks");
+	test_local();
+	diag("asynchronous barriers");
+	test_async();
+	diag("grace periods with a timeout");
+	test_synchronize_timeout();
+	diag("NUMA nodes");
+	test_numa();
+
+	return exit_status();
+}
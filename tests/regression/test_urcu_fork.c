@@ -40,7 +40,38 @@
 #else
 #define rcu_debug_yield_read()
 #endif
+#if defined(RCU_PERCPU)
+#include <urcu-percpu.h>
+#define test_before_fork()			\
+	do {					\
+		call_rcu_before_fork();		\
+		rcu_percpu_before_fork();	\
+	} while (0)
+#define test_after_fork_parent()		\
+	do {					\
+		rcu_percpu_after_fork_parent();	\
+		call_rcu_after_fork_parent();	\
+	} while (0)
+#define test_after_fork_child()			\
+	do {					\
+		rcu_percpu_after_fork_child();	\
+		call_rcu_after_fork_child();	\
+	} while (0)
+#elif defined(RCU_EBR)
+#include <urcu-ebr.h>
+/* Callbacks are invoked by the threads queuing them, not by workers. */
+#define test_before_fork()		rcu_ebr_before_fork()
+#define test_after_fork_parent()	rcu_ebr_after_fork_parent()
+#define test_after_fork_child()		rcu_ebr_after_fork_child()
+#else
+/* The domains are only built in the default flavor library. */
+#define TEST_DOMAINS
 #include <urcu.h>
+#include <urcu/srcu.h>
+#define test_before_fork()		call_rcu_before_fork()
+#define test_after_fork_parent()	call_rcu_after_fork_parent()
+#define test_after_fork_child()		call_rcu_after_fork_child()
+#endif
 
 #include "tap.h"
 
@@ -53,6 +84,13 @@
 
 static int fork_generation;
 
+#ifdef TEST_DOMAINS
+/* Its worker thread is recreated in the children. */
+static struct rcu_domain *domain;
+
+static struct srcu_domain *srcu_domain;
+#endif
+
 /*
  * Only print diagnostic for top level parent process, else the console
  * has trouble formatting the tap output.
@@ -77,12 +115,54 @@ static void cb(struct rcu_head *head)
 	free(node);
 }
 
+#ifdef TEST_DOMAINS
+static void test_rcu_domain(void)
+{
+	struct rcu_domain_reader *r;
+	struct test_node *node;
+
+	r = rcu_domain_register_thread(domain);
+	assert(r);
+	rcu_domain_read_lock(r);
+	rcu_domain_read_unlock(r);
+	synchronize_rcu_domain(domain);
+
+	node = malloc(sizeof(*node));
+	assert(node);
+
+	call_rcu_domain(domain, &node->head, cb);
+	rcu_barrier_domain(domain);
+
+	rcu_domain_unregister_thread(r);
+}
+
+static void test_srcu(void)
+{
+	int idx;
+
+	idx = srcu_read_lock(srcu_domain);
+	srcu_read_unlock(srcu_domain, idx);
+	synchronize_srcu(srcu_domain);
+}
+#else
+static void test_rcu_domain(void)
+{
+}
+
+static void test_srcu(void)
+{
+}
+#endif
+
 static void test_rcu(void)
 {
 	struct test_node *node;
 
 	rcu_register_thread();
 
+	test_rcu_domain();
+	test_srcu();
+
 	synchronize_rcu();
 
 	rcu_read_lock();
@@ -108,14 +188,14 @@ static int do_fork(const char *execname)
 	diag_gen0("%s parent pid: %d, before fork",
 		execname, (int) getpid());
 
-	call_rcu_before_fork();
+	test_before_fork();
 	pid = fork();
 	if (pid == 0) {
 		/* child */
 		fork_generation++;
 		tap_disable();
 
-		call_rcu_after_fork_child();
+		test_after_fork_child();
 		diag_gen0("%s child pid: %d, after fork",
 			execname, (int) getpid());
 		test_rcu();
@@ -128,7 +208,7 @@ static int do_fork(const char *execname)
 		int status;
 
 		/* parent */
-		call_rcu_after_fork_parent();
+		test_after_fork_parent();
 		diag_gen0("%s parent pid: %d, after fork",
 			execname, (int) getpid());
 		test_rcu();
@@ -169,6 +249,19 @@ int main(int argc, char **argv)
 
 	plan_tests(NR_TESTS);
 
+#ifdef TEST_DOMAINS
+	domain = rcu_domain_create();
+	if (!domain) {
+		perror("rcu_domain_create");
+		exit(EXIT_FAILURE);
+	}
+	srcu_domain = srcu_domain_create();
+	if (!srcu_domain) {
+		perror("srcu_domain_create");
+		exit(EXIT_FAILURE);
+	}
+#endif
+
 #if 0
 	/* pthread_atfork does not work with malloc/free in callbacks */
 	ret = pthread_atfork(call_rcu_before_fork,
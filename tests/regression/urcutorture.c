@@ -1,5 +1,6 @@
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
 #include <poll.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -23,7 +24,33 @@
 #ifdef RCU_BP
 #include <urcu-bp.h>
 #endif
+#ifdef RCU_PERCPU
+#include <urcu-percpu.h>
+#endif
+#ifdef RCU_EBR
+#include <urcu-ebr.h>
+/*
+ * Callbacks of this flavor are invoked by the threads queuing them:
+ * without call_rcu worker threads, callrcu_global is the only mode.
+ */
+#undef create_call_rcu_data
+#define create_call_rcu_data(flags, cpu_affinity) \
+	((struct call_rcu_data *) NULL)
+#undef get_thread_call_rcu_data
+#define get_thread_call_rcu_data()	((struct call_rcu_data *) NULL)
+#undef set_thread_call_rcu_data
+#define set_thread_call_rcu_data(crdp)	((void) (crdp))
+#undef call_rcu_data_free
+#define call_rcu_data_free(crdp)	((void) (crdp))
+#undef get_cpu_call_rcu_data
+#define get_cpu_call_rcu_data(cpu)	((struct call_rcu_data *) NULL)
+#undef free_all_cpu_call_rcu_data
+#define free_all_cpu_call_rcu_data()
+#undef create_all_cpu_call_rcu_data
+#define create_all_cpu_call_rcu_data(flags)	(errno = ENOSYS, -1)
+#endif
 
 #include <urcu/uatomic.h>
 #include <urcu/rculist.h>
+#include <urcu/rculfhash.h>
 #include "rcutorture.h"
@@ -0,0 +1,84 @@
+/*
+ * test_build_cxx.cpp
+ *
+ * Userspace RCU library - build the public headers as C++
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Public headers must stay valid C++: no C++ keyword as identifier, no
+ * implicit conversion from void pointers in inline functions.
+ */
+#include <urcu.h>
+#include <urcu-call-rcu.h>
+#include <urcu-defer.h>
+#include <urcu-flavor.h>
+#include <urcu-pointer.h>
+
+#include <urcu/alloc.h>
+#include <urcu/cds.h>
+#include <urcu/compiler.h>
+#include <urcu/debug.h>
+#include <urcu/eventcount.h>
+#include <urcu/futex.h>
+#include <urcu/gp-stats.h>
+#include <urcu/hash.h>
+#include <urcu/hazptr.h>
+#include <urcu/hlist.h>
+#include <urcu/lfstack.h>
+#include <urcu/list.h>
+#include <urcu/percpu-counter.h>
+#include <urcu/percpu-ref.h>
+#include <urcu/rcuarray.h>
+#include <urcu/rcucache.h>
+#include <urcu/rcuhlist.h>
+#include <urcu/rcuhtable.h>
+#include <urcu/rcuja.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfqueue.h>
+#include <urcu/rculfstack.h>
+#include <urcu/rculist.h>
+#include <urcu/rcuseqlock.h>
+#include <urcu/rcuskiplist.h>
+#include <urcu/rcuslab.h>
+#include <urcu/rcusnapshot.h>
+#include <urcu/ref.h>
+#include <urcu/ring.h>
+#include <urcu/shm-rcu.h>
+#include <urcu/srcu.h>
+#include <urcu/system.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/wfqueue.h>
+#include <urcu/wfstack.h>
+
+#include <urcu/cds_lfht.hpp>
+#include <urcu/hook.hpp>
+#include <urcu/lfstack.hpp>
+#include <urcu/urcu.hpp>
+#include <urcu/wfcqueue.hpp>
+
+extern "C" {
+#include "tap.h"
+}
+
+int main(void)
+{
+	plan_tests(1);
+	ok(1, "public headers build as C++");
+	return exit_status();
+}
@@ -0,0 +1,197 @@
+/*
+ * test_hazptr.c
+ *
+ * Userspace RCU library - test the hazard pointer domains
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/hazptr.h>
+
+#include "poison-obj.h"
+#include "tap.h"
+
+#define NR_TESTS	13
+
+#define NR_UPDATES	20000
+
+struct obj {
+	struct poison_obj poison;
+	struct cds_hazptr_head head;
+};
+
+static struct cds_hazptr_domain dom;
+static unsigned long nr_freed;
+static struct obj *gp;
+static int updater_done;
+
+static void obj_free(struct cds_hazptr_head *head)
+{
+	poison_obj_free(&caa_container_of(head, struct obj, head)->poison);
+	uatomic_inc(&nr_freed);
+}
+
+static struct obj *obj_alloc(void)
+{
+	return poison_obj_alloc(sizeof(struct obj));
+}
+
+static void retire(struct obj *o)
+{
+	cds_hazptr_retire(&dom, o, &o->head, obj_free);
+}
+
+/* Scan the retired objects now, and wait for the scan. */
+static void scan(void)
+{
+	cds_hazptr_domain_flush(&dom);
+	rcu_barrier();
+}
+
+static void test_protect(void)
+{
+	struct cds_hazptr *hp, *hp2;
+	struct obj *o, *p;
+
+	cds_hazptr_domain_init(&dom, 0);
+	hp = cds_hazptr_acquire(&dom);
+	ok1(hp);
+	cds_hazptr_release(hp);
+	hp2 = cds_hazptr_acquire(&dom);
+	ok(hp2 == hp, "released hazard pointer is reused");
+
+	o = obj_alloc();
+	retire(o);
+	scan();
+	ok(uatomic_read(&nr_freed) == 1, "unprotected object freed");
+
+	/* Protection without RCU read-side lock. */
+	rcu_assign_pointer(gp, obj_alloc());
+	p = cds_hazptr_protect(hp, &gp);
+	o = rcu_xchg_pointer(&gp, NULL);
+	ok1(o == p);
+	retire(o);
+	scan();
+	ok(uatomic_read(&nr_freed) == 1 && poison_obj_live(&p->poison),
+		"object protected by cds_hazptr_protect is kept");
+	cds_hazptr_clear(hp);
+	scan();
+	ok(uatomic_read(&nr_freed) == 2, "object freed once cleared");
+
+	/* Protection extending a RCU read-side critical section. */
+	rcu_assign_pointer(gp, obj_alloc());
+	rcu_read_lock();
+	p = rcu_dereference(gp);
+	cds_hazptr_set(hp, p);
+	rcu_read_unlock();
+	o = rcu_xchg_pointer(&gp, NULL);
+	retire(o);
+	scan();
+	ok(uatomic_read(&nr_freed) == 2 && poison_obj_live(&p->poison),
+		"object protected by cds_hazptr_set is kept");
+	cds_hazptr_release(hp);
+	scan();
+	ok(uatomic_read(&nr_freed) == 3, "object freed once released");
+	cds_hazptr_domain_destroy(&dom);
+}
+
+static void test_batch(void)
+{
+	int i;
+
+	uatomic_set(&nr_freed, 0);
+	cds_hazptr_domain_init(&dom, 4);
+	for (i = 0; i < 3; i++)
+		retire(obj_alloc());
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == 0, "partial batch is not scanned");
+	retire(obj_alloc());
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == 4, "full batch is scanned");
+	retire(obj_alloc());
+	cds_hazptr_domain_destroy(&dom);
+	ok(uatomic_read(&nr_freed) == 5, "destroy frees the retired objects");
+}
+
+/* Replace the object read by the reader, and retire the old one. */
+static void *thr_updater(void *arg)
+{
+	unsigned long i;
+	struct obj *old;
+
+	(void) arg;
+	rcu_register_thread();
+	for (i = 0; i < NR_UPDATES; i++) {
+		old = rcu_xchg_pointer(&gp, obj_alloc());
+		retire(old);
+	}
+	rcu_unregister_thread();
+	uatomic_set(&updater_done, 1);
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad = 0;
+	struct cds_hazptr *hp;
+	pthread_t updater;
+	struct obj *p;
+	int err;
+
+	uatomic_set(&nr_freed, 0);
+	cds_hazptr_domain_init(&dom, 16);
+	hp = cds_hazptr_acquire(&dom);
+	rcu_assign_pointer(gp, obj_alloc());
+	err = pthread_create(&updater, NULL, thr_updater, NULL);
+	while (!err && !uatomic_read(&updater_done)) {
+		p = cds_hazptr_protect(hp, &gp);
+		/* Long reader: let the updater run while protected. */
+		sched_yield();
+		if (!poison_obj_live(&p->poison))
+			nr_bad++;
+		cds_hazptr_clear(hp);
+	}
+	if (!err)
+		err = pthread_join(updater, NULL);
+	ok(!err && !nr_bad,
+		"protected objects are not freed under a long reader");
+	cds_hazptr_release(hp);
+	retire(rcu_xchg_pointer(&gp, NULL));
+	cds_hazptr_domain_destroy(&dom);
+	ok(uatomic_read(&nr_freed) == NR_UPDATES + 1,
+		"every retired object freed (%lu)", uatomic_read(&nr_freed));
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("protection of a single object");
+	test_protect();
+	diag("batches of retired objects");
+	test_batch();
+	diag("long reader concurrent with an updater");
+	test_concurrent();
+
+	rcu_unregister_thread();
+	poison_obj_free_all();
+	return exit_status();
+}
@@ -0,0 +1,252 @@
+/*
+ * test_lfht_add_hint.c
+ *
+ * Userspace RCU library - test the hinted add of the hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	8
+
+#define NR_KEYS		3000
+#define NR_ADDERS	2
+#define NR_ADDS		5000	/* Per adder. */
+
+static struct cds_lfht *ht;
+static int adders_done;
+
+/*
+ * Keys in increasing order have increasing bit-reversed hashes: they are
+ * added in split-order.
+ */
+static unsigned long hash_key(unsigned long key)
+{
+	unsigned long hash = 0;
+	unsigned int i;
+
+	for (i = 0; i < CAA_BITS_PER_LONG; i++) {
+		hash = (hash << 1) | (key & 1);
+		key >>= 1;
+	}
+	return hash;
+}
+
+/* Call with rcu_read_lock held. */
+static void add_hint(unsigned long key, struct cds_lfht_iter *hint)
+{
+	cds_lfht_add_hint(ht, hash_key(key), &lfht_entry_alloc(key)->node,
+		hint);
+}
+
+/* Count the nodes of @key. */
+static unsigned long nr_nodes(unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	unsigned long nr = 0;
+
+	rcu_read_lock();
+	cds_lfht_lookup(ht, hash_key(key), lfht_entry_match, &key, &iter);
+	while (cds_lfht_iter_get_node(&iter)) {
+		nr++;
+		cds_lfht_next_duplicate(ht, lfht_entry_match, &key, &iter);
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+/* Count the keys of [start, start + len) without a single node. */
+static unsigned long nr_not_once(unsigned long start, unsigned long len)
+{
+	unsigned long key, nr = 0;
+
+	for (key = start; key < start + len; key++) {
+		if (nr_nodes(key) != 1)
+			nr++;
+	}
+	return nr;
+}
+
+/* Count the nodes of the table not following their predecessor's key. */
+static unsigned long nr_out_of_order(unsigned long *nr_total)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long nr = 0, prev = 0, key;
+
+	*nr_total = 0;
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		key = lfht_entry_of(node)->key;
+		if ((*nr_total)++ && key < prev)
+			nr++;
+		prev = key;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void test_sequential(void)
+{
+	struct cds_lfht_iter hint;
+	struct cds_lfht_node *node;
+	unsigned long key, nr, nr_bad;
+
+	/* A single bucket: the keys are all in the chain of the hint. */
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	ok1(ht);
+	rcu_read_lock();
+	hint.node = NULL;
+	for (key = 0; key < NR_KEYS; key += 2)
+		add_hint(key, &hint);
+	node = cds_lfht_iter_get_node(&hint);
+	key = NR_KEYS - 2;
+	ok(node && lfht_entry_match(node, &key), "hint set on the added node");
+	rcu_read_unlock();
+	nr_bad = 0;
+	for (key = 0; key < NR_KEYS; key++) {
+		if (nr_nodes(key) != !(key & 1))
+			nr_bad++;
+	}
+	ok(!nr_bad && !nr_out_of_order(&nr) && nr == NR_KEYS / 2,
+		"keys added in split-order");
+
+	/* Odd keys precede the hint, left on the last even key. */
+	rcu_read_lock();
+	for (key = 1; key < NR_KEYS; key += 2)
+		add_hint(key, &hint);
+	rcu_read_unlock();
+	ok(!nr_not_once(0, NR_KEYS) && !nr_out_of_order(&nr) && nr == NR_KEYS,
+		"hints following the key fall back on the bucket");
+
+	rcu_read_lock();
+	key = NR_KEYS;
+	add_hint(key, &hint);
+	add_hint(key, &hint);
+	rcu_read_unlock();
+	ok(nr_nodes(key) == 2, "duplicates added after the hint");
+
+	/* Remove the hint before each add. */
+	rcu_read_lock();
+	for (key = NR_KEYS + 1; key < NR_KEYS + 100; key++) {
+		add_hint(key, &hint);
+		node = cds_lfht_iter_get_node(&hint);
+		lfht_entry_del(ht, node);
+	}
+	add_hint(key, &hint);
+	rcu_read_unlock();
+	ok(!nr_nodes(NR_KEYS + 1) && nr_nodes(key) == 1
+		&& !nr_out_of_order(&nr) && nr == NR_KEYS + 3,
+		"removed hints fall back on the bucket");
+	lfht_entry_destroy(ht);
+}
+
+/* Add the keys of the adder, interleaved with those of the others. */
+static void *thr_adder(void *arg)
+{
+	unsigned long i, first = (unsigned long) arg;
+	struct cds_lfht_iter hint;
+
+	rcu_register_thread();
+	hint.node = NULL;
+	for (i = 0; i < NR_ADDS; i++) {
+		rcu_read_lock();
+		add_hint(first + i * NR_ADDERS, &hint);
+		rcu_read_unlock();
+		/* Only valid within a critical section, or if not removed. */
+		if (!((first + i * NR_ADDERS) % 3))
+			hint.node = NULL;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Remove the keys multiple of 3 as they appear. */
+static void *thr_remover(void *arg)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long *nr_removed = arg;
+	int done;
+
+	rcu_register_thread();
+	do {
+		done = uatomic_read(&adders_done);
+		rcu_read_lock();
+		cds_lfht_for_each(ht, &iter, node) {
+			if (lfht_entry_of(node)->key % 3)
+				continue;
+			if (!cds_lfht_del(ht, node)) {
+				call_rcu(&lfht_entry_of(node)->rcu_head,
+					lfht_entry_free);
+				(*nr_removed)++;
+			}
+		}
+		rcu_read_unlock();
+	} while (!done);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t adders[NR_ADDERS], remover;
+	unsigned long i, key, nr, nr_removed = 0, nr_bad = 0;
+	int err = 0;
+
+	ht = cds_lfht_new(1, 1, 0,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!ht)
+		abort();
+	err |= pthread_create(&remover, NULL, thr_remover, &nr_removed);
+	for (i = 0; i < NR_ADDERS; i++)
+		err |= pthread_create(&adders[i], NULL, thr_adder, (void *) i);
+	for (i = 0; i < NR_ADDERS; i++)
+		err |= pthread_join(adders[i], NULL);
+	uatomic_set(&adders_done, 1);
+	err |= pthread_join(remover, NULL);
+	for (key = 0; key < NR_ADDERS * NR_ADDS; key++) {
+		if (nr_nodes(key) != (key % 3 ? 1 : 0))
+			nr_bad++;
+	}
+	ok(!err && !nr_bad, "keys added once, removed keys absent");
+	ok(!nr_out_of_order(&nr)
+		&& nr + nr_removed == NR_ADDERS * NR_ADDS,
+		"table in split-order");
+	diag("%lu nodes, %lu removed", nr, nr_removed);
+	lfht_entry_destroy(ht);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d adders and a remover", NR_ADDERS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
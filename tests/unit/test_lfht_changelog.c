@@ -0,0 +1,234 @@
+/*
+ * test_lfht_changelog.c
+ *
+ * Userspace RCU library - test the change log of the hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	18
+
+#define RING_CAPACITY	4
+#define NR_THREADS	2
+#define NR_UPDATES	5000	/* Adds, then as many removals, per thread. */
+#define BATCH		64
+
+static struct cds_lfht *ht;
+static int nr_updaters_done;
+
+static void free_node(struct cds_lfht_node *node, void *priv)
+{
+	(void) priv;
+	free(lfht_entry_of(node));
+}
+
+static unsigned long drain(struct cds_lfht_change *changes, unsigned long nr,
+		int *overflow)
+{
+	unsigned long ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_changelog_drain(ht, changes, nr, overflow);
+	rcu_read_unlock();
+	return ret;
+}
+
+/* Return whether the only change logged is @type on @node of @key. */
+static int logged(enum cds_lfht_change_type type, unsigned long key,
+		struct cds_lfht_node *node)
+{
+	struct cds_lfht_change changes[2];
+	int overflow;
+
+	return drain(changes, 2, &overflow) == 1 && !overflow
+		&& changes[0].type == type
+		&& changes[0].hash == test_hash_key(key)
+		&& changes[0].node == node;
+}
+
+static void test_updates(void)
+{
+	struct cds_lfht_change change;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node, *old;
+	struct lfht_entry *e, *dup;
+	unsigned long key;
+	int overflow = 1;
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	ok1(ht);
+	lfht_entry_add_keys(ht, 0, 1);
+	ok(drain(&change, 1, &overflow) == 0 && !overflow,
+		"nothing to drain without a change log");
+	ok1(cds_lfht_changelog_enable(ht, 0) == 0);
+	ok1(cds_lfht_changelog_enable(ht, 0) == -EBUSY);
+
+	e = lfht_entry_alloc(1);
+	rcu_read_lock();
+	cds_lfht_add(ht, test_hash_key(1), &e->node);
+	rcu_read_unlock();
+	ok(logged(CDS_LFHT_CHANGE_ADD, 1, &e->node), "add logged");
+
+	dup = lfht_entry_alloc(1);
+	rcu_read_lock();
+	node = cds_lfht_add_unique(ht, test_hash_key(1), lfht_entry_match,
+			&dup->key, &dup->node);
+	rcu_read_unlock();
+	ok(node == &e->node && drain(&change, 1, NULL) == 0,
+		"failed add_unique not logged");
+	e = lfht_entry_alloc(2);
+	rcu_read_lock();
+	cds_lfht_add_unique(ht, test_hash_key(2), lfht_entry_match, &e->key,
+			&e->node);
+	rcu_read_unlock();
+	ok(logged(CDS_LFHT_CHANGE_ADD, 2, &e->node), "add_unique logged");
+
+	rcu_read_lock();
+	old = cds_lfht_add_replace(ht, test_hash_key(1), lfht_entry_match,
+			&dup->key, &dup->node);
+	rcu_read_unlock();
+	ok(old && logged(CDS_LFHT_CHANGE_REPLACE, 1, &dup->node),
+		"add_replace of a present key logged as a replace");
+	call_rcu(&lfht_entry_of(old)->rcu_head, lfht_entry_free);
+	e = lfht_entry_alloc(3);
+	rcu_read_lock();
+	old = cds_lfht_add_replace(ht, test_hash_key(3), lfht_entry_match,
+			&e->key, &e->node);
+	rcu_read_unlock();
+	ok(!old && logged(CDS_LFHT_CHANGE_ADD, 3, &e->node),
+		"add_replace of an absent key logged as an add");
+
+	key = 2;
+	e = lfht_entry_alloc(key);
+	rcu_read_lock();
+	old = lfht_entry_lookup(ht, key, &iter);
+	ok(!cds_lfht_replace(ht, &iter, test_hash_key(key),
+				lfht_entry_match, &key, &e->node)
+			&& logged(CDS_LFHT_CHANGE_REPLACE, key, &e->node),
+		"replace logged");
+	rcu_read_unlock();
+	call_rcu(&lfht_entry_of(old)->rcu_head, lfht_entry_free);
+
+	rcu_read_lock();
+	old = lfht_entry_lookup(ht, 3, &iter);
+	rcu_read_unlock();
+	lfht_entry_del_key(ht, 3);
+	ok(logged(CDS_LFHT_CHANGE_DEL, 3, old), "del logged");
+	cds_lfht_changelog_disable(ht);
+}
+
+static void test_overflow(void)
+{
+	struct cds_lfht_change changes[BATCH];
+	unsigned long nr_cpus, total, nr;
+	int overflow;
+
+	/* More adds than room in all the rings. */
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if ((long) nr_cpus <= 0)
+		nr_cpus = 1;
+	ok1(cds_lfht_changelog_enable(ht, RING_CAPACITY) == 0);
+	lfht_entry_add_keys(ht, 10, RING_CAPACITY * nr_cpus + 1);
+	total = 0;
+	nr = drain(changes, 1, &overflow);
+	ok(nr == 1 && overflow, "full ring flags an overflow");
+	do {
+		total += nr;
+		nr = drain(changes, BATCH, &overflow);
+	} while (nr && !overflow);
+	ok(!overflow && total <= RING_CAPACITY * nr_cpus,
+		"partial drains return the changes kept (%lu)", total);
+
+	cds_lfht_clear(ht, free_node, NULL);
+	ok(drain(changes, BATCH, &overflow) == 0 && overflow,
+		"clear flags an overflow");
+	cds_lfht_changelog_disable(ht);
+}
+
+static void *thr_updater(void *arg)
+{
+	unsigned long i, start = (unsigned long) arg * NR_UPDATES;
+
+	rcu_register_thread();
+	lfht_entry_add_keys(ht, start, NR_UPDATES);
+	for (i = start; i < start + NR_UPDATES; i++)
+		lfht_entry_del_key(ht, i);
+	rcu_unregister_thread();
+	uatomic_inc(&nr_updaters_done);
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	struct cds_lfht_change changes[BATCH];
+	pthread_t threads[NR_THREADS];
+	unsigned long i, nr, nr_add = 0, nr_del = 0;
+	int err = 0, overflow, overflowed = 0, done;
+
+	ok1(cds_lfht_changelog_enable(ht,
+		2 * NR_THREADS * NR_UPDATES) == 0);
+	for (i = 0; i < NR_THREADS; i++)
+		err |= pthread_create(&threads[i], NULL, thr_updater,
+				(void *) i);
+	do {
+		done = uatomic_read(&nr_updaters_done) == NR_THREADS;
+		/* Drain everything logged before done was read. */
+		while ((nr = drain(changes, BATCH, &overflow))) {
+			overflowed |= overflow;
+			for (i = 0; i < nr; i++) {
+				if (changes[i].type == CDS_LFHT_CHANGE_ADD)
+					nr_add++;
+				else if (changes[i].type == CDS_LFHT_CHANGE_DEL)
+					nr_del++;
+			}
+		}
+	} while (!err && !done);
+	for (i = 0; i < NR_THREADS; i++)
+		err |= pthread_join(threads[i], NULL);
+	ok(!err && !overflowed && nr_add == NR_THREADS * NR_UPDATES
+			&& nr_del == NR_THREADS * NR_UPDATES,
+		"changes of concurrent updates drained (%lu adds, %lu dels)",
+		nr_add, nr_del);
+	cds_lfht_changelog_disable(ht);
+	ok1(cds_lfht_destroy(ht, NULL) == 0);
+	rcu_barrier();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("updates logged");
+	test_updates();
+	diag("overflow of the per-CPU rings");
+	test_overflow();
+	diag("drains concurrent with %d updaters", NR_THREADS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,173 @@
+/*
+ * test_lfht_cursor.c
+ *
+ * Userspace RCU library - test the resumable hash table cursor
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	9
+
+#define NR_KEYS		2000	/* Keys swept, [0, 2000). */
+#define NR_OTHER	2000	/* Keys updated during sweeps, [2000, 4000). */
+#define PAUSE_EVERY	7
+#define NR_SWEEPS	20
+
+static struct cds_lfht *ht;
+static unsigned long nr_visits[NR_KEYS];
+static int test_stop;
+
+/* Return whether each swept key was visited once. */
+static int visited_once(void)
+{
+	unsigned long i;
+
+	for (i = 0; i < NR_KEYS; i++) {
+		if (nr_visits[i] != 1)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Sweep the table, leaving the read-side critical section every
+ * PAUSE_EVERY nodes and calling @between meanwhile. Remove the swept
+ * nodes if @del.
+ */
+static unsigned long sweep(void (*between)(unsigned long nr), int del)
+{
+	struct cds_lfht_cursor cursor;
+	struct cds_lfht_node *node;
+	struct lfht_entry *e;
+	unsigned long nr = 0;
+
+	memset(nr_visits, 0, sizeof(nr_visits));
+	cds_lfht_cursor_init(&cursor);
+	rcu_read_lock();
+	while ((node = cds_lfht_cursor_next(ht, &cursor))) {
+		e = lfht_entry_of(node);
+		if (e->key < NR_KEYS)
+			nr_visits[e->key]++;
+		if (del)
+			lfht_entry_del(ht, node);
+		if (++nr % PAUSE_EVERY)
+			continue;
+		cds_lfht_cursor_pause(&cursor);
+		rcu_read_unlock();
+		if (between)
+			between(nr);
+		rcu_read_lock();
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+/* Resize the table back and forth between the pauses of a sweep. */
+static void resize(unsigned long nr)
+{
+	cds_lfht_resize(ht, (nr / PAUSE_EVERY) % 2 ? 4096 : 2);
+}
+
+static void grace_period(unsigned long nr)
+{
+	(void) nr;
+	synchronize_rcu();
+}
+
+/* Add and remove the other keys. */
+static void *thr_updater(void *arg)
+{
+	unsigned long key;
+
+	(void) arg;
+	rcu_register_thread();
+	while (!uatomic_read(&test_stop)) {
+		lfht_entry_add_keys(ht, NR_KEYS, NR_OTHER);
+		for (key = NR_KEYS; key < NR_KEYS + NR_OTHER; key++)
+			lfht_entry_del_key(ht, key);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_sequential(void)
+{
+	struct cds_lfht_cursor cursor;
+
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	ok1(ht);
+	cds_lfht_cursor_init(&cursor);
+	rcu_read_lock();
+	ok(!cds_lfht_cursor_next(ht, &cursor)
+			&& !cds_lfht_cursor_next(ht, &cursor),
+		"sweep of an empty table");
+	rcu_read_unlock();
+	lfht_entry_add_keys(ht, 0, NR_KEYS);
+	cds_lfht_resize(ht, 256);
+
+	ok(sweep(NULL, 0) == NR_KEYS && visited_once(),
+		"sweep within read-side critical sections");
+	ok(sweep(grace_period, 0) == NR_KEYS && visited_once(),
+		"sweep across grace periods");
+	ok(sweep(resize, 0) == NR_KEYS && visited_once(),
+		"sweep across resizes");
+}
+
+static void test_concurrent(void)
+{
+	unsigned long i;
+	int err, once = 1;
+	pthread_t updater;
+
+	err = pthread_create(&updater, NULL, thr_updater, NULL);
+	for (i = 0; i < NR_SWEEPS; i++) {
+		sweep(i & 1 ? resize : grace_period, 0);
+		once &= visited_once();
+	}
+	uatomic_set(&test_stop, 1);
+	if (!err)
+		err = pthread_join(updater, NULL);
+	ok(!err && once, "keys present during sweeps concurrent with "
+		"updates visited once");
+	ok(sweep(grace_period, 1) == NR_KEYS && visited_once(),
+		"sweep removing the nodes returned");
+	ok(sweep(NULL, 0) == 0, "table empty after the removing sweep");
+	ok1(cds_lfht_destroy(ht, NULL) == 0);
+	rcu_barrier();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("sweeps concurrent with updates of other keys");
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,193 @@
+/*
+ * test_lfht_del_if.c
+ *
+ * Userspace RCU library - test the removal of hash table nodes by predicate
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	8
+
+#define NR_KEYS		3000
+#define MAX_THREADS	7
+#define NR_READERS	2
+
+struct del_counts {
+	unsigned long nr_pred, nr_free;
+	unsigned long mask;		/* Remove the keys with these bits. */
+};
+
+static struct cds_lfht *ht;
+static int del_done;
+
+static int pred(struct cds_lfht_node *node, void *priv)
+{
+	struct del_counts *counts = priv;
+
+	uatomic_inc(&counts->nr_pred);
+	return !counts->mask || (lfht_entry_of(node)->key & counts->mask);
+}
+
+/* Called after a grace period: free right away. */
+static void free_node(struct cds_lfht_node *node, void *priv)
+{
+	struct del_counts *counts = priv;
+
+	uatomic_inc(&counts->nr_free);
+	free(lfht_entry_of(node));
+}
+
+static void fill_table(unsigned long init_size)
+{
+	ht = cds_lfht_new(init_size, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	lfht_entry_add_keys(ht, 0, NR_KEYS);
+}
+
+/* Count the keys of [start, start + len) found with @step. */
+static unsigned long nr_found(unsigned long start, unsigned long len,
+		unsigned long step)
+{
+	unsigned long key, nr = 0;
+
+	rcu_read_lock();
+	for (key = start; key < start + len; key += step) {
+		if (lfht_entry_lookup(ht, key, NULL))
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void test_sequential(void)
+{
+	static const unsigned long sizes[] = { 1, 64, 128, 1024, 4096 };
+	struct del_counts counts = { 0, 0, 0 };
+	unsigned long i, nr_threads, nr_bad = 0;
+	long ret;
+
+	fill_table(64);
+	counts.mask = 1;
+	ret = cds_lfht_del_if(ht, pred, free_node, &counts, 1);
+	ok(ret == NR_KEYS / 2 && counts.nr_pred == NR_KEYS,
+		"matching nodes removed");
+	ok(counts.nr_free == NR_KEYS / 2, "removed nodes freed");
+	ok(nr_found(0, NR_KEYS, 2) == NR_KEYS / 2 && !nr_found(1, NR_KEYS, 2),
+		"other nodes kept");
+	ret = cds_lfht_del_if(ht, pred, free_node, &counts, 1);
+	ok(!ret && counts.nr_free == NR_KEYS / 2, "no node matches");
+	counts.mask = 0;
+	ret = cds_lfht_del_if(ht, pred, free_node, &counts, 0);
+	ok(ret == NR_KEYS / 2 && !nr_found(0, NR_KEYS, 1),
+		"threads chosen from the table size");
+	lfht_entry_destroy(ht);
+
+	/* Ranges of buckets split between fewer or more threads. */
+	for (i = 0; i < CAA_ARRAY_SIZE(sizes); i++) {
+		for (nr_threads = 1; nr_threads <= MAX_THREADS; nr_threads++) {
+			fill_table(sizes[i]);
+			counts.nr_free = 0;
+			ret = cds_lfht_del_if(ht, pred, free_node, &counts,
+					nr_threads);
+			if (ret != NR_KEYS || counts.nr_free != NR_KEYS) {
+				diag("%lu buckets, %lu threads: %ld removed",
+					sizes[i], nr_threads, ret);
+				nr_bad++;
+			}
+			lfht_entry_destroy(ht);
+		}
+	}
+	ok(!nr_bad, "all nodes removed with 1 to %d threads", MAX_THREADS);
+}
+
+/* Check the keys kept by cds_lfht_del_if. */
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg;
+
+	rcu_register_thread();
+	while (!uatomic_read(&del_done)) {
+		if (nr_found(0, NR_KEYS, 2) != NR_KEYS / 2)
+			(*nr_bad)++;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Add even keys while odd keys are removed. */
+static void *thr_adder(void *arg)
+{
+	unsigned long key;
+
+	(void) arg;
+	rcu_register_thread();
+	for (key = NR_KEYS; key < 2 * NR_KEYS; key += 2)
+		lfht_entry_add_keys(ht, key, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	struct del_counts counts = { 0, 0, 1 };
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	pthread_t readers[NR_READERS], adder;
+	long ret;
+	int err = 0;
+
+	fill_table(1024);
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	err |= pthread_create(&adder, NULL, thr_adder, NULL);
+	ret = cds_lfht_del_if(ht, pred, free_node, &counts, 4);
+	err |= pthread_join(adder, NULL);
+	uatomic_set(&del_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad && ret == NR_KEYS / 2
+		&& counts.nr_free == NR_KEYS / 2,
+		"readers keep finding the other nodes");
+	ok(nr_found(0, 2 * NR_KEYS, 2) == NR_KEYS
+		&& !nr_found(1, NR_KEYS, 2),
+		"nodes added concurrently kept");
+	lfht_entry_destroy(ht);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d readers and an adder", NR_READERS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,152 @@
+/*
+ * test_lfht_filter.c
+ *
+ * Userspace RCU library - test the membership filter of the hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	12
+
+#define NR_KEYS		1000	/* Keys [0, 1000) added before the rebuild. */
+#define NR_LATE		2000	/* Keys [1000, 3000) added during rebuilds. */
+#define ABSENT_START	100000
+#define NR_MANY		16
+
+static struct cds_lfht *ht;
+static int adder_done;
+
+/* Count the keys of [start, start + len) found. */
+static unsigned long nr_found(unsigned long start, unsigned long len)
+{
+	return len - lfht_entry_nr_missing(ht, start, len);
+}
+
+static int lookup_many_ok(void)
+{
+	unsigned long keys[NR_MANY], hashes[NR_MANY];
+	const void *key_ptrs[NR_MANY];
+	struct cds_lfht_iter iters[NR_MANY];
+	struct cds_lfht_node *node;
+	int i, ret = 1;
+
+	for (i = 0; i < NR_MANY; i++) {
+		/* Alternate present and absent keys. */
+		keys[i] = (i & 1) ? ABSENT_START + i : (unsigned long) i * 7;
+		hashes[i] = test_hash_key(keys[i]);
+		key_ptrs[i] = &keys[i];
+	}
+	rcu_read_lock();
+	cds_lfht_lookup_many(ht, NR_MANY, hashes, lfht_entry_match, key_ptrs,
+		iters);
+	for (i = 0; i < NR_MANY; i++) {
+		node = cds_lfht_iter_get_node(&iters[i]);
+		if ((i & 1) ? node != NULL
+			    : !node || !lfht_entry_match(node, &keys[i]))
+			ret = 0;
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+/* Add keys, each found right after its add. */
+static void *thr_adder(void *arg)
+{
+	unsigned long key;
+	unsigned long *nr_bad = arg;
+
+	rcu_register_thread();
+	for (key = NR_KEYS; key < NR_KEYS + NR_LATE; key++) {
+		lfht_entry_add_keys(ht, key, 1);
+		*nr_bad += lfht_entry_nr_missing(ht, key, 1);
+	}
+	rcu_unregister_thread();
+	uatomic_set(&adder_done, 1);
+	return NULL;
+}
+
+static void test_sequential(void)
+{
+	struct cds_lfht_node *node;
+	unsigned long key;
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	ok1(ht);
+	lfht_entry_add_keys(ht, 0, NR_KEYS);
+	ok1(cds_lfht_filter_rebuild(ht, 0) == 0);
+	ok(!lfht_entry_nr_missing(ht, 0, NR_KEYS),
+		"no false negative after a rebuild");
+	ok(!nr_found(ABSENT_START, NR_KEYS), "absent keys are not found");
+	ok1(lookup_many_ok());
+
+	lfht_entry_add_keys(ht, ABSENT_START - 1, 1);
+	ok(!lfht_entry_nr_missing(ht, ABSENT_START - 1, 1),
+		"key added after a rebuild found");
+	key = 0;
+	rcu_read_lock();
+	node = lfht_entry_lookup(ht, key, NULL);
+	ok1(node && !cds_lfht_del(ht, node));
+	rcu_read_unlock();
+	call_rcu(&lfht_entry_of(node)->rcu_head, lfht_entry_free);
+	ok(!nr_found(0, 1), "removed key not found before a rebuild");
+	ok1(cds_lfht_filter_rebuild(ht, 0) == 0 && !nr_found(0, 1)
+		&& !lfht_entry_nr_missing(ht, 1, NR_KEYS - 1));
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad = 0;
+	pthread_t adder;
+	int err;
+
+	err = pthread_create(&adder, NULL, thr_adder, &nr_bad);
+	while (!err && !uatomic_read(&adder_done)) {
+		if (cds_lfht_filter_rebuild(ht, NR_KEYS + NR_LATE))
+			abort();
+	}
+	if (!err)
+		err = pthread_join(adder, NULL);
+	ok(!err && !nr_bad, "keys added during rebuilds found right away");
+	ok(!lfht_entry_nr_missing(ht, 1, NR_KEYS + NR_LATE - 1),
+		"no false negative once the rebuilds complete");
+	cds_lfht_filter_disable(ht);
+	ok(!lfht_entry_nr_missing(ht, 1, NR_KEYS + NR_LATE - 1)
+			&& !nr_found(ABSENT_START, NR_KEYS),
+		"lookups without the filter");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("adds concurrent with rebuilds");
+	test_concurrent();
+	lfht_entry_destroy(ht);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
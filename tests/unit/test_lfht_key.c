@@ -0,0 +1,216 @@
+/*
+ * test_lfht_key.c
+ *
+ * Userspace RCU library - test the hash table nodes with an inline key
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Built with and without _LGPL_SOURCE, to test the inline lookups and
+ * the library symbols.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	12
+
+#define NR_KEYS		1000
+#define MAX_WORDS	4
+#define LINE_SIZE	64
+
+/* Extra node per width, for the unique adds. */
+static struct cds_lfht_node_key8 nodes8[NR_KEYS + 1];
+static struct cds_lfht_node_key16 nodes16[NR_KEYS + 1];
+static struct cds_lfht_node_key32 nodes32[NR_KEYS + 1];
+
+static struct cds_lfht *ht;
+
+static struct cds_lfht_node *node_of(unsigned int nr_words, unsigned long i)
+{
+	switch (nr_words) {
+	case 1:
+		return &nodes8[i].node;
+	case 2:
+		return &nodes16[i].node;
+	default:
+		return &nodes32[i].node;
+	}
+}
+
+static uint64_t *key_of(unsigned int nr_words, unsigned long i)
+{
+	switch (nr_words) {
+	case 1:
+		return &nodes8[i].key;
+	case 2:
+		return nodes16[i].key;
+	default:
+		return nodes32[i].key;
+	}
+}
+
+static cds_lfht_match_fct match_of(unsigned int nr_words)
+{
+	switch (nr_words) {
+	case 1:
+		return cds_lfht_match_key8;
+	case 2:
+		return cds_lfht_match_key16;
+	default:
+		return cds_lfht_match_key32;
+	}
+}
+
+/* Call with rcu_read_lock held. */
+static void lookup(unsigned int nr_words, unsigned long hash,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	switch (nr_words) {
+	case 1:
+		cds_lfht_lookup_key8(ht, hash, key, iter);
+		break;
+	case 2:
+		cds_lfht_lookup_key16(ht, hash, key, iter);
+		break;
+	default:
+		cds_lfht_lookup_key32(ht, hash, key, iter);
+		break;
+	}
+}
+
+/*
+ * Keys 2n and 2n + 1 share their hash and all their words but the last,
+ * which is @last.
+ */
+static void make_key(uint64_t *key, unsigned int nr_words, unsigned long i,
+		uint64_t last)
+{
+	unsigned int j;
+
+	for (j = 0; j < nr_words - 1; j++)
+		key[j] = test_hash_key((i / 2 + 1) * (j + 1));
+	key[nr_words - 1] = last;
+}
+
+static unsigned long hash_of(unsigned long i)
+{
+	return test_hash_key(i / 2);
+}
+
+/* Look @key up from an unaligned copy, and return the node found. */
+static struct cds_lfht_node *lookup_unaligned(unsigned int nr_words,
+		unsigned long hash, const uint64_t *key)
+{
+	char buf[MAX_WORDS * sizeof(uint64_t) + 1];
+	struct cds_lfht_iter iter;
+
+	memcpy(buf + 1, key, nr_words * sizeof(uint64_t));
+	lookup(nr_words, hash, buf + 1, &iter);
+	return cds_lfht_iter_get_node(&iter);
+}
+
+static void test_width(unsigned int nr_words)
+{
+	unsigned int size = nr_words * sizeof(uint64_t);
+	uint64_t key[MAX_WORDS];
+	struct cds_lfht_node *node;
+	unsigned long i, nr_bad;
+	uintptr_t start, end;
+
+	ht = cds_lfht_new(64, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	nr_bad = 0;
+	for (i = 0; i < NR_KEYS; i++) {
+		start = (uintptr_t) node_of(nr_words, i);
+		end = (uintptr_t) (key_of(nr_words, i) + nr_words) - 1;
+		if (start / LINE_SIZE != end / LINE_SIZE)
+			nr_bad++;
+	}
+	ok(!nr_bad, "key%u: node and key in a cache line", size);
+
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++) {
+		make_key(key_of(nr_words, i), nr_words, i, i);
+		cds_lfht_node_init(node_of(nr_words, i));
+		cds_lfht_add(ht, hash_of(i), node_of(nr_words, i));
+	}
+	nr_bad = 0;
+	for (i = 0; i < NR_KEYS; i++) {
+		make_key(key, nr_words, i, i);
+		if (lookup_unaligned(nr_words, hash_of(i), key)
+				!= node_of(nr_words, i))
+			nr_bad++;
+	}
+	ok(!nr_bad, "key%u: keys found from unaligned copies", size);
+	nr_bad = 0;
+	for (i = 0; i < NR_KEYS; i++) {
+		make_key(key, nr_words, i, NR_KEYS + i);
+		if (lookup_unaligned(nr_words, hash_of(i), key))
+			nr_bad++;
+	}
+	ok(!nr_bad, "key%u: keys differing by their last word not found",
+		size);
+
+	nr_bad = 0;
+	node = node_of(nr_words, NR_KEYS);
+	make_key(key, nr_words, 0, 0);
+	make_key(key_of(nr_words, NR_KEYS), nr_words, 0, 0);
+	cds_lfht_node_init(node);
+	if (cds_lfht_add_unique(ht, hash_of(0), match_of(nr_words), key,
+			node) != node_of(nr_words, 0))
+		nr_bad++;
+	make_key(key, nr_words, 0, 2 * NR_KEYS);
+	make_key(key_of(nr_words, NR_KEYS), nr_words, 0, 2 * NR_KEYS);
+	if (cds_lfht_add_unique(ht, hash_of(0), match_of(nr_words), key,
+			node) != node
+	    || lookup_unaligned(nr_words, hash_of(0), key) != node)
+		nr_bad++;
+	rcu_read_unlock();
+	ok(!nr_bad, "key%u: match function for unique adds", size);
+
+	rcu_read_lock();
+	for (i = 0; i <= NR_KEYS; i++) {
+		if (cds_lfht_del(ht, node_of(nr_words, i)))
+			abort();
+	}
+	rcu_read_unlock();
+	/* Static nodes: wait for the readers before the next width. */
+	synchronize_rcu();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	test_width(1);
+	test_width(2);
+	test_width(4);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,225 @@
+/*
+ * test_lfht_lookup_cache.c
+ *
+ * Userspace RCU library - test the per-thread lookup cache of the hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	9
+
+#define NR_KEYS		1000	/* Keys [0, 1000) stay in the table. */
+#define NR_UPDATE_KEYS	100	/* Keys [1000, 1100) updated. */
+#define NR_UPDATES	20000
+#define NR_READERS	2
+#define CACHE_SIZE	256
+
+static struct cds_lfht *ht;
+static int updater_done;
+
+/* Call with rcu_read_lock held. */
+static struct lfht_entry *lookup_cached(struct cds_lfht_lookup_cache *cache,
+		unsigned long key)
+{
+	struct cds_lfht_iter iter;
+
+	cds_lfht_lookup_cached(cache, test_hash_key(key), lfht_entry_match,
+			&key, &iter);
+	return lfht_entry_of(cds_lfht_iter_get_node(&iter));
+}
+
+/* Count the keys looked up through @cache unlike without it. */
+static unsigned long nr_mismatches(struct cds_lfht_lookup_cache *cache,
+		unsigned long start, unsigned long len)
+{
+	unsigned long key, nr = 0;
+	struct lfht_entry *e;
+
+	rcu_read_lock();
+	for (key = start; key < start + len; key++) {
+		e = lfht_entry_of(lfht_entry_lookup(ht, key, NULL));
+		if (lookup_cached(cache, key) != e)
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void test_sequential(void)
+{
+	struct cds_lfht_lookup_cache *cache, *small;
+	struct cds_lfht_iter iter;
+	struct lfht_entry *e, *old;
+	unsigned long key;
+	int nr_bad = 0;
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	lfht_entry_add_keys(ht, 0, NR_KEYS);
+	ok(!cds_lfht_lookup_cache_create(ht, 0), "empty cache rejected");
+	cache = cds_lfht_lookup_cache_create(ht, CACHE_SIZE - 1);
+	ok(cache, "cache created");
+	ok(!nr_mismatches(cache, 0, NR_KEYS)
+		&& !nr_mismatches(cache, 0, NR_KEYS),
+		"cached lookups fill the cache, then hit");
+	ok(!nr_mismatches(cache, NR_KEYS, NR_KEYS), "absent keys not found");
+
+	key = NR_KEYS;
+	lfht_entry_add_keys(ht, key, 1);
+	ok(!nr_mismatches(cache, key, 1), "misses are not cached");
+
+	rcu_read_lock();
+	e = lookup_cached(cache, key);
+	if (!e || cds_lfht_del(ht, &e->node))
+		abort();
+	rcu_read_unlock();
+	call_rcu(&e->rcu_head, lfht_entry_free);
+	rcu_read_lock();
+	ok(!lookup_cached(cache, key), "removed node not hit");
+	rcu_read_unlock();
+
+	key = 0;
+	e = lfht_entry_alloc(key);
+	rcu_read_lock();
+	old = lookup_cached(cache, key);
+	lfht_entry_lookup(ht, key, &iter);
+	if (cds_lfht_replace(ht, &iter, test_hash_key(key), lfht_entry_match,
+			&key, &e->node))
+		abort();
+	rcu_read_unlock();
+	call_rcu(&old->rcu_head, lfht_entry_free);
+	rcu_read_lock();
+	ok(lookup_cached(cache, key) == e, "replaced node not hit");
+	rcu_read_unlock();
+
+	/* Every key shares the entry of a single entry cache. */
+	small = cds_lfht_lookup_cache_create(ht, 1);
+	if (!small)
+		abort();
+	rcu_read_lock();
+	for (key = 0; key < 100; key++) {
+		e = lfht_entry_of(lfht_entry_lookup(ht, key % 2, NULL));
+		if (lookup_cached(small, key % 2) != e)
+			nr_bad++;
+	}
+	key = 1;
+	cds_lfht_lookup_cached(small, test_hash_key(key), NULL, NULL, &iter);
+	if (cds_lfht_iter_get_node(&iter) != lfht_entry_lookup(ht, key, NULL))
+		nr_bad++;
+	rcu_read_unlock();
+	ok(!nr_bad, "keys sharing a cache entry, NULL match function");
+	cds_lfht_lookup_cache_destroy(small);
+	cds_lfht_lookup_cache_destroy(cache);
+	lfht_entry_destroy(ht);
+}
+
+/* Look the keys up through a cache of the reader. */
+static void *thr_reader(void *arg)
+{
+	struct cds_lfht_lookup_cache *cache;
+	unsigned long *nr_bad = arg, key;
+	struct lfht_entry *e;
+
+	rcu_register_thread();
+	cache = cds_lfht_lookup_cache_create(ht, CACHE_SIZE);
+	if (!cache)
+		abort();
+	while (!uatomic_read(&updater_done)) {
+		rcu_read_lock();
+		for (key = 0; key < NR_KEYS + NR_UPDATE_KEYS; key++) {
+			e = lookup_cached(cache, key);
+			if (key < NR_KEYS ? !e : e && e->key != key)
+				(*nr_bad)++;
+			/* A stale hit could return a freed node. */
+			if (e && CMM_LOAD_SHARED(e->magic) != LFHT_ENTRY_MAGIC)
+				(*nr_bad)++;
+		}
+		rcu_read_unlock();
+	}
+	cds_lfht_lookup_cache_destroy(cache);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Alternately add and remove the updated keys. */
+static void *thr_updater(void *arg)
+{
+	struct cds_lfht_node *node;
+	unsigned long i, key;
+
+	(void) arg;
+	rcu_register_thread();
+	for (i = 0; i < NR_UPDATES; i++) {
+		key = NR_KEYS + i % NR_UPDATE_KEYS;
+		rcu_read_lock();
+		node = lfht_entry_lookup(ht, key, NULL);
+		if (node)
+			lfht_entry_del(ht, node);
+		else
+			cds_lfht_add(ht, test_hash_key(key),
+					&lfht_entry_alloc(key)->node);
+		rcu_read_unlock();
+	}
+	uatomic_set(&updater_done, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	pthread_t readers[NR_READERS], updater;
+	int err = 0;
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	lfht_entry_add_keys(ht, 0, NR_KEYS);
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	err |= pthread_create(&updater, NULL, thr_updater, NULL);
+	err |= pthread_join(updater, NULL);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad, "cached lookups concurrent with removals");
+	lfht_entry_destroy(ht);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d readers and an updater", NR_READERS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,179 @@
+/*
+ * test_lfht_lookup_or_add.c
+ *
+ * Userspace RCU library - test the construct-on-miss add of the hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	10
+
+#define NR_THREADS	4
+#define NR_KEYS		5000
+
+struct ctor_counts {
+	unsigned long nr_ctor, nr_free;
+	int fail;			/* Constructors return NULL. */
+};
+
+static struct cds_lfht *ht;
+
+static struct cds_lfht_node *ctor(const void *key, void *priv)
+{
+	struct ctor_counts *counts = priv;
+
+	if (counts->fail)
+		return NULL;
+	uatomic_inc(&counts->nr_ctor);
+	return &lfht_entry_alloc(*(const unsigned long *) key)->node;
+}
+
+/* The node was never published: free it right away. */
+static void free_unused(struct cds_lfht_node *node, void *priv)
+{
+	struct ctor_counts *counts = priv;
+
+	uatomic_inc(&counts->nr_free);
+	free(lfht_entry_of(node));
+}
+
+/* Call with rcu_read_lock held. */
+static struct cds_lfht_node *lookup_or_add(unsigned long key,
+		struct ctor_counts *counts)
+{
+	return cds_lfht_lookup_or_add(ht, test_hash_key(key),
+			lfht_entry_match, &key, ctor, free_unused, counts);
+}
+
+static void test_sequential(void)
+{
+	struct ctor_counts counts = { 0, 0, 0 };
+	struct cds_lfht_node *node, *again;
+	unsigned long key = 1;
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	ok1(ht);
+	rcu_read_lock();
+	node = lookup_or_add(key, &counts);
+	rcu_read_unlock();
+	ok(node && lfht_entry_match(node, &key) && counts.nr_ctor == 1,
+		"miss constructs the node");
+	ok(lfht_entry_nr_nodes(ht, key) == 1, "constructed node added");
+	rcu_read_lock();
+	again = lookup_or_add(key, &counts);
+	rcu_read_unlock();
+	ok(again == node && counts.nr_ctor == 1,
+		"hit returns the node without constructing");
+
+	counts.fail = 1;
+	key = 2;
+	rcu_read_lock();
+	node = lookup_or_add(key, &counts);
+	rcu_read_unlock();
+	ok(!node && !lfht_entry_nr_nodes(ht, key),
+		"failed construction adds nothing");
+	counts.fail = 0;
+
+	/* Key 3 has the hash of key 1. */
+	key = 3;
+	rcu_read_lock();
+	node = cds_lfht_lookup_or_add(ht, test_hash_key(1), NULL, &key, ctor,
+			free_unused, &counts);
+	rcu_read_unlock();
+	ok(node == again && counts.nr_ctor == 1,
+		"NULL match function matches on the hash");
+	ok(!counts.nr_free, "no node freed without a race");
+}
+
+struct thread_arg {
+	unsigned long start;		/* First key walked by the thread. */
+	struct ctor_counts *counts;
+	struct cds_lfht_node *nodes[NR_KEYS];	/* Node returned per key. */
+};
+
+static void *thr_lookup_or_add(void *arg)
+{
+	struct thread_arg *ta = arg;
+	unsigned long i, key;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_KEYS; i++) {
+		key = (ta->start + i) % NR_KEYS;
+		rcu_read_lock();
+		ta->nodes[key] = lookup_or_add(NR_KEYS + key, ta->counts);
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Keys [NR_KEYS, 2 * NR_KEYS) are added by all the threads. */
+static void test_concurrent(void)
+{
+	static struct thread_arg ta[NR_THREADS];
+	struct ctor_counts counts = { 0, 0, 0 };
+	pthread_t threads[NR_THREADS];
+	unsigned long i, key, nr_bad = 0;
+	int err = 0;
+
+	for (i = 0; i < NR_THREADS; i++) {
+		ta[i].start = i * NR_KEYS / NR_THREADS;
+		ta[i].counts = &counts;
+		err |= pthread_create(&threads[i], NULL, thr_lookup_or_add,
+				&ta[i]);
+	}
+	for (i = 0; i < NR_THREADS; i++)
+		err |= pthread_join(threads[i], NULL);
+	for (key = 0; key < NR_KEYS; key++) {
+		for (i = 1; i < NR_THREADS; i++) {
+			if (!ta[i].nodes[key]
+			    || ta[i].nodes[key] != ta[0].nodes[key])
+				nr_bad++;
+		}
+	}
+	ok(!err && !nr_bad, "all threads get the same node of each key");
+	for (key = 0; key < NR_KEYS; key++) {
+		if (lfht_entry_nr_nodes(ht, NR_KEYS + key) != 1)
+			nr_bad++;
+	}
+	ok(!nr_bad, "a single node added per key");
+	ok(counts.nr_ctor - counts.nr_free == NR_KEYS,
+		"nodes of lost races are freed");
+	diag("%lu constructions, %lu freed", counts.nr_ctor, counts.nr_free);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d threads adding the same keys", NR_THREADS);
+	test_concurrent();
+	lfht_entry_destroy(ht);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,302 @@
+/*
+ * test_lfht_migrate.c
+ *
+ * Userspace RCU library - test the online migration of hash table nodes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	12
+
+#define NEW_SEED	0x5bd1e995UL
+#define NR_KEYS		2000	/* Keys [0, 2000) are in the old table. */
+/* Keys [0, 500) removed and [2000, 2500) added during the move. */
+#define NR_UPDATES	500
+#define NR_READERS	2
+#define BATCH		16
+
+static struct cds_lfht *old_ht, *new_ht;
+static struct cds_lfht_migration *m;
+static int copy_fail, mover_done;
+
+static unsigned long new_hash_key(unsigned long key)
+{
+	return test_hash_key(key ^ NEW_SEED);
+}
+
+static unsigned long migrate_hash(struct cds_lfht_node *node, void *priv)
+{
+	(void) priv;
+	return new_hash_key(lfht_entry_of(node)->key);
+}
+
+static struct cds_lfht_node *migrate_copy(struct cds_lfht_node *node,
+		void *priv)
+{
+	(void) priv;
+	if (copy_fail)
+		return NULL;
+	return &lfht_entry_alloc(lfht_entry_of(node)->key)->node;
+}
+
+static void migrate_retire(struct cds_lfht_node *node, void *priv)
+{
+	(void) priv;
+	call_rcu(&lfht_entry_of(node)->rcu_head, lfht_entry_free);
+}
+
+static const struct cds_lfht_migrate_ops ops = {
+	.hash = migrate_hash,
+	.copy = migrate_copy,
+	.retire = migrate_retire,
+};
+
+/* Call with rcu_read_lock held. */
+static struct cds_lfht *lookup_key(unsigned long key,
+		struct cds_lfht_iter *iter)
+{
+	return cds_lfht_migrate_lookup(m, test_hash_key(key),
+			new_hash_key(key), lfht_entry_match, &key, iter);
+}
+
+static unsigned long nr_nodes(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long nr = 0;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		nr++;
+	rcu_read_unlock();
+	return nr;
+}
+
+/* Count the keys of [start, start + len) not found. */
+static unsigned long nr_missing(unsigned long start, unsigned long len)
+{
+	struct cds_lfht_iter iter;
+	unsigned long key, nr = 0;
+
+	rcu_read_lock();
+	for (key = start; key < start + len; key++) {
+		if (!lookup_key(key, &iter))
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void create_tables(void)
+{
+	old_ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	new_ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!old_ht || !new_ht)
+		abort();
+	lfht_entry_add_keys(old_ht, 0, NR_KEYS);
+}
+
+/* Move the remaining nodes, in batches. */
+static int migrate_all(void)
+{
+	int ret;
+
+	do {
+		rcu_read_lock();
+		ret = cds_lfht_migrate_step(m, BATCH);
+		rcu_read_unlock();
+	} while (ret == 1);
+	return ret;
+}
+
+/* Free the migration and both tables. */
+static void end_migration(void)
+{
+	synchronize_rcu();
+	cds_lfht_migrate_destroy(m);
+	lfht_entry_destroy(old_ht);
+	lfht_entry_destroy(new_ht);
+}
+
+static void test_sequential(void)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct lfht_entry *e;
+	unsigned long key;
+	int ret;
+
+	create_tables();
+	ok(!cds_lfht_migrate_begin(old_ht, old_ht, &ops, NULL),
+		"migration into the same table rejected");
+	m = cds_lfht_migrate_begin(old_ht, new_ht, &ops, NULL);
+	ok(m, "migration started");
+
+	rcu_read_lock();
+	ret = cds_lfht_migrate_step(m, 10);
+	rcu_read_unlock();
+	ok(ret == 1 && nr_nodes(new_ht) == 10
+		&& nr_nodes(old_ht) == NR_KEYS - 10,
+		"step moves a batch of nodes");
+	ok(!nr_missing(0, NR_KEYS), "all keys found during the migration");
+	copy_fail = 1;
+	rcu_read_lock();
+	ret = cds_lfht_migrate_step(m, 10);
+	rcu_read_unlock();
+	copy_fail = 0;
+	ok(ret == -ENOMEM && nr_nodes(old_ht) + nr_nodes(new_ht) == NR_KEYS,
+		"failed copy leaves the node in place");
+
+	ret = migrate_all();
+	ok(!ret && !nr_nodes(old_ht) && nr_nodes(new_ht) == NR_KEYS,
+		"all nodes moved");
+	key = 0;
+	rcu_read_lock();
+	ok(lookup_key(key, &iter) == new_ht, "moved key found in the new table");
+	node = cds_lfht_iter_get_node(&iter);
+	e = lfht_entry_alloc(key);
+	ok(cds_lfht_migrate_add_unique(m, test_hash_key(key),
+			new_hash_key(key), lfht_entry_match, &key,
+			&e->node) == node,
+		"add_unique returns the present node");
+	free(e);
+	key = NR_KEYS;
+	e = lfht_entry_alloc(key);
+	ok(cds_lfht_migrate_add_unique(m, test_hash_key(key),
+			new_hash_key(key), lfht_entry_match, &key,
+			&e->node) == &e->node
+		&& lookup_key(key, &iter) == new_ht,
+		"add_unique adds an absent key to the new table");
+	rcu_read_unlock();
+	end_migration();
+}
+
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg, key;
+	struct cds_lfht_iter iter;
+
+	rcu_register_thread();
+	while (!uatomic_read(&mover_done)) {
+		rcu_read_lock();
+		for (key = NR_UPDATES; key < NR_KEYS; key++) {
+			if (!lookup_key(key, &iter))
+				(*nr_bad)++;
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Remove some keys of the old table, and add new keys. */
+static void *thr_updater(void *arg)
+{
+	unsigned long i, key, nr_bad = 0;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct cds_lfht *ht;
+	struct lfht_entry *e;
+
+	(void) arg;
+	rcu_register_thread();
+	for (i = 0; i < NR_UPDATES; i++) {
+		key = i;
+		rcu_read_lock();
+		/* The node can be moved between the lookup and removal. */
+		for (;;) {
+			ht = lookup_key(key, &iter);
+			if (!ht) {
+				nr_bad++;
+				break;
+			}
+			node = cds_lfht_iter_get_node(&iter);
+			if (!cds_lfht_del(ht, node)) {
+				call_rcu(&lfht_entry_of(node)->rcu_head,
+					lfht_entry_free);
+				break;
+			}
+		}
+		rcu_read_unlock();
+
+		key = NR_KEYS + i;
+		e = lfht_entry_alloc(key);
+		rcu_read_lock();
+		if (cds_lfht_migrate_add_unique(m, test_hash_key(key),
+				new_hash_key(key), lfht_entry_match, &key,
+				&e->node) != &e->node)
+			nr_bad++;
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return (void *) nr_bad;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	pthread_t readers[NR_READERS], updater;
+	void *ret;
+	int err = 0;
+
+	create_tables();
+	m = cds_lfht_migrate_begin(old_ht, new_ht, &ops, NULL);
+	if (!m)
+		abort();
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	err |= pthread_create(&updater, NULL, thr_updater, NULL);
+	err |= migrate_all();
+	err |= pthread_join(updater, &ret);
+	ok(!err && !ret, "removals and adds during the migration");
+	uatomic_set(&mover_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad, "readers find the keys being moved");
+	/* Nodes added after the last step went to the new table. */
+	ok(!nr_nodes(old_ht)
+		&& nr_nodes(new_ht) == NR_KEYS
+		&& nr_missing(0, NR_UPDATES) == NR_UPDATES
+		&& !nr_missing(NR_UPDATES, NR_KEYS),
+		"new table holds the expected keys");
+	end_migration();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d readers, an updater and the mover", NR_READERS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
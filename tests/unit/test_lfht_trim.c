@@ -0,0 +1,126 @@
+/*
+ * test_lfht_trim.c
+ *
+ * Userspace RCU library - test the immediate shrink of idle hash tables
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	9
+
+#define INIT_SIZE	4096
+#define NR_KEYS		2000
+#define NR_READERS	2
+#define NR_TRIMS	20
+
+static struct cds_lfht *ht;
+static int trimmer_done;
+
+static void test_sequential(void)
+{
+	struct cds_lfht_resize_policy policy = CDS_LFHT_RESIZE_POLICY_DEFAULT;
+
+	/* Nodes counted by a walk of the table. */
+	ht = cds_lfht_new(INIT_SIZE, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	lfht_entry_add_keys(ht, 0, 100);
+	ok(cds_lfht_trim(ht) == 128, "shrink to fit the node count");
+	ok(!lfht_entry_nr_missing(ht, 0, 100), "nodes found after the trim");
+	lfht_entry_add_keys(ht, 100, 900);
+	ok(cds_lfht_trim(ht) == 128 && !lfht_entry_nr_missing(ht, 0, 1000),
+		"trim does not grow the table");
+	lfht_entry_del_all(ht);
+	ok(cds_lfht_trim(ht) == 1, "empty table shrunk to a single bucket");
+	lfht_entry_destroy(ht);
+
+	/* Nodes counted by the split-counters. */
+	policy.target_load_order = 2;
+	ht = cds_lfht_new_with_policy(INIT_SIZE, 1, 0, CDS_LFHT_ACCOUNTING,
+			&policy, NULL);
+	if (!ht)
+		abort();
+	lfht_entry_add_keys(ht, 0, 1000);
+	ok(cds_lfht_trim(ht) == 256, "shrink to the target load order");
+	ok(!lfht_entry_nr_missing(ht, 0, 1000),
+		"nodes found after the trim, with accounting");
+	lfht_entry_destroy(ht);
+}
+
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg;
+
+	rcu_register_thread();
+	while (!uatomic_read(&trimmer_done))
+		*nr_bad += lfht_entry_nr_missing(ht, 0, NR_KEYS);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Alternately grow the table and trim it back, under lookups. */
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	unsigned long nr_wrong_size = 0;
+	pthread_t readers[NR_READERS];
+	int err = 0;
+
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	lfht_entry_add_keys(ht, 0, NR_KEYS);
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	for (i = 0; i < NR_TRIMS; i++) {
+		cds_lfht_resize(ht, 4 * INIT_SIZE);
+		if (cds_lfht_trim(ht) != 2048)
+			nr_wrong_size++;
+	}
+	uatomic_set(&trimmer_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!nr_wrong_size, "each trim shrinks the grown table");
+	ok(!err && !total_bad, "readers find the nodes across trims");
+	ok(!lfht_entry_nr_missing(ht, 0, NR_KEYS),
+		"nodes found after the trims");
+	lfht_entry_destroy(ht);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d readers and a trimmer", NR_READERS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
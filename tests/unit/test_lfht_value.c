@@ -0,0 +1,226 @@
+/*
+ * test_lfht_value.c
+ *
+ * Userspace RCU library - test the in-place value updates of hash table nodes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	7
+
+#define VALUE_MAGIC	0x1234abcdUL
+#define NR_KEYS		64
+#define NR_READERS	2
+#define NR_UPDATERS	2
+#define NR_UPDATES	20000	/* Per updater. */
+
+struct value {
+	unsigned long magic;
+	unsigned long key;
+	unsigned long count;		/* Number of updates of the key. */
+	struct rcu_head rcu_head;
+};
+
+struct entry {
+	struct lfht_entry base;
+	struct value *value;
+};
+
+static struct cds_lfht *ht;
+static int updaters_done;
+
+static struct value *value_alloc(unsigned long key, unsigned long count)
+{
+	struct value *v = malloc(sizeof(*v));
+
+	if (!v)
+		abort();
+	v->magic = VALUE_MAGIC;
+	v->key = key;
+	v->count = count;
+	return v;
+}
+
+static void free_value(struct rcu_head *head)
+{
+	struct value *v = caa_container_of(head, struct value, rcu_head);
+
+	v->magic = 0;
+	free(v);
+}
+
+/* Call with rcu_read_lock held. */
+static struct entry *lookup_key(unsigned long key)
+{
+	struct cds_lfht_node *node = lfht_entry_lookup(ht, key, NULL);
+
+	return node ? caa_container_of(node, struct entry, base.node) : NULL;
+}
+
+/* Free the current values, then the entries. No reader is left. */
+static void destroy_table(void)
+{
+	struct cds_lfht_iter iter;
+	struct entry *e;
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht, &iter, e, base.node)
+		free(e->value);
+	rcu_read_unlock();
+	lfht_entry_destroy(ht);
+}
+
+static void test_sequential(void)
+{
+	struct value *v0, *v1, *v2, *old;
+	struct entry *e;
+	unsigned long key;
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	ok1(ht);
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++) {
+		e = malloc(sizeof(*e));
+		if (!e)
+			abort();
+		lfht_entry_init(&e->base, key);
+		cds_lfht_value_set(e->value, value_alloc(key, 0));
+		cds_lfht_add(ht, test_hash_key(key), &e->base.node);
+	}
+	e = lookup_key(0);
+	v0 = cds_lfht_value_get(e->value);
+	ok(v0 && v0->key == 0 && v0->count == 0, "get the value set");
+	v1 = value_alloc(0, 1);
+	old = cds_lfht_value_xchg(e->value, v1);
+	ok(old == v0 && cds_lfht_value_get(e->value) == v1,
+		"exchange returns the old value");
+	v2 = value_alloc(0, 2);
+	old = cds_lfht_value_cmpxchg(e->value, v0, v2);
+	ok(old == v1 && cds_lfht_value_get(e->value) == v1,
+		"compare-and-exchange fails on another value");
+	old = cds_lfht_value_cmpxchg(e->value, v1, v2);
+	ok(old == v1 && cds_lfht_value_get(e->value) == v2,
+		"compare-and-exchange succeeds on the old value");
+	rcu_read_unlock();
+	call_rcu(&v0->rcu_head, free_value);
+	call_rcu(&v1->rcu_head, free_value);
+}
+
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg, key;
+	struct value *v;
+	struct entry *e;
+
+	rcu_register_thread();
+	while (!uatomic_read(&updaters_done)) {
+		rcu_read_lock();
+		for (key = 0; key < NR_KEYS; key++) {
+			e = lookup_key(key);
+			v = e ? cds_lfht_value_get(e->value) : NULL;
+			if (!v || CMM_LOAD_SHARED(v->magic) != VALUE_MAGIC
+			    || v->key != key)
+				(*nr_bad)++;
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Increment the count of the keys, with a new value per increment. */
+static void *thr_updater(void *arg)
+{
+	unsigned long i, key, seed = (unsigned long) arg;
+	struct value *v, *old, *cur;
+	struct entry *e;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_UPDATES; i++) {
+		seed = seed * 1103515245 + 12345;
+		key = (seed >> 16) % NR_KEYS;
+		v = value_alloc(key, 0);
+		rcu_read_lock();
+		e = lookup_key(key);
+		cur = cds_lfht_value_get(e->value);
+		do {
+			old = cur;
+			v->count = old->count + 1;
+			cur = cds_lfht_value_cmpxchg(e->value, old, v);
+		} while (cur != old);
+		rcu_read_unlock();
+		/* Each old value is returned to exactly one updater. */
+		call_rcu(&old->rcu_head, free_value);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, key, total_bad = 0;
+	unsigned long total_count = 0;
+	pthread_t readers[NR_READERS], updaters[NR_UPDATERS];
+	struct entry *e;
+	int err = 0;
+
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	for (i = 0; i < NR_UPDATERS; i++)
+		err |= pthread_create(&updaters[i], NULL, thr_updater,
+				(void *) (i + 1));
+	for (i = 0; i < NR_UPDATERS; i++)
+		err |= pthread_join(updaters[i], NULL);
+	uatomic_set(&updaters_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad, "readers see live values of their key");
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++) {
+		e = lookup_key(key);
+		total_count += cds_lfht_value_get(e->value)->count;
+	}
+	rcu_read_unlock();
+	/* Key 0 starts at 2, from the sequential test. */
+	ok(total_count == NR_UPDATERS * NR_UPDATES + 2,
+		"no value update lost");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d readers and %d updaters", NR_READERS, NR_UPDATERS);
+	test_concurrent();
+	destroy_table();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
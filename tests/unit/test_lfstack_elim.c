@@ -0,0 +1,156 @@
+/*
+ * test_lfstack_elim.c
+ *
+ * Userspace RCU library - test the elimination array of the lock-free stack
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu/uatomic.h>
+#include <urcu/lfstack.h>
+
+#include "tap.h"
+
+#define NR_TESTS	6
+
+#define NR_NODES	8
+#define NR_PUSHERS	2
+#define NR_POPPERS	2
+#define NR_PUSHES	100000	/* Per pusher. */
+
+/*
+ * Items are static, and pushed once by the concurrent test, which rules
+ * out the pop ABA without further synchronization.
+ */
+struct item {
+	unsigned long val;
+	struct cds_lfs_node node;
+};
+
+static struct __cds_lfs_stack stack;
+static struct cds_lfs_elim elim;
+static struct item items[NR_PUSHERS * NR_PUSHES];
+
+static void push_val(unsigned long val, bool *nonempty)
+{
+	struct item *it = &items[val];
+
+	it->val = val;
+	cds_lfs_node_init(&it->node);
+	*nonempty = cds_lfs_push_elim(&stack, &elim, &it->node);
+}
+
+/* Pop an item and return its value, or -1 if the stack is empty. */
+static long pop_val(void)
+{
+	struct cds_lfs_node *node;
+
+	node = __cds_lfs_pop_elim(&stack, &elim);
+	if (!node)
+		return -1;
+	return caa_container_of(node, struct item, node)->val;
+}
+
+static void test_sequential(void)
+{
+	unsigned long i, nr_bad = 0;
+	bool nonempty, was_nonempty = false;
+
+	__cds_lfs_init(&stack);
+	cds_lfs_elim_init(&elim);
+	ok(pop_val() == -1, "pop of an empty stack");
+	push_val(0, &nonempty);
+	ok(!nonempty, "push on an empty stack");
+	for (i = 1; i < NR_NODES; i++) {
+		push_val(i, &nonempty);
+		was_nonempty |= nonempty;
+	}
+	ok(was_nonempty && !cds_lfs_empty(&stack),
+		"uncontended pushes go to the stack");
+	for (i = 0; i < NR_NODES; i++) {
+		if (pop_val() != (long) (NR_NODES - 1 - i))
+			nr_bad++;
+	}
+	ok(!nr_bad, "LIFO order without contention");
+	ok(pop_val() == -1 && cds_lfs_empty(&stack), "stack emptied");
+}
+
+static int pushers_done;
+static unsigned long popped[NR_PUSHERS * NR_PUSHES];
+
+static void *thr_pusher(void *arg)
+{
+	unsigned long start = (unsigned long) arg * NR_PUSHES, i;
+	bool nonempty;
+
+	for (i = start; i < start + NR_PUSHES; i++)
+		push_val(i, &nonempty);
+	return NULL;
+}
+
+static void *thr_popper(void *arg)
+{
+	long val;
+
+	(void) arg;
+	for (;;) {
+		val = pop_val();
+		if (val >= 0)
+			uatomic_inc(&popped[val]);
+		else if (uatomic_read(&pushers_done))
+			break;
+	}
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t pushers[NR_PUSHERS], poppers[NR_POPPERS];
+	unsigned long i, nr_bad = 0;
+	int err = 0;
+
+	for (i = 0; i < NR_POPPERS; i++)
+		err |= pthread_create(&poppers[i], NULL, thr_popper, NULL);
+	for (i = 0; i < NR_PUSHERS; i++)
+		err |= pthread_create(&pushers[i], NULL, thr_pusher,
+				(void *) i);
+	for (i = 0; i < NR_PUSHERS; i++)
+		err |= pthread_join(pushers[i], NULL);
+	/* Pushes have completed: the stack holds all the nodes left. */
+	uatomic_set(&pushers_done, 1);
+	for (i = 0; i < NR_POPPERS; i++)
+		err |= pthread_join(poppers[i], NULL);
+	for (i = 0; i < NR_PUSHERS * NR_PUSHES; i++) {
+		if (popped[i] != 1)
+			nr_bad++;
+	}
+	ok(!err && !nr_bad, "each pushed node popped once by %d poppers",
+		NR_POPPERS);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	diag("single thread");
+	test_sequential();
+	diag("%d pushers and %d poppers", NR_PUSHERS, NR_POPPERS);
+	test_concurrent();
+
+	return exit_status();
+}
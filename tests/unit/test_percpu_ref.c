@@ -0,0 +1,156 @@
+/*
+ * test_percpu_ref.c
+ *
+ * Userspace RCU library - test the per-CPU reference counter
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <urcu.h>
+#include <urcu/percpu-ref.h>
+
+#include "tap.h"
+
+#define NR_TESTS	12
+
+#define NR_THREADS	4
+
+static struct urcu_percpu_ref ref;
+static unsigned long nr_release;
+static int test_stop;
+
+static void release(struct urcu_percpu_ref *r)
+{
+	uatomic_inc(&nr_release);
+	urcu_percpu_ref_exit(r);
+}
+
+static void test_kill_with_references(void)
+{
+	bool live, dying;
+
+	ok1(urcu_percpu_ref_init(&ref, release) == 0);
+	rcu_read_lock();
+	urcu_percpu_ref_get(&ref);
+	urcu_percpu_ref_put(&ref);
+	live = urcu_percpu_ref_tryget_live(&ref);
+	rcu_read_unlock();
+	ok(live && !urcu_percpu_ref_is_dying(&ref),
+		"tryget_live of a live counter");
+
+	urcu_percpu_ref_kill(&ref);
+	rcu_read_lock();
+	dying = urcu_percpu_ref_is_dying(&ref);
+	live = urcu_percpu_ref_tryget_live(&ref);
+	rcu_read_unlock();
+	ok(dying && !live, "tryget_live fails once killed");
+	rcu_barrier();
+	ok(uatomic_read(&nr_release) == 0,
+		"no release while a reference remains");
+	rcu_read_lock();
+	ok(urcu_percpu_ref_tryget(&ref),
+		"tryget succeeds while a reference remains");
+	urcu_percpu_ref_put(&ref);
+	rcu_read_unlock();
+	ok1(uatomic_read(&nr_release) == 0);
+	rcu_read_lock();
+	urcu_percpu_ref_put(&ref);
+	rcu_read_unlock();
+	ok(uatomic_read(&nr_release) == 1,
+		"release on the last put in shared mode");
+}
+
+static void test_kill_without_references(void)
+{
+	uatomic_set(&nr_release, 0);
+	ok1(urcu_percpu_ref_init(&ref, release) == 0);
+	urcu_percpu_ref_kill(&ref);
+	rcu_barrier();
+	ok(uatomic_read(&nr_release) == 1,
+		"release after the grace period of kill");
+}
+
+/*
+ * Get references in per-CPU mode and put them after the switch, and
+ * conversely.
+ */
+static void *thr_user(void *arg)
+{
+	unsigned long i, nr_held = 0;
+
+	(void) arg;
+	rcu_register_thread();
+	for (i = 0; !uatomic_read(&test_stop); i++) {
+		rcu_read_lock();
+		if (urcu_percpu_ref_tryget_live(&ref)) {
+			if (i & 1)
+				nr_held++;
+			else
+				urcu_percpu_ref_put(&ref);
+		}
+		rcu_read_unlock();
+		if (i % 1000 == 999)
+			(void) poll(NULL, 0, 0);
+	}
+	while (nr_held--) {
+		rcu_read_lock();
+		urcu_percpu_ref_put(&ref);
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t threads[NR_THREADS];
+	unsigned long i;
+	int err = 0;
+
+	uatomic_set(&nr_release, 0);
+	ok1(urcu_percpu_ref_init(&ref, release) == 0);
+	for (i = 0; i < NR_THREADS; i++)
+		err |= pthread_create(&threads[i], NULL, thr_user, NULL);
+	(void) poll(NULL, 0, 10);
+	urcu_percpu_ref_kill(&ref);
+	ok(!err, "counter killed while used by %d threads", NR_THREADS);
+	(void) poll(NULL, 0, 10);
+	uatomic_set(&test_stop, 1);
+	for (i = 0; i < NR_THREADS; i++)
+		err |= pthread_join(threads[i], NULL);
+	/* The last put may race with the switch to shared mode. */
+	rcu_barrier();
+	ok(!err && uatomic_read(&nr_release) == 1,
+		"released once after the last put");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("kill with references held");
+	test_kill_with_references();
+	diag("kill without references");
+	test_kill_without_references();
+	diag("references taken and put across kill");
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,160 @@
+/*
+ * test_rcuarray.c
+ *
+ * Userspace RCU library - test the RCU resizable array
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rcuarray.h>
+
+#include "tap.h"
+
+#define NR_TESTS	12
+
+#define NR_APPEND	10000
+
+static struct cds_rcu_array array;
+static int appender_done;
+
+/* Count the previous blocks queued for a grace period, and freed. */
+static unsigned long nr_queued, nr_invoked;
+static void (*array_func)(struct rcu_head *head);
+
+static void counting_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+	array_func(head);
+}
+
+static void counting_call_rcu(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	array_func = func;
+	uatomic_inc(&nr_queued);
+	call_rcu(head, counting_cb);
+}
+
+/* Entry i holds 1 + i. */
+static void *value(unsigned long i)
+{
+	return (void *) (uintptr_t) (1 + i);
+}
+
+static void *thr_appender(void *arg)
+{
+	unsigned long i, index;
+
+	(void) arg;
+	rcu_register_thread();
+	for (i = 0; i < NR_APPEND; i++) {
+		if (cds_rcu_array_append(&array, value(i), &index)
+				|| index != i)
+			abort();
+	}
+	rcu_unregister_thread();
+	uatomic_set(&appender_done, 1);
+	return NULL;
+}
+
+static void test_sequential(void)
+{
+	unsigned long i, index;
+	void *old;
+	int nulls = 1;
+
+	cds_rcu_array_init(&array, counting_call_rcu);
+	rcu_read_lock();
+	ok(!cds_rcu_array_get(&array, 0) && !cds_rcu_array_get(&array, 1000),
+		"empty array reads as NULL");
+	rcu_read_unlock();
+	ok1(cds_rcu_array_len(&array) == 0);
+	ok1(cds_rcu_array_set(&array, 10, value(10), &old) == 0 && !old);
+	ok1(cds_rcu_array_len(&array) == 11);
+	rcu_read_lock();
+	for (i = 0; i < 10; i++)
+		nulls &= !cds_rcu_array_get(&array, i);
+	ok(nulls && cds_rcu_array_get(&array, 10) == value(10),
+		"entries below the one set read as NULL");
+	rcu_read_unlock();
+	ok1(cds_rcu_array_set(&array, 10, value(20), &old) == 0
+		&& old == value(10));
+	ok1(cds_rcu_array_append(&array, value(11), &index) == 0
+		&& index == 11);
+	ok1(cds_rcu_array_set(&array, 10, NULL, NULL) == 0
+		&& cds_rcu_array_len(&array) == 12);
+	cds_rcu_array_destroy(&array);
+	rcu_barrier();
+}
+
+static void test_concurrent(void)
+{
+	unsigned long i, len, nr_bad = 0;
+	pthread_t appender;
+	void *v;
+	int err;
+
+	uatomic_set(&nr_queued, 0);
+	uatomic_set(&nr_invoked, 0);
+	cds_rcu_array_init(&array, counting_call_rcu);
+	err = pthread_create(&appender, NULL, thr_appender, NULL);
+	while (!err && !uatomic_read(&appender_done)) {
+		/* Entries read as NULL until set, never as another value. */
+		len = cds_rcu_array_len(&array);
+		rcu_read_lock();
+		for (i = 0; i < len + 64; i++) {
+			v = cds_rcu_array_get(&array, i);
+			if (v && v != value(i))
+				nr_bad++;
+		}
+		rcu_read_unlock();
+	}
+	if (!err)
+		err = pthread_join(appender, NULL);
+	ok(!err && !nr_bad, "reads concurrent with growth see no other value");
+	ok1(cds_rcu_array_len(&array) == NR_APPEND);
+	rcu_read_lock();
+	for (i = 0; i < NR_APPEND; i++) {
+		if (cds_rcu_array_get(&array, i) != value(i))
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	ok(!nr_bad, "entries kept across growth");
+	rcu_barrier();
+	ok(uatomic_read(&nr_queued) > 0
+			&& uatomic_read(&nr_invoked) == uatomic_read(&nr_queued),
+		"previous blocks freed after a grace period (%lu)",
+		uatomic_read(&nr_queued));
+	cds_rcu_array_destroy(&array);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("reads concurrent with appends");
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,198 @@
+/*
+ * test_rcucache.c
+ *
+ * Userspace RCU library - test the RCU CLOCK cache
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rcucache.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	16
+
+#define CAPACITY	8
+#define NR_THREADS	2
+#define NR_LOOKUPS	50000
+#define NR_KEYS		64
+
+struct entry {
+	unsigned long key;
+	struct cds_rcucache_node node;
+};
+
+static struct cds_rcucache *cache;
+static unsigned long nr_added, nr_freed;
+
+static void free_entry(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct entry, node.rcu_head));
+	uatomic_inc(&nr_freed);
+}
+
+static int match(struct cds_rcucache_node *node, const void *key)
+{
+	return caa_container_of(node, struct entry, node)->key
+		== *(const unsigned long *) key;
+}
+
+static unsigned long entry_key(struct cds_rcucache_node *node)
+{
+	return caa_container_of(node, struct entry, node)->key;
+}
+
+/* Add @key, returning the entry of the cache holding it. */
+static struct cds_rcucache_node *add_key(unsigned long key)
+{
+	struct entry *e = malloc(sizeof(*e));
+	struct cds_rcucache_node *ret;
+
+	if (!e)
+		abort();
+	e->key = key;
+	cds_rcucache_node_init(&e->node);
+	ret = cds_rcucache_add(cache, test_hash_key(key), match, &e->key,
+			&e->node);
+	if (ret == &e->node)
+		uatomic_inc(&nr_added);
+	else
+		free(e);
+	return ret;
+}
+
+static struct cds_rcucache_node *lookup_key(unsigned long key)
+{
+	return cds_rcucache_lookup(cache, test_hash_key(key), match, &key);
+}
+
+static void test_clock(void)
+{
+	struct cds_rcucache_stats stats;
+	struct cds_rcucache_node *node;
+	unsigned long key;
+	int added = 1, hits = 1;
+
+	ok1(!cds_rcucache_new(0, 1, free_entry));
+	cache = cds_rcucache_new(CAPACITY, 1, free_entry);
+	ok1(cache);
+	rcu_read_lock();
+	for (key = 0; key < CAPACITY; key++)
+		added &= entry_key(add_key(key)) == key;
+	ok(added && uatomic_read(&nr_added) == CAPACITY,
+		"%d entries added", CAPACITY);
+	ok(uatomic_read(&nr_added) == CAPACITY
+			&& entry_key(add_key(3)) == 3
+			&& uatomic_read(&nr_added) == CAPACITY,
+		"add of a present key returns its entry");
+	for (key = 0; key < CAPACITY - 1; key++) {
+		node = lookup_key(key);
+		hits &= node && entry_key(node) == key;
+	}
+	ok(hits, "lookups hit the entries");
+	ok(!lookup_key(100), "lookup of an absent key misses");
+
+	/* The only unreferenced entry is evicted. */
+	add_key(CAPACITY);
+	ok(!lookup_key(CAPACITY - 1), "unreferenced entry evicted");
+	ok(lookup_key(CAPACITY) && lookup_key(0),
+		"new and referenced entries kept");
+	rcu_read_unlock();
+	cds_rcucache_get_stats(cache, &stats);
+	ok(stats.count == CAPACITY && stats.capacity == CAPACITY
+			&& stats.evictions == 1,
+		"statistics: %lu entries, %lu evictions",
+		stats.count, stats.evictions);
+	ok(stats.hits == CAPACITY + 1 && stats.misses == 2,
+		"statistics: %lu hits, %lu misses", stats.hits, stats.misses);
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == 1, "evicted entry freed");
+
+	rcu_read_lock();
+	node = lookup_key(0);
+	ok1(cds_rcucache_del(cache, node) == 0);
+	ok1(cds_rcucache_del(cache, node) == -ENOENT);
+	rcu_read_unlock();
+	cds_rcucache_destroy(cache);
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == uatomic_read(&nr_added),
+		"destroy frees the remaining entries");
+}
+
+/* Look up random keys, adding them on a miss. */
+static void *thr_user(void *arg)
+{
+	unsigned int seed = (unsigned int) (unsigned long) arg;
+	struct cds_rcucache_node *node;
+	unsigned long i, key, *nr_bad = arg;
+
+	*nr_bad = 0;
+	rcu_register_thread();
+	for (i = 0; i < NR_LOOKUPS; i++) {
+		key = (unsigned long) rand_r(&seed) % NR_KEYS;
+		rcu_read_lock();
+		node = lookup_key(key);
+		if (!node)
+			node = add_key(key);
+		if (entry_key(node) != key)
+			(*nr_bad)++;
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t threads[NR_THREADS];
+	unsigned long nr_bad[NR_THREADS], i, total_bad = 0;
+	int err = 0;
+
+	uatomic_set(&nr_added, 0);
+	uatomic_set(&nr_freed, 0);
+	cache = cds_rcucache_new(2 * CAPACITY, 4, free_entry);
+	for (i = 0; i < NR_THREADS; i++)
+		err |= pthread_create(&threads[i], NULL, thr_user, &nr_bad[i]);
+	for (i = 0; i < NR_THREADS; i++) {
+		err |= pthread_join(threads[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad,
+		"concurrent lookups and adds return matching entries");
+	cds_rcucache_destroy(cache);
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == uatomic_read(&nr_added),
+		"every entry added is freed (%lu)", uatomic_read(&nr_added));
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("CLOCK eviction");
+	test_clock();
+	diag("%d threads looking up and adding keys", NR_THREADS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,286 @@
+/*
+ * test_rcuhtable.c
+ *
+ * Userspace RCU library - test the fixed-size RCU hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rcuhtable.h>
+
+#include "lfht-entry.h"
+#include "tap.h"
+
+#define NR_TESTS	16
+
+#define NR_KEYS		1000	/* Keys [0, 1000) stay in the table. */
+#define NR_UPDATERS	2
+#define NR_UPDATES	20000	/* Over the keys of each updater. */
+#define NR_UPDATE_KEYS	100
+#define NR_READERS	2
+
+struct entry {
+	unsigned long key;
+	unsigned long magic;
+	struct cds_rcuhtable_node node;
+	struct rcu_head rcu_head;
+};
+
+static struct cds_rcuhtable *ht;
+static int updaters_done;
+
+static int match(struct cds_rcuhtable_node *node, const void *key)
+{
+	return caa_container_of(node, struct entry, node)->key
+		== *(const unsigned long *) key;
+}
+
+static struct entry *entry_alloc(unsigned long key)
+{
+	struct entry *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	e->key = key;
+	e->magic = LFHT_ENTRY_MAGIC;
+	return e;
+}
+
+static void free_entry(struct rcu_head *head)
+{
+	struct entry *e = caa_container_of(head, struct entry, rcu_head);
+
+	e->magic = 0;
+	free(e);
+}
+
+/* Call with rcu_read_lock held. */
+static struct entry *lookup_key(unsigned long key)
+{
+	struct cds_rcuhtable_node *node;
+
+	node = cds_rcuhtable_lookup(ht, test_hash_key(key), match, &key);
+	return node ? caa_container_of(node, struct entry, node) : NULL;
+}
+
+/* Count the keys of [start, start + len) not found. */
+static unsigned long nr_missing(unsigned long start, unsigned long len)
+{
+	unsigned long key, nr = 0;
+
+	rcu_read_lock();
+	for (key = start; key < start + len; key++) {
+		if (!lookup_key(key))
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+/* Remove all the nodes of the table, and return how many there were. */
+static unsigned long empty_table(void)
+{
+	struct cds_rcuhtable_node *pos;
+	unsigned long i, nr = 0;
+
+	rcu_read_lock();
+	cds_rcuhtable_for_each(ht, i, pos) {
+		if (!cds_rcuhtable_del(ht, pos)) {
+			call_rcu(&caa_container_of(pos, struct entry,
+					node)->rcu_head, free_entry);
+			nr++;
+		}
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void test_sequential(void)
+{
+	struct cds_rcuhtable_stats stats;
+	struct cds_rcuhtable_node *node;
+	struct entry *e, *dup;
+	unsigned long key, nr;
+
+	ht = cds_rcuhtable_new(1000);
+	ok(ht && ht->mask == 1023, "size rounded up to a power of 2");
+	for (key = 0; key < NR_KEYS; key++)
+		cds_rcuhtable_add(ht, test_hash_key(key),
+				&entry_alloc(key)->node);
+	ok(!nr_missing(0, NR_KEYS), "added keys found");
+	ok(nr_missing(NR_KEYS, NR_KEYS) == NR_KEYS, "absent keys not found");
+	key = 7;
+	rcu_read_lock();
+	node = cds_rcuhtable_lookup(ht, test_hash_key(key), NULL, NULL);
+	ok(node && match(node, &key), "NULL match function matches the hash");
+	rcu_read_unlock();
+
+	/* Duplicates of key 7. */
+	cds_rcuhtable_add(ht, test_hash_key(key), &entry_alloc(key)->node);
+	cds_rcuhtable_add(ht, test_hash_key(key), &entry_alloc(key)->node);
+	nr = 0;
+	rcu_read_lock();
+	for (node = cds_rcuhtable_lookup(ht, test_hash_key(key), match, &key);
+			node;
+			node = cds_rcuhtable_next_duplicate(node, match, &key))
+		nr++;
+	rcu_read_unlock();
+	ok(nr == 3, "duplicates chained by next_duplicate");
+
+	dup = entry_alloc(key);
+	rcu_read_lock();
+	e = lookup_key(key);
+	ok(cds_rcuhtable_add_unique(ht, test_hash_key(key), match, &key,
+			&dup->node) == &e->node,
+		"add_unique returns the present node");
+	rcu_read_unlock();
+	dup->key = NR_KEYS;
+	key = NR_KEYS;
+	ok(cds_rcuhtable_add_unique(ht, test_hash_key(key), match, &key,
+			&dup->node) == &dup->node && !nr_missing(key, 1),
+		"add_unique adds an absent key");
+
+	cds_rcuhtable_get_stats(ht, &stats);
+	ok(stats.nr_buckets == 1024 && stats.nr_nodes == NR_KEYS + 3
+		&& stats.nr_empty < stats.nr_buckets && stats.max_chain >= 3,
+		"statistics count the nodes");
+
+	rcu_read_lock();
+	e = lookup_key(NR_KEYS);
+	ok(!cds_rcuhtable_del(ht, &e->node)
+		&& cds_rcuhtable_del(ht, &e->node) == -ENOENT,
+		"second removal of a node fails");
+	rcu_read_unlock();
+	call_rcu(&e->rcu_head, free_entry);
+	ok(nr_missing(NR_KEYS, 1) == 1, "removed key not found");
+	ok(cds_rcuhtable_destroy(ht) == -EPERM,
+		"destroy fails while the table holds nodes");
+	ok(empty_table() == NR_KEYS + 2, "iteration sees every node");
+	cds_rcuhtable_get_stats(ht, &stats);
+	ok(!stats.nr_nodes && stats.nr_empty == stats.nr_buckets
+		&& !stats.max_chain, "statistics of an empty table");
+}
+
+/* Check the stable keys, and the entries of the updated ones. */
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg, key;
+	struct entry *e;
+
+	rcu_register_thread();
+	while (!uatomic_read(&updaters_done)) {
+		rcu_read_lock();
+		for (key = 0; key < NR_KEYS + NR_UPDATERS * NR_UPDATE_KEYS;
+				key++) {
+			e = lookup_key(key);
+			if (key < NR_KEYS ? !e : e && e->key != key)
+				(*nr_bad)++;
+			if (e && CMM_LOAD_SHARED(e->magic) != LFHT_ENTRY_MAGIC)
+				(*nr_bad)++;
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Alternately add and remove each key of the updater. */
+static void *thr_updater(void *arg)
+{
+	unsigned long start = NR_KEYS + (unsigned long) arg * NR_UPDATE_KEYS;
+	unsigned long i, key, nr_bad = 0;
+	struct entry *e;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_UPDATES; i++) {
+		key = start + i % NR_UPDATE_KEYS;
+		e = entry_alloc(key);
+		rcu_read_lock();
+		if (cds_rcuhtable_add_unique(ht, test_hash_key(key), match,
+				&key, &e->node) != &e->node) {
+			free(e);
+			e = lookup_key(key);
+			if (!e || cds_rcuhtable_del(ht, &e->node))
+				nr_bad++;
+			else
+				call_rcu(&e->rcu_head, free_entry);
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return (void *) nr_bad;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, key, total_bad = 0;
+	pthread_t readers[NR_READERS], updaters[NR_UPDATERS];
+	void *ret;
+	int err = 0;
+
+	/* Few buckets, shared by the keys of the updaters and readers. */
+	ht = cds_rcuhtable_new(64);
+	if (!ht)
+		abort();
+	for (key = 0; key < NR_KEYS; key++)
+		cds_rcuhtable_add(ht, test_hash_key(key),
+				&entry_alloc(key)->node);
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	for (i = 0; i < NR_UPDATERS; i++)
+		err |= pthread_create(&updaters[i], NULL, thr_updater,
+				(void *) i);
+	for (i = 0; i < NR_UPDATERS; i++) {
+		err |= pthread_join(updaters[i], &ret);
+		total_bad += (unsigned long) ret;
+	}
+	ok(!err && !total_bad, "concurrent updates of shared buckets");
+	uatomic_set(&updaters_done, 1);
+	total_bad = 0;
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad, "readers concurrent with the updates");
+	ok(!nr_missing(0, NR_KEYS), "no stable key lost");
+	/* Both updaters end with all their keys removed. */
+	empty_table();
+	if (cds_rcuhtable_destroy(ht))
+		abort();
+	rcu_barrier();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	rcu_barrier();
+	if (cds_rcuhtable_destroy(ht))
+		abort();
+	diag("%d readers and %d updaters", NR_READERS, NR_UPDATERS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,228 @@
+/*
+ * test_rcuja.c
+ *
+ * Userspace RCU library - test the RCU Judy array
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rcuja.h>
+
+#include "tap.h"
+
+#define NR_TESTS	20
+
+#define DENSE_START	1000	/* Dense range [1000, 2000). */
+#define DENSE_LEN	1000
+#define NR_ROUNDS	50
+
+struct entry {
+	struct cds_ja_node node;
+	struct rcu_head rcu_head;
+};
+
+static const uint64_t sparse_keys[] = {
+	0, 1, 255, 256, 65535, 1ULL << 40, UINT64_MAX,
+};
+#define NR_SPARSE	(sizeof(sparse_keys) / sizeof(sparse_keys[0]))
+
+static struct cds_ja *ja;
+static int writer_done;
+
+static struct entry *entry_alloc(void)
+{
+	struct entry *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	return e;
+}
+
+static void free_entry_rcu(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct entry, rcu_head));
+}
+
+static void entry_free_rcu(struct cds_ja_node *node)
+{
+	call_rcu(&caa_container_of(node, struct entry, node)->rcu_head,
+		free_entry_rcu);
+}
+
+static int add_key(uint64_t key)
+{
+	struct entry *e = entry_alloc();
+	struct cds_ja_node *ret;
+
+	rcu_read_lock();
+	ret = cds_ja_add_unique(ja, key, &e->node);
+	rcu_read_unlock();
+	if (ret != &e->node)
+		free(e);
+	return ret == &e->node;
+}
+
+static void test_sequential(void)
+{
+	struct cds_ja_node *node, *prev;
+	struct entry *dup;
+	uint64_t key;
+	unsigned long i, count = 0;
+	int added = 1, order_ok = 1;
+
+	errno = 0;
+	ok1(!cds_ja_new(12) && errno == EINVAL);
+	ja = cds_ja_new(16);
+	ok1(ja);
+	errno = 0;
+	dup = entry_alloc();
+	rcu_read_lock();
+	ok(!cds_ja_add_unique(ja, 1 << 16, &dup->node) && errno == EINVAL,
+		"key out of the range of a 16-bit array");
+	rcu_read_unlock();
+	free(dup);
+	ok1(cds_ja_destroy(ja) == 0);
+
+	ja = cds_ja_new(64);
+	ok1(ja);
+	for (i = 0; i < NR_SPARSE; i++)
+		added &= add_key(sparse_keys[i]);
+	for (i = 0; i < DENSE_LEN; i += 2)
+		added &= add_key(DENSE_START + i);
+	ok(added, "sparse and dense keys added");
+
+	rcu_read_lock();
+	prev = NULL;
+	cds_ja_for_each_key_rcu(ja, node) {
+		if (prev && prev->key >= node->key)
+			order_ok = 0;
+		prev = node;
+		count++;
+	}
+	ok(order_ok && count == NR_SPARSE + DENSE_LEN / 2,
+		"traversal sees every key in increasing order");
+	node = cds_ja_lookup(ja, 1ULL << 40);
+	ok(node && node->key == 1ULL << 40, "lookup of a present key");
+	ok(!cds_ja_lookup(ja, DENSE_START + 1), "lookup of an absent key");
+	node = cds_ja_lookup_above_equal(ja, DENSE_START + 1);
+	ok(node && node->key == DENSE_START + 2, "above_equal of an absent key");
+	node = cds_ja_lookup_below_equal(ja, DENSE_START + 1);
+	ok(node && node->key == DENSE_START, "below_equal of an absent key");
+	node = cds_ja_lookup_below_equal(ja, (1ULL << 40) - 1);
+	ok(node && node->key == 65535, "below_equal across sparse nodes");
+	node = cds_ja_lookup_above_equal(ja, (1ULL << 40) + 1);
+	ok(node && node->key == UINT64_MAX, "above_equal of the highest key");
+	rcu_read_unlock();
+
+	dup = entry_alloc();
+	rcu_read_lock();
+	node = cds_ja_add_unique(ja, 256, &dup->node);
+	ok(node && node != &dup->node && node->key == 256,
+		"add_unique returns the node already holding the key");
+	rcu_read_unlock();
+	free(dup);
+
+	ok1(cds_ja_destroy(ja) == -EPERM);
+	rcu_read_lock();
+	node = cds_ja_lookup(ja, 255);
+	ok1(node && cds_ja_del(ja, node) == 0);
+	ok1(cds_ja_del(ja, node) == -ENOENT);
+	key = 255;
+	ok(!cds_ja_lookup(ja, key)
+			&& cds_ja_lookup_above_equal(ja, key)->key == 256,
+		"removed key is not found");
+	rcu_read_unlock();
+	entry_free_rcu(node);
+}
+
+/* Add and remove the odd keys of the dense range. */
+static void *thr_writer(void *arg)
+{
+	struct cds_ja_node *node;
+	unsigned long round, i;
+
+	(void) arg;
+	rcu_register_thread();
+	for (round = 0; round < NR_ROUNDS; round++) {
+		for (i = 1; i < DENSE_LEN; i += 2) {
+			if (!add_key(DENSE_START + i))
+				abort();
+		}
+		for (i = 1; i < DENSE_LEN; i += 2) {
+			rcu_read_lock();
+			node = cds_ja_lookup(ja, DENSE_START + i);
+			if (!node || cds_ja_del(ja, node))
+				abort();
+			rcu_read_unlock();
+			entry_free_rcu(node);
+		}
+	}
+	rcu_unregister_thread();
+	uatomic_set(&writer_done, 1);
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	struct cds_ja_node *node;
+	pthread_t writer;
+	unsigned long i, nr_missing = 0;
+	int err;
+
+	err = pthread_create(&writer, NULL, thr_writer, NULL);
+	while (!err && !uatomic_read(&writer_done)) {
+		/* The even keys of the dense range stay in the array. */
+		rcu_read_lock();
+		for (i = 0; i < DENSE_LEN; i += 2) {
+			node = cds_ja_lookup(ja, DENSE_START + i);
+			if (!node || node->key != DENSE_START + i)
+				nr_missing++;
+		}
+		rcu_read_unlock();
+	}
+	if (!err)
+		err = pthread_join(writer, NULL);
+	ok(!err && !nr_missing,
+		"lookups concurrent with updates of neighbouring keys");
+
+	rcu_read_lock();
+	cds_ja_for_each_key_rcu(ja, node) {
+		if (!cds_ja_del(ja, node))
+			entry_free_rcu(node);
+	}
+	rcu_read_unlock();
+	ok1(cds_ja_destroy(ja) == 0);
+	rcu_barrier();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("lookups concurrent with a writer");
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,450 @@
+/*
+ * test_rculist.c
+ *
+ * Userspace RCU library - test the batched and sorted updates of the RCU lists
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculist.h>
+#include <urcu/rcuhlist.h>
+
+#include "tap.h"
+
+#define NR_TESTS	16
+
+#define NR_READERS	2
+#define NR_REPLACES	2000
+#define NR_ELEMS	16
+#define NR_SORTED_ADDS	4000
+
+struct elem {
+	unsigned long val;
+	unsigned long gen;
+	struct cds_list_head node;
+	struct cds_hlist_node hnode;
+};
+
+static struct elem *elem_alloc(unsigned long val, unsigned long gen)
+{
+	struct elem *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	e->val = val;
+	e->gen = gen;
+	return e;
+}
+
+/* Add the values [start, start + len) to the tail of a private list. */
+static void list_fill(struct cds_list_head *list, unsigned long start,
+		unsigned long len, unsigned long gen)
+{
+	unsigned long i;
+
+	for (i = start; i < start + len; i++)
+		cds_list_add_tail(&elem_alloc(i, gen)->node, list);
+}
+
+/* Same for an hlist, added at its head, so in decreasing order. */
+static void hlist_fill(struct cds_hlist_head *list, unsigned long start,
+		unsigned long len, unsigned long gen)
+{
+	unsigned long i;
+
+	for (i = start; i < start + len; i++)
+		cds_hlist_add_head(&elem_alloc(i, gen)->hnode, list);
+}
+
+static void list_free(struct cds_list_head *list)
+{
+	struct elem *e, *tmp;
+
+	cds_list_for_each_entry_safe(e, tmp, list, node)
+		free(e);
+	CDS_INIT_LIST_HEAD(list);
+}
+
+static void hlist_free(struct cds_hlist_head *list)
+{
+	struct elem *e, *tmp;
+
+	cds_hlist_for_each_entry_safe_2(e, tmp, list, hnode)
+		free(e);
+	CDS_INIT_HLIST_HEAD(list);
+}
+
+/*
+ * Return 1 if @list holds the values @vals in order, with consistent
+ * backward links.
+ */
+static int list_is(struct cds_list_head *list, const unsigned long *vals,
+		unsigned long len)
+{
+	struct cds_list_head *pos;
+	unsigned long i = 0;
+
+	cds_list_for_each(pos, list) {
+		if (i >= len || pos->next->prev != pos
+		    || cds_list_entry(pos, struct elem, node)->val != vals[i])
+			return 0;
+		i++;
+	}
+	return i == len && list->next->prev == list;
+}
+
+static int hlist_is(struct cds_hlist_head *list, const unsigned long *vals,
+		unsigned long len)
+{
+	struct cds_hlist_node *pos, *prev = (struct cds_hlist_node *) list;
+	unsigned long i = 0;
+
+	cds_hlist_for_each(pos, list) {
+		if (i >= len || pos->prev != prev
+		    || cds_hlist_entry(pos, struct elem, hnode)->val != vals[i])
+			return 0;
+		prev = pos;
+		i++;
+	}
+	return i == len;
+}
+
+static void test_list(void)
+{
+	static const unsigned long spliced[] = { 3, 4, 0, 1, 2 };
+	static const unsigned long replaced[] = { 5, 6 };
+	CDS_LIST_HEAD(head);
+	CDS_LIST_HEAD(list);
+	CDS_LIST_HEAD(old);
+
+	list_fill(&head, 0, 3, 0);
+	cds_list_splice_init_rcu(&list, &head);
+	ok(list_is(&head, spliced + 2, 3), "splice of an empty list");
+	list_fill(&list, 3, 2, 0);
+	cds_list_splice_init_rcu(&list, &head);
+	ok(list_is(&head, spliced, 5) && cds_list_empty(&list),
+		"splice at the head of the list");
+
+	list_fill(&list, 5, 2, 0);
+	cds_list_replace_all_rcu(&list, &head, &old);
+	ok(list_is(&head, replaced, 2) && cds_list_empty(&list),
+		"replace all the elements");
+	synchronize_rcu();
+	cds_list_replace_all_rcu_done(&old);
+	ok(list_is(&old, spliced, 5), "old elements moved to their own head");
+	list_free(&old);
+
+	cds_list_replace_all_rcu(&list, &head, &old);
+	ok(cds_list_empty(&head), "replace by an empty list");
+	synchronize_rcu();
+	cds_list_replace_all_rcu_done(&old);
+	ok(list_is(&old, replaced, 2), "old elements of the emptied list");
+	list_free(&old);
+	list_fill(&list, 5, 2, 0);
+	cds_list_replace_all_rcu(&list, &head, &old);
+	ok(list_is(&head, replaced, 2) && cds_list_empty(&old),
+		"replace the elements of an empty list");
+	list_free(&head);
+}
+
+static void test_hlist(void)
+{
+	static const unsigned long spliced[] = { 4, 3, 2, 1, 0 };
+	static const unsigned long replaced[] = { 6, 5 };
+	CDS_HLIST_HEAD(head);
+	CDS_HLIST_HEAD(list);
+	CDS_HLIST_HEAD(old);
+
+	hlist_fill(&head, 0, 3, 0);
+	cds_hlist_splice_init_rcu(&list, &head);
+	ok(hlist_is(&head, spliced + 2, 3), "splice of an empty hlist");
+	hlist_fill(&list, 3, 2, 0);
+	cds_hlist_splice_init_rcu(&list, &head);
+	ok(hlist_is(&head, spliced, 5) && !list.next,
+		"splice at the head of the hlist");
+
+	hlist_fill(&list, 5, 2, 0);
+	cds_hlist_replace_all_rcu(&list, &head, &old);
+	ok(hlist_is(&head, replaced, 2) && hlist_is(&old, spliced, 5)
+		&& !list.next, "replace all the elements of the hlist");
+	synchronize_rcu();
+	hlist_free(&old);
+	cds_hlist_replace_all_rcu(&list, &head, &old);
+	ok(!head.next && hlist_is(&old, replaced, 2),
+		"replace by an empty hlist");
+	synchronize_rcu();
+	hlist_free(&old);
+}
+
+static int list_cmp(const struct cds_list_head *a,
+		const struct cds_list_head *b)
+{
+	unsigned long va = cds_list_entry(a, struct elem, node)->val;
+	unsigned long vb = cds_list_entry(b, struct elem, node)->val;
+
+	return (va > vb) - (va < vb);
+}
+
+static int hlist_cmp(const struct cds_hlist_node *a,
+		const struct cds_hlist_node *b)
+{
+	unsigned long va = cds_hlist_entry(a, struct elem, hnode)->val;
+	unsigned long vb = cds_hlist_entry(b, struct elem, hnode)->val;
+
+	return (va > vb) - (va < vb);
+}
+
+/* Return the generation of the elements of @list holding @val, in order. */
+static unsigned long list_gens(struct cds_list_head *list, unsigned long val)
+{
+	unsigned long gens = 0;
+	struct elem *e;
+
+	cds_list_for_each_entry(e, list, node) {
+		if (e->val == val)
+			gens = gens * 10 + e->gen;
+	}
+	return gens;
+}
+
+static unsigned long hlist_gens(struct cds_hlist_head *list,
+		unsigned long val)
+{
+	struct cds_hlist_node *pos;
+	unsigned long gens = 0;
+	struct elem *e;
+
+	cds_hlist_for_each_entry(e, pos, list, hnode) {
+		if (e->val == val)
+			gens = gens * 10 + e->gen;
+	}
+	return gens;
+}
+
+static void test_sorted(void)
+{
+	static const unsigned long added[] = { 5, 1, 3, 3, 0, 9, 3 };
+	static const unsigned long sorted[] = { 0, 1, 3, 3, 3, 5, 9 };
+	static const unsigned long linked[] = { 0, 2, 3, 4, 6, 8 };
+	struct elem *two, *six;
+	CDS_LIST_HEAD(head);
+	CDS_HLIST_HEAD(hhead);
+	unsigned long i;
+
+	/* The generation of an element is its index in @added. */
+	for (i = 0; i < CAA_ARRAY_SIZE(added); i++) {
+		cds_list_add_sorted_rcu(&elem_alloc(added[i], i)->node, &head,
+			list_cmp);
+		cds_hlist_add_sorted_rcu(&elem_alloc(added[i], i)->hnode,
+			&hhead, hlist_cmp);
+	}
+	ok(list_is(&head, sorted, CAA_ARRAY_SIZE(sorted))
+		&& list_gens(&head, 3) == 236,
+		"sorted list, equal elements in insertion order");
+	ok(hlist_is(&hhead, sorted, CAA_ARRAY_SIZE(sorted))
+		&& hlist_gens(&hhead, 3) == 236,
+		"sorted hlist, equal elements in insertion order");
+	list_free(&head);
+	hlist_free(&hhead);
+
+	two = elem_alloc(2, 0);
+	six = elem_alloc(6, 0);
+	cds_hlist_add_head_rcu(&two->hnode, &hhead);
+	cds_hlist_add_behind_rcu(&six->hnode, &two->hnode);
+	cds_hlist_add_before_rcu(&elem_alloc(0, 0)->hnode, &two->hnode);
+	cds_hlist_add_before_rcu(&elem_alloc(4, 0)->hnode, &six->hnode);
+	cds_hlist_add_behind_rcu(&elem_alloc(8, 0)->hnode, &six->hnode);
+	cds_hlist_add_behind_rcu(&elem_alloc(3, 0)->hnode, &two->hnode);
+	ok(hlist_is(&hhead, linked, CAA_ARRAY_SIZE(linked)),
+		"hlist adds before and behind an element");
+	hlist_free(&hhead);
+}
+
+static CDS_LIST_HEAD(sorted_list);
+static CDS_HLIST_HEAD(sorted_hlist);
+static int sorter_done;
+
+/* Readers traverse sorted lists at all times. */
+static void *thr_sorted_reader(void *arg)
+{
+	unsigned long *nr_bad = arg, prev;
+	struct cds_hlist_node *pos;
+	struct elem *e;
+
+	rcu_register_thread();
+	while (!uatomic_read(&sorter_done)) {
+		rcu_read_lock();
+		prev = 0;
+		cds_list_for_each_entry_rcu(e, &sorted_list, node) {
+			if (e->val < prev)
+				(*nr_bad)++;
+			prev = e->val;
+		}
+		prev = 0;
+		cds_hlist_for_each_entry_rcu(e, pos, &sorted_hlist, hnode) {
+			if (e->val < prev)
+				(*nr_bad)++;
+			prev = e->val;
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Add random values, and remove the first element once in a while. */
+static void test_sorted_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	unsigned long seed = 1, val;
+	pthread_t readers[NR_READERS];
+	struct elem *e, *he;
+	int err = 0;
+
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_sorted_reader,
+				&nr_bad[i]);
+	for (i = 0; i < NR_SORTED_ADDS; i++) {
+		seed = seed * 1103515245 + 12345;
+		val = (seed >> 16) % 1000;
+		cds_list_add_sorted_rcu(&elem_alloc(val, 0)->node,
+			&sorted_list, list_cmp);
+		cds_hlist_add_sorted_rcu(&elem_alloc(val, 0)->hnode,
+			&sorted_hlist, hlist_cmp);
+		if (i % 4 != 3)
+			continue;
+		e = cds_list_entry(sorted_list.next, struct elem, node);
+		he = cds_hlist_entry(sorted_hlist.next, struct elem, hnode);
+		cds_list_del_rcu(&e->node);
+		cds_hlist_del_rcu(&he->hnode);
+		synchronize_rcu();
+		free(e);
+		free(he);
+	}
+	uatomic_set(&sorter_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad, "readers see sorted lists");
+	list_free(&sorted_list);
+	hlist_free(&sorted_hlist);
+}
+
+static CDS_LIST_HEAD(shared_list);
+static CDS_HLIST_HEAD(shared_hlist);
+static int updater_done;
+
+/*
+ * Each replacement publishes NR_ELEMS elements of a new generation:
+ * readers see all the elements of a single generation.
+ */
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg, nr, gen;
+	struct cds_hlist_node *pos;
+	struct elem *e;
+
+	rcu_register_thread();
+	while (!uatomic_read(&updater_done)) {
+		rcu_read_lock();
+		nr = 0;
+		gen = 0;
+		cds_list_for_each_entry_rcu(e, &shared_list, node) {
+			if (!nr)
+				gen = e->gen;
+			if (e->gen != gen || e->val != nr)
+				(*nr_bad)++;
+			nr++;
+		}
+		if (nr != NR_ELEMS)
+			(*nr_bad)++;
+		nr = 0;
+		cds_hlist_for_each_entry_rcu(e, pos, &shared_hlist, hnode) {
+			if (!nr)
+				gen = e->gen;
+			if (e->gen != gen || e->val != NR_ELEMS - 1 - nr)
+				(*nr_bad)++;
+			nr++;
+		}
+		if (nr != NR_ELEMS)
+			(*nr_bad)++;
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	pthread_t readers[NR_READERS];
+	CDS_LIST_HEAD(list);
+	CDS_LIST_HEAD(old);
+	CDS_HLIST_HEAD(hlist);
+	CDS_HLIST_HEAD(hold);
+	int err = 0;
+
+	list_fill(&list, 0, NR_ELEMS, 0);
+	cds_list_splice_init_rcu(&list, &shared_list);
+	hlist_fill(&hlist, 0, NR_ELEMS, 0);
+	cds_hlist_splice_init_rcu(&hlist, &shared_hlist);
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	for (i = 1; i <= NR_REPLACES; i++) {
+		list_fill(&list, 0, NR_ELEMS, i);
+		cds_list_replace_all_rcu(&list, &shared_list, &old);
+		hlist_fill(&hlist, 0, NR_ELEMS, i);
+		cds_hlist_replace_all_rcu(&hlist, &shared_hlist, &hold);
+		synchronize_rcu();
+		cds_list_replace_all_rcu_done(&old);
+		list_free(&old);
+		hlist_free(&hold);
+	}
+	uatomic_set(&updater_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad,
+		"readers see the elements of a single replacement");
+	list_free(&shared_list);
+	hlist_free(&shared_hlist);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("list");
+	test_list();
+	diag("hlist");
+	test_hlist();
+	diag("sorted adds");
+	test_sorted();
+	diag("%d readers concurrent with replacements", NR_READERS);
+	test_concurrent();
+	diag("%d readers concurrent with sorted adds", NR_READERS);
+	test_sorted_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
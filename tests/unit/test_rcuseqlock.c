@@ -0,0 +1,217 @@
+/*
+ * test_rcuseqlock.c
+ *
+ * Userspace RCU library - test the RCU sequence lock
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rcuseqlock.h>
+
+#include "tap.h"
+
+#define NR_TESTS	8
+
+#define NR_WRITERS	2
+#define NR_WRITES	100000
+#define SWAP_EVERY	100
+
+/* Consistent when every word holds the same count. */
+struct value {
+	unsigned long words[4];
+};
+
+struct obj {
+	struct rcu_seqlock lock;
+	struct value value;
+	struct rcu_head rcu_head;
+};
+
+static struct rcu_seqlock lock = RCU_SEQLOCK_INIT;
+static struct value value;
+static struct obj *gp;
+static int nr_writers_done;
+
+static void value_set(struct value *v, unsigned long count)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		v->words[i] = count;
+}
+
+static int value_consistent(const struct value *v)
+{
+	return v->words[0] == v->words[1] && v->words[1] == v->words[2]
+		&& v->words[2] == v->words[3];
+}
+
+static void free_obj(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct obj, rcu_head));
+}
+
+static void test_sequential(void)
+{
+	struct value v, copy;
+	unsigned long seq;
+
+	seq = rcu_seqlock_read_begin(&lock);
+	ok(!(seq & 1) && !rcu_seqlock_read_retry(&lock, seq),
+		"read without write is not retried");
+	seq = rcu_seqlock_read_begin(&lock);
+	rcu_seqlock_write_lock(&lock);
+	value.words[0] = 1;
+	rcu_seqlock_write_unlock(&lock);
+	ok(rcu_seqlock_read_retry(&lock, seq), "read across a write is retried");
+	ok1(rcu_seqlock_read_begin(&lock) == seq + 2);
+
+	value_set(&v, 42);
+	rcu_seqlock_write_copy(&lock, &value, &v, sizeof(v));
+	rcu_seqlock_read_copy(&lock, &copy, &value, sizeof(copy));
+	ok(value_consistent(&copy) && copy.words[0] == 42,
+		"copy out of a value written in place");
+	value_set(&value, 0);
+}
+
+/* Increment every word of the value, in place. */
+static void *thr_writer(void *arg)
+{
+	unsigned long i;
+	unsigned int j;
+
+	(void) arg;
+	for (i = 0; i < NR_WRITES; i++) {
+		rcu_seqlock_write_lock(&lock);
+		for (j = 0; j < 4; j++)
+			CMM_STORE_SHARED(value.words[j], value.words[j] + 1);
+		rcu_seqlock_write_unlock(&lock);
+	}
+	uatomic_inc(&nr_writers_done);
+	return NULL;
+}
+
+/*
+ * Update the value of the published object in place, and every
+ * SWAP_EVERY updates, publish a copy.
+ */
+static void *thr_swapper(void *arg)
+{
+	struct obj *o, *old;
+	unsigned long i;
+	unsigned int j;
+
+	(void) arg;
+	rcu_register_thread();
+	for (i = 1; i <= NR_WRITES; i++) {
+		if (i % SWAP_EVERY) {
+			o = gp;
+			rcu_seqlock_write_lock(&o->lock);
+			for (j = 0; j < 4; j++)
+				CMM_STORE_SHARED(o->value.words[j], i);
+			rcu_seqlock_write_unlock(&o->lock);
+			continue;
+		}
+		o = malloc(sizeof(*o));
+		if (!o)
+			abort();
+		rcu_seqlock_init(&o->lock);
+		value_set(&o->value, i);
+		old = rcu_xchg_pointer(&gp, o);
+		call_rcu(&old->rcu_head, free_obj);
+	}
+	rcu_unregister_thread();
+	uatomic_inc(&nr_writers_done);
+	return NULL;
+}
+
+static void test_in_place(void)
+{
+	pthread_t writers[NR_WRITERS];
+	unsigned long i, nr_bad = 0;
+	struct value copy;
+	int err = 0;
+
+	for (i = 0; i < NR_WRITERS; i++)
+		err |= pthread_create(&writers[i], NULL, thr_writer, NULL);
+	while (!err && uatomic_read(&nr_writers_done) < NR_WRITERS) {
+		rcu_seqlock_read_copy(&lock, &copy, &value, sizeof(copy));
+		if (!value_consistent(&copy))
+			nr_bad++;
+	}
+	for (i = 0; i < NR_WRITERS; i++)
+		err |= pthread_join(writers[i], NULL);
+	ok(!err && !nr_bad, "reads concurrent with %d writers are consistent",
+		NR_WRITERS);
+	ok(value_consistent(&value)
+			&& value.words[0] == NR_WRITERS * NR_WRITES,
+		"writers are serialized");
+}
+
+static void test_hybrid(void)
+{
+	unsigned long nr_bad = 0, last = 0;
+	struct value copy;
+	pthread_t swapper;
+	struct obj *o;
+	int err;
+
+	o = malloc(sizeof(*o));
+	if (!o)
+		abort();
+	rcu_seqlock_init(&o->lock);
+	value_set(&o->value, 0);
+	rcu_assign_pointer(gp, o);
+	uatomic_set(&nr_writers_done, 0);
+	err = pthread_create(&swapper, NULL, thr_swapper, NULL);
+	while (!err && !uatomic_read(&nr_writers_done)) {
+		rcu_read_lock();
+		o = rcu_dereference(gp);
+		rcu_seqlock_read_copy(&o->lock, &copy, &o->value,
+			sizeof(copy));
+		rcu_read_unlock();
+		/* The value only moves forward, across swaps too. */
+		if (!value_consistent(&copy) || copy.words[0] < last)
+			nr_bad++;
+		last = copy.words[0];
+	}
+	if (!err)
+		err = pthread_join(swapper, NULL);
+	ok(!err && !nr_bad,
+		"reads concurrent with in-place updates and swaps");
+	ok1(gp->value.words[0] == NR_WRITES);
+	free(gp);
+	rcu_barrier();
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("in-place updates by %d writers", NR_WRITERS);
+	test_in_place();
+	diag("in-place updates and swaps of a RCU-published object");
+	test_hybrid();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,270 @@
+/*
+ * test_rcuskiplist.c
+ *
+ * Userspace RCU library - test the RCU skip list
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rcuskiplist.h>
+
+#include "tap.h"
+
+#define NR_TESTS	16
+
+#define NR_KEYS		1000	/* Even keys from 2 to 2 * NR_KEYS. */
+#define NR_WRITERS	2
+#define NR_ROUNDS	20
+
+struct entry {
+	unsigned long key;
+	struct rcu_head rcu_head;
+	struct cds_skiplist_node node;	/* Last: variable-sized tower. */
+};
+
+static struct cds_skiplist *list;
+static int writers_done;
+static unsigned long nr_out_of_order;
+
+static int cmp_entry(struct cds_skiplist_node *node, const void *key)
+{
+	unsigned long a = caa_container_of(node, struct entry, node)->key;
+	unsigned long b = *(const unsigned long *) key;
+
+	return (a > b) - (a < b);
+}
+
+static unsigned long node_key(struct cds_skiplist_node *node)
+{
+	return caa_container_of(node, struct entry, node)->key;
+}
+
+static struct entry *entry_alloc(unsigned long key)
+{
+	unsigned int level = cds_skiplist_random_level();
+	struct entry *e;
+
+	e = malloc(offsetof(struct entry, node)
+			+ cds_skiplist_node_size(level));
+	if (!e)
+		abort();
+	e->key = key;
+	cds_skiplist_node_init(&e->node, level);
+	return e;
+}
+
+static void free_entry_rcu(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct entry, rcu_head));
+}
+
+/* Removed entries are freed after a grace period. */
+static void entry_free_rcu(struct cds_skiplist_node *node)
+{
+	struct entry *e = caa_container_of(node, struct entry, node);
+
+	call_rcu(&e->rcu_head, free_entry_rcu);
+}
+
+static unsigned long count_nodes(void)
+{
+	struct cds_skiplist_node *node;
+	unsigned long count = 0, prev = 0;
+
+	rcu_read_lock();
+	cds_skiplist_for_each(list, node) {
+		if (node_key(node) <= prev)
+			uatomic_inc(&nr_out_of_order);
+		prev = node_key(node);
+		count++;
+	}
+	rcu_read_unlock();
+	return count;
+}
+
+/* Shuffled even keys. */
+static void shuffle_keys(unsigned long *keys, unsigned long nr)
+{
+	unsigned long i, j, tmp;
+
+	for (i = 0; i < nr; i++)
+		keys[i] = 2 * (i + 1);
+	for (i = nr - 1; i > 0; i--) {
+		j = (unsigned long) rand() % (i + 1);
+		tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+static void test_sequential(void)
+{
+	unsigned long keys[NR_KEYS], i, key, lo, hi, count;
+	struct cds_skiplist_node *node, *ret;
+	struct entry *dup;
+	int added = 1;
+
+	list = cds_skiplist_new(cmp_entry);
+	ok1(list);
+	shuffle_keys(keys, NR_KEYS);
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++) {
+		struct entry *e = entry_alloc(keys[i]);
+
+		if (cds_skiplist_add_unique(list, &e->key, &e->node)
+				!= &e->node)
+			added = 0;
+	}
+	rcu_read_unlock();
+	ok(added, "%d shuffled keys added", NR_KEYS);
+	ok(count_nodes() == NR_KEYS && !nr_out_of_order,
+		"traversal sees every key in increasing order");
+
+	rcu_read_lock();
+	key = 500;
+	node = cds_skiplist_lookup(list, &key);
+	ok(node && node_key(node) == 500, "lookup of a present key");
+	key = 501;
+	ok(!cds_skiplist_lookup(list, &key), "lookup of an absent key");
+	node = cds_skiplist_lower_bound(list, &key);
+	ok(node && node_key(node) == 502, "lower bound of an absent key");
+	key = 2 * NR_KEYS + 1;
+	ok(!cds_skiplist_lower_bound(list, &key), "lower bound past the end");
+	lo = 99;
+	hi = 120;
+	count = 0;
+	cds_skiplist_for_each_range(list, &lo, &hi, node) {
+		if (node_key(node) < lo || node_key(node) > hi)
+			break;
+		count++;
+	}
+	ok(!node && count == 11, "range [99, 120] holds 11 keys");
+
+	dup = entry_alloc(500);
+	ret = cds_skiplist_add_unique(list, &dup->key, &dup->node);
+	ok(ret != &dup->node && node_key(ret) == 500,
+		"add_unique returns the node already holding the key");
+	free(dup);
+
+	key = 500;
+	node = cds_skiplist_lookup(list, &key);
+	ok1(cds_skiplist_del(list, node) == 0);
+	ok1(cds_skiplist_is_node_deleted(node));
+	ok1(cds_skiplist_del(list, node) == -ENOENT);
+	ok(!cds_skiplist_lookup(list, &key), "removed key is not found");
+	rcu_read_unlock();
+	entry_free_rcu(node);
+	ok(count_nodes() == NR_KEYS - 1 && !nr_out_of_order,
+		"traversal after removal");
+}
+
+/*
+ * Each writer owns the odd keys congruent to its number, and adds and
+ * removes them repeatedly while the main thread walks the list.
+ */
+static void *thr_writer(void *arg)
+{
+	unsigned long nr = (unsigned long) arg, round, key;
+	struct cds_skiplist_node *node;
+
+	rcu_register_thread();
+	for (round = 0; round < NR_ROUNDS; round++) {
+		for (key = 2 * nr + 1; key < 2 * NR_KEYS;
+				key += 2 * NR_WRITERS) {
+			struct entry *e = entry_alloc(key);
+
+			rcu_read_lock();
+			if (cds_skiplist_add_unique(list, &e->key, &e->node)
+					!= &e->node)
+				abort();
+			rcu_read_unlock();
+		}
+		for (key = 2 * nr + 1; key < 2 * NR_KEYS;
+				key += 2 * NR_WRITERS) {
+			rcu_read_lock();
+			node = cds_skiplist_lookup(list, &key);
+			if (!node || cds_skiplist_del(list, node))
+				abort();
+			rcu_read_unlock();
+			entry_free_rcu(node);
+		}
+	}
+	rcu_unregister_thread();
+	uatomic_inc(&writers_done);
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t writers[NR_WRITERS];
+	struct cds_skiplist_node *node;
+	unsigned long i, prev, even;
+	int err = 0, evens_ok = 1;
+
+	for (i = 0; i < NR_WRITERS; i++)
+		err |= pthread_create(&writers[i], NULL, thr_writer,
+				(void *) i);
+	while (!err && uatomic_read(&writers_done) < NR_WRITERS) {
+		/* The even keys but 500 stay in the list throughout. */
+		rcu_read_lock();
+		prev = even = 0;
+		cds_skiplist_for_each(list, node) {
+			if (node_key(node) <= prev)
+				uatomic_inc(&nr_out_of_order);
+			prev = node_key(node);
+			if (prev & 1)
+				continue;
+			if (prev != even + (even == 498 ? 4 : 2))
+				evens_ok = 0;
+			even = prev;
+		}
+		if (even != 2 * NR_KEYS)
+			evens_ok = 0;
+		rcu_read_unlock();
+	}
+	for (i = 0; i < NR_WRITERS; i++)
+		err |= pthread_join(writers[i], NULL);
+	ok(!err && !nr_out_of_order && evens_ok,
+		"concurrent traversals see the keys in order");
+
+	rcu_read_lock();
+	cds_skiplist_for_each(list, node) {
+		if (!cds_skiplist_del(list, node))
+			entry_free_rcu(node);
+	}
+	rcu_read_unlock();
+	rcu_barrier();
+	ok1(cds_skiplist_destroy(list) == 0);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("single thread");
+	test_sequential();
+	diag("%d writers adding and removing keys", NR_WRITERS);
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,200 @@
+/*
+ * test_rcuslab.c
+ *
+ * Userspace RCU library - test the RCU-aware object cache
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <urcu.h>
+#include <urcu/rcuslab.h>
+
+#include "tap.h"
+
+#define NR_TESTS	14
+
+#define OBJ_SIZE	40
+#define OBJ_ALIGN	64
+#define NR_OBJS		200
+
+static struct cds_rcu_slab *slab;
+static void *objs[NR_OBJS];
+
+/* Count the batches queued and invoked by the cache. */
+static unsigned long nr_queued, nr_invoked;
+static void (*slab_func)(struct rcu_head *head);
+
+static void counting_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+	slab_func(head);
+}
+
+static void counting_call_rcu(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	slab_func = func;
+	uatomic_inc(&nr_queued);
+	call_rcu(head, counting_cb);
+}
+
+static int reader_locked, reader_release;
+
+static void *thr_reader(void *arg)
+{
+	(void) arg;
+	rcu_register_thread();
+	rcu_read_lock();
+	uatomic_set(&reader_locked, 1);
+	while (!uatomic_read(&reader_release))
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Free the objects of another thread after a grace period. */
+static void *thr_remote_free(void *arg)
+{
+	unsigned long i;
+
+	(void) arg;
+	rcu_register_thread();
+	for (i = 0; i < NR_OBJS; i++)
+		cds_rcu_slab_free_rcu(slab, objs[i]);
+	cds_rcu_slab_flush(slab);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static int cmp_ptr(const void *a, const void *b)
+{
+	uintptr_t pa = (uintptr_t) *(void * const *) a;
+	uintptr_t pb = (uintptr_t) *(void * const *) b;
+
+	return (pa > pb) - (pa < pb);
+}
+
+static void test_alloc_free(void)
+{
+	void *first[NR_OBJS];
+	unsigned long i;
+	int aligned = 1, reused = 1;
+
+	errno = 0;
+	ok1(!cds_rcu_slab_create(OBJ_SIZE, 3, call_rcu) && errno == EINVAL);
+	slab = cds_rcu_slab_create(OBJ_SIZE, OBJ_ALIGN, counting_call_rcu);
+	ok1(slab);
+	for (i = 0; i < NR_OBJS; i++) {
+		objs[i] = cds_rcu_slab_alloc(slab);
+		if (!objs[i] || ((uintptr_t) objs[i] & (OBJ_ALIGN - 1)))
+			aligned = 0;
+		else
+			memset(objs[i], 0x5a, OBJ_SIZE);
+		first[i] = objs[i];
+	}
+	ok(aligned, "%d objects allocated and aligned on %d bytes",
+		NR_OBJS, OBJ_ALIGN);
+	ok1(cds_rcu_slab_destroy(slab) == -EBUSY);
+	for (i = 0; i < NR_OBJS; i++)
+		cds_rcu_slab_free(slab, objs[i]);
+	qsort(first, NR_OBJS, sizeof(first[0]), cmp_ptr);
+	for (i = 0; i < NR_OBJS; i++) {
+		objs[i] = cds_rcu_slab_alloc(slab);
+		if (!bsearch(&objs[i], first, NR_OBJS, sizeof(first[0]),
+				cmp_ptr))
+			reused = 0;
+	}
+	ok(reused, "freed objects are reused");
+}
+
+static void test_free_rcu(void)
+{
+	pthread_t reader;
+	unsigned long i;
+	int err;
+
+	uatomic_set(&nr_queued, 0);
+	uatomic_set(&nr_invoked, 0);
+	for (i = 0; i < CDS_RCU_SLAB_BATCH - 1; i++)
+		cds_rcu_slab_free_rcu(slab, objs[i]);
+	ok(uatomic_read(&nr_queued) == 0, "partial batch is not queued");
+	cds_rcu_slab_free_rcu(slab, objs[i]);
+	ok(uatomic_read(&nr_queued) == 1, "full batch is queued");
+	rcu_barrier();
+	ok1(uatomic_read(&nr_invoked) == 1);
+
+	/* A batch waits for the readers which may still see its objects. */
+	err = pthread_create(&reader, NULL, thr_reader, NULL);
+	while (!err && !uatomic_read(&reader_locked))
+		(void) poll(NULL, 0, 1);
+	cds_rcu_slab_free_rcu(slab, objs[CDS_RCU_SLAB_BATCH]);
+	cds_rcu_slab_flush(slab);
+	(void) poll(NULL, 0, 100);
+	ok(!err && uatomic_read(&nr_queued) == 2
+			&& uatomic_read(&nr_invoked) == 1,
+		"flushed batch waits for a pre-existing reader");
+	uatomic_set(&reader_release, 1);
+	if (!err)
+		err = pthread_join(reader, NULL);
+	rcu_barrier();
+	ok(!err && uatomic_read(&nr_invoked) == 2,
+		"flushed batch is invoked after the reader unlocks");
+	for (i = CDS_RCU_SLAB_BATCH + 1; i < NR_OBJS; i++)
+		cds_rcu_slab_free(slab, objs[i]);
+	ok1(cds_rcu_slab_destroy(slab) == 0);
+}
+
+static void test_remote_free(void)
+{
+	pthread_t thread;
+	unsigned long i;
+	int err;
+
+	slab = cds_rcu_slab_create(OBJ_SIZE, 0, call_rcu);
+	ok1(slab);
+	for (i = 0; i < NR_OBJS; i++)
+		objs[i] = cds_rcu_slab_alloc(slab);
+	err = pthread_create(&thread, NULL, thr_remote_free, NULL);
+	if (!err)
+		err = pthread_join(thread, NULL);
+	ok(!err, "objects freed by another thread");
+	rcu_barrier();
+	ok(cds_rcu_slab_destroy(slab) == 0,
+		"objects freed by another thread went back to their owner");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("allocation and immediate free");
+	test_alloc_free();
+	diag("free after a grace period");
+	test_free_rcu();
+	diag("free from another thread");
+	test_remote_free();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
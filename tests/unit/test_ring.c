@@ -0,0 +1,182 @@
+/*
+ * test_ring.c
+ *
+ * Userspace RCU library - test the bounded MPMC and SPSC rings
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <urcu/ring.h>
+#include <urcu/uatomic.h>
+
+#include "tap.h"
+
+#define NR_TESTS	19
+
+#define CAPACITY	8
+#define NR_PRODUCERS	2
+#define NR_CONSUMERS	2
+#define NR_ITEMS	100000UL	/* Per producer. */
+
+static struct cds_mpmc_ring mpmc;
+static unsigned long nr_dequeued, sum_dequeued;
+
+static void *item(unsigned long v)
+{
+	return (void *) (uintptr_t) v;
+}
+
+static void *thr_producer(void *arg)
+{
+	unsigned long base = (unsigned long) arg * NR_ITEMS, i;
+
+	for (i = 1; i <= NR_ITEMS; i++) {
+		while (!cds_mpmc_ring_enqueue(&mpmc, item(base + i)))
+			sched_yield();
+	}
+	return NULL;
+}
+
+/*
+ * Account each item as soon as dequeued: a consumer waiting for the
+ * last items must see those dequeued by the others.
+ */
+static void *thr_consumer(void *arg)
+{
+	unsigned long sum = 0;
+	void *v;
+
+	(void) arg;
+	while (uatomic_read(&nr_dequeued) < NR_PRODUCERS * NR_ITEMS) {
+		if (cds_mpmc_ring_dequeue(&mpmc, &v)) {
+			sum += (uintptr_t) v;
+			uatomic_inc(&nr_dequeued);
+		} else {
+			sched_yield();
+		}
+	}
+	uatomic_add(&sum_dequeued, sum);
+	return NULL;
+}
+
+static void test_mpmc_sequential(void)
+{
+	unsigned long i, order_ok = 1;
+	void *v;
+
+	ok1(cds_mpmc_ring_init(&mpmc, 6) == -EINVAL);
+	ok1(cds_mpmc_ring_init(&mpmc, CAPACITY) == 0);
+	ok(!cds_mpmc_ring_dequeue(&mpmc, &v), "empty ring dequeue fails");
+	for (i = 1; i <= CAPACITY; i++) {
+		if (!cds_mpmc_ring_enqueue(&mpmc, item(i)))
+			break;
+	}
+	ok(i == CAPACITY + 1, "ring holds its capacity");
+	ok(!cds_mpmc_ring_enqueue(&mpmc, item(i)), "full ring enqueue fails");
+	/* Cycle the positions through the slots several times. */
+	for (i = 1; i <= 10 * CAPACITY; i++) {
+		if (!cds_mpmc_ring_dequeue(&mpmc, &v) || v != item(i))
+			order_ok = 0;
+		if (!cds_mpmc_ring_enqueue(&mpmc, item(i + CAPACITY)))
+			order_ok = 0;
+	}
+	ok(order_ok, "FIFO order across wrap-around");
+	for (i = 10 * CAPACITY + 1; i <= 11 * CAPACITY; i++) {
+		if (!cds_mpmc_ring_dequeue(&mpmc, &v) || v != item(i))
+			order_ok = 0;
+	}
+	ok(order_ok, "FIFO order when draining");
+	ok(!cds_mpmc_ring_dequeue(&mpmc, &v), "drained ring dequeue fails");
+	cds_mpmc_ring_destroy(&mpmc);
+}
+
+static void test_mpmc_concurrent(void)
+{
+	pthread_t producers[NR_PRODUCERS], consumers[NR_CONSUMERS];
+	unsigned long i, expected = 0;
+	int err = 0;
+
+	ok1(cds_mpmc_ring_init(&mpmc, CAPACITY) == 0);
+	for (i = 0; i < NR_CONSUMERS; i++)
+		err |= pthread_create(&consumers[i], NULL, thr_consumer, NULL);
+	for (i = 0; i < NR_PRODUCERS; i++)
+		err |= pthread_create(&producers[i], NULL, thr_producer,
+				(void *) i);
+	for (i = 0; i < NR_PRODUCERS; i++)
+		err |= pthread_join(producers[i], NULL);
+	for (i = 0; i < NR_CONSUMERS; i++)
+		err |= pthread_join(consumers[i], NULL);
+	ok(!err, "thread creation and join");
+	for (i = 1; i <= NR_PRODUCERS * NR_ITEMS; i++)
+		expected += i;
+	ok(nr_dequeued == NR_PRODUCERS * NR_ITEMS,
+		"each item dequeued once (%lu)", nr_dequeued);
+	ok(sum_dequeued == expected, "dequeued items match the enqueued ones");
+	cds_mpmc_ring_destroy(&mpmc);
+}
+
+static void test_spsc(void)
+{
+	struct cds_spsc_ring spsc;
+	void *items[CAPACITY];
+	unsigned long i, n, order_ok = 1;
+	void *v;
+
+	ok1(cds_spsc_ring_init(&spsc, 3) == -EINVAL);
+	ok1(cds_spsc_ring_init(&spsc, CAPACITY) == 0);
+	for (i = 1; i <= CAPACITY; i++)
+		cds_spsc_ring_enqueue(&spsc, item(i));
+	ok(!cds_spsc_ring_enqueue(&spsc, item(i)), "full ring enqueue fails");
+	ok1(cds_spsc_ring_dequeue(&spsc, &v) && v == item(1));
+	n = cds_spsc_ring_dequeue_bulk(&spsc, items, 3);
+	for (i = 0; i < n; i++) {
+		if (items[i] != item(i + 2))
+			order_ok = 0;
+	}
+	ok(n == 3 && order_ok, "bulk dequeue of part of the ring");
+	/* Wrap the tail, then ask for more than what is queued. */
+	for (i = 0; i < 4; i++)
+		cds_spsc_ring_enqueue(&spsc, item(i + CAPACITY + 1));
+	n = cds_spsc_ring_dequeue_bulk(&spsc, items, CAPACITY);
+	for (i = 0; i < n; i++) {
+		if (items[i] != item(i + 5))
+			order_ok = 0;
+	}
+	ok(n == CAPACITY && order_ok, "bulk dequeue across wrap-around");
+	ok(cds_spsc_ring_dequeue_bulk(&spsc, items, CAPACITY) == 0
+			&& !cds_spsc_ring_dequeue(&spsc, &v),
+		"drained ring dequeue fails");
+	cds_spsc_ring_destroy(&spsc);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	diag("MPMC ring, single thread");
+	test_mpmc_sequential();
+	diag("MPMC ring, %d producers and %d consumers",
+		NR_PRODUCERS, NR_CONSUMERS);
+	test_mpmc_concurrent();
+	diag("SPSC ring");
+	test_spsc();
+
+	return exit_status();
+}
@@ -0,0 +1,343 @@
+/*
+ * test_shm_rcu.c
+ *
+ * Userspace RCU library - test the RCU domains shared between processes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <urcu/arch.h>
+#include <urcu/shm-rcu.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#include "tap.h"
+
+#define NR_TESTS	15
+
+#define NR_SLOTS	4
+#define OBJ_MAGIC	0x1234abcdUL
+#define NR_OBJS		2
+#define NR_CHILD_READERS	2
+#define NR_UPDATES	2000
+
+/*
+ * State shared with the child processes. Objects are designated by
+ * their index, since the mappings could be at different addresses.
+ */
+struct shared {
+	int reader_locked, reader_release, updater_done;
+	unsigned long cur;
+	unsigned long magic[NR_OBJS];
+	unsigned long nr_bad;
+};
+
+static struct shm_rcu_domain *dp;
+static struct shared *shared;
+static void *domain_mem;
+static size_t domain_len;
+static int synchronized, reader_locked, reader_release;
+
+static void *map_shared(size_t len)
+{
+	void *mem;
+
+	mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+	return mem;
+}
+
+static int wait_child(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) != pid)
+		return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void *thr_synchronize(void *arg)
+{
+	(void) arg;
+	synchronize_shm_rcu(dp);
+	uatomic_set(&synchronized, 1);
+	return NULL;
+}
+
+/* Return whether a grace period started now is still waiting after 100ms. */
+static int synchronize_blocked(pthread_t *updater)
+{
+	uatomic_set(&synchronized, 0);
+	if (pthread_create(updater, NULL, thr_synchronize, NULL))
+		abort();
+	(void) poll(NULL, 0, 100);
+	return !uatomic_read(&synchronized);
+}
+
+static void test_init(void)
+{
+	struct shm_rcu_domain *ret;
+	char zero[256] = { 0 };
+
+	domain_len = shm_rcu_domain_size(NR_SLOTS);
+	ok1(domain_len > shm_rcu_domain_size(NR_SLOTS - 1));
+	domain_mem = map_shared(domain_len);
+	errno = 0;
+	ret = shm_rcu_domain_init(domain_mem, domain_len - 1, NR_SLOTS);
+	ok(!ret && errno == EINVAL, "init fails when the area is too small");
+	errno = 0;
+	ret = shm_rcu_domain_attach(zero, sizeof(zero));
+	ok(!ret && errno == EINVAL, "attach fails without a domain");
+	dp = shm_rcu_domain_init(domain_mem, domain_len, NR_SLOTS);
+	ok1(dp);
+	errno = 0;
+	ret = shm_rcu_domain_attach(domain_mem, domain_len - 1);
+	ok(!ret && errno == EINVAL, "attach fails when the area is too small");
+	ok1(shm_rcu_domain_attach(domain_mem, domain_len) == dp);
+}
+
+/* Exit with a reader slot registered. */
+static void *thr_leak(void *arg)
+{
+	struct shm_rcu_reader **rp = arg;
+
+	*rp = shm_rcu_register_thread(dp);
+	return NULL;
+}
+
+static void test_registration(void)
+{
+	struct shm_rcu_reader *rps[NR_SLOTS], *rp, *leaked = NULL;
+	pthread_t leaker;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < NR_SLOTS - 1; i++)
+		rps[i] = shm_rcu_register_thread(dp);
+	err = pthread_create(&leaker, NULL, thr_leak, &leaked);
+	if (!err)
+		err = pthread_join(leaker, NULL);
+	rp = shm_rcu_register_thread(dp);
+	ok(!err && leaked && rp == leaked,
+		"slot of a thread exited while registered is reclaimed");
+	errno = 0;
+	ok(!shm_rcu_register_thread(dp) && errno == ENOSPC,
+		"register fails once all the slots are in use");
+	shm_rcu_unregister_thread(rp);
+	rp = shm_rcu_register_thread(dp);
+	ok(rp != NULL, "unregister releases the slot");
+	rps[NR_SLOTS - 1] = rp;
+	for (i = 0; i < NR_SLOTS; i++)
+		shm_rcu_unregister_thread(rps[i]);
+}
+
+static void *thr_reader_lock(void *arg)
+{
+	struct shm_rcu_reader *rp;
+
+	(void) arg;
+	rp = shm_rcu_register_thread(dp);
+	if (!rp)
+		abort();
+	shm_rcu_read_lock(rp);
+	shm_rcu_read_lock(rp);
+	shm_rcu_read_unlock(rp);
+	uatomic_set(&reader_locked, 1);
+	while (!uatomic_read(&reader_release))
+		(void) poll(NULL, 0, 1);
+	shm_rcu_read_unlock(rp);
+	shm_rcu_unregister_thread(rp);
+	return NULL;
+}
+
+static void test_thread_reader(void)
+{
+	pthread_t reader, updater;
+	int err, blocked;
+
+	err = pthread_create(&reader, NULL, thr_reader_lock, NULL);
+	while (!err && !uatomic_read(&reader_locked))
+		(void) poll(NULL, 0, 1);
+	blocked = synchronize_blocked(&updater);
+	uatomic_set(&reader_release, 1);
+	if (!err)
+		err = pthread_join(reader, NULL);
+	err |= pthread_join(updater, NULL);
+	ok(!err && blocked && uatomic_read(&synchronized),
+		"grace period waits for a nested reader of another thread");
+}
+
+/* Hold a read lock in a child process until released or killed. */
+static void child_reader_lock(void)
+{
+	struct shm_rcu_domain *cdp;
+	struct shm_rcu_reader *rp;
+
+	cdp = shm_rcu_domain_attach(domain_mem, domain_len);
+	if (!cdp)
+		_exit(EXIT_FAILURE);
+	rp = shm_rcu_register_thread(cdp);
+	if (!rp)
+		_exit(EXIT_FAILURE);
+	shm_rcu_read_lock(rp);
+	uatomic_set(&shared->reader_locked, 1);
+	while (!uatomic_read(&shared->reader_release))
+		(void) poll(NULL, 0, 1);
+	shm_rcu_read_unlock(rp);
+	shm_rcu_unregister_thread(rp);
+	_exit(EXIT_SUCCESS);
+}
+
+static pid_t fork_reader_lock(void)
+{
+	pid_t pid;
+
+	uatomic_set(&shared->reader_locked, 0);
+	uatomic_set(&shared->reader_release, 0);
+	pid = fork();
+	if (pid == 0)
+		child_reader_lock();
+	while (pid > 0 && !uatomic_read(&shared->reader_locked))
+		(void) poll(NULL, 0, 1);
+	return pid;
+}
+
+static void test_process_reader(void)
+{
+	pthread_t updater;
+	int blocked;
+	pid_t pid;
+
+	pid = fork_reader_lock();
+	blocked = synchronize_blocked(&updater);
+	uatomic_set(&shared->reader_release, 1);
+	(void) pthread_join(updater, NULL);
+	ok(pid > 0 && blocked && uatomic_read(&synchronized),
+		"grace period waits for a reader of another process");
+	ok1(wait_child(pid) == 0);
+
+	pid = fork_reader_lock();
+	blocked = synchronize_blocked(&updater);
+	if (pid > 0)
+		kill(pid, SIGKILL);
+	(void) wait_child(pid);
+	(void) pthread_join(updater, NULL);
+	ok(pid > 0 && blocked && uatomic_read(&synchronized),
+		"grace period completes once the reader process is killed");
+}
+
+/* Check the current object until the updater is done. */
+static void *thr_child_reader(void *arg)
+{
+	struct shm_rcu_domain *cdp = arg;
+	struct shm_rcu_reader *rp;
+	unsigned long idx;
+
+	rp = shm_rcu_register_thread(cdp);
+	if (!rp)
+		abort();
+	while (!uatomic_read(&shared->updater_done)) {
+		shm_rcu_read_lock(rp);
+		idx = CMM_LOAD_SHARED(shared->cur);
+		cmm_smp_rmb();
+		if (CMM_LOAD_SHARED(shared->magic[idx]) != OBJ_MAGIC)
+			uatomic_inc(&shared->nr_bad);
+		shm_rcu_read_unlock(rp);
+	}
+	shm_rcu_unregister_thread(rp);
+	return NULL;
+}
+
+static void child_readers(void)
+{
+	pthread_t readers[NR_CHILD_READERS];
+	struct shm_rcu_domain *cdp;
+	unsigned int i;
+
+	cdp = shm_rcu_domain_attach(domain_mem, domain_len);
+	if (!cdp)
+		_exit(EXIT_FAILURE);
+	for (i = 0; i < NR_CHILD_READERS; i++)
+		if (pthread_create(&readers[i], NULL, thr_child_reader, cdp))
+			_exit(EXIT_FAILURE);
+	for (i = 0; i < NR_CHILD_READERS; i++)
+		if (pthread_join(readers[i], NULL))
+			_exit(EXIT_FAILURE);
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ * Publish another object, then poison the previous one once the
+ * readers of the child process are done with it.
+ */
+static void test_concurrent(void)
+{
+	unsigned long i, old;
+	pid_t pid;
+
+	shared->magic[0] = OBJ_MAGIC;
+	shared->cur = 0;
+	pid = fork();
+	if (pid == 0)
+		child_readers();
+	for (i = 0; pid > 0 && i < NR_UPDATES; i++) {
+		old = shared->cur;
+		CMM_STORE_SHARED(shared->magic[old ^ 1], OBJ_MAGIC);
+		cmm_smp_wmb();
+		CMM_STORE_SHARED(shared->cur, old ^ 1);
+		synchronize_shm_rcu(dp);
+		CMM_STORE_SHARED(shared->magic[old], 0);
+	}
+	uatomic_set(&shared->updater_done, 1);
+	ok(pid > 0 && wait_child(pid) == 0, "reader process exits normally");
+	ok(!uatomic_read(&shared->nr_bad),
+		"objects are not poisoned under readers of another process");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	shared = map_shared(sizeof(*shared));
+	diag("domain initialization");
+	test_init();
+	diag("reader slots");
+	test_registration();
+	diag("a reader thread");
+	test_thread_reader();
+	diag("a reader process");
+	test_process_reader();
+	diag("%d readers in another process concurrent with an updater",
+		NR_CHILD_READERS);
+	test_concurrent();
+
+	(void) munmap(domain_mem, domain_len);
+	(void) munmap(shared, sizeof(*shared));
+	return exit_status();
+}
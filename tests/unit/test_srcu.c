@@ -0,0 +1,177 @@
+/*
+ * test_srcu.c
+ *
+ * Userspace RCU library - test the sleepable RCU domains
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Only use the static pointer helpers: SRCU needs no flavor library. */
+#define _LGPL_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu/arch.h>
+#include <urcu-pointer.h>
+#include <urcu/srcu.h>
+#include <urcu/uatomic.h>
+
+#include "poison-obj.h"
+#include "tap.h"
+
+#define NR_TESTS	9
+
+#define NR_READERS	2
+#define NR_UPDATES	2000
+
+struct obj {
+	struct poison_obj poison;
+};
+
+static struct srcu_domain *dom_a, *dom_b;
+static int synchronized, updater_done;
+static int reader_idx;
+static struct obj *gp;
+
+static void obj_free(struct obj *o)
+{
+	poison_obj_free(&o->poison);
+}
+
+static struct obj *obj_alloc(void)
+{
+	return poison_obj_alloc(sizeof(struct obj));
+}
+
+/* Enter a read-side critical section of domain A, left by main. */
+static void *thr_reader_lock(void *arg)
+{
+	(void) arg;
+	uatomic_set(&reader_idx, srcu_read_lock(dom_a));
+	return NULL;
+}
+
+static void *thr_synchronize(void *arg)
+{
+	(void) arg;
+	synchronize_srcu(dom_a);
+	uatomic_set(&synchronized, 1);
+	return NULL;
+}
+
+static void test_read_side(void)
+{
+	int idx, idx2;
+
+	dom_a = srcu_domain_create();
+	dom_b = srcu_domain_create();
+	ok1(dom_a && dom_b);
+	idx = srcu_read_lock(dom_a);
+	idx2 = srcu_read_lock(dom_a);
+	srcu_read_unlock(dom_a, idx2);
+	ok(srcu_domain_destroy(dom_a) == -EBUSY,
+		"destroy fails within a read-side critical section");
+	srcu_read_unlock(dom_a, idx);
+	synchronize_srcu(dom_a);
+	idx = srcu_read_lock(dom_a);
+	srcu_read_unlock(dom_a, idx);
+	ok(idx == 0 || idx == 1, "read lock returns an index");
+}
+
+static void test_sleeping_reader(void)
+{
+	pthread_t reader, updater;
+	int err;
+
+	err = pthread_create(&reader, NULL, thr_reader_lock, NULL);
+	if (!err)
+		err = pthread_join(reader, NULL);
+	synchronize_srcu(dom_b);
+	ok(!err, "grace periods of another domain do not wait for the "
+		"reader");
+	err |= pthread_create(&updater, NULL, thr_synchronize, NULL);
+	(void) poll(NULL, 0, 100);
+	ok(!uatomic_read(&synchronized),
+		"grace periods of the domain wait for the sleeping reader");
+	ok(srcu_domain_destroy(dom_a) == -EBUSY,
+		"destroy fails while the reader sleeps");
+	/* Unlock from another thread than the one which locked. */
+	srcu_read_unlock(dom_a, uatomic_read(&reader_idx));
+	if (!err)
+		err = pthread_join(updater, NULL);
+	ok(!err && uatomic_read(&synchronized),
+		"grace period completes once unlocked from another thread");
+}
+
+/* Dereference and check the object, without thread registration. */
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg;
+	struct obj *o;
+	int idx;
+
+	while (!uatomic_read(&updater_done)) {
+		idx = srcu_read_lock(dom_a);
+		o = rcu_dereference(gp);
+		if (!poison_obj_live(&o->poison))
+			(*nr_bad)++;
+		srcu_read_unlock(dom_a, idx);
+	}
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	pthread_t readers[NR_READERS];
+	struct obj *old;
+	int err = 0;
+
+	rcu_assign_pointer(gp, obj_alloc());
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	for (i = 0; i < NR_UPDATES; i++) {
+		old = rcu_xchg_pointer(&gp, obj_alloc());
+		synchronize_srcu(dom_a);
+		obj_free(old);
+	}
+	uatomic_set(&updater_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad,
+		"objects are not freed under unregistered readers");
+	obj_free(gp);
+	ok1(!srcu_domain_destroy(dom_a) && !srcu_domain_destroy(dom_b));
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	diag("read side");
+	test_read_side();
+	diag("a reader sleeping within a read-side critical section");
+	test_sleeping_reader();
+	diag("%d readers concurrent with an updater", NR_READERS);
+	test_concurrent();
+
+	poison_obj_free_all();
+	return exit_status();
+}
@@ -40,6 +40,22 @@ struct testvals {
 
 static struct testvals vals;
 
+#ifdef UATOMIC_HAS_CMPXCHG_DOUBLE
+#define NR_DOUBLE_TESTS 4
+
+static unsigned long dvals[2] __attribute__((aligned(2 * sizeof(long))));
+
+static void do_test_double(void)
+{
+	dvals[0] = 1;
+	dvals[1] = 2;
+	ok1(uatomic_cmpxchg_double(dvals, 1, 2, 3, 4));
+	ok1(dvals[0] == 3 && dvals[1] == 4);
+	ok1(!uatomic_cmpxchg_double(dvals, 3, 5, 6, 7));
+	ok1(dvals[0] == 3 && dvals[1] == 4);
+}
+#endif
+
 #define do_test(ptr)				\
 do {						\
 	__typeof__(*(ptr)) v;			\
@@ -101,7 +117,11 @@ int main(int argc, char **argv)
 	nr_run += 1;
 #endif
 
+#ifdef UATOMIC_HAS_CMPXCHG_DOUBLE
+	plan_tests(nr_run * NR_TESTS + NR_DOUBLE_TESTS);
+#else
 	plan_tests(nr_run * NR_TESTS);
+#endif
 #ifdef UATOMIC_HAS_ATOMIC_BYTE
 	diag("Test atomic ops on byte");
 	do_test(&vals.c);
@@ -114,6 +134,10 @@ int main(int argc, char **argv)
 	do_test(&vals.i);
 	diag("Test atomic ops on long");
 	do_test(&vals.l);
+#ifdef UATOMIC_HAS_CMPXCHG_DOUBLE
+	diag("Test double-width cmpxchg");
+	do_test_double();
+#endif
 
 	return exit_status();
 }
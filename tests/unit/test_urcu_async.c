@@ -0,0 +1,117 @@
+/*
+ * test_urcu_async.c
+ *
+ * Userspace RCU library - test the asynchronous and polled grace periods
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_TESTS	8
+
+/* Bound of the waits, in milliseconds. */
+#define WAIT_MS		10000
+
+/*
+ * Nobody calls synchronize_rcu(): the grace periods are run by the
+ * call_rcu thread.
+ */
+static int wait_async(struct rcu_async *req)
+{
+	int i;
+
+	for (i = 0; i < WAIT_MS && !rcu_async_poll(req); i++)
+		(void) poll(NULL, 0, 1);
+	return rcu_async_poll(req);
+}
+
+static int wait_cookie(unsigned long cookie)
+{
+	int i;
+
+	for (i = 0; i < WAIT_MS && !poll_state_synchronize_rcu(cookie); i++)
+		(void) poll(NULL, 0, 1);
+	return poll_state_synchronize_rcu(cookie);
+}
+
+static void test_async(void)
+{
+	struct rcu_async req = { .fd = -1 };
+	struct pollfd pfd;
+	unsigned long cookie;
+	uint64_t value = 0;
+	int fds[2];
+
+	cookie = get_state_synchronize_rcu();
+	synchronize_rcu_async(&req);
+	ok(wait_async(&req), "asynchronous grace period completes");
+	ok(poll_state_synchronize_rcu(cookie),
+		"and completes the cookies taken before it started");
+
+	if (pipe(fds)) {
+		skip(2, "pipe");
+		return;
+	}
+	req.fd = fds[1];
+	synchronize_rcu_async(&req);
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	ok(poll(&pfd, 1, WAIT_MS) == 1
+		&& read(fds[0], &value, sizeof(value)) == sizeof(value)
+		&& value == 1,
+		"completion is written to the file descriptor");
+	ok(rcu_async_poll(&req),
+		"request is completed once the file descriptor is written to");
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void test_start_poll(void)
+{
+	unsigned long first, second;
+
+	first = start_poll_synchronize_rcu();
+	ok(wait_cookie(first), "polled grace period completes");
+	ok(!poll_state_synchronize_rcu(get_state_synchronize_rcu()),
+		"a new cookie waits for another grace period");
+
+	/* The second cookie is served by the pending request, queued again. */
+	first = start_poll_synchronize_rcu();
+	second = start_poll_synchronize_rcu();
+	ok(wait_cookie(second) && poll_state_synchronize_rcu(first),
+		"back-to-back polled grace periods complete");
+	ok((long) (second - first) >= 0, "cookies do not go backwards");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	rcu_register_thread();
+	diag("asynchronous grace periods");
+	test_async();
+	diag("polled grace periods");
+	test_start_poll();
+	rcu_unregister_thread();
+
+	return exit_status();
+}
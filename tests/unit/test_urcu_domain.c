@@ -0,0 +1,235 @@
+/*
+ * test_urcu_domain.c
+ *
+ * Userspace RCU library - test the independent RCU domains
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu.h>
+
+#include "poison-obj.h"
+#include "tap.h"
+
+#define NR_TESTS	15
+
+#define NR_READERS	2
+#define NR_UPDATES	2000
+#define NR_CALLBACKS	1000
+
+struct obj {
+	struct poison_obj poison;
+	struct rcu_head rcu_head;
+};
+
+static struct rcu_domain *dom_a, *dom_b;
+static unsigned long nr_invoked;
+static int reader_locked, reader_release, synchronized, updater_done;
+static struct obj *gp;
+
+static void obj_free(struct rcu_head *head)
+{
+	poison_obj_free(&caa_container_of(head, struct obj, rcu_head)->poison);
+	uatomic_inc(&nr_invoked);
+}
+
+static struct obj *obj_alloc(void)
+{
+	return poison_obj_alloc(sizeof(struct obj));
+}
+
+/* Hold a read lock of domain A until released. */
+static void *thr_long_reader(void *arg)
+{
+	struct rcu_domain_reader *r;
+
+	(void) arg;
+	rcu_register_thread();
+	r = rcu_domain_register_thread(dom_a);
+	if (!r)
+		abort();
+	rcu_domain_read_lock(r);
+	uatomic_set(&reader_locked, 1);
+	while (!uatomic_read(&reader_release))
+		(void) poll(NULL, 0, 1);
+	rcu_domain_read_unlock(r);
+	rcu_domain_unregister_thread(r);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_synchronize(void *arg)
+{
+	(void) arg;
+	rcu_register_thread();
+	synchronize_rcu_domain(dom_a);
+	uatomic_set(&synchronized, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_read_side(void)
+{
+	struct rcu_domain_reader *r;
+	int nested;
+
+	dom_a = rcu_domain_create();
+	dom_b = rcu_domain_create();
+	ok1(dom_a && dom_b);
+	r = rcu_domain_register_thread(dom_a);
+	ok1(r);
+	ok1(!rcu_domain_read_ongoing(r));
+	rcu_domain_read_lock(r);
+	rcu_domain_read_lock(r);
+	rcu_domain_read_unlock(r);
+	nested = rcu_domain_read_ongoing(r);
+	rcu_domain_read_unlock(r);
+	ok(nested && !rcu_domain_read_ongoing(r),
+		"read-side critical sections nest");
+	ok(rcu_domain_destroy(dom_a) == -EBUSY,
+		"destroy fails while a reader is registered");
+	rcu_domain_unregister_thread(r);
+}
+
+static void test_independence(void)
+{
+	pthread_t reader, updater;
+	int err;
+
+	err = pthread_create(&reader, NULL, thr_long_reader, NULL);
+	while (!err && !uatomic_read(&reader_locked))
+		(void) poll(NULL, 0, 1);
+	synchronize_rcu_domain(dom_b);
+	synchronize_rcu();
+	ok(!err, "grace periods of another domain and of the flavor "
+		"do not wait for the reader");
+
+	err |= pthread_create(&updater, NULL, thr_synchronize, NULL);
+	call_rcu_domain(dom_a, &obj_alloc()->rcu_head, obj_free);
+	(void) poll(NULL, 0, 100);
+	ok(!uatomic_read(&synchronized) && !uatomic_read(&nr_invoked),
+		"grace periods of the domain wait for the reader");
+	uatomic_set(&reader_release, 1);
+	if (!err)
+		err = pthread_join(reader, NULL);
+	if (!err)
+		err = pthread_join(updater, NULL);
+	ok(!err && uatomic_read(&synchronized),
+		"grace period completes once the reader leaves");
+	rcu_barrier_domain(dom_a);
+	ok(uatomic_read(&nr_invoked) == 1,
+		"callback invoked once the reader leaves");
+}
+
+/* Dereference and check the object, within domain A read locks. */
+static void *thr_reader(void *arg)
+{
+	struct rcu_domain_reader *r;
+	unsigned long *nr_bad = arg;
+	struct obj *o;
+
+	rcu_register_thread();
+	r = rcu_domain_register_thread(dom_a);
+	if (!r)
+		abort();
+	while (!uatomic_read(&updater_done)) {
+		rcu_domain_read_lock(r);
+		o = rcu_dereference(gp);
+		if (!poison_obj_live(&o->poison))
+			(*nr_bad)++;
+		rcu_domain_read_unlock(r);
+	}
+	rcu_domain_unregister_thread(r);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	pthread_t readers[NR_READERS];
+	struct obj *old;
+	int err = 0;
+
+	uatomic_set(&nr_invoked, 0);
+	rcu_assign_pointer(gp, obj_alloc());
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	for (i = 0; i < NR_UPDATES; i++) {
+		old = rcu_xchg_pointer(&gp, obj_alloc());
+		if (i & 1) {
+			call_rcu_domain(dom_a, &old->rcu_head, obj_free);
+		} else {
+			synchronize_rcu_domain(dom_a);
+			obj_free(&old->rcu_head);
+		}
+	}
+	uatomic_set(&updater_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad,
+		"objects are not freed under domain readers");
+	rcu_barrier_domain(dom_a);
+	ok(uatomic_read(&nr_invoked) == NR_UPDATES,
+		"every object freed (%lu)", uatomic_read(&nr_invoked));
+	obj_free(&gp->rcu_head);
+}
+
+static void test_barrier(void)
+{
+	unsigned long i;
+
+	uatomic_set(&nr_invoked, 0);
+	ok(!rcu_domain_destroy(dom_b) && (dom_b = rcu_domain_create()),
+		"destroy of a domain never used for callbacks");
+	for (i = 0; i < NR_CALLBACKS; i++)
+		call_rcu_domain(dom_b, &obj_alloc()->rcu_head, obj_free);
+	rcu_barrier_domain(dom_b);
+	ok(uatomic_read(&nr_invoked) == NR_CALLBACKS,
+		"barrier waits for the callbacks queued before it");
+	for (i = 0; i < NR_CALLBACKS; i++)
+		call_rcu_domain(dom_b, &obj_alloc()->rcu_head, obj_free);
+	ok(!rcu_domain_destroy(dom_b)
+			&& uatomic_read(&nr_invoked) == 2 * NR_CALLBACKS,
+		"destroy invokes the pending callbacks");
+	ok1(!rcu_domain_destroy(dom_a));
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+	rcu_register_thread();
+
+	diag("read side");
+	test_read_side();
+	diag("a long reader of one domain");
+	test_independence();
+	diag("%d readers concurrent with an updater", NR_READERS);
+	test_concurrent();
+	diag("callbacks");
+	test_barrier();
+
+	rcu_unregister_thread();
+	poison_obj_free_all();
+	return exit_status();
+}
@@ -0,0 +1,191 @@
+/*
+ * test_urcu_percpu.c
+ *
+ * Userspace RCU library - test the per-CPU counters flavor
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu-percpu.h>
+
+#include "poison-obj.h"
+#include "tap.h"
+
+#define NR_TESTS	8
+
+#define NR_READERS	4
+#define NR_UPDATES	2000
+#define NR_CALLBACKS	1000
+
+struct obj {
+	struct poison_obj poison;
+	struct rcu_head rcu_head;
+};
+
+static unsigned long nr_invoked;
+static int reader_locked, reader_release, synchronized, updater_done;
+static struct obj *gp;
+
+static void obj_free(struct rcu_head *head)
+{
+	poison_obj_free(&caa_container_of(head, struct obj, rcu_head)->poison);
+	uatomic_inc(&nr_invoked);
+}
+
+static struct obj *obj_alloc(void)
+{
+	return poison_obj_alloc(sizeof(struct obj));
+}
+
+/* Hold a read lock until released, without thread registration. */
+static void *thr_long_reader(void *arg)
+{
+	(void) arg;
+	rcu_read_lock();
+	uatomic_set(&reader_locked, 1);
+	while (!uatomic_read(&reader_release))
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	return NULL;
+}
+
+static void *thr_synchronize(void *arg)
+{
+	(void) arg;
+	synchronize_rcu();
+	uatomic_set(&synchronized, 1);
+	return NULL;
+}
+
+static void test_read_side(void)
+{
+	int nested;
+
+	ok1(!rcu_read_ongoing());
+	rcu_read_lock();
+	rcu_read_lock();
+	rcu_read_unlock();
+	nested = rcu_read_ongoing();
+	rcu_read_unlock();
+	ok(nested && !rcu_read_ongoing(), "read-side critical sections nest");
+}
+
+static void test_long_reader(void)
+{
+	pthread_t reader, updater;
+	int err;
+
+	err = pthread_create(&reader, NULL, thr_long_reader, NULL);
+	while (!err && !uatomic_read(&reader_locked))
+		(void) poll(NULL, 0, 1);
+	err |= pthread_create(&updater, NULL, thr_synchronize, NULL);
+	call_rcu(&obj_alloc()->rcu_head, obj_free);
+	(void) poll(NULL, 0, 100);
+	ok(!err && !uatomic_read(&synchronized) && !uatomic_read(&nr_invoked),
+		"grace periods wait for an unregistered reader");
+	uatomic_set(&reader_release, 1);
+	if (!err)
+		err = pthread_join(reader, NULL);
+	if (!err)
+		err = pthread_join(updater, NULL);
+	ok(!err && uatomic_read(&synchronized),
+		"grace period completes once the reader leaves");
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == 1,
+		"callback invoked once the reader leaves");
+}
+
+/* Dereference and check the object, without thread registration. */
+static void *thr_reader(void *arg)
+{
+	unsigned long *nr_bad = arg;
+	struct obj *o;
+
+	while (!uatomic_read(&updater_done)) {
+		rcu_read_lock();
+		o = rcu_dereference(gp);
+		if (!poison_obj_live(&o->poison))
+			(*nr_bad)++;
+		rcu_read_unlock();
+	}
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	unsigned long nr_bad[NR_READERS] = { 0 }, i, total_bad = 0;
+	pthread_t readers[NR_READERS];
+	struct obj *old;
+	int err = 0;
+
+	uatomic_set(&nr_invoked, 0);
+	rcu_assign_pointer(gp, obj_alloc());
+	for (i = 0; i < NR_READERS; i++)
+		err |= pthread_create(&readers[i], NULL, thr_reader,
+				&nr_bad[i]);
+	for (i = 0; i < NR_UPDATES; i++) {
+		old = rcu_xchg_pointer(&gp, obj_alloc());
+		if (i & 1) {
+			call_rcu(&old->rcu_head, obj_free);
+		} else {
+			synchronize_rcu();
+			obj_free(&old->rcu_head);
+		}
+	}
+	uatomic_set(&updater_done, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		err |= pthread_join(readers[i], NULL);
+		total_bad += nr_bad[i];
+	}
+	ok(!err && !total_bad,
+		"objects are not freed under unregistered readers");
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_UPDATES,
+		"every object freed (%lu)", uatomic_read(&nr_invoked));
+	obj_free(&gp->rcu_head);
+}
+
+static void test_barrier(void)
+{
+	unsigned long i;
+
+	uatomic_set(&nr_invoked, 0);
+	for (i = 0; i < NR_CALLBACKS; i++)
+		call_rcu(&obj_alloc()->rcu_head, obj_free);
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_CALLBACKS,
+		"barrier waits for the callbacks queued before it");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	diag("read side");
+	test_read_side();
+	diag("a long unregistered reader");
+	test_long_reader();
+	diag("%d readers concurrent with an updater", NR_READERS);
+	test_concurrent();
+	diag("callbacks");
+	test_barrier();
+
+	poison_obj_free_all();
+	return exit_status();
+}
@@ -0,0 +1,176 @@
+/*
+ * test_urcu_poll.c
+ *
+ * Userspace RCU library - test the polling grace-period API
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Build the polling API against stubs of the grace periods and of the
+ * call_rcu thread, so that the test can set the grace-period sequence
+ * close to its wrap and run the grace periods itself.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <urcu.h>
+
+#include "urcu-poll-impl.h"
+
+#include "tap.h"
+
+#define NR_TESTS	19
+
+/* Callback queued by call_rcu_expedited(), run by run_queued(). */
+static struct rcu_head *queued_head;
+static unsigned long nr_queued, nr_synchronize;
+
+void call_rcu_expedited(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	head->func = func;
+	queued_head = head;
+	nr_queued++;
+}
+
+static void grace_period(void)
+{
+	rcu_gp_seq_start();
+	rcu_gp_seq_end();
+}
+
+void synchronize_rcu(void)
+{
+	grace_period();
+	nr_synchronize++;
+}
+
+/* Complete a grace period, then invoke the queued callback. */
+static void run_queued(void)
+{
+	struct rcu_head *head = queued_head;
+
+	if ((rcu_gp_seq & 1))
+		rcu_gp_seq_end();
+	else
+		grace_period();
+	queued_head = NULL;
+	if (head)
+		head->func(head);
+}
+
+static void test_cookies(void)
+{
+	unsigned long cookie, old;
+
+	rcu_gp_seq = ULONG_MAX - 3;
+	cookie = get_state_synchronize_rcu();
+	ok(cookie == ULONG_MAX - 1, "cookie of an idle sequence");
+	ok(!poll_state_synchronize_rcu(cookie),
+		"no grace period has elapsed yet");
+	grace_period();
+	ok(poll_state_synchronize_rcu(cookie),
+		"the next grace period completes the cookie");
+
+	/* A grace period in progress wraps the sequence when it ends. */
+	rcu_gp_seq_start();
+	ok(rcu_gp_seq == ULONG_MAX, "grace period in progress");
+	old = cookie;
+	cookie = get_state_synchronize_rcu();
+	ok(cookie == 2, "cookie taken during a grace period wraps");
+	rcu_gp_seq_end();
+	ok(!rcu_gp_seq && !poll_state_synchronize_rcu(cookie),
+		"the grace period in progress does not complete the cookie");
+	ok(poll_state_synchronize_rcu(old),
+		"cookie completed before the wrap stays completed");
+	grace_period();
+	ok(poll_state_synchronize_rcu(cookie),
+		"the next full grace period completes the cookie");
+}
+
+static void test_cond_synchronize(void)
+{
+	unsigned long cookie;
+
+	rcu_gp_seq = ULONG_MAX - 1;
+	cookie = get_state_synchronize_rcu();
+	nr_synchronize = 0;
+	cond_synchronize_rcu(cookie);
+	ok(nr_synchronize == 1 && poll_state_synchronize_rcu(cookie),
+		"cond_synchronize_rcu() waits for a pending cookie");
+	cond_synchronize_rcu(cookie);
+	ok(nr_synchronize == 1,
+		"cond_synchronize_rcu() skips a completed cookie");
+}
+
+/* Cookies of the synchronize_rcu() callers batched by the flavors. */
+static void test_wanted(void)
+{
+	rcu_gp_seq = ULONG_MAX - 1;
+	rcu_gp_seq_wanted = 0;
+	rcu_gp_seq_want();
+	ok(rcu_gp_seq_wanted == 0 && !rcu_gp_seq_wanted_done(),
+		"wanted cookie past the wrap");
+	rcu_gp_seq_max(&rcu_gp_seq_wanted, ULONG_MAX - 1);
+	ok(rcu_gp_seq_wanted == 0,
+		"older cookie does not lower the wanted one");
+	grace_period();
+	ok(rcu_gp_seq_wanted_done(),
+		"grace period past the wrap completes the wanted cookie");
+}
+
+static void test_start_poll(void)
+{
+	unsigned long first, second;
+
+	rcu_gp_seq = ULONG_MAX - 3;
+	rcu_gp_poll_cookie = rcu_gp_seq;
+	nr_queued = 0;
+	first = start_poll_synchronize_rcu();
+	ok(nr_queued == 1 && queued_head == &rcu_gp_poll_head,
+		"start_poll_synchronize_rcu() queues a grace period");
+	/* The queued grace period started before the second cookie. */
+	rcu_gp_seq_start();
+	second = start_poll_synchronize_rcu();
+	ok(nr_queued == 1 && !second,
+		"start_poll_synchronize_rcu() queues at most one request");
+	run_queued();
+	ok(poll_state_synchronize_rcu(first)
+		&& !poll_state_synchronize_rcu(second),
+		"the queued grace period only completes the first cookie");
+	ok(nr_queued == 2 && queued_head == &rcu_gp_poll_head,
+		"the request is queued again for the second cookie");
+	run_queued();
+	ok(poll_state_synchronize_rcu(second),
+		"grace period past the wrap completes the second cookie");
+	ok(nr_queued == 2 && !queued_head && !rcu_gp_poll_pending,
+		"no request is left once the cookies are completed");
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	diag("cookies across the sequence wrap");
+	test_cookies();
+	diag("conditional grace periods");
+	test_cond_synchronize();
+	diag("batched grace periods");
+	test_wanted();
+	diag("polled grace periods");
+	test_start_poll();
+
+	return exit_status();
+}
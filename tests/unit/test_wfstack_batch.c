@@ -0,0 +1,171 @@
+/*
+ * test_wfstack_batch.c
+ *
+ * Userspace RCU library - test the batched pop of the wait-free stack
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <urcu/uatomic.h>
+#include <urcu/wfstack.h>
+
+#include "tap.h"
+
+#define NR_TESTS	9
+
+#define NR_NODES	8
+#define NR_PUSHERS	2
+#define NR_POPPERS	2
+#define NR_PUSHES	100000	/* Per pusher. */
+
+struct item {
+	unsigned long val;
+	struct cds_wfs_node node;
+};
+
+static struct __cds_wfs_stack stack;
+
+static struct item *item_alloc(unsigned long val)
+{
+	struct item *it = malloc(sizeof(*it));
+
+	if (!it)
+		abort();
+	it->val = val;
+	cds_wfs_node_init(&it->node);
+	return it;
+}
+
+/* Pop an item and return its value, or -1 if the stack is empty. */
+static long pop_val(struct cds_wfs_batch *batch, int *state)
+{
+	struct cds_wfs_node *node;
+	struct item *it;
+	long val;
+
+	node = __cds_wfs_pop_batch_with_state_blocking(&stack, batch, state);
+	if (!node)
+		return -1;
+	it = caa_container_of(node, struct item, node);
+	val = it->val;
+	free(it);
+	return val;
+}
+
+static void test_sequential(void)
+{
+	struct cds_wfs_batch batch;
+	unsigned long i, nr_bad = 0;
+	int state, nr_last = 0;
+
+	__cds_wfs_init(&stack);
+	cds_wfs_batch_init(&batch);
+	ok(!__cds_wfs_pop_batch_blocking(&stack, &batch),
+		"pop of an empty stack");
+	for (i = 0; i < NR_NODES; i++)
+		cds_wfs_push(&stack, &item_alloc(i)->node);
+	for (i = 0; i < NR_NODES; i++) {
+		if (pop_val(&batch, &state) != (long) (NR_NODES - 1 - i))
+			nr_bad++;
+		if (state & CDS_WFS_STATE_LAST)
+			nr_last++;
+	}
+	ok(!nr_bad, "LIFO order within a batch");
+	ok(nr_last == 1, "a single pop takes the batch");
+	ok(pop_val(&batch, &state) == -1 && !state,
+		"pop of a drained batch and empty stack");
+
+	cds_wfs_push(&stack, &item_alloc(0)->node);
+	cds_wfs_push(&stack, &item_alloc(1)->node);
+	ok(pop_val(&batch, &state) == 1 && (state & CDS_WFS_STATE_LAST),
+		"pop takes a new batch");
+	ok(cds_wfs_empty(&stack), "batched nodes are not in the stack");
+	cds_wfs_push(&stack, &item_alloc(2)->node);
+	ok(pop_val(&batch, &state) == 0 && !state,
+		"nodes of the batch before those pushed since");
+	ok(pop_val(&batch, &state) == 2 && (state & CDS_WFS_STATE_LAST)
+		&& pop_val(&batch, &state) == -1,
+		"nodes pushed during the batch come next");
+}
+
+static int pushers_done;
+static unsigned long popped[NR_PUSHERS * NR_PUSHES];
+
+static void *thr_pusher(void *arg)
+{
+	unsigned long start = (unsigned long) arg * NR_PUSHES, i;
+
+	for (i = start; i < start + NR_PUSHES; i++)
+		cds_wfs_push(&stack, &item_alloc(i)->node);
+	return NULL;
+}
+
+/* Several batch consumers only need the synchronization of pop_all. */
+static void *thr_popper(void *arg)
+{
+	struct cds_wfs_batch batch;
+	long val;
+
+	(void) arg;
+	cds_wfs_batch_init(&batch);
+	for (;;) {
+		val = pop_val(&batch, NULL);
+		if (val >= 0)
+			uatomic_inc(&popped[val]);
+		else if (uatomic_read(&pushers_done)
+				&& cds_wfs_empty(&stack))
+			break;
+	}
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t pushers[NR_PUSHERS], poppers[NR_POPPERS];
+	unsigned long i, nr_bad = 0;
+	int err = 0;
+
+	for (i = 0; i < NR_POPPERS; i++)
+		err |= pthread_create(&poppers[i], NULL, thr_popper, NULL);
+	for (i = 0; i < NR_PUSHERS; i++)
+		err |= pthread_create(&pushers[i], NULL, thr_pusher,
+				(void *) i);
+	for (i = 0; i < NR_PUSHERS; i++)
+		err |= pthread_join(pushers[i], NULL);
+	uatomic_set(&pushers_done, 1);
+	for (i = 0; i < NR_POPPERS; i++)
+		err |= pthread_join(poppers[i], NULL);
+	for (i = 0; i < NR_PUSHERS * NR_PUSHES; i++) {
+		if (popped[i] != 1)
+			nr_bad++;
+	}
+	ok(!err && !nr_bad, "each pushed node popped once by %d consumers",
+		NR_POPPERS);
+}
+
+int main(void)
+{
+	plan_tests(NR_TESTS);
+
+	diag("single thread");
+	test_sequential();
+	diag("%d pushers and %d batch consumers", NR_PUSHERS, NR_POPPERS);
+	test_concurrent();
+
+	return exit_status();
+}